@@ -0,0 +1,638 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Microbenchmarks of the hot paths of the storage engine and of the
+// replication layer: encoding and decoding cfile blocks, inserting into a
+// MemRowSet, looking up keys in a CBTree, appending to and reading from the
+// LogCache, and taking row locks in the LockManager.
+//
+// Each benchmark case runs for each of its data sizes and, if it can run
+// concurrently, for each of the --microbench_threads thread counts. A run is
+// repeated with more operations until it takes at least
+// --microbench_min_time_ms, and the results of the last run are reported.
+// They're logged, and written as JSON to --microbench_json_output (or to
+// stdout), so that they can be compared between builds.
+//
+// Example:
+//   kudu_microbench --microbench_filter=cfile --microbench_threads=1,8
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/type_encodings.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/row.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/common/types.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/log.h"
+#include "kudu/consensus/log_anchor_registry.h"
+#include "kudu/consensus/log_cache.h"
+#include "kudu/consensus/log_util.h"
+#include "kudu/consensus/opid.pb.h"
+#include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/tablet/concurrent_btree.h"
+#include "kudu/tablet/lock_manager.h"
+#include "kudu/tablet/memrowset.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+#include "kudu/util/version_info.h"
+
+DEFINE_string(microbench_filter, "",
+              "Comma-separated list of substrings. Only the benchmark cases "
+              "whose names contain one of them are run. Empty means all.");
+DEFINE_string(microbench_threads, "1,4",
+              "Comma-separated list of the numbers of threads to run the "
+              "concurrent benchmark cases with.");
+DEFINE_int32(microbench_min_time_ms, 1000,
+             "The minimum time each run of a benchmark case is timed for.");
+DEFINE_string(microbench_json_output, "",
+              "File to write the results to as JSON. If empty, they're "
+              "written to stdout.");
+DEFINE_string(microbench_data_dir, "",
+              "Directory the benchmarks which need a file system, such as the "
+              "LogCache ones, create it in. Defaults to a directory under the "
+              "test directory of the environment.");
+
+METRIC_DECLARE_entity(tablet);
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+using cfile::BlockBuilder;
+using cfile::BlockDecoder;
+using cfile::TypeEncodingInfo;
+using cfile::WriterOptions;
+using consensus::LogCache;
+using consensus::ReplicateMsg;
+using consensus::ReplicateRefPtr;
+using tablet::LockManager;
+using tablet::MemRowSet;
+using tablet::ScopedRowLock;
+using tablet::TransactionState;
+
+namespace {
+
+// The function each thread of a run calls once, to run 'num_ops' operations.
+typedef std::function<void(int thread_idx, int64_t num_ops)> OpsFunc;
+
+// Prepares a run of a benchmark case of size 'size' with 'num_threads'
+// threads, and returns the function the threads run. Anything done here
+// isn't timed.
+typedef std::function<OpsFunc(int64_t size, int num_threads)> SetupFunc;
+
+struct BenchmarkCase {
+  string name;
+  // What the size of the case is a measure of, e.g. "values_per_block".
+  string size_unit;
+  vector<int64_t> sizes;
+  // Whether the case runs with each of --microbench_threads, rather than
+  // only with one thread.
+  bool concurrent;
+  // The number of items (values, rows, ...) each operation processes, as a
+  // function of the size, so that throughput can be reported per item.
+  std::function<int64_t(int64_t size)> items_per_op;
+  SetupFunc setup;
+};
+
+struct BenchmarkResult {
+  string name;
+  string size_unit;
+  int64_t size;
+  int threads;
+  int64_t ops;
+  int64_t items;
+  MonoDelta elapsed;
+};
+
+// Runs 'ops_func' on 'num_threads' threads, each running 'ops_per_thread'
+// operations, and returns how long it took for all of them to finish.
+MonoDelta TimeRun(const OpsFunc& ops_func, int num_threads, int64_t ops_per_thread) {
+  CountDownLatch ready(num_threads);
+  CountDownLatch go(1);
+  vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i]() {
+      ready.CountDown();
+      go.Wait();
+      ops_func(i, ops_per_thread);
+    });
+  }
+  ready.Wait();
+  MonoTime start = MonoTime::Now();
+  go.CountDown();
+  for (auto& t : threads) {
+    t.join();
+  }
+  return MonoTime::Now() - start;
+}
+
+// Runs a benchmark case with more and more operations until a run takes at
+// least --microbench_min_time_ms, and returns the results of that run.
+BenchmarkResult RunCase(const BenchmarkCase& bench, int64_t size, int num_threads) {
+  const MonoDelta min_time = MonoDelta::FromMilliseconds(FLAGS_microbench_min_time_ms);
+  int64_t ops_per_thread = 1;
+  while (true) {
+    OpsFunc ops_func = bench.setup(size, num_threads);
+    MonoDelta elapsed = TimeRun(ops_func, num_threads, ops_per_thread);
+    if (elapsed >= min_time) {
+      int64_t ops = ops_per_thread * num_threads;
+      return { bench.name, bench.size_unit, size, num_threads, ops,
+               ops * bench.items_per_op(size), elapsed };
+    }
+    // Aim a little past the minimum time, but grow at most tenfold at once,
+    // since very short runs are poor estimates.
+    double scale = 1.4 * min_time.ToSeconds() / std::max(elapsed.ToSeconds(), 1e-9);
+    scale = std::min(10.0, std::max(2.0, scale));
+    ops_per_thread = static_cast<int64_t>(ops_per_thread * scale);
+  }
+}
+
+////////////////////////////////////////////////////////////
+// cfile encoding and decoding
+////////////////////////////////////////////////////////////
+
+WriterOptions BlockWriterOptions(int64_t block_bytes) {
+  WriterOptions opts;
+  // Make the blocks large enough to hold all the values of a case.
+  opts.storage_attributes.cfile_block_size = block_bytes;
+  return opts;
+}
+
+// The values encoded by the cfile cases: for integers, runs of 16 equal
+// values, which all the integer encodings handle, and for strings, sorted
+// keys with long common prefixes.
+struct BlockValues {
+  BlockValues(DataType type, int64_t count) {
+    if (type == INT32) {
+      ints.resize(count);
+      for (int64_t i = 0; i < count; i++) {
+        ints[i] = static_cast<int32_t>(i / 16);
+      }
+    } else {
+      strings.resize(count);
+      slices.resize(count);
+      for (int64_t i = 0; i < count; i++) {
+        strings[i] = StringPrintf("row-key-%012lld", static_cast<long long>(i));
+        slices[i] = Slice(strings[i]);
+      }
+    }
+  }
+
+  const uint8_t* data() const {
+    return ints.empty() ? reinterpret_cast<const uint8_t*>(slices.data())
+                        : reinterpret_cast<const uint8_t*>(ints.data());
+  }
+
+  vector<int32_t> ints;
+  vector<string> strings;
+  vector<Slice> slices;
+};
+
+// Encodes 'values' into a block with 'builder', and returns it.
+Slice BuildBlock(BlockBuilder* builder, const BlockValues& values, int64_t count) {
+  builder->Reset();
+  const uint8_t* data = values.data();
+  size_t elem_size = values.ints.empty() ? sizeof(Slice) : sizeof(int32_t);
+  int64_t added = 0;
+  while (added < count) {
+    int n = builder->Add(data + added * elem_size, count - added);
+    CHECK_GT(n, 0) << "block is full";
+    added += n;
+  }
+  return builder->Finish(0);
+}
+
+SetupFunc CFileEncodeSetup(DataType type, EncodingType encoding) {
+  return [=](int64_t size, int /* num_threads */) {
+    const TypeEncodingInfo* tei;
+    CHECK_OK(TypeEncodingInfo::Get(GetTypeInfo(type), encoding, &tei));
+    auto values = std::make_shared<BlockValues>(type, size);
+    auto opts = std::make_shared<WriterOptions>(BlockWriterOptions(size * 64));
+    return [=](int /* thread_idx */, int64_t num_ops) {
+      BlockBuilder* raw_builder;
+      CHECK_OK(tei->CreateBlockBuilder(&raw_builder, opts.get()));
+      unique_ptr<BlockBuilder> builder(raw_builder);
+      for (int64_t i = 0; i < num_ops; i++) {
+        BuildBlock(builder.get(), *values, size);
+      }
+    };
+  };
+}
+
+SetupFunc CFileDecodeSetup(DataType type, EncodingType encoding) {
+  return [=](int64_t size, int /* num_threads */) {
+    const TypeInfo* type_info = GetTypeInfo(type);
+    const TypeEncodingInfo* tei;
+    CHECK_OK(TypeEncodingInfo::Get(type_info, encoding, &tei));
+    BlockValues values(type, size);
+    WriterOptions opts = BlockWriterOptions(size * 64);
+    BlockBuilder* raw_builder;
+    CHECK_OK(tei->CreateBlockBuilder(&raw_builder, &opts));
+    unique_ptr<BlockBuilder> builder(raw_builder);
+    // The block refers to the builder's buffer, so it's copied.
+    auto block = std::make_shared<string>(BuildBlock(builder.get(), values, size).ToString());
+    return [=](int /* thread_idx */, int64_t num_ops) {
+      Arena arena(1024 * 1024);
+      vector<uint8_t> buf(size * type_info->size());
+      ColumnBlock cblock(type_info, nullptr, buf.data(), size, &arena);
+      for (int64_t i = 0; i < num_ops; i++) {
+        arena.Reset();
+        BlockDecoder* raw_decoder;
+        CHECK_OK(tei->CreateBlockDecoder(&raw_decoder, Slice(*block), nullptr));
+        unique_ptr<BlockDecoder> decoder(raw_decoder);
+        CHECK_OK(decoder->ParseHeader());
+        ColumnDataView view(&cblock);
+        size_t n = size;
+        CHECK_OK(decoder->CopyNextValues(&n, &view));
+        CHECK_EQ(size, n);
+      }
+    };
+  };
+}
+
+////////////////////////////////////////////////////////////
+// MemRowSet
+////////////////////////////////////////////////////////////
+
+// Inserts rows with values of 'size' bytes into a new MemRowSet, each thread
+// in its own range of keys.
+OpsFunc MemRowSetInsertSetup(int64_t size, int /* num_threads */) {
+  SchemaBuilder builder;
+  CHECK_OK(builder.AddKeyColumn("key", STRING));
+  CHECK_OK(builder.AddColumn("val", STRING));
+  auto schema = std::make_shared<Schema>(builder.Build());
+  // Nothing is anchored in the log, so the MemRowSets can share a registry.
+  static log::LogAnchorRegistry* registry = new log::LogAnchorRegistry();
+  shared_ptr<MemRowSet> mrs;
+  CHECK_OK(MemRowSet::Create(0, *schema, registry, MemTracker::GetRootTracker(), &mrs));
+  return [=](int thread_idx, int64_t num_ops) {
+    const consensus::OpId op_id = consensus::MaximumOpId();
+    const string val(size, 'v');
+    RowBuilder rb(*schema);
+    char key[64];
+    for (int64_t i = 0; i < num_ops; i++) {
+      snprintf(key, sizeof(key), "%04d-%012lld", thread_idx, static_cast<long long>(i));
+      rb.Reset();
+      rb.AddString(Slice(key));
+      rb.AddString(val);
+      CHECK_OK(mrs->Insert(Timestamp(i), rb.row(), op_id));
+    }
+  };
+}
+
+////////////////////////////////////////////////////////////
+// CBTree
+////////////////////////////////////////////////////////////
+
+// Looks up random keys in a CBTree of 'size' keys.
+OpsFunc CBTreeLookupSetup(int64_t size, int /* num_threads */) {
+  auto tree = std::make_shared<tablet::btree::CBTree<tablet::btree::BTreeTraits>>();
+  char key[32];
+  for (int64_t i = 0; i < size; i++) {
+    snprintf(key, sizeof(key), "%016lld", static_cast<long long>(i));
+    CHECK(tree->Insert(Slice(key), Slice(key)));
+  }
+  return [=](int thread_idx, int64_t num_ops) {
+    Random rng(thread_idx);
+    char key[32];
+    char val[32];
+    for (int64_t i = 0; i < num_ops; i++) {
+      snprintf(key, sizeof(key), "%016lld", static_cast<long long>(rng.Uniform64(size)));
+      size_t len = sizeof(val);
+      CHECK_EQ(tablet::btree::CBTree<tablet::btree::BTreeTraits>::GET_SUCCESS,
+               tree->GetCopy(Slice(key), val, &len));
+    }
+  };
+}
+
+////////////////////////////////////////////////////////////
+// LogCache
+////////////////////////////////////////////////////////////
+
+// A LogCache over a WAL on a real file system, which the LogCache cases
+// share.
+class LogCacheFixture {
+ public:
+  static LogCacheFixture* Get() {
+    static LogCacheFixture* fixture = new LogCacheFixture();
+    return fixture;
+  }
+
+  // Appends 'count' ops with payloads of 'payload_size' bytes, one at a time.
+  void Append(int64_t count, int64_t payload_size) {
+    for (int64_t i = 0; i < count; i++) {
+      unique_ptr<ReplicateMsg> msg(new ReplicateMsg);
+      msg->mutable_id()->set_term(1);
+      msg->mutable_id()->set_index(next_index_++);
+      msg->set_op_type(consensus::NO_OP);
+      msg->mutable_noop_request()->mutable_payload_for_tests()->resize(payload_size);
+      msg->set_timestamp(Timestamp::kInitialTimestamp.ToUint64());
+      vector<ReplicateRefPtr> msgs = {
+        consensus::make_scoped_refptr_replicate(msg.release())
+      };
+      CHECK_OK(cache_->AppendOperations(msgs, Bind(&CheckAppended)));
+    }
+  }
+
+  // Waits for the appended ops to be written to the log.
+  void WaitUntilAllFlushed() {
+    CHECK_OK(log_->WaitUntilAllFlushed());
+  }
+
+  LogCache* cache() const { return cache_.get(); }
+  int64_t last_index() const { return next_index_ - 1; }
+
+ private:
+  LogCacheFixture()
+      : schema_({ ColumnSchema("key", INT32) }, 1),
+        metric_entity_(METRIC_ENTITY_tablet.Instantiate(&metric_registry_, "microbench")),
+        next_index_(1) {
+    Env* env = Env::Default();
+    string dir = FLAGS_microbench_data_dir;
+    if (dir.empty()) {
+      CHECK_OK(env->GetTestDirectory(&dir));
+      dir = JoinPathSegments(dir, Substitute("kudu_microbench.$0", getpid()));
+    }
+    fs_manager_.reset(new FsManager(env, dir));
+    CHECK_OK(fs_manager_->CreateInitialFileSystemLayout());
+    CHECK_OK(fs_manager_->Open());
+    CHECK_OK(log::Log::Open(log::LogOptions(), fs_manager_.get(), "microbench-tablet",
+                            schema_, 0, nullptr, &log_));
+    cache_.reset(new LogCache(metric_entity_, log_, "microbench-peer", "microbench-tablet"));
+    cache_->Init(consensus::MinimumOpId());
+  }
+
+  static void CheckAppended(const Status& s) {
+    CHECK_OK(s);
+  }
+
+  const Schema schema_;
+  MetricRegistry metric_registry_;
+  scoped_refptr<MetricEntity> metric_entity_;
+  unique_ptr<FsManager> fs_manager_;
+  scoped_refptr<log::Log> log_;
+  unique_ptr<LogCache> cache_;
+  int64_t next_index_;
+};
+
+// Appends ops with payloads of 'size' bytes.
+OpsFunc LogCacheAppendSetup(int64_t size, int /* num_threads */) {
+  LogCacheFixture* fixture = LogCacheFixture::Get();
+  fixture->WaitUntilAllFlushed();
+  return [=](int /* thread_idx */, int64_t num_ops) {
+    fixture->Append(num_ops, size);
+  };
+}
+
+// Reads batches of up to 1MB of cached ops with payloads of 'size' bytes,
+// following random indexes.
+OpsFunc LogCacheReadSetup(int64_t size, int /* num_threads */) {
+  const int64_t kNumOps = 1000;
+  LogCacheFixture* fixture = LogCacheFixture::Get();
+  fixture->Append(kNumOps, size);
+  fixture->WaitUntilAllFlushed();
+  int64_t first_index = fixture->last_index() - kNumOps + 1;
+  return [=](int thread_idx, int64_t num_ops) {
+    Random rng(thread_idx);
+    for (int64_t i = 0; i < num_ops; i++) {
+      int64_t after_index = first_index + rng.Uniform64(kNumOps) - 1;
+      vector<ReplicateRefPtr> msgs;
+      consensus::OpId preceding_op;
+      CHECK_OK(fixture->cache()->ReadOps(after_index, 1024 * 1024, &msgs, &preceding_op));
+      CHECK(!msgs.empty());
+    }
+  };
+}
+
+////////////////////////////////////////////////////////////
+// LockManager
+////////////////////////////////////////////////////////////
+
+// Locks and unlocks random rows among 'size' rows. The fewer the rows, the
+// more the threads contend for them.
+OpsFunc LockManagerSetup(int64_t size, int /* num_threads */) {
+  auto manager = std::make_shared<LockManager>();
+  auto keys = std::make_shared<vector<string>>();
+  for (int64_t i = 0; i < size; i++) {
+    keys->push_back(Substitute("row-$0", i));
+  }
+  return [=](int thread_idx, int64_t num_ops) {
+    // Each thread acts as a different transaction.
+    const TransactionState* txn = reinterpret_cast<const TransactionState*>(
+        static_cast<uintptr_t>(thread_idx + 1));
+    Random rng(thread_idx);
+    for (int64_t i = 0; i < num_ops; i++) {
+      ScopedRowLock l(manager.get(), txn, (*keys)[rng.Uniform64(size)],
+                      LockManager::LOCK_EXCLUSIVE);
+    }
+  };
+}
+
+////////////////////////////////////////////////////////////
+// Driver
+////////////////////////////////////////////////////////////
+
+vector<BenchmarkCase> AllCases() {
+  auto one = [](int64_t /* size */) { return 1; };
+  auto same = [](int64_t size) { return size; };
+  vector<BenchmarkCase> cases;
+
+  const vector<std::pair<DataType, EncodingType>> kEncodings = {
+    { INT32, PLAIN_ENCODING },
+    { INT32, BIT_SHUFFLE },
+    { INT32, RLE },
+    { INT32, FRAME_OF_REFERENCE },
+    { BINARY, PLAIN_ENCODING },
+    { BINARY, PREFIX_ENCODING },
+    { BINARY, FRONT_CODED_ENCODING },
+  };
+  for (const auto& e : kEncodings) {
+    string suffix = Substitute("$0/$1", GetTypeInfo(e.first)->name(),
+                               EncodingType_Name(e.second));
+    cases.push_back({ "cfile_encode/" + suffix, "values_per_block", { 1024, 64 * 1024 },
+                      true, same, CFileEncodeSetup(e.first, e.second) });
+    cases.push_back({ "cfile_decode/" + suffix, "values_per_block", { 1024, 64 * 1024 },
+                      true, same, CFileDecodeSetup(e.first, e.second) });
+  }
+  cases.push_back({ "memrowset_insert", "value_bytes", { 16, 1024 },
+                    true, one, &MemRowSetInsertSetup });
+  cases.push_back({ "cbtree_lookup", "keys", { 1000, 1000 * 1000 },
+                    true, one, &CBTreeLookupSetup });
+  // Ops are appended in order, so appends can't be concurrent.
+  cases.push_back({ "log_cache_append", "payload_bytes", { 0, 16 * 1024 },
+                    false, one, &LogCacheAppendSetup });
+  cases.push_back({ "log_cache_read", "payload_bytes", { 128, 16 * 1024 },
+                    true, one, &LogCacheReadSetup });
+  cases.push_back({ "lock_manager_lock_unlock", "rows", { 16, 1000 * 1000 },
+                    true, one, &LockManagerSetup });
+  return cases;
+}
+
+bool MatchesFilter(const string& name) {
+  if (FLAGS_microbench_filter.empty()) {
+    return true;
+  }
+  for (const string& f : strings::Split(FLAGS_microbench_filter, ",", strings::SkipEmpty())) {
+    if (name.find(f) != string::npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WriteResults(const vector<BenchmarkResult>& results, std::ostream* out) {
+  JsonWriter jw(out, JsonWriter::PRETTY);
+  jw.StartObject();
+  jw.String("context");
+  jw.StartObject();
+  jw.String("version");
+  jw.String(VersionInfo::GetShortVersionInfo());
+  jw.String("num_cpus");
+  jw.Int(base::NumCPUs());
+  jw.String("min_time_ms");
+  jw.Int(FLAGS_microbench_min_time_ms);
+  jw.EndObject();
+
+  jw.String("benchmarks");
+  jw.StartArray();
+  for (const auto& r : results) {
+    double secs = r.elapsed.ToSeconds();
+    jw.StartObject();
+    jw.String("name");
+    jw.String(r.name);
+    jw.String("size_unit");
+    jw.String(r.size_unit);
+    jw.String("size");
+    jw.Int64(r.size);
+    jw.String("threads");
+    jw.Int(r.threads);
+    jw.String("ops");
+    jw.Int64(r.ops);
+    jw.String("elapsed_ns");
+    jw.Int64(r.elapsed.ToNanoseconds());
+    jw.String("ops_per_sec");
+    jw.Double(r.ops / secs);
+    jw.String("items_per_sec");
+    jw.Double(r.items / secs);
+    // The latency of an operation, as seen by each thread.
+    jw.String("ns_per_op");
+    jw.Double(r.elapsed.ToNanoseconds() * static_cast<double>(r.threads) / r.ops);
+    jw.EndObject();
+  }
+  jw.EndArray();
+  jw.EndObject();
+}
+
+int RunMicrobenchmarks() {
+  vector<int> thread_counts;
+  for (const string& t : strings::Split(FLAGS_microbench_threads, ",", strings::SkipEmpty())) {
+    int n;
+    if (!safe_strto32(t, &n) || n <= 0) {
+      LOG(ERROR) << "invalid thread count in --microbench_threads: " << t;
+      return 1;
+    }
+    thread_counts.push_back(n);
+  }
+  if (thread_counts.empty()) {
+    thread_counts.push_back(1);
+  }
+
+  vector<BenchmarkResult> results;
+  for (const BenchmarkCase& bench : AllCases()) {
+    if (!MatchesFilter(bench.name)) {
+      continue;
+    }
+    vector<int> threads = bench.concurrent ? thread_counts : vector<int>{ 1 };
+    for (int64_t size : bench.sizes) {
+      for (int num_threads : threads) {
+        BenchmarkResult r = RunCase(bench, size, num_threads);
+        LOG(INFO) << Substitute("$0 ($1=$2, threads=$3): $4 ops in $5, $6 ops/s",
+                                r.name, r.size_unit, r.size, r.threads, r.ops,
+                                r.elapsed.ToString(), r.ops / r.elapsed.ToSeconds());
+        results.emplace_back(std::move(r));
+      }
+    }
+  }
+
+  std::ostringstream json;
+  WriteResults(results, &json);
+  if (FLAGS_microbench_json_output.empty()) {
+    std::cout << json.str() << std::endl;
+  } else {
+    Status s = WriteStringToFile(Env::Default(), json.str(), FLAGS_microbench_json_output);
+    if (!s.ok()) {
+      LOG(ERROR) << "could not write results: " << s.ToString();
+      return 1;
+    }
+  }
+  return 0;
+}
+
+} // anonymous namespace
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  FLAGS_logtostderr = 1;
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+  return kudu::RunMicrobenchmarks();
+}
@@ -22,13 +22,16 @@
 //
 
 #include <cstddef>
+#include <cstdint>
 #include <ostream>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bit-stream-utils.h"
 #include "kudu/util/bit-stream-utils.inline.h"
 #include "kudu/util/faststring.h"
@@ -38,6 +41,10 @@
 
 DEFINE_int32(bitstream_num_bytes, 1 * 1024 * 1024,
              "Number of bytes worth of bits to write and read from the bitstream");
+DEFINE_int32(rle_num_values, 16 * 1024 * 1024,
+             "Number of values to encode and decode in the RLE literal run benchmarks");
+
+using std::vector;
 
 namespace kudu {
 
@@ -75,6 +82,45 @@ void BooleanBitStream() {
   }
 }
 
+// Measure reading the single-bit stream written by BooleanBitStream() in batches
+void BooleanBitStreamBatch() {
+  faststring buffer(FLAGS_bitstream_num_bytes);
+  BitWriter writer(&buffer);
+  for (int i = 0; i < FLAGS_bitstream_num_bytes * 8; ++i) {
+    writer.PutValue((i / 8) % 2, 1);
+  }
+  writer.Flush();
+
+  BitReader reader(buffer.data(), writer.bytes_written());
+  bool vals[1024];
+  while (reader.GetBatch(1, vals, arraysize(vals)) > 0) {
+  }
+}
+
+// Measure decoding literal runs of values of 'bit_width' bits, one value at a
+// time if 'batch' is false, and in batches otherwise.
+void IntegerLiteralRLE(int bit_width, bool batch) {
+  faststring buffer;
+  RleEncoder<uint32_t> encoder(&buffer, bit_width);
+  const uint32_t mask = bit_width == 32 ? ~0U : (1U << bit_width) - 1;
+  // Consecutive values differ, so that they're all in literal runs.
+  for (int i = 0; i < FLAGS_rle_num_values; i++) {
+    encoder.Put(i & mask);
+  }
+  int len = encoder.Flush();
+
+  RleDecoder<uint32_t> decoder(buffer.data(), len, bit_width);
+  vector<uint32_t> vals(1024);
+  if (batch) {
+    while (decoder.GetBatch(vals.data(), vals.size()) > 0) {
+    }
+  } else {
+    size_t i = 0;
+    while (decoder.Get(&vals[i++ % vals.size()])) {
+    }
+  }
+}
+
 // Measure bulk puts and decoding runs of RLE bools
 void BooleanRLE() {
   const int num_iters = 3 * 1024;
@@ -112,9 +158,22 @@ int main(int argc, char **argv) {
     kudu::BooleanBitStream();
   }
 
+  LOG_TIMING(INFO, "BooleanBitStreamBatch") {
+    kudu::BooleanBitStreamBatch();
+  }
+
   LOG_TIMING(INFO, "BooleanRLE") {
     kudu::BooleanRLE();
   }
 
+  for (int bit_width : { 1, 7, 8, 13, 16, 24, 31, 32 }) {
+    LOG_TIMING(INFO, strings::Substitute("IntegerLiteralRLE($0 bits)", bit_width)) {
+      kudu::IntegerLiteralRLE(bit_width, false);
+    }
+    LOG_TIMING(INFO, strings::Substitute("IntegerLiteralRLE($0 bits, batched)", bit_width)) {
+      kudu::IntegerLiteralRLE(bit_width, true);
+    }
+  }
+
   return 0;
 }
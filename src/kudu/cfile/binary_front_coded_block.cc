@@ -0,0 +1,369 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/binary_front_coded_block.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <ostream>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/memory/arena.h"
+
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+////////////////////////////////////////////////////////////
+// Encoding
+////////////////////////////////////////////////////////////
+
+BinaryFrontCodedBlockBuilder::BinaryFrontCodedBlockBuilder(const WriterOptions *options)
+  : head_offset_(0),
+    head_len_(0),
+    finished_(false),
+    options_(options) {
+  Reset();
+}
+
+void BinaryFrontCodedBlockBuilder::Reset() {
+  offsets_.clear();
+  shared_.clear();
+  buffer_.clear();
+  buffer_.resize(kHeaderSize);
+  buffer_.reserve(options_->storage_attributes.cfile_block_size);
+  head_offset_ = 0;
+  head_len_ = 0;
+  last_val_.clear();
+  finished_ = false;
+}
+
+bool BinaryFrontCodedBlockBuilder::IsBlockFull() const {
+  return buffer_.size() + offsets_.size() * (sizeof(uint32_t) + sizeof(uint16_t)) >
+      options_->storage_attributes.cfile_block_size;
+}
+
+Slice BinaryFrontCodedBlockBuilder::Finish(rowid_t ordinal_pos) {
+  CHECK(!finished_) << "already finished";
+  finished_ = true;
+
+  const size_t index_pos = buffer_.size();
+
+  InlineEncodeFixed32(&buffer_[0], ordinal_pos);
+  InlineEncodeFixed32(&buffer_[4], offsets_.size());
+  InlineEncodeFixed32(&buffer_[8], options_->block_restart_interval);
+  InlineEncodeFixed32(&buffer_[12], index_pos);
+
+  buffer_.reserve(index_pos +
+                  (offsets_.size() + 1) * sizeof(uint32_t) +
+                  shared_.size() * sizeof(uint16_t));
+  for (uint32_t offset : offsets_) {
+    InlinePutFixed32(&buffer_, offset);
+  }
+  InlinePutFixed32(&buffer_, index_pos);
+  for (uint16_t shared : shared_) {
+    uint8_t buf[sizeof(uint16_t)];
+    UNALIGNED_STORE16(buf, shared);
+    buffer_.append(buf, sizeof(buf));
+  }
+
+  return Slice(buffer_);
+}
+
+int BinaryFrontCodedBlockBuilder::Add(const uint8_t *vals, size_t count) {
+  DCHECK(!finished_);
+  DCHECK_GT(count, 0);
+  DCHECK_GT(options_->block_restart_interval, 0);
+
+  const Slice* slices = reinterpret_cast<const Slice*>(vals);
+  size_t added = 0;
+  while (!IsBlockFull() && added < count) {
+    const Slice& val = slices[added];
+
+    size_t shared = 0;
+    if (offsets_.size() % options_->block_restart_interval == 0) {
+      // Start a new group, headed by this entry.
+      head_offset_ = buffer_.size();
+      head_len_ = val.size();
+    } else {
+      Slice head(&buffer_[head_offset_], head_len_);
+      shared = std::min<size_t>(CommonPrefixLength(head, val),
+                                std::numeric_limits<uint16_t>::max());
+      if (shared < kMinSharedPrefix) {
+        shared = 0;
+      }
+    }
+
+    offsets_.push_back(buffer_.size());
+    shared_.push_back(shared);
+    buffer_.append(val.data() + shared, val.size() - shared);
+    added++;
+  }
+
+  if (added > 0) {
+    const Slice& last = slices[added - 1];
+    last_val_.assign_copy(last.data(), last.size());
+  }
+  return added;
+}
+
+size_t BinaryFrontCodedBlockBuilder::Count() const {
+  return offsets_.size();
+}
+
+Status BinaryFrontCodedBlockBuilder::GetFirstKey(void *key) const {
+  if (offsets_.empty()) {
+    return Status::NotFound("no keys in data block");
+  }
+  // The first entry heads its group, so it is stored whole.
+  DCHECK_EQ(0, shared_[0]);
+  size_t len = offsets_.size() > 1 ? offsets_[1] - offsets_[0] : head_len_;
+  *reinterpret_cast<Slice *>(key) = Slice(&buffer_[offsets_[0]], len);
+  return Status::OK();
+}
+
+Status BinaryFrontCodedBlockBuilder::GetLastKey(void *key) const {
+  if (offsets_.empty()) {
+    return Status::NotFound("no keys in data block");
+  }
+  *reinterpret_cast<Slice *>(key) = Slice(last_val_);
+  return Status::OK();
+}
+
+////////////////////////////////////////////////////////////
+// Decoding
+////////////////////////////////////////////////////////////
+
+BinaryFrontCodedBlockDecoder::BinaryFrontCodedBlockDecoder(Slice slice)
+    : data_(slice),
+      parsed_(false),
+      num_elems_(0),
+      ordinal_pos_base_(0),
+      restart_interval_(0),
+      offsets_(nullptr),
+      shared_(nullptr),
+      cur_idx_(0) {
+}
+
+Status BinaryFrontCodedBlockDecoder::ParseHeader() {
+  CHECK(!parsed_);
+
+  if (data_.size() < kMinHeaderSize) {
+    return Status::Corruption(
+      Substitute("not enough bytes for header: string block header "
+        "size ($0) less than minimum possible header length ($1)",
+        data_.size(), kMinHeaderSize));
+  }
+
+  ordinal_pos_base_ = DecodeFixed32(&data_[0]);
+  num_elems_ = DecodeFixed32(&data_[4]);
+  restart_interval_ = DecodeFixed32(&data_[8]);
+  const size_t index_pos = DecodeFixed32(&data_[12]);
+
+  const uint64_t index_size = (num_elems_ + 1ULL) * sizeof(uint32_t) +
+      static_cast<uint64_t>(num_elems_) * sizeof(uint16_t);
+  if (index_pos < kMinHeaderSize || index_pos > data_.size() ||
+      data_.size() - index_pos < index_size) {
+    return Status::Corruption(
+      Substitute("index of $0 entries at $1 doesn't fit in front-coded block of $2 bytes",
+                 num_elems_, index_pos, data_.size()));
+  }
+  if (num_elems_ > 0 && restart_interval_ == 0) {
+    return Status::Corruption("front-coded block has a restart interval of 0");
+  }
+  offsets_ = data_.data() + index_pos;
+  shared_ = offsets_ + (num_elems_ + 1) * sizeof(uint32_t);
+
+  // Check the index once here, so that entries can be accessed without
+  // bounds checks afterwards.
+  if (offset(num_elems_) != index_pos) {
+    return Status::Corruption("last offset of front-coded block index doesn't point at the index");
+  }
+  for (uint32_t i = 0; i < num_elems_; i++) {
+    if (offset(i) < kMinHeaderSize || offset(i) > offset(i + 1)) {
+      return Status::Corruption(Substitute("bad offset for entry $0 of front-coded block", i));
+    }
+    const uint32_t head = i - i % restart_interval_;
+    if (head == i ? shared(i) != 0 : shared(i) > offset(head + 1) - offset(head)) {
+      return Status::Corruption(
+          Substitute("bad shared prefix length for entry $0 of front-coded block", i));
+    }
+  }
+
+  parsed_ = true;
+  return Status::OK();
+}
+
+void BinaryFrontCodedBlockDecoder::SeekToPositionInBlock(uint pos) {
+  if (PREDICT_FALSE(num_elems_ == 0)) {
+    DCHECK_EQ(0, pos);
+    return;
+  }
+
+  DCHECK_LE(pos, num_elems_);
+  cur_idx_ = pos;
+}
+
+int BinaryFrontCodedBlockDecoder::CompareAt(size_t idx, const Slice& target) const {
+  const Slice pre = prefix(idx);
+  const size_t n = std::min(pre.size(), target.size());
+  int c = memcmp(pre.data(), target.data(), n);
+  if (c != 0) {
+    return c;
+  }
+  if (target.size() < pre.size()) {
+    return 1;
+  }
+  return suffix(idx).compare(Slice(target.data() + pre.size(), target.size() - pre.size()));
+}
+
+void BinaryFrontCodedBlockDecoder::EntryAt(size_t idx, faststring* scratch, Slice* out) const {
+  if (shared(idx) == 0) {
+    *out = suffix(idx);
+    return;
+  }
+  const Slice pre = prefix(idx);
+  const Slice suf = suffix(idx);
+  scratch->clear();
+  scratch->reserve(pre.size() + suf.size());
+  scratch->append(pre.data(), pre.size());
+  scratch->append(suf.data(), suf.size());
+  *out = Slice(*scratch);
+}
+
+Status BinaryFrontCodedBlockDecoder::SeekAtOrAfterValue(const void *value_void, bool *exact) {
+  DCHECK(value_void != nullptr);
+
+  const Slice &target = *reinterpret_cast<const Slice *>(value_void);
+
+  // Every entry can be compared in place, so binary search over all of them
+  // rather than over the group heads.
+  uint32_t left = 0;
+  uint32_t right = num_elems_;
+  while (left != right) {
+    uint32_t mid = left + (right - left) / 2;
+    int c = CompareAt(mid, target);
+    if (c < 0) {
+      left = mid + 1;
+    } else if (c > 0) {
+      right = mid;
+    } else {
+      cur_idx_ = mid;
+      *exact = true;
+      return Status::OK();
+    }
+  }
+  *exact = false;
+  cur_idx_ = left;
+  if (cur_idx_ == num_elems_) {
+    return Status::NotFound("after last key in block");
+  }
+
+  return Status::OK();
+}
+
+Status BinaryFrontCodedBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
+  DCHECK(parsed_);
+  CHECK_EQ(dst->type_info()->physical_type(), BINARY);
+  DCHECK_LE(*n, dst->nrows());
+  DCHECK_EQ(dst->stride(), sizeof(Slice));
+  if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+    *n = 0;
+    return Status::OK();
+  }
+  const size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+
+  // Size the whole batch up front from the index, so that the cells are
+  // copied with a single arena allocation.
+  size_t total = offset(cur_idx_ + max_fetch) - offset(cur_idx_);
+  for (size_t i = 0; i < max_fetch; i++) {
+    total += shared(cur_idx_ + i);
+  }
+  Slice* out = reinterpret_cast<Slice*>(dst->data());
+  if (PREDICT_FALSE(total == 0)) {
+    std::fill(out, out + max_fetch, Slice());
+    cur_idx_ += max_fetch;
+    *n = max_fetch;
+    return Status::OK();
+  }
+  uint8_t* buf = static_cast<uint8_t*>(dst->arena()->AllocateBytes(total));
+  if (PREDICT_FALSE(buf == nullptr)) {
+    return Status::IOError("Out of memory",
+                           Substitute("Failed to allocate $0 bytes in output arena", total));
+  }
+
+  for (size_t i = 0; i < max_fetch; i++, cur_idx_++) {
+    const Slice pre = prefix(cur_idx_);
+    const Slice suf = suffix(cur_idx_);
+    memcpy(buf, pre.data(), pre.size());
+    memcpy(buf + pre.size(), suf.data(), suf.size());
+    out[i] = Slice(buf, pre.size() + suf.size());
+    buf += out[i].size();
+  }
+  *n = max_fetch;
+  return Status::OK();
+}
+
+Status BinaryFrontCodedBlockDecoder::CopyNextAndEval(size_t* n,
+                                                     ColumnMaterializationContext* ctx,
+                                                     SelectionVectorView* sel,
+                                                     ColumnDataView* dst) {
+  DCHECK(parsed_);
+  CHECK_EQ(dst->type_info()->physical_type(), BINARY);
+  DCHECK_LE(*n, dst->nrows());
+  DCHECK_EQ(dst->stride(), sizeof(Slice));
+  ctx->SetDecoderEvalSupported();
+  if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+    *n = 0;
+    return Status::OK();
+  }
+  const size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+
+  // Entries that share no prefix are evaluated in place, and only the cells
+  // that pass are copied.
+  Arena* out_arena = dst->arena();
+  Slice* out = reinterpret_cast<Slice*>(dst->data());
+  for (size_t i = 0; i < max_fetch; i++, cur_idx_++) {
+    if (!sel->TestBit(i)) {
+      continue;
+    }
+    Slice elem;
+    EntryAt(cur_idx_, &scratch_, &elem);
+    if (ctx->pred()->EvaluateCell<BINARY>(static_cast<const void*>(&elem))) {
+      CHECK(out_arena->RelocateSlice(elem, &out[i]));
+    } else {
+      sel->ClearBit(i);
+    }
+  }
+  *n = max_fetch;
+  return Status::OK();
+}
+
+} // namespace cfile
+} // namespace kudu
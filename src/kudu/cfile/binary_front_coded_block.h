@@ -0,0 +1,210 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Front-coded encoding for binary data with common prefixes.
+//
+// Entries are split into groups of 'block_restart_interval' entries. The
+// first entry of a group (its head) is stored whole. Every other entry
+// stores only the bytes following the prefix it shares with its group's
+// head. Unlike PREFIX_ENCODING, which shares with the previous entry and
+// needs varint-prefixed entries to be decoded in sequence, every entry can
+// be located and compared in constant time from a fixed-width index.
+//
+// The block consists of:
+// Header:
+//   ordinal_pos (32-bit fixed)
+//   num_elems (32-bit fixed)
+//   restart_interval (32-bit fixed)
+//   index_pos (32-bit fixed): position of the index, relative to block start
+// Suffixes:
+//   the non-shared bytes of each entry
+// Index: [pointed to by index_pos]
+//   num_elems + 1 32-bit fixed offsets of each entry's suffix, relative to
+//   block start. The last one points after the last suffix.
+//   num_elems 16-bit fixed lengths of the prefix that each entry shares
+//   with its group's head.
+//
+// Prefixes shorter than kMinSharedPrefix aren't shared. Entries that share
+// nothing are contiguous in the block, and the decoder reads and compares
+// them in place.
+#ifndef KUDU_CFILE_BINARY_FRONT_CODED_BLOCK_H
+#define KUDU_CFILE_BINARY_FRONT_CODED_BLOCK_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnDataView;
+class ColumnMaterializationContext;
+class SelectionVectorView;
+
+namespace cfile {
+
+struct WriterOptions;
+
+class BinaryFrontCodedBlockBuilder final : public BlockBuilder {
+ public:
+  explicit BinaryFrontCodedBlockBuilder(const WriterOptions *options);
+
+  bool IsBlockFull() const override;
+
+  int Add(const uint8_t *vals, size_t count) override;
+
+  // Return a Slice which represents the encoded data.
+  //
+  // This Slice points to internal data of this class
+  // and becomes invalid after the builder is destroyed
+  // or after Finish() is called again.
+  Slice Finish(rowid_t ordinal_pos) override;
+
+  void Reset() override;
+
+  size_t Count() const override;
+
+  // Return the first added key.
+  // key should be a Slice*
+  Status GetFirstKey(void *key) const override;
+
+  // Return the last added key.
+  // key should be a Slice*
+  Status GetLastKey(void *key) const override;
+
+  // Length of a header.
+  static const size_t kHeaderSize = sizeof(uint32_t) * 4;
+
+  // Shortest prefix worth sharing with a group's head.
+  static const size_t kMinSharedPrefix = 4;
+
+ private:
+  faststring buffer_;
+
+  // Offsets of each entry's suffix, relative to the start of the block, and
+  // the lengths of the prefixes they share with their group's head.
+  std::vector<uint32_t> offsets_;
+  std::vector<uint16_t> shared_;
+
+  // Location of the current group's head in 'buffer_'.
+  size_t head_offset_;
+  size_t head_len_;
+
+  faststring last_val_;
+
+  bool finished_;
+
+  const WriterOptions *options_;
+};
+
+class BinaryFrontCodedBlockDecoder final : public BlockDecoder {
+ public:
+  explicit BinaryFrontCodedBlockDecoder(Slice slice);
+
+  Status ParseHeader() override;
+  void SeekToPositionInBlock(uint pos) override;
+  Status SeekAtOrAfterValue(const void *value, bool *exact_match) override;
+  Status CopyNextValues(size_t *n, ColumnDataView *dst) override;
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override;
+
+  bool HasNext() const override {
+    DCHECK(parsed_);
+    return cur_idx_ < num_elems_;
+  }
+
+  size_t Count() const override {
+    DCHECK(parsed_);
+    return num_elems_;
+  }
+
+  size_t GetCurrentIndex() const override {
+    DCHECK(parsed_);
+    return cur_idx_;
+  }
+
+  rowid_t GetFirstRowId() const override {
+    return ordinal_pos_base_;
+  }
+
+  // Minimum length of a header.
+  static const size_t kMinHeaderSize = BinaryFrontCodedBlockBuilder::kHeaderSize;
+
+ private:
+  // Offset within 'data_' of the suffix of the entry 'idx'.
+  uint32_t offset(size_t idx) const {
+    return DecodeFixed32(offsets_ + idx * sizeof(uint32_t));
+  }
+
+  // Length of the prefix that the entry 'idx' shares with its group's head.
+  uint32_t shared(size_t idx) const {
+    return UNALIGNED_LOAD16(shared_ + idx * sizeof(uint16_t));
+  }
+
+  Slice suffix(size_t idx) const {
+    const uint32_t off = offset(idx);
+    return Slice(&data_[off], offset(idx + 1) - off);
+  }
+
+  // The shared prefix of the entry 'idx', which points into the suffix of
+  // its group's head.
+  Slice prefix(size_t idx) const {
+    return Slice(&data_[offset(idx - idx % restart_interval_)], shared(idx));
+  }
+
+  // Compare the entry 'idx' to 'target' without materializing it.
+  int CompareAt(size_t idx, const Slice& target) const;
+
+  // Set 'out' to the entry 'idx', materializing it in 'scratch' if it
+  // isn't contiguous in the block.
+  void EntryAt(size_t idx, faststring* scratch, Slice* out) const;
+
+  Slice data_;
+  bool parsed_;
+
+  uint32_t num_elems_;
+  rowid_t ordinal_pos_base_;
+  uint32_t restart_interval_;
+
+  // The two arrays of the index, within 'data_'.
+  const uint8_t* offsets_;
+  const uint8_t* shared_;
+
+  // Index of the currently seeked element in the block.
+  uint32_t cur_idx_;
+
+  // Materialized entry for the predicate evaluation of CopyNextAndEval().
+  faststring scratch_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif // KUDU_CFILE_BINARY_FRONT_CODED_BLOCK_H
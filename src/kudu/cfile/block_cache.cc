@@ -19,14 +19,19 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <ostream>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/fs/block_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/flag_tags.h"
@@ -54,6 +59,18 @@ DEFINE_string(block_cache_type, "DRAM",
               "in a memory-mapped file using the NVML library.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_string(block_cache_eviction_policy, "LRU",
+              "Which eviction policy to use for the block cache. Valid "
+              "choices are 'LRU' or 'TINYLFU'. LRU, the default, evicts the "
+              "least recently used blocks. 'TINYLFU' only admits a new block "
+              "into a full cache if it is accessed more frequently than the "
+              "block it would evict, so that large scans do not flush the "
+              "frequently accessed blocks, and doesn't lock the cache on "
+              "hits. 'TINYLFU' requires the DRAM block cache.");
+TAG_FLAG(block_cache_eviction_policy, experimental);
+
+using std::unordered_set;
+using std::vector;
 using strings::Substitute;
 
 template <class T> class scoped_refptr;
@@ -68,7 +85,8 @@ namespace {
 
 Cache* CreateCache(int64_t capacity) {
   CacheType t = BlockCache::GetConfiguredCacheTypeOrDie();
-  return NewLRUCache(t, capacity, "block_cache");
+  CacheEvictionPolicy policy = BlockCache::GetConfiguredEvictionPolicyOrDie();
+  return NewCache(t, policy, capacity, "block_cache");
 }
 
 // Validates the block cache capacity won't permit the cache to grow large enough
@@ -117,6 +135,24 @@ CacheType BlockCache::GetConfiguredCacheTypeOrDie() {
   __builtin_unreachable();
 }
 
+CacheEvictionPolicy BlockCache::GetConfiguredEvictionPolicyOrDie() {
+  ToUpperCase(FLAGS_block_cache_eviction_policy, &FLAGS_block_cache_eviction_policy);
+  if (FLAGS_block_cache_eviction_policy == "LRU") {
+    return CacheEvictionPolicy::LRU;
+  }
+  if (FLAGS_block_cache_eviction_policy == "TINYLFU") {
+    if (GetConfiguredCacheTypeOrDie() != DRAM_CACHE) {
+      LOG(FATAL) << "The 'TINYLFU' block cache eviction policy requires the "
+                 << "'DRAM' block cache type";
+    }
+    return CacheEvictionPolicy::TINY_LFU;
+  }
+
+  LOG(FATAL) << "Unknown block cache eviction policy: '"
+             << FLAGS_block_cache_eviction_policy << "' (expected 'LRU' or 'TINYLFU')";
+  __builtin_unreachable();
+}
+
 BlockCache::BlockCache()
   : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024) {
 }
@@ -146,6 +182,34 @@ void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inser
   inserted->SetHandle(cache_.get(), h);
 }
 
+Status BlockCache::ValidateRestoredBlocks(fs::BlockManager* block_manager) {
+  if (!cache_->HasUnvalidatedEntries()) {
+    return Status::OK();
+  }
+  vector<BlockId> block_ids;
+  RETURN_NOT_OK(block_manager->GetAllBlockIds(&block_ids));
+  unordered_set<uint64_t> file_ids;
+  file_ids.reserve(block_ids.size());
+  for (const auto& block_id : block_ids) {
+    file_ids.insert(block_id.id());
+  }
+  // Block ids are never reused and blocks are immutable, so the entries
+  // of the blocks which still exist are up to date.
+  cache_->ValidateRestoredEntries([&](const Slice& key) {
+    if (key.size() != sizeof(CacheKey)) {
+      return false;
+    }
+    CacheKey cache_key(FileId(), 0);
+    memcpy(&cache_key, key.data(), sizeof(cache_key));
+    return ContainsKey(file_ids, cache_key.file_id_);
+  });
+  return Status::OK();
+}
+
+Status BlockCache::Persist() {
+  return cache_->Persist();
+}
+
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
   cache_->SetMetrics(metric_entity);
 }
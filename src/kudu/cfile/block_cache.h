@@ -31,7 +31,9 @@
 #include "kudu/gutil/singleton.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/status.h"
 
+DECLARE_string(block_cache_eviction_policy);
 DECLARE_string(block_cache_type);
 
 template <class T> class scoped_refptr;
@@ -40,6 +42,10 @@ namespace kudu {
 
 class MetricEntity;
 
+namespace fs {
+class BlockManager;
+} // namespace fs
+
 namespace cfile {
 
 class BlockCacheHandle;
@@ -52,6 +58,10 @@ class BlockCache {
   // invalid.
   static CacheType GetConfiguredCacheTypeOrDie();
 
+  // Parse the gflag which configures the eviction policy of the block cache.
+  // FATALs if the flag is invalid, or not supported by the cache type.
+  static CacheEvictionPolicy GetConfiguredEvictionPolicyOrDie();
+
   // BlockId refers to the unique identifier for a Kudu block, that is, for an
   // entire CFile. This is different than the block cache's notion of a block,
   // which is just a portion of a CFile.
@@ -164,6 +174,15 @@ class BlockCache {
   // entry in the cache.
   void Insert(PendingEntry* entry, BlockCacheHandle* inserted);
 
+  // Erases the blocks restored by a persistent cache from a previous process
+  // whose file no longer is in 'block_manager'. Must be called once the block
+  // manager is opened, and before any block is read.
+  Status ValidateRestoredBlocks(fs::BlockManager* block_manager);
+
+  // Saves the cached blocks if the cache is persistent, so that the next
+  // process starts with them.
+  Status Persist();
+
  private:
   friend class Singleton<BlockCache>;
   BlockCache();
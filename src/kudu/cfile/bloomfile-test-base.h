@@ -67,14 +67,14 @@ class BloomFileTestBase : public KuduTest {
     }
   }
 
-  void WriteTestBloomFile() {
+  void WriteTestBloomFile(BloomFilterLayout layout = BloomFilterLayout::CLASSIC) {
     std::unique_ptr<fs::WritableBlock> sink;
     ASSERT_OK(fs_manager_->CreateNewBlock({}, &sink));
     block_id_ = sink->id();
 
     // Set sizing based on flags
     BloomFilterSizing sizing = BloomFilterSizing::BySizeAndFPRate(
-      FLAGS_bloom_size_bytes, FLAGS_fp_rate);
+      FLAGS_bloom_size_bytes, FLAGS_fp_rate, layout);
     ASSERT_NEAR(sizing.n_bytes(), FLAGS_bloom_size_bytes, FLAGS_bloom_size_bytes * 0.05);
     ASSERT_GT(FLAGS_n_keys, sizing.expected_count())
       << "Invalid parameters: --n_keys isn't set large enough to fill even "
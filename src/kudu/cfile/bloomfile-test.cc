@@ -15,11 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
 #include <ostream>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -44,6 +46,7 @@ namespace cfile {
 using fs::CountingReadableBlock;
 using fs::ReadableBlock;
 using std::unique_ptr;
+using std::vector;
 
 class BloomFileTest : public BloomFileTestBase {
 
@@ -86,6 +89,49 @@ TEST_F(BloomFileTest, TestWriteAndRead) {
   VerifyBloomFile();
 }
 
+TEST_F(BloomFileTest, TestWriteAndReadSplitBlock) {
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile(BloomFilterLayout::SPLIT_BLOCK));
+  ASSERT_OK(OpenBloomFile());
+  VerifyBloomFile();
+}
+
+// Test that batched probes give the same answers as probing key by key,
+// across a sorted key range that spans many bloom blocks and mixes hits with
+// misses.
+TEST_F(BloomFileTest, TestCheckKeysPresentBatch) {
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+
+  const int kBatchSize = 1000;
+  const uint64_t num_probes = FLAGS_n_keys << kKeyShift;
+  for (uint64_t start = 0; start < num_probes; start += kBatchSize) {
+    uint64_t end = std::min<uint64_t>(start + kBatchSize, num_probes);
+    vector<uint64_t> keys;
+    vector<BloomKeyProbe> probes;
+    for (uint64_t i = start; i < end; i++) {
+      keys.push_back(BigEndian::FromHost64(i));
+    }
+    for (const uint64_t& key : keys) {
+      probes.emplace_back(Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)));
+    }
+    vector<const BloomKeyProbe*> probe_ptrs;
+    for (const auto& probe : probes) {
+      probe_ptrs.push_back(&probe);
+    }
+
+    unique_ptr<bool[]> batch_present(new bool[probes.size()]);
+    ASSERT_OK(bfr_->CheckKeysPresent(probe_ptrs, nullptr, batch_present.get()));
+    for (int i = 0; i < probes.size(); i++) {
+      bool present;
+      ASSERT_OK_FAST(bfr_->CheckKeyPresent(probes[i], nullptr, &present));
+      ASSERT_EQ(present, batch_present[i]) << "probe " << (start + i);
+      if ((start + i) % (1 << kKeyShift) == 0) {
+        ASSERT_TRUE(present) << "inserted key " << (start + i) << " should be present";
+      }
+    }
+  }
+}
+
 #ifdef NDEBUG
 TEST_F(BloomFileTest, Benchmark) {
   ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
@@ -16,6 +16,7 @@
 // under the License.
 #include "kudu/cfile/bloomfile.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <ostream>
 #include <string>
@@ -105,6 +106,9 @@ BloomFileWriter::BloomFileWriter(unique_ptr<WritableBlock> block,
   // bloom filters are high-entropy data structures by their nature.
   opts.storage_attributes.encoding  = PLAIN_ENCODING;
   opts.storage_attributes.compression = NO_COMPRESSION;
+  if (sizing.layout() == BloomFilterLayout::SPLIT_BLOCK) {
+    opts.incompatible_features |= IncompatibleFeatures::SPLIT_BLOCK_BLOOM;
+  }
   writer_.reset(new cfile::CFileWriter(std::move(opts),
                                        GetTypeInfo(BINARY),
                                        false,
@@ -169,6 +173,9 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
   // Encode the header.
   BloomBlockHeaderPB hdr;
   hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  if (bloom_builder_.layout() == BloomFilterLayout::SPLIT_BLOCK) {
+    hdr.set_layout(BLOOM_LAYOUT_SPLIT_BLOCK);
+  }
   faststring hdr_str;
   PutFixed32(&hdr_str, hdr.ByteSize());
   pb_util::AppendToString(hdr, &hdr_str);
@@ -285,6 +292,32 @@ Status BloomFileReader::ParseBlockHeader(const Slice& block,
   return Status::OK();
 }
 
+Status BloomFileReader::ReadBloomBlock(const IOContext* io_context,
+                                       const BlockPointer& ptr,
+                                       BlockHandle* handle,
+                                       BloomFilter* bloom) const {
+  BlockHandle dblk_data;
+  RETURN_NOT_OK(reader_->ReadBlock(io_context, ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+
+  // Parse the header in the block.
+  BloomBlockHeaderPB hdr;
+  Slice bloom_data;
+  RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
+
+  BloomFilterLayout layout = BloomFilterLayout::CLASSIC;
+  if (hdr.layout() == BLOOM_LAYOUT_SPLIT_BLOCK) {
+    if (PREDICT_FALSE(bloom_data.size() % BloomFilter::kSplitBlockBytes != 0)) {
+      return Status::Corruption(
+          StringPrintf("Split-block bloom filter size %ld is not a multiple of %zu",
+                       bloom_data.size(), BloomFilter::kSplitBlockBytes));
+    }
+    layout = BloomFilterLayout::SPLIT_BLOCK;
+  }
+  *bloom = BloomFilter(bloom_data, hdr.num_hash_functions(), layout);
+  *handle = std::move(dblk_data);
+  return Status::OK();
+}
+
 Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
                                         const IOContext* io_context,
                                         bool *maybe_present) {
@@ -321,19 +354,9 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   // block in the BloomFile, we need to read the correct block and re-hydrate the
   // BloomFilter instance.
   if (!bci->cur_block_pointer.Equals(bblk_ptr)) {
-    BlockHandle dblk_data;
-    RETURN_NOT_OK(reader_->ReadBlock(io_context, bblk_ptr,
-                                     CFileReader::CACHE_BLOCK, &dblk_data));
-
-    // Parse the header in the block.
-    BloomBlockHeaderPB hdr;
-    Slice bloom_data;
-    RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
-
-    // Save the data back into our threadlocal cache.
-    bci->cur_bloom = BloomFilter(bloom_data, hdr.num_hash_functions());
+    RETURN_NOT_OK(ReadBloomBlock(io_context, bblk_ptr,
+                                 &bci->cur_block_handle, &bci->cur_bloom));
     bci->cur_block_pointer = bblk_ptr;
-    bci->cur_block_handle = std::move(dblk_data);
   }
 
   // Actually check the bloom filter.
@@ -341,6 +364,75 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   return Status::OK();
 }
 
+Status BloomFileReader::CheckKeysPresent(ArrayView<const BloomKeyProbe* const> probes,
+                                         const IOContext* io_context,
+                                         bool* maybe_present) {
+  DCHECK(init_once_.init_succeeded());
+  const size_t n = probes.size();
+  if (n == 0) return Status::OK();
+
+  // See CheckKeyPresent() for why the state lives in a thread-local cache.
+  auto* tlc = BloomCacheTLC::GetInstance();
+  BloomCacheItem* bci = tlc->Lookup(instance_nonce_);
+  if (!bci) {
+    bci = tlc->EmplaceNew(instance_nonce_, io_context, reader_.get());
+  }
+  DCHECK_EQ(reader_.get(), bci->index_iter.cfile_reader())
+      << "Cached index reader does not match expected instance";
+
+  // First resolve the bloom block for every probe. For sorted probes these
+  // seeks walk forward through the same few index blocks. A probe that sorts
+  // before the first entry in the file is definitely not present; the rest
+  // are marked as maybe present until their bloom block is checked.
+  IndexTreeIterator* index_iter = &bci->index_iter;
+  vector<BlockPointer> block_ptrs(n, BlockPointer(0, 0));
+  for (size_t i = 0; i < n; i++) {
+    Status s = index_iter->SeekAtOrBefore(probes[i]->key());
+    if (PREDICT_FALSE(s.IsNotFound())) {
+      maybe_present[i] = false;
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    block_ptrs[i] = index_iter->GetCurrentBlockPointer();
+    maybe_present[i] = true;
+  }
+
+  // Then test each run of probes which share a bloom block, reading the block
+  // at most once per run.
+  static const size_t kPrefetchDistance = 4;
+  size_t i = 0;
+  while (i < n) {
+    if (!maybe_present[i]) {
+      i++;
+      continue;
+    }
+    const BlockPointer& bblk_ptr = block_ptrs[i];
+    size_t run_end = i + 1;
+    while (run_end < n && maybe_present[run_end] && block_ptrs[run_end].Equals(bblk_ptr)) {
+      run_end++;
+    }
+
+    if (!bci->cur_block_pointer.Equals(bblk_ptr)) {
+      RETURN_NOT_OK(ReadBloomBlock(io_context, bblk_ptr,
+                                   &bci->cur_block_handle, &bci->cur_bloom));
+      bci->cur_block_pointer = bblk_ptr;
+    }
+
+    const BloomFilter& bloom = bci->cur_bloom;
+    for (size_t j = i; j < std::min(run_end, i + kPrefetchDistance); j++) {
+      bloom.PrefetchKey(*probes[j]);
+    }
+    for (size_t j = i; j < run_end; j++) {
+      if (j + kPrefetchDistance < run_end) {
+        bloom.PrefetchKey(*probes[j + kPrefetchDistance]);
+      }
+      maybe_present[j] = bloom.MayContainKey(*probes[j]);
+    }
+    i = run_end;
+  }
+  return Status::OK();
+}
+
 size_t BloomFileReader::memory_footprint_excluding_reader() const {
   return kudu_malloc_usable_size(this) + init_once_.memory_footprint_excluding_this();
 }
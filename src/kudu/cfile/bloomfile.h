@@ -24,6 +24,7 @@
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/array_view.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/mem_tracker.h"
@@ -42,7 +43,9 @@ class WritableBlock;
 
 namespace cfile {
 
+class BlockHandle;
 class BloomBlockHeaderPB;
+class BlockPointer;
 struct ReaderOptions;
 
 class BloomFileWriter {
@@ -117,6 +120,16 @@ class BloomFileReader {
                          const fs::IOContext* io_context,
                          bool* maybe_present);
 
+  // Batched version of CheckKeyPresent(): sets maybe_present[i] for each
+  // probes[i].
+  //
+  // The probes should be sorted by key. Each run of probes falling into the
+  // same bloom block is then tested against that block in one tight loop,
+  // prefetching the bitmap for upcoming probes while testing the current one.
+  Status CheckKeysPresent(ArrayView<const BloomKeyProbe* const> probes,
+                          const fs::IOContext* io_context,
+                          bool* maybe_present);
+
   // Can be called before Init().
   uint64_t FileSize() const {
     return reader_->file_size();
@@ -136,6 +149,13 @@ class BloomFileReader {
                           BloomBlockHeaderPB* hdr,
                           Slice* bloom_data) const;
 
+  // Read the bloom block at 'ptr', returning its handle in *handle and the
+  // BloomFilter backed by it in *bloom.
+  Status ReadBloomBlock(const fs::IOContext* io_context,
+                        const BlockPointer& ptr,
+                        BlockHandle* handle,
+                        BloomFilter* bloom) const;
+
   // Callback used in 'init_once_' to initialize this bloom file.
   Status InitOnce(const fs::IOContext* io_context);
 
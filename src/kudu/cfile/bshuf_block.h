@@ -328,6 +328,18 @@ class BShufBlockDecoder final : public BlockDecoder {
     return CopyNextValuesToArray(n, dst->data());
   }
 
+  // Evaluates the predicate on the decoded values as they are copied out,
+  // without a second pass over the column block.
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) OVERRIDE {
+    ctx->SetDecoderEvalSupported();
+    RETURN_NOT_OK(CopyNextValues(n, dst));
+    ctx->pred()->EvaluateCells(Type, dst->data(), *n, sel);
+    return Status::OK();
+  }
+
   // Copy the codewords to a temporary buffer.
   // This API provides a more convenient way for the dictionary decoder to copy out
   // integer codewords and then look up the strings. If we use the CopyNextValuesToArray()
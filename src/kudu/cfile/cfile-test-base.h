@@ -355,7 +355,8 @@ class CFileTestBase : public KuduTest {
   enum Flags {
     NO_FLAGS = 0,
     WRITE_VALIDX = 1,
-    SMALL_BLOCKSIZE = 1 << 1
+    SMALL_BLOCKSIZE = 1 << 1,
+    WRITE_ZONE_MAP = 1 << 2
   };
 
   template<class DataGeneratorType>
@@ -374,6 +375,9 @@ class CFileTestBase : public KuduTest {
     if (flags & WRITE_VALIDX) {
       opts.write_validx = true;
     }
+    if (flags & WRITE_ZONE_MAP) {
+      opts.write_zone_map = true;
+    }
     if (flags & SMALL_BLOCKSIZE) {
       // Use a smaller block size to exercise multi-level indexing.
       opts.storage_attributes.cfile_block_size = 1024;
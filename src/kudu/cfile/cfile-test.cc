@@ -42,6 +42,7 @@
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/encoded_key.h"
@@ -75,9 +76,12 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/trace.h"
+#include "kudu/util/trace_metrics.h"
 
 DECLARE_bool(cfile_write_checksums);
 DECLARE_bool(cfile_verify_checksums);
+DECLARE_int32(cfile_prefetch_readahead_blocks);
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
@@ -240,6 +244,60 @@ class TestCFile : public CFileTestBase {
     }
   }
 
+  // Scans a file in batches whose selection vectors leave runs of various
+  // lengths unselected, letting the iterator skip them, and verifies the
+  // selected rows.
+  template <class DataGeneratorType>
+  void TestScanSkippingUnselectedRows(DataGeneratorType* generator, EncodingType encoding) {
+    const size_t kNumEntries = 10000;
+    const size_t kBatchSize = 1000;
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE,
+                  &block_id);
+
+    unique_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    unique_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK, nullptr));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(kBatchSize);
+    SelectionVector sel(kBatchSize);
+    size_t read_offset = 0;
+    while (iter->HasNext()) {
+      size_t n = kBatchSize;
+      ASSERT_OK(iter->PrepareBatch(&n));
+      // Select only the first rows of every 500 and every 7th row otherwise,
+      // so that there are both long runs to skip and short ones to decode.
+      sel.SetAllFalse();
+      for (size_t j = 0; j < n; j++) {
+        const size_t row = read_offset + j;
+        if (row % 500 < 20 || row % 7 == 0) {
+          sel.SetRowSelected(j);
+        }
+      }
+      ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+      ctx.SetSkipUnselectedRows();
+      ASSERT_OK(iter->Scan(&ctx));
+      ASSERT_OK(iter->FinishBatch());
+
+      generator->Build(read_offset, n);
+      for (size_t j = 0; j < n; j++) {
+        if (!sel.IsRowSelected(j)) continue;
+        const bool expected_null = generator->TestValueShouldBeNull(read_offset + j);
+        ASSERT_EQ(expected_null, cb.is_null(j)) << "row " << read_offset + j;
+        if (!expected_null) {
+          ASSERT_EQ((*generator)[j], cb[j]) << "row " << read_offset + j;
+        }
+      }
+      cb.arena()->Reset();
+      read_offset += n;
+    }
+    ASSERT_EQ(kNumEntries, read_offset);
+  }
+
   template <class DataGeneratorType>
   void TestNullTypes(DataGeneratorType* generator, EncodingType encoding,
                      CompressionType compression) {
@@ -845,6 +903,7 @@ TEST_P(TestCFileBothCacheTypes, TestAppendRaw) {
   TestReadWriteRawBlocks(SNAPPY, 1000);
   TestReadWriteRawBlocks(LZ4, 1000);
   TestReadWriteRawBlocks(ZLIB, 1000);
+  TestReadWriteRawBlocks(ZSTD, 1000);
 }
 
 TEST_P(TestCFileBothCacheTypes, TestChecksumFlags) {
@@ -1034,6 +1093,214 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   }
 }
 
+// Tests that a sequential scan which prefetches each batch before preparing
+// it prefetches every data block exactly once, and still reads the right data.
+TEST_P(TestCFileBothCacheTypes, TestPrefetchDataBlocks) {
+  const int nrows = 10000;
+  BlockId block_id;
+  UInt32DataGenerator<false> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, nrows,
+                SMALL_BLOCKSIZE, &block_id);
+
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+  int num_data_blocks = 0;
+  {
+    gscoped_ptr<IndexTreeIterator> idx_iter(
+        IndexTreeIterator::Create(nullptr, reader.get(), reader->posidx_root()));
+    ASSERT_OK(idx_iter->SeekToFirst());
+    num_data_blocks++;
+    while (idx_iter->HasNext()) {
+      ASSERT_OK(idx_iter->Next());
+      num_data_blocks++;
+    }
+  }
+  ASSERT_GT(num_data_blocks, 1);
+
+  // Don't cache the blocks, so that none is skipped for being in the cache.
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK, nullptr));
+  ScopedColumnBlock<UINT32> out(nrows);
+  SelectionVector sel(nrows);
+  scoped_refptr<Trace> trace(new Trace);
+  {
+    ADOPT_TRACE(trace.get());
+    ASSERT_OK(iter->SeekToOrdinal(0));
+    size_t fetched = 0;
+    while (iter->HasNext()) {
+      ColumnBlock advancing_block(out.type_info(), nullptr,
+                                  out.data() + (fetched * out.stride()),
+                                  out.nrows() - fetched, out.arena());
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&advancing_block, &sel);
+      size_t n = std::min<size_t>(333, nrows - fetched);
+      ASSERT_OK(iter->Prefetch(iter->GetCurrentOrdinal(), n));
+      ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+      fetched += n;
+    }
+    ASSERT_EQ(nrows, fetched);
+  }
+  ASSERT_EQ(num_data_blocks, trace->metrics().GetMetric("cfile_prefetches"));
+  for (int i = 0; i < nrows; i++) {
+    ASSERT_EQ(generator.BuildTestValue(0, i), out[i]);
+  }
+
+  // Seeking backwards or past the end isn't a problem.
+  ASSERT_OK(iter->SeekToOrdinal(nrows / 2));
+  ASSERT_OK(iter->Prefetch(nrows / 2, 10));
+  ASSERT_OK(iter->Prefetch(nrows - 1, 1000));
+}
+
+// Tests that prefetching a batch also reads ahead the configured number of
+// blocks past it, and that blocks read ahead aren't prefetched again.
+TEST_P(TestCFileBothCacheTypes, TestPrefetchReadahead) {
+  FLAGS_cfile_prefetch_readahead_blocks = 3;
+  BlockId block_id;
+  UInt32DataGenerator<false> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, 10000,
+                SMALL_BLOCKSIZE, &block_id);
+
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::DONT_CACHE_BLOCK, nullptr));
+
+  scoped_refptr<Trace> trace(new Trace);
+  ADOPT_TRACE(trace.get());
+  ASSERT_OK(iter->SeekToOrdinal(0));
+  ASSERT_OK(iter->Prefetch(0, 1));
+  ASSERT_EQ(1 + FLAGS_cfile_prefetch_readahead_blocks,
+            trace->metrics().GetMetric("cfile_prefetches"));
+
+  // The next row is in the same block: the read-ahead window is already full.
+  ASSERT_OK(iter->Prefetch(1, 1));
+  ASSERT_EQ(1 + FLAGS_cfile_prefetch_readahead_blocks,
+            trace->metrics().GetMetric("cfile_prefetches"));
+}
+
+TEST_P(TestCFileBothCacheTypes, TestScanSkippingUnselectedRows) {
+  {
+    UInt32DataGenerator<false> generator;
+    TestScanSkippingUnselectedRows(&generator, PLAIN_ENCODING);
+  }
+  {
+    UInt32DataGenerator<true> generator;
+    TestScanSkippingUnselectedRows(&generator, PLAIN_ENCODING);
+  }
+  {
+    UInt32DataGenerator<true> generator;
+    TestScanSkippingUnselectedRows(&generator, RLE);
+  }
+  {
+    StringDataGenerator<true> generator("hello %zu");
+    TestScanSkippingUnselectedRows(&generator, PREFIX_ENCODING);
+  }
+  {
+    StringDataGenerator<false> generator("hello %zu");
+    TestScanSkippingUnselectedRows(&generator, DICT_ENCODING);
+  }
+}
+
+TEST_P(TestCFileBothCacheTypes, TestZoneMap) {
+  const size_t kNumEntries = 10000;
+  const ColumnSchema col("c", UINT32, /*is_nullable=*/true);
+
+  // The values are the row index * 10, and every data block holds a few
+  // hundred of them.
+  UInt32DataGenerator<false> generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                SMALL_BLOCKSIZE | WRITE_ZONE_MAP, &block_id);
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  unique_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->footer().has_zone_map_block_ptr());
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK, nullptr));
+
+  auto check = [&](const ColumnPredicate& pred, rowid_t ord_idx, size_t* nrows) {
+    bool may_match;
+    CHECK_OK(iter->CheckZoneMap(pred, ord_idx, nrows, &may_match));
+    return may_match;
+  };
+
+  // Only the block holding row 5000 may match an equality predicate on its
+  // value, so the blocks before it are reported as one run.
+  uint32_t value = 50000;
+  const auto eq = ColumnPredicate::Equality(col, &value);
+  size_t nrows = kNumEntries;
+  ASSERT_FALSE(check(eq, 0, &nrows));
+  ASSERT_GT(nrows, 4000);
+  ASSERT_LE(nrows, 5000);
+  const rowid_t match_idx = nrows;
+  nrows = kNumEntries;
+  ASSERT_TRUE(check(eq, match_idx, &nrows));
+  ASSERT_GT(match_idx + nrows, 5000);
+  ASSERT_LT(nrows, 1000);
+  const rowid_t after_idx = match_idx + nrows;
+  nrows = kNumEntries - after_idx;
+  ASSERT_FALSE(check(eq, after_idx, &nrows));
+  ASSERT_EQ(kNumEntries - after_idx, nrows);
+
+  // The run is capped by the number of rows asked about.
+  nrows = 10;
+  ASSERT_FALSE(check(eq, 0, &nrows));
+  ASSERT_EQ(10, nrows);
+
+  // The upper bound of a range is exclusive.
+  uint32_t lower = 25;
+  uint32_t upper = 30;
+  nrows = kNumEntries;
+  ASSERT_TRUE(check(ColumnPredicate::Range(col, &lower, &upper), 0, &nrows));
+  lower = 100000;
+  upper = 200000;
+  nrows = kNumEntries;
+  ASSERT_FALSE(check(ColumnPredicate::Range(col, &lower, &upper), 0, &nrows));
+  ASSERT_EQ(kNumEntries, nrows);
+  nrows = kNumEntries;
+  ASSERT_FALSE(check(ColumnPredicate::Range(col, &lower, nullptr), 0, &nrows));
+  ASSERT_EQ(kNumEntries, nrows);
+  nrows = kNumEntries;
+  ASSERT_TRUE(check(ColumnPredicate::Range(col, nullptr, &upper), 0, &nrows));
+  ASSERT_EQ(kNumEntries, nrows);
+
+  // In-list values between a block's minimum and maximum may match, even if
+  // the block doesn't hold them.
+  uint32_t in_values[] = { 5, 95000, 99995 };
+  vector<const void*> in_list = { &in_values[0], &in_values[1], &in_values[2] };
+  const auto in_pred = ColumnPredicate::InList(col, &in_list);
+  ASSERT_EQ(PredicateType::InList, in_pred.predicate_type());
+  nrows = kNumEntries;
+  ASSERT_TRUE(check(in_pred, 0, &nrows));
+  nrows = kNumEntries;
+  ASSERT_FALSE(check(in_pred, 5000, &nrows));
+
+  // The file has no NULLs.
+  nrows = kNumEntries;
+  ASSERT_FALSE(check(ColumnPredicate::IsNull(col), 0, &nrows));
+  ASSERT_EQ(kNumEntries, nrows);
+  nrows = kNumEntries;
+  ASSERT_TRUE(check(ColumnPredicate::IsNotNull(col), 0, &nrows));
+  ASSERT_EQ(kNumEntries, nrows);
+
+  // Without a zone map, all rows may match.
+  iter.reset();
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                SMALL_BLOCKSIZE, &block_id);
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_FALSE(reader->footer().has_zone_map_block_ptr());
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK, nullptr));
+  nrows = kNumEntries;
+  ASSERT_TRUE(check(eq, 0, &nrows));
+  ASSERT_EQ(kNumEntries, nrows);
+}
+
 #if defined(HAVE_LIB_VMEM)
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
@@ -1048,7 +1315,7 @@ class TestCFileDifferentCodecs : public TestCFile,
 };
 
 INSTANTIATE_TEST_CASE_P(Codecs, TestCFileDifferentCodecs,
-                        ::testing::Values(NO_COMPRESSION, SNAPPY, LZ4, ZLIB));
+                        ::testing::Values(NO_COMPRESSION, SNAPPY, LZ4, ZLIB, ZSTD));
 
 // Read/write a file with uncompressible data (random int32s)
 TEST_P(TestCFileDifferentCodecs, TestUncompressible) {
@@ -36,6 +36,7 @@
 #include "kudu/cfile/cfile_writer.h" // for kMagicString
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/column_materialization_context.h"
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
@@ -78,6 +79,28 @@ DEFINE_bool(cfile_verify_checksums, true,
             "Verify the checksum for each block on read if one exists");
 TAG_FLAG(cfile_verify_checksums, evolving);
 
+DEFINE_bool(cfile_prefetch_data_blocks, true,
+            "Whether to prefetch the data blocks of all the columns of a batch "
+            "of rows before they're read, so that the reads are serviced by "
+            "the disk concurrently rather than one after the other.");
+TAG_FLAG(cfile_prefetch_data_blocks, advanced);
+TAG_FLAG(cfile_prefetch_data_blocks, experimental);
+
+DEFINE_int32(cfile_prefetch_readahead_blocks, 2,
+             "Number of data blocks past the end of a batch to prefetch along "
+             "with the batch's own blocks, so that the reads for the next "
+             "batch are already in flight while the current one is decoded. "
+             "Only takes effect if --cfile_prefetch_data_blocks is set.");
+TAG_FLAG(cfile_prefetch_readahead_blocks, advanced);
+TAG_FLAG(cfile_prefetch_readahead_blocks, experimental);
+
+DEFINE_int32(cfile_late_materialization_min_skip_rows, 32,
+             "Minimum length of a run of rows already filtered out of a scan "
+             "for which a column without a predicate seeks past the rows "
+             "instead of decoding them. Set to 0 to always decode every row.");
+TAG_FLAG(cfile_late_materialization_min_skip_rows, advanced);
+TAG_FLAG(cfile_late_materialization_min_skip_rows, experimental);
+
 DEFINE_double(cfile_inject_corruption, 0,
               "Fraction of the time that read operations on CFiles will fail "
               "with a corruption status");
@@ -568,6 +591,20 @@ Status CFileReader::ReadBlock(const IOContext* io_context, const BlockPointer &p
   return Status::OK();
 }
 
+Status CFileReader::PrefetchBlock(const BlockPointer& ptr) const {
+  DCHECK(init_once_.init_succeeded());
+  BlockCacheHandle bc_handle;
+  BlockCache::CacheKey key(block_->id(), ptr.offset());
+  if (BlockCache::GetSingleton()->Lookup(key, Cache::NO_EXPECT_IN_CACHE, &bc_handle)) {
+    return Status::OK();
+  }
+  TRACE_COUNTER_INCREMENT("cfile_prefetches", 1);
+  RETURN_NOT_OK_PREPEND(block_->Prefetch(ptr.offset(), ptr.size()),
+                        Substitute("failed to prefetch CFile block $0 at $1",
+                                   block_id().ToString(), ptr.ToString()));
+  return Status::OK();
+}
+
 Status CFileReader::CountRows(rowid_t *count) const {
   *count = footer().num_values();
   return Status::OK();
@@ -684,6 +721,11 @@ CFileIterator::CFileIterator(CFileReader* reader,
                              CFileReader::CacheControl cache_control,
                              const IOContext* io_context)
   : reader_(reader),
+    prefetch_block_first_idx_(0),
+    prefetch_block_done_(false),
+    prefetch_next_idx_(0),
+    zone_map_read_(false),
+    zone_map_skipped_upto_(0),
     seeked_(nullptr),
     prepared_(false),
     cache_control_(cache_control),
@@ -997,6 +1039,64 @@ bool CFileIterator::HasNext() const {
   return !prepared_blocks_.empty() || seeked_->HasNext();
 }
 
+Status CFileIterator::CheckZoneMap(const ColumnPredicate& pred,
+                                  rowid_t ord_idx,
+                                  size_t* nrows,
+                                  bool* may_match) {
+  *may_match = true;
+  if (!zone_map_read_) {
+    RETURN_NOT_OK(reader_->Init(io_context_));
+    if (reader_->footer().has_zone_map_block_ptr()) {
+      BlockPointer bp(reader_->footer().zone_map_block_ptr());
+      BlockHandle handle;
+      RETURN_NOT_OK_PREPEND(reader_->ReadBlock(io_context_, bp, cache_control_, &handle),
+                            "couldn't read zone map block");
+      unique_ptr<ZoneMap> zone_map(new ZoneMap());
+      RETURN_NOT_OK_PREPEND(zone_map->Init(reader_->type_info(), handle.data()),
+                            Substitute("couldn't parse zone map in block $0 ($1)",
+                                       reader_->block_id().ToString(),
+                                       bp.ToString()));
+      zone_map_ = std::move(zone_map);
+    }
+    zone_map_read_ = true;
+  }
+  if (!zone_map_) {
+    return Status::OK();
+  }
+
+  int idx = zone_map_->FindEntry(ord_idx);
+  if (idx < 0) {
+    return Status::OK();
+  }
+  *may_match = zone_map_->MayMatch(idx, pred);
+  const rowid_t last_idx = ord_idx + *nrows;
+  rowid_t end_idx = zone_map_->end_ordinal(idx);
+  while (end_idx < last_idx &&
+         ++idx < static_cast<int>(zone_map_->num_entries()) &&
+         zone_map_->first_ordinal(idx) == end_idx &&
+         zone_map_->MayMatch(idx, pred) == *may_match) {
+    end_idx = zone_map_->end_ordinal(idx);
+  }
+  *nrows = std::min(last_idx, end_idx) - ord_idx;
+  return Status::OK();
+}
+
+void CFileIterator::RecordZoneMapSkip(rowid_t ord_idx, size_t nrows) {
+  if (!zone_map_ || nrows == 0) {
+    return;
+  }
+  int first = zone_map_->FindEntry(ord_idx);
+  int last = zone_map_->FindEntry(ord_idx + nrows - 1);
+  if (first < 0 || last < 0) {
+    return;
+  }
+  first = std::max(first, zone_map_skipped_upto_);
+  if (first <= last) {
+    io_stats_.blocks_skipped += last - first + 1;
+    zone_map_skipped_upto_ = last + 1;
+  }
+}
+
 Status CFileIterator::PrepareBatch(size_t *n) {
   CHECK(!prepared_) << "Should call FinishBatch() first";
   CHECK(seeked_ != nullptr) << "must be seeked";
@@ -1048,6 +1148,68 @@ Status CFileIterator::PrepareBatch(size_t *n) {
   return Status::OK();
 }
 
+Status CFileIterator::Prefetch(rowid_t ord_idx, size_t n) {
+  if (!FLAGS_cfile_prefetch_data_blocks || n == 0) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(reader_->Init(io_context_));
+  if (!reader_->footer().has_posidx_info()) {
+    return Status::OK();
+  }
+
+  // The positional index is keyed by the first row of each data block.
+  auto decode_first_idx = [&]() -> Status {
+    Slice key = prefetch_iter_->GetCurrentKey();
+    return KeyEncoderTraits<UINT32, faststring>::DecodeKeyPortion(
+        &key, true, nullptr, reinterpret_cast<uint8_t*>(&prefetch_block_first_idx_));
+  };
+
+  if (!prefetch_iter_ || ord_idx != prefetch_next_idx_) {
+    prefetch_readahead_idxs_.clear();
+    if (!prefetch_iter_) {
+      BlockPointer bp(reader_->footer().posidx_info().root_block());
+      prefetch_iter_.reset(IndexTreeIterator::Create(io_context_, reader_, bp));
+    }
+    faststring enc_idx;
+    KeyEncoderTraits<UINT32, faststring>::Encode(ord_idx, &enc_idx);
+    Status s = prefetch_iter_->SeekAtOrBefore(Slice(enc_idx));
+    if (s.IsNotFound()) {
+      prefetch_iter_.reset();
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+    RETURN_NOT_OK(decode_first_idx());
+    prefetch_block_done_ = false;
+  }
+
+  // Blocks read ahead by earlier calls which are now part of the batch no
+  // longer count towards the read-ahead window.
+  rowid_t last_idx = ord_idx + n - 1;
+  while (!prefetch_readahead_idxs_.empty() &&
+         prefetch_readahead_idxs_.front() <= last_idx) {
+    prefetch_readahead_idxs_.pop_front();
+  }
+  const size_t readahead_blocks = std::max(0, FLAGS_cfile_prefetch_readahead_blocks);
+  while (prefetch_block_first_idx_ <= last_idx ||
+         prefetch_readahead_idxs_.size() < readahead_blocks) {
+    if (!prefetch_block_done_) {
+      RETURN_NOT_OK(reader_->PrefetchBlock(prefetch_iter_->GetCurrentBlockPointer()));
+      prefetch_block_done_ = true;
+      if (prefetch_block_first_idx_ > last_idx) {
+        prefetch_readahead_idxs_.push_back(prefetch_block_first_idx_);
+      }
+    }
+    if (!prefetch_iter_->HasNext()) {
+      break;
+    }
+    RETURN_NOT_OK(prefetch_iter_->Next());
+    RETURN_NOT_OK(decode_first_idx());
+    prefetch_block_done_ = false;
+  }
+  prefetch_next_idx_ = last_idx + 1;
+  return Status::OK();
+}
+
 Status CFileIterator::FinishBatch() {
   CHECK(prepared_) << "no batch prepared";
   prepared_ = false;
@@ -1114,6 +1276,13 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       }
     }
   }
+
+  // Rows already filtered out by predicates on other columns don't need to be
+  // decoded if the caller allows it. Long enough runs of such rows are seeked
+  // past instead.
+  const size_t min_skip_rows = std::max(0, FLAGS_cfile_late_materialization_min_skip_rows);
+  const bool can_skip = min_skip_rows > 0 && ctx->skip_unselected_rows();
+
   for (PreparedBlock *pb : prepared_blocks_) {
     if (pb->needs_rewind_) {
       // Seek back to the saved position.
@@ -1122,80 +1291,37 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
-    if (reader_->is_nullable()) {
-      DCHECK(ctx->block()->is_nullable());
-
-      size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
-      // Fill column bitmap
-      size_t count = nrows;
-      while (count > 0) {
-        bool not_null = false;
-        size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
-        DCHECK_LE(nblock, count);
-        if (PREDICT_FALSE(nblock == 0)) {
-          return Status::Corruption(
-            Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
-                       count));
+
+    size_t nrows = std::min<size_t>(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+    while (nrows > 0) {
+      size_t this_run = nrows;
+      if (can_skip) {
+        size_t nskip = remaining_sel.CountRun(0, nrows, false);
+        if (nskip >= min_skip_rows || nskip == nrows) {
+          SkipRowsInBlock(pb, nskip, ctx, &remaining_sel, &remaining_dst);
+          rem -= nskip;
+          nrows -= nskip;
+          continue;
         }
-        size_t this_batch = nblock;
-        if (not_null) {
-          if (ctx->DecoderEvalNotDisabled()) {
-            RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch,
-                                                     ctx,
-                                                     &remaining_sel,
-                                                     &remaining_dst));
-          } else {
-            RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-          }
-          DCHECK_EQ(nblock, this_batch);
-          pb->needs_rewind_ = true;
-        } else {
-#ifndef NDEBUG
-          kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
-                                     remaining_dst.stride() * nblock,
-                                     "NULLNULLNULLNULLNULL");
-#endif
-          if (ctx->DecoderEvalNotDisabled() && !ctx->EvaluatingIsNull()) {
-            remaining_sel.ClearBits(this_batch);
-          }
+        // Decode up to the next run of unselected rows that is worth skipping.
+        this_run = nskip;
+        while (this_run < nrows) {
+          this_run += remaining_sel.CountRun(this_run, nrows - this_run, true);
+          if (this_run == nrows) break;
+          nskip = remaining_sel.CountRun(this_run, nrows - this_run, false);
+          if (nskip >= min_skip_rows) break;
+          this_run += nskip;
         }
-
-        // Set the ColumnBlock bitmap
-        remaining_dst.SetNullBits(this_batch, not_null);
-
-        rem -= this_batch;
-        count -= this_batch;
-        pb->idx_in_block_ += this_batch;
-        remaining_dst.Advance(this_batch);
-        remaining_sel.Advance(this_batch);
-      }
-    } else {
-      // Fetch as many as we can from the current datablock.
-      size_t this_batch = rem;
-
-      if (ctx->DecoderEvalNotDisabled()) {
-        RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, &remaining_sel, &remaining_dst));
-      } else {
-        RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-      }
-      pb->needs_rewind_ = true;
-      DCHECK_LE(this_batch, rem);
-
-      // If the column is nullable, set all bits to true
-      if (ctx->block()->is_nullable()) {
-        remaining_dst.SetNullBits(this_batch, true);
       }
-
-      rem -= this_batch;
-      pb->idx_in_block_ += this_batch;
-      remaining_dst.Advance(this_batch);
-      remaining_sel.Advance(this_batch);
+      RETURN_NOT_OK(DecodeRowsInBlock(pb, this_run, ctx, &remaining_sel, &remaining_dst));
+      rem -= this_run;
+      nrows -= this_run;
     }
 
     // If we didn't fetch as many as requested, then it should
     // be because the current data block ran out.
     if (rem > 0) {
-      DCHECK_EQ(pb->dblk_->Count(), pb->dblk_->GetCurrentIndex()) <<
+      DCHECK_EQ(pb->num_rows_in_block_, pb->idx_in_block_) <<
         "dblk stopped yielding values before it was empty.";
     } else {
       break;
@@ -1206,6 +1332,112 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
   return Status::OK();
 }
 
+Status CFileIterator::DecodeRowsInBlock(PreparedBlock* pb,
+                                        size_t nrows,
+                                        ColumnMaterializationContext* ctx,
+                                        SelectionVectorView* remaining_sel,
+                                        ColumnDataView* remaining_dst) {
+  if (reader_->is_nullable()) {
+    DCHECK(ctx->block()->is_nullable());
+
+    // Fill column bitmap
+    size_t count = nrows;
+    while (count > 0) {
+      bool not_null = false;
+      size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
+      DCHECK_LE(nblock, count);
+      if (PREDICT_FALSE(nblock == 0)) {
+        return Status::Corruption(
+          Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
+                     count));
+      }
+      size_t this_batch = nblock;
+      if (not_null) {
+        if (ctx->DecoderEvalNotDisabled()) {
+          RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch,
+                                                   ctx,
+                                                   remaining_sel,
+                                                   remaining_dst));
+        } else {
+          RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, remaining_dst));
+        }
+        DCHECK_EQ(nblock, this_batch);
+        pb->needs_rewind_ = true;
+      } else {
+#ifndef NDEBUG
+        kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst->data()),
+                                   remaining_dst->stride() * nblock,
+                                   "NULLNULLNULLNULLNULL");
+#endif
+        if (ctx->DecoderEvalNotDisabled() && !ctx->EvaluatingIsNull()) {
+          remaining_sel->ClearBits(this_batch);
+        }
+      }
+
+      // Set the ColumnBlock bitmap
+      remaining_dst->SetNullBits(this_batch, not_null);
+
+      count -= this_batch;
+      pb->idx_in_block_ += this_batch;
+      remaining_dst->Advance(this_batch);
+      remaining_sel->Advance(this_batch);
+    }
+  } else {
+    size_t this_batch = nrows;
+    if (ctx->DecoderEvalNotDisabled()) {
+      RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, remaining_sel, remaining_dst));
+    } else {
+      RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, remaining_dst));
+    }
+    pb->needs_rewind_ = true;
+    if (PREDICT_FALSE(this_batch != nrows)) {
+      return Status::Corruption(
+          Substitute("Unexpected EOF in data block. Expected $0 more rows but got $1",
+                     nrows, this_batch));
+    }
+
+    // If the column is nullable, set all bits to true
+    if (ctx->block()->is_nullable()) {
+      remaining_dst->SetNullBits(this_batch, true);
+    }
+
+    pb->idx_in_block_ += this_batch;
+    remaining_dst->Advance(this_batch);
+    remaining_sel->Advance(this_batch);
+  }
+  return Status::OK();
+}
+
+void CFileIterator::SkipRowsInBlock(PreparedBlock* pb,
+                                    size_t nrows,
+                                    ColumnMaterializationContext* ctx,
+                                    SelectionVectorView* remaining_sel,
+                                    ColumnDataView* remaining_dst) {
+  const uint32_t target_idx = pb->idx_in_block_ + nrows;
+  DCHECK_LE(target_idx, pb->num_rows_in_block_);
+  if (target_idx < pb->num_rows_in_block_) {
+    SeekToPositionInBlock(pb, target_idx);
+  } else {
+    // Not every decoder supports seeking to the end of its block. Nothing is
+    // read from the block past this point before it is rewound anyway.
+    pb->idx_in_block_ = target_idx;
+  }
+  pb->needs_rewind_ = true;
+
+  // The skipped cells are never read, since their rows are not selected.
+  // Mark them NULL where possible so that they are at least well-defined.
+#ifndef NDEBUG
+  kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst->data()),
+                             remaining_dst->stride() * nrows,
+                             "SKIPSKIPSKIPSKIPSKIP");
+#endif
+  if (ctx->block()->is_nullable()) {
+    remaining_dst->SetNullBits(nrows, false);
+  }
+  remaining_dst->Advance(nrows);
+  remaining_sel->Advance(nrows);
+}
+
 Status CFileIterator::CopyNextValues(size_t* n, ColumnMaterializationContext* ctx) {
   RETURN_NOT_OK(PrepareBatch(n));
   RETURN_NOT_OK(Scan(ctx));
@@ -20,6 +20,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -49,10 +50,13 @@
 
 namespace kudu {
 
+class ColumnDataView;
 class ColumnMaterializationContext;
+class ColumnPredicate;
 class CompressionCodec;
 class EncodedKey;
 class SelectionVector;
+class SelectionVectorView;
 class TypeInfo;
 
 namespace fs {
@@ -67,6 +71,7 @@ class BinaryPlainBlockDecoder;
 class CFileIterator;
 class IndexTreeIterator;
 class TypeEncodingInfo;
+class ZoneMap;
 struct ReaderOptions;
 
 class CFileReader {
@@ -118,6 +123,11 @@ class CFileReader {
   Status ReadBlock(const fs::IOContext* io_context, const BlockPointer& ptr,
                    CacheControl cache_control, BlockHandle* ret) const;
 
+  // Starts reading the data block pointed to by `ptr` from the filesystem
+  // block in the background, unless it's in the block cache already. See
+  // fs::ReadableBlock::Prefetch().
+  Status PrefetchBlock(const BlockPointer& ptr) const;
+
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
   // the data)
@@ -271,6 +281,12 @@ class ColumnIterator {
   // ever result in a "short read".
   virtual Status PrepareBatch(size_t *n) = 0;
 
+  // Hints that the 'n' rows starting at 'ord_idx' will be prepared soon.
+  // Iterators backed by a file may start reading the data covering them in
+  // the background, so that the reads of all the columns of a batch are in
+  // flight at once rather than issued one after the other.
+  virtual Status Prefetch(rowid_t ord_idx, size_t n) = 0;
+
   // Copy values into the prepared column block.
   // Any indirected values (eg strings) are copied into the ctx's block's
   // arena.
@@ -285,6 +301,20 @@ class ColumnIterator {
   // batch left off.
   virtual Status FinishBatch() = 0;
 
+  // Uses the per-block statistics of the column, if it has any, to find
+  // whether the rows starting at 'ord_idx' may satisfy 'pred'. Sets
+  // '*may_match' to the answer, and '*nrows' to the number of rows, no more
+  // than its value on input, for which it holds. Without statistics,
+  // '*may_match' is set to true and '*nrows' is left unchanged.
+  virtual Status CheckZoneMap(const ColumnPredicate& pred,
+                              rowid_t ord_idx,
+                              size_t* nrows,
+                              bool* may_match) = 0;
+
+  // Records in the IO statistics that the 'nrows' rows starting at 'ord_idx'
+  // were skipped because CheckZoneMap() found that they couldn't match.
+  virtual void RecordZoneMapSkip(rowid_t ord_idx, size_t nrows) = 0;
+
   virtual const IteratorStats& io_statistics() const = 0;
 };
 
@@ -308,9 +338,19 @@ class DefaultColumnValueIterator : public ColumnIterator {
   rowid_t GetCurrentOrdinal() const OVERRIDE { return ordinal_; }
 
   Status PrepareBatch(size_t* n) OVERRIDE;
+  Status Prefetch(rowid_t /*ord_idx*/, size_t /*n*/) OVERRIDE { return Status::OK(); }
   Status Scan(ColumnMaterializationContext* ctx) override;
   Status FinishBatch() OVERRIDE;
 
+  Status CheckZoneMap(const ColumnPredicate& /*pred*/,
+                      rowid_t /*ord_idx*/,
+                      size_t* /*nrows*/,
+                      bool* may_match) override {
+    *may_match = true;
+    return Status::OK();
+  }
+  void RecordZoneMapSkip(rowid_t /*ord_idx*/, size_t /*nrows*/) override {}
+
   const IteratorStats& io_statistics() const OVERRIDE { return io_stats_; }
 
  private:
@@ -377,6 +417,15 @@ class CFileIterator : public ColumnIterator {
   // ever result in a "short read".
   Status PrepareBatch(size_t *n) OVERRIDE;
 
+  // Prefetches the data blocks covering the 'n' rows starting at 'ord_idx'
+  // which aren't in the block cache, walking a separate positional index
+  // iterator ahead of the one used for reading. Also keeps up to
+  // --cfile_prefetch_readahead_blocks blocks past the range prefetched, so
+  // sequential batches find their blocks already being read. Does nothing
+  // unless --cfile_prefetch_data_blocks is set and the file has a positional
+  // index.
+  Status Prefetch(rowid_t ord_idx, size_t n) OVERRIDE;
+
   // Copy values into the prepared column block.
   // Any indirected values (eg strings) are copied into the dst block's
   // arena.
@@ -392,6 +441,16 @@ class CFileIterator : public ColumnIterator {
   // Return true if the next call to PrepareBatch will return at least one row.
   bool HasNext() const;
 
+  // Consults the file's zone map, which is read on first use. Runs of
+  // consecutive blocks with the same answer are reported together.
+  Status CheckZoneMap(const ColumnPredicate& pred,
+                      rowid_t ord_idx,
+                      size_t* nrows,
+                      bool* may_match) override;
+
+  // Counts each skipped block once in io_statistics().blocks_skipped.
+  void RecordZoneMapSkip(rowid_t ord_idx, size_t nrows) override;
+
   // Convenience method to prepare a batch, scan it, and finish it.
   Status CopyNextValues(size_t* n, ColumnMaterializationContext* ctx);
 
@@ -457,6 +516,24 @@ class CFileIterator : public ColumnIterator {
   // Seek the given PreparedBlock to the given index within it.
   void SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block);
 
+  // Decode the next 'nrows' rows of the given PreparedBlock into
+  // 'remaining_dst', evaluating the context's predicate at the decoder level
+  // if possible. Advances the views past the decoded rows.
+  Status DecodeRowsInBlock(PreparedBlock* pb,
+                           size_t nrows,
+                           ColumnMaterializationContext* ctx,
+                           SelectionVectorView* remaining_sel,
+                           ColumnDataView* remaining_dst);
+
+  // Seek the given PreparedBlock past its next 'nrows' rows without decoding
+  // them, and advance the views past the skipped rows. Only for rows which
+  // are not selected in 'remaining_sel'.
+  void SkipRowsInBlock(PreparedBlock* pb,
+                       size_t nrows,
+                       ColumnMaterializationContext* ctx,
+                       SelectionVectorView* remaining_sel,
+                       ColumnDataView* remaining_dst);
+
   // Read the data block currently pointed to by idx_iter_
   // into the given PreparedBlock structure.
   //
@@ -477,6 +554,20 @@ class CFileIterator : public ColumnIterator {
   gscoped_ptr<IndexTreeIterator> posidx_iter_;
   gscoped_ptr<IndexTreeIterator> validx_iter_;
 
+  // Positional index iterator used by Prefetch(), seeked to the data block
+  // whose first row is 'prefetch_block_first_idx_'. 'prefetch_block_done_'
+  // is true if that block has been prefetched already. 'prefetch_next_idx_'
+  // is the row following the range of the last Prefetch() call; a call for
+  // any other row seeks the iterator anew.
+  gscoped_ptr<IndexTreeIterator> prefetch_iter_;
+  rowid_t prefetch_block_first_idx_;
+  bool prefetch_block_done_;
+  rowid_t prefetch_next_idx_;
+
+  // First rows of the blocks prefetched past the range of the last Prefetch()
+  // call, i.e. the blocks currently read ahead.
+  std::deque<rowid_t> prefetch_readahead_idxs_;
+
   // Decoder for the dictionary block.
   gscoped_ptr<BinaryPlainBlockDecoder> dict_decoder_;
   BlockHandle dict_block_handle_;
@@ -484,6 +575,15 @@ class CFileIterator : public ColumnIterator {
   // Set containing the codewords that match the predicate in a dictionary.
   std::unique_ptr<SelectionVector> codewords_matching_pred_;
 
+  // The file's zone map, if it has one and it's been read. 'zone_map_read_'
+  // is true once the footer has been checked for it.
+  std::unique_ptr<ZoneMap> zone_map_;
+  bool zone_map_read_;
+
+  // Index of the first zone map entry whose block hasn't been counted as
+  // skipped yet.
+  int zone_map_skipped_upto_;
+
   // The currently in-use index iterator. This is equal to either
   // posidx_iter_.get(), validx_iter_.get(), or NULL if not seeked.
   IndexTreeIterator *seeked_;
@@ -47,7 +47,9 @@ WriterOptions::WriterOptions()
     write_posidx(false),
     write_validx(false),
     optimize_index_keys(true),
-    validx_key_encoder(boost::none) {
+    validx_key_encoder(boost::none),
+    incompatible_features(IncompatibleFeatures::NONE),
+    write_zone_map(false) {
 }
 
 Status DumpIterator(const CFileReader& reader,
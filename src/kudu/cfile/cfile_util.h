@@ -49,7 +49,10 @@ enum IncompatibleFeatures {
   // Write a crc32 checksum at the end of each cfile block
   CHECKSUM = 1 << 0,
 
-  SUPPORTED = NONE | CHECKSUM
+  // Bloom file blocks may use the split-block bloom filter layout
+  SPLIT_BLOCK_BLOOM = 1 << 1,
+
+  SUPPORTED = NONE | CHECKSUM | SPLIT_BLOCK_BLOOM
 };
 
 typedef std::function<void(const void*, faststring*)> ValidxKeyEncoder;
@@ -89,6 +92,19 @@ struct WriterOptions {
   // encodes the entire value.
   boost::optional<ValidxKeyEncoder> validx_key_encoder;
 
+  // IncompatibleFeatures used by the blocks appended to the file, in addition
+  // to those determined by the writer itself.
+  //
+  // Default: NONE
+  uint32_t incompatible_features;
+
+  // Whether to record the statistics of each data block in a zone map. Only
+  // takes effect for types which support zone maps, and files with a
+  // positional index.
+  //
+  // Default: false
+  bool write_zone_map;
+
   WriterOptions();
 };
 
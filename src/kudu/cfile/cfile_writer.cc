@@ -33,6 +33,7 @@
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/common/schema.h"
@@ -141,6 +142,11 @@ CFileWriter::CFileWriter(WriterOptions options,
 
     validx_builder_.reset(new IndexTreeBuilder(&options_, this));
   }
+
+  if (options_.write_zone_map && options_.write_posidx &&
+      ZoneMapBuilder::SupportsType(typeinfo_)) {
+    zone_map_builder_.reset(new ZoneMapBuilder(typeinfo_));
+  }
 }
 
 CFileWriter::~CFileWriter() {
@@ -215,7 +221,7 @@ Status CFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transaction)
 
   state_ = kWriterFinished;
 
-  uint32_t incompatible_features = 0;
+  uint32_t incompatible_features = options_.incompatible_features;
   if (FLAGS_cfile_write_checksums) {
     incompatible_features |= IncompatibleFeatures::CHECKSUM;
   }
@@ -243,6 +249,15 @@ Status CFileWriter::FinishAndReleaseBlock(BlockCreationTransaction* transaction)
     footer.mutable_validx_info()->CopyFrom(validx_info);
   }
 
+  if (zone_map_builder_) {
+    faststring zone_map_str;
+    pb_util::SerializeToString(zone_map_builder_->zone_map(), &zone_map_str);
+    BlockPointer zone_map_ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ Slice(zone_map_str) }, &zone_map_ptr, "zone map"),
+                          "Couldn't write zone map");
+    zone_map_ptr.CopyToPB(footer.mutable_zone_map_block_ptr());
+  }
+
   // Optionally append extra information to the end of cfile.
   // Example: dictionary block for dictionary encoding
   RETURN_NOT_OK(data_block_->AppendExtraInfo(this, &footer));
@@ -310,6 +325,9 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   while (rem > 0) {
     int n = data_block_->Add(ptr, rem);
     DCHECK_GE(n, 0);
+    if (zone_map_builder_) {
+      zone_map_builder_->AddValues(ptr, n);
+    }
 
     ptr += typeinfo_->size() * n;
     rem -= n;
@@ -340,6 +358,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       do {
         int n = data_block_->Add(ptr, rem);
         DCHECK_GE(n, 0);
+        if (zone_map_builder_) {
+          zone_map_builder_->AddValues(ptr, n);
+        }
 
         null_bitmap_builder_->AddRun(true, n);
         ptr += n * typeinfo_->size();
@@ -353,6 +374,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      if (zone_map_builder_) {
+        zone_map_builder_->AddNulls(nblock);
+      }
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -407,6 +431,9 @@ Status CFileWriter::FinishCurDataBlock() {
   if (is_nullable_) {
     null_bitmap_builder_->Reset();
   }
+  if (zone_map_builder_) {
+    zone_map_builder_->FinishBlock(first_elem_ord, num_elems_in_block);
+  }
 
   if (validx_builder_ != nullptr) {
     RETURN_NOT_OK(data_block_->GetLastKey(key_tmp_space));
@@ -59,6 +59,7 @@ class CompressedBlockBuilder;
 class FileMetadataPairPB;
 class IndexTreeBuilder;
 class TypeEncodingInfo;
+class ZoneMapBuilder;
 
 // Magic used in header/footer
 extern const char kMagicStringV1[];
@@ -238,6 +239,7 @@ class CFileWriter {
   gscoped_ptr<IndexTreeBuilder> validx_builder_;
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
+  std::unique_ptr<ZoneMapBuilder> zone_map_builder_;
 
   enum State {
     kWriterInitialized,
@@ -32,11 +32,13 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/cfile/binary_front_coded_block.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/binary_prefix_block.h"
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/bshuf_block.h"
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/for_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
@@ -182,12 +184,12 @@ class TestEncoding : public KuduTest {
   void TestStringSeekByValueLargeBlock() {
     Arena arena(1024); // TODO(todd): move to fixture?
     gscoped_ptr<WriterOptions> opts(NewWriterOptions());
-    BinaryPrefixBlockBuilder sbb(opts.get());
+    BuilderType sbb(opts.get());
     const uint kCount = 1000;
     // Insert 'hello 000' through 'hello 999'
     Slice s = CreateBinaryBlock(
         &sbb, kCount, std::bind(StringPrintf, "hello %03d", std::placeholders::_1));
-    BinaryPrefixBlockDecoder sbd(s);
+    DecoderType sbd(s);
     ASSERT_OK(sbd.ParseHeader());
 
     // Seeking to just after a key should return the
@@ -775,6 +777,43 @@ TEST_F(TestEncoding, TestRleIntBlockEncoder) {
   ASSERT_EQ(14UL, s.size());
 }
 
+// Monotonically increasing timestamps with small, jittered gaps should pack
+// into a few bits per value.
+TEST_F(TestEncoding, TestForIntBlockEncoder) {
+  const int kNumInts = 10000;
+  unique_ptr<WriterOptions> opts(NewWriterOptions());
+  ForBlockBuilder<INT64> fbb(opts.get());
+  vector<int64_t> timestamps(kNumInts);
+  int64_t ts = 1500000000000000L;
+  for (int i = 0; i < kNumInts; i++) {
+    ts += 1000 + random() % 16;
+    timestamps[i] = ts;
+  }
+  ASSERT_EQ(kNumInts, fbb.Add(reinterpret_cast<const uint8_t*>(timestamps.data()), kNumInts));
+  Slice s = fbb.Finish(12345);
+  LOG(INFO) << "FOR encoded size for 10k timestamps: " << s.size();
+  // Four bits per value, plus the per-miniblock overhead.
+  ASSERT_LT(s.size(), kNumInts);
+
+  ForBlockDecoder<INT64> fbd(s);
+  ASSERT_OK(fbd.ParseHeader());
+  ASSERT_EQ(kNumInts, fbd.Count());
+  ASSERT_EQ(12345, fbd.GetFirstRowId());
+
+  // Seek into the middle of a miniblock and read across miniblock boundaries.
+  vector<int64_t> decoded(kNumInts);
+  ColumnBlock cb(GetTypeInfo(INT64), nullptr, decoded.data(), kNumInts, nullptr);
+  ColumnDataView cdv(&cb);
+  fbd.SeekToPositionInBlock(1000);
+  size_t n = kNumInts;
+  ASSERT_OK(fbd.CopyNextValues(&n, &cdv));
+  ASSERT_EQ(kNumInts - 1000, n);
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQ(timestamps[1000 + i], decoded[i]) << "at index " << i;
+  }
+  ASSERT_FALSE(fbd.HasNext());
+}
+
 TEST_F(TestEncoding, TestPlainBitMapRoundTrip) {
   TestBoolBlockRoundTrip<PlainBitMapBlockBuilder, PlainBitMapBlockDecoder>();
 }
@@ -794,6 +833,10 @@ TEST_F(TestEncoding, TestBinaryPlainBlockBuilderSeekByValueSmallBlock) {
   TestBinarySeekByValueSmallBlock<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestBinaryFrontCodedBlockBuilderSeekByValueSmallBlock) {
+  TestBinarySeekByValueSmallBlock<BinaryFrontCodedBlockBuilder, BinaryFrontCodedBlockDecoder>();
+}
+
 // Test seeking to a value in a large block which contains
 // many 'restarts'
 TEST_F(TestEncoding, TestBinaryPrefixBlockBuilderSeekByValueLargeBlock) {
@@ -804,6 +847,10 @@ TEST_F(TestEncoding, TestBinaryPlainBlockBuilderSeekByValueLargeBlock) {
   TestStringSeekByValueLargeBlock<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestBinaryFrontCodedBlockBuilderSeekByValueLargeBlock) {
+  TestStringSeekByValueLargeBlock<BinaryFrontCodedBlockBuilder, BinaryFrontCodedBlockDecoder>();
+}
+
 // Test round-trip encode/decode of a binary block.
 TEST_F(TestEncoding, TestBinaryPrefixBlockBuilderRoundTrip) {
   TestBinaryBlockRoundTrip<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
@@ -813,6 +860,54 @@ TEST_F(TestEncoding, TestBinaryPlainBlockBuilderRoundTrip) {
   TestBinaryBlockRoundTrip<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestBinaryFrontCodedBlockBuilderRoundTrip) {
+  TestBinaryBlockRoundTrip<BinaryFrontCodedBlockBuilder, BinaryFrontCodedBlockDecoder>();
+}
+
+// Keys with a long common prefix should be stored once per group, and read
+// back whole from any position.
+TEST_F(TestEncoding, TestBinaryFrontCodedBlockSharesPrefixes) {
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  const uint kCount = 1000;
+  const auto& GenKey = [](int i) {
+    return StringPrintf("tenant-0042/user-%08d", i * 7);
+  };
+  BinaryFrontCodedBlockBuilder fbb(opts.get());
+  Slice s = CreateBinaryBlock(&fbb, kCount, GenKey);
+  BinaryPlainBlockBuilder pbb(opts.get());
+  Slice plain = CreateBinaryBlock(&pbb, kCount, GenKey);
+  LOG(INFO) << "Front-coded size: " << s.size() << ", plain size: " << plain.size();
+  ASSERT_LT(s.size(), plain.size());
+
+  BinaryFrontCodedBlockDecoder fbd(s);
+  ASSERT_OK(fbd.ParseHeader());
+  ASSERT_EQ(kCount, fbd.Count());
+
+  // Read from the middle of a group to the end of the block in one go.
+  ScopedColumnBlock<STRING> cb(kCount);
+  ColumnDataView cdv(&cb);
+  fbd.SeekToPositionInBlock(21);
+  size_t n = kCount;
+  ASSERT_OK(fbd.CopyNextValues(&n, &cdv));
+  ASSERT_EQ(kCount - 21, n);
+  for (uint i = 0; i < n; i++) {
+    ASSERT_EQ(GenKey(21 + i), cb[i].ToString());
+  }
+
+  // A key between two entries seeks to the next one.
+  string target = GenKey(500) + "x";
+  Slice q(target);
+  bool exact;
+  ASSERT_OK(fbd.SeekAtOrAfterValue(&q, &exact));
+  ASSERT_FALSE(exact);
+  ASSERT_EQ(501u, fbd.GetCurrentIndex());
+  // A key sharing less than a group's prefix still compares correctly.
+  q = "tenant-0042/user-";
+  ASSERT_OK(fbd.SeekAtOrAfterValue(&q, &exact));
+  ASSERT_FALSE(exact);
+  ASSERT_EQ(0, fbd.GetCurrentIndex());
+}
+
 // Test empty block encode/decode
 TEST_F(TestEncoding, TestBinaryPlainEmptyBlockEncodeDecode) {
   TestEmptyBlockEncodeDecode<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
@@ -822,6 +917,10 @@ TEST_F(TestEncoding, TestBinaryPrefixEmptyBlockEncodeDecode) {
   TestEmptyBlockEncodeDecode<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestBinaryFrontCodedEmptyBlockEncodeDecode) {
+  TestEmptyBlockEncodeDecode<BinaryFrontCodedBlockBuilder, BinaryFrontCodedBlockDecoder>();
+}
+
 // Test encode/decode of a binary block with various-sized truncations.
 TEST_F(TestEncoding, TestBinaryPlainBlockBuilderTruncation) {
   TestBinaryBlockTruncation<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
@@ -831,6 +930,10 @@ TEST_F(TestEncoding, TestBinaryPrefixBlockBuilderTruncation) {
   TestBinaryBlockTruncation<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestBinaryFrontCodedBlockBuilderTruncation) {
+  TestBinaryBlockTruncation<BinaryFrontCodedBlockBuilder, BinaryFrontCodedBlockDecoder>();
+}
+
 // We have several different encodings for INT blocks.
 // The following tests use GTest's TypedTest functionality to run the tests
 // for each of the encodings.
@@ -859,7 +962,16 @@ struct BitshuffleTestTraits {
     typedef BShufBlockDecoder<type> decoder_type;
   };
 };
-typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits> MyTestFixtures;
+
+struct ForTestTraits {
+  template<DataType type>
+  struct Classes {
+    typedef ForBlockBuilder<type> encoder_type;
+    typedef ForBlockDecoder<type> decoder_type;
+  };
+};
+typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits,
+                       ForTestTraits> MyTestFixtures;
 TYPED_TEST_CASE(IntEncodingTest, MyTestFixtures);
 
 template<class TestTraits>
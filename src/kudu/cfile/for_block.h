@@ -0,0 +1,507 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Delta + frame-of-reference + bit-packing encoding for the integer types
+// UINT8, INT8, UINT16, INT16, UINT32, INT32, UINT64 and INT64.
+//
+// This targets columns such as monotonically increasing IDs and timestamps,
+// whose consecutive values differ by small amounts.
+#ifndef KUDU_CFILE_FOR_BLOCK_H
+#define KUDU_CFILE_FOR_BLOCK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowid.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace cfile {
+
+// The values of a block are split into miniblocks of kForMiniBlockSize
+// values. Within a miniblock, each value but the first is stored as its
+// difference from the previous value, minus the smallest such difference in
+// the miniblock (the frame of reference), bit-packed to the width of the
+// largest result. Differences are computed with wrap-around, so decreasing
+// and unsorted values are supported too, only packing less tightly.
+//
+// Every miniblock is decoded independently of the others, so seeking within
+// a block only requires decoding the miniblock that is seeked into.
+//
+// The block format is as follows:
+//
+// 1. Header: (8 bytes total)
+//
+//    <num_elements> [32-bit]
+//      The number of elements encoded in the block.
+//
+//    <first_ordinal> [32-bit]
+//      The ordinal offset of the first element in the block.
+//
+// 2. Miniblock descriptors, one per miniblock:
+//
+//    <first_value> [sizeof(CppType)]
+//      The first value of the miniblock.
+//
+//    <min_delta> [sizeof(CppType)]
+//      The smallest difference between consecutive values of the miniblock.
+//
+//    <bit_width> [8-bit]
+//      The width of each packed value of the miniblock.
+//
+// 3. Packed data, one run per miniblock:
+//
+//    kForMiniBlockSize values of <bit_width> bits each, least significant
+//    bit first, so 16 * <bit_width> bytes. The first value of each run is
+//    always zero, as are the values past the end of the block in the last
+//    run.
+//
+// 4. Padding: (8 bytes total)
+//
+//    Zeros, so that the decoder may always load 64 bits at once.
+enum {
+  kForBlockHeaderSize = 8,
+  kForBlockPaddingSize = 8,
+  kForMiniBlockSize = 128
+};
+
+namespace for_internal {
+
+// Bit-pack the low 'width' bits of each of the kForMiniBlockSize values in
+// 'vals', appending them to 'out'.
+inline void PackMiniBlock(const uint64_t* vals, int width, faststring* out) {
+  if (width == 0) {
+    return;
+  }
+  uint64_t acc = 0;
+  int acc_bits = 0;
+  for (int i = 0; i < kForMiniBlockSize; i++) {
+    const uint64_t v = vals[i];
+    acc |= v << acc_bits;
+    acc_bits += width;
+    if (acc_bits >= 64) {
+      uint8_t buf[8];
+      InlineEncodeFixed64(buf, acc);
+      out->append(buf, sizeof(buf));
+      acc_bits -= 64;
+      // Keep the bits of 'v' which didn't fit.
+      acc = acc_bits == 0 ? 0 : v >> (width - acc_bits);
+    }
+  }
+  // kForMiniBlockSize * width bits are always a multiple of 64.
+  DCHECK_EQ(0, acc_bits);
+}
+
+// Unpack kForMiniBlockSize values of 'width' bits each from 'src'.
+//
+// Loads 64 bits at a time, so up to 8 bytes past the end of the packed data
+// may be read.
+inline void UnpackMiniBlock(const uint8_t* src, int width, uint64_t* vals) {
+  if (width == 0) {
+    memset(vals, 0, kForMiniBlockSize * sizeof(uint64_t));
+    return;
+  }
+  const uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+  size_t bit_pos = 0;
+  for (int i = 0; i < kForMiniBlockSize; i++) {
+    const uint8_t* p = src + (bit_pos >> 3);
+    const int shift = bit_pos & 7;
+    uint64_t v = UNALIGNED_LOAD64(p) >> shift;
+    if (shift + width > 64) {
+      v |= static_cast<uint64_t>(p[8]) << (64 - shift);
+    }
+    vals[i] = v & mask;
+    bit_pos += width;
+  }
+}
+
+} // namespace for_internal
+
+template<DataType Type>
+class ForBlockBuilder final : public BlockBuilder {
+ public:
+  explicit ForBlockBuilder(const WriterOptions* options)
+      : options_(options) {
+    Reset();
+  }
+
+  virtual bool IsBlockFull() const OVERRIDE {
+    const size_t pending = values_.size() % kForMiniBlockSize;
+    return estimated_size_ + pending * kCppTypeSize >
+        options_->storage_attributes.cfile_block_size;
+  }
+
+  virtual int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    DCHECK_EQ(reinterpret_cast<uintptr_t>(vals_void) & (alignof(CppType) - 1), 0)
+        << "Pointer passed to Add() must be naturally-aligned";
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    for (size_t i = 0; i < count; i++) {
+      values_.push_back(vals[i]);
+      if (values_.size() % kForMiniBlockSize == 0) {
+        // Account for the miniblock that was just completed.
+        UnsignedType min_delta;
+        int width;
+        ComputeFrame(values_.size() - kForMiniBlockSize, &min_delta, &width);
+        estimated_size_ += kDescriptorSize + 16 * width;
+      }
+    }
+    return count;
+  }
+
+  virtual Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    buf_.clear();
+    const size_t num_elems = values_.size();
+    const size_t num_miniblocks = (num_elems + kForMiniBlockSize - 1) / kForMiniBlockSize;
+    buf_.resize(kForBlockHeaderSize + num_miniblocks * kDescriptorSize);
+    InlineEncodeFixed32(&buf_[0], num_elems);
+    InlineEncodeFixed32(&buf_[4], ordinal_pos);
+
+    uint64_t packed[kForMiniBlockSize];
+    for (size_t m = 0; m < num_miniblocks; m++) {
+      const size_t start = m * kForMiniBlockSize;
+      const size_t n = std::min<size_t>(kForMiniBlockSize, num_elems - start);
+      UnsignedType min_delta;
+      int width;
+      ComputeFrame(start, &min_delta, &width);
+
+      uint8_t* desc = &buf_[kForBlockHeaderSize + m * kDescriptorSize];
+      UnalignedStore<CppType>(desc, values_[start]);
+      UnalignedStore<UnsignedType>(desc + kCppTypeSize, min_delta);
+      desc[2 * kCppTypeSize] = width;
+
+      packed[0] = 0;
+      for (size_t i = 1; i < n; i++) {
+        packed[i] = static_cast<UnsignedType>(Delta(start + i) - min_delta);
+      }
+      std::fill(packed + n, packed + kForMiniBlockSize, 0);
+      for_internal::PackMiniBlock(packed, width, &buf_);
+    }
+    buf_.resize(buf_.size() + kForBlockPaddingSize, 0);
+    return Slice(buf_);
+  }
+
+  virtual void Reset() OVERRIDE {
+    values_.clear();
+    buf_.clear();
+    estimated_size_ = kForBlockHeaderSize + kForBlockPaddingSize;
+  }
+
+  virtual size_t Count() const OVERRIDE {
+    return values_.size();
+  }
+
+  virtual Status GetFirstKey(void* key) const OVERRIDE {
+    if (PREDICT_FALSE(values_.empty())) {
+      return Status::NotFound("No keys in the block");
+    }
+    UnalignedStore<CppType>(key, values_.front());
+    return Status::OK();
+  }
+
+  virtual Status GetLastKey(void* key) const OVERRIDE {
+    if (PREDICT_FALSE(values_.empty())) {
+      return Status::NotFound("No keys in the block");
+    }
+    UnalignedStore<CppType>(key, values_.back());
+    return Status::OK();
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef typename std::make_unsigned<CppType>::type UnsignedType;
+  typedef typename std::make_signed<CppType>::type SignedType;
+
+  enum {
+    kCppTypeSize = TypeTraits<Type>::size,
+    kDescriptorSize = 2 * kCppTypeSize + 1
+  };
+
+  // The difference between the value at 'idx' and its predecessor, with
+  // wrap-around.
+  ATTRIBUTE_NO_SANITIZE_INTEGER
+  UnsignedType Delta(size_t idx) const {
+    return static_cast<UnsignedType>(static_cast<UnsignedType>(values_[idx]) -
+                                     static_cast<UnsignedType>(values_[idx - 1]));
+  }
+
+  // Compute the frame of reference and packed width of the miniblock starting
+  // at value 'start'.
+  ATTRIBUTE_NO_SANITIZE_INTEGER
+  void ComputeFrame(size_t start, UnsignedType* min_delta, int* width) const {
+    const size_t end = std::min<size_t>(start + kForMiniBlockSize, values_.size());
+    if (end - start < 2) {
+      *min_delta = 0;
+      *width = 0;
+      return;
+    }
+    SignedType min = std::numeric_limits<SignedType>::max();
+    SignedType max = std::numeric_limits<SignedType>::min();
+    for (size_t i = start + 1; i < end; i++) {
+      const SignedType d = static_cast<SignedType>(Delta(i));
+      min = std::min(min, d);
+      max = std::max(max, d);
+    }
+    *min_delta = static_cast<UnsignedType>(min);
+    const uint64_t range = static_cast<UnsignedType>(static_cast<UnsignedType>(max) -
+                                                     static_cast<UnsignedType>(min));
+    *width = range == 0 ? 0 : Bits::FindMSBSetNonZero64(range) + 1;
+  }
+
+  std::vector<CppType> values_;
+  faststring buf_;
+  size_t estimated_size_;
+  const WriterOptions* const options_;
+};
+
+template<DataType Type>
+class ForBlockDecoder final : public BlockDecoder {
+ public:
+  explicit ForBlockDecoder(Slice slice)
+      : data_(slice),
+        parsed_(false),
+        num_elems_(0),
+        ordinal_pos_base_(0),
+        cur_idx_(0),
+        decoded_miniblock_(-1) {
+  }
+
+  virtual Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < kForBlockHeaderSize + kForBlockPaddingSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: $0", data_.size()));
+    }
+    num_elems_ = DecodeFixed32(&data_[0]);
+    ordinal_pos_base_ = DecodeFixed32(&data_[4]);
+
+    const size_t num_miniblocks = (num_elems_ + kForMiniBlockSize - 1) / kForMiniBlockSize;
+    const size_t descriptors_size = num_miniblocks * kDescriptorSize;
+    if (data_.size() < kForBlockHeaderSize + descriptors_size + kForBlockPaddingSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for $0 miniblock descriptors: $1",
+                              num_miniblocks, data_.size()));
+    }
+
+    // Locate the packed data of each miniblock.
+    miniblock_offsets_.resize(num_miniblocks);
+    size_t offset = kForBlockHeaderSize + descriptors_size;
+    for (size_t m = 0; m < num_miniblocks; m++) {
+      const int width = Width(m);
+      if (PREDICT_FALSE(width > kCppTypeSize * 8)) {
+        return Status::Corruption(
+            strings::Substitute("invalid bit width $0 for miniblock $1", width, m));
+      }
+      miniblock_offsets_[m] = offset;
+      offset += 16 * width;
+    }
+    if (data_.size() < offset + kForBlockPaddingSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for packed data: expected $0, got $1",
+                              offset + kForBlockPaddingSize, data_.size()));
+    }
+
+    parsed_ = true;
+    SeekToPositionInBlock(0);
+    return Status::OK();
+  }
+
+  virtual void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    DCHECK_LE(pos, num_elems_)
+        << "Tried to seek to " << pos << " which is > number of elements ("
+        << num_elems_ << ") in the block!";
+    // Miniblocks are decoded lazily, as values are copied out.
+    cur_idx_ = pos;
+  }
+
+  virtual Status SeekAtOrAfterValue(const void* value_void, bool* exact_match) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    if (PREDICT_FALSE(num_elems_ == 0)) {
+      return Status::NotFound("not in block");
+    }
+    const CppType target = UnalignedLoad<CppType>(value_void);
+
+    // Find the last miniblock starting at or before the target.
+    size_t lo = 0;
+    size_t hi = miniblock_offsets_.size();
+    while (hi - lo > 1) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (FirstValue(mid) <= target) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+
+    DecodeMiniBlock(lo);
+    const size_t n = NumValues(lo);
+    const CppType* found = std::lower_bound(decoded_, decoded_ + n, target);
+    if (found != decoded_ + n) {
+      cur_idx_ = lo * kForMiniBlockSize + (found - decoded_);
+      *exact_match = *found == target;
+      return Status::OK();
+    }
+    if (lo + 1 < miniblock_offsets_.size()) {
+      // The next miniblock starts after the target.
+      cur_idx_ = (lo + 1) * kForMiniBlockSize;
+      *exact_match = false;
+      return Status::OK();
+    }
+    return Status::NotFound("not in block");
+  }
+
+  virtual Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    const size_t to_fetch = std::min<size_t>(*n, num_elems_ - cur_idx_);
+    size_t remaining = to_fetch;
+    uint8_t* out = dst->data();
+    while (remaining > 0) {
+      const size_t m = cur_idx_ / kForMiniBlockSize;
+      const size_t off = cur_idx_ % kForMiniBlockSize;
+      const size_t count = std::min(remaining, NumValues(m) - off);
+      if (off == 0 && count == kForMiniBlockSize && decoded_miniblock_ != m) {
+        // Decode whole miniblocks directly into the output.
+        DecodeMiniBlockInto(m, reinterpret_cast<CppType*>(out));
+      } else {
+        DecodeMiniBlock(m);
+        memcpy(out, decoded_ + off, count * kCppTypeSize);
+      }
+      out += count * kCppTypeSize;
+      cur_idx_ += count;
+      remaining -= count;
+    }
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  virtual bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+  virtual size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  virtual size_t GetCurrentIndex() const OVERRIDE {
+    return cur_idx_;
+  }
+
+  virtual rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef typename std::make_unsigned<CppType>::type UnsignedType;
+
+  enum {
+    kCppTypeSize = TypeTraits<Type>::size,
+    kDescriptorSize = 2 * kCppTypeSize + 1
+  };
+
+  const uint8_t* Descriptor(size_t m) const {
+    return data_.data() + kForBlockHeaderSize + m * kDescriptorSize;
+  }
+
+  CppType FirstValue(size_t m) const {
+    return UnalignedLoad<CppType>(Descriptor(m));
+  }
+
+  int Width(size_t m) const {
+    return Descriptor(m)[2 * kCppTypeSize];
+  }
+
+  // The number of values in miniblock 'm'.
+  size_t NumValues(size_t m) const {
+    return std::min<size_t>(kForMiniBlockSize, num_elems_ - m * kForMiniBlockSize);
+  }
+
+  // Decode miniblock 'm' into 'decoded_', unless it already is.
+  void DecodeMiniBlock(size_t m) {
+    if (decoded_miniblock_ != m) {
+      DecodeMiniBlockInto(m, decoded_);
+      decoded_miniblock_ = m;
+    }
+  }
+
+  // Decode the values of miniblock 'm' into 'out', which must have space
+  // for kForMiniBlockSize values.
+  ATTRIBUTE_NO_SANITIZE_INTEGER
+  void DecodeMiniBlockInto(size_t m, CppType* out) const {
+    const uint8_t* desc = Descriptor(m);
+    const UnsignedType min_delta = UnalignedLoad<UnsignedType>(desc + kCppTypeSize);
+    uint64_t packed[kForMiniBlockSize];
+    for_internal::UnpackMiniBlock(data_.data() + miniblock_offsets_[m], Width(m), packed);
+
+    // Undo the frame of reference, then the deltas. The first loop is
+    // independent across values, so the compiler may vectorize it.
+    UnsignedType deltas[kForMiniBlockSize];
+    for (int i = 0; i < kForMiniBlockSize; i++) {
+      deltas[i] = static_cast<UnsignedType>(packed[i]) + min_delta;
+    }
+    const size_t n = NumValues(m);
+    UnsignedType v = static_cast<UnsignedType>(UnalignedLoad<CppType>(desc));
+    out[0] = static_cast<CppType>(v);
+    for (size_t i = 1; i < n; i++) {
+      v += deltas[i];
+      out[i] = static_cast<CppType>(v);
+    }
+  }
+
+  Slice data_;
+  bool parsed_;
+  uint32_t num_elems_;
+  rowid_t ordinal_pos_base_;
+  size_t cur_idx_;
+
+  // The offset within 'data_' of each miniblock's packed data.
+  std::vector<uint32_t> miniblock_offsets_;
+
+  // The values of miniblock 'decoded_miniblock_', or -1 if none.
+  CppType decoded_[kForMiniBlockSize];
+  size_t decoded_miniblock_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
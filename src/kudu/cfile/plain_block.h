@@ -209,6 +209,16 @@ class PlainBlockDecoder final : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    ctx->SetDecoderEvalSupported();
+    RETURN_NOT_OK(CopyNextValues(n, dst));
+    ctx->pred()->EvaluateCells(Type, dst->data(), *n, sel);
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
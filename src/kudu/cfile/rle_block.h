@@ -22,6 +22,7 @@
 #include <string>
 
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/common/columnblock.h"
@@ -176,15 +177,8 @@ class RleBitMapBlockDecoder final : public BlockDecoder {
     }
 
     size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
-    size_t remaining = bits_to_fetch;
-    uint8_t* data_ptr = dst->data();
-    // TODO : do this a word/byte at a time as opposed bit at a time
-    while (remaining > 0) {
-      bool result = rle_decoder_.Get(reinterpret_cast<bool*>(data_ptr));
-      DCHECK(result);
-      remaining--;
-      data_ptr++;
-    }
+    size_t fetched = rle_decoder_.GetBatch(reinterpret_cast<bool*>(dst->data()), bits_to_fetch);
+    DCHECK_EQ(bits_to_fetch, fetched);
 
     cur_idx_ += bits_to_fetch;
     *n = bits_to_fetch;
@@ -409,13 +403,47 @@ class RleIntBlockDecoder final : public BlockDecoder {
     }
 
     size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
-    size_t remaining = to_fetch;
-    uint8_t* data_ptr = dst->data();
-    while (remaining > 0) {
-      bool result = rle_decoder_.Get(reinterpret_cast<CppType*>(data_ptr));
-      DCHECK(result);
-      remaining--;
-      data_ptr += kCppTypeSize;
+    size_t fetched = rle_decoder_.GetBatch(reinterpret_cast<CppType*>(dst->data()), to_fetch);
+    DCHECK_EQ(to_fetch, fetched);
+
+    cur_idx_ += to_fetch;
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  // Evaluates the predicate once per run of repeated values. Rows of runs
+  // which don't match are deselected and left unmaterialized.
+  virtual Status CopyNextAndEval(size_t* n,
+                                 ColumnMaterializationContext* ctx,
+                                 SelectionVectorView* sel,
+                                 ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    CppType* out = reinterpret_cast<CppType*>(dst->data());
+    size_t fetched = 0;
+    while (fetched < to_fetch) {
+      CppType val;
+      size_t run = rle_decoder_.GetNextRun(&val, to_fetch - fetched);
+      if (PREDICT_FALSE(run == 0)) {
+        return Status::Corruption(
+            strings::Substitute("unexpected end of RLE data: expected $0 more values",
+                                to_fetch - fetched));
+      }
+      if (ctx->pred()->EvaluateCell<IntType>(&val)) {
+        std::fill(out + fetched, out + fetched + run, val);
+      } else {
+        sel->ClearBits(fetched, run);
+      }
+      fetched += run;
     }
 
     cur_idx_ += to_fetch;
@@ -21,7 +21,9 @@
 #include <unordered_map>
 #include <utility>
 
+#include "kudu/cfile/binary_front_coded_block.h"
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/for_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
@@ -154,6 +156,22 @@ struct DataTypeEncodingTraits<BINARY, PREFIX_ENCODING> {
   }
 };
 
+// Template specialization for front-coded strings.
+template<>
+struct DataTypeEncodingTraits<BINARY, FRONT_CODED_ENCODING> {
+
+  static Status CreateBlockBuilder(BlockBuilder **bb, const WriterOptions *options) {
+    *bb = new BinaryFrontCodedBlockBuilder(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder **bd, const Slice &slice,
+                                   CFileIterator *iter) {
+    *bd = new BinaryFrontCodedBlockDecoder(slice);
+    return Status::OK();
+  }
+};
+
 // Template for dictionary encoding
 template<>
 struct DataTypeEncodingTraits<BINARY, DICT_ENCODING> {
@@ -185,6 +203,21 @@ struct DataTypeEncodingTraits<IntType, RLE> {
   }
 };
 
+template<DataType IntType>
+struct DataTypeEncodingTraits<IntType, FRAME_OF_REFERENCE> {
+
+  static Status CreateBlockBuilder(BlockBuilder** bb, const WriterOptions *options) {
+    *bb = new ForBlockBuilder<IntType>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder** bd, const Slice& slice,
+                                   CFileIterator *iter) {
+    *bd = new ForBlockDecoder<IntType>(slice);
+    return Status::OK();
+  }
+};
+
 
 template<typename TypeEncodingTraitsClass>
 TypeEncodingInfo::TypeEncodingInfo(TypeEncodingTraitsClass t)
@@ -243,27 +276,35 @@ class TypeEncodingResolver {
     AddMapping<UINT8, BIT_SHUFFLE>();
     AddMapping<UINT8, PLAIN_ENCODING>();
     AddMapping<UINT8, RLE>();
+    AddMapping<UINT8, FRAME_OF_REFERENCE>();
     AddMapping<INT8, BIT_SHUFFLE>();
     AddMapping<INT8, PLAIN_ENCODING>();
     AddMapping<INT8, RLE>();
+    AddMapping<INT8, FRAME_OF_REFERENCE>();
     AddMapping<UINT16, BIT_SHUFFLE>();
     AddMapping<UINT16, PLAIN_ENCODING>();
     AddMapping<UINT16, RLE>();
+    AddMapping<UINT16, FRAME_OF_REFERENCE>();
     AddMapping<INT16, BIT_SHUFFLE>();
     AddMapping<INT16, PLAIN_ENCODING>();
     AddMapping<INT16, RLE>();
+    AddMapping<INT16, FRAME_OF_REFERENCE>();
     AddMapping<UINT32, BIT_SHUFFLE>();
     AddMapping<UINT32, RLE>();
     AddMapping<UINT32, PLAIN_ENCODING>();
+    AddMapping<UINT32, FRAME_OF_REFERENCE>();
     AddMapping<INT32, BIT_SHUFFLE>();
     AddMapping<INT32, PLAIN_ENCODING>();
     AddMapping<INT32, RLE>();
+    AddMapping<INT32, FRAME_OF_REFERENCE>();
     AddMapping<UINT64, BIT_SHUFFLE>();
     AddMapping<UINT64, PLAIN_ENCODING>();
     AddMapping<UINT64, RLE>();
+    AddMapping<UINT64, FRAME_OF_REFERENCE>();
     AddMapping<INT64, BIT_SHUFFLE>();
     AddMapping<INT64, PLAIN_ENCODING>();
     AddMapping<INT64, RLE>();
+    AddMapping<INT64, FRAME_OF_REFERENCE>();
     AddMapping<FLOAT, BIT_SHUFFLE>();
     AddMapping<FLOAT, PLAIN_ENCODING>();
     AddMapping<DOUBLE, BIT_SHUFFLE>();
@@ -271,6 +312,7 @@ class TypeEncodingResolver {
     AddMapping<BINARY, DICT_ENCODING>();
     AddMapping<BINARY, PLAIN_ENCODING>();
     AddMapping<BINARY, PREFIX_ENCODING>();
+    AddMapping<BINARY, FRONT_CODED_ENCODING>();
     AddMapping<BOOL, RLE>();
     AddMapping<BOOL, PLAIN_ENCODING>();
     AddMapping<INT128, BIT_SHUFFLE>();
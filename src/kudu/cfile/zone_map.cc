@@ -0,0 +1,225 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/zone_map.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#include <glog/logging.h>
+
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+static_assert(sizeof(int128_t) >= sizeof(Slice), "a zone map bound must fit a Slice");
+
+////////////////////////////////////////////////////////////
+// ZoneMapBuilder
+////////////////////////////////////////////////////////////
+
+ZoneMapBuilder::ZoneMapBuilder(const TypeInfo* type)
+    : type_(type),
+      has_values_(false),
+      null_count_(0) {
+  DCHECK(SupportsType(type));
+}
+
+bool ZoneMapBuilder::SupportsType(const TypeInfo* type) {
+  switch (type->physical_type()) {
+    case FLOAT:
+    case DOUBLE:
+      return false;
+    default:
+      return type->size() <= sizeof(int128_t);
+  }
+}
+
+void ZoneMapBuilder::Bound::Set(const TypeInfo* type, const void* cell) {
+  if (type->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    data_.assign_copy(s->data(), s->size());
+    Slice copy(data_);
+    memcpy(&cell_, &copy, sizeof(copy));
+  } else {
+    memcpy(&cell_, cell, type->size());
+  }
+}
+
+Slice ZoneMapBuilder::Bound::ToSlice(const TypeInfo* type) const {
+  if (type->physical_type() == BINARY) {
+    return Slice(data_);
+  }
+  return Slice(reinterpret_cast<const uint8_t*>(&cell_), type->size());
+}
+
+void ZoneMapBuilder::AddValues(const void* cells, size_t n) {
+  if (n == 0) {
+    return;
+  }
+  // Find the extremes of the new cells first, so that at most one copy is
+  // made of each.
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(cells);
+  const void* min = ptr;
+  const void* max = ptr;
+  for (size_t i = 1; i < n; i++) {
+    ptr += type_->size();
+    if (type_->Compare(ptr, min) < 0) {
+      min = ptr;
+    } else if (type_->Compare(ptr, max) > 0) {
+      max = ptr;
+    }
+  }
+  if (!has_values_ || type_->Compare(min, min_.cell()) < 0) {
+    min_.Set(type_, min);
+  }
+  if (!has_values_ || type_->Compare(max, max_.cell()) > 0) {
+    max_.Set(type_, max);
+  }
+  has_values_ = true;
+}
+
+void ZoneMapBuilder::FinishBlock(rowid_t first_ordinal, uint32_t num_rows) {
+  DCHECK_LE(null_count_, num_rows);
+  ZoneMapEntryPB* entry = zone_map_.add_entries();
+  entry->set_first_ordinal(first_ordinal);
+  entry->set_num_rows(num_rows);
+  if (null_count_ > 0) {
+    entry->set_null_count(null_count_);
+  }
+  if (has_values_) {
+    entry->set_min_value(min_.ToSlice(type_).ToString());
+    entry->set_max_value(max_.ToSlice(type_).ToString());
+  }
+  has_values_ = false;
+  null_count_ = 0;
+}
+
+////////////////////////////////////////////////////////////
+// ZoneMap
+////////////////////////////////////////////////////////////
+
+ZoneMap::ZoneMap()
+    : type_(nullptr) {
+}
+
+Status ZoneMap::Init(const TypeInfo* type, const Slice& data) {
+  type_ = type;
+  if (!ZoneMapBuilder::SupportsType(type)) {
+    return Status::Corruption(Substitute("zone map for unsupported type $0", type->name()));
+  }
+  if (!zone_map_.ParseFromArray(data.data(), data.size())) {
+    return Status::Corruption("unable to parse zone map");
+  }
+
+  rowid_t next_ordinal = 0;
+  for (const auto& entry : zone_map_.entries()) {
+    if (entry.first_ordinal() < next_ordinal ||
+        entry.null_count() > entry.num_rows() ||
+        entry.has_min_value() != entry.has_max_value() ||
+        entry.has_min_value() == (entry.null_count() == entry.num_rows())) {
+      return Status::Corruption("bad zone map entry", entry.ShortDebugString());
+    }
+    if (type->physical_type() != BINARY && entry.has_min_value() &&
+        (entry.min_value().size() != type->size() ||
+         entry.max_value().size() != type->size())) {
+      return Status::Corruption(Substitute("bad zone map value size for type $0",
+                                           type->name()));
+    }
+    next_ordinal = entry.first_ordinal() + entry.num_rows();
+  }
+  return Status::OK();
+}
+
+int ZoneMap::FindEntry(rowid_t ordinal) const {
+  const auto& entries = zone_map_.entries();
+  auto it = std::upper_bound(entries.begin(), entries.end(), ordinal,
+                             [](rowid_t ord, const ZoneMapEntryPB& entry) {
+                               return ord < entry.first_ordinal();
+                             });
+  if (it == entries.begin()) {
+    return -1;
+  }
+  int idx = std::distance(entries.begin(), it) - 1;
+  return ordinal < end_ordinal(idx) ? idx : -1;
+}
+
+const void* ZoneMap::ToCell(const string& value, int128_t* cell) const {
+  if (type_->physical_type() == BINARY) {
+    Slice s(value);
+    memcpy(cell, &s, sizeof(s));
+  } else {
+    memcpy(cell, value.data(), type_->size());
+  }
+  return cell;
+}
+
+bool ZoneMap::MayMatch(int idx, const ColumnPredicate& pred) const {
+  const ZoneMapEntryPB& entry = zone_map_.entries(idx);
+  const bool has_values = entry.num_rows() > entry.null_count();
+  switch (pred.predicate_type()) {
+    case PredicateType::None:
+      return false;
+    case PredicateType::IsNull:
+      return entry.null_count() > 0;
+    case PredicateType::IsNotNull:
+    case PredicateType::InBloomFilter:
+      return has_values;
+    case PredicateType::Equality:
+    case PredicateType::Range:
+    case PredicateType::InList:
+      break;
+  }
+  if (!has_values) {
+    return false;
+  }
+
+  int128_t min_buf;
+  int128_t max_buf;
+  const void* min = ToCell(entry.min_value(), &min_buf);
+  const void* max = ToCell(entry.max_value(), &max_buf);
+  switch (pred.predicate_type()) {
+    case PredicateType::Equality:
+      return type_->Compare(pred.raw_lower(), min) >= 0 &&
+             type_->Compare(pred.raw_lower(), max) <= 0;
+    case PredicateType::Range:
+      // The upper bound of a range is exclusive.
+      return (pred.raw_lower() == nullptr || type_->Compare(max, pred.raw_lower()) >= 0) &&
+             (pred.raw_upper() == nullptr || type_->Compare(min, pred.raw_upper()) < 0);
+    case PredicateType::InList:
+      return std::any_of(pred.raw_values().begin(), pred.raw_values().end(),
+                         [&](const void* value) {
+                           return type_->Compare(value, min) >= 0 &&
+                                  type_->Compare(value, max) <= 0;
+                         });
+    default:
+      LOG(FATAL) << "unexpected predicate type";
+  }
+  return true;
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,136 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_ZONE_MAP_H
+#define KUDU_CFILE_ZONE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/int128.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnPredicate;
+class TypeInfo;
+
+namespace cfile {
+
+// A zone map records, for each data block of a CFile, the number of NULL
+// cells and the minimum and maximum non-NULL value. A reader can use it to
+// tell that none of the rows of a block can satisfy a predicate without
+// reading the block.
+//
+// Zone maps aren't kept for floating point columns, whose NaN values
+// don't fall between any minimum and maximum.
+
+// Accumulates the zone map of a CFile as its data blocks are written.
+class ZoneMapBuilder {
+ public:
+  explicit ZoneMapBuilder(const TypeInfo* type);
+
+  // Whether zone maps can be kept for columns of the given type.
+  static bool SupportsType(const TypeInfo* type);
+
+  // Add 'n' non-NULL cells, which are contiguous in memory, to the current
+  // block.
+  void AddValues(const void* cells, size_t n);
+
+  // Add 'n' NULL cells to the current block.
+  void AddNulls(size_t n) { null_count_ += n; }
+
+  // Finish the current block, which holds the 'num_rows' rows starting at
+  // 'first_ordinal', and start a new one.
+  void FinishBlock(rowid_t first_ordinal, uint32_t num_rows);
+
+  const ZoneMapPB& zone_map() const { return zone_map_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapBuilder);
+
+  // A copy of a cell, which owns the data of BINARY cells.
+  class Bound {
+   public:
+    const void* cell() const { return &cell_; }
+    void Set(const TypeInfo* type, const void* cell);
+    Slice ToSlice(const TypeInfo* type) const;
+
+   private:
+    // Large enough for any fixed-size cell, or for a Slice into 'data_'.
+    int128_t cell_;
+    faststring data_;
+  };
+
+  const TypeInfo* type_;
+
+  bool has_values_;
+  Bound min_;
+  Bound max_;
+  uint32_t null_count_;
+
+  ZoneMapPB zone_map_;
+};
+
+// Read-only view of the zone map of a CFile.
+class ZoneMap {
+ public:
+  ZoneMap();
+
+  // Parse the zone map from 'data', which was written for a column of type
+  // 'type'.
+  Status Init(const TypeInfo* type, const Slice& data);
+
+  // Return the index of the entry for the block holding the row at
+  // 'ordinal', or -1 if no block holds it.
+  int FindEntry(rowid_t ordinal) const;
+
+  size_t num_entries() const { return zone_map_.entries_size(); }
+
+  rowid_t first_ordinal(int idx) const {
+    return zone_map_.entries(idx).first_ordinal();
+  }
+
+  // The ordinal following the last row of the block of the entry 'idx'.
+  rowid_t end_ordinal(int idx) const {
+    const ZoneMapEntryPB& entry = zone_map_.entries(idx);
+    return entry.first_ordinal() + entry.num_rows();
+  }
+
+  // Return false if no row of the block of the entry 'idx' can satisfy
+  // 'pred'. A true result means that some row might.
+  bool MayMatch(int idx, const ColumnPredicate& pred) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ZoneMap);
+
+  // Point 'cell' at a cell holding 'value' for the comparisons of
+  // MayMatch().
+  const void* ToCell(const std::string& value, int128_t* cell) const;
+
+  const TypeInfo* type_;
+  ZoneMapPB zone_map_;
+};
+
+} // namespace cfile
+} // namespace kudu
+#endif
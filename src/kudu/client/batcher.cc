@@ -38,6 +38,7 @@
 #include "kudu/client/schema.h"
 #include "kudu/client/session-internal.h"
 #include "kudu/client/shared_ptr.h"
+#include "kudu/client/write_flow_controller.h"
 #include "kudu/client/write_op-internal.h"
 #include "kudu/client/write_op.h"
 #include "kudu/common/common.pb.h"
@@ -253,6 +254,11 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
 
   // The id of the tablet being written to.
   string tablet_id_;
+
+  // The replica and start time of the current attempt, for the session's
+  // flow controller.
+  string attempt_server_uuid_;
+  MonoTime attempt_start_;
 };
 
 WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
@@ -333,6 +339,10 @@ string WriteRpc::ToString() const {
 
 void WriteRpc::Try(RemoteTabletServer* replica, const ResponseCallback& callback) {
   VLOG(2) << "Tablet " << tablet_id_ << ": Writing batch to replica " << replica->ToString();
+  if (batcher_->flow_controller_) {
+    attempt_server_uuid_ = replica->permanent_uuid();
+    attempt_start_ = MonoTime::Now();
+  }
   replica->proxy()->WriteAsync(req_, &resp_,
                                mutable_retrier()->mutable_controller(),
                                callback);
@@ -366,6 +376,12 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
     if (err && err->has_code() &&
         (err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY ||
          err->code() == ErrorStatusPB::ERROR_UNAVAILABLE)) {
+      if (batcher_->flow_controller_ &&
+          err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY) {
+        // The server's RPC queue overflowed.
+        batcher_->flow_controller_->WriteResponded(
+            attempt_server_uuid_, MonoTime::Now() - attempt_start_, true);
+      }
       result.result = RetriableRpcStatus::SERVICE_UNAVAILABLE;
       return result;
     }
@@ -401,6 +417,14 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
     result.status = StatusFromPB(resp_.error().status());
   }
 
+  // Sample the round trip time of every write the server processed, whether
+  // or not it succeeded.
+  if (batcher_->flow_controller_ && rpc_cb_status.ok() &&
+      mutable_retrier()->controller().status().ok()) {
+    batcher_->flow_controller_->WriteResponded(
+        attempt_server_uuid_, MonoTime::Now() - attempt_start_, false);
+  }
+
   // If we get TABLET_NOT_FOUND, the replica we thought was leader has been deleted.
   if (resp_.has_error() && resp_.error().code() == tserver::TabletServerErrorPB::TABLET_NOT_FOUND) {
     result.result = RetriableRpcStatus::RESOURCE_NOT_FOUND;
@@ -455,12 +479,14 @@ bool WriteRpc::GetNewAuthnTokenAndRetry() {
 Batcher::Batcher(KuduClient* client,
                  scoped_refptr<ErrorCollector> error_collector,
                  sp::weak_ptr<KuduSession> session,
-                 kudu::client::KuduSession::ExternalConsistencyMode consistency_mode)
+                 kudu::client::KuduSession::ExternalConsistencyMode consistency_mode,
+                 shared_ptr<WriteFlowController> flow_controller)
   : state_(kGatheringOps),
     client_(client),
     weak_session_(std::move(session)),
     consistency_mode_(consistency_mode),
     error_collector_(std::move(error_collector)),
+    flow_controller_(std::move(flow_controller)),
     had_errors_(false),
     flush_callback_(nullptr),
     next_op_sequence_number_(0),
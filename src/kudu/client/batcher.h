@@ -18,6 +18,7 @@
 #define KUDU_CLIENT_BATCHER_H
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
@@ -46,6 +47,7 @@ struct InFlightOp;
 
 class ErrorCollector;
 class RemoteTablet;
+class WriteFlowController;
 class WriteRpc;
 
 // A Batcher is the class responsible for collecting row operations, routing them to the
@@ -66,10 +68,14 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // is to break circular dependencies (a session keeps a reference to its
   // current batcher) and make it possible to call notify a session
   // (if it's around) from a batcher which does its job using other threads.
+  //
+  // If 'flow_controller' is set, the responses to the batcher's writes are
+  // reported to it.
   Batcher(KuduClient* client,
           scoped_refptr<ErrorCollector> error_collector,
           client::sp::weak_ptr<KuduSession> session,
-          kudu::client::KuduSession::ExternalConsistencyMode consistency_mode);
+          kudu::client::KuduSession::ExternalConsistencyMode consistency_mode,
+          std::shared_ptr<WriteFlowController> flow_controller = nullptr);
 
   // Abort the current batch. Any writes that were buffered and not yet sent are
   // discarded. Those that were sent may still be delivered.  If there is a pending Flush
@@ -189,6 +195,10 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // Errors are reported into this error collector.
   scoped_refptr<ErrorCollector> error_collector_;
 
+  // The session's flow controller, if it adapts its batching to the load
+  // of the tablet servers.
+  const std::shared_ptr<WriteFlowController> flow_controller_;
+
   // The time when the very first operation was added into the batcher.
   MonoTime first_op_time_;
 
@@ -145,7 +145,8 @@ Status RetryFunc(const MonoTime& deadline,
 }
 
 KuduClient::Data::Data()
-    : hive_metastore_sasl_enabled_(false),
+    : prefetch_tablet_locations_(false),
+      hive_metastore_sasl_enabled_(false),
       latest_observed_timestamp_(KuduClient::kNoTimestamp) {
 }
 
@@ -45,6 +45,7 @@
 #include "kudu/client/client-test-util.h"
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
+#include "kudu/client/columnar_scan_batch.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/resource_metrics.h"
@@ -95,6 +96,7 @@
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/async_util.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"  // IWYU pragma: keep
 #include "kudu/util/metrics.h"
@@ -1151,6 +1153,53 @@ TEST_F(ClientTest, TestScanEmptyProjection) {
   }
 }
 
+TEST_F(ClientTest, TestColumnarScan) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetProjectedColumns({ "key", "int_val", "string_val" }));
+  ASSERT_TRUE(scanner.SetRowFormatFlags(
+      KuduScanner::COLUMNAR_LAYOUT |
+      KuduScanner::PAD_UNIXTIME_MICROS_TO_16_BYTES).IsInvalidArgument());
+  ASSERT_OK(scanner.SetRowFormatFlags(KuduScanner::COLUMNAR_LAYOUT));
+  ASSERT_OK(scanner.Open());
+
+  // Row-wise batches can't be fetched from a columnar scan.
+  KuduScanBatch row_batch;
+  Status s = scanner.NextBatch(&row_batch);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+
+  KuduColumnarScanBatch batch;
+  int count = 0;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    Slice keys, int_vals, str_offsets, str_data, str_non_null;
+    ASSERT_OK(batch.GetFixedLengthColumn(0, &keys));
+    ASSERT_OK(batch.GetFixedLengthColumn(1, &int_vals));
+    ASSERT_OK(batch.GetVariableLengthColumn(2, &str_offsets, &str_data));
+    ASSERT_OK(batch.GetNonNullBitmapForColumn(2, &str_non_null));
+    ASSERT_TRUE(batch.GetFixedLengthColumn(2, &keys).IsInvalidArgument());
+    ASSERT_TRUE(batch.GetFixedLengthColumn(3, &keys).IsInvalidArgument());
+    if (batch.NumRows() == 0) {
+      continue;
+    }
+    ASSERT_EQ(batch.NumRows() * sizeof(int32_t), keys.size());
+    ASSERT_EQ(batch.NumRows() * sizeof(int32_t), int_vals.size());
+    ASSERT_EQ((batch.NumRows() + 1) * sizeof(uint32_t), str_offsets.size());
+    for (int i = 0; i < batch.NumRows(); i++) {
+      int32_t key = UnalignedLoad<int32_t>(keys.data() + i * sizeof(int32_t));
+      ASSERT_EQ(key * 2, UnalignedLoad<int32_t>(int_vals.data() + i * sizeof(int32_t)));
+      ASSERT_TRUE(BitmapTest(str_non_null.data(), i));
+      uint32_t start = UnalignedLoad<uint32_t>(str_offsets.data() + i * sizeof(uint32_t));
+      uint32_t end = UnalignedLoad<uint32_t>(str_offsets.data() + (i + 1) * sizeof(uint32_t));
+      ASSERT_EQ(StringPrintf("hello %d", key),
+                Slice(str_data.data() + start, end - start).ToString());
+    }
+    count += batch.NumRows();
+  }
+  ASSERT_EQ(FLAGS_test_scan_num_rows, count);
+}
+
 TEST_F(ClientTest, TestProjectInvalidColumn) {
   KuduScanner scanner(client_table_.get());
   Status s = scanner.SetProjectedColumns({ "column-doesnt-exist" });
@@ -1971,6 +2020,47 @@ TEST_F(ClientTest, TestMetaCacheExpiry) {
   ASSERT_FALSE(entry.stale());
 }
 
+// Check that a client which prefetches tablet locations caches the locations
+// of all of a table's tablets once it opens the table.
+TEST_F(ClientTest, TestPrefetchTabletLocations) {
+  const string kPrefetchTableName = "prefetch";
+  const int kNumTablets = 20;
+  vector<unique_ptr<KuduPartialRow>> split_rows;
+  for (int i = 1; i < kNumTablets; i++) {
+    unique_ptr<KuduPartialRow> row(schema_.NewRow());
+    ASSERT_OK(row->SetInt32(0, i * 10));
+    split_rows.emplace_back(std::move(row));
+  }
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable(kPrefetchTableName, 1, std::move(split_rows), {}, &table));
+
+  shared_ptr<KuduClient> client;
+  ASSERT_OK(KuduClientBuilder()
+      .add_master_server_addr(cluster_->mini_master()->bound_rpc_addr().ToString())
+      .prefetch_tablet_locations(true)
+      .Build(&client));
+  ASSERT_OK(client->OpenTable(kPrefetchTableName, &table));
+  auto& meta_cache = client->data_->meta_cache_;
+  ASSERT_EVENTUALLY([&] {
+    string partition_key;
+    ASSERT_FALSE(meta_cache->NextUncachedPartitionKey(table->id(), &partition_key));
+  });
+
+  // Every tablet is found without a lookup from the master.
+  internal::MetaCacheEntry entry;
+  int num_tablets = 0;
+  string partition_key;
+  while (true) {
+    ASSERT_TRUE(meta_cache->LookupEntryByKeyFastPath(table.get(), partition_key, &entry));
+    num_tablets++;
+    if (entry.upper_bound_partition_key().empty()) {
+      break;
+    }
+    partition_key = entry.upper_bound_partition_key();
+  }
+  ASSERT_EQ(kNumTablets, num_tablets);
+}
+
 TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("blacklist",
@@ -2977,6 +3067,41 @@ TEST_F(ClientTest, TestSessionMutationBufferMaxNum) {
   }
 }
 
+// Check that an adaptive session writes all of its operations, and never
+// has more batchers than its configured limit.
+TEST_F(ClientTest, TestSessionMutationBufferAdaptiveFlush) {
+  const size_t kBufferMaxLimit = 4;
+  const int kNumRows = 1000;
+  shared_ptr<KuduSession> session(client_->NewSession());
+  ASSERT_OK(session->SetMutationBufferSpace(1024));
+  ASSERT_OK(session->SetMutationBufferMaxNum(kBufferMaxLimit));
+  ASSERT_OK(session->SetMutationBufferAdaptiveFlush(true));
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+
+  size_t monitor_max_batchers_count = 0;
+  CountDownLatch monitor_run_ctl(1);
+  thread monitor(bind(&ClientTest::MonitorSessionBatchersCount, session.get(),
+                      &monitor_run_ctl, &monitor_max_batchers_count));
+  for (int i = 0; i < kNumRows; ++i) {
+    ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, i, i, "x"));
+  }
+  EXPECT_OK(session->Flush());
+  monitor_run_ctl.CountDown();
+  monitor.join();
+  EXPECT_GE(kBufferMaxLimit, monitor_max_batchers_count);
+  ASSERT_EQ(0, session->CountPendingErrors());
+  ASSERT_EQ(kNumRows, CountRowsFromClient(client_table_.get()));
+
+  // As with the other settings, it can't be changed with buffered writes.
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  ASSERT_OK(ApplyInsertToSession(session.get(), client_table_,
+                                 kNumRows, kNumRows, "x"));
+  Status s = session->SetMutationBufferAdaptiveFlush(false);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  ASSERT_OK(session->Flush());
+  ASSERT_OK(session->SetMutationBufferAdaptiveFlush(false));
+}
+
 enum class RowSize {
   CONSTANT,
   RANDOM,
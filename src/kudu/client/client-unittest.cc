@@ -31,6 +31,7 @@
 #include "kudu/client/error_collector.h"
 #include "kudu/client/schema.h"
 #include "kudu/client/value.h"
+#include "kudu/client/write_flow_controller.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/ref_counted.h"
@@ -43,6 +44,7 @@ using std::string;
 using std::vector;
 using strings::Substitute;
 using kudu::client::internal::ErrorCollector;
+using kudu::client::internal::WriteFlowController;
 
 namespace kudu {
 namespace client {
@@ -301,5 +303,43 @@ TEST(ClientUnitTest, TestKuduSchemaToStringWithColumnIds) {
             kudu_schema.ToString());
 }
 
+// The window grows while the servers respond promptly, up to its limit, and
+// is halved once per round trip when any of them is congested.
+TEST(ClientUnitTest, TestWriteFlowController) {
+  const int kRttMs = 2;
+  const MonoDelta kRtt = MonoDelta::FromMilliseconds(kRttMs);
+  WriteFlowController fc(2, 8);
+  ASSERT_EQ(2, fc.max_batchers());
+  ASSERT_EQ(1, fc.batch_size_fraction());
+
+  for (int i = 0; i < 100; i++) {
+    fc.WriteResponded("a", kRtt, false);
+    fc.WriteResponded("b", kRtt, false);
+  }
+  ASSERT_EQ(8, fc.max_batchers());
+
+  // A rejection by either server halves the session's window.
+  fc.WriteResponded("a", kRtt, true);
+  ASSERT_EQ(4, fc.max_batchers());
+  ASSERT_EQ(0.5, fc.batch_size_fraction());
+
+  // A write which takes much longer than the server's best halves that
+  // server's window, but it isn't halved again within a round trip.
+  fc.WriteResponded("b", MonoDelta::FromMilliseconds(
+      kRttMs * (WriteFlowController::kRttCongestionFactor + 1)), false);
+  ASSERT_EQ(4, fc.max_batchers());
+  fc.WriteResponded("b", kRtt, true);
+  ASSERT_EQ(4, fc.max_batchers());
+  ASSERT_EQ(0.5, fc.batch_size_fraction());
+
+  // The window never drops below a single batcher.
+  for (int i = 0; i < 10; i++) {
+    SleepFor(MonoDelta::FromMilliseconds(kRttMs * 10));
+    fc.WriteResponded("a", kRtt, true);
+  }
+  ASSERT_EQ(1, fc.max_batchers());
+  ASSERT_EQ(WriteFlowController::kMinBatchSizeFraction, fc.batch_size_fraction());
+}
+
 } // namespace client
 } // namespace kudu
@@ -34,6 +34,7 @@
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/client_builder-internal.h"
+#include "kudu/client/columnar_scan_batch.h"
 #include "kudu/client/error-internal.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/master_proxy_rpc.h"
@@ -302,6 +303,11 @@ KuduClientBuilder& KuduClientBuilder::num_reactors(int num_reactors) {
   return *this;
 }
 
+KuduClientBuilder& KuduClientBuilder::prefetch_tablet_locations(bool prefetch) {
+  data_->prefetch_tablet_locations_ = prefetch;
+  return *this;
+}
+
 namespace {
 Status ImportAuthnCreds(const string& authn_creds,
                         Messenger* messenger,
@@ -361,6 +367,7 @@ Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
   c->data_->master_server_addrs_ = data_->master_server_addrs_;
   c->data_->default_admin_operation_timeout_ = data_->default_admin_operation_timeout_;
   c->data_->default_rpc_timeout_ = data_->default_rpc_timeout_;
+  c->data_->prefetch_tablet_locations_ = data_->prefetch_tablet_locations_;
 
   // Let's allow for plenty of time for discovering the master the first
   // time around.
@@ -529,6 +536,11 @@ Status KuduClient::OpenTable(const string& table_name,
   // current range partitions of a table for up to the ttl.
   data_->meta_cache_->ClearNonCoveredRangeEntries(table_id);
 
+  if (data_->prefetch_tablet_locations_) {
+    data_->meta_cache_->PrefetchTableLocations(
+        *table, MonoTime::Now() + default_admin_operation_timeout());
+  }
+
   return Status::OK();
 }
 
@@ -1047,6 +1059,10 @@ Status KuduSession::SetMutationBufferMaxNum(unsigned int max_num) {
   return data_->SetMaxBatchersNum(max_num);
 }
 
+Status KuduSession::SetMutationBufferAdaptiveFlush(bool enable) {
+  return data_->SetAdaptiveFlush(enable);
+}
+
 void KuduSession::SetTimeoutMillis(int timeout_ms) {
   data_->SetTimeoutMillis(timeout_ms);
 }
@@ -1340,6 +1356,17 @@ Status KuduScanner::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   return Status::OK();
 }
 
+Status KuduScanner::SetMaxStalenessMillis(int64_t max_staleness_millis) {
+  if (data_->open_) {
+    return Status::IllegalState("Max staleness must be set before Open()");
+  }
+  if (max_staleness_millis < 0) {
+    return Status::InvalidArgument("Max staleness must be non-negative");
+  }
+  data_->mutable_configuration()->SetMaxStalenessMillis(max_staleness_millis);
+  return Status::OK();
+}
+
 Status KuduScanner::SetSelection(KuduClient::ReplicaSelection selection) {
   if (data_->open_) {
     return Status::IllegalState("Replica selection must be set before Open()");
@@ -1403,6 +1430,7 @@ Status KuduScanner::SetRowFormatFlags(uint64_t flags) {
   switch (flags) {
     case NO_FLAGS:
     case PAD_UNIXTIME_MICROS_TO_16_BYTES:
+    case COLUMNAR_LAYOUT:
       break;
     default:
       return Status::InvalidArgument(Substitute("Invalid row format flags: $0", flags));
@@ -1542,6 +1570,24 @@ Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
+  if (PREDICT_FALSE(data_->configuration().row_format_flags() & COLUMNAR_LAYOUT)) {
+    return Status::IllegalState(
+        "Cannot extract rows from a columnar scan. "
+        "Use NextBatch(KuduColumnarScanBatch*) instead");
+  }
+  return NextBatch(batch->data_);
+}
+
+Status KuduScanner::NextBatch(KuduColumnarScanBatch* batch) {
+  if (PREDICT_FALSE(!(data_->configuration().row_format_flags() & COLUMNAR_LAYOUT))) {
+    return Status::IllegalState(
+        "Cannot extract columns from a row-wise scan. "
+        "Set the COLUMNAR_LAYOUT row format flag to scan columns");
+  }
+  return NextBatch(batch->data_);
+}
+
+Status KuduScanner::NextBatch(internal::ScanBatchDataInterface* batch) {
   // TODO: do some double-buffering here -- when we return this batch
   // we should already have fired off the RPC for the next batch, but
   // need to do some swapping of the response objects around to avoid
@@ -1549,7 +1595,7 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
   CHECK(data_->open_);
   CHECK(data_->proxy_);
 
-  batch->data_->Clear();
+  batch->Clear();
 
   if (data_->short_circuit_) {
     return Status::OK();
@@ -1559,12 +1605,11 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     // We have data from a previous scan.
     VLOG(2) << "Extracting data from " << data_->DebugString();
     data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                               data_->configuration().row_format_flags(),
-                               unique_ptr<RowwiseRowBlockPB>(
-                                   data_->last_response_.release_data()));
+    return batch->Reset(&data_->controller_,
+                        data_->configuration().projection(),
+                        data_->configuration().client_projection(),
+                        data_->configuration().row_format_flags(),
+                        &data_->last_response_);
   }
 
   if (data_->last_response_.has_more_results()) {
@@ -1584,12 +1629,11 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
           data_->last_primary_key_ = data_->last_response_.last_primary_key();
         }
         data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   data_->configuration().row_format_flags(),
-                                   unique_ptr<RowwiseRowBlockPB>(
-                                       data_->last_response_.release_data()));
+        return batch->Reset(&data_->controller_,
+                            data_->configuration().projection(),
+                            data_->configuration().client_projection(),
+                            data_->configuration().row_format_flags(),
+                            &data_->last_response_);
       }
 
       data_->scan_attempts_++;
@@ -1755,10 +1799,32 @@ Status KuduScanTokenBuilder::SetCacheBlocks(bool cache_blocks) {
   return data_->mutable_configuration()->SetCacheBlocks(cache_blocks);
 }
 
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->set_split_size_bytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::Build(vector<KuduScanToken*>* tokens) {
   return data_->Build(tokens);
 }
 
+////////////////////////////////////////////////////////////
+// KuduScanTokenExecutor
+////////////////////////////////////////////////////////////
+
+KuduScanTokenExecutor::KuduScanTokenExecutor(int num_threads)
+    : data_(new KuduScanTokenExecutor::Data(num_threads)) {
+}
+
+KuduScanTokenExecutor::~KuduScanTokenExecutor() {
+  delete data_;
+}
+
+Status KuduScanTokenExecutor::Run(const vector<KuduScanToken*>& tokens,
+                                  KuduScanBatchConsumer* consumer) {
+  return data_->Run(tokens, consumer);
+}
+
 ////////////////////////////////////////////////////////////
 // KuduReplica
 ////////////////////////////////////////////////////////////
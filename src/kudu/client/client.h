@@ -67,6 +67,7 @@ class LeaderMasterProxy;
 
 namespace client {
 
+class KuduColumnarScanBatch;
 class KuduDelete;
 class KuduInsert;
 class KuduLoggingCallback;
@@ -95,6 +96,7 @@ class MetaCache;
 class RemoteTablet;
 class RemoteTabletServer;
 class ReplicaController;
+class ScanBatchDataInterface;
 class WriteRpc;
 } // namespace internal
 
@@ -264,6 +266,21 @@ class KUDU_EXPORT KuduClientBuilder {
   /// @return Reference to the updated object.
   KuduClientBuilder& num_reactors(int num_reactors);
 
+  /// @brief Prefetch the locations of all of a table's tablets when it's opened.
+  ///
+  /// By default, the client looks up the location of a tablet the first time
+  /// it writes to or scans the tablet, fetching a few of the following tablets
+  /// along with it. For a table with many tablets, the first writes spread
+  /// across the table then wait on many lookups. With prefetching enabled,
+  /// KuduClient::OpenTable() starts loading the locations of all of the
+  /// table's tablets from the master in the background, in pages, so that
+  /// the first writes find them cached.
+  ///
+  /// @param [in] prefetch
+  ///   Whether to prefetch the tablet locations of opened tables.
+  /// @return Reference to the updated object.
+  KuduClientBuilder& prefetch_tablet_locations(bool prefetch);
+
   /// Create a client object.
   ///
   /// @note KuduClients objects are shared amongst multiple threads and,
@@ -1617,6 +1634,30 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   /// @return Operation result status.
   Status SetMutationBufferMaxNum(unsigned int max_num) WARN_UNUSED_RESULT;
 
+  /// Adapt the batching of write operations to the load of the tablet servers.
+  ///
+  /// With a static flush watermark and number of mutation buffers, a session
+  /// either under-utilizes the cluster or overloads it, depending on how busy
+  /// the tablet servers are. With adaptive flushing, the session measures
+  /// the round trip time of its writes to each tablet server, and notes when
+  /// a tablet server rejects a write because its RPC queue is full. Much as
+  /// in TCP congestion control, the number of mutation buffers being flushed
+  /// concurrently and the size at which they're flushed grow gradually while
+  /// the tablet servers respond promptly, and are halved when any of them is
+  /// overloaded, which bounds the latency of the writes.
+  ///
+  /// The flush watermark set by SetMutationBufferFlushWatermark() and
+  /// the limit set by SetMutationBufferMaxNum() remain the upper bounds.
+  /// By default, adaptive flushing is disabled.
+  ///
+  /// @note This setting is applicable only for AUTO_FLUSH_BACKGROUND sessions,
+  ///   except that the number of mutation buffers is adapted in any mode.
+  ///
+  /// @param [in] enable
+  ///   Whether to adapt the batching to the load of the tablet servers.
+  /// @return Operation result status.
+  Status SetMutationBufferAdaptiveFlush(bool enable) WARN_UNUSED_RESULT;
+
   /// Set the timeout for writes made in this session.
   ///
   /// @param [in] millis
@@ -2080,6 +2121,19 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status NextBatch(KuduScanBatch* batch);
 
+  /// Fetch the next batch of columnar results for this scanner.
+  ///
+  /// This requires that the scanner was configured with the COLUMNAR_LAYOUT
+  /// row format flag.
+  ///
+  /// A single KuduColumnarScanBatch object may be reused. Each subsequent call
+  /// replaces the data from the previous call, and invalidates any
+  /// Slices previously obtained from the batch.
+  /// @param [out] batch
+  ///   Placeholder for the result.
+  /// @return Operation result status.
+  Status NextBatch(KuduColumnarScanBatch* batch);
+
   /// Get the KuduTabletServer that is currently handling the scan.
   ///
   /// More concretely, this is the server that handled the most recent
@@ -2161,6 +2215,20 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetSnapshotRaw(uint64_t snapshot_timestamp) WARN_UNUSED_RESULT;
 
+  /// Allow a @c READ_AT_SNAPSHOT scan with no snapshot timestamp set to read
+  /// a snapshot up to the given time in the past.
+  ///
+  /// A replica whose applied state is recent enough then serves the scan
+  /// without waiting to hear from the tablet's leader, so such scans stay
+  /// available and fast on followers while the tablet has no leader.
+  /// The snapshot timestamp picked by the first tablet server scanned is
+  /// used for the rest of the scan, as for other @c READ_AT_SNAPSHOT scans.
+  ///
+  /// @param [in] max_staleness_millis
+  ///   The maximum staleness of the snapshot, in milliseconds.
+  /// @return Operation result status.
+  Status SetMaxStalenessMillis(int64_t max_staleness_millis) WARN_UNUSED_RESULT;
+
   /// Set the maximum time that Open() and NextBatch() are allowed to take.
   ///
   /// @param [in] millis
@@ -2188,6 +2256,13 @@ class KUDU_EXPORT KuduScanner {
   ///   results and might even cause the client to crash.
   static const uint64_t PAD_UNIXTIME_MICROS_TO_16_BYTES = 1 << 0;
 
+  /// Makes the server return the rows column by column, rather than row by
+  /// row. The results must then be fetched with
+  /// NextBatch(KuduColumnarScanBatch*); see KuduColumnarScanBatch for the
+  /// format of each column.
+  /// @note This flag can't be combined with PAD_UNIXTIME_MICROS_TO_16_BYTES.
+  static const uint64_t COLUMNAR_LAYOUT = 1 << 1;
+
   /// Optionally set row format modifier flags.
   ///
   /// If flags is RowFormatFlags::NO_FLAGS, then no modifications will be made to the row
@@ -2235,6 +2310,8 @@ class KUDU_EXPORT KuduScanner {
  private:
   class KUDU_NO_EXPORT Data;
 
+  Status NextBatch(internal::ScanBatchDataInterface* batch);
+
   friend class KuduScanToken;
   FRIEND_TEST(ClientTest, TestBlockScannerHijackingAttempts);
   FRIEND_TEST(ClientTest, TestScanCloseProxy);
@@ -2411,6 +2488,24 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Split each tablet's scan into tokens of roughly the given size.
+  ///
+  /// By default, a token is built for each tablet, so a scan of a table with
+  /// a few large tablets parallelizes poorly. With a split size set, the
+  /// tablet servers are asked to divide each tablet's primary key range into
+  /// chunks of about @c split_size_bytes each, estimated from the sizes of
+  /// the tablet's rowsets and of the projected columns, and a token is built
+  /// for each chunk.
+  ///
+  /// @note The sizes are estimates: data which hasn't yet been flushed
+  ///   to disk isn't counted, so tokens may be larger than the split size.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The target size of each token's scan, in bytes. Use @c 0 to build
+  ///   a single token per tablet.
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -2430,6 +2525,66 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   DISALLOW_COPY_AND_ASSIGN(KuduScanTokenBuilder);
 };
 
+/// @brief The interface for consumers of the batches of a KuduScanTokenExecutor.
+class KUDU_EXPORT KuduScanBatchConsumer {
+ public:
+  virtual ~KuduScanBatchConsumer() {}
+
+  /// Consume a batch of rows.
+  ///
+  /// This method is called concurrently from the executor's threads, each
+  /// with the batches of a different token, so it must be thread-safe.
+  ///
+  /// @param [in] token
+  ///   The token whose scan returned the batch.
+  /// @param [in] batch
+  ///   The batch of rows. The batch is valid only until the method returns.
+  /// @return Operation result status. If it is not OK, the executor stops
+  ///   scanning and returns the status.
+  virtual Status Consume(const KuduScanToken& token, KuduScanBatch* batch) = 0;
+};
+
+/// @brief Scans a set of scan tokens in parallel.
+///
+/// The executor turns each scan token into a scanner, and runs the scanners
+/// on a pool of threads, passing their batches to the consumer as they
+/// arrive. Combined with KuduScanTokenBuilder::SetSplitSizeBytes(), this
+/// spreads a scan evenly across the threads however the table's data is
+/// distributed among its tablets.
+///
+/// @note This class is not thread-safe.
+class KUDU_EXPORT KuduScanTokenExecutor {
+ public:
+  /// Construct an instance of the class.
+  ///
+  /// @param [in] num_threads
+  ///   The number of tokens to scan concurrently; at least 1.
+  explicit KuduScanTokenExecutor(int num_threads);
+  ~KuduScanTokenExecutor();
+
+  /// Scan the given tokens, and wait for the scans to finish.
+  ///
+  /// @param [in] tokens
+  ///   The tokens to scan. The executor doesn't take ownership of the tokens,
+  ///   which must remain valid until the method returns.
+  /// @param [in] consumer
+  ///   The consumer of the scanned batches, which must remain valid until
+  ///   the method returns.
+  /// @return Operation result status. If any scan fails, or the consumer
+  ///   returns an error, the remaining scans are stopped and the first error
+  ///   is returned.
+  Status Run(const std::vector<KuduScanToken*>& tokens,
+             KuduScanBatchConsumer* consumer) WARN_UNUSED_RESULT;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduScanTokenExecutor);
+};
+
 /// @brief Builder for Partitioner instances.
 class KUDU_EXPORT KuduPartitionerBuilder {
  public:
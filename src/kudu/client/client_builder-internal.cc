@@ -25,7 +25,8 @@ namespace client {
 KuduClientBuilder::Data::Data()
     : default_admin_operation_timeout_(MonoDelta::FromSeconds(30)),
       default_rpc_timeout_(MonoDelta::FromSeconds(10)),
-      replica_visibility_(internal::ReplicaController::Visibility::VOTERS) {
+      replica_visibility_(internal::ReplicaController::Visibility::VOTERS),
+      prefetch_tablet_locations_(false) {
 }
 
 KuduClientBuilder::Data::~Data() {
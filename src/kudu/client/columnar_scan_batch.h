@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_COLUMNAR_SCAN_BATCH_H
+#define KUDU_CLIENT_COLUMNAR_SCAN_BATCH_H
+
+#ifdef KUDU_HEADERS_NO_STUBS
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#else
+#include "kudu/client/stubs.h"
+#endif
+
+#include "kudu/util/kudu_export.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace client {
+
+class KuduSchema;
+
+/// @brief A batch of columnar data returned from a scanner
+///
+/// Every call to KuduScanner::NextBatch(KuduColumnarScanBatch*) returns
+/// a batch of zero or more rows, laid out column by column. This requires
+/// that the scanner was configured with the KuduScanner::COLUMNAR_LAYOUT
+/// row format flag.
+///
+/// Each column's data is in the format of the corresponding column of the
+/// scanner's projection:
+///
+/// - For fixed-size types, the cells are laid out back to back, each in the
+///   same little-endian format as used by KuduScanBatch::RowPtr. NULL cells
+///   are zeroed.
+/// - For variable-length types (STRING and BINARY), the cells are in a data
+///   buffer, and their positions are given by NumRows() + 1 little-endian
+///   32-bit offsets: cell 'i' spans from offset 'i' to offset 'i + 1'.
+///   NULL cells are empty.
+/// - For nullable columns, bit 'i' of the non-null bitmap is set if cell 'i'
+///   is not NULL.
+///
+/// @note The Slices returned by this class are only valid for the lifetime
+///   of the batch, or until it's used for another call to NextBatch().
+class KUDU_EXPORT KuduColumnarScanBatch {
+ public:
+  KuduColumnarScanBatch();
+  ~KuduColumnarScanBatch();
+
+  /// @return The number of rows in this batch.
+  int NumRows() const;
+
+  /// Get the cells of a fixed-size column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] data
+  ///   The column's cells.
+  /// @return Operation result status. Returns InvalidArgument if the column
+  ///   is of a variable-length type.
+  Status GetFixedLengthColumn(int idx, Slice* data) const;
+
+  /// Get the cells of a variable-length column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] offsets
+  ///   The offsets of the cells in 'data'.
+  /// @param [out] data
+  ///   The bytes of the cells.
+  /// @return Operation result status. Returns InvalidArgument if the column
+  ///   is of a fixed-size type.
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const;
+
+  /// Get the non-null bitmap of a column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] data
+  ///   The bitmap, or an empty Slice if the column isn't nullable, in which
+  ///   case none of its cells are NULL.
+  /// @return Operation result status.
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const;
+
+  /// @return The projection schema for this batch.
+  const KuduSchema* projection_schema() const;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+  friend class KuduScanner;
+
+  Data* data_;
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnarScanBatch);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
@@ -18,6 +18,7 @@
 #include "kudu/client/meta_cache.h"
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <set>
@@ -750,6 +751,74 @@ void LookupRpc::SendRpcCb(const Status& status) {
   user_cb_.Run(new_status);
 }
 
+// Loads the locations of all of a table's tablets with a chain of range
+// lookups, each of which starts where the cached entries run out. Deletes
+// itself once the whole table is cached, or a lookup fails.
+class TableLocationsPrefetcher {
+ public:
+  TableLocationsPrefetcher(scoped_refptr<MetaCache> meta_cache,
+                           sp::shared_ptr<KuduTable> table,
+                           const MonoTime& deadline,
+                           ReplicaController::Visibility replica_visibility)
+      : meta_cache_(std::move(meta_cache)),
+        table_(std::move(table)),
+        deadline_(deadline),
+        replica_visibility_(replica_visibility),
+        num_lookups_(0) {
+  }
+
+  // Sends the lookup of the next range which isn't cached.
+  void Run() {
+    string next_key = partition_key_;
+    if (!meta_cache_->NextUncachedPartitionKey(table_->id(), &next_key) ||
+        (num_lookups_ > 0 && next_key <= partition_key_)) {
+      // Either the whole table is cached, or the last lookup made no progress
+      // (e.g. if the master returns locations which are already stale).
+      VLOG(2) << "Prefetched the locations of table " << table_->name()
+              << " in " << num_lookups_ << " lookup(s)";
+      delete this;
+      return;
+    }
+    partition_key_ = std::move(next_key);
+    num_lookups_++;
+    LookupRpc* rpc = new LookupRpc(meta_cache_,
+                                   Bind(&TableLocationsPrefetcher::LookupFinished,
+                                        Unretained(this)),
+                                   table_.get(),
+                                   partition_key_,
+                                   nullptr,
+                                   deadline_,
+                                   MetaCache::LookupType::kLowerBound,
+                                   replica_visibility_);
+    rpc->SendRpcSlowPath();
+  }
+
+ private:
+  void LookupFinished(const Status& s) {
+    if (!s.ok()) {
+      // NotFound means there are no tablets beyond the last lookup key.
+      if (!s.IsNotFound()) {
+        KLOG_EVERY_N_SECS(WARNING, 1) << "Failed to prefetch the locations of table "
+                                      << table_->name() << ": " << s.ToString();
+      }
+      delete this;
+      return;
+    }
+    Run();
+  }
+
+  const scoped_refptr<MetaCache> meta_cache_;
+  const sp::shared_ptr<KuduTable> table_;
+  const MonoTime deadline_;
+  const ReplicaController::Visibility replica_visibility_;
+
+  // The start of the range of the last lookup.
+  string partition_key_;
+  int num_lookups_;
+
+  DISALLOW_COPY_AND_ASSIGN(TableLocationsPrefetcher);
+};
+
 Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
                                         MetaCacheEntry* cache_entry,
                                         int max_returned_locations) {
@@ -760,8 +829,11 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
       MonoDelta::FromMilliseconds(rpc.resp().ttl_millis());
 
   std::lock_guard<percpu_rwlock> l(lock_);
-  TabletMap& tablets_by_key = LookupOrInsert(&tablets_by_table_and_key_,
-                                             rpc.table_id(), TabletMap());
+  // Update a copy of the table's tablets, and replace the table's snapshot
+  // with it once it's complete.
+  shared_ptr<const TabletMap>* snapshot = &LookupOrInsert(
+      &tablets_by_table_and_key_, rpc.table_id(), nullptr);
+  TabletMap tablets_by_key = *snapshot ? **snapshot : TabletMap();
 
   const auto& tablet_locations = rpc.resp().tablet_locations();
 
@@ -894,14 +966,22 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
     *cache_entry = FindFloorOrDie(tablets_by_key, cache_entry->upper_bound_partition_key());
     DCHECK(!cache_entry->is_non_covered_range());
   }
+  *snapshot = std::make_shared<const TabletMap>(std::move(tablets_by_key));
   return Status::OK();
 }
 
+shared_ptr<const MetaCache::TabletMap> MetaCache::GetTabletMap(
+    const string& table_id) const {
+  shared_lock<rw_spinlock> l(lock_.get_lock());
+  const shared_ptr<const TabletMap>* tablets =
+      FindOrNull(tablets_by_table_and_key_, table_id);
+  return tablets ? *tablets : nullptr;
+}
+
 bool MetaCache::LookupEntryByKeyFastPath(const KuduTable* table,
                                          const string& partition_key,
                                          MetaCacheEntry* entry) {
-  shared_lock<rw_spinlock> l(lock_.get_lock());
-  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
+  const shared_ptr<const TabletMap> tablets = GetTabletMap(table->id());
   if (PREDICT_FALSE(!tablets)) {
     // No cache available for this table.
     return false;
@@ -954,19 +1034,45 @@ void MetaCache::ClearNonCoveredRangeEntries(const std::string& table_id) {
   VLOG(3) << "Clearing non-covered range entries of table " << table_id;
   std::lock_guard<percpu_rwlock> l(lock_);
 
-  TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table_id);
-  if (PREDICT_FALSE(!tablets)) {
+  shared_ptr<const TabletMap>* snapshot = FindOrNull(tablets_by_table_and_key_, table_id);
+  if (PREDICT_FALSE(!snapshot || !*snapshot)) {
     // No cache available for this table.
     return;
   }
 
-  for (auto it = tablets->begin(); it != tablets->end();) {
+  TabletMap tablets(**snapshot);
+  for (auto it = tablets.begin(); it != tablets.end();) {
     if (it->second.is_non_covered_range()) {
-      it = tablets->erase(it);
+      it = tablets.erase(it);
     } else {
       it++;
     }
   }
+  *snapshot = std::make_shared<const TabletMap>(std::move(tablets));
+}
+
+bool MetaCache::NextUncachedPartitionKey(const string& table_id,
+                                         string* partition_key) {
+  const shared_ptr<const TabletMap> tablets = GetTabletMap(table_id);
+  if (!tablets) {
+    return true;
+  }
+  while (true) {
+    const MetaCacheEntry* e = FindFloorOrNull(*tablets, *partition_key);
+    if (!e || e->stale() || !e->Contains(*partition_key)) {
+      return true;
+    }
+    if (e->upper_bound_partition_key().empty()) {
+      return false;
+    }
+    *partition_key = e->upper_bound_partition_key();
+  }
+}
+
+void MetaCache::PrefetchTableLocations(sp::shared_ptr<KuduTable> table,
+                                       const MonoTime& deadline) {
+  (new TableLocationsPrefetcher(this, std::move(table), deadline,
+                                replica_visibility_))->Run();
 }
 
 void MetaCache::ClearCache() {
@@ -32,6 +32,7 @@
 #include <gtest/gtest_prod.h>
 
 #include "kudu/client/replica_controller-internal.h"
+#include "kudu/client/shared_ptr.h"
 #include "kudu/common/partition.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/gutil/macros.h"
@@ -61,6 +62,7 @@ namespace client {
 
 class ClientTest_TestMasterLookupPermits_Test;
 class ClientTest_TestMetaCacheExpiry_Test;
+class ClientTest_TestPrefetchTabletLocations_Test;
 class KuduClient;
 class KuduTable;
 
@@ -77,6 +79,7 @@ const int kFetchTabletsPerRangeLookup = 1000;
 
 class LookupRpc;
 class MetaCache;
+class TableLocationsPrefetcher;
 class RemoteTablet;
 
 // The information cached about a given tablet server in the cluster.
@@ -405,6 +408,14 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                          scoped_refptr<RemoteTablet>* remote_tablet,
                          const StatusCallback& callback);
 
+  // Loads the locations of all of the table's tablets into the cache in
+  // the background, a page of kFetchTabletsPerRangeLookup tablets at a time,
+  // so that the first writes to each tablet needn't wait on the master.
+  // Ranges which are already cached aren't fetched again. 'table' is kept
+  // alive until the prefetch finishes or 'deadline' passes.
+  void PrefetchTableLocations(client::sp::shared_ptr<KuduTable> table,
+                              const MonoTime& deadline);
+
   // Clears the non-covered range entries from a table's meta cache.
   void ClearNonCoveredRangeEntries(const std::string& table_id);
 
@@ -428,9 +439,11 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
 
  private:
   friend class LookupRpc;
+  friend class TableLocationsPrefetcher;
 
   FRIEND_TEST(client::ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(client::ClientTest, TestMetaCacheExpiry);
+  FRIEND_TEST(client::ClientTest, TestPrefetchTabletLocations);
 
   // Called on the slow LookupTablet path when the master responds. Populates
   // the tablet caches and returns a reference to the first one.
@@ -464,9 +477,15 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
   // NOTE: Must be called with lock_ held.
   void UpdateTabletServer(const master::TSInfoPB& pb);
 
+  // Returns the partition key at which the fresh entries cached for the table
+  // starting from 'partition_key' run out, or false if they cover the rest of
+  // the table's partition key space.
+  bool NextUncachedPartitionKey(const std::string& table_id,
+                                std::string* partition_key);
+
   KuduClient* client_;
 
-  percpu_rwlock lock_;
+  mutable percpu_rwlock lock_;
 
   // Cache of Tablet Server locations: TS UUID -> RemoteTabletServer*.
   //
@@ -478,14 +497,22 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
   TabletServerMap ts_cache_;
 
   // Cache of tablets, keyed by partition key.
-  //
-  // Protected by lock_.
   typedef std::map<std::string, MetaCacheEntry> TabletMap;
 
+  // Returns the current snapshot of the table's tablets, or NULL if none are
+  // cached. The snapshot is immutable, so it can be searched without holding
+  // lock_, which is held only to copy the pointer.
+  std::shared_ptr<const TabletMap> GetTabletMap(const std::string& table_id) const;
+
   // Cache of tablets and non-covered ranges, keyed by table id.
   //
+  // Each table's map is copied on write: an update builds a new map and
+  // replaces the table's snapshot, so that lookups of the table's tablets
+  // never see it change underneath them.
+  //
   // Protected by lock_.
-  std::unordered_map<std::string, TabletMap> tablets_by_table_and_key_;
+  std::unordered_map<std::string, std::shared_ptr<const TabletMap>>
+      tablets_by_table_and_key_;
 
   // Cache of tablets, keyed by tablet ID.
   //
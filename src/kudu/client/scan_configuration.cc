@@ -181,6 +181,10 @@ void ScanConfiguration::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   snapshot_timestamp_ = snapshot_timestamp;
 }
 
+void ScanConfiguration::SetMaxStalenessMillis(int64_t max_staleness_millis) {
+  max_staleness_ = MonoDelta::FromMilliseconds(max_staleness_millis);
+}
+
 void ScanConfiguration::SetScanLowerBoundTimestampRaw(uint64_t propagation_timestamp) {
   lower_bound_propagation_timestamp_ = propagation_timestamp;
 }
@@ -90,6 +90,10 @@ class ScanConfiguration {
   // Requires READ_AT_SNAPSHOT scan mode.
   void SetSnapshotRaw(uint64_t snapshot_timestamp);
 
+  // Sets how far in the past the server may pick the snapshot of a
+  // READ_AT_SNAPSHOT scan with no snapshot timestamp.
+  void SetMaxStalenessMillis(int64_t max_staleness_millis);
+
   // Set the lower bound of scan's propagation timestamp.
   // It is only used in READ_YOUR_WRITES scan mode.
   void SetScanLowerBoundTimestampRaw(uint64_t propagation_timestamp);
@@ -163,6 +167,10 @@ class ScanConfiguration {
     return lower_bound_propagation_timestamp_;
   }
 
+  const MonoDelta& max_staleness() const {
+    return max_staleness_;
+  }
+
   const MonoDelta& timeout() const {
     return timeout_;
   }
@@ -205,6 +213,9 @@ class ScanConfiguration {
 
   uint64_t lower_bound_propagation_timestamp_;
 
+  // Uninitialized unless the scan allows a stale snapshot.
+  MonoDelta max_staleness_;
+
   MonoDelta timeout_;
 
   // Manages interior allocations for the scan spec and copied bounds.
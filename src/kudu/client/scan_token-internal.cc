@@ -17,8 +17,10 @@
 
 #include "kudu/client/scan_token-internal.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -30,6 +32,7 @@
 #include "kudu/client/client.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/replica-internal.h"
+#include "kudu/client/scan_batch.h"
 #include "kudu/client/scanner-internal.h"
 #include "kudu/client/schema.h"
 #include "kudu/client/shared_ptr.h"
@@ -45,14 +48,20 @@
 #include "kudu/common/types.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/metadata.pb.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/async_util.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 
 using std::string;
 using std::unique_ptr;
@@ -210,7 +219,44 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
 }
 
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::SplitKeyRange(
+    const scoped_refptr<internal::RemoteTablet>& tablet,
+    const ScanTokenPB& pb,
+    const MonoTime& deadline,
+    vector<KeyRangePB>* ranges) {
+  KuduClient* client = configuration_.table_->client();
+  internal::RemoteTabletServer* ts;
+  vector<internal::RemoteTabletServer*> candidates;
+  RETURN_NOT_OK(client->data_->GetTabletServer(client, tablet, configuration_.selection(),
+                                               {}, &candidates, &ts));
+
+  tserver::SplitKeyRangeRequestPB req;
+  req.set_tablet_id(tablet->tablet_id());
+  if (pb.has_lower_bound_primary_key()) {
+    req.set_start_primary_key(pb.lower_bound_primary_key());
+  }
+  if (pb.has_upper_bound_primary_key()) {
+    req.set_stop_primary_key(pb.upper_bound_primary_key());
+  }
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+  *req.mutable_columns() = pb.projected_columns();
+
+  tserver::SplitKeyRangeResponsePB resp;
+  rpc::RpcController controller;
+  controller.set_deadline(deadline);
+  RETURN_NOT_OK_PREPEND(ts->proxy()->SplitKeyRange(req, &resp, &controller),
+                        Substitute("unable to split the key range of tablet $0",
+                                   tablet->tablet_id()));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status()).CloneAndPrepend(
+        Substitute("unable to split the key range of tablet $0", tablet->tablet_id()));
+  }
+  ranges->assign(resp.ranges().begin(), resp.ranges().end());
+  return Status::OK();
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -341,28 +387,120 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
       client_replicas.push_back(client_replica.release());
     }
 
-    unique_ptr<KuduTablet> client_tablet(new KuduTablet);
-    client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
-                                                std::move(client_replicas));
-    client_replicas.clear();
-
-    // Create the scan token itself.
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(
-        tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(
-        tablet->partition().partition_key_end());
-    unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
-    client_scan_token->data_ =
-        new KuduScanToken::Data(table,
-                                std::move(message),
-                                std::move(client_tablet));
-    tokens->push_back(client_scan_token.release());
+    // Split the tablet's primary key range into chunks, if requested. The
+    // chunks cover the whole range, so a tablet which can't be split gets
+    // a single token.
+    vector<KeyRangePB> ranges;
+    if (split_size_bytes_ > 0) {
+      RETURN_NOT_OK(SplitKeyRange(tablet, pb, deadline, &ranges));
+    }
+    if (ranges.empty()) {
+      ranges.emplace_back();
+    }
+
+    for (const auto& range : ranges) {
+      // Each token has its own copy of the tablet's locations.
+      vector<const KuduReplica*> token_replicas;
+      ElementDeleter token_replicas_deleter(&token_replicas);
+      for (const KuduReplica* r : client_replicas) {
+        const KuduTabletServer::Data* ts_data = r->data_->ts_->data_;
+        unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
+        client_ts->data_ = new KuduTabletServer::Data(ts_data->uuid_,
+                                                      ts_data->hp_,
+                                                      ts_data->location_);
+        unique_ptr<KuduReplica> client_replica(new KuduReplica);
+        client_replica->data_ = new KuduReplica::Data(r->data_->is_leader_,
+                                                      r->data_->is_voter_,
+                                                      std::move(client_ts));
+        token_replicas.push_back(client_replica.release());
+      }
+      unique_ptr<KuduTablet> client_tablet(new KuduTablet);
+      client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
+                                                  std::move(token_replicas));
+      token_replicas.clear();
+
+      // Create the scan token itself.
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(
+          tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(
+          tablet->partition().partition_key_end());
+      if (range.has_start_primary_key()) {
+        message.set_lower_bound_primary_key(range.start_primary_key());
+      }
+      if (range.has_stop_primary_key()) {
+        message.set_upper_bound_primary_key(range.stop_primary_key());
+      }
+      unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
+      client_scan_token->data_ =
+          new KuduScanToken::Data(table,
+                                  std::move(message),
+                                  std::move(client_tablet));
+      tokens->push_back(client_scan_token.release());
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
 }
 
+KuduScanTokenExecutor::Data::Data(int num_threads)
+    : num_threads_(std::max(1, num_threads)),
+      failed_(false) {
+}
+
+Status KuduScanTokenExecutor::Data::Run(const vector<KuduScanToken*>& tokens,
+                                        KuduScanBatchConsumer* consumer) {
+  first_error_ = Status::OK();
+  failed_ = false;
+
+  gscoped_ptr<ThreadPool> pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("scan-tokens")
+                .set_min_threads(0)
+                .set_max_threads(num_threads_)
+                .Build(&pool));
+  for (const KuduScanToken* token : tokens) {
+    Status s = pool->SubmitFunc([this, token, consumer]() { ScanToken(token, consumer); });
+    if (PREDICT_FALSE(!s.ok())) {
+      // Stop the scans which were already submitted.
+      failed_ = true;
+      pool->Wait();
+      return s;
+    }
+  }
+  pool->Wait();
+  pool->Shutdown();
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  return first_error_;
+}
+
+void KuduScanTokenExecutor::Data::ScanToken(const KuduScanToken* token,
+                                            KuduScanBatchConsumer* consumer) {
+  if (failed_) {
+    return;
+  }
+  Status s = [&]() {
+    KuduScanner* scanner_ptr;
+    RETURN_NOT_OK(token->IntoKuduScanner(&scanner_ptr));
+    unique_ptr<KuduScanner> scanner(scanner_ptr);
+    RETURN_NOT_OK(scanner->Open());
+    KuduScanBatch batch;
+    while (scanner->HasMoreRows() && !failed_) {
+      RETURN_NOT_OK(scanner->NextBatch(&batch));
+      RETURN_NOT_OK(consumer->Consume(*token, &batch));
+    }
+    return Status::OK();
+  }();
+  if (PREDICT_FALSE(!s.ok())) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (first_error_.ok()) {
+      first_error_ = s.CloneAndPrepend(Substitute(
+          "unable to scan tablet $0", token->tablet().id()));
+    }
+    failed_ = true;
+  }
+}
+
 } // namespace client
 } // namespace kudu
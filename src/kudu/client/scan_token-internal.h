@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,11 +26,19 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/scan_configuration.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -72,8 +82,43 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void set_split_size_bytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Asks a replica of 'tablet' to split the primary key range of the token
+  // 'pb' into ranges of about split_size_bytes_ each.
+  Status SplitKeyRange(const scoped_refptr<internal::RemoteTablet>& tablet,
+                       const ScanTokenPB& pb,
+                       const MonoTime& deadline,
+                       std::vector<KeyRangePB>* ranges);
+
   ScanConfiguration configuration_;
+
+  // If non-zero, the target size of each token's scan.
+  uint64_t split_size_bytes_;
+};
+
+class KuduScanTokenExecutor::Data {
+ public:
+  explicit Data(int num_threads);
+
+  Status Run(const std::vector<KuduScanToken*>& tokens,
+             KuduScanBatchConsumer* consumer);
+
+ private:
+  // Scans 'token', passing its batches to 'consumer', unless another scan
+  // has failed. Records the first failure.
+  void ScanToken(const KuduScanToken* token, KuduScanBatchConsumer* consumer);
+
+  const int num_threads_;
+
+  simple_spinlock lock_;
+  Status first_error_; // Protected by lock_.
+
+  // Set once a scan fails, to stop the other scans.
+  std::atomic<bool> failed_;
 };
 
 } // namespace client
@@ -42,9 +42,13 @@
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/mini-cluster/internal_mini_cluster.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_replica.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
@@ -64,6 +68,7 @@ using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
+using tablet::TabletReplica;
 using tserver::MiniTabletServer;
 
 class ScanTokenTest : public KuduTest {
@@ -323,6 +328,88 @@ TEST_F(ScanTokenTest, TestScanTokens) {
   }
 }
 
+// Counts the rows of the batches passed to it.
+class RowCountingConsumer : public KuduScanBatchConsumer {
+ public:
+  RowCountingConsumer() : rows_(0) {}
+
+  Status Consume(const KuduScanToken& /*token*/, KuduScanBatch* batch) override {
+    rows_ += batch->NumRows();
+    return Status::OK();
+  }
+
+  int rows() const { return rows_; }
+
+ private:
+  atomic<int> rows_;
+};
+
+// Check that a tablet's scan is split into tokens by size, and that
+// the tokens cover all of the tablet's rows.
+TEST_F(ScanTokenTest, TestSplitSizeBytes) {
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    ASSERT_OK(builder.Build(&schema));
+  }
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({})
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  // Write the rows of the single tablet in disjoint ranges, flushing each range
+  // to its own rowset, so there are rowset bounds to split at.
+  const int kNumRowSets = 4;
+  const int kRowsPerRowSet = 500;
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  vector<scoped_refptr<TabletReplica>> replicas;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletReplicas(&replicas);
+  ASSERT_EQ(1, replicas.size());
+  for (int i = 0; i < kNumRowSets * kRowsPerRowSet; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(session->Apply(insert.release()));
+    if ((i + 1) % kRowsPerRowSet == 0) {
+      ASSERT_OK(session->Flush());
+      ASSERT_OK(replicas[0]->tablet()->Flush());
+    }
+  }
+
+  {
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+  }
+
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  KuduScanTokenBuilder builder(table.get());
+  ASSERT_OK(builder.SetSplitSizeBytes(1));
+  ASSERT_OK(builder.Build(&tokens));
+  ASSERT_GT(tokens.size(), 1);
+  for (const auto* token : tokens) {
+    ASSERT_EQ(replicas[0]->tablet_id(), token->tablet().id());
+  }
+  ASSERT_EQ(kNumRowSets * kRowsPerRowSet, CountRows(tokens));
+
+  // The executor scans the same rows.
+  RowCountingConsumer consumer;
+  KuduScanTokenExecutor executor(3);
+  ASSERT_OK(executor.Run(tokens, &consumer));
+  ASSERT_EQ(kNumRowSets * kRowsPerRowSet, consumer.rows());
+}
+
 TEST_F(ScanTokenTest, TestScanTokensWithNonCoveringRange) {
   // Create schema
   KuduSchema schema;
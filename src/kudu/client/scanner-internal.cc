@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <map>
 #include <ostream>
 #include <string>
 #include <unordered_map>
@@ -36,6 +37,7 @@
 #include "kudu/common/partition.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/types.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -214,6 +216,14 @@ void KuduScanner::Data::UpdateResourceMetrics() {
       }
     }
   }
+
+  // The resources the server reported using to handle the RPC, prefixed so
+  // that they're not confused with the scan-specific metrics above.
+  std::map<string, int64_t> server_metrics;
+  controller_.GetServerResourceMetrics(&server_metrics);
+  for (const auto& e : server_metrics) {
+    resource_metrics_.Increment("server_" + e.first, e.second);
+  }
 }
 
 string KuduScanner::Data::DebugString() const {
@@ -320,12 +330,16 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
 
   controller_.Reset();
   controller_.set_deadline(rpc_deadline);
+  controller_.set_request_server_resource_metrics(true);
   if (!configuration_.spec().predicates().empty()) {
     controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
   }
   if (configuration().row_format_flags() & KuduScanner::PAD_UNIXTIME_MICROS_TO_16_BYTES) {
     controller_.RequireServerFeature(TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES);
   }
+  if (configuration().row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    controller_.RequireServerFeature(TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE);
+  }
   ScanRpcStatus scan_status = AnalyzeResponse(
       proxy_->Scan(next_req_,
                    &last_response_,
@@ -333,7 +347,8 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
       rpc_deadline, overall_deadline);
   if (scan_status.result == ScanRpcStatus::OK) {
     UpdateResourceMetrics();
-    num_rows_returned_ += last_response_.data().num_rows();
+    num_rows_returned_ += last_response_.has_columnar_data() ?
+        last_response_.columnar_data().num_rows() : last_response_.data().num_rows();
   }
   return scan_status;
 }
@@ -359,6 +374,8 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
       scan->set_read_mode(kudu::READ_AT_SNAPSHOT);
       if (configuration_.has_snapshot_timestamp()) {
         scan->set_snap_timestamp(configuration_.snapshot_timestamp());
+      } else if (configuration_.max_staleness().Initialized()) {
+        scan->set_max_staleness_us(configuration_.max_staleness().ToMicroseconds());
       }
       break;
     case KuduScanner::READ_YOUR_WRITES:
@@ -505,12 +522,14 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
 
   next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data() && last_response_.data().num_rows() > 0;
+  data_in_open_ = (last_response_.has_data() && last_response_.data().num_rows() > 0) ||
+                  (last_response_.has_columnar_data() &&
+                   last_response_.columnar_data().num_rows() > 0);
   if (last_response_.has_more_results()) {
     next_req_.set_scanner_id(last_response_.scanner_id());
     VLOG(2) << "Opened tablet " << remote_->tablet_id()
             << ", scanner ID " << last_response_.scanner_id();
-  } else if (last_response_.has_data()) {
+  } else if (last_response_.has_data() || last_response_.has_columnar_data()) {
     VLOG(2) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
   } else {
     VLOG(2) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
@@ -614,8 +633,10 @@ Status KuduScanBatch::Data::Reset(RpcController* controller,
                                   const Schema* projection,
                                   const KuduSchema* client_projection,
                                   uint64_t row_format_flags,
-                                  unique_ptr<RowwiseRowBlockPB> resp_data) {
+                                  tserver::ScanResponsePB* response) {
+  DCHECK(!(row_format_flags & KuduScanner::COLUMNAR_LAYOUT));
   CHECK(controller->finished());
+  unique_ptr<RowwiseRowBlockPB> resp_data(response->release_data());
   controller_.Swap(controller);
   projection_ = projection;
   projected_row_size_ = CalculateProjectedRowSize(*projection_);
@@ -692,5 +713,144 @@ void KuduScanBatch::Data::Clear() {
   controller_.Reset();
 }
 
+////////////////////////////////////////////////////////////
+// KuduColumnarScanBatch
+////////////////////////////////////////////////////////////
+
+KuduColumnarScanBatch::Data::Data() : projection_(nullptr), client_projection_(nullptr) {}
+
+KuduColumnarScanBatch::Data::~Data() {}
+
+Status KuduColumnarScanBatch::Data::Reset(RpcController* controller,
+                                          const Schema* projection,
+                                          const KuduSchema* client_projection,
+                                          uint64_t row_format_flags,
+                                          tserver::ScanResponsePB* response) {
+  DCHECK(row_format_flags & KuduScanner::COLUMNAR_LAYOUT);
+  CHECK(controller->finished());
+  controller_.Swap(controller);
+  projection_ = projection;
+  client_projection_ = client_projection;
+  columns_.clear();
+  if (!response->has_columnar_data()) {
+    // No new data; just clear out the old stuff.
+    resp_data_.Clear();
+    return Status::OK();
+  }
+
+  // There's new data. Swap it in and find its sidecars.
+  resp_data_.Swap(response->mutable_columnar_data());
+  response->clear_columnar_data();
+  if (resp_data_.num_rows() == 0) {
+    return Status::OK();
+  }
+  if (PREDICT_FALSE(resp_data_.columns_size() != projection_->num_columns())) {
+    return Status::Corruption(Substitute(
+        "Server sent invalid response: $0 columns, expected $1",
+        resp_data_.columns_size(), projection_->num_columns()));
+  }
+
+  const auto get_sidecar = [&](int sidecar_idx, Slice* data) {
+    Status s = controller_.GetInboundSidecar(sidecar_idx, data);
+    if (!s.ok()) {
+      return Status::Corruption("Server sent invalid response: "
+          "column sidecar index corrupt", s.ToString());
+    }
+    return Status::OK();
+  };
+  const size_t num_rows = resp_data_.num_rows();
+  columns_.resize(resp_data_.columns_size());
+  for (int i = 0; i < resp_data_.columns_size(); i++) {
+    const ColumnarRowBlockPB::Column& col_pb = resp_data_.columns(i);
+    const ColumnSchema& col = projection_->column(i);
+    Column* dst = &columns_[i];
+    if (PREDICT_FALSE(!col_pb.has_data_sidecar())) {
+      return Status::Corruption(Substitute(
+          "Server sent invalid response: no data for column $0", col.name()));
+    }
+    RETURN_NOT_OK(get_sidecar(col_pb.data_sidecar(), &dst->data));
+    if (col_pb.has_varlen_data_sidecar()) {
+      RETURN_NOT_OK(get_sidecar(col_pb.varlen_data_sidecar(), &dst->varlen_data));
+    }
+    if (col_pb.has_non_null_bitmap_sidecar()) {
+      RETURN_NOT_OK(get_sidecar(col_pb.non_null_bitmap_sidecar(), &dst->non_null_bitmap));
+    }
+
+    // Validate the sizes of the buffers, so that the accessors can hand them
+    // out without further checks.
+    const bool is_varlen = col.type_info()->physical_type() == BINARY;
+    const size_t expected_data_size = is_varlen ?
+        (num_rows + 1) * sizeof(uint32_t) : num_rows * col.type_info()->size();
+    if (PREDICT_FALSE(dst->data.size() != expected_data_size ||
+                      (col.is_nullable() &&
+                       dst->non_null_bitmap.size() != BitmapSize(num_rows)))) {
+      return Status::Corruption(Substitute(
+          "Server sent invalid response: bad data size for column $0", col.name()));
+    }
+    if (is_varlen) {
+      const uint8_t* offsets = dst->data.data();
+      uint32_t prev = 0;
+      for (size_t row = 0; row <= num_rows; row++) {
+        uint32_t offset = UnalignedLoad<uint32_t>(offsets + row * sizeof(uint32_t));
+        if (PREDICT_FALSE(offset < prev || offset > dst->varlen_data.size())) {
+          return Status::Corruption(Substitute(
+              "Server sent invalid response: bad offset for column $0", col.name()));
+        }
+        prev = offset;
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void KuduColumnarScanBatch::Data::Clear() {
+  resp_data_.Clear();
+  columns_.clear();
+  controller_.Reset();
+}
+
+Status KuduColumnarScanBatch::Data::CheckColumnIndex(int idx) const {
+  if (PREDICT_FALSE(idx < 0 || idx >= projection_->num_columns())) {
+    return Status::InvalidArgument(Substitute("bad column index $0", idx));
+  }
+  return Status::OK();
+}
+
+Status KuduColumnarScanBatch::Data::GetFixedLengthColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(CheckColumnIndex(idx));
+  const ColumnSchema& col = projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument(Substitute(
+        "column $0 is of variable-length type $1", col.name(), col.type_info()->name()));
+  }
+  *data = columns_.empty() ? Slice() : columns_[idx].data;
+  return Status::OK();
+}
+
+Status KuduColumnarScanBatch::Data::GetVariableLengthColumn(int idx,
+                                                            Slice* offsets,
+                                                            Slice* data) const {
+  RETURN_NOT_OK(CheckColumnIndex(idx));
+  const ColumnSchema& col = projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument(Substitute(
+        "column $0 is of fixed-size type $1", col.name(), col.type_info()->name()));
+  }
+  if (columns_.empty()) {
+    *offsets = Slice();
+    *data = Slice();
+  } else {
+    *offsets = columns_[idx].data;
+    *data = columns_[idx].varlen_data;
+  }
+  return Status::OK();
+}
+
+Status KuduColumnarScanBatch::Data::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(CheckColumnIndex(idx));
+  *data = columns_.empty() ? Slice() : columns_[idx].non_null_bitmap;
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
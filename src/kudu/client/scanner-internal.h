@@ -28,6 +28,7 @@
 #include <glog/logging.h>
 
 #include "kudu/client/client.h"
+#include "kudu/client/columnar_scan_batch.h"
 #include "kudu/client/resource_metrics.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scan_batch.h"
@@ -58,6 +59,24 @@ class KuduSchema;
 namespace internal {
 class RemoteTablet;
 class RemoteTabletServer;
+
+// The data of a batch of scan results, in any of the formats in which the
+// client can hand them out.
+class ScanBatchDataInterface {
+ public:
+  virtual ~ScanBatchDataInterface() {}
+
+  // Takes ownership of the RPC which returned 'response', and extracts the
+  // batch from it.
+  virtual Status Reset(rpc::RpcController* controller,
+                       const Schema* projection,
+                       const KuduSchema* client_projection,
+                       uint64_t row_format_flags,
+                       tserver::ScanResponsePB* response) = 0;
+
+  virtual void Clear() = 0;
+};
+
 } // namespace internal
 
 // The result of KuduScanner::Data::AnalyzeResponse.
@@ -290,7 +309,7 @@ class KuduScanner::Data {
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
-class KuduScanBatch::Data {
+class KuduScanBatch::Data : public internal::ScanBatchDataInterface {
  public:
   Data();
   ~Data();
@@ -299,7 +318,7 @@ class KuduScanBatch::Data {
                const Schema* projection,
                const KuduSchema* client_projection,
                uint64_t row_format_flags,
-               std::unique_ptr<RowwiseRowBlockPB> resp_data);
+               tserver::ScanResponsePB* response) override;
 
   int num_rows() const {
     return resp_data_.num_rows();
@@ -317,7 +336,7 @@ class KuduScanBatch::Data {
 
   void ExtractRows(std::vector<KuduScanBatch::RowPtr>* rows);
 
-  void Clear();
+  void Clear() override;
 
   // Returns the size of a row for the given projection 'proj'.
   static size_t CalculateProjectedRowSize(const Schema& proj);
@@ -347,6 +366,54 @@ class KuduScanBatch::Data {
   size_t projected_row_size_;
 };
 
+class KuduColumnarScanBatch::Data : public internal::ScanBatchDataInterface {
+ public:
+  Data();
+  ~Data();
+
+  Status Reset(rpc::RpcController* controller,
+               const Schema* projection,
+               const KuduSchema* client_projection,
+               uint64_t row_format_flags,
+               tserver::ScanResponsePB* response) override;
+
+  void Clear() override;
+
+  Status GetFixedLengthColumn(int idx, Slice* data) const;
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const;
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const;
+
+  int num_rows() const {
+    return resp_data_.num_rows();
+  }
+
+  // The RPC controller for the RPC which returned this batch.
+  // Holding on to the controller ensures we hold on to the sidecars
+  // which contain the columns.
+  rpc::RpcController controller_;
+
+  // The PB which contains the sidecar indexes of the columns.
+  ColumnarRowBlockPB resp_data_;
+
+  // The buffers of each column, whose lifetime is ensured by the members above.
+  // Empty for buffers absent from the response.
+  struct Column {
+    Slice data;
+    Slice varlen_data;
+    Slice non_null_bitmap;
+  };
+  std::vector<Column> columns_;
+
+  // The projection being scanned.
+  const Schema* projection_;
+  // The KuduSchema version of 'projection_'
+  const KuduSchema* client_projection_;
+
+ private:
+  // Returns a bad Status if column 'idx' can't be accessed.
+  Status CheckColumnIndex(int idx) const;
+};
+
 } // namespace client
 } // namespace kudu
 
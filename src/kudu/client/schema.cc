@@ -48,7 +48,7 @@ MAKE_ENUM_LIMITS(kudu::client::KuduColumnStorageAttributes::EncodingType,
 
 MAKE_ENUM_LIMITS(kudu::client::KuduColumnStorageAttributes::CompressionType,
                  kudu::client::KuduColumnStorageAttributes::DEFAULT_COMPRESSION,
-                 kudu::client::KuduColumnStorageAttributes::ZLIB);
+                 kudu::client::KuduColumnStorageAttributes::ZSTD);
 
 MAKE_ENUM_LIMITS(kudu::client::KuduColumnSchema::DataType,
                  kudu::client::KuduColumnSchema::INT8,
@@ -71,6 +71,8 @@ kudu::EncodingType ToInternalEncodingType(KuduColumnStorageAttributes::EncodingT
     case KuduColumnStorageAttributes::GROUP_VARINT: return kudu::GROUP_VARINT;
     case KuduColumnStorageAttributes::RLE: return kudu::RLE;
     case KuduColumnStorageAttributes::BIT_SHUFFLE: return kudu::BIT_SHUFFLE;
+    case KuduColumnStorageAttributes::FRAME_OF_REFERENCE: return kudu::FRAME_OF_REFERENCE;
+    case KuduColumnStorageAttributes::FRONT_CODED_ENCODING: return kudu::FRONT_CODED_ENCODING;
     default: LOG(FATAL) << "Unexpected encoding type: " << type;
   }
 }
@@ -84,6 +86,8 @@ KuduColumnStorageAttributes::EncodingType FromInternalEncodingType(kudu::Encodin
     case kudu::GROUP_VARINT: return KuduColumnStorageAttributes::GROUP_VARINT;
     case kudu::RLE: return KuduColumnStorageAttributes::RLE;
     case kudu::BIT_SHUFFLE: return KuduColumnStorageAttributes::BIT_SHUFFLE;
+    case kudu::FRAME_OF_REFERENCE: return KuduColumnStorageAttributes::FRAME_OF_REFERENCE;
+    case kudu::FRONT_CODED_ENCODING: return KuduColumnStorageAttributes::FRONT_CODED_ENCODING;
     default: LOG(FATAL) << "Unexpected internal encoding type: " << type;
   }
 }
@@ -95,6 +99,7 @@ kudu::CompressionType ToInternalCompressionType(KuduColumnStorageAttributes::Com
     case KuduColumnStorageAttributes::SNAPPY: return kudu::SNAPPY;
     case KuduColumnStorageAttributes::LZ4: return kudu::LZ4;
     case KuduColumnStorageAttributes::ZLIB: return kudu::ZLIB;
+    case KuduColumnStorageAttributes::ZSTD: return kudu::ZSTD;
     default: LOG(FATAL) << "Unexpected compression type" << type;
   }
 }
@@ -107,6 +112,7 @@ KuduColumnStorageAttributes::CompressionType FromInternalCompressionType(
     case kudu::SNAPPY: return KuduColumnStorageAttributes::SNAPPY;
     case kudu::LZ4: return KuduColumnStorageAttributes::LZ4;
     case kudu::ZLIB: return KuduColumnStorageAttributes::ZLIB;
+    case kudu::ZSTD: return KuduColumnStorageAttributes::ZSTD;
     default: LOG(FATAL) << "Unexpected internal compression type: " << type;
   }
 }
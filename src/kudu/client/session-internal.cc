@@ -17,6 +17,8 @@
 
 #include "kudu/client/session-internal.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <mutex>
 #include <utility>
@@ -29,6 +31,7 @@
 #include "kudu/client/callbacks.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/shared_ptr.h" // IWYU pragma: keep
+#include "kudu/client/write_flow_controller.h"
 #include "kudu/client/write_op.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/gutil/port.h"
@@ -46,10 +49,18 @@ namespace client {
 
 using internal::Batcher;
 using internal::ErrorCollector;
+using internal::WriteFlowController;
 
 using sp::shared_ptr;
 using sp::weak_ptr;
 
+namespace {
+
+// The number of batchers an adaptive session starts with: the default limit
+// for a session which doesn't adapt.
+const size_t kInitialFlowWindow = 2;
+
+} // anonymous namespace
 
 KuduSession::Data::Data(shared_ptr<KuduClient> client,
                         std::weak_ptr<rpc::Messenger> messenger)
@@ -218,6 +229,29 @@ Status KuduSession::Data::SetMaxBatchersNum(unsigned int max_num) {
   // However, the lock is needed to check for pending operations because
   // there may be pending RPCs and the background flush task may be running.
   batchers_num_limit_ = max_num;
+  if (flow_controller_) {
+    // Start afresh with the new limit.
+    flow_controller_ = std::make_shared<WriteFlowController>(
+        kInitialFlowWindow, batchers_num_limit_);
+  }
+  return Status::OK();
+}
+
+Status KuduSession::Data::SetAdaptiveFlush(bool enable) {
+  std::lock_guard<Mutex> l(mutex_);
+  if (HasPendingOperationsUnlocked()) {
+    // NOTE: this is an artificial restriction.
+    return Status::IllegalState(
+        "Cannot change adaptive flushing when writes are buffered.");
+  }
+  // The window starts at the default number of batchers, and grows up to
+  // the session's limit while the tablet servers keep up.
+  if (enable) {
+    flow_controller_ = std::make_shared<WriteFlowController>(
+        kInitialFlowWindow, batchers_num_limit_);
+  } else {
+    flow_controller_.reset();
+  }
   return Status::OK();
 }
 
@@ -415,8 +449,13 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
     // Add the operation to the current batcher. If the current batcher
     // is not there, allocate one and set it to be current.
     if (!batcher_) {
-      while (batchers_num_limit_ != 0 &&
-             batchers_num_ >= batchers_num_limit_) {
+      while (true) {
+        // An adaptive session's window is within the configured limit.
+        const size_t limit = flow_controller_ ? flow_controller_->max_batchers()
+                                              : batchers_num_limit_;
+        if (limit == 0 || batchers_num_ < limit) {
+          break;
+        }
         // Wait until it's possible to add a new batcher given the limit
         // on the maximum outstanding batchers per session.
         condition_.Wait();
@@ -427,7 +466,7 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
       // no thread-safety is advertised for the kudu::KuduSession interface.
       scoped_refptr<Batcher> batcher(
           new Batcher(client_.get(), error_collector_, session_,
-                      external_consistency_mode_));
+                      external_consistency_mode_, flow_controller_));
       if (timeout_.Initialized()) {
         batcher->SetTimeout(timeout_);
       }
@@ -445,8 +484,14 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
   }
 
   if (flush_mode == AUTO_FLUSH_BACKGROUND) {
-    const size_t flush_watermark =
+    size_t flush_watermark =
         buffer_bytes_limit_ * buffer_watermark_pct_ / 100;
+    if (flow_controller_) {
+      // Send smaller batches more often while the tablet servers are
+      // congested, to bound the latency of the writes.
+      flush_watermark = std::max<size_t>(
+          1, flush_watermark * flow_controller_->batch_size_fraction());
+    }
     // In AUTO_FLUSH_BACKGROUND mode it's necessary to flush the newly added
     // operations if the flush watermark is reached. The current batcher is
     // the exclusive and the only container for the newly added operations.
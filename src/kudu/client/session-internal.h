@@ -45,6 +45,10 @@ namespace client {
 class KuduStatusCallback;
 class KuduWriteOperation;
 
+namespace internal {
+class WriteFlowController;
+} // namespace internal
+
 // This class contains the code to do the heavy-lifting for the
 // kudu::KuduSession-related operations. Its interface does not assume
 // thread-safety in general, but it's thread-safe regarding the following
@@ -93,6 +97,10 @@ class KuduSession::Data {
   // Set the limit on maximum number of batchers with pending operations.
   Status SetMaxBatchersNum(unsigned int period_ms);
 
+  // Enable or disable adapting the flush watermark and the number of
+  // batchers to the load of the tablet servers.
+  Status SetAdaptiveFlush(bool enable);
+
   // Set timeout for write operations, in milliseconds.
   void SetTimeoutMillis(int timeout_ms);
 
@@ -237,6 +245,14 @@ class KuduSession::Data {
   // The total number of bytes used by buffered write operations.
   int64_t buffer_bytes_used_;  // protected by mutex_
 
+  // If set, the flush watermark and the limit on the number of batchers
+  // are reduced to what the tablet servers can absorb, as measured by
+  // the flow controller from the responses to the session's writes.
+  // Thread-safety note: flow_controller_ is not supposed to be modified
+  // from any other thread since no thread-safety is advertised for the
+  // kudu::KuduSession interface.
+  std::shared_ptr<internal::WriteFlowController> flow_controller_;
+
  private:
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundApplyBlocks);
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundAndErrorCollector);
@@ -0,0 +1,124 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/write_flow_controller.h"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+
+using std::string;
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+constexpr double WriteFlowController::kRttCongestionFactor;
+constexpr double WriteFlowController::kMinBatchSizeFraction;
+
+namespace {
+
+// Round trip times below this aren't treated as congestion, however much
+// they've grown, since at that scale they're dominated by noise.
+const int64_t kMinCongestedRttUs = 1000;
+
+// The increase in a server's batch size fraction on each prompt response.
+const double kBatchSizeFractionIncrease = 1.0 / 16;
+
+} // anonymous namespace
+
+WriteFlowController::WriteFlowController(size_t initial_batchers, size_t max_batchers)
+    : initial_batchers_(std::max<size_t>(
+          1, max_batchers == 0 ? initial_batchers
+                               : std::min(initial_batchers, max_batchers))),
+      max_batchers_(max_batchers),
+      cur_max_batchers_(initial_batchers_),
+      cur_batch_size_fraction_(1) {
+}
+
+void WriteFlowController::WriteResponded(const string& server_uuid,
+                                         const MonoDelta& rtt,
+                                         bool too_busy) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  ServerWindow* w = &LookupOrInsert(&windows_, server_uuid, ServerWindow{
+      static_cast<double>(initial_batchers_), 1, 0,
+      std::numeric_limits<int64_t>::max(), MonoTime() });
+
+  bool congested = too_busy;
+  if (!too_busy) {
+    // A rejection arrives promptly, so only the round trip times of writes
+    // which the server processed are sampled.
+    const int64_t rtt_us = rtt.ToMicroseconds();
+    w->min_rtt_us = std::min(w->min_rtt_us, rtt_us);
+    w->srtt_us = w->srtt_us == 0 ? rtt_us : w->srtt_us * 7 / 8 + rtt_us / 8.0;
+    congested = rtt_us > kMinCongestedRttUs &&
+        rtt_us > w->min_rtt_us * kRttCongestionFactor;
+  }
+
+  if (congested) {
+    const MonoTime now = MonoTime::Now();
+    if (!w->last_decrease.Initialized() ||
+        now - w->last_decrease > MonoDelta::FromMicroseconds(w->srtt_us)) {
+      w->batchers = std::max(1.0, w->batchers / 2);
+      w->batch_size_fraction = std::max(kMinBatchSizeFraction,
+                                        w->batch_size_fraction / 2);
+      w->last_decrease = now;
+      VLOG(1) << "Write to tablet server " << server_uuid
+              << (too_busy ? " was rejected" : " was slow")
+              << ", reducing window to " << w->batchers << " batchers of "
+              << w->batch_size_fraction << " of the flush watermark";
+    }
+  } else {
+    w->batchers += 1 / w->batchers;
+    if (max_batchers_ != 0) {
+      w->batchers = std::min<double>(w->batchers, max_batchers_);
+    }
+    w->batch_size_fraction = std::min(1.0, w->batch_size_fraction +
+                                      kBatchSizeFractionIncrease);
+  }
+  UpdateLimitsUnlocked();
+}
+
+size_t WriteFlowController::max_batchers() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return cur_max_batchers_;
+}
+
+double WriteFlowController::batch_size_fraction() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return cur_batch_size_fraction_;
+}
+
+void WriteFlowController::UpdateLimitsUnlocked() {
+  DCHECK(lock_.is_locked());
+  double batchers = std::numeric_limits<double>::max();
+  double fraction = 1;
+  for (const auto& e : windows_) {
+    batchers = std::min(batchers, e.second.batchers);
+    fraction = std::min(fraction, e.second.batch_size_fraction);
+  }
+  cur_max_batchers_ = std::max<size_t>(1, static_cast<size_t>(batchers));
+  cur_batch_size_fraction_ = fraction;
+}
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_WRITE_FLOW_CONTROLLER_H
+#define KUDU_CLIENT_WRITE_FLOW_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace client {
+namespace internal {
+
+// Adjusts the size of a session's batches and the number of its outstanding
+// batchers to the load of the tablet servers it writes to, in the manner of
+// TCP congestion control: the window grows additively while writes succeed
+// promptly, and is halved when a tablet server rejects a write because its
+// RPC queue is full, or when a write's round trip time grows well beyond the
+// best seen for that server.
+//
+// Each tablet server has its own window, and the session is limited by the
+// most congested server it has written to.
+//
+// This class is thread-safe: responses are reported from reactor threads
+// while the session reads the current limits.
+class WriteFlowController {
+ public:
+  // The window starts at 'initial_batchers' outstanding batchers, and never
+  // grows beyond 'max_batchers' (or without bound if 0).
+  // Either way, the window is at least one batcher.
+  WriteFlowController(size_t initial_batchers, size_t max_batchers);
+
+  // Reports the response to a write sent to the tablet server 'server_uuid',
+  // which took 'rtt' to arrive. 'too_busy' is true if the server rejected
+  // the write because it was overloaded.
+  void WriteResponded(const std::string& server_uuid, const MonoDelta& rtt,
+                      bool too_busy);
+
+  // The number of batchers which may be outstanding at once; at least 1.
+  size_t max_batchers() const;
+
+  // The fraction, between kMinBatchSizeFraction and 1, of the session's flush
+  // watermark at which to flush the current batcher.
+  double batch_size_fraction() const;
+
+  // A server whose round trip time grows beyond this multiple of its lowest
+  // round trip time is treated as congested.
+  static constexpr double kRttCongestionFactor = 4;
+
+  static constexpr double kMinBatchSizeFraction = 1.0 / 64;
+
+ private:
+  struct ServerWindow {
+    // The window, in outstanding batchers.
+    double batchers;
+    double batch_size_fraction;
+
+    // The smoothed and lowest round trip times, in microseconds.
+    double srtt_us;
+    int64_t min_rtt_us;
+
+    // When the window was last decreased: it isn't decreased again within
+    // a round trip, since the writes in flight at the time of a decrease
+    // were sent with the larger window.
+    MonoTime last_decrease;
+  };
+
+  // Recomputes the session's limits from the servers' windows.
+  void UpdateLimitsUnlocked();
+
+  const size_t initial_batchers_;
+  const size_t max_batchers_;
+
+  mutable simple_spinlock lock_;
+
+  std::unordered_map<std::string, ServerWindow> windows_;
+
+  size_t cur_max_batchers_;
+  double cur_batch_size_fraction_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteFlowController);
+};
+
+} // namespace internal
+} // namespace client
+} // namespace kudu
+
+#endif
@@ -79,6 +79,12 @@ class Clock : public RefCountedThreadSafe<Clock> {
     LOG(FATAL) << "Clock's timestamps don't have a physical component.";
   }
 
+  // Returns the maximum rate, in parts per million, at which the local clock
+  // may drift from true time, or 0 if the clock has no physical component.
+  virtual int64_t MaxDriftPpm() const {
+    return 0;
+  }
+
   // Update the clock with a transaction timestamp originating from
   // another server. For instance replicas can call this so that,
   // if elected leader, they are guaranteed to generate timestamps
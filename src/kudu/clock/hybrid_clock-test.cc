@@ -27,6 +27,7 @@
 
 #include "kudu/clock/hybrid_clock.h"
 #include "kudu/clock/mock_ntp.h"
+#include "kudu/clock/system_ntp.h"
 #include "kudu/clock/time_service.h"
 #include "kudu/common/timestamp.h"
 #include "kudu/gutil/casts.h"
@@ -44,6 +45,7 @@
 
 
 DECLARE_bool(inject_unsync_time_errors);
+DECLARE_int32(ntp_error_refresh_interval_ms);
 DECLARE_string(time_source);
 
 using std::string;
@@ -359,6 +361,31 @@ TEST_F(HybridClockTest, TestNtpDiagnostics) {
   ASSERT_STR_CONTAINS(s, "ntpq");
   ASSERT_STR_CONTAINS(s, "ntp_gettime");
 }
+
+// Test that with a cached error bound, clock reads extend the bound by the
+// maximum skew since it was last refreshed, and still report the clock as
+// unsynchronized.
+TEST_F(HybridClockTest, TestNtpCachedErrorBound) {
+  // Refresh rarely enough that the bound isn't refreshed during the test.
+  FLAGS_ntp_error_refresh_interval_ms = 60 * 60 * 1000;
+  SystemNtp ntp;
+  ASSERT_OK(ntp.Init());
+
+  uint64_t now_usec[2];
+  uint64_t error_usec[2];
+  ASSERT_OK(ntp.WalltimeWithError(&now_usec[0], &error_usec[0]));
+  SleepFor(MonoDelta::FromSeconds(1));
+  ASSERT_OK(ntp.WalltimeWithError(&now_usec[1], &error_usec[1]));
+
+  uint64_t elapsed_usec = now_usec[1] - now_usec[0];
+  ASSERT_GE(elapsed_usec, 1000000);
+  ASSERT_NEAR(static_cast<int64_t>(error_usec[1] - error_usec[0]),
+              ntp.skew_ppm() * static_cast<int64_t>(elapsed_usec) / 1000000, 10);
+
+  FLAGS_inject_unsync_time_errors = true;
+  Status s = ntp.WalltimeWithError(&now_usec[0], &error_usec[0]);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+}
 #endif
 
 }  // namespace clock
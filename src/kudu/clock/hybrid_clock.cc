@@ -255,6 +255,11 @@ MonoDelta HybridClock::GetPhysicalComponentDifference(Timestamp lhs, Timestamp r
                                      static_cast<int64_t>(GetPhysicalValueMicros(rhs)));
 }
 
+int64_t HybridClock::MaxDriftPpm() const {
+  DCHECK(time_service_) << "HybridClock is not initialized";
+  return time_service_->skew_ppm();
+}
+
 Status HybridClock::WaitUntilAfter(const Timestamp& then,
                                    const MonoTime& deadline) {
   TRACE_EVENT0("clock", "HybridClock::WaitUntilAfter");
@@ -69,6 +69,9 @@ class HybridClock : public Clock {
 
   MonoDelta GetPhysicalComponentDifference(Timestamp lhs, Timestamp rhs) const OVERRIDE;
 
+  // Returns the skew reported by the time service.
+  int64_t MaxDriftPpm() const OVERRIDE;
+
   // Blocks the caller thread until the true time is after 'then'.
   // In other words, waits until the HybridClock::Now() on _all_ nodes
   // will return a value greater than 'then'.
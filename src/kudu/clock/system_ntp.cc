@@ -20,7 +20,10 @@
 #include <sys/time.h>
 #include <sys/timex.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <ctime>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -34,10 +37,13 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/subprocess.h"
+#include "kudu/util/thread.h"
 
 DECLARE_bool(inject_unsync_time_errors);
 
@@ -49,6 +55,15 @@ DEFINE_int32(ntp_initial_sync_wait_secs, 60,
 TAG_FLAG(ntp_initial_sync_wait_secs, evolving);
 TAG_FLAG(ntp_initial_sync_wait_secs, advanced);
 
+DEFINE_int32(ntp_error_refresh_interval_ms, 0,
+             "If positive, the interval at which a background thread reads "
+             "the kernel's clock synchronization status and error bound. "
+             "Clock reads then use clock_gettime() rather than ntp_adjtime(), "
+             "and extend the last error bound read by the clock's maximum "
+             "skew, which avoids a system call for every timestamp. If zero, "
+             "every clock read calls ntp_adjtime().");
+TAG_FLAG(ntp_error_refresh_interval_ms, experimental);
+
 using std::string;
 using std::vector;
 using strings::Substitute;
@@ -153,6 +168,17 @@ Status WaitForNtp() {
 }
 } // anonymous namespace
 
+SystemNtp::SystemNtp()
+    : stop_refresh_(1) {
+}
+
+SystemNtp::~SystemNtp() {
+  if (refresh_thread_) {
+    stop_refresh_.CountDown();
+    refresh_thread_->Join();
+  }
+}
+
 void SystemNtp::DumpDiagnostics(vector<string>* log) const {
   LOG_STRING(ERROR, log) << "Dumping NTP diagnostics";
   TryRun({"ntptime"}, log);
@@ -200,12 +226,62 @@ Status SystemNtp::Init() {
             << " Skew: " << skew_ppm_ << "ppm"
             << " Current error: " << timex.maxerror <<  "us";
 
+  if (FLAGS_ntp_error_refresh_interval_ms > 0) {
+    RefreshCachedError();
+    RETURN_NOT_OK(Thread::Create("clock", "ntp-error-refresh",
+                                 &SystemNtp::RefreshThread, this, &refresh_thread_));
+  }
   return Status::OK();
 }
 
+void SystemNtp::RefreshCachedError() {
+  timex tx;
+  MonoTime before = MonoTime::Now();
+  Status s = CallAdjTime(&tx);
+  MonoTime after = MonoTime::Now();
+
+  // As in HybridClock::WalltimeWithError(), the error bound is most likely
+  // to have been read halfway through the call, and could have been read
+  // anywhere within it.
+  MonoDelta read_time_error = MonoDelta::FromNanoseconds((after - before).ToNanoseconds() / 2);
+
+  std::lock_guard<simple_spinlock> l(cached_lock_);
+  cached_status_ = s;
+  if (s.ok()) {
+    cached_error_usec_ = tx.maxerror + read_time_error.ToMicroseconds();
+    cached_time_ = before + read_time_error;
+  }
+}
+
+void SystemNtp::RefreshThread() {
+  const MonoDelta interval = MonoDelta::FromMilliseconds(FLAGS_ntp_error_refresh_interval_ms);
+  while (!stop_refresh_.WaitFor(interval)) {
+    RefreshCachedError();
+  }
+}
+
 
 Status SystemNtp::WalltimeWithError(uint64_t *now_usec,
                                     uint64_t *error_usec) {
+  if (refresh_thread_) {
+    if (PREDICT_FALSE(FLAGS_inject_unsync_time_errors)) {
+      return Status::ServiceUnavailable("Error reading clock. Clock considered unsynchronized");
+    }
+    timespec ts;
+    PCHECK(clock_gettime(CLOCK_REALTIME, &ts) == 0);
+    MonoTime now = MonoTime::Now();
+    std::lock_guard<simple_spinlock> l(cached_lock_);
+    RETURN_NOT_OK(cached_status_);
+    // The clock may have drifted by up to the maximum skew since the error
+    // bound was read; the kernel itself grows its bound at the same rate.
+    // Round up, so that the bound stays conservative.
+    int64_t elapsed_usec = std::max<int64_t>((now - cached_time_).ToMicroseconds(), 0);
+    *now_usec = ts.tv_sec * kMicrosPerSec + ts.tv_nsec / 1000;
+    *error_usec = cached_error_usec_ + (elapsed_usec * skew_ppm_ + kMicrosPerSec - 1) /
+        kMicrosPerSec;
+    return Status::OK();
+  }
+
   // Read the time. This will return an error if the clock is not synchronized.
   timex tx;
   RETURN_NOT_OK(CallAdjTime(&tx));
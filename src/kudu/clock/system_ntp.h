@@ -22,9 +22,16 @@
 
 #include "kudu/clock/time_service.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
+
+class Thread;
+
 namespace clock {
 
 // TimeService implementation which uses the 'ntp_adjtime' call (corresponding to the
@@ -33,9 +40,15 @@ namespace clock {
 //
 // This implementation relies on the ntpd service running on the local host
 // to keep the kernel's timekeeping up to date and in sync.
+//
+// If --ntp_error_refresh_interval_ms is positive, 'ntp_adjtime' is instead
+// called periodically by a background thread. Clock reads then get the time
+// from 'clock_gettime', which is served by the vDSO without a system call,
+// and extrapolate the error bound from the last refresh by the maximum skew.
 class SystemNtp : public TimeService {
  public:
-  SystemNtp() = default;
+  SystemNtp();
+  virtual ~SystemNtp();
 
   // Ensure that the kernel's timekeeping status indicates that it is currently
   // in sync, and initialize various internal parameters.
@@ -56,9 +69,31 @@ class SystemNtp : public TimeService {
 
   static const uint64_t kMicrosPerSec;
 
+  // Reads the kernel's synchronization status and error bound, and caches
+  // them for WalltimeWithError().
+  void RefreshCachedError();
+
+  // Calls RefreshCachedError() every --ntp_error_refresh_interval_ms until
+  // 'stop_refresh_' is counted down.
+  void RefreshThread();
+
   // The skew rate in PPM reported by the kernel.
   uint64_t skew_ppm_ = 0;
 
+  // Protects the cached state below.
+  mutable simple_spinlock cached_lock_;
+
+  // The result of the last refresh: whether the clock was synchronized, and
+  // if so, its error bound at 'cached_time_'.
+  Status cached_status_;
+  uint64_t cached_error_usec_ = 0;
+  MonoTime cached_time_;
+
+  CountDownLatch stop_refresh_;
+
+  // The refresh thread, or NULL if the error bound isn't cached.
+  scoped_refptr<Thread> refresh_thread_;
+
   DISALLOW_COPY_AND_ASSIGN(SystemNtp);
 };
 
@@ -23,6 +23,8 @@
 #include <cctype>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -39,11 +41,14 @@
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Target/TargetMachine.h>
 
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/scan_kernel.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/once.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/status.h"
 
@@ -55,6 +60,11 @@ DEFINE_bool(codegen_dump_mc, false, "Whether to dump the disassembly of the"
             " machine code for generated functions.");
 TAG_FLAG(codegen_dump_mc, experimental);
 TAG_FLAG(codegen_dump_mc, runtime);
+DEFINE_string(codegen_object_cache_dir, "", "Directory in which to save the machine "
+              "code of generated functions, so that it is loaded rather than compiled "
+              "again when the same functions are generated, including after a restart. "
+              "If empty, the machine code is not saved.");
+TAG_FLAG(codegen_object_cache_dir, experimental);
 
 namespace llvm {
 class MCAsmInfo;
@@ -78,6 +88,7 @@ using llvm::Target;
 using llvm::TargetMachine;
 using llvm::Triple;
 using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -202,6 +213,12 @@ void CodeGenerator::GlobalInit() {
 CodeGenerator::CodeGenerator() {
   static GoogleOnceType once = GOOGLE_ONCE_INIT;
   GoogleOnceInit(&once, &CodeGenerator::GlobalInit);
+  if (!FLAGS_codegen_object_cache_dir.empty()) {
+    // Compiling without the object cache is only slower, so don't fail.
+    WARN_NOT_OK(ObjectCache::Open(Env::Default(), FLAGS_codegen_object_cache_dir,
+                                  &object_cache_),
+                "Could not open codegen object cache");
+  }
 }
 
 CodeGenerator::~CodeGenerator() {}
@@ -212,7 +229,7 @@ Status CodeGenerator::CompileRowProjector(const Schema& base, const Schema& proj
   RETURN_NOT_OK(CheckCodegenEnabled());
 
   TargetMachine* tm;
-  RETURN_NOT_OK(RowProjectorFunctions::Create(base, proj, out, &tm));
+  RETURN_NOT_OK(RowProjectorFunctions::Create(base, proj, out, &tm, object_cache_.get()));
 
   if (FLAGS_codegen_dump_mc) {
     static const int kInstrMax = 1500;
@@ -226,5 +243,26 @@ Status CodeGenerator::CompileRowProjector(const Schema& base, const Schema& proj
   return Status::OK();
 }
 
+Status CodeGenerator::CompileScanKernel(const Schema& base, const Schema& proj,
+                                        vector<KernelPredicate> predicates,
+                                        scoped_refptr<ScanKernelFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(ScanKernelFunctions::Create(base, proj, std::move(predicates), out, &tm,
+                                            object_cache_.get()));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 1500;
+    std::ostringstream sstr;
+    sstr << "Printing scan kernel function:\n";
+    int instrs = DumpAsm((*out)->kernel(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
 } // namespace codegen
 } // namespace kudu
@@ -18,6 +18,9 @@
 #ifndef KUDU_CODEGEN_CODE_GENERATOR_H
 #define KUDU_CODEGEN_CODE_GENERATOR_H
 
+#include <memory>
+#include <vector>
+
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
 
@@ -30,7 +33,10 @@ class Schema;
 
 namespace codegen {
 
+class ObjectCache;
 class RowProjectorFunctions;
+class ScanKernelFunctions;
+struct KernelPredicate;
 
 // CodeGenerator is a top-level class that manages a per-module
 // LLVM context, ExecutionEngine initialization, native target loading,
@@ -53,6 +59,10 @@ class RowProjectorFunctions;
 // compilation thread (See CompilationManager class). Threads may run
 // codegen'd functions concurrently.
 //
+// If --codegen_object_cache_dir is set, the object code of the functions is
+// saved there, and loaded by later compilations of the same functions, even
+// by a later run of the process.
+//
 // Code generation may be disabled globally at compile time by defining
 // the preprocessor macro KUDU_DISABLE_CODEGEN.
 class CodeGenerator {
@@ -67,10 +77,17 @@ class CodeGenerator {
   Status CompileRowProjector(const Schema& base, const Schema& proj,
                              scoped_refptr<RowProjectorFunctions>* out);
 
+  // Attempts to initialize scan kernel functions by compiling code
+  // for the parameter schemas and predicates. Writes to 'out' upon success.
+  Status CompileScanKernel(const Schema& base, const Schema& proj,
+                           std::vector<KernelPredicate> predicates,
+                           scoped_refptr<ScanKernelFunctions>* out);
+
  private:
   static void GlobalInit();
 
-  // TODO static ObjectCache shared b/w engines
+  // Null unless --codegen_object_cache_dir is set.
+  std::unique_ptr<ObjectCache> object_cache_;
 
   DISALLOW_COPY_AND_ASSIGN(CodeGenerator);
 };
@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -30,7 +31,10 @@
 
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/scan_kernel.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
@@ -38,8 +42,12 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/singleton.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/logging_test_util.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/slice.h"
@@ -48,10 +56,12 @@
 #include "kudu/util/test_util.h"
 
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 DECLARE_bool(codegen_dump_mc);
 DECLARE_int32(codegen_cache_capacity);
+DECLARE_string(codegen_object_cache_dir);
 
 namespace kudu {
 
@@ -63,7 +73,8 @@ using codegen::CompilationManager;
 class CodegenTest : public KuduTest {
  public:
   CodegenTest()
-    : random_(SeedRandom()),
+    : generator_(new codegen::CodeGenerator()),
+      random_(SeedRandom()),
       // Set the initial Arena size as small as possible to catch errors during relocation.
       projections_arena_(16) {
     // Create the base schema.
@@ -135,6 +146,16 @@ class CodegenTest : public KuduTest {
   Status CreatePartialSchema(const vector<size_t>& col_indexes,
                              Schema* out);
 
+  // Replaces the code generator with a new one, e.g. to pick up flags.
+  void ResetGenerator() {
+    generator_.reset(new codegen::CodeGenerator());
+  }
+
+  // Compares the rows matched and projected by a scan kernel compiled with
+  // the given predicates to a separate evaluation and non-codegen projection.
+  // All of the predicates must be compiled into the kernel.
+  void TestScanKernel(const Schema* proj, const vector<ColumnPredicate>& preds);
+
  private:
   // Projects the test rows into parameter rowblock using projector and
   // member projections_arena_ (should be Reset() manually).
@@ -149,7 +170,7 @@ class CodegenTest : public KuduTest {
   typedef const void* DefaultValueType;
   static const DefaultValueType kI32R, kI32W, kStrR, kStrW;
 
-  codegen::CodeGenerator generator_;
+  gscoped_ptr<codegen::CodeGenerator> generator_;
   Random random_;
   gscoped_ptr<ConstContiguousRow> test_rows_[kNumTestRows];
   Arena projections_arena_;
@@ -230,7 +251,7 @@ void CodegenTest::TestProjection(const Schema* proj) {
 
 Status CodegenTest::Generate(const Schema* proj, gscoped_ptr<CodegenRP>* out) {
   scoped_refptr<codegen::RowProjectorFunctions> functions;
-  RETURN_NOT_OK(generator_.CompileRowProjector(base_, *proj, &functions));
+  RETURN_NOT_OK(generator_->CompileRowProjector(base_, *proj, &functions));
   out->reset(new CodegenRP(&base_, proj, functions));
   return Status::OK();
 }
@@ -244,6 +265,47 @@ Status CodegenTest::CreatePartialSchema(const vector<size_t>& col_indexes,
   return defaults_.CreateProjectionByIdsIgnoreMissing(col_ids, out);
 }
 
+void CodegenTest::TestScanKernel(const Schema* proj,
+                                 const vector<ColumnPredicate>& preds) {
+  vector<codegen::KernelPredicate> kernel_preds;
+  codegen::ScanKernelFunctions::ExtractPredicates(base_, preds, &kernel_preds);
+  ASSERT_EQ(preds.size(), kernel_preds.size());
+
+  scoped_refptr<codegen::ScanKernelFunctions> functions;
+  ASSERT_OK(generator_->CompileScanKernel(base_, *proj, kernel_preds, &functions));
+  codegen::ScanKernel kernel(&base_, proj, functions);
+  NoCodegenRP without(&base_, proj);
+  ASSERT_OK(without.Init());
+
+  RowBlock rb_with(*proj, 1, &projections_arena_);
+  RowBlock rb_without(*proj, 1, &projections_arena_);
+  projections_arena_.Reset();
+  for (int i = 0; i < kNumTestRows; ++i) {
+    const ConstContiguousRow& src = *test_rows_[i];
+    bool expected = true;
+    for (const auto& pred : preds) {
+      int col_idx = base_.find_column(pred.column().name());
+      if (src.is_null(col_idx)) {
+        expected &= pred.predicate_type() == PredicateType::IsNull;
+      } else {
+        expected &= pred.predicate_type() != PredicateType::IsNull &&
+                    pred.EvaluateCell(pred.column().type_info()->physical_type(),
+                                      src.cell_ptr(col_idx));
+      }
+    }
+
+    RowBlockRow dst_with = rb_with.row(0);
+    bool matched;
+    ASSERT_OK(kernel.ProjectRowIfMatch(src, &dst_with, &projections_arena_, &matched));
+    ASSERT_EQ(expected, matched) << "row " << base_.DebugRow(src);
+    if (matched) {
+      RowBlockRow dst_without = rb_without.row(0);
+      ASSERT_OK(without.ProjectRowForRead(src, &dst_without, &projections_arena_));
+      CheckRowBlocksEqual(&rb_with, &rb_without, "Codegen", "Expected");
+    }
+  }
+}
+
 TEST_F(CodegenTest, ObservablesTest) {
   // Test when not identity
   Schema proj = base_.CreateKeyProjection();
@@ -382,6 +444,62 @@ TEST_F(CodegenTest, TestDumpMC) {
   EXPECT_THAT(msgs[0], testing::ContainsRegex("retq"));
 }
 
+TEST_F(CodegenTest, TestScanKernels) {
+  Schema proj;
+  ASSERT_OK(CreatePartialSchema({ kKeyCol, kI32Col, kStrCol, kStrNullValCol }, &proj));
+
+  const ColumnSchema& key_col = base_.column(kKeyCol);
+  const ColumnSchema& i32_col = base_.column(kI32Col);
+  const ColumnSchema& i32_null_val_col = base_.column(kI32NullValCol);
+  const ColumnSchema& i32_null_col = base_.column(kI32NullCol);
+  const uint64_t kKeyLower = 2;
+  const uint64_t kKeyUpper = 8;
+  const uint64_t kKeyValue = 5;
+  const int32_t kZero = 0;
+
+  // No predicate doesn't filter anything.
+  NO_FATALS(TestScanKernel(&proj, {}));
+
+  // Each supported predicate type, alone and combined.
+  NO_FATALS(TestScanKernel(&proj, {
+      ColumnPredicate::Equality(key_col, &kKeyValue) }));
+  NO_FATALS(TestScanKernel(&proj, {
+      ColumnPredicate::Range(key_col, &kKeyLower, &kKeyUpper) }));
+  NO_FATALS(TestScanKernel(&proj, {
+      ColumnPredicate::Range(i32_col, &kZero, nullptr) }));
+  NO_FATALS(TestScanKernel(&proj, {
+      ColumnPredicate::Range(i32_col, nullptr, &kZero) }));
+  NO_FATALS(TestScanKernel(&proj, { ColumnPredicate::IsNull(i32_null_col) }));
+  NO_FATALS(TestScanKernel(&proj, { ColumnPredicate::IsNotNull(i32_null_col) }));
+  NO_FATALS(TestScanKernel(&proj, { ColumnPredicate::IsNotNull(i32_null_val_col) }));
+  NO_FATALS(TestScanKernel(&proj, { ColumnPredicate::None(i32_col) }));
+  {
+    vector<uint64_t> keys = { 1, 3, 4, 9 };
+    vector<const void*> values;
+    for (const auto& key : keys) {
+      values.push_back(&key);
+    }
+    NO_FATALS(TestScanKernel(&proj, { ColumnPredicate::InList(key_col, &values) }));
+  }
+  NO_FATALS(TestScanKernel(&proj, {
+      ColumnPredicate::Range(key_col, &kKeyLower, &kKeyUpper),
+      ColumnPredicate::Range(i32_null_val_col, &kZero, nullptr),
+      ColumnPredicate::IsNull(i32_null_col) }));
+}
+
+// Predicates the kernel can't compile are left out of it.
+TEST_F(CodegenTest, TestScanKernelUnsupportedPredicates) {
+  const Slice kStr("a");
+  vector<ColumnPredicate> preds = {
+      ColumnPredicate::Equality(base_.column(kStrCol), &kStr),
+      ColumnPredicate::IsNotNull(base_.column(kI32NullValCol)) };
+  vector<codegen::KernelPredicate> kernel_preds;
+  codegen::ScanKernelFunctions::ExtractPredicates(base_, preds, &kernel_preds);
+  ASSERT_EQ(1, kernel_preds.size());
+  ASSERT_EQ(static_cast<size_t>(kI32NullValCol), kernel_preds[0].col_idx);
+  ASSERT_EQ(PredicateType::IsNotNull, kernel_preds[0].type);
+}
+
 // Basic test for the CompilationManager code cache.
 // This runs a bunch of compilation tasks and ensures that the cache
 // sometimes hits on the second attempt for the same projection.
@@ -424,4 +542,62 @@ TEST_F(CodegenTest, TestCodeCache) {
   }
 }
 
+TEST_F(CodegenTest, TestObjectCacheLoadAndSave) {
+  unique_ptr<codegen::ObjectCache> cache;
+  string dir = GetTestPath("object_cache");
+  ASSERT_OK(codegen::ObjectCache::Open(env_, dir, &cache));
+
+  faststring object;
+  Status s = cache->Load("key", &object);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  ASSERT_OK(cache->Save("key", "object"));
+  ASSERT_OK(cache->Load("key", &object));
+  ASSERT_EQ("object", object.ToString());
+  s = cache->Load("other key", &object);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+
+  // A corrupt object is reported rather than loaded.
+  vector<string> children;
+  ASSERT_OK(env_->GetChildren(dir, &children));
+  for (const string& child : children) {
+    if (HasSuffixString(child, ".o")) {
+      ASSERT_OK(WriteStringToFile(env_, "garbage!", JoinPathSegments(dir, child)));
+    }
+  }
+  s = cache->Load("key", &object);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+// Test that the code generated for a projection is saved to the object
+// cache, and that a later code generator, e.g. of a later run, loads it.
+TEST_F(CodegenTest, TestObjectCache) {
+  FLAGS_codegen_object_cache_dir = GetTestPath("object_cache");
+  ResetGenerator();
+  auto NumCachedObjects = [&]() {
+    vector<string> children;
+    CHECK_OK(env_->GetChildren(FLAGS_codegen_object_cache_dir, &children));
+    return std::count_if(children.begin(), children.end(), [](const string& child) {
+      return HasSuffixString(child, ".o");
+    });
+  };
+
+  Schema ints;
+  ASSERT_OK(CreatePartialSchema({ kI32Col, kI32NullValCol, kI32NullCol }, &ints));
+  TestProjection<true>(&ints);
+  ASSERT_EQ(1, NumCachedObjects());
+
+  // Projections of default values embed pointers to the values, which are
+  // only valid in this process, so they're not cached.
+  Schema defaults;
+  ASSERT_OK(CreatePartialSchema({ kI32RCol, kStrRWCol }, &defaults));
+  TestProjection<true>(&defaults);
+  ASSERT_EQ(1, NumCachedObjects());
+
+  ResetGenerator();
+  TestProjection<true>(&ints);
+  TestProjection<false>(&ints);
+  ASSERT_EQ(1, NumCachedObjects());
+}
+
 } // namespace kudu
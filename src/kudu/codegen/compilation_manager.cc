@@ -21,6 +21,8 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -29,6 +31,7 @@
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/jit_wrapper.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/scan_kernel.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
@@ -46,6 +49,7 @@
 #include "kudu/util/threadpool.h"
 
 using std::shared_ptr;
+using std::vector;
 
 DEFINE_bool(codegen_time_compilation, false, "Whether to print time that each code "
             "generation request took.");
@@ -122,6 +126,55 @@ class CompilationTask : public Runnable {
   DISALLOW_COPY_AND_ASSIGN(CompilationTask);
 };
 
+// Like CompilationTask, but generates a scan kernel.
+class ScanKernelCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  ScanKernelCompilationTask(const Schema& base, const Schema& proj,
+                            vector<KernelPredicate> predicates,
+                            CodeCache* cache, CodeGenerator* generator)
+    : base_(base),
+      proj_(proj),
+      predicates_(std::move(predicates)),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of scan kernel from base schema " +
+                base_.ToString() + " to projection schema " +
+                proj_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(ScanKernelFunctions::EncodeKey(base_, proj_, predicates_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<ScanKernelFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating scan kernel") {
+      RETURN_NOT_OK(generator_->CompileScanKernel(base_, proj_, std::move(predicates_),
+                                                  &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  Schema base_;
+  Schema proj_;
+  vector<KernelPredicate> predicates_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanKernelCompilationTask);
+};
+
 } // anonymous namespace
 
 CompilationManager::CompilationManager()
@@ -199,5 +252,34 @@ bool CompilationManager::RequestRowProjector(const Schema* base_schema,
   return true;
 }
 
+bool CompilationManager::RequestScanKernel(const Schema* base_schema,
+                                           const Schema* projection,
+                                           const vector<KernelPredicate>& predicates,
+                                           gscoped_ptr<ScanKernel>* out) {
+  faststring key;
+  Status s = ScanKernelFunctions::EncodeKey(*base_schema, *projection, predicates, &key);
+  WARN_NOT_OK(s, "ScanKernel compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<ScanKernelFunctions> cached(
+    down_cast<ScanKernelFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new ScanKernelCompilationTask(*base_schema, *projection, predicates,
+                                    &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "ScanKernel compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new ScanKernel(base_schema, projection, cached));
+  return true;
+}
+
 } // namespace codegen
 } // namespace kudu
@@ -19,6 +19,7 @@
 #define KUDU_CODEGEN_COMPILATION_MANAGER_H
 
 #include <cstdint>
+#include <vector>
 
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/code_cache.h"
@@ -38,6 +39,8 @@ class ThreadPool;
 namespace codegen {
 
 class RowProjector;
+class ScanKernel;
+struct KernelPredicate;
 
 // The compilation manager is a top-level class which manages the actual
 // delivery of a code generator's output by maintaining its own
@@ -78,6 +81,15 @@ class CompilationManager {
                            const Schema* projection,
                            gscoped_ptr<RowProjector>* out);
 
+  // Like RequestRowProjector(), but for a scan kernel which evaluates
+  // 'predicates' over rows of the base schema before projecting them (see
+  // codegen::ScanKernelFunctions). Kernels are cached by their schemas and
+  // predicates.
+  bool RequestScanKernel(const Schema* base_schema,
+                         const Schema* projection,
+                         const std::vector<KernelPredicate>& predicates,
+                         gscoped_ptr<ScanKernel>* out);
+
   // Waits for all asynchronous compilation tasks to finish.
   void Wait();
 
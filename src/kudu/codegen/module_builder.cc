@@ -17,6 +17,7 @@
 
 #include "kudu/codegen/module_builder.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <sstream>
 #include <string>
@@ -30,8 +31,10 @@
 #include <glog/logging.h>
 #include <llvm/ADT/StringMap.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/MCJIT.h> // IWYU pragma: keep
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/IR/Attributes.h>
 #include <llvm/IR/Constant.h>
 #include <llvm/IR/Constants.h>
@@ -55,10 +58,15 @@
 #include <llvm/Transforms/IPO/AlwaysInliner.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/precompiled.ll.h"
 #include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 #ifndef CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
@@ -83,6 +91,8 @@ using llvm::IntegerType;
 using llvm::legacy::FunctionPassManager;
 using llvm::legacy::PassManager;
 using llvm::LLVMContext;
+using llvm::MemoryBuffer;
+using llvm::MemoryBufferRef;
 using llvm::Module;
 using llvm::PassManagerBuilder;
 using llvm::PointerType;
@@ -140,7 +150,10 @@ bool ModuleContains(const Module& m, const Function* fptr) {
 ModuleBuilder::ModuleBuilder()
   : state_(kUninitialized),
     context_(new LLVMContext()),
-    builder_(*context_) {}
+    builder_(*context_),
+    target_(nullptr),
+    object_cache_(nullptr),
+    embeds_pointers_(false) {}
 
 ModuleBuilder::~ModuleBuilder() {}
 
@@ -198,8 +211,9 @@ Type* ModuleBuilder::GetType(const string& name) {
   return CHECK_NOTNULL(module_->getTypeByName(name));
 }
 
-Value* ModuleBuilder::GetPointerValue(void* ptr) const {
+Value* ModuleBuilder::GetPointerValue(void* ptr) {
   CHECK_EQ(state_, kBuilding);
+  embeds_pointers_ = true;
   // No direct way of creating constant pointer values in LLVM, so
   // first a constant int has to be created and then casted to a pointer
   IntegerType* llvm_uintptr_t = Type::getIntNTy(*context_, 8 * sizeof(ptr));
@@ -211,6 +225,11 @@ Value* ModuleBuilder::GetPointerValue(void* ptr) const {
 }
 
 
+void ModuleBuilder::EnableObjectCache(ObjectCache* cache, const Slice& key) {
+  object_cache_ = CHECK_NOTNULL(cache);
+  object_cache_key_ = key.ToString();
+}
+
 void ModuleBuilder::AddJITPromise(llvm::Function* llvm_f,
                                   FunctionAddress* actual_f) {
   CHECK_EQ(state_, kBuilding);
@@ -315,8 +334,65 @@ vector<string> GetHostCPUAttrs() {
   return attrs;
 }
 
+// Hands MCJIT the object code of a module from an ObjectCache, in place of
+// compiling the module, or saves the object code it compiles.
+class MCJITObjectCache : public llvm::ObjectCache {
+ public:
+  MCJITObjectCache(codegen::ObjectCache* cache, string key)
+    : cache_(cache),
+      key_(move(key)),
+      loaded_(false) {}
+
+  // Loads the object code from the cache. Returns true if it was found.
+  bool Load() {
+    Status s = cache_->Load(key_, &object_);
+    if (!s.ok() && !s.IsNotFound()) {
+      LOG(WARNING) << "Could not load cached object code: " << s.ToString();
+    }
+    loaded_ = s.ok();
+    return loaded_;
+  }
+
+  unique_ptr<MemoryBuffer> getObject(const Module* /* module */) override {
+    if (!loaded_) {
+      return nullptr;
+    }
+    return MemoryBuffer::getMemBufferCopy(
+        llvm::StringRef(reinterpret_cast<const char*>(object_.data()), object_.size()));
+  }
+
+  void notifyObjectCompiled(const Module* /* module */, MemoryBufferRef obj) override {
+    WARN_NOT_OK(cache_->Save(key_, Slice(obj.getBufferStart(), obj.getBufferSize())),
+                "Could not save compiled object code");
+  }
+
+ private:
+  codegen::ObjectCache* const cache_;
+  const string key_;
+  faststring object_;
+  bool loaded_;
+};
+
 } // anonymous namespace
 
+string ModuleBuilder::ObjectCacheKey() const {
+  // Besides the module itself, the object code depends on the precompiled
+  // IR linked into it, and on the compiler and target which compiled it.
+  static const uint64_t kPrecompiledHash =
+      util_hash::CityHash64(precompiled_ll_data, precompiled_ll_len);
+  vector<string> attrs = GetHostCPUAttrs();
+  std::sort(attrs.begin(), attrs.end());
+  string key = object_cache_key_;
+  key.append(Substitute("|$0|$1|$2|$3|$4|$5",
+                        kPrecompiledHash,
+                        LLVM_VERSION_STRING,
+                        llvm::sys::getProcessTriple(),
+                        string(llvm::sys::getHostCPUName()),
+                        JoinStrings(attrs, ","),
+                        CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS));
+  return key;
+}
+
 Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
   CHECK_EQ(state_, kBuilding);
 
@@ -342,11 +418,24 @@ Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
   }
   module->setDataLayout(target_->createDataLayout());
 
-  DoOptimizations(module, GetFunctionNames());
+  // A module whose object code was saved to the object cache needn't be
+  // optimized, since MCJIT loads the object rather than compiling it.
+  unique_ptr<MCJITObjectCache> object_cache;
+  bool cached = false;
+  if (object_cache_ && !embeds_pointers_) {
+    object_cache.reset(new MCJITObjectCache(object_cache_, ObjectCacheKey()));
+    cached = object_cache->Load();
+    local_engine->setObjectCache(object_cache.get());
+  }
+
+  if (!cached) {
+    DoOptimizations(module, GetFunctionNames());
+  }
   SetFunctionAttributes(module);
 
   // Compile the module
   local_engine->finalizeObject();
+  local_engine->setObjectCache(nullptr);
 
   // Satisfy the promises
   for (JITFuture& fut : futures_) {
@@ -42,8 +42,13 @@ class Value;
 } // namespace llvm
 
 namespace kudu {
+
+class Slice;
+
 namespace codegen {
 
+class ObjectCache;
+
 // A ModuleBuilder provides an interface to generate code for procedures
 // given a CodeGenerator to refer to. Builder can be used to create multiple
 // functions. It is intended to make building functions easier than using
@@ -84,8 +89,10 @@ class ModuleBuilder {
   llvm::Type* GetType(const std::string& name);
   // Retrieve a precompiled function
   llvm::Function* GetFunction(const std::string& name);
-  // Get the LLVM wrapper for a constant pointer value of type i8*
-  llvm::Value* GetPointerValue(void* ptr) const;
+  // Get the LLVM wrapper for a constant pointer value of type i8*.
+  // Since the pointer is only valid in this process, a module which uses
+  // one is never saved to the object cache.
+  llvm::Value* GetPointerValue(void* ptr);
 
   LLVMBuilder* builder() { return &builder_; }
 
@@ -103,6 +110,15 @@ class ModuleBuilder {
     AddJITPromise(llvm_f, reinterpret_cast<FunctionAddress*>(actual_f));
   }
 
+  // Has Compile() load the module's object code from 'cache', if it was
+  // saved there under 'key' by a previous compilation, and save it there
+  // otherwise. 'key' must identify the code of the module, such as the
+  // key of the JITWrapper built from it; it's combined with the version
+  // of the precompiled IR and the host target, so that objects compiled
+  // by another build or for another machine are never loaded.
+  // 'cache' must outlive the builder.
+  void EnableObjectCache(ObjectCache* cache, const Slice& key);
+
   // Compiles all promised functions. Builder may not be used after
   // this method, only destructed. Upon success, releases ownership
   // of the execution engine through the 'out' parameter.
@@ -136,6 +152,11 @@ class ModuleBuilder {
   // Returns the function names for the functions stored in the JITFutures.
   std::unordered_set<std::string> GetFunctionNames() const;
 
+  // Returns the key of the module in the object cache, which combines
+  // 'object_cache_key_' with what the object code depends on besides the
+  // module.
+  std::string ObjectCacheKey() const;
+
   MBState state_;
   std::vector<JITFuture> futures_;
   std::unique_ptr<llvm::LLVMContext> context_;
@@ -143,6 +164,11 @@ class ModuleBuilder {
   LLVMBuilder builder_;
   llvm::TargetMachine* target_; // not owned
 
+  ObjectCache* object_cache_; // not owned, may be null
+  std::string object_cache_key_;
+  // Whether the module embeds process-local pointers (see GetPointerValue()).
+  bool embeds_pointers_;
+
   DISALLOW_COPY_AND_ASSIGN(ModuleBuilder);
 };
 
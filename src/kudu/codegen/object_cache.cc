@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/object_cache.h"
+
+#include <cstdint>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/crc.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/slice.h"
+
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+namespace codegen {
+
+// Each file holds, in sequence:
+//
+// (4 bytes) length of the key
+// (variable) the key
+// (variable) the object
+// (4 bytes) CRC32C checksum of all of the above
+static const size_t kLengthSize = sizeof(uint32_t);
+static const size_t kChecksumSize = sizeof(uint32_t);
+
+ObjectCache::ObjectCache(Env* env, string dir)
+  : env_(env),
+    dir_(std::move(dir)) {}
+
+Status ObjectCache::Open(Env* env, const string& dir, unique_ptr<ObjectCache>* cache) {
+  RETURN_NOT_OK_PREPEND(env_util::CreateDirIfMissing(env, dir),
+                        "could not create codegen object cache directory");
+  cache->reset(new ObjectCache(env, dir));
+  return Status::OK();
+}
+
+string ObjectCache::PathForKey(const Slice& key) const {
+  char buf[kFastToBufferSize];
+  uint64_t hash = util_hash::CityHash64(reinterpret_cast<const char*>(key.data()), key.size());
+  return JoinPathSegments(dir_, Substitute("$0.o", FastHex64ToBuffer(hash, buf)));
+}
+
+Status ObjectCache::Load(const Slice& key, faststring* object) const {
+  string path = PathForKey(key);
+  if (!env_->FileExists(path)) {
+    return Status::NotFound("no cached object", path);
+  }
+  faststring contents;
+  RETURN_NOT_OK(ReadFileToString(env_, path, &contents));
+
+  if (contents.size() < kLengthSize + kChecksumSize) {
+    return Status::Corruption("cached object file too short", path);
+  }
+  size_t checked_size = contents.size() - kChecksumSize;
+  if (crc::Crc32c(contents.data(), checked_size) !=
+      DecodeFixed32(contents.data() + checked_size)) {
+    return Status::Corruption("cached object checksum mismatch", path);
+  }
+  uint32_t key_size = DecodeFixed32(contents.data());
+  if (key_size > checked_size - kLengthSize) {
+    return Status::Corruption("cached object key too long", path);
+  }
+  // Files are named by a hash of the key, so another key may hash the same.
+  if (Slice(contents.data() + kLengthSize, key_size) != key) {
+    return Status::NotFound("cached object is for another key", path);
+  }
+  size_t object_offset = kLengthSize + key_size;
+  object->assign_copy(contents.data() + object_offset, checked_size - object_offset);
+  return Status::OK();
+}
+
+Status ObjectCache::Save(const Slice& key, const Slice& object) const {
+  faststring contents;
+  contents.reserve(kLengthSize + key.size() + object.size() + kChecksumSize);
+  PutFixed32(&contents, key.size());
+  contents.append(key.data(), key.size());
+  contents.append(object.data(), object.size());
+  PutFixed32(&contents, crc::Crc32c(contents.data(), contents.size()));
+
+  string path = PathForKey(key);
+  string tmp_path;
+  unique_ptr<WritableFile> file;
+  RETURN_NOT_OK(env_->NewTempWritableFile(WritableFileOptions(),
+                                          path + ".tmp.XXXXXX",
+                                          &tmp_path, &file));
+  Status s = file->Append(contents);
+  if (s.ok()) {
+    s = file->Close();
+  }
+  if (s.ok()) {
+    s = env_->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    WARN_NOT_OK(env_->DeleteFile(tmp_path),
+                Substitute("could not delete temporary object file $0", tmp_path));
+  }
+  return s;
+}
+
+} // namespace codegen
+} // namespace kudu
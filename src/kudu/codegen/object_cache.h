@@ -0,0 +1,77 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_OBJECT_CACHE_H
+#define KUDU_CODEGEN_OBJECT_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Env;
+class faststring;
+class Slice;
+
+namespace codegen {
+
+// An object cache persists the machine code compiled for JIT modules in a
+// directory, so that code compiled by a previous run of the process is
+// loaded rather than optimized and compiled again, which takes most of the
+// time of a compilation. Unlike the CodeCache, it holds object files which
+// still need to be linked into an execution engine, not runnable code.
+//
+// Objects are cached under arbitrary keys, which should identify both the
+// module and the compiler which compiled it (see
+// ModuleBuilder::EnableObjectCache()). Each is stored in a file named after
+// a hash of its key, along with the key itself and a checksum, both of which
+// are verified when it's loaded.
+//
+// This class is thread-safe.
+class ObjectCache {
+ public:
+  // Opens an object cache in 'dir', creating the directory if it doesn't
+  // exist.
+  static Status Open(Env* env, const std::string& dir, std::unique_ptr<ObjectCache>* cache);
+
+  // Reads the object cached under 'key' into 'object'. Returns NotFound if
+  // there is none, and Corruption if its file is corrupt.
+  Status Load(const Slice& key, faststring* object) const;
+
+  // Caches 'object' under 'key', replacing any object cached under it
+  // already. The object is written to a temporary file which is then renamed
+  // into place, so that concurrent loads never see it partially written.
+  Status Save(const Slice& key, const Slice& object) const;
+
+ private:
+  ObjectCache(Env* env, std::string dir);
+
+  std::string PathForKey(const Slice& key) const;
+
+  Env* const env_;
+  const std::string dir_;
+
+  DISALLOW_COPY_AND_ASSIGN(ObjectCache);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
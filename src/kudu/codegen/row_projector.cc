@@ -45,6 +45,7 @@
 #include "kudu/common/types.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
 namespace llvm {
@@ -254,6 +255,12 @@ llvm::Function* MakeProjection(const string& name,
 
 } // anonymous namespace
 
+Function* MakeReadProjection(const string& name,
+                             ModuleBuilder* mbuilder,
+                             const kudu::RowProjector& proj) {
+  return MakeProjection<true>(name, mbuilder, proj);
+}
+
 RowProjectorFunctions::RowProjectorFunctions(const Schema& base_schema,
                                              const Schema& projection,
                                              ProjectionFunction read_f,
@@ -273,7 +280,8 @@ RowProjectorFunctions::RowProjectorFunctions(const Schema& base_schema,
 Status RowProjectorFunctions::Create(const Schema& base_schema,
                                      const Schema& projection,
                                      scoped_refptr<RowProjectorFunctions>* out,
-                                     llvm::TargetMachine** tm) {
+                                     llvm::TargetMachine** tm,
+                                     ObjectCache* object_cache) {
   ModuleBuilder builder;
   RETURN_NOT_OK(builder.Init());
 
@@ -293,6 +301,12 @@ Status RowProjectorFunctions::Create(const Schema& base_schema,
   builder.AddJITPromise(read, &read_f);
   builder.AddJITPromise(write, &write_f);
 
+  if (object_cache) {
+    faststring key;
+    RETURN_NOT_OK(EncodeKey(base_schema, projection, &key));
+    builder.EnableObjectCache(object_cache, key);
+  }
+
   unique_ptr<JITCodeOwner> owner;
   RETURN_NOT_OK(builder.Compile(&owner));
 
@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <iosfwd>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <glog/logging.h>
@@ -36,6 +37,7 @@
 #include "kudu/util/status.h"
 
 namespace llvm {
+class Function;
 class TargetMachine;
 } // namespace llvm
 
@@ -46,6 +48,17 @@ class faststring;
 
 namespace codegen {
 
+class ModuleBuilder;
+class ObjectCache;
+
+// Generates the projection-for-read function of 'proj', named 'name', in the
+// module of 'mbuilder', so that other generated functions can call it. The
+// function is of the form bool(int8_t* src, RowBlockRow* row, Arena* arena),
+// like RowProjectorFunctions::read().
+llvm::Function* MakeReadProjection(const std::string& name,
+                                   ModuleBuilder* mbuilder,
+                                   const kudu::RowProjector& proj);
+
 // The JITWrapper for codegen::RowProjector functions. Contains
 // the compiled functions themselves as well as the schemas used
 // to generate them.
@@ -55,9 +68,11 @@ class RowProjectorFunctions : public JITWrapper {
   // and projection.
   // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
   // and the functions to 'out' upon success.
+  // Loads and saves the object code through 'object_cache' (if not NULL).
   static Status Create(const Schema& base_schema, const Schema& projection,
                        scoped_refptr<RowProjectorFunctions>* out,
-                       llvm::TargetMachine** tm = NULL);
+                       llvm::TargetMachine** tm = NULL,
+                       ObjectCache* object_cache = NULL);
 
   const Schema& base_schema() { return base_schema_; }
   const Schema& projection() { return projection_; }
@@ -0,0 +1,463 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/scan_kernel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <utility>
+
+#include <gflags/gflags_declare.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Value.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "kudu/codegen/module_builder.h"
+#include "kudu/codegen/row_projector.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/row.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::ConstantInt;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::IntegerType;
+using llvm::LLVMContext;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// In-lists longer than this are left to the caller's evaluation, rather
+// than unrolled into a chain of comparisons.
+const size_t kMaxInListValues = 16;
+
+bool IsSupportedType(DataType physical_type) {
+  switch (physical_type) {
+    case BOOL:
+    case INT8:
+    case UINT8:
+    case INT16:
+    case UINT16:
+    case INT32:
+    case UINT32:
+    case INT64:
+    case UINT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsSigned(DataType physical_type) {
+  switch (physical_type) {
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+string CellToString(const ColumnSchema& col, const void* cell) {
+  return string(reinterpret_cast<const char*>(cell), col.type_info()->size());
+}
+
+// Returns the integer constant for the raw cell 'value' of type 'type'.
+ConstantInt* MakeConstant(IntegerType* type, const string& value) {
+  uint64_t bits = 0;
+  DCHECK_LE(value.size(), sizeof(bits));
+  memcpy(&bits, value.data(), value.size());
+  return ConstantInt::get(type, bits, /*isSigned=*/false);
+}
+
+// Generates a function of the form bool(int8_t* src), which returns whether
+// the contiguous row 'src' of the base schema satisfies all of 'preds'.
+//
+// define i1 @name(i8* %src)
+// entry:
+//   %src_bitmap = getelementptr i8* %src, i64 <offset to bitmap>
+//   <for each predicate>
+//     <if the column is nullable>
+//       %is_null = <bit <column index> of %src_bitmap>
+//     <end implicit if>
+//     %cell = load i<type bits>, i<type bits>* <src + column offset>
+//     %match = <comparisons of %cell to constants, and'ed with !%is_null>
+//     br i1 %match, label %<next predicate>, label %fail
+//   <end implicit for each>
+//   ret i1 true
+// fail:
+//   ret i1 false
+//
+// Cells are loaded whether or not they're null, so that the nullability
+// check doesn't need a branch of its own.
+Function* MakeMatch(const string& name,
+                    ModuleBuilder* mbuilder,
+                    const Schema& base_schema,
+                    const vector<KernelPredicate>& preds) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  vector<Type*> argtypes = { Type::getInt8PtrTy(context) };
+  FunctionType* fty = FunctionType::get(Type::getInt1Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+  Argument* src = &*f->arg_begin();
+  src->setName("src");
+  f->addParamAttr(0, llvm::Attribute::NoAlias);
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* fail = BasicBlock::Create(context, "fail", f);
+  builder->SetInsertPoint(fail);
+  builder->CreateRet(builder->getInt1(false));
+
+  builder->SetInsertPoint(entry);
+  // The bitmap for a contiguous row goes after the row data
+  // See common/row.h ContiguousRowHelper class
+  Value* src_bitmap = builder->CreateConstGEP1_64(src, base_schema.byte_size());
+  src_bitmap->setName("src_bitmap");
+
+  for (size_t i = 0; i < preds.size(); i++) {
+    const KernelPredicate& pred = preds[i];
+    const ColumnSchema& col = base_schema.column(pred.col_idx);
+    const DataType physical_type = col.type_info()->physical_type();
+
+    Value* is_null = builder->getInt1(false);
+    if (col.is_nullable()) {
+      Value* bitmap_byte = builder->CreateLoad(
+          builder->CreateConstGEP1_64(src_bitmap, pred.col_idx >> 3));
+      Value* bit = builder->CreateAnd(bitmap_byte, builder->getInt8(1 << (pred.col_idx & 7)));
+      is_null = builder->CreateICmpNE(bit, builder->getInt8(0));
+      is_null->setName(StrCat("is_null_", pred.col_idx));
+    }
+
+    IntegerType* cell_type = IntegerType::get(context, col.type_info()->size() * 8);
+    Value* cell_ptr = builder->CreateBitCast(
+        builder->CreateConstGEP1_64(src, base_schema.column_offset(pred.col_idx)),
+        PointerType::getUnqual(cell_type));
+    // Cells of a contiguous row aren't necessarily aligned.
+    Value* cell = builder->CreateAlignedLoad(cell_ptr, 1);
+    cell->setName(StrCat("cell_", pred.col_idx));
+
+    const bool is_signed = IsSigned(physical_type);
+    Value* match = nullptr;
+    switch (pred.type) {
+      case PredicateType::None:
+        match = builder->getInt1(false);
+        break;
+      case PredicateType::IsNull:
+        match = is_null;
+        break;
+      case PredicateType::IsNotNull:
+        match = builder->CreateNot(is_null);
+        break;
+      case PredicateType::Equality:
+        match = builder->CreateICmpEQ(cell, MakeConstant(cell_type, pred.lower));
+        break;
+      case PredicateType::Range:
+        match = builder->getInt1(true);
+        if (!pred.lower.empty()) {
+          Value* lower = MakeConstant(cell_type, pred.lower);
+          match = builder->CreateAnd(match, is_signed ? builder->CreateICmpSGE(cell, lower)
+                                                      : builder->CreateICmpUGE(cell, lower));
+        }
+        if (!pred.upper.empty()) {
+          Value* upper = MakeConstant(cell_type, pred.upper);
+          match = builder->CreateAnd(match, is_signed ? builder->CreateICmpSLT(cell, upper)
+                                                      : builder->CreateICmpULT(cell, upper));
+        }
+        break;
+      case PredicateType::InList:
+        match = builder->getInt1(false);
+        for (const string& value : pred.values) {
+          match = builder->CreateOr(match,
+                                    builder->CreateICmpEQ(cell, MakeConstant(cell_type, value)));
+        }
+        break;
+      default:
+        LOG(FATAL) << "unexpected predicate type in scan kernel";
+    }
+    if (pred.type != PredicateType::IsNull && pred.type != PredicateType::IsNotNull) {
+      match = builder->CreateAnd(match, builder->CreateNot(is_null));
+    }
+    match->setName(StrCat("match_", i));
+
+    BasicBlock* next = BasicBlock::Create(context, StrCat("pred_", i + 1), f);
+    builder->CreateCondBr(match, next, fail);
+    builder->SetInsertPoint(next);
+  }
+  builder->CreateRet(builder->getInt1(true));
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping scan kernel predicates:";
+    f->print(llvm::errs(), nullptr);
+  }
+  return f;
+}
+
+// Generates the kernel function, of the form
+// int32_t(int8_t* src, RowBlockRow* row, Arena* arena), returning a
+// ScanKernelFunctions::KernelResult.
+//
+// define i32 @name(i8* noalias %src, RowBlockRow* noalias %rbrow, Arena* noalias %arena)
+// entry:
+//   %match = call i1 @<match>(i8* %src)
+//   br i1 %match, label %project, label %filtered
+// filtered:
+//   ret i32 <kFiltered>
+// project:
+//   %success = call i1 @<read>(i8* %src, RowBlockRow* %rbrow, Arena* %arena)
+//   %result = select i1 %success, i32 <kProjected>, i32 <kOutOfMemory>
+//   ret i32 %result
+//
+// Both callees are internalized and inlined when the module is compiled.
+Function* MakeKernel(const string& name,
+                     ModuleBuilder* mbuilder,
+                     Function* match,
+                     Function* read) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  vector<Type*> argtypes = { Type::getInt8PtrTy(context),
+                             PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlockRow")),
+                             PointerType::getUnqual(mbuilder->GetType("class.kudu::Arena")) };
+  FunctionType* fty = FunctionType::get(Type::getInt32Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* src = &*it++;
+  Argument* rbrow = &*it++;
+  Argument* arena = &*it++;
+  DCHECK(it == f->arg_end());
+  src->setName("src");
+  rbrow->setName("rbrow");
+  arena->setName("arena");
+  f->addParamAttr(0, llvm::Attribute::NoAlias);
+  f->addParamAttr(1, llvm::Attribute::NoAlias);
+  f->addParamAttr(2, llvm::Attribute::NoAlias);
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* filtered = BasicBlock::Create(context, "filtered", f);
+  BasicBlock* project = BasicBlock::Create(context, "project", f);
+
+  builder->SetInsertPoint(entry);
+  vector<Value*> match_args = { src };
+  Value* matched = builder->CreateCall(match, match_args);
+  matched->setName("match");
+  builder->CreateCondBr(matched, project, filtered);
+
+  builder->SetInsertPoint(filtered);
+  builder->CreateRet(builder->getInt32(ScanKernelFunctions::kFiltered));
+
+  builder->SetInsertPoint(project);
+  vector<Value*> read_args = { src, rbrow, arena };
+  Value* success = builder->CreateCall(read, read_args);
+  success->setName("success");
+  Value* result = builder->CreateSelect(success,
+                                        builder->getInt32(ScanKernelFunctions::kProjected),
+                                        builder->getInt32(ScanKernelFunctions::kOutOfMemory));
+  builder->CreateRet(result);
+
+  return f;
+}
+
+// Convenience methods which append to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+void AddNextString(faststring* fs, const string& val) {
+  AddNext(fs, val.size());
+  fs->append(val);
+}
+
+} // anonymous namespace
+
+void ScanKernelFunctions::ExtractPredicates(const Schema& base,
+                                            const vector<ColumnPredicate>& preds,
+                                            vector<KernelPredicate>* out) {
+  const size_t num_existing = out->size();
+  for (const ColumnPredicate& pred : preds) {
+    int col_idx = base.find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    const ColumnSchema& col = base.column(col_idx);
+    if (!IsSupportedType(col.type_info()->physical_type()) ||
+        !col.EqualsPhysicalType(pred.column())) {
+      continue;
+    }
+
+    KernelPredicate kp;
+    kp.col_idx = col_idx;
+    kp.type = pred.predicate_type();
+    switch (pred.predicate_type()) {
+      case PredicateType::None:
+      case PredicateType::IsNull:
+      case PredicateType::IsNotNull:
+        break;
+      case PredicateType::Equality:
+        kp.lower = CellToString(col, pred.raw_lower());
+        break;
+      case PredicateType::Range:
+        if (pred.raw_lower() != nullptr) {
+          kp.lower = CellToString(col, pred.raw_lower());
+        }
+        if (pred.raw_upper() != nullptr) {
+          kp.upper = CellToString(col, pred.raw_upper());
+        }
+        break;
+      case PredicateType::InList:
+        if (pred.raw_values().size() > kMaxInListValues) {
+          continue;
+        }
+        for (const void* value : pred.raw_values()) {
+          kp.values.emplace_back(CellToString(col, value));
+        }
+        break;
+      default:
+        continue;
+    }
+    out->emplace_back(std::move(kp));
+  }
+  std::sort(out->begin() + num_existing, out->end(),
+            [](const KernelPredicate& a, const KernelPredicate& b) {
+              return a.col_idx < b.col_idx;
+            });
+}
+
+ScanKernelFunctions::ScanKernelFunctions(const Schema& base_schema,
+                                         const Schema& projection,
+                                         vector<KernelPredicate> predicates,
+                                         KernelFunction kernel_f,
+                                         unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    base_schema_(base_schema),
+    projection_(projection),
+    predicates_(std::move(predicates)),
+    kernel_f_(kernel_f) {
+  CHECK(kernel_f != nullptr)
+    << "Promise to compile kernel function not fulfilled by ModuleBuilder";
+}
+
+Status ScanKernelFunctions::Create(const Schema& base_schema,
+                                   const Schema& projection,
+                                   vector<KernelPredicate> predicates,
+                                   scoped_refptr<ScanKernelFunctions>* out,
+                                   llvm::TargetMachine** tm,
+                                   ObjectCache* object_cache) {
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  kudu::RowProjector no_codegen(&base_schema, &projection);
+  RETURN_NOT_OK(no_codegen.Init());
+  for (const KernelPredicate& pred : predicates) {
+    if (pred.col_idx >= base_schema.num_columns() ||
+        !IsSupportedType(base_schema.column(pred.col_idx).type_info()->physical_type())) {
+      return Status::InvalidArgument("unsupported predicate for scan kernel");
+    }
+  }
+
+  Function* match = MakeMatch("ScanMatch", &builder, base_schema, predicates);
+  Function* read = MakeReadProjection("ScanProjRead", &builder, no_codegen);
+  Function* kernel = MakeKernel("ScanKernel", &builder, match, read);
+
+  KernelFunction kernel_f;
+  builder.AddJITPromise(kernel, &kernel_f);
+
+  if (object_cache) {
+    faststring key;
+    RETURN_NOT_OK(EncodeKey(base_schema, projection, predicates, &key));
+    builder.EnableObjectCache(object_cache, key);
+  }
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new ScanKernelFunctions(base_schema, projection, std::move(predicates),
+                                     kernel_f, std::move(owner)));
+  return Status::OK();
+}
+
+// The key is the type identifier for ScanKernelFunctions, followed by the
+// key of the row projector functions for the same schemas (see
+// RowProjectorFunctions::EncodeKey()), and then, in sequence:
+//
+// (8 bytes) number, as unsigned long, of predicates
+// for each predicate, in order:
+//   (8 bytes) base column index
+//   (4 bytes) predicate type
+//   lower bound, upper bound, and each in-list value, each preceded by its
+//   length (8 bytes), with the number of in-list values (8 bytes) before them
+Status ScanKernelFunctions::EncodeKey(const Schema& base, const Schema& proj,
+                                      const vector<KernelPredicate>& predicates,
+                                      faststring* out) {
+  AddNext(out, JITWrapper::SCAN_KERNEL);
+  RETURN_NOT_OK(RowProjectorFunctions::EncodeKey(base, proj, out));
+  AddNext(out, predicates.size());
+  for (const KernelPredicate& pred : predicates) {
+    AddNext(out, pred.col_idx);
+    AddNext(out, pred.type);
+    AddNextString(out, pred.lower);
+    AddNextString(out, pred.upper);
+    AddNext(out, pred.values.size());
+    for (const string& value : pred.values) {
+      AddNextString(out, value);
+    }
+  }
+  return Status::OK();
+}
+
+ScanKernel::ScanKernel(const Schema* base_schema, const Schema* projection,
+                       scoped_refptr<ScanKernelFunctions> functions)
+  : base_schema_(base_schema),
+    projection_(projection),
+    functions_(std::move(functions)) {}
+
+} // namespace codegen
+} // namespace kudu
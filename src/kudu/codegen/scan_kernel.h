@@ -0,0 +1,183 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_SCAN_KERNEL_H
+#define KUDU_CODEGEN_SCAN_KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+
+class Arena;
+class faststring;
+
+namespace codegen {
+
+class ObjectCache;
+
+// A predicate compiled into a scan kernel, reduced to what the generated
+// code depends on. Unlike a ColumnPredicate, it owns its values, so it may
+// outlive the scan which requested the kernel.
+struct KernelPredicate {
+  // Index of the predicate's column in the base schema.
+  size_t col_idx;
+
+  PredicateType type;
+
+  // Raw cell values. An equality keeps its value in 'lower'. A range keeps
+  // its inclusive lower and exclusive upper bounds, either of which is empty
+  // if the range is unbounded on that side. An in-list keeps its values in
+  // 'values'.
+  std::string lower;
+  std::string upper;
+  std::vector<std::string> values;
+};
+
+// The JITWrapper for codegen::ScanKernel functions.
+//
+// A scan kernel fuses predicate evaluation with projection: it evaluates a
+// conjunction of predicates over a contiguous row of the base schema, and
+// projects the row for read only if the row may match. Rows which don't
+// match are never copied.
+//
+// Only predicates over fixed-size integer columns are compiled in (see
+// ExtractPredicates()), so the kernel filters conservatively: callers must
+// still evaluate the whole predicate set over the rows it projects.
+class ScanKernelFunctions : public JITWrapper {
+ public:
+  // The results of the kernel function.
+  enum KernelResult {
+    // The row doesn't match and wasn't projected.
+    kFiltered = 0,
+    // The row may match and was projected.
+    kProjected = 1,
+    // The row may match, but relocating one of its slices failed.
+    kOutOfMemory = 2
+  };
+
+  typedef int32_t(*KernelFunction)(const uint8_t*, RowBlockRow*, Arena*);
+
+  // Appends the predicates of 'preds' which can be compiled into a scan
+  // kernel over rows of 'base' to 'out', ordered by column.
+  static void ExtractPredicates(const Schema& base,
+                                const std::vector<ColumnPredicate>& preds,
+                                std::vector<KernelPredicate>* out);
+
+  // Compiles the scan kernel for the given base, projection, and predicates,
+  // which must have been extracted by ExtractPredicates().
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  // Loads and saves the object code through 'object_cache' (if not NULL).
+  static Status Create(const Schema& base_schema, const Schema& projection,
+                       std::vector<KernelPredicate> predicates,
+                       scoped_refptr<ScanKernelFunctions>* out,
+                       llvm::TargetMachine** tm = nullptr,
+                       ObjectCache* object_cache = nullptr);
+
+  const Schema& base_schema() { return base_schema_; }
+  const Schema& projection() { return projection_; }
+
+  KernelFunction kernel() const { return kernel_f_; }
+
+  Status EncodeOwnKey(faststring* out) override {
+    return EncodeKey(base_schema_, projection_, predicates_, out);
+  }
+
+  // Two kernels with the same key are functionally equivalent: their
+  // projections are compatible (see codegen::RowProjector::Init()) and they
+  // evaluate the same predicates over the same columns.
+  static Status EncodeKey(const Schema& base, const Schema& proj,
+                          const std::vector<KernelPredicate>& predicates,
+                          faststring* out);
+
+ private:
+  ScanKernelFunctions(const Schema& base_schema, const Schema& projection,
+                      std::vector<KernelPredicate> predicates,
+                      KernelFunction kernel_f,
+                      std::unique_ptr<JITCodeOwner> owner);
+
+  const Schema base_schema_, projection_;
+  const std::vector<KernelPredicate> predicates_;
+  const KernelFunction kernel_f_;
+};
+
+// Applies a compiled scan kernel to rows of the given schemas. Both schemas
+// must remain valid for the lifetime of this object, and must be compatible
+// with the schemas used to create 'functions'.
+class ScanKernel {
+ public:
+  ScanKernel(const Schema* base_schema, const Schema* projection,
+             scoped_refptr<ScanKernelFunctions> functions);
+
+  // If 'src_row' may match the kernel's predicates, projects it for read into
+  // 'dst_row' and sets 'matched' to true. Otherwise, sets 'matched' to false
+  // and leaves 'dst_row' untouched.
+  // Ignores relocations if dst_arena == NULL
+  template<class ContiguousRowType>
+  Status ProjectRowIfMatch(const ContiguousRowType& src_row,
+                           RowBlockRow* dst_row,
+                           Arena* dst_arena,
+                           bool* matched) const {
+    DCHECK_SCHEMA_EQ(*base_schema_, *src_row.schema());
+    DCHECK_SCHEMA_EQ(*projection_, *dst_row->schema());
+    ScanKernelFunctions::KernelFunction f = functions_->kernel();
+    switch (f(src_row.row_data(), dst_row, dst_arena)) {
+      case ScanKernelFunctions::kFiltered:
+        *matched = false;
+        return Status::OK();
+      case ScanKernelFunctions::kProjected:
+        *matched = true;
+        return Status::OK();
+      default:
+        return Status::IOError("out of memory copying slice during projection. "
+                               "Base schema row: ", base_schema_->DebugRow(src_row));
+    }
+  }
+
+  const Schema* base_schema() const { return base_schema_; }
+  const Schema* projection() const { return projection_; }
+
+ private:
+  const Schema* const base_schema_;
+  const Schema* const projection_;
+  scoped_refptr<ScanKernelFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanKernel);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
@@ -38,7 +38,8 @@ class ColumnMaterializationContext {
       pred_(pred),
       block_(block),
       sel_(sel),
-      decoder_eval_status_(kNotSet) {
+      decoder_eval_status_(kNotSet),
+      skip_unselected_rows_(false) {
       if (!pred_ || !sel || !block) {
         decoder_eval_status_ = kDecoderEvalNotSupported;
       }
@@ -110,6 +111,22 @@ class ColumnMaterializationContext {
     decoder_eval_status_ = kDecoderEvalNotSupported;
   }
 
+  // Allows the rows which aren't selected in sel() to be left unmaterialized,
+  // so their cells in block() hold undefined values afterwards. Only safe if
+  // the selection vector is final and nothing reads the unselected cells, as
+  // for a column without a predicate that is materialized after all of the
+  // predicates have been evaluated.
+  void SetSkipUnselectedRows() {
+    DCHECK(pred_ == nullptr && sel_ != nullptr);
+    skip_unselected_rows_ = true;
+  }
+
+  // Checked by CFileIterator::Scan() to determine whether runs of unselected
+  // rows may be seeked past instead of decoded (on true).
+  bool skip_unselected_rows() const {
+    return skip_unselected_rows_;
+  }
+
  private:
   enum DecoderEvalStatus {
     // During scan, will try to evaluate with the decoder, after which the
@@ -138,6 +155,8 @@ class ColumnMaterializationContext {
   SelectionVector* const sel_;
 
   DecoderEvalStatus decoder_eval_status_;
+
+  bool skip_unselected_rows_;
 };
 
 } // namespace kudu
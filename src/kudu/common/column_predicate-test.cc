@@ -17,6 +17,7 @@
 
 #include "kudu/common/column_predicate.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <string>
@@ -26,17 +27,22 @@
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
+#include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/int128.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/random.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
+using std::string;
 using std::vector;
 
 namespace kudu {
@@ -1371,6 +1377,169 @@ TEST_F(TestColumnPredicate, TestSelectivity) {
             0);
 }
 
+// Test that evaluating predicates on contiguous cells, as decoders do, matches
+// evaluating them on a column block, whatever the alignment of the view into
+// the selection vector.
+TEST_F(TestColumnPredicate, TestEvaluateCells) {
+  const int kNumRows = 100;
+  ColumnSchema column("a", INT32);
+  Random rand(SeedRandom());
+  vector<int32_t> values(kNumRows);
+  for (auto& v : values) {
+    v = rand.Uniform(20);
+  }
+  int32_t five = 5;
+  int32_t ten = 10;
+  vector<const void*> in_list = { &five, &ten };
+  vector<ColumnPredicate> predicates = {
+    ColumnPredicate::Range(column, &five, &ten),
+    ColumnPredicate::Range(column, &five, nullptr),
+    ColumnPredicate::Range(column, nullptr, &ten),
+    ColumnPredicate::Equality(column, &five),
+    ColumnPredicate::InList(column, &in_list),
+    ColumnPredicate::IsNotNull(column),
+    ColumnPredicate::IsNull(column),
+  };
+
+  for (const auto& pred : predicates) {
+    SCOPED_TRACE(pred.ToString());
+    for (int offset = 0; offset < 10; offset++) {
+      const int nrows = kNumRows - offset;
+      vector<bool> initial(kNumRows);
+      for (int i = 0; i < kNumRows; i++) {
+        initial[i] = !rand.OneIn(4);
+      }
+
+      // The rows before 'offset' are left untouched by both evaluations.
+      SelectionVector tail(nrows);
+      for (int i = 0; i < nrows; i++) {
+        BitmapChange(tail.mutable_bitmap(), i, initial[offset + i]);
+      }
+      ColumnBlock block(GetTypeInfo(INT32), nullptr, &values[offset], nrows, nullptr);
+      pred.Evaluate(block, &tail);
+      vector<bool> expected(initial);
+      for (int i = 0; i < nrows; i++) {
+        expected[offset + i] = tail.IsRowSelected(i);
+      }
+
+      SelectionVector actual(kNumRows);
+      for (int i = 0; i < kNumRows; i++) {
+        BitmapChange(actual.mutable_bitmap(), i, initial[i]);
+      }
+      SelectionVectorView view(&actual);
+      view.Advance(offset);
+      pred.EvaluateCells(INT32, &values[offset], nrows, &view);
+
+      for (int i = 0; i < kNumRows; i++) {
+        ASSERT_EQ(expected[i], actual.IsRowSelected(i))
+            << "row " << i << " with offset " << offset;
+      }
+    }
+  }
+}
+
+// Test that large IN lists, which are probed in a bitmap or hash table rather
+// than searched, select the same rows as a search of the list would.
+TEST_F(TestColumnPredicate, TestLargeInListEvaluation) {
+  const int kNumRows = 1000;
+  Random rand(SeedRandom());
+
+  // Dense and sparse lists of integers, the latter straddling zero.
+  for (int64_t spread : { 2, 1000000 }) {
+    SCOPED_TRACE(spread);
+    vector<int64_t> list_values;
+    for (int i = 0; i < 100; i++) {
+      list_values.push_back((static_cast<int64_t>(rand.Uniform(200)) - 100) * spread);
+    }
+    list_values.push_back(0);
+    vector<const void*> in_list;
+    for (const auto& v : list_values) {
+      in_list.push_back(&v);
+    }
+    ColumnPredicate pred = ColumnPredicate::InList(ColumnSchema("a", INT64), &in_list);
+    ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+
+    vector<int64_t> values(kNumRows);
+    for (auto& v : values) {
+      v = (static_cast<int64_t>(rand.Uniform(200)) - 100) * spread + rand.Uniform(2);
+    }
+    SelectionVector sel(kNumRows);
+    sel.SetAllTrue();
+    pred.Evaluate(ColumnBlock(GetTypeInfo(INT64), nullptr, values.data(), kNumRows, nullptr),
+                  &sel);
+    SelectionVector cells_sel(kNumRows);
+    cells_sel.SetAllTrue();
+    SelectionVectorView view(&cells_sel);
+    pred.EvaluateCells(INT64, values.data(), kNumRows, &view);
+    for (int i = 0; i < kNumRows; i++) {
+      bool expected = std::find(list_values.begin(), list_values.end(), values[i]) !=
+                      list_values.end();
+      ASSERT_EQ(expected, sel.IsRowSelected(i)) << values[i];
+      ASSERT_EQ(expected, cells_sel.IsRowSelected(i)) << values[i];
+    }
+  }
+
+  // Strings.
+  vector<string> list_strings;
+  for (int i = 0; i < 100; i++) {
+    list_strings.push_back(std::to_string(rand.Uniform(200)));
+  }
+  vector<Slice> list_slices(list_strings.begin(), list_strings.end());
+  vector<const void*> in_list;
+  for (const auto& s : list_slices) {
+    in_list.push_back(&s);
+  }
+  ColumnPredicate pred = ColumnPredicate::InList(ColumnSchema("a", STRING), &in_list);
+  ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+
+  vector<string> strings;
+  for (int i = 0; i < kNumRows; i++) {
+    strings.push_back(std::to_string(rand.Uniform(200)));
+  }
+  vector<Slice> slices(strings.begin(), strings.end());
+  SelectionVector sel(kNumRows);
+  sel.SetAllTrue();
+  pred.Evaluate(ColumnBlock(GetTypeInfo(BINARY), nullptr, slices.data(), kNumRows, nullptr),
+                &sel);
+  for (int i = 0; i < kNumRows; i++) {
+    bool expected = std::find(list_strings.begin(), list_strings.end(), strings[i]) !=
+                    list_strings.end();
+    ASSERT_EQ(expected, sel.IsRowSelected(i)) << strings[i];
+  }
+}
+
+// Measure the throughput of evaluating IN list predicates of various sizes.
+TEST_F(TestColumnPredicate, TestInListEvaluationPerformance) {
+  const int kNumRows = AllowSlowTests() ? 10000000 : 100000;
+  Random rand(SeedRandom());
+  vector<int64_t> values(kNumRows);
+  for (auto& v : values) {
+    v = rand.Next64();
+  }
+  ColumnBlock block(GetTypeInfo(INT64), nullptr, values.data(), kNumRows, nullptr);
+
+  for (int list_size : { 4, 16, 100, 1000, 10000 }) {
+    // Half of the rows match a sparse list, which is hashed.
+    vector<int64_t> list_values;
+    for (int i = 0; i < list_size; i++) {
+      list_values.push_back(values[rand.Uniform(kNumRows)]);
+    }
+    vector<const void*> in_list;
+    for (const auto& v : list_values) {
+      in_list.push_back(&v);
+    }
+    ColumnPredicate pred = ColumnPredicate::InList(ColumnSchema("a", INT64), &in_list);
+
+    SelectionVector sel(kNumRows);
+    sel.SetAllTrue();
+    LOG_TIMING(INFO, strings::Substitute("evaluating an IN list of $0 values on $1 rows",
+                                         list_size, kNumRows)) {
+      pred.Evaluate(block, &sel);
+    }
+    ASSERT_GT(sel.CountSelected(), 0);
+  }
+}
+
 TEST_F(TestColumnPredicate, TestRedaction) {
   ASSERT_NE("", gflags::SetCommandLineOption("redact", "log"));
   ColumnSchema column_i32("a", INT32, true);
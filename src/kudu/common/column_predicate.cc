@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cstring>
 #include <iterator>
+#include <type_traits>
 
 #include <boost/optional/optional.hpp>
 
@@ -29,18 +30,189 @@
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/hash_util.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/memory/arena.h"
 
 using std::move;
+using std::shared_ptr;
 using std::string;
 using std::vector;
 
 namespace kudu {
 
+// Integers whose range is at most 64 times the number of values are kept in a
+// bitmap over the range, taking at most 8 bytes per value. Other integers and
+// binary values are kept in an open-addressing hash table with linear probing,
+// which is at most half full.
+struct ColumnPredicate::InListSet {
+  // Lists shorter than this are searched about as quickly as they're hashed.
+  static const size_t kMinValues = 16;
+
+  static shared_ptr<const InListSet> Build(DataType physical_type,
+                                           const vector<const void*>& values);
+
+  template <typename CppType>
+  static shared_ptr<const InListSet> BuildForIntegers(const vector<const void*>& values);
+
+  static shared_ptr<const InListSet> BuildForBinary(const vector<const void*>& values);
+
+  // Sizes the hash table for 'num_values' values.
+  void InitHashTable(size_t num_values) {
+    int bits = 1;
+    while ((1ULL << bits) < 2 * num_values) {
+      bits++;
+    }
+    shift = 64 - bits;
+    mask = (1ULL << bits) - 1;
+  }
+
+  static uint64_t HashInt(uint64_t v) {
+    // Fibonacci hashing: the high bits of the product are well mixed.
+    return v * 0x9e3779b97f4a7c15ULL;
+  }
+
+  static uint64_t HashBinary(const Slice& s) {
+    return HashUtil::MurmurHash2_64(s.data(), s.size(), 0);
+  }
+
+  // Integers are sign-extended to 64 bits, which keeps them ordered relative
+  // to the minimum of the list when subtracted from it.
+  bool ContainsInt(uint64_t v) const {
+    if (is_bitmap) {
+      uint64_t offset = v - min;
+      return offset <= range && BitmapTest(bitmap.data(), offset);
+    }
+    if (v == 0) {
+      return contains_zero;
+    }
+    for (uint64_t i = HashInt(v) >> shift; ; i = (i + 1) & mask) {
+      uint64_t slot = int_slots[i];
+      if (slot == v) return true;
+      if (slot == 0) return false;
+    }
+  }
+
+  bool ContainsBinary(const Slice& s) const {
+    for (uint64_t i = HashBinary(s) >> shift; ; i = (i + 1) & mask) {
+      const Slice* slot = binary_slots[i];
+      if (slot == nullptr) return false;
+      if (*slot == s) return true;
+    }
+  }
+
+  template <typename CppType>
+  bool ContainsValue(const CppType& v) const {
+    return ContainsInt(static_cast<uint64_t>(v));
+  }
+
+  bool ContainsValue(const Slice& v) const {
+    return ContainsBinary(v);
+  }
+
+  template <DataType PhysicalType>
+  bool Contains(const void* cell) const {
+    typedef typename DataTypeTraits<PhysicalType>::cpp_type CppType;
+    return ContainsValue(*static_cast<const CppType*>(cell));
+  }
+
+  bool is_bitmap = false;
+
+  // For a bitmap, the smallest value, the offset of the largest from it, and
+  // the bits at the offsets of the values.
+  uint64_t min = 0;
+  uint64_t range = 0;
+  vector<uint8_t> bitmap;
+
+  // For a hash table, the index of a value's first slot is the top bits of
+  // its hash, shifted by 'shift'.
+  int shift = 0;
+  uint64_t mask = 0;
+
+  // Empty integer slots are 0, so whether the list holds 0 is kept aside.
+  vector<uint64_t> int_slots;
+  bool contains_zero = false;
+
+  // Binary slots point to the Slices of the list, and are null when empty.
+  vector<const Slice*> binary_slots;
+};
+
+shared_ptr<const ColumnPredicate::InListSet> ColumnPredicate::InListSet::Build(
+    DataType physical_type, const vector<const void*>& values) {
+  if (values.size() < kMinValues) {
+    return nullptr;
+  }
+  switch (physical_type) {
+    case INT8: return BuildForIntegers<int8_t>(values);
+    case INT16: return BuildForIntegers<int16_t>(values);
+    case INT32: return BuildForIntegers<int32_t>(values);
+    case INT64: return BuildForIntegers<int64_t>(values);
+    case UINT8: return BuildForIntegers<uint8_t>(values);
+    case UINT16: return BuildForIntegers<uint16_t>(values);
+    case UINT32: return BuildForIntegers<uint32_t>(values);
+    case UINT64: return BuildForIntegers<uint64_t>(values);
+    case BINARY: return BuildForBinary(values);
+    // Floating point values which compare equal may differ in their bits, and
+    // 128-bit integers don't fit in the slots, so they're searched instead.
+    default: return nullptr;
+  }
+}
+
+template <typename CppType>
+shared_ptr<const ColumnPredicate::InListSet> ColumnPredicate::InListSet::BuildForIntegers(
+    const vector<const void*>& values) {
+  auto set = std::make_shared<InListSet>();
+  // The values are sorted.
+  set->min = static_cast<uint64_t>(UnalignedLoad<CppType>(values.front()));
+  set->range = static_cast<uint64_t>(UnalignedLoad<CppType>(values.back())) - set->min;
+  if (set->range / 64 < values.size()) {
+    set->is_bitmap = true;
+    set->bitmap.resize(BitmapSize(set->range + 1));
+    for (const void* value : values) {
+      BitmapSet(set->bitmap.data(),
+                static_cast<uint64_t>(UnalignedLoad<CppType>(value)) - set->min);
+    }
+    return set;
+  }
+
+  set->InitHashTable(values.size());
+  set->int_slots.resize(set->mask + 1);
+  for (const void* value : values) {
+    uint64_t v = static_cast<uint64_t>(UnalignedLoad<CppType>(value));
+    if (v == 0) {
+      set->contains_zero = true;
+      continue;
+    }
+    // The values are distinct, so each takes the first empty slot.
+    uint64_t i = HashInt(v) >> set->shift;
+    while (set->int_slots[i] != 0) {
+      i = (i + 1) & set->mask;
+    }
+    set->int_slots[i] = v;
+  }
+  return set;
+}
+
+shared_ptr<const ColumnPredicate::InListSet> ColumnPredicate::InListSet::BuildForBinary(
+    const vector<const void*>& values) {
+  auto set = std::make_shared<InListSet>();
+  set->InitHashTable(values.size());
+  set->binary_slots.resize(set->mask + 1);
+  for (const void* value : values) {
+    const Slice* s = static_cast<const Slice*>(value);
+    uint64_t i = HashBinary(*s) >> set->shift;
+    while (set->binary_slots[i] != nullptr) {
+      i = (i + 1) & set->mask;
+    }
+    set->binary_slots[i] = s;
+  }
+  return set;
+}
+
 ColumnPredicate::ColumnPredicate(PredicateType predicate_type,
                                  ColumnSchema column,
                                  const void* lower,
@@ -190,6 +362,7 @@ void ColumnPredicate::SetToNone() {
   predicate_type_ = PredicateType::None;
   lower_ = nullptr;
   upper_ = nullptr;
+  in_list_set_.reset();
 }
 
 // TODO(granthenke): For decimal columns, use column_.type_attributes().precision
@@ -248,6 +421,11 @@ void ColumnPredicate::Simplify() {
         upper_ = nullptr;
         values_.clear();
       }
+      if (predicate_type_ == PredicateType::InList) {
+        in_list_set_ = InListSet::Build(type_info->physical_type(), values_);
+      } else {
+        in_list_set_.reset();
+      }
       return;
     };
     case PredicateType::InBloomFilter: {
@@ -448,6 +626,7 @@ void ColumnPredicate::MergeIntoIsNotNull(const ColumnPredicate &other) {
       lower_ = other.lower_;
       upper_ = other.upper_;
       values_ = other.values_;
+      in_list_set_ = other.in_list_set_;
       bloom_filters_ = other.bloom_filters_;
       return;
     }
@@ -648,26 +827,125 @@ void ColumnPredicate::MergeIntoBloomFilter(const ColumnPredicate &other) {
 namespace {
 template <typename P>
 void ApplyPredicate(const ColumnBlock& block, SelectionVector* sel, P p) {
+  // Only visit the runs of selected rows, so that sparse selections skip the
+  // unselected rows many at a time.
+  SetBitRunIterator iter(sel->bitmap(), block.nrows());
+  size_t start;
+  size_t len;
   if (block.is_nullable()) {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void* cell = block.nullable_cell_ptr(i);
-      if (cell == nullptr || !p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+    while (iter.Next(&start, &len)) {
+      for (size_t i = start; i < start + len; i++) {
+        const void* cell = block.nullable_cell_ptr(i);
+        if (cell == nullptr || !p(cell)) {
+          BitmapClear(sel->mutable_bitmap(), i);
+        }
       }
     }
   } else {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void* cell = block.cell_ptr(i);
-      if (!p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+    while (iter.Next(&start, &len)) {
+      for (size_t i = start; i < start + len; i++) {
+        if (!p(block.cell_ptr(i))) {
+          BitmapClear(sel->mutable_bitmap(), i);
+        }
       }
     }
   }
 }
+
+// Evaluate 'p' on each of the 'nrows' cells at 'cells', one at a time.
+template <typename CppType, typename P>
+void ApplyPredicateToCells(const void* cells, size_t nrows, SelectionVectorView* sel, P p) {
+  const CppType* vals = static_cast<const CppType*>(cells);
+  for (size_t i = 0; i < nrows; i++) {
+    if (sel->TestBit(i) && !p(&vals[i])) {
+      sel->ClearBit(i);
+    }
+  }
+}
+
+// Evaluate a range or equality predicate on each of the 'nrows' integer cells
+// at 'cells'. Returns false if the cells aren't integers, in which case the
+// selection vector is untouched.
+template <typename CppType>
+bool ApplyIntegerPredicateToCells(PredicateType type,
+                                  const void* lower,
+                                  const void* upper,
+                                  const void* cells,
+                                  size_t nrows,
+                                  SelectionVectorView* sel,
+                                  std::true_type /* is_integral */) {
+  const CppType* vals = static_cast<const CppType*>(cells);
+  if (type == PredicateType::Equality) {
+    const CppType value = UnalignedLoad<CppType>(lower);
+    sel->AndWith(nrows, [&] (size_t i) { return vals[i] == value; });
+    return true;
+  }
+  DCHECK(type == PredicateType::Range);
+  if (lower == nullptr) {
+    const CppType u = UnalignedLoad<CppType>(upper);
+    sel->AndWith(nrows, [&] (size_t i) { return vals[i] < u; });
+  } else if (upper == nullptr) {
+    const CppType l = UnalignedLoad<CppType>(lower);
+    sel->AndWith(nrows, [&] (size_t i) { return vals[i] >= l; });
+  } else {
+    const CppType l = UnalignedLoad<CppType>(lower);
+    const CppType u = UnalignedLoad<CppType>(upper);
+    // Non-short-circuiting '&' keeps the comparison free of branches.
+    sel->AndWith(nrows, [&] (size_t i) { return (vals[i] >= l) & (vals[i] < u); });
+  }
+  return true;
+}
+
+template <typename CppType>
+bool ApplyIntegerPredicateToCells(PredicateType /* type */,
+                                  const void* /* lower */,
+                                  const void* /* upper */,
+                                  const void* /* cells */,
+                                  size_t /* nrows */,
+                                  SelectionVectorView* /* sel */,
+                                  std::false_type /* is_integral */) {
+  return false;
+}
 } // anonymous namespace
 
+template <DataType PhysicalType>
+void ColumnPredicate::EvaluateCellsForPhysicalType(const void* cells,
+                                                   size_t nrows,
+                                                   SelectionVectorView* sel) const {
+  typedef typename DataTypeTraits<PhysicalType>::cpp_type CppType;
+  switch (predicate_type()) {
+    case PredicateType::Range:
+    case PredicateType::Equality: {
+      if (ApplyIntegerPredicateToCells<CppType>(predicate_type(), lower_, upper_,
+                                                cells, nrows, sel,
+                                                std::is_integral<CppType>())) {
+        return;
+      }
+      break;
+    }
+    case PredicateType::IsNotNull:
+      // The cells aren't null.
+      return;
+    case PredicateType::InList:
+      if (in_list_set_) {
+        const CppType* vals = static_cast<const CppType*>(cells);
+        const InListSet* set = in_list_set_.get();
+        sel->AndWith(nrows, [&] (size_t i) { return set->ContainsValue(vals[i]); });
+        return;
+      }
+      break;
+    case PredicateType::None:
+    case PredicateType::IsNull:
+      sel->ClearBits(nrows);
+      return;
+    default:
+      break;
+  }
+  ApplyPredicateToCells<CppType>(cells, nrows, sel, [this] (const void* cell) {
+    return EvaluateCell<PhysicalType>(cell);
+  });
+}
+
 template <DataType PhysicalType>
 void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
                                               SelectionVector* sel) const {
@@ -697,9 +975,12 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
     };
     case PredicateType::IsNotNull: {
       if (!block.is_nullable()) return;
-      // TODO: make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
+      // The bits of the null bitmap are set for the non-null cells. The rows
+      // in the last partial byte are left to the loop, since the selection
+      // vector may hold more rows than the block.
+      size_t n_full_bytes_rows = block.nrows() & ~7;
+      BitmapMergeAnd(sel->mutable_bitmap(), block.null_bitmap(), n_full_bytes_rows);
+      for (size_t i = n_full_bytes_rows; i < block.nrows(); i++) {
         if (sel->IsRowSelected(i) && block.is_null(i)) {
           BitmapClear(sel->mutable_bitmap(), i);
         }
@@ -711,9 +992,9 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
         BitmapChangeBits(sel->mutable_bitmap(), 0, block.nrows(), false);
         return;
       }
-      // TODO(wdberkeley): make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
+      size_t n_full_bytes_rows = block.nrows() & ~7;
+      BitmapMergeAndNot(sel->mutable_bitmap(), block.null_bitmap(), n_full_bytes_rows);
+      for (size_t i = n_full_bytes_rows; i < block.nrows(); i++) {
         if (sel->IsRowSelected(i) && !block.is_null(i)) {
           BitmapClear(sel->mutable_bitmap(), i);
         }
@@ -721,6 +1002,13 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
       return;
     }
     case PredicateType::InList: {
+      if (in_list_set_) {
+        const InListSet* set = in_list_set_.get();
+        ApplyPredicate(block, sel, [set] (const void* cell) {
+          return set->Contains<PhysicalType>(cell);
+        });
+        return;
+      }
       ApplyPredicate(block, sel, [this] (const void* cell) {
         return std::binary_search(values_.begin(), values_.end(), cell,
                                   [] (const void* lhs, const void* rhs) {
@@ -779,6 +1067,27 @@ void ColumnPredicate::Evaluate(const ColumnBlock& block, SelectionVector* sel) c
   }
 }
 
+void ColumnPredicate::EvaluateCells(DataType type, const void* cells, size_t nrows,
+                                    SelectionVectorView* sel) const {
+  DCHECK(sel);
+  switch (type) {
+    case BOOL: return EvaluateCellsForPhysicalType<BOOL>(cells, nrows, sel);
+    case INT8: return EvaluateCellsForPhysicalType<INT8>(cells, nrows, sel);
+    case INT16: return EvaluateCellsForPhysicalType<INT16>(cells, nrows, sel);
+    case INT32: return EvaluateCellsForPhysicalType<INT32>(cells, nrows, sel);
+    case INT64: return EvaluateCellsForPhysicalType<INT64>(cells, nrows, sel);
+    case INT128: return EvaluateCellsForPhysicalType<INT128>(cells, nrows, sel);
+    case UINT8: return EvaluateCellsForPhysicalType<UINT8>(cells, nrows, sel);
+    case UINT16: return EvaluateCellsForPhysicalType<UINT16>(cells, nrows, sel);
+    case UINT32: return EvaluateCellsForPhysicalType<UINT32>(cells, nrows, sel);
+    case UINT64: return EvaluateCellsForPhysicalType<UINT64>(cells, nrows, sel);
+    case FLOAT: return EvaluateCellsForPhysicalType<FLOAT>(cells, nrows, sel);
+    case DOUBLE: return EvaluateCellsForPhysicalType<DOUBLE>(cells, nrows, sel);
+    case BINARY: return EvaluateCellsForPhysicalType<BINARY>(cells, nrows, sel);
+    default: LOG(FATAL) << "unknown physical type: " << GetTypeInfo(type)->name();
+  }
+}
+
 string ColumnPredicate::ToString() const {
   switch (predicate_type()) {
     case PredicateType::None: return strings::Substitute("$0 NONE", column_.name());
@@ -21,6 +21,7 @@
 #include <cstdint>
 
 #include <algorithm>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -39,6 +40,7 @@ namespace kudu {
 class Arena;
 class ColumnBlock;
 class SelectionVector;
+class SelectionVectorView;
 
 enum class PredicateType {
   // A predicate which always evaluates to false.
@@ -225,6 +227,17 @@ class ColumnPredicate {
   // Otherwise, use EvaluateCell<DataType>.
   bool EvaluateCell(DataType type, const void* cell) const;
 
+  // Evaluate the predicate on 'nrows' non-null cells of the given physical
+  // type, stored contiguously at 'cells', for use by decoders which evaluate
+  // predicates as they materialize a column.
+  //
+  // As with Evaluate(), this is an 'AND' with the current contents of *sel.
+  // Range and equality predicates on integer columns are evaluated without
+  // branches, a byte of the selection vector at a time, so that the compiler
+  // may vectorize the comparisons.
+  void EvaluateCells(DataType type, const void* cells, size_t nrows,
+                     SelectionVectorView* sel) const;
+
   // Print the predicate for debugging.
   std::string ToString() const;
 
@@ -335,6 +348,10 @@ class ColumnPredicate {
                   const void* lower,
                   const void* upper);
 
+  // The values of an InList predicate, laid out to be probed in constant
+  // time rather than searched. See column_predicate.cc.
+  struct InListSet;
+
   // Transition to a None predicate type.
   void SetToNone();
 
@@ -361,6 +378,10 @@ class ColumnPredicate {
 
   // Templated evaluation to inline the dispatch of comparator. Templating this
   // allows dispatch to occur only once per batch.
+  template <DataType PhysicalType>
+  void EvaluateCellsForPhysicalType(const void* cells, size_t nrows,
+                                    SelectionVectorView* sel) const;
+
   template <DataType PhysicalType>
   void EvaluateForPhysicalType(const ColumnBlock& block,
                                SelectionVector* sel) const;
@@ -425,6 +446,12 @@ class ColumnPredicate {
   // The list of values to check column against if this is an InList predicate.
   std::vector<const void*> values_;
 
+  // The values of an InList predicate of integers or binary values, if there
+  // are enough of them that probing a set is quicker than a binary search of
+  // 'values_'. Built by Simplify(), once the list is final, and shared between
+  // copies of the predicate.
+  std::shared_ptr<const InListSet> in_list_set_;
+
   // The list of bloom filter in this predicate.
   std::vector<BloomFilterInner> bloom_filters_;
 };
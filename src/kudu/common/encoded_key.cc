@@ -51,12 +51,20 @@ EncodedKey::EncodedKey(faststring* data,
 }
 
 gscoped_ptr<EncodedKey> EncodedKey::FromContiguousRow(const ConstContiguousRow& row) {
-  EncodedKeyBuilder kb(row.schema());
-  for (int i = 0; i < row.schema()->num_key_columns(); i++) {
-    kb.AddColumnKey(row.cell_ptr(i));
+  // This runs for every row written, so rather than going through an
+  // EncodedKeyBuilder, encode the key columns straight into a buffer sized
+  // for the key, and size the raw keys exactly.
+  const Schema* schema = row.schema();
+  const size_t num_key_cols = schema->num_key_columns();
+  faststring data(schema->key_byte_size());
+  vector<const void*> raw_keys(num_key_cols);
+  for (size_t i = 0; i < num_key_cols; i++) {
+    const void* raw_key = row.cell_ptr(i);
+    GetKeyEncoder<faststring>(schema->column(i).type_info()).Encode(
+        raw_key, i + 1 == num_key_cols, &data);
+    raw_keys[i] = raw_key;
   }
-  return make_gscoped_ptr(kb.BuildEncodedKey());
-
+  return gscoped_ptr<EncodedKey>(new EncodedKey(&data, &raw_keys, num_key_cols));
 }
 
 Status EncodedKey::DecodeEncodedString(const Schema& schema,
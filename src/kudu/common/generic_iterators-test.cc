@@ -163,7 +163,9 @@ class TestIntRangePredicate {
   ColumnPredicate pred_;
 };
 
-void TestMerge(const TestIntRangePredicate &predicate) {
+// If 'overlapping' is false, each list covers its own key range, and the
+// lists are passed to the merge in descending order of their ranges.
+void TestMerge(const TestIntRangePredicate &predicate, bool overlapping = true) {
   vector<shared_ptr<RowwiseIterator>> to_merge;
   vector<uint32_t> ints;
   vector<uint32_t> expected;
@@ -178,7 +180,7 @@ void TestMerge(const TestIntRangePredicate &predicate) {
     ints.clear();
     ints.reserve(FLAGS_num_rows);
 
-    uint32_t entry = 0;
+    uint32_t entry = overlapping ? 0 : (FLAGS_num_lists - i - 1) * FLAGS_num_rows * 5;
     for (int j = 0; j < FLAGS_num_rows; j++) {
       entry += rand() % 5;
       ints.push_back(entry);
@@ -247,6 +249,18 @@ TEST(TestMergeIterator, TestMergePredicate2) {
   TestMerge(predicate);
 }
 
+// Merging lists whose key ranges don't overlap copies runs of rows without
+// comparing them; make sure those runs stay in order.
+TEST(TestMergeIterator, TestMergeNonOverlapping) {
+  TestIntRangePredicate predicate(0, MathLimits<uint32_t>::kMax);
+  TestMerge(predicate, false);
+}
+
+TEST(TestMergeIterator, TestMergeNonOverlappingPredicate) {
+  TestIntRangePredicate predicate(FLAGS_num_rows, FLAGS_num_rows * 5 * 2);
+  TestMerge(predicate, false);
+}
+
 // Test that the MaterializingIterator properly evaluates predicates when they apply
 // to single columns.
 TEST(TestMaterializingIterator, TestMaterializingPredicatePushdown) {
@@ -119,6 +119,13 @@ class MergeIterState {
     }
   }
 
+  // The last selected row of the current block. All of the rows from
+  // next_row() onwards up to and including this one are valid.
+  const RowBlockRow& last_row() {
+    DCHECK_LT(num_advanced_, num_valid_);
+    return last_row_;
+  }
+
   bool IsBlockExhausted() const {
     return num_advanced_ == num_valid_;
   }
@@ -140,10 +147,16 @@ class MergeIterState {
       DCHECK_LE(selection->CountSelected(), read_block_.nrows());
       num_valid_ = selection->CountSelected();
       VLOG(2) << selection->CountSelected() << "/" << read_block_.nrows() << " rows selected";
-      // Seek next_row_ to the first selected row.
+      // Seek next_row_ to the first selected row, and last_row_ to the last.
       for (next_row_idx_ = 0; next_row_idx_ < read_block_.nrows(); next_row_idx_++) {
         if (selection->IsRowSelected(next_row_idx_)) {
           next_row_.Reset(&read_block_, next_row_idx_);
+          for (size_t i = read_block_.nrows(); i-- > next_row_idx_;) {
+            if (selection->IsRowSelected(i)) {
+              last_row_.Reset(&read_block_, i);
+              break;
+            }
+          }
           return Status::OK();
         }
       }
@@ -170,6 +183,8 @@ class MergeIterState {
   RowBlock read_block_;
   // The row currently pointed to by the iterator.
   RowBlockRow next_row_;
+  // The last selected row in read_block_.
+  RowBlockRow last_row_;
   // Row index of next_row_ in read_block_.
   size_t next_row_idx_;
   // Number of rows we've advanced past in the current RowBlock.
@@ -263,46 +278,123 @@ void MergeIterator::PrepareBatch(RowBlock* dst) {
   dst->Resize(std::min(dst->row_capacity(), available));
 }
 
-// TODO: this is an obvious spot to add codegen - there's a ton of branching
-// and such around the comparisons. A simple experiment indicated there's some
-// 2x to be gained.
+bool MergeIterator::RowLess(const RowBlockRow& a, size_t a_idx,
+                            const RowBlockRow& b, size_t b_idx) const {
+  int cmp = schema_.Compare(a, b);
+  // Break ties by sub-iterator index, so that equal keys are yielded in the
+  // order of the sub-iterators, as the linear merge did.
+  return cmp < 0 || (cmp == 0 && a_idx < b_idx);
+}
+
+bool MergeIterator::StateLess(size_t a, size_t b) const {
+  // Exhausted sub-iterators sort after all others.
+  if (iters_[a]->IsFullyExhausted()) return false;
+  if (iters_[b]->IsFullyExhausted()) return true;
+  return RowLess(iters_[a]->next_row(), a, iters_[b]->next_row(), b);
+}
+
+void MergeIterator::BuildLoserTree() {
+  // The tree is laid out like a binary heap: internal node 'n' has children
+  // 2n and 2n+1, and sub-iterator 'i' is the leaf at index i + k. Each
+  // internal node holds the loser of the match played there, and node 0
+  // holds the overall winner.
+  const size_t k = iters_.size();
+  loser_tree_.resize(k);
+  vector<size_t> winners(2 * k);
+  for (size_t i = 0; i < k; i++) {
+    winners[k + i] = i;
+  }
+  for (size_t n = k - 1; n >= 1; n--) {
+    size_t l = winners[2 * n];
+    size_t r = winners[2 * n + 1];
+    if (StateLess(l, r)) {
+      winners[n] = l;
+      loser_tree_[n] = r;
+    } else {
+      winners[n] = r;
+      loser_tree_[n] = l;
+    }
+  }
+  loser_tree_[0] = k > 1 ? winners[1] : 0;
+}
+
+void MergeIterator::ReplayLoserTree() {
+  // Only the winner's next row changed, so only the matches on the path
+  // from its leaf to the root need to be replayed.
+  size_t winner = loser_tree_[0];
+  for (size_t n = (winner + iters_.size()) / 2; n >= 1; n /= 2) {
+    if (StateLess(loser_tree_[n], winner)) {
+      std::swap(loser_tree_[n], winner);
+    }
+  }
+  loser_tree_[0] = winner;
+}
+
+ssize_t MergeIterator::RunnerUp() const {
+  // The runner-up lost a match to the winner, so it's one of the losers on
+  // the winner's path.
+  const size_t winner = loser_tree_[0];
+  ssize_t runner_up = -1;
+  for (size_t n = (winner + iters_.size()) / 2; n >= 1; n /= 2) {
+    if (runner_up == -1 || StateLess(loser_tree_[n], runner_up)) {
+      runner_up = loser_tree_[n];
+    }
+  }
+  if (runner_up != -1 && iters_[runner_up]->IsFullyExhausted()) {
+    return -1;
+  }
+  return runner_up;
+}
+
 Status MergeIterator::MaterializeBlock(RowBlock *dst) {
   // Initialize the selection vector.
   // MergeIterState only returns selected rows.
   dst->selection_vector()->SetAllTrue();
-  for (size_t dst_row_idx = 0; dst_row_idx < dst->nrows(); dst_row_idx++) {
-    RowBlockRow dst_row = dst->row(dst_row_idx);
-
-    // Find the sub-iterator which is currently smallest
-    MergeIterState *smallest = nullptr;
-    ssize_t smallest_idx = -1;
-
-    // Typically the number of iters_ is not that large, so using a priority
-    // queue is not worth it
-    for (size_t i = 0; i < iters_.size(); i++) {
-      unique_ptr<MergeIterState> &state = iters_[i];
-
-      if (smallest == nullptr ||
-          schema_.Compare(state->next_row(), smallest->next_row()) < 0) {
-        smallest = state.get();
-        smallest_idx = i;
-      }
-    }
-
-    // If no iterators had any row left, then we're done iterating.
-    if (PREDICT_FALSE(smallest == nullptr)) break;
-
-    // Otherwise, copy the row from the smallest one, and advance it
-    RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
-    RETURN_NOT_OK(smallest->Advance());
+  if (iters_.empty()) {
+    return Status::OK();
+  }
 
-    if (smallest->IsFullyExhausted()) {
-      std::lock_guard<rw_spinlock> l(iters_lock_);
-      AddIterStats(*smallest->iter(), &finished_iter_stats_by_col_);
-      iters_.erase(iters_.begin() + smallest_idx);
+  // Sub-iterators remain in place while the block is filled, and the
+  // exhausted ones are removed once it's done.
+  BuildLoserTree();
+  size_t dst_row_idx = 0;
+  while (dst_row_idx < dst->nrows()) {
+    const size_t winner_idx = loser_tree_[0];
+    MergeIterState* winner = iters_[winner_idx].get();
+
+    // If the winner has no row left, then no iterator has any: we're done.
+    if (PREDICT_FALSE(winner->IsFullyExhausted())) break;
+
+    // Sub-iterators often cover disjoint key ranges (e.g. after compaction).
+    // If the rest of the winner's block sorts before every other
+    // sub-iterator's next row, the whole run can be copied without
+    // comparing each row.
+    size_t run = 1;
+    ssize_t runner_up_idx = RunnerUp();
+    if (runner_up_idx == -1 ||
+        RowLess(winner->last_row(), winner_idx,
+                iters_[runner_up_idx]->next_row(), runner_up_idx)) {
+      run = std::min(winner->remaining_in_block(), dst->nrows() - dst_row_idx);
+    }
+    for (size_t i = 0; i < run; i++, dst_row_idx++) {
+      RowBlockRow dst_row = dst->row(dst_row_idx);
+      RETURN_NOT_OK(CopyRow(winner->next_row(), &dst_row, dst->arena()));
+      RETURN_NOT_OK(winner->Advance());
     }
+    ReplayLoserTree();
   }
 
+  std::lock_guard<rw_spinlock> l(iters_lock_);
+  iters_.erase(
+      remove_if(iters_.begin(), iters_.end(), [&] (const unique_ptr<MergeIterState>& state) {
+        if (state->IsFullyExhausted()) {
+          AddIterStats(*state->iter(), &finished_iter_stats_by_col_);
+          return true;
+        }
+        return false;
+      }),
+      iters_.end());
+
   return Status::OK();
 }
 
@@ -563,6 +655,9 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
                                      nullptr,
                                      &dst_col,
                                      dst->selection_vector());
+    // All predicates have been evaluated, so rows filtered out by them don't
+    // need to be materialized.
+    ctx.SetSkipUnselectedRows();
     RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
   }
 
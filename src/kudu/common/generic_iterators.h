@@ -17,6 +17,8 @@
 #ifndef KUDU_COMMON_MERGE_ITERATOR_H
 #define KUDU_COMMON_MERGE_ITERATOR_H
 
+#include <sys/types.h>
+
 #include <cstddef>
 #include <cstdint>
 #include <deque>
@@ -44,6 +46,7 @@ namespace kudu {
 
 class MergeIterState;
 class RowBlock;
+class RowBlockRow;
 
 // An iterator which merges the results of other iterators, comparing
 // based on keys.
@@ -74,6 +77,25 @@ class MergeIterator : public RowwiseIterator {
   Status MaterializeBlock(RowBlock* dst);
   Status InitSubIterators(ScanSpec *spec);
 
+  // Returns true if row 'a' of sub-iterator 'a_idx' must be yielded before
+  // row 'b' of sub-iterator 'b_idx'.
+  bool RowLess(const RowBlockRow& a, size_t a_idx,
+               const RowBlockRow& b, size_t b_idx) const;
+
+  // Returns true if the next row of sub-iterator 'a' must be yielded before
+  // the next row of sub-iterator 'b'.
+  bool StateLess(size_t a, size_t b) const;
+
+  // Builds 'loser_tree_' over the next rows of all of 'iters_'.
+  void BuildLoserTree();
+
+  // Restores 'loser_tree_' after the winner has advanced.
+  void ReplayLoserTree();
+
+  // Returns the index of the sub-iterator whose next row follows the
+  // winner's, or -1 if every other sub-iterator is exhausted.
+  ssize_t RunnerUp() const;
+
   const Schema schema_;
 
   bool initted_;
@@ -87,6 +109,11 @@ class MergeIterator : public RowwiseIterator {
   mutable rw_spinlock iters_lock_;
   std::vector<std::unique_ptr<MergeIterState>> iters_;
 
+  // A tournament tree of loser indexes into 'iters_', used to find the
+  // sub-iterator with the smallest next row in O(log n) comparisons. Only
+  // valid during MaterializeBlock().
+  std::vector<size_t> loser_tree_;
+
   // Statistics (keyed by projection column index) accumulated so far by any
   // fully-consumed sub-iterators.
   std::vector<IteratorStats> finished_iter_stats_by_col_;
@@ -37,6 +37,10 @@ struct IteratorStats {
   // The number of CFile data blocks read from disk (or cache) by the iterator.
   int64_t blocks_read;
 
+  // The number of CFile data blocks whose zone maps showed that none of their
+  // rows could match the scan's predicates, so that they weren't read.
+  int64_t blocks_skipped;
+
   // Add statistics contained 'other' to this object (for each field
   // in this object, increment it by the value of the equivalent field
   // in 'other').
@@ -39,6 +39,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/decimal_util.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/hash_util.h"
 #include "kudu/util/int128.h"
 #include "kudu/util/logging.h"
@@ -883,44 +884,46 @@ bool PartitionSchema::Equals(const PartitionSchema& other) const {
 }
 
 // Encodes the specified primary key columns of the supplied row into the buffer.
+template<typename Buffer>
 Status PartitionSchema::EncodeColumns(const ConstContiguousRow& row,
                                       const vector<ColumnId>& column_ids,
-                                      string* buf) {
+                                      Buffer* buf) {
   for (int i = 0; i < column_ids.size(); i++) {
     ColumnId column_id = column_ids[i];
     int32_t column_idx = row.schema()->find_column_by_id(column_id);
     const TypeInfo* type = row.schema()->column(column_idx).type_info();
-    GetKeyEncoder<string>(type).Encode(row.cell_ptr(column_idx), i + 1 == column_ids.size(), buf);
+    GetKeyEncoder<Buffer>(type).Encode(row.cell_ptr(column_idx), i + 1 == column_ids.size(), buf);
   }
   return Status::OK();
 }
 
 // Encodes the specified primary key columns of the supplied row into the buffer.
+template<typename Buffer>
 Status PartitionSchema::EncodeColumns(const KuduPartialRow& row,
                                       const vector<ColumnId>& column_ids,
-                                      string* buf) {
+                                      Buffer* buf) {
+  ContiguousRow cont_row(row.schema(), row.row_data_);
   for (int i = 0; i < column_ids.size(); i++) {
     int32_t column_idx = row.schema()->find_column_by_id(column_ids[i]);
     CHECK(column_idx != Schema::kColumnNotFound);
     const TypeInfo* type_info = row.schema()->column(column_idx).type_info();
-    const KeyEncoder<string>& encoder = GetKeyEncoder<string>(type_info);
+    const KeyEncoder<Buffer>& encoder = GetKeyEncoder<Buffer>(type_info);
 
     if (PREDICT_FALSE(!row.IsColumnSet(column_idx))) {
       uint8_t min_value[kLargestTypeSize];
       type_info->CopyMinValue(min_value);
       encoder.Encode(min_value, i + 1 == column_ids.size(), buf);
     } else {
-      ContiguousRow cont_row(row.schema(), row.row_data_);
       encoder.Encode(cont_row.cell_ptr(column_idx), i + 1 == column_ids.size(), buf);
     }
   }
   return Status::OK();
 }
 
-int32_t PartitionSchema::BucketForEncodedColumns(const string& encoded_key,
+int32_t PartitionSchema::BucketForEncodedColumns(const Slice& encoded_key,
                                                  const HashBucketSchema& hash_bucket_schema) {
   uint64_t hash = HashUtil::MurmurHash2_64(encoded_key.data(),
-                                           encoded_key.length(),
+                                           encoded_key.size(),
                                            hash_bucket_schema.seed);
   return hash % static_cast<uint64_t>(hash_bucket_schema.num_buckets);
 }
@@ -929,10 +932,12 @@ template<typename Row>
 Status PartitionSchema::BucketForRow(const Row& row,
                                      const HashBucketSchema& hash_bucket_schema,
                                      int32_t* bucket) {
-  string buf;
+  // This is on the path of every write, on the client and on the server, so
+  // the hash columns are encoded into a faststring, whose inline buffer holds
+  // most keys without a heap allocation.
+  faststring buf;
   RETURN_NOT_OK(EncodeColumns(row, hash_bucket_schema.column_ids, &buf));
-  uint64_t hash = HashUtil::MurmurHash2_64(buf.data(), buf.length(), hash_bucket_schema.seed);
-  *bucket = hash % static_cast<uint64_t>(hash_bucket_schema.num_buckets);
+  *bucket = BucketForEncodedColumns(buf, hash_bucket_schema);
   return Status::OK();
 }
 
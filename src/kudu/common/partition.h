@@ -255,20 +255,23 @@ class PartitionSchema {
   std::string RangeKeyDebugString(const ConstContiguousRow& key) const;
 
   // Encodes the specified columns of a row into lexicographic sort-order
-  // preserving format.
+  // preserving format. 'Buffer' is either std::string or faststring; the
+  // latter avoids a heap allocation for the short keys hashed into buckets.
+  template<typename Buffer>
   static Status EncodeColumns(const KuduPartialRow& row,
                               const std::vector<ColumnId>& column_ids,
-                              std::string* buf);
+                              Buffer* buf);
 
   // Encodes the specified columns of a row into lexicographic sort-order
   // preserving format.
+  template<typename Buffer>
   static Status EncodeColumns(const ConstContiguousRow& row,
                               const std::vector<ColumnId>& column_ids,
-                              std::string* buf);
+                              Buffer* buf);
 
   // Returns the hash bucket of the encoded hash column. The encoded columns must match the
   // columns of the hash bucket schema.
-  static int32_t BucketForEncodedColumns(const std::string& encoded_hash_columns,
+  static int32_t BucketForEncodedColumns(const Slice& encoded_hash_columns,
                                          const HashBucketSchema& hash_bucket_schema);
 
   // Assigns the row to a hash bucket according to the hash schema.
@@ -21,6 +21,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <numeric>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -51,6 +53,7 @@ using std::count_if;
 using std::get;
 using std::make_tuple;
 using std::move;
+using std::set;
 using std::string;
 using std::tuple;
 using std::unique_ptr;
@@ -870,6 +873,79 @@ TEST_F(PartitionPrunerTest, TestMultiColumnInListHashPruning) {
         6, 2);
 }
 
+// Test hash pruning with in-lists on a multi-column hash component whose
+// product of values is much larger than the number of buckets.
+TEST_F(PartitionPrunerTest, TestLargeInListHashPruning) {
+  // CREATE TABLE t
+  // (a INT32, b INT32)
+  // PRIMARY KEY (a, b)
+  // DISTRIBUTE BY HASH(a, b) INTO 16 BUCKETS;
+  Schema schema({ ColumnSchema("a", INT32),
+                  ColumnSchema("b", INT32) },
+                { ColumnId(0), ColumnId(1) },
+                2);
+
+  PartitionSchema partition_schema;
+  auto pb = PartitionSchemaPB();
+  auto hash_component = pb.add_hash_bucket_schemas();
+  hash_component->add_columns()->set_name("a");
+  hash_component->add_columns()->set_name("b");
+  hash_component->set_num_buckets(16);
+  hash_component->set_seed(0);
+  pb.mutable_range_schema()->clear_columns();
+
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+
+  vector<Partition> partitions;
+  ASSERT_OK(partition_schema.CreatePartitions(vector<KuduPartialRow>(), {}, schema, &partitions));
+
+  // Returns the number of buckets of the rows matching the in-lists, counting
+  // the distinct bucket prefixes of their partition keys.
+  auto CountBuckets = [&] (const vector<int32_t>& a, const vector<int32_t>& b) {
+    set<string> buckets;
+    for (int32_t a_val : a) {
+      for (int32_t b_val : b) {
+        KuduPartialRow row(&schema);
+        CHECK_OK(row.SetInt32("a", a_val));
+        CHECK_OK(row.SetInt32("b", b_val));
+        string key;
+        CHECK_OK(partition_schema.EncodeKey(row, &key));
+        buckets.insert(key.substr(0, sizeof(int32_t)));
+      }
+    }
+    return buckets.size();
+  };
+
+  auto Check = [&] (const vector<int32_t>& a, const vector<int32_t>& b, size_t num_buckets) {
+    vector<const void*> a_values;
+    for (const auto& v : a) {
+      a_values.push_back(&v);
+    }
+    vector<const void*> b_values;
+    for (const auto& v : b) {
+      b_values.push_back(&v);
+    }
+    ScanSpec spec;
+    spec.AddPredicate(ColumnPredicate::InList(schema.column(0), &a_values));
+    spec.AddPredicate(ColumnPredicate::InList(schema.column(1), &b_values));
+    CheckPrunedPartitions(schema, partition_schema, partitions, spec, num_buckets, num_buckets);
+  };
+
+  // A few combinations, which don't hit every bucket.
+  vector<int32_t> a = { 1, 2 };
+  vector<int32_t> b = { 3, 4 };
+  NO_FATALS(Check(a, b, CountBuckets(a, b)));
+  a = { 1, 2, 3 };
+  b = { 10, 20, 30 };
+  NO_FATALS(Check(a, b, CountBuckets(a, b)));
+
+  // A million combinations, which hit every bucket long before they're all
+  // hashed.
+  vector<int32_t> values(1000);
+  std::iota(values.begin(), values.end(), 0);
+  NO_FATALS(Check(values, values, 16));
+}
+
 TEST_F(PartitionPrunerTest, TestPruning) {
   // CREATE TABLE timeseries
   // (host STRING, metric STRING, time UNIXTIME_MICROS, value DOUBLE)
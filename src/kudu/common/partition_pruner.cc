@@ -43,6 +43,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/slice.h"
 
@@ -189,38 +190,62 @@ vector<bool> PartitionPruner::PruneHashComponent(
     const Schema& schema,
     const ScanSpec& scan_spec) {
   vector<bool> hash_bucket_bitset(hash_bucket_schema.num_buckets, false);
-  vector<string> encoded_strings(1, "");
-  for (size_t col_offset = 0; col_offset < hash_bucket_schema.column_ids.size(); ++col_offset) {
-    vector<string> new_encoded_strings;
+  const size_t num_columns = hash_bucket_schema.column_ids.size();
+
+  // The values of the equality or in-list predicate on each hash column.
+  vector<vector<const void*>> column_values(num_columns);
+  vector<const KeyEncoder<faststring>*> encoders(num_columns);
+  for (size_t col_offset = 0; col_offset < num_columns; ++col_offset) {
     const ColumnSchema& column = schema.column_by_id(hash_bucket_schema.column_ids[col_offset]);
     const ColumnPredicate& predicate = FindOrDie(scan_spec.predicates(), column.name());
-    const KeyEncoder<string>& encoder = GetKeyEncoder<string>(column.type_info());
+    encoders[col_offset] = &GetKeyEncoder<faststring>(column.type_info());
 
-    vector<const void*> predicate_values;
+    vector<const void*>* values = &column_values[col_offset];
     if (predicate.predicate_type() == PredicateType::Equality) {
-      predicate_values.push_back(predicate.raw_lower());
+      values->push_back(predicate.raw_lower());
     } else {
       CHECK(predicate.predicate_type() == PredicateType::InList);
-      predicate_values.insert(predicate_values.end(),
-                              predicate.raw_values().begin(),
-                              predicate.raw_values().end());
+      values->assign(predicate.raw_values().begin(), predicate.raw_values().end());
     }
-    // For each of the encoded string, replicate it by the number of values in
-    // equality and in-list predicate.
-    for (const string& encoded_string : encoded_strings) {
-      for (const void* predicate_value : predicate_values) {
-        string new_encoded_string = encoded_string;
-        encoder.Encode(predicate_value,
-                       col_offset + 1 == hash_bucket_schema.column_ids.size(),
-                       &new_encoded_string);
-        new_encoded_strings.emplace_back(new_encoded_string);
-      }
+    if (values->empty()) {
+      return hash_bucket_bitset;
     }
-    encoded_strings.swap(new_encoded_strings);
   }
-  for (const string& encoded_string : encoded_strings) {
-    uint32_t hash = partition_schema.BucketForEncodedColumns(encoded_string, hash_bucket_schema);
-    hash_bucket_bitset[hash] = true;
+
+  // Hash every combination of the values, enumerating them like an odometer
+  // so that only the columns following the one which advanced are re-encoded
+  // into the single key buffer. The number of combinations is the product of
+  // the in-list sizes, so stop as soon as every bucket is known to be hit.
+  faststring encoded;
+  vector<size_t> value_idxs(num_columns, 0);
+  vector<size_t> prefix_sizes(num_columns, 0);
+  int32_t num_unset_buckets = hash_bucket_schema.num_buckets;
+  size_t col_offset = 0;
+  while (true) {
+    for (; col_offset < num_columns; ++col_offset) {
+      prefix_sizes[col_offset] = encoded.size();
+      encoders[col_offset]->Encode(column_values[col_offset][value_idxs[col_offset]],
+                                   col_offset + 1 == num_columns,
+                                   &encoded);
+    }
+    int32_t bucket = partition_schema.BucketForEncodedColumns(encoded, hash_bucket_schema);
+    if (!hash_bucket_bitset[bucket]) {
+      hash_bucket_bitset[bucket] = true;
+      if (--num_unset_buckets == 0) {
+        break;
+      }
+    }
+
+    // Advance to the next combination, carrying into the preceding columns.
+    while (col_offset > 0 &&
+           ++value_idxs[col_offset - 1] == column_values[col_offset - 1].size()) {
+      value_idxs[--col_offset] = 0;
+    }
+    if (col_offset == 0) {
+      break;
+    }
+    --col_offset;
+    encoded.resize(prefix_sizes[col_offset]);
   }
   return hash_bucket_bitset;
 }
@@ -35,6 +35,7 @@
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
@@ -643,6 +644,44 @@ TEST_F(RowOperationsTest, TestProjectDeletes) {
             TestProjection(RowOperationsPB::DELETE, client_row, server_schema));
 }
 
+// Test decoding a batch which mixes rows with all their columns set, which
+// are copied whole, with rows which have to be projected column by column.
+TEST_F(RowOperationsTest, TestDecodeMixedBatch) {
+  RowOperationsPB pb;
+  RowOperationsPBEncoder enc(&pb);
+  for (int i = 0; i < 4; i++) {
+    KuduPartialRow row(&schema_without_ids_);
+    ASSERT_OK(row.SetInt32("key", i));
+    ASSERT_OK(row.SetInt32("int_val", i * 10));
+    if (i % 2 == 0) {
+      ASSERT_OK(row.SetStringCopy("string_val", Substitute("hello $0", i)));
+    } else if (i == 3) {
+      ASSERT_OK(row.SetNull("string_val"));
+    }
+    enc.Add(i < 2 ? RowOperationsPB::INSERT : RowOperationsPB::UPSERT, row);
+  }
+
+  vector<DecodedRowOperation> ops;
+  RowOperationsPBDecoder dec(&pb, &schema_without_ids_, &schema_, &arena_);
+  ASSERT_OK(dec.DecodeOperations(&ops));
+  ASSERT_EQ(4, ops.size());
+  EXPECT_EQ(R"(INSERT (int32 key=0, int32 int_val=0, string string_val="hello 0"))",
+            ops[0].ToString(schema_));
+  EXPECT_EQ("INSERT (int32 key=1, int32 int_val=10, string string_val=NULL)",
+            ops[1].ToString(schema_));
+  EXPECT_EQ(R"(UPSERT (int32 key=2, int32 int_val=20, string string_val="hello 2"))",
+            ops[2].ToString(schema_));
+  EXPECT_EQ("UPSERT (int32 key=3, int32 int_val=30, string string_val=NULL)",
+            ops[3].ToString(schema_));
+  for (const auto& op : ops) {
+    EXPECT_TRUE(BitmapTest(op.isset_bitmap, 0));
+    EXPECT_TRUE(BitmapTest(op.isset_bitmap, 1));
+  }
+  EXPECT_TRUE(BitmapTest(ops[0].isset_bitmap, 2));
+  EXPECT_FALSE(BitmapTest(ops[1].isset_bitmap, 2));
+  EXPECT_TRUE(BitmapTest(ops[3].isset_bitmap, 2));
+}
+
 TEST_F(RowOperationsTest, SplitKeyRoundTrip) {
   Schema client_schema = Schema({ ColumnSchema("int8", INT8),
                                   ColumnSchema("int16", INT16),
@@ -153,7 +153,8 @@ RowOperationsPBDecoder::RowOperationsPBDecoder(const RowOperationsPB* pb,
     dst_arena_(dst_arena),
     bm_size_(BitmapSize(client_schema_->num_columns())),
     tablet_row_size_(ContiguousRowHelper::row_size(*tablet_schema_)),
-    src_(pb->rows().data(), pb->rows().size()) {
+    src_(pb->rows().data(), pb->rows().size()),
+    same_columns_(false) {
 }
 
 RowOperationsPBDecoder::~RowOperationsPBDecoder() {
@@ -227,6 +228,33 @@ Status RowOperationsPBDecoder::ReadColumn(const ColumnSchema& col, uint8_t* dst)
   return Status::OK();
 }
 
+Status RowOperationsPBDecoder::ReadAllColumns(uint8_t* tablet_row_storage) {
+  DCHECK(same_columns_);
+  size_t data_size = tablet_schema_->byte_size();
+  if (PREDICT_FALSE(src_.size() < data_size)) {
+    return Status::Corruption("Not enough data for row");
+  }
+  memcpy(tablet_row_storage, src_.data(), data_size);
+
+  // As in GetColumnSlice(), the Slices point relative to the indirect data.
+  const string& indirect_data = pb_->indirect_data();
+  for (int col_idx : binary_col_idxs_) {
+    uint8_t* cell = tablet_row_storage + tablet_schema_->column_offset(col_idx);
+    Slice ptr_slice;
+    memcpy(&ptr_slice, cell, sizeof(ptr_slice));
+    size_t offset_in_indirect = reinterpret_cast<uintptr_t>(ptr_slice.data());
+    bool overflowed = false;
+    size_t max_offset = AddWithOverflowCheck(offset_in_indirect, ptr_slice.size(), &overflowed);
+    if (PREDICT_FALSE(overflowed || max_offset > indirect_data.size())) {
+      return Status::Corruption("Bad indirect slice");
+    }
+    ptr_slice = Slice(&indirect_data[offset_in_indirect], ptr_slice.size());
+    memcpy(cell, &ptr_slice, sizeof(ptr_slice));
+  }
+  src_.remove_prefix(data_size);
+  return Status::OK();
+}
+
 bool RowOperationsPBDecoder::HasNext() const {
   return !src_.empty();
 }
@@ -347,6 +375,24 @@ Status RowOperationsPBDecoder::DecodeInsertOrUpsert(const uint8_t* prototype_row
     return Status::RuntimeError("Out of memory");
   }
 
+  // In the common case of a row with all the tablet's columns set and none
+  // of them null, the values are copied in one go rather than projected
+  // column by column.
+  int num_cols = client_schema_->num_columns();
+  if (same_columns_ &&
+      BitMapIsAllSet(client_isset_map, 0, num_cols) &&
+      (!client_schema_->has_nullables() || BitmapIsAllZero(client_null_map, 0, num_cols))) {
+    RETURN_NOT_OK(ReadAllColumns(tablet_row_storage));
+    if (tablet_schema_->has_nullables()) {
+      memset(ContiguousRowHelper::null_bitmap_ptr(*tablet_schema_, tablet_row_storage), 0,
+             ContiguousRowHelper::null_bitmap_size(*tablet_schema_));
+    }
+    memcpy(tablet_isset_bitmap, client_isset_map, bm_size_);
+    op->row_data = tablet_row_storage;
+    op->isset_bitmap = tablet_isset_bitmap;
+    return Status::OK();
+  }
+
   // Initialize the new row from the 'prototype' row which has been set
   // with all of the server-side default values. This copy may be entirely
   // overwritten in the case that all columns are specified, but this is
@@ -573,6 +619,17 @@ Status RowOperationsPBDecoder::DecodeOperations(vector<DecodedRowOperation>* ops
   DCHECK_EQ(mapping.num_mapped(), client_schema_->num_columns());
   RETURN_NOT_OK(mapping.CheckAllRequiredColumnsPresent());
 
+  same_columns_ = client_schema_->num_columns() == tablet_schema_->num_columns();
+  binary_col_idxs_.clear();
+  for (int i = 0; same_columns_ && i < client_schema_->num_columns(); i++) {
+    const ColumnSchema& col = tablet_schema_->column(i);
+    same_columns_ = mapping.client_to_tablet_idx(i) == i &&
+                    client_schema_->column(i).type_info() == col.type_info();
+    if (col.type_info()->physical_type() == BINARY) {
+      binary_col_idxs_.push_back(i);
+    }
+  }
+
   // Make a "prototype row" which has all the defaults filled in. We can copy
   // this to create a starting point for each row as we decode it, with
   // all the defaults in place without having to loop.
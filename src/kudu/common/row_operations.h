@@ -89,6 +89,13 @@ class RowOperationsPBDecoder {
   Status ReadNullBitmap(const uint8_t** null_bm);
   Status GetColumnSlice(const ColumnSchema& col, Slice* slice);
   Status ReadColumn(const ColumnSchema& col, uint8_t* dst);
+
+  // Reads the values of all the columns into 'tablet_row_storage' at once.
+  // Only valid if the client and tablet schemas have the same columns, and
+  // the row has all its columns set and none of them null, in which case the
+  // encoded values are laid out like the cells of the tablet row.
+  Status ReadAllColumns(uint8_t* tablet_row_storage);
+
   bool HasNext() const;
 
   Status DecodeInsertOrUpsert(const uint8_t* prototype_row_storage,
@@ -115,6 +122,15 @@ class RowOperationsPBDecoder {
   const int tablet_row_size_;
   Slice src_;
 
+  // Whether the client and tablet schemas have the same columns, of the same
+  // types and in the same order, so that rows with all their columns set may
+  // be decoded with ReadAllColumns(). Set by DecodeOperations().
+  bool same_columns_;
+
+  // The indexes of the BINARY columns, whose cells ReadAllColumns() has to
+  // point at the indirect data.
+  std::vector<int> binary_col_idxs_;
+
 
   DISALLOW_COPY_AND_ASSIGN(RowOperationsPBDecoder);
 };
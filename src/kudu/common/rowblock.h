@@ -163,6 +163,46 @@ class SelectionVectorView {
     DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
     BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_, nrows, false);
   }
+  void ClearBits(size_t row_idx, size_t nrows) {
+    DCHECK_LE(row_idx + nrows, sel_vec_->nrows() - row_offset_);
+    BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_ + row_idx, nrows, false);
+  }
+  // Clear the bits of the rows in [0, nrows) for which 'matches(row_idx)'
+  // returns false, leaving the other bits unchanged.
+  //
+  // 'matches' is called for every row, including rows which are already
+  // cleared, so that the results for each whole byte of the bitmap are
+  // combined without branches. It should be cheap and side-effect free.
+  template<class Matcher>
+  void AndWith(size_t nrows, const Matcher& matches) {
+    DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
+    uint8_t* bitmap = sel_vec_->mutable_bitmap();
+    size_t i = 0;
+    for (; i < nrows && (row_offset_ + i) % 8 != 0; i++) {
+      if (!matches(i)) BitmapClear(bitmap, row_offset_ + i);
+    }
+    for (; i + 8 <= nrows; i += 8) {
+      uint8_t byte = 0;
+      for (int b = 0; b < 8; b++) {
+        byte |= static_cast<uint8_t>(matches(i + b)) << b;
+      }
+      bitmap[(row_offset_ + i) / 8] &= byte;
+    }
+    for (; i < nrows; i++) {
+      if (!matches(i)) BitmapClear(bitmap, row_offset_ + i);
+    }
+  }
+  // Return the number of consecutive rows starting at 'row_idx', up to
+  // 'max_rows', whose selection bits are equal to 'selected'.
+  size_t CountRun(size_t row_idx, size_t max_rows, bool selected) const {
+    DCHECK_LE(row_idx + max_rows, sel_vec_->nrows() - row_offset_);
+    const size_t start = row_offset_ + row_idx;
+    size_t found;
+    if (!BitmapFindFirst(sel_vec_->bitmap(), start, start + max_rows, !selected, &found)) {
+      return max_rows;
+    }
+    return found - start;
+  }
  private:
   SelectionVector* sel_vec_;
   size_t row_offset_;
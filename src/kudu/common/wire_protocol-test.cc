@@ -357,6 +357,74 @@ TEST_F(WireProtocolTest, TestColumnarRowBlockToPBBenchmark) {
 }
 #endif
 
+// Serialize row blocks with unselected rows and NULLs in the columnar layout,
+// and check each column's buffers.
+TEST_F(WireProtocolTest, TestRowBlockToColumnar) {
+  const int kNumRows = 10;
+  Arena arena(1024);
+  RowBlock block(schema_, kNumRows, &arena);
+  FillRowBlockWithTestRows(&block);
+  for (int i = 0; i < kNumRows; i++) {
+    if (i % 3 == 0) {
+      block.selection_vector()->SetRowUnselected(i);
+    }
+    if (i % 2 == 0) {
+      block.row(i).cell(2).set_null(true);
+    }
+  }
+  const int kNumSelected = block.selection_vector()->CountSelected();
+
+  // Append the block twice, to check that the second one is appended at
+  // the right offsets and bits.
+  ColumnarSerializedBatch batch;
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  ASSERT_EQ(2 * kNumSelected, batch.num_rows);
+  ASSERT_EQ(schema_.num_columns(), batch.columns.size());
+
+  // The string columns.
+  const string kExpected[] = { "hello world col1", "hello world col2" };
+  for (int col = 0; col < 2; col++) {
+    SCOPED_TRACE(col);
+    const auto& c = batch.columns[col];
+    ASSERT_TRUE(c.varlen_data);
+    ASSERT_FALSE(c.non_null_bitmap);
+    ASSERT_EQ((batch.num_rows + 1) * sizeof(uint32_t), c.data->size());
+    const uint8_t* offsets = c.data->data();
+    for (int i = 0; i < batch.num_rows; i++) {
+      uint32_t start = UnalignedLoad<uint32_t>(offsets + i * sizeof(uint32_t));
+      uint32_t end = UnalignedLoad<uint32_t>(offsets + (i + 1) * sizeof(uint32_t));
+      ASSERT_LE(start, end);
+      ASSERT_LE(end, c.varlen_data->size());
+      EXPECT_EQ(kExpected[col], Slice(c.varlen_data->data() + start, end - start).ToString());
+    }
+  }
+
+  // The nullable integer column.
+  const auto& c = batch.columns[2];
+  ASSERT_FALSE(c.varlen_data);
+  ASSERT_TRUE(c.non_null_bitmap);
+  ASSERT_EQ(batch.num_rows * sizeof(uint32_t), c.data->size());
+  ASSERT_EQ(BitmapSize(batch.num_rows), c.non_null_bitmap->size());
+  int dst_row = 0;
+  for (int copy = 0; copy < 2; copy++) {
+    for (int i = 0; i < kNumRows; i++) {
+      if (i % 3 == 0) continue;
+      SCOPED_TRACE(dst_row);
+      uint32_t val = UnalignedLoad<uint32_t>(c.data->data() + dst_row * sizeof(uint32_t));
+      if (i % 2 == 0) {
+        EXPECT_FALSE(BitmapTest(c.non_null_bitmap->data(), dst_row));
+        EXPECT_EQ(0, val);
+      } else {
+        EXPECT_TRUE(BitmapTest(c.non_null_bitmap->data(), dst_row));
+        EXPECT_EQ(i, val);
+      }
+      dst_row++;
+    }
+  }
+  EXPECT_EQ(batch.num_rows, dst_row);
+}
+
 // Test that trying to extract rows from an invalid block correctly returns
 // Corruption statuses.
 TEST_F(WireProtocolTest, TestInvalidRowBlock) {
@@ -948,4 +948,138 @@ void SerializeRowBlock(const RowBlock& block,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+size_t ColumnarSerializedBatch::size() const {
+  size_t total = 0;
+  for (const auto& col : columns) {
+    total += col.data->size();
+    if (col.varlen_data) {
+      total += col.varlen_data->size();
+    }
+    if (col.non_null_bitmap) {
+      total += col.non_null_bitmap->size();
+    }
+  }
+  return total;
+}
+
+// Append a column's worth of data from the given RowBlock to 'dst'.
+//
+// As for CopyColumn(), nullability and variable length are template
+// parameters to keep the per-cell loop free of branches on them.
+template<bool IS_NULLABLE, bool IS_VARLEN>
+static void CopyColumnColumnar(const RowBlock& block, int col_idx, int64_t first_row,
+                               size_t num_rows, ColumnarSerializedBatch::Column* dst) {
+  ColumnBlock column_block = block.column_block(col_idx);
+  const size_t cell_size = column_block.stride();
+  const size_t dst_cell_size = IS_VARLEN ? sizeof(uint32_t) : cell_size;
+
+  faststring* data = dst->data.get();
+  const size_t old_size = data->size();
+  data->resize(old_size + num_rows * dst_cell_size);
+  uint8_t* dst_cell = data->data() + old_size;
+  if (IS_NULLABLE && !IS_VARLEN) {
+    // Zero the NULL cells so that we don't leak unrelated data to the client.
+    memset(dst_cell, 0, num_rows * dst_cell_size);
+  }
+  uint8_t* non_null_bitmap = nullptr;
+  if (IS_NULLABLE) {
+    faststring* bitmap = dst->non_null_bitmap.get();
+    const size_t old_bitmap_size = bitmap->size();
+    bitmap->resize(BitmapSize(first_row + num_rows));
+    memset(bitmap->data() + old_bitmap_size, 0, bitmap->size() - old_bitmap_size);
+    non_null_bitmap = bitmap->data();
+  }
+
+  // The offset at which the next variable-length cell starts. The offsets
+  // of each cell's end follow the offset of the first cell's start.
+  uint32_t varlen_offset = 0;
+  if (IS_VARLEN) {
+    varlen_offset = UnalignedLoad<uint32_t>(dst_cell - sizeof(uint32_t));
+  }
+
+  const uint8_t* src = column_block.cell_ptr(0);
+  int64_t dst_row = first_row;
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(), block.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      src += run_size * cell_size;
+      row_idx += run_size;
+      continue;
+    }
+    for (int i = 0; i < run_size; i++) {
+      const bool is_null = IS_NULLABLE && column_block.is_null(row_idx);
+      if (IS_NULLABLE) {
+        BitmapChange(non_null_bitmap, dst_row, !is_null);
+      }
+      if (IS_VARLEN) {
+        if (!is_null) {
+          const Slice* slice = reinterpret_cast<const Slice*>(src);
+          dst->varlen_data->append(slice->data(), slice->size());
+          varlen_offset += slice->size();
+        }
+        UnalignedStore(dst_cell, varlen_offset);
+      } else if (!is_null) {
+        strings::memcpy_inlined(dst_cell, src, cell_size);
+      }
+      dst_cell += dst_cell_size;
+      src += cell_size;
+      row_idx++;
+      dst_row++;
+    }
+  }
+}
+
+// Because we use a faststring here, ASAN tests become unbearably slow
+// with the extra verifications.
+ATTRIBUTE_NO_ADDRESS_SAFETY_ANALYSIS
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* projection_schema,
+                               ColumnarSerializedBatch* batch) {
+  const Schema& tablet_schema = block.schema();
+  if (projection_schema == nullptr) {
+    projection_schema = &tablet_schema;
+  }
+
+  if (batch->columns.empty() && projection_schema->num_columns() > 0) {
+    batch->columns.resize(projection_schema->num_columns());
+    for (int i = 0; i < projection_schema->num_columns(); i++) {
+      const ColumnSchema& col = projection_schema->column(i);
+      ColumnarSerializedBatch::Column* dst = &batch->columns[i];
+      dst->data.reset(new faststring());
+      if (col.type_info()->physical_type() == BINARY) {
+        dst->varlen_data.reset(new faststring());
+        // The offset of the first cell's start.
+        uint32_t zero = 0;
+        dst->data->append(&zero, sizeof(zero));
+      }
+      if (col.is_nullable()) {
+        dst->non_null_bitmap.reset(new faststring());
+      }
+    }
+  }
+  DCHECK_EQ(batch->columns.size(), projection_schema->num_columns());
+
+  const size_t num_rows = block.selection_vector()->CountSelected();
+  for (int p_schema_idx = 0; p_schema_idx < projection_schema->num_columns(); p_schema_idx++) {
+    const ColumnSchema& col = projection_schema->column(p_schema_idx);
+    int t_schema_idx = tablet_schema.find_column(col.name());
+    DCHECK_NE(t_schema_idx, -1);
+    ColumnarSerializedBatch::Column* dst = &batch->columns[p_schema_idx];
+    const bool is_varlen = col.type_info()->physical_type() == BINARY;
+    if (col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<true, true>(block, t_schema_idx, batch->num_rows, num_rows, dst);
+    } else if (col.is_nullable() && !is_varlen) {
+      CopyColumnColumnar<true, false>(block, t_schema_idx, batch->num_rows, num_rows, dst);
+    } else if (!col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<false, true>(block, t_schema_idx, batch->num_rows, num_rows, dst);
+    } else {
+      CopyColumnColumnar<false, false>(block, t_schema_idx, batch->num_rows, num_rows, dst);
+    }
+  }
+  batch->num_rows += num_rows;
+}
+
 } // namespace kudu
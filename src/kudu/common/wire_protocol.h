@@ -19,9 +19,12 @@
 #ifndef KUDU_COMMON_WIRE_PROTOCOL_H
 #define KUDU_COMMON_WIRE_PROTOCOL_H
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
+#include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
 namespace boost {
@@ -40,7 +43,6 @@ namespace kudu {
 class Arena;
 class ColumnPredicate;
 class ColumnSchema;
-class faststring;
 class HostPort;
 class RowBlock;
 class Schema;
@@ -154,6 +156,39 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        faststring* data_buf, faststring* indirect_data,
                        bool pad_unixtime_micros_to_16_bytes = false);
 
+// The columns of a scan result in the columnar layout, before they're attached
+// to the response as the sidecars of a ColumnarRowBlockPB. See that message for
+// the format of each buffer.
+struct ColumnarSerializedBatch {
+  struct Column {
+    // The cells, or for variable-length columns, the offsets of the cells.
+    std::unique_ptr<faststring> data;
+
+    // The bytes of the cells of a variable-length column, NULL otherwise.
+    std::unique_ptr<faststring> varlen_data;
+
+    // The non-null bitmap of a nullable column, NULL otherwise.
+    std::unique_ptr<faststring> non_null_bitmap;
+  };
+
+  // The total size of all of the buffers.
+  size_t size() const;
+
+  std::vector<Column> columns;
+  int64_t num_rows = 0;
+};
+
+// Append the selected rows of the given row block to 'batch', column by
+// column.
+//
+// As in SerializeRowBlock(), if 'projection_schema' is not NULL, then only
+// the columns it specifies are appended, in its order. The columns of 'batch'
+// are initialized upon the first call, and every subsequent call must use the
+// same projection.
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* projection_schema,
+                               ColumnarSerializedBatch* batch);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
@@ -0,0 +1,135 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/apply_scheduler.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/raft_consensus.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace consensus {
+
+class ApplySchedulerTest : public KuduTest {
+ public:
+  void SetUp() override {
+    KuduTest::SetUp();
+    ASSERT_OK(ThreadPoolBuilder("apply").set_max_threads(4).Build(&pool_));
+    token_ = pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+    scheduler_.reset(new ApplyScheduler("", token_.get(),
+        [this](ConsensusRound* round, vector<uint64_t>* keys) {
+          const vector<uint64_t>* round_keys = FindOrNull(keys_, round->id().index());
+          if (round_keys == nullptr) {
+            return false;
+          }
+          *keys = *round_keys;
+          return true;
+        }));
+  }
+
+  void TearDown() override {
+    scheduler_.reset();
+    token_->Shutdown();
+    pool_->Shutdown();
+    KuduTest::TearDown();
+  }
+
+ protected:
+  // Schedules a round with index 'index' and conflict keys 'keys' (or no keys
+  // if empty). If 'latch' is set, the round's callback blocks until it counts
+  // down.
+  void ScheduleRound(int64_t index, vector<uint64_t> keys,
+                     CountDownLatch* latch = nullptr) {
+    if (!keys.empty()) {
+      keys_[index] = std::move(keys);
+    }
+    gscoped_ptr<ReplicateMsg> msg(new ReplicateMsg);
+    msg->set_op_type(WRITE_OP);
+    *msg->mutable_id() = MakeOpId(1, index);
+    scoped_refptr<ConsensusRound> round(new ConsensusRound(
+        nullptr, std::move(msg), [this, index, latch](const Status& s) {
+          CHECK_OK(s);
+          if (latch) {
+            latch->Wait();
+          }
+          std::lock_guard<simple_spinlock> l(lock_);
+          applied_.push_back(index);
+        }));
+    scheduler_->Schedule(round);
+  }
+
+  vector<int64_t> Applied() {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return applied_;
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+  unique_ptr<ThreadPoolToken> token_;
+  unique_ptr<ApplyScheduler> scheduler_;
+  std::map<int64_t, vector<uint64_t>> keys_;
+
+  simple_spinlock lock_;
+  vector<int64_t> applied_;
+};
+
+// Rounds which don't conflict overtake a blocked round, rounds which do
+// wait for it, and rounds without keys wait for everything.
+TEST_F(ApplySchedulerTest, TestOrderingBetweenConflictingRounds) {
+  CountDownLatch latch(1);
+  ScheduleRound(1, { 1, 2 }, &latch);
+  ScheduleRound(2, { 3 });
+  ScheduleRound(3, { 2, 4 });
+  ScheduleRound(4, { 4 });
+  ScheduleRound(5, { 5 });
+
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_EQ(vector<int64_t>({ 2, 5 }), Applied());
+  });
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  ASSERT_EQ(vector<int64_t>({ 2, 5 }), Applied());
+  ASSERT_EQ(3, scheduler_->QueueDepth());
+
+  latch.CountDown();
+  ScheduleRound(6, {});
+  ASSERT_EQ(vector<int64_t>({ 2, 5, 1, 3, 4, 6 }), Applied());
+  ASSERT_EQ(0, scheduler_->QueueDepth());
+}
+
+}  // namespace consensus
+}  // namespace kudu
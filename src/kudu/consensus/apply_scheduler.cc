@@ -0,0 +1,136 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/apply_scheduler.h"
+
+#include <algorithm>
+#include <ostream>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/raft_consensus.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/status.h"
+#include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadpool.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace consensus {
+
+ApplyScheduler::ApplyScheduler(string log_prefix,
+                               ThreadPoolToken* token,
+                               ConflictKeysFunction conflict_keys_fn)
+    : log_prefix_(std::move(log_prefix)),
+      token_(DCHECK_NOTNULL(token)),
+      conflict_keys_fn_(std::move(conflict_keys_fn)),
+      drained_cond_(&lock_),
+      num_outstanding_(0) {
+}
+
+ApplyScheduler::~ApplyScheduler() {
+  Drain();
+}
+
+void ApplyScheduler::Schedule(const scoped_refptr<ConsensusRound>& round) {
+  shared_ptr<Task> task = std::make_shared<Task>();
+  task->round = round;
+  if (!conflict_keys_fn_(round.get(), &task->keys) || task->keys.empty()) {
+    // The round may conflict with anything in flight.
+    Drain();
+    round->NotifyReplicationFinished(Status::OK());
+    return;
+  }
+  std::sort(task->keys.begin(), task->keys.end());
+  task->keys.erase(std::unique(task->keys.begin(), task->keys.end()), task->keys.end());
+
+  {
+    MutexLock l(lock_);
+    for (uint64_t key : task->keys) {
+      shared_ptr<Task>& tail = tails_[key];
+      // Several keys may share the same tail, which must only block us once.
+      if (tail && (tail->dependents.empty() || tail->dependents.back() != task)) {
+        tail->dependents.push_back(task);
+        task->num_blockers++;
+      }
+      tail = task;
+    }
+    num_outstanding_++;
+    if (task->num_blockers > 0) {
+      return;
+    }
+  }
+  Submit(task);
+}
+
+void ApplyScheduler::Submit(const shared_ptr<Task>& task) {
+  Status s = token_->SubmitFunc([this, task]() { this->Run(task); });
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX(WARNING) << "Unable to schedule the apply of round "
+                             << task->round->id() << ", running it inline: " << s.ToString();
+    Run(task);
+  }
+}
+
+void ApplyScheduler::Run(const shared_ptr<Task>& task) {
+  task->round->NotifyReplicationFinished(Status::OK());
+
+  vector<shared_ptr<Task>> ready;
+  {
+    MutexLock l(lock_);
+    for (uint64_t key : task->keys) {
+      auto iter = tails_.find(key);
+      if (iter != tails_.end() && iter->second == task) {
+        tails_.erase(iter);
+      }
+    }
+    for (const shared_ptr<Task>& dependent : task->dependents) {
+      if (--dependent->num_blockers == 0) {
+        ready.push_back(dependent);
+      }
+    }
+    task->dependents.clear();
+    if (--num_outstanding_ == 0) {
+      drained_cond_.Broadcast();
+    }
+  }
+  for (const shared_ptr<Task>& dependent : ready) {
+    Submit(dependent);
+  }
+}
+
+void ApplyScheduler::Drain() {
+  ThreadRestrictions::AssertWaitAllowed();
+  MutexLock l(lock_);
+  while (num_outstanding_ > 0) {
+    drained_cond_.Wait();
+  }
+}
+
+int64_t ApplyScheduler::QueueDepth() const {
+  MutexLock l(lock_);
+  return num_outstanding_;
+}
+
+}  // namespace consensus
+}  // namespace kudu
@@ -0,0 +1,113 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+
+namespace kudu {
+class ThreadPoolToken;
+
+namespace consensus {
+class ConsensusRound;
+
+// Hands committed rounds to a thread pool so that rounds which don't
+// conflict with each other are applied concurrently.
+//
+// Each round is described by a set of conflict keys, typically hashes of the
+// rows it touches. A round is only notified of its replication once every
+// earlier round sharing a key with it has been notified, so the order is
+// preserved between conflicting rounds only. A round without keys conflicts
+// with every other round: it waits for all earlier rounds and is notified
+// inline by Schedule().
+//
+// This class is thread-safe.
+class ApplyScheduler {
+ public:
+  // Fills 'keys' with the conflict keys of 'round'. Returns false if the round
+  // may conflict with any other round.
+  typedef std::function<bool(ConsensusRound* round, std::vector<uint64_t>* keys)>
+      ConflictKeysFunction;
+
+  // 'token' must outlive this object and must not be shut down until Drain()
+  // has returned.
+  ApplyScheduler(std::string log_prefix,
+                 ThreadPoolToken* token,
+                 ConflictKeysFunction conflict_keys_fn);
+  ~ApplyScheduler();
+
+  // Notifies 'round' that it was replicated once all conflicting rounds
+  // scheduled before it have been notified.
+  //
+  // Rounds must be scheduled in index order. Since a round without conflict
+  // keys waits for all rounds scheduled before it, callbacks of rounds with
+  // keys must not block on the thread calling Schedule().
+  void Schedule(const scoped_refptr<ConsensusRound>& round);
+
+  // Waits until all the rounds scheduled so far have been notified.
+  void Drain();
+
+  // Returns the number of scheduled rounds which have not been notified yet.
+  int64_t QueueDepth() const;
+
+ private:
+  struct Task {
+    scoped_refptr<ConsensusRound> round;
+    std::vector<uint64_t> keys;
+    // The number of earlier conflicting tasks which haven't finished yet.
+    int num_blockers = 0;
+    // Later tasks which conflict with this one.
+    std::vector<std::shared_ptr<Task>> dependents;
+  };
+
+  // Submits 'task' to the pool, or runs it inline if that fails.
+  void Submit(const std::shared_ptr<Task>& task);
+
+  // Notifies the task's round and releases its dependents.
+  void Run(const std::shared_ptr<Task>& task);
+
+  const std::string& LogPrefix() const { return log_prefix_; }
+
+  const std::string log_prefix_;
+  ThreadPoolToken* const token_;
+  const ConflictKeysFunction conflict_keys_fn_;
+
+  mutable Mutex lock_;
+  // Signaled when 'num_outstanding_' drops to 0.
+  ConditionVariable drained_cond_;
+
+  // The last scheduled, unfinished task for each conflict key.
+  std::unordered_map<uint64_t, std::shared_ptr<Task>> tails_;
+
+  // The number of scheduled tasks which haven't finished.
+  int64_t num_outstanding_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApplyScheduler);
+};
+
+}  // namespace consensus
+}  // namespace kudu
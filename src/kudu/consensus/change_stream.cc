@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/change_stream.h"
+
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/consensus/opid.pb.h"
+#include "kudu/consensus/raft_consensus.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::shared_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace consensus {
+
+ChangeStream::ChangeStream(shared_ptr<RaftConsensus> consensus,
+                           scoped_refptr<log::LogAnchorRegistry> log_anchor_registry,
+                           int64_t after_index)
+    : consensus_(std::move(consensus)),
+      log_anchor_registry_(std::move(log_anchor_registry)),
+      owner_(Substitute("ChangeStream-$0", consensus_->tablet_id())),
+      last_read_index_(after_index),
+      last_acked_index_(after_index) {
+  log_anchor_registry_->Register(after_index + 1, owner_, &anchor_);
+}
+
+ChangeStream::~ChangeStream() {
+  WARN_NOT_OK(log_anchor_registry_->Unregister(&anchor_),
+              Substitute("$0: could not release the log anchor", owner_));
+}
+
+Status ChangeStream::ReadNext(int max_bytes, vector<ReplicateRefPtr>* ops) {
+  ops->clear();
+  RETURN_NOT_OK(consensus_->ReadCommittedOps(last_read_index_, max_bytes, ops));
+  if (!ops->empty()) {
+    last_read_index_ = ops->back()->get()->id().index();
+  }
+  return Status::OK();
+}
+
+Status ChangeStream::Ack(int64_t index) {
+  if (PREDICT_FALSE(index > last_read_index_)) {
+    return Status::InvalidArgument(
+        Substitute("cannot acknowledge op $0 before it is read: the last op read is $1",
+                   index, last_read_index_));
+  }
+  if (index <= last_acked_index_) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(log_anchor_registry_->UpdateRegistration(index + 1, owner_, &anchor_));
+  last_acked_index_ = index;
+  return Status::OK();
+}
+
+} // namespace consensus
+} // namespace kudu
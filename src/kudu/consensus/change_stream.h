@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_CHANGE_STREAM_H
+#define KUDU_CONSENSUS_CHANGE_STREAM_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/consensus/log_anchor_registry.h"
+#include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace consensus {
+
+class RaftConsensus;
+
+// A subscription to the committed ops of a replica, for consumers outside
+// of Raft, e.g. to capture the changes made to a tablet without scanning it.
+// Created by RaftConsensus::NewChangeStream().
+//
+// The consumer pulls batches of ops at its own pace, on its own thread. The
+// ops are taken from the log cache if they're still cached, and read from
+// the WAL otherwise, so a slow consumer never holds up replication. In turn
+// the stream anchors the WAL from the first op which the consumer hasn't
+// acknowledged, so that the ops it has yet to consume aren't garbage
+// collected.
+//
+// This class is not thread-safe.
+class ChangeStream {
+ public:
+  ~ChangeStream();
+
+  // Reads the committed ops following the last op read, up to a total of
+  // 'max_bytes' but at least one op if there is any. '*ops' is left empty if
+  // the consumer has caught up with the committed ops.
+  //
+  // Returns NotFound if the ops were garbage collected before the stream
+  // was created.
+  Status ReadNext(int max_bytes, std::vector<ReplicateRefPtr>* ops);
+
+  // Acknowledges that the consumer is done with the ops through 'index',
+  // which must have been read, so that the WAL segments which hold them may
+  // be garbage collected.
+  Status Ack(int64_t index);
+
+  // The index of the last op read.
+  int64_t last_read_index() const { return last_read_index_; }
+
+  // The index of the last op acknowledged.
+  int64_t last_acked_index() const { return last_acked_index_; }
+
+ private:
+  friend class RaftConsensus;
+
+  // Starts a stream of the ops following 'after_index' on 'consensus'.
+  ChangeStream(std::shared_ptr<RaftConsensus> consensus,
+               scoped_refptr<log::LogAnchorRegistry> log_anchor_registry,
+               int64_t after_index);
+
+  const std::shared_ptr<RaftConsensus> consensus_;
+  const scoped_refptr<log::LogAnchorRegistry> log_anchor_registry_;
+  const std::string owner_;
+  log::LogAnchor anchor_;
+
+  int64_t last_read_index_;
+  int64_t last_acked_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChangeStream);
+};
+
+} // namespace consensus
+} // namespace kudu
+
+#endif
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
@@ -40,6 +41,7 @@
 #include "kudu/rpc/messenger.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/threadpool.h"
@@ -497,6 +499,26 @@ class LocalTestPeerProxy : public TestPeerProxy {
                                            this, request, response)));
   }
 
+  // Answered inline, since the leader may wait for heartbeats which are sent
+  // on 'pool_'.
+  void ReadIndexAsync(const ReadIndexRequestPB* /*request*/,
+                      ReadIndexResponsePB* response,
+                      rpc::RpcController* controller,
+                      const rpc::ResponseCallback& callback) override {
+    std::shared_ptr<RaftConsensus> peer;
+    Status s = peers_->GetPeerByUuid(peer_uuid_, &peer);
+    int64_t read_index;
+    if (s.ok()) {
+      s = peer->LeaderReadIndex(MonoTime::Now() + controller->timeout(), &read_index);
+    }
+    if (s.ok()) {
+      response->set_read_index(read_index);
+    } else {
+      SetResponseError(s, response);
+    }
+    callback();
+  }
+
   template<class Response>
   void SetResponseError(const Status& status, Response* response) {
     tserver::TabletServerErrorPB* error = response->mutable_error();
@@ -533,6 +555,10 @@ class LocalTestPeerProxy : public TestPeerProxy {
     ConsensusRequestPB other_peer_req;
     other_peer_req.CopyFrom(*request);
 
+    if (latency_.Initialized()) {
+      SleepFor(latency_);
+    }
+
     // Give the other peer a clean response object to write to.
     ConsensusResponsePB other_peer_resp;
     std::shared_ptr<RaftConsensus> peer;
@@ -597,10 +623,16 @@ class LocalTestPeerProxy : public TestPeerProxy {
     return peer_uuid_;
   }
 
+  // Delays each update sent to the remote peer by 'latency'.
+  void set_latency(const MonoDelta& latency) {
+    latency_ = latency;
+  }
+
  private:
   const std::string peer_uuid_;
   TestPeerMapManager* const peers_;
   bool miss_comm_;
+  MonoDelta latency_;
 };
 
 class LocalTestPeerProxyFactory : public PeerProxyFactory {
@@ -616,6 +648,7 @@ class LocalTestPeerProxyFactory : public PeerProxyFactory {
     LocalTestPeerProxy* new_proxy = new LocalTestPeerProxy(peer_pb.permanent_uuid(),
                                                            pool_.get(),
                                                            peers_);
+    new_proxy->set_latency(latency_);
     proxy->reset(new_proxy);
     proxies_.push_back(new_proxy);
     return Status::OK();
@@ -625,6 +658,12 @@ class LocalTestPeerProxyFactory : public PeerProxyFactory {
     return proxies_;
   }
 
+  // Injects 'latency' into the updates sent through the proxies created from
+  // now on.
+  void set_latency(const MonoDelta& latency) {
+    latency_ = latency;
+  }
+
   const std::shared_ptr<rpc::Messenger>& messenger() const override {
     return messenger_;
   }
@@ -635,6 +674,7 @@ class LocalTestPeerProxyFactory : public PeerProxyFactory {
   TestPeerMapManager* const peers_;
     // NOTE: There is no need to delete this on the dctor because proxies are externally managed
   std::vector<LocalTestPeerProxy*> proxies_;
+  MonoDelta latency_;
 };
 
 // A simple implementation of the transaction driver.
@@ -706,6 +746,7 @@ class TestTransactionFactory : public ConsensusRoundHandler {
   }
 
   Status StartFollowerTransaction(const scoped_refptr<ConsensusRound>& round) override {
+    num_follower_transactions_++;
     auto txn = new TestDriver(pool_.get(), log_, round);
     txn->round_->SetConsensusReplicatedCallback(std::bind(
         &TestDriver::ReplicationFinished,
@@ -724,6 +765,10 @@ class TestTransactionFactory : public ConsensusRoundHandler {
     pool_->Wait();
   }
 
+  int num_follower_transactions() const {
+    return num_follower_transactions_;
+  }
+
   void ShutDown() {
     WaitDone();
     pool_->Shutdown();
@@ -737,6 +782,7 @@ class TestTransactionFactory : public ConsensusRoundHandler {
   gscoped_ptr<ThreadPool> pool_;
   RaftConsensus* consensus_;
   log::Log* log_;
+  std::atomic<int> num_follower_transactions_{0};
 };
 
 }  // namespace consensus
@@ -45,6 +45,15 @@ DEFINE_double(fault_crash_before_cmeta_flush, 0.0,
               "consensus metadata. (For testing only!)");
 TAG_FLAG(fault_crash_before_cmeta_flush, unsafe);
 
+DEFINE_bool(cmeta_group_dir_sync, false,
+            "Whether the consensus metadata flushes of different tablets which "
+            "happen at the same time share their syncs of the consensus metadata "
+            "directory, instead of each syncing it on its own. Only relevant with "
+            "--log_force_fsync_all.");
+TAG_FLAG(cmeta_group_dir_sync, advanced);
+TAG_FLAG(cmeta_group_dir_sync, experimental);
+TAG_FLAG(cmeta_group_dir_sync, runtime);
+
 namespace kudu {
 namespace consensus {
 
@@ -52,6 +61,43 @@ using std::lock_guard;
 using std::string;
 using strings::Substitute;
 
+ConsensusMetadataDirSyncer::ConsensusMetadataDirSyncer(FsManager* fs_manager)
+    : fs_manager_(DCHECK_NOTNULL(fs_manager)),
+      cond_(&lock_),
+      syncs_started_(0),
+      syncs_finished_(0),
+      sync_running_(false) {
+}
+
+Status ConsensusMetadataDirSyncer::SyncDir() {
+  lock_guard<Mutex> l(lock_);
+  // A running sync may have started before the caller's rename, so only
+  // the next one covers it.
+  const int64_t needed = syncs_started_ + 1;
+  while (syncs_finished_ < needed) {
+    if (sync_running_) {
+      cond_.Wait();
+      continue;
+    }
+    sync_running_ = true;
+    const int64_t seqno = ++syncs_started_;
+    lock_.unlock();
+    Status s = fs_manager_->env()->SyncDir(fs_manager_->GetConsensusMetadataDir());
+    lock_.lock();
+    sync_running_ = false;
+    syncs_finished_ = seqno;
+    last_status_ = s;
+    cond_.Broadcast();
+  }
+  // Any sync finished since the one needed covers the caller's rename too.
+  return last_status_;
+}
+
+int64_t ConsensusMetadataDirSyncer::num_syncs() const {
+  lock_guard<Mutex> l(lock_);
+  return syncs_finished_;
+}
+
 int64_t ConsensusMetadata::current_term() const {
   DFAKE_SCOPED_RECURSIVE_LOCK(fake_lock_);
   DCHECK(pb_.has_current_term());
@@ -233,17 +279,26 @@ Status ConsensusMetadata::Flush(FlushMode flush_mode) {
                           "Unable to fsync consensus parent dir " + parent_dir);
   }
 
+  // We use FLAGS_log_force_fsync_all here because the consensus metadata is
+  // essentially an extension of the primary durability mechanism of the
+  // consensus subsystem: the WAL. Using the same flag ensures that the WAL
+  // and the consensus metadata get the same durability guarantees.
+  pb_util::SyncMode sync_mode = pb_util::NO_SYNC;
+  if (FLAGS_log_force_fsync_all) {
+    sync_mode = dir_syncer_ && FLAGS_cmeta_group_dir_sync ? pb_util::SYNC_FILE_ONLY
+                                                          : pb_util::SYNC;
+  }
   string meta_file_path = fs_manager_->GetConsensusMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPath(
       fs_manager_->env(), meta_file_path, pb_,
       flush_mode == OVERWRITE ? pb_util::OVERWRITE : pb_util::NO_OVERWRITE,
-      // We use FLAGS_log_force_fsync_all here because the consensus metadata is
-      // essentially an extension of the primary durability mechanism of the
-      // consensus subsystem: the WAL. Using the same flag ensures that the WAL
-      // and the consensus metadata get the same durability guarantees.
-      FLAGS_log_force_fsync_all ? pb_util::SYNC : pb_util::NO_SYNC),
+      sync_mode),
           Substitute("Unable to write consensus meta file for tablet $0 to path $1",
                      tablet_id_, meta_file_path));
+  if (sync_mode == pb_util::SYNC_FILE_ONLY) {
+    RETURN_NOT_OK_PREPEND(dir_syncer_->SyncDir(),
+                          "Unable to fsync consensus metadata dir " + dir);
+  }
   RETURN_NOT_OK(UpdateOnDiskSize());
   return Status::OK();
 }
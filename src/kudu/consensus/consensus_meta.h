@@ -18,7 +18,9 @@
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include <gtest/gtest_prod.h>
 
@@ -27,11 +29,13 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/threading/thread_collision_warner.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
 class FsManager;
-class Status;
 
 namespace consensus {
 
@@ -43,6 +47,41 @@ enum class ConsensusMetadataCreateMode {
   NO_FLUSH_ON_CREATE,
 };
 
+// Group-commits the syncs of the consensus metadata directory, which make
+// the renames of newly written consensus metadata files durable. A caller
+// whose file is renamed into place is waiting for a sync which started
+// after the rename; while one sync is running, all the callers which arrive
+// meanwhile are covered by the single sync which follows it.
+//
+// This class is thread-safe.
+class ConsensusMetadataDirSyncer {
+ public:
+  explicit ConsensusMetadataDirSyncer(FsManager* fs_manager);
+
+  // Sync the directory, or wait for a sync of it that started after this
+  // call. Returns the status of that sync.
+  Status SyncDir();
+
+  // The number of syncs of the directory done so far.
+  int64_t num_syncs() const;
+
+ private:
+  FsManager* const fs_manager_;
+
+  mutable Mutex lock_;
+  ConditionVariable cond_;
+
+  // The number of syncs started and finished, and whether one is running.
+  int64_t syncs_started_;
+  int64_t syncs_finished_;
+  bool sync_running_;
+
+  // The status of the last finished sync.
+  Status last_status_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConsensusMetadataDirSyncer);
+};
+
 // Provides methods to read, write, and persist consensus-related metadata.
 // This partly corresponds to Raft Figure 2's "Persistent state on all servers".
 //
@@ -214,10 +253,20 @@ class ConsensusMetadata : public RefCountedThreadSafe<ConsensusMetadata> {
   // Updates the cached on-disk size of the consensus metadata.
   Status UpdateOnDiskSize();
 
+  // Set by the ConsensusMetadataManager. With --cmeta_group_dir_sync, flushes
+  // sync the directory through it.
+  void set_dir_syncer(std::shared_ptr<ConsensusMetadataDirSyncer> dir_syncer) {
+    dir_syncer_ = std::move(dir_syncer);
+  }
+
   FsManager* const fs_manager_;
   const std::string tablet_id_;
   const std::string peer_uuid_;
 
+  // Syncs the directory holding the metadata file, or NULL if the metadata
+  // isn't managed by a ConsensusMetadataManager.
+  std::shared_ptr<ConsensusMetadataDirSyncer> dir_syncer_;
+
   // This fake mutex helps ensure that this ConsensusMetadata object stays
   // externally synchronized.
   DFAKE_MUTEX(fake_lock_);
@@ -17,7 +17,10 @@
 
 #include <cstdint>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <google/protobuf/util/message_differencer.h>
 #include <gtest/gtest.h>
 
@@ -27,12 +30,19 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/status.h"
 
+DECLARE_bool(cmeta_group_dir_sync);
+DECLARE_bool(log_force_fsync_all);
+
 using google::protobuf::util::MessageDifferencer;
+using std::thread;
+using std::vector;
+using strings::Substitute;
 
 namespace kudu {
 namespace consensus {
@@ -156,5 +166,51 @@ TEST_F(ConsensusMetadataManagerTest, TestNoClobber) {
   }
 }
 
+// Test that concurrent flushes of different tablets' cmetas share their
+// directory syncs, and that the flushed cmetas are intact.
+TEST_F(ConsensusMetadataManagerTest, TestGroupDirSync) {
+  FLAGS_log_force_fsync_all = true;
+  FLAGS_cmeta_group_dir_sync = true;
+  const int kNumTablets = 16;
+
+  vector<scoped_refptr<ConsensusMetadata>> cmetas(kNumTablets);
+  for (int i = 0; i < kNumTablets; i++) {
+    ASSERT_OK(cmeta_manager_->Create(Substitute("$0-$1", kTabletId, i), config_, kInitialTerm,
+                                     ConsensusMetadataCreateMode::NO_FLUSH_ON_CREATE,
+                                     &cmetas[i]));
+  }
+  // A flush on its own gets a sync of its own.
+  ASSERT_OK(cmetas[0]->Flush());
+  ASSERT_EQ(1, cmeta_manager_->dir_sync_count_for_tests());
+
+  vector<Status> statuses(kNumTablets);
+  vector<thread> threads;
+  for (int i = 0; i < kNumTablets; i++) {
+    threads.emplace_back([&, i]() {
+      cmetas[i]->set_current_term(kInitialTerm + 1);
+      statuses[i] = cmetas[i]->Flush();
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& s : statuses) {
+    ASSERT_OK(s);
+  }
+  // Each flush was covered by a sync, though how many were shared depends
+  // on the timing.
+  int64_t num_syncs = cmeta_manager_->dir_sync_count_for_tests();
+  ASSERT_GT(num_syncs, 1);
+  ASSERT_LE(num_syncs, kNumTablets + 1);
+
+  // Reload the cmetas from disk.
+  cmeta_manager_.reset(new ConsensusMetadataManager(&fs_manager_));
+  for (int i = 0; i < kNumTablets; i++) {
+    scoped_refptr<ConsensusMetadata> cmeta;
+    ASSERT_OK(cmeta_manager_->Load(Substitute("$0-$1", kTabletId, i), &cmeta));
+    ASSERT_EQ(kInitialTerm + 1, cmeta->current_term());
+  }
+}
+
 } // namespace consensus
 } // namespace kudu
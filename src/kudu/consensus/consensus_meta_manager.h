@@ -17,6 +17,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -81,11 +82,21 @@ class ConsensusMetadataManager : public RefCountedThreadSafe<ConsensusMetadataMa
   // for some reason, perhaps due to a permissions or I/O-related issue.
   Status Delete(const std::string& tablet_id);
 
+  // The number of syncs of the consensus metadata directory done through
+  // the manager, with --cmeta_group_dir_sync.
+  int64_t dir_sync_count_for_tests() const {
+    return dir_syncer_->num_syncs();
+  }
+
  private:
   friend class RefCountedThreadSafe<ConsensusMetadataManager>;
 
   FsManager* const fs_manager_;
 
+  // Shared by the metadata of all the tablets, whose files are all in the
+  // same directory.
+  const std::shared_ptr<ConsensusMetadataDirSyncer> dir_syncer_;
+
   // Lock protecting the map below.
   Mutex lock_;
 
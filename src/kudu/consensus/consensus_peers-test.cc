@@ -15,12 +15,17 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -45,14 +50,22 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/rpc/response_callback.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/threadpool.h"
 
+DECLARE_bool(consensus_multi_raft_batching);
+DECLARE_int32(consensus_max_batch_size_bytes);
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+DECLARE_int32(consensus_multi_raft_batch_max_op_bytes);
+
 METRIC_DECLARE_entity(tablet);
 
 namespace kudu {
@@ -65,6 +78,7 @@ using rpc::MessengerBuilder;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 
 const char* kTabletId = "test-peers-tablet";
 const char* kLeaderUuid = "peer-0";
@@ -355,6 +369,203 @@ TEST_F(ConsensusPeersTest, TestDontSendOneRpcPerWriteWhenPeerIsDown) {
   ASSERT_LT(mock_proxy->update_count(), 5);
 }
 
+// A proxy which emulates a follower that applies the requests in the order
+// they are sent, but holds the responses until the test releases them, so that
+// several requests may be in flight at once.
+class HeldResponsePeerProxy : public PeerProxy {
+ public:
+  HeldResponsePeerProxy(ThreadPool* pool, string uuid)
+      : pool_(pool),
+        uuid_(std::move(uuid)),
+        last_received_(MinimumOpId()),
+        max_in_flight_(0) {
+  }
+
+  void UpdateAsync(const ConsensusRequestPB* request,
+                   ConsensusResponsePB* response,
+                   rpc::RpcController* /*controller*/,
+                   const rpc::ResponseCallback& callback) override {
+    std::lock_guard<simple_spinlock> l(lock_);
+    response->Clear();
+    if (OpIdLessThan(last_received_, request->preceding_id())) {
+      ConsensusErrorPB* error = response->mutable_status()->mutable_error();
+      error->set_code(ConsensusErrorPB::PRECEDING_ENTRY_DIDNT_MATCH);
+      StatusToPB(Status::IllegalState(""), error->mutable_status());
+    } else if (request->ops_size() > 0) {
+      last_received_ = request->ops(request->ops_size() - 1).id();
+    }
+    response->set_responder_uuid(uuid_);
+    response->set_responder_term(request->caller_term());
+    response->mutable_status()->mutable_last_received()->CopyFrom(last_received_);
+    response->mutable_status()->mutable_last_received_current_leader()->CopyFrom(last_received_);
+    response->mutable_status()->set_last_committed_idx(last_received_.index());
+    held_.push_back(callback);
+    max_in_flight_ = std::max<int>(max_in_flight_, held_.size());
+  }
+
+  void RequestConsensusVoteAsync(const VoteRequestPB* /*request*/,
+                                 VoteResponsePB* /*response*/,
+                                 rpc::RpcController* /*controller*/,
+                                 const rpc::ResponseCallback& /*callback*/) override {
+    LOG(FATAL) << "Not implemented";
+  }
+
+  Status StartElection(const RunLeaderElectionRequestPB* /*request*/,
+                       RunLeaderElectionResponsePB* /*response*/,
+                       rpc::RpcController* /*controller*/) override {
+    return Status::OK();
+  }
+
+  string PeerName() const override {
+    return "HeldResponsePeerProxy";
+  }
+
+  // Release the held responses, the most recent one first.
+  void RespondInReverseOrder() {
+    vector<rpc::ResponseCallback> callbacks;
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      callbacks.assign(held_.rbegin(), held_.rend());
+      held_.clear();
+    }
+    for (const auto& callback : callbacks) {
+      CHECK_OK(pool_->SubmitFunc(callback));
+    }
+  }
+
+  int max_in_flight() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return max_in_flight_;
+  }
+
+ private:
+  ThreadPool* pool_;
+  const string uuid_;
+  mutable simple_spinlock lock_;
+  OpId last_received_;                     // Protected by lock_.
+  vector<rpc::ResponseCallback> held_;     // Protected by lock_.
+  int max_in_flight_;                      // Protected by lock_.
+};
+
+// Tests that ops are pipelined to a peer when several requests are allowed in
+// flight, and that they all get replicated even though the responses come back
+// out of order.
+TEST_F(ConsensusPeersTest, TestPipelinedRequests) {
+  FLAGS_consensus_max_inflight_requests_per_peer = 4;
+  // Send a single op per request.
+  FLAGS_consensus_max_batch_size_bytes = 4096;
+  const int kNumOps = 20;
+
+  message_queue_->SetLeaderMode(kMinimumOpIdIndex,
+                                kMinimumTerm,
+                                BuildRaftConfigPBForTests(3));
+
+  auto proxy = new HeldResponsePeerProxy(raft_pool_.get(), kFollowerUuid);
+  shared_ptr<Peer> peer;
+  ASSERT_OK(Peer::NewRemotePeer(FakeRaftPeerPB(kFollowerUuid),
+                                kTabletId,
+                                kLeaderUuid,
+                                message_queue_.get(),
+                                raft_pool_token_.get(),
+                                gscoped_ptr<PeerProxy>(proxy),
+                                messenger_,
+                                &peer));
+
+  AppendReplicateMessagesToQueue(message_queue_.get(), clock_, 1, kNumOps, 3000);
+  ASSERT_OK(peer->SignalRequest(true));
+
+  ASSERT_EVENTUALLY([&]() {
+    proxy->RespondInReverseOrder();
+    ASSERT_EQ(kNumOps, message_queue_->GetAllReplicatedIndex());
+  });
+  ASSERT_GT(proxy->max_in_flight(), 1);
+
+  // Release anything still in flight, since the callbacks hold on to the peer.
+  peer->Close();
+  raft_pool_->Wait();
+  proxy->RespondInReverseOrder();
+}
+
+// A NoOpTestPeerProxy which also accepts batched requests, counting the
+// requests sent each way.
+class BatchingTestPeerProxy : public NoOpTestPeerProxy {
+ public:
+  BatchingTestPeerProxy(ThreadPool* pool, RaftPeerPB peer_pb)
+      : NoOpTestPeerProxy(pool, std::move(peer_pb)),
+        num_batched_(0),
+        num_unbatched_(0) {
+  }
+
+  void UpdateAsync(const ConsensusRequestPB* request,
+                   ConsensusResponsePB* response,
+                   rpc::RpcController* controller,
+                   const rpc::ResponseCallback& callback) override {
+    num_unbatched_++;
+    NoOpTestPeerProxy::UpdateAsync(request, response, controller, callback);
+  }
+
+  bool SupportsBatchedUpdates() const override { return true; }
+
+  void UpdateBatchedAsync(const ConsensusRequestPB* request,
+                          ConsensusResponsePB* response,
+                          StdStatusCallback callback) override {
+    num_batched_++;
+    NoOpTestPeerProxy::UpdateAsync(request, response, nullptr,
+                                   [callback]() { callback(Status::OK()); });
+  }
+
+  int num_batched() const { return num_batched_; }
+  int num_unbatched() const { return num_unbatched_; }
+
+ private:
+  std::atomic<int> num_batched_;
+  std::atomic<int> num_unbatched_;
+};
+
+// Tests that heartbeats, and appends up to the configured size, are batched
+// when the proxy supports it, and that larger appends are sent on their own.
+TEST_F(ConsensusPeersTest, TestBatchedRequests) {
+  FLAGS_consensus_multi_raft_batching = true;
+  FLAGS_consensus_multi_raft_batch_max_op_bytes = 0;
+
+  message_queue_->SetLeaderMode(kMinimumOpIdIndex,
+                                kMinimumTerm,
+                                BuildRaftConfigPBForTests(3));
+
+  auto proxy = new BatchingTestPeerProxy(raft_pool_.get(), FakeRaftPeerPB(kFollowerUuid));
+  shared_ptr<Peer> peer;
+  ASSERT_OK(Peer::NewRemotePeer(FakeRaftPeerPB(kFollowerUuid),
+                                kTabletId,
+                                kLeaderUuid,
+                                message_queue_.get(),
+                                raft_pool_token_.get(),
+                                gscoped_ptr<PeerProxy>(proxy),
+                                messenger_,
+                                &peer));
+
+  // With only heartbeats batched, the ops go in a request of their own.
+  AppendReplicateMessagesToQueue(message_queue_.get(), clock_, 1, 1, 1000);
+  ASSERT_OK(peer->SignalRequest(true));
+  WaitForCommitIndex(1);
+  ASSERT_GE(proxy->num_unbatched(), 1);
+
+  // Status-only requests are batched.
+  int num_batched = proxy->num_batched();
+  ASSERT_OK(peer->SignalRequest(true));
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_GT(proxy->num_batched(), num_batched);
+  });
+
+  // Once small appends may be batched, nothing is sent on its own anymore.
+  FLAGS_consensus_multi_raft_batch_max_op_bytes = 64 * 1024;
+  int num_unbatched = proxy->num_unbatched();
+  AppendReplicateMessagesToQueue(message_queue_.get(), clock_, 2, 1, 1000);
+  ASSERT_OK(peer->SignalRequest(true));
+  WaitForCommitIndex(2);
+  ASSERT_EQ(num_unbatched, proxy->num_unbatched());
+
+  peer->Close();
+}
+
 }  // namespace consensus
 }  // namespace kudu
-
@@ -37,7 +37,9 @@
 #include "kudu/consensus/consensus.proxy.h"
 #include "kudu/consensus/consensus_queue.h"
 #include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/multi_raft_batcher.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/state_machine_snapshot.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
@@ -45,8 +47,12 @@
 #include "kudu/rpc/periodic.h"
 #include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/rpc_controller.h"
+#include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/fault_injection.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
@@ -83,7 +89,23 @@ DEFINE_bool(enable_tablet_copy, true,
             "replica. For testing purposes only.");
 TAG_FLAG(enable_tablet_copy, unsafe);
 
+DEFINE_bool(consensus_send_ops_in_sidecar, false,
+            "Whether the leader ships the ops of an UpdateConsensus request as a "
+            "pre-serialized RPC sidecar shared by all peers, instead of serializing "
+            "them into every peer's request. All servers in the cluster must "
+            "support ConsensusRequestPB::ops_sidecar_idx before enabling this.");
+TAG_FLAG(consensus_send_ops_in_sidecar, advanced);
+TAG_FLAG(consensus_send_ops_in_sidecar, experimental);
+
+DEFINE_int32(raft_snapshot_chunk_size_bytes, 1024 * 1024,
+             "The maximum number of bytes of a state machine snapshot sent to "
+             "a peer in a single InstallSnapshot request.");
+TAG_FLAG(raft_snapshot_chunk_size_bytes, advanced);
+
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+DECLARE_int32(consensus_multi_raft_batch_max_op_bytes);
 DECLARE_int32(raft_heartbeat_interval_ms);
+DECLARE_int32(raft_quiescent_heartbeat_interval_ms);
 
 using kudu::pb_util::SecureShortDebugString;
 using kudu::rpc::Messenger;
@@ -103,6 +125,27 @@ namespace consensus {
 // The number of retries between failed requests whose failure is logged.
 constexpr auto kNumRetriesBetweenLoggingFailedRequest = 5;
 
+namespace {
+
+// Whether a request carrying 'ops' carries few enough bytes of ops to be
+// batched with the requests of other tablets (see
+// --consensus_multi_raft_batch_max_op_bytes).
+bool IsSmallEnoughToBatch(const ReplicateSpanPtr& ops) {
+  if (!ops) {
+    return true;
+  }
+  int64_t op_bytes = 0;
+  for (const ReplicateRefPtr& op : ops->msgs()) {
+    op_bytes += op->byte_size();
+    if (op_bytes > FLAGS_consensus_multi_raft_batch_max_op_bytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // anonymous namespace
+
 Status Peer::NewRemotePeer(RaftPeerPB peer_pb,
                            string tablet_id,
                            string leader_uuid,
@@ -137,6 +180,7 @@ Peer::Peer(RaftPeerPB peer_pb,
       proxy_(std::move(proxy)),
       queue_(queue),
       failed_attempts_(0),
+      last_request_committed_index_(kMinimumOpIdIndex),
       messenger_(std::move(messenger)),
       raft_pool_token_(raft_pool_token) {
 }
@@ -150,6 +194,14 @@ Status Peer::Init() {
   // Capture a weak_ptr reference into the functor so it can safely handle
   // outliving the peer.
   weak_ptr<Peer> w = shared_from_this();
+
+  // Send the ops as soon as an asynchronous catch-up read for them completes.
+  queue_->SetCatchupReadCallback(peer_pb_.permanent_uuid(), [w]() {
+    if (auto p = w.lock()) {
+      p->SignalRequest(true);
+    }
+  });
+
   heartbeater_ = PeriodicTimer::Create(
       messenger_,
       [w]() {
@@ -169,31 +221,60 @@ Status Peer::SignalRequest(bool even_if_queue_empty) {
     return Status::IllegalState("Peer was closed.");
   }
 
-  // Only allow one request at a time. No sense waking up the
-  // raft thread pool if the task will just abort anyway.
-  if (request_pending_) {
+  // Only allow one request at a time, unless ops can be pipelined behind it.
+  // No sense waking up the raft thread pool if the task will just abort anyway.
+  if (request_pending_ && !CanPipelineUnlocked()) {
     return Status::OK();
   }
 
   // Capture a weak_ptr reference into the submitted functor so that we can
-  // safely handle the functor outliving its peer.
+  // safely handle the functor outliving its peer. A SendNextRequest() still
+  // queued catches up with whatever this signal is about, so it's not queued
+  // twice.
   weak_ptr<Peer> w_this = shared_from_this();
-  RETURN_NOT_OK(raft_pool_token_->SubmitFunc([even_if_queue_empty, w_this]() {
-    if (auto p = w_this.lock()) {
-      p->SendNextRequest(even_if_queue_empty);
-    }
-  }));
+  RETURN_NOT_OK(raft_pool_token_->SubmitCoalesced(
+      &send_next_request_keys_[even_if_queue_empty ? 1 : 0],
+      [even_if_queue_empty, w_this]() {
+        if (auto p = w_this.lock()) {
+          p->SendNextRequest(even_if_queue_empty);
+        }
+      }));
   return Status::OK();
 }
 
+Status Peer::SignalHeartbeat() {
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    if (PREDICT_FALSE(closed_)) {
+      return Status::IllegalState("Peer was closed.");
+    }
+    if (request_pending_) {
+      heartbeat_requested_ = true;
+      return Status::OK();
+    }
+  }
+  return SignalRequest(true);
+}
+
+void Peer::SetRelayProxy(gscoped_ptr<PeerProxy> relay_proxy) {
+  std::lock_guard<simple_spinlock> l(peer_lock_);
+  relay_proxy_.reset(relay_proxy.release());
+}
+
+bool Peer::has_relay_proxy() const {
+  std::lock_guard<simple_spinlock> l(peer_lock_);
+  return relay_proxy_ != nullptr;
+}
+
 void Peer::SendNextRequest(bool even_if_queue_empty) {
   std::unique_lock<simple_spinlock> l(peer_lock_);
   if (PREDICT_FALSE(closed_)) {
     return;
   }
 
-  // Only allow one request at a time.
+  // Only allow one request at a time, unless ops can be pipelined behind it.
   if (request_pending_) {
+    SendPipelinedRequests(&l);
     return;
   }
 
@@ -220,20 +301,31 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
   }
 
   // The peer has no pending request nor is sending: send the request.
+  UpdateCall* call = AcquireCallUnlocked();
   bool needs_tablet_copy = false;
-  int64_t commit_index_before = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
-  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &request_,
-                                    &replicate_msg_refs_, &needs_tablet_copy);
-  int64_t commit_index_after = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
+  int64_t commit_index_before = last_request_committed_index_;
+  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &call->request,
+                                    &call->replicate_msg_refs, &needs_tablet_copy);
+  if (call->request.has_committed_index()) {
+    last_request_committed_index_ = call->request.committed_index();
+  }
+  int64_t commit_index_after = last_request_committed_index_;
 
   if (PREDICT_FALSE(!s.ok())) {
     VLOG_WITH_PREFIX_UNLOCKED(1) << s.ToString();
+    ReleaseCallUnlocked(call);
+    // The logs needed to catch up the peer are gone, but the state machine
+    // may catch it up from a snapshot instead.
+    if (s.IsNotFound() && queue_->PeerNeedsSnapshot(peer_pb_.permanent_uuid())) {
+      request_pending_ = true;
+      l.unlock();
+      SendSnapshot();
+    }
     return;
   }
 
   if (PREDICT_FALSE(needs_tablet_copy)) {
+    ReleaseCallUnlocked(call);
     Status s = PrepareTabletCopyRequest();
     if (s.ok()) {
       controller_.Reset();
@@ -253,38 +345,169 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
     return;
   }
 
-  request_.set_tablet_id(tablet_id_);
-  request_.set_caller_uuid(leader_uuid_);
-  request_.set_dest_uuid(peer_pb_.permanent_uuid());
-
-  bool req_has_ops = request_.ops_size() > 0 || (commit_index_after > commit_index_before);
+  bool req_has_ops = call->request.ops_size() > 0 || (commit_index_after > commit_index_before);
   // If the queue is empty, check if we were told to send a status-only
   // message, if not just return.
   if (PREDICT_FALSE(!req_has_ops && !even_if_queue_empty)) {
+    ReleaseCallUnlocked(call);
     return;
   }
 
   if (req_has_ops) {
     // If we're actually sending ops there's no need to heartbeat for a while.
     heartbeater_->Snooze();
+  } else if (call->request.quiescent()) {
+    // The peer is caught up on an idle tablet: heartbeat it less often until
+    // there are new ops to send, which snoozes the heartbeater back to its
+    // regular period.
+    heartbeater_->Snooze(MonoDelta::FromMilliseconds(FLAGS_raft_quiescent_heartbeat_interval_ms));
+  }
+
+  SendUpdate(call, &l);
+
+  // Keep the ops following this request flowing while it's in flight.
+  if (FLAGS_consensus_max_inflight_requests_per_peer > 1) {
+    l.lock();
+    SendPipelinedRequests(&l);
+  }
+}
+
+void Peer::SendPipelinedRequests(std::unique_lock<simple_spinlock>* l) {
+  DCHECK(l->owns_lock());
+  while (!closed_ && CanPipelineUnlocked()) {
+    UpdateCall* call = AcquireCallUnlocked();
+    Status s = queue_->PipelinedRequestForPeer(peer_pb_.permanent_uuid(),
+                                               pipelined_through_index_,
+                                               &call->request,
+                                               &call->replicate_msg_refs);
+    if (PREDICT_FALSE(!s.ok())) {
+      VLOG_WITH_PREFIX_UNLOCKED(1) << s.ToString();
+    }
+    if (!s.ok() || call->request.ops_size() == 0) {
+      ReleaseCallUnlocked(call);
+      return;
+    }
+    last_request_committed_index_ = call->request.committed_index();
+    heartbeater_->Snooze();
+    SendUpdate(call, l);
+    l->lock();
+  }
+}
+
+void Peer::SendUpdate(UpdateCall* call, std::unique_lock<simple_spinlock>* l) {
+  ConsensusRequestPB* request = &call->request;
+  request->set_tablet_id(tablet_id_);
+  request->set_caller_uuid(leader_uuid_);
+  // Requests routed through the relay are addressed to it: it forwards them
+  // to 'proxy_dest_uuid'.
+  PeerProxy* proxy = proxy_.get();
+  if (request->has_proxy_dest_uuid() && PREDICT_FALSE(!relay_proxy_)) {
+    // The relay joined the config after this peer, and its proxy wasn't set
+    // yet: send a heartbeat directly.
+    request->clear_proxy_dest_uuid();
+    request->clear_relayed_last_op_id();
+  }
+  if (request->has_proxy_dest_uuid()) {
+    proxy = relay_proxy_.get();
+    request->set_dest_uuid(peer_pb_.attrs().relay_uuid());
+  } else {
+    request->set_dest_uuid(peer_pb_.permanent_uuid());
   }
 
   MAYBE_FAULT(FLAGS_fault_crash_on_leader_request_fraction);
 
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending to peer " << peer_pb().permanent_uuid() << ": "
-      << SecureShortDebugString(request_);
-  controller_.Reset();
+      << SecureShortDebugString(*request);
+  call->controller.Reset();
+  call->send_time = MonoTime::Now();
+  request->clear_ops_sidecar_idx();
+  request->clear_ops_sidecar_compression();
+
+  // Further ops may only be pipelined behind the ones in this request: a
+  // status-only request doesn't tell what the peer has.
+  pipelined_through_index_ = !call->replicate_msg_refs ? -1 :
+      call->replicate_msg_refs->back()->id().index();
+
+  // Heartbeats and small appends ride along with those of other tablets to
+  // the same server. Their ops are sent inline.
+  const bool batched = proxy->SupportsBatchedUpdates() && IsSmallEnoughToBatch(call->replicate_msg_refs);
+
+  // Ship the ops as a sidecar shared with the other peers being sent the same
+  // batch. The ops themselves remain owned by 'replicate_msg_refs', so they
+  // are only released from the request here.
+  if (!batched && FLAGS_consensus_send_ops_in_sidecar && request->ops_size() > 0 &&
+      proxy->SupportsOpsSidecar() && peer_supports_ops_sidecar_) {
+    CompressionType compression;
+    int idx;
+    Status s = call->controller.AddOutboundSidecar(
+        rpc::RpcSidecar::FromSharedFaststring(queue_->GetSerializedOps(
+            peer_pb_.permanent_uuid(), call->replicate_msg_refs->msgs(),
+            peer_supports_compressed_ops_, &compression)),
+        &idx);
+    if (PREDICT_TRUE(s.ok())) {
+      request->mutable_ops()->ExtractSubrange(0, request->ops_size(), nullptr);
+      request->set_ops_sidecar_idx(idx);
+      call->controller.RequireServerFeature(OPS_SIDECAR);
+      if (compression != NO_COMPRESSION) {
+        request->set_ops_sidecar_compression(compression);
+        call->controller.RequireServerFeature(COMPRESSED_OPS_SIDECAR);
+      }
+    } else {
+      KLOG_EVERY_N_SECS(WARNING, 10) << LogPrefixUnlocked()
+          << "Unable to attach ops sidecar, sending ops inline: " << s.ToString();
+    }
+  }
 
   request_pending_ = true;
-  l.unlock();
+  num_updates_in_flight_++;
+  l->unlock();
   // Capture a shared_ptr reference into the RPC callback so that we're guaranteed
   // that this object outlives the RPC.
   shared_ptr<Peer> s_this = shared_from_this();
-  proxy_->UpdateAsync(&request_, &response_, &controller_,
-                      [s_this]() {
-                        s_this->ProcessResponse();
-                      });
+  if (batched) {
+    proxy->UpdateBatchedAsync(request, &call->response,
+                               [s_this, call](const Status& s) {
+                                 s_this->ProcessResponse(call, s);
+                               });
+    return;
+  }
+  proxy->UpdateAsync(request, &call->response, &call->controller,
+                     [s_this, call]() {
+                       s_this->ProcessResponse(call, call->controller.status());
+                     });
+}
+
+bool Peer::CanPipelineUnlocked() const {
+  DCHECK(peer_lock_.is_locked());
+  return num_updates_in_flight_ > 0 &&
+      num_updates_in_flight_ < FLAGS_consensus_max_inflight_requests_per_peer &&
+      pipelined_through_index_ >= 0 &&
+      failed_attempts_ == 0;
+}
+
+Peer::UpdateCall* Peer::AcquireCallUnlocked() {
+  DCHECK(peer_lock_.is_locked());
+  if (free_calls_.empty()) {
+    calls_.emplace_back(new UpdateCall);
+    return calls_.back().get();
+  }
+  UpdateCall* call = free_calls_.back();
+  free_calls_.pop_back();
+  return call;
+}
+
+void Peer::ReleaseCallUnlocked(UpdateCall* call) {
+  DCHECK(peer_lock_.is_locked());
+  free_calls_.push_back(call);
+}
+
+void Peer::FinishCallUnlocked(UpdateCall* call) {
+  DCHECK(peer_lock_.is_locked());
+  CHECK_GT(num_updates_in_flight_, 0);
+  num_updates_in_flight_--;
+  request_pending_ = num_updates_in_flight_ > 0;
+  ReleaseCallUnlocked(call);
 }
 
 Status Peer::StartElection() {
@@ -296,12 +519,12 @@ Status Peer::StartElection() {
   RETURN_NOT_OK(proxy_->StartElection(&req, &resp, &controller));
   RETURN_NOT_OK(controller.status());
   if (resp.has_error()) {
-    return StatusFromPB(response_.error().status());
+    return StatusFromPB(resp.error().status());
   }
   return Status::OK();
 }
 
-void Peer::ProcessResponse() {
+void Peer::ProcessResponse(UpdateCall* call, const Status& rpc_status) {
   // Note: This method runs on the reactor thread.
   std::unique_lock<simple_spinlock> lock(peer_lock_);
   if (closed_) {
@@ -311,34 +534,38 @@ void Peer::ProcessResponse() {
 
   MAYBE_FAULT(FLAGS_fault_crash_after_leader_request_fraction);
 
-  // Process RpcController errors.
-  const auto controller_status = controller_.status();
-  if (!controller_status.ok()) {
-    auto ps = controller_status.IsRemoteError() ?
+  const ConsensusResponsePB& response = call->response;
+
+  // Process RPC errors.
+  if (!rpc_status.ok()) {
+    if (rpc_status.IsRemoteError()) {
+      HandleUnsupportedFeaturesUnlocked(call);
+    }
+    auto ps = rpc_status.IsRemoteError() ?
         PeerStatus::REMOTE_ERROR : PeerStatus::RPC_LAYER_ERROR;
-    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, controller_status);
-    ProcessResponseError(controller_status);
+    queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, rpc_status);
+    ProcessResponseError(call, rpc_status);
     return;
   }
 
   // Process CANNOT_PREPARE.
   // TODO(todd): there is no integration test coverage of this code path. Likely a bug in
   // this path is responsible for KUDU-1779.
-  if (response_.status().has_error() &&
-      response_.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE) {
-    Status response_status = StatusFromPB(response_.status().error().status());
+  if (response.status().has_error() &&
+      response.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE) {
+    Status response_status = StatusFromPB(response.status().error().status());
     queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), PeerStatus::CANNOT_PREPARE,
                              response_status);
-    ProcessResponseError(response_status);
+    ProcessResponseError(call, response_status);
     return;
   }
 
   // Process tserver-level errors.
-  if (response_.has_error()) {
-    Status response_status = StatusFromPB(response_.error().status());
+  if (response.has_error()) {
+    Status response_status = StatusFromPB(response.error().status());
     PeerStatus ps;
-    TabletServerErrorPB resp_error = response_.error();
-    switch (response_.error().code()) {
+    TabletServerErrorPB resp_error = response.error();
+    switch (response.error().code()) {
       // We treat WRONG_SERVER_UUID as failed.
       case TabletServerErrorPB::WRONG_SERVER_UUID: FALLTHROUGH_INTENDED;
       case TabletServerErrorPB::TABLET_FAILED:
@@ -352,7 +579,7 @@ void Peer::ProcessResponse() {
         ps = PeerStatus::REMOTE_ERROR;
     }
     queue_->UpdatePeerStatus(peer_pb_.permanent_uuid(), ps, response_status);
-    ProcessResponseError(response_status);
+    ProcessResponseError(call, response_status);
     return;
   }
 
@@ -363,32 +590,59 @@ void Peer::ProcessResponse() {
   //
   // Capture a weak_ptr reference into the submitted functor so that we can
   // safely handle the functor outliving its peer.
+  call->response_time = MonoTime::Now();
   weak_ptr<Peer> w_this = shared_from_this();
-  Status s = raft_pool_token_->SubmitFunc([w_this]() {
+  Status s = raft_pool_token_->SubmitFunc([w_this, call]() {
     if (auto p = w_this.lock()) {
-      p->DoProcessResponse();
+      p->DoProcessResponse(call);
 
     }
   });
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to process peer response: " << s.ToString()
-        << ": " << SecureShortDebugString(response_);
-    request_pending_ = false;
+        << ": " << SecureShortDebugString(response);
+    pipelined_through_index_ = -1;
+    FinishCallUnlocked(call);
   }
 }
 
-void Peer::DoProcessResponse() {
+void Peer::DoProcessResponse(UpdateCall* call) {
+  const ConsensusResponsePB& response = call->response;
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Response from peer " << peer_pb().permanent_uuid() << ": "
-      << SecureShortDebugString(response_);
-
-  bool send_more_immediately = queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response_);
+      << SecureShortDebugString(response);
+
+  queue_->RecordPeerResponseTimes(call->send_time, call->response_time);
+  bool send_more_immediately = queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response);
+  // The peer only withholds its vote from other candidates if it accepted
+  // the request.
+  if (!response.status().has_error()) {
+    queue_->UpdatePeerLeaseRequestTime(peer_pb_.permanent_uuid(), call->send_time);
+  }
 
   {
     std::unique_lock<simple_spinlock> lock(peer_lock_);
     CHECK(request_pending_);
     failed_attempts_ = 0;
-    request_pending_ = false;
+    // If the peer rejected the request, or didn't take all of its ops, the
+    // requests pipelined behind it can't be accepted either: the peer must be
+    // resynchronized once they are all done.
+    if (response.status().has_error() ||
+        (call->replicate_msg_refs &&
+         response.status().last_received().index() <
+             call->replicate_msg_refs->back()->id().index())) {
+      pipelined_through_index_ = -1;
+    }
+    // Until the relay receives the next ops, there is nothing more it can
+    // forward: wait for the next ops or heartbeat instead.
+    if (call->request.has_proxy_dest_uuid() && !call->request.has_relayed_last_op_id()) {
+      send_more_immediately = false;
+    }
+    FinishCallUnlocked(call);
+    if (heartbeat_requested_ && !request_pending_) {
+      heartbeat_requested_ = false;
+      send_more_immediately = true;
+    }
   }
   // We're OK to read the state_ without a lock here -- if we get a race,
   // the worst thing that could happen is that we'll make one more request before
@@ -439,13 +693,138 @@ void Peer::ProcessTabletCopyResponse() {
   }
 }
 
-void Peer::ProcessResponseError(const Status& status) {
+void Peer::SendSnapshot() {
+  Status s = queue_->StartSnapshotForPeer(peer_pb_.permanent_uuid(), &snapshot_reader_,
+                                          &snapshot_request_);
+  if (PREDICT_FALSE(!s.ok())) {
+    FinishSnapshot(s);
+    return;
+  }
+  LOG_WITH_PREFIX_UNLOCKED(INFO) << "Sending snapshot through "
+                                 << OpIdToString(snapshot_request_.last_included_op_id())
+                                 << " to peer";
+  SendSnapshotChunk();
+}
+
+void Peer::SendSnapshotChunk() {
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    if (closed_) {
+      return;
+    }
+  }
+  // The snapshot state is only touched by the one request in flight, so it
+  // needn't be protected by 'peer_lock_'.
+  bool done = false;
+  snapshot_request_.clear_data();
+  Status s = snapshot_reader_->Read(FLAGS_raft_snapshot_chunk_size_bytes,
+                                    snapshot_request_.mutable_data(), &done);
+  if (PREDICT_FALSE(!s.ok())) {
+    FinishSnapshot(s.CloneAndPrepend("Unable to read snapshot"));
+    return;
+  }
+  snapshot_request_.set_done(done);
+  controller_.Reset();
+  shared_ptr<Peer> s_this = shared_from_this();
+  proxy_->InstallSnapshotAsync(&snapshot_request_, &snapshot_response_, &controller_,
+                               [s_this]() {
+                                 s_this->ProcessInstallSnapshotResponse();
+                               });
+}
+
+void Peer::ProcessInstallSnapshotResponse() {
+  // Reading the next chunk may do IO: don't do it on the reactor thread.
+  weak_ptr<Peer> w_this = shared_from_this();
+  Status s = raft_pool_token_->SubmitFunc([w_this]() {
+    if (auto p = w_this.lock()) {
+      p->DoProcessInstallSnapshotResponse();
+    }
+  });
+  if (PREDICT_FALSE(!s.ok())) {
+    FinishSnapshot(s);
+  }
+}
+
+void Peer::DoProcessInstallSnapshotResponse() {
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    if (closed_) {
+      return;
+    }
+  }
+  Status s = controller_.status();
+  if (s.ok() && snapshot_response_.has_error()) {
+    s = StatusFromPB(snapshot_response_.error().status());
+  }
+  if (s.ok()) {
+    queue_->SnapshotResponseFromPeer(peer_pb_.permanent_uuid(),
+                                     snapshot_request_.last_included_op_id(),
+                                     snapshot_response_);
+    if (snapshot_response_.status().has_error()) {
+      s = StatusFromPB(snapshot_response_.status().error().status());
+    } else if (!snapshot_response_.done()) {
+      if (PREDICT_FALSE(snapshot_request_.done())) {
+        s = Status::IllegalState("peer did not install the complete snapshot");
+      } else {
+        snapshot_request_.set_offset(snapshot_request_.offset() +
+                                     snapshot_request_.data().size());
+        SendSnapshotChunk();
+        return;
+      }
+    }
+  }
+  FinishSnapshot(s);
+}
+
+void Peer::FinishSnapshot(const Status& status) {
+  if (!status.ok()) {
+    LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to install snapshot on peer: "
+                                      << status.ToString();
+  }
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    snapshot_reader_.reset();
+    request_pending_ = false;
+    if (status.ok()) {
+      failed_attempts_ = 0;
+    } else {
+      failed_attempts_++;
+    }
+  }
+  if (status.ok()) {
+    // Send the peer the ops following the snapshot.
+    WARN_NOT_OK(SignalRequest(true), "Unable to signal request after snapshot");
+  }
+}
+
+void Peer::HandleUnsupportedFeaturesUnlocked(UpdateCall* call) {
+  DCHECK(peer_lock_.is_locked());
+  const rpc::ErrorStatusPB* err = call->controller.error_response();
+  if (!err) {
+    return;
+  }
+  // Fall back to what older peers understand; the failed request is simply
+  // retried in the older format.
+  for (uint32_t feature : err->unsupported_feature_flags()) {
+    if (feature == COMPRESSED_OPS_SIDECAR && peer_supports_compressed_ops_) {
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << "Peer does not support compressed ops, "
+                                     << "sending them uncompressed";
+      peer_supports_compressed_ops_ = false;
+    } else if (feature == OPS_SIDECAR && peer_supports_ops_sidecar_) {
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << "Peer does not support ops sidecars, "
+                                     << "sending ops inline";
+      peer_supports_ops_sidecar_ = false;
+    }
+  }
+}
+
+void Peer::ProcessResponseError(UpdateCall* call, const Status& status) {
   failed_attempts_++;
   string resp_err_info;
-  if (response_.has_error()) {
+  if (call->response.has_error()) {
     resp_err_info = Substitute(" Error code: $0 ($1).",
-                               TabletServerErrorPB::Code_Name(response_.error().code()),
-                               response_.error().code());
+                               TabletServerErrorPB::Code_Name(call->response.error().code()),
+                               call->response.error().code());
   }
   // We log the warning at the first failure, then every
   // 'kNumRetriesBetweenLoggingFailedRequest' retries.
@@ -463,7 +842,8 @@ void Peer::ProcessResponseError(const Status& status) {
                  failed_attempts_,
                  kNumRetriesBetweenLoggingFailedRequest);
   }
-  request_pending_ = false;
+  pipelined_through_index_ = -1;
+  FinishCallUnlocked(call);
 }
 
 string Peer::LogPrefixUnlocked() const {
@@ -491,13 +871,17 @@ Peer::~Peer() {
   }
 
   // We don't own the ops (the queue does).
-  request_.mutable_ops()->ExtractSubrange(0, request_.ops_size(), nullptr);
+  for (const auto& call : calls_) {
+    call->request.mutable_ops()->ExtractSubrange(0, call->request.ops_size(), nullptr);
+  }
 }
 
 RpcPeerProxy::RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy)
+                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+                           shared_ptr<MultiRaftBatcher> batcher)
     : hostport_(std::move(DCHECK_NOTNULL(hostport))),
-      consensus_proxy_(std::move(DCHECK_NOTNULL(consensus_proxy))) {
+      consensus_proxy_(std::move(DCHECK_NOTNULL(consensus_proxy))),
+      batcher_(std::move(batcher)) {
 }
 
 void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
@@ -508,6 +892,17 @@ void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
   consensus_proxy_->UpdateConsensusAsync(*request, response, controller, callback);
 }
 
+bool RpcPeerProxy::SupportsBatchedUpdates() const {
+  return batcher_ && batcher_->enabled();
+}
+
+void RpcPeerProxy::UpdateBatchedAsync(const ConsensusRequestPB* request,
+                                      ConsensusResponsePB* response,
+                                      StdStatusCallback callback) {
+  DCHECK(batcher_);
+  batcher_->AddRequest(request, response, std::move(callback));
+}
+
 Status RpcPeerProxy::StartElection(const RunLeaderElectionRequestPB* request,
                                  RunLeaderElectionResponsePB* response,
                                  rpc::RpcController* controller) {
@@ -519,7 +914,22 @@ void RpcPeerProxy::RequestConsensusVoteAsync(const VoteRequestPB* request,
                                              VoteResponsePB* response,
                                              rpc::RpcController* controller,
                                              const rpc::ResponseCallback& callback) {
-  consensus_proxy_->RequestConsensusVoteAsync(*request, response, controller, callback);
+  if (!batcher_ || !batcher_->votes_enabled()) {
+    consensus_proxy_->RequestConsensusVoteAsync(*request, response, controller, callback);
+    return;
+  }
+  // The controller is not used by the batched call, so a failure of the
+  // batch is handed back as a tablet error, which the election also counts
+  // as a denied vote.
+  batcher_->AddVoteRequest(request, response, [response, callback](const Status& s) {
+    if (!s.ok()) {
+      response->Clear();
+      TabletServerErrorPB* error = response->mutable_error();
+      error->set_code(TabletServerErrorPB::UNKNOWN_ERROR);
+      StatusToPB(s, error->mutable_status());
+    }
+    callback();
+  });
 }
 
 void RpcPeerProxy::StartTabletCopyAsync(const StartTabletCopyRequestPB* request,
@@ -530,12 +940,25 @@ void RpcPeerProxy::StartTabletCopyAsync(const StartTabletCopyRequestPB* request,
   consensus_proxy_->StartTabletCopyAsync(*request, response, controller, callback);
 }
 
+void RpcPeerProxy::InstallSnapshotAsync(const InstallSnapshotRequestPB* request,
+                                        InstallSnapshotResponsePB* response,
+                                        rpc::RpcController* controller,
+                                        const rpc::ResponseCallback& callback) {
+  controller->set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  consensus_proxy_->InstallSnapshotAsync(*request, response, controller, callback);
+}
+
+void RpcPeerProxy::ReadIndexAsync(const ReadIndexRequestPB* request,
+                                  ReadIndexResponsePB* response,
+                                  rpc::RpcController* controller,
+                                  const rpc::ResponseCallback& callback) {
+  consensus_proxy_->ReadIndexAsync(*request, response, controller, callback);
+}
+
 string RpcPeerProxy::PeerName() const {
   return hostport_->ToString();
 }
 
-namespace {
-
 Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger,
                                           const HostPort& hostport,
                                           gscoped_ptr<ConsensusServiceProxy>* new_proxy) {
@@ -550,10 +973,10 @@ Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger
   return Status::OK();
 }
 
-} // anonymous namespace
-
-RpcPeerProxyFactory::RpcPeerProxyFactory(shared_ptr<Messenger> messenger)
-    : messenger_(std::move(messenger)) {}
+RpcPeerProxyFactory::RpcPeerProxyFactory(shared_ptr<Messenger> messenger,
+                                         shared_ptr<MultiRaftManager> multi_raft_manager)
+    : messenger_(std::move(messenger)),
+      multi_raft_manager_(std::move(multi_raft_manager)) {}
 
 Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
                                      gscoped_ptr<PeerProxy>* proxy) {
@@ -561,7 +984,11 @@ Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
   RETURN_NOT_OK(HostPortFromPB(peer_pb.last_known_addr(), hostport.get()));
   gscoped_ptr<ConsensusServiceProxy> new_proxy;
   RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger_, *hostport, &new_proxy));
-  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy)));
+  shared_ptr<MultiRaftBatcher> batcher;
+  if (multi_raft_manager_) {
+    RETURN_NOT_OK(multi_raft_manager_->GetBatcher(*hostport, &batcher));
+  }
+  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy), std::move(batcher)));
   return Status::OK();
 }
 
@@ -20,6 +20,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -34,8 +35,10 @@
 #include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 
 namespace kudu {
 class ThreadPoolToken;
@@ -46,8 +49,11 @@ class PeriodicTimer;
 }
 
 namespace consensus {
+class MultiRaftBatcher;
+class MultiRaftManager;
 class PeerMessageQueue;
 class PeerProxy;
+class StateMachineSnapshotReader;
 
 // A remote peer in consensus.
 //
@@ -55,6 +61,8 @@ class PeerProxy;
 // may have at most one outstanding request at a time. If a
 // request is signaled when there is already one outstanding,
 // the request will be generated once the outstanding one finishes.
+// The exception are requests carrying ops, which may be pipelined up
+// to --consensus_max_inflight_requests_per_peer deep.
 //
 // Peers are owned by the consensus implementation and do not keep
 // state aside from the most recent request and response.
@@ -78,6 +86,18 @@ class Peer : public std::enable_shared_from_this<Peer> {
   // status-only requests.
   Status SignalRequest(bool even_if_queue_empty = false);
 
+  // Signals that this peer should be sent a request as soon as possible, even
+  // if the queue is empty. Unlike SignalRequest(true), if requests are already
+  // in flight the new one is sent once they are all done, rather than dropped.
+  Status SignalHeartbeat();
+
+  // Sets the proxy to the relay through which the queue may route requests to
+  // this peer, as per the 'relay_uuid' attribute of the peer.
+  void SetRelayProxy(gscoped_ptr<PeerProxy> relay_proxy);
+
+  // Whether SetRelayProxy() was called.
+  bool has_relay_proxy() const;
+
   // Synchronously starts a leader election on this peer.
   // This method is ad hoc, using this instance's PeerProxy to send the
   // StartElection request.
@@ -124,17 +144,59 @@ class Peer : public std::enable_shared_from_this<Peer> {
        gscoped_ptr<PeerProxy> proxy,
        std::shared_ptr<rpc::Messenger> messenger);
 
+  // An UpdateConsensus call to the peer, along with the state which must
+  // outlive it.
+  struct UpdateCall {
+    ConsensusRequestPB request;
+    ConsensusResponsePB response;
+    rpc::RpcController controller;
+
+    // The batch of ReplicateMsgs which are in-flight to the peer, if any. We may have
+    // loaded these messages from the LogCache, in which case we are potentially
+    // sharing the same batch as other peers. Since the PB request itself can't hold
+    // reference counts, this holds them.
+    ReplicateSpanPtr replicate_msg_refs;
+
+    // When the request was sent. A peer accepting it extends the leader's lease.
+    MonoTime send_time;
+
+    // When the response was received.
+    MonoTime response_time;
+  };
+
   void SendNextRequest(bool even_if_queue_empty);
 
+  // Send requests for the ops following the ones in flight, as long as the
+  // pipeline isn't full. 'l' must hold 'peer_lock_', and still does on return.
+  void SendPipelinedRequests(std::unique_lock<simple_spinlock>* l);
+
+  // Send 'call', whose request has been assembled. Releases 'l'.
+  void SendUpdate(UpdateCall* call, std::unique_lock<simple_spinlock>* l);
+
+  // Whether one more request can be pipelined behind the ones in flight.
+  bool CanPipelineUnlocked() const;
+
+  // Get an UpdateCall which is not in flight, or return one to the pool.
+  UpdateCall* AcquireCallUnlocked();
+  void ReleaseCallUnlocked(UpdateCall* call);
+
+  // Bookkeeping for 'call' being finished, successfully or not.
+  void FinishCallUnlocked(UpdateCall* call);
+
+  // If 'call' failed because the peer doesn't support a feature it required,
+  // stop using that feature with the peer.
+  void HandleUnsupportedFeaturesUnlocked(UpdateCall* call);
+
   // Signals that a response was received from the peer.
   //
   // This method is called from the reactor thread and calls
   // DoProcessResponse() on raft_pool_token_ to do any work that requires IO or
-  // lock-taking.
-  void ProcessResponse();
+  // lock-taking. 'rpc_status' is the status of the RPC which carried the
+  // request: its own, or that of the batch it was sent in.
+  void ProcessResponse(UpdateCall* call, const Status& rpc_status);
 
   // Run on 'raft_pool_token'. Does response handling that requires IO or may block.
-  void DoProcessResponse();
+  void DoProcessResponse(UpdateCall* call);
 
   // Fetch the desired tablet copy request from the queue and set up
   // tc_request_ appropriately.
@@ -146,8 +208,24 @@ class Peer : public std::enable_shared_from_this<Peer> {
   // Handle RPC callback from initiating tablet copy.
   void ProcessTabletCopyResponse();
 
-  // Signals there was an error sending the request to the peer.
-  void ProcessResponseError(const Status& status);
+  // Takes a snapshot of the state machine and starts sending it to the peer,
+  // which is too far behind to be caught up from the log. Must be called
+  // with 'request_pending_' set and 'peer_lock_' not held.
+  void SendSnapshot();
+
+  // Reads the next chunk of the snapshot into 'snapshot_request_' and sends it.
+  void SendSnapshotChunk();
+
+  // Handle RPC callback from sending a snapshot chunk. Does the work which
+  // may block on 'raft_pool_token_'.
+  void ProcessInstallSnapshotResponse();
+  void DoProcessInstallSnapshotResponse();
+
+  // Drops the snapshot being sent and clears 'request_pending_'.
+  void FinishSnapshot(const Status& status);
+
+  // Signals there was an error sending the request of 'call' to the peer.
+  void ProcessResponseError(UpdateCall* call, const Status& status);
 
   std::string LogPrefixUnlocked() const;
 
@@ -163,20 +241,25 @@ class Peer : public std::enable_shared_from_this<Peer> {
   PeerMessageQueue* queue_;
   uint64_t failed_attempts_;
 
-  // The latest consensus update request and response.
-  ConsensusRequestPB request_;
-  ConsensusResponsePB response_;
+  // All the UpdateConsensus calls ever made to the peer, which are reused, and
+  // the ones among them not in flight.
+  std::vector<std::unique_ptr<UpdateCall>> calls_;
+  std::vector<UpdateCall*> free_calls_;
+
+  // The committed index of the latest request assembled for the peer.
+  int64_t last_request_committed_index_;
 
   // The latest tablet copy request and response.
   StartTabletCopyRequestPB tc_request_;
   StartTabletCopyResponsePB tc_response_;
 
-  // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
-  // may have loaded these messages from the LogCache, in which case we are potentially
-  // sharing the same object as other peers. Since the PB request_ itself can't hold
-  // reference counts, this holds them.
-  std::vector<ReplicateRefPtr> replicate_msg_refs_;
+  // The snapshot being installed on the peer, if any, along with the latest
+  // chunk of it sent and the response to it.
+  std::unique_ptr<StateMachineSnapshotReader> snapshot_reader_;
+  InstallSnapshotRequestPB snapshot_request_;
+  InstallSnapshotResponsePB snapshot_response_;
 
+  // The controller of the latest tablet copy or snapshot call.
   rpc::RpcController controller_;
 
   std::shared_ptr<rpc::Messenger> messenger_;
@@ -186,14 +269,31 @@ class Peer : public std::enable_shared_from_this<Peer> {
   // RaftConsensus owns this shared token and is responsible for destroying it.
   ThreadPoolToken* raft_pool_token_;
 
+  // Keys of the SendNextRequest() tasks of the peer submitted to
+  // 'raft_pool_token_', indexed by their 'even_if_queue_empty' argument: the
+  // task is only queued once until it runs. Only the addresses matter.
+  char send_next_request_keys_[2];
+
   // Repeating timer responsible for scheduling heartbeats to this peer.
   std::shared_ptr<rpc::PeriodicTimer> heartbeater_;
 
   // Lock that protects Peer state changes, initialization, etc.
   mutable simple_spinlock peer_lock_;
   bool request_pending_ = false;
+  // The number of UpdateConsensus calls in flight, and the index of the last op
+  // sent by them, or -1 if no further ops may be pipelined behind them.
+  int num_updates_in_flight_ = 0;
+  int64_t pipelined_through_index_ = -1;
   bool closed_ = false;
   bool has_sent_first_request_ = false;
+  // Whether SignalHeartbeat() was called while requests were in flight.
+  bool heartbeat_requested_ = false;
+  // The proxy to the relay of this peer, if any.
+  std::unique_ptr<PeerProxy> relay_proxy_;
+  // Whether the peer supports ops sent in a sidecar, and compressed ops,
+  // until it rejects a request requiring either.
+  bool peer_supports_ops_sidecar_ = true;
+  bool peer_supports_compressed_ops_ = true;
 };
 
 // A proxy to another peer. Usually a thin wrapper around an rpc proxy but can
@@ -226,6 +326,41 @@ class PeerProxy {
     LOG(DFATAL) << "Not implemented";
   }
 
+  // Sends a chunk of a state machine snapshot to a peer.
+  virtual void InstallSnapshotAsync(const InstallSnapshotRequestPB* /*request*/,
+                                    InstallSnapshotResponsePB* /*response*/,
+                                    rpc::RpcController* /*controller*/,
+                                    const rpc::ResponseCallback& /*callback*/) {
+    LOG(DFATAL) << "Not implemented";
+  }
+
+  // Asks the leader for its read index. Unlike the other requests, the caller
+  // sets the deadline of 'controller'.
+  virtual void ReadIndexAsync(const ReadIndexRequestPB* /*request*/,
+                              ReadIndexResponsePB* /*response*/,
+                              rpc::RpcController* /*controller*/,
+                              const rpc::ResponseCallback& /*callback*/) {
+    LOG(DFATAL) << "Not implemented";
+  }
+
+  // Whether UpdateAsync() delivers RPC sidecars attached to 'controller'
+  // to the remote peer. Only proxies that return true may be sent requests
+  // whose ops are carried in a sidecar (see ConsensusRequestPB::ops_sidecar_idx).
+  virtual bool SupportsOpsSidecar() const { return false; }
+
+  // Whether UpdateBatchedAsync() may be used to send requests to the peer.
+  virtual bool SupportsBatchedUpdates() const { return false; }
+
+  // Sends an UpdateConsensus request to the peer in a batch with those of
+  // other tablets to the same server. 'callback' is called with the status
+  // of the batch RPC once 'response' is filled in. The request must not
+  // carry sidecars.
+  virtual void UpdateBatchedAsync(const ConsensusRequestPB* /*request*/,
+                                  ConsensusResponsePB* /*response*/,
+                                  StdStatusCallback /*callback*/) {
+    LOG(DFATAL) << "Not implemented";
+  }
+
   // Remote endpoint or description of the peer.
   virtual std::string PeerName() const = 0;
 };
@@ -246,8 +381,11 @@ class PeerProxyFactory {
 // PeerProxy implementation that does RPC calls
 class RpcPeerProxy : public PeerProxy {
  public:
+  // 'batcher' batches requests to the peer's server, or is NULL if
+  // requests are never batched.
   RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-               gscoped_ptr<ConsensusServiceProxy> consensus_proxy);
+               gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+               std::shared_ptr<MultiRaftBatcher> batcher);
 
   void UpdateAsync(const ConsensusRequestPB* request,
                    ConsensusResponsePB* response,
@@ -259,6 +397,14 @@ class RpcPeerProxy : public PeerProxy {
                                  rpc::RpcController* controller,
                                  const rpc::ResponseCallback& callback) override;
 
+  bool SupportsOpsSidecar() const override { return true; }
+
+  bool SupportsBatchedUpdates() const override;
+
+  void UpdateBatchedAsync(const ConsensusRequestPB* request,
+                          ConsensusResponsePB* response,
+                          StdStatusCallback callback) override;
+
   Status StartElection(const RunLeaderElectionRequestPB* request,
                        RunLeaderElectionResponsePB* response,
                        rpc::RpcController* controller) override;
@@ -268,17 +414,31 @@ class RpcPeerProxy : public PeerProxy {
                             rpc::RpcController* controller,
                             const rpc::ResponseCallback& callback) override;
 
+  void InstallSnapshotAsync(const InstallSnapshotRequestPB* request,
+                            InstallSnapshotResponsePB* response,
+                            rpc::RpcController* controller,
+                            const rpc::ResponseCallback& callback) override;
+
+  void ReadIndexAsync(const ReadIndexRequestPB* request,
+                      ReadIndexResponsePB* response,
+                      rpc::RpcController* controller,
+                      const rpc::ResponseCallback& callback) override;
+
   std::string PeerName() const override;
 
  private:
   gscoped_ptr<HostPort> hostport_;
   gscoped_ptr<ConsensusServiceProxy> consensus_proxy_;
+  std::shared_ptr<MultiRaftBatcher> batcher_;
 };
 
 // PeerProxyFactory implementation that generates RPCPeerProxies
 class RpcPeerProxyFactory : public PeerProxyFactory {
  public:
-  explicit RpcPeerProxyFactory(std::shared_ptr<rpc::Messenger> messenger);
+  // 'multi_raft_manager' provides the batchers for the proxies, or is NULL
+  // if requests are never batched.
+  RpcPeerProxyFactory(std::shared_ptr<rpc::Messenger> messenger,
+                      std::shared_ptr<MultiRaftManager> multi_raft_manager);
 
   Status NewProxy(const RaftPeerPB& peer_pb,
                   gscoped_ptr<PeerProxy>* proxy) override;
@@ -291,8 +451,14 @@ class RpcPeerProxyFactory : public PeerProxyFactory {
 
  private:
   std::shared_ptr<rpc::Messenger> messenger_;
+  std::shared_ptr<MultiRaftManager> multi_raft_manager_;
 };
 
+// Create a proxy for the consensus service of the server at 'hostport'.
+Status CreateConsensusServiceProxyForHost(const std::shared_ptr<rpc::Messenger>& messenger,
+                                          const HostPort& hostport,
+                                          gscoped_ptr<ConsensusServiceProxy>* new_proxy);
+
 // Query the consensus service at last known host/port that is
 // specified in 'remote_peer' and set the 'permanent_uuid' field based
 // on the response.
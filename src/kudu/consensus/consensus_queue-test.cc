@@ -15,10 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <gflags/gflags.h>
@@ -43,25 +46,43 @@
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/ops_sidecar.h"
 #include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/consensus/state_machine_snapshot.h"
 #include "kudu/consensus/time_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/async_util.h"
+#include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/threadpool.h"
 
+DECLARE_bool(consensus_adaptive_batch_sizing);
+DECLARE_bool(consensus_async_catchup_reads);
+DECLARE_int32(consensus_adaptive_batch_max_bytes);
+DECLARE_int32(consensus_adaptive_batch_min_bytes);
 DECLARE_int32(consensus_max_batch_size_bytes);
 DECLARE_int32(follower_unavailable_considered_failed_sec);
+DECLARE_bool(raft_commit_quorum_requires_remote_region);
+DECLARE_bool(raft_enable_quiescence);
+DECLARE_bool(raft_enable_relay_replication);
+DECLARE_int32(raft_op_latency_sample_interval);
+DECLARE_string(consensus_ops_compression_codec);
 
 using kudu::consensus::HealthReportPB;
+using std::shared_ptr;
 using std::vector;
 
 namespace kudu {
@@ -150,7 +171,7 @@ class ConsensusQueueTest : public KuduTest {
 
     // Ask for a request. The queue assumes the peer is up-to-date so
     // this should contain no operations.
-    vector<ReplicateRefPtr> refs;
+    ReplicateSpanPtr refs;
     bool needs_tablet_copy;
     ASSERT_OK(queue_->RequestForPeer(kPeerUuid, request, &refs, &needs_tablet_copy));
     ASSERT_FALSE(needs_tablet_copy);
@@ -256,7 +277,7 @@ TEST_F(ConsensusQueueTest, TestStartTrackingAfterStart) {
   ASSERT_TRUE(send_more_immediately);
 
   // Getting a new request should get all operations after 7.50
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
   bool needs_tablet_copy;
   ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
   ASSERT_FALSE(needs_tablet_copy);
@@ -321,7 +342,7 @@ TEST_F(ConsensusQueueTest, TestGetPagedMessages) {
   OpId last;
   for (int i = 0; i < 11; i++) {
     VLOG(1) << "Making request " << i;
-    vector<ReplicateRefPtr> refs;
+    ReplicateSpanPtr refs;
     bool needs_tablet_copy;
     ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
     ASSERT_FALSE(needs_tablet_copy);
@@ -332,7 +353,7 @@ TEST_F(ConsensusQueueTest, TestGetPagedMessages) {
     send_more_immediately = queue_->ResponseFromPeer(response.responder_uuid(), response);
     ASSERT_TRUE(send_more_immediately);
   }
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
   bool needs_tablet_copy;
   ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
   ASSERT_FALSE(needs_tablet_copy);
@@ -374,7 +395,7 @@ TEST_F(ConsensusQueueTest, TestPeersDontAckBeyondWatermarks) {
   ASSERT_EQ(queue_->GetAllReplicatedIndex(), 0);
   ASSERT_EQ(queue_->GetMajorityReplicatedIndexForTests(), 0);
 
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
   bool needs_tablet_copy;
   ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
   ASSERT_FALSE(needs_tablet_copy);
@@ -488,6 +509,41 @@ TEST_F(ConsensusQueueTest, TestQueueAdvancesCommittedIndex) {
   ASSERT_EQ(queue_->GetAllReplicatedIndex(), 5);
 }
 
+// Ensure that with --raft_commit_quorum_requires_remote_region, ops are only
+// majority-replicated once a voter outside the leader's region has them.
+TEST_F(ConsensusQueueTest, TestCommitRequiresRemoteRegion) {
+  FLAGS_raft_commit_quorum_requires_remote_region = true;
+  RaftConfigPB config = BuildRaftConfigPBForTests(3);
+  config.mutable_peers(0)->mutable_attrs()->set_region("east");
+  config.mutable_peers(1)->mutable_attrs()->set_region("east");
+  config.mutable_peers(2)->mutable_attrs()->set_region("west");
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, config);
+  queue_->TrackPeer(MakePeer("peer-1", RaftPeerPB::VOTER));
+  queue_->TrackPeer(MakePeer("peer-2", RaftPeerPB::VOTER));
+
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 10);
+  WaitForLocalPeerToAckIndex(10);
+
+  // A majority in the leader's region is not enough.
+  ConsensusResponsePB response;
+  response.set_responder_term(1);
+  response.set_responder_uuid("peer-1");
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(1, 10), MinimumOpId().index());
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(0, queue_->GetMajorityReplicatedIndexForTests());
+  ASSERT_EQ(0, queue_->GetCommittedIndex());
+
+  // Once the remote voter has acked, the ops commit.
+  response.set_responder_uuid("peer-2");
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(0, 5), MinimumOpId().index());
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(5, queue_->GetMajorityReplicatedIndexForTests());
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(1, 10), MinimumOpId().index());
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(10, queue_->GetMajorityReplicatedIndexForTests());
+  ASSERT_EQ(10, queue_->GetCommittedIndex());
+}
+
 // Ensure that the acks for a non-voter don't count toward the majority.
 TEST_F(ConsensusQueueTest, TestNonVoterAcksDontCountTowardMajority) {
   const auto kOtherVoterPeer = "peer-1";
@@ -549,6 +605,46 @@ TEST_F(ConsensusQueueTest, TestNonVoterAcksDontCountTowardMajority) {
   ASSERT_FALSE(send_more_immediately);
 }
 
+// Test that the leader throttles writes while a NON_VOTER marked for promotion
+// is close to catching up, and stops once it caught up.
+TEST_F(ConsensusQueueTest, TestThrottleWritesForPromotion) {
+  const auto kOtherVoterPeer = "peer-1";
+  const auto kNonVoterPeer = "non-voter-peer-0";
+  RaftConfigPB config = BuildRaftConfigPBForTests(/*num_voters=*/ 2, /*num_non_voters=*/ 1);
+  config.mutable_peers(2)->mutable_attrs()->set_promote(true);
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, config);
+  queue_->TrackPeer(MakePeer(kOtherVoterPeer, RaftPeerPB::VOTER));
+  queue_->TrackPeer(MakePeer(kNonVoterPeer, RaftPeerPB::NON_VOTER));
+
+  // This adds messages 0.1 -> 0.6, ..., 14.98 -> 14.100 to the queue.
+  const int kNumMessages = 100;
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, /*first=*/ 1, /*count=*/ kNumMessages);
+  WaitForLocalPeerToAckIndex(kNumMessages);
+
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kOtherVoterPeer);
+  response.set_responder_term(1);
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(14, kNumMessages), 0);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(kNumMessages, queue_->GetCommittedIndex());
+  ASSERT_FALSE(queue_->GetAdmissionThrottleDelay().Initialized());
+
+  // The NON_VOTER is within --raft_promotion_throttle_max_lag_ops of the
+  // committed index, and hasn't been seen catching up yet.
+  response.set_responder_uuid(kNonVoterPeer);
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(1, 10), 0);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(2, 20), 0);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_TRUE(queue_->GetAdmissionThrottleDelay().Initialized());
+  ASSERT_EQ(0, queue_->metrics().non_voter_time_to_promote->TotalCount());
+
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(14, kNumMessages), 0);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_FALSE(queue_->GetAdmissionThrottleDelay().Initialized());
+  ASSERT_EQ(1, queue_->metrics().non_voter_time_to_promote->TotalCount());
+}
+
 // In this test we append a sequence of operations to a log
 // and then start tracking a peer whose first required operation
 // is before the first operation in the queue.
@@ -601,7 +697,7 @@ TEST_F(ConsensusQueueTest, TestQueueLoadsOperationsForPeer) {
 
   // When we get another request for the peer the queue should load
   // the missing operations.
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
   bool needs_tablet_copy;
   ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
   ASSERT_FALSE(needs_tablet_copy);
@@ -611,6 +707,57 @@ TEST_F(ConsensusQueueTest, TestQueueLoadsOperationsForPeer) {
   request.mutable_ops()->ExtractSubrange(0, request.ops().size(), nullptr);
 }
 
+// Tests that with asynchronous catch-up reads, ops which aren't in the log cache
+// are read from disk off the request path, with heartbeats sent in the meantime.
+TEST_F(ConsensusQueueTest, TestAsyncCatchupReads) {
+  FLAGS_consensus_async_catchup_reads = true;
+
+  OpId opid = MakeOpId(1, 1);
+  const int kOpsToAppend = 100;
+  for (int i = 1; i <= kOpsToAppend; i++) {
+    ASSERT_OK(log::AppendNoOpToLogSync(clock_, log_.get(), &opid));
+  }
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+  OpId last_logged_opid = MakeOpId(opid.term(), opid.index() - 1);
+
+  CloseAndReopenQueue(last_logged_opid, last_logged_opid);
+  queue_->SetLeaderMode(last_logged_opid.index(),
+                        last_logged_opid.term(),
+                        BuildRaftConfigPBForTests(3));
+
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool send_more_immediately = false;
+  ASSERT_NO_FATAL_FAILURE(UpdatePeerWatermarkToOp(&request,
+                                                  &response,
+                                                  MakeOpId(1, 50),
+                                                  MinimumOpId(),
+                                                  &send_more_immediately));
+  ASSERT_TRUE(send_more_immediately);
+
+  CountDownLatch read_done(1);
+  queue_->SetCatchupReadCallback(kPeerUuid, [&]() { read_done.CountDown(); });
+
+  // The first request only starts the read, so it's a heartbeat which
+  // still points at the peer's last op.
+  ReplicateSpanPtr refs;
+  bool needs_tablet_copy;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_FALSE(needs_tablet_copy);
+  ASSERT_EQ(0, request.ops_size());
+  ASSERT_OPID_EQ(MakeOpId(1, 50), request.preceding_id());
+
+  // Once the read completes, the next request carries the ops.
+  read_done.Wait();
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(50, request.ops_size());
+  ASSERT_OPID_EQ(MakeOpId(1, 50), request.preceding_id());
+
+  // The messages still belong to the queue so we have to release them.
+  request.mutable_ops()->ExtractSubrange(0, request.ops().size(), nullptr);
+}
+
 // This tests that the queue is able to handle operation overwriting, i.e. when a
 // newly tracked peer reports the last received operations as some operation that
 // doesn't exist in the leader's log. In particular it tests the case where a
@@ -654,7 +801,7 @@ TEST_F(ConsensusQueueTest, TestQueueHandlesOperationOverwriting) {
   // and send it operations starting at the old leader's committed index.
   ConsensusRequestPB request;
   ConsensusResponsePB response;
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
   response.set_responder_uuid(kPeerUuid);
   bool send_more_immediately = false;
 
@@ -796,7 +943,7 @@ TEST_F(ConsensusQueueTest, TestOnlyAdvancesWatermarkWhenPeerHasAPrefixOfOurLog)
 
   ConsensusRequestPB request;
   ConsensusResponsePB response;
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
 
   bool send_more_immediately;
   // We expect the majority replicated watermark to start at the committed index.
@@ -895,7 +1042,7 @@ TEST_F(ConsensusQueueTest, TestTriggerTabletCopyIfTabletNotFound) {
   queue_->TrackPeer(MakePeer(kPeerUuid, RaftPeerPB::VOTER));
 
   // Create request for new peer.
-  vector<ReplicateRefPtr> refs;
+  ReplicateSpanPtr refs;
   bool needs_tablet_copy;
   ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
   ASSERT_FALSE(needs_tablet_copy);
@@ -947,6 +1094,431 @@ TEST_F(ConsensusQueueTest, TestFollowerCommittedIndexAndMetrics) {
   ASSERT_EQ(5, queue_->metrics_.num_ops_behind_leader->value());
 }
 
+// Tests that the batch size of a peer grows while it acknowledges full batches
+// promptly, and is cut when a round trip takes much longer than before.
+TEST_F(ConsensusQueueTest, TestAdaptiveBatchSizing) {
+  FLAGS_consensus_adaptive_batch_sizing = true;
+  FLAGS_consensus_max_batch_size_bytes = 16 * 1024;
+  FLAGS_consensus_adaptive_batch_min_bytes = 8 * 1024;
+  FLAGS_consensus_adaptive_batch_max_bytes = 256 * 1024;
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool send_more_immediately = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(),
+                          &send_more_immediately);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 2000, 1024);
+
+  auto exchange = [&](MonoDelta delay) {
+    ReplicateSpanPtr refs;
+    bool needs_tablet_copy;
+    ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+    ASSERT_GT(request.ops_size(), 0);
+    SleepFor(delay);
+    SetLastReceivedAndLastCommitted(&response, request.ops(request.ops_size() - 1).id());
+    queue_->ResponseFromPeer(response.responder_uuid(), response);
+  };
+
+  const int64_t initial_size = queue_->GetTrackedPeerForTests(kPeerUuid).batch_size_bytes;
+  ASSERT_EQ(FLAGS_consensus_max_batch_size_bytes, initial_size);
+  for (int i = 0; i < 10; i++) {
+    NO_FATALS(exchange(MonoDelta::FromMilliseconds(0)));
+  }
+  PeerMessageQueue::TrackedPeer peer = queue_->GetTrackedPeerForTests(kPeerUuid);
+  ASSERT_GT(peer.batch_size_bytes, initial_size);
+  ASSERT_LE(peer.batch_size_bytes, FLAGS_consensus_adaptive_batch_max_bytes);
+  ASSERT_GT(peer.estimated_bandwidth, 0);
+  ASSERT_EQ(peer.batch_size_bytes, queue_->metrics_.min_peer_batch_size->value());
+
+  // A round trip much slower than the previous ones halves the batch size.
+  const int64_t grown_size = peer.batch_size_bytes;
+  NO_FATALS(exchange(MonoDelta::FromMilliseconds(100)));
+  ASSERT_EQ(std::max<int64_t>(FLAGS_consensus_adaptive_batch_min_bytes, grown_size / 2),
+            queue_->GetTrackedPeerForTests(kPeerUuid).batch_size_bytes);
+
+  // Extract the ops from the request to avoid a double free.
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+}
+
+// Tests that a batch of ops is serialized once for all the peers it is sent
+// to, and that the sidecar decodes back into the original ops.
+TEST_F(ConsensusQueueTest, TestSerializedOpsAreShared) {
+  vector<ReplicateRefPtr> msgs;
+  for (int i = 1; i <= 5; i++) {
+    msgs.push_back(make_scoped_refptr_replicate(
+        CreateDummyReplicate(1, i, clock_->Now(), 10).release()));
+  }
+  CompressionType compression;
+  shared_ptr<const faststring> buf = queue_->GetSerializedOps("peer", msgs, true, &compression);
+  ASSERT_EQ(NO_COMPRESSION, compression);
+  ASSERT_EQ(buf.get(), queue_->GetSerializedOps("peer", msgs, true, &compression).get());
+
+  // A different batch gets its own buffer.
+  vector<ReplicateRefPtr> tail(msgs.begin() + 1, msgs.end());
+  ASSERT_NE(buf.get(), queue_->GetSerializedOps("peer", tail, true, &compression).get());
+
+  ConsensusRequestPB req;
+  ASSERT_OK(DecodeOpsFromSidecar(Slice(*buf), NO_COMPRESSION, &req));
+  ASSERT_EQ(msgs.size(), static_cast<size_t>(req.ops_size()));
+  for (int i = 0; i < req.ops_size(); i++) {
+    ASSERT_OPID_EQ(msgs[i]->get()->id(), req.ops(i).id());
+  }
+
+  // Truncated data is rejected.
+  req.Clear();
+  Status s = DecodeOpsFromSidecar(Slice(buf->data(), buf->size() - 1), NO_COMPRESSION, &req);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
+// Tests that with --consensus_ops_compression_codec the ops are compressed for
+// the peers which allow it, and decompress back into the original ops.
+TEST_F(ConsensusQueueTest, TestCompressedSerializedOps) {
+  FLAGS_consensus_ops_compression_codec = "lz4";
+  CloseAndReopenQueue(MinimumOpId(), MinimumOpId());
+
+  vector<ReplicateRefPtr> msgs;
+  for (int i = 1; i <= 5; i++) {
+    msgs.push_back(make_scoped_refptr_replicate(
+        CreateDummyReplicate(1, i, clock_->Now(), 1000).release()));
+  }
+  CompressionType compression;
+  shared_ptr<const faststring> plain = queue_->GetSerializedOps("peer-1", msgs, false,
+                                                                &compression);
+  ASSERT_EQ(NO_COMPRESSION, compression);
+  shared_ptr<const faststring> compressed = queue_->GetSerializedOps("peer-2", msgs, true,
+                                                                     &compression);
+  ASSERT_EQ(LZ4, compression);
+  ASSERT_LT(compressed->size(), plain->size());
+  CompressionType compression2;
+  ASSERT_EQ(compressed.get(),
+            queue_->GetSerializedOps("peer-3", msgs, true, &compression2).get());
+  ASSERT_EQ(LZ4, compression2);
+
+  ConsensusRequestPB req;
+  ASSERT_OK(DecodeOpsFromSidecar(Slice(*compressed), LZ4, &req));
+  ASSERT_EQ(msgs.size(), static_cast<size_t>(req.ops_size()));
+  for (int i = 0; i < req.ops_size(); i++) {
+    ASSERT_OPID_EQ(msgs[i]->get()->id(), req.ops(i).id());
+    ASSERT_EQ(1000, req.ops(i).noop_request().payload_for_tests().size());
+  }
+
+  // Truncated compressed data is rejected.
+  req.Clear();
+  Status s = DecodeOpsFromSidecar(Slice(compressed->data(), compressed->size() - 1), LZ4, &req);
+  ASSERT_FALSE(s.ok());
+}
+
+// Tests that with --raft_enable_quiescence the heartbeats to a peer are marked
+// quiescent once the peer has received and committed all the ops, and stop
+// being so as soon as there are new ops.
+TEST_F(ConsensusQueueTest, TestQuiescence) {
+  FLAGS_raft_enable_quiescence = true;
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool send_more_immediately = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(),
+                          &send_more_immediately);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 5);
+  WaitForLocalPeerToAckIndex(5);
+
+  ReplicateSpanPtr refs;
+  bool needs_tablet_copy;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(5, request.ops_size());
+  ASSERT_FALSE(request.quiescent());
+  const OpId last_op = request.ops(4).id();
+
+  // The peer's ack commits the ops, but the peer doesn't know that yet.
+  SetLastReceivedAndLastCommitted(&response, last_op, MinimumOpId().index());
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(5, queue_->GetCommittedIndex());
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(0, request.ops_size());
+  ASSERT_FALSE(request.quiescent());
+  ASSERT_FALSE(queue_->IsQuiescent());
+
+  // Once the peer has learned about the commit the tablet is idle.
+  SetLastReceivedAndLastCommitted(&response, last_op);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(0, request.ops_size());
+  ASSERT_TRUE(request.quiescent());
+  ASSERT_TRUE(queue_->IsQuiescent());
+
+  // A new op ends the quiescence.
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 6, 1);
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(1, request.ops_size());
+  ASSERT_FALSE(request.quiescent());
+  ASSERT_FALSE(queue_->IsQuiescent());
+
+  // Extract the ops from the request to avoid a double free.
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+}
+
+// Tests that the stages of the replication of the sampled ops are timed.
+TEST_F(ConsensusQueueTest, TestSampledOpLatencies) {
+  FLAGS_raft_op_latency_sample_interval = 2;
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool send_more_immediately = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(),
+                          &send_more_immediately);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 5);
+  WaitForLocalPeerToAckIndex(5);
+
+  // Ops 2 and 4 are sampled. They are durable locally, but a majority needs
+  // the peer too.
+  const auto& metrics = queue_->metrics();
+  ASSERT_EQ(2, metrics.op_local_append_latency->TotalCount());
+  ASSERT_EQ(0, metrics.op_majority_replicated_latency->TotalCount());
+  ASSERT_EQ(0, metrics.op_commit_latency->TotalCount());
+
+  ReplicateSpanPtr refs;
+  bool needs_tablet_copy;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(5, request.ops_size());
+  SetLastReceivedAndLastCommitted(&response, request.ops(2).id(), MinimumOpId().index());
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(1, metrics.op_majority_replicated_latency->TotalCount());
+  ASSERT_EQ(1, metrics.op_commit_latency->TotalCount());
+
+  SetLastReceivedAndLastCommitted(&response, request.ops(4).id(), MinimumOpId().index());
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(2, metrics.op_majority_replicated_latency->TotalCount());
+  ASSERT_EQ(2, metrics.op_commit_latency->TotalCount());
+  ASSERT_EQ(2, metrics.op_local_append_latency->TotalCount());
+
+  // Extract the ops from the request to avoid a double free.
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+}
+
+// Tests that the requests to a peer with a relay are routed through it, with
+// only the id of the last op the relay already received.
+TEST_F(ConsensusQueueTest, TestRelayedRequests) {
+  FLAGS_raft_enable_relay_replication = true;
+  const string kRelayedUuid = "peer-2";
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(3));
+
+  // Make the queue aware of the relay and of the relayed peer.
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  bool send_more_immediately = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(),
+                          &send_more_immediately);
+  SetLastReceivedAndLastCommitted(&response, MinimumOpId(), MinimumOpId().index());
+  queue_->ResponseFromPeer(kPeerUuid, response);
+  RaftPeerPB relayed_pb = MakePeer(kRelayedUuid, RaftPeerPB::VOTER);
+  relayed_pb.mutable_attrs()->set_relay_uuid(kPeerUuid);
+  queue_->TrackPeer(relayed_pb);
+  ReplicateSpanPtr refs;
+  bool needs_tablet_copy;
+  ConsensusRequestPB relayed_request;
+  ASSERT_OK(queue_->RequestForPeer(kRelayedUuid, &relayed_request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(kRelayedUuid, relayed_request.proxy_dest_uuid());
+  ConsensusResponsePB relayed_response;
+  relayed_response.set_responder_uuid(kRelayedUuid);
+  SetLastReceivedAndLastCommitted(&relayed_response, MinimumOpId(), MinimumOpId().index());
+  queue_->ResponseFromPeer(kRelayedUuid, relayed_response);
+
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 5);
+  WaitForLocalPeerToAckIndex(5);
+
+  // The relay only received the first three ops.
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(5, request.ops_size());
+  ASSERT_FALSE(request.has_proxy_dest_uuid());
+  SetLastReceivedAndLastCommitted(&response, request.ops(2).id(), MinimumOpId().index());
+  queue_->ResponseFromPeer(kPeerUuid, response);
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+
+  ASSERT_OK(queue_->RequestForPeer(kRelayedUuid, &relayed_request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(0, relayed_request.ops_size());
+  ASSERT_FALSE(refs);
+  ASSERT_EQ(kRelayedUuid, relayed_request.proxy_dest_uuid());
+  ASSERT_OPID_EQ(MinimumOpId(), relayed_request.preceding_id());
+  ASSERT_EQ(3, relayed_request.relayed_last_op_id().index());
+
+  // Without relaying, the peer is sent the ops directly.
+  FLAGS_raft_enable_relay_replication = false;
+  ASSERT_OK(queue_->RequestForPeer(kRelayedUuid, &relayed_request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(5, relayed_request.ops_size());
+  ASSERT_FALSE(relayed_request.has_proxy_dest_uuid());
+  ASSERT_FALSE(relayed_request.has_relayed_last_op_id());
+  relayed_request.mutable_ops()->ExtractSubrange(0, relayed_request.ops_size(), nullptr);
+}
+
+// Tests that ops a peer acknowledged before they were durable only count
+// toward the committed index once the peer reports them durable.
+TEST_F(ConsensusQueueTest, TestEarlyAcksWaitForDurability) {
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool send_more_immediately = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(),
+                          &send_more_immediately);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 5);
+  WaitForLocalPeerToAckIndex(5);
+
+  ReplicateSpanPtr refs;
+  bool needs_tablet_copy;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_EQ(5, request.ops_size());
+  ASSERT_TRUE(request.leader_tracks_durable_idx());
+  const OpId last_op = request.ops(4).id();
+
+  // The peer received all the ops, but only the first two are durable.
+  SetLastReceivedAndLastCommitted(&response, last_op, MinimumOpId().index());
+  response.mutable_status()->set_last_durable_idx(2);
+  send_more_immediately = queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_TRUE(send_more_immediately);
+  ASSERT_EQ(2, queue_->GetCommittedIndex());
+  ASSERT_EQ(6, queue_->GetTrackedPeerForTests(kPeerUuid).next_index);
+
+  // Once the peer reports them all durable they're committed.
+  response.mutable_status()->set_last_durable_idx(5);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(5, queue_->GetCommittedIndex());
+
+  // A durable index beyond the ops the peer shares with the leader doesn't count.
+  response.mutable_status()->set_last_durable_idx(10);
+  queue_->ResponseFromPeer(response.responder_uuid(), response);
+  ASSERT_EQ(5, queue_->GetTrackedPeerForTests(kPeerUuid).last_durable_index);
+
+  // Extract the ops from the request to avoid a double free.
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+}
+
+namespace {
+
+// A snapshot of nothing, as of 'last_included'.
+class FakeSnapshotReader : public StateMachineSnapshotReader {
+ public:
+  explicit FakeSnapshotReader(OpId last_included)
+      : last_included_(std::move(last_included)) {
+  }
+  const OpId& last_included_op_id() const override { return last_included_; }
+  Status Read(int64_t /*max_size*/, std::string* data, bool* done) override {
+    data->clear();
+    *done = true;
+    return Status::OK();
+  }
+ private:
+  const OpId last_included_;
+};
+
+class FakeSnapshotter : public StateMachineSnapshotter {
+ public:
+  explicit FakeSnapshotter(OpId last_included)
+      : last_included_(std::move(last_included)) {
+  }
+  Status TakeSnapshot(std::unique_ptr<StateMachineSnapshotReader>* reader) override {
+    reader->reset(new FakeSnapshotReader(last_included_));
+    return Status::OK();
+  }
+  Status InstallSnapshot(const OpId& /*last_included_op_id*/,
+                         std::unique_ptr<StateMachineSnapshotWriter>* /*writer*/) override {
+    return Status::NotSupported("leader only");
+  }
+ private:
+  const OpId last_included_;
+};
+
+} // anonymous namespace
+
+// Tests that once a peer installed a snapshot, it's sent the ops which follow it.
+TEST_F(ConsensusQueueTest, TestPeerCaughtUpFromSnapshot) {
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool send_more_immediately = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(),
+                          &send_more_immediately);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 10);
+  WaitForLocalPeerToAckIndex(10);
+
+  // Without a snapshotter, the peer may only be caught up from the log.
+  ASSERT_FALSE(queue_->PeerNeedsSnapshot(kPeerUuid));
+  std::unique_ptr<StateMachineSnapshotReader> reader;
+  InstallSnapshotRequestPB snapshot_request;
+  ASSERT_TRUE(queue_->StartSnapshotForPeer(kPeerUuid, &reader, &snapshot_request)
+              .IsNotSupported());
+
+  const OpId last_included = MakeOpId(0, 5);
+  FakeSnapshotter snapshotter(last_included);
+  queue_->SetSnapshotter(&snapshotter);
+  ASSERT_FALSE(queue_->PeerNeedsSnapshot(kPeerUuid));
+  ASSERT_OK(queue_->StartSnapshotForPeer(kPeerUuid, &reader, &snapshot_request));
+  ASSERT_EQ(kPeerUuid, snapshot_request.dest_uuid());
+  ASSERT_EQ(0, snapshot_request.offset());
+  ASSERT_OPID_EQ(last_included, snapshot_request.last_included_op_id());
+
+  // Until the peer is done installing the snapshot, nothing changes.
+  InstallSnapshotResponsePB snapshot_response;
+  snapshot_response.set_responder_uuid(kPeerUuid);
+  queue_->SnapshotResponseFromPeer(kPeerUuid, last_included, snapshot_response);
+  ASSERT_EQ(1, queue_->GetTrackedPeerForTests(kPeerUuid).next_index);
+
+  snapshot_response.set_done(true);
+  queue_->SnapshotResponseFromPeer(kPeerUuid, last_included, snapshot_response);
+  ASSERT_EQ(6, queue_->GetTrackedPeerForTests(kPeerUuid).next_index);
+
+  ReplicateSpanPtr refs;
+  bool needs_tablet_copy;
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &request, &refs, &needs_tablet_copy));
+  ASSERT_FALSE(needs_tablet_copy);
+  ASSERT_OPID_EQ(last_included, request.preceding_id());
+  ASSERT_EQ(5, request.ops_size());
+  ASSERT_EQ(6, request.ops(0).id().index());
+
+  // Extract the ops from the request to avoid a double free.
+  request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
+  queue_->SetSnapshotter(nullptr);
+}
+
+// Tests that the lease request time is the latest time by which a majority of
+// the voters accepted a request from the leader.
+TEST_F(ConsensusQueueTest, TestMajorityLeaseRequestTime) {
+  ASSERT_FALSE(queue_->GetMajorityLeaseRequestTime().Initialized());
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(5));
+  queue_->TrackPeer(MakePeer("peer-1", RaftPeerPB::VOTER));
+  queue_->TrackPeer(MakePeer("peer-2", RaftPeerPB::VOTER));
+  queue_->TrackPeer(MakePeer("peer-3", RaftPeerPB::VOTER));
+  queue_->TrackPeer(MakePeer("peer-4", RaftPeerPB::VOTER));
+  queue_->TrackPeer(MakePeer("learner", RaftPeerPB::NON_VOTER));
+
+  // The local peer and two others make a majority.
+  const MonoTime t0 = MonoTime::Now();
+  const MonoTime t1 = t0 + MonoDelta::FromMilliseconds(1);
+  const MonoTime t2 = t0 + MonoDelta::FromMilliseconds(2);
+  queue_->UpdatePeerLeaseRequestTime("peer-1", t2);
+  queue_->UpdatePeerLeaseRequestTime("learner", t2);
+  ASSERT_FALSE(queue_->GetMajorityLeaseRequestTime().Initialized());
+  queue_->UpdatePeerLeaseRequestTime("peer-2", t0);
+  ASSERT_EQ(t0, queue_->GetMajorityLeaseRequestTime());
+  queue_->UpdatePeerLeaseRequestTime("peer-3", t1);
+  ASSERT_EQ(t1, queue_->GetMajorityLeaseRequestTime());
+
+  // Out-of-order acknowledgments don't move the lease back.
+  queue_->UpdatePeerLeaseRequestTime("peer-3", t0);
+  ASSERT_EQ(t1, queue_->GetMajorityLeaseRequestTime());
+
+  // Stepping down drops the lease.
+  queue_->SetNonLeaderMode(BuildRaftConfigPBForTests(5));
+  ASSERT_FALSE(queue_->GetMajorityLeaseRequestTime().Initialized());
+}
+
 // Unit test for the PeerMessageQueue::PeerHealthStatus() method.
 TEST(ConsensusQueueUnitTest, PeerHealthStatus) {
   static constexpr PeerStatus kPeerStatusesForUnknown[] = {
@@ -1008,5 +1580,35 @@ TEST(ConsensusQueueUnitTest, PeerHealthStatus) {
   EXPECT_EQ(HealthReportPB::FAILED_UNRECOVERABLE, PeerMessageQueue::PeerHealthStatus(peer));
 }
 
+// Throughput benchmark for the leader's handling of follower responses,
+// which recomputes the watermarks under the queue lock.
+TEST_F(ConsensusQueueTest, TestResponseFromPeerThroughput) {
+  const int kNumPeers = 5;
+  const int64_t kNumOps = 1000;
+  const int kNumResponses = AllowSlowTests() ? 1000000 : 100000;
+
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm,
+                        BuildRaftConfigPBForTests(kNumPeers));
+  for (int i = 1; i < kNumPeers; i++) {
+    queue_->TrackPeer(MakePeer(strings::Substitute("peer-$0", i), RaftPeerPB::VOTER));
+  }
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, kNumOps);
+  WaitForLocalPeerToAckIndex(kNumOps);
+
+  ConsensusResponsePB response;
+  response.set_responder_term(kNumOps / 7);
+  LOG_TIMING(INFO, strings::Substitute("processing $0 responses", kNumResponses)) {
+    for (int i = 0; i < kNumResponses; i++) {
+      int64_t index = std::min<int64_t>(kNumOps, 1 + i / kNumPeers);
+      response.set_responder_uuid(strings::Substitute("peer-$0", 1 + i % (kNumPeers - 1)));
+      SetLastReceivedAndLastCommitted(&response, MakeOpId(index / 7, index),
+                                      queue_->GetCommittedIndex());
+      queue_->ResponseFromPeer(response.responder_uuid(), response);
+    }
+  }
+  ASSERT_EQ(kNumOps, queue_->GetMajorityReplicatedIndexForTests());
+  ASSERT_EQ(kNumOps, queue_->GetCommittedIndex());
+}
+
 }  // namespace consensus
 }  // namespace kudu
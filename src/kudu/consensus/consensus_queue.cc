@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -35,18 +36,25 @@
 #include "kudu/common/timestamp.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log.h"
+#include "kudu/consensus/ops_sidecar.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
+#include "kudu/consensus/state_machine_snapshot.h"
 #include "kudu/consensus/time_manager.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/fault_injection.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
@@ -59,6 +67,59 @@ DEFINE_int32(consensus_max_batch_size_bytes, 1024 * 1024,
              "The maximum per-tablet RPC batch size when updating peers.");
 TAG_FLAG(consensus_max_batch_size_bytes, advanced);
 
+DEFINE_int32(consensus_max_inflight_requests_per_peer, 1,
+             "The maximum number of UpdateConsensus requests carrying ops which "
+             "the leader keeps in flight to each peer. Values greater than 1 "
+             "pipeline batches of cached ops behind the outstanding ones instead "
+             "of waiting a round trip for each, which increases the throughput "
+             "to distant peers.");
+TAG_FLAG(consensus_max_inflight_requests_per_peer, advanced);
+TAG_FLAG(consensus_max_inflight_requests_per_peer, experimental);
+
+DEFINE_bool(consensus_adaptive_batch_sizing, false,
+            "Whether to size the batches of ops sent to each peer according to "
+            "the measured latency and throughput of the requests to it, between "
+            "--consensus_adaptive_batch_min_bytes and "
+            "--consensus_adaptive_batch_max_bytes, instead of always using "
+            "--consensus_max_batch_size_bytes.");
+TAG_FLAG(consensus_adaptive_batch_sizing, advanced);
+TAG_FLAG(consensus_adaptive_batch_sizing, experimental);
+
+DEFINE_int32(consensus_adaptive_batch_min_bytes, 64 * 1024,
+             "The smallest batch size, and the step by which batch sizes grow, "
+             "with --consensus_adaptive_batch_sizing.");
+TAG_FLAG(consensus_adaptive_batch_min_bytes, advanced);
+TAG_FLAG(consensus_adaptive_batch_min_bytes, experimental);
+
+DEFINE_int32(consensus_adaptive_batch_max_bytes, 8 * 1024 * 1024,
+             "The largest batch size with --consensus_adaptive_batch_sizing, which "
+             "peers catching up over fast links may be sent.");
+TAG_FLAG(consensus_adaptive_batch_max_bytes, advanced);
+TAG_FLAG(consensus_adaptive_batch_max_bytes, experimental);
+
+DEFINE_string(consensus_ops_compression_codec, "",
+              "Codec with which to compress the ops sent to peers, for example "
+              "LZ4. Only used with --consensus_send_ops_in_sidecar, and only for "
+              "peers which support compressed ops. Empty or 'none' to send ops "
+              "uncompressed.");
+TAG_FLAG(consensus_ops_compression_codec, advanced);
+TAG_FLAG(consensus_ops_compression_codec, experimental);
+
+DEFINE_bool(raft_enable_relay_replication, false,
+            "Whether the leader feeds the peers with the 'relay_uuid' attribute "
+            "through that relay peer, which forwards them the ops it already "
+            "received from its own log, instead of sending the ops to each of "
+            "them. Falls back to sending the ops directly while the relay is "
+            "unreachable.");
+TAG_FLAG(raft_enable_relay_replication, experimental);
+
+DEFINE_bool(raft_commit_quorum_requires_remote_region, false,
+            "Whether committing an op also requires a voter in another region than "
+            "the leader's to replicate it, as per the 'region' attribute of the "
+            "voters, so that committed ops survive the loss of the leader's region. "
+            "Ignored while all the voters are in the leader's region.");
+TAG_FLAG(raft_commit_quorum_requires_remote_region, experimental);
+
 DEFINE_int32(follower_unavailable_considered_failed_sec, 300,
              "Seconds that a leader is unable to successfully heartbeat to a "
              "follower after which the follower is considered to be failed and "
@@ -73,14 +134,67 @@ DEFINE_int32(consensus_inject_latency_ms_in_notifications, 0,
 TAG_FLAG(consensus_inject_latency_ms_in_notifications, hidden);
 TAG_FLAG(consensus_inject_latency_ms_in_notifications, unsafe);
 
+DEFINE_bool(consensus_async_catchup_reads, false,
+            "If true, when a lagging peer needs ops which are no longer in the log cache, "
+            "the leader reads them from disk on a separate thread pool instead of on the "
+            "thread preparing the peer's request, and keeps heartbeating the peer until "
+            "they are ready.");
+TAG_FLAG(consensus_async_catchup_reads, advanced);
+TAG_FLAG(consensus_async_catchup_reads, experimental);
+
+DEFINE_int32(consensus_catchup_read_threads, 4,
+             "The number of threads in the server-wide pool used for asynchronous "
+             "catch-up reads. Only used if --consensus_async_catchup_reads is set.");
+TAG_FLAG(consensus_catchup_read_threads, advanced);
+TAG_FLAG(consensus_catchup_read_threads, experimental);
+
+DEFINE_bool(consensus_safe_time_with_ops, false,
+            "Whether the leader sets safe time on requests carrying operations "
+            "too, rather than only on heartbeats. It is set to the timestamp of "
+            "the last operation of the request, so that snapshot scans on "
+            "followers wait for operations to be received rather than committed.");
+TAG_FLAG(consensus_safe_time_with_ops, advanced);
+TAG_FLAG(consensus_safe_time_with_ops, experimental);
+
+DEFINE_int32(raft_op_latency_sample_interval, 128,
+             "A leader times the stages of the replication of the ops whose index "
+             "is a multiple of this, for the raft_op_*_latency metrics. 0 disables "
+             "the sampling.");
+TAG_FLAG(raft_op_latency_sample_interval, advanced);
+TAG_FLAG(raft_op_latency_sample_interval, runtime);
+
+DEFINE_int32(raft_promotion_throttle_max_lag_ops, 1000,
+             "Once a NON_VOTER marked for promotion is within this many ops of "
+             "the committed index, but isn't catching up fast enough to be "
+             "promoted shortly, the leader briefly slows down the admission of "
+             "new writes so that the NON_VOTER may catch up. 0 disables this.");
+TAG_FLAG(raft_promotion_throttle_max_lag_ops, advanced);
+TAG_FLAG(raft_promotion_throttle_max_lag_ops, runtime);
+
+DEFINE_int32(raft_promotion_throttle_delay_us, 1000,
+             "How long the leader delays the admission of each write while it "
+             "throttles writes for the promotion of a NON_VOTER. See "
+             "--raft_promotion_throttle_max_lag_ops.");
+TAG_FLAG(raft_promotion_throttle_delay_us, advanced);
+TAG_FLAG(raft_promotion_throttle_delay_us, runtime);
+
+DEFINE_int32(raft_promotion_throttle_max_duration_ms, 5000,
+             "For how long at most the leader throttles writes for the promotion "
+             "of a given NON_VOTER. See --raft_promotion_throttle_max_lag_ops.");
+TAG_FLAG(raft_promotion_throttle_max_duration_ms, advanced);
+TAG_FLAG(raft_promotion_throttle_max_duration_ms, runtime);
+
 DECLARE_int32(consensus_rpc_timeout_ms);
 DECLARE_bool(safe_time_advancement_without_writes);
 DECLARE_bool(raft_prepare_replacement_before_eviction);
 DECLARE_bool(raft_attempt_to_replace_replica_without_majority);
+DECLARE_bool(raft_enable_quiescence);
+DECLARE_int32(raft_heartbeat_interval_ms);
 
 using kudu::log::Log;
 using kudu::pb_util::SecureDebugString;
 using kudu::pb_util::SecureShortDebugString;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::unordered_map;
@@ -101,6 +215,88 @@ METRIC_DEFINE_gauge_int64(tablet, in_progress_ops, "Operations in Progress",
 METRIC_DEFINE_gauge_int64(tablet, ops_behind_leader, "Operations Behind Leader",
                           MetricUnit::kOperations,
                           "Number of operations this server believes it is behind the leader.");
+METRIC_DEFINE_gauge_int64(tablet, min_peer_batch_size, "Minimum Peer Batch Size",
+                          MetricUnit::kBytes,
+                          "The smallest size of the batches of operations the leader sends to "
+                          "its peers, with --consensus_adaptive_batch_sizing. This metric is "
+                          "always zero for followers.");
+METRIC_DEFINE_gauge_int64(tablet, min_peer_bandwidth, "Minimum Estimated Peer Bandwidth",
+                          MetricUnit::kBytes,
+                          "The lowest estimated throughput, in bytes per second, of the "
+                          "requests the leader sends to its peers, with "
+                          "--consensus_adaptive_batch_sizing. This metric is always zero for "
+                          "followers.");
+METRIC_DEFINE_histogram(tablet, raft_op_local_append_latency, "Raft Op Local Append Latency",
+                        MetricUnit::kMicroseconds,
+                        "Microseconds from the append of a sampled op to the leader's queue "
+                        "until it is durable in the leader's WAL.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_op_majority_replicated_latency,
+                        "Raft Op Majority Replicated Latency",
+                        MetricUnit::kMicroseconds,
+                        "Microseconds from the append of a sampled op to the leader's queue "
+                        "until a majority of the voters received it.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_op_commit_latency, "Raft Op Commit Latency",
+                        MetricUnit::kMicroseconds,
+                        "Microseconds from the append of a sampled op to the leader's queue "
+                        "until it is committed.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_peer_rpc_latency, "Raft Peer RPC Latency",
+                        MetricUnit::kMicroseconds,
+                        "Microseconds from sending an update request to a peer until its "
+                        "response is received, which includes the peer preparing and logging "
+                        "the ops of the request.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_peer_response_queue_latency,
+                        "Raft Peer Response Queue Latency",
+                        MetricUnit::kMicroseconds,
+                        "Microseconds the responses of the peers wait for the Raft thread pool "
+                        "before being processed.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_non_voter_time_to_promote,
+                        "Raft NON_VOTER Time To Promote",
+                        MetricUnit::kMilliseconds,
+                        "Milliseconds from the leader starting to replicate to a NON_VOTER "
+                        "marked for promotion until it is caught up enough to be promoted.",
+                        3600000LU, 2);
+
+namespace {
+
+// Return the server-wide pool used for asynchronous catch-up reads, creating
+// it on first use. The pool is never destroyed.
+ThreadPool* GetCatchupReadPool() {
+  static ThreadPool* pool = []() {
+    gscoped_ptr<ThreadPool> new_pool;
+    CHECK_OK(ThreadPoolBuilder("catchup-read")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_consensus_catchup_read_threads)
+             .Build(&new_pool));
+    return new_pool.release();
+  }();
+  return pool;
+}
+
+// With --consensus_safe_time_with_ops, set the safe time of 'request' to the
+// timestamp of its last CLIENT_PROPAGATED op. The follower has all the ops up
+// to the last one of the request once it accepts it, and later ops get higher
+// timestamps than CLIENT_PROPAGATED ones. Unlike the leader's safe time, this
+// holds even if the request doesn't carry all of the leader's ops.
+void MaybeSetSafeTimestampFromOps(ConsensusRequestPB* request) {
+  if (!FLAGS_consensus_safe_time_with_ops) {
+    return;
+  }
+  for (int i = request->ops_size() - 1; i >= 0; i--) {
+    const ReplicateMsg& op = request->ops(i);
+    if (op.has_timestamp() &&
+        TimeManager::GetMessageConsistencyMode(op) == CLIENT_PROPAGATED) {
+      request->set_safe_timestamp(op.timestamp());
+      return;
+    }
+  }
+}
+
+} // anonymous namespace
 
 const char* PeerStatusToString(PeerStatus p) {
   switch (p) {
@@ -118,8 +314,13 @@ const char* PeerStatusToString(PeerStatus p) {
   return "<unknown>";
 }
 
-PeerMessageQueue::TrackedPeer::TrackedPeer(RaftPeerPB peer_pb)
+PeerMessageQueue::TrackedPeerConfig::TrackedPeerConfig(RaftPeerPB peer_pb)
     : peer_pb(std::move(peer_pb)),
+      status_log_throttler(std::make_shared<logging::LogThrottler>()) {
+}
+
+PeerMessageQueue::TrackedPeer::TrackedPeer(RaftPeerPB peer_pb)
+    : config(std::make_shared<const TrackedPeerConfig>(std::move(peer_pb))),
       next_index(kInvalidOpIdIndex),
       last_received(MinimumOpId()),
       last_known_committed_index(MinimumOpId().index()),
@@ -127,14 +328,24 @@ PeerMessageQueue::TrackedPeer::TrackedPeer(RaftPeerPB peer_pb)
       last_communication_time(MonoTime::Now()),
       wal_catchup_possible(true),
       last_overall_health_status(HealthReportPB::UNKNOWN),
-      status_log_throttler(std::make_shared<logging::LogThrottler>()),
+      batch_size_bytes(FLAGS_consensus_max_batch_size_bytes),
+      estimated_bandwidth(0),
+      sampled_request_bytes(0),
+      sampled_request_last_index(-1),
+      last_durable_index(MinimumOpId().index()),
+      ops_bytes_sent(0),
+      ops_bytes_uncompressed(0),
+      quiescent(false),
+      catchup_rate(0),
+      catchup_sample_lag(0),
+      promotion_caught_up(false),
       last_seen_term_(0) {
 }
 
 std::string PeerMessageQueue::TrackedPeer::ToString() const {
   return Substitute("Peer: $0, Status: $1, Last received: $2, Next index: $3, "
                     "Last known committed idx: $4, Time since last communication: $5",
-                    SecureShortDebugString(peer_pb),
+                    SecureShortDebugString(peer_pb()),
                     PeerStatusToString(last_exchange_status),
                     OpIdToString(last_received), next_index,
                     last_known_committed_index,
@@ -146,7 +357,18 @@ std::string PeerMessageQueue::TrackedPeer::ToString() const {
 PeerMessageQueue::Metrics::Metrics(const scoped_refptr<MetricEntity>& metric_entity)
   : num_majority_done_ops(INSTANTIATE_METRIC(METRIC_majority_done_ops)),
     num_in_progress_ops(INSTANTIATE_METRIC(METRIC_in_progress_ops)),
-    num_ops_behind_leader(INSTANTIATE_METRIC(METRIC_ops_behind_leader)) {
+    num_ops_behind_leader(INSTANTIATE_METRIC(METRIC_ops_behind_leader)),
+    min_peer_batch_size(INSTANTIATE_METRIC(METRIC_min_peer_batch_size)),
+    min_peer_bandwidth(INSTANTIATE_METRIC(METRIC_min_peer_bandwidth)),
+    op_local_append_latency(METRIC_raft_op_local_append_latency.Instantiate(metric_entity)),
+    op_majority_replicated_latency(
+        METRIC_raft_op_majority_replicated_latency.Instantiate(metric_entity)),
+    op_commit_latency(METRIC_raft_op_commit_latency.Instantiate(metric_entity)),
+    peer_rpc_latency(METRIC_raft_peer_rpc_latency.Instantiate(metric_entity)),
+    peer_response_queue_latency(
+        METRIC_raft_peer_response_queue_latency.Instantiate(metric_entity)),
+    non_voter_time_to_promote(
+        METRIC_raft_non_voter_time_to_promote.Instantiate(metric_entity)) {
 }
 #undef INSTANTIATE_METRIC
 
@@ -161,10 +383,18 @@ PeerMessageQueue::PeerMessageQueue(const scoped_refptr<MetricEntity>& metric_ent
     : raft_pool_observers_token_(std::move(raft_pool_observers_token)),
       local_peer_pb_(std::move(local_peer_pb)),
       tablet_id_(std::move(tablet_id)),
+      waiters_cond_(&waiters_lock_),
+      num_waiters_(0),
+      pending_commit_index_(-1),
+      commit_notification_scheduled_(false),
       successor_watch_in_progress_(false),
+      admission_throttled_(false),
       log_cache_(metric_entity, std::move(log), local_peer_pb_.permanent_uuid(), tablet_id_),
+      next_catchup_read_id_(0),
+      ops_codec_(nullptr),
       metrics_(metric_entity),
-      time_manager_(std::move(time_manager)) {
+      time_manager_(std::move(time_manager)),
+      snapshotter_(nullptr) {
   DCHECK(local_peer_pb_.has_permanent_uuid());
   DCHECK(local_peer_pb_.has_last_known_addr());
   DCHECK(last_locally_replicated.IsInitialized());
@@ -177,11 +407,28 @@ PeerMessageQueue::PeerMessageQueue(const scoped_refptr<MetricEntity>& metric_ent
   queue_state_.last_idx_appended_to_leader = 0;
   queue_state_.mode = NON_LEADER;
   queue_state_.majority_size_ = -1;
+  sampled_ops_.clear();
   queue_state_.last_appended = std::move(last_locally_replicated);
+  queue_state_.last_durable_index = queue_state_.last_appended.index();
+  queue_state_.num_truncations = 0;
   queue_state_.committed_index = last_locally_committed.index();
   queue_state_.state = kQueueOpen;
   // TODO(mpercy): Merge LogCache::Init() with its constructor.
   log_cache_.Init(queue_state_.last_appended);
+  if (FLAGS_consensus_async_catchup_reads) {
+    catchup_read_token_ = GetCatchupReadPool()->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  }
+  if (!FLAGS_consensus_ops_compression_codec.empty()) {
+    CompressionType codec_type = GetCompressionCodecType(FLAGS_consensus_ops_compression_codec);
+    if (codec_type != NO_COMPRESSION) {
+      Status s = GetCompressionCodec(codec_type, &ops_codec_);
+      if (PREDICT_FALSE(!s.ok())) {
+        LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to instantiate ops compression codec, "
+                                          << "sending ops uncompressed: " << s.ToString();
+        ops_codec_ = nullptr;
+      }
+    }
+  }
 }
 
 void PeerMessageQueue::SetLeaderMode(int64_t committed_index,
@@ -192,13 +439,18 @@ void PeerMessageQueue::SetLeaderMode(int64_t committed_index,
     CHECK_GT(current_term, queue_state_.current_term) << "Terms should only increase";
     queue_state_.first_index_in_current_term = boost::none;
     queue_state_.current_term = current_term;
+    // Requests accepted in earlier terms don't count toward this term's lease.
+    for (const PeersMap::value_type& entry : peers_map_) {
+      entry.second->lease_request_time = MonoTime();
+    }
   }
 
   queue_state_.committed_index = committed_index;
   queue_state_.majority_replicated_index = committed_index;
   queue_state_.active_config.reset(new RaftConfigPB(active_config));
-  queue_state_.majority_size_ = MajoritySize(CountVoters(*queue_state_.active_config));
+  queue_state_.majority_size_ = CommitQuorumSize(CountVoters(*queue_state_.active_config));
   queue_state_.mode = LEADER;
+  sampled_ops_.clear();
 
   TrackLocalPeerUnlocked();
   CheckPeersInActiveConfigIfLeaderUnlocked();
@@ -216,10 +468,14 @@ void PeerMessageQueue::SetLeaderMode(int64_t committed_index,
 }
 
 void PeerMessageQueue::SetNonLeaderMode(const RaftConfigPB& active_config) {
+  SCOPED_CLEANUP({ NotifyWaiters(); });
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   queue_state_.active_config.reset(new RaftConfigPB(active_config));
   queue_state_.mode = NON_LEADER;
   queue_state_.majority_size_ = -1;
+  for (const PeersMap::value_type& entry : peers_map_) {
+    entry.second->lease_request_time = MonoTime();
+  }
 
   // Update this when stepping down, since it doesn't get tracked as LEADER.
   queue_state_.last_idx_appended_to_leader = queue_state_.last_appended.index();
@@ -271,6 +527,13 @@ void PeerMessageQueue::UntrackPeerUnlocked(const string& uuid) {
   DCHECK(queue_lock_.is_locked());
   TrackedPeer* peer = EraseKeyReturnValuePtr(&peers_map_, uuid);
   delete peer; // Deleting a nullptr is safe.
+  catchup_reads_.erase(uuid);
+}
+
+void PeerMessageQueue::SetCatchupReadCallback(const string& uuid,
+                                              std::function<void()> callback) {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  catchup_reads_[uuid].ready_callback = std::move(callback);
 }
 
 void PeerMessageQueue::TrackLocalPeerUnlocked() {
@@ -336,10 +599,19 @@ void PeerMessageQueue::CheckPeersInActiveConfigIfLeaderUnlocked() const {
 }
 
 void PeerMessageQueue::LocalPeerAppendFinished(const OpId& id,
+                                               int64_t num_truncations,
                                                const StatusCallback& callback,
                                                const Status& status) {
   CHECK_OK(status);
 
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    if (num_truncations == queue_state_.num_truncations) {
+      queue_state_.last_durable_index = std::max(queue_state_.last_durable_index, id.index());
+      UpdateSampledOpsUnlocked();
+    }
+  }
+
   // Fake an RPC response from the local peer.
   // TODO: we should probably refactor the ResponseFromPeer function
   // so that we don't need to construct this fake response, but this
@@ -370,6 +642,16 @@ Status PeerMessageQueue::AppendOperations(const vector<ReplicateRefPtr>& msgs,
 
   OpId last_id = msgs.back()->get()->id();
 
+  // Appending ops which overwrite earlier ones truncates the latter.
+  int64_t first_index = msgs.front()->get()->id().index();
+  if (first_index <= queue_state_.last_appended.index()) {
+    queue_state_.num_truncations++;
+    queue_state_.last_durable_index = std::min(queue_state_.last_durable_index,
+                                               first_index - 1);
+    sampled_ops_.erase(sampled_ops_.lower_bound(first_index), sampled_ops_.end());
+  }
+  int64_t num_truncations = queue_state_.num_truncations;
+
   // "Snoop" on the appended operations to watch for term changes (as follower)
   // and to determine the first index in our term (as leader).
   //
@@ -396,6 +678,24 @@ Status PeerMessageQueue::AppendOperations(const vector<ReplicateRefPtr>& msgs,
     time_manager_->AdvanceSafeTimeWithMessage(*msgs.back()->get());
   }
 
+  // Sample ops to time the stages of their replication. The bound on the
+  // sampled ops in flight only matters if a majority is unreachable.
+  static const size_t kMaxSampledOps = 1024;
+  const int sample_interval = FLAGS_raft_op_latency_sample_interval;
+  if (queue_state_.mode == LEADER && sample_interval > 0 &&
+      sampled_ops_.size() < kMaxSampledOps) {
+    MonoTime now;
+    for (const auto& msg : msgs) {
+      int64_t index = msg->get()->id().index();
+      if (index % sample_interval == 0) {
+        if (!now.Initialized()) {
+          now = MonoTime::Now();
+        }
+        sampled_ops_[index].append_time = now;
+      }
+    }
+  }
+
   // Unlock ourselves during Append to prevent a deadlock: it's possible that
   // the log buffer is full, in which case AppendOperations would block. However,
   // for the log buffer to empty, it may need to call LocalPeerAppendFinished()
@@ -405,6 +705,7 @@ Status PeerMessageQueue::AppendOperations(const vector<ReplicateRefPtr>& msgs,
                                             Bind(&PeerMessageQueue::LocalPeerAppendFinished,
                                                  Unretained(this),
                                                  last_id,
+                                                 num_truncations,
                                                  log_append_callback)));
   lock.lock();
   DCHECK(last_id.IsInitialized());
@@ -425,16 +726,34 @@ void PeerMessageQueue::TruncateOpsAfter(int64_t index) {
     std::unique_lock<simple_spinlock> lock(queue_lock_);
     DCHECK(op.IsInitialized());
     queue_state_.last_appended = op;
+    queue_state_.num_truncations++;
+    queue_state_.last_durable_index = std::min(queue_state_.last_durable_index, op.index());
   }
   log_cache_.TruncateOpsAfter(op.index());
 }
 
+void PeerMessageQueue::ResetAfterSnapshot(const OpId& last_included) {
+  DFAKE_SCOPED_LOCK(append_fake_lock_); // should not race with append.
+  {
+    std::unique_lock<simple_spinlock> lock(queue_lock_);
+    DCHECK_EQ(NON_LEADER, queue_state_.mode);
+    queue_state_.last_appended = last_included;
+    queue_state_.last_durable_index = last_included.index();
+  }
+  log_cache_.ResetAfterSnapshot(last_included);
+}
+
 OpId PeerMessageQueue::GetLastOpIdInLog() const {
   std::unique_lock<simple_spinlock> lock(queue_lock_);
   DCHECK(queue_state_.last_appended.IsInitialized());
   return queue_state_.last_appended;
 }
 
+int64_t PeerMessageQueue::GetLastDurableIndex() const {
+  std::unique_lock<simple_spinlock> lock(queue_lock_);
+  return queue_state_.last_durable_index;
+}
+
 OpId PeerMessageQueue::GetNextOpId() const {
   std::unique_lock<simple_spinlock> lock(queue_lock_);
   DCHECK(queue_state_.last_appended.IsInitialized());
@@ -497,7 +816,8 @@ bool PeerMessageQueue::SafeToEvictUnlocked(const string& evict_uuid) const {
   // don't evict anything if the remaining number of viable voters is not enough
   // to form a majority of the remaining voters.
   if (PREDICT_TRUE(!FLAGS_raft_attempt_to_replace_replica_without_majority) &&
-      remaining_viable_voters < MajoritySize(remaining_voters)) {
+      remaining_viable_voters < std::max(CommitQuorumSize(remaining_voters),
+                                         ElectionQuorumSize(remaining_voters))) {
     VLOG(2) << LogPrefixUnlocked() << Substitute(
         "Not evicting P $0 (only $1/$2 remaining voters appear viable)",
         evict_uuid, remaining_viable_voters, remaining_voters);
@@ -511,7 +831,17 @@ void PeerMessageQueue::UpdatePeerHealthUnlocked(TrackedPeer* peer) {
   DCHECK(queue_lock_.is_locked());
   DCHECK_EQ(LEADER, queue_state_.mode);
 
-  auto overall_health_status = PeerHealthStatus(*peer);
+  // A peer which fell behind the log isn't lost if it can be caught up from
+  // a snapshot of the state machine instead.
+  const bool snapshot_catchup = !peer->wal_catchup_possible && snapshotter_ != nullptr;
+  HealthReportPB::HealthStatus overall_health_status;
+  if (snapshot_catchup) {
+    TrackedPeer caught_up = *peer;
+    caught_up.wal_catchup_possible = true;
+    overall_health_status = PeerHealthStatus(caught_up);
+  } else {
+    overall_health_status = PeerHealthStatus(*peer);
+  }
 
   // Prepare error messages for different conditions.
   string error_msg;
@@ -519,7 +849,7 @@ void PeerMessageQueue::UpdatePeerHealthUnlocked(TrackedPeer* peer) {
       overall_health_status == HealthReportPB::FAILED_UNRECOVERABLE) {
     if (peer->last_exchange_status == PeerStatus::TABLET_FAILED) {
       error_msg = Substitute("The tablet replica hosted on peer $0 has failed", peer->uuid());
-    } else if (!peer->wal_catchup_possible) {
+    } else if (!peer->wal_catchup_possible && !snapshot_catchup) {
       error_msg = Substitute("The logs necessary to catch up peer $0 have been "
                              "garbage collected. The replica will never be able "
                              "to catch up", peer->uuid());
@@ -610,13 +940,18 @@ HealthReportPB::HealthStatus PeerMessageQueue::PeerHealthStatus(const TrackedPee
 
 Status PeerMessageQueue::RequestForPeer(const string& uuid,
                                         ConsensusRequestPB* request,
-                                        vector<ReplicateRefPtr>* msg_refs,
+                                        ReplicateSpanPtr* msg_refs,
                                         bool* needs_tablet_copy) {
-  // Maintain a thread-safe copy of necessary members.
+  // Maintain a thread-safe copy of necessary members. Only the peer's
+  // progress is copied: its config is immutable and shared.
   OpId preceding_id;
   int64_t current_term;
-  TrackedPeer peer_copy;
+  shared_ptr<const TrackedPeerConfig> peer_config;
+  int64_t peer_next_index;
+  int64_t peer_batch_size;
+  PeerStatus peer_last_exchange_status;
   MonoDelta unreachable_time;
+  boost::optional<OpId> relay_last_received;
   {
     std::lock_guard<simple_spinlock> lock(queue_lock_);
     DCHECK_EQ(queue_state_.state, kQueueOpen);
@@ -627,7 +962,10 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
       return Status::NotFound(Substitute("peer $0 is no longer tracked or "
                                          "queue is not in leader mode", uuid));
     }
-    peer_copy = *peer;
+    peer_config = peer->config;
+    peer_next_index = peer->next_index;
+    peer_batch_size = BatchSizeForPeerUnlocked(*peer);
+    peer_last_exchange_status = peer->last_exchange_status;
 
     // Clear the requests without deleting the entries, as they may be in use by other peers.
     request->mutable_ops()->ExtractSubrange(0, request->ops_size(), nullptr);
@@ -641,10 +979,31 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     request->set_all_replicated_index(queue_state_.all_replicated_index);
     request->set_last_idx_appended_to_leader(queue_state_.last_appended.index());
     request->set_caller_term(current_term);
-    unreachable_time = MonoTime::Now() - peer_copy.last_communication_time;
+    request->set_leader_tracks_durable_idx(true);
+    unreachable_time = MonoTime::Now() - peer->last_communication_time;
+
+    // The tablet is idle as far as this peer is concerned if the peer has
+    // everything the leader has and knows that it's all committed.
+    peer->quiescent = FLAGS_raft_enable_quiescence &&
+        peer->last_exchange_status == PeerStatus::OK &&
+        OpIdEquals(peer->last_received, queue_state_.last_appended) &&
+        peer->last_durable_index == queue_state_.last_appended.index() &&
+        queue_state_.committed_index == queue_state_.last_appended.index() &&
+        peer->last_known_committed_index == queue_state_.committed_index;
+    request->set_quiescent(peer->quiescent);
+
+    request->clear_proxy_dest_uuid();
+    request->clear_relayed_last_op_id();
+    request->clear_safe_timestamp();
+    const TrackedPeer* relay = RelayForPeerUnlocked(*peer);
+    if (relay != nullptr) {
+      request->set_proxy_dest_uuid(uuid);
+      relay_last_received = relay->last_received;
+    }
   }
 
   // Always trigger a health status update check at the end of this function.
+  int64_t sent_bytes = 0;
   bool wal_catchup_progress = false;
   bool wal_catchup_failure = false;
   SCOPED_CLEANUP({
@@ -657,10 +1016,14 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
       }
       if (wal_catchup_progress) peer->wal_catchup_possible = true;
       if (wal_catchup_failure) peer->wal_catchup_possible = false;
+      if (sent_bytes > 0) {
+        RecordRequestSentUnlocked(peer, sent_bytes,
+                                  request->ops(request->ops_size() - 1).id().index());
+      }
       UpdatePeerHealthUnlocked(peer);
     });
 
-  if (peer_copy.last_exchange_status == PeerStatus::TABLET_NOT_FOUND) {
+  if (peer_last_exchange_status == PeerStatus::TABLET_NOT_FOUND) {
     VLOG(3) << LogPrefixUnlocked() << "Peer " << uuid << " needs tablet copy" << THROTTLE_MSG;
     *needs_tablet_copy = true;
     return Status::OK();
@@ -670,27 +1033,33 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
   // If we've never communicated with the peer, we don't know what messages to
   // send, so we'll send a status-only request. Otherwise, we grab requests
   // from the log starting at the last_received point.
-  if (peer_copy.last_exchange_status != PeerStatus::NEW) {
+  if (peer_last_exchange_status != PeerStatus::NEW) {
 
     // The batch of messages to send to the peer.
-    vector<ReplicateRefPtr> messages;
-    int max_batch_size = FLAGS_consensus_max_batch_size_bytes - request->ByteSize();
+    ReplicateSpanPtr messages;
+    int max_batch_size = peer_batch_size - request->ByteSize();
 
     // We try to get the follower's next_index from our log.
-    Status s = log_cache_.ReadOps(peer_copy.next_index - 1,
-                                  max_batch_size,
-                                  &messages,
-                                  &preceding_id);
+    bool read_pending = false;
+    Status s = ReadOpsForPeer(uuid,
+                              peer_next_index - 1,
+                              max_batch_size,
+                              &messages,
+                              &preceding_id,
+                              &read_pending);
     if (PREDICT_FALSE(!s.ok())) {
       // It's normal to have a NotFound() here if a follower falls behind where
       // the leader has GCed its logs. The follower replica will hang around
       // for a while until it's evicted.
       if (PREDICT_TRUE(s.IsNotFound())) {
-        KLOG_EVERY_N_SECS_THROTTLER(INFO, 60, *peer_copy.status_log_throttler, "logs_gced")
+        KLOG_EVERY_N_SECS_THROTTLER(INFO, 60, *peer_config->status_log_throttler, "logs_gced")
             << LogPrefixUnlocked()
             << Substitute("The logs necessary to catch up peer $0 have been "
-                          "garbage collected. The follower will never be able "
-                          "to catch up ($1)", uuid, s.ToString());
+                          "garbage collected. $1 ($2)", uuid,
+                          snapshotter_ != nullptr ?
+                              "The follower will be caught up from a snapshot" :
+                              "The follower will never be able to catch up",
+                          s.ToString());
         wal_catchup_failure = true;
         return s;
       }
@@ -700,26 +1069,47 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
         LOG_WITH_PREFIX_UNLOCKED(ERROR) << "Error trying to read ahead of the log "
                                         << "while preparing peer request: "
                                         << s.ToString() << ". Destination peer: "
-                                        << peer_copy.ToString();
+                                        << PeerToString(uuid);
         return s;
       }
       LOG_WITH_PREFIX_UNLOCKED(FATAL) << "Error reading the log while preparing peer request: "
                                       << s.ToString() << ". Destination peer: "
-                                      << peer_copy.ToString();
+                                      << PeerToString(uuid);
     }
 
     // Since we were able to read ops through the log cache, we know that
     // catchup is possible.
     wal_catchup_progress = true;
+    if (read_pending) {
+      VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending a heartbeat to peer " << uuid
+                                   << " while its ops are read from disk";
+    }
 
-    // We use AddAllocated rather than copy, because we pin the log cache at the
-    // "all replicated" point. At some point we may want to allow partially loading
-    // (and not pinning) earlier messages. At that point we'll need to do something
-    // smarter here, like copy or ref-count.
-    for (const ReplicateRefPtr& msg : messages) {
-      request->mutable_ops()->AddAllocated(msg->get());
+    // The relay forwards the ops it already has from its own log: only the id
+    // of the last one is sent, to check that its log matches this one.
+    if (relay_last_received && messages) {
+      const vector<ReplicateRefPtr>& msgs = messages->msgs();
+      auto it = msgs.rbegin();
+      while (it != msgs.rend() && (*it)->get()->id().index() > relay_last_received->index()) {
+        ++it;
+      }
+      if (it != msgs.rend()) {
+        *request->mutable_relayed_last_op_id() = (*it)->get()->id();
+      }
+      messages.reset();
+    }
+
+    // We use AddAllocated rather than copy, because the messages are kept
+    // alive by the batch in 'msg_refs' for as long as the request is in use.
+    if (messages) {
+      for (const ReplicateRefPtr& msg : messages->msgs()) {
+        request->mutable_ops()->AddAllocated(msg->get());
+        if (FLAGS_consensus_adaptive_batch_sizing) {
+          sent_bytes += msg->byte_size();
+        }
+      }
     }
-    msg_refs->swap(messages);
+    *msg_refs = std::move(messages);
   }
 
   DCHECK(preceding_id.IsInitialized());
@@ -731,11 +1121,12 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
   if (request->ops_size() > 0) {
     int64_t last_op_sent = request->ops(request->ops_size() - 1).id().index();
     if (last_op_sent < request->committed_index()) {
-      KLOG_EVERY_N_SECS_THROTTLER(INFO, 3, *peer_copy.status_log_throttler, "lagging")
+      KLOG_EVERY_N_SECS_THROTTLER(INFO, 3, *peer_config->status_log_throttler, "lagging")
           << LogPrefixUnlocked() << "Peer " << uuid << " is lagging by at least "
           << (request->committed_index() - last_op_sent)
           << " ops behind the committed index " << THROTTLE_MSG;
     }
+    MaybeSetSafeTimestampFromOps(request);
   // If we're not sending ops to the follower, set the safe time on the request.
   // TODO(dralves) When we have leader leases, send this all the time.
   } else {
@@ -762,6 +1153,269 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
   return Status::OK();
 }
 
+Status PeerMessageQueue::PipelinedRequestForPeer(const string& uuid,
+                                                 int64_t after_op_index,
+                                                 ConsensusRequestPB* request,
+                                                 ReplicateSpanPtr* msg_refs) {
+  int64_t peer_batch_size;
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    DCHECK_EQ(queue_state_.state, kQueueOpen);
+
+    TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+    if (PREDICT_FALSE(peer == nullptr || queue_state_.mode == NON_LEADER)) {
+      return Status::NotFound(Substitute("peer $0 is no longer tracked or "
+                                         "queue is not in leader mode", uuid));
+    }
+
+    // Clear the requests without deleting the entries, as they may be in use by other peers.
+    request->mutable_ops()->ExtractSubrange(0, request->ops_size(), nullptr);
+    request->clear_quiescent();
+    request->clear_proxy_dest_uuid();
+    request->clear_relayed_last_op_id();
+    request->clear_safe_timestamp();
+
+    // If the last exchange failed, the requests in flight may not be accepted
+    // either, so the peer has to be resynchronized first.
+    if (peer->last_exchange_status != PeerStatus::OK ||
+        !log_cache_.HasOpBeenWritten(after_op_index + 1)) {
+      return Status::OK();
+    }
+    peer->quiescent = false;
+    peer_batch_size = BatchSizeForPeerUnlocked(*peer);
+
+    request->set_committed_index(queue_state_.committed_index);
+    request->set_all_replicated_index(queue_state_.all_replicated_index);
+    request->set_last_idx_appended_to_leader(queue_state_.last_appended.index());
+    request->set_caller_term(queue_state_.current_term);
+    request->set_leader_tracks_durable_idx(true);
+  }
+
+  OpId preceding_id;
+  int max_batch_size = peer_batch_size - request->ByteSize();
+  RETURN_NOT_OK(log_cache_.ReadCachedSpan(after_op_index, max_batch_size,
+                                          msg_refs, &preceding_id));
+  if (*msg_refs) {
+    for (const ReplicateRefPtr& msg : (*msg_refs)->msgs()) {
+      request->mutable_ops()->AddAllocated(msg->get());
+    }
+  }
+  request->mutable_preceding_id()->CopyFrom(preceding_id);
+  MaybeSetSafeTimestampFromOps(request);
+
+  if (FLAGS_consensus_adaptive_batch_sizing && *msg_refs) {
+    int64_t sent_bytes = 0;
+    for (const ReplicateRefPtr& msg : (*msg_refs)->msgs()) {
+      sent_bytes += msg->byte_size();
+    }
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+    if (peer != nullptr) {
+      RecordRequestSentUnlocked(peer, sent_bytes, (*msg_refs)->back()->id().index());
+    }
+  }
+
+  if (PREDICT_FALSE(VLOG_IS_ON(2)) && request->ops_size() > 0) {
+    VLOG_WITH_PREFIX_UNLOCKED(2) << "Pipelining request with operations to Peer: " << uuid
+        << ". Size: " << request->ops_size()
+        << ". From: " << SecureShortDebugString(request->ops(0).id()) << ". To: "
+        << SecureShortDebugString(request->ops(request->ops_size() - 1).id());
+  }
+  return Status::OK();
+}
+
+shared_ptr<const faststring> PeerMessageQueue::GetSerializedOps(
+    const string& uuid,
+    const vector<ReplicateRefPtr>& msgs,
+    bool allow_compression,
+    CompressionType* compression) {
+  // The number of recently serialized batches to keep. Peers which are caught
+  // up are normally sent the same, latest batch.
+  static const int kMaxSerializedBatches = 4;
+
+  DCHECK(!msgs.empty());
+  const OpId& first_id = msgs.front()->get()->id();
+  const OpId& last_id = msgs.back()->get()->id();
+  const bool compress = allow_compression && ops_codec_ != nullptr;
+
+  SerializedOps result;
+  bool found = false;
+  {
+    std::lock_guard<simple_spinlock> lock(serialized_ops_lock_);
+    for (const SerializedOps& batch : serialized_ops_) {
+      if (OpIdEquals(batch.first_id, first_id) && OpIdEquals(batch.last_id, last_id) &&
+          batch.compressible == compress) {
+        result = batch;
+        found = true;
+        break;
+      }
+    }
+  }
+
+  if (!found) {
+    // Serialize and compress outside of the lock. If two peers race to
+    // serialize the same batch, both buffers are valid, and only one of them
+    // is cached.
+    auto buf = std::make_shared<faststring>();
+    SerializeOpsForSidecar(msgs, buf.get());
+    result = { first_id, last_id, compress, buf, NO_COMPRESSION,
+               static_cast<int64_t>(buf->size()) };
+    if (compress) {
+      auto compressed = std::make_shared<faststring>();
+      Status s = CompressOpsSidecar(*ops_codec_, Slice(*buf), compressed.get());
+      if (PREDICT_FALSE(!s.ok())) {
+        KLOG_EVERY_N_SECS(WARNING, 10) << LogPrefixUnlocked()
+            << "Unable to compress ops, sending them uncompressed: " << s.ToString();
+      } else if (compressed->size() < buf->size()) {
+        // Batches which don't compress are sent uncompressed, but still cached
+        // as compressible so that they aren't compressed again for each peer.
+        result.buf = compressed;
+        result.compression = ops_codec_->type();
+      }
+    }
+
+    std::lock_guard<simple_spinlock> lock(serialized_ops_lock_);
+    serialized_ops_.push_back(result);
+    if (serialized_ops_.size() > kMaxSerializedBatches) {
+      serialized_ops_.pop_front();
+    }
+  }
+
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+    if (peer) {
+      peer->ops_bytes_sent += result.buf->size();
+      peer->ops_bytes_uncompressed += result.uncompressed_size;
+    }
+  }
+  *compression = result.compression;
+  return result.buf;
+}
+
+string PeerMessageQueue::PeerToString(const string& uuid) const {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  const TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+  return peer ? peer->ToString() : Substitute("$0 (no longer tracked)", uuid);
+}
+
+Status PeerMessageQueue::ReadOpsForPeer(const string& uuid,
+                                        int64_t after_op_index,
+                                        int max_batch_size,
+                                        ReplicateSpanPtr* span,
+                                        OpId* preceding_id,
+                                        bool* read_pending) {
+  *read_pending = false;
+
+  // Ops which are cached can be sent right away, and if the peer is caught up
+  // there is nothing to read.
+  RETURN_NOT_OK(log_cache_.ReadCachedSpan(after_op_index, max_batch_size,
+                                          span, preceding_id));
+  if (*span || !log_cache_.HasOpBeenWritten(after_op_index + 1)) {
+    return Status::OK();
+  }
+  if (!catchup_read_token_) {
+    vector<ReplicateRefPtr> messages;
+    RETURN_NOT_OK(log_cache_.ReadOps(after_op_index, max_batch_size, &messages, preceding_id));
+    if (!messages.empty()) {
+      *span = new ReplicateSpan(std::move(messages));
+    }
+    return Status::OK();
+  }
+
+  // The ops have to come from disk.
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (PREDICT_FALSE(!ContainsKey(peers_map_, uuid))) {
+    return Status::NotFound(Substitute("peer $0 is no longer tracked", uuid));
+  }
+  CatchupRead* read = &catchup_reads_[uuid];
+  if (read->has_result && read->after_op_index == after_op_index) {
+    read->has_result = false;
+    if (!read->status.ok()) {
+      read->messages.clear();
+      return read->status;
+    }
+    *preceding_id = read->preceding_id;
+    if (read->messages.empty()) {
+      return Status::OK();
+    }
+    *span = new ReplicateSpan(std::move(read->messages));
+    read->messages.clear();
+
+    // Read the following ops ahead of time, so that they are likely to be ready
+    // by the time the peer acknowledges these.
+    int64_t last_index = (*span)->back()->id().index();
+    if (log_cache_.HasOpBeenWritten(last_index + 1) && !log_cache_.IsOpCached(last_index + 1)) {
+      StartCatchupReadUnlocked(uuid, last_index, max_batch_size, read);
+    }
+    return Status::OK();
+  }
+
+  // Start a read for these ops, unless one is already running. If the running
+  // one is for other ops (e.g. the peer's next index moved back), its result
+  // will be discarded and a new read started on the next request.
+  if (!read->in_progress) {
+    StartCatchupReadUnlocked(uuid, after_op_index, max_batch_size, read);
+  }
+  *read_pending = true;
+  return Status::OK();
+}
+
+void PeerMessageQueue::StartCatchupReadUnlocked(const string& uuid,
+                                                int64_t after_op_index,
+                                                int max_batch_size,
+                                                CatchupRead* read) {
+  DCHECK(queue_lock_.is_locked());
+  read->read_id = ++next_catchup_read_id_;
+  read->after_op_index = after_op_index;
+  read->in_progress = true;
+  read->has_result = false;
+  read->messages.clear();
+
+  int64_t read_id = read->read_id;
+  Status s = catchup_read_token_->SubmitFunc(
+      [this, uuid, read_id, after_op_index, max_batch_size]() {
+        CatchupReadTask(uuid, read_id, after_op_index, max_batch_size);
+      });
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to start catch-up read for peer "
+                                      << uuid << ": " << s.ToString();
+    read->in_progress = false;
+  }
+}
+
+void PeerMessageQueue::CatchupReadTask(const string& uuid,
+                                       int64_t read_id,
+                                       int64_t after_op_index,
+                                       int max_batch_size) {
+  vector<ReplicateRefPtr> messages;
+  OpId preceding_id;
+  Status s = log_cache_.ReadOps(after_op_index, max_batch_size, &messages, &preceding_id);
+  VLOG_WITH_PREFIX_UNLOCKED(2) << "Catch-up read of " << messages.size() << " ops after index "
+                               << after_op_index << " for peer " << uuid << ": "
+                               << s.ToString();
+
+  std::function<void()> callback;
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    CatchupRead* read = FindOrNull(catchup_reads_, uuid);
+    if (read == nullptr || read->read_id != read_id) {
+      return;
+    }
+    read->in_progress = false;
+    read->has_result = true;
+    read->status = s;
+    read->messages.swap(messages);
+    read->preceding_id = preceding_id;
+    callback = read->ready_callback;
+  }
+  // If the peer has a request in flight, this is a no-op, and the ops are sent
+  // once it gets the response.
+  if (callback) {
+    callback();
+  }
+}
+
 Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
                                                      StartTabletCopyRequestPB* req) {
   TrackedPeer* peer = nullptr;
@@ -788,6 +1442,84 @@ Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
   return Status::OK();
 }
 
+void PeerMessageQueue::SetSnapshotter(StateMachineSnapshotter* snapshotter) {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  snapshotter_ = snapshotter;
+}
+
+bool PeerMessageQueue::PeerNeedsSnapshot(const string& uuid) const {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (snapshotter_ == nullptr || queue_state_.mode == NON_LEADER) {
+    return false;
+  }
+  const TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+  return peer != nullptr && !peer->wal_catchup_possible;
+}
+
+Status PeerMessageQueue::StartSnapshotForPeer(const string& uuid,
+                                              unique_ptr<StateMachineSnapshotReader>* reader,
+                                              InstallSnapshotRequestPB* req) {
+  StateMachineSnapshotter* snapshotter;
+  int64_t current_term;
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    DCHECK_NE(uuid, local_peer_pb_.permanent_uuid());
+    const TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+    if (PREDICT_FALSE(peer == nullptr || queue_state_.mode == NON_LEADER)) {
+      return Status::NotFound("Peer not tracked or queue not in leader mode.");
+    }
+    if (PREDICT_FALSE(snapshotter_ == nullptr)) {
+      return Status::NotSupported("state machine doesn't support snapshots");
+    }
+    snapshotter = snapshotter_;
+    current_term = queue_state_.current_term;
+  }
+  // Taking the snapshot may be expensive: don't hold the lock meanwhile.
+  RETURN_NOT_OK_PREPEND(snapshotter->TakeSnapshot(reader), "Unable to take snapshot");
+  req->Clear();
+  req->set_dest_uuid(uuid);
+  req->set_tablet_id(tablet_id_);
+  req->set_caller_uuid(local_peer_pb_.permanent_uuid());
+  req->set_caller_term(current_term);
+  *req->mutable_last_included_op_id() = (*reader)->last_included_op_id();
+  req->set_offset(0);
+  return Status::OK();
+}
+
+void PeerMessageQueue::SnapshotResponseFromPeer(const string& uuid,
+                                                const OpId& last_included,
+                                                const InstallSnapshotResponsePB& response) {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+  if (PREDICT_FALSE(peer == nullptr || queue_state_.mode == NON_LEADER)) {
+    VLOG(1) << LogPrefixUnlocked() << "peer " << uuid
+            << " is no longer tracked or queue is not in leader mode";
+    return;
+  }
+  peer->last_communication_time = MonoTime::Now();
+  if (response.status().has_error() &&
+      response.status().error().code() == ConsensusErrorPB::INVALID_TERM) {
+    peer->last_exchange_status = PeerStatus::INVALID_TERM;
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Peer responded invalid term to snapshot: "
+                                   << peer->ToString();
+    NotifyObserversOfTermChange(response.responder_term());
+    return;
+  }
+  if (!response.done()) {
+    return;
+  }
+
+  // The peer's log now follows the snapshot: send it the ops after it.
+  LOG_WITH_PREFIX_UNLOCKED(INFO) << "Peer " << uuid << " installed snapshot through "
+                                 << OpIdToString(last_included);
+  peer->last_exchange_status = PeerStatus::OK;
+  peer->next_index = last_included.index() + 1;
+  peer->last_received = last_included;
+  peer->last_durable_index = last_included.index();
+  peer->wal_catchup_possible = true;
+  UpdatePeerHealthUnlocked(peer);
+}
+
 void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
                                              int64_t* watermark,
                                              const OpId& replicated_before,
@@ -806,14 +1538,17 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
   // Go through the peer's watermarks, we want the highest watermark that
   // 'num_peers_required' of peers has replicated. To find this we do the
   // following:
-  // - Store all the peer's 'last_received' in a vector
-  // - Sort the vector
-  // - Find the vector.size() - 'num_peers_required' position, this
-  //   will be the new 'watermark'.
-  vector<int64_t> watermarks;
+  // - Store all the peer's 'last_durable_index' in a vector
+  // - Partially sort the vector around the vector.size() - 'num_peers_required'
+  //   position, the value there will be the new 'watermark'.
+  //
+  // This runs under 'queue_lock_' for every response, so the vector is reused
+  // across calls and the selection is linear rather than a full sort.
+  vector<int64_t>& watermarks = watermarks_scratch_;
+  watermarks.clear();
   for (const PeersMap::value_type& peer : peers_map_) {
     if (replica_types == VOTER_REPLICAS &&
-        peer.second->peer_pb.member_type() != RaftPeerPB::VOTER) {
+        peer.second->peer_pb().member_type() != RaftPeerPB::VOTER) {
       continue;
     }
     // TODO(todd): The fact that we only consider peers whose last exchange was
@@ -837,7 +1572,7 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
     // for watermark calculation. This could be fixed by separately storing the
     // 'match_index' on a per-peer basis and using that for watermark calculation.
     if (peer.second->last_exchange_status == PeerStatus::OK) {
-      watermarks.push_back(peer.second->last_received.index());
+      watermarks.push_back(peer.second->last_durable_index);
     }
   }
 
@@ -848,9 +1583,10 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
     return;
   }
 
-  std::sort(watermarks.begin(), watermarks.end());
+  auto nth = watermarks.begin() + (watermarks.size() - num_peers_required);
+  std::nth_element(watermarks.begin(), nth, watermarks.end());
 
-  int64_t new_watermark = watermarks[watermarks.size() - num_peers_required];
+  int64_t new_watermark = *nth;
   int64_t old_watermark = *watermark;
   *watermark = new_watermark;
 
@@ -861,6 +1597,7 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
     for (const PeersMap::value_type& peer : peers_map_) {
       VLOG_WITH_PREFIX_UNLOCKED(3) << "Peer: " << peer.second->ToString();
     }
+    std::sort(watermarks.begin(), watermarks.end());
     VLOG_WITH_PREFIX_UNLOCKED(3) << "Sorted watermarks:";
     for (int64_t watermark : watermarks) {
       VLOG_WITH_PREFIX_UNLOCKED(3) << "Watermark: " << watermark;
@@ -882,11 +1619,14 @@ void PeerMessageQueue::EndWatchForSuccessor() {
 
 void PeerMessageQueue::UpdateFollowerWatermarks(int64_t committed_index,
                                                 int64_t all_replicated_index) {
-  std::lock_guard<simple_spinlock> l(queue_lock_);
-  DCHECK_EQ(queue_state_.mode, NON_LEADER);
-  queue_state_.committed_index = committed_index;
-  queue_state_.all_replicated_index = all_replicated_index;
-  UpdateMetricsUnlocked();
+  {
+    std::lock_guard<simple_spinlock> l(queue_lock_);
+    DCHECK_EQ(queue_state_.mode, NON_LEADER);
+    queue_state_.committed_index = committed_index;
+    queue_state_.all_replicated_index = all_replicated_index;
+    UpdateMetricsUnlocked();
+  }
+  NotifyWaiters();
 }
 
 void PeerMessageQueue::UpdateLastIndexAppendedToLeader(int64_t last_idx_appended_to_leader) {
@@ -927,6 +1667,12 @@ void PeerMessageQueue::UpdatePeerStatus(const string& peer_uuid,
       // like shutdown and failure to deserialize a protobuf. Therefore, we
       // generally consider these errors to indicate an unreachable peer.
       DCHECK(!status.ok());
+      // A request which timed out may have been too large for the link.
+      if (FLAGS_consensus_adaptive_batch_sizing && status.IsTimedOut()) {
+        peer->batch_size_bytes = std::max<int64_t>(FLAGS_consensus_adaptive_batch_min_bytes,
+                                                   BatchSizeForPeerUnlocked(*peer) / 2);
+        peer->sampled_request_last_index = -1;
+      }
       break;
 
     case PeerStatus::TABLET_NOT_FOUND:
@@ -1014,6 +1760,10 @@ void PeerMessageQueue::PromoteIfNeeded(TrackedPeer* peer, const TrackedPeer& pre
   if (s.ok() &&
       peer_pb->member_type() == RaftPeerPB::NON_VOTER &&
       peer_pb->attrs().promote()) {
+    MonoTime now = MonoTime::Now();
+    if (!peer->promotion_wait_start.Initialized()) {
+      peer->promotion_wait_start = now;
+    }
 
     // Only promote the peer if it is within one round-trip of being fully
     // caught-up with the current commit index, as measured by recent
@@ -1029,8 +1779,20 @@ void PeerMessageQueue::PromoteIfNeeded(TrackedPeer* peer, const TrackedPeer& pre
         !OpIdEquals(status.last_received_current_leader(), MinimumOpId()) &&
         status.last_received_current_leader().index() + last_batch_size
             >= queue_state_.committed_index;
-    if (!peer_caught_up) return;
+    if (!peer_caught_up) {
+      ThrottleForPromotionIfNeededUnlocked(peer, now);
+      return;
+    }
 
+    if (!peer->promotion_caught_up) {
+      peer->promotion_caught_up = true;
+      metrics_.non_voter_time_to_promote->Increment(
+          (now - peer->promotion_wait_start).ToMilliseconds());
+      // Stop throttling writes for it right away.
+      if (peer->promotion_throttle_start.Initialized()) {
+        admission_throttle_deadline_ = now;
+      }
+    }
     // TODO(mpercy): Implement a SafeToPromote() check to ensure that we only
     // try to promote a NON_VOTER to VOTER if we will be able to commit the
     // resulting config change operation.
@@ -1038,6 +1800,71 @@ void PeerMessageQueue::PromoteIfNeeded(TrackedPeer* peer, const TrackedPeer& pre
   }
 }
 
+void PeerMessageQueue::UpdateCatchupRateUnlocked(TrackedPeer* peer) {
+  DCHECK(queue_lock_.is_locked());
+  // The weight of a new sample in the rate estimate.
+  static const double kRateSampleWeight = 0.25;
+  // Responses closer together than this are folded into the same sample,
+  // since pipelined requests make the progress between them bursty.
+  static const MonoDelta kMinSampleInterval = MonoDelta::FromMilliseconds(100);
+
+  MonoTime now = MonoTime::Now();
+  int64_t lag = queue_state_.committed_index - peer->last_received.index();
+  if (!peer->catchup_sample_time.Initialized()) {
+    peer->catchup_sample_time = now;
+    peer->catchup_sample_lag = lag;
+    return;
+  }
+  MonoDelta elapsed = now - peer->catchup_sample_time;
+  if (elapsed < kMinSampleInterval) {
+    return;
+  }
+  double sample_rate = (peer->catchup_sample_lag - lag) / elapsed.ToSeconds();
+  peer->catchup_rate = kRateSampleWeight * sample_rate +
+      (1 - kRateSampleWeight) * peer->catchup_rate;
+  peer->catchup_sample_time = now;
+  peer->catchup_sample_lag = lag;
+}
+
+void PeerMessageQueue::ThrottleForPromotionIfNeededUnlocked(TrackedPeer* peer, MonoTime now) {
+  DCHECK(queue_lock_.is_locked());
+  // A NON_VOTER expected to catch up within this long is left to do so.
+  static const MonoDelta kCatchupSlack = MonoDelta::FromMilliseconds(500);
+
+  int64_t lag = queue_state_.committed_index - peer->last_received.index();
+  if (lag > FLAGS_raft_promotion_throttle_max_lag_ops ||
+      (peer->catchup_rate > 0 && lag / peer->catchup_rate < kCatchupSlack.ToSeconds())) {
+    return;
+  }
+  if (!peer->promotion_throttle_start.Initialized()) {
+    peer->promotion_throttle_start = now;
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Throttling writes until NON_VOTER " << peer->uuid()
+                                   << " catches up for promotion: it is " << lag
+                                   << " ops behind, catching up at "
+                                   << static_cast<int64_t>(peer->catchup_rate) << " ops/s";
+  } else if (now - peer->promotion_throttle_start >
+             MonoDelta::FromMilliseconds(FLAGS_raft_promotion_throttle_max_duration_ms)) {
+    return;
+  }
+  // Keep throttling until the next couple of heartbeats to the peer at most,
+  // so that the throttle lapses if it stops responding.
+  admission_throttle_deadline_ =
+      now + MonoDelta::FromMilliseconds(2 * FLAGS_raft_heartbeat_interval_ms);
+  admission_throttled_ = true;
+}
+
+MonoDelta PeerMessageQueue::GetAdmissionThrottleDelay() {
+  if (!admission_throttled_.load(std::memory_order_relaxed)) {
+    return MonoDelta();
+  }
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (queue_state_.mode != LEADER || MonoTime::Now() >= admission_throttle_deadline_) {
+    admission_throttled_ = false;
+    return MonoDelta();
+  }
+  return MonoDelta::FromMicroseconds(FLAGS_raft_promotion_throttle_delay_us);
+}
+
 void PeerMessageQueue::TransferLeadershipIfNeeded(const TrackedPeer& peer,
                                                   const ConsensusStatusPB& status) {
   DCHECK(queue_lock_.is_locked());
@@ -1057,7 +1884,7 @@ void PeerMessageQueue::TransferLeadershipIfNeeded(const TrackedPeer& peer,
   RaftPeerPB* peer_pb;
   Status s = GetRaftConfigMember(DCHECK_NOTNULL(queue_state_.active_config.get()),
                                  peer.uuid(), &peer_pb);
-  if (!s.ok() || peer_pb->member_type() != RaftPeerPB::VOTER) {
+  if (!s.ok() || peer_pb->member_type() != RaftPeerPB::VOTER || peer_pb->attrs().witness()) {
     return;
   }
 
@@ -1074,6 +1901,83 @@ void PeerMessageQueue::TransferLeadershipIfNeeded(const TrackedPeer& peer,
   NotifyObserversOfSuccessor(peer.uuid());
 }
 
+int64_t PeerMessageQueue::RemoteRegionReplicatedIndexUnlocked() const {
+  DCHECK(queue_lock_.is_locked());
+  const RaftConfigPB& config = *DCHECK_NOTNULL(queue_state_.active_config.get());
+  string leader_region;
+  for (const RaftPeerPB& peer_pb : config.peers()) {
+    if (peer_pb.permanent_uuid() == local_peer_pb_.permanent_uuid()) {
+      leader_region = peer_pb.attrs().region();
+      break;
+    }
+  }
+  bool has_remote_voters = false;
+  int64_t index = -1;
+  for (const RaftPeerPB& peer_pb : config.peers()) {
+    if (peer_pb.member_type() != RaftPeerPB::VOTER ||
+        peer_pb.attrs().region() == leader_region) {
+      continue;
+    }
+    has_remote_voters = true;
+    const TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_pb.permanent_uuid());
+    if (peer != nullptr && peer->last_exchange_status == PeerStatus::OK) {
+      index = std::max(index, peer->last_durable_index);
+    }
+  }
+  return has_remote_voters ? index : std::numeric_limits<int64_t>::max();
+}
+
+const PeerMessageQueue::TrackedPeer* PeerMessageQueue::RelayForPeerUnlocked(
+    const TrackedPeer& peer) const {
+  DCHECK(queue_lock_.is_locked());
+  const string& relay_uuid = peer.peer_pb().attrs().relay_uuid();
+  if (!FLAGS_raft_enable_relay_replication || relay_uuid.empty() ||
+      relay_uuid == local_peer_pb_.permanent_uuid()) {
+    return nullptr;
+  }
+  const TrackedPeer* relay = FindPtrOrNull(peers_map_, relay_uuid);
+  if (relay == nullptr || relay->last_exchange_status != PeerStatus::OK) {
+    return nullptr;
+  }
+  return relay;
+}
+
+Status PeerMessageQueue::ReadOpsForRelay(const OpId& preceding_id,
+                                         const OpId& last_op_id,
+                                         vector<ReplicateRefPtr>* msgs) {
+  // By the log matching property, the ops up to 'last_op_id' are those of the
+  // leader if this one is.
+  OpId local_op_id;
+  Status s = log_cache_.LookupOpId(last_op_id.index(), &local_op_id);
+  if (!s.ok() || !OpIdEquals(local_op_id, last_op_id)) {
+    return Status::NotFound(Substitute("relay does not have op $0",
+                                       OpIdToString(last_op_id)),
+                            s.ok() ? "" : s.ToString());
+  }
+  OpId local_preceding_id;
+  RETURN_NOT_OK(log_cache_.ReadOps(preceding_id.index(), FLAGS_consensus_max_batch_size_bytes,
+                                   msgs, &local_preceding_id));
+  if (PREDICT_FALSE(!OpIdEquals(local_preceding_id, preceding_id))) {
+    msgs->clear();
+    return Status::NotFound(Substitute("relay does not have op $0",
+                                       OpIdToString(preceding_id)));
+  }
+  while (!msgs->empty() && msgs->back()->get()->id().index() > last_op_id.index()) {
+    msgs->pop_back();
+  }
+  return Status::OK();
+}
+
+void PeerMessageQueue::UpdateLastDurableIndexUnlocked(TrackedPeer* peer,
+                                                      const ConsensusStatusPB& status) {
+  DCHECK(queue_lock_.is_locked());
+  // The peer's log may hold durable ops past 'last_received' which diverge
+  // from ours: these don't count.
+  peer->last_durable_index = status.has_last_durable_idx() ?
+      std::min(status.last_durable_idx(), peer->last_received.index()) :
+      peer->last_received.index();
+}
+
 bool PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                                         const ConsensusResponsePB& response) {
   DCHECK(response.IsInitialized()) << "Error: Uninitialized: "
@@ -1126,10 +2030,23 @@ bool PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
     // is guaranteed by the Raft protocol to be a valid op.
 
     bool peer_has_prefix_of_log = IsOpInLog(status.last_received());
-    if (peer_has_prefix_of_log) {
+    if (peer_has_prefix_of_log &&
+        FLAGS_consensus_max_inflight_requests_per_peer > 1 &&
+        peer->last_exchange_status == PeerStatus::OK &&
+        OpIdLessThan(status.last_received(), prev_peer_state.last_received)) {
+      // With pipelined requests, the response to an earlier request may
+      // arrive after the response to a later one: don't move the peer's
+      // progress back. Unlike an LMP mismatch, such stale responses don't
+      // mean that the peer lost any ops.
+      VLOG_WITH_PREFIX_UNLOCKED(2) << "Ignoring progress of out-of-order response from peer "
+                                   << peer_uuid << ": " << OpIdToString(status.last_received())
+                                   << " is behind " << OpIdToString(peer->last_received);
+    } else if (peer_has_prefix_of_log) {
       // If the latest thing in their log is in our log, we are in sync.
       peer->last_received = status.last_received();
       peer->next_index = peer->last_received.index() + 1;
+      UpdateLastDurableIndexUnlocked(peer, status);
+      UpdateCatchupRateUnlocked(peer);
 
       // Check if the peer is a NON_VOTER candidate ready for promotion.
       PromoteIfNeeded(peer, prev_peer_state, status);
@@ -1141,6 +2058,7 @@ bool PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
       // will cause the divergent entry in their log to be overwritten.
       peer->last_received = status.last_received_current_leader();
       peer->next_index = peer->last_received.index() + 1;
+      UpdateLastDurableIndexUnlocked(peer, status);
 
     } else {
       // The peer is divergent and they have not (successfully) received
@@ -1175,6 +2093,10 @@ bool PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
       CHECK_LE(response.responder_term(), queue_state_.current_term);
     }
 
+    if (FLAGS_consensus_adaptive_batch_sizing) {
+      UpdateBatchSizeUnlocked(peer);
+    }
+
     if (PREDICT_FALSE(VLOG_IS_ON(2))) {
       VLOG_WITH_PREFIX_UNLOCKED(2) << "Received Response from Peer (" << peer->ToString() << "). "
           << "Response: " << SecureShortDebugString(response);
@@ -1196,6 +2118,11 @@ bool PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                             /*num_peers_required=*/ queue_state_.majority_size_,
                             VOTER_REPLICAS,
                             peer);
+      if (FLAGS_raft_commit_quorum_requires_remote_region) {
+        queue_state_.majority_replicated_index =
+            std::min(queue_state_.majority_replicated_index,
+                     RemoteRegionReplicatedIndexUnlocked());
+      }
 
       // Advance the all replicated index.
       AdvanceQueueWatermark("all_replicated",
@@ -1246,13 +2173,30 @@ bool PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
     send_more_immediately = peer->last_known_committed_index < queue_state_.committed_index ||
                             log_cache_.HasOpBeenWritten(peer->next_index);
 
+    // A peer which acknowledged ops before they were durable answers the next
+    // request once they are, so send it right away to learn about it.
+    send_more_immediately |= peer->last_durable_index < peer->last_received.index();
+
+    // If the ops for the peer are still being read from disk, there's no point
+    // in sending a heartbeat right away: the peer is signaled once they are ready.
+    if (send_more_immediately &&
+        peer->last_known_committed_index >= queue_state_.committed_index) {
+      const CatchupRead* read = FindOrNull(catchup_reads_, peer->uuid());
+      if (read != nullptr && read->in_progress &&
+          read->after_op_index == peer->next_index - 1) {
+        send_more_immediately = false;
+      }
+    }
+
     log_cache_.EvictThroughOp(queue_state_.all_replicated_index);
 
     UpdateMetricsUnlocked();
+    UpdateSampledOpsUnlocked();
   }
 
   if (mode_copy == LEADER && updated_commit_index != boost::none) {
     NotifyObserversOfCommitIndexChange(*updated_commit_index);
+    NotifyWaiters();
   }
 
   return send_more_immediately;
@@ -1269,11 +2213,65 @@ int64_t PeerMessageQueue::GetAllReplicatedIndex() const {
   return queue_state_.all_replicated_index;
 }
 
+Status PeerMessageQueue::WaitForMajorityLeaseRequestTime(const MonoTime& request_time,
+                                                         const MonoTime& deadline) {
+  MutexLock l(waiters_lock_);
+  num_waiters_++;
+  SCOPED_CLEANUP({ num_waiters_--; });
+  while (true) {
+    if (!IsInLeaderMode()) {
+      return Status::IllegalState("replica is no longer the leader");
+    }
+    MonoTime majority_time = GetMajorityLeaseRequestTime();
+    if (majority_time.Initialized() && majority_time >= request_time) {
+      return Status::OK();
+    }
+    if (!waiters_cond_.WaitUntil(deadline)) {
+      return Status::TimedOut("timed out waiting for a majority to accept a request");
+    }
+  }
+}
+
+Status PeerMessageQueue::WaitForCommittedIndex(int64_t index, const MonoTime& deadline) {
+  MutexLock l(waiters_lock_);
+  num_waiters_++;
+  SCOPED_CLEANUP({ num_waiters_--; });
+  while (GetCommittedIndex() < index) {
+    if (!waiters_cond_.WaitUntil(deadline)) {
+      return Status::TimedOut(Substitute("timed out waiting for index $0 to be committed",
+                                         index));
+    }
+  }
+  return Status::OK();
+}
+
+void PeerMessageQueue::NotifyWaiters() {
+  if (num_waiters_ > 0) {
+    MutexLock l(waiters_lock_);
+    waiters_cond_.Broadcast();
+  }
+}
+
 int64_t PeerMessageQueue::GetCommittedIndex() const {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   return queue_state_.committed_index;
 }
 
+Status PeerMessageQueue::ReadCommittedOps(int64_t after_op_index,
+                                          int max_bytes,
+                                          vector<ReplicateRefPtr>* ops) {
+  int64_t committed_index = GetCommittedIndex();
+  if (after_op_index >= committed_index) {
+    return Status::OK();
+  }
+  OpId preceding_id;
+  RETURN_NOT_OK(log_cache_.ReadOps(after_op_index, max_bytes, ops, &preceding_id));
+  while (!ops->empty() && ops->back()->get()->id().index() > committed_index) {
+    ops->pop_back();
+  }
+  return Status::OK();
+}
+
 bool PeerMessageQueue::IsCommittedIndexInCurrentTerm() const {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   return queue_state_.first_index_in_current_term != boost::none &&
@@ -1285,6 +2283,69 @@ bool PeerMessageQueue::IsInLeaderMode() const {
   return queue_state_.mode == Mode::LEADER;
 }
 
+bool PeerMessageQueue::IsQuiescent() const {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (queue_state_.mode != Mode::LEADER) {
+    return false;
+  }
+  bool has_remote_peers = false;
+  for (const PeersMap::value_type& entry : peers_map_) {
+    if (entry.first == local_peer_pb_.permanent_uuid()) {
+      continue;
+    }
+    if (!entry.second->quiescent) {
+      return false;
+    }
+    has_remote_peers = true;
+  }
+  return has_remote_peers;
+}
+
+void PeerMessageQueue::UpdatePeerLeaseRequestTime(const string& uuid, MonoTime request_time) {
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+    if (PREDICT_FALSE(peer == nullptr || queue_state_.mode == NON_LEADER)) {
+      return;
+    }
+    // Responses to pipelined requests may arrive out of order.
+    if (peer->lease_request_time.Initialized() && peer->lease_request_time >= request_time) {
+      return;
+    }
+    peer->lease_request_time = request_time;
+  }
+  NotifyWaiters();
+}
+
+MonoTime PeerMessageQueue::GetMajorityLeaseRequestTime() const {
+  std::lock_guard<simple_spinlock> lock(queue_lock_);
+  if (queue_state_.mode != LEADER) {
+    return MonoTime();
+  }
+  // The local peer has voted for itself in this term.
+  int num_remote_voters_required = queue_state_.majority_size_ - 1;
+  if (num_remote_voters_required <= 0) {
+    return MonoTime::Max();
+  }
+  vector<MonoTime> request_times;
+  for (const PeersMap::value_type& entry : peers_map_) {
+    const TrackedPeer* peer = entry.second;
+    if (entry.first == local_peer_pb_.permanent_uuid() ||
+        peer->peer_pb().member_type() != RaftPeerPB::VOTER ||
+        !peer->lease_request_time.Initialized()) {
+      continue;
+    }
+    request_times.push_back(peer->lease_request_time);
+  }
+  if (static_cast<int>(request_times.size()) < num_remote_voters_required) {
+    return MonoTime();
+  }
+  // The latest time by which enough voters accepted a request.
+  std::sort(request_times.begin(), request_times.end(),
+            [](const MonoTime& a, const MonoTime& b) { return b < a; });
+  return request_times[num_remote_voters_required - 1];
+}
+
 int64_t PeerMessageQueue::GetMajorityReplicatedIndexForTests() const {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   return queue_state_.majority_replicated_index;
@@ -1302,6 +2363,10 @@ void PeerMessageQueue::UpdateMetricsUnlocked() {
     : 0);
   metrics_.num_in_progress_ops->set_value(
     queue_state_.last_appended.index() - queue_state_.committed_index);
+  if (queue_state_.mode != LEADER) {
+    metrics_.min_peer_batch_size->set_value(0);
+    metrics_.min_peer_bandwidth->set_value(0);
+  }
 
   UpdateLagMetricsUnlocked();
 }
@@ -1312,6 +2377,86 @@ void PeerMessageQueue::UpdateLagMetricsUnlocked() {
       queue_state_.last_idx_appended_to_leader - queue_state_.last_appended.index());
 }
 
+int64_t PeerMessageQueue::BatchSizeForPeerUnlocked(const TrackedPeer& peer) const {
+  DCHECK(queue_lock_.is_locked());
+  if (!FLAGS_consensus_adaptive_batch_sizing) {
+    return FLAGS_consensus_max_batch_size_bytes;
+  }
+  // The flags may have changed since the batch size was last adjusted.
+  return std::max<int64_t>(FLAGS_consensus_adaptive_batch_min_bytes,
+                           std::min<int64_t>(FLAGS_consensus_adaptive_batch_max_bytes,
+                                             peer.batch_size_bytes));
+}
+
+void PeerMessageQueue::RecordRequestSentUnlocked(TrackedPeer* peer,
+                                                 int64_t bytes,
+                                                 int64_t last_index) {
+  DCHECK(queue_lock_.is_locked());
+  peer->sampled_request_time = MonoTime::Now();
+  peer->sampled_request_bytes = bytes;
+  peer->sampled_request_last_index = last_index;
+}
+
+void PeerMessageQueue::UpdateBatchSizeUnlocked(TrackedPeer* peer) {
+  DCHECK(queue_lock_.is_locked());
+  // The weight of a new sample in the bandwidth estimate.
+  static const double kBandwidthSampleWeight = 0.25;
+  // How much longer than the fastest recent one a round trip may take before
+  // the batch size is decreased.
+  static const double kLatencyIncreaseFactor = 2.0;
+  static const MonoDelta kLatencySlack = MonoDelta::FromMilliseconds(1);
+
+  if (peer->sampled_request_last_index < 0 ||
+      peer->last_received.index() < peer->sampled_request_last_index) {
+    return;
+  }
+  MonoDelta latency = MonoTime::Now() - peer->sampled_request_time;
+  int64_t bytes = peer->sampled_request_bytes;
+  peer->sampled_request_last_index = -1;
+
+  double sample_bandwidth = bytes / std::max(latency.ToSeconds(), 1e-6);
+  peer->estimated_bandwidth = peer->estimated_bandwidth == 0 ? sample_bandwidth :
+      kBandwidthSampleWeight * sample_bandwidth +
+      (1 - kBandwidthSampleWeight) * peer->estimated_bandwidth;
+
+  // Let the base latency creep up, so that it follows a slower network path
+  // instead of shrinking batches forever.
+  if (!peer->min_latency.Initialized() || latency < peer->min_latency) {
+    peer->min_latency = latency;
+  } else {
+    peer->min_latency = MonoDelta::FromNanoseconds(peer->min_latency.ToNanoseconds() * 1.01);
+  }
+
+  int64_t min_size = FLAGS_consensus_adaptive_batch_min_bytes;
+  int64_t max_size = std::max<int64_t>(min_size, FLAGS_consensus_adaptive_batch_max_bytes);
+  int64_t batch_size = BatchSizeForPeerUnlocked(*peer);
+  if (latency.ToSeconds() >
+      kLatencyIncreaseFactor * peer->min_latency.ToSeconds() + kLatencySlack.ToSeconds()) {
+    batch_size = std::max(min_size, batch_size / 2);
+  } else if (bytes >= batch_size * 3 / 4) {
+    batch_size = std::min(max_size, batch_size + min_size);
+  }
+  if (batch_size != peer->batch_size_bytes) {
+    VLOG_WITH_PREFIX_UNLOCKED(2) << "Batch size for peer " << peer->uuid() << " changed from "
+                                 << peer->batch_size_bytes << " to " << batch_size
+                                 << " bytes after a round trip of " << latency.ToString()
+                                 << " for " << bytes << " bytes";
+    peer->batch_size_bytes = batch_size;
+  }
+
+  // Publish the figures of the slowest peer.
+  int64_t min_batch_size = std::numeric_limits<int64_t>::max();
+  double min_bandwidth = std::numeric_limits<double>::max();
+  for (const PeersMap::value_type& entry : peers_map_) {
+    const TrackedPeer* p = entry.second;
+    if (p->uuid() == local_peer_pb_.permanent_uuid()) continue;
+    min_batch_size = std::min(min_batch_size, BatchSizeForPeerUnlocked(*p));
+    min_bandwidth = std::min(min_bandwidth, p->estimated_bandwidth);
+  }
+  metrics_.min_peer_batch_size->set_value(min_batch_size);
+  metrics_.min_peer_bandwidth->set_value(static_cast<int64_t>(min_bandwidth));
+}
+
 void PeerMessageQueue::DumpToStrings(vector<string>* lines) const {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   DumpToStringsUnlocked(lines);
@@ -1328,17 +2473,67 @@ void PeerMessageQueue::DumpToStringsUnlocked(vector<string>* lines) const {
   log_cache_.DumpToStrings(lines);
 }
 
+void PeerMessageQueue::UpdateSampledOpsUnlocked() {
+  DCHECK(queue_lock_.is_locked());
+  if (sampled_ops_.empty()) {
+    return;
+  }
+  const MonoTime now = MonoTime::Now();
+  auto iter = sampled_ops_.begin();
+  while (iter != sampled_ops_.end()) {
+    const int64_t index = iter->first;
+    SampledOp* op = &iter->second;
+    const int64_t elapsed_us = (now - op->append_time).ToMicroseconds();
+    if (!op->durable && index <= queue_state_.last_durable_index) {
+      op->durable = true;
+      metrics_.op_local_append_latency->Increment(elapsed_us);
+    }
+    if (!op->majority_replicated && index <= queue_state_.majority_replicated_index) {
+      op->majority_replicated = true;
+      metrics_.op_majority_replicated_latency->Increment(elapsed_us);
+    }
+    if (index > queue_state_.committed_index) {
+      // The ops are sorted by index and are durable, replicated and committed
+      // in order.
+      if (index > queue_state_.last_durable_index &&
+          index > queue_state_.majority_replicated_index) {
+        break;
+      }
+      ++iter;
+      continue;
+    }
+    metrics_.op_commit_latency->Increment(elapsed_us);
+    iter = sampled_ops_.erase(iter);
+  }
+}
+
+void PeerMessageQueue::RecordPeerResponseTimes(const MonoTime& send_time,
+                                               const MonoTime& response_time) {
+  metrics_.peer_rpc_latency->Increment((response_time - send_time).ToMicroseconds());
+  metrics_.peer_response_queue_latency->Increment(
+      (MonoTime::Now() - response_time).ToMicroseconds());
+}
+
 void PeerMessageQueue::DumpToHtml(std::ostream& out) const {
   using std::endl;
 
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   out << "<h3>Watermarks</h3>" << endl;
   out << "<table>" << endl;;
-  out << "  <tr><th>Peer</th><th>Watermark</th></tr>" << endl;
+  out << "  <tr><th>Peer</th><th>Watermark</th><th>Batch size</th>"
+      << "<th>Estimated bandwidth</th><th>Compression ratio</th></tr>" << endl;
   for (const PeersMap::value_type& entry : peers_map_) {
-    out << Substitute("  <tr><td>$0</td><td>$1</td></tr>",
+    const TrackedPeer* peer = entry.second;
+    string compression_ratio = peer->ops_bytes_sent == 0 ? "-" :
+        StringPrintf("%.2f", static_cast<double>(peer->ops_bytes_uncompressed) /
+                             peer->ops_bytes_sent);
+    out << Substitute("  <tr><td>$0</td><td>$1</td><td>$2</td><td>$3/s</td><td>$4</td></tr>",
                       EscapeForHtmlToString(entry.first),
-                      EscapeForHtmlToString(entry.second->ToString())) << endl;
+                      EscapeForHtmlToString(peer->ToString()),
+                      HumanReadableNumBytes::ToString(BatchSizeForPeerUnlocked(*peer)),
+                      HumanReadableNumBytes::ToString(
+                          static_cast<int64_t>(peer->estimated_bandwidth)),
+                      compression_ratio) << endl;
   }
   out << "</table>" << endl;
   out << "<p>" << queue_state_.ToString() << "</p>" << endl;
@@ -1349,11 +2544,15 @@ void PeerMessageQueue::DumpToHtml(std::ostream& out) const {
 void PeerMessageQueue::ClearUnlocked() {
   DCHECK(queue_lock_.is_locked());
   STLDeleteValues(&peers_map_);
+  catchup_reads_.clear();
   queue_state_.state = kQueueClosed;
 }
 
 void PeerMessageQueue::Close() {
   raft_pool_observers_token_->Shutdown();
+  if (catchup_read_token_) {
+    catchup_read_token_->Shutdown();
+  }
 
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   ClearUnlocked();
@@ -1410,12 +2609,30 @@ bool PeerMessageQueue::IsOpInLog(const OpId& desired_op) const {
 }
 
 void PeerMessageQueue::NotifyObserversOfCommitIndexChange(int64_t new_commit_index) {
-  WARN_NOT_OK(raft_pool_observers_token_->SubmitClosure(
-      Bind(&PeerMessageQueue::NotifyObserversTask, Unretained(this),
-           [=](PeerMessageQueueObserver* observer) {
-             observer->NotifyCommitIndex(new_commit_index);
-           })),
-      LogPrefixUnlocked() + "Unable to notify RaftConsensus of commit index change.");
+  int64_t pending = pending_commit_index_.load();
+  while (pending < new_commit_index &&
+         !pending_commit_index_.compare_exchange_weak(pending, new_commit_index)) {
+  }
+  // If a notification is already queued, it will pick up the new index.
+  if (commit_notification_scheduled_.exchange(true)) {
+    return;
+  }
+  Status s = raft_pool_observers_token_->SubmitClosure(
+      Bind(&PeerMessageQueue::NotifyObserversOfCommitIndexTask, Unretained(this)));
+  if (PREDICT_FALSE(!s.ok())) {
+    commit_notification_scheduled_ = false;
+    WARN_NOT_OK(s, LogPrefixUnlocked() + "Unable to notify RaftConsensus of commit index change.");
+  }
+}
+
+void PeerMessageQueue::NotifyObserversOfCommitIndexTask() {
+  // Clear the flag before reading the index: an advance which comes later
+  // either is seen below or queues another task.
+  commit_notification_scheduled_ = false;
+  int64_t commit_index = pending_commit_index_.load();
+  NotifyObserversTask([=](PeerMessageQueueObserver* observer) {
+                        observer->NotifyCommitIndex(commit_index);
+                      });
 }
 
 void PeerMessageQueue::NotifyObserversOfTermChange(int64_t term) {
@@ -18,9 +18,12 @@
 #ifndef KUDU_CONSENSUS_CONSENSUS_QUEUE_H_
 #define KUDU_CONSENSUS_CONSENSUS_QUEUE_H_
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -37,14 +40,19 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/threading/thread_collision_warner.h"
+#include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/condition_variable.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/status.h"
 #include "kudu/util/status_callback.h"
 
 namespace kudu {
+class CompressionCodec;
 class ThreadPoolToken;
+class faststring;
 
 namespace log {
 class Log;
@@ -58,7 +66,11 @@ namespace consensus {
 class ConsensusRequestPB;
 class ConsensusResponsePB;
 class ConsensusStatusPB;
+class InstallSnapshotRequestPB;
+class InstallSnapshotResponsePB;
 class PeerMessageQueueObserver;
+class StateMachineSnapshotReader;
+class StateMachineSnapshotter;
 class TimeManager;
 class StartTabletCopyRequestPB;
 
@@ -115,6 +127,19 @@ const char* PeerStatusToString(PeerStatus p);
 // modify it.
 class PeerMessageQueue {
  public:
+  // The part of a TrackedPeer which doesn't change while the peer is tracked.
+  // It is shared by all copies of the TrackedPeer, so that taking a snapshot
+  // of a peer's progress doesn't copy its RaftPeerPB.
+  struct TrackedPeerConfig {
+    explicit TrackedPeerConfig(RaftPeerPB peer_pb);
+
+    const RaftPeerPB peer_pb;
+
+    // Throttler for how often we will log status messages pertaining to this
+    // peer (eg when it is lagging, etc).
+    const std::shared_ptr<logging::LogThrottler> status_log_throttler;
+  };
+
   struct TrackedPeer {
     explicit TrackedPeer(RaftPeerPB peer_pb);
 
@@ -131,12 +156,20 @@ class PeerMessageQueue {
     }
 
     const std::string& uuid() const {
-      return peer_pb.permanent_uuid();
+      return config->peer_pb.permanent_uuid();
+    }
+
+    const RaftPeerPB& peer_pb() const {
+      return config->peer_pb;
+    }
+
+    logging::LogThrottler* status_log_throttler() const {
+      return config->status_log_throttler.get();
     }
 
     std::string ToString() const;
 
-    RaftPeerPB peer_pb;
+    std::shared_ptr<const TrackedPeerConfig> config;
 
     // Next index to send to the peer.
     // This corresponds to "nextIndex" as specified in Raft.
@@ -171,9 +204,57 @@ class PeerMessageQueue {
     // The peer's latest overall health status.
     HealthReportPB::HealthStatus last_overall_health_status;
 
-    // Throttler for how often we will log status messages pertaining to this
-    // peer (eg when it is lagging, etc).
-    std::shared_ptr<logging::LogThrottler> status_log_throttler;
+    // The size of the batches of ops sent to the peer when
+    // --consensus_adaptive_batch_sizing is enabled.
+    int64_t batch_size_bytes;
+
+    // The estimated throughput of requests to the peer, in bytes per second,
+    // or 0 if it hasn't been measured yet.
+    double estimated_bandwidth;
+
+    // The lowest recent round-trip latency of a request to the peer.
+    MonoDelta min_latency;
+
+    // The send time, size in bytes, and index of the last op of the latest
+    // request carrying ops whose response hasn't been measured, or -1 for the
+    // index if there is no such request.
+    MonoTime sampled_request_time;
+    int64_t sampled_request_bytes;
+    int64_t sampled_request_last_index;
+
+    // The index of the last op durably written to the peer's log. This is the
+    // index of 'last_received', unless the peer acknowledges ops before they
+    // are durable. Only durable ops count towards the replicated watermarks.
+    int64_t last_durable_index;
+
+    // The bytes of ops sidecars sent to the peer, and their size before
+    // compression. Their ratio is the peer's compression ratio.
+    int64_t ops_bytes_sent;
+    int64_t ops_bytes_uncompressed;
+
+    // Whether the last request sent to the peer was a quiescent heartbeat.
+    // See --raft_enable_quiescence.
+    bool quiescent;
+
+    // The time at which the latest request that the peer accepted from this
+    // leader was sent, or uninitialized if there is none. The peer doesn't
+    // vote for other candidates for an election timeout after accepting it.
+    MonoTime lease_request_time;
+
+    // The rate, in ops per second, at which the peer closes its gap to the
+    // committed index, averaged over recent responses. Negative if it falls
+    // further behind. Sampled from the gap 'catchup_sample_lag' the peer had
+    // at 'catchup_sample_time'.
+    double catchup_rate;
+    MonoTime catchup_sample_time;
+    int64_t catchup_sample_lag;
+
+    // For a NON_VOTER marked for promotion: when the leader started waiting
+    // for it to catch up, when it started throttling writes for it, if it did,
+    // and whether it caught up.
+    MonoTime promotion_wait_start;
+    MonoTime promotion_throttle_start;
+    bool promotion_caught_up;
 
    private:
     // The last term we saw from a given peer.
@@ -217,6 +298,27 @@ class PeerMessageQueue {
   // Makes the queue untrack this peer.
   void UntrackPeer(const std::string& uuid);
 
+  // Return the ops in 'msgs', which must not be empty, serialized for an ops
+  // sidecar (see ConsensusRequestPB.ops_sidecar_idx) to send to the peer
+  // 'uuid'. The last few serialized batches are cached, so peers which are
+  // sent the same batch share a single buffer rather than each serializing it.
+  //
+  // If 'allow_compression' is true and --consensus_ops_compression_codec is
+  // set, the buffer may be compressed; '*compression' is set to the codec
+  // used, or NO_COMPRESSION. The bytes are accounted to the peer's
+  // compression ratio.
+  std::shared_ptr<const faststring> GetSerializedOps(const std::string& uuid,
+                                                     const std::vector<ReplicateRefPtr>& msgs,
+                                                     bool allow_compression,
+                                                     CompressionType* compression);
+
+  // Registers 'callback' to be run when an asynchronous catch-up read for the
+  // tracked peer 'uuid' completes (see --consensus_async_catchup_reads), so the
+  // peer can send the ops it was waiting for without waiting for its next
+  // heartbeat. The callback is run on a catch-up read thread and must not
+  // block.
+  void SetCatchupReadCallback(const std::string& uuid, std::function<void()> callback);
+
   // Returns a health report for all active peers.
   // Returns IllegalState if the local peer is not the leader of the config.
   std::unordered_map<std::string, HealthReportPB> ReportHealthOfPeers() const;
@@ -246,10 +348,19 @@ class PeerMessageQueue {
   // accordingly.
   void TruncateOpsAfter(int64_t index);
 
+  // Reset the queue of a non-leader once a snapshot of the state machine
+  // which includes the ops up to 'last_included' was installed: the next op
+  // appended must follow it.
+  void ResetAfterSnapshot(const OpId& last_included);
+
   // Return the last OpId in the log.
   // Note that this can move backwards after a truncation (TruncateOpsAfter).
   OpId GetLastOpIdInLog() const;
 
+  // Return the index of the last op durably written to the local log. This
+  // may lag the index of GetLastOpIdInLog() while appends are in progress.
+  int64_t GetLastDurableIndex() const;
+
   // Return the next OpId to be appended to the queue in the current term.
   OpId GetNextOpId() const;
 
@@ -267,18 +378,52 @@ class PeerMessageQueue {
   // that does not delete the entries. The simplest way is to pass the same
   // instance of ConsensusRequestPB to RequestForPeer(): the buffer will
   // replace the old entries with new ones without de-allocating the old
-  // ones if they are still required.
+  // ones if they are still required. The entries are kept alive by the batch
+  // set in '*msg_refs', which may be shared with the requests of other peers.
   Status RequestForPeer(const std::string& uuid,
                         ConsensusRequestPB* request,
-                        std::vector<ReplicateRefPtr>* msg_refs,
+                        ReplicateSpanPtr* msg_refs,
                         bool* needs_tablet_copy);
 
+  // Like RequestForPeer(), but assembles a request to be pipelined behind the
+  // requests already in flight to the peer, the last of which ends with the
+  // op at 'after_op_index' (see --consensus_max_inflight_requests_per_peer).
+  // Only cached ops are sent this way, and only while the peer's last exchange
+  // was successful: otherwise 'request' is left without ops, and should not be
+  // sent.
+  Status PipelinedRequestForPeer(const std::string& uuid,
+                                 int64_t after_op_index,
+                                 ConsensusRequestPB* request,
+                                 ReplicateSpanPtr* msg_refs);
+
   // Fill in a StartTabletCopyRequest for the specified peer.
   // If that peer should not initiate Tablet Copy, returns a non-OK status.
   // On success, also internally resets peer->needs_tablet_copy to false.
   Status GetTabletCopyRequestForPeer(const std::string& uuid,
                                      StartTabletCopyRequestPB* req);
 
+  // Sets the state machine snapshotter used to catch up the peers which are
+  // too far behind to be caught up from the log, or NULL to never do so.
+  // Must be called before the queue is put in leader mode.
+  void SetSnapshotter(StateMachineSnapshotter* snapshotter);
+
+  // Returns true if the peer 'uuid' can't be caught up from the log, but can
+  // be from a snapshot of the state machine.
+  bool PeerNeedsSnapshot(const std::string& uuid) const;
+
+  // Takes a snapshot of the state machine to install on the peer 'uuid', and
+  // fills in the fields of 'req' which are common to all its chunks.
+  Status StartSnapshotForPeer(const std::string& uuid,
+                              std::unique_ptr<StateMachineSnapshotReader>* reader,
+                              InstallSnapshotRequestPB* req);
+
+  // Updates the queue with the response of the peer 'uuid' to a chunk of the
+  // snapshot which includes the ops up to 'last_included'. Once the peer
+  // installed the whole snapshot, it is sent the ops which follow it.
+  void SnapshotResponseFromPeer(const std::string& uuid,
+                                const OpId& last_included,
+                                const InstallSnapshotResponsePB& response);
+
   // Inform the queue of a new status known for one of its peers.
   // 'ps' indicates an interpretation of the status, while 'status'
   // may contain a more specific error message in the case of one of
@@ -319,12 +464,59 @@ class PeerMessageQueue {
   // this index have been committed.
   int64_t GetCommittedIndex() const;
 
+  // Reads the committed ops following 'after_op_index' from the log cache, or
+  // from the log if they aren't cached, up to a total of 'max_bytes' but at
+  // least one op if there is any. See ChangeStream.
+  Status ReadCommittedOps(int64_t after_op_index,
+                          int max_bytes,
+                          std::vector<ReplicateRefPtr>* ops);
+
   // Return true if the committed index falls within the current term.
   bool IsCommittedIndexInCurrentTerm() const;
 
   // Whether the queue run in the leader mode.
   bool IsInLeaderMode() const;
 
+  // Whether the queue is in leader mode and the last requests sent to all the
+  // remote peers were quiescent heartbeats.
+  bool IsQuiescent() const;
+
+  // Reads into 'msgs' the ops following 'preceding_id', up to 'last_op_id',
+  // so that this replica can forward them as the relay of another peer.
+  // Fewer ops may be returned if they exceed the maximum batch size. Returns
+  // NotFound if this replica's log doesn't contain both ops.
+  Status ReadOpsForRelay(const OpId& preceding_id,
+                         const OpId& last_op_id,
+                         std::vector<ReplicateRefPtr>* msgs);
+
+  // Records that the peer with 'uuid' accepted a request from this leader
+  // which was sent at 'request_time'.
+  void UpdatePeerLeaseRequestTime(const std::string& uuid, MonoTime request_time);
+
+  // Returns the latest time such that a majority of the voters, counting the
+  // local peer, accepted requests this leader sent at or after it. Returns
+  // MonoTime::Max() if the local peer alone is a majority, or an uninitialized
+  // MonoTime if the queue isn't in leader mode or no majority accepted a
+  // request yet.
+  MonoTime GetMajorityLeaseRequestTime() const;
+
+  // Blocks until a majority of the voters accepted requests this leader sent
+  // at or after 'request_time', as per GetMajorityLeaseRequestTime().
+  // Returns TimedOut once 'deadline' passes, or IllegalState if the queue
+  // leaves the leader mode first.
+  Status WaitForMajorityLeaseRequestTime(const MonoTime& request_time,
+                                         const MonoTime& deadline);
+
+  // Blocks until the committed index known to this queue reaches 'index'.
+  // Returns TimedOut once 'deadline' passes.
+  Status WaitForCommittedIndex(int64_t index, const MonoTime& deadline);
+
+  // Returns how long the admission of a new write should be delayed, or an
+  // uninitialized MonoDelta if it shouldn't. Writes are delayed for a little
+  // while when a NON_VOTER marked for promotion is about to catch up but
+  // isn't closing the gap. See --raft_promotion_throttle_max_lag_ops.
+  MonoDelta GetAdmissionThrottleDelay();
+
   // Returns the current majority replicated index, for tests.
   int64_t GetMajorityReplicatedIndexForTests() const;
 
@@ -339,6 +531,14 @@ class PeerMessageQueue {
 
   void DumpToHtml(std::ostream& out) const;
 
+  // Records the timings of an update RPC to a peer, sent at 'send_time'
+  // and responded to at 'response_time', about to be processed.
+  void RecordPeerResponseTimes(const MonoTime& send_time, const MonoTime& response_time);
+
+  const Metrics& metrics() const {
+    return metrics_;
+  }
+
   void RegisterObserver(PeerMessageQueueObserver* observer);
 
   Status UnRegisterObserver(PeerMessageQueueObserver* observer);
@@ -352,6 +552,26 @@ class PeerMessageQueue {
     // Keeps track of the number of ops. behind the leader the peer is, measured as the difference
     // between the latest appended op index on this peer versus on the leader (0 if leader).
     scoped_refptr<AtomicGauge<int64_t> > num_ops_behind_leader;
+    // The smallest adaptive batch size and estimated bandwidth among the
+    // peers of a leader (see --consensus_adaptive_batch_sizing).
+    scoped_refptr<AtomicGauge<int64_t> > min_peer_batch_size;
+    scoped_refptr<AtomicGauge<int64_t> > min_peer_bandwidth;
+
+    // The stages of the replication of the ops sampled on a leader (see
+    // --raft_op_latency_sample_interval), each timed from the op's append to
+    // the queue: until it is durable in the local WAL, until a majority of
+    // the voters received it, and until it is committed.
+    scoped_refptr<Histogram> op_local_append_latency;
+    scoped_refptr<Histogram> op_majority_replicated_latency;
+    scoped_refptr<Histogram> op_commit_latency;
+    // The round trip of the update RPCs to the peers, which includes the
+    // followers preparing and logging the ops, and how long their responses
+    // then wait for the Raft thread pool.
+    scoped_refptr<Histogram> peer_rpc_latency;
+    scoped_refptr<Histogram> peer_response_queue_latency;
+    // The time from a leader starting to replicate to a NON_VOTER marked for
+    // promotion until the NON_VOTER is caught up enough to be promoted.
+    scoped_refptr<Histogram> non_voter_time_to_promote;
 
     explicit Metrics(const scoped_refptr<MetricEntity>& metric_entity);
   };
@@ -366,6 +586,7 @@ class PeerMessageQueue {
   void EndWatchForSuccessor();
 
  private:
+  FRIEND_TEST(ConsensusQueueTest, TestAdaptiveBatchSizing);
   FRIEND_TEST(ConsensusQueueTest, TestQueueAdvancesCommittedIndex);
   FRIEND_TEST(ConsensusQueueTest, TestQueueMovesWatermarksBackward);
   FRIEND_TEST(ConsensusQueueTest, TestFollowerCommittedIndexAndMetrics);
@@ -414,6 +635,14 @@ class PeerMessageQueue {
     // The opid of the last operation appended to the queue.
     OpId last_appended;
 
+    // The index of the last operation durably appended to the local log.
+    int64_t last_durable_index;
+
+    // The number of times ops appended to the queue were truncated, so that
+    // log appends which complete after their ops were truncated don't move
+    // 'last_durable_index'.
+    int64_t num_truncations;
+
     // The queue's owner current_term.
     // Set by the last appended operation.
     // If the queue owner's term is less than the term observed
@@ -425,7 +654,8 @@ class PeerMessageQueue {
     // when the first operation is appended in the new term.
     boost::optional<int64_t> first_index_in_current_term;
 
-    // The size of the majority for the queue.
+    // The size of the commit quorum for the queue: a majority unless
+    // --raft_commit_quorum_size is set.
     int majority_size_;
 
     State state;
@@ -439,6 +669,67 @@ class PeerMessageQueue {
     std::string ToString() const;
   };
 
+  // The state of the asynchronous catch-up reads for a peer.
+  struct CatchupRead {
+    CatchupRead()
+        : read_id(0),
+          after_op_index(-1),
+          in_progress(false),
+          has_result(false) {
+    }
+
+    // Identifies the last read that was started, so that a stale read
+    // completing after the peer was untracked and re-tracked is ignored.
+    int64_t read_id;
+
+    // The index after which the last read started returns ops.
+    int64_t after_op_index;
+
+    // Whether the last read is still running.
+    bool in_progress;
+
+    // Whether the last read has completed and its result below hasn't yet been
+    // handed out in a request.
+    bool has_result;
+
+    // The result of the last read.
+    Status status;
+    std::vector<ReplicateRefPtr> messages;
+    OpId preceding_id;
+
+    // See SetCatchupReadCallback().
+    std::function<void()> ready_callback;
+  };
+
+  // Return a description of the tracked peer 'uuid' for logging.
+  std::string PeerToString(const std::string& uuid) const;
+
+  // Read the ops following 'after_op_index' to send to peer 'uuid', setting
+  // '*span' to NULL if there are none. If ops which are not in the log cache
+  // are needed and asynchronous catch-up reads are enabled, this returns the
+  // result of a completed read or starts a new one, in which case it returns
+  // no messages and sets '*read_pending'. In any case '*preceding_id' is set
+  // to the OpId at 'after_op_index' on success.
+  Status ReadOpsForPeer(const std::string& uuid,
+                        int64_t after_op_index,
+                        int max_batch_size,
+                        ReplicateSpanPtr* span,
+                        OpId* preceding_id,
+                        bool* read_pending);
+
+  // Start reading the ops following 'after_op_index' for 'uuid' on the
+  // catch-up read pool, storing the result in 'read'.
+  void StartCatchupReadUnlocked(const std::string& uuid,
+                                int64_t after_op_index,
+                                int max_batch_size,
+                                CatchupRead* read);
+
+  // The body of a catch-up read started by StartCatchupReadUnlocked().
+  void CatchupReadTask(const std::string& uuid,
+                       int64_t read_id,
+                       int64_t after_op_index,
+                       int max_batch_size);
+
   // Returns true iff given 'desired_op' is found in the local WAL.
   // If the op is not found, returns false.
   // If the log cache returns some error other than NotFound, crashes with a
@@ -453,6 +744,15 @@ class PeerMessageQueue {
   // notifications.
   void UpdatePeerHealthUnlocked(TrackedPeer* peer);
 
+  // Returns the highest index replicated by a voter in another region than
+  // the leader's, or the maximum index if there is no such voter in the
+  // active config. See --raft_commit_quorum_requires_remote_region.
+  int64_t RemoteRegionReplicatedIndexUnlocked() const;
+
+  // Returns the peer through which 'peer' is fed, or nullptr if it must be
+  // sent its ops directly. See --raft_enable_relay_replication.
+  const TrackedPeer* RelayForPeerUnlocked(const TrackedPeer& peer) const;
+
   // Update the peer's last exchange status, and other fields, based on the
   // response. Sets 'lmp_mismatch' to true if the given response indicates
   // there was a log-matching property mismatch on the remote, otherwise sets
@@ -465,6 +765,14 @@ class PeerMessageQueue {
   void PromoteIfNeeded(TrackedPeer* peer, const TrackedPeer& prev_peer_state,
                        const ConsensusStatusPB& status);
 
+  // Updates the estimate of the rate at which 'peer' catches up.
+  void UpdateCatchupRateUnlocked(TrackedPeer* peer);
+
+  // Throttles writes for a little while if 'peer', a NON_VOTER marked for
+  // promotion which isn't caught up yet, is close to catching up but doesn't
+  // close the gap fast enough. See GetAdmissionThrottleDelay().
+  void ThrottleForPromotionIfNeededUnlocked(TrackedPeer* peer, MonoTime now);
+
   // If there is a graceful leadership change underway, notify queue observers
   // to initiate leadership transfer to the specified peer under the following
   // conditions:
@@ -490,6 +798,9 @@ class PeerMessageQueue {
   // Notify all PeerMessageQueueObservers using the given callback function.
   void NotifyObserversTask(const std::function<void(PeerMessageQueueObserver*)>& func);
 
+  // Notify all PeerMessageQueueObservers of 'pending_commit_index_'.
+  void NotifyObserversOfCommitIndexTask();
+
   typedef std::unordered_map<std::string, TrackedPeer*> PeersMap;
 
   std::string ToStringUnlocked() const;
@@ -501,12 +812,39 @@ class PeerMessageQueue {
   // Updates the metrics based on index math.
   void UpdateMetricsUnlocked();
 
+  // Records the stages the sampled ops went through since the last call,
+  // forgetting the ones which are committed.
+  void UpdateSampledOpsUnlocked();
+
   // Update the metric that measures how many ops behind the leader the local
   // replica believes it is (0 if leader).
   void UpdateLagMetricsUnlocked();
 
+  // The maximum size of a batch of ops to send to 'peer'.
+  int64_t BatchSizeForPeerUnlocked(const TrackedPeer& peer) const;
+
+  // Record that 'bytes' worth of ops, through the one at 'last_index', are being
+  // sent to 'peer', so that the latency and throughput of the request can be
+  // measured when the peer acknowledges them.
+  void RecordRequestSentUnlocked(TrackedPeer* peer, int64_t bytes, int64_t last_index);
+
+  // Adjust the batch size of 'peer' after a successful response, based on the
+  // latency and throughput of the request it acknowledged, if any.
+  //
+  // This is additive increase / multiplicative decrease: the batch size grows
+  // for as long as full batches are acknowledged promptly -- i.e. the peer is
+  // catching up -- and halves when the round trip takes much longer than the
+  // fastest recent one, a sign that batches are queuing up on the way to the
+  // peer and delaying the commit of newer ops.
+  void UpdateBatchSizeUnlocked(TrackedPeer* peer);
+
   void ClearUnlocked();
 
+  // Wakes up the threads blocked in WaitForMajorityLeaseRequestTime() or
+  // WaitForCommittedIndex(). Must be called without holding 'queue_lock_',
+  // after the state they wait on was updated.
+  void NotifyWaiters();
+
   // Returns the last operation in the message queue, or
   // 'preceding_first_op_in_queue_' if the queue is empty.
   const OpId& GetLastOp() const;
@@ -524,8 +862,15 @@ class PeerMessageQueue {
   // does not hold. If the queue is in NON_LEADER mode, does nothing.
   void CheckPeersInActiveConfigIfLeaderUnlocked() const;
 
+  // Updates the durable index of 'peer', whose 'last_received' was just set,
+  // from the status of its response.
+  void UpdateLastDurableIndexUnlocked(TrackedPeer* peer, const ConsensusStatusPB& status);
+
   // Callback when a REPLICATE message has finished appending to the local log.
+  // 'num_truncations' is the queue's number of truncations when it was
+  // appended.
   void LocalPeerAppendFinished(const OpId& id,
+                               int64_t num_truncations,
                                const StatusCallback& callback,
                                const Status& status);
 
@@ -555,13 +900,37 @@ class PeerMessageQueue {
 
   QueueState queue_state_;
 
+  // Scratch space for AdvanceQueueWatermark(), kept to avoid an allocation
+  // per response. Protected by 'queue_lock_'.
+  std::vector<int64_t> watermarks_scratch_;
+
   // The currently tracked peers.
   PeersMap peers_map_;
   mutable simple_spinlock queue_lock_; // TODO(todd): rename
 
+  // Protects the waits on 'waiters_cond_', which is signaled by
+  // NotifyWaiters(). Must be acquired before 'queue_lock_'.
+  Mutex waiters_lock_;
+  ConditionVariable waiters_cond_;
+  // The number of threads waiting on 'waiters_cond_', so that NotifyWaiters()
+  // only takes 'waiters_lock_' when there are any.
+  std::atomic<int> num_waiters_;
+
+  // The newest commit index to hand to the observers, and whether a task to do
+  // so is already queued on 'raft_pool_observers_token_'. Successive advances
+  // of the commit index which happen before that task runs are coalesced into
+  // it rather than each queuing a task of its own.
+  std::atomic<int64_t> pending_commit_index_;
+  std::atomic<bool> commit_notification_scheduled_;
+
   bool successor_watch_in_progress_;
   boost::optional<std::string> designated_successor_uuid_;
 
+  // Whether writes may be throttled, until 'admission_throttle_deadline_',
+  // which is protected by 'queue_lock_'. See GetAdmissionThrottleDelay().
+  std::atomic<bool> admission_throttled_;
+  MonoTime admission_throttle_deadline_;
+
   // We assume that we never have multiple threads racing to append to the queue.
   // This fake mutex adds some extra assurance that this implementation property
   // doesn't change.
@@ -569,9 +938,49 @@ class PeerMessageQueue {
 
   LogCache log_cache_;
 
+  // The catch-up reads for each peer, keyed by UUID. Protected by queue_lock_.
+  std::unordered_map<std::string, CatchupRead> catchup_reads_;
+  int64_t next_catchup_read_id_;
+
+  // The token which runs catch-up reads, or NULL if they are synchronous.
+  std::unique_ptr<ThreadPoolToken> catchup_read_token_;
+
+  // A batch of ops serialized by GetSerializedOps().
+  struct SerializedOps {
+    OpId first_id;
+    OpId last_id;
+    // Whether the batch was requested with compression allowed.
+    bool compressible;
+    std::shared_ptr<const faststring> buf;
+    // The codec 'buf' is compressed with, or NO_COMPRESSION.
+    CompressionType compression;
+    int64_t uncompressed_size;
+  };
+
+  // The most recently serialized batches, oldest first.
+  std::deque<SerializedOps> serialized_ops_;
+  simple_spinlock serialized_ops_lock_;
+
+  // The codec for ops sent to peers, or NULL if they are sent uncompressed.
+  const CompressionCodec* ops_codec_;
+
   Metrics metrics_;
 
+  // An op sampled for the latency breakdown of its replication.
+  struct SampledOp {
+    MonoTime append_time;
+    bool durable = false;
+    bool majority_replicated = false;
+  };
+
+  // The sampled ops not committed yet, keyed by index. Protected by
+  // 'queue_lock_'.
+  std::map<int64_t, SampledOp> sampled_ops_;
+
   scoped_refptr<TimeManager> time_manager_;
+
+  // See SetSnapshotter().
+  StateMachineSnapshotter* snapshotter_;
 };
 
 // The interface between RaftConsensus and the PeerMessageQueue.
@@ -24,6 +24,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -53,7 +54,11 @@
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/env.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
@@ -62,18 +67,32 @@
 DEFINE_int32(num_batches, 10000,
              "Number of batches to write to/read from the Log in TestWriteManyBatches");
 
+DECLARE_bool(log_async_segment_deletion);
+DECLARE_bool(log_inject_latency);
+DECLARE_int32(log_inject_latency_ms_mean);
+DECLARE_int32(log_inject_latency_ms_stddev);
 DECLARE_int32(log_min_segments_to_retain);
 DECLARE_int32(log_max_segments_to_retain);
+DECLARE_int64(log_max_bytes_to_retain_for_peers);
+DECLARE_int32(log_segment_pool_size);
+DECLARE_int32(log_segments_to_keep_in_wal_dir);
+DECLARE_int32(log_read_ahead_batches);
+DECLARE_int32(log_read_decode_threads);
 DECLARE_double(log_inject_io_error_on_preallocate_fraction);
 DECLARE_int64(fs_wal_dir_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
+DECLARE_string(log_archive_dir);
 DECLARE_string(log_compression_codec);
+DECLARE_bool(log_zero_copy_serialization);
+DECLARE_int32(log_segment_index_interval_batches);
+DECLARE_bool(log_mmap_closed_segments);
 
 namespace kudu {
 namespace log {
 
 using std::shared_ptr;
 using std::string;
+using std::thread;
 using std::unique_ptr;
 using std::vector;
 using consensus::CommitMsg;
@@ -82,6 +101,7 @@ using consensus::NO_OP;
 using consensus::OpId;
 using consensus::ReplicateMsg;
 using consensus::WRITE_OP;
+using pb_util::SecureShortDebugString;
 using strings::Substitute;
 
 struct TestLogSequenceElem {
@@ -177,7 +197,8 @@ class LogTestOptionalCompression : public LogTest,
     FLAGS_log_compression_codec = name;
   }
 };
-INSTANTIATE_TEST_CASE_P(Codecs, LogTestOptionalCompression, ::testing::Values(NO_COMPRESSION, LZ4));
+INSTANTIATE_TEST_CASE_P(Codecs, LogTestOptionalCompression,
+                        ::testing::Values(NO_COMPRESSION, LZ4, ZSTD));
 
 // If we write more than one entry in a batch, we should be able to
 // read all of those entries back.
@@ -249,6 +270,37 @@ TEST_P(LogTestOptionalCompression, TestFsync) {
   ASSERT_OK(log_->Close());
 }
 
+// Tests that segments written with direct I/O, which pads each write to the
+// block size, can be read back both while in progress and once closed.
+TEST_P(LogTestOptionalCompression, TestDirectIO) {
+  options_.direct_io = true;
+  options_.dsync = true;
+  Status s = BuildLog();
+  if (s.IsNotSupported() || s.posix_code() == EINVAL) {
+    LOG(INFO) << "direct I/O not supported, skipping test: " << s.ToString();
+    return;
+  }
+  ASSERT_OK(s);
+
+  OpId opid = MakeOpId(1, 1);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(AppendNoOpsToLogSync(clock_, log_.get(), &opid, 3));
+  }
+
+  SegmentSequence segments;
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  LogEntries entries;
+  ASSERT_OK(segments[0]->ReadEntries(&entries));
+  ASSERT_EQ(30, entries.size());
+
+  ASSERT_OK(log_->AllocateSegmentAndRollOver());
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  entries.clear();
+  ASSERT_OK(segments[0]->ReadEntries(&entries));
+  ASSERT_EQ(30, entries.size());
+  ASSERT_OK(log_->Close());
+}
+
 // Regression test for part of KUDU-735:
 // if a log is not preallocated, we should properly track its on-disk size as we append to
 // it.
@@ -314,6 +366,49 @@ TEST_P(LogTestOptionalCompression, TestBlankLogFile) {
   ASSERT_TRUE(entries.empty());
 }
 
+// Test that truncating the ops after an index drops them from the active
+// segment, up to the last COMMIT written after them.
+TEST_P(LogTestOptionalCompression, TestTruncateOpsAfter) {
+  ASSERT_OK(BuildLog());
+  for (int i = 1; i <= 5; i++) {
+    ASSERT_OK(AppendReplicateBatch(MakeOpId(1, i)));
+  }
+
+  // Ops 4 and 5 are abandoned, and overwritten by a new leader.
+  ASSERT_OK(log_->AsyncTruncateOpsAfter(3));
+  ASSERT_OK(AppendReplicateBatch(MakeOpId(2, 4)));
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+
+  SegmentSequence segments;
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  LogEntries entries;
+  ASSERT_OK(segments.back()->ReadEntries(&entries));
+  ASSERT_EQ(4, entries.size());
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(i + 1, entries[i]->replicate().id().index());
+  }
+  ASSERT_EQ(2, entries[3]->replicate().id().term());
+  OpId loaded_op;
+  ASSERT_OK(log_->reader()->LookupOpId(4, &loaded_op));
+  ASSERT_EQ("2.4", OpIdToString(loaded_op));
+
+  // A COMMIT written after the abandoned ops is kept, along with the ops
+  // before it.
+  ASSERT_OK(AppendReplicateBatch(MakeOpId(2, 5)));
+  ASSERT_OK(AppendCommit(MakeOpId(2, 4)));
+  ASSERT_OK(AppendReplicateBatch(MakeOpId(2, 6)));
+  ASSERT_OK(log_->AsyncTruncateOpsAfter(4));
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+
+  entries.clear();
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  ASSERT_OK(segments.back()->ReadEntries(&entries));
+  ASSERT_EQ(6, entries.size());
+  ASSERT_EQ(5, entries[4]->replicate().id().index());
+  ASSERT_EQ(COMMIT, entries[5]->type());
+  ASSERT_OK(log_->Close());
+}
+
 void LogTest::DoCorruptionTest(CorruptionType type, CorruptionPosition place,
                                const Status& expected_status, int expected_entries) {
   const int kNumEntries = 4;
@@ -731,6 +826,55 @@ TEST_P(LogTestOptionalCompression, TestLogReopenAndGC) {
   ASSERT_OK(log_anchor_registry_->Unregister(anchors[3]));
 }
 
+// Tests that --log_max_bytes_to_retain_for_peers bounds the segments retained
+// for peers, and that the segments GCed may be deleted in the background.
+TEST_F(LogTest, TestGCBoundedBytesForPeersAndAsyncDeletion) {
+  ASSERT_OK(BuildLog());
+
+  vector<LogAnchor*> anchors;
+  ElementDeleter deleter(&anchors);
+  OpId op_id = MakeOpId(1, 1);
+  ASSERT_OK(AppendMultiSegmentSequence(4, 5, &op_id, &anchors));
+  SegmentSequence segments;
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(4, segments.size());
+
+  // Only the active segment is needed for durability, but peers need all of
+  // the segments.
+  for (int i = 0; i < 3; i++) {
+    ASSERT_OK(log_anchor_registry_->Unregister(anchors[i]));
+  }
+  RetentionIndexes retention;
+  ASSERT_OK(log_anchor_registry_->GetEarliestRegisteredLogIndex(&retention.for_durability));
+  retention.for_peers = 0;
+  int num_gced_segments;
+  ASSERT_OK(log_->GC(retention, &num_gced_segments));
+  ASSERT_EQ(0, num_gced_segments);
+
+  // Bound the bytes retained for peers to all the segments but the first.
+  int64_t bytes_after_first = 0;
+  for (size_t i = 1; i < segments.size(); i++) {
+    bytes_after_first += segments[i]->file_size();
+  }
+  FLAGS_log_max_bytes_to_retain_for_peers = bytes_after_first;
+  ASSERT_OK(log_->GC(retention, &num_gced_segments));
+  ASSERT_EQ(1, num_gced_segments);
+  NO_FATALS(CheckRightNumberOfSegmentFiles(3));
+
+  // Bound them to nothing, deleting the segments in the background. Only the
+  // segment needed for durability is left once the log is closed.
+  FLAGS_log_max_bytes_to_retain_for_peers = 0;
+  FLAGS_log_async_segment_deletion = true;
+  ASSERT_OK(log_->GC(retention, &num_gced_segments));
+  ASSERT_EQ(2, num_gced_segments);
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(1, segments.size()) << DumpSegmentsToString(segments);
+  ASSERT_OK(log_->Close());
+  NO_FATALS(CheckRightNumberOfSegmentFiles(1));
+
+  ASSERT_OK(log_anchor_registry_->Unregister(anchors[3]));
+}
+
 // Helper to measure the performance of the log.
 TEST_P(LogTestOptionalCompression, TestWriteManyBatches) {
   uint64_t num_batches = 10;
@@ -766,12 +910,99 @@ TEST_P(LogTestOptionalCompression, TestWriteManyBatches) {
   }
 }
 
+// Compares the throughput of writing large REPLICATE batches to the log with
+// and without zero-copy serialization, and checks that both produce the same,
+// readable entries.
+TEST_P(LogTestOptionalCompression, TestZeroCopySerializationThroughput) {
+  const int kNumBatches = AllowSlowTests() ? 200 : 10;
+  const int kPayloadBytes = 1024 * 1024;
+  options_.segment_size_mb = 32;
+
+  for (bool zero_copy : { false, true }) {
+    FLAGS_log_zero_copy_serialization = zero_copy;
+    ASSERT_OK(BuildLog());
+
+    Random rng(SeedRandom());
+    std::string payload = RandomString(kPayloadBytes, &rng);
+    int64_t bytes_written = 0;
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < kNumBatches; i++) {
+      consensus::ReplicateRefPtr replicate =
+          consensus::make_scoped_refptr_replicate(new ReplicateMsg());
+      replicate->get()->set_op_type(WRITE_OP);
+      replicate->get()->mutable_id()->CopyFrom(MakeOpId(1, current_index_++));
+      replicate->get()->set_timestamp(clock_->Now().ToUint64());
+      tserver::WriteRequestPB* req = replicate->get()->mutable_write_request();
+      req->set_tablet_id(kTestTablet);
+      req->mutable_row_operations()->set_rows(payload);
+      bytes_written += replicate->get()->ByteSize();
+      ASSERT_OK(AppendReplicateBatch(replicate, APPEND_ASYNC));
+    }
+    ASSERT_OK(log_->WaitUntilAllFlushed());
+    sw.stop();
+    LOG(INFO) << Substitute("zero_copy=$0: wrote $1 bytes at $2 MB/sec",
+                            zero_copy, bytes_written,
+                            bytes_written / sw.elapsed().wall_seconds() / (1024 * 1024));
+    ASSERT_OK(log_->Close());
+
+    shared_ptr<LogReader> reader;
+    ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+    SegmentSequence segments;
+    ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+    entries_.clear();
+    for (const auto& segment : segments) {
+      ASSERT_OK(segment->ReadEntries(&entries_));
+    }
+    int num_replicates = 0;
+    for (const auto& entry : entries_) {
+      if (entry->type() == REPLICATE) {
+        ASSERT_EQ(payload, entry->replicate().write_request().row_operations().rows());
+        num_replicates++;
+      }
+    }
+    // The second run reopens the log of the first one, so it reads both.
+    ASSERT_EQ(kNumBatches * (zero_copy ? 2 : 1), num_replicates);
+  }
+}
+
 // This tests that querying LogReader works.
 // This sets up a reader with some segments to query which amount to the
 // following:
 // seg002: 0.10 through 0.19
 // seg003: 0.20 through 0.29
 // seg004: 0.30 through 0.39
+// Tests that reading the entries of segments with their batches decoded in
+// parallel yields the same entries, in the same order, as reading them serially.
+TEST_P(LogTestOptionalCompression, TestReadEntriesWithParallelDecoding) {
+  ASSERT_OK(BuildLog());
+  OpId op_id = MakeOpId(1, 1);
+  ASSERT_OK(AppendMultiSegmentSequence(3, 50, &op_id, nullptr));
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(3, segments.size());
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    FLAGS_log_read_decode_threads = 0;
+    LogEntries serial_entries;
+    ASSERT_OK(segment->ReadEntries(&serial_entries));
+    ASSERT_FALSE(serial_entries.empty());
+
+    FLAGS_log_read_decode_threads = 4;
+    FLAGS_log_read_ahead_batches = 3;
+    LogEntries parallel_entries;
+    ASSERT_OK(segment->ReadEntries(&parallel_entries));
+    ASSERT_EQ(serial_entries.size(), parallel_entries.size());
+    for (size_t i = 0; i < serial_entries.size(); i++) {
+      ASSERT_EQ(SecureShortDebugString(*serial_entries[i]),
+                SecureShortDebugString(*parallel_entries[i]));
+    }
+  }
+}
+
 TEST_P(LogTestOptionalCompression, TestLogReader) {
   LogReader reader(env_,
                    scoped_refptr<LogIndex>(),
@@ -818,6 +1049,53 @@ TEST_P(LogTestOptionalCompression, TestLogReaderReturnsLatestSegmentIfIndexEmpty
   ASSERT_EQ(2, entries.size());
 }
 
+// Tests that the footer of an in-progress segment can be rebuilt from its
+// sparse index, and that a sparse index which doesn't match the segment is
+// ignored.
+TEST_F(LogTest, TestRebuildFooterFromSegmentIndex) {
+  FLAGS_log_segment_index_interval_batches = 3;
+  ASSERT_OK(BuildLog());
+  OpId op_id = MakeOpId(1, 1);
+  const int kNumBatches = 10;
+  for (int i = 0; i < kNumBatches; i++) {
+    ASSERT_OK(AppendNoOps(&op_id, 1));
+  }
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+
+  SegmentSequence segments;
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  const string segment_path = segments.back()->path();
+  LogSegmentIndexCheckpointPB checkpoint;
+  ASSERT_OK(ReadLastSegmentIndexCheckpoint(env_, segment_path, &checkpoint));
+  ASSERT_EQ(9, checkpoint.footer().num_entries());
+
+  // Open the segment as if the server had crashed, rebuilding its footer both
+  // from the checkpoint and by a full scan.
+  auto rebuild_footer = [&](const LogSegmentIndexCheckpointPB* checkpoint,
+                            LogSegmentFooterPB* footer) {
+    scoped_refptr<ReadableLogSegment> segment;
+    RETURN_NOT_OK(ReadableLogSegment::Open(env_, segment_path, &segment));
+    RETURN_NOT_OK(segment->RebuildFooterByScanning(checkpoint));
+    *footer = segment->footer();
+    return Status::OK();
+  };
+  LogSegmentFooterPB scanned_footer;
+  ASSERT_OK(rebuild_footer(nullptr, &scanned_footer));
+  ASSERT_EQ(kNumBatches, scanned_footer.num_entries());
+  LogSegmentFooterPB footer;
+  ASSERT_OK(rebuild_footer(&checkpoint, &footer));
+  ASSERT_EQ(SecureShortDebugString(scanned_footer), SecureShortDebugString(footer));
+
+  // A checkpoint which doesn't line up with a batch falls back to a full scan.
+  checkpoint.set_offset(checkpoint.offset() - 1);
+  ASSERT_OK(rebuild_footer(&checkpoint, &footer));
+  ASSERT_EQ(SecureShortDebugString(scanned_footer), SecureShortDebugString(footer));
+
+  // Closing the segment writes its footer and removes the sparse index.
+  ASSERT_OK(log_->Close());
+  ASSERT_FALSE(env_->FileExists(SegmentIndexPath(segment_path)));
+}
+
 TEST_F(LogTest, TestOpIdUtils) {
   OpId id = MakeOpId(1, 2);
   ASSERT_EQ("1.2", consensus::OpIdToString(id));
@@ -1044,6 +1322,80 @@ TEST_P(LogTestOptionalCompression, TestReadReplicatesHighIndex) {
   ASSERT_GT(op_id.index(), std::numeric_limits<int32_t>::max());
 }
 
+// Tests reading replicates from memory-mapped closed segments, both from
+// segments closed by this log and from segments opened by a new reader.
+TEST_P(LogTestOptionalCompression, TestReadReplicatesFromMappedSegments) {
+  FLAGS_log_mmap_closed_segments = true;
+  const int kNumSegments = 3;
+  const int kEntriesPerSegment = 20;
+  ASSERT_OK(BuildLog());
+  OpId op_id = MakeOpId(1, 1);
+  for (int i = 0; i < kNumSegments; i++) {
+    ASSERT_OK(AppendNoOps(&op_id, kEntriesPerSegment));
+    ASSERT_OK(RollLog());
+  }
+  const int64_t last_index = op_id.index() - 1;
+
+  auto verify_reads = [&](const shared_ptr<LogReader>& reader) {
+    // Read ranges that start and end mid-segment and span segment boundaries.
+    for (int64_t start = 1; start <= last_index; start += 7) {
+      vector<ReplicateMsg*> replicates;
+      ElementDeleter deleter(&replicates);
+      ASSERT_OK(reader->ReadReplicatesInRange(start, last_index, LogReader::kNoSizeLimit,
+                                              &replicates));
+      ASSERT_EQ(last_index - start + 1, replicates.size());
+      int64_t expected_index = start;
+      for (const ReplicateMsg* replicate : replicates) {
+        ASSERT_EQ(expected_index++, replicate->id().index());
+      }
+    }
+  };
+  ASSERT_NO_FATAL_FAILURE(verify_reads(log_->reader()));
+
+  ASSERT_OK(log_->Close());
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(),
+                            make_scoped_refptr(new LogIndex(log_->log_dir_)),
+                            kTestTablet, nullptr, &reader));
+  ASSERT_NO_FATAL_FAILURE(verify_reads(reader));
+}
+
+// Tests that segments with compact entry headers and no schema can be read
+// back, both while in progress and once closed and reopened.
+TEST_P(LogTestOptionalCompression, TestCompactEntryHeadersWithoutSchema) {
+  options_.compact_entry_headers = true;
+  options_.omit_segment_schema = true;
+  ASSERT_OK(BuildLog());
+  OpId op_id = MakeOpId(1, 1);
+  ASSERT_OK(AppendNoOps(&op_id, 10));
+  ASSERT_OK(RollLog());
+  ASSERT_OK(AppendNoOps(&op_id, 10));
+
+  SegmentSequence segments;
+  ASSERT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(2, segments.size());
+  const LogSegmentHeaderPB& header = segments[0]->header();
+  ASSERT_FALSE(header.has_schema());
+  ASSERT_EQ(1, header.incompatible_features_size());
+  ASSERT_EQ(LogSegmentHeaderPB::COMPACT_ENTRY_HEADERS, header.incompatible_features(0));
+  ASSERT_LT(segments[0]->min_entry_header_size(), kEntryHeaderSizeV2);
+
+  LogEntries entries;
+  ASSERT_OK(segments[0]->ReadEntries(&entries));
+  ASSERT_EQ(10, entries.size());
+
+  ASSERT_OK(log_->Close());
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(),
+                            make_scoped_refptr(new LogIndex(log_->log_dir_)),
+                            kTestTablet, nullptr, &reader));
+  vector<ReplicateMsg*> replicates;
+  ElementDeleter deleter(&replicates);
+  ASSERT_OK(reader->ReadReplicatesInRange(1, 20, LogReader::kNoSizeLimit, &replicates));
+  ASSERT_EQ(20, replicates.size());
+  ASSERT_EQ(20, replicates.back()->id().index());
+}
+
 // Test various situations where we expect different segments depending on what the
 // min log index is.
 TEST_F(LogTest, TestGetGCableDataSize) {
@@ -1103,6 +1455,95 @@ TEST_F(LogTest, TestFailedLogPreAllocation) {
 }
 
 // Test the enforcement of reserving disk space for the log.
+// Tests that the log keeps a pool of preallocated segments to roll over to,
+// and removes it once closed.
+TEST_F(LogTest, TestSegmentPool) {
+  FLAGS_log_segment_pool_size = 2;
+  ASSERT_OK(BuildLog());
+  const string wal_dir = JoinPathSegments(fs_manager_->GetWalsRootDir(), kTestTablet);
+  const auto count_placeholders = [&] {
+    vector<string> files;
+    CHECK_OK(env_->GetChildren(wal_dir, &files));
+    return std::count_if(files.begin(), files.end(), [](const string& f) {
+      return f.find(kTmpInfix) != string::npos;
+    });
+  };
+  ASSERT_EVENTUALLY([&] {
+    ASSERT_EQ(2, count_placeholders());
+  });
+
+  // Rolling over takes a pooled segment, and the pool is refilled.
+  OpId op_id = MakeOpId(1, 1);
+  ASSERT_OK(AppendMultiSegmentSequence(4, 5, &op_id, nullptr));
+  NO_FATALS(CheckRightNumberOfSegmentFiles(4));
+  ASSERT_EVENTUALLY([&] {
+    ASSERT_EQ(2, count_placeholders());
+  });
+
+  ASSERT_OK(log_->Close());
+  ASSERT_EQ(0, count_placeholders());
+  NO_FATALS(CheckRightNumberOfSegmentFiles(4));
+}
+
+// Test that closed segments migrate to the archive directory, and remain
+// readable and GCable there.
+TEST_F(LogTest, TestMigrateSegmentsToArchiveDir) {
+  FLAGS_log_archive_dir = GetTestPath("wal-archive");
+  FLAGS_log_segments_to_keep_in_wal_dir = 1;
+  ASSERT_OK(BuildLog());
+  const string wal_dir = JoinPathSegments(fs_manager_->GetWalsRootDir(), kTestTablet);
+  const string archive_dir = GetArchiveDirForWalDir(wal_dir);
+  const auto count_segments = [&](const string& dir) {
+    vector<string> files;
+    if (!env_->FileExists(dir)) {
+      return 0;
+    }
+    CHECK_OK(env_->GetChildren(dir, &files));
+    return static_cast<int>(std::count_if(files.begin(), files.end(), IsLogFileName));
+  };
+
+  vector<LogAnchor*> anchors;
+  ElementDeleter deleter(&anchors);
+  OpId op_id = MakeOpId(1, 1);
+  ASSERT_OK(AppendMultiSegmentSequence(5, 5, &op_id, &anchors));
+
+  // All but the active segment and the most recent closed one are migrated.
+  ASSERT_EVENTUALLY([&] {
+    ASSERT_EQ(3, count_segments(archive_dir));
+    ASSERT_EQ(2, count_segments(wal_dir));
+  });
+
+  // The archived segments are GCed like the others.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK(log_anchor_registry_->Unregister(anchors[i]));
+  }
+  RetentionIndexes retention;
+  ASSERT_OK(log_anchor_registry_->GetEarliestRegisteredLogIndex(&retention.for_durability));
+  int num_gced_segments;
+  ASSERT_OK(log_->GC(retention, &num_gced_segments));
+  ASSERT_EQ(2, num_gced_segments);
+  ASSERT_EQ(1, count_segments(archive_dir));
+  ASSERT_OK(log_->Close());
+
+  // A reader finds the segments in both directories.
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(3, segments.size()) << DumpSegmentsToString(segments);
+  for (const auto& segment : segments) {
+    LogEntries entries;
+    ASSERT_OK(segment->ReadEntries(&entries));
+    ASSERT_FALSE(entries.empty());
+  }
+
+  ASSERT_OK(Log::DeleteOnDiskData(fs_manager_.get(), kTestTablet));
+  ASSERT_FALSE(env_->FileExists(archive_dir));
+  for (size_t i = 2; i < anchors.size(); i++) {
+    ASSERT_OK(log_anchor_registry_->Unregister(anchors[i]));
+  }
+}
+
 TEST_F(LogTest, TestDiskSpaceCheck) {
   FLAGS_fs_wal_dir_reserved_bytes = 1; // Keep at least 1 byte reserved in the FS.
   FLAGS_disk_reserved_bytes_free_for_testing = 0;
@@ -1140,6 +1581,130 @@ TEST_F(LogTest, TestAutoStopIdleAppendThread) {
     });
 }
 
+// Test that the adaptive group commit window only opens up when batches arrive
+// faster than groups are committed, and stays within its bounds.
+TEST_F(LogTest, TestGroupCommitWindowPolicy) {
+  const MonoDelta kMaxWindow = MonoDelta::FromMicroseconds(500);
+  GroupCommitWindowPolicy policy(kMaxWindow);
+
+  // Nothing is known yet, so there should be no waiting.
+  ASSERT_EQ(0, policy.ComputeWindow().ToMicroseconds());
+
+  // A batch every 100us, with groups taking 1ms to commit: the window should
+  // aim to collect a few more batches.
+  MonoTime now = MonoTime::Now();
+  for (int i = 0; i < 10; i++) {
+    policy.RecordArrivals(now, 1);
+    policy.RecordCommitLatency(MonoDelta::FromMilliseconds(1));
+    now += MonoDelta::FromMicroseconds(100);
+  }
+  MonoDelta window = policy.ComputeWindow();
+  ASSERT_GT(window.ToMicroseconds(), 0);
+  ASSERT_LE(window.ToMicroseconds(), kMaxWindow.ToMicroseconds());
+
+  // Once batches arrive more slowly than a group commits, the window closes.
+  for (int i = 0; i < 50; i++) {
+    now += MonoDelta::FromMilliseconds(10);
+    policy.RecordArrivals(now, 1);
+  }
+  ASSERT_EQ(0, policy.ComputeWindow().ToMicroseconds());
+}
+
+// Test that appends complete and are read back correctly with adaptive group
+// commit enabled.
+TEST_F(LogTest, TestAdaptiveGroupCommit) {
+  options_.adaptive_group_commit = true;
+  ASSERT_OK(BuildLog());
+  const int kNumBatches = 100;
+  for (int i = 0; i < kNumBatches; i++) {
+    ASSERT_OK(AppendReplicateBatch(MakeOpId(1, i + 1), APPEND_ASYNC));
+  }
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  for (const auto& segment : segments) {
+    ASSERT_OK(segment->ReadEntries(&entries_));
+  }
+  vector<uint32_t> ids;
+  EntriesToIdList(&ids);
+  ASSERT_EQ(kNumBatches, ids.size());
+  ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+}
+
+// Test that concurrent syncs of a LogGroupSyncer share syncs of the file
+// system, and that a log synced by it reads back correctly.
+TEST_F(LogTest, TestGroupSync) {
+  Status s = env_->SyncFileSystem(test_dir_);
+  if (s.IsNotSupported()) {
+    LOG(INFO) << "Skipping test: " << s.ToString();
+    return;
+  }
+  ASSERT_OK(s);
+
+  LogGroupSyncer syncer(env_, test_dir_);
+  const int kNumThreads = 8;
+  const int kSyncsPerThread = 20;
+  vector<thread> threads;
+  vector<Status> statuses(kNumThreads);
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < kSyncsPerThread && statuses[i].ok(); j++) {
+        statuses[i] = syncer.Sync();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& status : statuses) {
+    ASSERT_OK(status);
+  }
+  ASSERT_GT(syncer.num_syncs(), 0);
+  ASSERT_LE(syncer.num_syncs(), kNumThreads * kSyncsPerThread);
+
+  options_.force_fsync_all = true;
+  options_.group_sync_per_wal_dir = true;
+  ASSERT_OK(BuildLog());
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(AppendReplicateBatch(MakeOpId(1, i + 1)));
+  }
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  for (const auto& segment : segments) {
+    ASSERT_OK(segment->ReadEntries(&entries_));
+  }
+  ASSERT_EQ(10, entries_.size());
+}
+
+// Test the signals the log exposes for write admission control.
+TEST_F(LogTest, TestBackpressureSignals) {
+  ASSERT_OK(BuildLog());
+  ASSERT_EQ(0, log_->append_queue_fill());
+  ASSERT_EQ(0, log_->recent_group_commit_latency().ToMicroseconds());
+
+  // Slow syncs show up in the group commit latency.
+  FLAGS_log_inject_latency = true;
+  FLAGS_log_inject_latency_ms_mean = 10;
+  FLAGS_log_inject_latency_ms_stddev = 0;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_OK(AppendReplicateBatch(MakeOpId(1, i + 1)));
+  }
+  ASSERT_GE(log_->recent_group_commit_latency().ToMilliseconds(), 1);
+
+  // Once the log is idle, its queue is empty.
+  FLAGS_log_inject_latency = false;
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+  ASSERT_EQ(0, log_->append_queue_fill());
+}
+
 // Test that Log::TotalSize() captures creation, addition, and deletion of log segments.
 TEST_P(LogTestOptionalCompression, TestTotalSize) {
   // Build a log. There is an active segment, so on-disk size should be positive.
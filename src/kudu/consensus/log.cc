@@ -18,14 +18,20 @@
 #include "kudu/consensus/log.h"
 
 #include <cerrno>
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <set>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/range/adaptor/reversed.hpp>
 #include <gflags/gflags.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log_index.h"
@@ -33,6 +39,7 @@
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log_util.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
@@ -77,6 +84,40 @@ TAG_FLAG(log_max_segments_to_retain, runtime);
 TAG_FLAG(log_max_segments_to_retain, advanced);
 TAG_FLAG(log_max_segments_to_retain, experimental);
 
+DEFINE_int64(log_max_bytes_to_retain_for_peers, -1,
+             "The maximum size in bytes of the past log segments to keep for "
+             "the purposes of catching up other peers. Older segments needed "
+             "only by peers lagging this far behind are GCed, and such peers "
+             "are caught up by tablet copy instead. -1 means no limit other "
+             "than --log_max_segments_to_retain.");
+TAG_FLAG(log_max_bytes_to_retain_for_peers, runtime);
+TAG_FLAG(log_max_bytes_to_retain_for_peers, advanced);
+TAG_FLAG(log_max_bytes_to_retain_for_peers, experimental);
+
+DEFINE_bool(log_async_segment_deletion, false,
+            "Whether the log segments GCed are deleted by a background thread "
+            "of the log, rather than by the thread running the GC. The log "
+            "directory is synced once per batch of deleted segments.");
+TAG_FLAG(log_async_segment_deletion, runtime);
+TAG_FLAG(log_async_segment_deletion, advanced);
+TAG_FLAG(log_async_segment_deletion, experimental);
+
+
+DEFINE_int32(log_segment_pool_size, 0,
+             "The number of log segments each log keeps preallocated beyond "
+             "the next one, so that rolling over to a new segment under bursts "
+             "of writes needs not wait for the allocation of one.");
+TAG_FLAG(log_segment_pool_size, runtime);
+TAG_FLAG(log_segment_pool_size, advanced);
+TAG_FLAG(log_segment_pool_size, experimental);
+
+DEFINE_int32(log_segments_to_keep_in_wal_dir, 2,
+             "With --log_archive_dir set, the number of most recent closed log "
+             "segments kept in the WAL directory along with the active one, "
+             "rather than migrated to the archive directory. These are the "
+             "segments most likely read to catch up lagging peers.");
+TAG_FLAG(log_segments_to_keep_in_wal_dir, runtime);
+TAG_FLAG(log_segments_to_keep_in_wal_dir, experimental);
 
 // Group commit configuration.
 // -----------------------------
@@ -85,16 +126,48 @@ DEFINE_int32(group_commit_queue_size_bytes, 4 * 1024 * 1024,
 TAG_FLAG(group_commit_queue_size_bytes, advanced);
 
 
+DECLARE_int32(log_group_commit_max_window_us);
+
 DEFINE_int32(log_thread_idle_threshold_ms, 1000,
              "Number of milliseconds after which the log append thread decides that a "
              "log is idle, and considers shutting down. Used by tests.");
 TAG_FLAG(log_thread_idle_threshold_ms, experimental);
 TAG_FLAG(log_thread_idle_threshold_ms, hidden);
 
+DEFINE_bool(log_zero_copy_serialization, false,
+            "Whether REPLICATE entry batches should be written to the WAL with "
+            "scatter/gather I/O directly from the payloads of the replicated messages, "
+            "rather than first being copied into a contiguous serialization buffer. "
+            "The copy is only fully avoided when WAL compression is disabled.");
+TAG_FLAG(log_zero_copy_serialization, experimental);
+
+DEFINE_bool(log_async_writeback, false,
+            "Whether the WAL append thread should start writeback of each group of "
+            "entry batches as soon as it has been written, so that the device I/O "
+            "overlaps with preparing the next group and the subsequent sync has less "
+            "left to do");
+TAG_FLAG(log_async_writeback, experimental);
+TAG_FLAG(log_async_writeback, runtime);
+
+DEFINE_bool(log_truncate_abandoned_ops, true,
+            "Whether the ops a follower abandons when a new leader overwrites "
+            "them are truncated from the active WAL segment, rather than left "
+            "for bootstrap to skip when replaying the log.");
+TAG_FLAG(log_truncate_abandoned_ops, advanced);
+TAG_FLAG(log_truncate_abandoned_ops, runtime);
+
+DEFINE_int32(log_segment_index_interval_batches, 0,
+             "If greater than 0, the state of each in-progress WAL segment is "
+             "checkpointed to a sparse index file every this many entry batches, so "
+             "that after a crash the segment's footer can be rebuilt by scanning only "
+             "the entries following the last checkpoint. If 0, no sparse index is kept.");
+TAG_FLAG(log_segment_index_interval_batches, experimental);
+
 // Compression configuration.
 // -----------------------------
 DEFINE_string(log_compression_codec, "LZ4",
-              "Codec to use for compressing WAL segments.");
+              "Codec to use for compressing WAL segments: one of NONE, SNAPPY, "
+              "LZ4, ZLIB or ZSTD.");
 TAG_FLAG(log_compression_codec, experimental);
 
 // Fault/latency injection flags.
@@ -205,6 +278,14 @@ using strings::Substitute;
 //    ensure that it doesn't miss a concurrent wake-up. This is done in GoIdle().
 //
 // See the implementation comments in Wake() and GoIdle() for details.
+//
+// If the log is configured with 'pipelined_append', the append thread is
+// split into two stages: the append stage (the task described above) writes
+// each group to the active segment, and then hands it off to a sync stage,
+// which is another single-threaded pool responsible for syncing the segment
+// and running the group's callbacks. This lets group N+1 be serialized and
+// written while group N is being synced. Since the sync stage runs its tasks
+// in FIFO order, callbacks still run in the order the batches were appended.
 class Log::AppendThread {
  public:
   explicit AppendThread(Log* log);
@@ -227,6 +308,10 @@ class Log::AppendThread {
     return base::subtle::NoBarrier_Load(&worker_state_) == WORKER_ACTIVE;
   }
 
+  // Waits until all groups handed off to the sync stage have been synced and
+  // had their callbacks run. No-op if the log is not pipelined.
+  void WaitForSyncStage();
+
  private:
   // The task submitted to the threadpool which collects batches from the queue
   // and appends them, until it determines that the queue is idle.
@@ -238,16 +323,34 @@ class Log::AppendThread {
   // a new task was enqueued just as we were trying to go idle.
   bool GoIdle();
 
+  // Resubmits DoWork() behind the tasks of the other logs sharing the append
+  // pool, keeping the worker in WORKER_ACTIVE state.
+  void Yield();
+
+  // Waits for the window chosen by 'window_policy_' for more batches to join
+  // 'entry_batches', appending any that arrive.
+  void CoalesceGroup(vector<LogEntryBatch*>* entry_batches);
+
   // Handle the actual appending of a group of entries. Responsible for deleting the
   // LogEntryBatch* pointers.
   void HandleGroup(vector<LogEntryBatch*> entry_batches);
 
+  // Writes each batch in 'entry_batches' to the active segment. If a batch
+  // fails to be written, its callback is run with the error and reset.
+  // Returns true if the group needs to be synced, i.e. if it contains
+  // anything other than COMMIT messages.
+  bool AppendGroup(const vector<LogEntryBatch*>& entry_batches);
+
+  // Syncs the log if 'needs_sync' is true, then runs the callbacks of the batches
+  // in 'entry_batches' and deletes them.
+  void SyncAndCompleteGroup(const vector<LogEntryBatch*>& entry_batches, bool needs_sync);
+
   string LogPrefix() const;
 
   Log* const log_;
 
   // Atomic state machine for whether there is any worker task currently
-  // queued or running on append_pool_. See Wake() and GoIdle() for more details.
+  // queued or running on append_token_. See Wake() and GoIdle() for more details.
   enum WorkerState {
     // No worker task is queued or running.
     WORKER_STOPPED,
@@ -257,8 +360,24 @@ class Log::AppendThread {
   Atomic32 worker_state_ = WORKER_STOPPED;
 
   // Pool with a single thread, which handles shutting down the thread
-  // when idle.
+  // when idle. Not set if the log uses a shared append pool.
   gscoped_ptr<ThreadPool> append_pool_;
+
+  // Whether 'append_token_' belongs to a pool shared with other logs.
+  bool shared_pool_ = false;
+
+  // Serial token on which the worker task is submitted, either from
+  // 'append_pool_' or from the pool shared by the logs in the WAL root
+  // directory.
+  std::unique_ptr<ThreadPoolToken> append_token_;
+
+  // Pool with a single thread which syncs groups written by the append stage.
+  // Only set if the log is pipelined.
+  gscoped_ptr<ThreadPool> sync_pool_;
+
+  // Chooses how long to wait to coalesce batches into a group. Only set if
+  // adaptive group commit is enabled.
+  gscoped_ptr<GroupCommitWindowPolicy> window_policy_;
 };
 
 
@@ -266,30 +385,145 @@ Log::AppendThread::AppendThread(Log *log)
   : log_(log) {
 }
 
+namespace {
+
+// Returns the append pool shared by all logs under 'wal_root', creating it
+// with 'num_threads' threads if this is the first log to ask for it. The pools
+// live for the lifetime of the process.
+Status GetSharedAppendPool(const string& wal_root, int num_threads, ThreadPool** pool) {
+  static std::mutex lock;
+  static auto* pools = new std::unordered_map<string, ThreadPool*>();
+  std::lock_guard<std::mutex> l(lock);
+  ThreadPool*& shared_pool = (*pools)[wal_root];
+  if (!shared_pool) {
+    gscoped_ptr<ThreadPool> new_pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("wal-append")
+                  .set_min_threads(0)
+                  .set_max_threads(num_threads)
+                  .Build(&new_pool));
+    shared_pool = new_pool.release();
+  }
+  *pool = shared_pool;
+  return Status::OK();
+}
+
+// Returns the group syncer shared by all logs under 'wal_root', creating it if
+// this is the first log to ask for it, or nullptr if the platform can't sync
+// a whole file system. The syncers live for the lifetime of the process.
+LogGroupSyncer* GetSharedGroupSyncer(Env* env, const string& wal_root) {
+  static std::mutex lock;
+  static auto* syncers = new std::unordered_map<string, LogGroupSyncer*>();
+  std::lock_guard<std::mutex> l(lock);
+  auto it = syncers->find(wal_root);
+  if (it != syncers->end()) {
+    return it->second;
+  }
+  LogGroupSyncer* syncer = nullptr;
+  Status s = env->SyncFileSystem(wal_root);
+  if (s.IsNotSupported()) {
+    LOG(WARNING) << "Logs under " << wal_root << " are synced individually: "
+                 << s.ToString();
+  } else {
+    syncer = new LogGroupSyncer(env, wal_root);
+  }
+  (*syncers)[wal_root] = syncer;
+  return syncer;
+}
+
+// The serialized size of 'replicate' as an entry of a LogEntryBatchPB,
+// including the entry's tag and length, and the size of the LogEntryPB
+// itself, in 'entry_size'.
+size_t ReplicateEntrySize(const ReplicateRefPtr& replicate, uint32_t* entry_size) {
+  using google::protobuf::internal::WireFormatLite;
+  *entry_size = 1 + WireFormatLite::EnumSize(REPLICATE) +
+      1 + WireFormatLite::LengthDelimitedSize(replicate->byte_size());
+  return 1 + WireFormatLite::LengthDelimitedSize(*entry_size);
+}
+
+// Serializes 'replicates' to 'out' as the entries of a LogEntryBatchPB,
+// exactly as LogEntryBatchPB::SerializeWithCachedSizes() would, but using the
+// sizes cached by RefCountedReplicate::CacheSizes().
+void SerializeReplicateEntries(const vector<ReplicateRefPtr>& replicates,
+                               google::protobuf::io::CodedOutputStream* out) {
+  using google::protobuf::internal::WireFormatLite;
+  for (const ReplicateRefPtr& replicate : replicates) {
+    uint32_t entry_size;
+    ReplicateEntrySize(replicate, &entry_size);
+    WireFormatLite::WriteTag(LogEntryBatchPB::kEntryFieldNumber,
+                             WireFormatLite::WIRETYPE_LENGTH_DELIMITED, out);
+    out->WriteVarint32(entry_size);
+    WireFormatLite::WriteEnum(LogEntryPB::kTypeFieldNumber, REPLICATE, out);
+    WireFormatLite::WriteTag(LogEntryPB::kReplicateFieldNumber,
+                             WireFormatLite::WIRETYPE_LENGTH_DELIMITED, out);
+    out->WriteVarint32(replicate->byte_size());
+    replicate->get()->SerializeWithCachedSizes(out);
+  }
+}
+
+uint32_t TotalReplicateEntriesSize(const vector<ReplicateRefPtr>& replicates) {
+  uint32_t total = 0;
+  uint32_t entry_size;
+  for (const ReplicateRefPtr& replicate : replicates) {
+    total += ReplicateEntrySize(replicate, &entry_size);
+  }
+  return total;
+}
+
+} // anonymous namespace
+
 Status Log::AppendThread::Init() {
-  DCHECK(!append_pool_) << "Already initialized";
-  VLOG_WITH_PREFIX(1) << "Starting log append thread";
-  RETURN_NOT_OK(ThreadPoolBuilder("wal-append")
-                .set_min_threads(0)
-                // Only need one thread since we'll only schedule one
-                // task at a time.
-                .set_max_threads(1)
-                // No need for keeping idle threads, since the task itself
-                // handles waiting for work while idle.
-                .set_idle_timeout(MonoDelta::FromSeconds(0))
-                .Build(&append_pool_));
+  DCHECK(!append_token_) << "Already initialized";
+  if (log_->options_.append_threads_per_wal_dir > 0) {
+    VLOG_WITH_PREFIX(1) << "Using shared log append pool";
+    ThreadPool* pool;
+    RETURN_NOT_OK(GetSharedAppendPool(log_->fs_manager_->GetWalsRootDir(),
+                                      log_->options_.append_threads_per_wal_dir,
+                                      &pool));
+    shared_pool_ = true;
+    append_token_ = pool->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  } else {
+    VLOG_WITH_PREFIX(1) << "Starting log append thread";
+    RETURN_NOT_OK(ThreadPoolBuilder("wal-append")
+                  .set_min_threads(0)
+                  // Only need one thread since we'll only schedule one
+                  // task at a time.
+                  .set_max_threads(1)
+                  // No need for keeping idle threads, since the task itself
+                  // handles waiting for work while idle.
+                  .set_idle_timeout(MonoDelta::FromSeconds(0))
+                  .Build(&append_pool_));
+    append_token_ = append_pool_->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  }
+  if (log_->options_.pipelined_append) {
+    VLOG_WITH_PREFIX(1) << "Starting log sync thread";
+    RETURN_NOT_OK(ThreadPoolBuilder("wal-sync")
+                  .set_min_threads(0)
+                  // A single thread ensures groups are synced, and their
+                  // callbacks run, in the order they were written.
+                  .set_max_threads(1)
+                  .Build(&sync_pool_));
+  }
+  if (log_->options_.adaptive_group_commit) {
+    window_policy_.reset(new GroupCommitWindowPolicy(
+        MonoDelta::FromMicroseconds(FLAGS_log_group_commit_max_window_us)));
+  }
   return Status::OK();
 }
 
 void Log::AppendThread::Wake() {
-  DCHECK(append_pool_);
+  DCHECK(append_token_);
   auto old_status = base::subtle::NoBarrier_CompareAndSwap(
       &worker_state_, WORKER_STOPPED, WORKER_ACTIVE);
   if (old_status == WORKER_STOPPED) {
-    CHECK_OK(append_pool_->SubmitClosure(Bind(&Log::AppendThread::DoWork, Unretained(this))));
+    CHECK_OK(append_token_->SubmitClosure(Bind(&Log::AppendThread::DoWork, Unretained(this))));
   }
 }
 
+void Log::AppendThread::Yield() {
+  DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(worker_state_), WORKER_ACTIVE);
+  CHECK_OK(append_token_->SubmitClosure(Bind(&Log::AppendThread::DoWork, Unretained(this))));
+}
+
 bool Log::AppendThread::GoIdle() {
   // Inject latency at key points in this function for the purposes of tests.
   MAYBE_INJECT_RANDOM_LATENCY(FLAGS_log_inject_thread_lifecycle_latency_ms);
@@ -334,8 +568,13 @@ void Log::AppendThread::DoWork() {
   DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(worker_state_), WORKER_ACTIVE);
   VLOG_WITH_PREFIX(2) << "WAL Appender going active";
   while (true) {
-    MonoTime deadline = MonoTime::Now() +
-        MonoDelta::FromMilliseconds(FLAGS_log_thread_idle_threshold_ms);
+    // A shared pool thread must not sit waiting on an idle queue while other
+    // logs have work for it, so only wait for more batches if the thread is
+    // ours alone.
+    MonoTime deadline = MonoTime::Now();
+    if (!shared_pool_) {
+      deadline += MonoDelta::FromMilliseconds(FLAGS_log_thread_idle_threshold_ms);
+    }
     vector<LogEntryBatch*> entry_batches;
     Status s = log_->entry_queue()->BlockingDrainTo(&entry_batches, deadline);
     if (PREDICT_FALSE(s.IsAborted())) {
@@ -344,19 +583,81 @@ void Log::AppendThread::DoWork() {
       if (GoIdle()) break;
       continue;
     }
+    if (window_policy_) {
+      CoalesceGroup(&entry_batches);
+    }
     HandleGroup(std::move(entry_batches));
+    if (shared_pool_) {
+      // Let the other logs sharing the pool append a group before our next one.
+      Yield();
+      return;
+    }
   }
   VLOG_WITH_PREFIX(2) << "WAL Appender going idle";
 }
 
+void Log::AppendThread::CoalesceGroup(vector<LogEntryBatch*>* entry_batches) {
+  MonoDelta window = window_policy_->ComputeWindow();
+  if (log_->metrics_) {
+    log_->metrics_->group_commit_window->Increment(window.ToMicroseconds());
+  }
+  if (window.ToMicroseconds() > 0) {
+    TRACE_EVENT1("log", "CoalesceGroup", "window_us", window.ToMicroseconds());
+    MonoTime deadline = MonoTime::Now() + window;
+    while (MonoTime::Now() < deadline) {
+      // Stops early on TimedOut, or on Aborted if the log is shutting down,
+      // in which case the batches collected so far are still appended.
+      if (!log_->entry_queue()->BlockingDrainTo(entry_batches, deadline).ok()) {
+        break;
+      }
+    }
+  }
+  window_policy_->RecordArrivals(MonoTime::Now(), entry_batches->size());
+}
+
 void Log::AppendThread::HandleGroup(vector<LogEntryBatch*> entry_batches) {
   if (log_->metrics_) {
     log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
   }
   TRACE_EVENT1("log", "batch", "batch_size", entry_batches.size());
 
-  SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
+  MonoTime start = MonoTime::Now();
+  if (!sync_pool_) {
+    SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
+    bool needs_sync = AppendGroup(entry_batches);
+    SyncAndCompleteGroup(entry_batches, needs_sync);
+    MonoDelta latency = MonoTime::Now() - start;
+    if (window_policy_) {
+      window_policy_->RecordCommitLatency(latency);
+    }
+    log_->RecordGroupCommitLatency(latency);
+    return;
+  }
+
+  // When pipelined, the group commit latency spans both stages, so it is
+  // recorded by hand once the sync stage is done with the group.
+  bool needs_sync = AppendGroup(entry_batches);
+  if (log_->metrics_) {
+    log_->metrics_->sync_stage_depth->Increment();
+  }
+  CHECK_OK(sync_pool_->SubmitFunc([this, entry_batches, needs_sync, start]() {
+    SyncAndCompleteGroup(entry_batches, needs_sync);
+    MonoDelta latency = MonoTime::Now() - start;
+    if (window_policy_) {
+      window_policy_->RecordCommitLatency(latency);
+    }
+    log_->RecordGroupCommitLatency(latency);
+    if (log_->metrics_) {
+      log_->metrics_->sync_stage_depth->Decrement();
+      log_->metrics_->group_commit_latency->Increment(latency.ToMicroseconds());
+    }
+  }));
+}
 
+bool Log::AppendThread::AppendGroup(const vector<LogEntryBatch*>& entry_batches) {
+  if (log_->metrics_) {
+    log_->metrics_->append_stage_depth->IncrementBy(entry_batches.size());
+  }
   bool is_all_commits = true;
   for (LogEntryBatch* entry_batch : entry_batches) {
     TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
@@ -368,6 +669,9 @@ void Log::AppendThread::HandleGroup(vector<LogEntryBatch*> entry_batches) {
       // them to be appended? What about transactions in future
       // batches?
       if (!entry_batch->callback().is_null()) {
+        // Earlier groups may still be waiting on the sync stage; let them
+        // complete first so that callbacks keep running in append order.
+        WaitForSyncStage();
         entry_batch->callback().Run(s);
         entry_batch->callback_.Reset();
       }
@@ -375,11 +679,25 @@ void Log::AppendThread::HandleGroup(vector<LogEntryBatch*> entry_batches) {
     if (is_all_commits && entry_batch->type_ != COMMIT) {
       is_all_commits = false;
     }
+    if (log_->metrics_) {
+      log_->metrics_->append_stage_depth->Decrement();
+    }
+  }
+  if (FLAGS_log_async_writeback && !is_all_commits) {
+    WARN_NOT_OK(log_->active_segment_->StartWriteback(),
+                Substitute("$0Could not start writeback of WAL segment", LogPrefix()));
   }
+  return !is_all_commits;
+}
 
+void Log::AppendThread::SyncAndCompleteGroup(const vector<LogEntryBatch*>& entry_batches,
+                                             bool needs_sync) {
   Status s;
-  if (!is_all_commits) {
+  if (needs_sync) {
     s = log_->Sync();
+    if (log_->metrics_) {
+      log_->metrics_->entry_batches_per_sync->Increment(entry_batches.size());
+    }
   }
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX(ERROR) << "Error syncing log: " << s.ToString();
@@ -405,12 +723,26 @@ void Log::AppendThread::HandleGroup(vector<LogEntryBatch*> entry_batches) {
   }
 }
 
+void Log::AppendThread::WaitForSyncStage() {
+  if (sync_pool_) {
+    sync_pool_->Wait();
+  }
+}
+
 void Log::AppendThread::Shutdown() {
   log_->entry_queue()->Shutdown();
+  if (append_token_) {
+    append_token_->Wait();
+    append_token_->Shutdown();
+  }
   if (append_pool_) {
-    append_pool_->Wait();
     append_pool_->Shutdown();
   }
+  // The append stage is done handing off groups, so drain the sync stage.
+  if (sync_pool_) {
+    sync_pool_->Wait();
+    sync_pool_->Shutdown();
+  }
 }
 
 string Log::AppendThread::LogPrefix() const {
@@ -429,6 +761,130 @@ void Log::SegmentAllocationTask() {
   allocation_status_.Set(PreAllocateNewSegment());
 }
 
+void Log::SegmentPoolRefillTask() {
+  while (true) {
+    {
+      std::lock_guard<simple_spinlock> l(segment_pool_lock_);
+      if (static_cast<int>(segment_pool_.size()) >= FLAGS_log_segment_pool_size) {
+        return;
+      }
+    }
+    string path;
+    shared_ptr<WritableFile> file;
+    Status s = CreateAndPreAllocateSegment(&path, &file);
+    if (!s.ok()) {
+      // Segments are still allocated one at a time next time around.
+      LOG_WITH_PREFIX(WARNING) << "Unable to preallocate a pooled log segment: " << s.ToString();
+      if (!path.empty()) {
+        WARN_NOT_OK(fs_manager_->env()->DeleteFile(path),
+                    Substitute("$0Unable to delete placeholder segment", LogPrefix()));
+      }
+      return;
+    }
+    std::lock_guard<simple_spinlock> l(segment_pool_lock_);
+    segment_pool_.emplace_back(std::move(path), std::move(file));
+  }
+}
+
+bool Log::TakeSegmentFromPool(string* path, shared_ptr<WritableFile>* file) {
+  std::lock_guard<simple_spinlock> l(segment_pool_lock_);
+  if (segment_pool_.empty()) {
+    return false;
+  }
+  *path = std::move(segment_pool_.front().first);
+  *file = std::move(segment_pool_.front().second);
+  segment_pool_.pop_front();
+  return true;
+}
+
+void Log::MigrateSegmentsTask() {
+  SegmentSequence segments;
+  {
+    shared_lock<rw_spinlock> l(state_lock_.get_lock());
+    if (log_state_ != kLogWriting) {
+      return;
+    }
+    WARN_NOT_OK(reader_->GetSegmentsSnapshot(&segments),
+                Substitute("$0Unable to get log segments to migrate", LogPrefix()));
+  }
+  // The last segment is the active one.
+  int num_to_migrate = static_cast<int>(segments.size()) - 1 -
+                       std::max(FLAGS_log_segments_to_keep_in_wal_dir, 0);
+  if (num_to_migrate <= 0) {
+    return;
+  }
+  Status s = env_util::CreateDirIfMissing(fs_manager_->env(), FLAGS_log_archive_dir);
+  if (s.ok()) {
+    s = env_util::CreateDirIfMissing(fs_manager_->env(), archive_dir_);
+  }
+  if (!s.ok()) {
+    LOG_WITH_PREFIX(WARNING) << "Unable to create log archive directory " << archive_dir_
+                             << ": " << s.ToString();
+    return;
+  }
+  for (int i = 0; i < num_to_migrate; i++) {
+    const auto& segment = segments[i];
+    if (!segment->HasFooter() || DirName(segment->path()) != log_dir_) {
+      continue;
+    }
+    s = MigrateSegment(segment);
+    if (!s.ok()) {
+      // Try again after the next roll over.
+      LOG_WITH_PREFIX(WARNING) << "Unable to migrate log segment " << segment->path()
+                               << " to " << archive_dir_ << ": " << s.ToString();
+      return;
+    }
+  }
+}
+
+Status Log::MigrateSegment(const scoped_refptr<ReadableLogSegment>& segment) {
+  Env* env = fs_manager_->env();
+  const string base_name = BaseName(segment->path());
+  const string dest_path = JoinPathSegments(archive_dir_, base_name);
+  // The temporary copy is hidden from LogReader::Init(). One left behind by a
+  // crash is overwritten by the next attempt, or deleted along with the
+  // archive directory.
+  const string tmp_path = JoinPathSegments(archive_dir_,
+                                           Substitute(".$0$1", base_name, kTmpInfix));
+  WritableFileOptions opts;
+  opts.sync_on_close = true;
+  Status s = env_util::CopyFile(env, segment->path(), tmp_path, opts);
+  if (s.ok()) {
+    s = env->RenameFile(tmp_path, dest_path);
+  }
+  if (!s.ok()) {
+    WARN_NOT_OK(env->DeleteFile(tmp_path),
+                Substitute("$0Unable to delete partial copy of log segment", LogPrefix()));
+    return s;
+  }
+  RETURN_NOT_OK_PREPEND(env->SyncDir(archive_dir_), "failed to sync log archive directory");
+
+  scoped_refptr<ReadableLogSegment> archived;
+  RETURN_NOT_OK(ReadableLogSegment::Open(env, dest_path, &archived));
+  {
+    std::lock_guard<percpu_rwlock> l(state_lock_);
+    s = log_state_ == kLogWriting ? reader_->ReplaceSegment(archived)
+                                  : Status::NotFound("log is closed");
+  }
+  if (s.IsNotFound()) {
+    // The segment was GCed while being copied.
+    return env->DeleteFile(dest_path);
+  }
+  RETURN_NOT_OK(s);
+  VLOG_WITH_PREFIX(1) << "Migrated log segment " << segment->path() << " to " << dest_path;
+  return env->DeleteFile(segment->path());
+}
+
+void Log::ClearSegmentPool() {
+  string path;
+  shared_ptr<WritableFile> file;
+  while (TakeSegmentFromPool(&path, &file)) {
+    WARN_NOT_OK(file->Close(), Substitute("$0Unable to close placeholder segment", LogPrefix()));
+    WARN_NOT_OK(fs_manager_->env()->DeleteFile(path),
+                Substitute("$0Unable to delete placeholder segment", LogPrefix()));
+  }
+}
+
 const Status Log::kLogShutdownStatus(
     Status::ServiceUnavailable("WAL is shutting down", "", ESHUTDOWN));
 
@@ -469,16 +925,22 @@ Log::Log(LogOptions options, FsManager* fs_manager, string log_path,
       schema_version_(schema_version),
       active_segment_sequence_number_(0),
       log_state_(kLogInitialized),
+      batches_since_index_checkpoint_(0),
       max_segment_size_(options_.segment_size_mb * 1024 * 1024),
       entry_batch_queue_(FLAGS_group_commit_queue_size_bytes),
       append_thread_(new AppendThread(this)),
+      archive_dir_(GetArchiveDirForWalDir(log_dir_)),
       force_sync_all_(options_.force_fsync_all),
       sync_disabled_(false),
+      group_syncer_(nullptr),
       allocation_state_(kAllocationNotStarted),
       codec_(nullptr),
       metric_entity_(std::move(metric_entity)),
-      on_disk_size_(0) {
+      on_disk_size_(0),
+      group_commit_latency_us_(0) {
   CHECK_OK(ThreadPoolBuilder("log-alloc").set_max_threads(1).Build(&allocation_pool_));
+  CHECK_OK(ThreadPoolBuilder("log-delete").set_max_threads(1).Build(&deletion_pool_));
+  CHECK_OK(ThreadPoolBuilder("log-migrate").set_max_threads(1).Build(&migration_pool_));
   if (metric_entity_) {
     metrics_.reset(new LogMetrics(metric_entity_));
   }
@@ -531,6 +993,9 @@ Status Log::Init() {
   RETURN_NOT_OK(allocation_status_.Get());
   RETURN_NOT_OK(SwitchToAllocatedSegment());
 
+  if (options_.group_sync_per_wal_dir) {
+    group_syncer_ = GetSharedGroupSyncer(fs_manager_->env(), fs_manager_->GetWalsRootDir());
+  }
   RETURN_NOT_OK(append_thread_->Init());
   log_state_ = kLogWriting;
   return Status::OK();
@@ -540,9 +1005,19 @@ Status Log::AsyncAllocateSegment() {
   std::lock_guard<RWMutex> l(allocation_lock_);
   CHECK_EQ(allocation_state_, kAllocationNotStarted);
   allocation_status_.Reset();
-  allocation_state_ = kAllocationInProgress;
-  RETURN_NOT_OK(allocation_pool_->SubmitClosure(
-                  Bind(&Log::SegmentAllocationTask, Unretained(this))));
+  if (TakeSegmentFromPool(&next_segment_path_, &next_segment_file_)) {
+    // The segment is ready to be rolled over to right away.
+    allocation_state_ = kAllocationFinished;
+    allocation_status_.Set(Status::OK());
+  } else {
+    allocation_state_ = kAllocationInProgress;
+    RETURN_NOT_OK(allocation_pool_->SubmitClosure(
+                    Bind(&Log::SegmentAllocationTask, Unretained(this))));
+  }
+  if (FLAGS_log_segment_pool_size > 0) {
+    RETURN_NOT_OK(allocation_pool_->SubmitClosure(
+                    Bind(&Log::SegmentPoolRefillTask, Unretained(this))));
+  }
   return Status::OK();
 }
 
@@ -556,6 +1031,8 @@ Status Log::CloseCurrentSegment() {
 
   footer_builder_.set_close_timestamp_micros(GetCurrentTimeMicros());
   RETURN_NOT_OK(active_segment_->WriteFooterAndClose(footer_builder_));
+  WARN_NOT_OK(CloseSegmentIndex(),
+              Substitute("$0Could not remove sparse index of WAL segment", LogPrefix()));
 
   return Status::OK();
 }
@@ -568,12 +1045,21 @@ Status Log::RollOver() {
 
   DCHECK_EQ(allocation_state(), kAllocationFinished);
 
+  // The sync stage of a pipelined log may still be syncing the current
+  // segment, so let it finish before the segment is closed.
+  append_thread_->WaitForSyncStage();
+
   RETURN_NOT_OK(Sync());
   RETURN_NOT_OK(CloseCurrentSegment());
 
   RETURN_NOT_OK(SwitchToAllocatedSegment());
 
   LOG_WITH_PREFIX(INFO) << "Rolled over to a new log segment at " << active_segment_->path();
+
+  if (!archive_dir_.empty()) {
+    WARN_NOT_OK(migration_pool_->SubmitClosure(Bind(&Log::MigrateSegmentsTask, Unretained(this))),
+                Substitute("$0Unable to schedule the migration of log segments", LogPrefix()));
+  }
   return Status::OK();
 }
 
@@ -592,6 +1078,7 @@ Status Log::CreateBatchFromPB(LogEntryTypePB type,
 
 Status Log::AsyncAppend(unique_ptr<LogEntryBatch> entry_batch, const StatusCallback& callback) {
   TRACE_EVENT0("log", "Log::AsyncAppend");
+  TRACE_COUNTER_INCREMENT("wal_bytes_appended", entry_batch->total_size_bytes());
 
   entry_batch->set_callback(callback);
   TRACE_EVENT_FLOW_BEGIN0("log", "Batch", entry_batch.get());
@@ -606,11 +1093,14 @@ Status Log::AsyncAppend(unique_ptr<LogEntryBatch> entry_batch, const StatusCallb
 
 Status Log::AsyncAppendReplicates(const vector<ReplicateRefPtr>& replicates,
                                   const StatusCallback& callback) {
-  unique_ptr<LogEntryBatchPB> batch_pb = CreateBatchFromAllocatedOperations(replicates);
-
-  unique_ptr<LogEntryBatch> batch;
-  RETURN_NOT_OK(CreateBatchFromPB(REPLICATE, std::move(batch_pb), &batch));
-  batch->SetReplicates(replicates);
+  // Replicates coming through the LogCache already have their sizes cached.
+  for (const ReplicateRefPtr& replicate : replicates) {
+    replicate->CacheSizes();
+  }
+  unique_ptr<LogEntryBatch> batch(new LogEntryBatch(
+      CreateBatchFromAllocatedOperations(replicates), replicates));
+  batch->Serialize();
+  TRACE("Serialized $0 byte log entry", batch->total_size_bytes());
   return AsyncAppend(std::move(batch), callback);
 }
 
@@ -629,6 +1119,18 @@ Status Log::AsyncAppendCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
   return Status::OK();
 }
 
+Status Log::AsyncTruncateOpsAfter(int64_t index) {
+  if (!FLAGS_log_truncate_abandoned_ops) {
+    return Status::OK();
+  }
+  unique_ptr<LogEntryBatchPB> batch_pb(new LogEntryBatchPB);
+  batch_pb->add_entry()->set_type(FLUSH_MARKER);
+  unique_ptr<LogEntryBatch> batch;
+  RETURN_NOT_OK(CreateBatchFromPB(FLUSH_MARKER, std::move(batch_pb), &batch));
+  batch->truncate_after_index_ = index;
+  return AsyncAppend(std::move(batch), StatusCallback());
+}
+
 Status Log::DoAppend(LogEntryBatch* entry_batch) {
   size_t num_entries = entry_batch->count();
   DCHECK_GT(num_entries, 0) << "Cannot call DoAppend() with zero entries reserved";
@@ -636,7 +1138,11 @@ Status Log::DoAppend(LogEntryBatch* entry_batch) {
   MAYBE_RETURN_FAILURE(FLAGS_log_inject_io_error_on_append_fraction,
                        Status::IOError("Injected IOError in Log::DoAppend()"));
 
-  Slice entry_batch_data = entry_batch->data();
+  if (PREDICT_FALSE(entry_batch->truncate_after_index_)) {
+    return DoTruncateOpsAfter(*entry_batch->truncate_after_index_);
+  }
+
+  const vector<Slice>& entry_batch_data = entry_batch->data();
   uint32_t entry_batch_bytes = entry_batch->total_size_bytes();
   // If there is no data to write return OK.
   if (PREDICT_FALSE(entry_batch_bytes == 0)) {
@@ -667,6 +1173,7 @@ Status Log::DoAppend(LogEntryBatch* entry_batch) {
   LOG_SLOW_EXECUTION(WARNING, 50, Substitute("$0Append to log took a long time", LogPrefix())) {
     SCOPED_LATENCY_METRIC(metrics_, append_latency);
     SCOPED_WATCH_STACK(500);
+    fs::IOScheduler::ScopedWalIO wal_io;
 
     RETURN_NOT_OK(active_segment_->WriteEntryBatch(entry_batch_data, codec_));
 
@@ -684,10 +1191,80 @@ Status Log::DoAppend(LogEntryBatch* entry_batch) {
 
   CHECK_OK(UpdateIndexForBatch(*entry_batch, start_offset));
   UpdateFooterForBatch(entry_batch);
+  WARN_NOT_OK(MaybeCheckpointSegmentIndex(start_offset),
+              Substitute("$0Could not checkpoint WAL segment index", LogPrefix()));
 
   return Status::OK();
 }
 
+Status Log::DoTruncateOpsAfter(int64_t index) {
+  if (!footer_builder_.has_max_replicate_index() ||
+      footer_builder_.max_replicate_index() <= index) {
+    return Status::OK();
+  }
+
+  // Find the batch holding the first op to drop.
+  const bool drop_all_replicates = footer_builder_.min_replicate_index() > index;
+  int64_t offset = active_segment_->first_entry_offset();
+  if (!drop_all_replicates) {
+    LogIndexEntry index_entry;
+    Status s = log_index_->GetEntry(index + 1, &index_entry);
+    if (!s.ok() || index_entry.segment_sequence_number != active_segment_sequence_number_) {
+      VLOG_WITH_PREFIX(1) << "Not truncating ops after " << index
+                          << " from the log: op " << index + 1
+                          << " isn't indexed in the active segment";
+      return Status::OK();
+    }
+    offset = index_entry.offset_in_segment;
+  }
+
+  // The batches following it may hold entries to keep: COMMITs, and ops up to
+  // 'index' written in the same batch. Truncate after the last of those.
+  SegmentSequence segments;
+  RETURN_NOT_OK(reader_->GetSegmentsSnapshot(&segments));
+  LogEntryReader entry_reader(segments.back().get(), offset);
+  const int64_t first_offset = offset;
+  int64_t num_entries_dropped = 0;
+  while (true) {
+    unique_ptr<LogEntryPB> entry;
+    Status s = entry_reader.ReadNextEntry(&entry);
+    if (s.IsEndOfFile()) {
+      break;
+    }
+    RETURN_NOT_OK_PREPEND(s, "Unable to read the entries to truncate");
+    // The whole batch of the entry was read: the reader is past it.
+    int64_t batch_end = entry_reader.offset();
+    if (entry->type() != REPLICATE || entry->replicate().id().index() <= index) {
+      offset = batch_end;
+      num_entries_dropped = 0;
+    } else if (batch_end > offset) {
+      num_entries_dropped++;
+    }
+  }
+  if (offset == active_segment_->written_offset()) {
+    return Status::OK();
+  }
+
+  VLOG_WITH_PREFIX(1) << "Truncating ops after " << index << " from the log at offset "
+                      << offset << " of " << active_segment_->path();
+  reader_->UpdateLastSegmentOffset(offset);
+  RETURN_NOT_OK(active_segment_->Truncate(offset));
+  footer_builder_.set_num_entries(footer_builder_.num_entries() - num_entries_dropped);
+  // Unless entries were kept after the abandoned ops, the segment now ends
+  // with op 'index', if it has any op at all.
+  if (offset == first_offset) {
+    if (drop_all_replicates) {
+      footer_builder_.clear_min_replicate_index();
+      footer_builder_.clear_max_replicate_index();
+    } else {
+      footer_builder_.set_max_replicate_index(index);
+    }
+  }
+  // The checkpoints of the sparse index may point past the new end of the
+  // segment, so start it over.
+  return CloseSegmentIndex();
+}
+
 Status Log::UpdateIndexForBatch(const LogEntryBatch& batch,
                                 int64_t start_offset) {
   if (batch.type_ != REPLICATE) {
@@ -705,6 +1282,41 @@ Status Log::UpdateIndexForBatch(const LogEntryBatch& batch,
   return Status::OK();
 }
 
+Status Log::MaybeCheckpointSegmentIndex(int64_t start_offset) {
+  if (FLAGS_log_segment_index_interval_batches <= 0 ||
+      ++batches_since_index_checkpoint_ < FLAGS_log_segment_index_interval_batches) {
+    return Status::OK();
+  }
+  batches_since_index_checkpoint_ = 0;
+  if (!segment_index_) {
+    unique_ptr<RWFile> file;
+    RETURN_NOT_OK(fs_manager_->env()->NewRWFile(SegmentIndexPath(active_segment_->path()),
+                                                &file));
+    unique_ptr<pb_util::WritablePBContainerFile> index(
+        new pb_util::WritablePBContainerFile(std::move(file)));
+    RETURN_NOT_OK(index->CreateNew(LogSegmentIndexCheckpointPB()));
+    segment_index_ = std::move(index);
+  }
+  // The checkpoint need not be synced: the reader verifies it against the
+  // segment before using it.
+  LogSegmentIndexCheckpointPB checkpoint;
+  checkpoint.set_offset(active_segment_->written_offset());
+  checkpoint.set_last_batch_offset(start_offset);
+  *checkpoint.mutable_footer() = footer_builder_;
+  return segment_index_->Append(checkpoint);
+}
+
+Status Log::CloseSegmentIndex() {
+  batches_since_index_checkpoint_ = 0;
+  if (!segment_index_) {
+    return Status::OK();
+  }
+  Status s = segment_index_->Close();
+  segment_index_.reset();
+  RETURN_NOT_OK(s);
+  return fs_manager_->env()->DeleteFile(SegmentIndexPath(active_segment_->path()));
+}
+
 void Log::UpdateFooterForBatch(LogEntryBatch* batch) {
   footer_builder_.set_num_entries(footer_builder_.num_entries() + batch->count());
 
@@ -746,7 +1358,12 @@ Status Log::Sync() {
 
   if (force_sync_all_ && !sync_disabled_) {
     LOG_SLOW_EXECUTION(WARNING, 50, Substitute("$0Fsync log took a long time", LogPrefix())) {
-      RETURN_NOT_OK(active_segment_->Sync());
+      fs::IOScheduler::ScopedWalIO wal_io;
+      if (group_syncer_) {
+        RETURN_NOT_OK(group_syncer_->Sync());
+      } else {
+        RETURN_NOT_OK(active_segment_->Sync());
+      }
 
       if (log_hooks_) {
         RETURN_NOT_OK_PREPEND(log_hooks_->PostSyncIfFsyncEnabled(),
@@ -763,6 +1380,11 @@ Status Log::Sync() {
 
 int GetPrefixSizeToGC(RetentionIndexes retention_indexes, const SegmentSequence& segments) {
   int rem_segs = segments.size();
+  int64_t rem_bytes = 0;
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    rem_bytes += segment->file_size();
+  }
+  const int64_t max_bytes_for_peers = FLAGS_log_max_bytes_to_retain_for_peers;
   int prefix_size = 0;
   for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
     if (rem_segs <= FLAGS_log_min_segments_to_retain) {
@@ -778,14 +1400,17 @@ int GetPrefixSizeToGC(RetentionIndexes retention_indexes, const SegmentSequence&
     }
 
     // Check if removing this segment would compromise the ability to catch up a peer,
-    // we should retain it, unless this would break the max_segments flag.
+    // we should retain it, unless this would break the max_segments or the
+    // max_bytes flag.
     if (seg_max_idx >= retention_indexes.for_peers &&
-        rem_segs <= FLAGS_log_max_segments_to_retain) {
+        rem_segs <= FLAGS_log_max_segments_to_retain &&
+        (max_bytes_for_peers < 0 || rem_bytes <= max_bytes_for_peers)) {
       break;
     }
 
     prefix_size++;
     rem_segs--;
+    rem_bytes -= segment->file_size();
   }
   return prefix_size;
 }
@@ -849,18 +1474,17 @@ Status Log::GC(RetentionIndexes retention_indexes, int32_t* num_gced) {
     }
 
     // Now that they are no longer referenced by the Log, delete the files.
-    *num_gced = 0;
-    for (const scoped_refptr<ReadableLogSegment>& segment : segments_to_delete) {
-      string ops_str;
-      if (segment->HasFooter() && segment->footer().has_min_replicate_index()) {
-        DCHECK(segment->footer().has_max_replicate_index());
-        ops_str = Substitute(" (ops $0-$1)",
-                             segment->footer().min_replicate_index(),
-                             segment->footer().max_replicate_index());
-      }
-      LOG_WITH_PREFIX(INFO) << "Deleting log segment in path: " << segment->path() << ops_str;
-      RETURN_NOT_OK(fs_manager_->env()->DeleteFile(segment->path()));
-      (*num_gced)++;
+    if (FLAGS_log_async_segment_deletion) {
+      // Unlinking large files may stall the filesystem for long, so leave it
+      // to the deletion thread rather than holding up e.g. a maintenance
+      // thread.
+      *num_gced = segments_to_delete.size();
+      RETURN_NOT_OK(deletion_pool_->SubmitFunc([this, segments_to_delete]() {
+        WARN_NOT_OK(DeleteSegments(segments_to_delete, /*sync_dir=*/ true),
+                    Substitute("$0Failed to delete GCed log segments", LogPrefix()));
+      }));
+    } else {
+      RETURN_NOT_OK(DeleteSegments(segments_to_delete, /*sync_dir=*/ false, num_gced));
     }
 
     // Determine the minimum remaining replicate index in order to properly GC
@@ -873,6 +1497,36 @@ Status Log::GC(RetentionIndexes retention_indexes, int32_t* num_gced) {
   return Status::OK();
 }
 
+Status Log::DeleteSegments(const SegmentSequence& segments, bool sync_dir, int* num_deleted) {
+  if (num_deleted) {
+    *num_deleted = 0;
+  }
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    string ops_str;
+    if (segment->HasFooter() && segment->footer().has_min_replicate_index()) {
+      DCHECK(segment->footer().has_max_replicate_index());
+      ops_str = Substitute(" (ops $0-$1)",
+                           segment->footer().min_replicate_index(),
+                           segment->footer().max_replicate_index());
+    }
+    LOG_WITH_PREFIX(INFO) << "Deleting log segment in path: " << segment->path() << ops_str;
+    RETURN_NOT_OK(fs_manager_->env()->DeleteFile(segment->path()));
+    if (num_deleted) {
+      (*num_deleted)++;
+    }
+  }
+  if (sync_dir) {
+    std::set<string> dirs;
+    for (const auto& segment : segments) {
+      dirs.insert(DirName(segment->path()));
+    }
+    for (const auto& dir : dirs) {
+      RETURN_NOT_OK_PREPEND(fs_manager_->env()->SyncDir(dir), "failed to sync log directory");
+    }
+  }
+  return Status::OK();
+}
+
 int64_t Log::GetGCableDataSize(RetentionIndexes retention_indexes) const {
   CHECK_GE(retention_indexes.for_durability, 0);
   SegmentSequence segments_to_delete;
@@ -929,6 +1583,29 @@ int64_t Log::OnDiskSize() {
   return ret;
 }
 
+int64_t Log::bytes_logged() const {
+  return metrics_ ? metrics_->bytes_logged->value() : 0;
+}
+
+double Log::append_queue_fill() const {
+  return std::min(1.0, static_cast<double>(entry_batch_queue_.size()) /
+                       entry_batch_queue_.max_size());
+}
+
+MonoDelta Log::recent_group_commit_latency() const {
+  return MonoDelta::FromMicroseconds(group_commit_latency_us_.load(std::memory_order_relaxed));
+}
+
+void Log::RecordGroupCommitLatency(MonoDelta latency) {
+  // The weight of a new sample in the average.
+  static const double kSampleWeight = 0.1;
+  int64_t average = group_commit_latency_us_.load(std::memory_order_relaxed);
+  group_commit_latency_us_.store(
+      static_cast<int64_t>(kSampleWeight * latency.ToMicroseconds() +
+                           (1 - kSampleWeight) * average),
+      std::memory_order_relaxed);
+}
+
 void Log::SetSchemaForNextLogSegment(const Schema& schema,
                                      uint32_t version) {
   std::lock_guard<rw_spinlock> l(schema_lock_);
@@ -938,6 +1615,15 @@ void Log::SetSchemaForNextLogSegment(const Schema& schema,
 
 Status Log::Close() {
   allocation_pool_->Shutdown();
+  // Nobody is going to roll over to the pooled segments anymore.
+  ClearSegmentPool();
+  // A migration in progress finishes with the segment in either directory.
+  migration_pool_->Wait();
+  migration_pool_->Shutdown();
+  // Let the pending segment deletions finish, so that the files are gone once
+  // the log is closed.
+  deletion_pool_->Wait();
+  deletion_pool_->Shutdown();
   append_thread_->Shutdown();
 
   std::lock_guard<percpu_rwlock> l(state_lock_);
@@ -980,6 +1666,13 @@ bool Log::HasOnDiskData(FsManager* fs_manager, const string& tablet_id) {
 Status Log::DeleteOnDiskData(FsManager* fs_manager, const string& tablet_id) {
   string wal_dir = fs_manager->GetTabletWalDir(tablet_id);
   Env* env = fs_manager->env();
+  // Delete the archived segments first, so that the directory is not left
+  // behind should the server crash in between.
+  const string archive_dir = GetArchiveDirForWalDir(wal_dir);
+  if (!archive_dir.empty() && env->FileExists(archive_dir)) {
+    RETURN_NOT_OK_PREPEND(env->DeleteRecursively(archive_dir),
+                          "Unable to recursively delete WAL archive dir for tablet " + tablet_id);
+  }
   if (!env->FileExists(wal_dir)) {
     return Status::OK();
   }
@@ -1007,6 +1700,15 @@ Status Log::RemoveRecoveryDirIfExists(FsManager* fs_manager, const string& table
   RETURN_NOT_OK_PREPEND(fs_manager->env()->RenameFile(recovery_path, tmp_path),
                         Substitute("Could not rename old recovery dir from: $0 to: $1",
                                    recovery_path, tmp_path));
+  // The segments of the recovery dir migrated to the archive go along.
+  const string archive_recovery_path = GetArchiveDirForWalDir(recovery_path);
+  string archive_tmp_path;
+  if (!archive_recovery_path.empty() && fs_manager->env()->FileExists(archive_recovery_path)) {
+    archive_tmp_path = GetArchiveDirForWalDir(tmp_path);
+    RETURN_NOT_OK_PREPEND(fs_manager->env()->RenameFile(archive_recovery_path, archive_tmp_path),
+                          Substitute("Could not rename old archived recovery dir from: $0 to: $1",
+                                     archive_recovery_path, archive_tmp_path));
+  }
 
   if (FLAGS_skip_remove_old_recovery_dir) {
     LOG(INFO) << kLogPrefix << "--skip_remove_old_recovery_dir enabled. NOT deleting " << tmp_path;
@@ -1015,6 +1717,10 @@ Status Log::RemoveRecoveryDirIfExists(FsManager* fs_manager, const string& table
   VLOG(1) << kLogPrefix << "Deleting all files from renamed log recovery directory " << tmp_path;
   RETURN_NOT_OK_PREPEND(fs_manager->env()->DeleteRecursively(tmp_path),
                         "Could not remove renamed recovery dir " + tmp_path);
+  if (!archive_tmp_path.empty()) {
+    RETURN_NOT_OK_PREPEND(fs_manager->env()->DeleteRecursively(archive_tmp_path),
+                          "Could not remove renamed archived recovery dir " + archive_tmp_path);
+  }
   VLOG(1) << kLogPrefix << "Completed deletion of old log recovery files and directory "
           << tmp_path;
   return Status::OK();
@@ -1030,22 +1736,32 @@ Status Log::PreAllocateNewSegment() {
     allocation_state_ = kAllocationFinished;
   });
 
+  // The pool may have been refilled since the allocation began.
+  if (TakeSegmentFromPool(&next_segment_path_, &next_segment_file_)) {
+    return Status::OK();
+  }
+  return CreateAndPreAllocateSegment(&next_segment_path_, &next_segment_file_);
+}
+
+Status Log::CreateAndPreAllocateSegment(string* path, shared_ptr<WritableFile>* file) {
   WritableFileOptions opts;
   opts.sync_on_close = force_sync_all_;
-  RETURN_NOT_OK(CreatePlaceholderSegment(opts, &next_segment_path_, &next_segment_file_));
+  opts.direct_io = options_.direct_io;
+  opts.dsync = options_.dsync;
+  RETURN_NOT_OK(CreatePlaceholderSegment(opts, path, file));
 
   MAYBE_RETURN_FAILURE(FLAGS_log_inject_io_error_on_preallocate_fraction,
                        Status::IOError("Injected IOError in Log::PreAllocateNewSegment()"));
 
   if (options_.preallocate_segments) {
-    TRACE("Preallocating $0 byte segment in $1", max_segment_size_, next_segment_path_);
+    TRACE("Preallocating $0 byte segment in $1", max_segment_size_, *path);
     RETURN_NOT_OK(env_util::VerifySufficientDiskSpace(fs_manager_->env(),
-                                                      next_segment_path_,
+                                                      *path,
                                                       max_segment_size_,
                                                       FLAGS_fs_wal_dir_reserved_bytes));
     // TODO (perf) zero the new segments -- this could result in
     // additional performance improvements.
-    RETURN_NOT_OK(next_segment_file_->PreAllocate(max_segment_size_));
+    RETURN_NOT_OK((*file)->PreAllocate(max_segment_size_));
   }
 
   return Status::OK();
@@ -1077,6 +1793,9 @@ Status Log::SwitchToAllocatedSegment() {
   if (codec_) {
     header.set_compression_codec(codec_->type());
   }
+  if (options_.compact_entry_headers) {
+    header.add_incompatible_features(LogSegmentHeaderPB::COMPACT_ENTRY_HEADERS);
+  }
 
   // Set up the new footer. This will be maintained as the segment is written.
   footer_builder_.Clear();
@@ -1084,7 +1803,7 @@ Status Log::SwitchToAllocatedSegment() {
 
 
   // Set the new segment's schema.
-  {
+  if (!options_.omit_segment_schema) {
     shared_lock<rw_spinlock> l(schema_lock_);
     RETURN_NOT_OK(SchemaToPB(schema_, header.mutable_schema()));
     header.set_schema_version(schema_version_);
@@ -1174,6 +1893,16 @@ LogEntryBatch::LogEntryBatch(LogEntryTypePB type,
       count_(count) {
 }
 
+LogEntryBatch::LogEntryBatch(unique_ptr<LogEntryBatchPB> entry_batch_pb,
+                             vector<ReplicateRefPtr> replicates)
+    : type_(REPLICATE),
+      entry_batch_pb_(std::move(entry_batch_pb)),
+      total_size_bytes_(TotalReplicateEntriesSize(replicates)),
+      count_(replicates.size()),
+      replicates_(std::move(replicates)) {
+  DCHECK_EQ(count_, entry_batch_pb_->entry_size());
+}
+
 LogEntryBatch::~LogEntryBatch() {
   if (type_ == REPLICATE && entry_batch_pb_) {
     for (LogEntryPB& entry : *entry_batch_pb_->mutable_entry()) {
@@ -1186,12 +1915,45 @@ LogEntryBatch::~LogEntryBatch() {
 
 void LogEntryBatch::Serialize() {
   DCHECK_EQ(buffer_.size(), 0);
+  DCHECK(data_.empty());
   // FLUSH_MARKER LogEntries are markers and are not serialized.
   if (PREDICT_FALSE(count() == 1 && entry_batch_pb_->entry(0).type() == FLUSH_MARKER)) {
     return;
   }
-  buffer_.reserve(total_size_bytes_);
-  pb_util::AppendToString(*entry_batch_pb_, &buffer_);
+  DCHECK(entry_batch_pb_->IsInitialized());
+
+  // The sizes of the entries were computed, and cached, either by the
+  // ByteSize() call in the constructor or, for replicates, when they were
+  // appended to the LogCache, so serialize without traversing them again.
+  if (type_ == REPLICATE && FLAGS_log_zero_copy_serialization) {
+    aliased_buffer_.reset(new SliceOutputStream());
+    {
+      google::protobuf::io::CodedOutputStream out(aliased_buffer_.get());
+      out.EnableAliasing(true);
+      if (!replicates_.empty()) {
+        SerializeReplicateEntries(replicates_, &out);
+      } else {
+        entry_batch_pb_->SerializeWithCachedSizes(&out);
+      }
+      CHECK(!out.HadError());
+    }
+    DCHECK_EQ(total_size_bytes_, static_cast<uint32_t>(aliased_buffer_->ByteCount()));
+    data_ = aliased_buffer_->slices();
+    return;
+  }
+
+  buffer_.resize(total_size_bytes_);
+  if (!replicates_.empty()) {
+    google::protobuf::io::ArrayOutputStream array_out(buffer_.data(), total_size_bytes_);
+    google::protobuf::io::CodedOutputStream out(&array_out);
+    SerializeReplicateEntries(replicates_, &out);
+    CHECK(!out.HadError());
+    DCHECK_EQ(total_size_bytes_, static_cast<uint32_t>(out.ByteCount()));
+  } else {
+    uint8_t* end = entry_batch_pb_->SerializeWithCachedSizesToArray(buffer_.data());
+    DCHECK_EQ(total_size_bytes_, static_cast<uint32_t>(end - buffer_.data()));
+  }
+  data_.emplace_back(buffer_);
 }
 
 
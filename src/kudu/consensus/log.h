@@ -21,12 +21,15 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <boost/optional/optional.hpp>
 #include <glog/logging.h>
 #include <gtest/gtest_prod.h>
 
@@ -40,7 +43,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
-#include "kudu/util/blocking_queue.h"
+#include "kudu/util/mpsc_blocking_queue.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/promise.h"
@@ -58,6 +61,10 @@ class ThreadPool;
 class WritableFile;
 struct WritableFileOptions;
 
+namespace pb_util {
+class WritablePBContainerFile;
+} // namespace pb_util
+
 namespace log {
 
 struct LogEntryBatchLogicalSize;
@@ -67,7 +74,7 @@ class LogEntryBatch;
 class LogIndex;
 class LogReader;
 
-typedef BlockingQueue<LogEntryBatch*, LogEntryBatchLogicalSize> LogEntryBatchQueue;
+typedef MpscBlockingQueue<LogEntryBatch*, LogEntryBatchLogicalSize> LogEntryBatchQueue;
 
 // Log interface, inspired by Raft's (logcabin) Log. Provides durability to
 // Kudu as a normal Write Ahead Log and also plays the role of persistent
@@ -118,6 +125,17 @@ class Log : public RefCountedThreadSafe<Log> {
                            const StatusCallback& callback);
 
 
+  // Asynchronously drops the REPLICATE entries with indexes greater than
+  // 'index' from the active segment, once the entries appended before are
+  // written, so that neither replay nor reads of the log come across these
+  // abandoned ops. The log is truncated from the first batch holding such an
+  // op, or from the batch following the last entry to keep in the segment if
+  // any is written after it. Abandoned ops in earlier segments are left for
+  // bootstrap to skip.
+  //
+  // Returns a bad status if the log is already shut down.
+  Status AsyncTruncateOpsAfter(int64_t index);
+
   // Blocks the current thread until all the entries in the log queue
   // are flushed and fsynced (if fsync of log entries is enabled).
   Status WaitUntilAllFlushed();
@@ -130,6 +148,19 @@ class Log : public RefCountedThreadSafe<Log> {
   // The closure submitted to allocation_pool_ to allocate a new segment.
   void SegmentAllocationTask();
 
+  // The closure submitted to allocation_pool_ to top up 'segment_pool_' to
+  // --log_segment_pool_size segments.
+  void SegmentPoolRefillTask();
+
+  // The closure submitted to migration_pool_ to migrate the closed segments
+  // beyond the --log_segments_to_keep_in_wal_dir most recent ones to the
+  // archive directory.
+  void MigrateSegmentsTask();
+
+  // Copies the closed segment 'segment' to 'archive_dir_', points the reader
+  // at the copy, and deletes the original.
+  Status MigrateSegment(const scoped_refptr<ReadableLogSegment>& segment);
+
   // Syncs all state and closes the log.
   Status Close();
 
@@ -181,6 +212,8 @@ class Log : public RefCountedThreadSafe<Log> {
   //
   // 'min_op_idx' is the minimum operation index required to be retained.
   // If successful, num_gced is set to the number of deleted log segments.
+  // With --log_async_segment_deletion, the files of the segments are deleted
+  // in the background, and not until Close() returns at the latest.
   //
   // This method is thread-safe.
   Status GC(RetentionIndexes retention_indexes, int* num_gced);
@@ -216,6 +249,17 @@ class Log : public RefCountedThreadSafe<Log> {
   // Returns 0 if the log is shut down.
   int64_t OnDiskSize();
 
+  // Returns the total number of bytes appended to the log since it was
+  // opened, or 0 if the log has no metrics.
+  int64_t bytes_logged() const;
+
+  // Returns how full the queue of batches waiting to be appended is, from 0
+  // when it's empty to 1 when appending blocks for room in it.
+  double append_queue_fill() const;
+
+  // Returns a moving average of the latency of the last group commits.
+  MonoDelta recent_group_commit_latency() const;
+
   // Returns the file system location of the currently active WAL segment.
   const std::string& ActiveSegmentPathForTests() const {
     return active_segment_->path();
@@ -297,13 +341,30 @@ class Log : public RefCountedThreadSafe<Log> {
   // disk as the header, and sets active_segment_ to point to this new segment.
   Status SwitchToAllocatedSegment();
 
-  // Preallocates the space for a new segment.
+  // Preallocates the space for a new segment, or takes one from
+  // 'segment_pool_' if there is any.
   Status PreAllocateNewSegment();
 
+  // Creates a placeholder segment and preallocates its space. 'path' and
+  // 'file' are set to the segment once it has been created, even on failure
+  // to preallocate it.
+  Status CreateAndPreAllocateSegment(std::string* path, std::shared_ptr<WritableFile>* file);
+
+  // If 'segment_pool_' is not empty, sets 'path' and 'file' to its first
+  // segment, removing it from the pool, and returns true.
+  bool TakeSegmentFromPool(std::string* path, std::shared_ptr<WritableFile>* file);
+
+  // Deletes the segments of 'segment_pool_'.
+  void ClearSegmentPool();
+
   // Writes serialized contents of 'entry' to the log. Called inside
   // AppenderThread.
   Status DoAppend(LogEntryBatch* entry_batch);
 
+  // Does the truncation of AsyncTruncateOpsAfter(). Called inside
+  // AppenderThread.
+  Status DoTruncateOpsAfter(int64_t index);
+
   // Update footer_builder_ to reflect the log indexes seen in 'batch'.
   void UpdateFooterForBatch(LogEntryBatch* batch);
 
@@ -313,12 +374,27 @@ class Log : public RefCountedThreadSafe<Log> {
   Status UpdateIndexForBatch(const LogEntryBatch& batch,
                              int64_t start_offset);
 
+  // Appends a checkpoint of footer_builder_ to the sparse index of the
+  // current segment every --log_segment_index_interval_batches batches.
+  // 'start_offset' is the offset of the batch that was just appended.
+  Status MaybeCheckpointSegmentIndex(int64_t start_offset);
+
+  // Closes and deletes the sparse index of the current segment, if any. Once
+  // the segment has a footer, the sparse index is no longer needed.
+  Status CloseSegmentIndex();
+
   // Replaces the last "empty" segment in 'log_reader_', i.e. the one currently
   // being written to, by the same segment once properly closed.
   Status ReplaceSegmentInReaderUnlocked();
 
   Status Sync();
 
+  // Delete the files of 'segments', syncing their directories afterwards if
+  // 'sync_dir'. If 'num_deleted' is not null, it is set to the number of
+  // files deleted.
+  Status DeleteSegments(const SegmentSequence& segments, bool sync_dir,
+                        int* num_deleted = nullptr);
+
   // Helper method to get the segment sequence to GC based on the provided 'retention' struct.
   Status GetSegmentsToGCUnlocked(RetentionIndexes retention_indexes,
                                  SegmentSequence* segments_to_gc) const;
@@ -327,6 +403,9 @@ class Log : public RefCountedThreadSafe<Log> {
     return &entry_batch_queue_;
   }
 
+  // Folds the latency of a group commit into 'group_commit_latency_us_'.
+  void RecordGroupCommitLatency(MonoDelta latency);
+
   const SegmentAllocationState allocation_state() {
     shared_lock<RWMutex> l(allocation_lock_);
     return allocation_state_;
@@ -361,6 +440,11 @@ class Log : public RefCountedThreadSafe<Log> {
   // The path for the next allocated segment.
   std::string next_segment_path_;
 
+  // Placeholder segments preallocated ahead of the next allocated segment,
+  // and their paths. See --log_segment_pool_size.
+  simple_spinlock segment_pool_lock_;
+  std::deque<std::pair<std::string, std::shared_ptr<WritableFile>>> segment_pool_;
+
   // Lock to protect mutations to log_state_ and other shared state variables.
   mutable percpu_rwlock state_lock_;
 
@@ -379,6 +463,14 @@ class Log : public RefCountedThreadSafe<Log> {
   // When the segment is closed, it will be written.
   LogSegmentFooterPB footer_builder_;
 
+  // Sparse index of the current segment, to which footer_builder_ is
+  // periodically checkpointed. Created on the first checkpoint.
+  std::unique_ptr<pb_util::WritablePBContainerFile> segment_index_;
+
+  // The number of batches appended to the current segment since its last
+  // sparse index checkpoint.
+  int batches_since_index_checkpoint_;
+
   // The maximum segment size, in bytes.
   uint64_t max_segment_size_;
 
@@ -391,6 +483,16 @@ class Log : public RefCountedThreadSafe<Log> {
 
   gscoped_ptr<ThreadPool> allocation_pool_;
 
+  // Deletes the segments GCed with --log_async_segment_deletion.
+  gscoped_ptr<ThreadPool> deletion_pool_;
+
+  // The directory of --log_archive_dir closed segments are migrated to, or
+  // empty if they stay in 'log_dir_'.
+  const std::string archive_dir_;
+
+  // Migrates closed segments to 'archive_dir_' after each roll over.
+  gscoped_ptr<ThreadPool> migration_pool_;
+
   // If true, sync on all appends.
   bool force_sync_all_;
 
@@ -398,6 +500,11 @@ class Log : public RefCountedThreadSafe<Log> {
   // This is used to disable fsync during bootstrap.
   bool sync_disabled_;
 
+  // Syncs this log together with the other logs under the same WAL root, if
+  // LogOptions::group_sync_per_wal_dir is set and the platform supports it.
+  // Shared by the logs for the lifetime of the process.
+  LogGroupSyncer* group_syncer_;
+
   // The status of the most recent log-allocation action.
   Promise<Status> allocation_status_;
 
@@ -416,6 +523,10 @@ class Log : public RefCountedThreadSafe<Log> {
   // The cached on-disk size of the log, used to track its size even if it has been closed.
   std::atomic<int64_t> on_disk_size_;
 
+  // An exponentially weighted moving average of the group commit latency, in
+  // microseconds. Only updated by the append thread, or the sync stage.
+  std::atomic<int64_t> group_commit_latency_us_;
+
   DISALLOW_COPY_AND_ASSIGN(Log);
 };
 
@@ -465,6 +576,12 @@ class LogEntryBatch {
                 std::unique_ptr<LogEntryBatchPB> entry_batch_pb,
                 size_t count);
 
+  // A REPLICATE batch of 'replicates', whose sizes must have been cached by
+  // RefCountedReplicate::CacheSizes(), and which 'entry_batch_pb' must hold.
+  // The batch is sized and serialized using the cached sizes.
+  LogEntryBatch(std::unique_ptr<LogEntryBatchPB> entry_batch_pb,
+                std::vector<consensus::ReplicateRefPtr> replicates);
+
   // Serializes contents of the entry to an internal buffer.
   void Serialize();
 
@@ -481,10 +598,10 @@ class LogEntryBatch {
   }
 
 
-  // Returns a Slice representing the serialized contents of the
-  // entry.
-  Slice data() const {
-    return Slice(buffer_);
+  // Returns the serialized contents of the entry, as a sequence of slices
+  // to be written in order.
+  const std::vector<Slice>& data() const {
+    return data_;
   }
 
   size_t count() const { return count_; }
@@ -503,10 +620,6 @@ class LogEntryBatch {
     return entry_batch_pb_->entry(idx).replicate().id();
   }
 
-  void SetReplicates(const std::vector<consensus::ReplicateRefPtr>& replicates) {
-    replicates_ = replicates;
-  }
-
   // The type of entries in this batch.
   const LogEntryTypePB type_;
 
@@ -519,10 +632,15 @@ class LogEntryBatch {
   // Number of entries in 'entry_batch_pb_'
   const size_t count_;
 
+  // If set, this is a FLUSH_MARKER batch which truncates the ops after this
+  // index from the log instead. See Log::AsyncTruncateOpsAfter().
+  boost::optional<int64_t> truncate_after_index_;
+
   // The vector of refcounted replicates.
   // Used only when type is REPLICATE, this makes sure there's at
   // least a reference to each replicate message until we're finished
-  // appending.
+  // appending. If set, the batch is serialized from these rather than
+  // from 'entry_batch_pb_'.
   std::vector<consensus::ReplicateRefPtr> replicates_;
 
   // Callback to be invoked upon the entries being written and
@@ -533,6 +651,16 @@ class LogEntryBatch {
   // 'Serialize()'
   faststring buffer_;
 
+  // Stream to which REPLICATE batches are serialized instead of 'buffer_' if
+  // --log_zero_copy_serialization is set. Large fields of the replicates are
+  // referenced in place rather than copied, which is safe since 'replicates_'
+  // keeps them alive until the batch is destroyed.
+  std::unique_ptr<SliceOutputStream> aliased_buffer_;
+
+  // The slices making up the serialized batch, pointing into either
+  // 'buffer_' or 'aliased_buffer_'.
+  std::vector<Slice> data_;
+
   DISALLOW_COPY_AND_ASSIGN(LogEntryBatch);
 };
 
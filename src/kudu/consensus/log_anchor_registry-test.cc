@@ -19,9 +19,12 @@
 
 #include <cstdint>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/monotime.h"
@@ -30,6 +33,8 @@
 #include "kudu/util/test_util.h"
 
 using std::string;
+using std::thread;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -121,5 +126,65 @@ TEST_F(LogAnchorRegistryTest, TestOrderedEarliestOpId) {
   ASSERT_TRUE(s.IsNotFound()) << s.ToString();
 }
 
+// Ensure that the earliest index follows anchors which are moved.
+TEST_F(LogAnchorRegistryTest, TestEarliestAfterUpdateRegistration) {
+  scoped_refptr<LogAnchorRegistry> reg(new LogAnchorRegistry());
+  const string test_name = CURRENT_TEST_NAME();
+
+  LogAnchor a;
+  LogAnchor b;
+  reg->Register(5, test_name, &a);
+  reg->Register(10, test_name, &b);
+
+  int64_t anchor_idx = -1;
+  ASSERT_OK(reg->GetEarliestRegisteredLogIndex(&anchor_idx));
+  ASSERT_EQ(5, anchor_idx);
+
+  // Moving the earliest anchor later exposes the next one.
+  ASSERT_OK(reg->UpdateRegistration(20, test_name, &a));
+  ASSERT_OK(reg->GetEarliestRegisteredLogIndex(&anchor_idx));
+  ASSERT_EQ(10, anchor_idx);
+
+  // Moving another anchor earlier makes it the earliest.
+  ASSERT_OK(reg->UpdateRegistration(1, test_name, &a));
+  ASSERT_OK(reg->GetEarliestRegisteredLogIndex(&anchor_idx));
+  ASSERT_EQ(1, anchor_idx);
+
+  ASSERT_OK(reg->Unregister(&a));
+  ASSERT_OK(reg->GetEarliestRegisteredLogIndex(&anchor_idx));
+  ASSERT_EQ(10, anchor_idx);
+  ASSERT_TRUE(reg->Unregister(&a).IsNotFound());
+  ASSERT_OK(reg->Unregister(&b));
+}
+
+// Test that concurrent writers end up anchoring the minimum index any of them
+// passed in.
+TEST_F(LogAnchorRegistryTest, TestConcurrentMinLogIndexAnchorer) {
+  scoped_refptr<LogAnchorRegistry> reg(new LogAnchorRegistry());
+  const int kNumThreads = 4;
+  const int kNumPerThread = 10000;
+  {
+    MinLogIndexAnchorer anchorer(reg.get(), CURRENT_TEST_NAME());
+    ASSERT_EQ(consensus::kInvalidOpIdIndex, anchorer.minimum_log_index());
+
+    vector<thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([&anchorer, t]() {
+        for (int i = kNumPerThread; i > 0; i--) {
+          anchorer.AnchorIfMinimum(i * kNumThreads + t);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    ASSERT_EQ(kNumThreads, anchorer.minimum_log_index());
+    int64_t anchor_idx = -1;
+    ASSERT_OK(reg->GetEarliestRegisteredLogIndex(&anchor_idx));
+    ASSERT_EQ(kNumThreads, anchor_idx);
+  }
+  ASSERT_EQ(0, reg->GetAnchorCountForTests());
+}
+
 } // namespace log
 } // namespace kudu
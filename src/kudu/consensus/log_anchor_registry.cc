@@ -17,10 +17,12 @@
 
 #include "kudu/consensus/log_anchor_registry.h"
 
+#include <algorithm>
 #include <mutex>
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -33,10 +35,13 @@ namespace log {
 
 using consensus::kInvalidOpIdIndex;
 using std::string;
+using std::vector;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 
-LogAnchorRegistry::LogAnchorRegistry() {
+LogAnchorRegistry::LogAnchorRegistry()
+    : earliest_index_(kInvalidOpIdIndex),
+      earliest_index_stale_(false) {
 }
 
 LogAnchorRegistry::~LogAnchorRegistry() {
@@ -73,13 +78,18 @@ Status LogAnchorRegistry::UnregisterIfAnchored(LogAnchor* anchor) {
 
 Status LogAnchorRegistry::GetEarliestRegisteredLogIndex(int64_t* log_index) {
   std::lock_guard<simple_spinlock> l(lock_);
-  auto iter = anchors_.begin();
-  if (iter == anchors_.end()) {
+  if (anchors_.empty()) {
     return Status::NotFound("No anchors in registry");
   }
 
-  // Since this is a sorted map, the first element is the one we want.
-  *log_index = iter->first;
+  if (PREDICT_FALSE(earliest_index_stale_)) {
+    earliest_index_ = anchors_[0]->log_index;
+    for (const LogAnchor* anchor : anchors_) {
+      earliest_index_ = std::min(earliest_index_, anchor->log_index);
+    }
+    earliest_index_stale_ = false;
+  }
+  *log_index = earliest_index_;
   return Status::OK();
 }
 
@@ -92,8 +102,12 @@ std::string LogAnchorRegistry::DumpAnchorInfo() const {
   string buf;
   std::lock_guard<simple_spinlock> l(lock_);
   MonoTime now = MonoTime::Now();
-  for (const AnchorMultiMap::value_type& entry : anchors_) {
-    const LogAnchor* anchor = entry.second;
+  vector<const LogAnchor*> anchors(anchors_.begin(), anchors_.end());
+  std::stable_sort(anchors.begin(), anchors.end(),
+                   [](const LogAnchor* a, const LogAnchor* b) {
+                     return a->log_index < b->log_index;
+                   });
+  for (const LogAnchor* anchor : anchors) {
     DCHECK(anchor->is_registered);
     if (!buf.empty()) buf += ", ";
     SubstituteAndAppend(&buf, "LogAnchor[index=$0, age=$1s, owner=$2]",
@@ -114,31 +128,44 @@ void LogAnchorRegistry::RegisterUnlocked(int64_t log_index,
   anchor->owner.assign(owner);
   anchor->is_registered = true;
   anchor->when_registered = MonoTime::Now();
-  AnchorMultiMap::value_type value(log_index, anchor);
-  anchors_.insert(value);
+  anchor->slot = anchors_.size();
+  anchors_.push_back(anchor);
+  if (anchors_.size() == 1) {
+    earliest_index_ = log_index;
+    earliest_index_stale_ = false;
+  } else if (!earliest_index_stale_) {
+    earliest_index_ = std::min(earliest_index_, log_index);
+  }
 }
 
 Status LogAnchorRegistry::UnregisterUnlocked(LogAnchor* anchor) {
   DCHECK(anchor != nullptr);
   DCHECK(anchor->is_registered);
 
-  auto iter = anchors_.find(anchor->log_index);
-  while (iter != anchors_.end()) {
-    if (iter->second == anchor) {
-      anchor->is_registered = false;
-      anchors_.erase(iter);
-      // No need for the iterator to remain valid since we return here.
-      return Status::OK();
-    }
-    ++iter;
+  if (PREDICT_FALSE(anchor->slot >= anchors_.size() || anchors_[anchor->slot] != anchor)) {
+    return Status::NotFound(Substitute("Anchor with index $0 and owner $1 not found",
+                                       anchor->log_index, anchor->owner));
+  }
+
+  // Move the last anchor into the slot being freed.
+  LogAnchor* last = anchors_.back();
+  last->slot = anchor->slot;
+  anchors_[anchor->slot] = last;
+  anchors_.pop_back();
+  anchor->is_registered = false;
+
+  // Other anchors may be at the same index, but finding out would take a scan
+  // which the next GetEarliestRegisteredLogIndex() may as well do.
+  if (anchor->log_index == earliest_index_) {
+    earliest_index_stale_ = true;
   }
-  return Status::NotFound(Substitute("Anchor with index $0 and owner $1 not found",
-                                     anchor->log_index, anchor->owner));
+  return Status::OK();
 }
 
 LogAnchor::LogAnchor()
   : is_registered(false),
-    log_index(kInvalidOpIdIndex) {
+    log_index(kInvalidOpIdIndex),
+    slot(0) {
 }
 
 LogAnchor::~LogAnchor() {
@@ -156,27 +183,35 @@ MinLogIndexAnchorer::~MinLogIndexAnchorer() {
 }
 
 void MinLogIndexAnchorer::AnchorIfMinimum(int64_t log_index) {
+  // This is called for every write, and almost always with an index which is
+  // not lower than the anchored one.
+  int64_t minimum = minimum_log_index_.load(std::memory_order_acquire);
+  if (PREDICT_TRUE(minimum != kInvalidOpIdIndex && log_index >= minimum)) {
+    return;
+  }
+
   std::lock_guard<simple_spinlock> l(lock_);
-  if (PREDICT_FALSE(minimum_log_index_ == kInvalidOpIdIndex)) {
-    minimum_log_index_ = log_index;
-    registry_->Register(minimum_log_index_, owner_, &anchor_);
-  } else if (log_index < minimum_log_index_) {
-    minimum_log_index_ = log_index;
-    CHECK_OK(registry_->UpdateRegistration(minimum_log_index_, owner_, &anchor_));
+  minimum = minimum_log_index_.load(std::memory_order_relaxed);
+  if (PREDICT_FALSE(minimum == kInvalidOpIdIndex)) {
+    registry_->Register(log_index, owner_, &anchor_);
+  } else if (log_index < minimum) {
+    CHECK_OK(registry_->UpdateRegistration(log_index, owner_, &anchor_));
+  } else {
+    return;
   }
+  minimum_log_index_.store(log_index, std::memory_order_release);
 }
 
 Status MinLogIndexAnchorer::ReleaseAnchor() {
   std::lock_guard<simple_spinlock> l(lock_);
-  if (PREDICT_TRUE(minimum_log_index_ != kInvalidOpIdIndex)) {
+  if (PREDICT_TRUE(minimum_log_index_.load(std::memory_order_relaxed) != kInvalidOpIdIndex)) {
     return registry_->Unregister(&anchor_);
   }
   return Status::OK(); // If there were no inserts, return OK.
 }
 
 int64_t MinLogIndexAnchorer::minimum_log_index() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return minimum_log_index_;
+  return minimum_log_index_.load(std::memory_order_acquire);
 }
 
 } // namespace log
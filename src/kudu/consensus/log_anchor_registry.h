@@ -17,10 +17,11 @@
 #ifndef KUDU_CONSENSUS_LOG_ANCHOR_REGISTRY_
 #define KUDU_CONSENSUS_LOG_ANCHOR_REGISTRY_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
-#include <map>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
@@ -69,6 +70,9 @@ class LogAnchorRegistry : public RefCountedThreadSafe<LogAnchorRegistry> {
 
   // Query the registry to find the earliest anchored log index in the registry.
   // Returns Status::NotFound if no anchors are currently active.
+  //
+  // The earliest index is cached, and only recomputed after the anchor holding
+  // it was released or moved to a later index.
   Status GetEarliestRegisteredLogIndex(int64_t* log_index);
 
   // Simply returns the number of active anchors for use in debugging / tests.
@@ -82,15 +86,21 @@ class LogAnchorRegistry : public RefCountedThreadSafe<LogAnchorRegistry> {
   friend class RefCountedThreadSafe<LogAnchorRegistry>;
   ~LogAnchorRegistry();
 
-  typedef std::multimap<int64_t, LogAnchor*> AnchorMultiMap;
-
   // Register a new anchor after taking the lock. See Register().
   void RegisterUnlocked(int64_t log_index, const std::string& owner, LogAnchor* anchor);
 
   // Unregister an anchor after taking the lock. See Unregister().
   Status UnregisterUnlocked(LogAnchor* anchor);
 
-  AnchorMultiMap anchors_;
+  // The registered anchors, in no particular order. Each anchor knows its slot
+  // in the vector, so that it can be removed in constant time.
+  std::vector<LogAnchor*> anchors_;
+
+  // The earliest index anchored in 'anchors_', if 'earliest_index_stale_' is
+  // false. Otherwise it must be recomputed from 'anchors_'.
+  int64_t earliest_index_;
+  bool earliest_index_stale_;
+
   mutable simple_spinlock lock_;
 
   DISALLOW_COPY_AND_ASSIGN(LogAnchorRegistry);
@@ -117,6 +127,10 @@ struct LogAnchor {
   // The index of the log entry we are anchoring on.
   int64_t log_index;
 
+  // The position of this anchor in the registry's list of anchors, while
+  // registered.
+  size_t slot;
+
   // An arbitrary string containing details of the subsystem holding the
   // anchor, and any relevant information about it that should be displayed in
   // the log or the web UI.
@@ -152,8 +166,14 @@ class MinLogIndexAnchorer {
   LogAnchor anchor_;
 
   // The index currently anchored, or kInvalidOpIdIndex if no anchor has yet been registered.
-  int64_t minimum_log_index_;
-  mutable simple_spinlock lock_;
+  //
+  // Only updated under 'lock_', once the registry has been updated, so that
+  // AnchorIfMinimum() can return without taking the lock for an index which
+  // isn't lower: such an index is always covered by the registered anchor.
+  std::atomic<int64_t> minimum_log_index_;
+
+  // Serializes updates of the anchor.
+  simple_spinlock lock_;
 
   DISALLOW_COPY_AND_ASSIGN(MinLogIndexAnchorer);
 };
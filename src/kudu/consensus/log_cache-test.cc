@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
@@ -36,6 +37,7 @@
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_cache.h"
+#include "kudu/consensus/log_cache_manager.h"
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
@@ -50,6 +52,7 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -61,6 +64,7 @@ using std::vector;
 using strings::Substitute;
 
 DECLARE_int32(log_cache_size_limit_mb);
+DECLARE_bool(log_cache_shared_budget);
 DECLARE_int32(global_log_cache_size_limit_mb);
 
 METRIC_DECLARE_entity(tablet);
@@ -115,14 +119,18 @@ class LogCacheTest : public KuduTest {
 
   Status AppendReplicateMessagesToCache(int64_t first, int64_t count,
                                         size_t payload_size = 0) {
+    return AppendReplicateMessagesTo(cache_.get(), first, count, payload_size);
+  }
 
+  Status AppendReplicateMessagesTo(LogCache* cache, int64_t first, int64_t count,
+                                   size_t payload_size = 0) {
     for (int64_t cur_index = first; cur_index < first + count; cur_index++) {
       int64_t term = cur_index / 7;
       int64_t index = cur_index;
       vector<ReplicateRefPtr> msgs;
       msgs.push_back(make_scoped_refptr_replicate(
                        CreateDummyReplicate(term, index, clock_->Now(), payload_size).release()));
-      RETURN_NOT_OK(cache_->AppendOperations(msgs, Bind(&FatalOnError)));
+      RETURN_NOT_OK(cache->AppendOperations(msgs, Bind(&FatalOnError)));
     }
     return Status::OK();
   }
@@ -314,6 +322,55 @@ TEST_F(LogCacheTest, TestGlobalMemoryLimit) {
   ASSERT_LE(cache_->BytesUsed(), 1024 * 1024);
 }
 
+// Test that with a shared budget, a tablet's cache may grow past the per-tablet
+// limit, and that memory is reclaimed from another tablet's cache which uses
+// more than its fair share of the global budget.
+TEST_F(LogCacheTest, TestSharedBudget) {
+  cache_.reset();
+
+  FLAGS_log_cache_size_limit_mb = 1;
+  FLAGS_global_log_cache_size_limit_mb = 4;
+  FLAGS_log_cache_shared_budget = true;
+  CloseAndReopenCache(MinimumOpId());
+  const int64_t kBudget = 4 * 1024 * 1024;
+  const int kPayloadSize = 1024 * 1024;
+
+  // Set up the cache of an idle tablet, using most of the budget.
+  const char* kIdleTablet = "idle-tablet";
+  scoped_refptr<log::Log> idle_log;
+  ASSERT_OK(log::Log::Open(log::LogOptions(),
+                           fs_manager_.get(),
+                           kIdleTablet,
+                           schema_,
+                           0, // schema_version
+                           nullptr,
+                           &idle_log));
+  LogCache idle_cache(METRIC_ENTITY_tablet.Instantiate(&metric_registry_, kIdleTablet),
+                      idle_log, kPeerUuid, kIdleTablet);
+  idle_cache.Init(MinimumOpId());
+  ASSERT_OK(AppendReplicateMessagesTo(&idle_cache, 1, 3, kPayloadSize));
+  idle_log->WaitUntilAllFlushed();
+  ASSERT_EQ(3, idle_cache.num_cached_ops());
+
+  // Appending to our cache should evict the idle tablet's ops rather than our
+  // own, even though we go past the per-tablet limit.
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 2, kPayloadSize));
+  log_->WaitUntilAllFlushed();
+  ASSERT_EQ(2, cache_->num_cached_ops());
+  ASSERT_EQ(1, idle_cache.num_cached_ops());
+  ASSERT_LE(cache_->BytesUsed() + idle_cache.BytesUsed(), kBudget);
+
+  // A lagging peer reading from our cache makes its fair share grow.
+  vector<ReplicateRefPtr> messages;
+  OpId preceding;
+  ASSERT_OK(cache_->ReadOps(0, 1, &messages, &preceding));
+  ASSERT_EQ(1, messages.size());
+  ASSERT_GT(cache_->demand(), 0);
+  ASSERT_EQ(0, idle_cache.demand());
+  ASSERT_GT(LogCacheManager::Get()->FairShare(cache_.get(), kBudget),
+            LogCacheManager::Get()->FairShare(&idle_cache, kBudget));
+}
+
 // Test that the log cache properly replaces messages when an index
 // is reused. This is a regression test for a bug where the memtracker's
 // consumption wasn't properly managed when messages were replaced.
@@ -377,6 +434,86 @@ TEST_F(LogCacheTest, TestTruncation) {
   }
 }
 
+// Test that peers reading the same cached ops share a single batch, and that
+// the batch isn't reused once it no longer matches what's in the cache.
+TEST_F(LogCacheTest, TestReadCachedSpan) {
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 10));
+  log_->WaitUntilAllFlushed();
+
+  ReplicateSpanPtr span;
+  ReplicateSpanPtr other_span;
+  OpId preceding;
+  ASSERT_OK(cache_->ReadCachedSpan(5, 8 * 1024 * 1024, &span, &preceding));
+  ASSERT_TRUE(span);
+  ASSERT_EQ(5, span->size());
+  EXPECT_EQ("0.5", OpIdToString(preceding));
+  EXPECT_EQ(10, span->back()->id().index());
+  ASSERT_OK(cache_->ReadCachedSpan(5, 8 * 1024 * 1024, &other_span, &preceding));
+  ASSERT_EQ(span.get(), other_span.get());
+
+  // Once more ops are appended, the batch is read again.
+  ASSERT_OK(AppendReplicateMessagesToCache(11, 1));
+  ASSERT_OK(cache_->ReadCachedSpan(5, 8 * 1024 * 1024, &other_span, &preceding));
+  ASSERT_NE(span.get(), other_span.get());
+  ASSERT_EQ(6, other_span->size());
+
+  // As it is if the ops are truncated.
+  cache_->TruncateOpsAfter(8);
+  ASSERT_OK(cache_->ReadCachedSpan(5, 8 * 1024 * 1024, &span, &preceding));
+  ASSERT_EQ(3, span->size());
+  EXPECT_EQ(8, span->back()->id().index());
+
+  // A peer which is caught up gets no batch.
+  ASSERT_OK(cache_->ReadCachedSpan(8, 8 * 1024 * 1024, &span, &preceding));
+  ASSERT_FALSE(span);
+  EXPECT_EQ("1.8", OpIdToString(preceding));
+}
+
+// Throughput benchmark for the cache itself: append a large number of small
+// ops, read them all back from the cache in batches, and then evict them.
+TEST_F(LogCacheTest, TestCacheThroughput) {
+  const int64_t kNumOps = AllowSlowTests() ? 200000 : 20000;
+  const int kBatchSize = 100;
+
+  vector<ReplicateRefPtr> all_msgs;
+  all_msgs.reserve(kNumOps);
+  for (int64_t index = 1; index <= kNumOps; index++) {
+    all_msgs.push_back(make_scoped_refptr_replicate(
+        CreateDummyReplicate(index / 7, index, clock_->Now(), 0).release()));
+  }
+
+  LOG_TIMING(INFO, Substitute("appending $0 ops to the cache", kNumOps)) {
+    for (int64_t i = 0; i < kNumOps; i += kBatchSize) {
+      vector<ReplicateRefPtr> batch(all_msgs.begin() + i,
+                                    all_msgs.begin() + std::min(i + kBatchSize, kNumOps));
+      ASSERT_OK(cache_->AppendOperations(batch, Bind(&FatalOnError)));
+    }
+  }
+  // Drop our references so that the ops may be evicted below.
+  all_msgs.clear();
+  log_->WaitUntilAllFlushed();
+  ASSERT_EQ(kNumOps, cache_->num_cached_ops());
+
+  LOG_TIMING(INFO, Substitute("reading $0 ops from the cache", kNumOps)) {
+    int64_t index = 0;
+    while (index < kNumOps) {
+      vector<ReplicateRefPtr> messages;
+      OpId preceding;
+      ASSERT_OK(cache_->ReadOps(index, 64 * 1024, &messages, &preceding));
+      ASSERT_EQ(index, preceding.index());
+      ASSERT_FALSE(messages.empty());
+      index += messages.size();
+    }
+  }
+
+  LOG_TIMING(INFO, Substitute("evicting $0 ops from the cache", kNumOps)) {
+    for (int64_t index = kBatchSize; index <= kNumOps; index += kBatchSize) {
+      cache_->EvictThroughOp(index);
+    }
+  }
+  ASSERT_EQ(0, cache_->num_cached_ops());
+}
+
 TEST_F(LogCacheTest, TestMTReadAndWrite) {
   atomic<bool> stop { false };
   vector<thread> threads;
@@ -17,7 +17,9 @@
 
 #include "kudu/consensus/log_cache.h"
 
-#include <map>
+#include <algorithm>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <ostream>
 #include <string>
@@ -31,13 +33,13 @@
 
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log.h"
+#include "kudu/consensus/log_cache_manager.h"
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
-#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -60,6 +62,15 @@ DEFINE_int32(global_log_cache_size_limit_mb, 1024,
              "caching log entries across all tablets is kept under this threshold.");
 TAG_FLAG(global_log_cache_size_limit_mb, advanced);
 
+DEFINE_bool(log_cache_shared_budget, false,
+            "If true, tablets' log caches are not limited by 'log_cache_size_limit_mb'. "
+            "Instead, they share the 'global_log_cache_size_limit_mb' budget, and when it "
+            "is exhausted, memory is reclaimed first from the least recently read tablets "
+            "using more than their fair share of it, which is weighed by how much their "
+            "lagging followers read from the cache.");
+TAG_FLAG(log_cache_shared_budget, advanced);
+TAG_FLAG(log_cache_shared_budget, experimental);
+
 using kudu::pb_util::SecureShortDebugString;
 using std::string;
 using std::vector;
@@ -88,6 +99,9 @@ LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
     tablet_id_(std::move(tablet_id)),
     next_sequential_op_index_(0),
     min_pinned_op_index_(0),
+    use_shared_budget_(FLAGS_log_cache_shared_budget),
+    demand_(0),
+    last_read_sequence_(0),
     metrics_(metric_entity) {
 
 
@@ -99,35 +113,48 @@ LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
   parent_tracker_ = MemTracker::FindOrCreateGlobalTracker(global_max_ops_size_bytes,
                                                           kParentMemTrackerId);
 
-  // And create a child tracker with the per-tablet limit.
+  // And create a child tracker with the per-tablet limit, unless the caches
+  // share the global budget.
   tracker_ = MemTracker::CreateTracker(
-      max_ops_size_bytes, Substitute("$0:$1:$2", kParentMemTrackerId,
-                                     local_uuid_, tablet_id_),
+      use_shared_budget_ ? -1 : max_ops_size_bytes,
+      Substitute("$0:$1:$2", kParentMemTrackerId, local_uuid_, tablet_id_),
       parent_tracker_);
+  if (use_shared_budget_) {
+    LogCacheManager::Get()->RegisterCache(this);
+  }
 
-  // Put a fake message at index 0, since this simplifies a lot of our
-  // code paths elsewhere.
   auto zero_op = new ReplicateMsg();
   *zero_op->mutable_id() = MinimumOpId();
-  InsertOrDie(&cache_, 0, { make_scoped_refptr_replicate(zero_op), zero_op->SpaceUsed() });
+  zero_op_ = { make_scoped_refptr_replicate(zero_op), zero_op->SpaceUsed() };
 }
 
 LogCache::~LogCache() {
+  if (use_shared_budget_) {
+    LogCacheManager::Get()->UnregisterCache(this);
+  }
   tracker_->Release(tracker_->consumption());
-  cache_.clear();
+  cache_.Clear();
 }
 
 void LogCache::Init(const OpId& preceding_op) {
   std::lock_guard<simple_spinlock> l(lock_);
-  CHECK_EQ(cache_.size(), 1)
+  CHECK(cache_.empty())
     << "Cache should have only our special '0' op";
   next_sequential_op_index_ = preceding_op.index() + 1;
   min_pinned_op_index_ = next_sequential_op_index_;
 }
 
 void LogCache::TruncateOpsAfter(int64_t index) {
-  std::unique_lock<simple_spinlock> l(lock_);
-  TruncateOpsAfterUnlocked(index);
+  {
+    std::unique_lock<simple_spinlock> l(lock_);
+    TruncateOpsAfterUnlocked(index);
+  }
+  // As with appends, the log may block if its queue is full.
+  Status s = log_->AsyncTruncateOpsAfter(index);
+  if (!s.ok()) {
+    LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Couldn't truncate the log after op "
+                                      << index << ": " << s.ToString();
+  }
 }
 
 void LogCache::TruncateOpsAfterUnlocked(int64_t index) {
@@ -136,28 +163,45 @@ void LogCache::TruncateOpsAfterUnlocked(int64_t index) {
   // to the last index, i.e. we're overwriting.
   CHECK_LE(first_to_truncate, next_sequential_op_index_);
 
+  last_span_.span.reset();
+
   // Now remove the overwritten operations.
   for (int64_t i = first_to_truncate; i < next_sequential_op_index_; ++i) {
-    auto it = cache_.find(i);
-    if (it != cache_.end()) {
-      AccountForMessageRemovalUnlocked(it->second);
-      cache_.erase(it);
+    const CacheEntry* entry = cache_.Find(i);
+    if (entry != nullptr) {
+      AccountForMessageRemovalUnlocked(*entry);
+      cache_.Erase(i);
     }
   }
   next_sequential_op_index_ = index + 1;
 }
 
+void LogCache::ResetAfterSnapshot(const OpId& preceding_op) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  last_span_.span.reset();
+  for (int64_t index = cache_.first_index(); index < cache_.end_index(); ++index) {
+    const CacheEntry* entry = cache_.Find(index);
+    if (entry != nullptr) {
+      AccountForMessageRemovalUnlocked(*entry);
+    }
+  }
+  cache_.Clear();
+  next_sequential_op_index_ = preceding_op.index() + 1;
+  min_pinned_op_index_ = next_sequential_op_index_;
+}
+
 Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
                                   const StatusCallback& callback) {
   CHECK_GT(msgs.size(), 0);
 
-  // SpaceUsed is relatively expensive, so do calculations outside the lock
-  // and cache the result with each message.
+  // The sizes of the messages are relatively expensive to compute, so do it
+  // outside the lock, once: the WAL and the peers reuse them.
   int64_t mem_required = 0;
   vector<CacheEntry> entries_to_insert;
   entries_to_insert.reserve(msgs.size());
   for (const auto& msg : msgs) {
-    CacheEntry e = { msg, static_cast<int64_t>(msg->get()->SpaceUsedLong()) };
+    msg->CacheSizes();
+    CacheEntry e = { msg, msg->space_used() };
     mem_required += e.mem_usage;
     entries_to_insert.emplace_back(std::move(e));
   }
@@ -165,10 +209,21 @@ Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
   int64_t first_idx_in_batch = msgs.front()->get()->id().index();
   int64_t last_idx_in_batch = msgs.back()->get()->id().index();
 
+  // If the shared budget would be exceeded, first try to reclaim memory from
+  // the caches which are over their fair share of it. This must be done before
+  // taking our lock, since it may evict from this cache as well.
+  if (use_shared_budget_) {
+    int64_t spare = parent_tracker_->SpareCapacity();
+    if (spare < mem_required) {
+      LogCacheManager::Get()->Reclaim(parent_tracker_->limit(), mem_required - spare);
+    }
+  }
+
   std::unique_lock<simple_spinlock> l(lock_);
   // If we're not appending a consecutive op we're likely overwriting and
   // need to replace operations in the cache.
-  if (first_idx_in_batch != next_sequential_op_index_) {
+  bool overwriting = first_idx_in_batch != next_sequential_op_index_;
+  if (overwriting) {
     TruncateOpsAfterUnlocked(first_idx_in_batch - 1);
   }
 
@@ -198,7 +253,7 @@ Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
 
   for (auto& e : entries_to_insert) {
     auto index = e.msg->get()->id().index();
-    EmplaceOrDie(&cache_, index, std::move(e));
+    cache_.Insert(index, std::move(e));
     next_sequential_op_index_ = index + 1;
   }
 
@@ -210,6 +265,15 @@ Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
   metrics_.log_cache_size->IncrementBy(mem_required);
   metrics_.log_cache_num_ops->IncrementBy(msgs.size());
 
+  // Drop the overwritten operations from the log too, ahead of the new ones.
+  if (overwriting) {
+    Status s = log_->AsyncTruncateOpsAfter(first_idx_in_batch - 1);
+    if (!s.ok()) {
+      LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Couldn't truncate the log after op "
+                                        << first_idx_in_batch - 1 << ": " << s.ToString();
+    }
+  }
+
   Status log_status = log_->AsyncAppendReplicates(
     msgs, Bind(&LogCache::LogCallback,
                Unretained(this),
@@ -255,6 +319,11 @@ bool LogCache::HasOpBeenWritten(int64_t index) const {
   return index < next_sequential_op_index_;
 }
 
+bool LogCache::IsOpCached(int64_t index) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return FindEntryUnlocked(index) != nullptr;
+}
+
 Status LogCache::LookupOpId(int64_t op_index, OpId* op_id) const {
   // First check the log cache itself.
   {
@@ -269,9 +338,9 @@ Status LogCache::LookupOpId(int64_t op_index, OpId* op_id) const {
                                            "(next sequential op: $1)",
                                            op_index, next_sequential_op_index_));
     }
-    auto iter = cache_.find(op_index);
-    if (iter != cache_.end()) {
-      *op_id = iter->second.msg->get()->id();
+    const CacheEntry* entry = FindEntryUnlocked(op_index);
+    if (entry != nullptr) {
+      *op_id = entry->msg->get()->id();
       return Status::OK();
     }
   }
@@ -284,9 +353,9 @@ namespace {
 // Calculate the total byte size that will be used on the wire to replicate
 // this message as part of a consensus update request. This accounts for the
 // length delimiting and tagging of the message.
-int64_t TotalByteSizeForMessage(const ReplicateMsg& msg) {
+int64_t TotalByteSizeForMessage(const RefCountedReplicate& msg) {
   int msg_size = google::protobuf::internal::WireFormatLite::LengthDelimitedSize(
-    msg.ByteSize());
+    msg.byte_size());
   msg_size += 1; // for the type tag
   return msg_size;
 }
@@ -298,9 +367,14 @@ Status LogCache::ReadOps(int64_t after_op_index,
                          OpId* preceding_op) {
   DCHECK_GE(after_op_index, 0);
   RETURN_NOT_OK(LookupOpId(after_op_index, preceding_op));
+  if (use_shared_budget_) {
+    last_read_sequence_.store(LogCacheManager::Get()->NextReadSequence(),
+                              std::memory_order_relaxed);
+  }
 
   std::unique_lock<simple_spinlock> l(lock_);
   int64_t next_index = after_op_index + 1;
+  int64_t ops_read_from_disk = 0;
 
   // Return as many operations as we can, up to the limit
   int64_t remaining_space = max_size_bytes;
@@ -308,15 +382,15 @@ Status LogCache::ReadOps(int64_t after_op_index,
 
     // If the messages the peer needs haven't been loaded into the queue yet,
     // load them.
-    MessageCache::const_iterator iter = cache_.lower_bound(next_index);
-    if (iter == cache_.end() || iter->first != next_index) {
+    if (cache_.Find(next_index) == nullptr) {
+      int64_t next_cached_index = cache_.LowerBound(next_index);
       int64_t up_to;
-      if (iter == cache_.end()) {
+      if (next_cached_index == -1) {
         // Read all the way to the current op
         up_to = next_sequential_op_index_ - 1;
       } else {
         // Read up to the next entry that's in the cache
-        up_to = iter->first - 1;
+        up_to = next_cached_index - 1;
       }
 
       l.unlock();
@@ -327,6 +401,7 @@ Status LogCache::ReadOps(int64_t after_op_index,
           next_index, up_to, remaining_space, &raw_replicate_ptrs),
         Substitute("Failed to read ops $0..$1", next_index, up_to));
       l.lock();
+      ops_read_from_disk += raw_replicate_ptrs.size();
       VLOG_WITH_PREFIX_UNLOCKED(2)
           << "Successfully read " << raw_replicate_ptrs.size() << " ops "
           << "from disk (" << next_index << ".."
@@ -335,25 +410,22 @@ Status LogCache::ReadOps(int64_t after_op_index,
       for (ReplicateMsg* msg : raw_replicate_ptrs) {
         CHECK_EQ(next_index, msg->id().index());
 
-        remaining_space -= TotalByteSizeForMessage(*msg);
+        ReplicateRefPtr msg_ref = make_scoped_refptr_replicate(msg);
+        msg_ref->CacheSizes();
+        remaining_space -= TotalByteSizeForMessage(*msg_ref);
         if (remaining_space > 0 || messages->empty()) {
-          messages->push_back(make_scoped_refptr_replicate(msg));
+          messages->push_back(std::move(msg_ref));
           next_index++;
-        } else {
-          delete msg;
         }
       }
 
     } else {
       // Pull contiguous messages from the cache until the size limit is achieved.
-      for (; iter != cache_.end(); ++iter) {
-        const ReplicateRefPtr& msg = iter->second.msg;
-        int64_t index = msg->get()->id().index();
-        if (index != next_index) {
-          continue;
-        }
+      const CacheEntry* entry;
+      while ((entry = cache_.Find(next_index)) != nullptr) {
+        const ReplicateRefPtr& msg = entry->msg;
 
-        remaining_space -= TotalByteSizeForMessage(*msg->get());
+        remaining_space -= TotalByteSizeForMessage(*msg);
         if (remaining_space < 0 && !messages->empty()) {
           break;
         }
@@ -363,9 +435,72 @@ Status LogCache::ReadOps(int64_t after_op_index,
       }
     }
   }
+
+  // A peer which is caught up only asks for the ops at the head of the log,
+  // so it doesn't need this cache to hold any older ones.
+  if (next_index < next_sequential_op_index_ || ops_read_from_disk > 0) {
+    demand_.fetch_add(messages->size() + ops_read_from_disk, std::memory_order_relaxed);
+  }
   return Status::OK();
 }
 
+Status LogCache::ReadCachedSpan(int64_t after_op_index,
+                                int max_size_bytes,
+                                ReplicateSpanPtr* span,
+                                OpId* preceding_op) {
+  DCHECK_GE(after_op_index, 0);
+  RETURN_NOT_OK(LookupOpId(after_op_index, preceding_op));
+  if (use_shared_budget_) {
+    last_read_sequence_.store(LogCacheManager::Get()->NextReadSequence(),
+                              std::memory_order_relaxed);
+  }
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!last_span_.span ||
+      last_span_.after_op_index != after_op_index ||
+      last_span_.max_size_bytes != max_size_bytes ||
+      (!last_span_.limited && last_span_.end_index != next_sequential_op_index_)) {
+    // Pull contiguous messages from the cache until the size limit is achieved.
+    vector<ReplicateRefPtr> messages;
+    int64_t next_index = after_op_index + 1;
+    int64_t remaining_space = max_size_bytes;
+    const CacheEntry* entry;
+    while (remaining_space > 0 && (entry = cache_.Find(next_index)) != nullptr) {
+      remaining_space -= TotalByteSizeForMessage(*entry->msg);
+      if (remaining_space < 0 && !messages.empty()) {
+        break;
+      }
+      messages.push_back(entry->msg);
+      next_index++;
+    }
+    if (messages.empty()) {
+      span->reset();
+      return Status::OK();
+    }
+    last_span_.after_op_index = after_op_index;
+    last_span_.max_size_bytes = max_size_bytes;
+    last_span_.end_index = next_sequential_op_index_;
+    last_span_.limited = next_index < next_sequential_op_index_;
+    last_span_.span = new ReplicateSpan(std::move(messages));
+  }
+  *span = last_span_.span;
+
+  // See ReadOps().
+  if (after_op_index + static_cast<int64_t>((*span)->size()) + 1 < next_sequential_op_index_) {
+    demand_.fetch_add((*span)->size(), std::memory_order_relaxed);
+  }
+  return Status::OK();
+}
+
+void LogCache::DecayDemand() {
+  demand_.store(demand_.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+}
+
+int64_t LogCache::EvictForMemoryPressure(int64_t bytes_to_evict) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  return EvictSomeUnlocked(min_pinned_op_index_, bytes_to_evict);
+}
+
 
 void LogCache::EvictThroughOp(int64_t index) {
   std::lock_guard<simple_spinlock> lock(lock_);
@@ -373,25 +508,28 @@ void LogCache::EvictThroughOp(int64_t index) {
   EvictSomeUnlocked(index, MathLimits<int64_t>::kMax);
 }
 
-void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict) {
+int64_t LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict) {
   DCHECK(lock_.is_locked());
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting log cache index <= "
                       << stop_after_index
                       << " or " << HumanReadableNumBytes::ToString(bytes_to_evict)
                       << ": before state: " << ToStringUnlocked();
 
+  // The last batch read holds references to its ops, which would keep them
+  // from being evicted even once no peer is using them.
+  if (last_span_.after_op_index < std::min(stop_after_index, min_pinned_op_index_ - 1)) {
+    last_span_.span.reset();
+  }
+
   int64_t bytes_evicted = 0;
-  for (auto iter = cache_.begin(); iter != cache_.end();) {
-    const CacheEntry& entry = (*iter).second;
-    const ReplicateRefPtr& msg = entry.msg;
-    VLOG_WITH_PREFIX_UNLOCKED(2) << "considering for eviction: " << msg->get()->id();
-    int64_t msg_index = msg->get()->id().index();
-    if (msg_index == 0) {
-      // Always keep our special '0' op.
-      ++iter;
+  for (int64_t index = cache_.first_index(); index < cache_.end_index(); ++index) {
+    const CacheEntry* entry = cache_.Find(index);
+    if (entry == nullptr) {
       continue;
     }
-
+    const ReplicateRefPtr& msg = entry->msg;
+    VLOG_WITH_PREFIX_UNLOCKED(2) << "considering for eviction: " << msg->get()->id();
+    int64_t msg_index = msg->get()->id().index();
     if (msg_index > stop_after_index || msg_index >= min_pinned_op_index_) {
       break;
     }
@@ -399,20 +537,38 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
     if (!msg->HasOneRef()) {
       VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting cache: cannot remove " << msg->get()->id()
                                    << " because it is in-use by a peer.";
-      ++iter;
       continue;
     }
 
     VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting cache. Removing: " << msg->get()->id();
-    AccountForMessageRemovalUnlocked(entry);
-    bytes_evicted += entry.mem_usage;
-    cache_.erase(iter++);
+    AccountForMessageRemovalUnlocked(*entry);
+    bytes_evicted += entry->mem_usage;
+    cache_.Erase(index);
 
     if (bytes_evicted >= bytes_to_evict) {
       break;
     }
   }
   VLOG_WITH_PREFIX_UNLOCKED(1) << "Evicting log cache: after state: " << ToStringUnlocked();
+  return bytes_evicted;
+}
+
+const LogCache::CacheEntry* LogCache::FindEntryUnlocked(int64_t index) const {
+  if (index == 0) {
+    return &zero_op_;
+  }
+  return cache_.Find(index);
+}
+
+void LogCache::ForEachEntryUnlocked(
+    const std::function<void(const CacheEntry&)>& func) const {
+  func(zero_op_);
+  for (int64_t index = cache_.first_index(); index < cache_.end_index(); ++index) {
+    const CacheEntry* entry = cache_.Find(index);
+    if (entry != nullptr) {
+      func(*entry);
+    }
+  }
 }
 
 void LogCache::AccountForMessageRemovalUnlocked(const LogCache::CacheEntry& entry) {
@@ -466,14 +622,14 @@ void LogCache::DumpToStrings(vector<string>* lines) const {
   int counter = 0;
   lines->push_back(ToStringUnlocked());
   lines->push_back("Messages:");
-  for (const auto& entry : cache_) {
-    const ReplicateMsg* msg = entry.second.msg->get();
+  ForEachEntryUnlocked([&](const CacheEntry& entry) {
+    const ReplicateMsg* msg = entry.msg->get();
     lines->push_back(
       Substitute("Message[$0] $1.$2 : REPLICATE. Type: $3, Size: $4",
                  counter++, msg->id().term(), msg->id().index(),
                  OperationType_Name(msg->op_type()),
-                 msg->ByteSize()));
-  }
+                 entry.msg->byte_size()));
+  });
 }
 
 void LogCache::DumpToHtml(std::ostream& out) const {
@@ -485,17 +641,82 @@ void LogCache::DumpToHtml(std::ostream& out) const {
   out << "<tr><th>Entry</th><th>OpId</th><th>Type</th><th>Size</th><th>Status</th></tr>" << endl;
 
   int counter = 0;
-  for (const auto& entry : cache_) {
-    const ReplicateMsg* msg = entry.second.msg->get();
+  ForEachEntryUnlocked([&](const CacheEntry& entry) {
+    const ReplicateMsg* msg = entry.msg->get();
     out << Substitute("<tr><th>$0</th><th>$1.$2</th><td>REPLICATE $3</td>"
                       "<td>$4</td><td>$5</td></tr>",
                       counter++, msg->id().term(), msg->id().index(),
                       OperationType_Name(msg->op_type()),
-                      msg->ByteSize(), SecureShortDebugString(msg->id())) << endl;
-  }
+                      entry.msg->byte_size(), SecureShortDebugString(msg->id())) << endl;
+  });
   out << "</table>";
 }
 
+LogCache::MessageCache::MessageCache()
+    : first_index_(0),
+      num_entries_(0) {
+}
+
+const LogCache::CacheEntry* LogCache::MessageCache::Find(int64_t index) const {
+  if (index < first_index_ || index >= end_index()) {
+    return nullptr;
+  }
+  const CacheEntry& entry = slots_[index - first_index_];
+  return entry.msg ? &entry : nullptr;
+}
+
+void LogCache::MessageCache::Insert(int64_t index, CacheEntry entry) {
+  DCHECK(entry.msg);
+  if (slots_.empty()) {
+    first_index_ = index;
+    slots_.emplace_back();
+  } else if (index < first_index_) {
+    slots_.insert(slots_.begin(), first_index_ - index, CacheEntry());
+    first_index_ = index;
+  } else if (index >= end_index()) {
+    slots_.resize(index - first_index_ + 1);
+  }
+  CacheEntry& slot = slots_[index - first_index_];
+  CHECK(!slot.msg) << "Op " << index << " is already cached";
+  slot = std::move(entry);
+  num_entries_++;
+}
+
+void LogCache::MessageCache::Erase(int64_t index) {
+  if (index < first_index_ || index >= end_index()) {
+    return;
+  }
+  CacheEntry& slot = slots_[index - first_index_];
+  if (!slot.msg) {
+    return;
+  }
+  slot = CacheEntry();
+  num_entries_--;
+
+  // Keep the invariant that there are no empty slots at either end.
+  while (!slots_.empty() && !slots_.front().msg) {
+    slots_.pop_front();
+    first_index_++;
+  }
+  while (!slots_.empty() && !slots_.back().msg) {
+    slots_.pop_back();
+  }
+}
+
+int64_t LogCache::MessageCache::LowerBound(int64_t index) const {
+  for (int64_t i = std::max(index, first_index_); i < end_index(); ++i) {
+    if (slots_[i - first_index_].msg) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void LogCache::MessageCache::Clear() {
+  slots_.clear();
+  num_entries_ = 0;
+}
+
 #define INSTANTIATE_METRIC(x) \
   x.Instantiate(metric_entity, 0)
 LogCache::Metrics::Metrics(const scoped_refptr<MetricEntity>& metric_entity)
@@ -17,9 +17,12 @@
 #ifndef KUDU_CONSENSUS_LOG_CACHE_H
 #define KUDU_CONSENSUS_LOG_CACHE_H
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <iosfwd>
-#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -87,6 +90,19 @@ class LogCache {
                  std::vector<ReplicateRefPtr>* messages,
                  OpId* preceding_op);
 
+  // Like ReadOps(), but only returns ops which are in the cache and never reads
+  // them from disk, so the result is empty if the op following 'after_op_index'
+  // is not cached. *preceding_op is still set if the result is empty.
+  //
+  // The ops are returned as a single shared batch, which is NULL if there are
+  // none. The peers of a leader normally ask for the same ops: they're handed
+  // the batch built for the first of them rather than each taking a reference
+  // to every op.
+  Status ReadCachedSpan(int64_t after_op_index,
+                        int max_size_bytes,
+                        ReplicateSpanPtr* span,
+                        OpId* preceding_op);
+
   // Append the operations into the log and the cache.
   // When the messages have completed writing into the on-disk log, fires 'callback'.
   //
@@ -102,15 +118,25 @@ class LogCache {
   // Following this, reads of truncated indexes using ReadOps(), LookupOpId(),
   // HasOpBeenWritten(), etc, will return as if the operations were never appended.
   //
-  // NOTE: unless a new operation is appended followig 'index', this truncation does
-  // not persist across server restarts.
+  // The operations are also truncated from the active segment of the log, once
+  // the operations appended earlier are written. Those in earlier segments are
+  // only skipped when replaying the log, so unless a new operation is appended
+  // following 'index', their truncation does not persist across server restarts.
   void TruncateOpsAfter(int64_t index);
 
+  // Evict all the operations, and make 'preceding_op' the current latest op,
+  // once a snapshot of the state machine which includes the ops up to it was
+  // installed. Its index may be past that of the latest op appended so far.
+  void ResetAfterSnapshot(const OpId& preceding_op);
+
   // Return true if an operation with the given index has been written through
   // the cache. The operation may not necessarily be durable yet -- it could still be
   // en route to the log.
   bool HasOpBeenWritten(int64_t index) const;
 
+  // Return true if the operation with the given index is currently cached.
+  bool IsOpCached(int64_t index) const;
+
   // Evict any operations with op index <= 'index'.
   void EvictThroughOp(int64_t index);
 
@@ -142,6 +168,27 @@ class LogCache {
   // Returns another bad Status if the log index fails to load (eg. due to an IO error).
   Status LookupOpId(int64_t op_index, OpId* op_id) const;
 
+  // The demand for this cache: the number of ops recently read from it by
+  // peers which were behind the head of the log, with ops which had to be
+  // read from disk counted twice. Used by LogCacheManager to weigh the fair
+  // share of each cache.
+  int64_t demand() const {
+    return demand_.load(std::memory_order_relaxed);
+  }
+
+  // Halve the demand, so that it reflects recent reads.
+  void DecayDemand();
+
+  // The LogCacheManager read sequence as of the last ReadOps() call.
+  int64_t last_read_sequence() const {
+    return last_read_sequence_.load(std::memory_order_relaxed);
+  }
+
+  // Evict the oldest ops which are neither pinned nor in use by a peer until
+  // at least 'bytes_to_evict' bytes have been evicted. Returns the number of
+  // bytes evicted.
+  int64_t EvictForMemoryPressure(int64_t bytes_to_evict);
+
  private:
   FRIEND_TEST(LogCacheTest, TestAppendAndGetMessages);
   FRIEND_TEST(LogCacheTest, TestGlobalMemoryLimit);
@@ -157,10 +204,61 @@ class LogCache {
     int64_t mem_usage;
   };
 
+  // The buffer of cached messages, indexed by op index.
+  //
+  // Since op indexes are dense and sequential, entries are stored in a deque
+  // where the slot at position 'i' holds the op with index first_index() + i.
+  // Lookup is a subtraction, and appending at the end or evicting from the
+  // front is O(1) without any per-entry node allocation. Ops which are not
+  // cached (e.g. because an older op was evicted around them while it was
+  // still in use by a peer) are represented by slots with a NULL 'msg'. There
+  // are never empty slots at either end of the buffer.
+  class MessageCache {
+   public:
+    MessageCache();
+
+    // Return the entry for 'index', or NULL if it is not cached.
+    const CacheEntry* Find(int64_t index) const;
+
+    // Insert the entry for 'index', which must not already be cached.
+    void Insert(int64_t index, CacheEntry entry);
+
+    // Remove the entry for 'index', if it is cached.
+    void Erase(int64_t index);
+
+    // Return the lowest cached index which is >= 'index', or -1 if there is none.
+    int64_t LowerBound(int64_t index) const;
+
+    void Clear();
+
+    // The number of cached entries.
+    size_t size() const { return num_entries_; }
+    bool empty() const { return num_entries_ == 0; }
+
+    // All cached entries have indexes in [first_index(), end_index()).
+    int64_t first_index() const { return first_index_; }
+    int64_t end_index() const { return first_index_ + slots_.size(); }
+
+   private:
+    int64_t first_index_;
+    std::deque<CacheEntry> slots_;
+    size_t num_entries_;
+
+    DISALLOW_COPY_AND_ASSIGN(MessageCache);
+  };
+
+  // Return the cached entry for 'index', or NULL if it is not cached.
+  const CacheEntry* FindEntryUnlocked(int64_t index) const;
+
+  // Call 'func' on every cached entry, including the special '0' op, in index
+  // order.
+  void ForEachEntryUnlocked(const std::function<void(const CacheEntry&)>& func) const;
+
   // Try to evict the oldest operations from the queue, stopping either when
   // 'bytes_to_evict' bytes have been evicted, or the op with index
-  // 'stop_after_index' has been evicted, whichever comes first.
-  void EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict);
+  // 'stop_after_index' has been evicted, whichever comes first. Returns the
+  // number of bytes evicted.
+  int64_t EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict);
 
   // Update metrics and MemTracker to account for the removal of the
   // given message.
@@ -190,9 +288,12 @@ class LogCache {
 
   mutable simple_spinlock lock_;
 
-  // An ordered map that serves as the buffer for the cached messages.
-  // Maps from log index -> ReplicateMsg
-  typedef std::map<uint64_t, CacheEntry> MessageCache;
+  // A fake message at index 0, since this simplifies a lot of our code paths
+  // elsewhere. It is kept outside of 'cache_' so that the buffer doesn't have
+  // to span the gap between it and the first real op, and is never evicted.
+  CacheEntry zero_op_;
+
+  // The buffer for the cached messages.
   MessageCache cache_;
 
   // The next log index to append. Each append operation must either
@@ -218,6 +319,31 @@ class LogCache {
   // A MemTracker for this instance.
   std::shared_ptr<MemTracker> tracker_;
 
+  // Whether this cache is registered with the LogCacheManager, i.e.
+  // --log_cache_shared_budget was set when it was created.
+  const bool use_shared_budget_;
+
+  // See demand().
+  std::atomic<int64_t> demand_;
+
+  // See last_read_sequence().
+  std::atomic<int64_t> last_read_sequence_;
+
+  // The last batch built by ReadCachedSpan(), which is handed out again for
+  // the same read until ops are appended past it. Reset when ops are
+  // truncated or evicted. Protected by lock_.
+  struct LastSpan {
+    int64_t after_op_index = -1;
+    int max_size_bytes = 0;
+    // next_sequential_op_index_ when the batch was built.
+    int64_t end_index = -1;
+    // Whether the batch stopped short of 'end_index', in which case ops
+    // appended since don't change it.
+    bool limited = false;
+    ReplicateSpanPtr span;
+  };
+  LastSpan last_span_;
+
   struct Metrics {
     explicit Metrics(const scoped_refptr<MetricEntity>& metric_entity);
 
@@ -0,0 +1,134 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/log_cache_manager.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/consensus/log_cache.h"
+
+using std::vector;
+
+namespace kudu {
+namespace consensus {
+
+// How often the demand of every cache is halved, so that it reflects recent
+// reads rather than the whole lifetime of the tablet.
+static const int64_t kDemandDecayPeriodMs = 1000;
+
+LogCacheManager* LogCacheManager::Get() {
+  // Leaked on purpose, since caches may be destroyed during static destruction.
+  static LogCacheManager* instance = new LogCacheManager();
+  return instance;
+}
+
+LogCacheManager::LogCacheManager()
+    : last_decay_time_(MonoTime::Now()),
+      read_sequence_(0) {
+}
+
+void LogCacheManager::RegisterCache(LogCache* cache) {
+  std::lock_guard<std::mutex> l(lock_);
+  DCHECK(std::find(caches_.begin(), caches_.end(), cache) == caches_.end());
+  caches_.push_back(cache);
+}
+
+void LogCacheManager::UnregisterCache(LogCache* cache) {
+  std::lock_guard<std::mutex> l(lock_);
+  auto it = std::find(caches_.begin(), caches_.end(), cache);
+  DCHECK(it != caches_.end());
+  if (it != caches_.end()) {
+    caches_.erase(it);
+  }
+}
+
+void LogCacheManager::MaybeDecayDemandUnlocked() {
+  MonoTime now = MonoTime::Now();
+  if (now - last_decay_time_ < MonoDelta::FromMilliseconds(kDemandDecayPeriodMs)) {
+    return;
+  }
+  for (LogCache* cache : caches_) {
+    cache->DecayDemand();
+  }
+  last_decay_time_ = now;
+}
+
+int64_t LogCacheManager::TotalWeightUnlocked() const {
+  int64_t total_weight = 0;
+  for (const LogCache* cache : caches_) {
+    total_weight += 1 + cache->demand();
+  }
+  return total_weight;
+}
+
+int64_t LogCacheManager::FairShareUnlocked(const LogCache* cache, int64_t budget,
+                                           int64_t total_weight) {
+  DCHECK_GT(total_weight, 0);
+  // Compute in floating point: the product may overflow int64_t.
+  return static_cast<int64_t>(static_cast<double>(budget) * (1 + cache->demand()) /
+                              total_weight);
+}
+
+int64_t LogCacheManager::FairShare(const LogCache* cache, int64_t budget) {
+  std::lock_guard<std::mutex> l(lock_);
+  DCHECK(std::find(caches_.begin(), caches_.end(), cache) != caches_.end());
+  return FairShareUnlocked(cache, budget, TotalWeightUnlocked());
+}
+
+int64_t LogCacheManager::Reclaim(int64_t budget, int64_t bytes_to_free) {
+  std::lock_guard<std::mutex> l(lock_);
+  if (caches_.empty()) {
+    return 0;
+  }
+  MaybeDecayDemandUnlocked();
+
+  // Collect the caches which are over their fair share, along with how much
+  // they are over by.
+  int64_t total_weight = TotalWeightUnlocked();
+  vector<std::pair<LogCache*, int64_t>> candidates;
+  for (LogCache* cache : caches_) {
+    int64_t excess = cache->BytesUsed() - FairShareUnlocked(cache, budget, total_weight);
+    if (excess > 0) {
+      candidates.emplace_back(cache, excess);
+    }
+  }
+
+  // Evict from the least recently read caches first.
+  std::sort(candidates.begin(), candidates.end(),
+            [](const std::pair<LogCache*, int64_t>& a,
+               const std::pair<LogCache*, int64_t>& b) {
+              return a.first->last_read_sequence() < b.first->last_read_sequence();
+            });
+
+  int64_t bytes_freed = 0;
+  for (const auto& candidate : candidates) {
+    if (bytes_freed >= bytes_to_free) {
+      break;
+    }
+    bytes_freed += candidate.first->EvictForMemoryPressure(
+        std::min(candidate.second, bytes_to_free - bytes_freed));
+  }
+  VLOG(1) << "Reclaimed " << bytes_freed << " of " << bytes_to_free
+          << " requested bytes from " << candidates.size() << " log caches";
+  return bytes_freed;
+}
+
+} // namespace consensus
+} // namespace kudu
@@ -0,0 +1,105 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_LOG_CACHE_MANAGER_H
+#define KUDU_CONSENSUS_LOG_CACHE_MANAGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace consensus {
+
+class LogCache;
+
+// Server-wide manager of the memory used by the log caches of all tablets.
+//
+// By default each LogCache is limited by --log_cache_size_limit_mb and, when
+// it runs out of memory, only evicts its own ops. So a busy tablet evicts ops
+// its lagging followers still need while an idle tablet keeps holding ops it
+// may never serve. With --log_cache_shared_budget, the per-tablet limit is
+// lifted, and when an append would exceed the global budget the manager
+// reclaims memory from the caches which use more than their fair share of it,
+// least recently read first.
+//
+// A cache's fair share of the global budget is proportional to its demand
+// (see LogCache::demand()), which grows as peers that are behind read from it
+// and when it has to fall back to reading from disk, and decays over time.
+// This lets tablets with lagging followers keep more of their ops in memory
+// without raising the total memory used by all log caches.
+//
+// This class is thread-safe.
+class LogCacheManager {
+ public:
+  // Return the singleton instance.
+  static LogCacheManager* Get();
+
+  void RegisterCache(LogCache* cache);
+  void UnregisterCache(LogCache* cache);
+
+  // Try to free at least 'bytes_to_free' bytes from caches which are using
+  // more than their fair share of 'budget' bytes, evicting from the least
+  // recently read cache first. The caches may include the caller. Returns the
+  // number of bytes that were actually freed.
+  //
+  // Must not be called with the lock of any LogCache held.
+  int64_t Reclaim(int64_t budget, int64_t bytes_to_free);
+
+  // Return the fair share of 'budget' bytes for 'cache', which must be
+  // registered.
+  int64_t FairShare(const LogCache* cache, int64_t budget);
+
+  // Return a new value of a logical clock which orders reads across all
+  // caches, used to find the least recently read one.
+  int64_t NextReadSequence() {
+    return read_sequence_.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+ private:
+  LogCacheManager();
+
+  // Halve the demand of every registered cache if a decay period has passed.
+  void MaybeDecayDemandUnlocked();
+
+  // Return the fair share of 'budget' bytes for 'cache' given the total demand
+  // of all registered caches.
+  static int64_t FairShareUnlocked(const LogCache* cache, int64_t budget,
+                                   int64_t total_weight);
+
+  // Return the sum of the weights of all registered caches.
+  int64_t TotalWeightUnlocked() const;
+
+  std::mutex lock_;
+
+  // The registered caches. Protected by 'lock_'.
+  std::vector<LogCache*> caches_;
+
+  // The last time demand was decayed. Protected by 'lock_'.
+  MonoTime last_decay_time_;
+
+  std::atomic<int64_t> read_sequence_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogCacheManager);
+};
+
+} // namespace consensus
+} // namespace kudu
+#endif /* KUDU_CONSENSUS_LOG_CACHE_MANAGER_H */
@@ -15,9 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <atomic>
 #include <cstdint>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include <glog/logging.h>
 #include <gtest/gtest.h>
 
 #include "kudu/consensus/log_index.h"
@@ -25,6 +29,8 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -34,6 +40,8 @@ namespace log {
 
 using consensus::MakeOpId;
 using consensus::OpId;
+using std::thread;
+using std::vector;
 
 class LogIndexTest : public KuduTest {
  public:
@@ -117,5 +125,52 @@ TEST_F(LogIndexTest, TestMultiSegmentWithGC) {
   VerifyNotFound(2500000);
 }
 
+// Microbenchmark for concurrent AddEntry() and GetEntry() calls: one writer
+// appends entries across several chunks while readers look up random entries
+// which have already been written, as peers catching up through the log cache
+// do.
+TEST_F(LogIndexTest, TestConcurrentAddAndGetEntries) {
+  const int64_t kNumEntries = AllowSlowTests() ? 5000000 : 1500000;
+  const int kNumReaders = 4;
+
+  std::atomic<int64_t> last_written(0);
+  std::atomic<bool> done(false);
+  std::atomic<int64_t> total_reads(0);
+
+  vector<thread> readers;
+  for (int i = 0; i < kNumReaders; i++) {
+    readers.emplace_back([&, i]() {
+      Random rng(i);
+      int64_t reads = 0;
+      while (!done.load()) {
+        int64_t max_index = last_written.load();
+        if (max_index == 0) continue;
+        int64_t index = 1 + rng.Uniform64(max_index);
+        LogIndexEntry result;
+        CHECK_OK(index_->GetEntry(index, &result));
+        CHECK_EQ(index, result.offset_in_segment);
+        reads++;
+      }
+      total_reads += reads;
+    });
+  }
+
+  MonoTime start = MonoTime::Now();
+  for (int64_t index = 1; index <= kNumEntries; index++) {
+    ASSERT_OK(AddEntry(MakeOpId(1, index), 1, index));
+    last_written.store(index);
+  }
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+  MonoDelta elapsed = MonoTime::Now() - start;
+
+  LOG(INFO) << "Wrote " << kNumEntries << " entries and performed " << total_reads.load()
+            << " concurrent reads from " << kNumReaders << " threads in "
+            << elapsed.ToString() << " ("
+            << (kNumEntries + total_reads.load()) / elapsed.ToSeconds() << " ops/sec)";
+}
+
 } // namespace log
 } // namespace kudu
@@ -25,6 +25,12 @@
 //
 // When the log is GCed, we remove any index chunks which are no longer needed, and
 // unmap them.
+//
+// The set of open chunks changes only when a new chunk is opened (once every
+// kEntriesPerIndexChunk entries) or when chunks are GCed, while lookups happen
+// on every append and on every log cache miss. So the set is published
+// copy-on-write: lookups load an immutable snapshot and never contend with each
+// other or with a writer opening a chunk.
 
 #include "kudu/consensus/log_index.h"
 
@@ -36,6 +42,7 @@
 #include <cinttypes>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <string>
@@ -51,6 +58,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/errno.h"
 
+using std::shared_ptr;
 using std::string;
 using std::vector;
 using strings::Substitute;
@@ -156,7 +164,9 @@ void LogIndex::IndexChunk::SetEntry(int entry_index, const PhysicalEntry& entry)
 // LogIndex
 ////////////////////////////////////////////////////////////
 
-LogIndex::LogIndex(std::string base_dir) : base_dir_(std::move(base_dir)) {}
+LogIndex::LogIndex(std::string base_dir)
+    : base_dir_(std::move(base_dir)),
+      open_chunks_(std::make_shared<const ChunkMap>()) {}
 
 LogIndex::~LogIndex() {
 }
@@ -179,11 +189,8 @@ Status LogIndex::GetChunkForIndex(int64_t log_index, bool create,
   CHECK_GT(log_index, 0);
   int64_t chunk_idx = log_index / kEntriesPerIndexChunk;
 
-  {
-    std::lock_guard<simple_spinlock> l(open_chunks_lock_);
-    if (FindCopy(open_chunks_, chunk_idx, chunk)) {
-      return Status::OK();
-    }
+  if (FindCopy(*chunks_snapshot(), chunk_idx, chunk)) {
+    return Status::OK();
   }
 
   if (!create) {
@@ -194,14 +201,17 @@ Status LogIndex::GetChunkForIndex(int64_t log_index, bool create,
                         "Couldn't open index chunk");
   {
     std::lock_guard<simple_spinlock> l(open_chunks_lock_);
-    if (PREDICT_FALSE(ContainsKey(open_chunks_, chunk_idx))) {
+    shared_ptr<const ChunkMap> old_chunks = chunks_snapshot();
+    if (PREDICT_FALSE(ContainsKey(*old_chunks, chunk_idx))) {
       // Someone else opened the chunk in the meantime.
       // We'll just return that one.
-      *chunk = FindOrDie(open_chunks_, chunk_idx);
+      *chunk = FindOrDie(*old_chunks, chunk_idx);
       return Status::OK();
     }
 
-    InsertOrDie(&open_chunks_, chunk_idx, *chunk);
+    auto new_chunks = std::make_shared<ChunkMap>(*old_chunks);
+    InsertOrDie(new_chunks.get(), chunk_idx, *chunk);
+    std::atomic_store(&open_chunks_, shared_ptr<const ChunkMap>(std::move(new_chunks)));
   }
 
   return Status::OK();
@@ -251,14 +261,15 @@ void LogIndex::GC(int64_t min_index_to_retain) {
   // Enumerate which chunks to delete.
   vector<int64_t> chunks_to_delete;
   {
-    std::lock_guard<simple_spinlock> l(open_chunks_lock_);
-    for (auto it = open_chunks_.begin();
-         it != open_chunks_.lower_bound(min_chunk_to_retain); ++it) {
+    shared_ptr<const ChunkMap> chunks = chunks_snapshot();
+    for (auto it = chunks->begin();
+         it != chunks->lower_bound(min_chunk_to_retain); ++it) {
       chunks_to_delete.push_back(it->first);
     }
   }
 
   // Outside of the lock, try to delete them (avoid holding the lock during IO).
+  vector<int64_t> deleted_chunks;
   for (int64_t chunk_idx : chunks_to_delete) {
     string path = GetChunkPath(chunk_idx);
     int rc = unlink(path.c_str());
@@ -267,11 +278,18 @@ void LogIndex::GC(int64_t min_index_to_retain) {
       continue;
     }
     LOG(INFO) << "Deleted log index segment " << path;
-    {
-      std::lock_guard<simple_spinlock> l(open_chunks_lock_);
-      open_chunks_.erase(chunk_idx);
-    }
+    deleted_chunks.push_back(chunk_idx);
+  }
+  if (deleted_chunks.empty()) {
+    return;
+  }
+
+  std::lock_guard<simple_spinlock> l(open_chunks_lock_);
+  auto new_chunks = std::make_shared<ChunkMap>(*chunks_snapshot());
+  for (int64_t chunk_idx : deleted_chunks) {
+    new_chunks->erase(chunk_idx);
   }
+  std::atomic_store(&open_chunks_, shared_ptr<const ChunkMap>(std::move(new_chunks)));
 }
 
 string LogIndexEntry::ToString() const {
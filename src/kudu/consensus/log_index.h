@@ -18,8 +18,9 @@
 #define KUDU_CONSENSUS_LOG_INDEX_H
 
 #include <cstdint>
-#include <string>
 #include <map>
+#include <memory>
+#include <string>
 
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/gutil/macros.h"
@@ -95,13 +96,23 @@ class LogIndex : public RefCountedThreadSafe<LogIndex> {
   // The base directory where index files are located.
   const std::string base_dir_;
 
-  simple_spinlock open_chunks_lock_;
-
   // Map from chunk index to IndexChunk. The chunk index is the log index modulo
   // the number of entries per chunk (see docs in log_index.cc).
-  // Protected by open_chunks_lock_
   typedef std::map<int64_t, scoped_refptr<IndexChunk> > ChunkMap;
-  ChunkMap open_chunks_;
+
+  // Return the current snapshot of the open chunks.
+  std::shared_ptr<const ChunkMap> chunks_snapshot() const {
+    return std::atomic_load(&open_chunks_);
+  }
+
+  // Serializes writers which replace 'open_chunks_'. Readers never take it.
+  simple_spinlock open_chunks_lock_;
+
+  // An immutable snapshot of the open chunks. Readers atomically load it and
+  // look up their chunk without locking; writers build a modified copy under
+  // 'open_chunks_lock_' and atomically publish it. A chunk dropped by GC stays
+  // mapped until the last reader holding an older snapshot releases it.
+  std::shared_ptr<const ChunkMap> open_chunks_;
 
   DISALLOW_COPY_AND_ASSIGN(LogIndex);
 };
@@ -36,7 +36,8 @@ METRIC_DEFINE_histogram(tablet, log_append_latency, "Log Append Latency",
 METRIC_DEFINE_histogram(tablet, log_group_commit_latency, "Log Group Commit Latency",
                         kudu::MetricUnit::kMicroseconds,
                         "Microseconds spent on committing an entire group",
-                        60000000LU, 2);
+                        60000000LU, 2,
+                        kudu::SHARDED);
 
 METRIC_DEFINE_histogram(tablet, log_roll_latency, "Log Roll Latency",
                         kudu::MetricUnit::kMicroseconds,
@@ -48,19 +49,47 @@ METRIC_DEFINE_histogram(tablet, log_entry_batches_per_group, "Log Group Commit B
                         "Number of log entry batches in a group commit group",
                         1024, 2);
 
+METRIC_DEFINE_histogram(tablet, log_entry_batches_per_sync, "Log Entry Batches per Sync",
+                        kudu::MetricUnit::kRequests,
+                        "Number of log entry batches made durable by each sync of the log",
+                        1024, 2);
+
+METRIC_DEFINE_histogram(tablet, log_group_commit_window, "Log Group Commit Window",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds the log append thread chose to wait for more entry "
+                        "batches before committing a group, when adaptive group commit "
+                        "is enabled",
+                        60000000LU, 2);
+
+METRIC_DEFINE_gauge_int64(tablet, log_append_stage_depth, "Log Append Stage Depth",
+                          kudu::MetricUnit::kRequests,
+                          "Number of log entry batches currently being written by the "
+                          "append stage of a pipelined WAL");
+
+METRIC_DEFINE_gauge_int64(tablet, log_sync_stage_depth, "Log Sync Stage Depth",
+                          kudu::MetricUnit::kRequests,
+                          "Number of written groups of log entry batches waiting to be "
+                          "synced by the sync stage of a pipelined WAL");
+
 namespace kudu {
 namespace log {
 
 #define MINIT(x) x(METRIC_log_##x.Instantiate(metric_entity))
+#define GINIT(x) x(METRIC_log_##x.Instantiate(metric_entity, 0))
 LogMetrics::LogMetrics(const scoped_refptr<MetricEntity>& metric_entity)
     : MINIT(bytes_logged),
       MINIT(sync_latency),
       MINIT(append_latency),
       MINIT(group_commit_latency),
       MINIT(roll_latency),
-      MINIT(entry_batches_per_group) {
+      MINIT(entry_batches_per_group),
+      MINIT(entry_batches_per_sync),
+      MINIT(group_commit_window),
+      GINIT(append_stage_depth),
+      GINIT(sync_stage_depth) {
 }
 #undef MINIT
+#undef GINIT
 
 } // namespace log
 } // namespace kudu
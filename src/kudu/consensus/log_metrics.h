@@ -17,6 +17,8 @@
 #ifndef KUDU_CONSENSUS_LOG_METRICS_H
 #define KUDU_CONSENSUS_LOG_METRICS_H
 
+#include <cstdint>
+
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/metrics.h"
 
@@ -35,6 +37,12 @@ struct LogMetrics {
   scoped_refptr<Histogram> group_commit_latency;
   scoped_refptr<Histogram> roll_latency;
   scoped_refptr<Histogram> entry_batches_per_group;
+  scoped_refptr<Histogram> entry_batches_per_sync;
+  scoped_refptr<Histogram> group_commit_window;
+
+  // Pipelined append stage stats
+  scoped_refptr<AtomicGauge<int64_t>> append_stage_depth;
+  scoped_refptr<AtomicGauge<int64_t>> sync_stage_depth;
 };
 
 } // namespace log
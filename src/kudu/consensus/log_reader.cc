@@ -21,6 +21,7 @@
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <set>
 
 #include <glog/logging.h>
 
@@ -29,6 +30,7 @@
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -128,19 +130,45 @@ Status LogReader::Init(const string& tablet_wal_path) {
     return Status::IllegalState("Cannot find wal location at", tablet_wal_path);
   }
 
-  VLOG(1) << "Parsing segments from path: " << tablet_wal_path;
+  SegmentSequence read_segments;
+  RETURN_NOT_OK(OpenSegmentsInDir(tablet_wal_path, &read_segments));
+
+  // Closed segments may have been migrated to the archive directory. A
+  // segment found in both directories was being migrated when the server
+  // stopped, so prefer the copy in the WAL directory.
+  const string archive_dir = GetArchiveDirForWalDir(tablet_wal_path);
+  if (!archive_dir.empty() && env_->FileExists(archive_dir)) {
+    std::set<int64_t> seqnos;
+    for (const auto& segment : read_segments) {
+      seqnos.insert(segment->header().sequence_number());
+    }
+    SegmentSequence archived_segments;
+    RETURN_NOT_OK(OpenSegmentsInDir(archive_dir, &archived_segments));
+    for (const auto& segment : archived_segments) {
+      if (ContainsKey(seqnos, segment->header().sequence_number())) {
+        VLOG(1) << "Ignoring log segment " << segment->path() << " also found in "
+                << tablet_wal_path;
+        continue;
+      }
+      segments->push_back(segment);
+    }
+  }
+  return Status::OK();
+}
+
+Status LogReader::OpenSegmentsInDir(const string& dir, SegmentSequence* segments) {
+  VLOG(1) << "Parsing segments from path: " << dir;
   // list existing segment files
   vector<string> log_files;
 
-  RETURN_NOT_OK_PREPEND(env_->GetChildren(tablet_wal_path, &log_files),
+  RETURN_NOT_OK_PREPEND(env_->GetChildren(dir, &log_files),
                         "Unable to read children from path");
 
-  SegmentSequence read_segments;
-
   // build a log segment from each file
   for (const string &log_file : log_files) {
-    if (HasPrefixString(log_file, FsManager::kWalFileNamePrefix)) {
-      string fqp = JoinPathSegments(tablet_wal_path, log_file);
+    if (HasPrefixString(log_file, FsManager::kWalFileNamePrefix) &&
+        !HasSuffixString(log_file, kSegmentIndexFileSuffix)) {
+      string fqp = JoinPathSegments(dir, log_file);
       scoped_refptr<ReadableLogSegment> segment;
       Status s = ReadableLogSegment::Open(env_, fqp, &segment);
       if (s.IsUninitialized()) {
@@ -159,7 +187,9 @@ Status LogReader::Init(const string& tablet_wal_path) {
       if (!segment->HasFooter()) {
         VLOG(1) << "Log segment " << fqp << " was likely left in-progress "
                 << "after a previous crash. Will try to rebuild footer by scanning data.";
-        RETURN_NOT_OK(segment->RebuildFooterByScanning());
+        LogSegmentIndexCheckpointPB checkpoint;
+        bool has_checkpoint = ReadLastSegmentIndexCheckpoint(env_, fqp, &checkpoint).ok();
+        RETURN_NOT_OK(segment->RebuildFooterByScanning(has_checkpoint ? &checkpoint : nullptr));
       }
 
       read_segments.push_back(segment);
@@ -261,7 +291,7 @@ Status LogReader::ReadBatchUsingIndexEntry(const LogIndexEntry& index_entry,
                                    index_entry.offset_in_segment));
 
   if (bytes_read_) {
-    bytes_read_->IncrementBy(segment->entry_header_size() + tmp_buf->length());
+    bytes_read_->IncrementBy(offset - index_entry.offset_in_segment);
     entries_read_->IncrementBy((**batch).entry_size());
   }
 
@@ -404,6 +434,21 @@ Status LogReader::ReplaceLastSegment(const scoped_refptr<ReadableLogSegment>& se
   return Status::OK();
 }
 
+Status LogReader::ReplaceSegment(const scoped_refptr<ReadableLogSegment>& segment) {
+  DCHECK(segment->HasFooter());
+
+  std::lock_guard<simple_spinlock> lock(lock_);
+  CHECK_EQ(state_, kLogReaderReading);
+  const int64_t seqno = segment->header().sequence_number();
+  for (auto& existing : segments_) {
+    if (existing->header().sequence_number() == seqno) {
+      existing = segment;
+      return Status::OK();
+    }
+  }
+  return Status::NotFound(Substitute("Segment $0 is not in the reader", seqno));
+}
+
 Status LogReader::AppendSegment(const scoped_refptr<ReadableLogSegment>& segment) {
   DCHECK(segment->IsInitialized());
   if (PREDICT_FALSE(!segment->HasFooter())) {
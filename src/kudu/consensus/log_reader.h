@@ -152,6 +152,12 @@ class LogReader : public enable_make_shared<LogReader> {
   // Expects 'segment' to be properly closed and to have footer.
   Status ReplaceLastSegment(const scoped_refptr<ReadableLogSegment>& segment);
 
+  // Replaces the segment in the reader with the same sequence number as
+  // 'segment', which must be a closed copy of it, e.g. once migrated to the
+  // archive directory. Returns Status::NotFound() if the reader has no such
+  // segment, e.g. since it was GCed meanwhile.
+  Status ReplaceSegment(const scoped_refptr<ReadableLogSegment>& segment);
+
   // Appends 'segment' to the segment sequence.
   // Assumes that the segment was scanned, if no footer was found.
   // To be used only internally, clients of this class with private access (i.e. friends)
@@ -171,9 +177,13 @@ class LogReader : public enable_make_shared<LogReader> {
                                   faststring* tmp_buf,
                                   std::unique_ptr<LogEntryBatchPB>* batch) const;
 
-  // Reads the headers of all segments in 'tablet_wal_path'.
+  // Reads the headers of all segments in 'tablet_wal_path' and, if set, in
+  // its archive directory of --log_archive_dir.
   Status Init(const std::string& tablet_wal_path);
 
+  // Opens the segments in 'dir', appending them to 'segments'.
+  Status OpenSegmentsInDir(const std::string& dir, SegmentSequence* segments);
+
   // Initializes an 'empty' reader for tests, i.e. does not scan a path looking for segments.
   Status InitEmptyReaderForTests();
 
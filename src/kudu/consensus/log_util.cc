@@ -17,10 +17,17 @@
 
 #include "kudu/consensus/log_util.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <utility>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -29,6 +36,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -38,13 +46,17 @@
 #include "kudu/util/coding.h"
 #include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(log_segment_size_mb, 8,
              "The default size for log segments, in MB");
@@ -62,6 +74,94 @@ DEFINE_bool(log_async_preallocate_segments, true,
             "Whether the WAL segments preallocation should happen asynchronously");
 TAG_FLAG(log_async_preallocate_segments, advanced);
 
+DEFINE_bool(log_pipelined_append, false,
+            "Whether the WAL append thread should hand each written group of entry "
+            "batches off to a separate sync stage, so that the next group can be "
+            "written while the previous one is being synced to disk");
+TAG_FLAG(log_pipelined_append, experimental);
+
+DEFINE_bool(log_adaptive_group_commit, false,
+            "Whether the WAL append thread should wait for a short, adaptively chosen "
+            "window for more entry batches to arrive before committing a group, in "
+            "order to amortize each sync over more batches");
+TAG_FLAG(log_adaptive_group_commit, experimental);
+
+DEFINE_int32(log_group_commit_max_window_us, 500,
+             "Maximum number of microseconds the WAL append thread waits for more "
+             "entry batches before committing a group. Only takes effect if "
+             "--log_adaptive_group_commit is true");
+TAG_FLAG(log_group_commit_max_window_us, experimental);
+TAG_FLAG(log_group_commit_max_window_us, runtime);
+
+DEFINE_int32(log_append_threads_per_wal_dir, 0,
+             "If greater than 0, the WAL appends of all tablets whose WALs share a "
+             "root directory are multiplexed onto a single pool with this many "
+             "threads, bounding the number of concurrent appends and syncs per disk. "
+             "If 0, each tablet's WAL has its own append thread");
+TAG_FLAG(log_append_threads_per_wal_dir, experimental);
+
+DEFINE_bool(log_group_sync_per_wal_dir, false,
+            "Whether the WALs of all tablets sharing a root directory are synced "
+            "together, by a single syncfs() of the file system holding it which "
+            "makes the writes of all the WALs waiting for a sync durable, instead "
+            "of each WAL fsyncing its own segment. Only pays off when the WAL root "
+            "directory has a file system of its own, since the sync flushes "
+            "everything written to it. Falls back to fsync on platforms without "
+            "syncfs()");
+TAG_FLAG(log_group_sync_per_wal_dir, experimental);
+
+DEFINE_bool(log_direct_io, false,
+            "Whether to write WAL segments with O_DIRECT, bypassing the page cache. "
+            "Each write is padded to the file system block size.");
+TAG_FLAG(log_direct_io, experimental);
+
+DEFINE_bool(log_dsync, false,
+            "Whether to open WAL segments with O_DSYNC, making each write durable "
+            "as it completes instead of at the following sync.");
+TAG_FLAG(log_dsync, experimental);
+
+DEFINE_bool(log_mmap_closed_segments, false,
+            "Whether to memory-map closed WAL segments and read their entries "
+            "straight from the page cache, rather than into per-read heap buffers. "
+            "Mapped segments are hinted for sequential readahead.");
+TAG_FLAG(log_mmap_closed_segments, experimental);
+
+DEFINE_int32(log_read_decode_threads, 0,
+             "If greater than 0, the WAL entry batches read by replay and catch-up "
+             "are verified against their checksums and decompressed by a pool of "
+             "this many threads shared by all the logs of the process, rather than "
+             "by the reading thread");
+TAG_FLAG(log_read_decode_threads, experimental);
+
+DEFINE_int32(log_read_ahead_batches, 8,
+             "The number of WAL entry batches each reader reads ahead of the entry "
+             "it returns, to be decoded in parallel. Only takes effect if "
+             "--log_read_decode_threads is greater than 0");
+TAG_FLAG(log_read_ahead_batches, experimental);
+TAG_FLAG(log_read_ahead_batches, runtime);
+
+DEFINE_string(log_archive_dir, "",
+              "If set, the directory closed WAL segments are migrated to in the "
+              "background, e.g. on bulk storage, keeping only the active segment "
+              "and the most recent closed ones in the WAL directory, which may then "
+              "be on a small, fast device. Segments remain readable from either "
+              "directory. Must be unique to this server, and must not be unset "
+              "while it holds segments.");
+TAG_FLAG(log_archive_dir, experimental);
+
+DEFINE_bool(log_compact_entry_headers, false,
+            "Whether new WAL segments prefix their entries with compact, "
+            "variable-length headers rather than fixed 16-byte ones. Segments "
+            "written this way can't be read by versions which predate the format.");
+TAG_FLAG(log_compact_entry_headers, experimental);
+
+DEFINE_bool(log_omit_segment_schema, false,
+            "Whether to leave the schema out of the headers of new WAL segments. "
+            "Only for embeddings of the log which don't bootstrap a tablet from it: "
+            "tablet bootstrap fails on segments without a schema.");
+TAG_FLAG(log_omit_segment_schema, experimental);
+TAG_FLAG(log_omit_segment_schema, unsafe);
+
 DEFINE_double(fault_crash_before_write_log_segment_header, 0.0,
               "Fraction of the time we will crash just before writing the log segment header");
 TAG_FLAG(fault_crash_before_write_log_segment_header, unsafe);
@@ -94,6 +194,13 @@ const size_t kLogSegmentFooterMagicAndFooterLength  = 12;
 const size_t kEntryHeaderSizeV1 = 12;
 // Later versions, which added support for compression, use a 16-byte header.
 const size_t kEntryHeaderSizeV2 = 16;
+// Segments with the COMPACT_ENTRY_HEADERS feature use a header made of one or
+// two varints followed by two CRCs. See DecodeEntryHeader().
+const size_t kMaxVarint32Size = 5;
+const size_t kEntryHeaderSizeCompactMin = 1 + 8;
+const size_t kEntryHeaderSizeCompactMax = kMaxVarint32Size * 2 + 8;
+static_assert(kEntryHeaderSizeCompactMax >= kEntryHeaderSizeV2,
+              "WriteEntryBatch()'s header buffer must fit a V2 entry header");
 
 // Maximum log segment header/footer size, in bytes (8 MB).
 const uint32_t kLogSegmentMaxHeaderOrFooterSize = 8 * 1024 * 1024;
@@ -102,18 +209,93 @@ LogOptions::LogOptions()
 : segment_size_mb(FLAGS_log_segment_size_mb),
   force_fsync_all(FLAGS_log_force_fsync_all),
   preallocate_segments(FLAGS_log_preallocate_segments),
-  async_preallocate_segments(FLAGS_log_async_preallocate_segments) {
+  async_preallocate_segments(FLAGS_log_async_preallocate_segments),
+  pipelined_append(FLAGS_log_pipelined_append),
+  adaptive_group_commit(FLAGS_log_adaptive_group_commit),
+  append_threads_per_wal_dir(FLAGS_log_append_threads_per_wal_dir),
+  group_sync_per_wal_dir(FLAGS_log_group_sync_per_wal_dir),
+  direct_io(FLAGS_log_direct_io),
+  dsync(FLAGS_log_dsync),
+  compact_entry_headers(FLAGS_log_compact_entry_headers),
+  omit_segment_schema(FLAGS_log_omit_segment_schema) {
 }
 
+namespace {
+
+bool HasCompactEntryHeaders(const LogSegmentHeaderPB& header) {
+  for (int32_t feature : header.incompatible_features()) {
+    if (feature == LogSegmentHeaderPB::COMPACT_ENTRY_HEADERS) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
 ////////////////////////////////////////////////////////////
 // LogEntryReader
 ////////////////////////////////////////////////////////////
 
+namespace {
+
+// Returns the pool shared by all the log entry readers of the process to
+// decode entry batches with, sized by --log_read_decode_threads.
+ThreadPool* GetSharedDecodePool() {
+  static ThreadPool* pool = [] {
+    gscoped_ptr<ThreadPool> new_pool;
+    CHECK_OK(ThreadPoolBuilder("log-decode")
+             .set_max_threads(FLAGS_log_read_decode_threads)
+             .Build(&new_pool));
+    return new_pool.release();
+  }();
+  return pool;
+}
+
+} // anonymous namespace
+
+struct LogEntryReader::PendingBatch {
+  explicit PendingBatch(int64_t offset)
+      : offset(offset),
+        next_offset(offset),
+        status_detail(EntryHeaderStatus::OTHER_ERROR),
+        decoded(1) {
+  }
+
+  // The offset of the batch's header, and of the batch following it.
+  int64_t offset;
+  int64_t next_offset;
+
+  ReadableLogSegment::EntryHeader header;
+
+  // The still encoded data of the batch, and the buffer it is read and
+  // decoded into.
+  Slice data;
+  faststring buf;
+
+  // The outcome of reading and decoding the batch.
+  Status status;
+  EntryHeaderStatus status_detail;
+  std::unique_ptr<LogEntryBatchPB> batch;
+
+  // Counted down once the batch is decoded, or failed to be read.
+  CountDownLatch decoded;
+};
+
 LogEntryReader::LogEntryReader(ReadableLogSegment* seg)
+    : LogEntryReader(seg, seg->first_entry_offset()) {
+}
+
+LogEntryReader::LogEntryReader(ReadableLogSegment* seg, int64_t offset)
     : seg_(seg),
       num_batches_read_(0),
       num_entries_read_(0),
-      offset_(seg_->first_entry_offset()) {
+      offset_(offset),
+      read_ahead_offset_(offset_),
+      read_ahead_failed_(false) {
+  if (FLAGS_log_read_decode_threads > 0) {
+    decode_token_ = GetSharedDecodePool()->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  }
 
   int64_t readable_to_offset = seg_->readable_to_offset_.Load();
 
@@ -127,7 +309,10 @@ LogEntryReader::LogEntryReader(ReadableLogSegment* seg)
           << seg_->file_size() << " readable_to_offset=" << readable_to_offset;
 }
 
-LogEntryReader::~LogEntryReader() {}
+LogEntryReader::~LogEntryReader() {
+  // The decode pool may still be decoding into the batches read ahead.
+  ClearReadAhead();
+}
 
 Status LogEntryReader::ReadNextEntry(unique_ptr<LogEntryPB>* entry) {
   // Refill pending_entries_ if none are available.
@@ -151,7 +336,9 @@ Status LogEntryReader::ReadNextEntry(unique_ptr<LogEntryPB>* entry) {
     // Read and validate the entry header first.
     Status s;
     EntryHeaderStatus s_detail = EntryHeaderStatus::OTHER_ERROR;
-    if (offset_ + seg_->entry_header_size() < read_up_to_) {
+    if (decode_token_) {
+      s = ReadNextBatchFromReadAhead(&current_batch, &s_detail);
+    } else if (offset_ + seg_->min_entry_header_size() < read_up_to_) {
       s = seg_->ReadEntryHeaderAndBatch(&offset_, &tmp_buf_, &current_batch, &s_detail);
     } else {
       s = Status::Corruption(Substitute("Truncated log entry at offset $0", offset_));
@@ -188,6 +375,106 @@ Status LogEntryReader::ReadNextEntry(unique_ptr<LogEntryPB>* entry) {
   return Status::OK();
 }
 
+Status LogEntryReader::ReadNextBatchFromReadAhead(unique_ptr<LogEntryBatchPB>* batch,
+                                                  EntryHeaderStatus* status_detail) {
+  FillReadAhead();
+  DCHECK(!read_ahead_.empty());
+  unique_ptr<PendingBatch> pending = std::move(read_ahead_.front());
+  read_ahead_.pop_front();
+  DCHECK_EQ(offset_, pending->offset);
+  pending->decoded.Wait();
+  if (PREDICT_FALSE(!pending->status.ok())) {
+    // There's no reading past the error.
+    ClearReadAhead();
+    *status_detail = pending->status_detail;
+    return pending->status;
+  }
+  offset_ = pending->next_offset;
+  *batch = std::move(pending->batch);
+  return Status::OK();
+}
+
+void LogEntryReader::FillReadAhead() {
+  const size_t max_batches = std::max(1, FLAGS_log_read_ahead_batches);
+  // The batches read by this call, whose checksums are verified together.
+  vector<PendingBatch*> read;
+  while (read_ahead_.size() < max_batches &&
+         !read_ahead_failed_ &&
+         read_ahead_offset_ < read_up_to_) {
+    // The headers are read in order, to find where each batch starts.
+    unique_ptr<PendingBatch> pending(new PendingBatch(read_ahead_offset_));
+    int64_t data_offset = read_ahead_offset_;
+    Status s;
+    if (data_offset + seg_->min_entry_header_size() < read_up_to_) {
+      s = seg_->ReadEntryHeader(&data_offset, &pending->header, &pending->status_detail);
+      if (s.ok()) {
+        s = seg_->ReadEntryBatchData(data_offset, pending->header, &pending->buf,
+                                     &pending->data);
+        if (PREDICT_FALSE(!s.ok())) {
+          pending->status_detail = EntryHeaderStatus::OTHER_ERROR;
+        }
+      }
+    } else {
+      s = Status::Corruption(Substitute("Truncated log entry at offset $0", read_ahead_offset_));
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      pending->status = s;
+      pending->decoded.CountDown();
+      read_ahead_.emplace_back(std::move(pending));
+      read_ahead_failed_ = true;
+      break;
+    }
+    pending->next_offset = data_offset + pending->header.msg_length_compressed;
+    read_ahead_offset_ = pending->next_offset;
+    read.push_back(pending.get());
+    read_ahead_.emplace_back(std::move(pending));
+  }
+  if (read.empty()) {
+    return;
+  }
+
+  // Most batches are small, so verifying their checksums together is much
+  // faster than one at a time in the decode pool.
+  vector<Slice> data;
+  data.reserve(read.size());
+  for (const auto* p : read) {
+    data.push_back(p->data);
+  }
+  vector<uint32_t> crcs(read.size());
+  crc::Crc32cMulti(data, crcs.data());
+
+  for (size_t i = 0; i < read.size(); i++) {
+    PendingBatch* p = read[i];
+    int64_t data_offset = p->next_offset - p->header.msg_length_compressed;
+    p->status = seg_->CheckEntryBatchCrc(data_offset, p->header, crcs[i]);
+    if (PREDICT_FALSE(!p->status.ok())) {
+      p->status_detail = EntryHeaderStatus::OTHER_ERROR;
+      p->decoded.CountDown();
+      continue;
+    }
+    auto decode = [this, p, data_offset]() {
+      p->status = seg_->DecodeEntryBatch(data_offset, p->header, p->data, &p->buf, &p->batch,
+                                         /*verify_crc=*/false);
+      if (PREDICT_FALSE(!p->status.ok())) {
+        p->status_detail = EntryHeaderStatus::OTHER_ERROR;
+      }
+      p->decoded.CountDown();
+    };
+    if (PREDICT_FALSE(!decode_token_->SubmitFunc(decode).ok())) {
+      decode();
+    }
+  }
+}
+
+void LogEntryReader::ClearReadAhead() {
+  if (decode_token_) {
+    decode_token_->Wait();
+  }
+  read_ahead_.clear();
+  read_ahead_offset_ = offset_;
+  read_ahead_failed_ = false;
+}
+
 Status LogEntryReader::HandleReadError(const Status& s, EntryHeaderStatus status_detail) const {
   if (!s.IsCorruption()) {
     // IO errors should always propagate back
@@ -211,7 +498,7 @@ Status LogEntryReader::HandleReadError(const Status& s, EntryHeaderStatus status
   // if not, we just WARN it, since it's OK for the last entry to be partially
   // written.
   bool has_valid_entries;
-  RETURN_NOT_OK_PREPEND(seg_->ScanForValidEntryHeaders(offset_ + seg_->entry_header_size(),
+  RETURN_NOT_OK_PREPEND(seg_->ScanForValidEntryHeaders(offset_ + seg_->min_entry_header_size(),
                                                        &has_valid_entries),
                         "Scanning forward for valid entries");
   if (has_valid_entries) {
@@ -276,10 +563,19 @@ ReadableLogSegment::ReadableLogSegment(
       file_size_(0),
       readable_to_offset_(0),
       readable_file_(std::move(readable_file)),
+      mapping_(nullptr),
+      mapping_size_(0),
       codec_(nullptr),
       is_initialized_(false),
+      compact_entry_headers_(false),
       footer_was_rebuilt_(false) {}
 
+ReadableLogSegment::~ReadableLogSegment() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+  }
+}
+
 Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
                                 const LogSegmentFooterPB& footer,
                                 int64_t first_entry_offset) {
@@ -290,10 +586,12 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   RETURN_NOT_OK(ReadFileSize());
 
   header_.CopyFrom(header);
+  compact_entry_headers_ = HasCompactEntryHeaders(header_);
   RETURN_NOT_OK(InitCompressionCodec());
 
   footer_.CopyFrom(footer);
   first_entry_offset_ = first_entry_offset;
+  RETURN_NOT_OK(MaybeMapFile());
   is_initialized_ = true;
   readable_to_offset_.Store(file_size());
 
@@ -308,6 +606,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   RETURN_NOT_OK(ReadFileSize());
 
   header_.CopyFrom(header);
+  compact_entry_headers_ = HasCompactEntryHeaders(header_);
   first_entry_offset_ = first_entry_offset;
   RETURN_NOT_OK(InitCompressionCodec());
   is_initialized_ = true;
@@ -336,6 +635,8 @@ Status ReadableLogSegment::Init() {
           << ": " << s.ToString();
       return s;
     }
+  } else {
+    RETURN_NOT_OK(MaybeMapFile());
   }
 
   is_initialized_ = true;
@@ -354,6 +655,49 @@ Status ReadableLogSegment::InitCompressionCodec() {
   return Status::OK();
 }
 
+Status ReadableLogSegment::MaybeMapFile() {
+  if (!FLAGS_log_mmap_closed_segments || file_size() == 0) {
+    return Status::OK();
+  }
+  int fd;
+  RETRY_ON_EINTR(fd, open(path_.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    int err = errno;
+    return Status::IOError(Substitute("Unable to open $0", path_), ErrnoToString(err), err);
+  }
+  size_t size = file_size();
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  int mmap_err = errno;
+  int ret;
+  // The mapping stays valid once the file is closed.
+  RETRY_ON_EINTR(ret, close(fd));
+  if (mapping == MAP_FAILED) {
+    return Status::IOError(Substitute("Unable to mmap $0", path_),
+                           ErrnoToString(mmap_err), mmap_err);
+  }
+  // Catch-up reads scan the segment front to back, so ask for aggressive
+  // readahead. This is only a hint, so failures are ignored.
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  mapping_ = static_cast<uint8_t*>(mapping);
+  mapping_size_ = size;
+  return Status::OK();
+}
+
+Status ReadableLogSegment::ReadRange(int64_t offset, size_t length,
+                                     uint8_t* scratch, Slice* result) const {
+  if (mapping_ != nullptr) {
+    if (PREDICT_FALSE(offset < 0 || offset + length > mapping_size_)) {
+      return Status::IOError(Substitute("Cannot read $0 bytes at offset $1 of $2: "
+                                        "file is only $3 bytes",
+                                        length, offset, path_, mapping_size_));
+    }
+    *result = Slice(mapping_ + offset, length);
+    return Status::OK();
+  }
+  *result = Slice(scratch, length);
+  return readable_file()->Read(offset, *result);
+}
+
 const int64_t ReadableLogSegment::readable_up_to() const {
   return readable_to_offset_.Load();
 }
@@ -363,7 +707,8 @@ void ReadableLogSegment::UpdateReadableToOffset(int64_t readable_to_offset) {
   file_size_.StoreMax(readable_to_offset);
 }
 
-Status ReadableLogSegment::RebuildFooterByScanning() {
+Status ReadableLogSegment::RebuildFooterByScanning(
+    const LogSegmentIndexCheckpointPB* checkpoint) {
   TRACE_EVENT1("log", "ReadableLogSegment::RebuildFooterByScanning",
                "path", path_);
 
@@ -373,6 +718,33 @@ Status ReadableLogSegment::RebuildFooterByScanning() {
 
   LogSegmentFooterPB new_footer;
   int num_entries = 0;
+  if (checkpoint) {
+    // Only trust the checkpoint if the batch it ends with is intact and ends
+    // where the checkpoint says it does.
+    int64_t offset = checkpoint->last_batch_offset();
+    faststring tmp_buf;
+    unique_ptr<LogEntryBatchPB> batch;
+    EntryHeaderStatus s_detail;
+    Status s;
+    if (offset >= first_entry_offset_ &&
+        checkpoint->offset() <= readable_to_offset_.Load()) {
+      s = ReadEntryHeaderAndBatch(&offset, &tmp_buf, &batch, &s_detail);
+    } else {
+      s = Status::Corruption("checkpoint is out of bounds");
+    }
+    if (s.ok() && offset == checkpoint->offset()) {
+      VLOG(1) << "Rebuilding footer for segment " << path_
+              << " from sparse index checkpoint at offset " << offset;
+      new_footer = checkpoint->footer();
+      num_entries = new_footer.num_entries();
+      reader.offset_ = offset;
+      reader.num_entries_read_ = num_entries;
+    } else {
+      LOG(WARNING) << "Ignoring sparse index checkpoint for segment " << path_
+                   << " which does not match its contents: "
+                   << (s.ok() ? Status::Corruption("batch size mismatch") : s).ToString();
+    }
+  }
   while (true) {
     unique_ptr<LogEntryPB> entry;
     Status s = reader.ReadNextEntry(&entry);
@@ -436,12 +808,15 @@ Status ReadableLogSegment::ReadHeader() {
                                                 header_size),
                         "Unable to parse protobuf");
 
-  if (header.incompatible_features_size() > 0) {
-    return Status::NotSupported("log segment uses a feature not supported by this version "
-                                "of Kudu");
+  for (int32_t feature : header.incompatible_features()) {
+    if (feature != LogSegmentHeaderPB::COMPACT_ENTRY_HEADERS) {
+      return Status::NotSupported("log segment uses a feature not supported by this version "
+                                  "of Kudu");
+    }
   }
 
   header_.Swap(&header);
+  compact_entry_headers_ = HasCompactEntryHeaders(header_);
   first_entry_offset_ = header_size + kLogSegmentHeaderMagicAndHeaderLength;
 
   return Status::OK();
@@ -566,11 +941,22 @@ Status ReadableLogSegment::ReadEntries(LogEntries* entries) {
   return Status::OK();
 }
 
-size_t ReadableLogSegment::entry_header_size() const {
+size_t ReadableLogSegment::min_entry_header_size() const {
   DCHECK(is_initialized_);
+  if (compact_entry_headers_) {
+    return kEntryHeaderSizeCompactMin + (codec_ ? 1 : 0);
+  }
   return header_.has_deprecated_major_version() ? kEntryHeaderSizeV1 : kEntryHeaderSizeV2;
 }
 
+size_t ReadableLogSegment::max_entry_header_size() const {
+  DCHECK(is_initialized_);
+  if (compact_entry_headers_) {
+    return kEntryHeaderSizeCompactMax - (codec_ ? 0 : kMaxVarint32Size);
+  }
+  return min_entry_header_size();
+}
+
 Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_valid_entries) {
   TRACE_EVENT1("log", "ReadableLogSegment::ScanForValidEntryHeaders",
                "path", path_);
@@ -583,9 +969,11 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
 
   // We overlap the reads by the size of the header, so that if a header
   // spans chunks, we don't miss it.
+  const size_t min_header_size = min_entry_header_size();
+  const size_t max_header_size = max_entry_header_size();
   for (;
-       offset < file_size() - entry_header_size();
-       offset += kChunkSize - entry_header_size()) {
+       offset < file_size() - min_header_size;
+       offset += kChunkSize - max_header_size) {
     int rem = std::min<int64_t>(file_size() - offset, kChunkSize);
     Slice chunk(buf.get(), rem);
     RETURN_NOT_OK(readable_file()->Read(offset, chunk));
@@ -598,9 +986,10 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
 
     // Check if this chunk has a valid entry header.
     for (int off_in_chunk = 0;
-         off_in_chunk < chunk.size() - entry_header_size();
+         off_in_chunk < chunk.size() - min_header_size;
          off_in_chunk++) {
-      Slice potential_header = Slice(&chunk[off_in_chunk], entry_header_size());
+      Slice potential_header = Slice(&chunk[off_in_chunk],
+                                     std::min(max_header_size, chunk.size() - off_in_chunk));
 
       EntryHeader header;
       if (DecodeEntryHeader(potential_header, &header) == EntryHeaderStatus::OK) {
@@ -634,10 +1023,14 @@ Status ReadableLogSegment::ReadEntryHeaderAndBatch(int64_t* offset, faststring*
 
 Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header,
                                            EntryHeaderStatus* status_detail) {
-  const size_t header_size = entry_header_size();
+  // Compact headers are variable-length, so read as much as the longest one
+  // may take up, but no further than the readable part of the segment.
+  const size_t header_size = std::max<int64_t>(
+      min_entry_header_size(),
+      std::min<int64_t>(max_entry_header_size(), readable_up_to() - *offset));
   uint8_t scratch[header_size];
-  Slice slice(scratch, header_size);
-  RETURN_NOT_OK_PREPEND(readable_file()->Read(*offset, slice),
+  Slice slice;
+  RETURN_NOT_OK_PREPEND(ReadRange(*offset, header_size, scratch, &slice),
                         "Could not read log entry header");
 
   *status_detail = DecodeEntryHeader(slice, header);
@@ -653,33 +1046,53 @@ Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header,
       return Status::Corruption("unexpected result from decoded");
   }
 
-  *offset += slice.size();
+  *offset += header->size;
   return Status::OK();
 }
 
 EntryHeaderStatus ReadableLogSegment::DecodeEntryHeader(
     const Slice& data, EntryHeader* header) {
+  DCHECK_GE(data.size(), min_entry_header_size());
   uint32_t computed_header_crc;
-  if (entry_header_size() == kEntryHeaderSizeV2) {
+  if (compact_entry_headers_) {
+    // The compressed length as a varint, then the uncompressed length as a
+    // varint if the segment is compressed, then the data and header CRCs.
+    const uint8_t* limit = data.data() + data.size();
+    const uint8_t* p = GetVarint32Ptr(data.data(), limit, &header->msg_length_compressed);
+    if (p && codec_) {
+      p = GetVarint32Ptr(p, limit, &header->msg_length);
+    } else {
+      header->msg_length = header->msg_length_compressed;
+    }
+    if (PREDICT_FALSE(!p || limit - p < 8)) {
+      header->size = data.size();
+      return IsAllZeros(data) ? EntryHeaderStatus::ALL_ZEROS : EntryHeaderStatus::CRC_MISMATCH;
+    }
+    header->msg_crc    = DecodeFixed32(p);
+    header->header_crc = DecodeFixed32(p + 4);
+    computed_header_crc = crc::Crc32c(data.data(), p + 4 - data.data());
+    header->size = p + 8 - data.data();
+  } else if (!header_.has_deprecated_major_version()) {
     header->msg_length_compressed = DecodeFixed32(&data[0]);
     header->msg_length = DecodeFixed32(&data[4]);
     header->msg_crc    = DecodeFixed32(&data[8]);
     header->header_crc = DecodeFixed32(&data[12]);
     computed_header_crc = crc::Crc32c(&data[0], 12);
+    header->size = kEntryHeaderSizeV2;
   } else {
-    DCHECK_EQ(kEntryHeaderSizeV1, data.size());
     header->msg_length = DecodeFixed32(&data[0]);
     header->msg_length_compressed = header->msg_length;
     header->msg_crc    = DecodeFixed32(&data[4]);
     header->header_crc = DecodeFixed32(&data[8]);
     computed_header_crc = crc::Crc32c(&data[0], 8);
+    header->size = kEntryHeaderSizeV1;
   }
 
   // Verify the header.
   if (computed_header_crc == header->header_crc) {
     return EntryHeaderStatus::OK;
   }
-  if (IsAllZeros(data)) {
+  if (IsAllZeros(Slice(data.data(), header->size))) {
     return EntryHeaderStatus::ALL_ZEROS;
   }
   return EntryHeaderStatus::CRC_MISMATCH;
@@ -694,60 +1107,88 @@ Status ReadableLogSegment::ReadEntryBatch(int64_t* offset,
                "path", path_,
                "range", Substitute("offset=$0 entry_len=$1",
                                    *offset, header.msg_length));
+  Slice entry_batch_slice;
+  RETURN_NOT_OK(ReadEntryBatchData(*offset, header, tmp_buf, &entry_batch_slice));
+  RETURN_NOT_OK(DecodeEntryBatch(*offset, header, entry_batch_slice, tmp_buf, entry_batch));
+  *offset += header.msg_length_compressed;
+  return Status::OK();
+}
 
+Status ReadableLogSegment::ReadEntryBatchData(int64_t offset,
+                                              const EntryHeader& header,
+                                              faststring* tmp_buf,
+                                              Slice* data) const {
   if (header.msg_length == 0) {
     return Status::Corruption("Invalid 0 entry length");
   }
   int64_t limit = readable_up_to();
-  if (PREDICT_FALSE(header.msg_length_compressed + *offset > limit)) {
+  if (PREDICT_FALSE(header.msg_length_compressed + offset > limit)) {
     // The log was likely truncated during writing.
     return Status::Corruption(
         Substitute("Could not read $0-byte log entry from offset $1 in $2: "
                    "log only readable up to offset $3",
-                   header.msg_length_compressed, *offset, path_, limit));
+                   header.msg_length_compressed, offset, path_, limit));
   }
 
   tmp_buf->clear();
-  size_t buf_len = header.msg_length_compressed;
+  // A mapped file is read in place, so only the decompressed copy, if any,
+  // needs room in 'tmp_buf'.
+  size_t compressed_len = mapping_ ? 0 : header.msg_length_compressed;
+  size_t buf_len = compressed_len;
   if (codec_) {
     // Reserve some space for the decompressed copy as well.
     buf_len += header.msg_length;
   }
   tmp_buf->resize(buf_len);
-  Slice entry_batch_slice(tmp_buf->data(), header.msg_length_compressed);
-  Status s =  readable_file()->Read(*offset, entry_batch_slice);
+  Status s = ReadRange(offset, header.msg_length_compressed, tmp_buf->data(), data);
 
   if (!s.ok()) return Status::IOError(Substitute("Could not read entry. Cause: $0",
                                                  s.ToString()));
+  return Status::OK();
+}
 
-  // Verify the CRC.
-  uint32_t read_crc = crc::Crc32c(entry_batch_slice.data(), entry_batch_slice.size());
-  if (PREDICT_FALSE(read_crc != header.msg_crc)) {
+Status ReadableLogSegment::CheckEntryBatchCrc(int64_t offset,
+                                              const EntryHeader& header,
+                                              uint32_t crc) const {
+  if (PREDICT_FALSE(crc != header.msg_crc)) {
     return Status::Corruption(Substitute("Entry CRC mismatch in byte range $0-$1: "
                                          "expected CRC=$2, computed=$3",
-                                         *offset, *offset + header.msg_length,
-                                         header.msg_crc, read_crc));
+                                         offset, offset + header.msg_length,
+                                         header.msg_crc, crc));
+  }
+  return Status::OK();
+}
+
+Status ReadableLogSegment::DecodeEntryBatch(int64_t offset,
+                                            const EntryHeader& header,
+                                            const Slice& data,
+                                            faststring* tmp_buf,
+                                            unique_ptr<LogEntryBatchPB>* entry_batch,
+                                            bool verify_crc) const {
+  if (verify_crc) {
+    RETURN_NOT_OK(CheckEntryBatchCrc(offset, header, crc::Crc32c(data.data(), data.size())));
   }
 
   // If it was compressed, decompress it.
+  Slice entry_batch_slice = data;
   if (codec_) {
-    // We pre-reserved space for the decompression up above.
-    uint8_t* uncompress_buf = &(*tmp_buf)[header.msg_length_compressed];
-    RETURN_NOT_OK_PREPEND(codec_->Uncompress(entry_batch_slice, uncompress_buf, header.msg_length),
+    // ReadEntryBatchData() reserved space for the decompression after the
+    // compressed data.
+    uint8_t* uncompress_buf = tmp_buf->data() + (mapping_ ? 0 : header.msg_length_compressed);
+    RETURN_NOT_OK_PREPEND(codec_->Uncompress(data, uncompress_buf, header.msg_length),
                           "failed to uncompress entry");
     entry_batch_slice = Slice(uncompress_buf, header.msg_length);
   }
 
   unique_ptr<LogEntryBatchPB> read_entry_batch(new LogEntryBatchPB);
-  s = pb_util::ParseFromArray(read_entry_batch.get(),
-                              entry_batch_slice.data(),
-                              header.msg_length);
+  Status s = pb_util::ParseFromArray(read_entry_batch.get(),
+                                     entry_batch_slice.data(),
+                                     header.msg_length);
 
   if (!s.ok()) {
     return Status::Corruption(Substitute("Could not parse PB. Cause: $0", s.ToString()));
   }
 
-  *offset += header.msg_length_compressed;
   entry_batch->reset(read_entry_batch.release());
   return Status::OK();
 }
@@ -758,6 +1199,7 @@ WritableLogSegment::WritableLogSegment(string path,
       writable_file_(std::move(writable_file)),
       is_header_written_(false),
       is_footer_written_(false),
+      compact_entry_headers_(false),
       written_offset_(0) {}
 
 Status WritableLogSegment::WriteHeaderAndOpen(const LogSegmentHeaderPB& new_header) {
@@ -777,6 +1219,7 @@ Status WritableLogSegment::WriteHeaderAndOpen(const LogSegmentHeaderPB& new_head
   RETURN_NOT_OK(writable_file()->Append(Slice(buf)));
 
   header_.CopyFrom(new_header);
+  compact_entry_headers_ = HasCompactEntryHeaders(header_);
   first_entry_offset_ = buf.size();
   written_offset_ = first_entry_offset_;
   is_header_written_ = true;
@@ -808,42 +1251,212 @@ Status WritableLogSegment::WriteFooterAndClose(const LogSegmentFooterPB& footer)
   return Status::OK();
 }
 
-Status WritableLogSegment::WriteEntryBatch(const Slice& data,
+Status WritableLogSegment::WriteEntryBatch(const vector<Slice>& data,
                                            const CompressionCodec* codec) {
   DCHECK(is_header_written_);
   DCHECK(!is_footer_written_);
-  uint8_t header_buf[kEntryHeaderSizeV2];
+  uint8_t header_buf[kEntryHeaderSizeCompactMax];
+
+  uint32_t uncompressed_len = 0;
+  for (const Slice& s : data) {
+    uncompressed_len += s.size();
+  }
 
-  const uint32_t uncompressed_len = data.size();
+  // The header goes first, followed by the batch data itself.
+  vector<Slice> slices;
+  slices.reserve(data.size() + 1);
+  slices.emplace_back();
 
   // If necessary, compress the data.
-  Slice data_to_write;
+  uint32_t len_to_write;
+  uint32_t data_crc;
   if (codec) {
     DCHECK_NE(header_.compression_codec(), NO_COMPRESSION);
     compress_buf_.resize(codec->MaxCompressedLength(uncompressed_len));
     size_t compressed_len;
     RETURN_NOT_OK(codec->Compress(data, &compress_buf_[0], &compressed_len));
     compress_buf_.resize(compressed_len);
-    data_to_write = Slice(compress_buf_.data(), compress_buf_.size());
+    slices.emplace_back(compress_buf_.data(), compress_buf_.size());
+    len_to_write = compressed_len;
+    data_crc = crc::Crc32c(compress_buf_.data(), compress_buf_.size());
   } else {
-    data_to_write = data;
+    slices.insert(slices.end(), data.begin(), data.end());
+    len_to_write = uncompressed_len;
+    data_crc = 0;
+    for (const Slice& s : data) {
+      data_crc = crc::Crc32c(s.data(), s.size(), data_crc);
+    }
   }
 
   // Fill in the header.
-  InlineEncodeFixed32(&header_buf[0], data_to_write.size());
-  InlineEncodeFixed32(&header_buf[4], uncompressed_len);
-  InlineEncodeFixed32(&header_buf[8], crc::Crc32c(data_to_write.data(), data_to_write.size()));
-  InlineEncodeFixed32(&header_buf[12], crc::Crc32c(&header_buf[0], kEntryHeaderSizeV2 - 4));
-
-  // Write the header to the file, followed by the batch data itself.
-  Slice slices[2] = {
-    Slice(header_buf, arraysize(header_buf)),
-    data_to_write };
+  uint8_t* p = header_buf;
+  if (compact_entry_headers_) {
+    p = InlineEncodeVarint32(p, len_to_write);
+    if (codec) {
+      p = InlineEncodeVarint32(p, uncompressed_len);
+    }
+  } else {
+    InlineEncodeFixed32(p, len_to_write);
+    InlineEncodeFixed32(p + 4, uncompressed_len);
+    p += 8;
+  }
+  InlineEncodeFixed32(p, data_crc);
+  p += 4;
+  InlineEncodeFixed32(p, crc::Crc32c(header_buf, p - header_buf));
+  p += 4;
+  slices[0] = Slice(header_buf, p - header_buf);
+
   RETURN_NOT_OK(writable_file_->AppendV(slices));
-  written_offset_ += arraysize(header_buf) + data_to_write.size();
+  written_offset_ += slices[0].size() + len_to_write;
+  return Status::OK();
+}
+
+Status WritableLogSegment::Truncate(int64_t offset) {
+  DCHECK(is_header_written_);
+  DCHECK(!is_footer_written_);
+  DCHECK_GE(offset, first_entry_offset_);
+  DCHECK_LE(offset, written_offset_);
+  RETURN_NOT_OK(writable_file_->Truncate(offset));
+  written_offset_ = offset;
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// SliceOutputStream
+////////////////////////////////////////////////////////////
+
+const int SliceOutputStream::kBlockSize = 4096;
+
+SliceOutputStream::SliceOutputStream()
+    : last_block_used_(kBlockSize),
+      byte_count_(0) {
+}
+
+SliceOutputStream::~SliceOutputStream() {}
+
+bool SliceOutputStream::Next(void** data, int* size) {
+  // Hand out the rest of the last block if some of it was backed up, e.g.
+  // before an aliased write. Otherwise start a new block.
+  if (last_block_used_ == kBlockSize) {
+    blocks_.emplace_back(new uint8_t[kBlockSize]);
+    last_block_used_ = 0;
+  }
+  uint8_t* start = blocks_.back().get() + last_block_used_;
+  *data = start;
+  *size = kBlockSize - last_block_used_;
+  slices_.emplace_back(start, *size);
+  last_block_used_ = kBlockSize;
+  byte_count_ += *size;
+  return true;
+}
+
+void SliceOutputStream::BackUp(int count) {
+  DCHECK(!slices_.empty());
+  Slice* last = &slices_.back();
+  DCHECK_LE(count, last->size());
+  last->truncate(last->size() - count);
+  if (last->empty()) {
+    slices_.pop_back();
+  }
+  last_block_used_ -= count;
+  byte_count_ -= count;
+}
+
+bool SliceOutputStream::WriteAliasedRaw(const void* data, int size) {
+  slices_.emplace_back(static_cast<const uint8_t*>(data), size);
+  byte_count_ += size;
+  return true;
+}
+
+////////////////////////////////////////////////////////////
+// GroupCommitWindowPolicy
+////////////////////////////////////////////////////////////
+
+namespace {
+// Weight of the newest sample in the moving averages.
+constexpr double kEwmaWeight = 0.2;
+
+void UpdateEwma(double sample, double* avg) {
+  *avg = *avg == 0 ? sample : (1 - kEwmaWeight) * *avg + kEwmaWeight * sample;
+}
+} // anonymous namespace
+
+const int GroupCommitWindowPolicy::kTargetExtraBatches = 4;
+
+GroupCommitWindowPolicy::GroupCommitWindowPolicy(MonoDelta max_window)
+    : max_window_(max_window),
+      arrival_interval_us_(0),
+      commit_latency_us_(0) {
+}
+
+void GroupCommitWindowPolicy::RecordArrivals(MonoTime now, int num_batches) {
+  DCHECK_GT(num_batches, 0);
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (last_arrival_.Initialized()) {
+    UpdateEwma(static_cast<double>((now - last_arrival_).ToMicroseconds()) / num_batches,
+               &arrival_interval_us_);
+  }
+  last_arrival_ = now;
+}
+
+void GroupCommitWindowPolicy::RecordCommitLatency(MonoDelta latency) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  UpdateEwma(latency.ToMicroseconds(), &commit_latency_us_);
+}
+
+MonoDelta GroupCommitWindowPolicy::ComputeWindow() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  // Until both averages are known, or if batches arrive more slowly than a
+  // group can be committed, waiting would only add latency.
+  if (arrival_interval_us_ <= 0 || commit_latency_us_ <= 0 ||
+      arrival_interval_us_ >= commit_latency_us_) {
+    return MonoDelta::FromMicroseconds(0);
+  }
+  double window_us = std::min(arrival_interval_us_ * kTargetExtraBatches,
+                              commit_latency_us_ / 2);
+  window_us = std::min(window_us, static_cast<double>(max_window_.ToMicroseconds()));
+  return MonoDelta::FromMicroseconds(static_cast<int64_t>(window_us));
+}
+
+LogGroupSyncer::LogGroupSyncer(Env* env, string wal_root)
+    : env_(env),
+      wal_root_(std::move(wal_root)),
+      cond_(&lock_),
+      num_started_(0),
+      num_completed_(0),
+      in_progress_(false) {
+}
+
+Status LogGroupSyncer::Sync() {
+  MutexLock l(lock_);
+  // A sync already in progress may have started before the caller's writes,
+  // so wait for the next one.
+  const int64_t needed = num_started_ + 1;
+  while (num_completed_ < needed && error_.ok()) {
+    if (in_progress_) {
+      cond_.Wait();
+      continue;
+    }
+    in_progress_ = true;
+    int64_t sync_num = ++num_started_;
+    l.Unlock();
+    Status s = env_->SyncFileSystem(wal_root_);
+    l.Lock();
+    in_progress_ = false;
+    num_completed_ = sync_num;
+    if (!s.ok()) {
+      error_ = s.CloneAndPrepend(Substitute("Unable to sync the file system of $0",
+                                            wal_root_));
+    }
+    cond_.Broadcast();
+  }
+  return error_;
+}
+
+int64_t LogGroupSyncer::num_syncs() const {
+  MutexLock l(lock_);
+  return num_completed_;
+}
 
 unique_ptr<LogEntryBatchPB> CreateBatchFromAllocatedOperations(
     const vector<consensus::ReplicateRefPtr>& msgs) {
@@ -864,6 +1477,11 @@ bool IsLogFileName(const string& fname) {
     return false;
   }
 
+  if (HasSuffixString(fname, kSegmentIndexFileSuffix)) {
+    VLOG(1) << "Ignoring segment index file: " << fname;
+    return false;
+  }
+
   vector<string> v = strings::Split(fname, "-");
   if (v.size() != 2 || v[0] != FsManager::kWalFileNamePrefix) {
     VLOG(1) << "Not a log file: " << fname;
@@ -873,6 +1491,51 @@ bool IsLogFileName(const string& fname) {
   return true;
 }
 
+string GetArchiveDirForWalDir(const string& tablet_wal_dir) {
+  if (FLAGS_log_archive_dir.empty()) {
+    return "";
+  }
+  return JoinPathSegments(FLAGS_log_archive_dir, BaseName(tablet_wal_dir));
+}
+
+const char kSegmentIndexFileSuffix[] = ".sparseidx";
+
+string SegmentIndexPath(const string& segment_path) {
+  return segment_path + kSegmentIndexFileSuffix;
+}
+
+Status ReadLastSegmentIndexCheckpoint(Env* env, const string& segment_path,
+                                      LogSegmentIndexCheckpointPB* checkpoint) {
+  string path = SegmentIndexPath(segment_path);
+  if (!env->FileExists(path)) {
+    return Status::NotFound("no sparse index for segment", segment_path);
+  }
+  unique_ptr<RandomAccessFile> file;
+  RETURN_NOT_OK(env->NewRandomAccessFile(path, &file));
+  pb_util::ReadablePBContainerFile container(std::move(file));
+  RETURN_NOT_OK(container.Open());
+  bool found = false;
+  while (true) {
+    LogSegmentIndexCheckpointPB pb;
+    // A crash may leave a truncated or corrupt checkpoint at the end of the
+    // file; everything before it is still usable.
+    Status s = container.ReadNextPB(&pb);
+    if (!s.ok()) {
+      if (!s.IsEndOfFile()) {
+        VLOG(1) << "Stopped reading sparse index " << path << ": " << s.ToString();
+      }
+      break;
+    }
+    checkpoint->Swap(&pb);
+    found = true;
+  }
+  WARN_NOT_OK(container.Close(), "Could not close sparse index " + path);
+  if (!found) {
+    return Status::NotFound("no checkpoint in sparse index for segment", segment_path);
+  }
+  return Status::OK();
+}
+
 void UpdateFooterForReplicateEntry(const LogEntryPB& entry_pb,
                                    LogSegmentFooterPB* footer) {
   DCHECK(entry_pb.has_replicate());
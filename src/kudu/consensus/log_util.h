@@ -27,6 +27,7 @@
 
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
+#include <google/protobuf/io/zero_copy_stream.h>
 #include <gtest/gtest_prod.h>
 
 #include "kudu/consensus/log.pb.h"
@@ -35,8 +36,12 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/condition_variable.h"
 #include "kudu/util/env.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
@@ -46,6 +51,7 @@ DECLARE_bool(log_force_fsync_all);
 namespace kudu {
 
 class CompressionCodec;
+class ThreadPoolToken;
 
 namespace log {
 
@@ -73,6 +79,37 @@ struct LogOptions {
   // Whether the allocation should happen asynchronously.
   bool async_preallocate_segments;
 
+  // Whether to pipeline appends, overlapping the write of one group of
+  // entry batches with the sync of the previous one.
+  bool pipelined_append;
+
+  // Whether the append thread should wait for an adaptively chosen window
+  // after draining the queue, in order to coalesce more batches per sync.
+  bool adaptive_group_commit;
+
+  // If greater than 0, the log's appends run on a pool of this many threads
+  // shared by all logs under the same WAL root directory, instead of on a
+  // thread of its own.
+  int append_threads_per_wal_dir;
+
+  // Whether the log is synced together with the other logs under the same WAL
+  // root directory, by a LogGroupSyncer, instead of on its own.
+  bool group_sync_per_wal_dir;
+
+  // Whether to write segments with O_DIRECT.
+  bool direct_io;
+
+  // Whether to write segments with O_DSYNC.
+  bool dsync;
+
+  // Whether new segments prefix their entries with compact, variable-length
+  // headers. Such segments can't be read by versions which predate them.
+  bool compact_entry_headers;
+
+  // Whether to leave the schema out of the headers of new segments. Only
+  // for logs which aren't bootstrapped into a tablet.
+  bool omit_segment_schema;
+
   LogOptions();
 };
 
@@ -104,10 +141,17 @@ class LogEntryReader {
   // 'seg' must outlive the LogEntryReader.
   explicit LogEntryReader(ReadableLogSegment* seg);
 
+  // Same, but starts reading at 'offset', which must be that of a batch.
+  LogEntryReader(ReadableLogSegment* seg, int64_t offset);
+
   ~LogEntryReader();
 
   // Read the next entry from the log, replacing the contents of 'entry'.
   //
+  // With --log_read_decode_threads, the batches following the next one are
+  // read ahead, and their checksums verified and their contents decompressed
+  // on a shared pool of threads, while the entries are still returned in order.
+  //
   // When there are no more entries to read, returns Status::EndOfFile().
   Status ReadNextEntry(std::unique_ptr<LogEntryPB>* entry);
 
@@ -124,6 +168,21 @@ class LogEntryReader {
  private:
   friend class ReadableLogSegment;
 
+  // A batch read ahead of 'offset_', being decoded by the decode pool.
+  struct PendingBatch;
+
+  // Read the batch at 'offset_' into 'batch', using the batches read ahead.
+  // On failure, sets 'status_detail' as ReadEntryHeaderAndBatch() does.
+  Status ReadNextBatchFromReadAhead(std::unique_ptr<LogEntryBatchPB>* batch,
+                                    EntryHeaderStatus* status_detail);
+
+  // Read up to --log_read_ahead_batches batches ahead of 'offset_', submitting
+  // each to the decode pool.
+  void FillReadAhead();
+
+  // Wait for the batches read ahead to be decoded and discard them.
+  void ClearReadAhead();
+
   // Handle an error reading an entry.
   Status HandleReadError(const Status& s, EntryHeaderStatus status_detail) const;
 
@@ -161,6 +220,20 @@ class LogEntryReader {
   // Temporary buffer used for deserialization.
   faststring tmp_buf_;
 
+  // The token of the decode pool the batches read ahead are decoded with, or
+  // null if the batches are read serially.
+  std::unique_ptr<ThreadPoolToken> decode_token_;
+
+  // The batches read ahead of 'offset_', in order.
+  std::deque<std::unique_ptr<PendingBatch>> read_ahead_;
+
+  // The offset of the next batch to be read ahead.
+  int64_t read_ahead_offset_;
+
+  // Whether reading ahead stopped at an error, e.g. at the end of the valid
+  // entries of the segment.
+  bool read_ahead_failed_;
+
   DISALLOW_COPY_AND_ASSIGN(LogEntryReader);
 };
 
@@ -213,7 +286,10 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // This is an expensive operation as it reads and parses the whole segment
   // so it should be only used in the case of a crash, where the footer is
   // missing because we didn't have the time to write it out.
-  Status RebuildFooterByScanning();
+  //
+  // If 'checkpoint' is provided and matches the contents of the segment, only
+  // the entries following it are scanned.
+  Status RebuildFooterByScanning(const LogSegmentIndexCheckpointPB* checkpoint = nullptr);
 
   bool IsInitialized() const {
     return is_initialized_;
@@ -265,9 +341,12 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // ends.
   const int64_t readable_up_to() const;
 
-  // Return the expected length of entry headers in this log segment.
-  // Versions of Kudu older than 1.3 used a different log entry header format.
-  size_t entry_header_size() const;
+  // Return the minimum and maximum lengths of entry headers in this log
+  // segment. Versions of Kudu older than 1.3 used a different log entry header
+  // format, and entry headers are only variable-length in segments with the
+  // COMPACT_ENTRY_HEADERS feature.
+  size_t min_entry_header_size() const;
+  size_t max_entry_header_size() const;
 
  private:
   friend class RefCountedThreadSafe<ReadableLogSegment>;
@@ -289,14 +368,27 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
 
     // The CRC32C of this EntryHeader.
     uint32_t header_crc;
+
+    // The length of this EntryHeader in the segment.
+    uint32_t size;
   };
 
-  ~ReadableLogSegment() {}
+  ~ReadableLogSegment();
 
   // Helper functions called by Init().
 
   Status ReadFileSize();
 
+  // Maps the whole file into memory, if the segment is closed and
+  // --log_mmap_closed_segments is set. Entries are then read straight from
+  // the mapping.
+  Status MaybeMapFile();
+
+  // Reads 'length' bytes at 'offset'. If the file is mapped, '*result' points
+  // into the mapping and 'scratch' is unused; otherwise the bytes are read
+  // into 'scratch', which must have room for them.
+  Status ReadRange(int64_t offset, size_t length, uint8_t* scratch, Slice* result) const;
+
   Status InitCompressionCodec();
 
   // Read the log file magic and header protobuf into 'header_'. Sets 'first_entry_offset_'
@@ -348,8 +440,9 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   Status ReadEntryHeader(int64_t *offset, EntryHeader* header,
                          EntryHeaderStatus* status_detail);
 
-  // Decode a log entry header from the given slice. The header length is
-  // determined by 'entry_header_size()'.
+  // Decode a log entry header from the start of the given slice, which holds
+  // at least 'min_entry_header_size()' bytes. Sets 'header->size' to the
+  // length of the header.
   // Returns true if successful, false if corrupt.
   //
   // NOTE: this is performance-critical since it is used by ScanForValidEntryHeaders
@@ -363,6 +456,30 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
                         faststring* tmp_buf,
                         std::unique_ptr<LogEntryBatchPB>* entry_batch);
 
+  // The first half of ReadEntryBatch(): reads the still encoded data of the
+  // batch at 'offset' into 'data', which either points into 'tmp_buf' or
+  // into the mapping of the segment. 'tmp_buf' is sized for the decoding
+  // as well.
+  Status ReadEntryBatchData(int64_t offset,
+                            const EntryHeader& header,
+                            faststring* tmp_buf,
+                            Slice* data) const;
+
+  // The second half of ReadEntryBatch(): verifies the checksum of the 'data'
+  // read by ReadEntryBatchData() with 'tmp_buf', unless 'verify_crc' is false
+  // because the caller already did, decompresses it and decodes it into
+  // 'entry_batch'. Thread-safe.
+  Status DecodeEntryBatch(int64_t offset,
+                          const EntryHeader& header,
+                          const Slice& data,
+                          faststring* tmp_buf,
+                          std::unique_ptr<LogEntryBatchPB>* entry_batch,
+                          bool verify_crc = true) const;
+
+  // Returns Corruption if 'crc', computed over the data of the batch at
+  // 'offset', doesn't match the one in its 'header'.
+  Status CheckEntryBatchCrc(int64_t offset, const EntryHeader& header, uint32_t crc) const;
+
   void UpdateReadableToOffset(int64_t readable_to_offset);
 
   const std::string path_;
@@ -384,6 +501,10 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // a readable file for a log segment (used on replay)
   const std::shared_ptr<RandomAccessFile> readable_file_;
 
+  // Read-only mapping of the whole file, or nullptr if the file isn't mapped.
+  uint8_t* mapping_;
+  size_t mapping_size_;
+
   // Compression codec used to decompress entries in this file.
   const CompressionCodec* codec_;
 
@@ -391,6 +512,9 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
 
   LogSegmentHeaderPB header_;
 
+  // Whether 'header_' has the COMPACT_ENTRY_HEADERS feature.
+  bool compact_entry_headers_;
+
   LogSegmentFooterPB footer_;
 
   // True if the footer was rebuilt, rather than actually found on disk.
@@ -427,13 +551,26 @@ class WritableLogSegment {
   // and checksum. If 'codec' is not NULL, compresses the batch.
   // Makes sure that the log segment has not been closed.
   // Write a compressed entry to the log.
-  Status WriteEntryBatch(const Slice& data, const CompressionCodec* codec);
+  //
+  // The batch is the concatenation of 'data', which is written with a single
+  // scatter/gather write.
+  Status WriteEntryBatch(const std::vector<Slice>& data, const CompressionCodec* codec);
+
+  // Drops the entry batches written at or after 'offset', which must be that
+  // of a batch. The following batches are written from there.
+  Status Truncate(int64_t offset);
 
   // Makes sure the I/O buffers in the underlying writable file are flushed.
   Status Sync() {
     return writable_file_->Sync();
   }
 
+  // Initiates writeback of the data written so far without waiting for it
+  // to complete. A subsequent Sync() is still required for durability.
+  Status StartWriteback() {
+    return writable_file_->Flush(WritableFile::FLUSH_ASYNC);
+  }
+
   // Returns true if the segment header has already been written to disk.
   bool IsHeaderWritten() const {
     return is_header_written_;
@@ -484,6 +621,9 @@ class WritableLogSegment {
 
   LogSegmentHeaderPB header_;
 
+  // Whether 'header_' has the COMPACT_ENTRY_HEADERS feature.
+  bool compact_entry_headers_;
+
   LogSegmentFooterPB footer_;
 
   // the offset of the first entry in the log
@@ -498,6 +638,127 @@ class WritableLogSegment {
   DISALLOW_COPY_AND_ASSIGN(WritableLogSegment);
 };
 
+// A protobuf output stream which collects serialized data as a sequence of
+// slices. Small fields are copied into blocks owned by the stream, while large
+// 'bytes' and 'string' fields written through a CodedOutputStream with
+// aliasing enabled are referenced in place rather than copied.
+//
+// The aliased buffers must outlive any use of slices().
+class SliceOutputStream : public google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  SliceOutputStream();
+  ~SliceOutputStream();
+
+  bool Next(void** data, int* size) override;
+  void BackUp(int count) override;
+  google::protobuf::int64 ByteCount() const override { return byte_count_; }
+  bool AllowsAliasing() const override { return true; }
+  bool WriteAliasedRaw(const void* data, int size) override;
+
+  // The data written so far, in order.
+  const std::vector<Slice>& slices() const { return slices_; }
+
+ private:
+  // The size of each block of owned data.
+  static const int kBlockSize;
+
+  // Blocks owned by this stream.
+  std::vector<std::unique_ptr<uint8_t[]>> blocks_;
+
+  // The number of bytes of the last block handed out by Next().
+  int last_block_used_;
+
+  std::vector<Slice> slices_;
+
+  google::protobuf::int64 byte_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(SliceOutputStream);
+};
+
+// Chooses how long the log append thread waits, after draining a first set
+// of batches from the queue, for more batches to join the same group before
+// committing it.
+//
+// Waiting only pays off when batches arrive faster than groups can be
+// committed: then each microsecond waited saves part of a sync. The window
+// therefore tracks moving averages of the batch inter-arrival time and of the
+// group commit latency. It is zero when batches arrive more slowly than a
+// group commits, and otherwise long enough to collect a few more batches,
+// never exceeding half the commit latency nor 'max_window'.
+//
+// This class is thread-safe.
+class GroupCommitWindowPolicy {
+ public:
+  explicit GroupCommitWindowPolicy(MonoDelta max_window);
+
+  // Records that 'num_batches' batches were drained from the queue at 'now'.
+  void RecordArrivals(MonoTime now, int num_batches);
+
+  // Records the latency of committing a group.
+  void RecordCommitLatency(MonoDelta latency);
+
+  // Returns how long to wait for more batches before committing a group.
+  MonoDelta ComputeWindow() const;
+
+ private:
+  // The number of additional batches the window aims to collect.
+  static const int kTargetExtraBatches;
+
+  const MonoDelta max_window_;
+
+  mutable simple_spinlock lock_;
+
+  // The time at which batches were last drained from the queue.
+  MonoTime last_arrival_;
+
+  // Exponentially weighted moving averages, in microseconds.
+  double arrival_interval_us_;
+  double commit_latency_us_;
+
+  DISALLOW_COPY_AND_ASSIGN(GroupCommitWindowPolicy);
+};
+
+// Makes the writes of the logs under a WAL root directory durable together,
+// with a single sync of the file system holding it (see
+// Env::SyncFileSystem()), rather than with an fsync per log. On dense servers,
+// this turns the syncs of many tablets' logs into one.
+//
+// A sync only covers the writes completed before it starts, so callers arriving
+// while a sync is in progress wait for it to finish, and the first of them then
+// syncs on behalf of all the others.
+//
+// Errors are sticky: once a sync failed, all the calls fail, since the kernel
+// may have dropped the dirty pages it failed to write back.
+//
+// This class is thread-safe.
+class LogGroupSyncer {
+ public:
+  LogGroupSyncer(Env* env, std::string wal_root);
+
+  // Returns once the writes completed before the call are durable.
+  Status Sync();
+
+  // The number of syncs of the file system done so far.
+  int64_t num_syncs() const;
+
+ private:
+  Env* const env_;
+  const std::string wal_root_;
+
+  mutable Mutex lock_;
+  ConditionVariable cond_;
+
+  // The number of syncs started and completed so far.
+  int64_t num_started_;
+  int64_t num_completed_;
+  bool in_progress_;
+
+  // The error of the first failed sync, if any.
+  Status error_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogGroupSyncer);
+};
+
 // Return a newly created batch that contains the pre-allocated
 // ReplicateMsgs in 'msgs'.
 std::unique_ptr<LogEntryBatchPB> CreateBatchFromAllocatedOperations(
@@ -506,6 +767,24 @@ std::unique_ptr<LogEntryBatchPB> CreateBatchFromAllocatedOperations(
 // Checks if 'fname' is a correctly formatted name of log segment file.
 bool IsLogFileName(const std::string& fname);
 
+// Returns the directory of --log_archive_dir which closed segments of the
+// tablet WAL directory 'tablet_wal_dir' are migrated to, or an empty string
+// if segments are not migrated. A tablet's WAL directory and its WAL recovery
+// directory each have an archive directory of their own.
+std::string GetArchiveDirForWalDir(const std::string& tablet_wal_dir);
+
+// Suffix of the sparse index file kept alongside an in-progress segment.
+extern const char kSegmentIndexFileSuffix[];
+
+// Returns the path of the sparse index file of the segment at 'segment_path'.
+std::string SegmentIndexPath(const std::string& segment_path);
+
+// Reads the last valid checkpoint from the sparse index file of the segment
+// at 'segment_path' into 'checkpoint'. Returns NotFound if the segment has no
+// sparse index, or if it contains no valid checkpoint.
+Status ReadLastSegmentIndexCheckpoint(Env* env, const std::string& segment_path,
+                                      LogSegmentIndexCheckpointPB* checkpoint);
+
 // Update 'footer' to reflect the given REPLICATE message 'entry_pb'.
 // In particular, updates the min/max seen replicate OpID.
 void UpdateFooterForReplicateEntry(
@@ -22,6 +22,7 @@
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -31,6 +32,7 @@
 #include <gtest/gtest.h>
 
 #include "kudu/clock/clock.h"
+#include "kudu/common/schema.h"
 #include "kudu/common/timestamp.h"
 #include "kudu/common/wire_protocol-test-util.h"
 #include "kudu/common/wire_protocol.pb.h"
@@ -41,6 +43,7 @@
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/opid.pb.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -66,6 +69,7 @@ DEFINE_int32(num_batches_per_thread, 2000, "Number of batches per thread");
 DEFINE_int32(num_ops_per_batch_avg, 5, "Target average number of ops per batch");
 DEFINE_bool(verify_log, true, "Whether to verify the log by reading it after the writes complete");
 
+DECLARE_bool(log_async_writeback);
 DECLARE_int32(log_thread_idle_threshold_ms);
 DECLARE_int32(log_inject_thread_lifecycle_latency_ms);
 
@@ -73,6 +77,7 @@ namespace kudu {
 namespace log {
 
 using std::shared_ptr;
+using std::string;
 using std::vector;
 using consensus::OpId;
 using consensus::ReplicateRefPtr;
@@ -244,6 +249,105 @@ TEST_F(MultiThreadedLogTest, TestAppends) {
   }
 }
 
+// Same as above, but with the append thread split into separate append and
+// sync stages. Forces fsync so that the sync stage does real work while the
+// append stage keeps writing and rolling segments.
+TEST_F(MultiThreadedLogTest, TestPipelinedAppends) {
+  if (google::GetCommandLineFlagInfoOrDie("log_segment_size_mb").is_default) {
+    options_.segment_size_mb = 1;
+  }
+  options_.force_fsync_all = true;
+  options_.pipelined_append = true;
+
+  ASSERT_OK(BuildLog());
+  ASSERT_NO_FATAL_FAILURE(Run());
+  ASSERT_OK(log_->Close());
+  ASSERT_NO_FATAL_FAILURE(VerifyLog());
+}
+
+// Measures the aggregate throughput of synchronous appends to many tablets'
+// logs at once, with and without asynchronous writeback of each group.
+TEST_F(MultiThreadedLogTest, TestMultiTabletAppendThroughput) {
+  options_.force_fsync_all = true;
+  for (int num_tablets : { 1, 8, 64 }) {
+    for (bool writeback : { false, true }) {
+      FLAGS_log_async_writeback = writeback;
+      const int batches_per_tablet = std::max(10, FLAGS_num_batches_per_thread / num_tablets);
+      vector<scoped_refptr<Log>> logs(num_tablets);
+      for (int i = 0; i < num_tablets; i++) {
+        ASSERT_OK(Log::Open(options_, fs_manager_.get(),
+                            strings::Substitute("$0-$1-$2-$3", kTestTablet, num_tablets,
+                                                writeback, i),
+                            SchemaBuilder(schema_).Build(), 0, metric_entity_.get(),
+                            &logs[i]));
+      }
+      Stopwatch sw;
+      sw.start();
+      vector<std::thread> writers;
+      for (int i = 0; i < num_tablets; i++) {
+        writers.emplace_back([&, i]() {
+          OpId op_id = consensus::MakeOpId(1, 1);
+          for (int b = 0; b < batches_per_tablet; b++) {
+            CHECK_OK(AppendNoOpsToLogSync(clock_, logs[i].get(), &op_id,
+                                          FLAGS_num_ops_per_batch_avg));
+          }
+        });
+      }
+      for (auto& t : writers) {
+        t.join();
+      }
+      sw.stop();
+      LOG(INFO) << strings::Substitute(
+          "$0 tablets, async writeback $1: $2 batches/sec",
+          num_tablets, writeback ? "on" : "off",
+          num_tablets * batches_per_tablet / sw.elapsed().wall_seconds());
+      for (auto& log : logs) {
+        ASSERT_OK(log->Close());
+      }
+    }
+  }
+}
+
+// Tests that many logs can append concurrently while sharing an append pool
+// with fewer threads than there are logs.
+TEST_F(MultiThreadedLogTest, TestSharedAppendPool) {
+  const int kNumTablets = 16;
+  const int kNumBatchesPerTablet = 50;
+  options_.append_threads_per_wal_dir = 2;
+  vector<scoped_refptr<Log>> logs(kNumTablets);
+  vector<string> tablet_ids;
+  for (int i = 0; i < kNumTablets; i++) {
+    tablet_ids.emplace_back(strings::Substitute("$0-shared-$1", kTestTablet, i));
+    ASSERT_OK(Log::Open(options_, fs_manager_.get(), tablet_ids.back(),
+                        SchemaBuilder(schema_).Build(), 0, metric_entity_.get(),
+                        &logs[i]));
+  }
+  vector<std::thread> writers;
+  for (int i = 0; i < kNumTablets; i++) {
+    writers.emplace_back([&, i]() {
+      OpId op_id = consensus::MakeOpId(1, 1);
+      for (int b = 0; b < kNumBatchesPerTablet; b++) {
+        CHECK_OK(AppendNoOpsToLogSync(clock_, logs[i].get(), &op_id, 1));
+      }
+    });
+  }
+  for (auto& t : writers) {
+    t.join();
+  }
+  for (int i = 0; i < kNumTablets; i++) {
+    ASSERT_OK(logs[i]->Close());
+    shared_ptr<LogReader> reader;
+    ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, tablet_ids[i], nullptr, &reader));
+    SegmentSequence segments;
+    ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+    LogEntries entries;
+    for (const auto& segment : segments) {
+      ASSERT_OK(segment->ReadEntries(&entries));
+    }
+    ASSERT_EQ(kNumBatchesPerTablet, entries.size());
+  }
+}
+
 // The lifecycle of the appender task starting and stopping is a bit complicated
 // (see Log::AppendThread::GoIdle for details). This injects some latency in key
 // points of that lifecycle to ensure that the different potential interleavings
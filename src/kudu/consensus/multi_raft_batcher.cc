@@ -0,0 +1,264 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/multi_raft_batcher.h"
+
+#include <mutex>
+#include <ostream>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/consensus/consensus.proxy.h"
+#include "kudu/consensus/consensus_peers.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+
+DEFINE_bool(consensus_multi_raft_batching, false,
+            "Whether tablet leaders coalesce the heartbeats, and the appends of up "
+            "to --consensus_multi_raft_batch_max_op_bytes, which they send to "
+            "the same server into MultiRaftUpdateConsensus RPCs instead of each "
+            "sending their own UpdateConsensus RPC.");
+TAG_FLAG(consensus_multi_raft_batching, advanced);
+TAG_FLAG(consensus_multi_raft_batching, experimental);
+
+DEFINE_int32(consensus_multi_raft_batch_window_ms, 10,
+             "With --consensus_multi_raft_batching, the longest time a request is "
+             "held for other requests to the same server to be batched with it.");
+TAG_FLAG(consensus_multi_raft_batch_window_ms, advanced);
+TAG_FLAG(consensus_multi_raft_batch_window_ms, experimental);
+
+DEFINE_int32(consensus_multi_raft_batch_max_requests, 256,
+             "With --consensus_multi_raft_batching, the number of requests to the "
+             "same server at which a batch is sent without waiting any longer.");
+TAG_FLAG(consensus_multi_raft_batch_max_requests, advanced);
+TAG_FLAG(consensus_multi_raft_batch_max_requests, experimental);
+
+DEFINE_int32(consensus_multi_raft_batch_max_op_bytes, 0,
+             "With --consensus_multi_raft_batching, requests carrying at most this "
+             "many bytes of ops are batched along with heartbeats. The receiving "
+             "server applies the requests of a batch one after another, so the "
+             "appends in a batch wait for each other's log syncs. 0 batches "
+             "heartbeats only.");
+TAG_FLAG(consensus_multi_raft_batch_max_op_bytes, advanced);
+TAG_FLAG(consensus_multi_raft_batch_max_op_bytes, experimental);
+
+DEFINE_bool(consensus_multi_raft_vote_batching, false,
+            "Whether candidates coalesce the vote requests which they send to the "
+            "same server into MultiRaftRequestConsensusVote RPCs instead of each "
+            "sending their own RequestConsensusVote RPC. Batches are bounded by "
+            "--consensus_multi_raft_batch_window_ms and "
+            "--consensus_multi_raft_batch_max_requests. Mostly useful when many "
+            "tablets hold elections at once, e.g. after a server fails.");
+TAG_FLAG(consensus_multi_raft_vote_batching, advanced);
+TAG_FLAG(consensus_multi_raft_vote_batching, experimental);
+
+DECLARE_int32(consensus_rpc_timeout_ms);
+
+using std::shared_ptr;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+namespace consensus {
+
+MultiRaftBatcher::MultiRaftBatcher(shared_ptr<rpc::Messenger> messenger,
+                                   HostPort hostport,
+                                   gscoped_ptr<ConsensusServiceProxy> proxy)
+    : messenger_(std::move(messenger)),
+      hostport_(std::move(hostport)),
+      proxy_(std::move(proxy)),
+      supported_(true),
+      votes_supported_(true) {
+}
+
+MultiRaftBatcher::~MultiRaftBatcher() {
+  // Only reached with a batch pending if its flush timer was dropped by the
+  // messenger shutting down.
+  const Status aborted = Status::Aborted("batcher destroyed before the batch was sent");
+  if (current_batch_.batch) {
+    for (const auto& callback : current_batch_.batch->callbacks) {
+      callback(aborted);
+    }
+  }
+  if (current_vote_batch_.batch) {
+    for (const auto& callback : current_vote_batch_.batch->callbacks) {
+      callback(aborted);
+    }
+  }
+}
+
+bool MultiRaftBatcher::enabled() const {
+  return FLAGS_consensus_multi_raft_batching && supported_;
+}
+
+bool MultiRaftBatcher::votes_enabled() const {
+  return FLAGS_consensus_multi_raft_vote_batching && votes_supported_;
+}
+
+void MultiRaftBatcher::AddRequest(const ConsensusRequestPB* request,
+                                  ConsensusResponsePB* response,
+                                  StdStatusCallback callback) {
+  AddToBatch(&current_batch_, request, response, std::move(callback));
+}
+
+void MultiRaftBatcher::AddVoteRequest(const VoteRequestPB* request,
+                                      VoteResponsePB* response,
+                                      StdStatusCallback callback) {
+  AddToBatch(&current_vote_batch_, request, response, std::move(callback));
+}
+
+template<class BatchType, class RequestPB>
+void MultiRaftBatcher::AddToBatch(CurrentBatch<BatchType>* current,
+                                  const RequestPB* request,
+                                  typename BatchType::Response* response,
+                                  StdStatusCallback callback) {
+  unique_ptr<BatchType> full_batch;
+  int64_t new_seqno = -1;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!current->batch) {
+      current->batch.reset(new BatchType);
+      new_seqno = ++current->seqno;
+    }
+    current->batch->request.add_requests()->CopyFrom(*request);
+    current->batch->responses.push_back(response);
+    current->batch->callbacks.emplace_back(std::move(callback));
+    if (current->batch->request.requests_size() >=
+        FLAGS_consensus_multi_raft_batch_max_requests) {
+      full_batch = std::move(current->batch);
+    }
+  }
+
+  if (full_batch) {
+    SendBatch(std::move(full_batch));
+    return;
+  }
+  if (new_seqno != -1) {
+    // The batch is flushed by the timer even if the messenger is shutting
+    // down, so that the callbacks get the resulting error.
+    shared_ptr<MultiRaftBatcher> self = shared_from_this();
+    messenger_->ScheduleOnReactor(
+        [self, current, new_seqno](const Status& /* s */) {
+          self->FlushBatch(current, new_seqno);
+        },
+        MonoDelta::FromMilliseconds(FLAGS_consensus_multi_raft_batch_window_ms));
+  }
+}
+
+template<class BatchType>
+void MultiRaftBatcher::FlushBatch(CurrentBatch<BatchType>* current, int64_t seqno) {
+  unique_ptr<BatchType> batch;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    // The batch may already have been sent because it filled up.
+    if (current->batch && current->seqno == seqno) {
+      batch = std::move(current->batch);
+    }
+  }
+  if (batch) {
+    SendBatch(std::move(batch));
+  }
+}
+
+void MultiRaftBatcher::SendBatch(unique_ptr<UpdateBatch> batch) {
+  UpdateBatch* b = batch.release();
+  b->controller.set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  b->controller.RequireServerFeature(MULTI_RAFT_UPDATE);
+  shared_ptr<MultiRaftBatcher> self = shared_from_this();
+  proxy_->MultiRaftUpdateConsensusAsync(
+      b->request, &b->response, &b->controller,
+      [self, b]() { self->BatchFinished(b, &self->supported_, "MultiRaftUpdateConsensus"); });
+}
+
+void MultiRaftBatcher::SendBatch(unique_ptr<VoteBatch> batch) {
+  VoteBatch* b = batch.release();
+  b->controller.set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  b->controller.RequireServerFeature(MULTI_RAFT_VOTE);
+  shared_ptr<MultiRaftBatcher> self = shared_from_this();
+  proxy_->MultiRaftRequestConsensusVoteAsync(
+      b->request, &b->response, &b->controller,
+      [self, b]() {
+        self->BatchFinished(b, &self->votes_supported_, "MultiRaftRequestConsensusVote");
+      });
+}
+
+template<class BatchType>
+void MultiRaftBatcher::BatchFinished(BatchType* b,
+                                     std::atomic<bool>* supported,
+                                     const char* method) {
+  unique_ptr<BatchType> batch(b);
+  Status s = batch->controller.status();
+  if (s.IsRemoteError()) {
+    const rpc::ErrorStatusPB* err = batch->controller.error_response();
+    if (err && (err->unsupported_feature_flags_size() > 0 ||
+                err->code() == rpc::ErrorStatusPB::ERROR_NO_SUCH_METHOD) &&
+        supported->exchange(false)) {
+      LOG(INFO) << "Server " << hostport_.ToString() << " does not support "
+                << method << ", no longer batching requests to it";
+    }
+  }
+  const int num_requests = batch->callbacks.size();
+  if (s.ok() && batch->response.responses_size() != num_requests) {
+    s = Status::Corruption(Substitute("got $0 responses to a batch of $1 requests",
+                                      batch->response.responses_size(),
+                                      num_requests));
+  }
+  for (int i = 0; i < num_requests; i++) {
+    if (s.ok()) {
+      batch->responses[i]->Swap(batch->response.mutable_responses(i));
+    }
+    batch->callbacks[i](s);
+  }
+}
+
+MultiRaftManager::MultiRaftManager(shared_ptr<rpc::Messenger> messenger)
+    : messenger_(std::move(messenger)) {
+}
+
+Status MultiRaftManager::GetBatcher(const HostPort& hostport,
+                                    shared_ptr<MultiRaftBatcher>* batcher) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    std::weak_ptr<MultiRaftBatcher>* existing = FindOrNull(batchers_, hostport);
+    if (existing && (*batcher = existing->lock())) {
+      return Status::OK();
+    }
+  }
+
+  // Resolve the server's address outside of the lock.
+  gscoped_ptr<ConsensusServiceProxy> proxy;
+  RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger_, hostport, &proxy));
+  auto new_batcher = std::make_shared<MultiRaftBatcher>(messenger_, hostport, std::move(proxy));
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  std::weak_ptr<MultiRaftBatcher>& entry = batchers_[hostport];
+  *batcher = entry.lock();
+  if (!*batcher) {
+    entry = new_batcher;
+    *batcher = std::move(new_batcher);
+  }
+  return Status::OK();
+}
+
+} // namespace consensus
+} // namespace kudu
@@ -0,0 +1,170 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_MULTI_RAFT_BATCHER_H
+#define KUDU_CONSENSUS_MULTI_RAFT_BATCHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/net/net_util.h"
+#include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
+
+namespace kudu {
+
+namespace rpc {
+class Messenger;
+}
+
+namespace consensus {
+
+class ConsensusServiceProxy;
+
+// Coalesces the UpdateConsensus requests which the tablet leaders of this
+// server send to one other server into MultiRaftUpdateConsensus RPCs, so
+// that the heartbeats of many tablets don't each take an RPC of their own.
+// Likewise coalesces the RequestConsensusVote requests of the candidates of
+// this server into MultiRaftRequestConsensusVote RPCs.
+//
+// A request is held for up to --consensus_multi_raft_batch_window_ms, or
+// until --consensus_multi_raft_batch_max_requests requests are waiting, and
+// is then sent along with the others batched with it.
+//
+// This class is thread-safe.
+class MultiRaftBatcher : public std::enable_shared_from_this<MultiRaftBatcher> {
+ public:
+  MultiRaftBatcher(std::shared_ptr<rpc::Messenger> messenger,
+                   HostPort hostport,
+                   gscoped_ptr<ConsensusServiceProxy> proxy);
+  ~MultiRaftBatcher();
+
+  // Whether requests may be batched to the server. False if batching is
+  // disabled, or if the server turned out not to support it.
+  bool enabled() const;
+
+  // Like enabled(), for vote requests.
+  bool votes_enabled() const;
+
+  // Add 'request' to the next batch. Once the batch RPC completes,
+  // 'response' is filled in and 'callback' is called, on a reactor thread,
+  // with the status of the batch RPC. 'request' and 'response' must remain
+  // valid until then. 'request' is copied into the batch, so it should be
+  // small: a heartbeat or a small append.
+  void AddRequest(const ConsensusRequestPB* request,
+                  ConsensusResponsePB* response,
+                  StdStatusCallback callback);
+
+  // Like AddRequest(), for a vote request.
+  void AddVoteRequest(const VoteRequestPB* request,
+                      VoteResponsePB* response,
+                      StdStatusCallback callback);
+
+ private:
+  // A batch of requests, and what is needed to respond to each.
+  template<class MultiRequestPB, class MultiResponsePB, class ResponsePB>
+  struct Batch {
+    typedef ResponsePB Response;
+    MultiRequestPB request;
+    MultiResponsePB response;
+    rpc::RpcController controller;
+    std::vector<ResponsePB*> responses;
+    std::vector<StdStatusCallback> callbacks;
+  };
+  typedef Batch<MultiRaftConsensusRequestPB, MultiRaftConsensusResponsePB,
+                ConsensusResponsePB> UpdateBatch;
+  typedef Batch<MultiRaftVoteRequestPB, MultiRaftVoteResponsePB,
+                VoteResponsePB> VoteBatch;
+
+  // The batch of one kind being assembled, or NULL, and its sequence number.
+  template<class BatchType>
+  struct CurrentBatch {
+    std::unique_ptr<BatchType> batch;
+    int64_t seqno = 0;
+  };
+
+  // Add 'request' to the batch in 'current'.
+  template<class BatchType, class RequestPB>
+  void AddToBatch(CurrentBatch<BatchType>* current,
+                  const RequestPB* request,
+                  typename BatchType::Response* response,
+                  StdStatusCallback callback);
+
+  // Send the batch in 'current', if it is still batch number 'seqno'.
+  template<class BatchType>
+  void FlushBatch(CurrentBatch<BatchType>* current, int64_t seqno);
+
+  // Send 'batch', which is no longer current.
+  void SendBatch(std::unique_ptr<UpdateBatch> batch);
+  void SendBatch(std::unique_ptr<VoteBatch> batch);
+
+  // Hand the responses to the batched requests back to their senders.
+  // 'supported' is cleared if the server doesn't implement 'method'.
+  template<class BatchType>
+  void BatchFinished(BatchType* batch, std::atomic<bool>* supported, const char* method);
+
+  const std::shared_ptr<rpc::Messenger> messenger_;
+  const HostPort hostport_;
+  const gscoped_ptr<ConsensusServiceProxy> proxy_;
+
+  // Cleared if the server rejects MultiRaftUpdateConsensus, resp.
+  // MultiRaftRequestConsensusVote.
+  std::atomic<bool> supported_;
+  std::atomic<bool> votes_supported_;
+
+  // Protects the fields below.
+  simple_spinlock lock_;
+
+  CurrentBatch<UpdateBatch> current_batch_;
+  CurrentBatch<VoteBatch> current_vote_batch_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiRaftBatcher);
+};
+
+// Hands out the MultiRaftBatcher for each destination server, so that all
+// the tablets of this server share one. One per server.
+//
+// This class is thread-safe.
+class MultiRaftManager {
+ public:
+  explicit MultiRaftManager(std::shared_ptr<rpc::Messenger> messenger);
+
+  // Get the batcher for the server at 'hostport', creating it if need be.
+  Status GetBatcher(const HostPort& hostport, std::shared_ptr<MultiRaftBatcher>* batcher);
+
+ private:
+  const std::shared_ptr<rpc::Messenger> messenger_;
+
+  simple_spinlock lock_;
+  // The batchers, which are owned by the proxies of the peers they batch for.
+  std::unordered_map<HostPort, std::weak_ptr<MultiRaftBatcher>,
+                     HostPortHasher, HostPortEqualityPredicate> batchers_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiRaftManager);
+};
+
+} // namespace consensus
+} // namespace kudu
+#endif /* KUDU_CONSENSUS_MULTI_RAFT_BATCHER_H */
@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/ops_sidecar.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glog/logging.h>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/pb_util.h"
+
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace consensus {
+
+void SerializeOpsForSidecar(const vector<ReplicateRefPtr>& msgs, faststring* buf) {
+  for (const ReplicateRefPtr& msg : msgs) {
+    const ReplicateMsg& replicate = *msg->get();
+    DCHECK(replicate.IsInitialized());
+    int size = msg->byte_size();
+    PutVarint32(buf, size);
+    // The sizes were cached when the message was appended to the log cache,
+    // so serialize without computing them again.
+    size_t offset = buf->size();
+    buf->resize(offset + size);
+    replicate.SerializeWithCachedSizesToArray(buf->data() + offset);
+  }
+}
+
+Status CompressOpsSidecar(const CompressionCodec& codec, Slice ops, faststring* buf) {
+  buf->clear();
+  PutVarint64(buf, ops.size());
+  size_t offset = buf->size();
+  buf->resize(offset + codec.MaxCompressedLength(ops.size()));
+  size_t compressed_size;
+  RETURN_NOT_OK(codec.Compress(ops, buf->data() + offset, &compressed_size));
+  buf->resize(offset + compressed_size);
+  return Status::OK();
+}
+
+Status DecodeOpsFromSidecar(Slice sidecar, CompressionType compression,
+                            ConsensusRequestPB* request) {
+  // An upper bound on the uncompressed size, so that a corrupt length can't
+  // make us allocate an arbitrary amount of memory.
+  static const uint64_t kMaxUncompressedSize = 1024L * 1024 * 1024;
+
+  faststring uncompressed;
+  if (compression != NO_COMPRESSION && compression != DEFAULT_COMPRESSION) {
+    const CompressionCodec* codec;
+    RETURN_NOT_OK_PREPEND(GetCompressionCodec(compression, &codec),
+                          "unable to decompress ops sidecar");
+    uint64_t uncompressed_size;
+    if (PREDICT_FALSE(!GetVarint64(&sidecar, &uncompressed_size) ||
+                      uncompressed_size > kMaxUncompressedSize)) {
+      return Status::Corruption("malformed compressed ops sidecar");
+    }
+    uncompressed.resize(uncompressed_size);
+    RETURN_NOT_OK_PREPEND(codec->Uncompress(sidecar, uncompressed.data(), uncompressed_size),
+                          "unable to decompress ops sidecar");
+    sidecar = Slice(uncompressed);
+  }
+
+  while (!sidecar.empty()) {
+    uint32_t len;
+    if (PREDICT_FALSE(!GetVarint32(&sidecar, &len) || len > sidecar.size())) {
+      return Status::Corruption(Substitute("malformed ops sidecar after $0 ops",
+                                           request->ops_size()));
+    }
+    RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(request->add_ops(), sidecar.data(), len),
+                          Substitute("unable to parse op $0 from sidecar", request->ops_size()));
+    sidecar.remove_prefix(len);
+  }
+  return Status::OK();
+}
+
+} // namespace consensus
+} // namespace kudu
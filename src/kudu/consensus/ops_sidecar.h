@@ -0,0 +1,53 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_OPS_SIDECAR_H
+#define KUDU_CONSENSUS_OPS_SIDECAR_H
+
+#include <vector>
+
+#include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/util/compression/compression.pb.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class CompressionCodec;
+class faststring;
+
+namespace consensus {
+
+class ConsensusRequestPB;
+
+// Serialize 'msgs' into 'buf' in the format of ConsensusRequestPB's ops
+// sidecar (see consensus.proto): each message as a varint32 length followed
+// by the serialized ReplicateMsg.
+void SerializeOpsForSidecar(const std::vector<ReplicateRefPtr>& msgs, faststring* buf);
+
+// Compress 'ops', serialized by SerializeOpsForSidecar(), with 'codec' into
+// 'buf': the uncompressed length as a varint64 followed by the compressed data.
+Status CompressOpsSidecar(const CompressionCodec& codec, Slice ops, faststring* buf);
+
+// Decode the ops in 'sidecar', serialized by SerializeOpsForSidecar() and
+// compressed with 'compression' unless it is NO_COMPRESSION, and add them to
+// the 'ops' of 'request'. Returns Corruption if the data is malformed.
+Status DecodeOpsFromSidecar(Slice sidecar, CompressionType compression,
+                            ConsensusRequestPB* request);
+
+} // namespace consensus
+} // namespace kudu
+#endif /* KUDU_CONSENSUS_OPS_SIDECAR_H */
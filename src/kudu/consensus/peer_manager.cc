@@ -65,7 +65,10 @@ Status PeerManager::UpdateRaftConfig(const RaftConfigPB& config) {
   std::lock_guard<simple_spinlock> lock(lock_);
   // Create new peers
   for (const RaftPeerPB& peer_pb : config.peers()) {
-    if (ContainsKey(peers_, peer_pb.permanent_uuid())) {
+    std::shared_ptr<Peer>* existing_peer = FindOrNull(peers_, peer_pb.permanent_uuid());
+    if (existing_peer) {
+      // The relay of the peer may have joined the config after it.
+      RETURN_NOT_OK(MaybeSetRelayProxyUnlocked(config, existing_peer->get()));
       continue;
     }
     if (peer_pb.permanent_uuid() == local_uuid_) {
@@ -86,12 +89,32 @@ Status PeerManager::UpdateRaftConfig(const RaftConfigPB& config) {
                                       std::move(peer_proxy),
                                       peer_proxy_factory_->messenger(),
                                       &remote_peer));
+
+    RETURN_NOT_OK(MaybeSetRelayProxyUnlocked(config, remote_peer.get()));
     peers_.emplace(peer_pb.permanent_uuid(), std::move(remote_peer));
   }
 
   return Status::OK();
 }
 
+Status PeerManager::MaybeSetRelayProxyUnlocked(const RaftConfigPB& config, Peer* peer) {
+  DCHECK(lock_.is_locked());
+  const std::string& relay_uuid = peer->peer_pb().attrs().relay_uuid();
+  if (relay_uuid.empty() || relay_uuid == local_uuid_ || peer->has_relay_proxy()) {
+    return Status::OK();
+  }
+  for (const RaftPeerPB& relay_pb : config.peers()) {
+    if (relay_pb.permanent_uuid() == relay_uuid) {
+      gscoped_ptr<PeerProxy> relay_proxy;
+      RETURN_NOT_OK_PREPEND(peer_proxy_factory_->NewProxy(relay_pb, &relay_proxy),
+                            "Could not obtain a remote proxy to the relay.");
+      peer->SetRelayProxy(std::move(relay_proxy));
+      break;
+    }
+  }
+  return Status::OK();
+}
+
 void PeerManager::SignalRequest(bool force_if_queue_empty) {
   std::lock_guard<simple_spinlock> lock(lock_);
   for (auto iter = peers_.begin(); iter != peers_.end();) {
@@ -107,6 +130,16 @@ void PeerManager::SignalRequest(bool force_if_queue_empty) {
   }
 }
 
+void PeerManager::SignalHeartbeats() {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  for (const auto& entry : peers_) {
+    // Closed peers are removed by the next SignalRequest().
+    WARN_NOT_OK(entry.second->SignalHeartbeat(),
+                Substitute("$0Could not signal a heartbeat to peer $1",
+                           GetLogPrefix(), entry.first));
+  }
+}
+
 Status PeerManager::StartElection(const std::string& uuid) {
   std::shared_ptr<Peer> peer;
   {
@@ -62,6 +62,10 @@ class PeerManager {
   // Signals all peers of the current configuration that there is a new request pending.
   void SignalRequest(bool force_if_queue_empty = false);
 
+  // Signals all peers to send a request as soon as possible, even if the
+  // queue is empty. See Peer::SignalHeartbeat().
+  void SignalHeartbeats();
+
   // Start an election on the peer with UUID 'uuid'.
   Status StartElection(const std::string& uuid);
 
@@ -71,6 +75,10 @@ class PeerManager {
  private:
   std::string GetLogPrefix() const;
 
+  // Sets the proxy to the relay of 'peer' in 'config', if it has one and it
+  // wasn't set yet.
+  Status MaybeSetRelayProxyUnlocked(const RaftConfigPB& config, Peer* peer);
+
   typedef std::unordered_map<std::string, std::shared_ptr<Peer>> PeersMap;
   const std::string tablet_id_;
   const std::string local_uuid_;
@@ -17,17 +17,17 @@
 
 #include "kudu/consensus/pending_rounds.h"
 
-#include <iterator>
+#include <algorithm>
 #include <ostream>
 #include <utility>
 
 #include <glog/logging.h>
 
+#include "kudu/consensus/apply_scheduler.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/raft_consensus.h"
 #include "kudu/consensus/time_manager.h"
-#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/debug-util.h"
@@ -47,10 +47,13 @@ namespace consensus {
 // PendingRounds
 //------------------------------------------------------------
 
-PendingRounds::PendingRounds(string log_prefix, scoped_refptr<TimeManager> time_manager)
+PendingRounds::PendingRounds(string log_prefix, scoped_refptr<TimeManager> time_manager,
+                             ApplyScheduler* apply_scheduler)
     : log_prefix_(std::move(log_prefix)),
+      first_pending_index_(0),
       last_committed_op_id_(MinimumOpId()),
-      time_manager_(std::move(time_manager)) {}
+      time_manager_(std::move(time_manager)),
+      apply_scheduler_(apply_scheduler) {}
 
 PendingRounds::~PendingRounds() {
 }
@@ -65,7 +68,7 @@ Status PendingRounds::CancelPendingTransactions() {
                         << " pending transactions.";
   // Abort transactions in reverse index order. See KUDU-1678.
   for (auto txn = pending_txns_.crbegin(); txn != pending_txns_.crend(); ++txn) {
-    const scoped_refptr<ConsensusRound>& round = txn->second;
+    const scoped_refptr<ConsensusRound>& round = *txn;
     // We cancel only transactions whose applies have not yet been triggered.
     LOG_WITH_PREFIX(INFO) << "Aborting transaction as it isn't in flight: "
                           << SecureShortDebugString(*round->replicate_msg());
@@ -79,40 +82,63 @@ void PendingRounds::AbortOpsAfter(int64_t index) {
                         << index;
 
   DCHECK_GE(index, 0);
-  OpId new_preceding;
-
-  auto iter = pending_txns_.lower_bound(index);
 
   // Either the new preceding id is in the pendings set or it must be equal to the
   // committed index since we can't truncate already committed operations.
-  if (iter != pending_txns_.end() && (*iter).first == index) {
-    new_preceding = (*iter).second->replicate_msg()->id();
-    ++iter;
-  } else {
+  if (index < first_pending_index_ || index >= end_pending_index()) {
     CHECK_EQ(index, last_committed_op_id_.index());
-    new_preceding = last_committed_op_id_;
   }
 
-  for (; iter != pending_txns_.end();) {
-    const scoped_refptr<ConsensusRound>& round = (*iter).second;
+  const int64_t num_pending = pending_txns_.size();
+  const int64_t num_kept = std::max<int64_t>(0, index + 1 - first_pending_index_);
+  for (int64_t i = num_kept; i < num_pending; i++) {
+    const scoped_refptr<ConsensusRound>& round = pending_txns_[i];
     auto op_type = round->replicate_msg()->op_type();
     LOG_WITH_PREFIX(INFO)
         << "Aborting uncommitted " << OperationType_Name(op_type)
         << " operation due to leader change: " << round->replicate_msg()->id();
 
     round->NotifyReplicationFinished(Status::Aborted("Transaction aborted by new leader"));
-    // Erase the entry from pendings.
-    pending_txns_.erase(iter++);
+  }
+  // Erase the entries from pendings.
+  if (num_kept < num_pending) {
+    pending_txns_.resize(num_kept);
   }
 }
 
+void PendingRounds::ResetAfterSnapshot(const OpId& last_included) {
+  CHECK_GT(last_included.index(), last_committed_op_id_.index());
+  AbortOpsAfter(last_committed_op_id_.index());
+  last_committed_op_id_ = last_included;
+  first_pending_index_ = last_included.index() + 1;
+}
+
 Status PendingRounds::AddPendingOperation(const scoped_refptr<ConsensusRound>& round) {
-  InsertOrDie(&pending_txns_, round->replicate_msg()->id().index(), round);
+  int64_t index = round->replicate_msg()->id().index();
+  if (pending_txns_.empty()) {
+    first_pending_index_ = index;
+  } else if (PREDICT_FALSE(index != end_pending_index())) {
+    return Status::IllegalState(Substitute(
+        "pending operations must be sequential (new=$0, last pending=$1)",
+        OpIdToString(round->replicate_msg()->id()),
+        OpIdToString(GetLastPendingTransactionOpId())));
+  }
+  pending_txns_.push_back(round);
   return Status::OK();
 }
 
 scoped_refptr<ConsensusRound> PendingRounds::GetPendingOpByIndexOrNull(int64_t index) {
-  return FindPtrOrNull(pending_txns_, index);
+  if (index < first_pending_index_ || index >= end_pending_index()) {
+    return nullptr;
+  }
+  return RoundAt(index);
+}
+
+bool PendingRounds::IsOpPending(const OpId& op_id) const {
+  if (op_id.index() < first_pending_index_ || op_id.index() >= end_pending_index()) {
+    return false;
+  }
+  return OpIdEquals(RoundAt(op_id.index())->id(), op_id);
 }
 
 bool PendingRounds::IsOpCommittedOrPending(const OpId& op_id, bool* term_mismatch) {
@@ -137,7 +163,7 @@ bool PendingRounds::IsOpCommittedOrPending(const OpId& op_id, bool* term_mismatc
 
 OpId PendingRounds::GetLastPendingTransactionOpId() const {
   return pending_txns_.empty()
-      ? MinimumOpId() : (--pending_txns_.end())->second->id();
+      ? MinimumOpId() : pending_txns_.back()->id();
 }
 
 Status PendingRounds::AdvanceCommittedIndex(int64_t committed_index) {
@@ -162,18 +188,16 @@ Status PendingRounds::AdvanceCommittedIndex(int64_t committed_index) {
     return Status::OK();
   }
 
-  // Start at the operation after the last committed one.
-  auto iter = pending_txns_.upper_bound(last_committed_op_id_.index());
-  // Stop at the operation after the last one we must commit.
-  auto end_iter = pending_txns_.upper_bound(committed_index);
-  CHECK(iter != pending_txns_.end());
+  // Committed ops are removed from the front, so the first pending op is the
+  // one after the last committed one.
+  DCHECK_GT(first_pending_index_, last_committed_op_id_.index());
 
   VLOG_WITH_PREFIX(1) << "Last triggered apply was: "
       <<  last_committed_op_id_
-      << " Starting to apply from log index: " << (*iter).first;
+      << " Starting to apply from log index: " << first_pending_index_;
 
-  while (iter != end_iter) {
-    scoped_refptr<ConsensusRound> round = (*iter).second; // Make a copy.
+  while (!pending_txns_.empty() && first_pending_index_ <= committed_index) {
+    scoped_refptr<ConsensusRound> round = pending_txns_.front(); // Make a copy.
     DCHECK(round);
     const OpId& current_id = round->id();
 
@@ -181,10 +205,15 @@ Status PendingRounds::AdvanceCommittedIndex(int64_t committed_index) {
       CHECK_OK(CheckOpInSequence(last_committed_op_id_, current_id));
     }
 
-    pending_txns_.erase(iter++);
+    pending_txns_.pop_front();
+    first_pending_index_++;
     last_committed_op_id_ = round->id();
     time_manager_->AdvanceSafeTimeWithMessage(*round->replicate_msg());
-    round->NotifyReplicationFinished(Status::OK());
+    if (apply_scheduler_) {
+      apply_scheduler_->Schedule(round);
+    } else {
+      round->NotifyReplicationFinished(Status::OK());
+    }
   }
 
   return Status::OK();
@@ -193,7 +222,7 @@ Status PendingRounds::AdvanceCommittedIndex(int64_t committed_index) {
 Status PendingRounds::SetInitialCommittedOpId(const OpId& committed_op) {
   CHECK_EQ(last_committed_op_id_.index(), 0);
   if (!pending_txns_.empty()) {
-    int64_t first_pending_index = pending_txns_.begin()->first;
+    int64_t first_pending_index = first_pending_index_;
     if (committed_op.index() < first_pending_index) {
       if (committed_op.index() != first_pending_index - 1) {
         return Status::Corruption(Substitute(
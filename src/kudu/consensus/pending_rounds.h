@@ -18,7 +18,7 @@
 #pragma once
 
 #include <cstdint>
-#include <map>
+#include <deque>
 #include <string>
 
 #include "kudu/consensus/opid.pb.h"
@@ -29,6 +29,7 @@ namespace kudu {
 class Status;
 
 namespace consensus {
+class ApplyScheduler;
 class ConsensusRound;
 class TimeManager;
 
@@ -41,7 +42,10 @@ class TimeManager;
 // We should consolidate to "round".
 class PendingRounds {
  public:
-  PendingRounds(std::string log_prefix, scoped_refptr<TimeManager> time_manager);
+  // If 'apply_scheduler' is not null, committed rounds are notified through it
+  // rather than inline. It must outlive this object.
+  PendingRounds(std::string log_prefix, scoped_refptr<TimeManager> time_manager,
+                ApplyScheduler* apply_scheduler = nullptr);
   ~PendingRounds();
 
   // Set the committed op during startup. This should be done after
@@ -53,7 +57,11 @@ class PendingRounds {
   // if there isn't.
   scoped_refptr<ConsensusRound> GetPendingOpByIndexOrNull(int64_t index);
 
-  // Add 'round' to the set of rounds waiting to be committed.
+  // Returns true if there is a pending op with exactly the id 'op_id'.
+  bool IsOpPending(const OpId& op_id) const;
+
+  // Add 'round' to the set of rounds waiting to be committed. Its index must
+  // directly follow that of the last pending round, if there is any.
   Status AddPendingOperation(const scoped_refptr<ConsensusRound>& round);
 
   // Advances the committed index.
@@ -65,6 +73,11 @@ class PendingRounds {
   // higher than 'index' those operations are aborted.
   void AbortOpsAfter(int64_t index);
 
+  // Aborts all pending operations and makes 'last_included' the last
+  // committed op, once a snapshot of the state machine which includes the ops
+  // up to it was installed. 'last_included' must follow the committed op.
+  void ResetAfterSnapshot(const OpId& last_included);
+
   // Returns true if an operation is in this replica's log, namely:
   // - If the op's index is lower than or equal to our committed index
   // - If the op id matches an inflight op.
@@ -100,17 +113,33 @@ class PendingRounds {
 
   const std::string log_prefix_;
 
-  // Index=>Round map that manages pending ops, i.e. operations for which we've
-  // received a replicate message from the leader but have yet to be committed.
-  // The key is the index of the replicate operation.
-  typedef std::map<int64_t, scoped_refptr<ConsensusRound> > IndexToRoundMap;
-  IndexToRoundMap pending_txns_;
+  // Returns the round at 'index', which must be pending.
+  const scoped_refptr<ConsensusRound>& RoundAt(int64_t index) const {
+    return pending_txns_[index - first_pending_index_];
+  }
+
+  // The index one past the last pending op.
+  int64_t end_pending_index() const {
+    return first_pending_index_ + pending_txns_.size();
+  }
+
+  // The pending ops, i.e. operations for which we've received a replicate
+  // message from the leader but have yet to be committed.
+  //
+  // Pending op indexes are dense and sequential, so, as in the LogCache, the
+  // slot at position 'i' holds the op with index first_pending_index_ + i:
+  // lookups are a subtraction, and committing from the front or aborting
+  // from the back is O(1).
+  std::deque<scoped_refptr<ConsensusRound>> pending_txns_;
+  int64_t first_pending_index_;
 
   // The OpId of the round that was last committed. Initialized to MinimumOpId().
   OpId last_committed_op_id_;
 
   scoped_refptr<TimeManager> time_manager_;
 
+  ApplyScheduler* const apply_scheduler_;
+
   DISALLOW_COPY_AND_ASSIGN(PendingRounds);
 };
 
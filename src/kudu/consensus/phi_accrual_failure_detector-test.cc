@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/phi_accrual_failure_detector.h"
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+namespace consensus {
+
+class PhiAccrualFailureDetectorTest : public KuduTest {
+ protected:
+  // Feeds 'detector' 'num' heartbeats alternating between 'short_ms' and
+  // 'long_ms' apart, and returns when the last one arrived.
+  static MonoTime Heartbeats(PhiAccrualFailureDetector* detector, MonoTime start,
+                             int num, int short_ms, int long_ms) {
+    MonoTime now = start;
+    for (int i = 0; i < num; i++) {
+      now += MonoDelta::FromMilliseconds(i % 2 == 0 ? short_ms : long_ms);
+      detector->Heartbeat(now);
+    }
+    return now;
+  }
+};
+
+TEST_F(PhiAccrualFailureDetectorTest, TestNotEnoughHeartbeats) {
+  PhiAccrualFailureDetector detector(100, MonoDelta::FromMilliseconds(0));
+  MonoTime now = Heartbeats(&detector, MonoTime::Now(),
+                            PhiAccrualFailureDetector::kMinSamples, 100, 100);
+  MonoDelta delta;
+  ASSERT_FALSE(detector.TimeToSuspicion(8, &delta));
+  ASSERT_EQ(0, detector.Phi(now + MonoDelta::FromSeconds(10)));
+
+  detector.Heartbeat(now + MonoDelta::FromMilliseconds(100));
+  ASSERT_TRUE(detector.TimeToSuspicion(8, &delta));
+
+  detector.Reset();
+  ASSERT_FALSE(detector.TimeToSuspicion(8, &delta));
+}
+
+TEST_F(PhiAccrualFailureDetectorTest, TestSuspicion) {
+  PhiAccrualFailureDetector detector(100, MonoDelta::FromMilliseconds(0));
+  MonoTime now = Heartbeats(&detector, MonoTime::Now(), 51, 90, 110);
+
+  // The suspicion grows with the time since the last heartbeat.
+  double phi_at_mean = detector.Phi(now + MonoDelta::FromMilliseconds(100));
+  double phi_late = detector.Phi(now + MonoDelta::FromMilliseconds(150));
+  ASSERT_NEAR(0.3, phi_at_mean, 0.01);
+  ASSERT_GT(phi_late, phi_at_mean);
+
+  // The time to suspicion is consistent with the suspicion level, and grows
+  // with the threshold.
+  MonoDelta low;
+  MonoDelta high;
+  ASSERT_TRUE(detector.TimeToSuspicion(2, &low));
+  ASSERT_TRUE(detector.TimeToSuspicion(8, &high));
+  ASSERT_GT(high, low);
+  ASSERT_NEAR(2, detector.Phi(now + low), 0.01);
+  ASSERT_NEAR(8, detector.Phi(now + high), 0.01);
+
+  // Jittery heartbeats push suspicion back.
+  PhiAccrualFailureDetector jittery(100, MonoDelta::FromMilliseconds(0));
+  Heartbeats(&jittery, MonoTime::Now(), 51, 10, 190);
+  MonoDelta jittery_high;
+  ASSERT_TRUE(jittery.TimeToSuspicion(8, &jittery_high));
+  ASSERT_GT(jittery_high, high);
+}
+
+// Frequent requests from a busy leader don't make its idle heartbeats
+// suspicious.
+TEST_F(PhiAccrualFailureDetectorTest, TestMinMeanInterval) {
+  PhiAccrualFailureDetector detector(100, MonoDelta::FromMilliseconds(500));
+  Heartbeats(&detector, MonoTime::Now(), 50, 1, 1);
+  MonoDelta delta;
+  ASSERT_TRUE(detector.TimeToSuspicion(8, &delta));
+  ASSERT_GT(delta, MonoDelta::FromMilliseconds(500));
+}
+
+}  // namespace consensus
+}  // namespace kudu
@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/phi_accrual_failure_detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include <glog/logging.h>
+
+namespace kudu {
+namespace consensus {
+
+namespace {
+
+// The probability that a normally distributed interval exceeds 'mean' by
+// over 'z' standard deviations.
+double ProbabilityLater(double z) {
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+} // anonymous namespace
+
+const int PhiAccrualFailureDetector::kMinSamples = 10;
+
+PhiAccrualFailureDetector::PhiAccrualFailureDetector(int window_size,
+                                                     MonoDelta min_mean_interval)
+    : window_size_(std::max(window_size, kMinSamples)),
+      min_mean_interval_(min_mean_interval),
+      sum_(0),
+      sum_of_squares_(0) {
+}
+
+void PhiAccrualFailureDetector::Heartbeat(MonoTime now) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (last_heartbeat_.Initialized() && now > last_heartbeat_) {
+    int64_t interval = (now - last_heartbeat_).ToMicroseconds();
+    intervals_us_.push_back(interval);
+    sum_ += interval;
+    sum_of_squares_ += static_cast<double>(interval) * interval;
+    if (static_cast<int>(intervals_us_.size()) > window_size_) {
+      int64_t oldest = intervals_us_.front();
+      intervals_us_.pop_front();
+      sum_ -= oldest;
+      sum_of_squares_ -= static_cast<double>(oldest) * oldest;
+    }
+  }
+  last_heartbeat_ = now;
+}
+
+void PhiAccrualFailureDetector::Reset() {
+  std::lock_guard<simple_spinlock> l(lock_);
+  intervals_us_.clear();
+  sum_ = 0;
+  sum_of_squares_ = 0;
+  last_heartbeat_ = MonoTime();
+}
+
+bool PhiAccrualFailureDetector::GetDistributionUnlocked(double* mean, double* stddev) const {
+  DCHECK(lock_.is_locked());
+  if (static_cast<int>(intervals_us_.size()) < kMinSamples) {
+    return false;
+  }
+  double n = intervals_us_.size();
+  double sample_mean = sum_ / n;
+  double variance = std::max(0.0, sum_of_squares_ / n - sample_mean * sample_mean);
+  *mean = std::max(sample_mean, static_cast<double>(min_mean_interval_.ToMicroseconds()));
+  // Very regular heartbeats would make any small delay look like a failure,
+  // so don't let the deviation drop below a tenth of the mean.
+  *stddev = std::max(std::sqrt(variance), *mean / 10);
+  return true;
+}
+
+double PhiAccrualFailureDetector::Phi(MonoTime now) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  double mean;
+  double stddev;
+  if (!last_heartbeat_.Initialized() || !GetDistributionUnlocked(&mean, &stddev)) {
+    return 0;
+  }
+  double elapsed = (now - last_heartbeat_).ToMicroseconds();
+  double p = ProbabilityLater((elapsed - mean) / stddev);
+  return -std::log10(std::max(p, 1e-300));
+}
+
+bool PhiAccrualFailureDetector::TimeToSuspicion(double threshold, MonoDelta* delta) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  double mean;
+  double stddev;
+  if (!GetDistributionUnlocked(&mean, &stddev)) {
+    return false;
+  }
+  // Find the number of deviations 'z' past the mean at which phi reaches
+  // 'threshold', by bisection since phi is increasing in 'z'.
+  double target = std::pow(10, -threshold);
+  double lo = -40;
+  double hi = 40;
+  for (int i = 0; i < 100; i++) {
+    double mid = (lo + hi) / 2;
+    if (ProbabilityLater(mid) > target) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  *delta = MonoDelta::FromMicroseconds(
+      static_cast<int64_t>(std::max(0.0, mean + hi * stddev)));
+  return true;
+}
+
+}  // namespace consensus
+}  // namespace kudu
@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace consensus {
+
+// A phi accrual failure detector (Hayashibara et al., "The phi accrual
+// failure detector") for the heartbeats of a leader.
+//
+// The detector keeps the intervals between the most recent heartbeats and
+// models them with a normal distribution. Instead of a binary verdict it
+// reports the suspicion level phi that the leader has failed, given the time
+// elapsed since the last heartbeat: phi = -log10(P(interval > elapsed)). A
+// phi of 1 means a 10% chance of a false positive, 2 means 1%, and so on.
+//
+// This class is thread-safe.
+class PhiAccrualFailureDetector {
+ public:
+  // 'window_size' is the number of intervals kept. The modeled mean interval
+  // is at least 'min_mean_interval': a leader only heartbeats once idle for
+  // that long, so shorter intervals seen while it is busy don't make a later
+  // idle period look like a failure.
+  PhiAccrualFailureDetector(int window_size, MonoDelta min_mean_interval);
+
+  // Records a heartbeat arriving at 'now'.
+  void Heartbeat(MonoTime now);
+
+  // Forgets all the heartbeats, e.g. when the leader changes.
+  void Reset();
+
+  // Returns the suspicion level at 'now', or 0 if there haven't been enough
+  // heartbeats yet.
+  double Phi(MonoTime now) const;
+
+  // Sets 'delta' to the time after the last heartbeat at which the suspicion
+  // level reaches 'threshold'. Returns false if there haven't been enough
+  // heartbeats yet.
+  bool TimeToSuspicion(double threshold, MonoDelta* delta) const;
+
+  // The number of intervals needed before the detector reports anything.
+  static const int kMinSamples;
+
+ private:
+  // Sets 'mean' and 'stddev' to the parameters of the modeled distribution,
+  // in microseconds. Returns false if there aren't enough samples.
+  bool GetDistributionUnlocked(double* mean, double* stddev) const;
+
+  const int window_size_;
+  const MonoDelta min_mean_interval_;
+
+  mutable simple_spinlock lock_;
+
+  // The most recent intervals between heartbeats, in microseconds, and their
+  // sum and sum of squares.
+  std::deque<int64_t> intervals_us_;
+  double sum_;
+  double sum_of_squares_;
+
+  // When the last heartbeat arrived, uninitialized if there wasn't any.
+  MonoTime last_heartbeat_;
+
+  DISALLOW_COPY_AND_ASSIGN(PhiAccrualFailureDetector);
+};
+
+}  // namespace consensus
+}  // namespace kudu
@@ -24,6 +24,7 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include "kudu/common/common.pb.h"
@@ -38,6 +39,8 @@ using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
 
+DECLARE_int32(raft_commit_quorum_size);
+
 namespace kudu {
 namespace consensus {
 
@@ -340,6 +343,30 @@ TEST(QuorumUtilTest, TestIsRaftConfigVoter) {
   ASSERT_FALSE(ReplicaTypesEqual(*peer_b, *peer_c));
 }
 
+TEST(QuorumUtilTest, TestQuorumSizes) {
+  google::FlagSaver flag_saver;
+  for (int num_voters = 1; num_voters <= 7; num_voters++) {
+    ASSERT_EQ(MajoritySize(num_voters), CommitQuorumSize(num_voters));
+    ASSERT_EQ(MajoritySize(num_voters), ElectionQuorumSize(num_voters));
+  }
+
+  // Smaller commit quorums require larger election quorums.
+  FLAGS_raft_commit_quorum_size = 2;
+  ASSERT_EQ(1, CommitQuorumSize(1));
+  ASSERT_EQ(1, ElectionQuorumSize(1));
+  ASSERT_EQ(2, CommitQuorumSize(3));
+  ASSERT_EQ(2, ElectionQuorumSize(3));
+  ASSERT_EQ(2, CommitQuorumSize(5));
+  ASSERT_EQ(4, ElectionQuorumSize(5));
+
+  // Election quorums are at least a majority.
+  FLAGS_raft_commit_quorum_size = 5;
+  ASSERT_EQ(5, CommitQuorumSize(5));
+  ASSERT_EQ(3, ElectionQuorumSize(5));
+  ASSERT_EQ(4, CommitQuorumSize(4));
+  ASSERT_EQ(3, ElectionQuorumSize(4));
+}
+
 // Tests paremeterized by the policy on the replica majority's health.
 class QuorumUtilHealthPolicyParamTest :
     public ::testing::Test,
@@ -16,6 +16,7 @@
 // under the License.
 #include "kudu/consensus/quorum_util.h"
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <ostream>
@@ -25,6 +26,7 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/common/common.pb.h"
@@ -33,6 +35,7 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 
@@ -47,6 +50,15 @@ using std::string;
 using std::vector;
 using strings::Substitute;
 
+DEFINE_int32(raft_commit_quorum_size, 0,
+             "The number of voters which must replicate an op to commit it, or 0 "
+             "for a majority. Elections then require the votes of enough voters "
+             "for every election quorum to intersect every commit quorum, and "
+             "always at least a majority. Smaller commit quorums lower the commit "
+             "latency at the expense of the availability of elections. Must be "
+             "the same on all the servers.");
+TAG_FLAG(raft_commit_quorum_size, experimental);
+
 namespace kudu {
 namespace consensus {
 
@@ -68,6 +80,15 @@ bool IsRaftConfigVoter(const std::string& uuid, const RaftConfigPB& config) {
   return false;
 }
 
+bool IsRaftConfigWitness(const std::string& uuid, const RaftConfigPB& config) {
+  for (const RaftPeerPB& peer : config.peers()) {
+    if (peer.permanent_uuid() == uuid) {
+      return peer.member_type() == RaftPeerPB::VOTER && peer.attrs().witness();
+    }
+  }
+  return false;
+}
+
 bool IsVoterRole(RaftPeerPB::Role role) {
   return role == RaftPeerPB::LEADER || role == RaftPeerPB::FOLLOWER;
 }
@@ -127,6 +148,21 @@ int MajoritySize(int num_voters) {
   return (num_voters / 2) + 1;
 }
 
+int CommitQuorumSize(int num_voters) {
+  DCHECK_GE(num_voters, 1);
+  if (FLAGS_raft_commit_quorum_size <= 0) {
+    return MajoritySize(num_voters);
+  }
+  return std::min(FLAGS_raft_commit_quorum_size, num_voters);
+}
+
+int ElectionQuorumSize(int num_voters) {
+  DCHECK_GE(num_voters, 1);
+  // Election quorums must also intersect each other, so that no two leaders
+  // are elected in the same term.
+  return std::max(MajoritySize(num_voters), num_voters - CommitQuorumSize(num_voters) + 1);
+}
+
 RaftPeerPB::Role GetConsensusRole(const std::string& peer_uuid,
                                   const std::string& leader_uuid,
                                   const RaftConfigPB& config) {
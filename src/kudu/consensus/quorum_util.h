@@ -48,6 +48,10 @@ enum class MajorityHealthPolicy {
 bool IsRaftConfigMember(const std::string& uuid, const RaftConfigPB& config);
 bool IsRaftConfigVoter(const std::string& uuid, const RaftConfigPB& config);
 
+// Whether the specified peer is a witness voter in the config, which only keeps
+// the log. See RaftPeerAttrsPB.
+bool IsRaftConfigWitness(const std::string& uuid, const RaftConfigPB& config);
+
 // Whether the specified Raft role is attributed to a peer which can participate
 // in leader elections.
 bool IsVoterRole(RaftPeerPB::Role role);
@@ -79,6 +83,15 @@ int CountVoters(const RaftConfigPB& config);
 // Calculates size of a configuration majority based on # of voters.
 int MajoritySize(int num_voters);
 
+// The number of voters which must replicate an op to commit it, which is a
+// majority unless --raft_commit_quorum_size is set.
+int CommitQuorumSize(int num_voters);
+
+// The number of votes a candidate needs to be elected: enough for any
+// election quorum to intersect any commit quorum and any other election
+// quorum. A majority unless --raft_commit_quorum_size is set.
+int ElectionQuorumSize(int num_voters);
+
 // Determines the role that the peer with uuid 'peer_uuid' plays in the
 // cluster. If 'peer_uuid' is empty or is not a member of the configuration,
 // this function will return NON_PARTICIPANT, regardless of whether it is
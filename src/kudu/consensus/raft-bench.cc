@@ -0,0 +1,314 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Benchmark for end-to-end Raft replication: stands up an in-process config
+// of RaftConsensus instances, each with its own WAL, and measures the
+// throughput of ops replicated through the leader and the latency from
+// Replicate() to commit.
+//
+// Disk latency may be injected with --log_inject_latency.
+//
+// BenchmarkFollowerUpdate replicates ops which followers start transactions
+// for, and also measures how long the followers' consensus lock is held up by
+// the updates, by timing calls which take it.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gflags/gflags_declare.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/clock/clock.h"
+#include "kudu/clock/logical_clock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/common/wire_protocol-test-util.h"
+#include "kudu/consensus/consensus-test-util.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/consensus_meta_manager.h"
+#include "kudu/consensus/log.h"
+#include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/raft_consensus.h"
+#include "kudu/consensus/time_manager.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(num_replicas, 3, "Number of voters in the Raft config");
+DEFINE_int32(client_threads, 16,
+             "Number of client threads, each of which has a single op being "
+             "replicated at a time");
+DEFINE_int32(op_size_bytes, 1024, "Payload size of each replicated op");
+DEFINE_int32(network_latency_ms, 0,
+             "Latency injected into each request from the leader to a follower");
+DEFINE_int32(run_seconds, 1, "Seconds to run the benchmark");
+
+DECLARE_bool(enable_leader_failure_detection);
+
+METRIC_DECLARE_entity(tablet);
+
+using kudu::log::Log;
+using kudu::log::LogOptions;
+using std::atomic;
+using std::shared_ptr;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace consensus {
+
+static const char* const kTabletId = "raft-bench-tablet";
+
+static void DoNothing(const string& /*reason*/) {
+}
+
+class RaftBench : public KuduTest {
+ public:
+  RaftBench()
+      : clock_(clock::LogicalClock::CreateStartingAt(Timestamp(1))),
+        metric_entity_(METRIC_ENTITY_tablet.Instantiate(&metric_registry_, "raft-bench")),
+        schema_(GetSimpleTestSchema()),
+        // Latencies up to 60 seconds, in microseconds.
+        latency_histogram_(60 * 1000 * 1000, 2),
+        lock_histogram_(60 * 1000 * 1000, 2) {
+  }
+
+  void SetUp() override {
+    KuduTest::SetUp();
+    OverrideFlagForSlowTests("run_seconds", "10");
+    FLAGS_enable_leader_failure_detection = false;
+    ASSERT_OK(ThreadPoolBuilder("raft").Build(&raft_pool_));
+    ASSERT_OK(StartConfig(FLAGS_num_replicas));
+  }
+
+  ~RaftBench() {
+    if (peers_) {
+      peers_->Clear();
+    }
+    STLDeleteElements(&txn_factories_);
+    logs_.clear();
+    STLDeleteElements(&fs_managers_);
+  }
+
+ protected:
+  // Builds and starts a config of 'num' replicas, and elects the first one.
+  Status StartConfig(int num) {
+    RaftConfigPB config;
+    for (int i = 0; i < num; i++) {
+      string path = GetTestPath(Substitute("peer-$0-root", i));
+      FsManagerOpts opts;
+      opts.parent_mem_tracker = MemTracker::CreateTracker(-1, Substitute("peer-$0", i));
+      opts.wal_root = path;
+      opts.data_roots = { path };
+      gscoped_ptr<FsManager> fs_manager(new FsManager(env_, opts));
+      RETURN_NOT_OK(fs_manager->CreateInitialFileSystemLayout());
+      RETURN_NOT_OK(fs_manager->Open());
+      cmeta_managers_.emplace_back(new ConsensusMetadataManager(fs_manager.get()));
+
+      scoped_refptr<Log> log;
+      RETURN_NOT_OK(Log::Open(LogOptions(), fs_manager.get(), kTabletId, schema_,
+                              0, nullptr, &log));
+      logs_.emplace_back(std::move(log));
+
+      RaftPeerPB* peer_pb = config.add_peers();
+      peer_pb->set_member_type(RaftPeerPB::VOTER);
+      peer_pb->set_permanent_uuid(fs_manager->uuid());
+      peer_pb->mutable_last_known_addr()->set_host(Substitute("peer-$0.fake-domain", i));
+      peer_pb->mutable_last_known_addr()->set_port(0);
+      fs_managers_.push_back(fs_manager.release());
+    }
+    config.set_opid_index(kInvalidOpIdIndex);
+    peers_.reset(new TestPeerMapManager(config));
+
+    ConsensusOptions options;
+    options.tablet_id = kTabletId;
+    for (int i = 0; i < num; i++) {
+      RETURN_NOT_OK(cmeta_managers_[i]->Create(kTabletId, config, kMinimumTerm));
+      shared_ptr<RaftConsensus> peer;
+      RETURN_NOT_OK(RaftConsensus::Create(options, config.peers(i), cmeta_managers_[i],
+                                          raft_pool_.get(), &peer));
+      peers_->AddPeer(config.peers(i).permanent_uuid(), peer);
+    }
+
+    for (int i = 0; i < num; i++) {
+      shared_ptr<RaftConsensus> peer;
+      RETURN_NOT_OK(peers_->GetPeerByIdx(i, &peer));
+      gscoped_ptr<LocalTestPeerProxyFactory> proxy_factory(
+          new LocalTestPeerProxyFactory(peers_.get()));
+      proxy_factory->set_latency(MonoDelta::FromMilliseconds(FLAGS_network_latency_ms));
+      scoped_refptr<TimeManager> time_manager(new TimeManager(clock_, Timestamp::kMin));
+      auto txn_factory = new TestTransactionFactory(logs_[i].get());
+      txn_factory->SetConsensus(peer.get());
+      txn_factories_.push_back(txn_factory);
+      RETURN_NOT_OK(peer->Start(ConsensusBootstrapInfo(),
+                                std::move(proxy_factory),
+                                logs_[i],
+                                time_manager,
+                                txn_factory,
+                                metric_entity_,
+                                Bind(&DoNothing)));
+    }
+    RETURN_NOT_OK(peers_->GetPeerByIdx(0, &leader_));
+    return leader_->EmulateElection();
+  }
+
+  // Replicates ops one at a time through the leader until 'stop_' is set,
+  // recording the latency of each.
+  void ClientThread(OperationType op_type) {
+    while (!stop_) {
+      gscoped_ptr<ReplicateMsg> msg(new ReplicateMsg);
+      msg->set_op_type(op_type);
+      msg->mutable_noop_request()->mutable_payload_for_tests()->resize(FLAGS_op_size_bytes);
+      msg->set_timestamp(clock_->Now().ToUint64());
+
+      Synchronizer sync;
+      scoped_refptr<ConsensusRound> round = leader_->NewRound(std::move(msg),
+                                                              sync.AsStdStatusCallback());
+      MonoTime start = MonoTime::Now();
+      CHECK_OK(leader_->Replicate(round.get()));
+      CHECK_OK(sync.Wait());
+      latency_histogram_.Increment((MonoTime::Now() - start).ToMicroseconds());
+      num_ops_++;
+    }
+  }
+
+  // Repeatedly takes the consensus lock of each follower until 'stop_' is set,
+  // recording how long each attempt took.
+  void FollowerLockThread() {
+    vector<shared_ptr<RaftConsensus>> followers;
+    for (int i = 1; i < FLAGS_num_replicas; i++) {
+      shared_ptr<RaftConsensus> peer;
+      CHECK_OK(peers_->GetPeerByIdx(i, &peer));
+      followers.emplace_back(std::move(peer));
+    }
+    while (!stop_) {
+      for (const auto& follower : followers) {
+        MonoTime start = MonoTime::Now();
+        follower->GetLastOpId(RECEIVED_OPID);
+        lock_histogram_.Increment((MonoTime::Now() - start).ToMicroseconds());
+      }
+    }
+  }
+
+  // Runs the client threads, plus 'extra_threads', for --run_seconds.
+  // Returns the elapsed times.
+  CpuTimes Run(OperationType op_type, vector<thread> extra_threads = {}) {
+    vector<thread> threads = std::move(extra_threads);
+    Stopwatch sw(Stopwatch::ALL_THREADS);
+    sw.start();
+    for (int i = 0; i < FLAGS_client_threads; i++) {
+      threads.emplace_back([this, op_type]() { this->ClientThread(op_type); });
+    }
+    SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
+    stop_ = true;
+    for (thread& t : threads) {
+      t.join();
+    }
+    sw.stop();
+    return sw.elapsed();
+  }
+
+  void LogResults(const CpuTimes& elapsed) {
+    LOG(INFO) << "Replicas:         " << FLAGS_num_replicas;
+    LOG(INFO) << "Client threads:   " << FLAGS_client_threads;
+    LOG(INFO) << "Op size:          " << FLAGS_op_size_bytes << " bytes";
+    LOG(INFO) << "Network latency:  " << FLAGS_network_latency_ms << " ms";
+    LOG(INFO) << "----------------------------------";
+    LOG(INFO) << "Ops/sec:          " << num_ops_ / elapsed.wall_seconds();
+    LOG(INFO) << "CPU usec/op:      "
+              << (elapsed.user + elapsed.system) / 1000.0 / std::max<int64_t>(num_ops_, 1);
+    LogHistogram("Commit latency (usec):", latency_histogram_);
+  }
+
+  static void LogHistogram(const string& title, const HdrHistogram& histogram) {
+    LOG(INFO) << title;
+    LOG(INFO) << "  mean:           " << histogram.MeanValue();
+    LOG(INFO) << "  p50:            " << histogram.ValueAtPercentile(50);
+    LOG(INFO) << "  p95:            " << histogram.ValueAtPercentile(95);
+    LOG(INFO) << "  p99:            " << histogram.ValueAtPercentile(99);
+    LOG(INFO) << "  p99.9:          " << histogram.ValueAtPercentile(99.9);
+    LOG(INFO) << "  max:            " << histogram.MaxValue();
+  }
+
+  scoped_refptr<clock::Clock> clock_;
+  MetricRegistry metric_registry_;
+  scoped_refptr<MetricEntity> metric_entity_;
+  const Schema schema_;
+  gscoped_ptr<ThreadPool> raft_pool_;
+
+  vector<FsManager*> fs_managers_;
+  vector<scoped_refptr<ConsensusMetadataManager>> cmeta_managers_;
+  vector<scoped_refptr<Log>> logs_;
+  vector<TestTransactionFactory*> txn_factories_;
+  unique_ptr<TestPeerMapManager> peers_;
+  shared_ptr<RaftConsensus> leader_;
+
+  atomic<bool> stop_{false};
+  atomic<int64_t> num_ops_{0};
+  HdrHistogram latency_histogram_;
+  HdrHistogram lock_histogram_;
+};
+
+TEST_F(RaftBench, BenchmarkReplicate) {
+  CpuTimes elapsed = Run(NO_OP);
+  LogResults(elapsed);
+  ASSERT_GT(num_ops_, 0);
+}
+
+// Followers start a transaction for each WRITE_OP they receive, unlike for
+// the NO_OPs above.
+TEST_F(RaftBench, BenchmarkFollowerUpdate) {
+  if (FLAGS_num_replicas < 2) {
+    LOG(INFO) << "Skipping: needs at least one follower";
+    return;
+  }
+  vector<thread> threads;
+  threads.emplace_back([this]() { this->FollowerLockThread(); });
+  CpuTimes elapsed = Run(WRITE_OP, std::move(threads));
+  LogResults(elapsed);
+  LogHistogram("Follower lock latency (usec):", lock_histogram_);
+  ASSERT_GT(num_ops_, 0);
+}
+
+}  // namespace consensus
+}  // namespace kudu
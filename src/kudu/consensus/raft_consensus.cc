@@ -36,6 +36,8 @@
 
 #include "kudu/common/timestamp.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/consensus/apply_scheduler.h"
+#include "kudu/consensus/change_stream.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/consensus_meta_manager.h"
@@ -46,7 +48,9 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/peer_manager.h"
 #include "kudu/consensus/pending_rounds.h"
+#include "kudu/consensus/phi_accrual_failure_detector.h"
 #include "kudu/consensus/quorum_util.h"
+#include "kudu/consensus/state_machine_snapshot.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/macros.h"
@@ -58,15 +62,19 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/rpc/periodic.h"
+#include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/async_util.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/hdr_histogram.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/process_memory.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread_restrictions.h"
 #include "kudu/util/threadpool.h"
@@ -79,6 +87,35 @@ DEFINE_int32(raft_heartbeat_interval_ms, 500,
              "and consider a leader to have failed if it misses several in a row.");
 TAG_FLAG(raft_heartbeat_interval_ms, advanced);
 
+DEFINE_bool(raft_enable_quiescence, false,
+            "Whether leaders of idle tablets should quiesce: once every follower has "
+            "received and committed all the ops, heartbeat it only every "
+            "--raft_quiescent_heartbeat_interval_ms rather than every "
+            "--raft_heartbeat_interval_ms. Followers of a quiescent leader extend "
+            "their failure detection timeout accordingly, so the failure of a "
+            "quiescent leader takes longer to detect.");
+TAG_FLAG(raft_enable_quiescence, experimental);
+
+DEFINE_int32(raft_quiescent_heartbeat_interval_ms, 5000,
+             "The heartbeat interval of quiescent leaders, with --raft_enable_quiescence. "
+             "Followers of a quiescent leader consider it failed after missing "
+             "--leader_failure_max_missed_heartbeat_periods of these heartbeats.");
+TAG_FLAG(raft_quiescent_heartbeat_interval_ms, experimental);
+
+DEFINE_bool(raft_follower_early_ack, false,
+            "Whether followers should acknowledge the ops they receive before they are "
+            "durable in their WAL, reporting how far their WAL is durable separately. "
+            "The leader sends the next batch right away, but only counts the durable ops "
+            "toward committing them. Only effective with leaders which track it.");
+TAG_FLAG(raft_follower_early_ack, experimental);
+
+DEFINE_bool(raft_enable_leader_leases, false,
+            "Whether leaders may serve linearizable reads locally while they hold a lease. "
+            "A leader holds a lease while a majority of voters accepted one of its requests "
+            "within the last election timeout, adjusted for clock drift: until then, these "
+            "voters don't vote for other candidates.");
+TAG_FLAG(raft_enable_leader_leases, experimental);
+
 DEFINE_double(leader_failure_max_missed_heartbeat_periods, 3.0,
              "Maximum heartbeat periods that the leader can fail to heartbeat in before we "
              "consider the leader to be failed. The total failure timeout in milliseconds is "
@@ -86,6 +123,27 @@ DEFINE_double(leader_failure_max_missed_heartbeat_periods, 3.0,
              "The value passed to this flag may be fractional.");
 TAG_FLAG(leader_failure_max_missed_heartbeat_periods, advanced);
 
+DEFINE_bool(raft_enable_phi_accrual_failure_detection, false,
+            "Whether followers adapt their leader failure timeout to the observed "
+            "distribution of intervals between the leader's heartbeats, suspecting "
+            "the leader once --raft_phi_accrual_threshold is reached rather than "
+            "after a fixed number of missed heartbeat periods. The timeout never "
+            "exceeds the fixed one. With --raft_enable_leader_leases, followers "
+            "still withhold their votes for the fixed timeout.");
+TAG_FLAG(raft_enable_phi_accrual_failure_detection, experimental);
+
+DEFINE_double(raft_phi_accrual_threshold, 8.0,
+              "The suspicion level phi at which a follower considers the leader to "
+              "have failed, with --raft_enable_phi_accrual_failure_detection. The "
+              "chance of wrongly suspecting a live leader is about 10^-phi per "
+              "heartbeat interval.");
+TAG_FLAG(raft_phi_accrual_threshold, experimental);
+
+DEFINE_int32(raft_phi_accrual_window_size, 100,
+             "The number of intervals between leader heartbeats which the "
+             "phi accrual failure detector bases its estimate on.");
+TAG_FLAG(raft_phi_accrual_window_size, experimental);
+
 DEFINE_int32(leader_failure_exp_backoff_max_delta_ms, 20 * 1000,
              "Maximum time to sleep in between leader election retries, in addition to the "
              "regular timeout. When leader election fails the interval in between retries "
@@ -125,6 +183,15 @@ DEFINE_bool(raft_enable_tombstoned_voting, true,
 TAG_FLAG(raft_enable_tombstoned_voting, experimental);
 TAG_FLAG(raft_enable_tombstoned_voting, runtime);
 
+DEFINE_bool(raft_lock_free_vote_checks, true,
+            "Whether running replicas answer pre-election vote requests, and deny "
+            "vote requests which can't succeed, from a snapshot of their term "
+            "and leader status rather than under the replica's locks. This "
+            "keeps voters from serializing on their locks when many tablets "
+            "hold elections at once.");
+TAG_FLAG(raft_lock_free_vote_checks, advanced);
+TAG_FLAG(raft_lock_free_vote_checks, runtime);
+
 // Enable improved re-replication (KUDU-1097).
 DEFINE_bool(raft_prepare_replacement_before_eviction, true,
             "When enabled, failed replicas will only be evicted after a "
@@ -139,6 +206,38 @@ DEFINE_bool(raft_attempt_to_replace_replica_without_majority, false,
             "Warning! This is only intended for testing.");
 TAG_FLAG(raft_attempt_to_replace_replica_without_majority, unsafe);
 
+DEFINE_bool(raft_enable_parallel_apply, false,
+            "Whether committed operations which don't conflict with each other, "
+            "as per the conflict keys supplied by the consensus round handler, "
+            "are applied concurrently on the Raft thread pool rather than one "
+            "after another in index order.");
+TAG_FLAG(raft_enable_parallel_apply, experimental);
+
+DEFINE_int32(raft_admission_control_max_delay_us, 0,
+             "The longest a leader delays each write it admits when it's falling "
+             "behind: when its WAL append queue fills up, group commits take "
+             "longer than --raft_admission_control_target_commit_latency_ms, "
+             "the commit index lags the log by more than half of "
+             "--raft_admission_control_max_uncommitted_ops, or more data than "
+             "--flush_threshold_mb waits to be flushed. The delay grows "
+             "quadratically with the worst of these. 0 disables admission control.");
+TAG_FLAG(raft_admission_control_max_delay_us, experimental);
+TAG_FLAG(raft_admission_control_max_delay_us, runtime);
+
+DEFINE_int32(raft_admission_control_target_commit_latency_ms, 20,
+             "The WAL group commit latency above which a leader starts delaying "
+             "writes. The delay reaches its maximum at four times this latency. "
+             "See --raft_admission_control_max_delay_us.");
+TAG_FLAG(raft_admission_control_target_commit_latency_ms, experimental);
+TAG_FLAG(raft_admission_control_target_commit_latency_ms, runtime);
+
+DEFINE_int32(raft_admission_control_max_uncommitted_ops, 1000,
+             "The number of operations by which the commit index may lag the "
+             "leader's log before writes are delayed the most. Delays start at "
+             "half of it. See --raft_admission_control_max_delay_us.");
+TAG_FLAG(raft_admission_control_max_uncommitted_ops, experimental);
+TAG_FLAG(raft_admission_control_max_uncommitted_ops, runtime);
+
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 
 // Metrics
@@ -164,6 +263,66 @@ METRIC_DEFINE_gauge_int64(tablet, time_since_last_leader_heartbeat,
                           kudu::MetricUnit::kMilliseconds,
                           "The time elapsed since the last heartbeat from the leader "
                           "in milliseconds. This metric is identically zero on a leader replica.");
+METRIC_DEFINE_gauge_int64(tablet, raft_leader_lease_valid,
+                          "Raft Leader Lease Valid",
+                          kudu::MetricUnit::kUnits,
+                          "1 if the replica is a leader holding a valid lease, with "
+                          "--raft_enable_leader_leases, 0 otherwise.");
+METRIC_DEFINE_counter(tablet, raft_leader_lease_misses,
+                      "Raft Leader Lease Misses",
+                      kudu::MetricUnit::kRequests,
+                      "Number of lease checks which found no valid leader lease, so that the "
+                      "read had to fall back to replicating an operation.");
+METRIC_DEFINE_counter(tablet, raft_promotion_throttled_writes,
+                      "Raft Promotion Throttled Writes",
+                      kudu::MetricUnit::kRequests,
+                      "Number of writes whose admission the leader delayed so that a "
+                      "NON_VOTER about to be promoted could catch up.");
+METRIC_DEFINE_counter(tablet, raft_admission_throttled_writes,
+                      "Raft Admission Throttled Writes",
+                      kudu::MetricUnit::kRequests,
+                      "Number of writes whose admission the leader delayed because its "
+                      "WAL, followers or flushes were falling behind.");
+METRIC_DEFINE_counter(tablet, raft_relayed_requests,
+                      "Raft Relayed Requests",
+                      kudu::MetricUnit::kRequests,
+                      "Number of requests from the leader which this replica forwarded to "
+                      "other peers as their relay.");
+METRIC_DEFINE_gauge_int64(tablet, raft_apply_queue_depth,
+                          "Raft Apply Queue Depth",
+                          kudu::MetricUnit::kOperations,
+                          "Number of committed operations waiting to be applied when "
+                          "--raft_enable_parallel_apply is set.");
+METRIC_DEFINE_gauge_double(tablet, raft_leader_failure_suspicion,
+                           "Raft Leader Failure Suspicion",
+                           kudu::MetricUnit::kUnits,
+                           "The suspicion level phi with which a follower considers the "
+                           "leader failed, with --raft_enable_phi_accrual_failure_detection. "
+                           "0 on leaders and while not enough heartbeats have been seen.");
+METRIC_DEFINE_gauge_int64(tablet, raft_quiescent,
+                          "Raft Replica Quiescent",
+                          kudu::MetricUnit::kUnits,
+                          "1 if the replica is quiescent, 0 otherwise. A leader is quiescent "
+                          "when all its followers are caught up and it only sends them "
+                          "infrequent heartbeats; a follower is quiescent when the last "
+                          "heartbeat it accepted came from a quiescent leader. Summed over "
+                          "the tablets of a server, this is the number of quiescent replicas.");
+METRIC_DEFINE_histogram(tablet, raft_replicate_latency, "Raft Replicate Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds a leader spends appending ops to be replicated to its "
+                        "queue, including waiting for the Raft locks.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_follower_prepare_latency, "Raft Follower Prepare Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds a follower spends starting the transactions of the ops "
+                        "of an update request.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, raft_follower_log_wait_latency,
+                        "Raft Follower Log Wait Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds a follower waits for the ops of an update request to "
+                        "be durable in its WAL before responding.",
+                        60000000LU, 2);
 
 
 using boost::optional;
@@ -194,10 +353,18 @@ RaftConsensus::RaftConsensus(
       rng_(GetRandomSeed32()),
       leader_transfer_in_progress_(false),
       withhold_votes_until_(MonoTime::Min()),
+      vote_snapshot_running_(false),
+      vote_snapshot_term_(0),
       last_received_cur_leader_(MinimumOpId()),
+      snapshot_next_offset_(0),
       failed_elections_since_stable_leader_(0),
       shutdown_(false),
-      update_calls_for_tests_(0) {
+      update_calls_for_tests_(0),
+      follower_quiescent_(false),
+      leader_heartbeat_detector_(
+          FLAGS_raft_phi_accrual_window_size,
+          MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms)),
+      admission_delay_us_(0) {
   DCHECK(local_peer_pb_.has_permanent_uuid());
 }
 
@@ -244,10 +411,21 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
   term_metric_ = metric_entity->FindOrCreateGauge(&METRIC_raft_term, CurrentTerm());
   follower_memory_pressure_rejections_ =
       metric_entity->FindOrCreateCounter(&METRIC_follower_memory_pressure_rejections);
+  leader_lease_misses_ = metric_entity->FindOrCreateCounter(&METRIC_raft_leader_lease_misses);
+  promotion_throttled_writes_ =
+      metric_entity->FindOrCreateCounter(&METRIC_raft_promotion_throttled_writes);
+  admission_throttled_writes_ =
+      metric_entity->FindOrCreateCounter(&METRIC_raft_admission_throttled_writes);
+  relayed_requests_ = metric_entity->FindOrCreateCounter(&METRIC_raft_relayed_requests);
+  replicate_latency_ = metric_entity->FindOrCreateHistogram(&METRIC_raft_replicate_latency);
+  follower_prepare_latency_ =
+      metric_entity->FindOrCreateHistogram(&METRIC_raft_follower_prepare_latency);
+  follower_log_wait_latency_ =
+      metric_entity->FindOrCreateHistogram(&METRIC_raft_follower_log_wait_latency);
 
   num_failed_elections_metric_ =
       metric_entity->FindOrCreateGauge(&METRIC_failed_elections_since_stable_leader,
-                                       failed_elections_since_stable_leader_);
+                                       failed_elections_since_stable_leader_.load());
 
   METRIC_time_since_last_leader_heartbeat.InstantiateFunctionGauge(
     metric_entity, Bind(&RaftConsensus::GetMillisSinceLastLeaderHeartbeat, Unretained(this)))
@@ -257,7 +435,8 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
   // PeerManager. Because PeerManager is owned by RaftConsensus, it receives a
   // raw pointer to the token, to emphasize that RaftConsensus is responsible
   // for destroying the token.
-  raft_pool_token_ = raft_pool_->NewToken(ThreadPool::ExecutionMode::CONCURRENT);
+  raft_pool_token_ = raft_pool_->NewTokenForShard(options_.raft_pool_shard,
+                                                 ThreadPool::ExecutionMode::CONCURRENT);
 
   // The message queue that keeps track of which operations need to be replicated
   // where.
@@ -274,7 +453,8 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
       time_manager_,
       local_peer_pb_,
       options_.tablet_id,
-      raft_pool_->NewToken(ThreadPool::ExecutionMode::SERIAL),
+      raft_pool_->NewTokenForShard(options_.raft_pool_shard,
+                                   ThreadPool::ExecutionMode::SERIAL),
       info.last_id,
       info.last_committed_id));
 
@@ -287,7 +467,20 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
                                                        raft_pool_token_.get(),
                                                        log_));
 
-  unique_ptr<PendingRounds> pending(new PendingRounds(LogPrefixThreadSafe(), time_manager_));
+  unique_ptr<ThreadPoolToken> apply_pool_token;
+  unique_ptr<ApplyScheduler> apply_scheduler;
+  if (FLAGS_raft_enable_parallel_apply) {
+    apply_pool_token = raft_pool_->NewTokenForShard(options_.raft_pool_shard,
+                                                    ThreadPool::ExecutionMode::CONCURRENT);
+    apply_scheduler.reset(new ApplyScheduler(
+        LogPrefixThreadSafe(),
+        apply_pool_token.get(),
+        std::bind(&RaftConsensus::GetApplyConflictKeys, this,
+                  std::placeholders::_1, std::placeholders::_2)));
+  }
+
+  unique_ptr<PendingRounds> pending(new PendingRounds(LogPrefixThreadSafe(), time_manager_,
+                                                      apply_scheduler.get()));
 
   // Capture a weak_ptr reference into the functor so it can safely handle
   // outliving the consensus instance.
@@ -320,9 +513,25 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
                                    << State_Name(state_);
 
     queue_ = std::move(queue);
+    queue_->SetSnapshotter(round_handler_->snapshotter());
     peer_manager_ = std::move(peer_manager);
+    apply_pool_token_ = std::move(apply_pool_token);
+    apply_scheduler_ = std::move(apply_scheduler);
     pending_ = std::move(pending);
 
+    METRIC_raft_quiescent.InstantiateFunctionGauge(
+      metric_entity, Bind(&RaftConsensus::GetQuiescentForMetrics, Unretained(this)))
+      ->AutoDetach(&metric_detacher_);
+    METRIC_raft_leader_lease_valid.InstantiateFunctionGauge(
+      metric_entity, Bind(&RaftConsensus::GetLeaderLeaseValidForMetrics, Unretained(this)))
+      ->AutoDetach(&metric_detacher_);
+    METRIC_raft_leader_failure_suspicion.InstantiateFunctionGauge(
+      metric_entity, Bind(&RaftConsensus::GetLeaderFailureSuspicionForMetrics, Unretained(this)))
+      ->AutoDetach(&metric_detacher_);
+    METRIC_raft_apply_queue_depth.InstantiateFunctionGauge(
+      metric_entity, Bind(&RaftConsensus::GetApplyQueueDepthForMetrics, Unretained(this)))
+      ->AutoDetach(&metric_detacher_);
+
     ClearLeaderUnlocked();
 
     // Our last persisted term can be higher than the last persisted operation
@@ -373,6 +582,13 @@ Status RaftConsensus::Start(const ConsensusBootstrapInfo& info,
     // Now assume non-leader replica duties.
     RETURN_NOT_OK(BecomeReplicaUnlocked(fd_initial_delta));
 
+    // Before restarting, this replica may have accepted requests from a leader
+    // whose lease relies on it withholding its vote: keep doing so for an
+    // election timeout.
+    if (FLAGS_raft_enable_leader_leases && CurrentTermUnlocked() > 0) {
+      withhold_votes_until_ = MonoTime::Now() + MinimumElectionTimeout();
+    }
+
     SetStateUnlocked(kRunning);
   }
 
@@ -399,6 +615,7 @@ Status RaftConsensus::EmulateElection() {
                "tablet", options_.tablet_id);
 
   ThreadRestrictions::AssertWaitAllowed();
+  std::lock_guard<simple_spinlock> update_guard(update_lock_);
   LockGuard l(lock_);
   RETURN_NOT_OK(CheckRunningUnlocked());
 
@@ -469,6 +686,11 @@ Status RaftConsensus::StartElection(ElectionMode mode, ElectionReason reason) {
                                   "a non-participant in the Raft config",
                                   SecureShortDebugString(cmeta_->ActiveConfig()));
     }
+    if (PREDICT_FALSE(IsWitnessUnlocked())) {
+      // A witness has no data to serve as the leader.
+      return Status::IllegalState("witnesses cannot start elections",
+          SecureShortDebugString(cmeta_->ActiveConfig()));
+    }
     LOG_WITH_PREFIX_UNLOCKED(INFO)
         << "Starting " << mode_str
         << " (" << ReasonString(reason, GetLeaderUuidUnlocked()) << ")";
@@ -476,7 +698,7 @@ Status RaftConsensus::StartElection(ElectionMode mode, ElectionReason reason) {
     // Snooze to avoid the election timer firing again as much as possible.
     // We do not disable the election timer while running an election, so that
     // if the election times out, we will try again.
-    MonoDelta timeout = LeaderElectionExpBackoffDeltaUnlocked();
+    MonoDelta timeout = LeaderElectionExpBackoffDelta();
     SnoozeFailureDetector(string("starting election"), timeout);
 
     // Increment the term and vote for ourselves, unless it's a pre-election.
@@ -496,7 +718,7 @@ Status RaftConsensus::StartElection(ElectionMode mode, ElectionReason reason) {
 
     // Initialize the VoteCounter.
     int num_voters = CountVoters(active_config);
-    int majority_size = MajoritySize(num_voters);
+    int majority_size = ElectionQuorumSize(num_voters);
     gscoped_ptr<VoteCounter> counter(new VoteCounter(num_voters, majority_size));
 
     // Vote for ourselves.
@@ -602,9 +824,10 @@ Status RaftConsensus::TransferLeadership(const boost::optional<string>& new_lead
       // already checked that we are leader.
       return Status::OK();
     }
-    if (!IsRaftConfigVoter(*new_leader_uuid, cmeta_->ActiveConfig())) {
-      const string msg = Substitute("tablet server $0 is not a voter in the active config",
-                                    *new_leader_uuid);
+    if (!IsRaftConfigVoter(*new_leader_uuid, cmeta_->ActiveConfig()) ||
+        IsRaftConfigWitness(*new_leader_uuid, cmeta_->ActiveConfig())) {
+      const string msg = Substitute("tablet server $0 is not a non-witness voter in the "
+                                    "active config", *new_leader_uuid);
       LOG_WITH_PREFIX_UNLOCKED(INFO) << "Rejecting request to transfer leadership "
                                      << "because " << msg;
       return Status::InvalidArgument(msg);
@@ -668,6 +891,7 @@ Status RaftConsensus::BecomeLeaderUnlocked() {
 
   // Disable FD while we are leader.
   DisableFailureDetector();
+  follower_quiescent_ = false;
 
   // Don't vote for anyone if we're a leader.
   withhold_votes_until_ = MonoTime::Max();
@@ -722,8 +946,74 @@ Status RaftConsensus::BecomeReplicaUnlocked(boost::optional<MonoDelta> fd_delta)
   return Status::OK();
 }
 
-Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
+void RaftConsensus::ThrottleWriteIfNeeded() {
+  MonoDelta delay = queue_->GetAdmissionThrottleDelay();
+  if (PREDICT_FALSE(delay.Initialized())) {
+    promotion_throttled_writes_->Increment();
+    SleepFor(delay);
+  }
 
+  if (FLAGS_raft_admission_control_max_delay_us <= 0) {
+    admission_delay_us_.store(0, std::memory_order_relaxed);
+    return;
+  }
+  RefreshAdmissionDelayIfNeeded();
+  int64_t delay_us = admission_delay_us_.load(std::memory_order_relaxed);
+  if (delay_us > 0) {
+    admission_throttled_writes_->Increment();
+    SleepFor(MonoDelta::FromMicroseconds(delay_us));
+  }
+}
+
+void RaftConsensus::RefreshAdmissionDelayIfNeeded() {
+  // The signals change slowly relative to the rate of writes, so they're
+  // sampled every few milliseconds by whichever writer gets there first.
+  static const MonoDelta kRefreshInterval = MonoDelta::FromMilliseconds(10);
+  std::unique_lock<simple_spinlock> l(admission_lock_, std::try_to_lock);
+  if (!l.owns_lock()) {
+    return;
+  }
+  MonoTime now = MonoTime::Now();
+  if (admission_refreshed_.Initialized() && now - admission_refreshed_ < kRefreshInterval) {
+    return;
+  }
+  admission_refreshed_ = now;
+  double pressure = ComputeWriteBackpressure();
+  admission_delay_us_.store(
+      static_cast<int64_t>(pressure * pressure * FLAGS_raft_admission_control_max_delay_us),
+      std::memory_order_relaxed);
+}
+
+namespace {
+// Maps 'x' linearly from [start, full] onto [0, 1], clamping it outside.
+double Ramp(double x, double start, double full) {
+  return std::min(1.0, std::max(0.0, (x - start) / (full - start)));
+}
+} // anonymous namespace
+
+double RaftConsensus::ComputeWriteBackpressure() {
+  double pressure = Ramp(log_->append_queue_fill(), 0.5, 1);
+
+  int32_t target_ms = FLAGS_raft_admission_control_target_commit_latency_ms;
+  if (target_ms > 0) {
+    double latency_ms = log_->recent_group_commit_latency().ToSeconds() * 1000;
+    pressure = std::max(pressure, Ramp(latency_ms / target_ms, 1, 4));
+  }
+
+  // The lag of the commit index is that of the majority of the followers:
+  // the leader can't commit faster than they acknowledge.
+  int32_t max_ops = FLAGS_raft_admission_control_max_uncommitted_ops;
+  if (max_ops > 0) {
+    int64_t lag = queue_->GetLastOpIdInLog().index() - queue_->GetCommittedIndex();
+    pressure = std::max(pressure, Ramp(static_cast<double>(lag) / max_ops, 0.5, 1));
+  }
+
+  return std::max(pressure, Ramp(round_handler_->GetFlushBacklog(), 1, 2));
+}
+
+Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
+  ThrottleWriteIfNeeded();
+  const MonoTime start = MonoTime::Now();
   std::lock_guard<simple_spinlock> lock(update_lock_);
   {
     ThreadRestrictions::AssertWaitAllowed();
@@ -732,11 +1022,212 @@ Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
     RETURN_NOT_OK(round->CheckBoundTerm(CurrentTermUnlocked()));
     RETURN_NOT_OK(AppendNewRoundToQueueUnlocked(round));
   }
+  replicate_latency_->Increment((MonoTime::Now() - start).ToMicroseconds());
 
   peer_manager_->SignalRequest();
   return Status::OK();
 }
 
+Status RaftConsensus::ReplicateBatch(const vector<scoped_refptr<ConsensusRound>>& rounds) {
+  if (rounds.empty()) {
+    return Status::OK();
+  }
+
+  ThrottleWriteIfNeeded();
+  const MonoTime start = MonoTime::Now();
+  std::lock_guard<simple_spinlock> lock(update_lock_);
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    // Check all the rounds before appending any, so that the batch is
+    // replicated entirely or not at all.
+    for (const scoped_refptr<ConsensusRound>& round : rounds) {
+      RETURN_NOT_OK(CheckSafeToReplicateUnlocked(*round->replicate_msg()));
+      RETURN_NOT_OK(round->CheckBoundTerm(CurrentTermUnlocked()));
+      if (PREDICT_FALSE(round->replicate_msg()->op_type() == CHANGE_CONFIG_OP)) {
+        return Status::InvalidArgument("config changes can't be replicated in a batch");
+      }
+    }
+    RETURN_NOT_OK(AppendNewRoundsToQueueUnlocked(rounds));
+  }
+  replicate_latency_->Increment((MonoTime::Now() - start).ToMicroseconds());
+
+  peer_manager_->SignalRequest();
+  return Status::OK();
+}
+
+Status RaftConsensus::CheckLeaderLease() {
+  if (!FLAGS_raft_enable_leader_leases) {
+    return Status::NotSupported("leader leases are disabled");
+  }
+  Status s = CheckLeaderLeaseInternal();
+  if (PREDICT_FALSE(!s.ok())) {
+    leader_lease_misses_->Increment();
+  }
+  return s;
+}
+
+Status RaftConsensus::CheckLeaderLeaseInternal() const {
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+    RETURN_NOT_OK(CheckActiveLeaderUnlocked());
+  }
+  // Until it commits an op of its own term, a new leader may not know about
+  // all the committed ops.
+  if (!queue_->IsCommittedIndexInCurrentTerm()) {
+    return Status::IllegalState("leader has not committed an operation in its term yet");
+  }
+  MonoTime request_time = queue_->GetMajorityLeaseRequestTime();
+  if (!request_time.Initialized()) {
+    return Status::IllegalState("a majority has not accepted this leader yet");
+  }
+  if (request_time != MonoTime::Max() && MonoTime::Now() >= request_time + LeaderLeaseDuration()) {
+    return Status::IllegalState("leader lease expired");
+  }
+  return Status::OK();
+}
+
+Status RaftConsensus::ReadIndex(const MonoTime& deadline, int64_t* read_index) {
+  RaftPeerPB leader_pb;
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+    if (cmeta_->active_role() != RaftPeerPB::LEADER) {
+      RaftConfigPB config = cmeta_->ActiveConfig();
+      RaftPeerPB* peer_pb;
+      const string& leader_uuid = GetLeaderUuidUnlocked();
+      if (leader_uuid.empty() || !GetRaftConfigMember(&config, leader_uuid, &peer_pb).ok()) {
+        return Status::ServiceUnavailable("no known leader");
+      }
+      leader_pb = *peer_pb;
+    }
+  }
+  if (!leader_pb.has_permanent_uuid()) {
+    return LeaderReadIndex(deadline, read_index);
+  }
+
+  shared_ptr<PeerProxy> proxy;
+  RETURN_NOT_OK(GetProxyToPeer(leader_pb, &proxy));
+  ReadIndexRequestPB req;
+  req.set_dest_uuid(leader_pb.permanent_uuid());
+  req.set_tablet_id(options_.tablet_id);
+  req.set_caller_uuid(peer_uuid());
+  ReadIndexResponsePB resp;
+  rpc::RpcController controller;
+  controller.set_deadline(deadline);
+  CountDownLatch latch(1);
+  proxy->ReadIndexAsync(&req, &resp, &controller, [&latch]() { latch.CountDown(); });
+  latch.Wait();
+  RETURN_NOT_OK_PREPEND(controller.status(), "ReadIndex RPC to the leader failed");
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+
+  RETURN_NOT_OK(queue_->WaitForCommittedIndex(resp.read_index(), deadline));
+  *read_index = resp.read_index();
+  return Status::OK();
+}
+
+Status RaftConsensus::LeaderReadIndex(const MonoTime& deadline, int64_t* read_index) {
+  const MonoTime start = MonoTime::Now();
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+    RETURN_NOT_OK(CheckActiveLeaderUnlocked());
+  }
+  // Until it commits an op of its own term, a new leader may not know about
+  // all the committed ops.
+  if (!queue_->IsCommittedIndexInCurrentTerm()) {
+    return Status::IllegalState("leader has not committed an operation in its term yet");
+  }
+  // This covers every op committed before this call started, as long as no
+  // other leader was elected by then.
+  int64_t index = queue_->GetCommittedIndex();
+  if (!FLAGS_raft_enable_leader_leases || !CheckLeaderLeaseInternal().ok()) {
+    SignalReadIndexHeartbeats(start);
+    RETURN_NOT_OK(queue_->WaitForMajorityLeaseRequestTime(start, deadline));
+  }
+  *read_index = index;
+  return Status::OK();
+}
+
+void RaftConsensus::SignalReadIndexHeartbeats(const MonoTime& time) {
+  {
+    std::lock_guard<simple_spinlock> l(read_index_lock_);
+    if (last_read_index_heartbeats_.Initialized() && last_read_index_heartbeats_ >= time) {
+      return;
+    }
+    last_read_index_heartbeats_ = MonoTime::Now();
+  }
+  peer_manager_->SignalHeartbeats();
+}
+
+Status RaftConsensus::GetProxyToPeer(const RaftPeerPB& peer_pb,
+                                     shared_ptr<PeerProxy>* proxy) {
+  {
+    std::lock_guard<simple_spinlock> l(peer_proxies_lock_);
+    if (FindCopy(peer_proxies_, peer_pb.permanent_uuid(), proxy)) {
+      return Status::OK();
+    }
+  }
+  gscoped_ptr<PeerProxy> new_proxy;
+  RETURN_NOT_OK(peer_proxy_factory_->NewProxy(peer_pb, &new_proxy));
+  std::lock_guard<simple_spinlock> l(peer_proxies_lock_);
+  *proxy = LookupOrInsert(&peer_proxies_, peer_pb.permanent_uuid(),
+                          shared_ptr<PeerProxy>(new_proxy.release()));
+  return Status::OK();
+}
+
+Status RaftConsensus::RelayUpdate(const ConsensusRequestPB* request,
+                                  ConsensusResponsePB* response) {
+  RaftPeerPB dest_pb;
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+    RaftConfigPB config = cmeta_->ActiveConfig();
+    RaftPeerPB* peer_pb;
+    RETURN_NOT_OK_PREPEND(GetRaftConfigMember(&config, request->proxy_dest_uuid(), &peer_pb),
+                          "cannot relay the request");
+    dest_pb = *peer_pb;
+  }
+
+  ConsensusRequestPB forward;
+  forward.CopyFrom(*request);
+  forward.set_dest_uuid(request->proxy_dest_uuid());
+  forward.clear_proxy_dest_uuid();
+  forward.clear_relayed_last_op_id();
+  // The ops remain owned by 'msgs', the request only borrows them.
+  vector<ReplicateRefPtr> msgs;
+  SCOPED_CLEANUP({
+    forward.mutable_ops()->ExtractSubrange(0, forward.ops_size(), nullptr);
+  });
+  if (request->has_relayed_last_op_id()) {
+    RETURN_NOT_OK(queue_->ReadOpsForRelay(request->preceding_id(),
+                                          request->relayed_last_op_id(),
+                                          &msgs));
+    for (const ReplicateRefPtr& msg : msgs) {
+      forward.mutable_ops()->AddAllocated(msg->get());
+    }
+  }
+
+  shared_ptr<PeerProxy> proxy;
+  RETURN_NOT_OK(GetProxyToPeer(dest_pb, &proxy));
+  rpc::RpcController controller;
+  CountDownLatch latch(1);
+  proxy->UpdateAsync(&forward, response, &controller, [&latch]() { latch.CountDown(); });
+  latch.Wait();
+  RETURN_NOT_OK_PREPEND(controller.status(),
+                        Substitute("could not relay the request to $0",
+                                   request->proxy_dest_uuid()));
+  relayed_requests_->Increment();
+  return Status::OK();
+}
+
 Status RaftConsensus::CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRound>& round) {
   ThreadRestrictions::AssertWaitAllowed();
   LockGuard l(lock_);
@@ -758,6 +1249,30 @@ Status RaftConsensus::AppendNewRoundToQueueUnlocked(const scoped_refptr<Consensu
   return Status::OK();
 }
 
+Status RaftConsensus::AppendNewRoundsToQueueUnlocked(
+    const vector<scoped_refptr<ConsensusRound>>& rounds) {
+  DCHECK(lock_.is_locked());
+
+  OpId id = queue_->GetNextOpId();
+  vector<ReplicateRefPtr> msgs;
+  msgs.reserve(rounds.size());
+  for (const scoped_refptr<ConsensusRound>& round : rounds) {
+    DCHECK_NE(CHANGE_CONFIG_OP, round->replicate_msg()->op_type());
+    *round->replicate_msg()->mutable_id() = id;
+    // Only config changes can fail to be added as pending.
+    CHECK_OK(AddPendingOperationUnlocked(round));
+    msgs.push_back(round->replicate_scoped_refptr());
+    id.set_index(id.index() + 1);
+  }
+
+  // See AppendNewRoundToQueueUnlocked() as to why this can't fail.
+  CHECK_OK_PREPEND(queue_->AppendOperations(
+                       msgs, Bind(CrashIfNotOkStatusCB,
+                                  "Enqueued replicate operations failed to write to WAL")),
+                   Substitute("$0: could not append to queue", LogPrefixUnlocked()));
+  return Status::OK();
+}
+
 Status RaftConsensus::AddPendingOperationUnlocked(const scoped_refptr<ConsensusRound>& round) {
   DCHECK(lock_.is_locked());
   DCHECK(pending_);
@@ -994,8 +1509,67 @@ void RaftConsensus::TryStartElectionOnPeerTask(const string& peer_uuid) {
               Substitute("unable to start election on peer $0", peer_uuid));
 }
 
+// Both the update and the log append hold a reference: whichever finishes
+// last calls back the caller of UpdateAsync().
+class RaftConsensus::UpdateCompletion : public RefCountedThreadSafe<UpdateCompletion> {
+ public:
+  UpdateCompletion(StdStatusCallback done, scoped_refptr<Histogram> log_wait_latency)
+      : done_(std::move(done)),
+        log_wait_latency_(std::move(log_wait_latency)),
+        append_start_(MonoTime::Now()),
+        pending_(2) {
+  }
+
+  // Called once the update has returned 'status'.
+  void UpdateFinished(const Status& status) {
+    update_status_ = status;
+    FinishOne();
+  }
+
+  // Called by the log once the ops of the update are durable.
+  void LogAppended(const Status& status) {
+    log_wait_latency_->Increment((MonoTime::Now() - append_start_).ToMicroseconds());
+    log_status_ = status;
+    FinishOne();
+  }
+
+ private:
+  friend class RefCountedThreadSafe<UpdateCompletion>;
+  ~UpdateCompletion() = default;
+
+  void FinishOne() {
+    if (pending_.fetch_sub(1) == 1) {
+      done_(!update_status_.ok() ? update_status_ : log_status_);
+    }
+  }
+
+  const StdStatusCallback done_;
+  const scoped_refptr<Histogram> log_wait_latency_;
+  const MonoTime append_start_;
+  std::atomic<int> pending_;
+  Status update_status_;
+  Status log_status_;
+
+  DISALLOW_COPY_AND_ASSIGN(UpdateCompletion);
+};
+
 Status RaftConsensus::Update(const ConsensusRequestPB* request,
                              ConsensusResponsePB* response) {
+  return DoUpdate(request, response, nullptr);
+}
+
+void RaftConsensus::UpdateAsync(const ConsensusRequestPB* request,
+                                ConsensusResponsePB* response,
+                                StdStatusCallback done) {
+  Status s = DoUpdate(request, response, &done);
+  if (done) {
+    done(s);
+  }
+}
+
+Status RaftConsensus::DoUpdate(const ConsensusRequestPB* request,
+                               ConsensusResponsePB* response,
+                               StdStatusCallback* done) {
   update_calls_for_tests_.Increment();
 
   if (PREDICT_FALSE(FLAGS_follower_reject_update_consensus_requests)) {
@@ -1003,23 +1577,133 @@ Status RaftConsensus::Update(const ConsensusRequestPB* request,
                                 "is set to true.");
   }
 
+  if (request->has_proxy_dest_uuid()) {
+    return RelayUpdate(request, response);
+  }
+
   response->set_responder_uuid(peer_uuid());
 
   VLOG_WITH_PREFIX(2) << "Replica received request: " << SecureShortDebugString(*request);
 
-  // see var declaration
-  std::lock_guard<simple_spinlock> lock(update_lock_);
-  Status s = UpdateReplica(request, response);
-  if (PREDICT_FALSE(VLOG_IS_ON(1))) {
-    if (request->ops().empty()) {
-      VLOG_WITH_PREFIX(1) << "Replica replied to status only request. Replica: "
-                          << ToString() << ". Response: "
-                          << SecureShortDebugString(*response);
+  scoped_refptr<UpdateCompletion> completion;
+  Status s;
+  {
+    // see var declaration
+    std::lock_guard<simple_spinlock> lock(update_lock_);
+    s = UpdateReplica(request, response, done, &completion);
+    if (PREDICT_FALSE(VLOG_IS_ON(1))) {
+      if (request->ops().empty()) {
+        VLOG_WITH_PREFIX(1) << "Replica replied to status only request. Replica: "
+                            << ToString() << ". Response: "
+                            << SecureShortDebugString(*response);
+      }
     }
   }
+  if (completion) {
+    completion->UpdateFinished(s);
+    return Status::OK();
+  }
   return s;
 }
 
+Status RaftConsensus::InstallSnapshot(const InstallSnapshotRequestPB* request,
+                                      InstallSnapshotResponsePB* response) {
+  TRACE_EVENT2("consensus", "RaftConsensus::InstallSnapshot",
+               "peer", peer_uuid(),
+               "tablet", options_.tablet_id);
+  response->set_responder_uuid(peer_uuid());
+
+  // The snapshot replaces the ops the replica received so far, so it must not
+  // be installed concurrently with an update. See 'update_lock_'.
+  std::lock_guard<simple_spinlock> update_guard(update_lock_);
+  StateMachineSnapshotter* snapshotter = round_handler_->snapshotter();
+  const OpId& last_included = request->last_included_op_id();
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+    if (PREDICT_FALSE(request->caller_term() < CurrentTermUnlocked())) {
+      string msg = Substitute("Rejecting snapshot from peer $0 for earlier term $1. "
+                              "Current term is $2",
+                              request->caller_uuid(),
+                              request->caller_term(),
+                              CurrentTermUnlocked());
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << msg;
+      response->set_responder_term(CurrentTermUnlocked());
+      ConsensusStatusPB* status = response->mutable_status();
+      *status->mutable_last_received() = queue_->GetLastOpIdInLog();
+      status->mutable_error()->set_code(ConsensusErrorPB::INVALID_TERM);
+      StatusToPB(Status::IllegalState(msg), status->mutable_error()->mutable_status());
+      return Status::OK();
+    }
+    if (request->caller_term() > CurrentTermUnlocked()) {
+      RETURN_NOT_OK(HandleTermAdvanceUnlocked(request->caller_term()));
+    }
+    response->set_responder_term(CurrentTermUnlocked());
+    if (PREDICT_FALSE(!HasLeaderUnlocked())) {
+      SetLeaderUuidUnlocked(request->caller_uuid());
+    }
+
+    // The leader is alive, even though it isn't sending updates meanwhile.
+    SnoozeFailureDetector(boost::none, LeaderFailureTimeout());
+
+    if (PREDICT_FALSE(snapshotter == nullptr)) {
+      return Status::NotSupported("state machine doesn't support snapshots");
+    }
+    if (last_included.index() <= pending_->GetCommittedIndex()) {
+      // Nothing to install: the leader may just send the ops which follow.
+      snapshot_writer_.reset();
+      response->set_done(true);
+      return Status::OK();
+    }
+  }
+
+  if (request->offset() == 0) {
+    snapshot_writer_.reset();
+    RETURN_NOT_OK_PREPEND(snapshotter->InstallSnapshot(last_included, &snapshot_writer_),
+                          "Unable to start installing snapshot");
+    snapshot_last_included_ = last_included;
+    snapshot_next_offset_ = 0;
+    LOG_WITH_PREFIX(INFO) << "Installing snapshot through " << OpIdToString(last_included)
+                          << " from peer " << request->caller_uuid();
+  } else if (PREDICT_FALSE(!snapshot_writer_ ||
+                           !OpIdEquals(snapshot_last_included_, last_included) ||
+                           request->offset() != snapshot_next_offset_)) {
+    snapshot_writer_.reset();
+    return Status::IllegalState(Substitute("Unexpected snapshot chunk at offset $0",
+                                           request->offset()));
+  }
+
+  Status s = snapshot_writer_->Write(request->data());
+  if (s.ok()) {
+    snapshot_next_offset_ += request->data().size();
+    if (request->done()) {
+      s = snapshot_writer_->Finish();
+    }
+  }
+  if (PREDICT_FALSE(!s.ok()) || request->done()) {
+    snapshot_writer_.reset();
+  }
+  RETURN_NOT_OK_PREPEND(s, "Unable to install snapshot");
+  if (!request->done()) {
+    return Status::OK();
+  }
+
+  // The state machine now includes all the ops through the snapshot: resume
+  // replication from the op which follows it.
+  ThreadRestrictions::AssertWaitAllowed();
+  LockGuard l(lock_);
+  RETURN_NOT_OK(CheckRunningUnlocked());
+  pending_->ResetAfterSnapshot(last_included);
+  queue_->ResetAfterSnapshot(last_included);
+  last_received_cur_leader_ = last_included;
+  queue_->UpdateFollowerWatermarks(last_included.index(), last_included.index());
+  LOG_WITH_PREFIX_UNLOCKED(INFO) << "Installed snapshot through "
+                                 << OpIdToString(last_included);
+  response->set_done(true);
+  return Status::OK();
+}
+
 // Helper function to check if the op is a non-Transaction op.
 static bool IsConsensusOnlyOperation(OperationType op_type) {
   return op_type == NO_OP || op_type == CHANGE_CONFIG_OP;
@@ -1032,17 +1716,37 @@ Status RaftConsensus::StartFollowerTransactionUnlocked(const ReplicateRefPtr& ms
     return StartConsensusOnlyRoundUnlocked(msg);
   }
 
+  if (IsWitnessUnlocked()) {
+    if (PREDICT_FALSE(FLAGS_follower_fail_all_prepare)) {
+      return Status::IllegalState("Rejected: --follower_fail_all_prepare "
+                                  "is set to true.");
+    }
+    // A witness only keeps the op in its log: the round just tracks the op
+    // until it is committed or aborted.
+    VLOG_WITH_PREFIX_UNLOCKED(1) << "Witnessing op: " << SecureShortDebugString(msg->get()->id());
+    scoped_refptr<ConsensusRound> round(new ConsensusRound(this, msg));
+    round->SetConsensusReplicatedCallback(&DoNothingStatusCB);
+    return AddPendingOperationUnlocked(round);
+  }
+
+  scoped_refptr<ConsensusRound> round;
+  RETURN_NOT_OK(StartFollowerTransaction(msg, &round));
+  return AddPendingOperationUnlocked(round);
+}
+
+Status RaftConsensus::StartFollowerTransaction(const ReplicateRefPtr& msg,
+                                               scoped_refptr<ConsensusRound>* round) {
+  DCHECK(!IsConsensusOnlyOperation(msg->get()->op_type()));
+
   if (PREDICT_FALSE(FLAGS_follower_fail_all_prepare)) {
     return Status::IllegalState("Rejected: --follower_fail_all_prepare "
                                 "is set to true.");
   }
 
-  VLOG_WITH_PREFIX_UNLOCKED(1) << "Starting transaction: "
-                               << SecureShortDebugString(msg->get()->id());
-  scoped_refptr<ConsensusRound> round(new ConsensusRound(this, msg));
-  ConsensusRound* round_ptr = round.get();
-  RETURN_NOT_OK(round_handler_->StartFollowerTransaction(round));
-  return AddPendingOperationUnlocked(round_ptr);
+  VLOG(1) << LogPrefixThreadSafe() << "Starting transaction: "
+          << SecureShortDebugString(msg->get()->id());
+  round->reset(new ConsensusRound(this, msg));
+  return round_handler_->StartFollowerTransaction(*round);
 }
 
 bool RaftConsensus::IsSingleVoterConfig() const {
@@ -1077,49 +1781,46 @@ void RaftConsensus::DeduplicateLeaderRequestUnlocked(ConsensusRequestPB* rpc_req
   // The leader's preceding id.
   deduplicated_req->preceding_opid = &rpc_req->preceding_id();
 
-  int64_t dedup_up_to_index = queue_->GetLastOpIdInLog().index();
-
-  deduplicated_req->first_message_idx = -1;
-
-  // In this loop we discard duplicates and advance the leader's preceding id
-  // accordingly.
-  for (int i = 0; i < rpc_req->ops_size(); i++) {
-    ReplicateMsg* leader_msg = rpc_req->mutable_ops(i);
-
-    if (leader_msg->id().index() <= last_committed_index) {
-      VLOG_WITH_PREFIX_UNLOCKED(2) << "Skipping op id " << leader_msg->id()
-                                   << " (already committed)";
-      deduplicated_req->preceding_opid = &leader_msg->id();
-      continue;
-    }
-
-    if (leader_msg->id().index() <= dedup_up_to_index) {
-      // If the index is uncommitted and below our match index, then it must be in the
-      // pendings set.
-      scoped_refptr<ConsensusRound> round =
-          pending_->GetPendingOpByIndexOrNull(leader_msg->id().index());
-      DCHECK(round) << "Could not find op with index " << leader_msg->id().index()
-                    << " in pending set. committed= " << last_committed_index
-                    << " dedup=" << dedup_up_to_index;
-
-      // If the OpIds match, i.e. if they have the same term and id, then this is just
-      // duplicate, we skip...
-      if (OpIdEquals(round->replicate_msg()->id(), leader_msg->id())) {
-        VLOG_WITH_PREFIX_UNLOCKED(2) << "Skipping op id " << leader_msg->id()
-                                     << " (already replicated)";
-        deduplicated_req->preceding_opid = &leader_msg->id();
-        continue;
-      }
+  const int64_t dedup_up_to_index = queue_->GetLastOpIdInLog().index();
 
-      // ... otherwise we must adjust our match index, i.e. all messages from now on
-      // are "new"
-      dedup_up_to_index = leader_msg->id().index();
-    }
+  // Discard the ops which we already committed.
+  const int num_ops = rpc_req->ops_size();
+  int first_new = 0;
+  while (first_new < num_ops &&
+         rpc_req->ops(first_new).id().index() <= last_committed_index) {
+    first_new++;
+  }
 
-    if (deduplicated_req->first_message_idx == - 1) {
-      deduplicated_req->first_message_idx = i;
+  // The uncommitted ops up to our last received one are either duplicates of
+  // ops we have pending, or replace them. By the Log Matching Property, if one
+  // of them matches the op we have pending at its index then so do all the
+  // earlier ones, so the duplicates are a prefix, which we binary search for.
+  int end_received = first_new;
+  while (end_received < num_ops &&
+         rpc_req->ops(end_received).id().index() <= dedup_up_to_index) {
+    end_received++;
+  }
+  while (first_new < end_received) {
+    int mid = first_new + (end_received - first_new) / 2;
+    if (pending_->IsOpPending(rpc_req->ops(mid).id())) {
+      first_new = mid + 1;
+    } else {
+      end_received = mid;
     }
-    deduplicated_req->messages.push_back(make_scoped_refptr_replicate(leader_msg));
+  }
+
+  // Advance the leader's preceding id past the discarded ops.
+  if (first_new > 0) {
+    VLOG_WITH_PREFIX_UNLOCKED(2) << "Skipping op ids " << rpc_req->ops(0).id() << " through "
+                                 << rpc_req->ops(first_new - 1).id()
+                                 << " (already committed or replicated)";
+    deduplicated_req->preceding_opid = &rpc_req->ops(first_new - 1).id();
+  }
+
+  deduplicated_req->first_message_idx = first_new < num_ops ? first_new : -1;
+  deduplicated_req->messages.reserve(num_ops - first_new);
+  for (int i = first_new; i < num_ops; i++) {
+    deduplicated_req->messages.push_back(make_scoped_refptr_replicate(rpc_req->mutable_ops(i)));
   }
 
   if (deduplicated_req->messages.size() != rpc_req->ops_size()) {
@@ -1241,8 +1942,10 @@ Status RaftConsensus::CheckLeaderRequestUnlocked(const ConsensusRequestPB* reque
   // We only release the messages from the request after the above check so that
   // that we can print the original request, if it fails.
   if (!deduped_req->messages.empty()) {
-    // We take ownership of the deduped ops.
+    // We take ownership of the deduped ops, which arena-allocated ops would
+    // not allow.
     DCHECK_GE(deduped_req->first_message_idx, 0);
+    DCHECK(mutable_req->GetArena() == nullptr);
     mutable_req->mutable_ops()->ExtractSubrange(
         deduped_req->first_message_idx,
         deduped_req->messages.size(),
@@ -1295,12 +1998,22 @@ Status RaftConsensus::CheckLeaderRequestUnlocked(const ConsensusRequestPB* reque
 }
 
 Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
-                                    ConsensusResponsePB* response) {
+                                    ConsensusResponsePB* response,
+                                    StdStatusCallback* done,
+                                    scoped_refptr<UpdateCompletion>* completion) {
   TRACE_EVENT2("consensus", "RaftConsensus::UpdateReplica",
                "peer", peer_uuid(),
                "tablet", options_.tablet_id);
+  // With early acks the response doesn't wait for the ops to be durable, so
+  // the log append must not call back into this frame.
+  const bool early_ack = FLAGS_raft_follower_early_ack &&
+      request->leader_tracks_durable_idx();
+  // Asynchronous updates don't wait for the ops to be durable either: the
+  // log append completes them instead.
+  const bool deferred = !early_ack && done && *done;
   Synchronizer log_synchronizer;
-  StatusCallback sync_status_cb = log_synchronizer.AsStatusCallback();
+  StatusCallback sync_status_cb = early_ack ? Bind(&DoNothingStatusCB) :
+      log_synchronizer.AsStatusCallback();
 
 
   // The ordering of the following operations is crucial, read on for details.
@@ -1384,6 +2097,10 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
   // Before replying to the leader we wait for the writes to be durable. We then
   // just update the last replicated watermark and respond.
   //
+  // With --raft_follower_early_ack we reply right away instead, reporting how
+  // far our log is durable separately. A request without new ops is only
+  // answered once all the ops are durable: this is how a leader learns that.
+  //
   // TODO - These failure scenarios need to be exercised in an unit
   //        test. Moreover we need to add more fault injection spots (well that
   //        and actually use the) for each of these steps.
@@ -1393,6 +2110,8 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
   // The deduplicated request.
   LeaderRequest deduped_req;
   auto& messages = deduped_req.messages;
+  int64_t term;
+  bool start_outside_lock;
   {
     ThreadRestrictions::AssertWaitAllowed();
     LockGuard l(lock_);
@@ -1412,8 +2131,18 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
 
     // Snooze the failure detector as soon as we decide to accept the message.
     // We are guaranteed to be acting as a FOLLOWER at this point by the above
-    // sanity check.
-    SnoozeFailureDetector();
+    // sanity check. A quiescent leader won't heartbeat again for a while, so
+    // give it correspondingly longer.
+    follower_quiescent_ = request->quiescent();
+    if (request->quiescent()) {
+      // The intervals to and between quiescent heartbeats say nothing about
+      // the regular ones.
+      leader_heartbeat_detector_.Reset();
+      SnoozeFailureDetector(boost::none, QuiescentElectionTimeout());
+    } else {
+      leader_heartbeat_detector_.Heartbeat(MonoTime::Now());
+      SnoozeFailureDetector(boost::none, LeaderFailureTimeout());
+    }
 
     last_leader_communication_time_micros_ = GetMonoTimeMicros();
 
@@ -1431,8 +2160,11 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
     // metrics get updated even when the operation is rejected.
     queue_->UpdateLastIndexAppendedToLeader(request->last_idx_appended_to_leader());
 
-    // Also prohibit voting for anyone for the minimum election timeout.
-    withhold_votes_until_ = MonoTime::Now() + MinimumElectionTimeout();
+    // Also prohibit voting for anyone for the minimum election timeout. Leases
+    // rely on this lasting the full timeout; otherwise withhold votes only for
+    // as long as we wouldn't suspect the leader ourselves.
+    withhold_votes_until_ = MonoTime::Now() + (FLAGS_raft_enable_leader_leases ?
+        MinimumElectionTimeout() : LeaderFailureTimeout());
 
     // 1 - Early commit pending (and committed) transactions
 
@@ -1478,18 +2210,93 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
       }
     }
 
-    Status prepare_status;
-    auto iter = messages.begin();
-    while (iter != messages.end()) {
-      prepare_status = StartFollowerTransactionUnlocked(*iter);
+    term = CurrentTermUnlocked();
+    start_outside_lock = !IsWitnessUnlocked();
+  }
+
+  // Starting a transaction decodes the op and registers it with the
+  // transaction tracker, which is too much to do while holding 'lock_'. So the
+  // leading run of ops which need a transaction are started without it, and
+  // only added to the pending ops once we've made sure under 'lock_' that the
+  // term didn't change meanwhile. 'update_lock_', which the caller holds, keeps
+  // other updates, and this replica becoming leader, from appending to the log
+  // or touching the pending ops until we're done.
+  const MonoTime prepare_start = MonoTime::Now();
+  Status prepare_status;
+  vector<scoped_refptr<ConsensusRound>> started_rounds;
+  if (start_outside_lock) {
+    started_rounds.reserve(messages.size());
+    for (const auto& msg : messages) {
+      if (IsConsensusOnlyOperation(msg->get()->op_type())) {
+        break;
+      }
+      scoped_refptr<ConsensusRound> round;
+      prepare_status = StartFollowerTransaction(msg, &round);
       if (PREDICT_FALSE(!prepare_status.ok())) {
         break;
       }
-      // TODO(dralves) Without leader leases this shouldn't be allowed to fail.
-      // Once we have that functionality we'll have to revisit this.
-      CHECK_OK(time_manager_->MessageReceivedFromLeader(*(*iter)->get()));
+      started_rounds.emplace_back(std::move(round));
+    }
+  }
+
+  OpId last_from_leader;
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    Status s = CheckRunningUnlocked();
+    if (PREDICT_FALSE(!s.ok() || CurrentTermUnlocked() != term)) {
+      for (const auto& round : started_rounds) {
+        round->NotifyReplicationFinished(Status::Aborted(
+            "Transaction started by a follower update which was superseded"));
+      }
+      RETURN_NOT_OK(s);
+      string msg = Substitute("Rejecting Update request from peer $0 for term $1. "
+                              "Term changed to $2 while starting transactions",
+                              request->caller_uuid(),
+                              request->caller_term(),
+                              CurrentTermUnlocked());
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << msg;
+      FillConsensusResponseError(response, ConsensusErrorPB::INVALID_TERM,
+                                 Status::IllegalState(msg));
+      FillConsensusResponseOKUnlocked(response);
+      return Status::OK();
+    }
+
+    vector<const ReplicateMsg*> prepared_msgs;
+    prepared_msgs.reserve(messages.size());
+    auto iter = messages.begin();
+    size_t num_added = 0;
+    for (; num_added < started_rounds.size(); num_added++) {
+      Status add_status = AddPendingOperationUnlocked(started_rounds[num_added]);
+      if (PREDICT_FALSE(!add_status.ok())) {
+        prepare_status = add_status;
+        break;
+      }
+      prepared_msgs.push_back((*iter)->get());
       ++iter;
     }
+    for (size_t i = num_added; i < started_rounds.size(); i++) {
+      started_rounds[i]->NotifyReplicationFinished(prepare_status);
+    }
+    // The rest of the ops, starting at the first one which needs no
+    // transaction or with all of them on a witness, are started under the lock.
+    if (prepare_status.ok()) {
+      while (iter != messages.end()) {
+        prepare_status = StartFollowerTransactionUnlocked(*iter);
+        if (PREDICT_FALSE(!prepare_status.ok())) {
+          break;
+        }
+        prepared_msgs.push_back((*iter)->get());
+        ++iter;
+      }
+    }
+    // TODO(dralves) Without leader leases this shouldn't be allowed to fail.
+    // Once we have that functionality we'll have to revisit this.
+    CHECK_OK(time_manager_->MessagesReceivedFromLeader(prepared_msgs));
+    if (!messages.empty()) {
+      follower_prepare_latency_->Increment((MonoTime::Now() - prepare_start).ToMicroseconds());
+    }
+    const bool all_prepared = iter == messages.end();
 
     // If we stopped before reaching the end we failed to prepare some message(s) and need
     // to perform cleanup, namely trimming deduped_req.messages to only contain the messages
@@ -1521,28 +2328,47 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
     }
 
     // All transactions that are going to be prepared were started, advance the safe timestamp.
-    // TODO(dralves) This is only correct because the queue only sets safe time when the request is
-    // an empty heartbeat. If we actually start setting this on a consensus request along with
-    // actual messages we need to be careful to ignore it if any of the messages fails to prepare.
-    if (request->has_safe_timestamp()) {
+    // The leader may set safe time on a request along with messages, which
+    // only holds if all of them were prepared: the ones which failed to will
+    // be sent again.
+    if (request->has_safe_timestamp() && all_prepared) {
       time_manager_->AdvanceSafeTime(Timestamp(request->safe_timestamp()));
     }
 
-    OpId last_from_leader;
-    // 3 - Enqueue the writes.
-    // Now that we've triggered the prepares enqueue the operations to be written
-    // to the WAL.
-    if (PREDICT_TRUE(!messages.empty())) {
-      last_from_leader = messages.back()->get()->id();
-      // Trigger the log append asap, if fsync() is on this might take a while
-      // and we can't reply until this is done.
-      //
-      // Since we've prepared, we need to be able to append (or we risk trying to apply
-      // later something that wasn't logged). We crash if we can't.
-      CHECK_OK(queue_->AppendOperations(messages, sync_status_cb));
-    } else {
-      last_from_leader = *deduped_req.preceding_opid;
+    last_from_leader = messages.empty() ? *deduped_req.preceding_opid :
+        messages.back()->get()->id();
+  }
+
+  // 3 - Enqueue the writes.
+  // Now that we've triggered the prepares enqueue the operations to be written
+  // to the WAL. This may block if the log is backed up, so it's done without
+  // 'lock_': 'update_lock_' already orders the appends.
+  if (PREDICT_TRUE(!messages.empty())) {
+    // Trigger the log append asap, if fsync() is on this might take a while
+    // and we can't reply until this is done.
+    //
+    // Since we've prepared, we need to be able to append (or we risk trying to apply
+    // later something that wasn't logged). We crash if we can't, unless we
+    // were stopped meanwhile, which aborts the pending transactions anyway.
+    if (deferred) {
+      StdStatusCallback update_done;
+      update_done.swap(*done);
+      completion->reset(new UpdateCompletion(std::move(update_done),
+                                             follower_log_wait_latency_));
+      sync_status_cb = Bind(&UpdateCompletion::LogAppended, *completion);
     }
+    Status s = queue_->AppendOperations(messages, sync_status_cb);
+    if (PREDICT_FALSE(!s.ok())) {
+      CHECK(!IsRunning()) << LogPrefixThreadSafe() << "Could not append to the log: "
+                          << s.ToString();
+      return s;
+    }
+  }
+
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
 
     // 4 - Mark transactions as committed
 
@@ -1579,7 +2405,22 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
   // We'll re-acquire it before we update the state again.
 
   // Update the last replicated op id
-  if (!messages.empty()) {
+  if (early_ack) {
+    if (messages.empty() && queue_->GetLastDurableIndex() < queue_->GetLastOpIdInLog().index()) {
+      TRACE("Waiting for the earlier replicates to finish logging");
+      SnoozeFailureDetector();
+      RETURN_NOT_OK(log_->WaitUntilAllFlushed());
+    }
+    response->mutable_status()->set_last_durable_idx(queue_->GetLastDurableIndex());
+  } else if (deferred) {
+    // The response acknowledges the last op in the log, which may have been
+    // appended by an earlier update still waiting for it to be durable.
+    if (messages.empty() && queue_->GetLastDurableIndex() < queue_->GetLastOpIdInLog().index()) {
+      TRACE("Waiting for the earlier replicates to finish logging");
+      SnoozeFailureDetector();
+      RETURN_NOT_OK(log_->WaitUntilAllFlushed());
+    }
+  } else if (!messages.empty()) {
 
     // 5 - We wait for the writes to be durable.
 
@@ -1587,6 +2428,7 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
     // request at a time and this way we can allow commits to proceed while we wait.
     TRACE("Waiting on the replicates to finish logging");
     TRACE_EVENT0("consensus", "Wait for log");
+    const MonoTime wait_start = MonoTime::Now();
     Status s;
     do {
       s = log_synchronizer.WaitFor(
@@ -1598,6 +2440,7 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
       }
     } while (s.IsTimedOut());
     RETURN_NOT_OK(s);
+    follower_log_wait_latency_->Increment((MonoTime::Now() - wait_start).ToMicroseconds());
 
     TRACE("finished");
   }
@@ -1619,6 +2462,9 @@ void RaftConsensus::FillConsensusResponseOKUnlocked(ConsensusResponsePB* respons
       last_received_cur_leader_);
   response->mutable_status()->set_last_committed_idx(
       queue_->GetCommittedIndex());
+  if (FLAGS_raft_follower_early_ack) {
+    response->mutable_status()->set_last_durable_idx(queue_->GetLastDurableIndex());
+  }
 }
 
 void RaftConsensus::FillConsensusResponseError(ConsensusResponsePB* response,
@@ -1637,6 +2483,10 @@ Status RaftConsensus::RequestVote(const VoteRequestPB* request,
                "tablet", options_.tablet_id);
   response->set_responder_uuid(peer_uuid());
 
+  if (FLAGS_raft_lock_free_vote_checks && RequestVoteLockFree(request, response)) {
+    return Status::OK();
+  }
+
   // We must acquire the update lock in order to ensure that this vote action
   // takes place between requests.
   // Lock ordering: update_lock_ must be acquired before lock_.
@@ -2170,6 +3020,10 @@ void RaftConsensus::Stop() {
     LOG_WITH_PREFIX_UNLOCKED(INFO) << "Raft consensus is shut down!";
   }
 
+  // Let the rounds which were already committed finish applying.
+  if (apply_scheduler_) apply_scheduler_->Drain();
+  if (apply_pool_token_) apply_pool_token_->Shutdown();
+
   // Shut down things that might acquire locks during destruction.
   if (raft_pool_token_) raft_pool_token_->Shutdown();
   if (failure_detector_) DisableFailureDetector();
@@ -2329,7 +3183,7 @@ Status RaftConsensus::RequestVoteRespondVoteGranted(const VoteRequestPB* request
   // We know our vote will be "yes", so avoid triggering an election while we
   // persist our vote to disk. We use an exponential backoff to avoid too much
   // split-vote contention when nodes display high latencies.
-  MonoDelta backoff = LeaderElectionExpBackoffDeltaUnlocked();
+  MonoDelta backoff = LeaderElectionExpBackoffDelta();
   SnoozeFailureDetector(string("vote granted"), backoff);
 
   if (!request->is_pre_election()) {
@@ -2350,6 +3204,90 @@ Status RaftConsensus::RequestVoteRespondVoteGranted(const VoteRequestPB* request
   return Status::OK();
 }
 
+bool RaftConsensus::RequestVoteLockFree(const VoteRequestPB* request,
+                                        VoteResponsePB* response) {
+  // Tombstoned replicas vote based on the last-logged OpId they're given, so
+  // they always take the locks.
+  if (!vote_snapshot_running_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  // The term only ever increases, and votes are withheld for as long as the
+  // snapshot says, give or take a concurrent update: the answers below are
+  // those the locked path would give, or a denial the candidate retries.
+  int64_t term = vote_snapshot_term_.load(std::memory_order_acquire);
+  ConsensusErrorPB::Code denial;
+  string reason;
+  if (request->candidate_term() < term) {
+    denial = ConsensusErrorPB::INVALID_TERM;
+    reason = Substitute("for earlier term $0. Current term is $1.",
+                        request->candidate_term(), term);
+  } else if (!request->ignore_live_leader() && MonoTime::Now() < withhold_votes_until_) {
+    denial = ConsensusErrorPB::LEADER_IS_ALIVE;
+    reason = Substitute("for term $0 because replica is either leader or believes a valid "
+                        "leader to be alive.", request->candidate_term());
+  } else if (!request->is_pre_election() || request->candidate_term() == term) {
+    // Real votes change the term and are persisted, and whether we voted in
+    // the current term is only known under the lock.
+    return false;
+  } else {
+    // A pre-vote for a later term.
+    OpId local_last_logged_opid = queue_->GetLastOpIdInLog();
+    if (OpIdLessThan(request->candidate_status().last_received(), local_last_logged_opid)) {
+      denial = ConsensusErrorPB::LAST_OPID_TOO_OLD;
+      reason = Substitute("for term $0 because replica has last-logged OpId of $1, which is "
+                          "greater than that of the candidate, which has last-logged OpId "
+                          "of $2.",
+                          request->candidate_term(),
+                          SecureShortDebugString(local_last_logged_opid),
+                          SecureShortDebugString(request->candidate_status().last_received()));
+    } else {
+      // Hold off our own election while the candidate runs its real one,
+      // backing off as RequestVoteRespondVoteGranted() does.
+      SnoozeFailureDetector(string("pre-vote granted"), LeaderElectionExpBackoffDelta());
+      response->set_responder_term(term);
+      response->set_vote_granted(true);
+      LOG(INFO) << Substitute("$0Leader pre-election vote request: Granting yes vote for "
+                              "candidate $1 in term $2.",
+                              LogPrefixThreadSafe(), request->candidate_uuid(), term);
+      return true;
+    }
+  }
+
+  response->set_responder_term(term);
+  response->set_vote_granted(false);
+  response->mutable_consensus_error()->set_code(denial);
+  string msg = Substitute("$0Leader $1election vote request: Denying vote to candidate $2 $3",
+                          LogPrefixThreadSafe(),
+                          request->is_pre_election() ? "pre-" : "",
+                          request->candidate_uuid(),
+                          reason);
+  LOG(INFO) << msg;
+  StatusToPB(Status::InvalidArgument(msg), response->mutable_consensus_error()->mutable_status());
+  return true;
+}
+
+Status RaftConsensus::NewChangeStream(
+    int64_t after_index,
+    const scoped_refptr<log::LogAnchorRegistry>& log_anchor_registry,
+    unique_ptr<ChangeStream>* stream) {
+  {
+    ThreadRestrictions::AssertWaitAllowed();
+    LockGuard l(lock_);
+    RETURN_NOT_OK(CheckRunningUnlocked());
+  }
+  if (PREDICT_FALSE(after_index < 0)) {
+    return Status::InvalidArgument(Substitute("invalid op index $0", after_index));
+  }
+  stream->reset(new ChangeStream(shared_from_this(), log_anchor_registry, after_index));
+  return Status::OK();
+}
+
+Status RaftConsensus::ReadCommittedOps(int64_t after_index,
+                                       int max_bytes,
+                                       vector<ReplicateRefPtr>* ops) {
+  return queue_->ReadCommittedOps(after_index, max_bytes, ops);
+}
+
 RaftPeerPB::Role RaftConsensus::role() const {
   ThreadRestrictions::AssertWaitAllowed();
   LockGuard l(lock_);
@@ -2383,6 +3321,10 @@ void RaftConsensus::SetStateUnlocked(State new_state) {
       break;
   }
   state_ = new_state;
+  if (new_state == kRunning) {
+    vote_snapshot_term_.store(CurrentTermUnlocked(), std::memory_order_release);
+  }
+  vote_snapshot_running_.store(new_state == kRunning, std::memory_order_release);
 }
 
 const char* RaftConsensus::State_Name(State state) {
@@ -2409,6 +3351,7 @@ void RaftConsensus::SetLeaderUuidUnlocked(const string& uuid) {
   DCHECK(lock_.is_locked());
   failed_elections_since_stable_leader_ = 0;
   num_failed_elections_metric_->set_value(failed_elections_since_stable_leader_);
+  leader_heartbeat_detector_.Reset();
   cmeta_->set_leader_uuid(uuid);
   MarkDirty(Substitute("New leader $0", uuid));
 }
@@ -2503,6 +3446,20 @@ RaftConfigPB RaftConsensus::CommittedConfig() const {
   return cmeta_->CommittedConfig();
 }
 
+namespace {
+
+// Writes a row of the latency breakdown table for the stage 'stage', timed by 'hist'.
+void LatencyHistogramToHtml(const string& stage, const Histogram& hist, std::ostream& out) {
+  std::unique_ptr<HdrHistogram> h = hist.Snapshot();
+  out << Substitute("  <tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td>"
+                    "<td>$5</td></tr>",
+                    EscapeForHtmlToString(stage), h->TotalCount(),
+                    h->ValueAtPercentile(50), h->ValueAtPercentile(99),
+                    h->ValueAtPercentile(99.9), h->MaxValue()) << std::endl;
+}
+
+} // anonymous namespace
+
 void RaftConsensus::DumpStatusHtml(std::ostream& out) const {
   RaftPeerPB::Role role;
   {
@@ -2530,6 +3487,26 @@ void RaftConsensus::DumpStatusHtml(std::ostream& out) const {
     out << "<h2>Queue details</h2>" << std::endl;
     queue_->DumpToHtml(out);
   }
+
+  // The stages a replicated op goes through, in order. The op stages are only
+  // timed by leaders, the follower stages only by followers.
+  const PeerMessageQueue::Metrics& queue_metrics = queue_->metrics();
+  out << "<h2>Latency breakdown (microseconds)</h2>" << std::endl;
+  out << "<table>" << std::endl;
+  out << "  <tr><th>Stage</th><th>Count</th><th>p50</th><th>p99</th><th>p99.9</th>"
+      << "<th>Max</th></tr>" << std::endl;
+  LatencyHistogramToHtml("Leader: append to queue", *replicate_latency_, out);
+  LatencyHistogramToHtml("Leader: op durable in local WAL",
+                         *queue_metrics.op_local_append_latency, out);
+  LatencyHistogramToHtml("Leader: update RPC round trip", *queue_metrics.peer_rpc_latency, out);
+  LatencyHistogramToHtml("Follower: prepare ops", *follower_prepare_latency_, out);
+  LatencyHistogramToHtml("Follower: wait for WAL", *follower_log_wait_latency_, out);
+  LatencyHistogramToHtml("Leader: response queued for Raft pool",
+                         *queue_metrics.peer_response_queue_latency, out);
+  LatencyHistogramToHtml("Leader: op majority replicated",
+                         *queue_metrics.op_majority_replicated_latency, out);
+  LatencyHistogramToHtml("Leader: op committed", *queue_metrics.op_commit_latency, out);
+  out << "</table>" << std::endl;
 }
 
 void RaftConsensus::ElectionCallback(ElectionReason reason, const ElectionResult& result) {
@@ -2550,6 +3527,12 @@ void RaftConsensus::DoElectionCallback(ElectionReason reason, const ElectionResu
 
   // The vote was granted, become leader.
   ThreadRestrictions::AssertWaitAllowed();
+  // Becoming leader appends to the log, which must not race with a follower
+  // update. See 'update_lock_'.
+  std::unique_lock<simple_spinlock> update_guard(update_lock_, std::defer_lock);
+  if (!was_pre_election && result.decision == VOTE_GRANTED) {
+    update_guard.lock();
+  }
   UniqueLock lock(lock_);
   Status s = CheckRunningUnlocked();
   if (PREDICT_FALSE(!s.ok())) {
@@ -2565,7 +3548,7 @@ void RaftConsensus::DoElectionCallback(ElectionReason reason, const ElectionResu
   // - When we lose or otherwise we can fall into a cycle, where everyone keeps
   //   triggering elections but no election ever completes because by the time they
   //   finish another one is triggered already.
-  SnoozeFailureDetector(string("election complete"), LeaderElectionExpBackoffDeltaUnlocked());
+  SnoozeFailureDetector(string("election complete"), LeaderElectionExpBackoffDelta());
 
   if (result.decision == VOTE_DENIED) {
     failed_elections_since_stable_leader_++;
@@ -2679,6 +3662,11 @@ boost::optional<OpId> RaftConsensus::GetLastOpIdUnlocked(OpIdType type) {
 }
 
 log::RetentionIndexes RaftConsensus::GetRetentionIndexes() {
+  // A witness never becomes leader, so it never catches up other peers.
+  if (IsWitness()) {
+    int64_t committed_index = queue_->GetCommittedIndex();
+    return log::RetentionIndexes(committed_index, committed_index);
+  }
   // Grab the watermarks from the queue. It's OK to fetch these two watermarks
   // separately -- the worst case is we see a relatively "out of date" watermark
   // which just means we'll retain slightly more than necessary in this invocation
@@ -2687,6 +3675,17 @@ log::RetentionIndexes RaftConsensus::GetRetentionIndexes() {
                                queue_->GetAllReplicatedIndex()); // for peers
 }
 
+bool RaftConsensus::IsWitness() const {
+  ThreadRestrictions::AssertWaitAllowed();
+  LockGuard l(lock_);
+  return IsWitnessUnlocked();
+}
+
+bool RaftConsensus::IsWitnessUnlocked() const {
+  DCHECK(lock_.is_locked());
+  return IsRaftConfigWitness(peer_uuid(), cmeta_->ActiveConfig());
+}
+
 void RaftConsensus::MarkDirty(const std::string& reason) {
   WARN_NOT_OK(raft_pool_token_->SubmitClosure(Bind(mark_dirty_clbk_, reason)),
               LogPrefixThreadSafe() + "Unable to run MarkDirty callback");
@@ -2817,7 +3816,8 @@ void RaftConsensus::UpdateFailureDetectorState(boost::optional<MonoDelta> delta)
   DCHECK(lock_.is_locked());
   const auto& uuid = peer_uuid();
   if (uuid != cmeta_->leader_uuid() &&
-      cmeta_->IsVoterInConfig(uuid, ACTIVE_CONFIG)) {
+      cmeta_->IsVoterInConfig(uuid, ACTIVE_CONFIG) &&
+      !IsWitnessUnlocked()) {
     // A voter that is not the leader should run the failure detector.
     EnableFailureDetector(std::move(delta));
   } else {
@@ -2850,11 +3850,39 @@ MonoDelta RaftConsensus::MinimumElectionTimeout() const {
   return MonoDelta::FromMilliseconds(failure_timeout);
 }
 
-MonoDelta RaftConsensus::LeaderElectionExpBackoffDeltaUnlocked() {
-  DCHECK(lock_.is_locked());
+MonoDelta RaftConsensus::LeaderFailureTimeout() const {
+  MonoDelta timeout = MinimumElectionTimeout();
+  MonoDelta suspicion_time;
+  if (FLAGS_raft_enable_phi_accrual_failure_detection &&
+      leader_heartbeat_detector_.TimeToSuspicion(FLAGS_raft_phi_accrual_threshold,
+                                                 &suspicion_time)) {
+    // Never suspect the leader before it could even have heartbeated.
+    timeout = std::min(timeout, std::max(
+        suspicion_time, MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms)));
+  }
+  return timeout;
+}
+
+MonoDelta RaftConsensus::LeaderLeaseDuration() const {
+  // Followers withhold their votes for the minimum election timeout after
+  // accepting a request, as measured by their own clocks: leave room for both
+  // our clock and theirs drifting at the maximum rate.
+  double max_drift = 2 * time_manager_->MaxClockDriftPpm() / 1000000.0;
+  return MonoDelta::FromNanoseconds(
+      MinimumElectionTimeout().ToNanoseconds() * std::max(0.0, 1 - max_drift));
+}
+
+MonoDelta RaftConsensus::QuiescentElectionTimeout() const {
+  int32_t failure_timeout = FLAGS_leader_failure_max_missed_heartbeat_periods *
+      FLAGS_raft_quiescent_heartbeat_interval_ms;
+  return MonoDelta::FromMilliseconds(failure_timeout);
+}
+
+MonoDelta RaftConsensus::LeaderElectionExpBackoffDelta() {
   // Compute a backoff factor based on how many leader elections have
   // failed since a stable leader was last seen.
-  double backoff_factor = pow(1.5, failed_elections_since_stable_leader_ + 1);
+  double backoff_factor = pow(
+      1.5, failed_elections_since_stable_leader_.load(std::memory_order_relaxed) + 1);
   double min_timeout = MinimumElectionTimeout().ToMilliseconds();
   double max_timeout = std::min<double>(
       min_timeout * backoff_factor,
@@ -3008,6 +4036,7 @@ Status RaftConsensus::SetCurrentTermUnlocked(int64_t new_term,
   }
   cmeta_->set_current_term(new_term);
   cmeta_->clear_voted_for();
+  vote_snapshot_term_.store(new_term, std::memory_order_release);
   if (flush == FLUSH_TO_DISK) {
     CHECK_OK(cmeta_->Flush());
   }
@@ -3108,6 +4137,34 @@ int64_t RaftConsensus::GetMillisSinceLastLeaderHeartbeat() const {
         0 : (GetMonoTimeMicros() - last_leader_communication_time_micros_) / 1000;
 }
 
+int64_t RaftConsensus::GetLeaderLeaseValidForMetrics() const {
+  return FLAGS_raft_enable_leader_leases && CheckLeaderLeaseInternal().ok() ? 1 : 0;
+}
+
+double RaftConsensus::GetLeaderFailureSuspicionForMetrics() const {
+  if (!FLAGS_raft_enable_phi_accrual_failure_detection || follower_quiescent_) {
+    return 0;
+  }
+  return leader_heartbeat_detector_.Phi(MonoTime::Now());
+}
+
+int64_t RaftConsensus::GetApplyQueueDepthForMetrics() const {
+  return apply_scheduler_ ? apply_scheduler_->QueueDepth() : 0;
+}
+
+bool RaftConsensus::GetApplyConflictKeys(ConsensusRound* round, vector<uint64_t>* keys) {
+  // Config changes and the like update the consensus state, so they are
+  // ordered with respect to everything else.
+  if (IsConsensusOnlyOperation(round->replicate_msg()->op_type())) {
+    return false;
+  }
+  return round_handler_->GetApplyConflictKeys(round, keys);
+}
+
+int64_t RaftConsensus::GetQuiescentForMetrics() const {
+  return follower_quiescent_ || queue_->IsQuiescent() ? 1 : 0;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // ConsensusBootstrapInfo
 ////////////////////////////////////////////////////////////////////////
@@ -23,6 +23,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -36,6 +37,7 @@
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid.pb.h"
+#include "kudu/consensus/phi_accrual_failure_detector.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/consensus/time_manager.h"
 #include "kudu/gutil/callback.h"
@@ -68,19 +70,34 @@ namespace rpc {
 class PeriodicTimer;
 }
 
+namespace log {
+class LogAnchorRegistry;
+}
+
 namespace consensus {
 
+class ChangeStream;
 class ConsensusMetadataManager;
 class ConsensusRound;
+class ApplyScheduler;
 class ConsensusRoundHandler;
 class PeerManager;
+class PeerProxy;
 class PeerProxyFactory;
 class PendingRounds;
+class StateMachineSnapshotWriter;
+class StateMachineSnapshotter;
 struct ConsensusBootstrapInfo;
 struct ElectionResult;
 
 struct ConsensusOptions {
+  ConsensusOptions() : raft_pool_shard(-1) {}
+
   std::string tablet_id;
+
+  // The shard of the raft pool the tokens of the replica are placed in, e.g.
+  // that of its NUMA node, or -1 to let the pool pick one for each token.
+  int raft_pool_shard;
 };
 
 struct TabletVotingState {
@@ -243,8 +260,28 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   //     commit index, which tells them to apply the operation.
   //
   // This method can only be called on the leader, i.e. role() == LEADER
+  //
+  // The caller may be briefly delayed while a NON_VOTER about to be promoted
+  // catches up, or while the leader's WAL, followers or flushes fall behind.
+  // See --raft_promotion_throttle_max_lag_ops and
+  // --raft_admission_control_max_delay_us.
   Status Replicate(const scoped_refptr<ConsensusRound>& round);
 
+  // Like Replicate(), but for many rounds at once: the rounds are assigned
+  // consecutive indexes in order, appended to the queue together, and the
+  // peers are signaled once. Either all the rounds are replicated or, if an
+  // error is returned, none of them are.
+  //
+  // Config changes can't be part of a batch: they must go through Replicate().
+  Status ReplicateBatch(const std::vector<scoped_refptr<ConsensusRound>>& rounds);
+
+  // Returns for how long, in microseconds, the leader currently delays each
+  // write it admits because of backpressure, or 0 if it doesn't. Clients may
+  // use it to pace their writes. See --raft_admission_control_max_delay_us.
+  int64_t admission_delay_us() const {
+    return admission_delay_us_.load(std::memory_order_relaxed);
+  }
+
   // Ensures that the consensus implementation is currently acting as LEADER,
   // and thus is allowed to submit operations to be prepared before they are
   // replicated. To avoid a time-of-check-to-time-of-use (TOCTOU) race, the
@@ -253,6 +290,31 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // that the term has not changed in the meantime.
   Status CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRound>& round);
 
+  // Returns OK if this replica is the leader and holds a leader lease. No
+  // other replica can then have been elected leader, so linearizable reads
+  // may be served locally once the ops up to the committed index are applied.
+  //
+  // Otherwise returns a bad status and counts a lease miss: the caller must
+  // fall back to replicating an operation before serving the read. Returns
+  // NotSupported if --raft_enable_leader_leases is off.
+  Status CheckLeaderLease();
+
+  // Returns in 'read_index' an index such that, once this replica applied all
+  // the ops up to it, linearizable reads may be served from its local state.
+  //
+  // A leader returns its committed index once it confirmed it was still the
+  // leader when this call started. A follower asks the leader for its read
+  // index with the ReadIndex RPC, then waits until it committed that index
+  // itself: applying the ops is left to the caller. Returns TimedOut once
+  // 'deadline' passes.
+  Status ReadIndex(const MonoTime& deadline, int64_t* read_index);
+
+  // The leader side of ReadIndex(), which serves the ReadIndex RPC. A lease
+  // confirms the leadership right away, as per CheckLeaderLease(). Otherwise,
+  // a majority must accept requests sent after this call started: concurrent
+  // calls share them.
+  Status LeaderReadIndex(const MonoTime& deadline, int64_t* read_index);
+
   // Messages sent from LEADER to FOLLOWERS and LEARNERS to update their
   // state machines. This is equivalent to "AppendEntries()" in Raft
   // terminology.
@@ -280,6 +342,28 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   Status Update(const ConsensusRequestPB* request,
                 ConsensusResponsePB* response);
 
+  // Like Update(), but rather than blocking until the ops of the request are
+  // durable in the log, returns once they're appended and calls 'done' with
+  // the Status Update() would have returned once they're durable, from the
+  // thread completing the log append. 'done' may also be called before
+  // returning, e.g. if the request carries no ops. The request isn't accessed
+  // after returning, but 'response' is until 'done' is called.
+  void UpdateAsync(const ConsensusRequestPB* request,
+                   ConsensusResponsePB* response,
+                   StdStatusCallback done);
+
+  // Installs a chunk of a snapshot of the leader's state machine, which the
+  // leader sends once the ops needed to catch up this replica are no longer
+  // in its log. Once the last chunk is installed, the replica resumes
+  // replication from the op following the snapshot.
+  //
+  // Like Update(), returns OK if the response has been filled, with an
+  // INVALID_TERM error if the caller's term is stale. Returns a bad Status if
+  // the chunk doesn't follow the previous one or can't be installed, in
+  // which case the leader starts over.
+  Status InstallSnapshot(const InstallSnapshotRequestPB* request,
+                         InstallSnapshotResponsePB* response);
+
   // Messages sent from CANDIDATEs to voting peers to request their vote
   // in leader election.
   //
@@ -309,6 +393,13 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // Returns boost::none if RaftConsensus was not properly initialized.
   boost::optional<OpId> GetLastOpId(OpIdType type);
 
+  // Subscribes to the committed ops following 'after_index' in '*stream'.
+  // 'log_anchor_registry' is the registry of the tablet's log, through which
+  // the stream retains the ops it hasn't delivered yet. See ChangeStream.
+  Status NewChangeStream(int64_t after_index,
+                         const scoped_refptr<log::LogAnchorRegistry>& log_anchor_registry,
+                         std::unique_ptr<ChangeStream>* stream);
+
   // Returns the current Raft role of this instance.
   RaftPeerPB::Role role() const;
 
@@ -385,11 +476,34 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // GCing these before the peer has caught up.
   log::RetentionIndexes GetRetentionIndexes();
 
+  // Whether this replica is a witness in the active config: it then keeps the
+  // ops in its log without applying them, and never becomes the leader. The
+  // log may be GCed up to the committed index. See RaftPeerAttrsPB.
+  bool IsWitness() const;
+
   // Return the on-disk size of the consensus metadata, in bytes.
   int64_t MetadataOnDiskSize() const;
 
   int64_t GetMillisSinceLastLeaderHeartbeat() const;
 
+  // Returns 1 if the replica is a quiescent leader or the follower of one,
+  // 0 otherwise. See --raft_enable_quiescence.
+  int64_t GetQuiescentForMetrics() const;
+
+  // Returns 1 if the replica holds a leader lease, 0 otherwise.
+  int64_t GetLeaderLeaseValidForMetrics() const;
+
+  // Returns the suspicion level that the leader failed. See
+  // --raft_enable_phi_accrual_failure_detection.
+  double GetLeaderFailureSuspicionForMetrics() const;
+
+  // Returns the number of committed rounds waiting to be applied, with
+  // --raft_enable_parallel_apply.
+  int64_t GetApplyQueueDepthForMetrics() const;
+
+  // The conflict keys of 'round' for the ApplyScheduler.
+  bool GetApplyConflictKeys(ConsensusRound* round, std::vector<uint64_t>* keys);
+
  protected:
   RaftConsensus(ConsensusOptions options,
                 RaftPeerPB local_peer_pb,
@@ -403,6 +517,9 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   FRIEND_TEST(RaftConsensusQuorumTest, TestLeaderElectionWithQuiescedQuorum);
   FRIEND_TEST(RaftConsensusQuorumTest, TestReplicasEnforceTheLogMatchingProperty);
   FRIEND_TEST(RaftConsensusQuorumTest, TestRequestVote);
+  FRIEND_TEST(RaftConsensusQuorumTest, TestReadIndex);
+  FRIEND_TEST(RaftConsensusQuorumTest, TestRelayReplication);
+  FRIEND_TEST(RaftConsensusQuorumTest, TestWitness);
 
   // RaftConsensus lifecycle states.
   //
@@ -502,12 +619,28 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // 'lock_' must be held for configuration change before calling.
   Status BecomeReplicaUnlocked(boost::optional<MonoDelta> fd_delta = boost::none);
 
+  // Joins the end of an asynchronous update with the durability of its ops.
+  // See UpdateAsync().
+  class UpdateCompletion;
+
+  // Implements Update() and, if 'done' is set, UpdateAsync(). If the update
+  // is deferred until its ops are durable, 'done' is taken and left empty.
+  Status DoUpdate(const ConsensusRequestPB* request,
+                  ConsensusResponsePB* response,
+                  StdStatusCallback* done);
+
   // Updates the state in a replica by storing the received operations in the log
   // and triggering the required transactions. This method won't return until all
   // operations have been stored in the log and all Prepares() have been completed,
   // and a replica cannot accept any more Update() requests until this is done.
+  //
+  // If 'done' is set and ops were appended, rather than waiting for them to be
+  // durable, '*completion' is set to track them, taking 'done'. The caller
+  // must then call UpdateFinished() on it with the returned Status.
   Status UpdateReplica(const ConsensusRequestPB* request,
-                       ConsensusResponsePB* response);
+                       ConsensusResponsePB* response,
+                       StdStatusCallback* done = nullptr,
+                       scoped_refptr<UpdateCompletion>* completion = nullptr);
 
   // Deduplicates an RPC request making sure that we get only messages that we
   // haven't appended to our log yet.
@@ -550,9 +683,20 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // that uses transactions, delegates to StartConsensusOnlyRoundUnlocked().
   Status StartFollowerTransactionUnlocked(const ReplicateRefPtr& msg);
 
+  // Creates a round for 'msg', which must use transactions, and starts its
+  // replica transaction, without adding it to the pending ops.
+  //
+  // Doesn't require 'lock_', so that the follower update path can start
+  // transactions without holding it. See UpdateReplica().
+  Status StartFollowerTransaction(const ReplicateRefPtr& msg,
+                                  scoped_refptr<ConsensusRound>* round);
+
   // Returns true if this node is the only voter in the Raft configuration.
   bool IsSingleVoterConfig() const;
 
+  // See IsWitness().
+  bool IsWitnessUnlocked() const;
+
   // Return header string for RequestVote log messages. 'lock_' must be held.
   std::string GetRequestVoteLogPrefixUnlocked(const VoteRequestPB& request) const;
 
@@ -605,6 +749,18 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   Status RequestVoteRespondVoteGranted(const VoteRequestPB* request,
                                        VoteResponsePB* response);
 
+  // Reads committed ops for a ChangeStream. See
+  // PeerMessageQueue::ReadCommittedOps().
+  Status ReadCommittedOps(int64_t after_index, int max_bytes, std::vector<ReplicateRefPtr>* ops);
+  friend class ChangeStream;
+
+  // Answer VoteRequest without taking 'update_lock_' or 'lock_' if it's a
+  // pre-vote, or if the vote would be denied anyway, based on the snapshot
+  // in 'vote_snapshot_running_', 'vote_snapshot_term_' and
+  // 'withhold_votes_until_'. Returns false if the request must go through the
+  // locked path. See --raft_lock_free_vote_checks.
+  bool RequestVoteLockFree(const VoteRequestPB* request, VoteResponsePB* response);
+
   // Callback for leader election driver. ElectionCallback is run on the
   // reactor thread, so it simply defers its work to DoElectionCallback.
   void ElectionCallback(ElectionReason reason, const ElectionResult& result);
@@ -652,13 +808,62 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // jitter, election timeouts may be longer than this.
   MonoDelta MinimumElectionTimeout() const;
 
+  // Return how long a follower waits to hear from the leader before calling an
+  // election. This is the minimum election timeout, or less with
+  // --raft_enable_phi_accrual_failure_detection if the leader's heartbeats
+  // have been regular enough.
+  MonoDelta LeaderFailureTimeout() const;
+
+  // Return the election timeout granted to a quiescent leader, which only
+  // heartbeats every --raft_quiescent_heartbeat_interval_ms.
+  MonoDelta QuiescentElectionTimeout() const;
+
+  // Return for how long after a majority of the voters accepted one of its
+  // requests a leader holds a lease.
+  MonoDelta LeaderLeaseDuration() const;
+
+  // Like CheckLeaderLease(), without checking the flag or counting misses.
+  Status CheckLeaderLeaseInternal() const;
+
+  // Delays the caller for a little while if the queue throttles writes so
+  // that a NON_VOTER about to be promoted may catch up, or if the leader is
+  // falling behind with its writes.
+  void ThrottleWriteIfNeeded();
+
+  // Recomputes admission_delay_us_ from ComputeWriteBackpressure(), unless
+  // it was recomputed in the last few milliseconds.
+  void RefreshAdmissionDelayIfNeeded();
+
+  // Returns how close the leader is to falling behind with writes, between 0
+  // and 1, from the fill of the WAL append queue, the latency of group
+  // commits, how far the commit index lags the log, and the flush backlog of
+  // the round handler.
+  double ComputeWriteBackpressure();
+
+  // Signals heartbeats to all the peers, unless some were already signaled at
+  // or after 'time'.
+  void SignalReadIndexHeartbeats(const MonoTime& time);
+
+  // Returns in 'proxy' a proxy to 'peer_pb', for the requests this replica
+  // sends outside of the PeerManager: ReadIndex() on followers, and the
+  // requests forwarded by RelayUpdate().
+  Status GetProxyToPeer(const RaftPeerPB& peer_pb, std::shared_ptr<PeerProxy>* proxy);
+
+  // Forwards a request from the leader to the peer it is addressed to, as the
+  // relay of that peer: see ConsensusRequestPB.proxy_dest_uuid. 'response' is
+  // the response of the peer.
+  Status RelayUpdate(const ConsensusRequestPB* request, ConsensusResponsePB* response);
+
   // Calculates a snooze delta for leader election.
   //
   // The delta increases exponentially with the difference between the current
   // term and the term of the last committed operation.
   //
   // The maximum delta is capped by 'FLAGS_leader_failure_exp_backoff_max_delta_ms'.
-  MonoDelta LeaderElectionExpBackoffDeltaUnlocked();
+  //
+  // Doesn't require 'lock_', so that RequestVoteLockFree() backs off like
+  // the locked path does.
+  MonoDelta LeaderElectionExpBackoffDelta();
 
   // Handle when the term has advanced beyond the current term.
   //
@@ -724,6 +929,10 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // As a leader, append a new ConsensusRound to the queue.
   Status AppendNewRoundToQueueUnlocked(const scoped_refptr<ConsensusRound>& round);
 
+  // Like the above, for the rounds of ReplicateBatch(). None of them may be a
+  // config change.
+  Status AppendNewRoundsToQueueUnlocked(const std::vector<scoped_refptr<ConsensusRound>>& rounds);
+
   // As a follower, start a consensus round not associated with a Transaction.
   Status StartConsensusOnlyRoundUnlocked(const ReplicateRefPtr& msg);
 
@@ -816,6 +1025,9 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // TODO(dralves) hack to serialize updates due to repeated/out-of-order messages
   // should probably be refactored out.
   //
+  // Follower updates append to the log without holding 'lock_', so becoming
+  // leader, which appends to the log too, must also take 'update_lock_'.
+  //
   // Lock ordering note: If both 'update_lock_' and 'lock_' are to be taken,
   // 'update_lock_' lock must be taken first.
   mutable simple_spinlock update_lock_;
@@ -845,12 +1057,17 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
   // The queue of messages that must be sent to peers.
   std::unique_ptr<PeerMessageQueue> queue_;
 
+  // With --raft_enable_parallel_apply, notifies committed rounds on
+  // 'apply_pool_token_'. Set in Start().
+  std::unique_ptr<ThreadPoolToken> apply_pool_token_;
+  std::unique_ptr<ApplyScheduler> apply_scheduler_;
+
   // The currently pending rounds that have not yet been committed by
   // consensus. Protected by 'lock_'.
   // TODO(todd) these locks will become more fine-grained.
   std::unique_ptr<PendingRounds> pending_;
 
-  Random rng_;
+  ThreadSafeRandom rng_;
 
   std::shared_ptr<rpc::PeriodicTimer> failure_detector_;
 
@@ -876,18 +1093,32 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
 
   // If any RequestVote() RPC arrives before this timestamp,
   // the request will be ignored. This prevents abandoned or partitioned
-  // nodes from disturbing the healthy leader.
-  MonoTime withhold_votes_until_;
+  // nodes from disturbing the healthy leader. Written under 'lock_', but read
+  // without it by RequestVoteLockFree().
+  std::atomic<MonoTime> withhold_votes_until_;
+
+  // Whether the replica is running, and its current term, as of the last
+  // change under 'lock_'. Read by RequestVoteLockFree().
+  std::atomic<bool> vote_snapshot_running_;
+  std::atomic<int64_t> vote_snapshot_term_;
 
   // The last OpId received from the current leader. This is updated whenever the follower
   // accepts operations from a leader, and passed back so that the leader knows from what
   // point to continue sending operations.
   OpId last_received_cur_leader_;
 
+  // The snapshot being installed by InstallSnapshot(), the op it includes
+  // ops through, and the offset of the next chunk of it. Protected by
+  // 'update_lock_'.
+  std::unique_ptr<StateMachineSnapshotWriter> snapshot_writer_;
+  OpId snapshot_last_included_;
+  int64_t snapshot_next_offset_;
+
   // The number of times this node has called and lost a leader election since
   // the last time it saw a stable leader (either itself or another node).
-  // This is used to calculate back-off of the election timeout.
-  int64_t failed_elections_since_stable_leader_;
+  // This is used to calculate back-off of the election timeout. Written
+  // under 'lock_', but read without it by LeaderElectionExpBackoffDelta().
+  std::atomic<int64_t> failed_elections_since_stable_leader_;
 
   Callback<void(const std::string& reason)> mark_dirty_clbk_;
 
@@ -903,7 +1134,37 @@ class RaftConsensus : public std::enable_shared_from_this<RaftConsensus>,
 
   std::atomic<int64_t> last_leader_communication_time_micros_;
 
+  // Whether the last request accepted from the leader was a quiescent
+  // heartbeat.
+  std::atomic<bool> follower_quiescent_;
+
+  // Tracks the heartbeats from the leader to adapt the leader failure timeout.
+  // See --raft_enable_phi_accrual_failure_detection.
+  PhiAccrualFailureDetector leader_heartbeat_detector_;
+
+  // Protects 'last_read_index_heartbeats_'.
+  simple_spinlock read_index_lock_;
+  // When heartbeats were last signaled by LeaderReadIndex().
+  MonoTime last_read_index_heartbeats_;
+
+  simple_spinlock admission_lock_;
+  // When admission_delay_us_ was last recomputed.
+  MonoTime admission_refreshed_;
+  // The delay applied to each write admitted by the leader.
+  std::atomic<int64_t> admission_delay_us_;
+
+  // The proxies returned by GetProxyToPeer(), keyed by UUID.
+  simple_spinlock peer_proxies_lock_;
+  std::unordered_map<std::string, std::shared_ptr<PeerProxy>> peer_proxies_;
+
   scoped_refptr<Counter> follower_memory_pressure_rejections_;
+  scoped_refptr<Counter> leader_lease_misses_;
+  scoped_refptr<Counter> promotion_throttled_writes_;
+  scoped_refptr<Counter> admission_throttled_writes_;
+  scoped_refptr<Counter> relayed_requests_;
+  scoped_refptr<Histogram> replicate_latency_;
+  scoped_refptr<Histogram> follower_prepare_latency_;
+  scoped_refptr<Histogram> follower_log_wait_latency_;
   scoped_refptr<AtomicGauge<int64_t>> term_metric_;
   scoped_refptr<AtomicGauge<int64_t>> num_failed_elections_metric_;
 
@@ -943,8 +1204,8 @@ struct ConsensusBootstrapInfo {
 // Follower transactions execute the following way:
 //
 // - When a ReplicateMsg is first received from the leader, the RaftConsensus
-//   instance creates the ConsensusRound and calls StartFollowerTransaction().
-//   This will trigger the Prepare(). At the same time, the follower's consensus
+//   instance creates the ConsensusRound and calls StartFollowerTransaction(),
+//   usually without holding its own lock. This will trigger the Prepare(). At the same time, the follower's consensus
 //   instance immediately stores the ReplicateMsg in the Log. Once the
 //   message is stored in stable storage an ACK is sent to the leader (i.e. the
 //   replica RaftConsensus instance does not wait for Prepare() to finish).
@@ -966,6 +1227,33 @@ class ConsensusRoundHandler {
   // replication. This can be used to trigger callbacks, akin to an Apply() for
   // transaction ops.
   virtual void FinishConsensusOnlyRound(ConsensusRound* round) = 0;
+
+  // With --raft_enable_parallel_apply, fills 'keys' with the conflict keys of
+  // the committed transaction 'round', e.g. hashes of the rows it writes, so
+  // that it may be applied concurrently with rounds not sharing any of them.
+  // Returns false if 'round' may conflict with any round, in which case it is
+  // applied once all the earlier rounds have been.
+  //
+  // The replicated callbacks of rounds with keys run on a thread pool and must
+  // not call back into RaftConsensus.
+  virtual bool GetApplyConflictKeys(ConsensusRound* /*round*/,
+                                    std::vector<uint64_t>* /*keys*/) {
+    return false;
+  }
+
+  // Returns the snapshotter of the state machine, if it supports catching up
+  // replicas from snapshots, or nullptr. Must outlive RaftConsensus.
+  virtual StateMachineSnapshotter* snapshotter() {
+    return nullptr;
+  }
+
+  // Returns how much of the data applied to the state machine is waiting to
+  // be flushed, as a multiple of the amount at which it's normally flushed.
+  // A leader delays new writes as it grows past 1, so that flushes may keep
+  // up. See --raft_admission_control_max_delay_us.
+  virtual double GetFlushBacklog() {
+    return 0;
+  }
 };
 
 // Context for a consensus round on the LEADER side, typically created as an
@@ -16,6 +16,8 @@
 // under the License.
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <ostream>
@@ -29,6 +31,9 @@
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#ifdef TCMALLOC_ENABLED
+#include <gperftools/malloc_hook.h>
+#endif
 
 #include "kudu/clock/clock.h"
 #include "kudu/clock/logical_clock.h"
@@ -37,6 +42,7 @@
 #include "kudu/common/timestamp.h"
 #include "kudu/common/wire_protocol-test-util.h"
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/consensus/change_stream.h"
 #include "kudu/consensus/consensus-test-util.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/consensus_meta.h"
@@ -45,6 +51,7 @@
 #include "kudu/consensus/consensus_queue.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log.pb.h"
+#include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log_util.h"
@@ -53,6 +60,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/consensus/raft_consensus.h"
+#include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/consensus/time_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/bind.h"
@@ -63,6 +71,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/periodic.h"
 #include "kudu/tablet/metadata.pb.h"
 #include "kudu/util/async_util.h"
 #include "kudu/util/mem_tracker.h"
@@ -71,12 +80,16 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/status_callback.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/threadpool.h"
 
 DECLARE_int32(raft_heartbeat_interval_ms);
 DECLARE_bool(enable_leader_failure_detection);
+DECLARE_bool(raft_enable_leader_leases);
+DECLARE_bool(raft_enable_relay_replication);
+DECLARE_bool(raft_lock_free_vote_checks);
 
 METRIC_DECLARE_entity(tablet);
 
@@ -85,6 +98,7 @@ using kudu::log::LogEntryPB;
 using kudu::log::LogOptions;
 using kudu::log::LogReader;
 using kudu::pb_util::SecureShortDebugString;
+using kudu::rpc::PeriodicTimer;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -100,6 +114,16 @@ const char* kTestTablet = "TestTablet";
 void DoNothing(const string& s) {
 }
 
+#ifdef TCMALLOC_ENABLED
+// The number of heap allocations made while CountAllocation() is installed as
+// a tcmalloc hook.
+std::atomic<int64_t> num_allocations(0);
+
+void CountAllocation(const void* /*ptr*/, size_t /*size*/) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+#endif
+
 Status WaitUntilLeaderForTests(RaftConsensus* raft) {
   MonoTime deadline = MonoTime::Now() + MonoDelta::FromSeconds(15);
   while (MonoTime::Now() < deadline) {
@@ -263,8 +287,8 @@ class RaftConsensusQuorumTest : public KuduTest {
     return nullptr;
   }
 
-  Status AppendDummyMessage(int peer_idx,
-                            scoped_refptr<ConsensusRound>* round) {
+  // Creates a round for a dummy message on the peer, without replicating it.
+  void NewDummyRound(int peer_idx, scoped_refptr<ConsensusRound>* round) {
     gscoped_ptr<ReplicateMsg> msg(new ReplicateMsg());
     msg->set_op_type(NO_OP);
     msg->mutable_noop_request();
@@ -277,6 +301,14 @@ class RaftConsensusQuorumTest : public KuduTest {
     gscoped_ptr<Synchronizer> sync(new Synchronizer());
     *round = peer->NewRound(std::move(msg), sync->AsStdStatusCallback());
     InsertOrDie(&syncs_, round->get(), sync.release());
+  }
+
+  Status AppendDummyMessage(int peer_idx,
+                            scoped_refptr<ConsensusRound>* round) {
+    NewDummyRound(peer_idx, round);
+
+    shared_ptr<RaftConsensus> peer;
+    CHECK_OK(peers_->GetPeerByIdx(peer_idx, &peer));
     RETURN_NOT_OK_PREPEND(peer->Replicate(round->get()),
                           Substitute("Unable to replicate to peer $0", peer_idx));
     return Status::OK();
@@ -622,7 +654,7 @@ TEST_F(RaftConsensusQuorumTest, TestFollowersReplicateAndCommitMessage) {
   ASSERT_OK(commit_sync->Wait());
   WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kFollower0Idx, kLeaderIdx);
   WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kFollower1Idx, kLeaderIdx);
-  VerifyLogs(2, 0, 1);
+  VerifyLogs(kLeaderIdx, kRelayedIdx, kRelayIdx);
 }
 
 // Tests Replicate/Commit a sequence of messages through the leader.
@@ -659,6 +691,176 @@ TEST_F(RaftConsensusQuorumTest, TestFollowersReplicateAndCommitSequence) {
   VerifyLogs(2, 0, 1);
 }
 
+// Tests that ReplicateBatch() replicates the rounds of each batch with
+// consecutive indexes, and compares its throughput to Replicate()'s.
+TEST_F(RaftConsensusQuorumTest, TestReplicateBatch) {
+  const int kFollower0Idx = 0;
+  const int kFollower1Idx = 1;
+  const int kLeaderIdx = 2;
+  const int kNumOps = AllowSlowTests() ? 20000 : 2000;
+  const int kBatchSize = 100;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+
+  // Replicate the ops one by one, then in batches, waiting for them to be
+  // replicated only at the end.
+  double one_by_one_secs;
+  {
+    vector<scoped_refptr<ConsensusRound>> rounds(kNumOps);
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < kNumOps; i++) {
+      NewDummyRound(kLeaderIdx, &rounds[i]);
+      ASSERT_OK(leader->Replicate(rounds[i]));
+    }
+    for (const scoped_refptr<ConsensusRound>& round : rounds) {
+      ASSERT_OK(WaitForReplicate(round.get()));
+    }
+    sw.stop();
+    one_by_one_secs = sw.elapsed().wall_seconds();
+  }
+
+  double batched_secs;
+  OpId last_op_id;
+  {
+    vector<scoped_refptr<ConsensusRound>> rounds(kNumOps);
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < kNumOps; i += kBatchSize) {
+      vector<scoped_refptr<ConsensusRound>> batch;
+      for (int j = i; j < i + kBatchSize; j++) {
+        NewDummyRound(kLeaderIdx, &rounds[j]);
+        batch.push_back(rounds[j]);
+      }
+      ASSERT_OK(leader->ReplicateBatch(batch));
+    }
+    for (const scoped_refptr<ConsensusRound>& round : rounds) {
+      ASSERT_OK(WaitForReplicate(round.get()));
+    }
+    sw.stop();
+    batched_secs = sw.elapsed().wall_seconds();
+
+    for (int i = 1; i < kNumOps; i++) {
+      ASSERT_EQ(rounds[i - 1]->id().index() + 1, rounds[i]->id().index());
+    }
+    last_op_id = rounds.back()->id();
+  }
+
+  LOG(INFO) << Substitute("Replicated $0 ops at $1 ops/s one by one, and at $2 ops/s "
+                          "in batches of $3",
+                          kNumOps, kNumOps / one_by_one_secs, kNumOps / batched_secs,
+                          kBatchSize);
+
+  WaitForReplicateIfNotAlreadyPresent(last_op_id, kFollower0Idx);
+  WaitForReplicateIfNotAlreadyPresent(last_op_id, kFollower1Idx);
+}
+
+// Reports the number of heap allocations made per op, both to create its
+// round and to replicate it to all the replicas, so that changes to the
+// allocations on the write path show up in the numbers. Allocations made by
+// the replicas' background threads in the meantime are counted too.
+TEST_F(RaftConsensusQuorumTest, TestAllocationsPerOp) {
+#ifndef TCMALLOC_ENABLED
+  LOG(WARNING) << "test is skipped; allocations can only be counted with tcmalloc";
+#else
+  const int kFollower0Idx = 0;
+  const int kFollower1Idx = 1;
+  const int kLeaderIdx = 2;
+  const int kNumOps = AllowSlowTests() ? 10000 : 1000;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+
+  // Replicate an op first, so that allocations made once per tablet, such
+  // as the peers' first requests, aren't counted.
+  scoped_refptr<ConsensusRound> first_round;
+  ASSERT_OK(AppendDummyMessage(kLeaderIdx, &first_round));
+  ASSERT_OK(WaitForReplicate(first_round.get()));
+
+  vector<scoped_refptr<ConsensusRound>> rounds(kNumOps);
+  ASSERT_TRUE(MallocHook::AddNewHook(&CountAllocation));
+  for (int i = 0; i < kNumOps; i++) {
+    NewDummyRound(kLeaderIdx, &rounds[i]);
+  }
+  int64_t round_allocations = num_allocations.load();
+  for (const scoped_refptr<ConsensusRound>& round : rounds) {
+    ASSERT_OK(leader->Replicate(round));
+  }
+  for (const scoped_refptr<ConsensusRound>& round : rounds) {
+    ASSERT_OK(WaitForReplicate(round.get()));
+  }
+  OpId last_op_id = rounds.back()->id();
+  WaitForReplicateIfNotAlreadyPresent(last_op_id, kFollower0Idx);
+  WaitForReplicateIfNotAlreadyPresent(last_op_id, kFollower1Idx);
+  ASSERT_TRUE(MallocHook::RemoveNewHook(&CountAllocation));
+  int64_t total_allocations = num_allocations.load();
+
+  LOG(INFO) << Substitute("Made $0 allocations per op to create the rounds, and $1 "
+                          "allocations per op in total to replicate $2 ops",
+                          static_cast<double>(round_allocations) / kNumOps,
+                          static_cast<double>(total_allocations) / kNumOps,
+                          kNumOps);
+#endif
+}
+
+// Tests that a change stream delivers the committed ops in batches, and
+// anchors the log until they're acknowledged.
+TEST_F(RaftConsensusQuorumTest, TestChangeStream) {
+  const int kLeaderIdx = 2;
+  const int kNumOps = 20;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+
+  OpId last_op_id;
+  vector<scoped_refptr<ConsensusRound>> rounds;
+  NO_FATALS(ReplicateSequenceOfMessages(
+      kNumOps, kLeaderIdx, WAIT_FOR_ALL_REPLICAS, DONT_COMMIT, &last_op_id, &rounds));
+
+  scoped_refptr<log::LogAnchorRegistry> registry(new log::LogAnchorRegistry());
+  unique_ptr<ChangeStream> stream;
+  ASSERT_OK(leader->NewChangeStream(0, registry, &stream));
+  int64_t anchored_index;
+  ASSERT_OK(registry->GetEarliestRegisteredLogIndex(&anchored_index));
+  ASSERT_EQ(1, anchored_index);
+
+  // Read the ops a few at a time. Each dummy op is larger than the limit, so
+  // a batch holds one op.
+  vector<ReplicateRefPtr> ops;
+  ASSERT_OK(stream->ReadNext(1, &ops));
+  ASSERT_EQ(1, ops.size());
+  ASSERT_EQ(1, ops[0]->get()->id().index());
+  ASSERT_OK(stream->Ack(1));
+  ASSERT_OK(registry->GetEarliestRegisteredLogIndex(&anchored_index));
+  ASSERT_EQ(2, anchored_index);
+
+  // Ops can't be acknowledged before they're read.
+  ASSERT_TRUE(stream->Ack(2).IsInvalidArgument());
+
+  // Read the rest, through the last committed op.
+  int64_t last_index = 1;
+  while (true) {
+    ASSERT_OK(stream->ReadNext(1024 * 1024, &ops));
+    if (ops.empty()) {
+      break;
+    }
+    for (const ReplicateRefPtr& op : ops) {
+      ASSERT_EQ(++last_index, op->get()->id().index());
+    }
+  }
+  ASSERT_EQ(last_op_id.index(), last_index);
+  ASSERT_EQ(last_index, stream->last_read_index());
+  ASSERT_EQ(1, stream->last_acked_index());
+
+  // Closing the stream releases its anchor.
+  stream.reset();
+  ASSERT_TRUE(registry->GetEarliestRegisteredLogIndex(&anchored_index).IsNotFound());
+}
+
 TEST_F(RaftConsensusQuorumTest, TestConsensusContinuesIfAMinorityFallsBehind) {
   // Constants with the indexes of peers with certain roles,
   // since peers don't change roles in this test.
@@ -859,6 +1061,145 @@ TEST_F(RaftConsensusQuorumTest, TestLeaderHeartbeats) {
   VerifyLogs(2, 0, 1);
 }
 
+// Tests that the leader, and only the leader, gets a lease with
+// --raft_enable_leader_leases.
+TEST_F(RaftConsensusQuorumTest, TestLeaderLease) {
+  FLAGS_raft_enable_leader_leases = true;
+  const int kFollower0Idx = 0;
+  const int kLeaderIdx = 2;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+  shared_ptr<RaftConsensus> follower;
+  CHECK_OK(peers_->GetPeerByIdx(kFollower0Idx, &follower));
+
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_OK(leader->CheckLeaderLease());
+  });
+  Status s = follower->CheckLeaderLease();
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+
+  // Heartbeats keep the lease valid.
+  SleepFor(MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms * 4LL));
+  ASSERT_OK(leader->CheckLeaderLease());
+
+  FLAGS_raft_enable_leader_leases = false;
+  ASSERT_TRUE(leader->CheckLeaderLease().IsNotSupported());
+}
+
+TEST_F(RaftConsensusQuorumTest, TestReadIndex) {
+  const int kFollower0Idx = 0;
+  const int kLeaderIdx = 2;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+  shared_ptr<RaftConsensus> follower;
+  CHECK_OK(peers_->GetPeerByIdx(kFollower0Idx, &follower));
+
+  OpId last_op_id;
+  shared_ptr<Synchronizer> last_commit_sync;
+  vector<scoped_refptr<ConsensusRound>> rounds;
+  NO_FATALS(ReplicateSequenceOfMessages(10, kLeaderIdx, WAIT_FOR_MAJORITY, COMMIT_ONE_BY_ONE,
+                                        &last_op_id, &rounds, &last_commit_sync));
+  ASSERT_OK(last_commit_sync->Wait());
+
+  // Without a lease, the leader waits for a round of heartbeats.
+  const MonoTime deadline = MonoTime::Now() + MonoDelta::FromSeconds(10);
+  int64_t read_index;
+  ASSERT_OK(leader->LeaderReadIndex(deadline, &read_index));
+  ASSERT_GE(read_index, last_op_id.index());
+
+  // A follower gets the read index from the leader, and returns once it
+  // committed it too.
+  ASSERT_EVENTUALLY([&]() {
+    ASSERT_OK(follower->ReadIndex(deadline, &read_index));
+  });
+  ASSERT_GE(read_index, last_op_id.index());
+  ASSERT_GE(follower->queue_->GetCommittedIndex(), read_index);
+
+  Status s = follower->LeaderReadIndex(deadline, &read_index);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+}
+
+// Tests that a peer fed through a relay receives all the ops.
+TEST_F(RaftConsensusQuorumTest, TestRelayReplication) {
+  FLAGS_raft_enable_relay_replication = true;
+  const int kRelayedIdx = 0;
+  const int kRelayIdx = 1;
+  const int kLeaderIdx = 2;
+
+  ASSERT_OK(BuildFsManagersAndLogs(3));
+  BuildInitialRaftConfigPB(3);
+  config_.mutable_peers(kRelayedIdx)->mutable_attrs()->set_relay_uuid(
+      config_.peers(kRelayIdx).permanent_uuid());
+  ASSERT_OK(BuildPeers());
+  ASSERT_OK(StartPeers());
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+  ASSERT_OK(leader->EmulateElection());
+
+  OpId last_op_id;
+  shared_ptr<Synchronizer> last_commit_sync;
+  vector<scoped_refptr<ConsensusRound>> rounds;
+  NO_FATALS(ReplicateSequenceOfMessages(20, kLeaderIdx, WAIT_FOR_ALL_REPLICAS,
+                                        COMMIT_ONE_BY_ONE, &last_op_id, &rounds,
+                                        &last_commit_sync));
+  ASSERT_OK(last_commit_sync->Wait());
+  WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kRelayedIdx, kLeaderIdx);
+  ASSERT_EQ(20, txn_factories_[kRelayedIdx]->num_follower_transactions());
+
+  shared_ptr<RaftConsensus> relay;
+  CHECK_OK(peers_->GetPeerByIdx(kRelayIdx, &relay));
+  ASSERT_GT(relay->relayed_requests_->value(), 0);
+  VerifyLogs(2, 0, 1);
+}
+
+// Tests that a witness replicates the ops to its log without applying them,
+// and neither starts elections nor is chosen as the successor of the leader.
+TEST_F(RaftConsensusQuorumTest, TestWitness) {
+  const int kWitnessIdx = 0;
+  const int kFollowerIdx = 1;
+  const int kLeaderIdx = 2;
+
+  ASSERT_OK(BuildFsManagersAndLogs(3));
+  BuildInitialRaftConfigPB(3);
+  config_.mutable_peers(kWitnessIdx)->mutable_attrs()->set_witness(true);
+  ASSERT_OK(BuildPeers());
+  ASSERT_OK(StartPeers());
+  shared_ptr<RaftConsensus> leader;
+  CHECK_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+  ASSERT_OK(leader->EmulateElection());
+  shared_ptr<RaftConsensus> witness;
+  CHECK_OK(peers_->GetPeerByIdx(kWitnessIdx, &witness));
+  ASSERT_TRUE(witness->IsWitness());
+  ASSERT_FALSE(leader->IsWitness());
+
+  OpId last_op_id;
+  shared_ptr<Synchronizer> last_commit_sync;
+  vector<scoped_refptr<ConsensusRound>> rounds;
+  NO_FATALS(ReplicateSequenceOfMessages(10, kLeaderIdx, WAIT_FOR_ALL_REPLICAS,
+                                        COMMIT_ONE_BY_ONE, &last_op_id, &rounds,
+                                        &last_commit_sync));
+  ASSERT_OK(last_commit_sync->Wait());
+  WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kWitnessIdx, kLeaderIdx);
+  WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kFollowerIdx, kLeaderIdx);
+
+  // Only the other follower applied the ops.
+  ASSERT_EQ(0, txn_factories_[kWitnessIdx]->num_follower_transactions());
+  ASSERT_EQ(10, txn_factories_[kFollowerIdx]->num_follower_transactions());
+  log::RetentionIndexes retention = witness->GetRetentionIndexes();
+  ASSERT_EQ(retention.for_durability, retention.for_peers);
+
+  Status s = witness->StartElection(RaftConsensus::ELECT_EVEN_IF_LEADER_IS_ALIVE,
+                                    RaftConsensus::EXTERNAL_REQUEST);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  LeaderStepDownResponsePB resp;
+  s = leader->TransferLeadership(witness->peer_uuid(), &resp);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
 // After creating the initial configuration, this test writes a small sequence
 // of messages to the initial leader. It then shuts down the current
 // leader, makes another peer become leader and writes a sequence of
@@ -1130,6 +1471,57 @@ TEST_F(RaftConsensusQuorumTest, TestRequestVote) {
                                                    fs_managers_[0]->uuid()));
   ASSERT_EQ(0, flush_count() - flush_count_before)
       << "Pre-elections should not flush";
+
+  // Pre-votes for an old term are denied too.
+  request.set_candidate_term(last_op_id.term() + 1);
+  response.Clear();
+  ASSERT_OK(peer->RequestVote(&request,
+                              TabletVotingState(boost::none, tablet::TABLET_DATA_READY),
+                              &response));
+  ASSERT_FALSE(response.vote_granted());
+  ASSERT_EQ(ConsensusErrorPB::INVALID_TERM, response.consensus_error().code());
+  ASSERT_EQ(last_op_id.term() + 2, response.responder_term());
+  ASSERT_EQ(0, flush_count() - flush_count_before)
+      << "Pre-elections should not flush";
+
+  // A pre-vote granted without the locks snoozes the failure detector by the
+  // same exponential backoff as one granted under them. The replica's PRNG is
+  // seeded the same way before each, so that they pick the same backoff.
+  {
+    const uint32_t kSeed = 63900;
+    FLAGS_enable_leader_failure_detection = true;
+    peer->EnableFailureDetector(MonoDelta::FromSeconds(600));
+    peer->failed_elections_since_stable_leader_ = 5;
+    peer->rng_.Reset(kSeed);
+    const MonoDelta backoff = peer->LeaderElectionExpBackoffDelta();
+    ASSERT_TRUE(backoff.MoreThan(peer->MinimumElectionTimeout())) << backoff.ToString();
+    const shared_ptr<PeriodicTimer> fd = peer->GetFailureDetectorForTests();
+
+    request.set_candidate_term(last_op_id.term() + 3);
+    for (bool lock_free : { true, false }) {
+      SCOPED_TRACE(lock_free ? "lock-free" : "locked");
+      FLAGS_raft_lock_free_vote_checks = lock_free;
+      // With failure detection enabled, the locked path denies votes which
+      // race with an update as busy, so retry those.
+      ASSERT_EVENTUALLY([&]() {
+        peer->rng_.Reset(kSeed);
+        response.Clear();
+        MonoTime before = MonoTime::Now();
+        ASSERT_OK(peer->RequestVote(&request,
+                                    TabletVotingState(boost::none, tablet::TABLET_DATA_READY),
+                                    &response));
+        MonoTime after = MonoTime::Now();
+        ASSERT_TRUE(response.vote_granted()) << SecureShortDebugString(response);
+        MonoTime next_task_time = fd->NextTaskTimeForTests();
+        ASSERT_GE(next_task_time, before + backoff);
+        ASSERT_LE(next_task_time, after + backoff);
+      });
+    }
+    FLAGS_raft_lock_free_vote_checks = true;
+    peer->DisableFailureDetector();
+    peer->failed_elections_since_stable_leader_ = 0;
+    FLAGS_enable_leader_failure_detection = false;
+  }
   request.set_is_pre_election(false);
 
   //
@@ -18,6 +18,13 @@
 #ifndef KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 #define KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -28,14 +35,46 @@ namespace consensus {
 // A simple ref-counted wrapper around ReplicateMsg.
 class RefCountedReplicate : public RefCountedThreadSafe<RefCountedReplicate> {
  public:
-  explicit RefCountedReplicate(ReplicateMsg* msg) : msg_(msg) {}
+  explicit RefCountedReplicate(ReplicateMsg* msg)
+      : msg_(msg),
+        byte_size_(-1),
+        space_used_(-1) {
+  }
 
   ReplicateMsg* get() {
     return msg_.get();
   }
 
+  // Computes the serialized size and the memory footprint of the message, which
+  // are expensive to compute, so that the log cache, the WAL and the peers can
+  // all reuse them. Does nothing if they were already computed.
+  //
+  // This must be called before the message is shared between threads, and the
+  // message must not be modified afterwards: the message is serialized using
+  // the sizes cached within it.
+  void CacheSizes() {
+    if (byte_size_ < 0) {
+      byte_size_ = msg_->ByteSize();
+      space_used_ = msg_->SpaceUsedLong();
+    }
+  }
+
+  // The serialized size of the message. Requires CacheSizes().
+  int64_t byte_size() const {
+    DCHECK_GE(byte_size_, 0);
+    return byte_size_;
+  }
+
+  // The memory used by the message. Requires CacheSizes().
+  int64_t space_used() const {
+    DCHECK_GE(space_used_, 0);
+    return space_used_;
+  }
+
  private:
   gscoped_ptr<ReplicateMsg> msg_;
+  int64_t byte_size_;
+  int64_t space_used_;
 };
 
 typedef scoped_refptr<RefCountedReplicate> ReplicateRefPtr;
@@ -44,6 +83,42 @@ inline ReplicateRefPtr make_scoped_refptr_replicate(ReplicateMsg* replicate) {
   return ReplicateRefPtr(new RefCountedReplicate(replicate));
 }
 
+// An immutable batch of consecutive messages, which may be shared by the
+// requests sending it to several peers. A reference to the batch keeps all of
+// its messages alive, so that each request takes one reference rather than
+// one per message.
+class ReplicateSpan : public RefCountedThreadSafe<ReplicateSpan> {
+ public:
+  explicit ReplicateSpan(std::vector<ReplicateRefPtr> msgs)
+      : msgs_(std::move(msgs)) {
+  }
+
+  const std::vector<ReplicateRefPtr>& msgs() const {
+    return msgs_;
+  }
+
+  bool empty() const {
+    return msgs_.empty();
+  }
+
+  size_t size() const {
+    return msgs_.size();
+  }
+
+  // The last message. Requires !empty().
+  ReplicateMsg* back() const {
+    return msgs_.back()->get();
+  }
+
+ private:
+  friend class RefCountedThreadSafe<ReplicateSpan>;
+  ~ReplicateSpan() {}
+
+  const std::vector<ReplicateRefPtr> msgs_;
+};
+
+typedef scoped_refptr<const ReplicateSpan> ReplicateSpanPtr;
+
 } // namespace consensus
 } // namespace kudu
 
@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "kudu/consensus/opid.pb.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace consensus {
+
+// A snapshot of the state of a state machine, read as a stream of bytes.
+class StateMachineSnapshotReader {
+ public:
+  virtual ~StateMachineSnapshotReader() {}
+
+  // The id of the last op whose effects the snapshot includes.
+  virtual const OpId& last_included_op_id() const = 0;
+
+  // Reads up to 'max_size' bytes following those read by the previous calls
+  // into 'data', and sets 'done' if they are the last of the snapshot.
+  virtual Status Read(int64_t max_size, std::string* data, bool* done) = 0;
+};
+
+// The receiving end of a snapshot, written as a stream of bytes.
+class StateMachineSnapshotWriter {
+ public:
+  virtual ~StateMachineSnapshotWriter() {}
+
+  // Writes the bytes following those written by the previous calls.
+  virtual Status Write(const Slice& data) = 0;
+
+  // Called once all the bytes of the snapshot were written. Once this
+  // returns OK, the state machine must have replaced its state with that of
+  // the snapshot, durably: the replica then resumes replication from the op
+  // following the snapshot, and its log may no longer hold the earlier ops.
+  virtual Status Finish() = 0;
+};
+
+// Implemented by state machines which can catch up a replica from a
+// snapshot of their state, for replicas which are too far behind to be
+// caught up from the leader's log. See ConsensusRoundHandler::snapshotter().
+//
+// Since the log then needn't be retained for lagging replicas, such state
+// machines may bound the log's retention with --log_max_segments_to_retain
+// and --log_max_bytes_to_retain_for_peers.
+class StateMachineSnapshotter {
+ public:
+  virtual ~StateMachineSnapshotter() {}
+
+  // Takes a snapshot of the state machine as of an op it has applied. The
+  // snapshot must remain readable while 'reader' is alive, even as further
+  // ops are applied.
+  virtual Status TakeSnapshot(std::unique_ptr<StateMachineSnapshotReader>* reader) = 0;
+
+  // Starts installing a snapshot which includes the ops up to
+  // 'last_included_op_id'. An install which isn't finished is abandoned by
+  // destroying its writer.
+  virtual Status InstallSnapshot(const OpId& last_included_op_id,
+                                 std::unique_ptr<StateMachineSnapshotWriter>* writer) = 0;
+};
+
+} // namespace consensus
+} // namespace kudu
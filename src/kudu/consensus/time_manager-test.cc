@@ -204,5 +204,38 @@ TEST_F(TimeManagerTest, TestTimeManagerLeaderMode) {
   after_latch->Wait();
 }
 
+// Tests receiving a batch of messages from the leader, and that advancing safe
+// time wakes up exactly the waiters whose timestamps became safe.
+TEST_F(TimeManagerTest, TestBatchedMessagesAndOrderedWaiters) {
+  Timestamp init = clock_->Now();
+  InitTimeManager(init);
+  Timestamp t1(init.value() + 10);
+  Timestamp t2(init.value() + 20);
+  Timestamp t3(init.value() + 30);
+
+  ReplicateMsg m1;
+  m1.set_timestamp(t1.value());
+  ReplicateMsg m2;
+  m2.set_timestamp(t2.value());
+  ASSERT_OK(time_manager_->MessagesReceivedFromLeader({ &m1, &m2 }));
+  ASSERT_EQ(time_manager_->last_serial_ts_assigned_, t2);
+  ASSERT_EQ(time_manager_->GetSafeTime(), init);
+
+  // Register the waiters out of timestamp order.
+  CountDownLatch* latch3 = WaitForSafeTimeAsync(t3);
+  CountDownLatch* latch1 = WaitForSafeTimeAsync(t1);
+  CountDownLatch* latch2 = WaitForSafeTimeAsync(t2);
+
+  time_manager_->AdvanceSafeTime(t2);
+  latch1->Wait();
+  latch2->Wait();
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  ASSERT_EQ(1, latch3->count());
+
+  time_manager_->AdvanceSafeTime(t3);
+  latch3->Wait();
+  ASSERT_EQ(time_manager_->GetSafeTime(), t3);
+}
+
 } // namespace consensus
 } // namespace kudu
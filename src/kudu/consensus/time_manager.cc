@@ -20,6 +20,7 @@
 #include <mutex>
 #include <ostream>
 
+#include <boost/optional/optional.hpp>
 #include <gflags/gflags.h>
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
@@ -54,6 +55,7 @@ DECLARE_int32(scanner_max_wait_ms);
 
 using kudu::clock::Clock;
 using std::string;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -137,6 +139,35 @@ Status TimeManager::MessageReceivedFromLeader(const ReplicateMsg& message) {
   return Status::OK();
 }
 
+Status TimeManager::MessagesReceivedFromLeader(const vector<const ReplicateMsg*>& messages) {
+  // See MessageReceivedFromLeader(). The timestamps of CLIENT_PROPAGATED
+  // messages increase in log order, but COMMIT_WAIT ones may be higher.
+  boost::optional<Timestamp> max_ts;
+  boost::optional<Timestamp> last_client_propagated_ts;
+  for (const ReplicateMsg* message : messages) {
+    DCHECK(message->has_timestamp());
+    Timestamp t(message->timestamp());
+    if (!max_ts || *max_ts < t) {
+      max_ts = t;
+    }
+    if (GetMessageConsistencyMode(*message) == CLIENT_PROPAGATED) {
+      last_client_propagated_ts = t;
+    }
+  }
+  if (!max_ts) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(clock_->Update(*max_ts));
+  {
+    Lock l(lock_);
+    CHECK_EQ(mode_, NON_LEADER) << "Cannot receive messages from a leader in leader mode.";
+    if (last_client_propagated_ts) {
+      last_serial_ts_assigned_ = *last_client_propagated_ts;
+    }
+  }
+  return Status::OK();
+}
+
 void TimeManager::AdvanceSafeTimeWithMessage(const ReplicateMsg& message) {
   Lock l(lock_);
   if (GetMessageConsistencyMode(message) == CLIENT_PROPAGATED) {
@@ -235,7 +266,7 @@ Status TimeManager::WaitUntilSafe(Timestamp timestamp, const MonoTime& deadline)
   {
     Lock l(lock_);
     if (IsTimestampSafeUnlocked(timestamp)) return Status::OK();
-    waiters_.push_back(&waiter);
+    waiter.entry = waiters_.emplace(timestamp, &waiter);
   }
 
   // Wait until we get notified or 'deadline' elapses.
@@ -247,7 +278,7 @@ Status TimeManager::WaitUntilSafe(Timestamp timestamp, const MonoTime& deadline)
     // Address the case where we were notified after the timeout.
     if (waiter.latch->count() == 0) return Status::OK();
 
-    waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &waiter));
+    waiters_.erase(waiter.entry);
 
     MakeWaiterTimeoutMessageUnlocked(waiter.timestamp, &error_message);
     return Status::TimedOut(error_message);
@@ -263,17 +294,15 @@ void TimeManager::AdvanceSafeTimeAndWakeUpWaitersUnlocked(Timestamp safe_time) {
   last_safe_ts_ = safe_time;
   last_advanced_safe_time_ = MonoTime::Now();
 
-  if (PREDICT_FALSE(!waiters_.empty())) {
+  // Waiters are ordered by timestamp, so stop at the first one not yet safe.
+  while (PREDICT_FALSE(!waiters_.empty())) {
     auto iter = waiters_.begin();
-    while (iter != waiters_.end()) {
-      WaitingState* waiter = *iter;
-      if (IsTimestampSafeUnlocked(waiter->timestamp)) {
-        iter = waiters_.erase(iter);
-        waiter->latch->CountDown();
-        continue;
-      }
-      iter++;
+    if (!IsTimestampSafeUnlocked(iter->first)) {
+      break;
     }
+    WaitingState* waiter = iter->second;
+    waiters_.erase(iter);
+    waiter->latch->CountDown();
   }
 }
 
@@ -348,6 +377,10 @@ Timestamp TimeManager::GetSerialTimestampPlusMaxError() {
   return clock_->NowLatest();
 }
 
+int64_t TimeManager::MaxClockDriftPpm() const {
+  return clock_->MaxDriftPpm();
+}
+
 
 } // namespace consensus
 } // namespace kudu
@@ -16,6 +16,7 @@
 // under the License.
 #pragma once
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -102,6 +103,10 @@ class TimeManager : public RefCountedThreadSafe<TimeManager> {
   // Requires non-leader mode (CHECK failure if it isn't).
   Status MessageReceivedFromLeader(const ReplicateMsg& message);
 
+  // Same as above but for a batch of messages received in one request, in
+  // log order, updating the clock and the internal state only once.
+  Status MessagesReceivedFromLeader(const std::vector<const ReplicateMsg*>& messages);
+
   // Advances safe time based on the timestamp and type of 'message'.
   //
   // This only moves safe time if 'message's timestamp is higher than the currently known one.
@@ -138,9 +143,17 @@ class TimeManager : public RefCountedThreadSafe<TimeManager> {
   // replica).
   Timestamp GetSerialTimestamp();
 
+  // Returns the maximum rate, in parts per million, at which the clock may
+  // drift from true time. See Clock::MaxDriftPpm().
+  int64_t MaxClockDriftPpm() const;
+
+  // Helper to return the external consistency mode of 'message'.
+  static ExternalConsistencyMode GetMessageConsistencyMode(const ReplicateMsg& message);
+
  private:
   FRIEND_TEST(TimeManagerTest, TestTimeManagerNonLeaderMode);
   FRIEND_TEST(TimeManagerTest, TestTimeManagerLeaderMode);
+  FRIEND_TEST(TimeManagerTest, TestBatchedMessagesAndOrderedWaiters);
 
   // Returns whether we've advanced safe time recently.
   // If this returns false we might be partitioned or there might be election churn.
@@ -156,21 +169,26 @@ class TimeManager : public RefCountedThreadSafe<TimeManager> {
   // Helper to build the final error message of WaitUntilSafe().
   void MakeWaiterTimeoutMessageUnlocked(Timestamp timestamp, std::string* error_message);
 
-  // Helper to return the external consistency mode of 'message'.
-  static ExternalConsistencyMode GetMessageConsistencyMode(const ReplicateMsg& message);
-
   // The mode of this TimeManager.
   enum Mode {
     LEADER,
     NON_LEADER
   };
 
+  struct WaitingState;
+
+  // Waiters, ordered by the timestamp they require be safe, so that advancing
+  // safe time only visits the waiters it wakes up.
+  typedef std::multimap<Timestamp, WaitingState*> WaitersMap;
+
   // State for waiters.
   struct WaitingState {
     // The timestamp the waiter requires be safe.
     Timestamp timestamp;
     // Latch that will be count down once 'timestamp' if safe, unblocking the waiter.
     CountDownLatch* latch;
+    // The entry of the waiter in 'waiters_', to remove it on timeout.
+    WaitersMap::iterator entry;
   };
 
   // Returns whether 'timestamp' is safe.
@@ -196,8 +214,8 @@ class TimeManager : public RefCountedThreadSafe<TimeManager> {
   // Lock to protect the non-const fields below.
   mutable simple_spinlock lock_;
 
-  // Vector of waiters to be notified when the safe time advances.
-  mutable std::vector<WaitingState*> waiters_;
+  // Waiters to be notified when the safe time advances.
+  mutable WaitersMap waiters_;
 
   // The last serial timestamp that was assigned.
   Timestamp last_serial_ts_assigned_;
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
@@ -165,6 +166,13 @@ class ReadableBlock : public Block {
   // If an error was encountered, returns a non-OK status.
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const = 0;
 
+  // Starts reading 'length' bytes beginning from 'offset' in the block into
+  // memory in the background, without waiting for them. A later Read() or
+  // ReadV() of the range is then likely to be served without blocking on
+  // the disk. Reads prefetched from many blocks at once are serviced by the
+  // device concurrently.
+  virtual Status Prefetch(uint64_t offset, size_t length) const = 0;
+
   // Returns the memory usage of this object including the object itself.
   virtual size_t memory_footprint() const = 0;
 };
@@ -175,6 +183,10 @@ class ReadableBlock : public Block {
 // placement into SSD-backed directories).
 struct CreateBlockOptions {
   const std::string tablet_id;
+
+  // The class of the writes to the block, by which they're scheduled.
+  // Defaults to FOREGROUND, i.e. unscheduled.
+  const IOClass io_class;
 };
 
 // Block manager creation options.
@@ -40,6 +40,7 @@
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
@@ -52,6 +53,7 @@ using std::unique_ptr;
 using strings::Substitute;
 
 DECLARE_bool(crash_on_eio);
+DECLARE_bool(fs_data_dirs_consider_io_load);
 DECLARE_double(env_inject_eio);
 DECLARE_int32(fs_data_dirs_full_disk_cache_seconds);
 DECLARE_int32(fs_target_data_dirs_per_tablet);
@@ -227,6 +229,47 @@ TEST_F(DataDirsTest, TestFailedDirNotReturned) {
   ASSERT_STR_CONTAINS(s.ToString(), "No healthy directories exist in tablet's directory group");
 }
 
+TEST_F(DataDirsTest, TestSlowDirAvoided) {
+  FLAGS_fs_data_dirs_consider_io_load = true;
+  FLAGS_fs_target_data_dirs_per_tablet = 2;
+  ASSERT_OK(dd_manager_->CreateDataDirGroup(test_tablet_name_));
+
+  // Make one of the directories in the group slow.
+  DataDir* slow_dd;
+  ASSERT_OK(dd_manager_->GetNextDataDir(test_block_opts_, &slow_dd));
+  slow_dd->IOStarted();
+  slow_dd->IOFinished(MonoDelta::FromSeconds(1));
+  ASSERT_GT(slow_dd->io_load(), 0);
+
+  // New blocks go to the other directory of the group.
+  for (int i = 0; i < 10; i++) {
+    DataDir* dd;
+    ASSERT_OK(dd_manager_->GetNextDataDir(test_block_opts_, &dd));
+    ASSERT_NE(slow_dd, dd);
+  }
+
+  // New tablets aren't placed on the slow directory, even though it holds
+  // fewer tablets than the others once they fill up.
+  int slow_uuid_idx;
+  ASSERT_TRUE(dd_manager_->FindUuidIndexByDataDir(slow_dd, &slow_uuid_idx));
+  for (int i = 0; i < 20; i++) {
+    string tablet_id = Substitute("$0-$1", test_tablet_name_, i);
+    ASSERT_OK(dd_manager_->CreateDataDirGroup(tablet_id));
+    ASSERT_FALSE(ContainsKey(dd_manager_->FindTabletsByDataDirUuidIdx(slow_uuid_idx),
+                             tablet_id));
+  }
+
+  // Without taking the load into account, the slow directory is used again.
+  FLAGS_fs_data_dirs_consider_io_load = false;
+  bool used_slow_dd = false;
+  for (int i = 0; i < 100 && !used_slow_dd; i++) {
+    DataDir* dd;
+    ASSERT_OK(dd_manager_->GetNextDataDir(test_block_opts_, &dd));
+    used_slow_dd = dd == slow_dd;
+  }
+  ASSERT_TRUE(used_slow_dd);
+}
+
 TEST_F(DataDirsTest, TestFailedDirNotAddedToGroup) {
   // Fail one dir and create a group with all directories. The failed directory
   // shouldn't be in the group.
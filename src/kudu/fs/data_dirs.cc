@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cmath>
 #include <cstdint>
 #include <iterator>
 #include <memory>
@@ -91,6 +92,14 @@ DEFINE_int32(fs_data_dirs_full_disk_cache_seconds, 30,
 TAG_FLAG(fs_data_dirs_full_disk_cache_seconds, advanced);
 TAG_FLAG(fs_data_dirs_full_disk_cache_seconds, evolving);
 
+DEFINE_bool(fs_data_dirs_consider_io_load, false,
+            "Whether to take the recently observed I/O latency and queue depth "
+            "of the data directories into account when placing new tablets and "
+            "new blocks, steering new writes away from slow disks.");
+TAG_FLAG(fs_data_dirs_consider_io_load, advanced);
+TAG_FLAG(fs_data_dirs_consider_io_load, experimental);
+TAG_FLAG(fs_data_dirs_consider_io_load, runtime);
+
 DEFINE_bool(fs_lock_data_dirs, true,
             "Lock the data directories to prevent concurrent usage. "
             "Note that read-only concurrent usage is still allowed.");
@@ -131,6 +140,18 @@ using strings::SubstituteAndAppend;
 
 namespace {
 
+// Weight of each new I/O operation in the moving average of a directory's
+// I/O latency.
+const double kIOLatencyAvgWeight = 0.1;
+
+// Half-life of the contribution of past I/O operations to the I/O load of a
+// directory.
+const double kIOLoadHalfLifeSecs = 10;
+
+// I/O loads within this factor of each other are considered equal when
+// placing new tablets.
+const double kIOLoadTolerance = 1.25;
+
 const char kHolePunchErrorMsg[] =
     "Error during hole punch test. The log block manager requires a "
     "filesystem with hole punching support such as ext4 or xfs. On el6, "
@@ -201,7 +222,8 @@ void DeleteTmpFilesRecursively(Env* env, const string& path) {
 #define GINIT(x) x(METRIC_##x.Instantiate(entity, 0))
 DataDirMetrics::DataDirMetrics(const scoped_refptr<MetricEntity>& entity)
   : GINIT(data_dirs_failed),
-    GINIT(data_dirs_full) {
+    GINIT(data_dirs_full),
+    io_scheduler(entity) {
 }
 #undef GINIT
 
@@ -222,7 +244,10 @@ DataDir::DataDir(Env* env,
       metadata_file_(std::move(metadata_file)),
       pool_(std::move(pool)),
       is_shutdown_(false),
-      is_full_(false) {
+      is_full_(false),
+      ios_in_flight_(0),
+      io_latency_avg_us_(0),
+      io_scheduler_(metrics ? &metrics->io_scheduler : nullptr) {
 }
 
 DataDir::~DataDir() {
@@ -295,6 +320,36 @@ Status DataDir::RefreshIsFull(RefreshMode mode) {
   return Status::OK();
 }
 
+void DataDir::IOStarted() {
+  ios_in_flight_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DataDir::IOFinished(MonoDelta latency) {
+  MonoTime now = MonoTime::Now();
+  {
+    std::lock_guard<simple_spinlock> l(io_load_lock_);
+    double avg = DecayedIOLatencyUnlocked(now);
+    io_latency_avg_us_ = avg + kIOLatencyAvgWeight * (latency.ToMicroseconds() - avg);
+    last_io_finished_ = now;
+  }
+  ios_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+double DataDir::io_load() const {
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(io_load_lock_);
+  return DecayedIOLatencyUnlocked(now) *
+      (1 + ios_in_flight_.load(std::memory_order_relaxed));
+}
+
+double DataDir::DecayedIOLatencyUnlocked(const MonoTime& now) const {
+  if (!last_io_finished_.Initialized()) {
+    return 0;
+  }
+  double age_secs = (now - last_io_finished_).ToSeconds();
+  return io_latency_avg_us_ * pow(0.5, age_secs / kIOLoadHalfLifeSecs);
+}
+
 ////////////////////////////////////////////////////////////
 // DataDirGroup
 ////////////////////////////////////////////////////////////
@@ -977,17 +1032,33 @@ Status DataDirManager::GetNextDataDir(const CreateBlockOptions& opts, DataDir**
   iota(random_indices.begin(), random_indices.end(), 0);
   shuffle(random_indices.begin(), random_indices.end(), default_random_engine(rng_.Next()));
 
-  // Randomly select a member of the group that is not full.
+  // Randomly select a member of the group that is not full. When taking the
+  // I/O load into account, select the less loaded of two such members.
+  DataDir* chosen = nullptr;
   for (int i : random_indices) {
     int uuid_idx = (*group_uuid_indices)[i];
     DataDir* candidate = FindOrDie(data_dir_by_uuid_idx_, uuid_idx);
     Status s = candidate->RefreshIsFull(DataDir::RefreshMode::EXPIRED_ONLY);
     WARN_NOT_OK(s, Substitute("failed to refresh fullness of $0", candidate->dir()));
     if (s.ok() && !candidate->is_full()) {
-      *dir = candidate;
-      return Status::OK();
+      if (!FLAGS_fs_data_dirs_consider_io_load) {
+        *dir = candidate;
+        return Status::OK();
+      }
+      if (!chosen) {
+        chosen = candidate;
+        continue;
+      }
+      if (candidate->io_load() < chosen->io_load()) {
+        chosen = candidate;
+      }
+      break;
     }
   }
+  if (chosen) {
+    *dir = chosen;
+    return Status::OK();
+  }
   string tablet_id_str = "";
   if (PREDICT_TRUE(!opts.tablet_id.empty())) {
     tablet_id_str = Substitute("$0's ", opts.tablet_id);
@@ -1044,11 +1115,26 @@ void DataDirManager::GetDirsForGroupUnlocked(int target_size,
       candidate_indices.push_back(e.first);
     }
   }
+  // Returns whether the directory with UUID index 'a' is less loaded than the
+  // one with UUID index 'b'.
+  const auto less_loaded = [&](int a, int b) {
+    if (FLAGS_fs_data_dirs_consider_io_load) {
+      double io_load_a = FindOrDie(data_dir_by_uuid_idx_, a)->io_load();
+      double io_load_b = FindOrDie(data_dir_by_uuid_idx_, b)->io_load();
+      if (io_load_a * kIOLoadTolerance < io_load_b) {
+        return true;
+      }
+      if (io_load_b * kIOLoadTolerance < io_load_a) {
+        return false;
+      }
+    }
+    return FindOrDie(tablets_by_uuid_idx_map_, a).size() <
+        FindOrDie(tablets_by_uuid_idx_map_, b).size();
+  };
   while (group_indices->size() < target_size && !candidate_indices.empty()) {
     shuffle(candidate_indices.begin(), candidate_indices.end(), default_random_engine(rng_.Next()));
     if (candidate_indices.size() == 1 ||
-        FindOrDie(tablets_by_uuid_idx_map_, candidate_indices[0]).size() <
-            FindOrDie(tablets_by_uuid_idx_map_, candidate_indices[1]).size()) {
+        less_loaded(candidate_indices[0], candidate_indices[1])) {
       group_indices->push_back(candidate_indices[0]);
       candidate_indices.erase(candidate_indices.begin());
     } else {
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <mutex>
@@ -28,6 +29,7 @@
 
 #include <gtest/gtest_prod.h>
 
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -135,6 +137,8 @@ struct DataDirMetrics {
 
   scoped_refptr<AtomicGauge<uint64_t>> data_dirs_failed;
   scoped_refptr<AtomicGauge<uint64_t>> data_dirs_full;
+
+  IOSchedulerMetrics io_scheduler;
 };
 
 // Representation of a data directory in use by the block manager.
@@ -189,7 +193,28 @@ class DataDir {
     return is_full_;
   }
 
+  // Marks the start of an I/O operation on this directory, for the purpose
+  // of tracking its load. Must be followed by a call to IOFinished().
+  void IOStarted();
+
+  // Marks the end of an I/O operation started with IOStarted(), which took
+  // 'latency' to complete.
+  void IOFinished(MonoDelta latency);
+
+  // Returns the I/O load of this directory: the moving average of the
+  // latency of its recent I/O operations in microseconds, scaled by the
+  // number of operations in flight. The average decays with the time since
+  // the last operation finished, so that a directory that was slow, and
+  // thus stopped being written to, is eventually considered again.
+  double io_load() const;
+
+  // Arbitrates the I/O issued to this directory.
+  IOScheduler* io_scheduler() { return &io_scheduler_; }
+
  private:
+  // Returns the moving average of the I/O latency, decayed as of 'now'.
+  double DecayedIOLatencyUnlocked(const MonoTime& now) const;
+
   Env* env_;
   DataDirMetrics* metrics_;
   const DataDirFsType fs_type_;
@@ -204,6 +229,16 @@ class DataDir {
   MonoTime last_check_is_full_;
   bool is_full_;
 
+  // Number of I/O operations currently in flight.
+  std::atomic<int32_t> ios_in_flight_;
+
+  // Protects 'io_latency_avg_us_' and 'last_io_finished_'.
+  mutable simple_spinlock io_load_lock_;
+  double io_latency_avg_us_;
+  MonoTime last_io_finished_;
+
+  IOScheduler io_scheduler_;
+
   DISALLOW_COPY_AND_ASSIGN(DataDir);
 };
 
@@ -328,7 +363,9 @@ class DataDirManager {
   void DeleteDataDirGroup(const std::string& tablet_id);
 
   // Returns a random directory from the specfied option's data dir group. If
-  // there is no room in the group, returns an error.
+  // --fs_data_dirs_consider_io_load is set, two random directories are picked
+  // and the one with the lower I/O load is returned. If there is no room in
+  // the group, returns an error.
   Status GetNextDataDir(const CreateBlockOptions& opts, DataDir** dir);
 
   // Finds the set of tablet_ids in the data dir specified by 'uuid_idx' and
@@ -456,7 +493,10 @@ class DataDirManager {
   // Balancing", selecting two directories randomly and choosing the one with
   // less load, quantified as the number of unique tablets in the directory.
   // The resulting behavior fills directories that have fewer tablets stored on
-  // them while not completely neglecting those with more tablets.
+  // them while not completely neglecting those with more tablets. If
+  // --fs_data_dirs_consider_io_load is set, the directory with the clearly
+  // lower I/O load is chosen first, and the number of tablets only breaks
+  // ties.
   //
   // 'group_indices' is an output that stores the list of uuid_indices to be
   // added. Although this function does not itself change DataDirManager state,
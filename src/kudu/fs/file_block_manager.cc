@@ -35,6 +35,7 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/fs_report.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/integral_types.h"
@@ -56,6 +57,7 @@
 #include "kudu/util/random_util.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/trace.h"
 
 using std::accumulate;
 using std::set;
@@ -234,7 +236,7 @@ void FileBlockLocation::GetAllParentDirs(vector<string>* parent_dirs) const {
 class FileWritableBlock : public WritableBlock {
  public:
   FileWritableBlock(FileBlockManager* block_manager, FileBlockLocation location,
-                    shared_ptr<WritableFile> writer);
+                    shared_ptr<WritableFile> writer, IOClass io_class);
 
   virtual ~FileWritableBlock();
 
@@ -281,6 +283,9 @@ class FileWritableBlock : public WritableBlock {
   // The underlying opened file backing this block.
   shared_ptr<WritableFile> writer_;
 
+  // The class of the writes to the block.
+  const IOClass io_class_;
+
   State state_;
 
   // The number of bytes successfully appended to the block.
@@ -291,10 +296,12 @@ class FileWritableBlock : public WritableBlock {
 
 FileWritableBlock::FileWritableBlock(FileBlockManager* block_manager,
                                      FileBlockLocation location,
-                                     shared_ptr<WritableFile> writer)
+                                     shared_ptr<WritableFile> writer,
+                                     IOClass io_class)
     : block_manager_(block_manager),
       location_(location),
       writer_(std::move(writer)),
+      io_class_(io_class),
       state_(CLEAN),
       bytes_appended_(0) {
   if (block_manager_->metrics_) {
@@ -339,16 +346,16 @@ Status FileWritableBlock::Append(const Slice& data) {
 
 Status FileWritableBlock::AppendV(ArrayView<const Slice> data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY) << "Invalid state: " << state_;
-  RETURN_NOT_OK_HANDLE_ERROR(writer_->AppendV(data));
-  RETURN_NOT_OK_HANDLE_ERROR(location_.data_dir()->RefreshIsFull(
-      DataDir::RefreshMode::ALWAYS));
-  state_ = DIRTY;
-
-  // Calculate the amount of data written
+  // Calculate the amount of data to write
   size_t bytes_written = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
                                     [&](int sum, const Slice& curr) {
                                       return sum + curr.size();
                                     });
+  location_.data_dir()->io_scheduler()->Admit(io_class_, bytes_written);
+  RETURN_NOT_OK_HANDLE_ERROR(writer_->AppendV(data));
+  RETURN_NOT_OK_HANDLE_ERROR(location_.data_dir()->RefreshIsFull(
+      DataDir::RefreshMode::ALWAYS));
+  state_ = DIRTY;
   bytes_appended_ += bytes_written;
   return Status::OK();
 }
@@ -449,6 +456,8 @@ class FileReadableBlock : public ReadableBlock {
 
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const OVERRIDE;
 
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
   void HandleError(const Status& s) const;
@@ -530,18 +539,26 @@ Status FileReadableBlock::ReadV(uint64_t offset, ArrayView<Slice> results) const
 
   RETURN_NOT_OK_HANDLE_ERROR(reader_->ReadV(offset, results));
 
+  // Calculate the read amount of data
+  size_t bytes_read = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
+                                 [&](int sum, const Slice& curr) {
+                                   return sum + curr.size();
+                                 });
+  TRACE_COUNTER_INCREMENT("fbm_read_bytes", bytes_read);
   if (block_manager_->metrics_) {
-    // Calculate the read amount of data
-    size_t bytes_read = accumulate(results.begin(), results.end(), static_cast<size_t>(0),
-                                   [&](int sum, const Slice& curr) {
-                                     return sum + curr.size();
-                                   });
     block_manager_->metrics_->total_bytes_read->IncrementBy(bytes_read);
   }
 
   return Status::OK();
 }
 
+Status FileReadableBlock::Prefetch(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK_HANDLE_ERROR(reader_->Prefetch(offset, length));
+  return Status::OK();
+}
+
 size_t FileReadableBlock::memory_footprint() const {
   DCHECK(reader_);
   return kudu_malloc_usable_size(this) + reader_->memory_footprint();
@@ -802,7 +819,7 @@ Status FileBlockManager::CreateBlock(const CreateBlockOptions& opts,
       }
       dirty_dirs_.insert(DirName(path));
     }
-    block->reset(new internal::FileWritableBlock(this, location, writer));
+    block->reset(new internal::FileWritableBlock(this, location, writer, opts.io_class));
   } else {
     HANDLE_DISK_FAILURE(s,
         error_manager_->RunErrorNotificationCb(ErrorHandlerType::DISK_ERROR, dir));
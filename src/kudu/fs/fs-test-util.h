@@ -85,6 +85,10 @@ class CountingReadableBlock : public ReadableBlock {
     return Status::OK();
   }
 
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE {
+    return block_->Prefetch(offset, length);
+  }
+
   virtual size_t memory_footprint() const OVERRIDE {
     return block_->memory_footprint();
   }
@@ -19,6 +19,8 @@
 
 #include <string>
 
+#include "kudu/fs/io_scheduler.h"
+
 namespace kudu {
 namespace fs {
 
@@ -43,6 +45,10 @@ namespace fs {
 struct IOContext {
   // The tablet id associated with this IO.
   std::string tablet_id;
+
+  // The class of the IO, by which the writes it issues are scheduled.
+  // Defaults to FOREGROUND, i.e. unscheduled.
+  IOClass io_class;
 };
 
 }  // namespace fs
@@ -0,0 +1,74 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(io_scheduler_compaction_bytes_per_sec);
+DECLARE_int32(io_scheduler_max_yield_ms);
+
+namespace kudu {
+namespace fs {
+
+class IOSchedulerTest : public KuduTest {
+ protected:
+  // Returns how long it took to admit the given I/O.
+  MonoDelta TimeAdmit(IOClass io_class, int64_t bytes) {
+    MonoTime start = MonoTime::Now();
+    scheduler_.Admit(io_class, bytes);
+    return MonoTime::Now() - start;
+  }
+
+  IOScheduler scheduler_ { nullptr };
+};
+
+TEST_F(IOSchedulerTest, TestTokenBucket) {
+  FLAGS_io_scheduler_compaction_bytes_per_sec = 100 * 1024;
+
+  // The bucket starts full, with a second's worth of tokens.
+  ASSERT_LT(TimeAdmit(IOClass::COMPACTION, 100 * 1024).ToMilliseconds(), 100);
+
+  // The next write waits for the bucket to refill. An operation larger than
+  // the bucket is still admitted, once the debt it incurs is repaid.
+  ASSERT_GE(TimeAdmit(IOClass::COMPACTION, 50 * 1024).ToMilliseconds(), 400);
+  ASSERT_GE(TimeAdmit(IOClass::COMPACTION, 200 * 1024).ToMilliseconds(), 1900);
+
+  // Other classes aren't limited.
+  ASSERT_LT(TimeAdmit(IOClass::FLUSH, 1024 * 1024).ToMilliseconds(), 100);
+  ASSERT_LT(TimeAdmit(IOClass::FOREGROUND, 1024 * 1024).ToMilliseconds(), 100);
+}
+
+TEST_F(IOSchedulerTest, TestYieldToWal) {
+  FLAGS_io_scheduler_max_yield_ms = 200;
+  ASSERT_LT(TimeAdmit(IOClass::FLUSH, 1024).ToMilliseconds(), 100);
+  {
+    IOScheduler::ScopedWalIO wal_io;
+    // Background I/O waits for the WAL I/O, for up to the maximum.
+    ASSERT_GE(TimeAdmit(IOClass::FLUSH, 1024).ToMilliseconds(), 200);
+    // Foreground I/O doesn't.
+    ASSERT_LT(TimeAdmit(IOClass::FOREGROUND, 1024).ToMilliseconds(), 100);
+  }
+  ASSERT_LT(TimeAdmit(IOClass::COMPACTION, 1024).ToMilliseconds(), 100);
+}
+
+} // namespace fs
+} // namespace kudu
@@ -0,0 +1,187 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/port.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_int64(io_scheduler_flush_bytes_per_sec, 0,
+             "The maximum rate at which flushes may write to each data "
+             "directory, in bytes per second. 0 means unlimited.");
+TAG_FLAG(io_scheduler_flush_bytes_per_sec, experimental);
+TAG_FLAG(io_scheduler_flush_bytes_per_sec, runtime);
+
+DEFINE_int64(io_scheduler_compaction_bytes_per_sec, 0,
+             "The maximum rate at which compactions may write to each data "
+             "directory, in bytes per second. 0 means unlimited.");
+TAG_FLAG(io_scheduler_compaction_bytes_per_sec, experimental);
+TAG_FLAG(io_scheduler_compaction_bytes_per_sec, runtime);
+
+DEFINE_int64(io_scheduler_tablet_copy_bytes_per_sec, 0,
+             "The maximum rate at which tablet copies may write to each data "
+             "directory, in bytes per second. 0 means unlimited.");
+TAG_FLAG(io_scheduler_tablet_copy_bytes_per_sec, experimental);
+TAG_FLAG(io_scheduler_tablet_copy_bytes_per_sec, runtime);
+
+DEFINE_int32(io_scheduler_max_yield_ms, 0,
+             "The maximum time a background write to a data directory (by a "
+             "flush, compaction or tablet copy) waits for the WAL I/O in "
+             "flight to finish before being issued. 0 disables the yielding.");
+TAG_FLAG(io_scheduler_max_yield_ms, experimental);
+TAG_FLAG(io_scheduler_max_yield_ms, runtime);
+
+METRIC_DEFINE_gauge_int64(server, io_scheduler_queue_depth,
+                          "I/O Scheduler Queue Depth",
+                          kudu::MetricUnit::kOperations,
+                          "Number of background I/O operations (flushes, compactions "
+                          "and tablet copies) waiting to be admitted by the I/O scheduler.");
+
+METRIC_DEFINE_histogram(server, io_scheduler_flush_wait_time_us,
+                        "I/O Scheduler Flush Wait Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent by flush writes waiting to be admitted by the "
+                        "I/O scheduler.",
+                        60000000LU, 2);
+
+METRIC_DEFINE_histogram(server, io_scheduler_compaction_wait_time_us,
+                        "I/O Scheduler Compaction Wait Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent by compaction writes waiting to be admitted by the "
+                        "I/O scheduler.",
+                        60000000LU, 2);
+
+METRIC_DEFINE_histogram(server, io_scheduler_tablet_copy_wait_time_us,
+                        "I/O Scheduler Tablet Copy Wait Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent by tablet copy writes waiting to be admitted by the "
+                        "I/O scheduler.",
+                        60000000LU, 2);
+
+namespace kudu {
+namespace fs {
+
+const char* IOClassToString(IOClass io_class) {
+  switch (io_class) {
+    case IOClass::FOREGROUND: return "foreground";
+    case IOClass::WAL: return "wal";
+    case IOClass::FLUSH: return "flush";
+    case IOClass::COMPACTION: return "compaction";
+    case IOClass::TABLET_COPY: return "tablet copy";
+  }
+  LOG(FATAL) << "unknown I/O class";
+  return "";
+}
+
+IOSchedulerMetrics::IOSchedulerMetrics(const scoped_refptr<MetricEntity>& entity)
+    : queue_depth(METRIC_io_scheduler_queue_depth.Instantiate(entity, 0)),
+      flush_wait_time(METRIC_io_scheduler_flush_wait_time_us.Instantiate(entity)),
+      compaction_wait_time(METRIC_io_scheduler_compaction_wait_time_us.Instantiate(entity)),
+      tablet_copy_wait_time(METRIC_io_scheduler_tablet_copy_wait_time_us.Instantiate(entity)) {
+}
+
+std::atomic<int32_t> IOScheduler::wal_ios_in_flight_(0);
+
+IOScheduler::IOScheduler(IOSchedulerMetrics* metrics)
+    : metrics_(metrics) {
+}
+
+void IOScheduler::Admit(IOClass io_class, int64_t bytes) {
+  if (io_class == IOClass::FOREGROUND || io_class == IOClass::WAL) {
+    return;
+  }
+  MonoTime start = MonoTime::Now();
+  if (metrics_) metrics_->queue_depth->Increment();
+  YieldToWal();
+  MonoDelta wait = TakeTokens(io_class, bytes);
+  if (wait.ToNanoseconds() > 0) {
+    SleepFor(wait);
+  }
+  if (metrics_) {
+    metrics_->queue_depth->Decrement();
+    int64_t waited_us = (MonoTime::Now() - start).ToMicroseconds();
+    switch (io_class) {
+      case IOClass::FLUSH: metrics_->flush_wait_time->Increment(waited_us); break;
+      case IOClass::COMPACTION: metrics_->compaction_wait_time->Increment(waited_us); break;
+      case IOClass::TABLET_COPY: metrics_->tablet_copy_wait_time->Increment(waited_us); break;
+      default: break;
+    }
+  }
+}
+
+void IOScheduler::YieldToWal() {
+  int32_t max_yield_ms = FLAGS_io_scheduler_max_yield_ms;
+  if (max_yield_ms <= 0 || wal_ios_in_flight_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  // WAL I/O is short and frequent, so rather than have it signal on the hot
+  // path, poll for it to finish.
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(max_yield_ms);
+  while (wal_ios_in_flight_.load(std::memory_order_relaxed) > 0 &&
+         MonoTime::Now() < deadline) {
+    SleepFor(MonoDelta::FromMicroseconds(100));
+  }
+}
+
+MonoDelta IOScheduler::TakeTokens(IOClass io_class, int64_t bytes) {
+  int64_t rate = 0;
+  TokenBucket* bucket = nullptr;
+  switch (io_class) {
+    case IOClass::FLUSH:
+      rate = FLAGS_io_scheduler_flush_bytes_per_sec;
+      bucket = &flush_bucket_;
+      break;
+    case IOClass::COMPACTION:
+      rate = FLAGS_io_scheduler_compaction_bytes_per_sec;
+      bucket = &compaction_bucket_;
+      break;
+    case IOClass::TABLET_COPY:
+      rate = FLAGS_io_scheduler_tablet_copy_bytes_per_sec;
+      bucket = &tablet_copy_bucket_;
+      break;
+    default:
+      LOG(FATAL) << "not a background I/O class: " << IOClassToString(io_class);
+  }
+  if (rate <= 0) {
+    return MonoDelta::FromNanoseconds(0);
+  }
+
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  // The bucket holds up to a second's worth of tokens.
+  if (PREDICT_FALSE(!bucket->last_refill.Initialized())) {
+    bucket->tokens = rate;
+  } else {
+    bucket->tokens = std::min<double>(
+        rate, bucket->tokens + rate * (now - bucket->last_refill).ToSeconds());
+  }
+  bucket->last_refill = now;
+  bucket->tokens -= bytes;
+  if (bucket->tokens >= 0) {
+    return MonoDelta::FromNanoseconds(0);
+  }
+  return MonoDelta::FromSeconds(-bucket->tokens / rate);
+}
+
+} // namespace fs
+} // namespace kudu
@@ -0,0 +1,136 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace fs {
+
+// The classes of I/O arbitrated by the IOScheduler.
+enum class IOClass {
+  // I/O on behalf of clients, and any I/O that isn't otherwise classified.
+  // Never held back.
+  FOREGROUND,
+
+  // Writes to the write-ahead log. Never held back, and background I/O
+  // yields to it.
+  WAL,
+
+  // Background I/O, held back in favor of WAL I/O and limited to the rate
+  // configured for its class.
+  FLUSH,
+  COMPACTION,
+  TABLET_COPY,
+};
+
+const char* IOClassToString(IOClass io_class);
+
+struct IOSchedulerMetrics {
+  explicit IOSchedulerMetrics(const scoped_refptr<MetricEntity>& entity);
+
+  // The number of background I/O operations waiting to be admitted.
+  scoped_refptr<AtomicGauge<int64_t>> queue_depth;
+
+  // The time spent by background I/O operations waiting to be admitted, by
+  // class.
+  scoped_refptr<Histogram> flush_wait_time;
+  scoped_refptr<Histogram> compaction_wait_time;
+  scoped_refptr<Histogram> tablet_copy_wait_time;
+};
+
+// Arbitrates the I/O issued to a data directory between the components
+// sharing it, so that e.g. a large compaction's writes don't delay WAL
+// fsyncs on the same disk.
+//
+// Foreground and WAL I/O is never held back. Background I/O is admitted by
+// Admit(), which:
+// 1. waits for the WAL I/O in flight to finish, for up to
+//    --io_scheduler_max_yield_ms, and
+// 2. takes tokens for its bytes from the token bucket of its class, which
+//    is refilled at the rate configured for the class, e.g. with
+//    --io_scheduler_compaction_bytes_per_sec. A bucket may go into debt by
+//    a single operation's bytes, so that operations larger than the burst
+//    size are still admitted, after waiting for the debt to be repaid.
+//
+// Each data directory has its own token buckets. However, since the WAL
+// needn't live in a data directory and the mapping of directories to disks
+// isn't known, WAL I/O in flight is tracked process-wide, and background I/O
+// to any directory yields to it.
+//
+// This class is thread-safe.
+class IOScheduler {
+ public:
+  // 'metrics' may be null.
+  explicit IOScheduler(IOSchedulerMetrics* metrics);
+
+  // Waits until 'bytes' of I/O of class 'io_class' may be issued.
+  void Admit(IOClass io_class, int64_t bytes);
+
+  // Marks WAL I/O as in flight for the lifetime of the object.
+  class ScopedWalIO {
+   public:
+    ScopedWalIO() {
+      wal_ios_in_flight_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~ScopedWalIO() {
+      wal_ios_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(ScopedWalIO);
+  };
+
+ private:
+  struct TokenBucket {
+    // The number of bytes which may be issued without waiting. Negative
+    // when in debt.
+    double tokens = 0;
+    MonoTime last_refill;
+  };
+
+  // Waits for the WAL I/O in flight to finish, for up to the configured
+  // maximum.
+  static void YieldToWal();
+
+  // Takes 'bytes' tokens from the bucket of 'io_class', and returns how long
+  // to wait before issuing the I/O.
+  MonoDelta TakeTokens(IOClass io_class, int64_t bytes);
+
+  // The number of WAL I/O operations in flight in the process.
+  static std::atomic<int32_t> wal_ios_in_flight_;
+
+  IOSchedulerMetrics* metrics_;
+
+  simple_spinlock lock_;
+  TokenBucket flush_bucket_;
+  TokenBucket compaction_bucket_;
+  TokenBucket tablet_copy_bucket_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOScheduler);
+};
+
+} // namespace fs
+} // namespace kudu
@@ -53,11 +53,13 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h" // IWYU pragma: keep
@@ -76,9 +78,13 @@ using strings::Substitute;
 
 DECLARE_bool(cache_force_single_shard);
 DECLARE_bool(crash_on_eio);
+DECLARE_bool(log_block_manager_checkpoint);
+DECLARE_bool(log_container_direct_io);
 DECLARE_double(env_inject_eio);
 DECLARE_double(log_container_excess_space_before_cleanup_fraction);
 DECLARE_double(log_container_live_metadata_before_compact_ratio);
+DECLARE_int32(log_container_direct_io_buffer_bytes);
+DECLARE_int32(log_container_load_threads_per_dir);
 DECLARE_int64(block_manager_max_open_files);
 DECLARE_int64(log_container_max_blocks);
 DECLARE_string(block_manager_preflush_control);
@@ -444,6 +450,51 @@ TEST_F(LogBlockManagerTest, MetricsTest) {
         {11, &METRIC_block_manager_total_blocks_deleted} }));
 }
 
+// Test that the holes of adjacent blocks deleted by different transactions are
+// coalesced into a single hole punch when they're queued at the same time.
+TEST_F(LogBlockManagerTest, TestCoalesceHolePunchesAcrossTransactions) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(ReopenBlockManager(entity));
+
+  // Create some contiguous blocks in one container.
+  const int kNumBlocks = 10;
+  vector<BlockId> blocks;
+  {
+    unique_ptr<BlockCreationTransaction> transaction = bm_->NewCreationTransaction();
+    for (int i = 0; i < kNumBlocks; i++) {
+      unique_ptr<WritableBlock> b;
+      ASSERT_OK(bm_->CreateBlock(test_block_opts_, &b));
+      blocks.emplace_back(b->id());
+      ASSERT_OK(b->Append("test data"));
+      ASSERT_OK(b->Finalize());
+      transaction->AddCreatedBlock(std::move(b));
+    }
+    ASSERT_OK(transaction->CommitCreatedBlocks());
+  }
+  ASSERT_EQ(1, bm_->all_containers_by_name_.size());
+
+  // Keep the data directory busy while the blocks are deleted, one per
+  // transaction, so that all of their holes are queued together.
+  CountDownLatch latch(1);
+  DataDir* dir = dd_manager_->data_dirs()[0].get();
+  dir->ExecClosure(Bind(&CountDownLatch::Wait, Unretained(&latch)));
+  for (const auto& id : blocks) {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    deletion_transaction->AddDeletedBlock(id);
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+    ASSERT_EQ(1, deleted.size());
+  }
+  latch.CountDown();
+  dir->WaitOnClosures();
+  NO_FATALS(CheckLogMetrics(entity,
+      { {0, &METRIC_log_block_manager_blocks_under_management} },
+      { {1, &METRIC_log_block_manager_holes_punched},
+        {kNumBlocks, &METRIC_block_manager_total_blocks_deleted} }));
+}
+
 TEST_F(LogBlockManagerTest, ContainerPreallocationTest) {
   string kTestData = "test data";
 
@@ -997,6 +1048,31 @@ TEST_F(LogBlockManagerTest, StartupBenchmark) {
     }
   }
 }
+
+// Like StartupBenchmark, but with a single block per container, so that the
+// startup is dominated by opening the containers rather than by processing
+// their records. Times the startup with different numbers of container
+// loading threads.
+TEST_F(LogBlockManagerTest, ManyContainersStartupBenchmark) {
+  FLAGS_block_manager_preflush_control = "never";
+  FLAGS_log_container_max_blocks = 1;
+  ASSERT_OK(ReopenBlockManager());
+  const int kNumContainers = AllowSlowTests() ? 100000 : 1000;
+  for (int i = 0; i < kNumContainers; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK_FAST(bm_->CreateBlock(test_block_opts_, &block));
+    ASSERT_OK_FAST(block->Append("x"));
+    ASSERT_OK_FAST(block->Close());
+  }
+  for (int num_threads : { 1, 4, 8, 16 }) {
+    FLAGS_log_container_load_threads_per_dir = num_threads;
+    LOG_TIMING(INFO, Substitute("reopening block manager with $0 loading threads",
+                                num_threads)) {
+      ASSERT_OK(ReopenBlockManager());
+    }
+    ASSERT_EQ(kNumContainers, bm_->all_containers_by_name_.size());
+  }
+}
 #endif
 
 TEST_F(LogBlockManagerTest, TestFailMultipleTransactionsPerContainer) {
@@ -1486,6 +1562,133 @@ TEST_F(LogBlockManagerTest, TestDeleteDeadContainersAtStartup) {
   ASSERT_FALSE(env_->FileExists(metadata_file_name));
 }
 
+// Test that the block manager reopens to the same state from the checkpoint of
+// its containers as from replaying their metadata in full, with records
+// written both before and after the checkpoint.
+TEST_F(LogBlockManagerTest, TestStartupFromCheckpoint) {
+  const string checkpoint_path = JoinPathSegments(
+      dd_manager_->GetDataDirs()[0], LogBlockManager::kCheckpointFileName);
+
+  // Creates 'num_blocks' blocks, then deletes every other one.
+  vector<BlockId> live_block_ids;
+  auto create_and_delete_blocks = [&](int num_blocks) {
+    vector<BlockId> created;
+    for (int i = 0; i < num_blocks; i++) {
+      unique_ptr<WritableBlock> block;
+      ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+      ASSERT_OK(block->Append("a"));
+      ASSERT_OK(block->Close());
+      created.emplace_back(block->id());
+    }
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    for (int i = 0; i < created.size(); i++) {
+      if (i % 2 == 0) {
+        deletion_transaction->AddDeletedBlock(created[i]);
+      } else {
+        live_block_ids.emplace_back(created[i]);
+      }
+    }
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+  };
+
+  // The containers are checkpointed when the block manager reopens.
+  NO_FATALS(create_and_delete_blocks(20));
+  ASSERT_FALSE(env_->FileExists(checkpoint_path));
+  ASSERT_OK(ReopenBlockManager());
+  ASSERT_TRUE(env_->FileExists(checkpoint_path));
+
+  // Write some more records after the checkpoint, including the deletion of a
+  // checkpointed block.
+  NO_FATALS(create_and_delete_blocks(20));
+  {
+    shared_ptr<BlockDeletionTransaction> deletion_transaction =
+        bm_->NewDeletionTransaction();
+    deletion_transaction->AddDeletedBlock(live_block_ids[0]);
+    vector<BlockId> deleted;
+    ASSERT_OK(deletion_transaction->CommitDeletedBlocks(&deleted));
+    live_block_ids.erase(live_block_ids.begin());
+  }
+  std::sort(live_block_ids.begin(), live_block_ids.end(), BlockIdCompare());
+
+  // Reopening from the checkpoint and from the metadata alone must yield the
+  // same blocks and stats.
+  vector<FsReport> reports;
+  for (bool use_checkpoint : { true, false }) {
+    FLAGS_log_block_manager_checkpoint = use_checkpoint;
+    FsReport report;
+    ASSERT_OK(ReopenBlockManager(nullptr, &report));
+    NO_FATALS(AssertEmptyReport(report));
+    vector<BlockId> block_ids;
+    ASSERT_OK(bm_->GetAllBlockIds(&block_ids));
+    std::sort(block_ids.begin(), block_ids.end(), BlockIdCompare());
+    ASSERT_EQ(live_block_ids, block_ids);
+    for (const auto& id : block_ids) {
+      unique_ptr<ReadableBlock> block;
+      ASSERT_OK(bm_->OpenBlock(id, &block));
+      ASSERT_OK(block->Close());
+    }
+    ASSERT_EQ(use_checkpoint, env_->FileExists(checkpoint_path));
+    reports.emplace_back(std::move(report));
+  }
+  ASSERT_EQ(reports[0].stats.ToString(), reports[1].stats.ToString());
+}
+
+TEST_F(LogBlockManagerTest, TestDirectIOWrites) {
+  FLAGS_log_container_direct_io = true;
+  FLAGS_log_container_direct_io_buffer_bytes = 8192;
+
+  // Write blocks of assorted sizes, some of them spanning several buffers,
+  // closing some on their own and the others in a transaction.
+  Random rng(SeedRandom());
+  unordered_map<BlockId, string, BlockIdHash> expected;
+  unique_ptr<BlockCreationTransaction> transaction = bm_->NewCreationTransaction();
+  for (int i = 0; i < 20; i++) {
+    unique_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(test_block_opts_, &block));
+    string data;
+    for (int j = 0; j < 5; j++) {
+      string a = RandomString(rng.Uniform(100), &rng);
+      string b = RandomString(rng.Uniform(10000), &rng);
+      vector<Slice> slices = { Slice(a), Slice(b) };
+      ASSERT_OK(block->AppendV(slices));
+      data += a + b;
+    }
+    ASSERT_EQ(data.size(), block->BytesAppended());
+    expected.emplace(block->id(), std::move(data));
+    if (i % 2 == 0) {
+      ASSERT_OK(block->Close());
+    } else {
+      ASSERT_OK(block->Finalize());
+      transaction->AddCreatedBlock(std::move(block));
+    }
+  }
+  ASSERT_OK(transaction->CommitCreatedBlocks());
+
+  auto check_blocks = [&]() {
+    for (const auto& e : expected) {
+      unique_ptr<ReadableBlock> block;
+      ASSERT_OK(bm_->OpenBlock(e.first, &block));
+      uint64_t size;
+      ASSERT_OK(block->Size(&size));
+      ASSERT_EQ(e.second.size(), size);
+      unique_ptr<uint8_t[]> scratch(new uint8_t[size]);
+      Slice result(scratch.get(), size);
+      ASSERT_OK(block->Read(0, result));
+      ASSERT_EQ(e.second, result.ToString());
+    }
+  };
+  NO_FATALS(check_blocks());
+
+  // The padding of each block's last file system block must not trip up the
+  // consistency checks at startup.
+  FsReport report;
+  ASSERT_OK(ReopenBlockManager(nullptr, &report));
+  NO_FATALS(AssertEmptyReport(report));
+  NO_FATALS(check_blocks());
+}
+
 TEST_F(LogBlockManagerTest, TestCompactFullContainerMetadataAtStartup) {
   // With this ratio, the metadata of a full container comprised of half dead
   // blocks will be compacted at startup.
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <errno.h>
 #include <map>
 #include <memory>
@@ -43,10 +44,12 @@
 #include "kudu/fs/error_manager.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_report.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
@@ -62,6 +65,7 @@
 #include "kudu/util/file_cache.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
@@ -73,6 +77,8 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/sorted_disjoint_interval_list.h"
 #include "kudu/util/test_util_prod.h"
+#include "kudu/util/threadpool.h"
+#include "kudu/util/throttler.h"
 #include "kudu/util/trace.h"
 
 DECLARE_bool(enable_data_block_fsync);
@@ -107,6 +113,48 @@ DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.50,
               "the container's metadata file will be compacted at startup.");
 TAG_FLAG(log_container_live_metadata_before_compact_ratio, experimental);
 
+DEFINE_int32(log_container_load_threads_per_dir, 8,
+             "Number of threads per data directory used to open the log "
+             "block containers and process their metadata at startup.");
+DEFINE_validator(log_container_load_threads_per_dir,
+    [](const char* /*n*/, int32_t v) { return v > 0; });
+TAG_FLAG(log_container_load_threads_per_dir, advanced);
+TAG_FLAG(log_container_load_threads_per_dir, experimental);
+
+DEFINE_int64(log_container_max_hole_punches_per_sec, 0,
+             "Maximum number of hole punching operations issued per second to "
+             "each data directory to reclaim the space of deleted blocks. The "
+             "blocks' space is reclaimed in the background, coalescing the "
+             "holes of adjacent blocks. 0 means no limit.");
+TAG_FLAG(log_container_max_hole_punches_per_sec, advanced);
+TAG_FLAG(log_container_max_hole_punches_per_sec, experimental);
+
+DEFINE_bool(log_container_direct_io, false,
+            "Whether to write block data to the log block containers with "
+            "direct I/O, bypassing the page cache. Each writable block combines "
+            "its appends into an aligned buffer which is written out in "
+            "multiples of the file system block size. Falls back to buffered "
+            "writes on file systems that don't support direct I/O.");
+TAG_FLAG(log_container_direct_io, advanced);
+TAG_FLAG(log_container_direct_io, experimental);
+
+DEFINE_int32(log_container_direct_io_buffer_bytes, 1024 * 1024,
+             "Size of the buffer used by each writable block to combine "
+             "appends when --log_container_direct_io is enabled. Rounded up "
+             "to a multiple of the file system block size.");
+DEFINE_validator(log_container_direct_io_buffer_bytes,
+    [](const char* /*n*/, int32_t v) { return v > 0; });
+TAG_FLAG(log_container_direct_io_buffer_bytes, advanced);
+TAG_FLAG(log_container_direct_io_buffer_bytes, experimental);
+
+DEFINE_bool(log_block_manager_checkpoint, true,
+            "Whether to checkpoint the state of the log block containers of "
+            "each data directory at startup. The next startup then loads the "
+            "checkpoint and only replays the container metadata written since, "
+            "rather than all of it.");
+TAG_FLAG(log_block_manager_checkpoint, advanced);
+TAG_FLAG(log_block_manager_checkpoint, experimental);
+
 DEFINE_bool(log_block_manager_test_hole_punching, true,
             "Ensure hole punching is supported by the underlying filesystem");
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
@@ -149,6 +197,7 @@ using pb_util::ReadablePBContainerFile;
 using pb_util::WritablePBContainerFile;
 using std::accumulate;
 using std::map;
+using std::pair;
 using std::set;
 using std::shared_ptr;
 using std::string;
@@ -259,7 +308,7 @@ class LogBlock : public RefCountedThreadSafe<LogBlock> {
 class LogWritableBlock : public WritableBlock {
  public:
   LogWritableBlock(LogBlockContainer* container, BlockId block_id,
-                   int64_t block_offset);
+                   int64_t block_offset, IOClass io_class);
 
   virtual ~LogWritableBlock();
 
@@ -296,9 +345,18 @@ class LogWritableBlock : public WritableBlock {
   // Does not synchronize the written data; that takes place in Close().
   Status AppendMetadata();
 
+  // Writes out any data still combined in the direct I/O buffer, padding it
+  // with zeros to the file system block size, and releases the buffer. No
+  // more data may be appended afterwards. A no-op if direct I/O isn't used.
+  Status FinishDirectIO();
+
   LogBlockContainer* container() const { return container_; }
 
  private:
+  // Writes out the 'direct_io_buf_len_' bytes in the direct I/O buffer,
+  // padded with zeros to the file system block size.
+  Status WriteDirectIOBuffer();
+
   // The owning container. Must outlive the block.
   LogBlockContainer* container_;
 
@@ -312,10 +370,29 @@ class LogWritableBlock : public WritableBlock {
   // The block's length. Changes with each Append().
   int64_t block_length_;
 
+  // The class of the writes to the block.
+  const IOClass io_class_;
+
   // The state of the block describing where it is in the write lifecycle,
   // for example, has it been synchronized to disk?
   WritableBlock::State state_;
 
+  // If --log_container_direct_io is enabled, appends are combined in this
+  // aligned buffer of 'direct_io_buf_size_' bytes and written out to
+  // 'direct_data_file_' whenever it fills up, and when the block is finished.
+  // 'direct_io_buf_len_' bytes are buffered, starting at the block offset
+  // 'block_length_ - direct_io_buf_len_'.
+  gscoped_ptr<uint8_t, FreeDeleter> direct_io_buf_;
+  size_t direct_io_buf_size_;
+  size_t direct_io_buf_len_;
+
+  // The container's data file opened with O_DIRECT. Opened on the first
+  // write of the direct I/O buffer. Stays null if the file system doesn't
+  // support direct I/O, in which case the buffer is written out through the
+  // container's regular descriptor instead.
+  unique_ptr<RWFile> direct_data_file_;
+  bool direct_io_unsupported_;
+
   DISALLOW_COPY_AND_ASSIGN(LogWritableBlock);
 };
 
@@ -373,8 +450,14 @@ class LogBlockContainer {
   // The on-disk effects of this call are made durable only after SyncData().
   Status PunchHole(int64_t offset, int64_t length);
 
-  // Executes a hole punching operation at 'offset' with the given 'length'.
-  void ContainerDeletionAsync(int64_t offset, int64_t length);
+  // Queues the <offset, offset + length> intervals of deleted blocks in
+  // 'intervals' to be punched out of the container's data file.
+  //
+  // The holes are punched asynchronously, on the container's data directory
+  // thread pool, coalesced with the intervals queued by other deletions in
+  // the meantime, and throttled according to
+  // --log_container_max_hole_punches_per_sec.
+  void QueueHolePunches(std::vector<std::pair<int64_t, int64_t>> intervals);
 
   // Preallocate enough space to ensure that an append of 'next_append_length'
   // can be satisfied by this container. The offset of the beginning of this
@@ -391,17 +474,32 @@ class LogBlockContainer {
   // See RWFile::WriteV()
   Status WriteVData(int64_t offset, ArrayView<const Slice> data);
 
+  // Opens a new descriptor for this container's data file with O_DIRECT,
+  // bypassing the file cache.
+  Status OpenDirectDataFile(unique_ptr<RWFile>* file);
+
+  // Like WriteData(), but writes through 'direct_file', a descriptor opened
+  // by OpenDirectDataFile(). 'offset' as well as the address and the size
+  // of 'data' must be aligned to the file system block size.
+  Status WriteDirectData(RWFile* direct_file, int64_t offset, const Slice& data);
+
   // See RWFile::Read().
   Status ReadData(int64_t offset, Slice result) const;
 
   // See RWFile::ReadV().
   Status ReadVData(int64_t offset, ArrayView<Slice> results) const;
 
+  // See RWFile::Prefetch().
+  Status PrefetchData(int64_t offset, size_t length) const;
+
   // Appends 'pb' to this container's metadata file.
   //
   // The on-disk effects of this call are made durable only after SyncMetadata().
   Status AppendMetadata(const BlockRecordPB& pb);
 
+  // Like AppendMetadata(), but appends all of 'pbs' with a single write.
+  Status AppendMetadata(const std::vector<const BlockRecordPB*>& pbs);
+
   // Asynchronously flush this container's data file from 'offset' through
   // to 'length'.
   //
@@ -444,19 +542,28 @@ class LogBlockContainer {
   // Reads the container's metadata from disk, sanity checking and processing
   // records along the way.
   //
+  // If 'checkpoint' isn't null and covers no more than the metadata file, the
+  // container's state is first restored from it, and only the records after
+  // it are read. Blocks deleted before the checkpoint aren't written to
+  // 'dead_blocks'.
+  //
   // Malformed records and other container inconsistencies are written to
   // 'report'. Healthy blocks are written either to 'live_blocks' or
   // 'dead_blocks'. Live records are written to 'live_block_records'. The
   // greatest block ID seen thus far in the container is written to 'max_block_id'.
+  // The offset of the end of the last healthy record is written to
+  // 'metadata_offset'.
   //
   // Returns an error only if there was a problem accessing the container from
   // disk; such errors are fatal and effectively halt processing immediately.
   Status ProcessRecords(
+      const LogBlockContainerCheckpointPB* checkpoint,
       FsReport* report,
       LogBlockManager::UntrackedBlockMap* live_blocks,
       LogBlockManager::BlockRecordMap* live_block_records,
       std::vector<scoped_refptr<internal::LogBlock>>* dead_blocks,
-      uint64_t* max_block_id);
+      uint64_t* max_block_id,
+      uint64_t* metadata_offset);
 
   // Updates internal bookkeeping state to reflect the creation of a block.
   void BlockCreated(const scoped_refptr<LogBlock>& block);
@@ -521,6 +628,17 @@ class LogBlockContainer {
                     unique_ptr<WritablePBContainerFile> metadata_file,
                     shared_ptr<RWFile> data_file);
 
+  // Restores the container's bookkeeping and live blocks from 'checkpoint',
+  // adding the blocks to 'live_blocks' and 'live_block_records'.
+  //
+  // Returns Status::Corruption() if the checkpoint is inconsistent, in which
+  // case the container is left untouched.
+  Status RestoreCheckpoint(
+      const LogBlockContainerCheckpointPB& checkpoint,
+      LogBlockManager::UntrackedBlockMap* live_blocks,
+      LogBlockManager::BlockRecordMap* live_block_records,
+      uint64_t* max_block_id);
+
   // Processes a single block record, performing sanity checks on it and adding
   // it either to 'live_blocks' or 'dead_blocks'. If the record is live, it is
   // added to 'live_block_records'.
@@ -544,6 +662,10 @@ class LogBlockContainer {
       uint64_t* data_file_size,
       uint64_t* max_block_id);
 
+  // Punches out the holes queued by QueueHolePunches() until there are none
+  // left.
+  void PunchQueuedHoles();
+
   // Updates this container data file's position based on the offset and length
   // of a block, marking this container as full if needed. Should only be called
   // when a block is fully written, as it will round up the container data file's
@@ -590,6 +712,18 @@ class LogBlockContainer {
   // as the block manager.
   const LogBlockManagerMetrics* metrics_;
 
+  // Throttles the hole punching in the container's data directory, or null if
+  // it isn't throttled. Owned by the block manager.
+  Throttler* const hole_punch_throttler_;
+
+  // Protects 'queued_holes_' and 'hole_punching_scheduled_'.
+  simple_spinlock queued_holes_lock_;
+
+  // Intervals of deleted blocks queued to be punched out, and whether a task
+  // to punch them is scheduled.
+  std::vector<std::pair<int64_t, int64_t>> queued_holes_;
+  bool hole_punching_scheduled_ = false;
+
   // If true, only read operations are allowed. Existing blocks may
   // not be deleted until the next restart, and new blocks may not
   // be added.
@@ -616,7 +750,9 @@ LogBlockContainer::LogBlockContainer(
       live_bytes_(0),
       live_bytes_aligned_(0),
       live_blocks_(0),
-      metrics_(block_manager->metrics()) {
+      metrics_(block_manager->metrics()),
+      hole_punch_throttler_(FindPointeeOrNull(block_manager->hole_punch_throttlers_by_data_dir_,
+                                              data_dir)) {
 }
 
 void LogBlockContainer::HandleError(const Status& s) const {
@@ -773,18 +909,41 @@ Status LogBlockContainer::TruncateDataToNextBlockOffset() {
 }
 
 Status LogBlockContainer::ProcessRecords(
+    const LogBlockContainerCheckpointPB* checkpoint,
     FsReport* report,
     LogBlockManager::UntrackedBlockMap* live_blocks,
     LogBlockManager::BlockRecordMap* live_block_records,
     vector<scoped_refptr<internal::LogBlock>>* dead_blocks,
-    uint64_t* max_block_id) {
+    uint64_t* max_block_id,
+    uint64_t* metadata_offset) {
   string metadata_path = metadata_file_->filename();
   unique_ptr<RandomAccessFile> metadata_reader;
   RETURN_NOT_OK_HANDLE_ERROR(block_manager()->env()->NewRandomAccessFile(
       metadata_path, &metadata_reader));
+  uint64_t metadata_size = 0;
+  if (checkpoint) {
+    RETURN_NOT_OK_HANDLE_ERROR(metadata_reader->Size(&metadata_size));
+  }
   ReadablePBContainerFile pb_reader(std::move(metadata_reader));
   RETURN_NOT_OK_HANDLE_ERROR(pb_reader.Open());
 
+  // The metadata file may have been truncated since the checkpoint was taken,
+  // in which case all of its records must be replayed.
+  if (checkpoint && checkpoint->metadata_offset() <= metadata_size &&
+      checkpoint->metadata_offset() >= pb_reader.offset()) {
+    Status s = RestoreCheckpoint(*checkpoint, live_blocks, live_block_records, max_block_id);
+    if (s.ok()) {
+      RETURN_NOT_OK(pb_reader.SeekToOffset(checkpoint->metadata_offset()));
+    } else {
+      LOG(WARNING) << Substitute("Not using checkpoint of container $0: $1",
+                                 ToString(), s.ToString());
+    }
+  } else if (checkpoint) {
+    LOG(WARNING) << Substitute("Not using checkpoint of container $0: metadata file "
+                               "is $1 bytes, checkpoint covers $2 bytes",
+                               ToString(), metadata_size, checkpoint->metadata_offset());
+  }
+
   uint64_t data_file_size = 0;
   Status read_status;
   while (true) {
@@ -801,6 +960,7 @@ Status LogBlockContainer::ProcessRecords(
   // NOTE: 'read_status' will never be OK here.
   if (PREDICT_TRUE(read_status.IsEndOfFile())) {
     // We've reached the end of the file without any problems.
+    *metadata_offset = pb_reader.offset();
     return Status::OK();
   }
   if (read_status.IsIncomplete()) {
@@ -809,6 +969,7 @@ Status LogBlockContainer::ProcessRecords(
     // write and truncate the metadata file to remove this partial record.
     report->partial_record_check->entries.emplace_back(ToString(),
                                                        pb_reader.offset());
+    *metadata_offset = pb_reader.offset();
     return Status::OK();
   }
   // If we've made it here, we've found (and are returning) an unrecoverable error.
@@ -817,6 +978,59 @@ Status LogBlockContainer::ProcessRecords(
   return read_status;
 }
 
+Status LogBlockContainer::RestoreCheckpoint(
+    const LogBlockContainerCheckpointPB& checkpoint,
+    LogBlockManager::UntrackedBlockMap* live_blocks,
+    LogBlockManager::BlockRecordMap* live_block_records,
+    uint64_t* max_block_id) {
+  DCHECK(live_blocks->empty());
+  const int num_blocks = checkpoint.block_ids_size();
+  if (PREDICT_FALSE(checkpoint.offsets_size() != num_blocks ||
+                    checkpoint.lengths_size() != num_blocks ||
+                    checkpoint.timestamps_us_size() != num_blocks)) {
+    return Status::Corruption("mismatched number of block fields");
+  }
+
+  LogBlockManager::UntrackedBlockMap restored_blocks;
+  LogBlockManager::BlockRecordMap restored_records;
+  int64_t restored_bytes = 0;
+  for (int i = 0; i < num_blocks; i++) {
+    const BlockId block_id(checkpoint.block_ids(i));
+    const int64_t offset = checkpoint.offsets(i);
+    const int64_t length = checkpoint.lengths(i);
+    if (PREDICT_FALSE(offset < 0 || length < 0)) {
+      return Status::Corruption(Substitute("invalid block $0", block_id.ToString()));
+    }
+    scoped_refptr<LogBlock> lb(new LogBlock(this, block_id, offset, length));
+    if (PREDICT_FALSE(!InsertIfNotPresent(&restored_blocks, block_id, lb))) {
+      return Status::Corruption(Substitute("duplicate block $0", block_id.ToString()));
+    }
+    restored_bytes += lb->fs_aligned_length();
+
+    BlockRecordPB* record = &restored_records[block_id];
+    block_id.CopyToPB(record->mutable_block_id());
+    record->set_op_type(CREATE);
+    record->set_timestamp_us(checkpoint.timestamps_us(i));
+    record->set_offset(offset);
+    record->set_length(length);
+  }
+
+  for (const auto& e : restored_blocks) {
+    UpdateNextBlockOffset(e.second->offset(), e.second->length());
+    BlockCreated(e.second);
+    *max_block_id = std::max(*max_block_id, e.first.id());
+  }
+
+  // Account for the blocks deleted before the checkpoint.
+  next_block_offset_.StoreMax(checkpoint.next_block_offset());
+  total_bytes_.IncrementBy(checkpoint.total_bytes() - restored_bytes);
+  total_blocks_.IncrementBy(checkpoint.total_blocks() - num_blocks);
+
+  *live_blocks = std::move(restored_blocks);
+  *live_block_records = std::move(restored_records);
+  return Status::OK();
+}
+
 Status LogBlockContainer::ProcessRecord(
     BlockRecordPB* record,
     FsReport* report,
@@ -911,6 +1125,10 @@ Status LogBlockContainer::ProcessRecord(
 Status LogBlockContainer::DoCloseBlocks(const vector<LogWritableBlock*>& blocks,
                                         SyncMode mode) {
   auto sync_blocks = [&]() -> Status {
+    for (auto* block : blocks) {
+      RETURN_NOT_OK(block->FinishDirectIO());
+    }
+
     if (mode == SYNC) {
       VLOG(3) << "Syncing data file " << data_file_->filename();
       RETURN_NOT_OK(SyncData());
@@ -969,7 +1187,11 @@ Status LogBlockContainer::WriteVData(int64_t offset, ArrayView<const Slice> data
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   DCHECK_GE(offset, next_block_offset());
 
-  RETURN_NOT_OK_HANDLE_ERROR(data_file_->WriteV(offset, data));
+  data_dir_->IOStarted();
+  MonoTime start = MonoTime::Now();
+  Status s = data_file_->WriteV(offset, data);
+  data_dir_->IOFinished(MonoTime::Now() - start);
+  RETURN_NOT_OK_HANDLE_ERROR(s);
 
   // This append may have changed the container size if:
   // 1. It was large enough that it blew out the preallocated space.
@@ -984,6 +1206,34 @@ Status LogBlockContainer::WriteVData(int64_t offset, ArrayView<const Slice> data
   return Status::OK();
 }
 
+Status LogBlockContainer::OpenDirectDataFile(unique_ptr<RWFile>* file) {
+  RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  opts.direct_io = true;
+  return block_manager_->env()->NewRWFile(opts, data_file_->filename(), file);
+}
+
+Status LogBlockContainer::WriteDirectData(RWFile* direct_file, int64_t offset,
+                                          const Slice& data) {
+  RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
+  DCHECK_GE(offset, next_block_offset());
+  DCHECK_EQ(0, offset % instance()->filesystem_block_size_bytes());
+  DCHECK_EQ(0, data.size() % instance()->filesystem_block_size_bytes());
+
+  data_dir_->IOStarted();
+  MonoTime start = MonoTime::Now();
+  Status s = direct_file->Write(offset, data);
+  data_dir_->IOFinished(MonoTime::Now() - start);
+  RETURN_NOT_OK_HANDLE_ERROR(s);
+
+  // See WriteVData().
+  if (offset + data.size() > preallocated_offset_) {
+    RETURN_NOT_OK_HANDLE_ERROR(data_dir_->RefreshIsFull(DataDir::RefreshMode::ALWAYS));
+  }
+  return Status::OK();
+}
+
 Status LogBlockContainer::ReadData(int64_t offset, Slice result) const {
   DCHECK_GE(offset, 0);
   RETURN_NOT_OK_HANDLE_ERROR(data_file_->Read(offset, result));
@@ -995,6 +1245,12 @@ Status LogBlockContainer::ReadVData(int64_t offset, ArrayView<Slice> results) co
   return Status::OK();
 }
 
+Status LogBlockContainer::PrefetchData(int64_t offset, size_t length) const {
+  DCHECK_GE(offset, 0);
+  RETURN_NOT_OK_HANDLE_ERROR(data_file_->Prefetch(offset, length));
+  return Status::OK();
+}
+
 Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   // Note: We don't check for sufficient disk space for metadata writes in
@@ -1003,6 +1259,14 @@ Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   return Status::OK();
 }
 
+Status LogBlockContainer::AppendMetadata(const vector<const BlockRecordPB*>& pbs) {
+  RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
+  // As above, the disk space isn't checked.
+  vector<const google::protobuf::Message*> msgs(pbs.begin(), pbs.end());
+  RETURN_NOT_OK_HANDLE_ERROR(metadata_file_->AppendBatch(msgs));
+  return Status::OK();
+}
+
 Status LogBlockContainer::FlushData(int64_t offset, int64_t length) {
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   DCHECK_GE(offset, 0);
@@ -1021,7 +1285,11 @@ Status LogBlockContainer::SyncData() {
   RETURN_NOT_OK_HANDLE_ERROR(read_only_status());
   if (FLAGS_enable_data_block_fsync) {
     if (metrics_) metrics_->generic_metrics.total_disk_sync->Increment();
-    RETURN_NOT_OK_HANDLE_ERROR(data_file_->Sync());
+    data_dir_->IOStarted();
+    MonoTime start = MonoTime::Now();
+    Status s = data_file_->Sync();
+    data_dir_->IOFinished(MonoTime::Now() - start);
+    RETURN_NOT_OK_HANDLE_ERROR(s);
   }
   return Status::OK();
 }
@@ -1156,12 +1424,50 @@ void LogBlockContainer::SetReadOnly(const Status& error) {
   read_only_status_ = error;
 }
 
-void LogBlockContainer::ContainerDeletionAsync(int64_t offset, int64_t length) {
-  VLOG(3) << "Freeing space belonging to container " << ToString();
-  Status s = PunchHole(offset, length);
-  if (s.ok() && metrics_) metrics_->holes_punched->Increment();
-  WARN_NOT_OK(s, Substitute("could not delete blocks in container $0",
-                            data_dir()->dir()));
+void LogBlockContainer::QueueHolePunches(vector<pair<int64_t, int64_t>> intervals) {
+  {
+    std::lock_guard<simple_spinlock> l(queued_holes_lock_);
+    if (queued_holes_.empty()) {
+      queued_holes_ = std::move(intervals);
+    } else {
+      queued_holes_.insert(queued_holes_.end(), intervals.begin(), intervals.end());
+    }
+    if (hole_punching_scheduled_) {
+      return;
+    }
+    hole_punching_scheduled_ = true;
+  }
+  ExecClosure(Bind(&LogBlockContainer::PunchQueuedHoles, Unretained(this)));
+}
+
+void LogBlockContainer::PunchQueuedHoles() {
+  while (true) {
+    vector<pair<int64_t, int64_t>> holes;
+    {
+      std::lock_guard<simple_spinlock> l(queued_holes_lock_);
+      if (queued_holes_.empty()) {
+        hole_punching_scheduled_ = false;
+        return;
+      }
+      holes.swap(queued_holes_);
+    }
+    CHECK_OK_PREPEND(CoalesceIntervals<int64_t>(&holes),
+                     Substitute("could not coalesce hole punching for container: $0",
+                                ToString()));
+
+    VLOG(3) << "Freeing space belonging to container " << ToString();
+    for (const auto& hole : holes) {
+      if (hole_punch_throttler_) {
+        while (!hole_punch_throttler_->Take(MonoTime::Now(), 1, 0)) {
+          SleepFor(MonoDelta::FromMicroseconds(Throttler::kRefillPeriodMicros));
+        }
+      }
+      Status s = PunchHole(hole.first, hole.second - hole.first);
+      if (s.ok() && metrics_) metrics_->holes_punched->Increment();
+      WARN_NOT_OK(s, Substitute("could not delete blocks in container $0",
+                                data_dir()->dir()));
+    }
+  }
 }
 
 ///////////////////////////////////////////////////////////
@@ -1260,17 +1566,7 @@ void LogBlockDeletionTransaction::AddDeletedBlock(BlockId block) {
 
 LogBlockDeletionTransaction::~LogBlockDeletionTransaction() {
   for (auto& entry : deleted_interval_map_) {
-    LogBlockContainer* container = entry.first;
-    CHECK_OK_PREPEND(CoalesceIntervals<int64_t>(&entry.second),
-                     Substitute("could not coalesce hole punching for container: $0",
-                                container->ToString()));
-
-    for (const auto& interval : entry.second) {
-      container->ExecClosure(Bind(&LogBlockContainer::ContainerDeletionAsync,
-                                  Unretained(container),
-                                  interval.first,
-                                  interval.second - interval.first));
-    }
+    entry.first->QueueHolePunches(std::move(entry.second));
   }
 }
 
@@ -1352,12 +1648,17 @@ void LogBlock::RegisterDeletion(
 ////////////////////////////////////////////////////////////
 
 LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
-                                   BlockId block_id, int64_t block_offset)
+                                   BlockId block_id, int64_t block_offset,
+                                   IOClass io_class)
     : container_(container),
       block_id_(block_id),
       block_offset_(block_offset),
       block_length_(0),
-      state_(CLEAN) {
+      io_class_(io_class),
+      state_(CLEAN),
+      direct_io_buf_size_(0),
+      direct_io_buf_len_(0),
+      direct_io_unsupported_(false) {
   DCHECK_GE(block_offset, 0);
   DCHECK_EQ(0, block_offset % container->instance()->filesystem_block_size_bytes());
   if (container->metrics()) {
@@ -1455,9 +1756,38 @@ Status LogWritableBlock::AppendV(ArrayView<const Slice> data) {
   // it now because the block's length is still in flux.
   int64_t cur_block_offset = block_offset_ + block_length_;
   RETURN_NOT_OK(container_->EnsurePreallocated(cur_block_offset, data_size));
+  container_->data_dir()->io_scheduler()->Admit(io_class_, data_size);
 
   MicrosecondsInt64 start_time = GetMonoTimeMicros();
-  RETURN_NOT_OK(container_->WriteVData(cur_block_offset, data));
+  if (FLAGS_log_container_direct_io) {
+    if (!direct_io_buf_) {
+      size_t fs_block_size = container_->instance()->filesystem_block_size_bytes();
+      direct_io_buf_size_ = KUDU_ALIGN_UP(FLAGS_log_container_direct_io_buffer_bytes,
+                                          fs_block_size);
+      direct_io_buf_.reset(static_cast<uint8_t*>(
+          aligned_malloc(direct_io_buf_size_, fs_block_size)));
+      if (!direct_io_buf_) {
+        return Status::RuntimeError("unable to allocate direct I/O buffer");
+      }
+    }
+    // Combine the appends, writing out the buffer each time it fills up.
+    for (const Slice& s : data) {
+      size_t copied = 0;
+      while (copied < s.size()) {
+        size_t n = std::min(s.size() - copied, direct_io_buf_size_ - direct_io_buf_len_);
+        memcpy(direct_io_buf_.get() + direct_io_buf_len_, s.data() + copied, n);
+        direct_io_buf_len_ += n;
+        copied += n;
+        block_length_ += n;
+        if (direct_io_buf_len_ == direct_io_buf_size_) {
+          RETURN_NOT_OK(WriteDirectIOBuffer());
+        }
+      }
+    }
+  } else {
+    RETURN_NOT_OK(container_->WriteVData(cur_block_offset, data));
+    block_length_ += data_size;
+  }
   MicrosecondsInt64 end_time = GetMonoTimeMicros();
 
   int64_t dur = end_time - start_time;
@@ -1465,11 +1795,56 @@ Status LogWritableBlock::AppendV(ArrayView<const Slice> data) {
   const char* counter = BUCKETED_COUNTER_NAME("lbm_writes", dur);
   TRACE_COUNTER_INCREMENT(counter, 1);
 
-  block_length_ += data_size;
   state_ = DIRTY;
   return Status::OK();
 }
 
+Status LogWritableBlock::WriteDirectIOBuffer() {
+  DCHECK_GT(direct_io_buf_len_, 0);
+  int64_t write_offset = block_offset_ + block_length_ - direct_io_buf_len_;
+  if (!direct_data_file_ && !direct_io_unsupported_) {
+    Status s = container_->OpenDirectDataFile(&direct_data_file_);
+    if (s.IsNotSupported() || s.posix_code() == EINVAL) {
+      KLOG_FIRST_N(WARNING, 1) << "Direct I/O is not supported for container "
+                               << container_->ToString() << ", using buffered writes: "
+                               << s.ToString();
+      direct_io_unsupported_ = true;
+    } else {
+      RETURN_NOT_OK(s);
+    }
+  }
+  if (direct_io_unsupported_) {
+    Slice buffered(direct_io_buf_.get(), direct_io_buf_len_);
+    direct_io_buf_len_ = 0;
+    return container_->WriteData(write_offset, buffered);
+  }
+
+  // The block starts on a file system block boundary, and so does the data
+  // that follows it, hence zeroing the padding doesn't overwrite anything.
+  size_t fs_block_size = container_->instance()->filesystem_block_size_bytes();
+  size_t write_len = KUDU_ALIGN_UP(direct_io_buf_len_, fs_block_size);
+  memset(direct_io_buf_.get() + direct_io_buf_len_, 0, write_len - direct_io_buf_len_);
+  direct_io_buf_len_ = 0;
+  return container_->WriteDirectData(direct_data_file_.get(), write_offset,
+                                     Slice(direct_io_buf_.get(), write_len));
+}
+
+Status LogWritableBlock::FinishDirectIO() {
+  if (!direct_io_buf_) {
+    return Status::OK();
+  }
+  if (direct_io_buf_len_ > 0) {
+    RETURN_NOT_OK(WriteDirectIOBuffer());
+  }
+  direct_io_buf_.reset();
+  direct_io_buf_size_ = 0;
+  if (direct_data_file_) {
+    RETURN_NOT_OK(direct_data_file_->Close());
+    direct_data_file_.reset();
+  }
+  return Status::OK();
+}
+
 Status LogWritableBlock::FlushDataAsync() {
   VLOG(3) << "Flushing block " << id();
   RETURN_NOT_OK(container_->FlushData(block_offset_, block_length_));
@@ -1490,6 +1865,7 @@ Status LogWritableBlock::Finalize() {
   });
 
   VLOG(3) << "Finalizing block " << id();
+  RETURN_NOT_OK(FinishDirectIO());
   if (state_ == DIRTY &&
       FLAGS_block_manager_preflush_control == "finalize") {
     // We do not mark the container as read-only if FlushDataAsync() fails
@@ -1567,6 +1943,8 @@ class LogReadableBlock : public ReadableBlock {
 
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const OVERRIDE;
 
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -1653,6 +2031,7 @@ Status LogReadableBlock::ReadV(uint64_t offset, ArrayView<Slice> results) const
 
   int64_t dur = end_time - start_time;
   TRACE_COUNTER_INCREMENT("lbm_read_time_us", dur);
+  TRACE_COUNTER_INCREMENT("lbm_read_bytes", read_length);
 
   const char* counter = BUCKETED_COUNTER_NAME("lbm_reads", dur);
   TRACE_COUNTER_INCREMENT(counter, 1);
@@ -1663,6 +2042,17 @@ Status LogReadableBlock::ReadV(uint64_t offset, ArrayView<Slice> results) const
   return Status::OK();
 }
 
+Status LogReadableBlock::Prefetch(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  // Clamp the range to the block, so as not to read into its neighbours.
+  if (offset >= log_block_->length()) {
+    return Status::OK();
+  }
+  length = std::min<uint64_t>(length, log_block_->length() - offset);
+  return container_->PrefetchData(log_block_->offset() + offset, length);
+}
+
 size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
@@ -1675,6 +2065,7 @@ size_t LogReadableBlock::memory_footprint() const {
 
 const char* LogBlockManager::kContainerMetadataFileSuffix = ".metadata";
 const char* LogBlockManager::kContainerDataFileSuffix = ".data";
+const char* LogBlockManager::kCheckpointFileName = "log_block_manager_checkpoint";
 
 // These values were arrived at via experimentation. See commit 4923a74 for
 // more details.
@@ -1780,6 +2171,12 @@ Status LogBlockManager::Open(FsReport* report) {
           dd->dir(), *limit);
     }
     InsertOrDie(&block_limits_by_data_dir_, dd.get(), limit);
+
+    if (FLAGS_log_container_max_hole_punches_per_sec > 0) {
+      InsertOrDie(&hole_punch_throttlers_by_data_dir_, dd.get(),
+                  unique_ptr<Throttler>(new Throttler(
+                      MonoTime::Now(), FLAGS_log_container_max_hole_punches_per_sec, 0, 1.0)));
+    }
   }
 
   vector<FsReport> reports(dd_manager_->data_dirs().size());
@@ -1861,7 +2258,8 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
 
   block->reset(new LogWritableBlock(container,
                                     new_block_id,
-                                    container->next_block_offset()));
+                                    container->next_block_offset(),
+                                    opts.io_class));
   VLOG(3) << "Created block " << (*block)->id() << " in container "
           << container->ToString();
   return Status::OK();
@@ -2092,18 +2490,33 @@ Status LogBlockManager::RemoveLogBlocks(vector<BlockId> block_ids,
     metrics()->bytes_under_management->DecrementBy(blocks_length);
   }
 
+  // Group the blocks by container so that their deletions can be recorded
+  // with a single metadata append per container.
+  unordered_map<LogBlockContainer*, vector<scoped_refptr<LogBlock>>> lbs_by_container;
   for (auto& lb : lbs) {
     VLOG(3) << "Deleting block " << lb->block_id();
     lb->container()->BlockDeleted(lb);
+    lbs_by_container[lb->container()].emplace_back(std::move(lb));
+  }
 
-    // Record the on-disk deletion.
+  const int64_t now_us = GetCurrentTimeMicros();
+  for (auto& e : lbs_by_container) {
+    LogBlockContainer* container = e.first;
+    vector<scoped_refptr<LogBlock>>& container_lbs = e.second;
+
+    // Record the on-disk deletions.
     //
-    // TODO(unknown): what if this fails? Should we restore the in-memory block?
-    BlockRecordPB record;
-    lb->block_id().CopyToPB(record.mutable_block_id());
-    record.set_op_type(DELETE);
-    record.set_timestamp_us(GetCurrentTimeMicros());
-    Status s = lb->container()->AppendMetadata(record);
+    // TODO(unknown): what if this fails? Should we restore the in-memory blocks?
+    vector<BlockRecordPB> records(container_lbs.size());
+    vector<const BlockRecordPB*> record_ptrs;
+    record_ptrs.reserve(records.size());
+    for (int i = 0; i < container_lbs.size(); i++) {
+      container_lbs[i]->block_id().CopyToPB(records[i].mutable_block_id());
+      records[i].set_op_type(DELETE);
+      records[i].set_timestamp_us(now_us);
+      record_ptrs.push_back(&records[i]);
+    }
+    Status s = container->AppendMetadata(record_ptrs);
 
     // We don't bother fsyncing the metadata append for deletes in order to avoid
     // the disk overhead. Even if we did fsync it, we'd still need to account for
@@ -2115,11 +2528,13 @@ Status LogBlockManager::RemoveLogBlocks(vector<BlockId> block_ids,
     if (!s.ok()) {
       if (first_failure.ok()) {
         first_failure = s.CloneAndPrepend(
-            "Unable to append deletion record to block metadata");
+            "Unable to append deletion records to block metadata");
       }
     } else {
-      deleted->emplace_back(lb->block_id());
-      log_blocks->emplace_back(std::move(lb));
+      for (auto& lb : container_lbs) {
+        deleted->emplace_back(lb->block_id());
+        log_blocks->emplace_back(std::move(lb));
+      }
     }
   }
 
@@ -2156,6 +2571,268 @@ Status LogBlockManager::RemoveLogBlockUnlocked(const BlockId& block_id,
   return Status::OK();
 }
 
+struct LogBlockManager::ContainerLoadResult {
+  // The consistency checks of the container.
+  FsReport report;
+
+  // Any unhandled error encountered while loading the container.
+  Status status;
+
+  // The container's path, set if the container was loaded.
+  string container_path;
+
+  // Whether the container is full and has no live blocks, and should be
+  // deleted during repair.
+  bool dead = false;
+
+  // Whether the container's metadata file should be compacted during repair,
+  // down to 'live_block_records'.
+  bool compact_metadata = false;
+  vector<BlockRecordPB> live_block_records;
+
+  // Deleted blocks whose space should be repunched during repair.
+  vector<scoped_refptr<internal::LogBlock>> need_repunching;
+
+  // The state of the container, as of the end of its metadata file, for the
+  // next checkpoint of the data directory.
+  LogBlockContainerCheckpointPB checkpoint;
+};
+
+void LogBlockManager::LoadContainer(DataDir* dir,
+                                    const string& container_name,
+                                    const LogBlockContainerCheckpointPB* checkpoint,
+                                    ContainerLoadResult* result) {
+  // The checks performed by OpenDataDir(), recorded for this container.
+  result->report.full_container_space_check.emplace();
+  result->report.incomplete_container_check.emplace();
+  result->report.malformed_record_check.emplace();
+  result->report.misaligned_block_check.emplace();
+  result->report.partial_record_check.emplace();
+
+  unique_ptr<LogBlockContainer> container;
+  Status s = LogBlockContainer::Open(
+      this, dir, &result->report, container_name, &container);
+  if (s.IsAborted()) {
+    // Skip the container. Open() added a record of it to the report for us.
+    return;
+  }
+  if (!s.ok()) {
+    result->status = s.CloneAndPrepend(Substitute(
+        "Could not open container $0", container_name));
+    return;
+  }
+  result->container_path = container->ToString();
+
+  // Process the records, building a container-local map for live blocks and
+  // a list of dead blocks.
+  //
+  // It's important that we don't try to add these blocks to the global map
+  // incrementally as we see each record, since it's possible that one container
+  // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
+  // If we processed those two containers in this order, then upon processing
+  // the second container, we'd think there was a duplicate block. Building
+  // the container-local map first ensures that we discount deleted blocks
+  // before checking for duplicate IDs.
+  //
+  // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
+  // exceedingly unlikely. However, we might have old data which still exhibits
+  // the above issue.
+  UntrackedBlockMap live_blocks;
+  BlockRecordMap live_block_records;
+  vector<scoped_refptr<internal::LogBlock>> dead_blocks;
+  uint64_t max_block_id = 0;
+  uint64_t metadata_offset = 0;
+  s = container->ProcessRecords(checkpoint,
+                                &result->report,
+                                &live_blocks,
+                                &live_block_records,
+                                &dead_blocks,
+                                &max_block_id,
+                                &metadata_offset);
+  if (!s.ok()) {
+    result->status = s.CloneAndPrepend(Substitute(
+        "Could not process records in container $0", container->ToString()));
+    return;
+  }
+
+  // Describe the container's new state for the next checkpoint, with the
+  // blocks sorted by ID.
+  LogBlockContainerCheckpointPB* new_checkpoint = &result->checkpoint;
+  new_checkpoint->set_container_id(container_name);
+  new_checkpoint->set_metadata_offset(metadata_offset);
+  new_checkpoint->set_next_block_offset(container->next_block_offset());
+  new_checkpoint->set_total_bytes(container->total_bytes());
+  new_checkpoint->set_total_blocks(container->total_blocks());
+  {
+    vector<const BlockRecordPB*> sorted_records;
+    sorted_records.reserve(live_block_records.size());
+    for (const auto& e : live_block_records) {
+      sorted_records.push_back(&e.second);
+    }
+    std::sort(sorted_records.begin(), sorted_records.end(),
+              [](const BlockRecordPB* a, const BlockRecordPB* b) {
+      return a->block_id().id() < b->block_id().id();
+    });
+    for (const auto* r : sorted_records) {
+      new_checkpoint->add_block_ids(r->block_id().id());
+      new_checkpoint->add_offsets(r->offset());
+      new_checkpoint->add_lengths(r->length());
+      new_checkpoint->add_timestamps_us(r->timestamp_us());
+    }
+  }
+
+  // With deleted blocks out of the way, check for misaligned blocks.
+  //
+  // We could also enforce that the record's offset is aligned with the
+  // underlying filesystem's block size, an invariant maintained by the log
+  // block manager. However, due to KUDU-1793, that invariant may have been
+  // broken, so we'll note but otherwise allow it.
+  for (const auto& e : live_blocks) {
+    if (PREDICT_FALSE(e.second->offset() %
+                      container->instance()->filesystem_block_size_bytes() != 0)) {
+      result->report.misaligned_block_check->entries.emplace_back(
+          container->ToString(), e.first);
+
+    }
+  }
+
+  if (container->full()) {
+    // Full containers without any live blocks can be deleted outright.
+    //
+    // TODO(adar): this should be reported as an inconsistency once dead
+    // container deletion is also done in real time. Until then, it would be
+    // confusing to report it as such since it'll be a natural event at startup.
+    if (container->live_blocks() == 0) {
+      DCHECK(live_blocks.empty());
+      result->dead = true;
+    } else if (static_cast<double>(container->live_blocks()) /
+        container->total_blocks() <= FLAGS_log_container_live_metadata_before_compact_ratio) {
+      // Metadata files of containers with very few live blocks will be compacted.
+      //
+      // TODO(adar): this should be reported as an inconsistency once
+      // container metadata compaction is also done in realtime. Until then,
+      // it would be confusing to report it as such since it'll be a natural
+      // event at startup.
+      vector<BlockRecordPB> records(live_block_records.size());
+      int i = 0;
+      for (auto& e : live_block_records) {
+        records[i].Swap(&e.second);
+        i++;
+      }
+
+      // Sort the records such that their ordering reflects the ordering in
+      // the pre-compacted metadata file.
+      //
+      // This is preferred to storing the records in an order-preserving
+      // container (such as std::map) because while records are temporarily
+      // retained for every container, only some containers will actually
+      // undergo metadata compaction.
+      std::sort(records.begin(), records.end(),
+                [](const BlockRecordPB& a, const BlockRecordPB& b) {
+        // Sort by timestamp.
+        if (a.timestamp_us() != b.timestamp_us()) {
+          return a.timestamp_us() < b.timestamp_us();
+        }
+
+        // If the timestamps match, sort by offset.
+        //
+        // If the offsets also match (i.e. both blocks are of zero length),
+        // it doesn't matter which of the two records comes first.
+        return a.offset() < b.offset();
+      });
+
+      result->compact_metadata = true;
+      result->live_block_records = std::move(records);
+
+      // Once compacted, the metadata file only has the live blocks.
+      new_checkpoint->set_total_bytes(container->live_bytes_aligned());
+      new_checkpoint->set_total_blocks(container->live_blocks());
+    }
+
+    // Having processed the block records, let's check whether any full
+    // containers have any extra space (left behind after a crash or from an
+    // older version of Kudu).
+    //
+    // Filesystems are unpredictable beasts and may misreport the amount of
+    // space allocated to a file in various interesting ways. Some examples:
+    // - XFS's speculative preallocation feature may artificially enlarge the
+    //   container's data file without updating its file size. This makes the
+    //   file size untrustworthy for the purposes of measuring allocated space.
+    //   See KUDU-1856 for more details.
+    // - On el6.6/ext4 a container data file that consumed ~32K according to
+    //   its extent tree was actually reported as consuming an additional fs
+    //   block (2k) of disk space. A similar container data file (generated
+    //   via the same workload) on Ubuntu 16.04/ext4 did not exhibit this.
+    //   The suspicion is that older versions of ext4 include interior nodes
+    //   of the extent tree when reporting file block usage.
+    //
+    // To deal with these issues, our extra space cleanup code (deleted block
+    // repunching and container truncation) is gated on an "actual disk space
+    // consumed" heuristic. To prevent unnecessary triggering of the
+    // heuristic, we allow for some slop in our size measurements. The exact
+    // amount of slop is configurable via
+    // log_container_excess_space_before_cleanup_fraction.
+    //
+    // Too little slop and we'll do unnecessary work at startup. Too much and
+    // more unused space may go unreclaimed.
+    string data_filename = StrCat(container->ToString(), kContainerDataFileSuffix);
+    uint64_t reported_size;
+    s = env_->GetFileSizeOnDisk(data_filename, &reported_size);
+    if (!s.ok()) {
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(
+          ErrorHandlerType::DISK_ERROR, dir));
+      result->status = s.CloneAndPrepend(Substitute(
+          "Could not get on-disk file size of container $0", container->ToString()));
+      return;
+    }
+    int64_t cleanup_threshold_size = container->live_bytes_aligned() *
+        (1 + FLAGS_log_container_excess_space_before_cleanup_fraction);
+    if (reported_size > cleanup_threshold_size) {
+      result->report.full_container_space_check->entries.emplace_back(
+          container->ToString(), reported_size - container->live_bytes_aligned());
+
+      // If the container is to be deleted outright, don't bother repunching
+      // its blocks. The report entry remains, however, so it's clear that
+      // there was a space discrepancy.
+      if (container->live_blocks()) {
+        result->need_repunching = std::move(dead_blocks);
+      }
+    }
+
+    result->report.stats.lbm_full_container_count++;
+  }
+  result->report.stats.live_block_bytes += container->live_bytes();
+  result->report.stats.live_block_bytes_aligned += container->live_bytes_aligned();
+  result->report.stats.live_block_count += container->live_blocks();
+  result->report.stats.lbm_container_count++;
+
+  next_block_id_.StoreMax(max_block_id + 1);
+
+  // Under the lock, merge this map into the main block map and add
+  // the container.
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    // To avoid cacheline contention during startup, we aggregate all of the
+    // memory in a local and add it to the mem-tracker in a single increment
+    // at the end of this loop.
+    int64_t mem_usage = 0;
+    for (UntrackedBlockMap::value_type& e : live_blocks) {
+      int block_mem = kudu_malloc_usable_size(e.second.get());
+      if (!AddLogBlockUnlocked(std::move(e.second))) {
+        // TODO(adar): track as an inconsistency?
+        LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
+                   << " which already is alive from another container when "
+                   << " processing container " << container->ToString();
+      }
+      mem_usage += block_mem;
+    }
+
+    mem_tracker_->Consume(mem_usage);
+    AddNewContainerUnlocked(container.get());
+    MakeContainerAvailableUnlocked(container.release());
+  }
+}
+
 void LogBlockManager::OpenDataDir(DataDir* dir,
                                   FsReport* report,
                                   Status* result_status) {
@@ -2184,6 +2861,18 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
   // files will be compacted during repair.
   unordered_map<string, vector<BlockRecordPB>> low_live_block_containers;
 
+  // Load the checkpoint of the containers' state, if there's one.
+  const string checkpoint_path = JoinPathSegments(dir->dir(), kCheckpointFileName);
+  unordered_map<string, LogBlockContainerCheckpointPB> checkpoints;
+  if (FLAGS_log_block_manager_checkpoint) {
+    Status s = ReadCheckpoint(checkpoint_path, &checkpoints);
+    if (!s.ok() && !s.IsNotFound()) {
+      LOG(WARNING) << Substitute("Not using checkpoint $0: $1",
+                                 checkpoint_path, s.ToString());
+      checkpoints.clear();
+    }
+  }
+
   // Find all containers and open them.
   unordered_set<string> containers_seen;
   vector<string> children;
@@ -2195,7 +2884,7 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
         "Could not list children of $0", dir->dir()));
     return;
   }
-  MonoTime last_opened_container_log_time = MonoTime::Now();
+  vector<string> container_names;
   for (const string& child : children) {
     string container_name;
     if (!TryStripSuffixString(
@@ -2207,202 +2896,90 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
     if (!InsertIfNotPresent(&containers_seen, container_name)) {
       continue;
     }
+    container_names.emplace_back(std::move(container_name));
+  }
 
-    unique_ptr<LogBlockContainer> container;
-    s = LogBlockContainer::Open(
-        this, dir, &local_report, container_name, &container);
-    if (s.IsAborted()) {
-      // Skip the container. Open() added a record of it to 'local_report' for us.
-      continue;
-    }
+  // Open the containers and process their records in parallel. A single
+  // data directory may hold hundreds of thousands of containers, so doing it
+  // serially would dominate the startup time.
+  //
+  // Env doesn't tell where the container files are located on disk, so they
+  // are submitted in directory listing order.
+  gscoped_ptr<ThreadPool> pool;
+  s = ThreadPoolBuilder(Substitute("lbm load $0", dir->dir()))
+      .set_max_threads(FLAGS_log_container_load_threads_per_dir)
+      .set_trace_metric_prefix("lbm load")
+      .Build(&pool);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not create container loading pool for $0", dir->dir()));
+    return;
+  }
+  vector<ContainerLoadResult> results(container_names.size());
+  AtomicInt<int64_t> containers_loaded(0);
+  for (int i = 0; i < container_names.size(); i++) {
+    ContainerLoadResult* result = &results[i];
+    const string* container_name = &container_names[i];
+    const LogBlockContainerCheckpointPB* checkpoint = FindOrNull(checkpoints, *container_name);
+    s = pool->SubmitFunc([this, dir, container_name, checkpoint, result, &containers_loaded]() {
+      LoadContainer(dir, *container_name, checkpoint, result);
+      containers_loaded.Increment();
+    });
     if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", container_name));
-      return;
+      WARN_NOT_OK(s, "Could not submit container loading task, running it synchronously");
+      LoadContainer(dir, *container_name, checkpoint, result);
+      containers_loaded.Increment();
     }
+  }
 
-    // Process the records, building a container-local map for live blocks and
-    // a list of dead blocks.
-    //
-    // It's important that we don't try to add these blocks to the global map
-    // incrementally as we see each record, since it's possible that one container
-    // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
-    // If we processed those two containers in this order, then upon processing
-    // the second container, we'd think there was a duplicate block. Building
-    // the container-local map first ensures that we discount deleted blocks
-    // before checking for duplicate IDs.
-    //
-    // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
-    // exceedingly unlikely. However, we might have old data which still exhibits
-    // the above issue.
-    UntrackedBlockMap live_blocks;
-    BlockRecordMap live_block_records;
-    vector<scoped_refptr<internal::LogBlock>> dead_blocks;
-    uint64_t max_block_id = 0;
-    s = container->ProcessRecords(&local_report,
-                                  &live_blocks,
-                                  &live_block_records,
-                                  &dead_blocks,
-                                  &max_block_id);
-    if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not process records in container $0", container->ToString()));
+  // Log number of containers opened every 10 seconds.
+  while (!pool->WaitFor(MonoDelta::FromSeconds(10))) {
+    LOG(INFO) << Substitute("Opened $0 log block containers in $1",
+                            containers_loaded.Load(), dir->dir());
+  }
+  pool->Shutdown();
+
+  // Merge the results in order, so the report and repairs don't depend on the
+  // order in which the containers happened to be loaded.
+  for (int i = 0; i < results.size(); i++) {
+    ContainerLoadResult& result = results[i];
+    if (!result.status.ok()) {
+      *result_status = result.status;
       return;
     }
-
-    // With deleted blocks out of the way, check for misaligned blocks.
-    //
-    // We could also enforce that the record's offset is aligned with the
-    // underlying filesystem's block size, an invariant maintained by the log
-    // block manager. However, due to KUDU-1793, that invariant may have been
-    // broken, so we'll note but otherwise allow it.
-    for (const auto& e : live_blocks) {
-      if (PREDICT_FALSE(e.second->offset() %
-                        container->instance()->filesystem_block_size_bytes() != 0)) {
-        local_report.misaligned_block_check->entries.emplace_back(
-            container->ToString(), e.first);
-
-      }
+    local_report.MergeFrom(result.report);
+    if (result.dead) {
+      dead_containers.emplace_back(result.container_path);
     }
-
-    if (container->full()) {
-      // Full containers without any live blocks can be deleted outright.
-      //
-      // TODO(adar): this should be reported as an inconsistency once dead
-      // container deletion is also done in real time. Until then, it would be
-      // confusing to report it as such since it'll be a natural event at startup.
-      if (container->live_blocks() == 0) {
-        DCHECK(live_blocks.empty());
-        dead_containers.emplace_back(container->ToString());
-      } else if (static_cast<double>(container->live_blocks()) /
-          container->total_blocks() <= FLAGS_log_container_live_metadata_before_compact_ratio) {
-        // Metadata files of containers with very few live blocks will be compacted.
-        //
-        // TODO(adar): this should be reported as an inconsistency once
-        // container metadata compaction is also done in realtime. Until then,
-        // it would be confusing to report it as such since it'll be a natural
-        // event at startup.
-        vector<BlockRecordPB> records(live_block_records.size());
-        int i = 0;
-        for (auto& e : live_block_records) {
-          records[i].Swap(&e.second);
-          i++;
-        }
-
-        // Sort the records such that their ordering reflects the ordering in
-        // the pre-compacted metadata file.
-        //
-        // This is preferred to storing the records in an order-preserving
-        // container (such as std::map) because while records are temporarily
-        // retained for every container, only some containers will actually
-        // undergo metadata compaction.
-        std::sort(records.begin(), records.end(),
-                  [](const BlockRecordPB& a, const BlockRecordPB& b) {
-          // Sort by timestamp.
-          if (a.timestamp_us() != b.timestamp_us()) {
-            return a.timestamp_us() < b.timestamp_us();
-          }
-
-          // If the timestamps match, sort by offset.
-          //
-          // If the offsets also match (i.e. both blocks are of zero length),
-          // it doesn't matter which of the two records comes first.
-          return a.offset() < b.offset();
-        });
-
-        low_live_block_containers[container->ToString()] = std::move(records);
-      }
-
-      // Having processed the block records, let's check whether any full
-      // containers have any extra space (left behind after a crash or from an
-      // older version of Kudu).
-      //
-      // Filesystems are unpredictable beasts and may misreport the amount of
-      // space allocated to a file in various interesting ways. Some examples:
-      // - XFS's speculative preallocation feature may artificially enlarge the
-      //   container's data file without updating its file size. This makes the
-      //   file size untrustworthy for the purposes of measuring allocated space.
-      //   See KUDU-1856 for more details.
-      // - On el6.6/ext4 a container data file that consumed ~32K according to
-      //   its extent tree was actually reported as consuming an additional fs
-      //   block (2k) of disk space. A similar container data file (generated
-      //   via the same workload) on Ubuntu 16.04/ext4 did not exhibit this.
-      //   The suspicion is that older versions of ext4 include interior nodes
-      //   of the extent tree when reporting file block usage.
-      //
-      // To deal with these issues, our extra space cleanup code (deleted block
-      // repunching and container truncation) is gated on an "actual disk space
-      // consumed" heuristic. To prevent unnecessary triggering of the
-      // heuristic, we allow for some slop in our size measurements. The exact
-      // amount of slop is configurable via
-      // log_container_excess_space_before_cleanup_fraction.
-      //
-      // Too little slop and we'll do unnecessary work at startup. Too much and
-      // more unused space may go unreclaimed.
-      string data_filename = StrCat(container->ToString(), kContainerDataFileSuffix);
-      uint64_t reported_size;
-      s = env_->GetFileSizeOnDisk(data_filename, &reported_size);
-      if (!s.ok()) {
-        HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(
-            ErrorHandlerType::DISK_ERROR, dir));
-        *result_status = s.CloneAndPrepend(Substitute(
-            "Could not get on-disk file size of container $0", container->ToString()));
-        return;
-      }
-      int64_t cleanup_threshold_size = container->live_bytes_aligned() *
-          (1 + FLAGS_log_container_excess_space_before_cleanup_fraction);
-      if (reported_size > cleanup_threshold_size) {
-        local_report.full_container_space_check->entries.emplace_back(
-            container->ToString(), reported_size - container->live_bytes_aligned());
-
-        // If the container is to be deleted outright, don't bother repunching
-        // its blocks. The report entry remains, however, so it's clear that
-        // there was a space discrepancy.
-        if (container->live_blocks()) {
-          need_repunching.insert(need_repunching.end(),
-                                 dead_blocks.begin(), dead_blocks.end());
-        }
-      }
-
-      local_report.stats.lbm_full_container_count++;
+    if (result.compact_metadata) {
+      low_live_block_containers[result.container_path] =
+          std::move(result.live_block_records);
     }
-    local_report.stats.live_block_bytes += container->live_bytes();
-    local_report.stats.live_block_bytes_aligned += container->live_bytes_aligned();
-    local_report.stats.live_block_count += container->live_blocks();
-    local_report.stats.lbm_container_count++;
+    need_repunching.insert(need_repunching.end(),
+                           std::make_move_iterator(result.need_repunching.begin()),
+                           std::make_move_iterator(result.need_repunching.end()));
+  }
 
-    // Log number of containers opened every 10 seconds
-    MonoTime now = MonoTime::Now();
-    if ((now - last_opened_container_log_time).ToSeconds() > 10) {
-      LOG(INFO) << Substitute("Opened $0 log block containers in $1",
-                              local_report.stats.lbm_container_count, dir->dir());
-      last_opened_container_log_time = now;
+  // Compacting metadata files invalidates the checkpoint, so it must be
+  // durably deleted first. The same goes if checkpointing is disabled, lest
+  // a stale checkpoint be used once it's enabled again.
+  unordered_set<string> compacted_containers;
+  for (const auto& e : low_live_block_containers) {
+    compacted_containers.insert(e.first);
+  }
+  if (!opts_.read_only &&
+      (!compacted_containers.empty() || !FLAGS_log_block_manager_checkpoint) &&
+      env_->FileExists(checkpoint_path)) {
+    s = env_->DeleteFile(checkpoint_path);
+    if (s.ok()) {
+      s = env_->SyncDir(dir->dir());
     }
-
-    next_block_id_.StoreMax(max_block_id + 1);
-
-    // Under the lock, merge this map into the main block map and add
-    // the container.
-    {
-      std::lock_guard<simple_spinlock> l(lock_);
-      // To avoid cacheline contention during startup, we aggregate all of the
-      // memory in a local and add it to the mem-tracker in a single increment
-      // at the end of this loop.
-      int64_t mem_usage = 0;
-      for (UntrackedBlockMap::value_type& e : live_blocks) {
-        int block_mem = kudu_malloc_usable_size(e.second.get());
-        if (!AddLogBlockUnlocked(std::move(e.second))) {
-          // TODO(adar): track as an inconsistency?
-          LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
-                     << " which already is alive from another container when "
-                     << " processing container " << container->ToString();
-        }
-        mem_usage += block_mem;
-      }
-
-      mem_tracker_->Consume(mem_usage);
-      AddNewContainerUnlocked(container.get());
-      MakeContainerAvailableUnlocked(container.release());
+    if (!s.ok()) {
+      HANDLE_DISK_FAILURE(s, error_manager_->RunErrorNotificationCb(
+          ErrorHandlerType::DISK_ERROR, dir));
+      *result_status = s.CloneAndPrepend(Substitute(
+          "Could not delete checkpoint $0", checkpoint_path));
+      return;
     }
   }
 
@@ -2420,6 +2997,35 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
     return;
   }
 
+  // Checkpoint the state of the repaired containers, so that the next startup
+  // only needs to replay the metadata written from now on. Failures aren't
+  // fatal: the containers' metadata will be replayed in full instead.
+  if (!opts_.read_only && FLAGS_log_block_manager_checkpoint &&
+      !local_report.HasFatalErrors()) {
+    vector<LogBlockContainerCheckpointPB*> new_checkpoints;
+    for (auto& result : results) {
+      if (result.container_path.empty() || result.dead) {
+        // The container was skipped or deleted during repair.
+        continue;
+      }
+      if (ContainsKey(compacted_containers, result.container_path)) {
+        uint64_t metadata_size;
+        s = env_->GetFileSize(StrCat(result.container_path, kContainerMetadataFileSuffix),
+                              &metadata_size);
+        if (!s.ok()) {
+          // Leave the container out of the checkpoint.
+          continue;
+        }
+        result.checkpoint.set_metadata_offset(metadata_size);
+      }
+      new_checkpoints.push_back(&result.checkpoint);
+    }
+    if (!new_checkpoints.empty()) {
+      WARN_NOT_OK(WriteCheckpoint(dir, checkpoint_path, new_checkpoints),
+                  Substitute("Could not write checkpoint $0", checkpoint_path));
+    }
+  }
+
   *report = std::move(local_report);
   *result_status = Status::OK();
 }
@@ -2731,6 +3337,65 @@ Status LogBlockManager::RewriteMetadataFile(const LogBlockContainer& container,
   return Status::OK();
 }
 
+Status LogBlockManager::ReadCheckpoint(
+    const string& path,
+    unordered_map<string, LogBlockContainerCheckpointPB>* checkpoints) {
+  unique_ptr<RandomAccessFile> reader;
+  RETURN_NOT_OK(env_->NewRandomAccessFile(path, &reader));
+  ReadablePBContainerFile pb_reader(std::move(reader));
+  RETURN_NOT_OK(pb_reader.Open());
+  while (true) {
+    LogBlockContainerCheckpointPB checkpoint;
+    Status s = pb_reader.ReadNextPB(&checkpoint);
+    if (s.IsEndOfFile()) {
+      break;
+    }
+    RETURN_NOT_OK(s);
+    if (ContainsKey(*checkpoints, checkpoint.container_id())) {
+      return Status::Corruption("duplicate container", checkpoint.container_id());
+    }
+    string container_id = checkpoint.container_id();
+    (*checkpoints)[container_id].Swap(&checkpoint);
+  }
+  return pb_reader.Close();
+}
+
+Status LogBlockManager::WriteCheckpoint(
+    DataDir* dir,
+    const string& path,
+    const vector<LogBlockContainerCheckpointPB*>& checkpoints) {
+  // Like RewriteMetadataFile(), write to a temporary file and rename it over
+  // the old checkpoint, if any, once it's fully written.
+  string tmpl = path + kTmpInfix + ".XXXXXX";
+  unique_ptr<RWFile> tmp_file;
+  string tmp_file_name;
+  RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(env_->NewTempRWFile(RWFileOptions(), tmpl,
+                                                             &tmp_file_name, &tmp_file),
+                                         "could not create temporary checkpoint file");
+  auto tmp_deleter = MakeScopedCleanup([&]() {
+    WARN_NOT_OK(env_->DeleteFile(tmp_file_name),
+                "Could not delete file " + tmp_file_name);
+  });
+  WritablePBContainerFile pb_file(std::move(tmp_file));
+  RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(pb_file.CreateNew(LogBlockContainerCheckpointPB()),
+                                         "could not initialize temporary checkpoint file");
+  for (const auto* c : checkpoints) {
+    RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(pb_file.Append(*c),
+                                           "could not append to temporary checkpoint file");
+  }
+  RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(pb_file.Sync(),
+                                         "could not sync temporary checkpoint file");
+  RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(pb_file.Close(),
+                                         "could not close temporary checkpoint file");
+  RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(env_->RenameFile(tmp_file_name, path),
+                                         "could not rename temporary checkpoint file");
+  tmp_deleter.cancel();
+  RETURN_NOT_OK_LBM_DISK_FAILURE_PREPEND(env_->SyncDir(dir->dir()),
+                                         "could not sync data directory");
+  VLOG(1) << Substitute("Checkpointed $0 containers in $1", checkpoints.size(), path);
+  return Status::OK();
+}
+
 std::string LogBlockManager::ContainerPathForTests(internal::LogBlockContainer* container) {
   return container->ToString();
 }
@@ -46,7 +46,9 @@ namespace kudu {
 
 class BlockRecordPB;
 class Env;
+class LogBlockContainerCheckpointPB;
 class RWFile;
+class Throttler;
 
 namespace fs {
 class DataDir;
@@ -182,6 +184,10 @@ class LogBlockManager : public BlockManager {
   static const char* kContainerMetadataFileSuffix;
   static const char* kContainerDataFileSuffix;
 
+  // The name of the file, in each data directory, checkpointing the state of
+  // the directory's containers.
+  static const char* kCheckpointFileName;
+
   // Note: all objects passed as pointers should remain alive for the lifetime
   // of the block manager.
   LogBlockManager(Env* env,
@@ -360,10 +366,43 @@ class LogBlockManager : public BlockManager {
                              const std::vector<BlockRecordPB>& records,
                              int64_t* file_bytes_delta);
 
+  // The outcome of loading a single container of a data directory at startup.
+  struct ContainerLoadResult;
+
+  // Opens the container 'container_name' in 'dir', processes its records, and
+  // adds it and its live blocks to the block manager. The results of its
+  // consistency checking, the repairs it needs, and its state for the next
+  // checkpoint are written to 'result'.
+  //
+  // May be called concurrently for different containers.
+  //
+  // If not null, 'checkpoint' is the container's state as of the data
+  // directory's last checkpoint.
+  void LoadContainer(DataDir* dir,
+                     const std::string& container_name,
+                     const LogBlockContainerCheckpointPB* checkpoint,
+                     ContainerLoadResult* result);
+
+  // Reads the checkpoint at 'path' into 'checkpoints', keyed by container ID.
+  Status ReadCheckpoint(
+      const std::string& path,
+      std::unordered_map<std::string, LogBlockContainerCheckpointPB>* checkpoints);
+
+  // Durably writes 'checkpoints' to 'path' in 'dir', replacing the previous
+  // checkpoint, if any.
+  Status WriteCheckpoint(DataDir* dir,
+                         const std::string& path,
+                         const std::vector<LogBlockContainerCheckpointPB*>& checkpoints);
+
   // Opens a particular data directory belonging to the block manager. The
   // results of consistency checking (and repair, if applicable) are written to
   // 'report'.
   //
+  // The containers of the directory are loaded in parallel, by up to
+  // --log_container_load_threads_per_dir threads, from the directory's
+  // checkpoint if there's one. A new checkpoint is written once the directory
+  // is repaired.
+  //
   // Success or failure is set in 'result_status'.
   void OpenDataDir(DataDir* dir,
                    FsReport* report,
@@ -417,6 +456,11 @@ class LogBlockManager : public BlockManager {
   std::unordered_map<const DataDir*,
                      boost::optional<int64_t>> block_limits_by_data_dir_;
 
+  // Maps a data directory to the throttler of its hole punching, if it's
+  // throttled.
+  std::unordered_map<const DataDir*,
+                     std::unique_ptr<Throttler>> hole_punch_throttlers_by_data_dir_;
+
   // Manages files opened for reading.
   FileCache<RWFile> file_cache_;
 
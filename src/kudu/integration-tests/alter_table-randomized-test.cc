@@ -85,7 +85,8 @@ const vector<KuduColumnStorageAttributes::CompressionType> kCompressionTypes =
     { KuduColumnStorageAttributes::NO_COMPRESSION,
       KuduColumnStorageAttributes::SNAPPY,
       KuduColumnStorageAttributes::LZ4,
-      KuduColumnStorageAttributes::ZLIB };
+      KuduColumnStorageAttributes::ZLIB,
+      KuduColumnStorageAttributes::ZSTD };
 const vector <KuduColumnStorageAttributes::EncodingType> kInt32Encodings =
     { KuduColumnStorageAttributes::PLAIN_ENCODING,
       KuduColumnStorageAttributes::RLE,
@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/integration-tests/cluster_verifier.h"
+#include "kudu/integration-tests/external_mini_cluster-itest-base.h"
+#include "kudu/integration-tests/test_workload.h"
+#include "kudu/mini-cluster/external_mini_cluster.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using kudu::cluster::ExternalTabletServer;
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+class AutoRebalancerITest : public ExternalMiniClusterITestBase {
+};
+
+// Once the leader master rebalances the cluster, a tablet server added to
+// the cluster gets its share of the replicas, while the tablets are written.
+TEST_F(AutoRebalancerITest, TestNewTabletServerGetsReplicas) {
+  const int kNumTablets = 8;
+  const int kNumReplicas = 3;
+  const vector<string> master_flags = {
+    "--auto_rebalancing_interval_seconds=1",
+  };
+  NO_FATALS(StartCluster({}, master_flags, kNumReplicas));
+
+  TestWorkload workload(cluster_.get());
+  workload.set_num_tablets(kNumTablets);
+  workload.set_num_replicas(kNumReplicas);
+  workload.Setup();
+  workload.Start();
+  ASSERT_EVENTUALLY([&] {
+    ASSERT_GT(workload.rows_inserted(), 0);
+  });
+
+  ASSERT_OK(cluster_->AddTabletServer());
+  ExternalTabletServer* new_ts = cluster_->tablet_server(kNumReplicas);
+  ASSERT_OK(cluster_->SetFlag(cluster_->master(), "auto_rebalancing_enabled", "true"));
+
+  // The replicas are balanced once each of the tablet servers hosts a quarter
+  // of them.
+  ASSERT_OK(cluster_->WaitForTabletsRunning(new_ts, kNumTablets * kNumReplicas / 4,
+                                            MonoDelta::FromSeconds(120)));
+  workload.StopAndJoin();
+
+  ClusterVerifier v(cluster_.get());
+  NO_FATALS(v.CheckCluster());
+  NO_FATALS(v.CheckRowCount(workload.table_name(), ClusterVerifier::AT_LEAST,
+                            workload.rows_inserted()));
+}
+
+} // namespace kudu
@@ -675,6 +675,23 @@ TEST_F(RaftConsensusITest, TestInsertAndMutateThroughConsensus) {
   NO_FATALS(AssertAllReplicasAgree(FLAGS_client_inserts_per_thread * num_iters));
 }
 
+// Like TestInsertAndMutateThroughConsensus, with the followers responding to
+// updates once their ops are durable rather than blocking a service thread
+// until then, on a single service thread.
+TEST_F(RaftConsensusITest, TestInsertWithAsyncConsensusUpdates) {
+  NO_FATALS(BuildAndStart({ "--consensus_service_async_updates",
+                            "--consensus_service_num_threads=1" }));
+
+  int num_iters = AllowSlowTests() ? 10 : 1;
+  for (int i = 0; i < num_iters; i++) {
+    InsertTestRowsRemoteThread(i * FLAGS_client_inserts_per_thread,
+                               FLAGS_client_inserts_per_thread,
+                               FLAGS_client_num_batches_per_thread,
+                               vector<CountDownLatch*>());
+  }
+  NO_FATALS(AssertAllReplicasAgree(FLAGS_client_inserts_per_thread * num_iters));
+}
+
 TEST_F(RaftConsensusITest, TestFailedTransaction) {
   NO_FATALS(BuildAndStart());
 
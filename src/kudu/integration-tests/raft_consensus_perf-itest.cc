@@ -0,0 +1,269 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Measures the write throughput and commit latency of a replicated tablet,
+// both in the steady state and while Raft recovers from a fault, so that
+// performance regressions in the consensus implementation show up as
+// changes in the numbers rather than as test failures.
+//
+// Each scenario logs its results as a single JSON object on a line starting
+// with "Results: ", for scripts tracking them across builds.
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gflags/gflags_declare.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/cluster_itest_util.h"
+#include "kudu/integration-tests/raft_consensus-itest-base.h"
+#include "kudu/integration-tests/test_workload.h"
+#include "kudu/mini-cluster/external_mini_cluster.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DEFINE_int32(test_workload_duration_sec, 10,
+             "How long to run the write workload for in each scenario. Faults "
+             "are injected half way through.");
+DEFINE_int32(test_num_write_threads, 4,
+             "Number of threads writing to the tablet.");
+DEFINE_int32(test_write_batch_size, 50,
+             "Number of rows written in each batch.");
+DEFINE_int32(test_raft_heartbeat_interval_ms, 100,
+             "The Raft heartbeat interval for tablet servers under the test.");
+DEFINE_int32(test_log_latency_ms, 20,
+             "The mean latency injected into each WAL sync in the slow disk "
+             "scenario.");
+
+DECLARE_int32(num_replicas);
+
+using kudu::cluster::ExternalTabletServer;
+using kudu::itest::TServerDetails;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+class RaftConsensusPerfITest : public RaftConsensusITestBase {
+ public:
+  RaftConsensusPerfITest()
+      // Up to a minute, with three significant digits.
+      : latency_histogram_(60 * 1000 * 1000, 3) {
+  }
+
+ protected:
+  // Starts the cluster with 'extra_ts_flags' in addition to the flags common
+  // to all scenarios.
+  void StartCluster(vector<string> extra_ts_flags = {}) {
+    vector<string> ts_flags = {
+      Substitute("--raft_heartbeat_interval_ms=$0", FLAGS_test_raft_heartbeat_interval_ms),
+    };
+    ts_flags.insert(ts_flags.end(), extra_ts_flags.begin(), extra_ts_flags.end());
+    NO_FATALS(BuildAndStart(ts_flags));
+  }
+
+  ExternalTabletServer* GetLeader() {
+    TServerDetails* leader;
+    CHECK_OK(GetLeaderReplicaWithRetries(tablet_id_, &leader));
+    return cluster_->tablet_server_by_uuid(leader->uuid());
+  }
+
+  ExternalTabletServer* GetFollower() {
+    TServerDetails* leader;
+    vector<TServerDetails*> followers;
+    CHECK_OK(GetTabletLeaderAndFollowers(tablet_id_, &leader, &followers));
+    CHECK(!followers.empty());
+    return cluster_->tablet_server_by_uuid(followers[0]->uuid());
+  }
+
+  // Runs the write workload for --test_workload_duration_sec and logs the
+  // results of the scenario named 'scenario'.
+  //
+  // If 'inject_fault' is set, it's called half way through the run. If
+  // 'measure_failover' is true, the time it takes for writes to resume after
+  // the fault is measured and reported as the failover time. 'heal_fault',
+  // if set, is then called once writes have resumed or, if failover isn't
+  // measured, after a quarter of the run.
+  void RunScenario(const string& scenario,
+                   const std::function<void()>& inject_fault = nullptr,
+                   bool measure_failover = false,
+                   const std::function<void()>& heal_fault = nullptr) {
+    const int64_t kDurationMs = FLAGS_test_workload_duration_sec * 1000L;
+
+    TestWorkload workload(cluster_.get());
+    workload.set_table_name(kTableId);
+    workload.set_num_replicas(FLAGS_num_replicas);
+    workload.set_num_write_threads(FLAGS_test_num_write_threads);
+    workload.set_write_batch_size(FLAGS_test_write_batch_size);
+    workload.set_write_latency_histogram(&latency_histogram_);
+    // Writes routed to a failed leader may time out or fail while the
+    // client looks for the new one.
+    workload.set_timeout_allowed(true);
+    workload.set_network_error_allowed(true);
+    workload.set_remote_error_allowed(true);
+    workload.Setup();
+
+    MonoTime start = MonoTime::Now();
+    workload.Start();
+    SleepFor(MonoDelta::FromMilliseconds(kDurationMs / 2));
+
+    MonoDelta failover;
+    if (inject_fault) {
+      // Any batches in flight when the fault is injected may still complete,
+      // so writes are only known to have resumed once more rows than that
+      // have been written.
+      int64_t rows_at_fault = workload.rows_inserted() +
+          FLAGS_test_num_write_threads * FLAGS_test_write_batch_size;
+      MonoTime fault_time = MonoTime::Now();
+      inject_fault();
+      if (measure_failover) {
+        MonoTime deadline = fault_time + MonoDelta::FromSeconds(60);
+        while (workload.rows_inserted() <= rows_at_fault) {
+          ASSERT_LT(MonoTime::Now(), deadline) << "writes did not resume after the fault";
+          SleepFor(MonoDelta::FromMilliseconds(1));
+        }
+        failover = MonoTime::Now() - fault_time;
+      } else {
+        SleepFor(MonoDelta::FromMilliseconds(kDurationMs / 4));
+      }
+      if (heal_fault) {
+        heal_fault();
+      }
+    }
+
+    MonoDelta remaining = start + MonoDelta::FromMilliseconds(kDurationMs) - MonoTime::Now();
+    if (remaining.ToNanoseconds() > 0) {
+      SleepFor(remaining);
+    }
+    workload.StopAndJoin();
+    MonoDelta elapsed = MonoTime::Now() - start;
+    ASSERT_GT(workload.rows_inserted(), 0);
+
+    std::ostringstream out;
+    JsonWriter writer(&out, JsonWriter::COMPACT);
+    writer.StartObject();
+    writer.String("scenario");
+    writer.String(scenario);
+    writer.String("duration_ms");
+    writer.Int64(elapsed.ToMilliseconds());
+    writer.String("rows_inserted");
+    writer.Int64(workload.rows_inserted());
+    writer.String("rows_per_sec");
+    writer.Double(workload.rows_inserted() / elapsed.ToSeconds());
+    writer.String("batches_completed");
+    writer.Int64(workload.batches_completed());
+    writer.String("commit_latency_us_p50");
+    writer.Uint64(latency_histogram_.ValueAtPercentile(50));
+    writer.String("commit_latency_us_p99");
+    writer.Uint64(latency_histogram_.ValueAtPercentile(99));
+    writer.String("commit_latency_us_max");
+    writer.Uint64(latency_histogram_.MaxValue());
+    if (failover.Initialized()) {
+      writer.String("failover_ms");
+      writer.Int64(failover.ToMilliseconds());
+    }
+    writer.EndObject();
+    LOG(INFO) << "Results: " << out.str();
+  }
+
+  // The client-side latency of each batch, from the time it's flushed until
+  // it's committed by a majority of the replicas.
+  HdrHistogram latency_histogram_;
+};
+
+TEST_F(RaftConsensusPerfITest, SteadyState) {
+  if (!AllowSlowTests()) {
+    LOG(WARNING) << "test is skipped; set KUDU_ALLOW_SLOW_TESTS=1 to run";
+    return;
+  }
+  NO_FATALS(StartCluster());
+  NO_FATALS(RunScenario("steady_state"));
+}
+
+// Kill the leader and measure how long it takes for a new one to be elected
+// and for writes to resume.
+TEST_F(RaftConsensusPerfITest, LeaderKill) {
+  if (!AllowSlowTests()) {
+    LOG(WARNING) << "test is skipped; set KUDU_ALLOW_SLOW_TESTS=1 to run";
+    return;
+  }
+  NO_FATALS(StartCluster());
+  ExternalTabletServer* leader = GetLeader();
+  NO_FATALS(RunScenario("leader_kill", [&]() { leader->Shutdown(); },
+                        /*measure_failover=*/true));
+}
+
+// Pause one follower, so that the leader has to commit with the other alone,
+// then resume it so that it has to catch up while writes continue.
+TEST_F(RaftConsensusPerfITest, FollowerLag) {
+  if (!AllowSlowTests()) {
+    LOG(WARNING) << "test is skipped; set KUDU_ALLOW_SLOW_TESTS=1 to run";
+    return;
+  }
+  NO_FATALS(StartCluster());
+  ExternalTabletServer* follower = GetFollower();
+  NO_FATALS(RunScenario("follower_lag",
+                        [&]() { CHECK_OK(follower->Pause()); },
+                        /*measure_failover=*/false,
+                        [&]() { CHECK_OK(follower->Resume()); }));
+}
+
+// Inject latency into every WAL sync on all the replicas.
+TEST_F(RaftConsensusPerfITest, SlowDisk) {
+  if (!AllowSlowTests()) {
+    LOG(WARNING) << "test is skipped; set KUDU_ALLOW_SLOW_TESTS=1 to run";
+    return;
+  }
+  NO_FATALS(StartCluster({
+    "--log_inject_latency",
+    Substitute("--log_inject_latency_ms_mean=$0", FLAGS_test_log_latency_ms),
+    Substitute("--log_inject_latency_ms_stddev=$0", FLAGS_test_log_latency_ms / 4),
+  }));
+  NO_FATALS(RunScenario("slow_disk"));
+}
+
+// Cut the leader off from the rest of the cluster by pausing it, measure how
+// long it takes for writes to resume with a new leader, then let the old
+// leader rejoin as a follower.
+TEST_F(RaftConsensusPerfITest, NetworkPartition) {
+  if (!AllowSlowTests()) {
+    LOG(WARNING) << "test is skipped; set KUDU_ALLOW_SLOW_TESTS=1 to run";
+    return;
+  }
+  NO_FATALS(StartCluster());
+  ExternalTabletServer* leader = GetLeader();
+  NO_FATALS(RunScenario("network_partition",
+                        [&]() { CHECK_OK(leader->Pause()); },
+                        /*measure_failover=*/true,
+                        [&]() { CHECK_OK(leader->Resume()); }));
+}
+
+} // namespace tserver
+} // namespace kudu
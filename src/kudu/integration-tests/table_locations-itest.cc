@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -29,7 +30,10 @@
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/catalog_manager.h"
+#include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/master/master.proxy.h"
 #include "kudu/master/mini_master.h"
@@ -282,6 +286,75 @@ TEST_F(TableLocationsTest, TestGetTableLocations) {
   }
 }
 
+// Test that table locations are served from the table's cache by requests
+// which cover the same tablets, and that the cache is invalidated when the
+// table's tablets change.
+TEST_F(TableLocationsTest, TestCachedTableLocations) {
+  const string table_name = "test";
+  Schema schema({ ColumnSchema("key", STRING) }, 1);
+  KuduPartialRow row(&schema);
+
+  vector<KuduPartialRow> splits(3, row);
+  ASSERT_OK(splits[0].SetStringNoCopy(0, "a"));
+  ASSERT_OK(splits[1].SetStringNoCopy(0, "b"));
+  ASSERT_OK(splits[2].SetStringNoCopy(0, "c"));
+  ASSERT_OK(CreateTable(table_name, schema, splits, {}));
+  NO_FATALS(CheckMasterTableCreation(table_name, 4));
+
+  auto get_locations = [&](const string& start_key, GetTableLocationsResponsePB* resp) {
+    GetTableLocationsRequestPB req;
+    RpcController controller;
+    req.mutable_table()->set_table_name(table_name);
+    req.set_partition_key_start(start_key);
+    req.set_max_returned_locations(2);
+    ASSERT_OK(proxy_->GetTableLocations(req, resp, &controller));
+    ASSERT_FALSE(resp->has_error()) << SecureDebugString(*resp);
+  };
+  scoped_refptr<TableInfo> table;
+  {
+    CatalogManager* catalog = cluster_->mini_master()->master()->catalog_manager();
+    CatalogManager::ScopedLeaderSharedLock l(catalog);
+    ASSERT_OK(l.first_failed_status());
+    vector<scoped_refptr<TableInfo>> tables;
+    ASSERT_OK(catalog->GetAllTables(&tables));
+    ASSERT_EQ(1, tables.size());
+    table = tables[0];
+  }
+
+  // Both requests start in the tablet [a, b), so the second is served from
+  // the cache with the same locations. Retry, since the cache is invalidated
+  // while the tablets' leaders are still being elected.
+  GetTableLocationsResponsePB first;
+  ASSERT_EVENTUALLY([&] {
+    NO_FATALS(get_locations("a", &first));
+    ASSERT_EQ(2, first.tablet_locations_size());
+    const int64_t num_cached = table->num_cached_locations();
+    ASSERT_GE(num_cached, 2);
+    GetTableLocationsResponsePB second;
+    NO_FATALS(get_locations("a0", &second));
+    ASSERT_EQ(SecureDebugString(first), SecureDebugString(second));
+    ASSERT_EQ(num_cached, table->num_cached_locations());
+  });
+
+  // Replace the tablet [a, b). Its replacement must be returned once it's
+  // running, rather than the cached locations of the old tablet.
+  const string old_tablet_id = first.tablet_locations(0).tablet_id();
+  {
+    ReplaceTabletRequestPB req;
+    ReplaceTabletResponsePB resp;
+    RpcController controller;
+    req.set_tablet_id(old_tablet_id);
+    ASSERT_OK(proxy_->ReplaceTablet(req, &resp, &controller));
+    ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp);
+  }
+  ASSERT_EVENTUALLY([&] {
+    GetTableLocationsResponsePB resp;
+    NO_FATALS(get_locations("a", &resp));
+    ASSERT_EQ(2, resp.tablet_locations_size());
+    ASSERT_NE(old_tablet_id, resp.tablet_locations(0).tablet_id());
+  });
+}
+
 TEST_F(TableLocationsWithTSLocationTest, TestGetTSLocation) {
   const string table_name = "test";
   Schema schema({ ColumnSchema("key", STRING) }, 1);
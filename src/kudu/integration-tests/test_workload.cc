@@ -35,6 +35,8 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/mini-cluster/mini_cluster.h"
 #include "kudu/tools/data_gen_util.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/random.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_util.h"
@@ -71,6 +73,7 @@ TestWorkload::TestWorkload(MiniCluster* cluster)
     network_error_allowed_(false),
     remote_error_allowed_(false),
     schema_(KuduSchema::FromSchema(GetSimpleTestSchema())),
+    write_latency_histogram_(nullptr),
     num_replicas_(3),
     num_tablets_(1),
     table_name_(kDefaultTableName),
@@ -168,7 +171,9 @@ void TestWorkload::WriteThread() {
       }
     }
 
+    MonoTime flush_start = MonoTime::Now();
     Status s = session->Flush();
+    MonoDelta flush_latency = MonoTime::Now() - flush_start;
 
     if (PREDICT_FALSE(!s.ok())) {
       std::vector<client::KuduError*> errors;
@@ -205,6 +210,9 @@ void TestWorkload::WriteThread() {
     if (inserted > 0) {
       rows_inserted_.IncrementBy(inserted);
       batches_completed_.Increment();
+      if (write_latency_histogram_) {
+        write_latency_histogram_->Increment(flush_latency.ToMicroseconds());
+      }
     }
   }
 }
@@ -37,6 +37,7 @@
 
 namespace kudu {
 
+class HdrHistogram;
 class Status;
 
 namespace cluster {
@@ -134,6 +135,12 @@ class TestWorkload {
     num_tablets_ = tablets;
   }
 
+  // Record the latency, in microseconds, of each batch in which at least one
+  // row was written into 'hist', which must outlive the workload's writers.
+  void set_write_latency_histogram(HdrHistogram* hist) {
+    write_latency_histogram_ = hist;
+  }
+
   void set_table_name(const std::string& table_name) {
     table_name_ = table_name;
   }
@@ -233,6 +240,7 @@ class TestWorkload {
   bool remote_error_allowed_;
   WritePattern write_pattern_;
   client::KuduSchema schema_;
+  HdrHistogram* write_latency_histogram_;
 
   int num_replicas_;
   int num_tablets_;
@@ -23,6 +23,7 @@
 #include <mutex>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -36,6 +37,7 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/threadpool.h"
 
@@ -55,7 +57,25 @@ static bool ValidateThreadPoolThreadLimit(const char* /*flagname*/, int32_t valu
 }
 DEFINE_validator(server_thread_pool_max_thread_count, &ValidateThreadPoolThreadLimit);
 
+DEFINE_int32(raft_pool_num_shards, 1,
+             "Number of scheduling shards of the server-wide raft thread pool, "
+             "which is shared by the tokens of all the hosted replicas. With "
+             "several shards, the replicas don't contend on a single pool lock "
+             "and idle threads of a shard run the tasks queued in the others.");
+TAG_FLAG(raft_pool_num_shards, advanced);
+TAG_FLAG(raft_pool_num_shards, experimental);
+
+DEFINE_bool(tablet_numa_affinity, false,
+            "Whether to assign each hosted replica to a NUMA node, and to run its "
+            "raft, prepare and apply tasks on the CPUs of that node, so that the "
+            "memory of the replica is allocated from, and mostly accessed by, "
+            "a single node. The server-wide raft, prepare and apply pools then "
+            "have a shard per node, overriding --raft_pool_num_shards. Has no "
+            "effect on machines with a single NUMA node.");
+TAG_FLAG(tablet_numa_affinity, experimental);
+
 using std::string;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -129,12 +149,27 @@ int GetThreadPoolThreadLimit(Env* env) {
 KuduServer::KuduServer(string name,
                        const ServerBaseOptions& options,
                        const string& metric_namespace)
-    : ServerBase(std::move(name), options, metric_namespace) {
+    : ServerBase(std::move(name), options, metric_namespace),
+      num_numa_nodes_(0) {
 }
 
 Status KuduServer::Init() {
   RETURN_NOT_OK(ServerBase::Init());
 
+  // With NUMA affinity, each of the pools below has a shard per node, shard
+  // i running on the CPUs of node i.
+  vector<vector<int>> numa_nodes;
+  if (FLAGS_tablet_numa_affinity) {
+    RETURN_NOT_OK_PREPEND(GetNumaNodes(&numa_nodes), "could not read the NUMA topology");
+    if (numa_nodes.size() > 1) {
+      num_numa_nodes_ = numa_nodes.size();
+      LOG(INFO) << Substitute("Assigning tablets to $0 NUMA nodes", num_numa_nodes_);
+    } else {
+      numa_nodes.clear();
+    }
+  }
+  int num_node_shards = std::max<int>(1, numa_nodes.size());
+
   ThreadPoolMetrics metrics = {
       METRIC_op_apply_queue_length.Instantiate(metric_entity_),
       METRIC_op_apply_queue_time.Instantiate(metric_entity_),
@@ -142,6 +177,8 @@ Status KuduServer::Init() {
   };
   RETURN_NOT_OK(ThreadPoolBuilder("apply")
                 .set_metrics(std::move(metrics))
+                .set_num_shards(num_node_shards)
+                .set_shard_cpus(numa_nodes)
                 .Build(&tablet_apply_pool_));
 
   // These pools are shared by all replicas hosted by this server, and thus
@@ -149,10 +186,15 @@ Status KuduServer::Init() {
   int server_wide_pool_limit = GetThreadPoolThreadLimit(fs_manager_->env());
   RETURN_NOT_OK(ThreadPoolBuilder("prepare")
                 .set_max_threads(server_wide_pool_limit)
+                .set_num_shards(num_node_shards)
+                .set_shard_cpus(numa_nodes)
                 .Build(&tablet_prepare_pool_));
   RETURN_NOT_OK(ThreadPoolBuilder("raft")
                 .set_trace_metric_prefix("raft")
                 .set_max_threads(server_wide_pool_limit)
+                .set_num_shards(numa_nodes.empty() ? std::max(1, FLAGS_raft_pool_num_shards)
+                                                   : num_node_shards)
+                .set_shard_cpus(numa_nodes)
                 .Build(&raft_pool_));
 
   return Status::OK();
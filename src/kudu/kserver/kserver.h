@@ -60,6 +60,11 @@ class KuduServer : public server::ServerBase {
   ThreadPool* tablet_apply_pool() const { return tablet_apply_pool_.get(); }
   ThreadPool* raft_pool() const { return raft_pool_.get(); }
 
+  // Returns the number of NUMA nodes the replicas are spread over, shard i of
+  // the pools above running on the CPUs of node i, or 0 if they aren't. See
+  // --tablet_numa_affinity.
+  int num_numa_nodes() const { return num_numa_nodes_; }
+
  private:
 
   // Thread pool for preparing transactions, shared between all tablets.
@@ -71,6 +76,9 @@ class KuduServer : public server::ServerBase {
   // Thread pool for Raft-related operations, shared between all tablets.
   gscoped_ptr<ThreadPool> raft_pool_;
 
+  // Set by Init().
+  int num_numa_nodes_;
+
   DISALLOW_COPY_AND_ASSIGN(KuduServer);
 };
 
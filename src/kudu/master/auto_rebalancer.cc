@@ -0,0 +1,515 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/auto_rebalancer.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_set>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/common/wire_protocol.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/consensus.proxy.h"
+#include "kudu/consensus/metadata.pb.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/catalog_manager.h"
+#include "kudu/master/master.h"
+#include "kudu/master/master.pb.h"
+#include "kudu/master/ts_descriptor.h"
+#include "kudu/master/ts_manager.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tools/rebalance_algo.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/cow_object.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/thread.h"
+
+DEFINE_bool(auto_rebalancing_enabled, false,
+            "Whether the leader master moves tablet replicas and tablet "
+            "leaderships to keep them balanced among the tablet servers. "
+            "Replicas are only moved when running with "
+            "--raft_prepare_replacement_before_eviction.");
+TAG_FLAG(auto_rebalancing_enabled, experimental);
+TAG_FLAG(auto_rebalancing_enabled, runtime);
+
+DEFINE_int32(auto_rebalancing_interval_seconds, 30,
+             "How often the leader master rebalances the cluster, if "
+             "--auto_rebalancing_enabled is set.");
+TAG_FLAG(auto_rebalancing_interval_seconds, experimental);
+TAG_FLAG(auto_rebalancing_interval_seconds, runtime);
+
+DEFINE_int32(auto_rebalancing_max_moves_per_server, 1,
+             "The most replica moves which may be in progress at once to or "
+             "from any one tablet server. This bounds the number of tablet "
+             "copies rebalancing puts on each tablet server.");
+TAG_FLAG(auto_rebalancing_max_moves_per_server, experimental);
+TAG_FLAG(auto_rebalancing_max_moves_per_server, runtime);
+
+DEFINE_int32(auto_rebalancing_max_concurrent_moves, 16,
+             "The most replica moves which may be in progress at once in the "
+             "whole cluster. This bounds the network and disk bandwidth "
+             "taken by the tablet copies of rebalancing.");
+TAG_FLAG(auto_rebalancing_max_concurrent_moves, experimental);
+TAG_FLAG(auto_rebalancing_max_concurrent_moves, runtime);
+
+DEFINE_int32(auto_rebalancing_move_timeout_seconds, 600,
+             "How long a replica move counts against the concurrency limits "
+             "if it doesn't complete.");
+TAG_FLAG(auto_rebalancing_move_timeout_seconds, experimental);
+TAG_FLAG(auto_rebalancing_move_timeout_seconds, runtime);
+
+DEFINE_int32(auto_rebalancing_max_leader_transfers_per_round, 10,
+             "The most tablet leadership transfers requested in each round "
+             "of rebalancing.");
+TAG_FLAG(auto_rebalancing_max_leader_transfers_per_round, experimental);
+TAG_FLAG(auto_rebalancing_max_leader_transfers_per_round, runtime);
+
+DECLARE_bool(raft_prepare_replacement_before_eviction);
+
+using kudu::consensus::RaftPeerPB;
+using kudu::tools::LeaderTransfer;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace master {
+
+namespace {
+
+// The timeout of the RPCs asking tablet leaders to change their config or
+// to step down.
+const MonoDelta kRpcTimeout = MonoDelta::FromSeconds(10);
+
+// See tools::LeaderBalancingAlgo: a server may lead up to 10% more tablets
+// than the average before its leaderships are transferred.
+const double kLeaderLoadTolerance = 0.1;
+
+} // anonymous namespace
+
+AutoRebalancerTask::AutoRebalancerTask(Master* master)
+    : master_(master),
+      closing_(false),
+      wake_up_cv_(&lock_) {
+}
+
+AutoRebalancerTask::~AutoRebalancerTask() {
+  if (thread_) {
+    Shutdown();
+  }
+}
+
+Status AutoRebalancerTask::Init() {
+  CHECK(!thread_) << "AutoRebalancerTask is already initialized";
+  return kudu::Thread::Create("catalog manager", "auto-rebalancer",
+                              &AutoRebalancerTask::RunLoop, this, &thread_);
+}
+
+void AutoRebalancerTask::Shutdown() {
+  CHECK(thread_) << "AutoRebalancerTask is not initialized";
+  {
+    std::lock_guard<Mutex> l(lock_);
+    DCHECK(!closing_);
+    closing_ = true;
+    wake_up_cv_.Signal();
+  }
+  CHECK_OK(ThreadJoiner(thread_.get()).Join());
+  thread_.reset();
+}
+
+void AutoRebalancerTask::RunLoop() {
+  while (true) {
+    {
+      std::lock_guard<Mutex> l(lock_);
+      if (!closing_) {
+        wake_up_cv_.WaitFor(
+            MonoDelta::FromSeconds(FLAGS_auto_rebalancing_interval_seconds));
+      }
+      if (closing_) {
+        return;
+      }
+    }
+    if (FLAGS_auto_rebalancing_enabled) {
+      WARN_NOT_OK(RunRound(), "auto-rebalancing round failed");
+    }
+  }
+}
+
+Status AutoRebalancerTask::RunRound() {
+  TSDescriptorVector descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&descs);
+  unordered_map<string, string> location_by_uuid;
+  for (const auto& desc : descs) {
+    const auto location = desc->location();
+    location_by_uuid.emplace(desc->permanent_uuid(), location ? *location : "");
+  }
+
+  unordered_map<string, TabletState> tablets;
+  {
+    // This method calls the catalog manager directly, so ensure the leader
+    // lock is held. The RPCs to the tablet servers are sent after releasing
+    // it: the config changes are conditional on the configs they were
+    // computed from, so they're safe even if this master loses leadership.
+    CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+    if (!l.first_failed_status().ok()) {
+      // The moves requested while this master was leader are seen by any
+      // new leader as config changes underway, and left alone; this master
+      // starts afresh if it's elected again.
+      moves_in_progress_.clear();
+      return Status::OK();
+    }
+    RETURN_NOT_OK(GetTabletStates(location_by_uuid, &tablets));
+  }
+
+  UpdateMovesInProgress(tablets);
+  bool balanced = true;
+  if (FLAGS_raft_prepare_replacement_before_eviction) {
+    RETURN_NOT_OK(ScheduleReplicaMoves(location_by_uuid, tablets, &balanced));
+  } else {
+    KLOG_EVERY_N_SECS(INFO, 3600) << "Not moving tablet replicas to rebalance the "
+        "cluster: --raft_prepare_replacement_before_eviction is not set";
+  }
+  if (balanced && moves_in_progress_.empty()) {
+    // Leaderships are balanced once the replicas are, since moving replicas
+    // changes which servers may lead which tablets.
+    RETURN_NOT_OK(ScheduleLeaderTransfers(location_by_uuid, tablets));
+  }
+  return Status::OK();
+}
+
+Status AutoRebalancerTask::GetTabletStates(
+    const unordered_map<string, string>& live_uuids,
+    unordered_map<string, TabletState>* tablets) {
+  vector<scoped_refptr<TableInfo>> tables;
+  RETURN_NOT_OK(master_->catalog_manager()->GetAllTables(&tables));
+  for (const auto& table : tables) {
+    {
+      TableMetadataLock l(table.get(), LockMode::READ);
+      if (!l.data().is_running()) {
+        continue;
+      }
+    }
+    vector<scoped_refptr<TabletInfo>> table_tablets;
+    table->GetAllTablets(&table_tablets);
+    for (const auto& tablet : table_tablets) {
+      TabletState state;
+      state.tablet_id = tablet->id();
+      state.table_id = table->id();
+
+      TabletMetadataLock l(tablet.get(), LockMode::READ);
+      const auto& cstate = l.data().pb.consensus_state();
+      state.leader_uuid = cstate.leader_uuid();
+      state.config_opid_index = cstate.committed_config().opid_index();
+      state.healthy = l.data().is_running() && !cstate.has_pending_config();
+      for (const auto& peer : cstate.committed_config().peers()) {
+        if (peer.member_type() != RaftPeerPB::VOTER) {
+          // A replica is being added.
+          state.healthy = false;
+          continue;
+        }
+        if (peer.attrs().replace()) {
+          state.healthy = false;
+        }
+        if (!ContainsKey(live_uuids, peer.permanent_uuid())) {
+          // The replica is to be replaced by re-replication rather than moved.
+          state.healthy = false;
+          continue;
+        }
+        state.voter_uuids.emplace_back(peer.permanent_uuid());
+      }
+      tablets->emplace(state.tablet_id, std::move(state));
+    }
+  }
+  return Status::OK();
+}
+
+void AutoRebalancerTask::UpdateMovesInProgress(
+    const unordered_map<string, TabletState>& tablets) {
+  const MonoTime now = MonoTime::Now();
+  moves_in_progress_.erase(std::remove_if(
+      moves_in_progress_.begin(), moves_in_progress_.end(),
+      [&](const Move& move) {
+        const TabletState* tablet = FindOrNull(tablets, move.tablet_id);
+        // Once the tablet's config has changed from the one the move was
+        // requested for, and no config change is underway anymore, the move
+        // has either completed or been abandoned.
+        return !tablet || now > move.deadline ||
+            (tablet->config_opid_index > move.config_opid_index && tablet->healthy);
+      }), moves_in_progress_.end());
+}
+
+Status AutoRebalancerTask::ScheduleReplicaMoves(
+    const unordered_map<string, string>& location_by_uuid,
+    const unordered_map<string, TabletState>& tablets,
+    bool* balanced) {
+  *balanced = true;
+
+  unordered_map<string, vector<string>> uuids_by_location;
+  for (const auto& e : location_by_uuid) {
+    uuids_by_location[e.second].emplace_back(e.first);
+  }
+  unordered_map<string, vector<const TabletState*>> tablets_by_table;
+  for (const auto& e : tablets) {
+    tablets_by_table[e.second.table_id].emplace_back(&e.second);
+  }
+
+  // The moves in progress count against the concurrency limits, and their
+  // tablets aren't moved again until they complete.
+  unordered_map<string, int> moves_by_server;
+  unordered_set<string> moving_tablets;
+  for (const auto& move : moves_in_progress_) {
+    ++moves_by_server[move.from];
+    ++moves_by_server[move.to];
+    moving_tablets.emplace(move.tablet_id);
+  }
+  const int max_moves_per_server = FLAGS_auto_rebalancing_max_moves_per_server;
+  const int max_concurrent_moves = FLAGS_auto_rebalancing_max_concurrent_moves;
+
+  tools::TwoDimensionalGreedyAlgo algo;
+  for (const auto& location : uuids_by_location) {
+    const auto& uuids = location.second;
+    if (uuids.size() < 2) {
+      continue;
+    }
+
+    // Count the replicas of each table on each tablet server of the location.
+    tools::ClusterInfo cluster_info;
+    unordered_map<string, int32_t> total_count_by_uuid;
+    for (const auto& uuid : uuids) {
+      total_count_by_uuid.emplace(uuid, 0);
+    }
+    for (const auto& table : tablets_by_table) {
+      unordered_map<string, int32_t> count_by_uuid;
+      for (const auto& uuid : uuids) {
+        count_by_uuid.emplace(uuid, 0);
+      }
+      for (const auto* tablet : table.second) {
+        for (const auto& uuid : tablet->voter_uuids) {
+          int32_t* count = FindOrNull(count_by_uuid, uuid);
+          if (count) {
+            ++*count;
+            ++FindOrDie(total_count_by_uuid, uuid);
+          }
+        }
+      }
+      tools::TableBalanceInfo table_info;
+      table_info.table_id = table.first;
+      int32_t min_count = std::numeric_limits<int32_t>::max();
+      int32_t max_count = 0;
+      for (const auto& e : count_by_uuid) {
+        min_count = std::min(min_count, e.second);
+        max_count = std::max(max_count, e.second);
+        table_info.servers_by_replica_count.emplace(e.second, e.first);
+      }
+      cluster_info.balance.table_info_by_skew.emplace(max_count - min_count,
+                                                      std::move(table_info));
+    }
+    for (const auto& e : total_count_by_uuid) {
+      cluster_info.balance.servers_by_total_replica_count.emplace(e.second, e.first);
+    }
+
+    vector<tools::TableReplicaMove> moves;
+    RETURN_NOT_OK(algo.GetNextMoves(
+        cluster_info, static_cast<int>(uuids.size()) * max_moves_per_server, &moves));
+    if (!moves.empty()) {
+      *balanced = false;
+    }
+
+    for (const auto& move : moves) {
+      if (static_cast<int>(moves_in_progress_.size()) >= max_concurrent_moves) {
+        return Status::OK();
+      }
+      if (moves_by_server[move.from] >= max_moves_per_server ||
+          moves_by_server[move.to] >= max_moves_per_server) {
+        continue;
+      }
+
+      // Pick a tablet of the table to move, preferring one whose leader
+      // isn't the replica to move, so as not to force an election.
+      const TabletState* to_move = nullptr;
+      for (const auto* tablet : FindOrDie(tablets_by_table, move.table_id)) {
+        const auto& voters = tablet->voter_uuids;
+        if (!tablet->healthy || tablet->leader_uuid.empty() ||
+            ContainsKey(moving_tablets, tablet->tablet_id) ||
+            std::find(voters.begin(), voters.end(), move.from) == voters.end() ||
+            std::find(voters.begin(), voters.end(), move.to) != voters.end()) {
+          continue;
+        }
+        to_move = tablet;
+        if (tablet->leader_uuid != move.from) {
+          break;
+        }
+      }
+      if (!to_move) {
+        continue;
+      }
+
+      Status s = RequestReplicaMove(*to_move, move.from, move.to);
+      if (!s.ok()) {
+        LOG(WARNING) << Substitute("Unable to move replica of tablet $0 from $1 to $2: $3",
+                                   to_move->tablet_id, move.from, move.to, s.ToString());
+        continue;
+      }
+      moves_in_progress_.push_back({ to_move->tablet_id, move.from, move.to,
+                                     to_move->config_opid_index,
+                                     MonoTime::Now() + MonoDelta::FromSeconds(
+                                         FLAGS_auto_rebalancing_move_timeout_seconds) });
+      ++moves_by_server[move.from];
+      ++moves_by_server[move.to];
+      moving_tablets.emplace(to_move->tablet_id);
+    }
+  }
+  return Status::OK();
+}
+
+Status AutoRebalancerTask::ScheduleLeaderTransfers(
+    const unordered_map<string, string>& location_by_uuid,
+    const unordered_map<string, TabletState>& tablets) {
+  vector<string> uuids;
+  uuids.reserve(location_by_uuid.size());
+  for (const auto& e : location_by_uuid) {
+    uuids.emplace_back(e.first);
+  }
+
+  // Leaderships are balanced by count.
+  vector<tools::TabletLeaderLoad> leader_loads;
+  for (const auto& e : tablets) {
+    const auto& tablet = e.second;
+    if (!tablet.healthy || tablet.leader_uuid.empty()) {
+      continue;
+    }
+    tools::TabletLeaderLoad leader_load;
+    leader_load.tablet_id = tablet.tablet_id;
+    leader_load.leader_uuid = tablet.leader_uuid;
+    for (const auto& uuid : tablet.voter_uuids) {
+      if (uuid != tablet.leader_uuid) {
+        leader_load.follower_uuids.emplace_back(uuid);
+      }
+    }
+    leader_load.load = 1;
+    leader_loads.emplace_back(std::move(leader_load));
+  }
+
+  vector<LeaderTransfer> transfers;
+  tools::LeaderBalancingAlgo algo(kLeaderLoadTolerance);
+  RETURN_NOT_OK(algo.GetNextTransfers(
+      uuids, leader_loads, FLAGS_auto_rebalancing_max_leader_transfers_per_round,
+      &transfers));
+  for (const auto& transfer : transfers) {
+    WARN_NOT_OK(RequestLeaderTransfer(transfer),
+                Substitute("Unable to transfer leadership of tablet $0 from $1 to $2",
+                           transfer.tablet_id, transfer.from, transfer.to));
+  }
+  return Status::OK();
+}
+
+Status AutoRebalancerTask::RequestReplicaMove(const TabletState& tablet,
+                                              const string& from,
+                                              const string& to) {
+  TSManager* ts_manager = master_->ts_manager();
+  shared_ptr<TSDescriptor> leader_desc;
+  shared_ptr<TSDescriptor> to_desc;
+  if (!ts_manager->LookupTSByUUID(tablet.leader_uuid, &leader_desc)) {
+    return Status::NotFound("leader's tablet server not found", tablet.leader_uuid);
+  }
+  if (!ts_manager->LookupTSByUUID(to, &to_desc)) {
+    return Status::NotFound("destination tablet server not found", to);
+  }
+  ServerRegistrationPB to_reg;
+  to_desc->GetRegistration(&to_reg);
+  if (to_reg.rpc_addresses_size() == 0) {
+    return Status::IllegalState("destination tablet server has no RPC address", to);
+  }
+  shared_ptr<consensus::ConsensusServiceProxy> proxy;
+  RETURN_NOT_OK(leader_desc->GetConsensusProxy(master_->messenger(), &proxy));
+
+  // Mark the replica to move for replacement, and add its replacement as a
+  // non-voter to be promoted once it has caught up.
+  consensus::BulkChangeConfigRequestPB req;
+  req.set_dest_uuid(tablet.leader_uuid);
+  req.set_tablet_id(tablet.tablet_id);
+  req.set_cas_config_opid_index(tablet.config_opid_index);
+  {
+    auto* change = req.add_config_changes();
+    change->set_type(consensus::MODIFY_PEER);
+    change->mutable_peer()->set_permanent_uuid(from);
+    change->mutable_peer()->mutable_attrs()->set_replace(true);
+  }
+  {
+    auto* change = req.add_config_changes();
+    change->set_type(consensus::ADD_PEER);
+    RaftPeerPB* peer = change->mutable_peer();
+    peer->set_permanent_uuid(to);
+    peer->set_member_type(RaftPeerPB::NON_VOTER);
+    peer->mutable_attrs()->set_promote(true);
+    *peer->mutable_last_known_addr() = to_reg.rpc_addresses(0);
+  }
+
+  consensus::ChangeConfigResponsePB resp;
+  rpc::RpcController rpc;
+  rpc.set_timeout(kRpcTimeout);
+  RETURN_NOT_OK(proxy->BulkChangeConfig(req, &resp, &rpc));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  LOG(INFO) << Substitute("Moving replica of tablet $0 from $1 to $2 to rebalance the cluster",
+                          tablet.tablet_id, from, to);
+  return Status::OK();
+}
+
+Status AutoRebalancerTask::RequestLeaderTransfer(const LeaderTransfer& transfer) {
+  shared_ptr<TSDescriptor> leader_desc;
+  if (!master_->ts_manager()->LookupTSByUUID(transfer.from, &leader_desc)) {
+    return Status::NotFound("leader's tablet server not found", transfer.from);
+  }
+  shared_ptr<consensus::ConsensusServiceProxy> proxy;
+  RETURN_NOT_OK(leader_desc->GetConsensusProxy(master_->messenger(), &proxy));
+
+  consensus::LeaderStepDownRequestPB req;
+  req.set_dest_uuid(transfer.from);
+  req.set_tablet_id(transfer.tablet_id);
+  req.set_mode(consensus::GRACEFUL);
+  req.set_new_leader_uuid(transfer.to);
+
+  consensus::LeaderStepDownResponsePB resp;
+  rpc::RpcController rpc;
+  rpc.set_timeout(kRpcTimeout);
+  RETURN_NOT_OK(proxy->LeaderStepDown(req, &resp, &rpc));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  LOG(INFO) << Substitute("Transferring leadership of tablet $0 from $1 to $2 "
+                          "to rebalance the cluster",
+                          transfer.tablet_id, transfer.from, transfer.to);
+  return Status::OK();
+}
+
+} // namespace master
+} // namespace kudu
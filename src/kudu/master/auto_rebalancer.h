@@ -0,0 +1,177 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Thread;
+
+namespace tools {
+struct LeaderTransfer;
+} // namespace tools
+
+namespace master {
+
+class Master;
+
+// A CatalogManager background task which keeps the tablet replicas and the
+// tablet leaders balanced among the tablet servers, so that imbalance doesn't
+// build up between runs of the 'kudu cluster rebalance' tool.
+//
+// As a background task, the lifetime of an instance of this class must be less
+// than the catalog manager it belongs to.
+//
+// The task wakes up every --auto_rebalancing_interval_seconds, but performs
+// no work when the master is a follower. Each round, it computes replica
+// moves with the same algorithm as the rebalancer tool, from the catalog's
+// view of the tablets' committed Raft configurations and the live tablet
+// servers, and asks the tablets' leaders to carry out as many of them as the
+// move concurrency limits allow. Replicas are only moved between tablet
+// servers in the same location, so moves never affect the placement of
+// replicas among locations; each location is balanced on its own.
+//
+// A replica is moved by adding the replacement as a non-voter to be promoted,
+// and marking the replica to move for replacement; once the replacement has
+// caught up and been promoted, the catalog manager evicts the replaced replica
+// as it does for any other replacement. This requires the 3-4-3 replica
+// management scheme (see --raft_prepare_replacement_before_eviction).
+//
+// Once no replica moves are needed or in progress, the task transfers tablet
+// leaderships to spread the leaders evenly among the tablet servers.
+class AutoRebalancerTask {
+ public:
+  explicit AutoRebalancerTask(Master* master);
+  ~AutoRebalancerTask();
+
+  // Starts the rebalancing thread.
+  Status Init() WARN_UNUSED_RESULT;
+
+  // Stops the rebalancing thread. This must be called before shutting down
+  // the catalog manager.
+  void Shutdown();
+
+ private:
+  // The replicas of a tablet, as of its committed Raft config.
+  struct TabletState {
+    std::string tablet_id;
+    std::string table_id;
+
+    // Empty if the tablet has no known leader.
+    std::string leader_uuid;
+
+    // The tablet servers hosting the tablet's voter replicas.
+    std::vector<std::string> voter_uuids;
+
+    // The opid index of the committed config, used to make the config
+    // changes conditional on the config which they were computed from.
+    int64_t config_opid_index;
+
+    // Whether the tablet may take part in rebalancing: it's running, its
+    // voters are all on live tablet servers, and it has no config change
+    // underway (no pending config, non-voters, or replicas being replaced).
+    bool healthy;
+  };
+
+  // A replica move which was requested, and hasn't completed yet.
+  struct Move {
+    std::string tablet_id;
+    std::string from;
+    std::string to;
+
+    // The opid index of the committed config the move was requested for.
+    int64_t config_opid_index;
+
+    // The move stops counting against the concurrency limits after this:
+    // the tablet server may have given up on the tablet copy.
+    MonoTime deadline;
+  };
+
+  // Runs the main loop of the rebalancing thread.
+  void RunLoop();
+
+  // Runs a round of rebalancing, if this master is the leader.
+  Status RunRound();
+
+  // Collects the state of the tablets of all running tables into 'tablets',
+  // keyed by tablet id. Only counts replicas on the tablet servers in
+  // 'live_uuids'. The leader lock must be held.
+  Status GetTabletStates(const std::unordered_map<std::string, std::string>& live_uuids,
+                         std::unordered_map<std::string, TabletState>* tablets);
+
+  // Forgets about the moves in 'moves_in_progress_' which have completed,
+  // failed, or run past their deadline.
+  void UpdateMovesInProgress(const std::unordered_map<std::string, TabletState>& tablets);
+
+  // Computes the replica moves balancing the tablet servers in
+  // 'location_by_uuid', and requests as many of them as the concurrency
+  // limits allow. Sets 'balanced' to whether no moves were needed.
+  Status ScheduleReplicaMoves(
+      const std::unordered_map<std::string, std::string>& location_by_uuid,
+      const std::unordered_map<std::string, TabletState>& tablets,
+      bool* balanced);
+
+  // Computes the leadership transfers balancing the tablet servers in
+  // 'location_by_uuid', and requests them.
+  Status ScheduleLeaderTransfers(
+      const std::unordered_map<std::string, std::string>& location_by_uuid,
+      const std::unordered_map<std::string, TabletState>& tablets);
+
+  // Asks the leader of 'tablet' to move its replica from 'from' to 'to'.
+  Status RequestReplicaMove(const TabletState& tablet,
+                            const std::string& from,
+                            const std::string& to) WARN_UNUSED_RESULT;
+
+  // Asks the leader of a tablet to transfer its leadership as per 'transfer'.
+  Status RequestLeaderTransfer(const tools::LeaderTransfer& transfer) WARN_UNUSED_RESULT;
+
+  Master* const master_;
+
+  // The rebalancing thread.
+  scoped_refptr<kudu::Thread> thread_;
+
+  // Protects 'closing_'.
+  Mutex lock_;
+
+  // Set to true if the task is in the process of shutting down.
+  bool closing_;
+
+  // Wakes the thread up at shutdown.
+  ConditionVariable wake_up_cv_;
+
+  // The replica moves requested by this master which haven't completed.
+  // Only accessed by the rebalancing thread.
+  std::vector<Move> moves_in_progress_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutoRebalancerTask);
+};
+
+} // namespace master
+} // namespace kudu
@@ -97,6 +97,7 @@
 #include "kudu/gutil/utf/utf.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/hms/hms_catalog.h"
+#include "kudu/master/auto_rebalancer.h"
 #include "kudu/master/hms_notification_log_listener.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
@@ -225,6 +226,14 @@ DEFINE_int32(table_locations_ttl_ms, 5 * 60 * 1000, // 5 minutes
              "until after waiting for the ttl period.");
 TAG_FLAG(table_locations_ttl_ms, advanced);
 
+DEFINE_int32(table_locations_cache_capacity, 10000,
+             "Maximum number of tablet locations cached per table for "
+             "GetTableLocations() requests. The cached locations are reused "
+             "until the table's tablets, their states or their Raft "
+             "configurations change. Set to 0 to disable the cache.");
+TAG_FLAG(table_locations_cache_capacity, advanced);
+TAG_FLAG(table_locations_cache_capacity, runtime);
+
 DEFINE_bool(catalog_manager_fail_ts_rpcs, false,
             "Whether all master->TS async calls should fail. Only for testing!");
 TAG_FLAG(catalog_manager_fail_ts_rpcs, hidden);
@@ -307,13 +316,13 @@ namespace master {
 
 class TableLoader : public TableVisitor {
  public:
-  explicit TableLoader(CatalogManager *catalog_manager)
-    : catalog_manager_(catalog_manager) {
+  explicit TableLoader(CatalogManager::TableMaps* maps)
+    : maps_(maps) {
   }
 
   Status VisitTable(const string& table_id,
                     const SysTablesEntryPB& metadata) override {
-    CHECK(!ContainsKey(catalog_manager_->table_ids_map_, table_id))
+    CHECK(!ContainsKey(maps_->ids, table_id))
           << "Table already exists: " << table_id;
 
     // Set up the table info.
@@ -323,9 +332,9 @@ class TableLoader : public TableVisitor {
 
     // Add the tablet to the IDs map and to the name map (if the table is not deleted).
     bool is_deleted = l.mutable_data()->is_deleted();
-    catalog_manager_->table_ids_map_[table->id()] = table;
+    maps_->ids[table->id()] = table;
     if (!is_deleted) {
-      auto* existing = InsertOrReturnExisting(&catalog_manager_->normalized_table_names_map_,
+      auto* existing = InsertOrReturnExisting(&maps_->names,
                                               CatalogManager::NormalizeTableName(l.data().name()),
                                               table);
       if (existing) {
@@ -349,7 +358,7 @@ class TableLoader : public TableVisitor {
   }
 
  private:
-  CatalogManager *catalog_manager_;
+  CatalogManager::TableMaps* maps_;
 
   DISALLOW_COPY_AND_ASSIGN(TableLoader);
 };
@@ -360,16 +369,17 @@ class TableLoader : public TableVisitor {
 
 class TabletLoader : public TabletVisitor {
  public:
-  explicit TabletLoader(CatalogManager *catalog_manager)
-    : catalog_manager_(catalog_manager) {
+  TabletLoader(const CatalogManager::TableInfoMap& tables,
+               vector<scoped_refptr<TabletInfo>>* tablets)
+    : tables_(tables),
+      tablets_(tablets) {
   }
 
   Status VisitTablet(const string& table_id,
                      const string& tablet_id,
                      const SysTabletsEntryPB& metadata) override {
     // Lookup the table.
-    scoped_refptr<TableInfo> table(FindPtrOrNull(
-        catalog_manager_->table_ids_map_, table_id));
+    scoped_refptr<TableInfo> table(FindPtrOrNull(tables_, table_id));
     if (table == nullptr) {
       // Tables and tablets are always created/deleted in one operation, so
       // this shouldn't be possible.
@@ -385,7 +395,7 @@ class TabletLoader : public TabletVisitor {
     l.mutable_data()->pb.CopyFrom(metadata);
 
     // Add the tablet to the tablet manager.
-    catalog_manager_->tablet_map_[tablet->id()] = tablet;
+    tablets_->push_back(tablet);
 
     // Add the tablet to the table.
     bool is_deleted = l.mutable_data()->is_deleted();
@@ -405,7 +415,8 @@ class TabletLoader : public TabletVisitor {
   }
 
  private:
-  CatalogManager *catalog_manager_;
+  const CatalogManager::TableInfoMap& tables_;
+  vector<scoped_refptr<TabletInfo>>* tablets_;
 
   DISALLOW_COPY_AND_ASSIGN(TabletLoader);
 };
@@ -686,6 +697,10 @@ CatalogManager::CatalogManager(Master* master)
       leader_ready_term_(-1),
       hms_notification_log_event_id_(-1),
       leader_lock_(RWMutex::Priority::PREFER_WRITING) {
+  table_maps_ = std::make_shared<TableMaps>();
+  for (auto& shard : tablet_map_shards_) {
+    shard = std::make_shared<TabletInfoMap>();
+  }
   CHECK_OK(ThreadPoolBuilder("leader-initialization")
            // Presently, this thread pool must contain only a single thread
            // (to correctly serialize invocations of ElectedAsLeaderCb upon
@@ -747,6 +762,10 @@ Status CatalogManager::Init(bool is_first_run) {
   RETURN_NOT_OK_PREPEND(background_tasks_->Init(),
                         "Failed to initialize catalog manager background tasks");
 
+  auto_rebalancer_.reset(new AutoRebalancerTask(master_));
+  RETURN_NOT_OK_PREPEND(auto_rebalancer_->Init(),
+                        "Failed to initialize auto-rebalancer task");
+
   {
     std::lock_guard<simple_spinlock> l(state_lock_);
     CHECK_EQ(kStarting, state_);
@@ -1152,21 +1171,24 @@ Status CatalogManager::VisitTablesAndTabletsUnlocked() {
   // it's important to end their tasks now; otherwise Shutdown() will
   // destroy master state used by these tasks.
   vector<scoped_refptr<TableInfo>> tables;
-  AppendValuesFromMap(table_ids_map_, &tables);
+  AppendValuesFromMap(table_maps()->ids, &tables);
   AbortAndWaitForAllTasks(tables);
 
   // Clear the existing state.
-  normalized_table_names_map_.clear();
-  table_ids_map_.clear();
-  tablet_map_.clear();
-
-  // Visit tables and tablets, load them into memory.
-  TableLoader table_loader(this);
-  RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTables(&table_loader),
-                        "Failed while visiting tables in sys catalog");
-  TabletLoader tablet_loader(this);
-  RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
-                        "Failed while visiting tablets in sys catalog");
+  ClearMapsUnlocked();
+
+  // Visit tables and tablets, load them into memory. The maps are built aside
+  // and published once each visit ends, rather than copied for every entry.
+  auto loaded_tables = std::make_shared<TableMaps>();
+  TableLoader table_loader(loaded_tables.get());
+  Status s = sys_catalog_->VisitTables(&table_loader);
+  PublishTableMapsUnlocked(loaded_tables);
+  RETURN_NOT_OK_PREPEND(s, "Failed while visiting tables in sys catalog");
+  vector<scoped_refptr<TabletInfo>> tablets;
+  TabletLoader tablet_loader(loaded_tables->ids, &tablets);
+  s = sys_catalog_->VisitTablets(&tablet_loader);
+  AddTabletsUnlocked(tablets);
+  RETURN_NOT_OK_PREPEND(s, "Failed while visiting tablets in sys catalog");
   return Status::OK();
 }
 
@@ -1177,6 +1199,90 @@ Status CatalogManager::VisitTablesAndTablets() {
   return VisitTablesAndTabletsUnlocked();
 }
 
+shared_ptr<const CatalogManager::TableMaps> CatalogManager::table_maps() const {
+  shared_lock<rw_spinlock> l(snapshot_lock_.get_lock());
+  return table_maps_;
+}
+
+void CatalogManager::PublishTableMapsUnlocked(shared_ptr<const TableMaps> maps) {
+  DCHECK(lock_.is_write_locked());
+  // Swap rather than assign, so that the old snapshot is released after
+  // snapshot_lock_ is.
+  std::lock_guard<percpu_rwlock> l(snapshot_lock_);
+  table_maps_.swap(maps);
+}
+
+int CatalogManager::TabletMapShardIndex(const string& tablet_id) {
+  return std::hash<string>()(tablet_id) % kNumTabletMapShards;
+}
+
+scoped_refptr<TabletInfo> CatalogManager::FindTablet(const string& tablet_id) const {
+  shared_ptr<const TabletInfoMap> shard;
+  {
+    shared_lock<rw_spinlock> l(snapshot_lock_.get_lock());
+    shard = tablet_map_shards_[TabletMapShardIndex(tablet_id)];
+  }
+  return FindPtrOrNull(*shard, tablet_id);
+}
+
+void CatalogManager::GetAllTablets(TabletInfoMap* tablets) const {
+  vector<shared_ptr<const TabletInfoMap>> shards;
+  {
+    shared_lock<rw_spinlock> l(snapshot_lock_.get_lock());
+    shards.assign(std::begin(tablet_map_shards_), std::end(tablet_map_shards_));
+  }
+  tablets->clear();
+  for (const auto& shard : shards) {
+    tablets->insert(shard->begin(), shard->end());
+  }
+}
+
+void CatalogManager::AddTabletsUnlocked(const vector<scoped_refptr<TabletInfo>>& tablets) {
+  DCHECK(lock_.is_write_locked());
+  if (tablets.empty()) {
+    return;
+  }
+
+  // The shards only change with lock_ held for writing, so they can be read
+  // here without snapshot_lock_.
+  shared_ptr<const TabletInfoMap> new_shards[kNumTabletMapShards];
+  {
+    unique_ptr<TabletInfoMap> building[kNumTabletMapShards];
+    for (const auto& tablet : tablets) {
+      int idx = TabletMapShardIndex(tablet->id());
+      if (!building[idx]) {
+        building[idx].reset(new TabletInfoMap(*tablet_map_shards_[idx]));
+      }
+      (*building[idx])[tablet->id()] = tablet;
+    }
+    for (int i = 0; i < kNumTabletMapShards; i++) {
+      new_shards[i] = std::move(building[i]);
+    }
+  }
+
+  std::lock_guard<percpu_rwlock> l(snapshot_lock_);
+  for (int i = 0; i < kNumTabletMapShards; i++) {
+    if (new_shards[i]) {
+      tablet_map_shards_[i].swap(new_shards[i]);
+    }
+  }
+}
+
+void CatalogManager::ClearMapsUnlocked() {
+  DCHECK(lock_.is_write_locked());
+  shared_ptr<const TableMaps> empty_tables = std::make_shared<TableMaps>();
+  shared_ptr<const TabletInfoMap> shards[kNumTabletMapShards];
+  for (auto& shard : shards) {
+    shard = std::make_shared<TabletInfoMap>();
+  }
+
+  std::lock_guard<percpu_rwlock> l(snapshot_lock_);
+  table_maps_.swap(empty_tables);
+  for (int i = 0; i < kNumTabletMapShards; i++) {
+    tablet_map_shards_[i].swap(shards[i]);
+  }
+}
+
 Status CatalogManager::InitSysCatalogAsync(bool is_first_run) {
   std::lock_guard<LockType> l(lock_);
   unique_ptr<SysCatalogTable> new_catalog(new SysCatalogTable(
@@ -1216,6 +1322,10 @@ void CatalogManager::Shutdown() {
     state_ = kClosing;
   }
 
+  if (auto_rebalancer_) {
+    auto_rebalancer_->Shutdown();
+  }
+
   // Shutdown the Catalog Manager background thread
   if (background_tasks_) {
     background_tasks_->Shutdown();
@@ -1233,10 +1343,7 @@ void CatalogManager::Shutdown() {
   // adds more entries to the map even after we finish; it won't start any new
   // tasks for those entries.
   vector<scoped_refptr<TableInfo>> copy;
-  {
-    shared_lock<LockType> l(lock_);
-    AppendValuesFromMap(table_ids_map_, &copy);
-  }
+  AppendValuesFromMap(table_maps()->ids, &copy);
   AbortAndWaitForAllTasks(copy);
 
   // Shutdown the underlying consensus implementation. This aborts all pending
@@ -1539,7 +1646,7 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
     TRACE("Acquired catalog manager lock");
 
     // b. Verify that the table does not exist.
-    table = FindPtrOrNull(normalized_table_names_map_, normalized_table_name);
+    table = FindPtrOrNull(table_maps()->names, normalized_table_name);
     if (table != nullptr) {
       return SetupError(Status::AlreadyPresent(Substitute(
               "table $0 already exists with id $1", normalized_table_name, table->id())),
@@ -1655,11 +1762,17 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
   {
     std::lock_guard<LockType> l(lock_);
 
-    table_ids_map_[table->id()] = table;
-    normalized_table_names_map_[normalized_table_name] = table;
+    // Publish the tablets first, so that any lookup which finds the table
+    // also finds its tablets.
     for (const auto& tablet : tablets) {
-      InsertOrDie(&tablet_map_, tablet->id(), tablet);
+      DCHECK(!FindTablet(tablet->id())) << tablet->id();
     }
+    AddTabletsUnlocked(tablets);
+
+    auto maps = std::make_shared<TableMaps>(*table_maps());
+    maps->ids[table->id()] = table;
+    maps->names[normalized_table_name] = table;
+    PublishTableMapsUnlocked(std::move(maps));
   }
   TRACE("Inserted table and tablets into CatalogManager maps");
 
@@ -1734,19 +1847,19 @@ Status CatalogManager::FindAndLockTable(const ReqClass& request,
 
   scoped_refptr<TableInfo> table;
   {
-    shared_lock<LockType> l(lock_);
+    const auto maps = table_maps();
     if (table_identifier.has_table_id()) {
-      table = FindPtrOrNull(table_ids_map_, table_identifier.table_id());
+      table = FindPtrOrNull(maps->ids, table_identifier.table_id());
 
       // If the request contains both a table ID and table name, ensure that
       // both match the same table.
       if (table_identifier.has_table_name() &&
-          table.get() != FindPtrOrNull(normalized_table_names_map_,
+          table.get() != FindPtrOrNull(maps->names,
                                        NormalizeTableName(table_identifier.table_name())).get()) {
         return tnf_error();
       }
     } else if (table_identifier.has_table_name()) {
-      table = FindPtrOrNull(normalized_table_names_map_,
+      table = FindPtrOrNull(maps->names,
                             NormalizeTableName(table_identifier.table_name()));
     } else {
       return SetupError(Status::InvalidArgument("missing table ID or table name"),
@@ -1892,11 +2005,13 @@ Status CatalogManager::DeleteTable(const DeleteTableRequestPB& req,
     {
       TRACE("Removing table from by-name map");
       std::lock_guard<LockType> l_map(lock_);
-      if (normalized_table_names_map_.erase(NormalizeTableName(l.data().name())) != 1) {
+      auto maps = std::make_shared<TableMaps>(*table_maps());
+      if (maps->names.erase(NormalizeTableName(l.data().name())) != 1) {
         LOG(FATAL) << "Could not remove table " << table->ToString()
                    << " from map in response to DeleteTable request: "
                    << SecureShortDebugString(req);
       }
+      PublishTableMapsUnlocked(std::move(maps));
     }
 
     // 5. Commit the dirty tablet state.
@@ -2337,7 +2452,7 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB& req,
     //
     // Special case: if this is a rename of a table from a non-normalized to
     // normalized name (ALTER TABLE A RENAME to a), then allow it.
-    scoped_refptr<TableInfo> other_table = FindPtrOrNull(normalized_table_names_map_,
+    scoped_refptr<TableInfo> other_table = FindPtrOrNull(table_maps()->names,
                                                          normalized_new_table_name);
     if (other_table &&
         !(table.get() == other_table.get() && l.data().name() != normalized_new_table_name)) {
@@ -2462,19 +2577,23 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB& req,
     // Take the global catalog manager lock in order to modify the global table
     // and tablets indices.
     std::lock_guard<LockType> lock(lock_);
+
+    // Insert new tablets into the global tablet map. After this, the tablets
+    // will be visible in GetTabletLocations RPCs.
+    for (const auto& tablet : tablets_to_add) {
+      DCHECK(!FindTablet(tablet->id())) << tablet->id();
+    }
+    AddTabletsUnlocked(tablets_to_add);
+
     if (req.has_new_table_name()) {
-      if (normalized_table_names_map_.erase(normalized_table_name) != 1) {
+      auto maps = std::make_shared<TableMaps>(*table_maps());
+      if (maps->names.erase(normalized_table_name) != 1) {
         LOG(FATAL) << "Could not remove table " << table->ToString()
                    << " from map in response to AlterTable request: "
                    << SecureShortDebugString(req);
       }
-      InsertOrDie(&normalized_table_names_map_, normalized_new_table_name, table);
-    }
-
-    // Insert new tablets into the global tablet map. After this, the tablets
-    // will be visible in GetTabletLocations RPCs.
-    for (const auto& tablet : tablets_to_add) {
-      InsertOrDie(&tablet_map_, tablet->id(), tablet);
+      InsertOrDie(&maps->names, normalized_new_table_name, table);
+      PublishTableMapsUnlocked(std::move(maps));
     }
   }
 
@@ -2588,9 +2707,8 @@ Status CatalogManager::ListTables(const ListTablesRequestPB* req,
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
 
-  shared_lock<LockType> l(lock_);
-
-  for (const TableInfoMap::value_type& entry : normalized_table_names_map_) {
+  const auto maps = table_maps();
+  for (const TableInfoMap::value_type& entry : maps->names) {
     TableMetadataLock ltm(entry.second.get(), LockMode::READ);
     if (!ltm.data().is_running()) continue; // implies !is_deleted() too
 
@@ -2613,8 +2731,7 @@ Status CatalogManager::GetTableInfo(const string& table_id, scoped_refptr<TableI
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
 
-  shared_lock<LockType> l(lock_);
-  *table = FindPtrOrNull(table_ids_map_, table_id);
+  *table = FindPtrOrNull(table_maps()->ids, table_id);
   return Status::OK();
 }
 
@@ -2623,8 +2740,7 @@ Status CatalogManager::GetAllTables(vector<scoped_refptr<TableInfo>>* tables) {
   RETURN_NOT_OK(CheckOnline());
 
   tables->clear();
-  shared_lock<LockType> l(lock_);
-  AppendValuesFromMap(table_ids_map_, tables);
+  AppendValuesFromMap(table_maps()->ids, tables);
 
   return Status::OK();
 }
@@ -2633,8 +2749,7 @@ Status CatalogManager::TableNameExists(const string& table_name, bool* exists) {
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
 
-  shared_lock<LockType> l(lock_);
-  *exists = ContainsKey(normalized_table_names_map_, NormalizeTableName(table_name));
+  *exists = ContainsKey(table_maps()->names, NormalizeTableName(table_name));
   return Status::OK();
 }
 
@@ -2672,6 +2787,38 @@ bool ShouldTransitionTabletToRunning(const scoped_refptr<TabletInfo>& tablet,
       IsRaftConfigMember(cstate.leader_uuid(), cstate.committed_config());
 }
 
+// Returns true if processing the full consensus state summarized by 'digest',
+// as reported by the tablet server 'ts_uuid', would leave the tablet as it
+// is, given its previous consensus state 'prev_cstate' and whether it's
+// running.
+bool IsConsensusStateDigestCurrent(const ConsensusStateDigestPB& digest,
+                                   const ConsensusStatePB& prev_cstate,
+                                   bool tablet_running,
+                                   const string& ts_uuid) {
+  // A tablet which isn't running yet may be waiting for its leader.
+  if (!tablet_running) return false;
+
+  // Has a config change been committed?
+  if (digest.committed_config_opid_index() >
+      prev_cstate.committed_config().opid_index()) {
+    return false;
+  }
+
+  // Is there a new leader? A reported leader which isn't a member of the
+  // committed config would be disregarded, but the digest doesn't carry the
+  // config to check that against.
+  if (!digest.leader_uuid().empty() &&
+      (prev_cstate.leader_uuid().empty() ||
+       digest.current_term() > prev_cstate.current_term())) {
+    return false;
+  }
+
+  // The leader's reports carry the health of the replicas, which decides
+  // whether replicas are added or evicted.
+  return !FLAGS_raft_prepare_replacement_before_eviction ||
+      digest.leader_uuid() != ts_uuid;
+}
+
 } // anonymous namespace
 
 Status CatalogManager::GetTabletReplica(const string& tablet_id,
@@ -3592,16 +3739,19 @@ Status CatalogManager::ProcessTabletReport(
   // acquisitions by reusing locks for tablets belonging to the same table, and
   // although one-at-a-time acquisition would reduce table lock contention when
   // writing, table writes are very rare events.
+  //
+  // Tablets reported with only a digest of their consensus state are never
+  // mutated, and are locked for READ instead, so that the full reports sent
+  // en masse after a master election don't contend with other writers of
+  // the tablets. The READ locks are released before the WRITE locks are
+  // committed, since committing waits for each tablet's readers.
   TableMetadataGroupLock tables_lock(LockMode::RELEASED);
   TabletMetadataGroupLock tablets_lock(LockMode::RELEASED);
+  TabletMetadataGroupLock unchanged_tablets_lock(LockMode::RELEASED);
 
   // 1. Set up local state.
   full_report_update->mutable_tablets()->Reserve(num_tablets);
   {
-    // We only need to acquire lock_ for the tablet_map_ access, but since it's
-    // acquired exclusively so rarely, it's probably cheaper to acquire and
-    // hold it for all tablets here than to acquire/release it for each tablet.
-    shared_lock<LockType> l(lock_);
     for (const ReportedTabletPB& report : full_report.updated_tablets()) {
       const string& tablet_id = report.tablet_id();
 
@@ -3611,7 +3761,7 @@ Status CatalogManager::ProcessTabletReport(
       update->set_tablet_id(tablet_id);
 
       // 1b. Find the tablet, deleting/skipping it if it can't be found.
-      scoped_refptr<TabletInfo> tablet = FindPtrOrNull(tablet_map_, tablet_id);
+      scoped_refptr<TabletInfo> tablet = FindTablet(tablet_id);
       if (!tablet) {
         // It'd be unsafe to ask the tserver to delete this tablet without first
         // replicating something to our followers (i.e. to guarantee that we're
@@ -3631,13 +3781,18 @@ Status CatalogManager::ProcessTabletReport(
       updates[tablet_id] = update;
       tablet_infos[tablet_id] = tablet;
       tables_lock.AddInfo(*tablet->table().get());
-      tablets_lock.AddMutableInfo(tablet.get());
+      if (report.has_consensus_state_digest() && !report.has_consensus_state()) {
+        unchanged_tablets_lock.AddInfo(*tablet);
+      } else {
+        tablets_lock.AddMutableInfo(tablet.get());
+      }
     }
   }
 
   // 2. Lock the affected tables and tablets.
   tables_lock.Lock(LockMode::READ);
   tablets_lock.Lock(LockMode::WRITE);
+  unchanged_tablets_lock.Lock(LockMode::READ);
 
   // 3. Process each tablet. This may not be in the order that the tablets
   // appear in 'full_report', but that has no bearing on correctness.
@@ -3675,10 +3830,14 @@ Status CatalogManager::ProcessTabletReport(
     // just been added to the committed config and are in the process of copying.
     const ConsensusStatePB& prev_cstate = tablet->metadata().state().pb.consensus_state();
     const int64_t prev_opid_index = prev_cstate.committed_config().opid_index();
-    const int64_t report_opid_index = (report.has_consensus_state() &&
-        report.consensus_state().committed_config().has_opid_index()) ?
-            report.consensus_state().committed_config().opid_index() :
-            consensus::kInvalidOpIdIndex;
+    int64_t report_opid_index = consensus::kInvalidOpIdIndex;
+    if (report.has_consensus_state()) {
+      if (report.consensus_state().committed_config().has_opid_index()) {
+        report_opid_index = report.consensus_state().committed_config().opid_index();
+      }
+    } else if (report.consensus_state_digest().has_committed_config_opid_index()) {
+      report_opid_index = report.consensus_state_digest().committed_config_opid_index();
+    }
     if (FLAGS_master_tombstone_evicted_tablet_replicas &&
         report.tablet_data_state() != TABLET_DATA_TOMBSTONED &&
         report.tablet_data_state() != TABLET_DATA_DELETED &&
@@ -3861,6 +4020,24 @@ Status CatalogManager::ProcessTabletReport(
               master_, tablet, cstate, RaftPeerPB::NON_VOTER, &rng_));
         }
       }
+    } else if (report.has_consensus_state_digest()) {
+      // 7f. A digest stands in for a consensus state which the tablet server
+      // expects is unchanged. As in 7a, skip replicas without a committed
+      // config opid_index.
+      const ConsensusStateDigestPB& digest = report.consensus_state_digest();
+      if (!digest.has_committed_config_opid_index()) {
+        continue;
+      }
+      // If the full consensus state might have changed anything above, ask
+      // for it in the next heartbeat.
+      if (!IsConsensusStateDigestCurrent(digest, prev_cstate,
+                                         tablet->metadata().state().is_running(),
+                                         ts_desc->permanent_uuid())) {
+        VLOG(1) << Substitute("T $0 P $1 reported a stale consensus state digest: $2",
+                              tablet_id, ts_desc->permanent_uuid(),
+                              SecureShortDebugString(digest));
+        update->set_needs_consensus_state(true);
+      }
     }
 
     // 8. Send an AlterSchema RPC if the tablet has an old schema version.
@@ -3892,13 +4069,19 @@ Status CatalogManager::ProcessTabletReport(
     }
   }
 
-  // 10. Unlock the tables; we no longer need to access their state.
+  // 10. Unlock the tables and the unchanged tablets; we no longer need to
+  // access their state.
   tables_lock.Unlock();
+  unchanged_tablets_lock.Unlock();
 
   // 11. Write all tablet mutations to the catalog table.
   //
   // SysCatalogTable::Write will short-circuit the case where the data has not
   // in fact changed since the previous version and avoid any unnecessary mutations.
+  unordered_map<string, scoped_refptr<TableInfo>> mutated_tables;
+  for (const auto& tablet : mutated_tablets) {
+    mutated_tables.emplace(tablet->table()->id(), tablet->table());
+  }
   SysCatalogTable::Actions actions;
   actions.tablets_to_update = std::move(mutated_tablets);
   Status s = sys_catalog_->Write(actions);
@@ -3912,8 +4095,12 @@ Status CatalogManager::ProcessTabletReport(
   // Having successfully written the tablet mutations, this function cannot
   // fail from here on out.
 
-  // 12. Publish the in-memory tablet mutations and release the locks.
+  // 12. Publish the in-memory tablet mutations and release the locks, and
+  // invalidate the cached locations of the mutated tablets.
   tablets_lock.Commit();
+  for (const auto& e : mutated_tables) {
+    e.second->InvalidateCachedLocations();
+  }
 
   // 13. Process all tablet schema version changes.
   //
@@ -4033,7 +4220,7 @@ void CatalogManager::SendDeleteTabletRequest(const scoped_refptr<TabletInfo>& ta
 void CatalogManager::ExtractTabletsToProcess(
     vector<scoped_refptr<TabletInfo>>* tablets_to_process) {
 
-  shared_lock<LockType> l(lock_);
+  const auto maps = table_maps();
 
   // TODO: At the moment we loop through all the tablets
   //       we can keep a set of tablets waiting for "assignment"
@@ -4042,7 +4229,7 @@ void CatalogManager::ExtractTabletsToProcess(
 
   // 'tablets_to_process' elements must be partially ordered in the same way as
   // table->GetAllTablets(); see the locking rules at the top of the file.
-  for (const auto& table_entry : table_ids_map_) {
+  for (const auto& table_entry : maps->ids) {
     scoped_refptr<TableInfo> table = table_entry.second;
     TableMetadataLock table_lock(table.get(), LockMode::READ);
     if (table_lock.data().is_deleted()) {
@@ -4319,9 +4506,7 @@ Status CatalogManager::ProcessPendingAssignments(
   // Acquire the global lock to publish the new tablets.
   {
     std::lock_guard<LockType> l(lock_);
-    for (const auto& t : deferred.tablets_to_add) {
-      tablet_map_[t->id()] = t;
-    }
+    AddTabletsUnlocked(deferred.tablets_to_add);
   }
 
   // Send DeleteTablet requests to tablet servers serving deleted tablets.
@@ -4485,12 +4670,9 @@ Status CatalogManager::GetTabletLocations(const string& tablet_id,
   RETURN_NOT_OK(CheckOnline());
 
   locs_pb->mutable_replicas()->Clear();
-  scoped_refptr<TabletInfo> tablet_info;
-  {
-    shared_lock<LockType> l(lock_);
-    if (!FindCopy(tablet_map_, tablet_id, &tablet_info)) {
-      return Status::NotFound(Substitute("Unknown tablet $0", tablet_id));
-    }
+  scoped_refptr<TabletInfo> tablet_info = FindTablet(tablet_id);
+  if (!tablet_info) {
+    return Status::NotFound(Substitute("Unknown tablet $0", tablet_id));
   }
 
   return BuildLocationsForTablet(tablet_info, filter, locs_pb);
@@ -4501,12 +4683,9 @@ Status CatalogManager::ReplaceTablet(const string& tablet_id, ReplaceTabletRespo
   RETURN_NOT_OK(CheckOnline());
 
   // Lookup the tablet-to-be-replaced and get its table.
-  scoped_refptr<TabletInfo> old_tablet;
-  {
-    shared_lock<LockType> l(lock_);
-    if (!FindCopy(tablet_map_, tablet_id, &old_tablet)) {
-      return Status::NotFound(Substitute("Unknown tablet $0", tablet_id));
-    }
+  scoped_refptr<TabletInfo> old_tablet = FindTablet(tablet_id);
+  if (!old_tablet) {
+    return Status::NotFound(Substitute("Unknown tablet $0", tablet_id));
   }
   scoped_refptr<TableInfo> table = old_tablet->table();
 
@@ -4555,7 +4734,8 @@ Status CatalogManager::ReplaceTablet(const string& tablet_id, ReplaceTabletRespo
   // Add the new tablet to the global tablet map.
   {
     std::lock_guard<LockType> l(lock_);
-    InsertOrDie(&tablet_map_, new_tablet->id(), new_tablet);
+    DCHECK(!FindTablet(new_tablet->id())) << new_tablet->id();
+    AddTabletsUnlocked({ new_tablet });
   }
 
   // Next, add the new tablet and remove the old tablet from the table.
@@ -4601,9 +4781,29 @@ Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
   RETURN_NOT_OK(FindAndLockTable(*req, resp, LockMode::READ, &table, &l));
   RETURN_NOT_OK(CheckIfTableDeletedOrNotRunning(&l, resp));
 
+  // Read the locations version before the tablets, so that the locations
+  // built below are cached under it only if they're current.
+  const int64_t locations_version = table->locations_version();
+  const int64_t ts_version = master_->ts_manager()->registration_version();
   vector<scoped_refptr<TabletInfo>> tablets_in_range;
   table->GetTabletsInRange(req, &tablets_in_range);
 
+  // The table's cache serves any request which covers the same range of
+  // tablets, whatever its exact partition keys. The registration version of
+  // the tablet servers is part of the key, so that locations aren't served
+  // with stale tablet server addresses.
+  string cache_key;
+  if (FLAGS_table_locations_cache_capacity > 0 && !tablets_in_range.empty()) {
+    cache_key = Substitute("$0:$1:$2:$3", req->replica_type_filter(), ts_version,
+                           tablets_in_range.front()->id(), tablets_in_range.back()->id());
+    auto cached = table->GetCachedLocations(cache_key, locations_version);
+    if (cached) {
+      resp->mutable_tablet_locations()->CopyFrom(cached->tablet_locations());
+      resp->set_ttl_millis(FLAGS_table_locations_ttl_ms);
+      return Status::OK();
+    }
+  }
+
   for (const auto& tablet : tablets_in_range) {
     Status s = BuildLocationsForTablet(
         tablet, req->replica_type_filter(), resp->add_tablet_locations());
@@ -4630,6 +4830,11 @@ Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
           << s.ToString();
     }
   }
+  if (!cache_key.empty() && !resp->has_error()) {
+    auto locations = std::make_shared<GetTableLocationsResponsePB>();
+    locations->mutable_tablet_locations()->CopyFrom(resp->tablet_locations());
+    table->CacheLocations(cache_key, locations_version, std::move(locations));
+  }
   resp->set_ttl_millis(FLAGS_table_locations_ttl_ms);
   return Status::OK();
 }
@@ -4638,13 +4843,13 @@ void CatalogManager::DumpState(std::ostream* out) const {
   TableInfoMap ids_copy, names_copy;
   TabletInfoMap tablets_copy;
 
-  // Copy the internal state so that, if the output stream blocks,
-  // we don't end up holding the lock for a long time.
+  // Copy the internal state so that the tablets can be erased from the copy
+  // as they're found below.
   {
-    shared_lock<LockType> l(lock_);
-    ids_copy = table_ids_map_;
-    names_copy = normalized_table_names_map_;
-    tablets_copy = tablet_map_;
+    const auto maps = table_maps();
+    ids_copy = maps->ids;
+    names_copy = maps->names;
+    GetAllTablets(&tablets_copy);
     // TODO(aserbin): add information about root CA certs, if any
   }
 
@@ -4961,7 +5166,11 @@ void PersistentTabletInfo::set_state(SysTabletsEntryPB::State state, const strin
 // TableInfo
 ////////////////////////////////////////////////////////////
 
-TableInfo::TableInfo(string table_id) : table_id_(std::move(table_id)) {}
+TableInfo::TableInfo(string table_id)
+    : table_id_(std::move(table_id)),
+      locations_version_(0),
+      num_cached_locations_(0) {
+}
 
 TableInfo::~TableInfo() {
 }
@@ -5000,6 +5209,10 @@ void TableInfo::AddRemoveTablets(const vector<scoped_refptr<TabletInfo>>& tablet
     DCHECK(schema_version_counts_.empty());
   }
 #endif
+
+  // Invalidate with lock_ held, so that lookups which see the new version
+  // also see the new tablets.
+  InvalidateCachedLocations();
 }
 
 void TableInfo::GetTabletsInRange(const GetTableLocationsRequestPB* req,
@@ -5112,6 +5325,56 @@ void TableInfo::GetAllTablets(vector<scoped_refptr<TabletInfo>>* ret) const {
   }
 }
 
+int64_t TableInfo::locations_version() const {
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  return locations_version_;
+}
+
+void TableInfo::InvalidateCachedLocations() {
+  unordered_map<string, shared_ptr<const GetTableLocationsResponsePB>> evicted;
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  locations_version_++;
+  // Free the evicted locations after the lock is released.
+  evicted.swap(cached_locations_);
+  num_cached_locations_ = 0;
+}
+
+shared_ptr<const GetTableLocationsResponsePB> TableInfo::GetCachedLocations(
+    const string& key, int64_t version) const {
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  if (version != locations_version_) {
+    return nullptr;
+  }
+  return FindPtrOrNull(cached_locations_, key);
+}
+
+void TableInfo::CacheLocations(const string& key, int64_t version,
+                               shared_ptr<const GetTableLocationsResponsePB> locations) {
+  const int64_t capacity = FLAGS_table_locations_cache_capacity;
+  const int64_t size = locations->tablet_locations_size();
+  if (size > capacity) {
+    return;
+  }
+  vector<shared_ptr<const GetTableLocationsResponsePB>> evicted;
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  if (version != locations_version_ || ContainsKey(cached_locations_, key)) {
+    return;
+  }
+  while (num_cached_locations_ + size > capacity) {
+    auto it = cached_locations_.begin();
+    num_cached_locations_ -= it->second->tablet_locations_size();
+    evicted.emplace_back(std::move(it->second));
+    cached_locations_.erase(it);
+  }
+  num_cached_locations_ += size;
+  InsertOrDie(&cached_locations_, key, std::move(locations));
+}
+
+int64_t TableInfo::num_cached_locations() const {
+  std::lock_guard<simple_spinlock> l(locations_cache_lock_);
+  return num_cached_locations_;
+}
+
 void TableInfo::IncrementSchemaVersionCountUnlocked(int64_t version) {
   DCHECK(lock_.is_write_locked());
   schema_version_counts_[version]++;
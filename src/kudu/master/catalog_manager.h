@@ -92,6 +92,7 @@ class HmsCatalog;
 
 namespace master {
 
+class AutoRebalancerTask;
 class CatalogManagerBgTasks;
 class HmsNotificationLogListenerTask;
 class Master;
@@ -293,6 +294,33 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
     return tablet_map_.size();
   }
 
+  // The version of the table's tablet locations, which changes whenever the
+  // table's tablets, or their states or consensus configurations, may have
+  // changed. It must be read before the tablets themselves, so that locations
+  // built from them are never cached under a newer version.
+  int64_t locations_version() const;
+
+  // Invalidates the cached locations of the table's tablets, by advancing the
+  // locations version.
+  //
+  // Must be called after any change to the tablets' states or consensus
+  // configurations is committed.
+  void InvalidateCachedLocations();
+
+  // Returns the tablet locations cached under 'key' at 'version', or NULL if
+  // there are none or the locations have changed since.
+  std::shared_ptr<const GetTableLocationsResponsePB> GetCachedLocations(
+      const std::string& key, int64_t version) const;
+
+  // Caches 'locations' under 'key', provided they were built at the current
+  // locations version. Other entries are evicted as necessary to keep the
+  // cache within --table_locations_cache_capacity tablet locations.
+  void CacheLocations(const std::string& key, int64_t version,
+                      std::shared_ptr<const GetTableLocationsResponsePB> locations);
+
+  // Returns the number of tablet locations cached for the table.
+  int64_t num_cached_locations() const;
+
  private:
   friend class RefCountedThreadSafe<TableInfo>;
   friend class TabletInfo;
@@ -331,6 +359,20 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   // tablet_map_ and summing up the tablets' reported schema versions.
   std::map<int64_t, int64_t> schema_version_counts_;
 
+  // Protects locations_version_ and the cached locations.
+  mutable simple_spinlock locations_cache_lock_;
+
+  int64_t locations_version_;
+
+  // GetTableLocations() responses built at locations_version_, holding only
+  // their tablet locations, keyed by the range of tablets they cover and the
+  // request's replica type filter.
+  std::unordered_map<std::string, std::shared_ptr<const GetTableLocationsResponsePB>>
+      cached_locations_;
+
+  // The total number of tablet locations in cached_locations_.
+  int64_t num_cached_locations_;
+
   DISALLOW_COPY_AND_ASSIGN(TableInfo);
 };
 
@@ -694,6 +736,9 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   FRIEND_TEST(MasterTest, TestShutdownDuringTableVisit);
   FRIEND_TEST(MasterTest, TestGetTableLocationsDuringRepeatedTableVisit);
 
+  // This test exclusively acquires lock_ directly.
+  FRIEND_TEST(MasterTest, TestLocationLookupsDontWaitForCatalogLock);
+
   // This test calls VisitTablesAndTablets() directly.
   FRIEND_TEST(kudu::CreateTableStressTest, TestConcurrentCreateTableAndReloadMetadata);
 
@@ -706,6 +751,47 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   typedef std::unordered_map<std::string, scoped_refptr<TableInfo>> TableInfoMap;
   typedef std::unordered_map<std::string, scoped_refptr<TabletInfo>> TabletInfoMap;
 
+  // The table maps, which are published together so that a lookup by both
+  // table ID and name sees them agree.
+  struct TableMaps {
+    // table-id -> TableInfo
+    TableInfoMap ids;
+    // normalized-table-name -> TableInfo
+    TableInfoMap names;
+  };
+
+  // The number of shards of the tablet map.
+  static constexpr int kNumTabletMapShards = 16;
+
+  // Returns the current snapshot of the table maps. The snapshot is immutable,
+  // so it can be searched without holding any lock.
+  std::shared_ptr<const TableMaps> table_maps() const;
+
+  // Replaces the table maps with 'maps'.
+  //
+  // Must be called with lock_ held for writing.
+  void PublishTableMapsUnlocked(std::shared_ptr<const TableMaps> maps);
+
+  // Returns the tablet with the given ID, or NULL if there is none.
+  scoped_refptr<TabletInfo> FindTablet(const std::string& tablet_id) const;
+
+  // Returns all of the tablets in the tablet map.
+  void GetAllTablets(TabletInfoMap* tablets) const;
+
+  // Adds 'tablets' to the tablet map, replacing any tablets with the same IDs.
+  // Each shard holding one of the tablets is copied once.
+  //
+  // Must be called with lock_ held for writing.
+  void AddTabletsUnlocked(const std::vector<scoped_refptr<TabletInfo>>& tablets);
+
+  // Empties the table and tablet maps.
+  //
+  // Must be called with lock_ held for writing.
+  void ClearMapsUnlocked();
+
+  // Returns the shard of the tablet map holding the tablet with the given ID.
+  static int TabletMapShardIndex(const std::string& tablet_id);
+
   // Delete the specified table in the catalog.
   //
   // If a notification log event ID is provided, it will be written to the sys
@@ -945,27 +1031,33 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   // objects have a copy of the string key. But STL doesn't make it
   // easy to make a "gettable set".
 
-  // Lock protecting the various maps and sets below.
+  // Lock serializing changes to the various maps and sets below.
   typedef rw_spinlock LockType;
   mutable LockType lock_;
 
-  // Table maps: table-id -> TableInfo and normalized-table-name -> TableInfo
-  TableInfoMap table_ids_map_;
-  TableInfoMap normalized_table_names_map_;
-
-  // Tablet maps: tablet-id -> TabletInfo
-  TabletInfoMap tablet_map_;
+  // The table and tablet maps are copied on write: a change builds new maps
+  // with lock_ held and publishes them, so that lookups, which only copy a
+  // snapshot pointer, never wait behind DDL or tablet report processing.
+  // The tablet map is sharded by tablet ID, so that adding tablets copies
+  // only the shards they fall in.
+  //
+  // The snapshot pointers are protected by snapshot_lock_, which is held
+  // only to copy or replace a pointer. Its read side is per-CPU, so that
+  // concurrent lookups don't contend on a shared cache line.
+  mutable percpu_rwlock snapshot_lock_;
+  std::shared_ptr<const TableMaps> table_maps_;
+  std::shared_ptr<const TabletInfoMap> tablet_map_shards_[kNumTabletMapShards];
 
   // Names of tables that are currently reserved by CreateTable() or AlterTable().
   //
   // As a rule, operations that add new table names should do so as follows:
   // 1. Acquire lock_.
-  // 2. Ensure normalized_table_names_map_ does not contain the new normalized name.
+  // 2. Ensure the table names map does not contain the new normalized name.
   // 3. Ensure reserved_normalized_table_names_ does not contain the new normalized name.
   // 4. Add the new normalized name to reserved_normalized_table_names_.
   // 5. Release lock_.
   // 6. Perform the operation.
-  // 7. If it succeeded, add the normalized name to normalized_table_names_map_ with lock_ held.
+  // 7. If it succeeded, add the normalized name to the table names map with lock_ held.
   // 8. Remove the new normalized name from reserved_normalized_table_names_ with lock_ held.
   std::unordered_set<std::string> reserved_normalized_table_names_;
 
@@ -985,6 +1077,8 @@ class CatalogManager : public tserver::TabletReplicaLookupIf {
   std::unique_ptr<hms::HmsCatalog> hms_catalog_;
   std::unique_ptr<HmsNotificationLogListenerTask> hms_notification_log_listener_;
 
+  std::unique_ptr<AutoRebalancerTask> auto_rebalancer_;
+
   enum State {
     kConstructed,
     kStarting,
@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
@@ -45,6 +46,7 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/replica_management.pb.h"
 #include "kudu/generated/version_defines.h"
 #include "kudu/gutil/dynamic_annotations.h"
@@ -68,6 +70,8 @@
 #include "kudu/security/token.pb.h"
 #include "kudu/security/token_verifier.h"
 #include "kudu/server/rpc_server.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/tablet.pb.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/curl_util.h"
@@ -84,6 +88,9 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/version_info.h"
 
+using kudu::consensus::ConsensusStatePB;
+using kudu::consensus::RaftConfigPB;
+using kudu::consensus::RaftPeerPB;
 using kudu::consensus::ReplicaManagementInfoPB;
 using kudu::pb_util::SecureDebugString;
 using kudu::pb_util::SecureShortDebugString;
@@ -317,6 +324,7 @@ TEST_F(MasterTest, TestRegisterAndHeartbeat) {
     ASSERT_FALSE(resp.needs_reregister());
     ASSERT_FALSE(resp.needs_full_tablet_report());
     ASSERT_TRUE(resp.has_tablet_report());
+    ASSERT_TRUE(resp.accepts_consensus_state_digests());
   }
 
   // Having sent a full report, an incremental report will also be processed.
@@ -964,6 +972,138 @@ TEST_F(MasterTest, TestGetTableLocationsDuringRepeatedTableVisit) {
   t.join();
 }
 
+// Tests that table and tablet location lookups are served while the catalog
+// manager's maps are locked for writing, e.g. by DDL.
+TEST_F(MasterTest, TestLocationLookupsDontWaitForCatalogLock) {
+  const char* const kTsUUID = "my-ts-uuid";
+  const char* const kTableName = "test";
+  const Schema kTableSchema({ ColumnSchema("key", INT32) }, 1);
+
+  TSToMasterCommonPB common;
+  common.mutable_ts_instance()->set_permanent_uuid(kTsUUID);
+  common.mutable_ts_instance()->set_instance_seqno(1);
+
+  // Register a fake TS to host the table's tablet.
+  {
+    TSHeartbeatRequestPB req;
+    TSHeartbeatResponsePB resp;
+    RpcController rpc;
+    req.mutable_common()->CopyFrom(common);
+    ServerRegistrationPB* reg = req.mutable_registration();
+    MakeHostPortPB("localhost", 1000, reg->add_rpc_addresses());
+    MakeHostPortPB("localhost", 2000, reg->add_http_addresses());
+    reg->set_software_version(VersionInfo::GetVersionInfo());
+    req.mutable_replica_management_info()->set_replacement_scheme(
+        FLAGS_raft_prepare_replacement_before_eviction
+            ? ReplicaManagementInfoPB::PREPARE_REPLACEMENT_BEFORE_EVICTION
+            : ReplicaManagementInfoPB::EVICT_FIRST);
+    ASSERT_OK(proxy_->TSHeartbeat(req, &resp, &rpc));
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  // Create a table with a single tablet, replicated only to the fake TS.
+  {
+    CreateTableRequestPB req;
+    CreateTableResponsePB resp;
+    RpcController controller;
+    req.set_name(kTableName);
+    req.set_num_replicas(1);
+    ASSERT_OK(SchemaToPB(kTableSchema, req.mutable_schema()));
+    ASSERT_OK(proxy_->CreateTable(req, &resp, &controller));
+    ASSERT_FALSE(resp.has_error()) << SecureDebugString(resp);
+  }
+
+  // Wait for the catalog manager to assign the tablet to the fake TS.
+  scoped_refptr<TabletInfo> tablet;
+  ASSERT_EVENTUALLY([&]() {
+    CatalogManager* catalog = master_->catalog_manager();
+    CatalogManager::ScopedLeaderSharedLock l(catalog);
+    ASSERT_OK(l.first_failed_status());
+    vector<scoped_refptr<TableInfo>> tables;
+    ASSERT_OK(catalog->GetAllTables(&tables));
+    ASSERT_EQ(1, tables.size());
+    vector<scoped_refptr<TabletInfo>> tablets;
+    tables[0]->GetAllTablets(&tablets);
+    ASSERT_EQ(1, tablets.size());
+    TabletMetadataLock tablet_lock(tablets[0].get(), LockMode::READ);
+    ASSERT_EQ(SysTabletsEntryPB::CREATING, tablet_lock.data().pb.state());
+    tablet = tablets[0];
+  });
+
+  // Report the replica as running, and as the leader of its config, so that
+  // the tablet starts running.
+  {
+    TSHeartbeatRequestPB req;
+    TSHeartbeatResponsePB resp;
+    RpcController rpc;
+    req.mutable_common()->CopyFrom(common);
+    TabletReportPB* tr = req.mutable_tablet_report();
+    tr->set_is_incremental(false);
+    tr->set_sequence_number(0);
+    ReportedTabletPB* reported = tr->add_updated_tablets();
+    reported->set_tablet_id(tablet->id());
+    reported->set_state(tablet::RUNNING);
+    reported->set_tablet_data_state(tablet::TABLET_DATA_READY);
+    ConsensusStatePB* cstate = reported->mutable_consensus_state();
+    cstate->set_current_term(1);
+    cstate->set_leader_uuid(kTsUUID);
+    RaftConfigPB* config = cstate->mutable_committed_config();
+    config->set_opid_index(1);
+    RaftPeerPB* peer = config->add_peers();
+    peer->set_permanent_uuid(kTsUUID);
+    peer->set_member_type(RaftPeerPB::VOTER);
+    MakeHostPortPB("localhost", 1000, peer->mutable_last_known_addr());
+    ASSERT_OK(proxy_->TSHeartbeat(req, &resp, &rpc));
+    ASSERT_FALSE(resp.has_error());
+  }
+  {
+    TabletMetadataLock tablet_lock(tablet.get(), LockMode::READ);
+    ASSERT_TRUE(tablet_lock.data().is_running());
+  }
+
+  // Hold the catalog manager's lock, as DDL does. Looking up the tablet's
+  // locations must still succeed, well within the RPC deadline.
+  std::lock_guard<CatalogManager::LockType> l(master_->catalog_manager()->lock_);
+
+  {
+    GetTableLocationsRequestPB req;
+    GetTableLocationsResponsePB resp;
+    RpcController controller;
+    controller.set_timeout(MonoDelta::FromSeconds(10));
+    req.mutable_table()->set_table_name(kTableName);
+    ASSERT_OK(proxy_->GetTableLocations(req, &resp, &controller));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_EQ(1, resp.tablet_locations_size());
+    const TabletLocationsPB& locs = resp.tablet_locations(0);
+    ASSERT_EQ(tablet->id(), locs.tablet_id());
+    ASSERT_EQ(1, locs.replicas_size());
+    ASSERT_EQ(kTsUUID, locs.replicas(0).ts_info().permanent_uuid());
+    ASSERT_EQ(RaftPeerPB::LEADER, locs.replicas(0).role());
+  }
+
+  {
+    GetTabletLocationsRequestPB req;
+    GetTabletLocationsResponsePB resp;
+    RpcController controller;
+    controller.set_timeout(MonoDelta::FromSeconds(10));
+    req.add_tablet_ids(tablet->id());
+    ASSERT_OK(proxy_->GetTabletLocations(req, &resp, &controller));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_EQ(0, resp.errors_size());
+    ASSERT_EQ(1, resp.tablet_locations_size());
+    const TabletLocationsPB& locs = resp.tablet_locations(0);
+    ASSERT_EQ(tablet->id(), locs.tablet_id());
+    ASSERT_EQ(1, locs.replicas_size());
+    const TSInfoPB& ts_info = locs.replicas(0).ts_info();
+    ASSERT_EQ(kTsUUID, ts_info.permanent_uuid());
+    ASSERT_EQ(1, ts_info.rpc_addresses_size());
+    ASSERT_EQ("localhost", ts_info.rpc_addresses(0).host());
+    ASSERT_EQ(1000, ts_info.rpc_addresses(0).port());
+    ASSERT_EQ(RaftPeerPB::LEADER, locs.replicas(0).role());
+  }
+}
+
 // The catalog manager had a bug wherein GetTableSchema() interleaved with
 // CreateTable() could expose intermediate uncommitted state to clients. This
 // test ensures that bug does not regress.
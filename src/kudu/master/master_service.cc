@@ -17,6 +17,7 @@
 
 #include "kudu/master/master_service.h"
 
+#include <algorithm>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -160,6 +161,7 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 2. All responses contain this.
   resp->mutable_master_instance()->CopyFrom(server_->instance_pb());
   resp->set_leader_master(is_leader_master);
+  resp->set_accepts_consensus_state_digests(true);
 
   // 3. Register or look up the tserver.
   shared_ptr<TSDescriptor> ts_desc;
@@ -231,6 +233,14 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 4. Update tserver soft state based on the heartbeat contents.
   ts_desc->UpdateHeartbeatTime();
   ts_desc->set_num_live_replicas(req->num_live_tablets());
+  if (req->has_load_stats()) {
+    const auto& stats = req->load_stats();
+    double max_utilization = 0;
+    for (double utilization : stats.data_dir_utilization()) {
+      max_utilization = std::max(max_utilization, utilization);
+    }
+    ts_desc->set_load_stats(std::max(0.0, stats.wal_bytes_per_sec()), max_utilization);
+  }
 
   // 5. Only leaders handle tablet reports.
   if (is_leader_master && req->has_tablet_report()) {
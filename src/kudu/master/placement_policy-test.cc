@@ -334,6 +334,36 @@ TEST_F(PlacementPolicyTest, PlaceTabletReplicasNoLoc) {
   }
 }
 
+// New replicas avoid tablet servers which host as many replicas as others,
+// but which write more, or whose disks are fuller.
+TEST_F(PlacementPolicyTest, PlaceTabletReplicasByLoad) {
+  const vector<LocationInfo> cluster_info = {
+    { "", { { "ts0", 10 }, { "ts1", 10 }, } },
+  };
+
+  // The server writing to its WALs at the highest rate in the cluster,
+  // and the server with a nearly full data directory, count as hosting
+  // about twice as many replicas. So, they aren't chosen until the other
+  // server has had about as many replicas placed on it.
+  for (bool by_disk : { false, true }) {
+    SCOPED_TRACE(by_disk ? "disk utilization" : "WAL write rate");
+    ASSERT_OK(Prepare(cluster_info));
+    const auto hot = GetDescriptors({ "ts1" })[0];
+    if (by_disk) {
+      hot->set_load_stats(0, 0.95);
+    } else {
+      hot->set_load_stats(10 * 1024 * 1024, 0);
+    }
+    PlacementPolicy policy(descriptors(), rng());
+    for (int i = 0; i < 5; ++i) {
+      TSDescriptorVector result;
+      ASSERT_OK(policy.PlaceTabletReplicas(1, &result));
+      ASSERT_EQ(1, result.size());
+      EXPECT_EQ("ts0", result[0]->permanent_uuid());
+    }
+  }
+}
+
 TEST_F(PlacementPolicyTest, PlaceTabletReplicas) {
   const vector<LocationInfo> cluster_info = {
     { "A", { { "A_ts0", 2 }, { "A_ts1", 1 }, { "A_ts2", 3 }, } },
@@ -17,6 +17,7 @@
 
 #include "kudu/master/placement_policy.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <iterator>
 #include <limits>
@@ -30,13 +31,34 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/ts_descriptor.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/random.h"
 
+DEFINE_double(placement_wal_load_weight, 1.0,
+              "How much the rate at which a tablet server writes to its WALs "
+              "weighs in when choosing tablet servers for new tablet replicas. "
+              "The replica load of the server with the highest WAL write rate "
+              "in the cluster is inflated by this fraction, and that of other "
+              "servers in proportion to their WAL write rates. "
+              "A value of 0 ignores WAL write rates.");
+TAG_FLAG(placement_wal_load_weight, advanced);
+TAG_FLAG(placement_wal_load_weight, runtime);
+
+DEFINE_double(placement_disk_utilization_weight, 1.0,
+              "How much the utilization of a tablet server's fullest data "
+              "directory weighs in when choosing tablet servers for new tablet "
+              "replicas. The replica load of a server is inflated by this "
+              "multiple of the fraction of the data directory that is in use. "
+              "A value of 0 ignores disk utilization.");
+TAG_FLAG(placement_disk_utilization_weight, advanced);
+TAG_FLAG(placement_disk_utilization_weight, runtime);
+
 using std::multimap;
 using std::numeric_limits;
 using std::set;
@@ -51,23 +73,37 @@ namespace master {
 
 namespace {
 
-double GetTSLoad(TSDescriptor* desc) {
-  return desc->RecentReplicaCreations() + desc->num_live_replicas();
+// Returns the load of the tablet server 'desc', where 'max_wal_bytes_per_sec'
+// is the highest WAL write rate of the tablet servers in the cluster.
+double GetTSLoad(TSDescriptor* desc, double max_wal_bytes_per_sec) {
+  double replica_load = desc->RecentReplicaCreations() + desc->num_live_replicas();
+
+  // The replica load is inflated by the server's write and disk load. One is
+  // added so that the write and disk load still count on an empty server.
+  double factor = 1 + FLAGS_placement_disk_utilization_weight *
+      desc->max_data_dir_utilization();
+  if (max_wal_bytes_per_sec > 0) {
+    factor += FLAGS_placement_wal_load_weight *
+        desc->wal_bytes_per_sec() / max_wal_bytes_per_sec;
+  }
+  return (replica_load + 1) * factor;
 }
 
 // Given exactly two choices in 'two_choices', pick the better tablet server on
 // which to place a tablet replica. Ties are broken using 'rng'.
 shared_ptr<TSDescriptor> PickBetterReplica(
     const TSDescriptorVector& two_choices,
+    double max_wal_bytes_per_sec,
     ThreadSafeRandom* rng) {
   CHECK_EQ(2, two_choices.size());
 
   const auto& a = two_choices[0];
   const auto& b = two_choices[1];
 
-  // When creating replicas, we consider two aspects of load:
-  //   (1) how many tablet replicas are already on the server, and
-  //   (2) how often we've chosen this server recently.
+  // When creating replicas, we consider these aspects of load:
+  //   (1) how many tablet replicas are already on the server,
+  //   (2) how often we've chosen this server recently, and
+  //   (3) how busy the server is writing, and how full its disks are.
   //
   // The first factor will attempt to put more replicas on servers that
   // are under-loaded (eg because they have newly joined an existing cluster, or have
@@ -79,10 +115,12 @@ shared_ptr<TSDescriptor> PickBetterReplica(
   // we batch the selection process before sending any creation commands to the
   // servers themselves.
   //
-  // TODO(wdberkeley): in the future we may want to factor in other items such
-  // as available disk space, actual request load, etc.
-  double load_a = GetTSLoad(a.get());
-  double load_b = GetTSLoad(b.get());
+  // The third factor keeps new replicas off servers which hold no more
+  // replicas than others, but whose replicas are hotter, or whose data
+  // directories are filling up. The write load is relative to that of the
+  // busiest server, as reported in the servers' heartbeats.
+  double load_a = GetTSLoad(a.get(), max_wal_bytes_per_sec);
+  double load_b = GetTSLoad(b.get(), max_wal_bytes_per_sec);
   if (load_a < load_b) {
     return a;
   }
@@ -98,10 +136,13 @@ shared_ptr<TSDescriptor> PickBetterReplica(
 PlacementPolicy::PlacementPolicy(TSDescriptorVector descs,
                                  ThreadSafeRandom* rng)
     : ts_num_(descs.size()),
-      rng_(rng) {
+      rng_(rng),
+      max_wal_bytes_per_sec_(0) {
   CHECK(rng_);
   for (auto& desc : descs) {
     EmplaceOrDie(&known_ts_ids_, desc->permanent_uuid());
+    max_wal_bytes_per_sec_ = std::max(max_wal_bytes_per_sec_,
+                                      desc->wal_bytes_per_sec());
     string location = desc->location() ? *desc->location() : "";
     LookupOrEmplace(&ltd_, std::move(location),
                     TSDescriptorVector()).emplace_back(std::move(desc));
@@ -285,7 +326,7 @@ shared_ptr<TSDescriptor> PlacementPolicy::SelectReplica(
 
   if (two_choices.size() == 2) {
     // Pick the better of the two.
-    return PickBetterReplica(two_choices, rng_);
+    return PickBetterReplica(two_choices, max_wal_bytes_per_sec_, rng_);
   }
   if (two_choices.size() == 1) {
     return two_choices.front();
@@ -164,6 +164,10 @@ class PlacementPolicy {
 
   // A set of known tablet server identifiers (derived from ltd_).
   std::unordered_set<std::string> known_ts_ids_;
+
+  // The highest WAL write rate among the available tablet servers, relative
+  // to which the write load of each server is weighed.
+  double max_wal_bytes_per_sec_;
 };
 
 } // namespace master
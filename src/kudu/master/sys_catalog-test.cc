@@ -17,6 +17,7 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -28,6 +29,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/catalog_manager.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
@@ -54,7 +56,9 @@ using kudu::security::DataFormat;
 using kudu::security::PrivateKey;
 using std::shared_ptr;
 using std::string;
+using std::thread;
 using std::vector;
+using strings::Substitute;
 
 namespace google {
 namespace protobuf {
@@ -340,6 +344,45 @@ TEST_F(SysCatalogTest, TestSysCatalogTabletsOperations) {
   }
 }
 
+// Test that concurrent writes, which may be coalesced into one replicated
+// write, are all persisted.
+TEST_F(SysCatalogTest, TestConcurrentWrites) {
+  const int kNumThreads = 8;
+  const int kNumTabletsPerThread = 20;
+  scoped_refptr<TableInfo> table(new TableInfo("abc"));
+  SysCatalogTable* sys_catalog = master_->catalog_manager()->sys_catalog();
+
+  vector<thread> threads;
+  vector<Status> statuses(kNumThreads);
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&, i]() {
+      for (int j = 0; j < kNumTabletsPerThread; j++) {
+        const string key = Substitute("$0-$1", i, j);
+        scoped_refptr<TabletInfo> tablet(CreateTablet(table, key, key, key + "0"));
+        TabletMetadataLock l(tablet.get(), LockMode::WRITE);
+        SysCatalogTable::Actions actions;
+        actions.tablets_to_add = { tablet };
+        Status s = sys_catalog->Write(actions);
+        if (!s.ok()) {
+          statuses[i] = s;
+          return;
+        }
+        l.Commit();
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (const auto& s : statuses) {
+    ASSERT_OK(s);
+  }
+
+  TestTabletLoader loader;
+  ASSERT_OK(sys_catalog->VisitTablets(&loader));
+  ASSERT_EQ(kNumThreads * kNumTabletsPerThread, loader.tablets.size());
+}
+
 // Verify that data mutations are not available from metadata() until commit.
 TEST_F(SysCatalogTest, TestTabletInfoCommit) {
   scoped_refptr<TabletInfo> tablet(new TabletInfo(nullptr, "123"));
@@ -85,15 +85,25 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/trace.h"
 
 DEFINE_double(sys_catalog_fail_during_write, 0.0,
               "Fraction of the time when system table writes will fail");
 TAG_FLAG(sys_catalog_fail_during_write, hidden);
 
+DEFINE_int32(sys_catalog_max_coalesced_write_bytes, 4 * 1024 * 1024,
+             "Maximum size in bytes of the row operations of concurrent sys "
+             "catalog writes which are coalesced into one replicated write. A "
+             "single write larger than this is written on its own. Set to 0 "
+             "to write each sys catalog write on its own.");
+TAG_FLAG(sys_catalog_max_coalesced_write_bytes, advanced);
+TAG_FLAG(sys_catalog_max_coalesced_write_bytes, runtime);
+
 using kudu::consensus::ConsensusMetadata;
 using kudu::consensus::ConsensusMetadataManager;
 using kudu::consensus::ConsensusStatePB;
@@ -161,7 +171,9 @@ SysCatalogTable::SysCatalogTable(Master* master,
     : metric_registry_(master->metric_registry()),
       master_(master),
       cmeta_manager_(new ConsensusMetadataManager(master_->fs_manager())),
-      leader_cb_(std::move(leader_cb)) {
+      leader_cb_(std::move(leader_cb)),
+      write_cond_(&write_lock_),
+      write_in_progress_(false) {
 }
 
 SysCatalogTable::~SysCatalogTable() {
@@ -489,36 +501,82 @@ Schema SysCatalogTable::BuildTableSchema() {
 Status SysCatalogTable::Write(const Actions& actions) {
   TRACE_EVENT0("master", "SysCatalogTable::Write");
 
+  // Queue the actions. If no write is in progress, write them along with any
+  // others queued meanwhile; otherwise wait for them to be written by the
+  // caller whose write is in progress, or to take over once it's done.
+  PendingWrite write(&actions);
+  MutexLock l(write_lock_);
+  pending_writes_.push_back(&write);
+  while (!write.done) {
+    if (write_in_progress_) {
+      write_cond_.Wait();
+      continue;
+    }
+    write_in_progress_ = true;
+    vector<PendingWrite*> writes(pending_writes_.begin(), pending_writes_.end());
+    l.Unlock();
+    Status s;
+    size_t num_written = WriteCoalesced(writes, &s);
+    l.Lock();
+    for (size_t i = 0; i < num_written; i++) {
+      writes[i]->status = s;
+      writes[i]->done = true;
+    }
+    pending_writes_.erase(pending_writes_.begin(), pending_writes_.begin() + num_written);
+    write_in_progress_ = false;
+    write_cond_.Broadcast();
+  }
+  return write.status;
+}
+
+size_t SysCatalogTable::WriteCoalesced(const vector<PendingWrite*>& writes, Status* status) {
+  DCHECK(!writes.empty());
   WriteRequestPB req;
   WriteResponsePB resp;
   req.set_tablet_id(kSysCatalogTabletId);
-  RETURN_NOT_OK(SchemaToPB(schema_, req.mutable_schema()));
+  *status = SchemaToPB(schema_, req.mutable_schema());
+  if (!status->ok()) {
+    return 1;
+  }
+
+  const size_t max_bytes = std::max(FLAGS_sys_catalog_max_coalesced_write_bytes, 0);
+  const auto& ops = req.row_operations();
+  size_t num_written = 0;
+  do {
+    ReqAddActions(&req, *writes[num_written++]->actions);
+  } while (num_written < writes.size() &&
+           ops.rows().size() + ops.indirect_data().size() < max_bytes);
+  if (num_written > 1) {
+    TRACE("Coalesced $0 sys catalog writes", num_written);
+  }
 
+  if (ops.rows().empty()) {
+    // No actual changes were written (i.e the data to be updated matched the
+    // previous version of the data).
+    return num_written;
+  }
+  *status = SyncWrite(&req, &resp);
+  return num_written;
+}
+
+void SysCatalogTable::ReqAddActions(WriteRequestPB* req, const Actions& actions) {
   if (actions.table_to_add) {
-    ReqAddTable(&req, actions.table_to_add);
+    ReqAddTable(req, actions.table_to_add);
   }
   if (actions.table_to_update) {
-    ReqUpdateTable(&req, actions.table_to_update);
+    ReqUpdateTable(req, actions.table_to_update);
   }
   if (actions.table_to_delete) {
-    ReqDeleteTable(&req, actions.table_to_delete);
+    ReqDeleteTable(req, actions.table_to_delete);
   }
 
-  ReqAddTablets(&req, actions.tablets_to_add);
-  ReqUpdateTablets(&req, actions.tablets_to_update);
-  ReqDeleteTablets(&req, actions.tablets_to_delete);
+  ReqAddTablets(req, actions.tablets_to_add);
+  ReqUpdateTablets(req, actions.tablets_to_update);
+  ReqDeleteTablets(req, actions.tablets_to_delete);
 
   if (actions.hms_notification_log_event_id) {
-    ReqSetNotificationLogEventId(&req, *actions.hms_notification_log_event_id);
+    ReqSetNotificationLogEventId(req, *actions.hms_notification_log_event_id);
   }
-
-  if (req.row_operations().rows().empty()) {
-    // No actual changes were written (i.e the data to be updated matched the
-    // previous version of the data).
-    return Status::OK();
-  }
-  RETURN_NOT_OK(SyncWrite(&req, &resp));
-  return Status::OK();
 }
 
 // ==================================================================
@@ -18,6 +18,7 @@
 #define KUDU_MASTER_SYS_CATALOG_H_
 
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <set>
 #include <string>
@@ -34,6 +35,8 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/master/catalog_manager.h"
 #include "kudu/tablet/tablet_replica.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -150,6 +153,12 @@ class SysCatalogTable {
   Status CreateNew(FsManager *fs_manager);
 
   // Perform a series of table/tablet actions in one WriteTransaction.
+  //
+  // Actions written concurrently are coalesced: while one write is being
+  // replicated, the actions queued behind it are combined into the next
+  // write, up to --sys_catalog_max_coalesced_write_bytes. The actions of each
+  // call are still written atomically, and if a combined write fails, every
+  // call in it fails.
   struct Actions {
     Actions() = default;
 
@@ -213,6 +222,28 @@ class SysCatalogTable {
   // Returns 'Status::OK()' if the WriteTransaction completed
   Status SyncWrite(const tserver::WriteRequestPB *req, tserver::WriteResponsePB *resp);
 
+  // A call to Write() waiting for its actions to be written.
+  struct PendingWrite {
+    explicit PendingWrite(const Actions* a)
+        : actions(a),
+          done(false) {
+    }
+
+    const Actions* actions;
+    bool done;
+    Status status;
+  };
+
+  // Adds the operations for 'actions' to 'req'.
+  void ReqAddActions(tserver::WriteRequestPB* req, const Actions& actions);
+
+  // Writes the actions of the first of 'writes', and of as many of the
+  // following ones as fit, in one WriteTransaction, whose result is returned
+  // in 'status'. Returns the number of writes written.
+  //
+  // Must be called without write_lock_ held.
+  size_t WriteCoalesced(const std::vector<PendingWrite*>& writes, Status* status);
+
   void SysCatalogStateChanged(const std::string& tablet_id, const std::string& reason);
 
   Status SetupTablet(const scoped_refptr<tablet::TabletMetadata>& metadata);
@@ -290,6 +321,18 @@ class SysCatalogTable {
   ElectedLeaderCallback leader_cb_;
 
   consensus::RaftPeerPB local_peer_pb_;
+
+  // Protects the fields below, which coalesce concurrent writes.
+  Mutex write_lock_;
+
+  // Signaled when a write finishes.
+  ConditionVariable write_cond_;
+
+  // The calls to Write() whose actions are yet to be written, in order.
+  std::deque<PendingWrite*> pending_writes_;
+
+  // Whether a call to Write() is writing the actions of pending writes.
+  bool write_in_progress_;
 };
 
 } // namespace master
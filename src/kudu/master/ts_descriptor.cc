@@ -143,7 +143,9 @@ TSDescriptor::TSDescriptor(std::string perm_id)
       last_heartbeat_(MonoTime::Now()),
       recent_replica_creations_(0),
       last_replica_creations_decay_(MonoTime::Now()),
-      num_live_replicas_(0) {
+      num_live_replicas_(0),
+      wal_bytes_per_sec_(0),
+      max_data_dir_utilization_(0) {
 }
 
 // Compares two repeated HostPortPB fields. Returns true if equal, false otherwise.
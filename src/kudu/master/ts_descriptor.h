@@ -132,6 +132,26 @@ class TSDescriptor : public enable_make_shared<TSDescriptor> {
     return num_live_replicas_;
   }
 
+  // Set the load statistics from the last heartbeat: the rate at which the
+  // tablet server appends to its WALs, and the fraction of the capacity in
+  // use of its fullest data directory.
+  void set_load_stats(double wal_bytes_per_sec, double max_data_dir_utilization) {
+    DCHECK_GE(wal_bytes_per_sec, 0);
+    std::lock_guard<simple_spinlock> l(lock_);
+    wal_bytes_per_sec_ = wal_bytes_per_sec;
+    max_data_dir_utilization_ = max_data_dir_utilization;
+  }
+
+  double wal_bytes_per_sec() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return wal_bytes_per_sec_;
+  }
+
+  double max_data_dir_utilization() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return max_data_dir_utilization_;
+  }
+
   // Return the location of the tablet server. This returns a safe copy
   // since the location could change at any time if the tablet server
   // re-registers.
@@ -177,6 +197,10 @@ class TSDescriptor : public enable_make_shared<TSDescriptor> {
   // The number of live replicas on this host, from the last heartbeat.
   int num_live_replicas_;
 
+  // The load statistics of this host, from the last heartbeat.
+  double wal_bytes_per_sec_;
+  double max_data_dir_utilization_;
+
   // The tablet server's location, as determined by the master at registration.
   boost::optional<std::string> location_;
 
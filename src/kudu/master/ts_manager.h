@@ -17,6 +17,8 @@
 #ifndef KUDU_MASTER_TS_MANAGER_H
 #define KUDU_MASTER_TS_MANAGER_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -81,6 +83,13 @@ class TSManager {
   // Get the TS count.
   int GetCount() const;
 
+  // Returns the number of times tablet servers have registered or
+  // re-registered, which changes whenever a tablet server's RPC addresses or
+  // location may have changed.
+  int64_t registration_version() const {
+    return registration_version_.load(std::memory_order_acquire);
+  }
+
  private:
   int ClusterSkew() const;
 
@@ -92,6 +101,9 @@ class TSManager {
     std::string, std::shared_ptr<TSDescriptor>> TSDescriptorMap;
   TSDescriptorMap servers_by_id_;
 
+  // Advanced after every registration, with lock_ held.
+  std::atomic<int64_t> registration_version_;
+
   DISALLOW_COPY_AND_ASSIGN(TSManager);
 };
 
@@ -61,6 +61,8 @@ DEFINE_int32(rpc_acceptor_listen_backlog, 128,
              "new inbound connection requests.");
 TAG_FLAG(rpc_acceptor_listen_backlog, advanced);
 
+DECLARE_int32(rpc_socket_busy_poll_us);
+
 namespace kudu {
 namespace rpc {
 
@@ -165,6 +167,14 @@ void AcceptorPool::RunThread() {
           << s.ToString() << THROTTLE_MSG;
       continue;
     }
+    if (FLAGS_rpc_socket_busy_poll_us > 0) {
+      s = new_sock.SetBusyPoll(FLAGS_rpc_socket_busy_poll_us);
+      if (!s.ok()) {
+        KLOG_EVERY_N_SECS(WARNING, 60) << "Acceptor with remote = " << remote.ToString()
+            << " failed to enable busy polling on a newly accepted socket: "
+            << s.ToString() << THROTTLE_MSG;
+      }
+    }
     rpc_connections_accepted_->Increment();
     messenger_->RegisterInboundSocket(&new_sock, remote);
   }
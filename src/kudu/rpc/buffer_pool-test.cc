@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/buffer_pool.h"
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/faststring.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/test_util.h"
+
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace rpc {
+
+class BufferPoolTest : public KuduTest {
+};
+
+// Test that recycled buffers are handed out again to requests of the same
+// size class, and that the idle buffers are accounted for.
+TEST_F(BufferPoolTest, TestRecycle) {
+  BufferPool pool("test-pool", 1024 * 1024);
+  unique_ptr<faststring> buf = pool.Acquire(5000);
+  ASSERT_EQ(8192, buf->capacity());
+  ASSERT_EQ(0, buf->size());
+  buf->resize(5000);
+  const uint8_t* data = buf->data();
+
+  pool.Recycle(std::move(buf));
+  ASSERT_EQ(8192, pool.idle_bytes());
+
+  // A request of another class doesn't get the buffer...
+  unique_ptr<faststring> other = pool.Acquire(100);
+  ASSERT_EQ(BufferPool::kMinBufferSize, other->capacity());
+  ASSERT_EQ(8192, pool.idle_bytes());
+
+  // ...but one of the same class does, emptied.
+  buf = pool.Acquire(8000);
+  ASSERT_EQ(data, buf->data());
+  ASSERT_EQ(0, buf->size());
+  ASSERT_EQ(0, pool.idle_bytes());
+
+  // A buffer which grew past its class goes to the class it covers.
+  buf->resize(20000);
+  pool.Recycle(std::move(buf));
+  buf = pool.Acquire(16 * 1024);
+  ASSERT_GE(buf->capacity(), 20000U);
+  ASSERT_EQ(0, pool.idle_bytes());
+
+  // Buffers out of the pooled sizes are just freed.
+  pool.Recycle(unique_ptr<faststring>(new faststring(100)));
+  pool.Recycle(pool.Acquire(BufferPool::kMaxBufferSize + 1));
+  pool.Recycle(nullptr);
+  ASSERT_EQ(0, pool.idle_bytes());
+}
+
+// Test that the pool doesn't hold more idle buffers than its capacity.
+TEST_F(BufferPoolTest, TestCapacity) {
+  BufferPool pool("test-pool", 64 * 1024);
+  vector<unique_ptr<faststring>> bufs;
+  for (int i = 0; i < 10; i++) {
+    bufs.emplace_back(pool.Acquire(16 * 1024));
+  }
+  for (auto& buf : bufs) {
+    pool.Recycle(std::move(buf));
+  }
+  ASSERT_EQ(64 * 1024, pool.idle_bytes());
+  ASSERT_EQ(64 * 1024, pool.mem_tracker()->consumption());
+}
+
+// Test acquiring and recycling buffers from several threads at once.
+TEST_F(BufferPoolTest, TestConcurrentRecycle) {
+  BufferPool pool("test-pool", 1024 * 1024);
+  vector<thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&pool, t]() {
+      for (int i = 0; i < 1000; i++) {
+        unique_ptr<faststring> buf = pool.Acquire((t + 1) * 4096 + i);
+        buf->resize((t + 1) * 4096 + i);
+        pool.Recycle(std::move(buf));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_LE(pool.idle_bytes(), 1024 * 1024);
+}
+
+} // namespace rpc
+} // namespace kudu
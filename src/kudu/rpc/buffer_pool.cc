@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/buffer_pool.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/bits.h"
+#include "kudu/util/mem_tracker.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+
+namespace kudu {
+namespace rpc {
+
+static_assert(BufferPool::kMinBufferSize == 1UL << 12, "kMinSizeClass mismatch");
+static_assert(BufferPool::kMaxBufferSize == 1UL << 24, "kMaxSizeClass mismatch");
+
+constexpr size_t BufferPool::kMinBufferSize;
+constexpr size_t BufferPool::kMaxBufferSize;
+
+BufferPool::BufferPool(const string& id, int64_t capacity_bytes,
+                       shared_ptr<MemTracker> parent_tracker)
+    : mem_tracker_(MemTracker::CreateTracker(capacity_bytes, id, std::move(parent_tracker))) {
+  DCHECK_GE(capacity_bytes, 0);
+}
+
+BufferPool::~BufferPool() {
+  mem_tracker_->Release(idle_bytes());
+}
+
+unique_ptr<faststring> BufferPool::Acquire(size_t size) {
+  if (size > kMaxBufferSize) {
+    return unique_ptr<faststring>(new faststring(size));
+  }
+  int size_class = std::max(Bits::Log2Ceiling64(size), kMinSizeClass);
+  SizeClass* sc = &size_classes_[size_class - kMinSizeClass];
+  unique_ptr<faststring> buf;
+  {
+    std::lock_guard<simple_spinlock> l(sc->lock);
+    if (!sc->buffers.empty()) {
+      buf = std::move(sc->buffers.back());
+      sc->buffers.pop_back();
+    }
+  }
+  if (buf) {
+    mem_tracker_->Release(buf->capacity());
+    return buf;
+  }
+  // Allocate the full size of the class, so that the buffer lands back in it
+  // once recycled.
+  return unique_ptr<faststring>(new faststring(1UL << size_class));
+}
+
+void BufferPool::Recycle(unique_ptr<faststring> buf) {
+  if (!buf || buf->capacity() < kMinBufferSize) {
+    return;
+  }
+  // A buffer may have grown past its class, in which case it goes to the
+  // largest class it fully covers.
+  int size_class = Bits::Log2Floor64(buf->capacity());
+  if (size_class > kMaxSizeClass) {
+    return;
+  }
+  if (!mem_tracker_->TryConsume(buf->capacity())) {
+    return;
+  }
+  buf->clear();
+  SizeClass* sc = &size_classes_[size_class - kMinSizeClass];
+  std::lock_guard<simple_spinlock> l(sc->lock);
+  sc->buffers.emplace_back(std::move(buf));
+}
+
+int64_t BufferPool::idle_bytes() const {
+  return mem_tracker_->consumption();
+}
+
+} // namespace rpc
+} // namespace kudu
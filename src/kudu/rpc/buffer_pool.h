@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+
+class MemTracker;
+
+namespace rpc {
+
+// A pool of recycled buffers for the transfers of a reactor: the inbound
+// transfers and the serialized requests and responses of its calls.
+//
+// Buffers are kept in size classes of powers of two, so that a buffer
+// recycled after one call can be handed out to the next call of a similar
+// size without going through the allocator. The memory held by the idle
+// buffers is accounted to a MemTracker whose limit bounds the pool: a buffer
+// recycled into a full pool is freed.
+//
+// Buffers are typically acquired on one thread and recycled on another, e.g.
+// a service thread, so every method is thread-safe.
+class BufferPool {
+ public:
+  // Buffers smaller than this are not worth pooling.
+  static constexpr size_t kMinBufferSize = 4 * 1024;
+
+  // Buffers larger than this are rare enough to be left to the allocator.
+  static constexpr size_t kMaxBufferSize = 16 * 1024 * 1024;
+
+  // Creates a pool holding at most 'capacity_bytes' of idle buffers, tracked
+  // by a MemTracker named 'id' under 'parent_tracker', or under the root
+  // tracker if 'parent_tracker' is null.
+  BufferPool(const std::string& id, int64_t capacity_bytes,
+             std::shared_ptr<MemTracker> parent_tracker = std::shared_ptr<MemTracker>());
+
+  ~BufferPool();
+
+  // Returns an empty buffer with a capacity of at least 'size' bytes,
+  // recycled from the pool if possible.
+  std::unique_ptr<faststring> Acquire(size_t size);
+
+  // Returns 'buf' to the pool, or frees it if it is too small or too large to
+  // be pooled, or if the pool is full. 'buf' may be null.
+  void Recycle(std::unique_ptr<faststring> buf);
+
+  // Returns the number of bytes held by the idle buffers of the pool.
+  int64_t idle_bytes() const;
+
+  const std::shared_ptr<MemTracker>& mem_tracker() const { return mem_tracker_; }
+
+ private:
+  // The size classes, from kMinBufferSize to kMaxBufferSize.
+  static constexpr int kMinSizeClass = 12;
+  static constexpr int kMaxSizeClass = 24;
+  static constexpr int kNumSizeClasses = kMaxSizeClass - kMinSizeClass + 1;
+
+  // The idle buffers of a given size class, guarded by their own lock so
+  // that calls of different sizes don't contend.
+  struct SizeClass {
+    simple_spinlock lock;
+    std::vector<std::unique_ptr<faststring>> buffers;
+  };
+
+  std::shared_ptr<MemTracker> mem_tracker_;
+
+  std::array<SizeClass, kNumSizeClasses> size_classes_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+} // namespace rpc
+} // namespace kudu
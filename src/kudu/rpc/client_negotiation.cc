@@ -179,8 +179,17 @@ Status ClientNegotiation::Negotiate(unique_ptr<ErrorStatusPB>* rpc_error) {
   // TODO(KUDU-1921): allow the client to require TLS.
   if (encryption_ != RpcEncryption::DISABLED &&
       ContainsKey(server_features_, TLS)) {
+    // Offer to resume the TLS session of the previous connection to the
+    // server, which saves the reconnections after a server restart most of
+    // the cost of the handshake.
+    Sockaddr server_addr;
+    string session_key;
+    if (socket_->GetPeerAddress(&server_addr).ok()) {
+      session_key = server_addr.ToString();
+    }
     RETURN_NOT_OK(tls_context_->InitiateHandshake(security::TlsHandshakeType::CLIENT,
-                                                  &tls_handshake_));
+                                                  &tls_handshake_,
+                                                  session_key));
 
     if (negotiated_authn_ == AuthenticationType::SASL) {
       // When using SASL authentication, verifying the server's certificate is
@@ -484,6 +493,12 @@ Status ClientNegotiation::HandleTlsHandshake(const NegotiatePB& response) {
   if (s.IsIncomplete()) {
     // Another roundtrip is required to complete the handshake.
     RETURN_NOT_OK(SendTlsHandshake(std::move(token)));
+  } else if (s.ok() && !token.empty()) {
+    // The client has the last word in an abbreviated handshake which resumes
+    // a session. The server responds to it once done, so wait for that before
+    // wrapping the socket.
+    RETURN_NOT_OK(SendTlsHandshake(std::move(token)));
+    return Status::Incomplete("awaiting the final TLS_HANDSHAKE response from server");
   }
 
   // Check that the handshake step didn't produce an error. Will also propagate
@@ -498,8 +513,9 @@ Status ClientNegotiation::HandleTlsHandshake(const NegotiatePB& response) {
     return tls_handshake_.FinishNoWrap(*socket_);
   }
 
-  TRACE("Negotiated $0 with cipher $1",
-        tls_handshake_.GetProtocol(), tls_handshake_.GetCipherDescription());
+  TRACE("Negotiated $0 with cipher $1$2",
+        tls_handshake_.GetProtocol(), tls_handshake_.GetCipherDescription(),
+        tls_handshake_.IsSessionReused() ? " (resumed session)" : "");
   return tls_handshake_.Finish(&socket_);
 }
 
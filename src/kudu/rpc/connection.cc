@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cerrno>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <set>
 #include <string>
@@ -71,6 +72,7 @@ Connection::Connection(ReactorThread *reactor_thread,
       direction_(direction),
       last_activity_time_(MonoTime::Now()),
       is_epoll_registered_(false),
+      zero_copy_enabled_(false),
       next_call_id_(1),
       credentials_policy_(policy),
       negotiation_complete_(false),
@@ -182,6 +184,12 @@ void Connection::Shutdown(const Status &status,
   write_io_.stop();
   is_epoll_registered_ = false;
   if (socket_) {
+    if (zero_copy_.num_pending() > 0) {
+      // The kernel may still read the memory of some zero-copy sends after we
+      // release it: reset the connection on close rather than letting the
+      // kernel send whatever that memory holds by then.
+      WARN_NOT_OK(socket_->SetLinger(true, 0), "Error resetting socket");
+    }
     WARN_NOT_OK(socket_->Close(), "Error closing socket");
   }
 }
@@ -198,7 +206,19 @@ void Connection::QueueOutbound(gscoped_ptr<OutboundTransfer> transfer) {
 
   DVLOG(3) << "Queueing transfer: " << transfer->HexDump();
 
-  outbound_transfers_.push_back(*transfer.release());
+  // A smaller transfer goes ahead of the bulk transfers at the back of the
+  // queue which haven't started yet. Bulk transfers keep their relative order.
+  auto pos = outbound_transfers_.end();
+  if (!transfer->is_bulk()) {
+    while (pos != outbound_transfers_.begin()) {
+      auto prev = std::prev(pos);
+      if (!prev->is_bulk() || prev->TransferStarted()) {
+        break;
+      }
+      pos = prev;
+    }
+  }
+  outbound_transfers_.insert(pos, *transfer.release());
 
   if (negotiation_complete_ && !write_io_.is_active()) {
     // If we weren't currently in the middle of sending anything,
@@ -332,7 +352,8 @@ void Connection::QueueOutboundCall(shared_ptr<OutboundCall> call) {
 
   // Serialize the actual bytes to be put on the wire.
   TransferPayload tmp_slices;
-  size_t n_slices = call->SerializeTo(&tmp_slices);
+  TransferPayloadOwners tmp_owners;
+  size_t n_slices = call->SerializeTo(&tmp_slices, &tmp_owners);
 
   call->SetQueued();
 
@@ -390,7 +411,7 @@ void Connection::QueueOutboundCall(shared_ptr<OutboundCall> call) {
   TransferCallbacks *cb = new CallTransferCallbacks(std::move(call), this);
   awaiting_response_[call_id] = car.release();
   QueueOutbound(gscoped_ptr<OutboundTransfer>(
-      OutboundTransfer::CreateForCallRequest(call_id, tmp_slices, n_slices, cb)));
+      OutboundTransfer::CreateForCallRequest(call_id, tmp_slices, n_slices, cb, &tmp_owners)));
 }
 
 // Callbacks for sending an RPC call response from the server.
@@ -462,14 +483,15 @@ void Connection::QueueResponseForCall(gscoped_ptr<InboundCall> call) {
   // ResponseTransferCallbacks::NotifyTransferAborted.
 
   TransferPayload tmp_slices;
-  size_t n_slices = call->SerializeResponseTo(&tmp_slices);
+  TransferPayloadOwners tmp_owners;
+  size_t n_slices = call->SerializeResponseTo(&tmp_slices, &tmp_owners);
 
   TransferCallbacks *cb = new ResponseTransferCallbacks(std::move(call), this);
   // After the response is sent, can delete the InboundCall object.
   // We set a dummy call ID and required feature set, since these are not needed
   // when sending responses.
   gscoped_ptr<OutboundTransfer> t(
-      OutboundTransfer::CreateForCallResponse(tmp_slices, n_slices, cb));
+      OutboundTransfer::CreateForCallResponse(tmp_slices, n_slices, cb, &tmp_owners));
 
   QueueTransferTask *task = new QueueTransferTask(std::move(t), this);
   reactor_thread_->reactor()->ScheduleReactorTask(task);
@@ -500,9 +522,13 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
   }
   last_activity_time_ = reactor_thread_->cur_time();
 
+  if (zero_copy_.num_pending() > 0) {
+    HandleZeroCopyCompletions();
+  }
+
   while (true) {
     if (!inbound_) {
-      inbound_.reset(new InboundTransfer());
+      inbound_.reset(new InboundTransfer(reactor_thread_->reactor()->buffer_pool()));
     }
     Status status = inbound_->ReceiveBuffer(*socket_);
     if (PREDICT_FALSE(!status.ok())) {
@@ -653,7 +679,7 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
     }
 
     last_activity_time_ = reactor_thread_->cur_time();
-    Status status = transfer->SendBuffer(*socket_);
+    Status status = transfer->SendBuffer(*socket_, zero_copy_enabled_ ? &zero_copy_ : nullptr);
     if (PREDICT_FALSE(!status.ok())) {
       LOG(WARNING) << ToString() << " send error: " << status.ToString();
       reactor_thread_->DestroyConnection(this, status);
@@ -674,6 +700,26 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   write_io_.stop();
 }
 
+void Connection::HandleZeroCopyCompletions() {
+  // The completions are queued on the error queue of the socket, which wakes
+  // up the read watcher.
+  Status s = socket_->ReadZeroCopyCompletions(
+      [this](uint32_t first, uint32_t last, bool copied) {
+        zero_copy_.Complete(first, last);
+        if (copied && zero_copy_enabled_) {
+          // The kernel had to copy the data anyway, e.g. because the route
+          // goes through the loopback device: pinning the memory only adds
+          // to the cost of the sends.
+          VLOG(1) << ToString() << ": zero-copy sends fell back to copying, disabling them";
+          zero_copy_enabled_ = false;
+        }
+      });
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG(WARNING) << ToString() << ": failed to read zero-copy completions: " << s.ToString();
+    zero_copy_enabled_ = false;
+  }
+}
+
 std::string Connection::ToString() const {
   // This may be called from other threads, so we cannot
   // include anything in the output about the current state,
@@ -726,6 +772,12 @@ void Connection::CompleteNegotiation(Status negotiation_status,
 void Connection::MarkNegotiationComplete() {
   DCHECK(reactor_thread_->IsCurrentThread());
   negotiation_complete_ = true;
+  if (FLAGS_rpc_zero_copy_threshold_bytes > 0) {
+    // Not supported e.g. on TLS sockets, which have to encrypt the data anyway.
+    Status s = socket_->SetZeroCopy(true);
+    zero_copy_enabled_ = s.ok();
+    VLOG_IF(1, !s.ok()) << ToString() << ": not using zero-copy sends: " << s.ToString();
+  }
 }
 
 Status Connection::DumpPB(const DumpRunningRpcsRequestPB& req,
@@ -179,6 +179,9 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // libev callback when we may write to the socket.
   void WriteHandler(ev::io &watcher, int revents);
 
+  // Releases the memory of the zero-copy sends which the kernel is done with.
+  void HandleZeroCopyCompletions();
+
   // Safe to be called from other threads.
   std::string ToString() const;
 
@@ -337,6 +340,13 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // waiting to be sent
   boost::intrusive::list<OutboundTransfer> outbound_transfers_; // NOLINT(*)
 
+  // Whether the sidecars with shared memory are sent with MSG_ZEROCOPY. See
+  // --rpc_zero_copy_threshold_bytes.
+  bool zero_copy_enabled_;
+
+  // The memory of the zero-copy sends the kernel may still be reading from.
+  ZeroCopyTracker zero_copy_;
+
   // Calls which have been sent and are now waiting for a response.
   car_map_t awaiting_response_;
 
@@ -63,10 +63,11 @@ string ConnectionId::ToString() const {
     network_plane = strings::Substitute(", network_plane=$0", network_plane_);
   }
 
-  return strings::Substitute("{remote=$0, user_credentials=$1$2}",
+  return strings::Substitute("{remote=$0, user_credentials=$1$2$3}",
                              remote,
                              user_credentials_.ToString(),
-                             network_plane);
+                             network_plane,
+                             bulk_ ? ", bulk" : "");
 }
 
 size_t ConnectionId::HashCode() const {
@@ -75,6 +76,7 @@ size_t ConnectionId::HashCode() const {
   boost::hash_combine(seed, hostname_);
   boost::hash_combine(seed, user_credentials_.HashCode());
   boost::hash_combine(seed, network_plane_);
+  boost::hash_combine(seed, bulk_);
   return seed;
 }
 
@@ -82,7 +84,8 @@ bool ConnectionId::Equals(const ConnectionId& other) const {
   return remote() == other.remote() &&
       hostname_ == other.hostname_ &&
       user_credentials().Equals(other.user_credentials()) &&
-      network_plane_ == other.network_plane_;
+      network_plane_ == other.network_plane_ &&
+      bulk_ == other.bulk_;
 }
 
 size_t ConnectionIdHash::operator() (const ConnectionId& conn_id) const {
@@ -55,6 +55,13 @@ class ConnectionId {
 
   const std::string& network_plane() const { return network_plane_; }
 
+  // Whether this connection is for bulk calls, see
+  // --rpc_bulk_transfer_threshold_bytes. Bulk calls use connections of their
+  // own, so that they don't hold up the other calls to the same remote.
+  void set_bulk(bool bulk) { bulk_ = bulk; }
+
+  bool bulk() const { return bulk_; }
+
   // Returns a string representation of the object, not including the password field.
   std::string ToString() const;
 
@@ -74,6 +81,8 @@ class ConnectionId {
   // The name of the network plane adopted by this connection. Please see header comemnts
   // at proxy.h for details.
   std::string network_plane_;
+
+  bool bulk_ = false;
 };
 
 class ConnectionIdHash {
@@ -18,16 +18,22 @@
 #include "kudu/rpc/inbound_call.h"
 
 #include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <ostream>
 
 #include <glog/logging.h>
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/message_lite.h>
 
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/connection.h"
+#include "kudu/rpc/reactor.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/rpcz_store.h"
@@ -37,7 +43,9 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
+#include "kudu/util/trace_metrics.h"
 
 namespace google {
 namespace protobuf {
@@ -58,13 +66,18 @@ namespace rpc {
 
 InboundCall::InboundCall(Connection* conn)
   : conn_(conn),
+    buffer_pool_(conn ? conn->reactor_thread()->reactor()->buffer_pool() : nullptr),
     trace_(new Trace),
     method_info_(nullptr),
     deadline_(MonoTime::Max()) {
   RecordCallReceived();
 }
 
-InboundCall::~InboundCall() {}
+InboundCall::~InboundCall() {
+  if (buffer_pool_) {
+    buffer_pool_->Recycle(std::move(response_msg_buf_));
+  }
+}
 
 Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   TRACE_EVENT_FLOW_BEGIN0("rpc", "InboundCall", this);
@@ -155,6 +168,8 @@ void InboundCall::ApplicationErrorToPB(int error_ext_id, const std::string& mess
 void InboundCall::Respond(const MessageLite& response,
                           bool is_success) {
   TRACE_EVENT_FLOW_END0("rpc", "InboundCall", this);
+  RecordHandlerCpuTime();
+  CollectResourceMetrics();
   SerializeResponseBuffer(response, is_success);
 
   TRACE_EVENT_ASYNC_END1("rpc", "InboundCall", this,
@@ -182,6 +197,13 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
   ResponseHeader resp_hdr;
   resp_hdr.set_call_id(header_.call_id());
   resp_hdr.set_is_error(!is_success);
+  if (header_.request_resource_metrics()) {
+    for (const auto& e : resource_metrics_) {
+      ResourceMetricPB* metric = resp_hdr.add_resource_metrics();
+      metric->set_key(e.first);
+      metric->set_value(e.second);
+    }
+  }
   int32_t sidecar_byte_size = 0;
   for (const unique_ptr<RpcSidecar>& car : outbound_sidecars_) {
     resp_hdr.add_sidecar_offsets(sidecar_byte_size + protobuf_msg_size);
@@ -190,23 +212,33 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
     sidecar_byte_size += sidecar_bytes;
   }
 
-  serialization::SerializeMessage(response, &response_msg_buf_,
+  if (!response_msg_buf_) {
+    // Leave room for the varint length prefix of the message.
+    response_msg_buf_ = buffer_pool_ ?
+        buffer_pool_->Acquire(protobuf_msg_size + google::protobuf::io::kMaxVarint32Bytes) :
+        unique_ptr<faststring>(new faststring());
+  }
+  serialization::SerializeMessage(response, response_msg_buf_.get(),
                                   sidecar_byte_size, true);
-  int64_t main_msg_size = sidecar_byte_size + response_msg_buf_.size();
+  int64_t main_msg_size = sidecar_byte_size + response_msg_buf_->size();
   serialization::SerializeHeader(resp_hdr, main_msg_size,
                                  &response_hdr_buf_);
 }
 
-size_t InboundCall::SerializeResponseTo(TransferPayload* slices) const {
+size_t InboundCall::SerializeResponseTo(TransferPayload* slices,
+                                        TransferPayloadOwners* owners) const {
   TRACE_EVENT0("rpc", "InboundCall::SerializeResponseTo");
   DCHECK_GT(response_hdr_buf_.size(), 0);
-  DCHECK_GT(response_msg_buf_.size(), 0);
+  DCHECK_GT(response_msg_buf_->size(), 0);
   size_t n_slices = 2 + outbound_sidecars_.size();
   DCHECK_LE(n_slices, slices->size());
   auto slice_iter = slices->begin();
   *slice_iter++ = Slice(response_hdr_buf_);
-  *slice_iter++ = Slice(response_msg_buf_);
+  *slice_iter++ = Slice(*response_msg_buf_);
   for (auto& sidecar : outbound_sidecars_) {
+    if (owners) {
+      (*owners)[slice_iter - slices->begin()] = sidecar->SharedData();
+    }
     *slice_iter++ = sidecar->AsSlice();
   }
   DCHECK_EQ(slice_iter - slices->begin(), n_slices);
@@ -288,6 +320,28 @@ void InboundCall::RecordHandlingStarted(Histogram* incoming_queue_time) {
   timing_.time_handled = MonoTime::Now();
   incoming_queue_time->Increment(
       (timing_.time_handled - timing_.time_received).ToMicroseconds());
+  handler_thread_id_ = Thread::UniqueThreadId();
+  handler_start_cpu_us_ = GetThreadCpuTimeMicros();
+}
+
+void InboundCall::RecordHandlerCpuTime() {
+  if (handler_thread_id_ != Thread::UniqueThreadId()) {
+    return;
+  }
+  trace_->metrics()->Increment("handler_cpu_time_us",
+                               GetThreadCpuTimeMicros() - handler_start_cpu_us_);
+}
+
+void InboundCall::CollectResourceMetrics() {
+  std::function<void(const Trace&)> collect = [&](const Trace& t) {
+    for (const auto& e : t.metrics().Get()) {
+      resource_metrics_[e.first] += e.second;
+    }
+    for (const auto& child : t.ChildTraces()) {
+      collect(*child.second);
+    }
+  };
+  collect(*trace_);
 }
 
 void InboundCall::RecordHandlingCompleted() {
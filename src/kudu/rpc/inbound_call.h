@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -53,6 +54,7 @@ class Trace;
 
 namespace rpc {
 
+class BufferPool;
 class Connection;
 class DumpRunningRpcsRequestPB;
 class RemoteUser;
@@ -127,8 +129,10 @@ class InboundCall {
 
   // Serialize the response packet for the finished call into 'slices'.
   // The resulting slices refer to memory in this object.
-  // Returns the number of slices in the serialized response.
-  size_t SerializeResponseTo(TransferPayload* slices) const;
+  // Returns the number of slices in the serialized response. If 'owners' is
+  // set, it is filled with the shared memory backing the slices, if any.
+  size_t SerializeResponseTo(TransferPayload* slices,
+                             TransferPayloadOwners* owners = nullptr) const;
 
   // See RpcContext::AddRpcSidecar()
   Status AddOutboundSidecar(std::unique_ptr<RpcSidecar> car, int* idx);
@@ -192,6 +196,12 @@ class InboundCall {
   // Return the time when this call was received.
   MonoTime GetTimeReceived() const;
 
+  // Return the resources used to handle this call, keyed by trace metric and
+  // summed across the child traces. Set when the call is responded to.
+  const std::map<std::string, int64_t>& resource_metrics() const {
+    return resource_metrics_;
+  }
+
   // Returns the set of application-specific feature flags required to service
   // the RPC.
   std::vector<uint32_t> GetRequiredFeatures() const;
@@ -227,6 +237,15 @@ class InboundCall {
   // Not thread-safe. Should only be called by the current "owner" thread.
   void RecordHandlingCompleted();
 
+  // Records the CPU time used by the handler thread in the trace, if the call
+  // is responded to on the thread which started handling it. Otherwise, the
+  // CPU time of the threads the work was handed off to is only accounted for
+  // if they record it themselves, as the thread pools do.
+  void RecordHandlerCpuTime();
+
+  // Sets 'resource_metrics_' from the trace metrics of the call.
+  void CollectResourceMetrics();
+
   // The connection on which this inbound call arrived.
   scoped_refptr<Connection> conn_;
 
@@ -242,9 +261,13 @@ class InboundCall {
   // by 'serialized_request_' above.
   gscoped_ptr<InboundTransfer> transfer_;
 
+  // The pool of the reactor of 'conn_', from which 'response_msg_buf_' is
+  // acquired. May be null.
+  const std::shared_ptr<BufferPool> buffer_pool_;
+
   // The buffers for serialized response. Set by SerializeResponseBuffer().
   faststring response_hdr_buf_;
-  faststring response_msg_buf_;
+  std::unique_ptr<faststring> response_msg_buf_;
 
   // Vector of additional sidecars that are tacked on to the call's response
   // after serialization of the protobuf. See rpc/rpc_sidecar.h for more info.
@@ -264,6 +287,14 @@ class InboundCall {
   // Timing information related to this RPC call.
   InboundCallTiming timing_;
 
+  // The thread which started handling the call, and its CPU time at the time.
+  // Set by RecordHandlingStarted().
+  int64_t handler_thread_id_ = -1;
+  int64_t handler_start_cpu_us_ = 0;
+
+  // See resource_metrics().
+  std::map<std::string, int64_t> resource_metrics_;
+
   // Proto service this calls belongs to. Used for routing.
   // This field is filled in when the inbound request header is parsed.
   RemoteMethod remote_method_;
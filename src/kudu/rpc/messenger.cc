@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/messenger.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <functional>
 #include <mutex>
@@ -24,6 +25,7 @@
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -51,6 +53,7 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread_restrictions.h"
@@ -59,8 +62,15 @@
 using std::string;
 using std::shared_ptr;
 using std::make_shared;
+using std::vector;
 using strings::Substitute;
 
+METRIC_DEFINE_counter(server, rpc_connections_steered,
+                      "RPC Connections Steered",
+                      kudu::MetricUnit::kConnections,
+                      "Number of incoming TCP connections assigned to the reactor "
+                      "pinned to the CPU which received them.");
+
 namespace boost {
 template <typename Signature> class function;
 }
@@ -82,7 +92,10 @@ MessengerBuilder::MessengerBuilder(std::string name)
       rpc_tls_ciphers_(kudu::security::SecurityDefaults::kDefaultTlsCiphers),
       rpc_tls_min_protocol_(kudu::security::SecurityDefaults::kDefaultTlsMinVersion),
       enable_inbound_tls_(false),
-      reuseport_(false) {
+      reuseport_(false),
+      reactor_numa_affinity_(false),
+      steer_inbound_connections_(false),
+      colocate_service_threads_(false) {
 }
 
 MessengerBuilder& MessengerBuilder::set_connection_keepalive_time(const MonoDelta &keepalive) {
@@ -184,6 +197,22 @@ MessengerBuilder& MessengerBuilder::set_reuseport() {
   return *this;
 }
 
+MessengerBuilder& MessengerBuilder::set_reactor_cpus(vector<int> cpus, bool numa_node) {
+  reactor_cpus_ = std::move(cpus);
+  reactor_numa_affinity_ = numa_node;
+  return *this;
+}
+
+MessengerBuilder& MessengerBuilder::enable_inbound_connection_steering() {
+  steer_inbound_connections_ = true;
+  return *this;
+}
+
+MessengerBuilder& MessengerBuilder::enable_service_thread_colocation() {
+  colocate_service_threads_ = true;
+  return *this;
+}
+
 Status MessengerBuilder::Build(shared_ptr<Messenger> *msgr) {
   // Initialize SASL library before we start making requests
   RETURN_NOT_OK(SaslInit(!keytab_file_.empty()));
@@ -395,7 +424,17 @@ void Messenger::QueueCancellation(const shared_ptr<OutboundCall> &call) {
 }
 
 void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote) {
-  Reactor *reactor = RemoteToReactor(remote);
+  Reactor* reactor = nullptr;
+  int cpu;
+  if (steer_inbound_connections_ && new_socket->GetIncomingCpu(&cpu).ok()) {
+    reactor = FindPtrOrNull(reactors_by_cpu_, cpu);
+    if (reactor && rpc_connections_steered_) {
+      rpc_connections_steered_->Increment();
+    }
+  }
+  if (!reactor) {
+    reactor = RemoteToReactor(remote);
+  }
   reactor->RegisterInboundSocket(new_socket, remote);
 }
 
@@ -412,10 +451,41 @@ Messenger::Messenger(const MessengerBuilder &bld)
     sasl_proto_name_(bld.sasl_proto_name_),
     keytab_file_(bld.keytab_file_),
     reuseport_(bld.reuseport_),
+    steer_inbound_connections_(bld.steer_inbound_connections_),
     retain_self_(this) {
   for (int i = 0; i < bld.num_reactors_; i++) {
     reactors_.push_back(new Reactor(retain_self_, i, bld));
   }
+  // Map each CPU to the reactor pinned to it first, and only then to the
+  // reactors which may run on it.
+  for (Reactor* r : reactors_) {
+    if (r->home_cpu() >= 0) {
+      reactors_by_cpu_.emplace(r->home_cpu(), r);
+    }
+  }
+  for (Reactor* r : reactors_) {
+    for (int cpu : r->affinity_cpus()) {
+      reactors_by_cpu_.emplace(cpu, r);
+    }
+    if (bld.colocate_service_threads_ && r->home_cpu() >= 0) {
+      vector<int> node_cpus;
+      Status s = GetNumaNodeCpus(r->home_cpu(), &node_cpus);
+      if (!s.ok()) {
+        LOG(WARNING) << "could not find the NUMA node of CPU " << r->home_cpu() << ": "
+                     << s.ToString();
+        node_cpus = r->affinity_cpus();
+      }
+      service_thread_cpus_.insert(service_thread_cpus_.end(),
+                                  node_cpus.begin(), node_cpus.end());
+    }
+  }
+  std::sort(service_thread_cpus_.begin(), service_thread_cpus_.end());
+  service_thread_cpus_.erase(std::unique(service_thread_cpus_.begin(),
+                                         service_thread_cpus_.end()),
+                             service_thread_cpus_.end());
+  if (metric_entity_) {
+    rpc_connections_steered_ = METRIC_rpc_connections_steered.Instantiate(metric_entity_);
+  }
   CHECK_OK(ThreadPoolBuilder("client-negotiator")
       .set_min_threads(bld.min_negotiation_threads_)
       .set_max_threads(bld.max_negotiation_threads_)
@@ -432,6 +502,10 @@ Messenger::~Messenger() {
   STLDeleteElements(&reactors_);
 }
 
+const shared_ptr<BufferPool>& Messenger::buffer_pool(const Sockaddr& remote) {
+  return RemoteToReactor(remote)->buffer_pool();
+}
+
 Reactor* Messenger::RemoteToReactor(const Sockaddr &remote) {
   uint32_t hashCode = remote.HashCode();
   int reactor_idx = hashCode % reactors_.size();
@@ -60,6 +60,7 @@ using security::RpcAuthentication;
 using security::RpcEncryption;
 
 class AcceptorPool;
+class BufferPool;
 class DumpRunningRpcsRequestPB;
 class DumpRunningRpcsResponsePB;
 class InboundCall;
@@ -86,6 +87,7 @@ struct AcceptorPoolInfo {
 class MessengerBuilder {
  public:
   friend class Messenger;
+  friend class Reactor;
   friend class ReactorThread;
 
   explicit MessengerBuilder(std::string name);
@@ -166,6 +168,22 @@ class MessengerBuilder {
   // Configure the messenger to set the SO_REUSEPORT socket option.
   MessengerBuilder& set_reuseport();
 
+  // Pin the reactor threads to the CPUs in 'cpus': reactor i runs on the
+  // CPU at index i % cpus.size(). If 'numa_node' is true, each reactor may
+  // instead run on any CPU of the NUMA node of its CPU.
+  MessengerBuilder& set_reactor_cpus(std::vector<int> cpus, bool numa_node);
+
+  // Configure the messenger to assign each inbound connection to the reactor
+  // pinned to the CPU which received the connection's packets, as reported by
+  // SO_INCOMING_CPU, rather than by the hash of the remote address. Has no
+  // effect unless the reactors are pinned.
+  MessengerBuilder& enable_inbound_connection_steering();
+
+  // Configure the messenger to report the CPUs of the NUMA nodes of its
+  // reactors as the CPUs to run service threads on. See
+  // Messenger::service_thread_cpus().
+  MessengerBuilder& enable_service_thread_colocation();
+
   Status Build(std::shared_ptr<Messenger> *msgr);
 
  private:
@@ -189,6 +207,10 @@ class MessengerBuilder {
   std::string keytab_file_;
   bool enable_inbound_tls_;
   bool reuseport_;
+  std::vector<int> reactor_cpus_;
+  bool reactor_numa_affinity_;
+  bool steer_inbound_connections_;
+  bool colocate_service_threads_;
 };
 
 // A Messenger is a container for the reactor threads which run event loops
@@ -303,6 +325,14 @@ class Messenger {
 
   int num_reactors() const { return reactors_.size(); }
 
+  // Returns the pool of transfer buffers of the reactor handling the
+  // connections to 'remote', or null if transfer buffers are not pooled.
+  const std::shared_ptr<BufferPool>& buffer_pool(const Sockaddr& remote);
+
+  // The CPUs the service threads handling this messenger's calls should run
+  // on, or an empty list if they shouldn't be restricted.
+  const std::vector<int>& service_thread_cpus() const { return service_thread_cpus_; }
+
   const std::string& name() const {
     return name_;
   }
@@ -407,6 +437,19 @@ class Messenger {
   // Whether to set SO_REUSEPORT on the listening sockets.
   bool reuseport_;
 
+  // Whether to place inbound connections by the CPU which received them.
+  const bool steer_inbound_connections_;
+
+  // The reactors by the CPUs they are pinned to. A CPU maps to the reactor
+  // pinned to it if any, or else to a reactor allowed to run on it.
+  std::unordered_map<int, Reactor*> reactors_by_cpu_;
+
+  // See service_thread_cpus().
+  std::vector<int> service_thread_cpus_;
+
+  // Number of inbound connections placed by the CPU which received them.
+  scoped_refptr<Counter> rpc_connections_steered_;
+
   // The ownership of the Messenger object is somewhat subtle. The pointer graph
   // looks like this:
   //
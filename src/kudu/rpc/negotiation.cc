@@ -47,6 +47,7 @@
 #include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/slice.h"
@@ -72,6 +73,20 @@ DEFINE_bool(rpc_encrypt_loopback_connections, false,
             "an attacker.");
 TAG_FLAG(rpc_encrypt_loopback_connections, advanced);
 
+METRIC_DEFINE_histogram(server, rpc_client_negotiation_time_us,
+                        "Client RPC Negotiation Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time taken to negotiate outbound RPC connections, including "
+                        "the TLS handshake and authentication, and the time to connect.",
+                        60000000LU, 2);
+
+METRIC_DEFINE_histogram(server, rpc_server_negotiation_time_us,
+                        "Server RPC Negotiation Time",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time taken to negotiate inbound RPC connections, including "
+                        "the TLS handshake and authentication.",
+                        60000000LU, 2);
+
 using std::string;
 using std::unique_ptr;
 using strings::Substitute;
@@ -288,12 +303,20 @@ void Negotiation::RunNegotiation(const scoped_refptr<Connection>& conn,
                                  MonoTime deadline) {
   Status s;
   unique_ptr<ErrorStatusPB> rpc_error;
+  const auto metric_entity = conn->reactor_thread()->reactor()->messenger()->metric_entity();
+  MonoTime start = MonoTime::Now();
   if (conn->direction() == Connection::SERVER) {
     s = DoServerNegotiation(conn.get(), authentication, encryption, deadline);
   } else {
     s = DoClientNegotiation(conn.get(), authentication, encryption, deadline,
                             &rpc_error);
   }
+  if (metric_entity) {
+    auto* prototype = conn->direction() == Connection::SERVER ?
+        &METRIC_rpc_server_negotiation_time_us : &METRIC_rpc_client_negotiation_time_us;
+    prototype->Instantiate(metric_entity)->Increment(
+        (MonoTime::Now() - start).ToMicroseconds());
+  }
 
   if (PREDICT_FALSE(!s.ok())) {
     string msg = Substitute("$0 connection negotiation failed: $1",
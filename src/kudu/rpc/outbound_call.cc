@@ -26,6 +26,7 @@
 
 #include <boost/function.hpp>
 #include <gflags/gflags.h>
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/message.h>
 
 #include "kudu/gutil/port.h"
@@ -33,6 +34,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/walltime.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/outbound_call.h"
 #include "kudu/rpc/rpc_controller.h"
@@ -60,6 +62,7 @@ DEFINE_int32(rpc_inject_cancellation_state, -1,
              "will be injected. Should use values in OutboundCall::State only");
 TAG_FLAG(rpc_inject_cancellation_state, unsafe);
 
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -80,13 +83,15 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
                            const RemoteMethod& remote_method,
                            google::protobuf::Message* response_storage,
                            RpcController* controller,
-                           ResponseCallback callback)
+                           ResponseCallback callback,
+                           shared_ptr<BufferPool> buffer_pool)
     : state_(READY),
       remote_method_(remote_method),
       conn_id_(conn_id),
       callback_(std::move(callback)),
       controller_(DCHECK_NOTNULL(controller)),
       response_(DCHECK_NOTNULL(response_storage)),
+      buffer_pool_(std::move(buffer_pool)),
       cancellation_requested_(false) {
   DVLOG(4) << "OutboundCall " << this << " constructed with state_: " << StateName(state_)
            << " and RPC timeout: "
@@ -102,15 +107,22 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
   if (controller_->request_id_) {
     header_.set_allocated_request_id(controller_->request_id_.release());
   }
+
+  if (controller_->request_server_resource_metrics()) {
+    header_.set_request_resource_metrics(true);
+  }
 }
 
 OutboundCall::~OutboundCall() {
   DCHECK(IsFinished());
   DVLOG(4) << "OutboundCall " << this << " destroyed with state_: " << StateName(state_);
+  if (buffer_pool_) {
+    buffer_pool_->Recycle(std::move(request_buf_));
+  }
 }
 
-size_t OutboundCall::SerializeTo(TransferPayload* slices) {
-  DCHECK_LT(0, request_buf_.size())
+size_t OutboundCall::SerializeTo(TransferPayload* slices, TransferPayloadOwners* owners) {
+  DCHECK(request_buf_ && request_buf_->size() > 0)
       << "Must call SetRequestPayload() before SerializeTo()";
 
   const MonoDelta &timeout = controller_->timeout();
@@ -124,14 +136,17 @@ size_t OutboundCall::SerializeTo(TransferPayload* slices) {
 
   DCHECK_LE(0, sidecar_byte_size_);
   serialization::SerializeHeader(
-      header_, sidecar_byte_size_ + request_buf_.size(), &header_buf_);
+      header_, sidecar_byte_size_ + request_buf_->size(), &header_buf_);
 
   size_t n_slices = 2 + sidecars_.size();
   DCHECK_LE(n_slices, slices->size());
   auto slice_iter = slices->begin();
   *slice_iter++ = Slice(header_buf_);
-  *slice_iter++ = Slice(request_buf_);
+  *slice_iter++ = Slice(*request_buf_);
   for (auto& sidecar : sidecars_) {
+    if (owners) {
+      (*owners)[slice_iter - slices->begin()] = sidecar->SharedData();
+    }
     *slice_iter++ = sidecar->AsSlice();
   }
   DCHECK_EQ(slice_iter - slices->begin(), n_slices);
@@ -156,7 +171,18 @@ void OutboundCall::SetRequestPayload(const Message& req,
     sidecar_byte_size_ += sidecar_bytes;
   }
 
-  serialization::SerializeMessage(req, &request_buf_, sidecar_byte_size_, true);
+  // Calls with large requests go over a bulk connection of their own.
+  const int64_t bulk_threshold = FLAGS_rpc_bulk_transfer_threshold_bytes;
+  if (bulk_threshold > 0 &&
+      static_cast<int64_t>(message_size) + sidecar_byte_size_ > bulk_threshold) {
+    conn_id_.set_bulk(true);
+  }
+
+  // Leave room for the varint length prefix of the message.
+  request_buf_ = buffer_pool_ ?
+      buffer_pool_->Acquire(message_size + google::protobuf::io::kMaxVarint32Bytes) :
+      unique_ptr<faststring>(new faststring());
+  serialization::SerializeMessage(req, request_buf_.get(), sidecar_byte_size_, true);
 }
 
 Status OutboundCall::status() const {
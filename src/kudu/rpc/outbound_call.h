@@ -54,6 +54,7 @@ class Message;
 namespace kudu {
 namespace rpc {
 
+class BufferPool;
 class CallResponse;
 class DumpRunningRpcsRequestPB;
 class RpcCallInProgressPB;
@@ -83,9 +84,12 @@ class OutboundCall {
     REMOTE_CALL,
   };
 
+  // If 'buffer_pool' is set, the request is serialized into a buffer recycled
+  // from it.
   OutboundCall(const ConnectionId& conn_id, const RemoteMethod& remote_method,
                google::protobuf::Message* response_storage,
-               RpcController* controller, ResponseCallback callback);
+               RpcController* controller, ResponseCallback callback,
+               std::shared_ptr<BufferPool> buffer_pool = nullptr);
 
   ~OutboundCall();
 
@@ -106,8 +110,9 @@ class OutboundCall {
 
   // Serialize the call for the wire. Requires that SetRequestPayload()
   // is called first. This is called from the Reactor thread.
-  // Returns the number of slices in the serialized call.
-  size_t SerializeTo(TransferPayload* slices);
+  // Returns the number of slices in the serialized call. If 'owners' is set,
+  // it is filled with the shared memory backing the slices, if any.
+  size_t SerializeTo(TransferPayload* slices, TransferPayloadOwners* owners = nullptr);
 
   // Mark in the call that cancellation has been requested. If the call hasn't yet
   // started sending or has finished sending the RPC request but is waiting for a
@@ -255,16 +260,20 @@ class OutboundCall {
   // RPC-system features required to send this call.
   std::set<RpcFeatureFlag> required_rpc_features_;
 
-  const ConnectionId conn_id_;
+  // Only modified by SetRequestPayload(), before the call is queued.
+  ConnectionId conn_id_;
   ResponseCallback callback_;
   RpcController* controller_;
 
   // Pointer for the protobuf where the response should be written.
   google::protobuf::Message* response_;
 
+  // The pool 'request_buf_' is acquired from. May be null.
+  const std::shared_ptr<BufferPool> buffer_pool_;
+
   // Buffers for storing segments of the wire-format request.
   faststring header_buf_;
-  faststring request_buf_;
+  std::unique_ptr<faststring> request_buf_;
 
   // Once a response has been received for this call, contains that response.
   // Otherwise NULL.
@@ -321,6 +330,12 @@ class CallResponse {
   // See RpcController::GetSidecar()
   Status GetSidecar(int idx, Slice* sidecar) const;
 
+  // See RpcController::GetServerResourceMetrics()
+  const google::protobuf::RepeatedPtrField<ResourceMetricPB>& resource_metrics() const {
+    DCHECK(parsed_);
+    return header_.resource_metrics();
+  }
+
  private:
   // True once ParseFrom() is called.
   bool parsed_;
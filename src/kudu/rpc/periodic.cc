@@ -122,6 +122,11 @@ bool PeriodicTimer::started() const {
   return started_;
 }
 
+MonoTime PeriodicTimer::NextTaskTimeForTests() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return next_task_time_;
+}
+
 MonoDelta PeriodicTimer::GetMinimumPeriod() {
   // Given jitter percentage J and period P, this returns (1-J)*P, which is
   // the lowest possible jittered value.
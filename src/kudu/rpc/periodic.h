@@ -145,6 +145,11 @@ class PeriodicTimer : public std::enable_shared_from_this<PeriodicTimer>,
   // Returns true iff the timer has been started.
   bool started() const;
 
+  // Returns the time at which the task is next due to run.
+  //
+  // Should only be used for tests!
+  MonoTime NextTaskTimeForTests() const;
+
  protected:
   PeriodicTimer(std::shared_ptr<Messenger> messenger,
                 RunTaskFunctor functor,
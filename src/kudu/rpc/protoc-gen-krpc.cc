@@ -207,6 +207,9 @@ class MethodSubstitutions : public Substituter {
     (*map)["metric_enum_key"] = strings::Substitute("kMetricIndex$0", method_->name());
     bool track_result = static_cast<bool>(method_->options().GetExtension(track_rpc_result));
     (*map)["track_result"] = track_result ? " true" : "false";
+    bool use_arena = static_cast<bool>(method_->options().GetExtension(arena_allocate_rpc));
+    (*map)["use_arena"] = use_arena ? " true" : "false";
+    (*map)["priority"] = RpcPriorityClassPB_Name(method_->options().GetExtension(rpc_priority));
     (*map)["authz_method"] = GetAuthzMethod(*method_).get_value_or("AuthorizeAllowAll");
   }
 
@@ -514,6 +517,8 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
               "                           ctx);\n"
               "    };\n"
               "    mi->track_result = $track_result$;\n"
+              "    mi->use_arena = $use_arena$;\n"
+              "    mi->priority = ::kudu::rpc::$priority$;\n"
               "    mi->handler_latency_histogram =\n"
               "        METRIC_handler_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
               "    mi->func = [this](const Message* req, Message* resp, RpcContext* ctx) {\n"
@@ -80,7 +80,8 @@ void Proxy::AsyncRequest(const string& method,
   base::subtle::NoBarrier_Store(&is_started_, true);
   RemoteMethod remote_method(service_name_, method);
   controller->call_.reset(
-      new OutboundCall(conn_id_, remote_method, response, controller, callback));
+      new OutboundCall(conn_id_, remote_method, response, controller, callback,
+                       messenger_->buffer_pool(conn_id_.remote())));
   controller->SetRequestParam(req);
   controller->SetMessenger(messenger_.get());
 
@@ -26,6 +26,7 @@
 #include "kudu/rpc/rpc-test-base.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/thread.h"
@@ -97,6 +98,29 @@ TEST_F(ReactorTest, TestFunctionIsCalledIfReactorShutdown) {
   latch_.Wait();
 }
 
+#if defined(__linux__)
+// Test that the reactors run on the CPUs they are pinned to.
+TEST_F(ReactorTest, TestPinnedReactors) {
+  const int cpu = GetCurrentCpu();
+  ASSERT_GE(cpu, 0);
+  shared_ptr<Messenger> messenger;
+  ASSERT_OK(MessengerBuilder("pinned")
+            .set_num_reactors(2)
+            .set_reactor_cpus({ cpu }, false)
+            .Build(&messenger));
+  for (int i = 0; i < 10; i++) {
+    latch_.Reset(1);
+    messenger->ScheduleOnReactor([&](const Status& s) {
+        CHECK_OK(s);
+        CHECK_EQ(cpu, GetCurrentCpu());
+        latch_.CountDown();
+      }, MonoDelta::FromMilliseconds(0));
+    latch_.Wait();
+  }
+  messenger->Shutdown();
+}
+#endif
+
 TEST_F(ReactorTest, TestReschedulesOnSameReactorThread) {
   // Our scheduled task will schedule yet another task.
   latch_.Reset(2);
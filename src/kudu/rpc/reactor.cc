@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/reactor.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <memory>
 #include <mutex>
@@ -31,10 +32,12 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/client_negotiation.h"
 #include "kudu/rpc/connection.h"
 #include "kudu/rpc/messenger.h"
@@ -45,10 +48,12 @@
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/sanitizer_scopes.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/thread_restrictions.h"
@@ -80,6 +85,37 @@ DEFINE_bool(rpc_reopen_outbound_connections, false,
 TAG_FLAG(rpc_reopen_outbound_connections, unsafe);
 TAG_FLAG(rpc_reopen_outbound_connections, runtime);
 
+DEFINE_int64(rpc_buffer_pool_capacity_mb, 0,
+             "The most memory, in MiB, each reactor keeps in idle transfer buffers "
+             "to recycle across RPCs instead of allocating a buffer for the "
+             "inbound transfer, the serialized request and the serialized "
+             "response of every call. If 0, the buffers are not recycled.");
+TAG_FLAG(rpc_buffer_pool_capacity_mb, experimental);
+
+DEFINE_int32(rpc_reactor_busy_poll_us, 0,
+             "If positive, a reactor which runs out of events keeps polling its "
+             "sockets without blocking for up to this many microseconds before "
+             "blocking in epoll_wait(), so that a message arriving shortly after "
+             "the previous one is picked up without the latency of a wakeup. "
+             "This trades CPU for latency: see --rpc_reactor_busy_poll_budget_percent.");
+TAG_FLAG(rpc_reactor_busy_poll_us, experimental);
+
+DEFINE_int32(rpc_reactor_busy_poll_budget_percent, 50,
+             "The most time, as a percentage of the wall clock time, each reactor "
+             "may spend busy polling when --rpc_reactor_busy_poll_us is positive. "
+             "Once the budget of a period of the reactor timer is spent, the "
+             "reactor blocks right away until the next period.");
+TAG_FLAG(rpc_reactor_busy_poll_budget_percent, experimental);
+TAG_FLAG(rpc_reactor_busy_poll_budget_percent, runtime);
+
+DEFINE_int32(rpc_socket_busy_poll_us, 0,
+             "If positive, sets SO_BUSY_POLL to this many microseconds on the RPC "
+             "sockets, so that the kernel busy-polls the device queue of a socket "
+             "with no data instead of waiting for an interrupt. Requires a NIC "
+             "driver with busy polling support, and raising the value above "
+             "net.core.busy_read requires CAP_NET_ADMIN.");
+TAG_FLAG(rpc_socket_busy_poll_us, experimental);
+
 METRIC_DEFINE_histogram(server, reactor_load_percent,
                         "Reactor Thread Load Percentage",
                         kudu::MetricUnit::kUnits,
@@ -97,6 +133,25 @@ METRIC_DEFINE_histogram(server, reactor_active_latency_us,
                         "to the latency of both inbound and outbound RPCs.",
                         1000000, 2);
 
+METRIC_DEFINE_counter(server, reactor_cpu_migrations,
+                      "Reactor Thread CPU Migrations",
+                      kudu::MetricUnit::kUnits,
+                      "Number of times a reactor thread was found running on another "
+                      "CPU than at its previous periodic check. If this grows quickly, "
+                      "pinning the reactors to CPUs with --rpc_reactor_cpus may improve "
+                      "their cache locality.");
+
+METRIC_DEFINE_counter(server, reactor_busy_poll_wakeups,
+                      "Reactor Busy Poll Wakeups",
+                      kudu::MetricUnit::kUnits,
+                      "Number of times a busy polling reactor found events to handle "
+                      "without blocking in epoll_wait().");
+
+METRIC_DEFINE_counter(server, reactor_busy_poll_time_us,
+                      "Reactor Busy Poll Time",
+                      kudu::MetricUnit::kMicroseconds,
+                      "Total time reactor threads spent busy polling for events.");
+
 namespace kudu {
 namespace rpc {
 
@@ -140,6 +195,9 @@ ReactorThread::ReactorThread(Reactor *reactor, const MessengerBuilder& bld)
         METRIC_reactor_active_latency_us.Instantiate(bld.metric_entity_);
     load_percent_histogram_ =
         METRIC_reactor_load_percent.Instantiate(bld.metric_entity_);
+    cpu_migrations_ = METRIC_reactor_cpu_migrations.Instantiate(bld.metric_entity_);
+    busy_poll_wakeups_ = METRIC_reactor_busy_poll_wakeups.Instantiate(bld.metric_entity_);
+    busy_poll_time_us_ = METRIC_reactor_busy_poll_time_us.Instantiate(bld.metric_entity_);
   }
 }
 
@@ -169,6 +227,15 @@ Status ReactorThread::Init() {
 }
 
 void ReactorThread::InvokePendingCb(struct ev_loop* loop) {
+  // libev calls this after every poll, even one which found nothing, which
+  // happens all the time when busy polling.
+  int pending = ev_pending_count(loop);
+  if (pending == 0) {
+    return;
+  }
+  ReactorThread* thr = static_cast<ReactorThread*>(ev_userdata(loop));
+  thr->total_pending_events_ += pending;
+
   // Calculate the number of cycles spent calling our callbacks.
   // This is called quite frequently so we use CycleClock rather than MonoTime
   // since it's a bit faster.
@@ -177,7 +244,6 @@ void ReactorThread::InvokePendingCb(struct ev_loop* loop) {
   int64_t dur_cycles = CycleClock::Now() - start;
 
   // Contribute this to our histogram.
-  ReactorThread* thr = static_cast<ReactorThread*>(ev_userdata(loop));
   if (thr->invoke_us_histogram_) {
     thr->invoke_us_histogram_->Increment(dur_cycles * 1000000 / base::CyclesPerSecond());
   }
@@ -303,6 +369,7 @@ void ReactorThread::AsyncHandler(ev::async& /*watcher*/, int /*revents*/) {
 
   if (PREDICT_FALSE(reactor_->closing())) {
     ShutdownInternal();
+    stopping_ = true;
     loop_.break_loop(); // break the epoll loop and terminate the thread
     return;
   }
@@ -398,6 +465,23 @@ void ReactorThread::TimerHandler(ev::timer& /*watcher*/, int revents) {
   last_load_measurement_.time_cycles = now_cycles;
   last_load_measurement_.poll_cycles = total_poll_cycles_;
 
+  int cpu = GetCurrentCpu();
+  if (cpu_migrations_ && last_cpu_ != -1 && cpu != last_cpu_) {
+    cpu_migrations_->Increment();
+  }
+  last_cpu_ = cpu;
+
+  // Report the time spent busy polling and start a new budget.
+  if (total_spin_cycles_ > 0) {
+    int64_t spin_us = static_cast<int64_t>(
+        total_spin_cycles_ * 1000000 / base::CyclesPerSecond());
+    if (busy_poll_time_us_) {
+      busy_poll_time_us_->IncrementBy(spin_us - reported_spin_us_);
+    }
+    reported_spin_us_ = spin_us;
+  }
+  ResetBusyPollBudget();
+
   ScanIdleConnections();
 }
 
@@ -474,7 +558,15 @@ void ReactorThread::RunThread() {
   ThreadRestrictions::SetWaitAllowed(false);
   ThreadRestrictions::SetIOAllowed(false);
   DVLOG(6) << "Calling ReactorThread::RunThread()...";
-  loop_.run(0);
+  if (!reactor_->affinity_cpus().empty()) {
+    WARN_NOT_OK(SetCurrentThreadCpuAffinity(reactor_->affinity_cpus()),
+                Substitute("$0: could not pin the reactor thread", name()));
+  }
+  if (FLAGS_rpc_reactor_busy_poll_us > 0) {
+    RunBusyPollLoop();
+  } else {
+    loop_.run(0);
+  }
   VLOG(1) << name() << " thread exiting.";
 
   // No longer need the messenger. This causes the messenger to
@@ -482,6 +574,60 @@ void ReactorThread::RunThread() {
   reactor_->messenger_.reset();
 }
 
+void ReactorThread::RunBusyPollLoop() {
+  // Polls for events without blocking as long as some arrived within the
+  // last spin window, backing off exponentially between empty polls to go
+  // easy on the sibling hyperthread, and blocks otherwise or once the
+  // budget of the current timer period is spent.
+  static const int kMaxPausesPerPoll = 64;
+  const int64_t spin_window_cycles = static_cast<int64_t>(
+      FLAGS_rpc_reactor_busy_poll_us * base::CyclesPerSecond() / 1000000);
+  int64_t last_event_cycles = CycleClock::Now();
+  int pauses = 1;
+  ResetBusyPollBudget();
+  while (!stopping_) {
+    const int64_t events_before = total_pending_events_;
+    const int64_t poll_cycles_before = total_poll_cycles_;
+    const int64_t start_cycles = CycleClock::Now();
+    const bool spinning = start_cycles - last_event_cycles < spin_window_cycles &&
+        busy_poll_budget_cycles_ > 0;
+    if (!spinning) {
+      // Blocks until at least one event arrives, like a regular reactor.
+      loop_.run(EVRUN_ONCE);
+      last_event_cycles = CycleClock::Now();
+      pauses = 1;
+      continue;
+    }
+
+    loop_.run(EVRUN_NOWAIT);
+    if (total_pending_events_ != events_before) {
+      if (busy_poll_wakeups_) {
+        busy_poll_wakeups_->Increment();
+      }
+      last_event_cycles = CycleClock::Now();
+      pauses = 1;
+      continue;
+    }
+    for (int i = 0; i < pauses; i++) {
+      base::subtle::PauseCPU();
+    }
+    pauses = std::min(pauses * 2, kMaxPausesPerPoll);
+
+    // An empty poll counts as idle time in its entirety, so that the load
+    // of a busy polling reactor remains comparable to that of a blocking one.
+    const int64_t spin_cycles = CycleClock::Now() - start_cycles;
+    total_poll_cycles_ = poll_cycles_before + spin_cycles;
+    busy_poll_budget_cycles_ -= spin_cycles;
+    total_spin_cycles_ += spin_cycles;
+  }
+}
+
+void ReactorThread::ResetBusyPollBudget() {
+  busy_poll_budget_cycles_ = static_cast<int64_t>(
+      coarse_timer_granularity_.ToSeconds() *
+      FLAGS_rpc_reactor_busy_poll_budget_percent / 100 * base::CyclesPerSecond());
+}
+
 bool ReactorThread::FindConnection(const ConnectionId& conn_id,
                                    CredentialsPolicy cred_policy,
                                    scoped_refptr<Connection>* conn) {
@@ -617,6 +763,13 @@ Status ReactorThread::CreateClientSocket(Socket *sock) {
   if (ret.ok()) {
     ret = sock->SetNoDelay(true);
   }
+  if (ret.ok() && FLAGS_rpc_socket_busy_poll_us > 0) {
+    Status s = sock->SetBusyPoll(FLAGS_rpc_socket_busy_poll_us);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "could not enable busy polling on an outbound socket: "
+                                     << s.ToString() << THROTTLE_MSG;
+    }
+  }
   LOG_IF(WARNING, !ret.ok())
       << "failed to create an outbound connection because a new socket could not be created: "
       << ret.ToString();
@@ -718,9 +871,27 @@ Reactor::Reactor(shared_ptr<Messenger> messenger,
     : messenger_(std::move(messenger)),
       name_(StringPrintf("%s_R%03d", messenger_->name().c_str(), index)),
       closing_(false),
-      thread_(this, bld) {
+      thread_(this, bld),
+      home_cpu_(-1) {
   static std::once_flag libev_once;
   std::call_once(libev_once, DoInitLibEv);
+  if (!bld.reactor_cpus_.empty()) {
+    home_cpu_ = bld.reactor_cpus_[index % bld.reactor_cpus_.size()];
+    affinity_cpus_ = { home_cpu_ };
+    if (bld.reactor_numa_affinity_) {
+      Status s = GetNumaNodeCpus(home_cpu_, &affinity_cpus_);
+      if (!s.ok()) {
+        LOG(WARNING) << name_ << ": could not find the NUMA node of CPU " << home_cpu_
+                     << ", pinning to the CPU only: " << s.ToString();
+        affinity_cpus_ = { home_cpu_ };
+      }
+    }
+  }
+  if (FLAGS_rpc_buffer_pool_capacity_mb > 0) {
+    buffer_pool_ = std::make_shared<BufferPool>(
+        Substitute("rpc-buffer-pool-$0", name_),
+        FLAGS_rpc_buffer_pool_capacity_mb * 1024 * 1024);
+  }
 }
 
 Status Reactor::Init() {
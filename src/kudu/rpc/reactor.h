@@ -22,6 +22,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/function.hpp> // IWYU pragma: keep
 #include <boost/intrusive/list.hpp>
@@ -49,6 +50,7 @@ namespace rpc {
 
 typedef std::list<scoped_refptr<Connection>> conn_list_t;
 
+class BufferPool;
 class DumpRunningRpcsRequestPB;
 class DumpRunningRpcsResponsePB;
 class OutboundCall;
@@ -206,6 +208,13 @@ class ReactorThread {
   // Run the main event loop of the reactor.
   void RunThread();
 
+  // Runs the event loop in busy polling mode, see --rpc_reactor_busy_poll_us.
+  // Returns once the reactor shuts down.
+  void RunBusyPollLoop();
+
+  // Grants the busy polling budget of a new period of the timer.
+  void ResetBusyPollBudget();
+
   // When libev has noticed that it needs to wake up an application watcher,
   // it calls this callback. The callback simply calls back into libev's
   // ev_invoke_pending() to trigger all the watcher callbacks, but
@@ -312,6 +321,12 @@ class ReactorThread {
   // Metrics.
   scoped_refptr<Histogram> invoke_us_histogram_;
   scoped_refptr<Histogram> load_percent_histogram_;
+  scoped_refptr<Counter> cpu_migrations_;
+  scoped_refptr<Counter> busy_poll_wakeups_;
+  scoped_refptr<Counter> busy_poll_time_us_;
+
+  // The CPU the thread was running on at the last TimerHandler() call, or -1.
+  int last_cpu_ = -1;
 
   // Total number of client connections opened during Reactor's lifetime.
   uint64_t total_client_conns_cnt_;
@@ -327,6 +342,20 @@ class ReactorThread {
   // started.
   int64_t total_poll_cycles_ = 0;
 
+  // The total number of events handled since this thread started.
+  int64_t total_pending_events_ = 0;
+
+  // Set when the reactor shuts down, to break out of RunBusyPollLoop().
+  bool stopping_ = false;
+
+  // The cycles left to spend busy polling in the current period of the timer.
+  int64_t busy_poll_budget_cycles_ = 0;
+
+  // The total number of cycles spent busy polling since this thread started,
+  // and the part of it already reported to busy_poll_time_us_, in microseconds.
+  int64_t total_spin_cycles_ = 0;
+  int64_t reported_spin_us_ = 0;
+
   // Accounting for determining load average in each cycle of TimerHandler.
   struct {
     // The cycle-time at which the load average was last calculated.
@@ -399,6 +428,20 @@ class Reactor {
     return thread_.IsCurrentThread();
   }
 
+  // The pool of transfer buffers of the calls on this reactor's connections,
+  // or null if the buffers are not pooled. Transfers and calls keep a
+  // reference to it, since they may outlive the reactor.
+  const std::shared_ptr<BufferPool>& buffer_pool() const {
+    return buffer_pool_;
+  }
+
+  // The CPU this reactor is pinned to, or -1 if it isn't pinned.
+  int home_cpu() const { return home_cpu_; }
+
+  // The CPUs this reactor's thread may run on, or an empty list if it may run
+  // on any CPU.
+  const std::vector<int>& affinity_cpus() const { return affinity_cpus_; }
+
  private:
   friend class ReactorThread;
   typedef simple_spinlock LockType;
@@ -419,6 +462,12 @@ class Reactor {
 
   ReactorThread thread_;
 
+  std::shared_ptr<BufferPool> buffer_pool_;
+
+  // See home_cpu() and affinity_cpus().
+  int home_cpu_;
+  std::vector<int> affinity_cpus_;
+
   DISALLOW_COPY_AND_ASSIGN(Reactor);
 };
 
@@ -293,6 +293,7 @@ class CalculatorService : public CalculatorServiceIf {
 
   void Echo(const EchoRequestPB *req, EchoResponsePB *resp, RpcContext *context) override {
     resp->set_data(req->data());
+    resp->set_on_arena(req->GetArena() != nullptr);
     context->RespondSuccess();
   }
 
@@ -55,6 +55,7 @@
 #include "kudu/security/test/test_certs.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
@@ -69,9 +70,14 @@
 
 METRIC_DECLARE_histogram(handler_latency_kudu_rpc_test_CalculatorService_Sleep);
 METRIC_DECLARE_histogram(rpc_incoming_queue_time);
+METRIC_DECLARE_counter(reactor_busy_poll_wakeups);
 
 DECLARE_bool(rpc_reopen_outbound_connections);
+DECLARE_int64(rpc_bulk_transfer_threshold_bytes);
 DECLARE_int32(rpc_negotiation_inject_delay_ms);
+DECLARE_int32(rpc_reactor_busy_poll_budget_percent);
+DECLARE_int32(rpc_reactor_busy_poll_us);
+DECLARE_int64(rpc_zero_copy_threshold_bytes);
 
 using std::shared_ptr;
 using std::string;
@@ -184,6 +190,30 @@ TEST_P(TestRpc, TestCall) {
   }
 }
 
+// Test making RPC calls through busy polling reactors.
+TEST_P(TestRpc, TestCallWithBusyPolling) {
+  FLAGS_rpc_reactor_busy_poll_us = 100 * 1000;
+  FLAGS_rpc_reactor_busy_poll_budget_percent = 100;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServer(&server_addr, enable_ssl));
+  shared_ptr<Messenger> client_messenger;
+  ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+
+  // The reactors picked up at least some of the calls and responses without
+  // blocking.
+  scoped_refptr<Counter> wakeups =
+      METRIC_reactor_busy_poll_wakeups.Instantiate(server_messenger_->metric_entity());
+  ASSERT_GT(wakeups->value(), 0);
+  client_messenger->Shutdown();
+}
+
 // Test for KUDU-2091 and KUDU-2220.
 TEST_P(TestRpc, TestCallWithChainCertAndChainCA) {
   bool enable_ssl = GetParam();
@@ -740,6 +770,79 @@ TEST_P(TestRpc, TestConnectionNetworkPlane) {
   ASSERT_EQ(2, metrics.num_client_connections_);
 }
 
+// Test that the calls with large requests go over a bulk connection of their
+// own, while the calls with large responses only don't.
+TEST_P(TestRpc, TestBulkConnection) {
+  FLAGS_rpc_bulk_transfer_threshold_bytes = 16 * 1024;
+  n_server_reactor_threads_ = 1;
+  keepalive_time_ms_ = -1;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServer(&server_addr, enable_ssl));
+  shared_ptr<Messenger> client_messenger;
+  ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  ReactorMetrics metrics;
+  ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  DoTestSidecar(p, 64 * 1024, 64 * 1024);
+  ASSERT_OK(client_messenger->reactors_[0]->GetMetrics(&metrics));
+  ASSERT_EQ(1, metrics.num_client_connections_);
+
+  ASSERT_OK(DoTestOutgoingSidecar(p, 64 * 1024, 64 * 1024));
+  ASSERT_OK(client_messenger->reactors_[0]->GetMetrics(&metrics));
+  ASSERT_EQ(2, metrics.num_client_connections_);
+
+  // Both kinds of calls keep using their connection.
+  ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  ASSERT_OK(DoTestOutgoingSidecar(p, 64 * 1024, 64 * 1024));
+  ASSERT_OK(client_messenger->reactors_[0]->GetMetrics(&metrics));
+  ASSERT_EQ(2, metrics.total_client_connections_);
+  ASSERT_OK(server_messenger_->reactors_[0]->GetMetrics(&metrics));
+  ASSERT_EQ(2, metrics.total_server_connections_);
+}
+
+// Test that calls with shared sidecars succeed when they are sent with
+// MSG_ZEROCOPY, or over TLS connections, which don't support it. Over the
+// loopback device, the kernel ends up copying the data anyway.
+TEST_P(TestRpc, TestZeroCopySidecars) {
+  FLAGS_rpc_zero_copy_threshold_bytes = 16 * 1024;
+
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  ASSERT_OK(StartTestServer(&server_addr, enable_ssl));
+  shared_ptr<Messenger> client_messenger;
+  ASSERT_OK(CreateMessenger("Client", &client_messenger, 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, server_addr.host(),
+          GenericCalculatorService::static_service_name());
+
+  for (int size : { 100, 64 * 1024, 3000 * 1024 }) {
+    SCOPED_TRACE(size);
+    shared_ptr<faststring> data1(new faststring());
+    data1->append(string(size, 'a'));
+    shared_ptr<faststring> data2(new faststring());
+    data2->append(string(size, 'b'));
+
+    RpcController controller;
+    int idx1;
+    int idx2;
+    ASSERT_OK(controller.AddOutboundSidecar(RpcSidecar::FromSharedFaststring(data1), &idx1));
+    ASSERT_OK(controller.AddOutboundSidecar(RpcSidecar::FromSharedFaststring(data2), &idx2));
+    PushTwoStringsRequestPB req;
+    req.set_sidecar1_idx(idx1);
+    req.set_sidecar2_idx(idx2);
+    PushTwoStringsResponsePB resp;
+    ASSERT_OK(p.SyncRequest(GenericCalculatorService::kPushTwoStringsMethodName,
+                            req, &resp, &controller));
+    ASSERT_EQ(size, resp.size1());
+    ASSERT_EQ(data1->ToString(), resp.data1());
+    ASSERT_EQ(size, resp.size2());
+    ASSERT_EQ(data2->ToString(), resp.data2());
+  }
+}
+
 // Test that a call which takes longer than the keepalive time
 // succeeds -- i.e that we don't consider a connection to be "idle" on the
 // server if there is a call outstanding on it.
@@ -31,6 +31,7 @@
 
 namespace google {
 namespace protobuf {
+class Arena;
 class Message;
 } // namespace protobuf
 } // namespace google
@@ -71,6 +72,13 @@ class RpcContext {
              const google::protobuf::Message *request_pb,
              google::protobuf::Message *response_pb);
 
+  // Like the above, but for a request and response allocated on 'arena',
+  // which the context takes ownership of and frees along with them.
+  RpcContext(InboundCall *call,
+             const google::protobuf::Message *request_pb,
+             google::protobuf::Message *response_pb,
+             std::unique_ptr<google::protobuf::Arena> arena);
+
   ~RpcContext();
 
   // Initialize a result tracker for the RPC.
@@ -241,8 +249,11 @@ class RpcContext {
  private:
   friend class ResultTracker;
   InboundCall* const call_;
-  const gscoped_ptr<const google::protobuf::Message> request_pb_;
-  const gscoped_ptr<google::protobuf::Message> response_pb_;
+  // If set, owns 'request_pb_' and 'response_pb_': they are released rather
+  // than deleted on destruction.
+  const std::unique_ptr<google::protobuf::Arena> arena_;
+  gscoped_ptr<const google::protobuf::Message> request_pb_;
+  gscoped_ptr<google::protobuf::Message> response_pb_;
   scoped_refptr<ResultTracker> result_tracker_;
 };
 
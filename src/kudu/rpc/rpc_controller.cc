@@ -17,9 +17,11 @@
 
 #include "kudu/rpc/rpc_controller.h"
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <string>
 #include <utility>
 
 #include <glog/logging.h>
@@ -62,6 +64,7 @@ void RpcController::Swap(RpcController* other) {
   std::swap(outbound_sidecars_total_bytes_, other->outbound_sidecars_total_bytes_);
   std::swap(timeout_, other->timeout_);
   std::swap(credentials_policy_, other->credentials_policy_);
+  std::swap(request_server_resource_metrics_, other->request_server_resource_metrics_);
   std::swap(call_, other->call_);
 }
 
@@ -72,6 +75,7 @@ void RpcController::Reset() {
   }
   call_.reset();
   required_server_features_.clear();
+  request_server_resource_metrics_ = false;
   credentials_policy_ = CredentialsPolicy::ANY_CREDENTIALS;
   messenger_ = nullptr;
   outbound_sidecars_total_bytes_ = 0;
@@ -110,6 +114,15 @@ Status RpcController::GetInboundSidecar(int idx, Slice* sidecar) const {
   return call_->call_response_->GetSidecar(idx, sidecar);
 }
 
+void RpcController::GetServerResourceMetrics(std::map<std::string, int64_t>* metrics) const {
+  if (!call_ || !call_->call_response_) {
+    return;
+  }
+  for (const auto& m : call_->call_response_->resource_metrics()) {
+    (*metrics)[m.key()] += m.value();
+  }
+}
+
 void RpcController::set_timeout(const MonoDelta& timeout) {
   std::lock_guard<simple_spinlock> l(lock_);
   DCHECK(!call_ || call_->state() == OutboundCall::READY);
@@ -18,7 +18,9 @@
 #define KUDU_RPC_RPC_CONTROLLER_H
 
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
@@ -219,6 +221,25 @@ class RpcController {
   // May fail if index is invalid.
   Status GetInboundSidecar(int idx, Slice* sidecar) const;
 
+  // Ask the server to return the resources it used to handle the call, e.g.
+  // the CPU time of the handler or the bytes read from disk. Must be set
+  // before the call is sent. Servers which don't support this ignore it.
+  void set_request_server_resource_metrics(bool request) {
+    request_server_resource_metrics_ = request;
+  }
+
+  bool request_server_resource_metrics() const {
+    return request_server_resource_metrics_;
+  }
+
+  // Adds the resources the server reported using to handle the call to
+  // 'metrics', keyed by name. Nothing is added unless they were requested
+  // with set_request_server_resource_metrics().
+  //
+  // Should only be called if the call's finished, but the controller has not
+  // been Reset().
+  void GetServerResourceMetrics(std::map<std::string, int64_t>* metrics) const;
+
   // Adds a sidecar to the outbound request. The index of the sidecar is written to
   // 'idx'. Returns an error if TransferLimits::kMaxSidecars have already been added
   // to this request. Also returns an error if the total size of all sidecars would
@@ -252,6 +273,9 @@ class RpcController {
   MonoDelta timeout_;
   std::unordered_set<uint32_t> required_server_features_;
 
+  // See set_request_server_resource_metrics().
+  bool request_server_resource_metrics_ = false;
+
   // RPC authentication policy for outbound calls.
   CredentialsPolicy credentials_policy_;
 
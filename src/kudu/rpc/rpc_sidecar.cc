@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include <google/protobuf/repeated_field.h>
@@ -28,6 +29,8 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
+using std::shared_ptr;
+using std::string;
 using std::unique_ptr;
 
 namespace kudu {
@@ -54,6 +57,26 @@ class FaststringSidecar : public RpcSidecar {
   const unique_ptr<faststring> data_;
 };
 
+class SharedFaststringSidecar : public RpcSidecar {
+ public:
+  explicit SharedFaststringSidecar(shared_ptr<const faststring> data) : data_(std::move(data)) { }
+  Slice AsSlice() const override { return *data_; }
+  shared_ptr<const void> SharedData() const override { return data_; }
+
+ private:
+  const shared_ptr<const faststring> data_;
+};
+
+class StringSidecar : public RpcSidecar {
+ public:
+  explicit StringSidecar(string data) : data_(std::make_shared<const string>(std::move(data))) { }
+  Slice AsSlice() const override { return *data_; }
+  shared_ptr<const void> SharedData() const override { return data_; }
+
+ private:
+  const shared_ptr<const string> data_;
+};
+
 unique_ptr<RpcSidecar> RpcSidecar::FromFaststring(unique_ptr<faststring> data) {
   return unique_ptr<RpcSidecar>(new FaststringSidecar(std::move(data)));
 }
@@ -62,6 +85,14 @@ unique_ptr<RpcSidecar> RpcSidecar::FromSlice(Slice slice) {
   return unique_ptr<RpcSidecar>(new SliceSidecar(slice));
 }
 
+unique_ptr<RpcSidecar> RpcSidecar::FromSharedFaststring(shared_ptr<const faststring> data) {
+  return unique_ptr<RpcSidecar>(new SharedFaststringSidecar(std::move(data)));
+}
+
+unique_ptr<RpcSidecar> RpcSidecar::FromString(string data) {
+  return unique_ptr<RpcSidecar>(new StringSidecar(std::move(data)));
+}
+
 
 Status RpcSidecar::ParseSidecars(
     const ::google::protobuf::RepeatedField<::google::protobuf::uint32>& offsets,
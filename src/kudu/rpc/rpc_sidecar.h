@@ -18,6 +18,7 @@
 #define KUDU_RPC_RPC_SIDECAR_H
 
 #include <memory>
+#include <string>
 
 #include <google/protobuf/repeated_field.h> // IWYU pragma: keep
 #include <google/protobuf/stubs/port.h>
@@ -53,6 +54,16 @@ class RpcSidecar {
   static std::unique_ptr<RpcSidecar> FromFaststring(std::unique_ptr<faststring> data);
   static std::unique_ptr<RpcSidecar> FromSlice(Slice slice);
 
+  // Create a sidecar which shares ownership of 'data', so that the same buffer
+  // may be attached to several calls without being copied.
+  static std::unique_ptr<RpcSidecar> FromSharedFaststring(
+      std::shared_ptr<const faststring> data);
+
+  // Create a sidecar which takes over 'data', e.g. a buffer filled by a read.
+  // Its memory is shared like that of FromSharedFaststring(), so it may be
+  // sent without a copy.
+  static std::unique_ptr<RpcSidecar> FromString(std::string data);
+
   // Utility method to parse a series of sidecar slices into 'sidecars' from 'buffer' and
   // a set of offsets. 'sidecars' must have length >= TransferLimits::kMaxSidecars, and
   // will be filled from index 0.
@@ -63,6 +74,11 @@ class RpcSidecar {
 
   // Returns a Slice representation of the sidecar's data.
   virtual Slice AsSlice() const = 0;
+
+  // If the sidecar's data is immutable and shared, returns a reference which
+  // keeps it alive past the sidecar, e.g. until the kernel is done sending it
+  // without a copy. Returns null otherwise.
+  virtual std::shared_ptr<const void> SharedData() const { return nullptr; }
   virtual ~RpcSidecar() { }
 };
 
@@ -22,6 +22,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -67,6 +68,7 @@
 #include "kudu/util/user.h"
 
 DEFINE_bool(is_panic_test_child, false, "Used by TestRpcPanic");
+DECLARE_bool(rpc_allocate_on_arena);
 DECLARE_bool(socket_inject_short_recvs);
 
 using kudu::pb_util::SecureDebugString;
@@ -157,6 +159,26 @@ TEST_F(RpcStubTest, TestBigCallData) {
   }
 }
 
+// Test that the methods which opt in have their requests allocated on an
+// arena, unless disabled by the flag.
+TEST_F(RpcStubTest, TestArenaAllocatedCall) {
+  CalculatorServiceProxy p(client_messenger_, server_addr_, server_addr_.host());
+  EchoRequestPB req;
+  req.set_data(string(100 * 1024, 'x'));
+  for (bool on_arena : { true, false }) {
+    FLAGS_rpc_allocate_on_arena = on_arena;
+    RpcController controller;
+    EchoResponsePB resp;
+    ASSERT_OK(p.Echo(req, &resp, &controller));
+    ASSERT_EQ(req.data(), resp.data());
+    ASSERT_EQ(on_arena, resp.on_arena());
+  }
+
+  // Methods which don't opt in never use an arena.
+  FLAGS_rpc_allocate_on_arena = true;
+  NO_FATALS(SendSimpleCall());
+}
+
 TEST_F(RpcStubTest, TestRespondDeferred) {
   CalculatorServiceProxy p(client_messenger_, server_addr_, server_addr_.host());
 
@@ -669,6 +691,49 @@ TEST_F(RpcStubTest, TestDumpSampledCalls) {
                       "    }");
   ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "SleepRequestPB");
   ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs), "duration_ms");
+
+  // The totals for the method cover both calls, with the child traces' metrics
+  // folded in.
+  EXPECT_EQ(2, sampled_rpcs.methods(0).num_calls());
+  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
+                      "  total_metrics {\n"
+                      "    key: \"related_trace_metric\"\n"
+                      "    value: 2\n"
+                      "  }\n");
+  ASSERT_STR_CONTAINS(SecureDebugString(sampled_rpcs),
+                      "  total_metrics {\n"
+                      "    key: \"test_sleep_us\"\n"
+                      "    value: 1650000\n"
+                      "  }\n");
+}
+
+// Test that the server returns the resources used by a call only when the
+// client asks for them.
+TEST_F(RpcStubTest, TestServerResourceMetrics) {
+  CalculatorServiceProxy p(client_messenger_, server_addr_, server_addr_.host());
+  SleepRequestPB req;
+  req.set_sleep_micros(1000);
+  SleepResponsePB resp;
+
+  {
+    RpcController controller;
+    ASSERT_OK(p.Sleep(req, &resp, &controller));
+    std::map<string, int64_t> metrics;
+    controller.GetServerResourceMetrics(&metrics);
+    ASSERT_TRUE(metrics.empty());
+  }
+
+  {
+    RpcController controller;
+    controller.set_request_server_resource_metrics(true);
+    ASSERT_OK(p.Sleep(req, &resp, &controller));
+    std::map<string, int64_t> metrics;
+    controller.GetServerResourceMetrics(&metrics);
+    ASSERT_EQ(1000, metrics["test_sleep_us"]);
+    ASSERT_EQ(1, metrics["related_trace_metric"]);
+    ASSERT_EQ(1, metrics.count("handler_cpu_time_us"));
+    ASSERT_GE(metrics["handler_cpu_time_us"], 0);
+  }
 }
 
 namespace {
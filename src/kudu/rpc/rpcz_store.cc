@@ -20,6 +20,7 @@
 #include <algorithm>  // IWYU pragma: keep
 #include <array>
 #include <cstdint>
+#include <map>
 #include <mutex> // for unique_lock
 #include <ostream>
 #include <string>
@@ -84,7 +85,10 @@ class MethodSampler {
   // Potentially sample a single call.
   void SampleCall(InboundCall* call);
 
-  // Dump the current samples.
+  // Add the resources used by a single call to the totals for the method.
+  void AccountCall(InboundCall* call);
+
+  // Dump the current samples and totals.
   void GetSamplePBs(RpczMethodPB* pb);
 
  private:
@@ -113,6 +117,11 @@ class MethodSampler {
   };
   std::array<SampleBucket, kNumBuckets> buckets_;
 
+  // Protects 'num_calls_' and 'total_metrics_'.
+  simple_spinlock totals_lock_;
+  int64_t num_calls_ = 0;
+  std::map<string, int64_t> total_metrics_;
+
   DISALLOW_COPY_AND_ASSIGN(MethodSampler);
 };
 
@@ -171,6 +180,14 @@ void MethodSampler::SampleCall(InboundCall* call) {
   }
 }
 
+void MethodSampler::AccountCall(InboundCall* call) {
+  std::lock_guard<simple_spinlock> l(totals_lock_);
+  num_calls_++;
+  for (const auto& e : call->resource_metrics()) {
+    total_metrics_[e.first] += e.second;
+  }
+}
+
 void MethodSampler::GetTraceMetrics(const Trace& t,
                                     const string& child_path,
                                     RpczSamplePB* sample_pb) {
@@ -195,6 +212,16 @@ void MethodSampler::GetTraceMetrics(const Trace& t,
 }
 
 void MethodSampler::GetSamplePBs(RpczMethodPB* method_pb) {
+  {
+    std::lock_guard<simple_spinlock> l(totals_lock_);
+    method_pb->set_num_calls(num_calls_);
+    for (const auto& e : total_metrics_) {
+      auto* pb = method_pb->add_total_metrics();
+      pb->set_key(e.first);
+      pb->set_value(e.second);
+    }
+  }
+
   for (auto& bucket : buckets_) {
     if (bucket.last_sample_time.Load() == 0) continue;
 
@@ -216,6 +243,7 @@ void RpczStore::AddCall(InboundCall* call) {
   auto* sampler = SamplerForCall(call);
   if (PREDICT_FALSE(!sampler)) return;
 
+  sampler->AccountCall(call);
   sampler->SampleCall(call);
 }
 
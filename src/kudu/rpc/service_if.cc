@@ -17,6 +17,8 @@
 
 #include "kudu/rpc/service_if.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -24,6 +26,7 @@
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <google/protobuf/arena.h>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
@@ -46,6 +49,15 @@
 DEFINE_bool(enable_exactly_once, true, "Whether to enable exactly once semantics.");
 TAG_FLAG(enable_exactly_once, hidden);
 
+DEFINE_bool(rpc_allocate_on_arena, true,
+            "Whether to allocate the request and response protobufs of the RPC "
+            "methods which opt in with the 'arena_allocate_rpc' option on a "
+            "per-call arena.");
+TAG_FLAG(rpc_allocate_on_arena, advanced);
+TAG_FLAG(rpc_allocate_on_arena, runtime);
+
+using google::protobuf::Arena;
+using google::protobuf::ArenaOptions;
 using google::protobuf::Message;
 using std::string;
 using std::unique_ptr;
@@ -104,6 +116,10 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
     RespondBadMethod(call);
     return;
   }
+  if (method_info->use_arena && !method_info->track_result && FLAGS_rpc_allocate_on_arena) {
+    HandleOnArena(call);
+    return;
+  }
   unique_ptr<Message> req(method_info->req_prototype->New());
   if (PREDICT_FALSE(!ParseParam(call, req.get()))) {
     return;
@@ -111,6 +127,31 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
   Message* resp = method_info->resp_prototype->New();
 
   RpcContext* ctx = new RpcContext(call, req.release(), resp);
+  Dispatch(call, ctx);
+}
+
+void GeneratedServiceIf::HandleOnArena(InboundCall* call) {
+  const RpcMethodInfo* method_info = call->method_info();
+  // Size the first block of the arena after the serialized request, which
+  // bounds the size of the parsed request, so that most calls parse without
+  // growing the arena.
+  ArenaOptions options;
+  options.start_block_size = std::max<size_t>(options.start_block_size,
+                                              call->serialized_request().size());
+  options.max_block_size = std::max(options.max_block_size, options.start_block_size);
+  unique_ptr<Arena> arena(new Arena(options));
+  Message* req = method_info->req_prototype->New(arena.get());
+  if (PREDICT_FALSE(!ParseParam(call, req))) {
+    return;
+  }
+  Message* resp = method_info->resp_prototype->New(arena.get());
+
+  Dispatch(call, new RpcContext(call, req, resp, std::move(arena)));
+}
+
+void GeneratedServiceIf::Dispatch(InboundCall* call, RpcContext* ctx) {
+  const RpcMethodInfo* method_info = call->method_info();
+  Message* resp = ctx->response_pb();
   if (!method_info->authz_method(ctx->request_pb(), resp, ctx)) {
     // The authz_method itself should have responded to the RPC.
     return;
@@ -149,6 +190,15 @@ RpcMethodInfo* GeneratedServiceIf::LookupMethod(const RemoteMethod& method) {
   return it->second.get();
 }
 
+bool GeneratedServiceIf::HasHighPriorityMethods() const {
+  for (const auto& entry : methods_by_name_) {
+    if (entry.second->priority != NORMAL_PRIORITY) {
+      return true;
+    }
+  }
+  return false;
+}
+
 
 } // namespace rpc
 } // namespace kudu
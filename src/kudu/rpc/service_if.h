@@ -26,6 +26,7 @@
 #include <google/protobuf/message.h>
 
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/util/metrics.h"
 
 namespace kudu {
@@ -52,6 +53,13 @@ struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
   // Whether we should track this method's result, using ResultTracker.
   bool track_result;
 
+  // Whether the request and response of each call should be allocated on a
+  // per-call protobuf arena. Ignored if 'track_result' is set.
+  bool use_arena = false;
+
+  // The priority class of the calls of this method in the service queue.
+  RpcPriorityClassPB priority = NORMAL_PRIORITY;
+
   // The authorization function for this RPC. If this function
   // returns false, the RPC has already been handled (i.e. rejected)
   // by the authorization function.
@@ -85,6 +93,12 @@ class ServiceIf {
     return nullptr;
   }
 
+  // Returns true if some methods of the service have calls of a higher
+  // priority class than NORMAL_PRIORITY.
+  virtual bool HasHighPriorityMethods() const {
+    return false;
+  }
+
   // Default authorization method, which just allows all RPCs.
   //
   // See docs/design-docs/rpc.md for details on how to add custom
@@ -114,6 +128,8 @@ class GeneratedServiceIf : public ServiceIf {
 
   RpcMethodInfo* LookupMethod(const RemoteMethod& method) override;
 
+  bool HasHighPriorityMethods() const override;
+
   // Returns the mapping from method names to method infos.
   typedef std::unordered_map<std::string, scoped_refptr<RpcMethodInfo>> MethodInfoMap;
   const MethodInfoMap& methods_by_name() const { return methods_by_name_; }
@@ -127,6 +143,14 @@ class GeneratedServiceIf : public ServiceIf {
 
   // The result tracker for this service's methods.
   scoped_refptr<ResultTracker> result_tracker_;
+
+ private:
+  // Like Handle(), but allocates the request and response of 'call' on a
+  // per-call arena owned by the call's RpcContext.
+  void HandleOnArena(InboundCall* call);
+
+  // Authorizes the call of 'ctx', tracks its result if needed and runs it.
+  void Dispatch(InboundCall* call, RpcContext* ctx);
 };
 
 } // namespace rpc
@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/service_pool.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <ostream>
@@ -26,6 +27,7 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/basictypes.h"
@@ -38,9 +40,11 @@
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
@@ -54,7 +58,25 @@ METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         "RPC Queue Time",
                         kudu::MetricUnit::kMicroseconds,
                         "Number of microseconds incoming RPC requests spend in the worker queue",
-                        60000000LU, 3);
+                        60000000LU, 3,
+                        kudu::SHARDED);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_normal_priority,
+                        "RPC Queue Time (Normal Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the normal "
+                        "priority class spend in the worker queue",
+                        60000000LU, 3,
+                        kudu::SHARDED);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_high_priority,
+                        "RPC Queue Time (High Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming RPC requests of the high "
+                        "priority class, e.g. Raft consensus requests, spend in the "
+                        "worker queue",
+                        60000000LU, 3,
+                        kudu::SHARDED);
 
 METRIC_DEFINE_counter(server, rpcs_timed_out_in_queue,
                       "RPC Queue Timeouts",
@@ -68,15 +90,29 @@ METRIC_DEFINE_counter(server, rpcs_queue_overflow,
                       "Number of RPCs dropped because the service queue "
                       "was full.");
 
+DEFINE_int32(rpc_num_high_priority_service_threads, 0,
+             "Number of the threads of each RPC service pool reserved for the calls "
+             "of high priority methods, such as the Raft consensus requests, so that "
+             "these don't wait behind lengthy calls when the pool is saturated. "
+             "Only applies to the services with high priority methods, and at least "
+             "one thread of each pool is left for the other calls.");
+TAG_FLAG(rpc_num_high_priority_service_threads, experimental);
+
 namespace kudu {
 namespace rpc {
 
+static_assert(RpcPriorityClassPB_ARRAYSIZE == 2,
+              "every priority class needs a queue time histogram");
+
 ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
   : service_(std::move(service)),
     service_queue_(service_queue_length),
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
+    class_queue_time_{{
+        METRIC_rpc_incoming_queue_time_normal_priority.Instantiate(entity),
+        METRIC_rpc_incoming_queue_time_high_priority.Instantiate(entity) }},
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
     closing_(false) {
@@ -87,10 +123,15 @@ ServicePool::~ServicePool() {
 }
 
 Status ServicePool::Init(int num_threads) {
+  int num_reserved_threads = 0;
+  if (service_->HasHighPriorityMethods()) {
+    num_reserved_threads = std::max(
+        0, std::min(FLAGS_rpc_num_high_priority_service_threads, num_threads - 1));
+  }
   for (int i = 0; i < num_threads; i++) {
     scoped_refptr<kudu::Thread> new_thread;
     CHECK_OK(kudu::Thread::Create("service pool", "rpc worker",
-        &ServicePool::RunThread, this, &new_thread));
+        &ServicePool::RunThread, this, i < num_reserved_threads, &new_thread));
     threads_.push_back(new_thread);
   }
   return Status::OK();
@@ -191,15 +232,22 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   return status;
 }
 
-void ServicePool::RunThread() {
+void ServicePool::RunThread(bool reserved) {
+  if (!thread_cpus_.empty()) {
+    WARN_NOT_OK(SetCurrentThreadCpuAffinity(thread_cpus_),
+                "could not set the CPU affinity of the service thread");
+  }
   while (true) {
     std::unique_ptr<InboundCall> incoming;
-    if (!service_queue_.BlockingGet(&incoming)) {
+    if (!service_queue_.BlockingGet(&incoming, reserved)) {
       VLOG(1) << "ServicePool: messenger shutting down.";
       return;
     }
 
     incoming->RecordHandlingStarted(incoming_queue_time_.get());
+    const InboundCallTiming& timing = incoming->timing();
+    class_queue_time_[LifoServiceQueue::PriorityOf(incoming.get())]->Increment(
+        (timing.time_handled - timing.time_received).ToMicroseconds());
     ADOPT_TRACE(incoming->trace());
 
     if (PREDICT_FALSE(incoming->ClientTimedOut())) {
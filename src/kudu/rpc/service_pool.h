@@ -18,6 +18,7 @@
 #ifndef KUDU_SERVICE_POOL_H
 #define KUDU_SERVICE_POOL_H
 
+#include <array>
 #include <cstddef>
 #include <functional>
 #include <string>
@@ -28,6 +29,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_service.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/util/mutex.h"
@@ -68,6 +70,12 @@ class ServicePool : public RpcService {
     too_busy_hook_ = std::move(hook);
   }
 
+  // Restrict the threads of the pool to run on the CPUs in 'cpus', or on any
+  // CPU if empty. Must be called before Init().
+  void set_thread_cpus(std::vector<int> cpus) {
+    thread_cpus_ = std::move(cpus);
+  }
+
   // Start up the thread pool.
   virtual Status Init(int num_threads);
 
@@ -93,13 +101,18 @@ class ServicePool : public RpcService {
   const std::string service_name() const;
 
  private:
-  void RunThread();
+  // Handles calls until the pool shuts down. If 'reserved' is true, this
+  // thread only handles the calls of the highest priority class.
+  void RunThread(bool reserved);
   void RejectTooBusy(InboundCall* c);
 
   gscoped_ptr<ServiceIf> service_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
+  std::vector<int> thread_cpus_;
   LifoServiceQueue service_queue_;
   scoped_refptr<Histogram> incoming_queue_time_;
+  // The queue time of the calls of each priority class.
+  std::array<scoped_refptr<Histogram>, RpcPriorityClassPB_ARRAYSIZE> class_queue_time_;
   scoped_refptr<Counter> rpcs_timed_out_in_queue_;
   scoped_refptr<Counter> rpcs_queue_overflow_;
 
@@ -30,7 +30,10 @@
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/inbound_call.h"
+#include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/stopwatch.h"
@@ -147,5 +150,93 @@ TEST(TestServiceQueue, LifoServiceQueuePerf) {
   LOG(INFO) << "Avg idle workers:     " << total_idle_workers / static_cast<double>(total_sample);
 }
 
+// Returns a new call of the method of 'method_info', received strictly after
+// any call created before.
+static InboundCall* NewCall(const scoped_refptr<RpcMethodInfo>& method_info) {
+  SleepFor(MonoDelta::FromMilliseconds(1));
+  InboundCall* call = new InboundCall(nullptr);
+  call->set_method_info(method_info);
+  return call;
+}
+
+// Test that the calls of a higher priority class are dequeued first, and that
+// they aren't rejected or evicted by an overflow of calls of a lower class.
+TEST(TestServiceQueue, TestPriorityClasses) {
+  LifoServiceQueue queue(2);
+  scoped_refptr<RpcMethodInfo> normal_info(new RpcMethodInfo());
+  scoped_refptr<RpcMethodInfo> high_info(new RpcMethodInfo());
+  high_info->priority = HIGH_PRIORITY;
+
+  boost::optional<InboundCall*> evicted;
+  InboundCall* normal1 = NewCall(normal_info);
+  InboundCall* normal2 = NewCall(normal_info);
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(normal1, &evicted));
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(normal2, &evicted));
+  InboundCall* high = NewCall(high_info);
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(high, &evicted));
+  ASSERT_EQ(boost::none, evicted);
+  unique_ptr<InboundCall> normal3(NewCall(normal_info));
+  ASSERT_EQ(QUEUE_FULL, queue.Put(normal3.get(), &evicted));
+  ASSERT_EQ(3, queue.estimated_queue_length());
+
+  // Dequeue from another thread, since consumers are bound to their queue.
+  vector<InboundCall*> dequeued;
+  std::thread consumer([&]() {
+      unique_ptr<InboundCall> call;
+      for (int i = 0; i < 3; i++) {
+        CHECK(queue.BlockingGet(&call));
+        dequeued.push_back(call.release());
+      }
+    });
+  consumer.join();
+  queue.Shutdown();
+  ASSERT_EQ(vector<InboundCall*>({ high, normal1, normal2 }), dequeued);
+  for (auto* call : dequeued) {
+    delete call;
+  }
+}
+
+// Test that the consumers reserved for the highest priority class only get
+// calls of that class.
+TEST(TestServiceQueue, TestReservedConsumers) {
+  LifoServiceQueue queue(10);
+  scoped_refptr<RpcMethodInfo> normal_info(new RpcMethodInfo());
+  scoped_refptr<RpcMethodInfo> high_info(new RpcMethodInfo());
+  high_info->priority = HIGH_PRIORITY;
+
+  InboundCall* reserved_call = nullptr;
+  std::thread reserved_consumer([&]() {
+      unique_ptr<InboundCall> call;
+      CHECK(queue.BlockingGet(&call, true));
+      reserved_call = call.release();
+    });
+  ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(1, queue.estimated_idle_worker_count());
+    });
+
+  // The reserved consumer doesn't pick up a normal call...
+  boost::optional<InboundCall*> evicted;
+  InboundCall* normal = NewCall(normal_info);
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(normal, &evicted));
+  ASSERT_EQ(1, queue.estimated_queue_length());
+  ASSERT_EQ(1, queue.estimated_idle_worker_count());
+
+  // ...but gets a high priority one.
+  InboundCall* high = NewCall(high_info);
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(high, &evicted));
+  reserved_consumer.join();
+  ASSERT_EQ(high, reserved_call);
+  delete reserved_call;
+
+  // A regular consumer gets the normal call.
+  std::thread consumer([&]() {
+      unique_ptr<InboundCall> call;
+      CHECK(queue.BlockingGet(&call));
+      CHECK_EQ(normal, call.get());
+    });
+  consumer.join();
+  queue.Shutdown();
+}
+
 } // namespace rpc
 } // namespace kudu
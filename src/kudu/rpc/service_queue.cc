@@ -23,12 +23,16 @@
 #include <boost/optional/optional.hpp>
 
 #include "kudu/gutil/port.h"
+#include "kudu/rpc/service_if.h"
 
 namespace kudu {
 namespace rpc {
 
 __thread LifoServiceQueue::ConsumerState* LifoServiceQueue::tl_consumer_ = nullptr;
 
+constexpr int LifoServiceQueue::kNumPriorityClasses;
+constexpr int LifoServiceQueue::kHighestPriorityClass;
+
 LifoServiceQueue::LifoServiceQueue(int max_size)
    : shutdown_(false),
      max_queue_size_(max_size) {
@@ -36,32 +40,46 @@ LifoServiceQueue::LifoServiceQueue(int max_size)
 }
 
 LifoServiceQueue::~LifoServiceQueue() {
-  DCHECK(queue_.empty())
+  DCHECK(empty())
       << "ServiceQueue holds bare pointers at destruction time";
 }
 
-bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
+RpcPriorityClassPB LifoServiceQueue::PriorityOf(InboundCall* call) {
+  const RpcMethodInfo* info = call->method_info();
+  return info ? info->priority : NORMAL_PRIORITY;
+}
+
+bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out, bool reserved) {
   auto consumer = tl_consumer_;
   if (PREDICT_FALSE(!consumer)) {
-    consumer = tl_consumer_ = new ConsumerState(this);
+    consumer = tl_consumer_ = new ConsumerState(this, reserved);
     std::lock_guard<simple_spinlock> l(lock_);
     consumers_.emplace_back(consumer);
   }
+  DCHECK_EQ(reserved, consumer->reserved());
 
+  const int lowest_class = reserved ? kHighestPriorityClass : 0;
   while (true) {
     {
       std::lock_guard<simple_spinlock> l(lock_);
-      if (!queue_.empty()) {
-        auto it = queue_.begin();
-        out->reset(*it);
-        queue_.erase(it);
-        return true;
+      for (int c = kHighestPriorityClass; c >= lowest_class; c--) {
+        auto& queue = queues_[c];
+        if (!queue.empty()) {
+          auto it = queue.begin();
+          out->reset(*it);
+          queue.erase(it);
+          return true;
+        }
       }
       if (PREDICT_FALSE(shutdown_)) {
         return false;
       }
       consumer->DCheckBoundInstance(this);
-      waiting_consumers_.push_back(consumer);
+      if (reserved) {
+        waiting_reserved_consumers_.push_back(consumer);
+      } else {
+        waiting_consumers_.push_back(consumer);
+      }
     }
     InboundCall* call = consumer->Wait();
     if (call != nullptr) {
@@ -75,17 +93,28 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
 
 QueueStatus LifoServiceQueue::Put(InboundCall* call,
                                   boost::optional<InboundCall*>* evicted) {
+  const int priority = PriorityOf(call);
+  auto& queue = queues_[priority];
+
   std::unique_lock<simple_spinlock> l(lock_);
   if (PREDICT_FALSE(shutdown_)) {
     return QUEUE_SHUTDOWN;
   }
 
-  DCHECK(!(waiting_consumers_.size() > 0 && queue_.size() > 0));
+  DCHECK(!(waiting_reserved_consumers_.size() > 0 && queues_[kHighestPriorityClass].size() > 0));
 
-  // fast path
-  if (queue_.empty() && waiting_consumers_.size() > 0) {
-    auto consumer = waiting_consumers_[waiting_consumers_.size() - 1];
-    waiting_consumers_.pop_back();
+  // fast path: calls of the highest class go to the reserved consumers first,
+  // which leaves the regular ones to the other calls.
+  std::vector<ConsumerState*>* waiting = nullptr;
+  if (priority == kHighestPriorityClass && !waiting_reserved_consumers_.empty()) {
+    waiting = &waiting_reserved_consumers_;
+  } else if (!waiting_consumers_.empty()) {
+    DCHECK_EQ(0, estimated_queue_length());
+    waiting = &waiting_consumers_;
+  }
+  if (waiting) {
+    auto consumer = waiting->back();
+    waiting->pop_back();
     // Notify condition var(and wake up consumer thread) takes time,
     // so put it out of spinlock scope.
     l.unlock();
@@ -93,20 +122,20 @@ QueueStatus LifoServiceQueue::Put(InboundCall* call,
     return QUEUE_SUCCESS;
   }
 
-  if (PREDICT_FALSE(queue_.size() >= max_queue_size_)) {
+  if (PREDICT_FALSE(queue.size() >= max_queue_size_)) {
     // eviction
-    DCHECK_EQ(queue_.size(), max_queue_size_);
-    auto it = queue_.end();
+    DCHECK_EQ(queue.size(), max_queue_size_);
+    auto it = queue.end();
     --it;
     if (DeadlineLess(*it, call)) {
       return QUEUE_FULL;
     }
 
     *evicted = *it;
-    queue_.erase(it);
+    queue.erase(it);
   }
 
-  queue_.insert(call);
+  queue.insert(call);
   return QUEUE_SUCCESS;
 }
 
@@ -119,11 +148,20 @@ void LifoServiceQueue::Shutdown() {
     cs->Post(nullptr);
   }
   waiting_consumers_.clear();
+  for (auto* cs : waiting_reserved_consumers_) {
+    cs->Post(nullptr);
+  }
+  waiting_reserved_consumers_.clear();
 }
 
 bool LifoServiceQueue::empty() const {
   std::lock_guard<simple_spinlock> l(lock_);
-  return queue_.empty();
+  for (const auto& queue : queues_) {
+    if (!queue.empty()) {
+      return false;
+    }
+  }
+  return true;
 }
 
 int LifoServiceQueue::max_size() const {
@@ -134,9 +172,11 @@ std::string LifoServiceQueue::ToString() const {
   std::string ret;
 
   std::lock_guard<simple_spinlock> l(lock_);
-  for (const auto* t : queue_) {
-    ret.append(t->ToString());
-    ret.append("\n");
+  for (int c = kHighestPriorityClass; c >= 0; c--) {
+    for (const auto* t : queues_[c]) {
+      ret.append(t->ToString());
+      ret.append("\n");
+    }
   }
   return ret;
 }
@@ -17,6 +17,7 @@
 #ifndef KUDU_UTIL_SERVICE_QUEUE_H
 #define KUDU_UTIL_SERVICE_QUEUE_H
 
+#include <array>
 #include <memory>
 #include <string>
 #include <set>
@@ -27,6 +28,7 @@
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/rpc/inbound_call.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/util/condition_variable.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
@@ -72,6 +74,13 @@ enum QueueStatus {
 //   work rate, the queue implementation itself is never used. Thus, we can
 //   have a priority queue without paying extra for it in the common case.
 //
+// Calls are further split by the priority class of their method into queues
+// of their own, each bounded by the max size: the calls of a higher class are
+// always dequeued first, and an overflow of calls of a lower class never
+// evicts them. Some consumers may also be reserved for the calls of the
+// highest class, so that these don't wait for a worker busy with a lengthy
+// call of a lower class.
+//
 // NOTE: because of the use of thread-local consumer records, once a consumer
 // thread accesses one LifoServiceQueue, it becomes "bound" to that queue and
 // must never access any other instance.
@@ -83,18 +92,21 @@ class LifoServiceQueue {
 
   // Get an element from the queue.  Returns false if we were shut down prior to
   // getting the element.
-  bool BlockingGet(std::unique_ptr<InboundCall>* out);
+  //
+  // If 'reserved' is true, the calling consumer only gets calls of the
+  // highest priority class. A consumer must pass the same value every time.
+  bool BlockingGet(std::unique_ptr<InboundCall>* out, bool reserved = false);
 
   // Add a new call to the queue.
   // Returns:
   // - QUEUE_SHUTDOWN if Shutdown() has already been called.
-  // - QUEUE_FULL if the queue is full and 'call' has a later deadline than any
-  //   RPC already in the queue.
+  // - QUEUE_FULL if the queue of the priority class of 'call' is full and
+  //   'call' has a later deadline than any RPC already in that queue.
   // - QUEUE_SUCCESS if 'call' was enqueued.
   //
   // In the case of a 'QUEUE_SUCCESS' response, the new element may have bumped
-  // another call out of the queue. In that case, *evicted will be set to the
-  // call that was bumped.
+  // another call of the same priority class out of the queue. In that case,
+  // *evicted will be set to the call that was bumped.
   QueueStatus Put(InboundCall* call, boost::optional<InboundCall*>* evicted);
 
   // Shut down the queue.
@@ -117,7 +129,10 @@ class LifoServiceQueue {
     // so this method won't try to traverse any actual nodes of the underlying
     // RB tree. Investigation of the libstdcxx implementation confirms that
     // size() is a simple field access of the _Rb_tree structure.
-    int ret = queue_.size();
+    int ret = 0;
+    for (const auto& queue : queues_) {
+      ret += queue.size();
+    }
     ANNOTATE_IGNORE_READS_END();
     return ret;
   }
@@ -126,12 +141,19 @@ class LifoServiceQueue {
   int estimated_idle_worker_count() const {
     ANNOTATE_IGNORE_READS_BEGIN();
     // Size of a vector is a simple field access so this is safe.
-    int ret = waiting_consumers_.size();
+    int ret = waiting_consumers_.size() + waiting_reserved_consumers_.size();
     ANNOTATE_IGNORE_READS_END();
     return ret;
   }
 
+  // Returns the priority class of 'call', NORMAL_PRIORITY if its method is
+  // unknown.
+  static RpcPriorityClassPB PriorityOf(InboundCall* call);
+
  private:
+  static constexpr int kNumPriorityClasses = RpcPriorityClassPB_ARRAYSIZE;
+  static constexpr int kHighestPriorityClass = RpcPriorityClassPB_MAX;
+
   // Comparison function which orders calls by their deadlines.
   static bool DeadlineLess(const InboundCall* a,
                            const InboundCall* b) {
@@ -159,10 +181,11 @@ class LifoServiceQueue {
   // post work using Post().
   class ConsumerState {
    public:
-    explicit ConsumerState(LifoServiceQueue* queue) :
+    ConsumerState(LifoServiceQueue* queue, bool reserved) :
         cond_(&lock_),
         call_(nullptr),
         should_wake_(false),
+        reserved_(reserved),
         bound_queue_(queue) {
     }
 
@@ -189,12 +212,19 @@ class LifoServiceQueue {
       DCHECK_EQ(q, bound_queue_);
     }
 
+    bool reserved() const {
+      return reserved_;
+    }
+
    private:
     Mutex lock_;
     ConditionVariable cond_;
     InboundCall* call_;
     bool should_wake_;
 
+    // Whether this consumer only handles calls of the highest priority class.
+    const bool reserved_;
+
     // For the purpose of assertions, tracks the LifoServiceQueue instance that
     // this consumer is reading from.
     LifoServiceQueue* bound_queue_;
@@ -206,12 +236,14 @@ class LifoServiceQueue {
   bool shutdown_;
   int max_queue_size_;
 
-  // Stack of consumer threads which are currently waiting for work.
+  // Stacks of consumer threads which are currently waiting for work: the
+  // regular ones and the ones reserved for the highest priority class.
   std::vector<ConsumerState*> waiting_consumers_;
+  std::vector<ConsumerState*> waiting_reserved_consumers_;
 
-  // The actual queue. Work is only added to the queue when there were no
-  // consumers available for a "direct hand-off".
-  std::multiset<InboundCall*, DeadlineLessStruct> queue_;
+  // The actual queues, one per priority class. Work is only added to a queue
+  // when there were no consumers available for a "direct hand-off".
+  std::array<std::multiset<InboundCall*, DeadlineLessStruct>, kNumPriorityClasses> queues_;
 
   // The total set of consumers who have ever accessed this queue.
   std::vector<std::unique_ptr<ConsumerState>> consumers_;
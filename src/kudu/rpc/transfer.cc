@@ -20,10 +20,13 @@
 #include <sys/uio.h>
 
 #include <algorithm>
+#include <cerrno>
 #include <cstdint>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <set>
+#include <utility>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -31,6 +34,7 @@
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
@@ -42,6 +46,27 @@ DEFINE_int64(rpc_max_message_size, (50 * 1024 * 1024),
 TAG_FLAG(rpc_max_message_size, advanced);
 TAG_FLAG(rpc_max_message_size, runtime);
 
+DEFINE_int64(rpc_bulk_transfer_threshold_bytes, 0,
+             "If positive, RPC messages larger than this many bytes are handled as "
+             "bulk transfers: they are sent after any smaller message queued on the "
+             "same connection before they start, and the calls with such large "
+             "requests are sent over a separate connection to the server, so that "
+             "e.g. a large Raft catch-up batch doesn't delay the heartbeats queued "
+             "behind it. If 0, messages are sent in the order they are queued.");
+TAG_FLAG(rpc_bulk_transfer_threshold_bytes, experimental);
+TAG_FLAG(rpc_bulk_transfer_threshold_bytes, runtime);
+
+DEFINE_int64(rpc_zero_copy_threshold_bytes, 0,
+             "If positive, RPC sidecars backed by shared immutable memory, such as "
+             "the replicated Raft ops, are sent with MSG_ZEROCOPY when at least this "
+             "many bytes of them remain to be sent, so that the kernel transmits them "
+             "from the sidecar memory instead of copying them into the socket buffer. "
+             "Only takes effect on the connections established after it is set, and "
+             "not on TLS-encrypted connections. Zero-copy sends usually only pay off "
+             "for sends of tens of kB or more. If 0, all sends are copied.");
+TAG_FLAG(rpc_zero_copy_threshold_bytes, experimental);
+TAG_FLAG(rpc_zero_copy_threshold_bytes, runtime);
+
 static bool ValidateMaxMessageSize(const char* flagname, int64_t value) {
   if (value < 1 * 1024 * 1024) {
     LOG(ERROR) << flagname << " must be at least 1MB.";
@@ -62,7 +87,9 @@ namespace rpc {
 
 using std::ostringstream;
 using std::set;
+using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using strings::Substitute;
 
 #define RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status)               \
@@ -79,10 +106,18 @@ using strings::Substitute;
 TransferCallbacks::~TransferCallbacks()
 {}
 
-InboundTransfer::InboundTransfer()
-  : total_length_(kMsgLengthPrefixLength),
+InboundTransfer::InboundTransfer(shared_ptr<BufferPool> buffer_pool)
+  : buffer_pool_(std::move(buffer_pool)),
+    buf_(new faststring()),
+    total_length_(kMsgLengthPrefixLength),
     cur_offset_(0) {
-  buf_.resize(kMsgLengthPrefixLength);
+  buf_->resize(kMsgLengthPrefixLength);
+}
+
+InboundTransfer::~InboundTransfer() {
+  if (buffer_pool_) {
+    buffer_pool_->Recycle(std::move(buf_));
+  }
 }
 
 Status InboundTransfer::ReceiveBuffer(Socket &socket) {
@@ -90,7 +125,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
     // receive uint32 length prefix
     int32_t rem = kMsgLengthPrefixLength - cur_offset_;
     int32_t nread;
-    Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+    Status status = socket.Recv(&(*buf_)[cur_offset_], rem, &nread);
     RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
     if (nread == 0) {
       return Status::OK();
@@ -108,7 +143,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
 
     // The length prefix doesn't include its own 4 bytes, so we have to
     // add that back in.
-    total_length_ = NetworkByteOrder::Load32(&buf_[0]) + kMsgLengthPrefixLength;
+    total_length_ = NetworkByteOrder::Load32(&(*buf_)[0]) + kMsgLengthPrefixLength;
     if (total_length_ > FLAGS_rpc_max_message_size) {
       return Status::NetworkError(Substitute(
           "RPC frame had a length of $0, but we only support messages up to $1 bytes "
@@ -118,7 +153,14 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
       return Status::NetworkError(Substitute("RPC frame had invalid length of $0",
                                              total_length_));
     }
-    buf_.resize(total_length_);
+    if (buffer_pool_) {
+      // Move the length prefix into a recycled buffer large enough for the
+      // whole message.
+      unique_ptr<faststring> buf = buffer_pool_->Acquire(total_length_);
+      buf->append(buf_->data(), kMsgLengthPrefixLength);
+      buf_ = std::move(buf);
+    }
+    buf_->resize(total_length_);
 
     // Fall through to receive the message body, which is likely to be already
     // available on the socket.
@@ -133,7 +175,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
   // currently only used for unit tests.
   int32_t rem = std::min(total_length_ - cur_offset_,
       static_cast<uint32_t>(std::numeric_limits<int32_t>::max()));
-  Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+  Status status = socket.Recv(&(*buf_)[cur_offset_], rem, &nread);
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
   cur_offset_ += nread;
 
@@ -155,20 +197,23 @@ string InboundTransfer::StatusAsString() const {
 OutboundTransfer* OutboundTransfer::CreateForCallRequest(int32_t call_id,
                                                          const TransferPayload &payload,
                                                          size_t n_payload_slices,
-                                                         TransferCallbacks *callbacks) {
-  return new OutboundTransfer(call_id, payload, n_payload_slices, callbacks);
+                                                         TransferCallbacks *callbacks,
+                                                         const TransferPayloadOwners* owners) {
+  return new OutboundTransfer(call_id, payload, n_payload_slices, callbacks, owners);
 }
 
 OutboundTransfer* OutboundTransfer::CreateForCallResponse(const TransferPayload &payload,
                                                           size_t n_payload_slices,
-                                                          TransferCallbacks *callbacks) {
-  return new OutboundTransfer(kInvalidCallId, payload, n_payload_slices, callbacks);
+                                                          TransferCallbacks *callbacks,
+                                                          const TransferPayloadOwners* owners) {
+  return new OutboundTransfer(kInvalidCallId, payload, n_payload_slices, callbacks, owners);
 }
 
 OutboundTransfer::OutboundTransfer(int32_t call_id,
                                    const TransferPayload &payload,
                                    size_t n_payload_slices,
-                                   TransferCallbacks *callbacks)
+                                   TransferCallbacks *callbacks,
+                                   const TransferPayloadOwners* owners)
   : cur_slice_idx_(0),
     cur_offset_in_slice_(0),
     callbacks_(callbacks),
@@ -181,6 +226,13 @@ OutboundTransfer::OutboundTransfer(int32_t call_id,
   for (int i = 0; i < n_payload_slices; i++) {
     payload_slices_[i] = payload[i];
   }
+  if (owners) {
+    for (int i = 0; i < n_payload_slices; i++) {
+      payload_owners_[i] = (*owners)[i];
+    }
+  }
+  const int64_t bulk_threshold = FLAGS_rpc_bulk_transfer_threshold_bytes;
+  bulk_ = bulk_threshold > 0 && TotalLength() > bulk_threshold;
 }
 
 OutboundTransfer::~OutboundTransfer() {
@@ -197,11 +249,33 @@ void OutboundTransfer::Abort(const Status &status) {
   aborted_ = true;
 }
 
-Status OutboundTransfer::SendBuffer(Socket &socket) {
+int32_t OutboundTransfer::NextZeroCopySlice() const {
+  const int64_t threshold = FLAGS_rpc_zero_copy_threshold_bytes;
+  if (threshold <= 0) {
+    return n_payload_slices_;
+  }
+  int offset_in_slice = cur_offset_in_slice_;
+  for (int i = cur_slice_idx_; i < n_payload_slices_; i++) {
+    if (payload_owners_[i] &&
+        static_cast<int64_t>(payload_slices_[i].size()) - offset_in_slice >= threshold) {
+      return i;
+    }
+    offset_in_slice = 0;
+  }
+  return n_payload_slices_;
+}
+
+Status OutboundTransfer::SendBuffer(Socket &socket, ZeroCopyTracker* zero_copy) {
   CHECK_LT(cur_slice_idx_, n_payload_slices_);
 
   started_ = true;
   int n_iovecs = n_payload_slices_ - cur_slice_idx_;
+  int32_t zero_copy_idx = zero_copy ? NextZeroCopySlice() : n_payload_slices_;
+  if (zero_copy_idx != n_payload_slices_) {
+    // Copy the slices before the shared one, then send the shared one on its
+    // own, so that its pin covers exactly the memory of the zero-copy send.
+    n_iovecs = std::max(zero_copy_idx - cur_slice_idx_, 1);
+  }
   struct iovec iovec[n_iovecs];
   {
     int offset_in_slice = cur_offset_in_slice_;
@@ -215,7 +289,20 @@ Status OutboundTransfer::SendBuffer(Socket &socket) {
   }
 
   int64_t written;
-  Status status = socket.Writev(iovec, n_iovecs, &written);
+  Status status;
+  if (zero_copy_idx == cur_slice_idx_) {
+    status = socket.WritevZeroCopy(iovec, n_iovecs, &written);
+    if (PREDICT_FALSE(status.posix_code() == ENOBUFS)) {
+      // The kernel is short of the memory to pin the pages, or the socket is
+      // over its limit of locked memory: copy instead.
+      status = socket.Writev(iovec, n_iovecs, &written);
+    } else if (status.ok() && written > 0) {
+      // Only the sends which wrote something are numbered by the kernel.
+      zero_copy->AddSend(payload_owners_[zero_copy_idx]);
+    }
+  } else {
+    status = socket.Writev(iovec, n_iovecs, &written);
+  }
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
 
   // Adjust our accounting of current writer position.
@@ -22,6 +22,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <limits.h>
+#include <map>
+#include <memory>
 #include <string>
 
 #include <boost/intrusive/list_hook.hpp>
@@ -35,6 +37,8 @@
 #include "kudu/util/status.h"
 
 DECLARE_int64(rpc_max_message_size);
+DECLARE_int64(rpc_bulk_transfer_threshold_bytes);
+DECLARE_int64(rpc_zero_copy_threshold_bytes);
 
 namespace kudu {
 
@@ -42,6 +46,7 @@ class Socket;
 
 namespace rpc {
 
+class BufferPool;
 struct TransferCallbacks;
 
 class TransferLimits {
@@ -57,6 +62,46 @@ class TransferLimits {
 
 typedef std::array<Slice, TransferLimits::kMaxPayloadSlices> TransferPayload;
 
+// For each slice of a TransferPayload, a reference to the immutable memory
+// backing it if that memory is shared, or null. See RpcSidecar::SharedData().
+typedef std::array<std::shared_ptr<const void>, TransferLimits::kMaxPayloadSlices>
+    TransferPayloadOwners;
+
+// Keeps the memory sent with MSG_ZEROCOPY on a socket alive until the kernel
+// reports that it is done with it. The kernel numbers the zero-copy sends of
+// a socket sequentially, starting from 0.
+//
+// Not thread-safe: used from the reactor thread of the connection.
+class ZeroCopyTracker {
+ public:
+  ZeroCopyTracker() : next_id_(0) {}
+
+  // Pins 'owner' until the completion of the next zero-copy send.
+  void AddSend(std::shared_ptr<const void> owner) {
+    pinned_.emplace(next_id_++, std::move(owner));
+  }
+
+  // Releases the memory of the sends numbered from 'first' to 'last', both
+  // inclusive. The range may wrap around.
+  void Complete(uint32_t first, uint32_t last) {
+    for (uint32_t id = first; !pinned_.empty(); id++) {
+      pinned_.erase(id);
+      if (id == last) break;
+    }
+  }
+
+  // Returns the number of zero-copy sends not completed yet.
+  size_t num_pending() const {
+    return pinned_.size();
+  }
+
+ private:
+  uint32_t next_id_;
+  std::map<uint32_t, std::shared_ptr<const void>> pinned_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZeroCopyTracker);
+};
+
 // This class is used internally by the RPC layer to represent an inbound
 // transfer in progress.
 //
@@ -66,7 +111,11 @@ typedef std::array<Slice, TransferLimits::kMaxPayloadSlices> TransferPayload;
 class InboundTransfer {
  public:
 
-  InboundTransfer();
+  // If 'buffer_pool' is set, the message is received into a buffer recycled
+  // from it, and the buffer goes back to it once the transfer is destroyed.
+  explicit InboundTransfer(std::shared_ptr<BufferPool> buffer_pool = nullptr);
+
+  ~InboundTransfer();
 
   // read from the socket into our buffer
   Status ReceiveBuffer(Socket &socket);
@@ -78,7 +127,7 @@ class InboundTransfer {
   bool TransferFinished() const;
 
   Slice data() const {
-    return Slice(buf_);
+    return Slice(*buf_);
   }
 
   // Return a string indicating the status of this transfer (number of bytes received, etc)
@@ -89,7 +138,9 @@ class InboundTransfer {
 
   Status ProcessInboundHeader();
 
-  faststring buf_;
+  const std::shared_ptr<BufferPool> buffer_pool_;
+
+  std::unique_ptr<faststring> buf_;
 
   uint32_t total_length_;
   uint32_t cur_offset_;
@@ -116,19 +167,24 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   //
   // NOTE: 'payload' is currently restricted to a maximum of kMaxPayloadSlices
   // slices.
+  //
+  // If set, 'owners' holds references to the shared memory backing some of
+  // the slices, which may then be sent without a copy.
   // ------------------------------------------------------------
 
   // Create an outbound transfer for a call request.
   static OutboundTransfer* CreateForCallRequest(int32_t call_id,
                                                 const TransferPayload &payload,
                                                 size_t n_payload_slices,
-                                                TransferCallbacks *callbacks);
+                                                TransferCallbacks *callbacks,
+                                                const TransferPayloadOwners* owners = nullptr);
 
   // Create an outbound transfer for a call response.
   // See above for details.
   static OutboundTransfer* CreateForCallResponse(const TransferPayload &payload,
                                                  size_t n_payload_slices,
-                                                 TransferCallbacks *callbacks);
+                                                 TransferCallbacks *callbacks,
+                                                 const TransferPayloadOwners* owners = nullptr);
 
   // Destruct the transfer. A transfer object should never be deallocated
   // before it has either (a) finished transferring, or (b) been Abort()ed.
@@ -139,7 +195,11 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   void Abort(const Status &status);
 
   // send from our buffers into the sock
-  Status SendBuffer(Socket &socket);
+  //
+  // If 'zero_copy' is set, zero-copy sends are enabled on the socket, and the
+  // slices with shared memory of at least --rpc_zero_copy_threshold_bytes are
+  // sent with MSG_ZEROCOPY, their memory being pinned in 'zero_copy'.
+  Status SendBuffer(Socket &socket, ZeroCopyTracker* zero_copy = nullptr);
 
   // Return true if any bytes have yet been sent.
   bool TransferStarted() const;
@@ -150,6 +210,12 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // Return the total number of bytes to be sent (including those already sent)
   int32_t TotalLength() const;
 
+  // Returns true if the transfer is larger than
+  // --rpc_bulk_transfer_threshold_bytes at the time it was created.
+  bool is_bulk() const {
+    return bulk_;
+  }
+
   std::string HexDump() const;
 
   bool is_for_outbound_call() const {
@@ -167,13 +233,21 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   OutboundTransfer(int32_t call_id,
                    const TransferPayload& payload,
                    size_t n_payload_slices,
-                   TransferCallbacks *callbacks);
+                   TransferCallbacks *callbacks,
+                   const TransferPayloadOwners* owners);
+
+  // Returns the index of the first slice from the current one which may be
+  // sent without a copy, or n_payload_slices_ if there is none.
+  int32_t NextZeroCopySlice() const;
 
   // Slices to send. Uses an array here instead of a vector to avoid an expensive
   // vector construction (improved performance a couple percent).
   TransferPayload payload_slices_;
   size_t n_payload_slices_;
 
+  // The shared memory backing the slices, if any.
+  TransferPayloadOwners payload_owners_;
+
   // The current slice that is being sent.
   int32_t cur_slice_idx_;
   // The number of bytes in the above slice which has already been sent.
@@ -185,6 +259,10 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // In the case of call responses, kInvalidCallId
   int32_t call_id_;
 
+  // Whether this is a bulk transfer, which smaller transfers may overtake
+  // until it starts.
+  bool bulk_;
+
   // True if SendBuffer() has been called at least once. This can be true even if
   // no bytes were sent successfully. This is needed as SSL_write() is stateful.
   // Please see KUDU-2334 for details.
@@ -33,6 +33,7 @@
 
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/security/ca/cert_management.h"
 #include "kudu/security/cert.h"
@@ -41,6 +42,8 @@
 #include "kudu/security/openssl_util.h"
 #include "kudu/security/security_flags.h"
 #include "kudu/security/tls_handshake.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -78,6 +81,39 @@ DEFINE_int32(ipki_server_key_size, 2048,
              "is used for TLS connections to and from clients and other servers.");
 TAG_FLAG(ipki_server_key_size, experimental);
 
+DEFINE_bool(rpc_tls_kernel_offload, false,
+            "Whether to hand the record encryption of TLS-encrypted RPC connections over "
+            "to the kernel (kTLS) once their TLS handshake is done, so that the data is "
+            "encrypted by the kernel, or by the NIC if it supports it, as it is sent "
+            "instead of by the reactor threads. Only takes effect with OpenSSL 3.0 or "
+            "newer built with kTLS support, a kernel with the 'tls' module loaded, and "
+            "on the connections which negotiate TLSv1.3 with a kTLS-compatible cipher; "
+            "the other connections are encrypted by OpenSSL as usual.");
+TAG_FLAG(rpc_tls_kernel_offload, experimental);
+
+DEFINE_bool(rpc_tls_session_resumption, true,
+            "Whether outbound TLS-encrypted RPC connections offer to resume the TLS "
+            "session of the previous connection to the same server, which makes for an "
+            "abbreviated TLS handshake without any public key operations if the server "
+            "accepts.");
+TAG_FLAG(rpc_tls_session_resumption, advanced);
+TAG_FLAG(rpc_tls_session_resumption, runtime);
+
+DEFINE_int32(rpc_tls_session_lifetime_s, 24 * 60 * 60,
+             "The number of seconds for which the TLS sessions negotiated by the RPC "
+             "server may be resumed by new connections.");
+TAG_FLAG(rpc_tls_session_lifetime_s, advanced);
+
+DEFINE_string(rpc_tls_session_ticket_key_file, "",
+              "Path to a file holding the secret keys with which the RPC server protects "
+              "the TLS session tickets it hands to its clients, which they present to "
+              "resume their session. The file must hold at least 80 bytes of random data "
+              "(e.g. generated with 'openssl rand 80'), and only be readable by the server. "
+              "If not set, the keys are generated at startup, so that the sessions can't "
+              "be resumed across restarts of the server.");
+TAG_FLAG(rpc_tls_session_ticket_key_file, experimental);
+TAG_FLAG(rpc_tls_session_ticket_key_file, sensitive);
+
 namespace kudu {
 namespace security {
 
@@ -108,6 +144,25 @@ Status CheckMaxSupportedTlsVersion(int tls_version, const char* tls_version_str)
   return Status::OK();
 }
 
+// The maximum number of sessions cached for resumption by a TlsContext.
+constexpr size_t kMaxCachedSessions = 10000;
+
+// Required by OpenSSL to resume the sessions of servers which verify the
+// certificates of their clients.
+constexpr unsigned char kSessionIdContext[] = "kudu-rpc";
+
+void FreeSessionKey(void* /*parent*/, void* ptr, CRYPTO_EX_DATA* /*ad*/,
+                    int /*idx*/, long /*argl*/, void* /*argp*/) { // NOLINT(*)
+  delete static_cast<string*>(ptr);
+}
+
+// The index of the ex_data of the SSL handles holding the session key of
+// their handshake.
+int SessionKeyIndex() {
+  static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &FreeSessionKey);
+  return index;
+}
+
 } // anonymous namespace
 
 TlsContext::TlsContext()
@@ -165,6 +220,12 @@ Status TlsContext::Init() {
                                    tls_min_protocol_);
   }
 
+#ifdef SSL_OP_ENABLE_KTLS
+  if (FLAGS_rpc_tls_kernel_offload) {
+    options |= SSL_OP_ENABLE_KTLS;
+  }
+#endif
+
   SSL_CTX_set_options(ctx_.get(), options);
 
   OPENSSL_RET_NOT_OK(
@@ -190,11 +251,76 @@ Status TlsContext::Init() {
 #endif
 #endif
 
+  // Clients cache their sessions themselves, keyed by server, and servers
+  // resume sessions from the tickets presented by the clients, so neither
+  // needs OpenSSL's internal session cache. See InitiateHandshake().
+  SSL_CTX_set_app_data(ctx_.get(), this);
+  SSL_CTX_set_session_cache_mode(ctx_.get(),
+                                 SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx_.get(), &TlsContext::NewSessionCallback);
+  SSL_CTX_set_timeout(ctx_.get(), FLAGS_rpc_tls_session_lifetime_s);
+  OPENSSL_RET_NOT_OK(
+      SSL_CTX_set_session_id_context(ctx_.get(), kSessionIdContext,
+                                     sizeof(kSessionIdContext) - 1),
+      "failed to set TLS session id context");
+  RETURN_NOT_OK(LoadSessionTicketKeys());
+
   // TODO(KUDU-1926): is it possible to disable client-side renegotiation? it seems there
   // have been various CVEs related to this feature that we don't need.
   return Status::OK();
 }
 
+Status TlsContext::LoadSessionTicketKeys() {
+  if (FLAGS_rpc_tls_session_ticket_key_file.empty()) {
+    return Status::OK();
+  }
+  faststring keys;
+  RETURN_NOT_OK_PREPEND(ReadFileToString(Env::Default(), FLAGS_rpc_tls_session_ticket_key_file,
+                                         &keys),
+                        "could not read TLS session ticket keys");
+  // Passing no buffer returns the size of the keys.
+  long keys_size = SSL_CTX_get_tlsext_ticket_keys(ctx_.get(), nullptr, 0); // NOLINT(*)
+  if (keys.size() < static_cast<size_t>(keys_size)) {
+    return Status::InvalidArgument(
+        Substitute("TLS session ticket key file $0 holds $1 bytes, but at least $2 are required",
+                   FLAGS_rpc_tls_session_ticket_key_file, keys.size(), keys_size));
+  }
+  OPENSSL_RET_NOT_OK(
+      SSL_CTX_set_tlsext_ticket_keys(ctx_.get(), keys.data(), keys_size),
+      "failed to set TLS session ticket keys");
+  return Status::OK();
+}
+
+Status TlsContext::SetUpSessionResumption(SSL* ssl, const string& session_key) const {
+  {
+    std::lock_guard<simple_spinlock> l(sessions_lock_);
+    const auto* session = FindOrNull(sessions_, session_key);
+    // The handshake takes its own reference to the session.
+    if (session && SSL_set_session(ssl, session->get()) != 1) {
+      return Status::RuntimeError("failed to set TLS session", GetOpenSSLErrors());
+    }
+  }
+  if (SSL_set_ex_data(ssl, SessionKeyIndex(), new string(session_key)) != 1) {
+    return Status::RuntimeError("failed to set TLS session key", GetOpenSSLErrors());
+  }
+  return Status::OK();
+}
+
+int TlsContext::NewSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  const auto* key = static_cast<const string*>(SSL_get_ex_data(ssl, SessionKeyIndex()));
+  if (!key) {
+    // Returning 0 leaves the ownership of the session with OpenSSL.
+    return 0;
+  }
+  auto* self = static_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  std::lock_guard<simple_spinlock> l(self->sessions_lock_);
+  if (self->sessions_.size() >= kMaxCachedSessions && !ContainsKey(self->sessions_, *key)) {
+    self->sessions_.erase(self->sessions_.begin());
+  }
+  self->sessions_[*key] = ssl_make_unique(session);
+  return 1;
+}
+
 Status TlsContext::VerifyCertChainUnlocked(const Cert& cert) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   X509_STORE* store = SSL_CTX_get_cert_store(ctx_.get());
@@ -488,7 +614,8 @@ Status TlsContext::LoadCertificateAuthority(const string& certificate_path) {
 }
 
 Status TlsContext::InitiateHandshake(TlsHandshakeType handshake_type,
-                                     TlsHandshake* handshake) const {
+                                     TlsHandshake* handshake,
+                                     const string& session_key) const {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   CHECK(ctx_);
   CHECK(!handshake->ssl_);
@@ -510,6 +637,9 @@ Status TlsContext::InitiateHandshake(TlsHandshakeType handshake_type,
       break;
     case TlsHandshakeType::CLIENT:
       SSL_set_connect_state(handshake->ssl());
+      if (!session_key.empty() && FLAGS_rpc_tls_session_resumption) {
+        RETURN_NOT_OK(SetUpSessionResumption(handshake->ssl(), session_key));
+      }
       break;
   }
 
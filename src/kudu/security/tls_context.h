@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/optional/optional.hpp>
@@ -161,8 +162,16 @@ class TlsContext {
   Status LoadCertificateAuthority(const std::string& certificate_path) WARN_UNUSED_RESULT;
 
   // Initiates a new TlsHandshake instance.
+  //
+  // If 'session_key' isn't empty, a client handshake offers to resume the
+  // session negotiated by the latest handshake initiated with the same key,
+  // which turns the handshake into an abbreviated one if the server accepts,
+  // and caches the session it negotiates under the key in turn. The key
+  // should identify the server, e.g. by its address. Ignored by server
+  // handshakes, which resume sessions from the tickets the clients present.
   Status InitiateHandshake(TlsHandshakeType handshake_type,
-                           TlsHandshake* handshake) const WARN_UNUSED_RESULT;
+                           TlsHandshake* handshake,
+                           const std::string& session_key = "") const WARN_UNUSED_RESULT;
 
   // Return the number of certs that have been marked as trusted.
   // Used by tests.
@@ -177,6 +186,19 @@ class TlsContext {
 
   Status VerifyCertChainUnlocked(const Cert& cert) WARN_UNUSED_RESULT;
 
+  // Loads the keys protecting the session tickets issued by this context from
+  // --rpc_tls_session_ticket_key_file, if set.
+  Status LoadSessionTicketKeys() WARN_UNUSED_RESULT;
+
+  // Sets up the client handshake of 'ssl' to resume the session cached under
+  // 'session_key', if any, and to cache the session it negotiates.
+  Status SetUpSessionResumption(SSL* ssl, const std::string& session_key) const
+      WARN_UNUSED_RESULT;
+
+  // Called by OpenSSL when a client handshake receives a new session. Adds it
+  // to 'sessions_' under the key of the handshake, if any.
+  static int NewSessionCallback(SSL* ssl, SSL_SESSION* session);
+
   // The cipher suite preferences to use for TLS-secured RPC connections. Uses the OpenSSL
   // cipher preference list format. See man (1) ciphers for more information.
   std::string tls_ciphers_;
@@ -196,6 +218,13 @@ class TlsContext {
   bool has_cert_;
   bool is_external_cert_;
   boost::optional<CertSignRequest> csr_;
+
+  // Protects 'sessions_'.
+  mutable simple_spinlock sessions_lock_;
+
+  // The latest session negotiated by the client handshakes initiated with
+  // each session key.
+  mutable std::unordered_map<std::string, c_unique_ptr<SSL_SESSION>> sessions_;
 };
 
 } // namespace security
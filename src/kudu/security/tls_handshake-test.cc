@@ -89,10 +89,15 @@ class TestTlsHandshakeBase : public KuduTest {
  protected:
   // Run a handshake using 'client_tls_' and 'server_tls_'. The client and server
   // verification modes are set to 'client_verify' and 'server_verify' respectively.
+  // The client handshake is initiated with 'session_key', and if
+  // 'session_reused' isn't null, it's set to whether it resumed a session.
   Status RunHandshake(TlsVerificationMode client_verify,
-                      TlsVerificationMode server_verify) {
+                      TlsVerificationMode server_verify,
+                      const string& session_key = "",
+                      bool* session_reused = nullptr) {
     TlsHandshake client, server;
-    RETURN_NOT_OK(client_tls_.InitiateHandshake(TlsHandshakeType::CLIENT, &client));
+    RETURN_NOT_OK(client_tls_.InitiateHandshake(TlsHandshakeType::CLIENT, &client,
+                                                session_key));
     RETURN_NOT_OK(server_tls_.InitiateHandshake(TlsHandshakeType::SERVER, &server));
 
     client.set_verification_mode(client_verify);
@@ -104,6 +109,7 @@ class TestTlsHandshakeBase : public KuduTest {
     while (!client_done || !server_done) {
       if (!client_done) {
         Status s = client.Continue(to_client, &to_server);
+        to_client.clear();
         VLOG(1) << "client->server: " << to_server.size() << " bytes";
         if (s.ok()) {
           client_done = true;
@@ -113,8 +119,10 @@ class TestTlsHandshakeBase : public KuduTest {
         }
       }
       if (!server_done) {
-        CHECK(!client_done);
+        // The client has the last word in an abbreviated handshake.
+        CHECK(!client_done || !to_server.empty());
         Status s = server.Continue(to_server, &to_client);
+        to_server.clear();
         VLOG(1) << "server->client: " << to_client.size() << " bytes";
         if (s.ok()) {
           server_done = true;
@@ -124,6 +132,13 @@ class TestTlsHandshakeBase : public KuduTest {
         }
       }
     }
+    // In TLSv1.3, the final response of the server holds its session tickets.
+    if (!to_client.empty()) {
+      RETURN_NOT_OK(client.Continue(to_client, &to_server));
+    }
+    if (session_reused) {
+      *session_reused = client.IsSessionReused();
+    }
     return Status::OK();
   }
 
@@ -177,6 +192,29 @@ TEST_P(TestTlsHandshakeConcurrent, TestConcurrentAdoptCert) {
   SleepFor(MonoDelta::FromMilliseconds(10));
 }
 
+// Test that a client handshake resumes the session negotiated by the previous
+// handshake initiated with the same session key.
+TEST_F(TestTlsHandshake, TestSessionResumption) {
+  PrivateKey ca_key;
+  Cert ca_cert;
+  ASSERT_OK(GenerateSelfSignedCAForTests(&ca_key, &ca_cert));
+  ASSERT_OK(ConfigureTlsContext(PkiConfig::SIGNED, ca_cert, ca_key, &client_tls_));
+  ASSERT_OK(ConfigureTlsContext(PkiConfig::SIGNED, ca_cert, ca_key, &server_tls_));
+
+  const auto kVerify = TlsVerificationMode::VERIFY_REMOTE_CERT_AND_HOST;
+  bool reused;
+  ASSERT_OK(RunHandshake(kVerify, kVerify, "server", &reused));
+  ASSERT_FALSE(reused);
+  ASSERT_OK(RunHandshake(kVerify, kVerify, "server", &reused));
+  ASSERT_TRUE(reused);
+
+  // The session isn't offered to other servers, nor without a session key.
+  ASSERT_OK(RunHandshake(kVerify, kVerify, "other-server", &reused));
+  ASSERT_FALSE(reused);
+  ASSERT_OK(RunHandshake(kVerify, kVerify, "", &reused));
+  ASSERT_FALSE(reused);
+}
+
 TEST_F(TestTlsHandshake, TestHandshakeSequence) {
   PrivateKey ca_key;
   Cert ca_cert;
@@ -104,6 +104,21 @@ Status TlsHandshake::Continue(const string& recv, string* send) {
     // the ERR error queue, so no need to ERR_clear_error() here.
   }
 
+  if (rc == 1 && !SSL_is_server(ssl_.get()) && BIO_ctrl_pending(rbio) > 0) {
+    // In TLSv1.3 the server sends its session tickets once the handshake is
+    // done, along with its final response. Have OpenSSL process them now,
+    // before the memory BIOs are replaced by the socket, so that the session
+    // may be resumed by later connections.
+    char c;
+    int peek_rc = SSL_peek(ssl_.get(), &c, 1);
+    if (peek_rc <= 0) {
+      int ssl_err = SSL_get_error(ssl_.get(), peek_rc);
+      if (ssl_err != SSL_ERROR_WANT_READ) {
+        return Status::RuntimeError("TLS Handshake error", GetSSLErrorDescription(ssl_err));
+      }
+    }
+  }
+
   BIO* wbio = SSL_get_wbio(ssl_.get());
   int pending = BIO_ctrl_pending(wbio);
 
@@ -210,6 +225,22 @@ Status TlsHandshake::Finish(unique_ptr<Socket>* socket) {
     return Status::RuntimeError("TLS handshake error", GetOpenSSLErrors());
   }
 
+#ifdef SSL_OP_ENABLE_KTLS
+  // The handshake went through memory BIOs, so OpenSSL couldn't hand the
+  // traffic keys over to the kernel when they were set up. Request a TLSv1.3
+  // key update instead: both ends switch to new keys, which OpenSSL then
+  // installs into the kernel now that the SSL instance writes to the socket.
+  // The update goes out with the next message of the client, which always
+  // speaks next in the negotiation.
+  if ((SSL_get_options(ssl_.get()) & SSL_OP_ENABLE_KTLS) &&
+      SSL_version(ssl_.get()) == TLS1_3_VERSION &&
+      !SSL_is_server(ssl_.get())) {
+    if (SSL_key_update(ssl_.get(), SSL_KEY_UPDATE_REQUESTED) != 1) {
+      return Status::RuntimeError("failed to request a TLS key update", GetOpenSSLErrors());
+    }
+  }
+#endif
+
   // Transfer the SSL instance to the socket.
   socket->reset(new TlsSocket(fd, std::move(ssl_)));
 
@@ -252,6 +283,11 @@ string TlsHandshake::GetProtocol() const {
   return SSL_get_version(ssl_.get());
 }
 
+bool TlsHandshake::IsSessionReused() const {
+  CHECK(has_started_);
+  return SSL_session_reused(ssl_.get()) == 1;
+}
+
 string TlsHandshake::GetCipherDescription() const {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   CHECK(has_started_);
@@ -134,6 +134,11 @@ class TlsHandshake {
   // Only valid to call after the handshake is complete and before 'Finish()'.
   std::string GetCipherDescription() const;
 
+  // Returns true if the handshake resumed a session negotiated by an earlier
+  // handshake instead of negotiating a new one. Only valid to call after the
+  // handshake is complete and before 'Finish()'.
+  bool IsSessionReused() const;
+
  private:
   friend class TlsContext;
 
@@ -33,11 +33,14 @@
 #include <thread>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/security/tls_context.h"
+#include "kudu/security/tls_socket.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
@@ -50,6 +53,8 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(rpc_tls_kernel_offload);
+
 using std::string;
 using std::thread;
 using std::unique_ptr;
@@ -362,5 +367,42 @@ TEST_F(TlsSocketTest, TestNonBlockingWritev) {
   ASSERT_OK(client_sock->Close());
 }
 
+class TlsSocketKernelOffloadTest : public TlsSocketTest {
+ public:
+  void SetUp() override {
+    FLAGS_rpc_tls_kernel_offload = true;
+    TlsSocketTest::SetUp();
+  }
+};
+
+// Test that data goes through intact once the connection is set to be
+// encrypted by the kernel. Whether it actually is depends on the OpenSSL
+// build and on the kernel, so the test also passes when it isn't.
+TEST_F(TlsSocketKernelOffloadTest, TestEcho) {
+  Random rng(GetRandomSeed32());
+
+  EchoServer server;
+  NO_FATALS(server.Start());
+
+  unique_ptr<Socket> client_sock;
+  NO_FATALS(ConnectClient(server.listen_addr(), &client_sock));
+
+  unique_ptr<uint8_t[]> buf(new uint8_t[kEchoChunkSize]);
+  unique_ptr<uint8_t[]> rbuf(new uint8_t[kEchoChunkSize]);
+  for (int i = 0; i < 3; i++) {
+    RandomString(buf.get(), kEchoChunkSize, &rng);
+    size_t n;
+    ASSERT_OK(client_sock->BlockingWrite(buf.get(), kEchoChunkSize, &n,
+        MonoTime::Now() + kTimeout));
+    ASSERT_OK(client_sock->BlockingRecv(rbuf.get(), kEchoChunkSize, &n,
+        MonoTime::Now() + kTimeout));
+    ASSERT_EQ(0, memcmp(buf.get(), rbuf.get(), kEchoChunkSize));
+  }
+  LOG(INFO) << "kernel send offload: "
+            << down_cast<TlsSocket*>(client_sock.get())->IsKernelSendOffloaded();
+  server.Stop();
+  ASSERT_OK(client_sock->Close());
+}
+
 } // namespace security
 } // namespace kudu
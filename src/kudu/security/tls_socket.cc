@@ -24,7 +24,9 @@
 #include <utility>
 
 #include <glog/logging.h>
+#include <openssl/bio.h>
 #include <openssl/err.h>
+#include <openssl/ssl.h>
 
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -80,6 +82,12 @@ Status TlsSocket::Write(const uint8_t *buf, int32_t amt, int32_t *nwritten) {
 Status TlsSocket::Writev(const struct ::iovec *iov, int iov_len, int64_t *nwritten) {
   SCOPED_OPENSSL_NO_PENDING_ERRORS;
   CHECK(ssl_);
+  if (IsKernelSendOffloaded() && !SSL_want_write(ssl_.get())) {
+    // The kernel frames and encrypts the data into records itself, so the
+    // whole vector goes out in a single system call. A write which OpenSSL
+    // has yet to complete must be retried through it, though.
+    return Socket::Writev(iov, iov_len, nwritten);
+  }
   *nwritten = 0;
   // Allows packets to be aggresively be accumulated before sending.
   RETURN_NOT_OK(SetTcpCork(1));
@@ -181,5 +189,17 @@ Status TlsSocket::Close() {
   return ssl_shutdown;
 }
 
+Status TlsSocket::SetZeroCopy(bool /*enabled*/) {
+  return Status::NotSupported("zero-copy sends are not supported on TLS sockets");
+}
+
+bool TlsSocket::IsKernelSendOffloaded() const {
+#ifdef BIO_get_ktls_send
+  return ssl_ && BIO_get_ktls_send(SSL_get_wbio(ssl_.get()));
+#else
+  return false;
+#endif
+}
+
 } // namespace security
 } // namespace kudu
@@ -46,6 +46,14 @@ class TlsSocket : public Socket {
 
   Status Close() override WARN_UNUSED_RESULT;
 
+  // The data must be encrypted before it is sent, so it is never sent from
+  // the memory of the caller as is.
+  Status SetZeroCopy(bool enabled) override WARN_UNUSED_RESULT;
+
+  // Returns true if the kernel encrypts the records sent on the socket (kTLS).
+  // See --rpc_tls_kernel_offload.
+  bool IsKernelSendOffloaded() const;
+
  private:
 
   friend class TlsHandshake;
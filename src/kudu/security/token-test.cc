@@ -624,6 +624,38 @@ TEST_F(TokenTest, TestEndToEnd_Valid) {
   ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(signed_token, &token));
 }
 
+// Test that the TokenVerifier only verifies the signature of a token once,
+// but still checks that tokens found in its cache haven't expired.
+TEST_F(TokenTest, TestVerifiedTokenCache) {
+  TokenSigner signer(kTokenValiditySeconds, kTokenValiditySeconds, 10);
+  {
+    std::unique_ptr<TokenSigningPrivateKey> key;
+    ASSERT_OK(signer.CheckNeedKey(&key));
+    ASSERT_OK(signer.AddKey(std::move(key)));
+  }
+  TokenVerifier verifier;
+  ASSERT_OK(verifier.ImportKeys(signer.verifier().ExportKeys()));
+
+  SignedTokenPB signed_token = MakeUnsignedToken(WallTime_Now() + 2);
+  ASSERT_OK(signer.SignToken(&signed_token));
+  TokenPB token;
+  ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(signed_token, &token));
+  ASSERT_EQ(0, verifier.cache_hits_for_tests());
+  ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(signed_token, &token));
+  ASSERT_EQ(1, verifier.cache_hits_for_tests());
+
+  // The same token data with another signature doesn't hit the cache.
+  SignedTokenPB forged_token = signed_token;
+  forged_token.set_signature("xyz");
+  ASSERT_EQ(VerificationResult::INVALID_SIGNATURE,
+            verifier.VerifyTokenSignature(forged_token, &token));
+  ASSERT_EQ(1, verifier.cache_hits_for_tests());
+
+  SleepFor(MonoDelta::FromSeconds(3));
+  ASSERT_EQ(VerificationResult::EXPIRED_TOKEN,
+            verifier.VerifyTokenSignature(signed_token, &token));
+}
+
 // Test all of the possible cases covered by token verification.
 // See VerificationResult.
 TEST_F(TokenTest, TestEndToEnd_InvalidCases) {
@@ -18,6 +18,7 @@
 #include "kudu/security/token_verifier.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <mutex>
 #include <ostream>
@@ -25,16 +26,28 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/security/token.pb.h"
 #include "kudu/security/token_signing_key.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
+DEFINE_int32(token_verifier_cache_size, 10000,
+             "The maximum number of tokens whose signature a server remembers having "
+             "verified, so that the further RPCs presenting them skip the verification "
+             "of the signature. Set to 0 to verify the signature of every token.");
+TAG_FLAG(token_verifier_cache_size, advanced);
+
 using std::lock_guard;
 using std::string;
 using std::transform;
@@ -44,7 +57,25 @@ using std::vector;
 namespace kudu {
 namespace security {
 
-TokenVerifier::TokenVerifier() {
+namespace {
+
+// Encodes the cache key of 'signed_token', which covers all of its content,
+// so that a token only hits the cache if it's identical to one whose
+// signature was verified.
+void EncodeCacheKey(const SignedTokenPB& signed_token, faststring* key) {
+  PutFixed64(key, signed_token.signing_key_seq_num());
+  PutLengthPrefixedSlice(key, Slice(signed_token.signature()));
+  key->append(signed_token.token_data());
+}
+
+} // anonymous namespace
+
+TokenVerifier::TokenVerifier()
+    : cache_hits_(0) {
+  if (FLAGS_token_verifier_cache_size > 0) {
+    verified_cache_.reset(NewLRUCache(DRAM_CACHE, FLAGS_token_verifier_cache_size,
+                                      "token_verifier_cache"));
+  }
 }
 
 TokenVerifier::~TokenVerifier() {
@@ -129,13 +160,33 @@ VerificationResult TokenVerifier::VerifyTokenSignature(const SignedTokenPB& sign
     }
   }
 
+  faststring cache_key;
+  if (verified_cache_) {
+    EncodeCacheKey(signed_token, &cache_key);
+    Cache::UniqueHandle h(verified_cache_->Lookup(Slice(cache_key), Cache::EXPECT_IN_CACHE),
+                          Cache::HandleDeleter(verified_cache_.get()));
+    if (h) {
+      cache_hits_++;
+      int64_t key_expire_unix_epoch_seconds;
+      Slice value = verified_cache_->Value(h.get());
+      DCHECK_EQ(sizeof(key_expire_unix_epoch_seconds), value.size());
+      memcpy(&key_expire_unix_epoch_seconds, value.data(), value.size());
+      if (key_expire_unix_epoch_seconds < now) {
+        return VerificationResult::EXPIRED_SIGNING_KEY;
+      }
+      return VerificationResult::VALID;
+    }
+  }
+
+  int64_t key_expire_unix_epoch_seconds;
   {
     shared_lock<RWMutex> l(lock_);
     auto* tsk = FindPointeeOrNull(keys_by_seq_, signed_token.signing_key_seq_num());
     if (!tsk) {
       return VerificationResult::UNKNOWN_SIGNING_KEY;
     }
-    if (tsk->pb().expire_unix_epoch_seconds() < now) {
+    key_expire_unix_epoch_seconds = tsk->pb().expire_unix_epoch_seconds();
+    if (key_expire_unix_epoch_seconds < now) {
       return VerificationResult::EXPIRED_SIGNING_KEY;
     }
     if (!tsk->VerifySignature(signed_token)) {
@@ -143,6 +194,13 @@ VerificationResult TokenVerifier::VerifyTokenSignature(const SignedTokenPB& sign
     }
   }
 
+  if (verified_cache_) {
+    Cache::PendingHandle* pending = CHECK_NOTNULL(verified_cache_->Allocate(
+        Slice(cache_key), sizeof(key_expire_unix_epoch_seconds), /*charge=*/1));
+    memcpy(verified_cache_->MutableValue(pending), &key_expire_unix_epoch_seconds,
+           sizeof(key_expire_unix_epoch_seconds));
+    verified_cache_->Release(verified_cache_->Insert(pending, nullptr));
+  }
   return VerificationResult::VALID;
 }
 
@@ -16,6 +16,7 @@
 // under the License.
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <map>
 #include <memory>
@@ -27,6 +28,7 @@
 
 namespace kudu {
 
+class Cache;
 class Status;
 
 namespace security {
@@ -59,6 +61,11 @@ enum class VerificationResult;
 // slow leak is not worrisome. If this class is adopted for any use cases
 // with frequent rotation, GC of expired tokens will need to be added.
 //
+// Since clients keep presenting the same token until it expires, the
+// signatures found valid are cached (see --token_verifier_cache_size), and a
+// token whose signature is in the cache is only checked for expiration
+// instead of being verified again.
+//
 // This class is thread-safe.
 class TokenVerifier {
  public:
@@ -88,6 +95,12 @@ class TokenVerifier {
   VerificationResult VerifyTokenSignature(const SignedTokenPB& signed_token,
                                           TokenPB* token) const;
 
+  // Returns the number of verifications which found the signature of the
+  // token in the cache. Used by tests.
+  int64_t cache_hits_for_tests() const {
+    return cache_hits_;
+  }
+
  private:
   typedef std::map<int64_t, std::unique_ptr<TokenSigningPublicKey>> KeysMap;
 
@@ -95,6 +108,13 @@ class TokenVerifier {
   mutable RWMutex lock_;
   KeysMap keys_by_seq_;
 
+  // The tokens whose signature was found valid, keyed by the whole signed
+  // token, with the expiration time of their signing key as value. Null if
+  // the cache is disabled.
+  std::unique_ptr<Cache> verified_cache_;
+
+  mutable std::atomic<int64_t> cache_hits_;
+
   DISALLOW_COPY_AND_ASSIGN(TokenVerifier);
 };
 
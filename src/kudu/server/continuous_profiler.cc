@@ -0,0 +1,401 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/server/continuous_profiler.h"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/util/debug-util.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/os-util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/spinlock_profiling.h"
+#include "kudu/util/status.h"
+#include "kudu/util/thread.h"
+#include "kudu/util/web_callback_registry.h"
+
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// GLog already implements symbolization. Just import their hidden symbol.
+namespace google {
+// Symbolizes a program counter.  On success, returns true and write the
+// symbol name to "out".  The symbol name is demangled if possible
+// (supports symbols generated by GCC 3.x or newer).  Otherwise,
+// returns false.
+bool Symbolize(void *pc, char *out, int out_size);
+}
+
+DEFINE_int32(continuous_profiling_interval_ms, 100,
+             "The interval at which the server samples the stacks of its threads which "
+             "are using CPU, for the profile served at /pprof/continuous. The actual "
+             "interval is picked at random between half and one and a half times this "
+             "value, to avoid biasing the samples towards periodic work. Each sample "
+             "signals the threads which used CPU since the previous one, so shorter "
+             "intervals cost more. If this is 0 or negative, no samples are taken.");
+TAG_FLAG(continuous_profiling_interval_ms, runtime);
+TAG_FLAG(continuous_profiling_interval_ms, experimental);
+
+DEFINE_int32(continuous_profiling_window_secs, 600,
+             "The number of seconds of samples kept by the continuous profiler.");
+TAG_FLAG(continuous_profiling_window_secs, runtime);
+TAG_FLAG(continuous_profiling_window_secs, experimental);
+
+DEFINE_bool(continuous_profiling_include_contention, true,
+            "Whether the continuous profiler also collects the stacks of threads "
+            "waiting on contended spinlocks. While enabled, the contention samples "
+            "are no longer all available from /pprof/contention.");
+TAG_FLAG(continuous_profiling_include_contention, runtime);
+TAG_FLAG(continuous_profiling_include_contention, experimental);
+
+namespace kudu {
+namespace server {
+
+namespace {
+
+// The interval of time covered by each bucket of samples.
+const int kBucketSecs = 10;
+
+// The thread group of the threads which weren't started as kudu::Threads, and
+// so have no known name.
+const char* const kOtherThreadGroup = "other";
+
+// The thread group of the spinlock contention samples, which aren't
+// attributed to a particular thread.
+const char* const kContentionThreadGroup = "spinlock";
+
+// Returns the thread group of the kudu::Thread named 'name': its name without
+// the thread id suffix, and without the worker suffix for thread pool
+// threads. For example, "wal-append [worker]-1234" belongs to "wal-append".
+string ThreadGroup(const string& name) {
+  string group = name;
+  size_t dash = group.rfind('-');
+  if (dash != string::npos && dash + 1 < group.size() &&
+      std::all_of(group.begin() + dash + 1, group.end(),
+                  [](char c) { return isdigit(c); })) {
+    group.resize(dash);
+  }
+  static const char kWorkerSuffix[] = " [worker]";
+  if (HasSuffixString(group, kWorkerSuffix)) {
+    group.resize(group.size() - strlen(kWorkerSuffix));
+  }
+  return group;
+}
+
+struct StackKey {
+  string group;
+  StackTrace stack;
+};
+
+struct StackKeyHash {
+  size_t operator()(const StackKey& key) const {
+    return key.stack.HashCode() ^ std::hash<string>()(key.group);
+  }
+};
+
+struct StackKeyEqual {
+  bool operator()(const StackKey& lhs, const StackKey& rhs) const {
+    return lhs.group == rhs.group && lhs.stack.Equals(rhs.stack);
+  }
+};
+
+// The total weight of the samples of each stack.
+typedef unordered_map<StackKey, int64_t, StackKeyHash, StackKeyEqual> StackWeights;
+
+} // anonymous namespace
+
+struct ContinuousProfiler::Bucket {
+  explicit Bucket(MonoTime start)
+      : start(start) {
+  }
+
+  // The time of the first sample in this bucket.
+  const MonoTime start;
+
+  StackWeights cpu;
+  StackWeights contention;
+};
+
+ContinuousProfiler::ContinuousProfiler()
+    : wake_(&lock_) {
+}
+
+ContinuousProfiler::~ContinuousProfiler() {
+  Stop();
+}
+
+Status ContinuousProfiler::Start() {
+  return Thread::Create("server", "continuous-profiler",
+                        &ContinuousProfiler::RunThread, this, &thread_);
+}
+
+void ContinuousProfiler::Stop() {
+  if (!thread_) return;
+
+  {
+    MutexLock l(lock_);
+    stop_ = true;
+    wake_.Signal();
+  }
+  thread_->Join();
+  thread_.reset();
+  stop_ = false;
+  if (contention_profiling_started_) {
+    StopSynchronizationProfiling();
+    contention_profiling_started_ = false;
+  }
+}
+
+void ContinuousProfiler::RunThread() {
+  Random rng(GetRandomSeed32());
+  MutexLock l(lock_);
+  while (!stop_) {
+    int32_t interval_ms = FLAGS_continuous_profiling_interval_ms;
+    // Sampling may be disabled, but the flag is runtime-modifiable, so we
+    // still wake up periodically to notice that it might have changed.
+    int64_t wait_ms = interval_ms > 0 ? interval_ms / 2 + rng.Uniform(interval_ms) + 1 : 1000;
+    wake_.WaitFor(MonoDelta::FromMilliseconds(wait_ms));
+    if (stop_ || interval_ms <= 0) {
+      continue;
+    }
+
+    // Unlock the mutex while sampling so as not to block Stop().
+    l.Unlock();
+    SCOPED_CLEANUP({ l.Lock(); });
+
+    // Collecting stacks interrupts the debugger, so don't.
+    if (IsBeingDebugged()) {
+      continue;
+    }
+    WARN_NOT_OK(SampleCpu(), "Unable to sample thread stacks");
+
+    if (FLAGS_continuous_profiling_include_contention != contention_profiling_started_) {
+      if (contention_profiling_started_) {
+        StopSynchronizationProfiling();
+      } else {
+        StartSynchronizationProfiling();
+      }
+      contention_profiling_started_ = !contention_profiling_started_;
+    }
+    if (contention_profiling_started_) {
+      SampleContention();
+    }
+  }
+}
+
+Status ContinuousProfiler::SampleCpu() {
+  vector<pid_t> tids;
+  RETURN_NOT_OK_PREPEND(ListThreads(&tids), "could not list threads");
+
+  // Find the threads which used CPU since the last sample, and how much. The
+  // threads seen for the first time have nothing to compare against, so they
+  // are only sampled from the next time on.
+  const int64_t self_tid = Thread::CurrentThreadId();
+  unordered_map<int64_t, int64_t> cpu_ns;
+  vector<pair<int64_t, int64_t>> used_cpu;
+  for (pid_t tid : tids) {
+    ThreadStats stats;
+    if (tid == self_tid || !GetThreadStats(tid, &stats).ok()) {
+      // The thread may have exited since it was listed.
+      continue;
+    }
+    int64_t ns = stats.user_ns + stats.kernel_ns;
+    const int64_t* last_ns = FindOrNull(last_cpu_ns_, tid);
+    if (last_ns != nullptr && ns > *last_ns) {
+      used_cpu.emplace_back(tid, ns - *last_ns);
+    }
+    cpu_ns[tid] = ns;
+  }
+  // This also forgets about the threads which exited.
+  last_cpu_ns_.swap(cpu_ns);
+  if (used_cpu.empty()) {
+    return Status::OK();
+  }
+
+  vector<StackTraceCollector> collectors(used_cpu.size());
+  vector<StackTrace> stacks(used_cpu.size());
+  vector<Status> statuses(used_cpu.size());
+  for (int i = 0; i < used_cpu.size(); i++) {
+    statuses[i] = collectors[i].TriggerAsync(used_cpu[i].first, &stacks[i]);
+  }
+
+  // Look the thread names up while the stacks are being collected.
+  unordered_map<int64_t, string> names;
+  GetThreadNames(&names);
+
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(100);
+  for (int i = 0; i < used_cpu.size(); i++) {
+    statuses[i] = statuses[i].AndThen([&] {
+        return collectors[i].AwaitCollection(deadline);
+      });
+  }
+
+  MutexLock l(buckets_lock_);
+  Bucket* bucket = CurrentBucket(MonoTime::Now());
+  for (int i = 0; i < used_cpu.size(); i++) {
+    if (!statuses[i].ok()) {
+      continue;
+    }
+    const string* name = FindOrNull(names, used_cpu[i].first);
+    StackKey key { name ? ThreadGroup(*name) : kOtherThreadGroup, stacks[i] };
+    bucket->cpu[key] += used_cpu[i].second / 1000;
+  }
+  return Status::OK();
+}
+
+void ContinuousProfiler::SampleContention() {
+  vector<pair<StackTrace, int64_t>> samples;
+  int64_t dropped = 0;
+  FlushSynchronizationProfile([&](const StackTrace& stack, int64_t /*trip_count*/,
+                                  int64_t cycles) {
+      samples.emplace_back(stack, cycles);
+    }, &dropped);
+  if (samples.empty()) {
+    return;
+  }
+
+  const double cycles_per_micro = base::CyclesPerSecond() / 1000000.0;
+  MutexLock l(buckets_lock_);
+  Bucket* bucket = CurrentBucket(MonoTime::Now());
+  for (const auto& sample : samples) {
+    StackKey key { kContentionThreadGroup, sample.first };
+    bucket->contention[key] += static_cast<int64_t>(sample.second / cycles_per_micro);
+  }
+}
+
+ContinuousProfiler::Bucket* ContinuousProfiler::CurrentBucket(MonoTime now) {
+  buckets_lock_.AssertAcquired();
+  const MonoDelta bucket_duration = MonoDelta::FromSeconds(kBucketSecs);
+  if (buckets_.empty() || now - buckets_.back()->start >= bucket_duration) {
+    buckets_.emplace_back(new Bucket(now));
+  }
+  // Drop the buckets which ended before the window started.
+  const MonoTime window_start =
+      now - MonoDelta::FromSeconds(FLAGS_continuous_profiling_window_secs);
+  while (buckets_.front()->start + bucket_duration < window_start) {
+    buckets_.pop_front();
+  }
+  return buckets_.back().get();
+}
+
+void ContinuousProfiler::WriteFoldedStacks(Kind kind, const string& group_filter,
+                                           MonoDelta window, std::ostream* out) const {
+  StackWeights weights;
+  {
+    MutexLock l(buckets_lock_);
+    const MonoDelta bucket_duration = MonoDelta::FromSeconds(kBucketSecs);
+    const MonoTime window_start = MonoTime::Now() - window;
+    for (const auto& bucket : buckets_) {
+      if (bucket->start + bucket_duration < window_start) {
+        continue;
+      }
+      for (const auto& e : kind == Kind::CPU ? bucket->cpu : bucket->contention) {
+        if (group_filter.empty() || e.first.group.find(group_filter) != string::npos) {
+          weights[e.first] += e.second;
+        }
+      }
+    }
+  }
+
+  // Symbolize outside of the lock, since it's relatively slow. Many stacks
+  // share their outer frames, so cache the symbols.
+  unordered_map<void*, string> symbols;
+  vector<pair<string, int64_t>> lines;
+  lines.reserve(weights.size());
+  for (const auto& e : weights) {
+    string line = e.first.group;
+    const StackTrace& stack = e.first.stack;
+    for (int i = stack.num_frames() - 1; i >= 0; i--) {
+      void* addr = stack.frame(i);
+      auto it = symbols.find(addr);
+      if (it == symbols.end()) {
+        char buf[1024];
+        // Subtract 1 from the address before symbolizing, because the
+        // address on the stack is actually the return address of the function
+        // call rather than the address of the call instruction itself.
+        string symbol = google::Symbolize(static_cast<char*>(addr) - 1, buf, sizeof(buf)) ?
+            buf : StringPrintf("%p", addr);
+        // Semicolons separate the frames of folded stacks.
+        std::replace(symbol.begin(), symbol.end(), ';', ':');
+        it = symbols.emplace(addr, std::move(symbol)).first;
+      }
+      line += ";";
+      line += it->second;
+    }
+    lines.emplace_back(std::move(line), e.second);
+  }
+
+  std::sort(lines.begin(), lines.end());
+  for (const auto& line : lines) {
+    *out << line.first << " " << line.second << "\n";
+  }
+}
+
+void ContinuousProfiler::RegisterPathHandler(WebCallbackRegistry* web) {
+  auto handler = [this](const WebCallbackRegistry::WebRequest& req,
+                        WebCallbackRegistry::PrerenderedWebResponse* resp) {
+    Kind kind;
+    string kind_arg = FindWithDefault(req.parsed_args, "kind", "cpu");
+    if (kind_arg == "cpu") {
+      kind = Kind::CPU;
+    } else if (kind_arg == "contention") {
+      kind = Kind::CONTENTION;
+    } else {
+      resp->status_code = HttpStatusCode::BadRequest;
+      *resp->output << "Unknown profile kind: " << kind_arg;
+      return;
+    }
+
+    int32_t seconds = FLAGS_continuous_profiling_window_secs;
+    const string* seconds_arg = FindOrNull(req.parsed_args, "seconds");
+    if (seconds_arg != nullptr && (!safe_strto32(*seconds_arg, &seconds) || seconds <= 0)) {
+      resp->status_code = HttpStatusCode::BadRequest;
+      *resp->output << "Invalid number of seconds: " << *seconds_arg;
+      return;
+    }
+
+    WriteFoldedStacks(kind, FindWithDefault(req.parsed_args, "group", ""),
+                      MonoDelta::FromSeconds(seconds), resp->output);
+  };
+  web->RegisterPrerenderedPathHandler("/pprof/continuous", "", handler,
+                                      false /* is_styled */, false /* is_on_nav_bar */);
+}
+
+} // namespace server
+} // namespace kudu
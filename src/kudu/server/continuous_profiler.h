@@ -0,0 +1,129 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+
+namespace kudu {
+
+class Status;
+class Thread;
+class WebCallbackRegistry;
+
+namespace server {
+
+// Always-on, low-overhead profiler of the server's threads.
+//
+// A background thread periodically samples the stacks of the threads which
+// used CPU since the previous sample, weighting each sample by the CPU time
+// the thread used, and drains the spinlock contention profile. The samples
+// are aggregated by thread group (the name of the thread or thread pool,
+// e.g. "wal-append") and stack, and kept for a rolling window of time, so
+// that a transient latency incident can still be looked at after the fact.
+//
+// The aggregated stacks are served as flame graph input at
+// /pprof/continuous. See RegisterPathHandler() for details.
+class ContinuousProfiler {
+ public:
+  // The kinds of samples collected by the profiler.
+  enum class Kind {
+    // Stacks of threads using CPU, weighted by the CPU microseconds used.
+    CPU,
+    // Stacks waiting on contended spinlocks, weighted by the microseconds
+    // waited.
+    CONTENTION
+  };
+
+  ContinuousProfiler();
+  ~ContinuousProfiler();
+
+  Status Start();
+  void Stop();
+
+  // Registers /pprof/continuous with 'web'. The page takes the following
+  // arguments:
+  //   kind:    "cpu" (the default) or "contention".
+  //   group:   only include thread groups whose names contain this string.
+  //   seconds: only include the samples from this many of the last seconds.
+  //            Defaults to the whole window.
+  //
+  // The response lists one stack per line in the "folded" format accepted by
+  // flamegraph.pl and most flame graph viewers:
+  //   <thread group>;<outermost frame>;...;<innermost frame> <weight>
+  void RegisterPathHandler(WebCallbackRegistry* web);
+
+  // Writes the aggregated stacks of the given 'kind' from the last 'window'
+  // to 'out', in the format described above. If 'group_filter' isn't empty,
+  // only the thread groups whose names contain it are included.
+  void WriteFoldedStacks(Kind kind, const std::string& group_filter,
+                         MonoDelta window, std::ostream* out) const;
+
+ private:
+  struct Bucket;
+
+  void RunThread();
+
+  // Samples the stacks of the threads which used CPU since the last call.
+  Status SampleCpu();
+
+  // Drains the spinlock contention profile.
+  void SampleContention();
+
+  // Returns the bucket to add the samples taken at 'now' to, starting a new
+  // one and dropping those which fell out of the window if needed.
+  //
+  // REQUIRES: 'buckets_lock_' is held.
+  Bucket* CurrentBucket(MonoTime now);
+
+  scoped_refptr<Thread> thread_;
+
+  Mutex lock_;
+  ConditionVariable wake_;
+  bool stop_ = false;
+
+  // The CPU time used by each thread as of the last sample, keyed by thread id.
+  // Only accessed by the profiler thread.
+  std::unordered_map<int64_t, int64_t> last_cpu_ns_;
+
+  // Whether this profiler enabled the spinlock contention profile, so that it
+  // knows to disable it again when stopped.
+  bool contention_profiling_started_ = false;
+
+  // Protects 'buckets_'.
+  mutable Mutex buckets_lock_;
+
+  // The aggregated samples, oldest first. Each bucket covers a fixed interval
+  // of time, so that the samples which fall out of the window may be dropped
+  // a bucket at a time.
+  std::deque<std::unique_ptr<Bucket>> buckets_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContinuousProfiler);
+};
+
+} // namespace server
+} // namespace kudu
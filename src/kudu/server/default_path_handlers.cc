@@ -19,12 +19,15 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <ctime>
 #include <fstream>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/algorithm/string/predicate.hpp>
@@ -46,6 +49,7 @@
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/server/pprof_path_handlers.h"
 #include "kudu/server/webserver.h"
 #include "kudu/util/array_view.h"
@@ -54,6 +58,7 @@
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/flags.h"
 #include "kudu/util/jsonwriter.h"
+#include "kudu/util/kernel_stack_watchdog.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -186,6 +191,53 @@ static void StacksHandler(const Webserver::WebRequest& /*req*/,
     });
 }
 
+// Registered to handle "/stalls".
+//
+// Lists the stalls most recently observed by the kernel stack watchdog, newest
+// first, and the number of stalls of each watched section since the server
+// started, most frequent first. With the 'raw' argument, the page is the JSON
+// of all this, for scripts which collect the stalls.
+static void StallsHandler(const Webserver::WebRequest& req,
+                          Webserver::WebResponse* resp) {
+  EasyJson* output = resp->output;
+  KernelStackWatchdog* watchdog = KernelStackWatchdog::GetInstance();
+  (*output)["num_stalls"] = watchdog->num_stalls();
+
+  vector<std::pair<string, int64_t>> counts;
+  for (const auto& entry : watchdog->StallCountsByLabel()) {
+    counts.emplace_back(entry.first, entry.second);
+  }
+  std::sort(counts.begin(), counts.end(),
+            [](const std::pair<string, int64_t>& a, const std::pair<string, int64_t>& b) {
+              return a.second > b.second;
+            });
+  EasyJson counts_json = output->Set("counts", EasyJson::kArray);
+  for (const auto& count : counts) {
+    EasyJson count_json = counts_json.PushBack(EasyJson::kObject);
+    count_json["label"] = count.first;
+    count_json["count"] = count.second;
+  }
+
+  vector<KernelStackWatchdog::Stall> stalls = watchdog->RecentStalls();
+  EasyJson stalls_json = output->Set("stalls", EasyJson::kArray);
+  for (auto it = stalls.rbegin(); it != stalls.rend(); ++it) {
+    EasyJson stall_json = stalls_json.PushBack(EasyJson::kObject);
+    string start_time;
+    StringAppendStrftime(&start_time, "%Y-%m-%d %H:%M:%S",
+                         static_cast<time_t>(it->start_unix_micros / 1000000), true);
+    stall_json["start_time"] = start_time;
+    stall_json["label"] = it->label;
+    stall_json["tid"] = it->tid;
+    stall_json["duration_ms"] = it->duration_ms;
+    stall_json["kernel_stack"] = it->kernel_stack;
+    stall_json["user_stack"] = it->user_stack;
+  }
+
+  if (ContainsKey(req.parsed_args, "raw")) {
+    (*output)["raw"] = output->ToString();
+  }
+}
+
 // Registered to handle "/memz", and prints out memory allocation statistics.
 static void MemUsageHandler(const Webserver::WebRequest& req,
                             Webserver::PrerenderedWebResponse* resp) {
@@ -319,15 +371,16 @@ void AddDefaultPathHandlers(Webserver* webserver) {
   webserver->RegisterPrerenderedPathHandler("/stacks", "Stacks", StacksHandler,
                                             /*is_styled=*/false,
                                             /*is_on_nav_bar=*/false);
+  webserver->RegisterPathHandler("/stalls", "Stalls", StallsHandler,
+                                 styled, /*is_on_nav_bar=*/false);
 
   AddPprofPathHandlers(webserver);
 }
 
 
-static void WriteMetricsAsJson(const MetricRegistry* const metrics,
-                               const Webserver::WebRequest& req,
-                               Webserver::PrerenderedWebResponse* resp) {
-  ostringstream* output = resp->output;
+static void WriteMetrics(const MetricRegistry* const metrics,
+                         const Webserver::WebRequest& req,
+                         Webserver::StreamingWebResponse* resp) {
   const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
   vector<string> requested_metrics;
   MetricJsonOptions opts;
@@ -340,14 +393,22 @@ static void WriteMetricsAsJson(const MetricRegistry* const metrics,
     string arg = FindWithDefault(req.parsed_args, "include_schema", "false");
     opts.include_schema_info = ParseLeadingBoolValue(arg.c_str(), false);
   }
-  JsonWriter::Mode json_mode;
   {
-    string arg = FindWithDefault(req.parsed_args, "compact", "false");
-    json_mode = ParseLeadingBoolValue(arg.c_str(), false) ?
-      JsonWriter::COMPACT : JsonWriter::PRETTY;
+    string arg = FindWithDefault(req.parsed_args, "include_entity_attributes", "true");
+    opts.include_entity_attributes = ParseLeadingBoolValue(arg.c_str(), true);
+  }
+  {
+    const string* arg = FindOrNull(req.parsed_args, "entity_types");
+    if (arg != nullptr) {
+      SplitStringUsing(*arg, ",", &opts.entity_types);
+    }
+  }
+  {
+    const string* arg = FindOrNull(req.parsed_args, "entity_ids");
+    if (arg != nullptr) {
+      SplitStringUsing(*arg, ",", &opts.entity_ids);
+    }
   }
-
-  JsonWriter writer(output, json_mode);
 
   if (requested_metrics_param != nullptr) {
     SplitStringUsing(*requested_metrics_param, ",", &requested_metrics);
@@ -356,23 +417,39 @@ static void WriteMetricsAsJson(const MetricRegistry* const metrics,
     requested_metrics.emplace_back("*");
   }
 
+  string format = FindWithDefault(req.parsed_args, "format", "json");
+  if (format == "prometheus") {
+    WARN_NOT_OK(metrics->WriteAsPrometheus(resp->output, requested_metrics, opts),
+                "Couldn't write Prometheus metrics over HTTP");
+    return;
+  }
+  if (format != "json") {
+    resp->status_code = HttpStatusCode::BadRequest;
+    *resp->output << Substitute("Unknown metrics format: $0", format);
+    return;
+  }
+
+  JsonWriter::Mode json_mode;
+  {
+    string arg = FindWithDefault(req.parsed_args, "compact", "false");
+    json_mode = ParseLeadingBoolValue(arg.c_str(), false) ?
+      JsonWriter::COMPACT : JsonWriter::PRETTY;
+  }
+
+  JsonWriter writer(resp->output, json_mode);
   WARN_NOT_OK(metrics->WriteAsJson(&writer, requested_metrics, opts),
               "Couldn't write JSON metrics over HTTP");
 }
 
 void RegisterMetricsJsonHandler(Webserver* webserver, const MetricRegistry* const metrics) {
-  Webserver::PrerenderedPathHandlerCallback callback = boost::bind(WriteMetricsAsJson, metrics,
-                                                                   _1, _2);
-  bool not_styled = false;
+  Webserver::StreamingPathHandlerCallback callback = boost::bind(WriteMetrics, metrics, _1, _2);
   bool not_on_nav_bar = false;
   bool is_on_nav_bar = true;
-  webserver->RegisterPrerenderedPathHandler("/metrics", "Metrics", callback,
-                                            not_styled, is_on_nav_bar);
+  webserver->RegisterStreamingPathHandler("/metrics", "Metrics", callback, is_on_nav_bar);
 
   // The old name -- this is preserved for compatibility with older releases of
   // monitoring software which expects the old name.
-  webserver->RegisterPrerenderedPathHandler("/jsonmetricz", "Metrics", callback,
-                                            not_styled, not_on_nav_bar);
+  webserver->RegisterStreamingPathHandler("/jsonmetricz", "Metrics", callback, not_on_nav_bar);
 }
 
 } // namespace kudu
@@ -19,7 +19,9 @@
 #include <cstddef>
 #include <glog/logging.h>
 
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/port.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 
 METRIC_DEFINE_counter(server, glog_info_messages,
@@ -34,6 +36,12 @@ METRIC_DEFINE_counter(server, glog_error_messages,
                       "ERROR-level Log Messages", kudu::MetricUnit::kMessages,
                       "Number of ERROR-level log messages emitted by the application.");
 
+METRIC_DEFINE_gauge_uint64(server, glog_async_dropped_messages,
+                           "Dropped Log Messages", kudu::MetricUnit::kMessages,
+                           "Number of log messages dropped because the asynchronous "
+                           "logging buffers were full. See --log_async_drop_when_full.",
+                           kudu::EXPOSE_AS_COUNTER);
+
 struct tm;
 
 namespace kudu {
@@ -78,6 +86,9 @@ class MetricsSink : public google::LogSink {
 ScopedGLogMetrics::ScopedGLogMetrics(const scoped_refptr<MetricEntity>& entity)
   : sink_(new MetricsSink(entity)) {
   google::AddLogSink(sink_.get());
+  entity->NeverRetire(
+      METRIC_glog_async_dropped_messages.InstantiateFunctionGauge(
+          entity, Bind(&GetAsyncLoggingDroppedMessages)));
 }
 
 ScopedGLogMetrics::~ScopedGLogMetrics() {
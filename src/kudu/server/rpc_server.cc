@@ -147,14 +147,15 @@ Status RpcServer::Init(const shared_ptr<Messenger>& messenger) {
   return Status::OK();
 }
 
-Status RpcServer::RegisterService(gscoped_ptr<rpc::ServiceIf> service) {
+Status RpcServer::RegisterService(gscoped_ptr<rpc::ServiceIf> service, int num_threads) {
   CHECK(server_state_ == INITIALIZED ||
         server_state_ == BOUND) << "bad state: " << server_state_;
   string service_name = service->service_name();
   scoped_refptr<rpc::ServicePool> service_pool =
     new rpc::ServicePool(std::move(service), messenger_->metric_entity(),
                          options_.service_queue_length);
-  RETURN_NOT_OK(service_pool->Init(options_.num_service_threads));
+  service_pool->set_thread_cpus(messenger_->service_thread_cpus());
+  RETURN_NOT_OK(service_pool->Init(num_threads > 0 ? num_threads : options_.num_service_threads));
   auto* service_pool_raw_ptr = service_pool.get();
   service_pool->set_too_busy_hook([this, service_pool_raw_ptr]() {
       if (too_busy_hook_) {
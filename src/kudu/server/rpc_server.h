@@ -72,8 +72,10 @@ class RpcServer {
 
   Status Init(const std::shared_ptr<rpc::Messenger>& messenger) WARN_UNUSED_RESULT;
   // Services need to be registered after Init'ing, but before Start'ing.
-  // The service's ownership will be given to a ServicePool.
-  Status RegisterService(gscoped_ptr<rpc::ServiceIf> service) WARN_UNUSED_RESULT;
+  // The service's ownership will be given to a ServicePool, with
+  // 'num_threads' threads or, if 0, --rpc_num_service_threads.
+  Status RegisterService(gscoped_ptr<rpc::ServiceIf> service,
+                         int num_threads = 0) WARN_UNUSED_RESULT;
   Status Bind() WARN_UNUSED_RESULT;
   Status Start() WARN_UNUSED_RESULT;
   void Shutdown();
@@ -52,6 +52,7 @@
 #include "kudu/security/init.h"
 #include "kudu/security/security_flags.h"
 #include "kudu/server/default_path_handlers.h"
+#include "kudu/server/continuous_profiler.h"
 #include "kudu/server/diagnostics_log.h"
 #include "kudu/server/generic_service.h"
 #include "kudu/server/glog_metrics.h"
@@ -68,6 +69,7 @@
 #include "kudu/util/flag_validators.h"
 #include "kudu/util/flags.h"
 #include "kudu/util/jsonwriter.h"
+#include "kudu/util/kernel_stack_watchdog.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -75,6 +77,7 @@
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/spinlock_profiling.h"
@@ -85,6 +88,29 @@
 DEFINE_int32(num_reactor_threads, 4, "Number of libev reactor threads to start.");
 TAG_FLAG(num_reactor_threads, advanced);
 
+DEFINE_string(rpc_reactor_cpus, "",
+              "The CPUs to pin the reactor threads to, in the kernel's cpulist format, "
+              "e.g. '0-3,32-35'. Reactor i is pinned to the i-th CPU of the list, "
+              "wrapping around. If empty, the reactors are not pinned.");
+TAG_FLAG(rpc_reactor_cpus, experimental);
+
+DEFINE_bool(rpc_reactor_pin_to_numa_node, false,
+            "Whether to let each reactor run on any CPU of the NUMA node of its CPU "
+            "in --rpc_reactor_cpus, rather than on that CPU only.");
+TAG_FLAG(rpc_reactor_pin_to_numa_node, experimental);
+
+DEFINE_bool(rpc_steer_connections_by_incoming_cpu, false,
+            "Whether to assign each accepted connection to the reactor pinned to the "
+            "CPU which received its packets (SO_INCOMING_CPU), so that the network "
+            "processing and the reactor share the CPU's caches. Has no effect unless "
+            "--rpc_reactor_cpus is set.");
+TAG_FLAG(rpc_steer_connections_by_incoming_cpu, experimental);
+
+DEFINE_bool(rpc_service_threads_on_reactor_nodes, false,
+            "Whether to restrict the RPC service threads to the NUMA nodes of the "
+            "CPUs in --rpc_reactor_cpus.");
+TAG_FLAG(rpc_service_threads_on_reactor_nodes, experimental);
+
 DEFINE_int32(min_negotiation_threads, 0, "Minimum number of connection negotiation threads.");
 TAG_FLAG(min_negotiation_threads, advanced);
 
@@ -416,6 +442,7 @@ Status ServerBase::Init() {
   glog_metrics_.reset(new ScopedGLogMetrics(metric_entity_));
   tcmalloc::RegisterMetrics(metric_entity_);
   RegisterSpinLockContentionMetrics(metric_entity_);
+  RegisterKernelStackWatchdogMetrics(metric_entity_);
 
   InitSpinLockContentionProfiling();
 
@@ -470,6 +497,18 @@ Status ServerBase::Init() {
   if (options_.rpc_opts.rpc_reuseport) {
     builder.set_reuseport();
   }
+  if (!FLAGS_rpc_reactor_cpus.empty()) {
+    vector<int> reactor_cpus;
+    RETURN_NOT_OK_PREPEND(ParseCpuList(FLAGS_rpc_reactor_cpus, &reactor_cpus),
+                          "invalid --rpc_reactor_cpus");
+    builder.set_reactor_cpus(std::move(reactor_cpus), FLAGS_rpc_reactor_pin_to_numa_node);
+  }
+  if (FLAGS_rpc_steer_connections_by_incoming_cpu) {
+    builder.enable_inbound_connection_steering();
+  }
+  if (FLAGS_rpc_service_threads_on_reactor_nodes) {
+    builder.enable_service_thread_colocation();
+  }
 
   RETURN_NOT_OK(builder.Build(&messenger_));
   rpc_server_->set_too_busy_hook(std::bind(
@@ -608,8 +647,8 @@ Status ServerBase::DumpServerInfo(const string& path,
   return Status::OK();
 }
 
-Status ServerBase::RegisterService(gscoped_ptr<rpc::ServiceIf> rpc_impl) {
-  return rpc_server_->RegisterService(std::move(rpc_impl));
+Status ServerBase::RegisterService(gscoped_ptr<rpc::ServiceIf> rpc_impl, int num_threads) {
+  return rpc_server_->RegisterService(std::move(rpc_impl), num_threads);
 }
 
 Status ServerBase::StartMetricsLogging() {
@@ -665,8 +704,13 @@ Status ServerBase::Start() {
                                   new GenericServiceImpl(this))));
   RETURN_NOT_OK(rpc_server_->Start());
 
+  unique_ptr<ContinuousProfiler> profiler(new ContinuousProfiler());
+  RETURN_NOT_OK_PREPEND(profiler->Start(), "Failed to start continuous profiler");
+  profiler_ = std::move(profiler);
+
   if (web_server_) {
     AddDefaultPathHandlers(web_server_.get());
+    profiler_->RegisterPathHandler(web_server_.get());
     AddRpczPathHandlers(messenger_, web_server_.get());
     RegisterMetricsJsonHandler(web_server_.get(), metric_registry_.get());
     TracingPathHandlers::RegisterHandlers(web_server_.get());
@@ -701,6 +745,9 @@ void ServerBase::Shutdown() {
   if (diag_log_) {
     diag_log_->Stop();
   }
+  if (profiler_) {
+    profiler_->Stop();
+  }
   if (excess_log_deleter_thread_) {
     excess_log_deleter_thread_->Join();
   }
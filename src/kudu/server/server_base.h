@@ -61,6 +61,7 @@ class TokenVerifier;
 } // namespace security
 
 namespace server {
+class ContinuousProfiler;
 class DiagnosticsLog;
 class ServerStatusPB;
 
@@ -134,8 +135,9 @@ class ServerBase {
   virtual void Shutdown();
 
   // Registers a new RPC service. Once Start() is called, the server will
-  // process and dispatch incoming RPCs belonging to this service.
-  Status RegisterService(gscoped_ptr<rpc::ServiceIf> rpc_impl);
+  // process and dispatch incoming RPCs belonging to this service on
+  // 'num_threads' threads or, if 0, on --rpc_num_service_threads.
+  Status RegisterService(gscoped_ptr<rpc::ServiceIf> rpc_impl, int num_threads = 0);
 
   // Unregisters all RPC services. After this function returns, any subsequent
   // incoming RPCs will be rejected.
@@ -206,6 +208,7 @@ class ServerBase {
   ServerBaseOptions options_;
 
   std::unique_ptr<DiagnosticsLog> diag_log_;
+  std::unique_ptr<ContinuousProfiler> profiler_;
   scoped_refptr<Thread> excess_log_deleter_thread_;
   CountDownLatch stop_background_threads_latch_;
 
@@ -27,6 +27,7 @@
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <streambuf>
 #include <string>
 #include <unordered_set>
 #include <utility>
@@ -42,6 +43,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/stringpiece.h"
@@ -108,6 +110,107 @@ namespace {
     LOG(FATAL) << "Unexpected HTTP response code";
   }
 
+  // Returns the status line and headers of a response with status 'code',
+  // made of 'fixed_headers' followed by the headers which the handler 'alias'
+  // added to the response, 'response_headers'. These may not override any of
+  // the headers in 'reserved_headers'.
+  string ResponseHeaders(
+      kudu::HttpStatusCode code,
+      const vector<std::pair<string, string>>& fixed_headers,
+      const kudu::WebCallbackRegistry::HttpResponseHeaders& response_headers,
+      const std::unordered_set<string>& reserved_headers,
+      const string& alias) {
+    ostringstream headers_stream;
+    headers_stream << Substitute("HTTP/1.1 $0\r\n", HttpStatusCodeToString(code));
+    for (const auto& entry : fixed_headers) {
+      headers_stream << Substitute("$0: $1\r\n", entry.first, entry.second);
+    }
+    for (const auto& entry : response_headers) {
+      // It's forbidden to override the above headers.
+      if (ContainsKey(reserved_headers, entry.first)) {
+        LOG(FATAL) << "Reserved header " << entry.first << " was overridden "
+            "by handler for " << alias;
+      }
+      headers_stream << Substitute("$0: $1\r\n", entry.first, entry.second);
+    }
+    headers_stream << "\r\n";
+    return headers_stream.str();
+  }
+
+  // A stream buffer which sends the data written to it over 'connection' as
+  // the chunks of an HTTP response with chunked transfer encoding. The status
+  // line and headers are produced by 'headers_fn' when the first chunk is
+  // sent, so that the handler may set them until then.
+  class ChunkedResponseBuf : public std::streambuf {
+   public:
+    ChunkedResponseBuf(struct sq_connection* connection,
+                       std::function<string()> headers_fn)
+        : connection_(connection),
+          headers_fn_(std::move(headers_fn)),
+          headers_sent_(false),
+          failed_(false),
+          buf_(kChunkSize) {
+      setp(buf_.data(), buf_.data() + buf_.size());
+    }
+
+    // Sends the remaining data followed by the last, empty, chunk.
+    void Finish() {
+      sync();
+      static const char kLastChunk[] = "0\r\n\r\n";
+      Write(kLastChunk, sizeof(kLastChunk) - 1);
+    }
+
+   protected:
+    int_type overflow(int_type ch) override {
+      if (sync() != 0) {
+        return traits_type::eof();
+      }
+      if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+      }
+      return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+      if (!headers_sent_) {
+        string headers = headers_fn_();
+        Write(headers.data(), headers.size());
+        headers_sent_ = true;
+      }
+      size_t len = pptr() - pbase();
+      if (len > 0) {
+        string chunk_header = StringPrintf("%zx\r\n", len);
+        Write(chunk_header.data(), chunk_header.size());
+        Write(pbase(), len);
+        Write("\r\n", 2);
+        setp(buf_.data(), buf_.data() + buf_.size());
+      }
+      return failed_ ? -1 : 0;
+    }
+
+   private:
+    // Writes data to the connection, unless a previous write failed, e.g.
+    // because the client went away.
+    void Write(const char* data, size_t len) {
+      if (failed_) {
+        return;
+      }
+      // Make sure to use sq_write; sq_printf truncates at 8KB.
+      if (sq_write(connection_, data, len) != static_cast<int>(len)) {
+        failed_ = true;
+      }
+    }
+
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    struct sq_connection* const connection_;
+    const std::function<string()> headers_fn_;
+    bool headers_sent_;
+    bool failed_;
+    vector<char> buf_;
+  };
+
 }  // anonymous namespace
 
 namespace kudu {
@@ -455,6 +558,11 @@ int Webserver::RunPathHandler(const PathHandler& handler,
     }
   }
 
+  if (handler.is_streaming()) {
+    RunStreamingPathHandler(handler, req, connection, request_info);
+    return 1;
+  }
+
   if (!handler.is_styled() || ContainsKey(req.parsed_args, "raw")) {
     use_style = false;
   }
@@ -498,23 +606,15 @@ int Webserver::RunPathHandler(const PathHandler& handler,
     }
   }
 
-  ostringstream headers_stream;
-  headers_stream << Substitute("HTTP/1.1 $0\r\n", HttpStatusCodeToString(resp.status_code));
-  headers_stream << Substitute("Content-Type: $0\r\n", use_style ? "text/html" : "text/plain");
-  headers_stream << Substitute("Content-Length: $0\r\n", full_content.length());
-  if (is_compressed) headers_stream << "Content-Encoding: gzip\r\n";
-  headers_stream << Substitute("X-Frame-Options: $0\r\n", FLAGS_webserver_x_frame_options);
-  std::unordered_set<string> invalid_headers{"Content-Type", "Content-Length", "X-Frame-Options"};
-  for (const auto& entry : resp.response_headers) {
-    // It's forbidden to override the above headers.
-    if (ContainsKey(invalid_headers, entry.first)) {
-      LOG(FATAL) << "Reserved header " << entry.first << " was overridden "
-          "by handler for " << handler.alias();
-    }
-    headers_stream << Substitute("$0: $1\r\n", entry.first, entry.second);
-  }
-  headers_stream << "\r\n";
-  string headers = headers_stream.str();
+  vector<std::pair<string, string>> fixed_headers {
+    { "Content-Type", use_style ? "text/html" : "text/plain" },
+    { "Content-Length", std::to_string(full_content.length()) },
+  };
+  if (is_compressed) fixed_headers.emplace_back("Content-Encoding", "gzip");
+  fixed_headers.emplace_back("X-Frame-Options", FLAGS_webserver_x_frame_options);
+  string headers = ResponseHeaders(resp.status_code, fixed_headers, resp.response_headers,
+                                   {"Content-Type", "Content-Length", "X-Frame-Options"},
+                                   handler.alias());
 
   // Make sure to use sq_write for printing the body; sq_printf truncates at 8KB.
   sq_write(connection, headers.c_str(), headers.length());
@@ -522,6 +622,64 @@ int Webserver::RunPathHandler(const PathHandler& handler,
   return 1;
 }
 
+void Webserver::RunStreamingPathHandler(const PathHandler& handler,
+                                        const WebRequest& req,
+                                        struct sq_connection* connection,
+                                        struct sq_request_info* request_info) {
+  // Chunked transfer encoding requires HTTP/1.1, so buffer the response in
+  // full for older clients.
+  if (request_info->http_version == nullptr ||
+      strcmp(request_info->http_version, "1.1") != 0) {
+    ostringstream content;
+    StreamingWebResponse resp { HttpStatusCode::Ok, HttpResponseHeaders{}, &content };
+    if (kudu::g_should_redact == kudu::RedactContext::ALL) {
+      handler.streaming_callback()(req, &resp);
+    } else {
+      ScopedDisableRedaction s;
+      handler.streaming_callback()(req, &resp);
+    }
+    string full_content = content.str();
+    string headers = ResponseHeaders(
+        resp.status_code,
+        {
+          { "Content-Type", "text/plain" },
+          { "Content-Length", std::to_string(full_content.length()) },
+          { "X-Frame-Options", FLAGS_webserver_x_frame_options },
+        },
+        resp.response_headers,
+        {"Content-Type", "Content-Length", "X-Frame-Options"},
+        handler.alias());
+    sq_write(connection, headers.c_str(), headers.length());
+    sq_write(connection, full_content.c_str(), full_content.length());
+    return;
+  }
+
+  // The response isn't compressed: gzip would need the whole body to be
+  // buffered, which is what streaming avoids.
+  StreamingWebResponse resp { HttpStatusCode::Ok, HttpResponseHeaders{}, nullptr };
+  ChunkedResponseBuf buf(connection, [&]() {
+      return ResponseHeaders(
+          resp.status_code,
+          {
+            { "Content-Type", "text/plain" },
+            { "Transfer-Encoding", "chunked" },
+            { "X-Frame-Options", FLAGS_webserver_x_frame_options },
+          },
+          resp.response_headers,
+          {"Content-Type", "Content-Length", "Transfer-Encoding", "X-Frame-Options"},
+          handler.alias());
+    });
+  std::ostream output(&buf);
+  resp.output = &output;
+  if (kudu::g_should_redact == kudu::RedactContext::ALL) {
+    handler.streaming_callback()(req, &resp);
+  } else {
+    ScopedDisableRedaction s;
+    handler.streaming_callback()(req, &resp);
+  }
+  buf.Finish();
+}
+
 void Webserver::RegisterPathHandler(const string& path, const string& alias,
     const PathHandlerCallback& callback, bool is_styled, bool is_on_nav_bar) {
   string render_path = (path == "/") ? "/home" : path;
@@ -544,6 +702,12 @@ void Webserver::RegisterPrerenderedPathHandler(const string& path, const string&
   InsertOrDie(&path_handlers_, path, new PathHandler(is_styled, is_on_nav_bar, alias, callback));
 }
 
+void Webserver::RegisterStreamingPathHandler(const string& path, const string& alias,
+    const StreamingPathHandlerCallback& callback, bool is_on_nav_bar) {
+  std::lock_guard<RWMutex> l(lock_);
+  InsertOrDie(&path_handlers_, path, new PathHandler(is_on_nav_bar, alias, callback));
+}
+
 string Webserver::MustachePartialTag(const string& path) const {
   return Substitute("{{> $0.mustache}}", path);
 }
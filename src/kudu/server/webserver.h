@@ -78,6 +78,12 @@ class Webserver : public WebCallbackRegistry {
                                       bool is_styled,
                                       bool is_on_nav_bar) override;
 
+  // Register a route 'path' whose response is streamed to the client using
+  // chunked transfer encoding. See the RegisterPathHandler for details.
+  void RegisterStreamingPathHandler(const std::string& path, const std::string& alias,
+                                    const StreamingPathHandlerCallback& callback,
+                                    bool is_on_nav_bar) override;
+
   // Change the footer HTML to be displayed at the bottom of all styled web pages.
   void set_footer_html(const std::string& html);
 
@@ -95,10 +101,21 @@ class Webserver : public WebCallbackRegistry {
           alias_(std::move(alias)),
           callback_(std::move(callback)) {}
 
+    PathHandler(bool is_on_nav_bar, std::string alias,
+                StreamingPathHandlerCallback callback)
+        : is_styled_(false),
+          is_on_nav_bar_(is_on_nav_bar),
+          alias_(std::move(alias)),
+          streaming_callback_(std::move(callback)) {}
+
     bool is_styled() const { return is_styled_; }
     bool is_on_nav_bar() const { return is_on_nav_bar_; }
     const std::string& alias() const { return alias_; }
     const PrerenderedPathHandlerCallback& callback() const { return callback_; }
+    const StreamingPathHandlerCallback& streaming_callback() const {
+      return streaming_callback_;
+    }
+    bool is_streaming() const { return !streaming_callback_.empty(); }
 
    private:
     // If true, the page appears is rendered styled.
@@ -112,6 +129,10 @@ class Webserver : public WebCallbackRegistry {
 
     // Callback to render output for this page.
     PrerenderedPathHandlerCallback callback_;
+
+    // Callback to stream output for this page. Set instead of 'callback_'
+    // for streaming pages.
+    StreamingPathHandlerCallback streaming_callback_;
   };
 
   bool static_pages_available() const;
@@ -146,6 +167,13 @@ class Webserver : public WebCallbackRegistry {
                      struct sq_connection* connection,
                      struct sq_request_info* request_info);
 
+  // Runs the streaming handler 'handler' for the request 'req', sending the
+  // response with chunked transfer encoding.
+  void RunStreamingPathHandler(const PathHandler& handler,
+                               const WebRequest& req,
+                               struct sq_connection* connection,
+                               struct sq_request_info* request_info);
+
   // Callback to funnel mongoose logs through glog.
   static int LogMessageCallbackStatic(const struct sq_connection* connection,
                                       const char* message);
@@ -37,6 +37,7 @@
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
 using std::string;
@@ -164,10 +165,11 @@ TEST_F(TestCBTree, TestLeafNodeBigKVs) {
 
 // Setup the tree to fanout quicker, so we test internal node
 // splitting, etc.
+// The sizes fit four entries per node, counting each entry's key prefix.
 struct SmallFanoutTraits : public BTreeTraits {
 
-  static const size_t kInternalNodeSize = 84;
-  static const size_t kLeafNodeSize = 92;
+  static const size_t kInternalNodeSize = 116;
+  static const size_t kLeafNodeSize = 121;
 };
 
 // Enables yield() calls at interesting points of the btree
@@ -482,6 +484,76 @@ void TestCBTree::DoTestConcurrentInsert() {
   }
 }
 
+// Inserts keys key_<N> for N in [start_idx, end_idx) stepping by 'step',
+// in increasing key order, with a single mutation hint.
+template<class T>
+void InsertRangeWithHint(CBTree<T> *tree, int start_idx, int end_idx, int step) {
+  char kbuf[64];
+  char vbuf[64];
+  MutationHint<T> hint;
+  for (int i = start_idx; i < end_idx; i += step) {
+    snprintf(kbuf, sizeof(kbuf), "key_%08d", i);
+    snprintf(vbuf, sizeof(vbuf), "val_%d", i);
+    PreparedMutation<T> mutation(Slice(kbuf));
+    mutation.Prepare(tree, &hint);
+    ASSERT_FALSE(mutation.exists()) << "key " << i;
+    ASSERT_TRUE(mutation.Insert(Slice(vbuf))) << "Failed insert at iteration " << i;
+  }
+}
+
+template<class T>
+void VerifyRangeWithHint(const CBTree<T> &tree, int start_idx, int end_idx) {
+  char kbuf[64];
+  char vbuf[64];
+  for (int i = start_idx; i < end_idx; i++) {
+    snprintf(kbuf, sizeof(kbuf), "key_%08d", i);
+    snprintf(vbuf, sizeof(vbuf), "val_%d", i);
+    VerifyGet(tree, Slice(kbuf), Slice(vbuf));
+  }
+}
+
+// Tests inserting with a mutation hint, both in key order, where the hint
+// is usually valid, and out of order, where it usually isn't.
+TEST_F(TestCBTree, TestInsertWithHint) {
+  CBTree<SmallFanoutTraits> t;
+  const int kNumKeys = 10000;
+  // Insert every other key in order, then the rest in two interleaved passes.
+  NO_FATALS(InsertRangeWithHint(&t, 0, kNumKeys, 2));
+  NO_FATALS(InsertRangeWithHint(&t, 1, kNumKeys, 4));
+  NO_FATALS(InsertRangeWithHint(&t, 3, kNumKeys, 4));
+  NO_FATALS(VerifyRangeWithHint(t, 0, kNumKeys));
+  ASSERT_EQ(static_cast<size_t>(kNumKeys), t.count());
+
+  // Every key is now a duplicate, whether found through the hint or not.
+  char kbuf[64];
+  MutationHint<SmallFanoutTraits> hint;
+  for (int i = kNumKeys - 1; i >= 0; i -= 7) {
+    snprintf(kbuf, sizeof(kbuf), "key_%08d", i);
+    PreparedMutation<SmallFanoutTraits> mutation(Slice(kbuf));
+    mutation.Prepare(&t, &hint);
+    ASSERT_TRUE(mutation.exists()) << "key " << i;
+  }
+}
+
+// Tests threads inserting interleaved keys in order with their own hints,
+// so that each thread's hinted leaf is frequently split by the others.
+TEST_F(TestCBTree, TestConcurrentInsertWithHint) {
+  CBTree<RacyTraits> t;
+  const int kNumThreads = 8;
+  const int kNumKeys = AllowSlowTests() ? 100000 : 10000;
+  vector<thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&t, i, kNumKeys]() {
+        InsertRangeWithHint(&t, i, kNumKeys, kNumThreads);
+      });
+  }
+  for (thread &thr : threads) {
+    thr.join();
+  }
+  NO_FATALS(VerifyRangeWithHint(t, 0, kNumKeys));
+  ASSERT_EQ(static_cast<size_t>(kNumKeys), t.count());
+}
+
 TEST_F(TestCBTree, TestIterator) {
   CBTree<SmallFanoutTraits> t;
 
@@ -747,6 +819,66 @@ TEST_F(TestCBTree, TestConcurrentIterateAndInsert) {
   }
 }
 
+// Test that the prefix-based search in a node agrees with a plain binary
+// search, including for keys that share their first 8 bytes or are shorter
+// than that.
+TEST_F(TestCBTree, TestFindWithSharedKeyPrefixes) {
+  CBTree<SmallFanoutTraits> t;
+  vector<string> keys;
+  for (const char* base : { "", "a", "ab", "abcdefgh", "abcdefghi", "abcdefgh\xff" }) {
+    for (int i = 0; i < 20; i++) {
+      string key = StringPrintf("%s%c%d", base, 'a' + (i % 3), i);
+      if (t.Insert(Slice(key), Slice("val"))) {
+        keys.push_back(key);
+      }
+    }
+  }
+  for (const string& key : keys) {
+    ASSERT_TRUE(t.ContainsKey(Slice(key))) << key;
+    string missing = key + '\0';
+    ASSERT_FALSE(t.ContainsKey(Slice(missing))) << missing;
+  }
+  ASSERT_FALSE(t.ContainsKey(Slice("abcdefgg")));
+}
+
+// Check the performance of point lookups of wide keys, as done by upserts
+// into a MemRowSet.
+TEST_F(TestCBTree, TestLookupPerformance) {
+  CBTree<BTreeTraits> tree;
+#ifndef NDEBUG
+  int n_keys = 10000;
+#else
+  int n_keys = 1000000;
+#endif
+  if (AllowSlowTests()) {
+    n_keys = 4000000;
+  }
+
+  // 41-byte keys, as seen in tables keyed by wide strings.
+  auto make_key = [](int i, char* buf, size_t len) {
+    snprintf(buf, len, "%08x-wide-string-key-%016d",
+             static_cast<unsigned>(i) * 2654435761U, i);
+  };
+  char kbuf[64];
+  LOG_TIMING(INFO, StringPrintf("Insert %d wide keys", n_keys)) {
+    for (int i = 0; i < n_keys; i++) {
+      make_key(i, kbuf, sizeof(kbuf));
+      ASSERT_TRUE(tree.Insert(Slice(kbuf), Slice("val")));
+    }
+  }
+
+  int lookup_trials = 5;
+  LOG_TIMING(INFO, StringPrintf("Look up %d wide keys %d times",
+                                n_keys, lookup_trials)) {
+    for (int trial = 0; trial < lookup_trials; trial++) {
+      for (int i = 0; i < n_keys; i++) {
+        make_key(i, kbuf, sizeof(kbuf));
+        ASSERT_TRUE(tree.ContainsKey(Slice(kbuf)));
+      }
+    }
+  }
+}
+
 // Check the performance of scanning through a large tree.
 TEST_F(TestCBTree, TestScanPerformance) {
   CBTree<BTreeTraits> tree;
@@ -58,6 +58,7 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(cfile_write_zone_maps);
 DECLARE_int32(cfile_default_block_size);
 
 using std::shared_ptr;
@@ -463,6 +464,62 @@ TEST_F(TestCFileSet, TestRangePredicates2) {
   DoTestRangeScan(fileset, kNumRows * 10, kNoBound);
 }
 
+// Test that predicates on non-key columns skip the blocks which the zone maps
+// show can't match, without reading any of the columns for them.
+TEST_F(TestCFileSet, TestZoneMapsSkipBlocks) {
+  FLAGS_cfile_write_zone_maps = true;
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), nullptr, &fileset));
+
+  shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_, nullptr));
+  gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+
+  // The third column contains the row index * 100.
+  ScanSpec spec;
+  int32_t lower = 200000;
+  int32_t upper = 201000;
+  spec.AddPredicate(ColumnPredicate::Range(schema_.column(2), &lower, &upper));
+  ASSERT_OK(iter->Init(&spec));
+
+  vector<string> results;
+  ASSERT_OK(IterateToStringList(iter.get(), &results));
+  ASSERT_EQ(10, results.size());
+  EXPECT_EQ("(int32 c0=4000, int32 c1=20000, int32 c2=200000)", results[0]);
+  EXPECT_EQ("(int32 c0=4018, int32 c1=20090, int32 c2=200900)", results[9]);
+
+  // The matching rows are in one or two blocks of each column, and the
+  // predicate column's blocks outside of them were skipped.
+  vector<IteratorStats> stats;
+  iter->GetIteratorStats(&stats);
+  ASSERT_EQ(3, stats.size());
+  for (const auto& col_stats : stats) {
+    EXPECT_LE(col_stats.blocks_read, 2) << col_stats.ToString();
+  }
+  EXPECT_GT(stats[2].blocks_skipped, 10) << stats[2].ToString();
+  EXPECT_EQ(0, stats[0].blocks_skipped);
+
+  // Without zone maps, every block of the predicate column is read.
+  FLAGS_cfile_write_zone_maps = false;
+  rowset_meta_.reset();
+  ASSERT_OK(tablet()->metadata()->CreateRowSet(&rowset_meta_));
+  WriteTestRowSet(kNumRows);
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), nullptr, &fileset));
+  cfile_iter.reset(fileset->NewIterator(&schema_, nullptr));
+  iter.reset(new MaterializingIterator(cfile_iter));
+  ScanSpec spec2;
+  spec2.AddPredicate(ColumnPredicate::Range(schema_.column(2), &lower, &upper));
+  ASSERT_OK(iter->Init(&spec2));
+  results.clear();
+  ASSERT_OK(IterateToStringList(iter.get(), &results));
+  ASSERT_EQ(10, results.size());
+  iter->GetIteratorStats(&stats);
+  EXPECT_GT(stats[2].blocks_read, 10) << stats[2].ToString();
+  EXPECT_EQ(0, stats[2].blocks_skipped);
+}
+
 TEST_F(TestCFileSet, TestBloomFilterPredicates) {
   const int kNumRows = 100;
   BloomFilterBuilder bfb1_contain(
@@ -325,6 +325,61 @@ Status CFileSet::CheckRowPresent(const RowSetKeyProbe& probe, const IOContext* i
   return Status::OK();
 }
 
+Status CFileSet::CheckRowsPresent(ArrayView<const RowSetKeyProbe* const> probes,
+                                  const IOContext* io_context,
+                                  bool* present,
+                                  rowid_t* rowids,
+                                  ArrayView<ProbeStats* const> stats) const {
+  const size_t n = probes.size();
+  DCHECK_EQ(n, stats.size());
+  std::fill(present, present + n, true);
+
+  if (FLAGS_consult_bloom_filters) {
+    RETURN_NOT_OK(bloom_reader_->Init(io_context));
+
+    vector<const BloomKeyProbe*> bloom_probes(n);
+    for (size_t i = 0; i < n; i++) {
+      bloom_probes[i] = &probes[i]->bloom_probe();
+      stats[i]->blooms_consulted++;
+    }
+    Status s = bloom_reader_->CheckKeysPresent(bloom_probes, io_context, present);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 1) << Substitute("Unable to query bloom in $0: $1",
+          rowset_metadata_->bloom_block().ToString(), s.ToString());
+      if (PREDICT_FALSE(s.IsDiskFailure())) {
+        // If the bloom lookup failed because of a disk failure, return early
+        // since I/O to the tablet should be stopped.
+        return s;
+      }
+      // Continue with the slow path for every probe.
+      std::fill(present, present + n, true);
+    }
+  }
+
+  // Share a single key iterator across the batch rather than creating one
+  // per probe.
+  unique_ptr<CFileIterator> key_iter;
+  for (size_t i = 0; i < n; i++) {
+    if (!present[i]) continue;
+    if (!key_iter) {
+      CFileIterator* iter = nullptr;
+      RETURN_NOT_OK(NewKeyIterator(io_context, &iter));
+      key_iter.reset(iter);
+    }
+
+    stats[i]->keys_consulted++;
+    bool exact;
+    Status s = key_iter->SeekAtOrAfter(probes[i]->encoded_key(), &exact);
+    if (s.IsNotFound() || (s.ok() && !exact)) {
+      present[i] = false;
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    rowids[i] = key_iter->GetCurrentOrdinal();
+  }
+  return Status::OK();
+}
+
 Status CFileSet::NewKeyIterator(const IOContext* io_context, CFileIterator** key_iter) const {
   RETURN_NOT_OK(key_index_reader()->Init(io_context));
   return key_index_reader()->NewIterator(key_iter, CFileReader::CACHE_BLOCK, io_context);
@@ -392,6 +447,16 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // ordinal range.
   RETURN_NOT_OK(PushdownRangeScanPredicate(spec));
 
+  zone_map_preds_.clear();
+  if (spec != nullptr) {
+    for (const auto& col_pred : spec->predicates()) {
+      int col_idx = projection_->find_column(col_pred.first);
+      if (col_idx != Schema::kColumnNotFound) {
+        zone_map_preds_.emplace_back(col_idx, col_pred.second);
+      }
+    }
+  }
+
   initted_ = true;
 
   // Don't actually seek -- we'll seek when we first actually read the
@@ -461,8 +526,30 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status CFileSet::Iterator::AlignBatchWithZoneMaps(size_t* n) {
+  size_t skip_rows = 0;
+  size_t match_rows = *n;
+  for (const auto& col_pred : zone_map_preds_) {
+    size_t nrows = *n;
+    bool may_match;
+    RETURN_NOT_OK(col_iters_[col_pred.first]->CheckZoneMap(col_pred.second, cur_idx_,
+                                                           &nrows, &may_match));
+    if (!may_match) {
+      if (nrows > skip_rows) {
+        skip_rows = nrows;
+        zone_map_skip_col_ = col_pred.first;
+      }
+    } else {
+      match_rows = std::min(match_rows, nrows);
+    }
+  }
+  *n = skip_rows > 0 ? skip_rows : match_rows;
+  return Status::OK();
+}
+
 void CFileSet::Iterator::Unprepare() {
   prepared_count_ = 0;
+  zone_map_skip_col_ = -1;
   cols_prepared_.assign(col_iters_.size(), false);
 }
 
@@ -473,10 +560,21 @@ Status CFileSet::Iterator::PrepareBatch(size_t *n) {
   if (*n > remaining) {
     *n = remaining;
   }
+  if (!zone_map_preds_.empty() && *n > 0) {
+    RETURN_NOT_OK(AlignBatchWithZoneMaps(n));
+  }
 
   prepared_count_ = *n;
 
-  // Lazily prepare the first column when it is materialized.
+  // Columns are only prepared lazily, as they're materialized. Start reading
+  // the data for all of them up front though, so the reads of the different
+  // columns overlap rather than being issued one at a time. A batch which is
+  // likely to be skipped isn't worth reading.
+  if (zone_map_skip_col_ < 0) {
+    for (const auto& col_iter : col_iters_) {
+      RETURN_NOT_OK(col_iter->Prefetch(cur_idx_, prepared_count_));
+    }
+  }
   return Status::OK();
 }
 
@@ -518,6 +616,16 @@ Status CFileSet::Iterator::PrepareColumn(ColumnMaterializationContext *ctx) {
 }
 
 Status CFileSet::Iterator::InitializeSelectionVector(SelectionVector *sel_vec) {
+  return InitializeSelectionVector(sel_vec, /*use_zone_maps=*/true);
+}
+
+Status CFileSet::Iterator::InitializeSelectionVector(SelectionVector *sel_vec,
+                                                     bool use_zone_maps) {
+  if (use_zone_maps && zone_map_skip_col_ >= 0) {
+    sel_vec->SetAllFalse();
+    col_iters_[zone_map_skip_col_]->RecordZoneMapSkip(cur_idx_, prepared_count_);
+    return Status::OK();
+  }
   sel_vec->SetAllTrue();
   return Status::OK();
 }
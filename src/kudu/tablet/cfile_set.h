@@ -30,6 +30,7 @@
 #include <gtest/gtest_prod.h>
 
 #include "kudu/cfile/cfile_reader.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/rowid.h"
 #include "kudu/common/schema.h"
@@ -38,6 +39,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/tablet/rowset_metadata.h"
+#include "kudu/util/array_view.h"
 #include "kudu/util/status.h"
 
 namespace boost {
@@ -121,6 +123,16 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   Status CheckRowPresent(const RowSetKeyProbe& probe, const fs::IOContext* io_context,
                          bool* present, rowid_t* rowid, ProbeStats* stats) const;
 
+  // Batched version of CheckRowPresent(). The probes are first checked
+  // against the bloom filter in a single batch, and the survivors are then
+  // looked up through one key index iterator. The probes should be sorted by
+  // encoded key so that successive index seeks move forward.
+  Status CheckRowsPresent(ArrayView<const RowSetKeyProbe* const> probes,
+                          const fs::IOContext* io_context,
+                          bool* present,
+                          rowid_t* rowids,
+                          ArrayView<ProbeStats* const> stats) const;
+
   // Return true if there exists a CFile for the given column ID.
   bool has_data_for_column_id(ColumnId col_id) const {
     return ContainsKey(readers_by_col_id_, col_id);
@@ -187,6 +199,12 @@ class CFileSet::Iterator : public ColumnwiseIterator {
 
   virtual Status InitializeSelectionVector(SelectionVector *sel_vec) OVERRIDE;
 
+  // Like the above, but only deselects the rows of a batch which the zone
+  // maps showed can't match the scan's predicates if 'use_zone_maps' is true.
+  // Zone maps describe the base data only, so they mustn't be used for
+  // batches to which deltas may apply.
+  Status InitializeSelectionVector(SelectionVector *sel_vec, bool use_zone_maps);
+
   Status MaterializeColumn(ColumnMaterializationContext *ctx) override;
 
   virtual Status FinishBatch() OVERRIDE;
@@ -227,6 +245,7 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         initted_(false),
         cur_idx_(0),
         prepared_count_(0),
+        zone_map_skip_col_(-1),
         io_context_(io_context) {}
 
   // Fill in col_iters_ for each of the requested columns.
@@ -237,6 +256,12 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // store it in member fields.
   Status PushdownRangeScanPredicate(ScanSpec *spec);
 
+  // Shrink the batch of '*n' rows starting at cur_idx_ to the leading run of
+  // rows which the zone maps of the predicate columns show can't match, if
+  // there is one, or else to the leading run which may match. Each batch is
+  // thus either skipped whole or read whole.
+  Status AlignBatchWithZoneMaps(size_t* n);
+
   void Unprepare();
 
   // Prepare the given column if not already prepared.
@@ -264,6 +289,14 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   rowid_t lower_bound_idx_;
   rowid_t upper_bound_idx_;
 
+  // The scan's predicates, with the index of their column in the projection,
+  // whose columns' zone maps are consulted to skip batches.
+  std::vector<std::pair<int, ColumnPredicate>> zone_map_preds_;
+
+  // If the zone maps showed that no row of the prepared batch can match, the
+  // index of the column whose zone map showed it. Otherwise -1.
+  int zone_map_skip_col_;
+
   const fs::IOContext* io_context_;
 
   // The underlying columns are prepared lazily, so that if a column is never
@@ -1043,6 +1043,41 @@ TEST_F(TestCompaction, TestMergeMRS) {
                 "Redo Mutations: [];", out[19]);
 }
 
+// Test that a key range input yields exactly the rows of its range, and that
+// adjacent ranges together cover the whole input.
+TEST_F(TestCompaction, TestKeyRangeInput) {
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              mem_trackers_.tablet_tracker, &mrs));
+  InsertRows(mrs.get(), 100, 0);
+  MvccSnapshot snap(mvcc_);
+
+  // Row keys are "hello <n*10>"; the single string key column's encoded form
+  // is the string itself.
+  const vector<string> split_keys = { "hello 00000250", "hello 00000700" };
+  vector<string> all_out;
+  for (int i = 0; i <= split_keys.size(); i++) {
+    shared_ptr<CompactionInput> mrs_input(CompactionInput::Create(*mrs, &schema_, snap));
+    gscoped_ptr<CompactionInput> input(CompactionInput::KeyRange(
+        mrs_input,
+        i == 0 ? "" : split_keys[i - 1],
+        i == split_keys.size() ? "" : split_keys[i]));
+    vector<string> out;
+    IterateInput(input.get(), &out);
+    all_out.insert(all_out.end(), out.begin(), out.end());
+    if (i == 0) {
+      ASSERT_EQ(25, out.size());
+    } else if (i == 1) {
+      ASSERT_EQ(45, out.size());
+      ASSERT_STR_CONTAINS(out[0], "hello 00000250");
+    } else {
+      ASSERT_EQ(30, out.size());
+      ASSERT_STR_CONTAINS(out.back(), "hello 00000990");
+    }
+  }
+  ASSERT_EQ(100, all_out.size());
+}
+
 #ifdef NDEBUG
 // Benchmark for the compaction merge input for the case where the inputs
 // contain non-overlapping data. In this case the merge can be optimized
@@ -844,6 +844,76 @@ string CompactionInputRowToString(const CompactionInputRow& input_row) {
   return ret;
 }
 
+namespace {
+
+// CompactionInput which yields the rows of another input that fall in a range
+// of encoded keys. Since the wrapped input is sorted by key, the range ends as
+// soon as a row at or past the upper bound is seen.
+class KeyRangeCompactionInput : public CompactionInput {
+ public:
+  KeyRangeCompactionInput(shared_ptr<CompactionInput> input,
+                          string lower_bound,
+                          string upper_bound)
+      : input_(std::move(input)),
+        lower_bound_(std::move(lower_bound)),
+        upper_bound_(std::move(upper_bound)),
+        past_upper_bound_(false) {
+  }
+
+  Status Init() override {
+    return input_->Init();
+  }
+
+  bool HasMoreBlocks() override {
+    return !past_upper_bound_ && input_->HasMoreBlocks();
+  }
+
+  Status PrepareBlock(vector<CompactionInputRow> *block) override {
+    RETURN_NOT_OK(input_->PrepareBlock(block));
+
+    const Schema& schema = input_->schema();
+    int num_kept = 0;
+    for (int i = 0; i < block->size(); i++) {
+      CompactionInputRow& input_row = (*block)[i];
+      Slice key = schema.EncodeComparableKey(input_row.row, &key_buf_);
+      if (!upper_bound_.empty() && key.compare(upper_bound_) >= 0) {
+        past_upper_bound_ = true;
+        break;
+      }
+      if (!lower_bound_.empty() && key.compare(lower_bound_) < 0) {
+        continue;
+      }
+      if (num_kept != i) {
+        (*block)[num_kept] = input_row;
+      }
+      num_kept++;
+    }
+    block->resize(num_kept);
+    return Status::OK();
+  }
+
+  Arena* PreparedBlockArena() override { return input_->PreparedBlockArena(); }
+
+  Status FinishBlock() override {
+    return input_->FinishBlock();
+  }
+
+  const Schema &schema() const override {
+    return input_->schema();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(KeyRangeCompactionInput);
+
+  shared_ptr<CompactionInput> input_;
+  const string lower_bound_;
+  const string upper_bound_;
+  bool past_upper_bound_;
+  faststring key_buf_;
+};
+
+} // anonymous namespace
+
 ////////////////////////////////////////////////////////////
 
 Status CompactionInput::Create(const DiskRowSet &rowset,
@@ -893,6 +963,14 @@ CompactionInput *CompactionInput::Merge(const vector<shared_ptr<CompactionInput>
   return new MergeCompactionInput(inputs, schema);
 }
 
+CompactionInput *CompactionInput::KeyRange(shared_ptr<CompactionInput> input,
+                                           string lower_bound,
+                                           string upper_bound) {
+  return new KeyRangeCompactionInput(std::move(input),
+                                     std::move(lower_bound),
+                                     std::move(upper_bound));
+}
+
 
 Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
                                                   const Schema* schema,
@@ -918,6 +996,41 @@ Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
   return Status::OK();
 }
 
+void RowSetsInCompaction::GetPartitionSplitKeys(int num_partitions,
+                                                vector<string>* split_keys) const {
+  split_keys->clear();
+  if (num_partitions <= 1) {
+    return;
+  }
+
+  // Collect the bounds of every rowset. Splitting at rowset boundaries keeps
+  // each range's share of the input roughly proportional to the number of
+  // rowsets overlapping it.
+  vector<string> bounds;
+  for (const shared_ptr<RowSet>& rs : rowsets_) {
+    string min_key;
+    string max_key;
+    if (!rs->GetBounds(&min_key, &max_key).ok()) {
+      return;
+    }
+    bounds.emplace_back(std::move(min_key));
+    bounds.emplace_back(std::move(max_key));
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+  // The smallest bound can't split anything off.
+  for (int i = 1; i < num_partitions; i++) {
+    size_t idx = i * bounds.size() / num_partitions;
+    if (idx == 0 || idx >= bounds.size()) {
+      continue;
+    }
+    if (split_keys->empty() || split_keys->back() != bounds[idx]) {
+      split_keys->push_back(bounds[idx]);
+    }
+  }
+}
+
 void RowSetsInCompaction::DumpToLog() const {
   LOG(INFO) << "Selected " << rowsets_.size() << " rowsets to compact:";
   // Dump the selected rowsets to the log, and collect corresponding iterators.
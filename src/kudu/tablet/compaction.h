@@ -122,6 +122,14 @@ class CompactionInput {
   static CompactionInput *Merge(const std::vector<std::shared_ptr<CompactionInput> > &inputs,
                                 const Schema *schema);
 
+  // Create an input which yields only the rows of 'input' whose encoded keys
+  // fall in the range ['lower_bound', 'upper_bound'). An empty bound leaves
+  // that side of the range unbounded. Reading stops as soon as a row at or
+  // past 'upper_bound' is seen.
+  static CompactionInput *KeyRange(std::shared_ptr<CompactionInput> input,
+                                   std::string lower_bound,
+                                   std::string upper_bound);
+
   virtual Status Init() = 0;
   virtual Status PrepareBlock(std::vector<CompactionInputRow> *block) = 0;
 
@@ -159,6 +167,16 @@ class RowSetsInCompaction {
                                const fs::IOContext* io_context,
                                std::shared_ptr<CompactionInput> *out) const;
 
+  // Picks up to 'num_partitions' - 1 encoded keys splitting the key space of
+  // the rowsets into ranges of roughly equal overlap, suitable for compacting
+  // each range independently. The split keys are drawn from the rowsets'
+  // bounds and returned in ascending order.
+  //
+  // Leaves 'split_keys' empty if the rowsets can't be partitioned (e.g. one
+  // of them is a MemRowSet, whose bounds are unknown).
+  void GetPartitionSplitKeys(int num_partitions,
+                             std::vector<std::string>* split_keys) const;
+
   // Dump a log message indicating the chosen rowsets.
   void DumpToLog() const;
 
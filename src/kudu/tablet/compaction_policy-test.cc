@@ -21,6 +21,7 @@
 #include <limits>
 #include <memory>
 #include <ostream>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -30,10 +31,12 @@
 #include <glog/stl_logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/compaction_policy_simulator.h"
 #include "kudu/tablet/mock-rowsets.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_info.h"
@@ -50,6 +53,7 @@ using std::string;
 using std::vector;
 
 DECLARE_double(compaction_minimum_improvement);
+DECLARE_double(compaction_write_amp_budget);
 DECLARE_double(compaction_small_rowset_tradeoff);
 DECLARE_int64(budgeted_compaction_target_rowset_size);
 
@@ -434,6 +438,103 @@ TEST_F(TestCompactionPolicy, TestHeightBasedDominatesSizeBased) {
   }
 }
 
+// Test that the hybrid policy selects like the budgeted policy while within
+// its write amplification budget, and only selects small or hot rowsets once
+// over it.
+TEST_F(TestCompactionPolicy, TestHybridPolicyTiersOverWriteAmpBudget) {
+  FLAGS_compaction_write_amp_budget = 10.0;
+  constexpr auto kBigRowSetSizeBytes = 64 * 1024 * 1024;
+  constexpr auto kSmallRowSetSizeBytes = 1024 * 1024;
+  constexpr auto kBudgetMb = 1000; // Enough to select all rowsets.
+  auto big = std::make_shared<MockDiskRowSet>("a", "z", kBigRowSetSizeBytes);
+  const RowSetVector rowsets = {
+    big,
+    std::make_shared<MockDiskRowSet>("a", "p", kSmallRowSetSizeBytes),
+    std::make_shared<MockDiskRowSet>("h", "z", kSmallRowSetSizeBytes),
+  };
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(rowsets));
+
+  HybridCompactionPolicy policy(kBudgetMb);
+  ASSERT_EQ(1.0, policy.write_amplification());
+  CompactionSelection picked;
+  double quality = 0.0;
+  ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, /*log=*/nullptr));
+  ASSERT_EQ(3, picked.size());
+
+  // Push the write amplification over budget: the big rowset is excluded.
+  policy.RecordBytesWritten(1024 * 1024, /*is_flush=*/true);
+  policy.RecordBytesWritten(100 * 1024 * 1024, /*is_flush=*/false);
+  ASSERT_GT(policy.write_amplification(), FLAGS_compaction_write_amp_budget);
+  picked.clear();
+  ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, /*log=*/nullptr));
+  ASSERT_EQ(2, picked.size());
+  ASSERT_FALSE(ContainsKey(picked, big.get()));
+
+  // Once the big rowset serves most reads, it's eligible again.
+  big->set_read_count(1000);
+  picked.clear();
+  ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, /*log=*/nullptr));
+  ASSERT_EQ(3, picked.size());
+}
+
+// Test that rowset dumps round-trip through the simulator's parser, including
+// keys which need escaping.
+TEST_F(TestCompactionPolicy, TestRowSetDumpRoundTrip) {
+  const RowSetVector rowsets = {
+    std::make_shared<MockDiskRowSet>("a\tb", "c\nd", 2 * 1024 * 1024),
+    std::make_shared<MockDiskRowSet>(string("b\0", 2), "z\\", 5 * 1024 * 1024),
+  };
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(rowsets));
+  vector<RowSetInfo> infos, unused;
+  RowSetInfo::ComputeCdfAndCollectOrdered(tree, /*average_height=*/nullptr,
+                                          &infos, &unused);
+  std::ostringstream dump;
+  WriteRowSetDump(infos, &dump);
+
+  RowSetVector parsed;
+  ASSERT_OK(ParseRowSetDump(dump.str(), &parsed));
+  ASSERT_EQ(infos.size(), parsed.size());
+  for (int i = 0; i < infos.size(); i++) {
+    string min_key, max_key;
+    ASSERT_OK(parsed[i]->GetBounds(&min_key, &max_key));
+    ASSERT_EQ(infos[i].min_key(), min_key);
+    ASSERT_EQ(infos[i].max_key(), max_key);
+    ASSERT_EQ(infos[i].size_bytes(), parsed[i]->OnDiskBaseDataSizeWithRedos());
+  }
+
+  ASSERT_TRUE(ParseRowSetDump("1\tonly-one-key\n", &parsed).IsCorruption());
+}
+
+// Run the compaction policy simulator over the YCSB rowset layout with both
+// policies, sanity-checking the reported statistics.
+TEST_F(TestCompactionPolicy, TestSimulateYcsbCompactions) {
+  if (!AllowSlowTests()) {
+    LOG(WARNING) << "test is skipped; set KUDU_ALLOW_SLOW_TESTS=1 to run";
+    return;
+  }
+  const RowSetVector rowsets = LoadFile("testdata/ycsb-test-rowsets.tsv");
+  CompactionSimulationOptions opts;
+  opts.num_rounds = 20;
+  opts.flushes_per_round = 2;
+
+  BudgetedCompactionPolicy budgeted(128);
+  HybridCompactionPolicy hybrid(128);
+  for (CompactionPolicy* policy : { static_cast<CompactionPolicy*>(&budgeted),
+                                    static_cast<CompactionPolicy*>(&hybrid) }) {
+    CompactionSimulationResult result;
+    ASSERT_OK(SimulateCompactions(rowsets, opts, policy, &result));
+    LOG(INFO) << result.ToString();
+    ASSERT_EQ(opts.num_rounds * opts.flushes_per_round * opts.flush_size_bytes,
+              result.bytes_flushed);
+    ASSERT_LE(result.num_compactions, opts.num_rounds * opts.max_compactions_per_round);
+    ASSERT_GE(result.write_amplification(), 1.0);
+    ASSERT_GT(result.final_num_rowsets, 0);
+    ASSERT_GE(result.max_average_height, result.mean_average_height);
+  }
+}
+
 namespace {
 double ComputeAverageRowsetHeight(
     const vector<std::pair<string, string>>& intervals) {
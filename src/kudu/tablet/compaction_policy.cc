@@ -18,7 +18,9 @@
 #include "kudu/tablet/compaction_policy.h"
 
 #include <algorithm>
+#include <atomic>
 #include <limits>
+#include <memory>
 #include <ostream>
 #include <queue>
 #include <string>
@@ -31,12 +33,16 @@
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/compaction_policy_simulator.h"
+#include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_info.h"
+#include "kudu/tablet/rowset_tree.h"
 #include "kudu/tablet/svg_dump.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/knapsack_solver.h"
 #include "kudu/util/status.h"
 
+using std::string;
 using std::vector;
 using strings::Substitute;
 
@@ -59,6 +65,31 @@ DEFINE_double(compaction_minimum_improvement, 0.01f,
               "compaction will be considered ineligible.");
 TAG_FLAG(compaction_minimum_improvement, advanced);
 
+DEFINE_double(compaction_write_amp_budget, 10.0,
+              "The write amplification, in bytes written by flushes and "
+              "compactions per byte flushed, up to which the hybrid compaction "
+              "policy compacts to minimize rowset height. Beyond it, the policy "
+              "only consolidates small or frequently-read rowsets.");
+TAG_FLAG(compaction_write_amp_budget, advanced);
+TAG_FLAG(compaction_write_amp_budget, experimental);
+TAG_FLAG(compaction_write_amp_budget, runtime);
+
+DEFINE_double(compaction_tiered_max_size_ratio, 0.5,
+              "When the hybrid compaction policy is over its write amplification "
+              "budget, rowsets larger than this fraction of the target rowset "
+              "size are not selected for compaction unless they are hot.");
+TAG_FLAG(compaction_tiered_max_size_ratio, advanced);
+TAG_FLAG(compaction_tiered_max_size_ratio, experimental);
+TAG_FLAG(compaction_tiered_max_size_ratio, runtime);
+
+DEFINE_double(compaction_hot_rowset_read_fraction, 0.1,
+              "The fraction of a tablet's rowset reads that a single rowset must "
+              "have served to be considered hot by the hybrid compaction policy. "
+              "Hot rowsets remain eligible for compaction regardless of size.");
+TAG_FLAG(compaction_hot_rowset_read_fraction, advanced);
+TAG_FLAG(compaction_hot_rowset_read_fraction, experimental);
+TAG_FLAG(compaction_hot_rowset_read_fraction, runtime);
+
 namespace kudu {
 namespace tablet {
 
@@ -509,9 +540,79 @@ Status BudgetedCompactionPolicy::PickRowSets(
 
   picked->swap(best_solution.rowsets);
   DumpCompactionSVGToFile(asc_min_key, *picked);
+  WriteRowSetDumpToFile(asc_min_key);
 
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// HybridCompactionPolicy
+////////////////////////////////////////////////////////////
+
+HybridCompactionPolicy::HybridCompactionPolicy(int size_budget_mb)
+  : budgeted_(size_budget_mb),
+    bytes_flushed_(0),
+    bytes_compacted_(0) {
+}
+
+uint64_t HybridCompactionPolicy::target_rowset_size() const {
+  return budgeted_.target_rowset_size();
+}
+
+void HybridCompactionPolicy::RecordBytesWritten(uint64_t bytes, bool is_flush) {
+  auto& counter = is_flush ? bytes_flushed_ : bytes_compacted_;
+  counter.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+double HybridCompactionPolicy::write_amplification() const {
+  const uint64_t flushed = bytes_flushed_.load(std::memory_order_relaxed);
+  if (flushed == 0) {
+    return 1.0;
+  }
+  const uint64_t compacted = bytes_compacted_.load(std::memory_order_relaxed);
+  return static_cast<double>(flushed + compacted) / flushed;
+}
+
+Status HybridCompactionPolicy::PickRowSets(const RowSetTree& tree,
+                                           CompactionSelection* picked,
+                                           double* quality,
+                                           vector<string>* log) {
+  const double write_amp = write_amplification();
+  if (write_amp <= FLAGS_compaction_write_amp_budget) {
+    if (log) {
+      LOG_STRING(INFO, log) << Substitute("Write amplification $0 within budget $1: "
+                                          "leveled selection",
+                                          write_amp, FLAGS_compaction_write_amp_budget);
+    }
+    return budgeted_.PickRowSets(tree, picked, quality, log);
+  }
+
+  // Over budget: restrict the selection to small rowsets and hot rowsets.
+  uint64_t total_reads = 0;
+  for (const auto& rs : tree.all_rowsets()) {
+    total_reads += rs->ReadCount();
+  }
+  const uint64_t max_size_bytes = static_cast<uint64_t>(
+      FLAGS_compaction_tiered_max_size_ratio * target_rowset_size());
+  const double hot_reads = FLAGS_compaction_hot_rowset_read_fraction * total_reads;
+  RowSetVector eligible;
+  for (const auto& rs : tree.all_rowsets()) {
+    const bool hot = total_reads > 0 && rs->ReadCount() >= hot_reads;
+    if (hot || rs->OnDiskBaseDataSizeWithRedos() <= max_size_bytes) {
+      eligible.push_back(rs);
+    }
+  }
+  if (log) {
+    LOG_STRING(INFO, log) << Substitute("Write amplification $0 exceeds budget $1: "
+                                        "tiered selection over $2 of $3 rowsets",
+                                        write_amp, FLAGS_compaction_write_amp_budget,
+                                        eligible.size(), tree.all_rowsets().size());
+  }
+
+  RowSetTree eligible_tree;
+  RETURN_NOT_OK(eligible_tree.Reset(eligible));
+  return budgeted_.PickRowSets(eligible_tree, picked, quality, log);
+}
+
 } // namespace tablet
 } // namespace kudu
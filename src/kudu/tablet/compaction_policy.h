@@ -17,6 +17,7 @@
 #ifndef KUDU_TABLET_COMPACTION_POLICY_H
 #define KUDU_TABLET_COMPACTION_POLICY_H
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <string>
@@ -66,6 +67,13 @@ class CompactionPolicy {
   // whereas others may prefer large ones.
   virtual uint64_t target_rowset_size() const = 0;
 
+  // Notify the policy that a flush (if 'is_flush' is true) or a compaction
+  // wrote 'bytes' bytes of new rowsets. Policies that account for write
+  // amplification use this history; the default implementation ignores it.
+  //
+  // May be called concurrently with PickRowSets().
+  virtual void RecordBytesWritten(uint64_t /*bytes*/, bool /*is_flush*/) {}
+
  private:
   DISALLOW_COPY_AND_ASSIGN(CompactionPolicy);
 };
@@ -127,6 +135,43 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
   const size_t size_budget_mb_;
 };
 
+// A compaction policy which trades write amplification against read
+// amplification, switching between leveled and tiered selection.
+//
+// While the tablet's observed write amplification (bytes written by flushes
+// and compactions per byte flushed) is within
+// -compaction_write_amp_budget, selection is "leveled": the budgeted policy
+// runs over all rowsets, minimizing the tablet's average height. Once the
+// budget is exceeded, selection becomes "tiered": only rowsets that are small
+// relative to the target rowset size are eligible, so that small flushed
+// rowsets are consolidated without rewriting large, already-compacted ones.
+// Rowsets that served a large fraction of the tablet's reads remain eligible
+// in tiered mode, since reducing the height over them benefits the most reads.
+class HybridCompactionPolicy : public CompactionPolicy {
+ public:
+  explicit HybridCompactionPolicy(int size_budget_mb);
+
+  Status PickRowSets(const RowSetTree& tree,
+                     CompactionSelection* picked,
+                     double* quality,
+                     std::vector<std::string>* log) override;
+
+  uint64_t target_rowset_size() const override;
+
+  void RecordBytesWritten(uint64_t bytes, bool is_flush) override;
+
+  // Return the write amplification observed so far: the ratio of bytes written
+  // by flushes and compactions to bytes written by flushes alone. Returns 1.0
+  // if nothing has been flushed yet.
+  double write_amplification() const;
+
+ private:
+  BudgetedCompactionPolicy budgeted_;
+
+  std::atomic<uint64_t> bytes_flushed_;
+  std::atomic<uint64_t> bytes_compacted_;
+};
+
 } // namespace tablet
 } // namespace kudu
 #endif
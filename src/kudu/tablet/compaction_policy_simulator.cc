@@ -0,0 +1,240 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/compaction_policy_simulator.h"
+
+#include <algorithm>
+#include <ctime>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/escaping.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/tablet/compaction_policy.h"
+#include "kudu/tablet/mock-rowsets.h"
+#include "kudu/tablet/rowset_info.h"
+#include "kudu/tablet/rowset_tree.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_string(compaction_policy_dump_rowsets_pattern, "",
+              "File path into which to dump the rowset layout considered by "
+              "each compaction selection, in the format read by the "
+              "compaction policy simulator. The special string 'TIME' will be "
+              "substituted with the compaction selection timestamp.");
+TAG_FLAG(compaction_policy_dump_rowsets_pattern, hidden);
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tablet {
+
+namespace {
+
+const uint64_t kBytesPerMb = 1024 * 1024;
+
+// Return the average height of the rowsets in 'rowsets'.
+Status ComputeAverageHeight(const RowSetVector& rowsets, double* average_height) {
+  RowSetTree tree;
+  RETURN_NOT_OK(tree.Reset(rowsets));
+  RowSetInfo::ComputeCdfAndCollectOrdered(tree, average_height, nullptr, nullptr);
+  return Status::OK();
+}
+
+// Replace the rowsets in 'picked' with the output of compacting them into
+// rowsets of at most 'target_size_bytes' each, returning the number of bytes
+// compacted in 'bytes_compacted'.
+//
+// The output rowsets span consecutive ranges between the inputs' bounds, which
+// stand in for the key distribution of the compacted data.
+Status ApplyCompaction(const CompactionSelection& picked,
+                       uint64_t target_size_bytes,
+                       RowSetVector* rowsets,
+                       uint64_t* bytes_compacted) {
+  uint64_t total_bytes = 0;
+  vector<string> keys;
+  RowSetVector remaining;
+  for (const auto& rs : *rowsets) {
+    if (!ContainsKey(picked, rs.get())) {
+      remaining.push_back(rs);
+      continue;
+    }
+    string min_key, max_key;
+    RETURN_NOT_OK(rs->GetBounds(&min_key, &max_key));
+    keys.emplace_back(std::move(min_key));
+    keys.emplace_back(std::move(max_key));
+    total_bytes += rs->OnDiskBaseDataSizeWithRedos();
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  // Each output needs two distinct bounds.
+  size_t num_outputs = std::max<uint64_t>(
+      1, (total_bytes + target_size_bytes - 1) / target_size_bytes);
+  num_outputs = std::min(num_outputs, std::max<size_t>(1, keys.size() - 1));
+  const uint64_t output_bytes = total_bytes / num_outputs;
+  for (size_t i = 0; i < num_outputs; i++) {
+    const string& min_key = keys[i * (keys.size() - 1) / num_outputs];
+    const string& max_key = keys[(i + 1) * (keys.size() - 1) / num_outputs];
+    remaining.push_back(std::make_shared<MockDiskRowSet>(min_key, max_key, output_bytes));
+  }
+
+  rowsets->swap(remaining);
+  *bytes_compacted = total_bytes;
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+double CompactionSimulationResult::write_amplification() const {
+  if (bytes_flushed == 0) {
+    return 1.0;
+  }
+  return static_cast<double>(bytes_flushed + bytes_compacted) / bytes_flushed;
+}
+
+string CompactionSimulationResult::ToString() const {
+  return Substitute("flushed=$0MiB compacted=$1MiB compactions=$2 write_amp=$3 "
+                    "avg_height(final=$4 mean=$5 max=$6) rowsets=$7",
+                    bytes_flushed / kBytesPerMb, bytes_compacted / kBytesPerMb,
+                    num_compactions, write_amplification(),
+                    final_average_height, mean_average_height, max_average_height,
+                    final_num_rowsets);
+}
+
+Status ParseRowSetDump(const string& data, RowSetVector* rowsets) {
+  const vector<string> lines = strings::Split(data, "\n");
+  for (const auto& line : lines) {
+    if (line.empty() || line[0] == '#') continue;
+    const vector<string> fields = strings::Split(line, "\t");
+    if (fields.size() != 3) {
+      return Status::Corruption("expected 3 fields in rowset dump line", line);
+    }
+    const int size_mb = ParseLeadingInt32Value(fields[0], -1);
+    if (size_mb < 1) {
+      return Status::Corruption("expected size of at least 1MiB in rowset dump line",
+                                line);
+    }
+    string min_key, max_key, err;
+    if (!CUnescape(fields[1], &min_key, &err) ||
+        !CUnescape(fields[2], &max_key, &err)) {
+      return Status::Corruption(Substitute("bad key in rowset dump line: $0", err), line);
+    }
+    rowsets->emplace_back(std::make_shared<MockDiskRowSet>(
+        std::move(min_key), std::move(max_key), size_mb * kBytesPerMb));
+  }
+  return Status::OK();
+}
+
+void WriteRowSetDump(const vector<RowSetInfo>& infos, std::ostream* out) {
+  CHECK(out);
+  for (const auto& rsi : infos) {
+    if (!rsi.has_bounds()) continue;
+    *out << rsi.size_mb() << "\t" << CEscape(rsi.min_key())
+         << "\t" << CEscape(rsi.max_key()) << "\n";
+  }
+}
+
+void WriteRowSetDumpToFile(const vector<RowSetInfo>& infos) {
+  const string& pattern = FLAGS_compaction_policy_dump_rowsets_pattern;
+  if (pattern.empty()) {
+    return;
+  }
+  const string path = StringReplace(pattern,
+                                    "TIME",
+                                    StringPrintf("%ld", time(nullptr)),
+                                    /*replace_all=*/true);
+  std::ostringstream buf;
+  WriteRowSetDump(infos, &buf);
+  WARN_NOT_OK(WriteStringToFile(Env::Default(), buf.str(), path),
+              "unable to dump rowset layout to file");
+}
+
+Status SimulateCompactions(const RowSetVector& initial,
+                           const CompactionSimulationOptions& opts,
+                           CompactionPolicy* policy,
+                           CompactionSimulationResult* result) {
+  DCHECK(policy);
+  DCHECK(result);
+  *result = CompactionSimulationResult();
+
+  RowSetVector rowsets = initial;
+  double sum_average_height = 0.0;
+  for (int round = 0; round < opts.num_rounds; round++) {
+    // Flushed rowsets span the whole key range of the layout.
+    string min_key, max_key;
+    for (const auto& rs : rowsets) {
+      string rs_min, rs_max;
+      RETURN_NOT_OK(rs->GetBounds(&rs_min, &rs_max));
+      if (min_key.empty() || rs_min < min_key) min_key = std::move(rs_min);
+      if (rs_max > max_key) max_key = std::move(rs_max);
+    }
+    if (max_key.empty()) {
+      max_key = "\xff";
+    }
+    for (int i = 0; i < opts.flushes_per_round; i++) {
+      rowsets.push_back(std::make_shared<MockDiskRowSet>(min_key, max_key,
+                                                         opts.flush_size_bytes));
+      result->bytes_flushed += opts.flush_size_bytes;
+      policy->RecordBytesWritten(opts.flush_size_bytes, /*is_flush=*/true);
+    }
+
+    for (int i = 0; i < opts.max_compactions_per_round; i++) {
+      RowSetTree tree;
+      RETURN_NOT_OK(tree.Reset(rowsets));
+      CompactionSelection picked;
+      double quality = 0.0;
+      RETURN_NOT_OK(policy->PickRowSets(tree, &picked, &quality, /*log=*/nullptr));
+      if (picked.empty()) {
+        break;
+      }
+      uint64_t bytes_compacted = 0;
+      RETURN_NOT_OK(ApplyCompaction(picked, policy->target_rowset_size(),
+                                    &rowsets, &bytes_compacted));
+      result->bytes_compacted += bytes_compacted;
+      result->num_compactions++;
+      policy->RecordBytesWritten(bytes_compacted, /*is_flush=*/false);
+    }
+
+    double average_height = 0.0;
+    RETURN_NOT_OK(ComputeAverageHeight(rowsets, &average_height));
+    sum_average_height += average_height;
+    result->max_average_height = std::max(result->max_average_height, average_height);
+    result->final_average_height = average_height;
+  }
+  if (opts.num_rounds > 0) {
+    result->mean_average_height = sum_average_height / opts.num_rounds;
+  }
+  result->final_num_rowsets = rowsets.size();
+  return Status::OK();
+}
+
+} // namespace tablet
+} // namespace kudu
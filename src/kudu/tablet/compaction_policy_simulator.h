@@ -0,0 +1,103 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_COMPACTION_POLICY_SIMULATOR_H
+#define KUDU_TABLET_COMPACTION_POLICY_SIMULATOR_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "kudu/tablet/rowset.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace tablet {
+
+class CompactionPolicy;
+class RowSetInfo;
+
+// Offline simulation of a compaction policy over a tablet's rowset layout.
+//
+// The layout is given as a rowset dump: one rowset per line, formatted as
+// '<size in MiB>\t<min key>\t<max key>', with the keys C-escaped. Lines that
+// are empty or start with '#' are ignored. This is the format of
+// tablet/ycsb-test-rowsets.tsv and of the files written according to
+// --compaction_policy_dump_rowsets_pattern.
+//
+// The simulation runs a number of rounds. Each round flushes new rowsets
+// spanning the layout's whole key range, as random-key ingest would, and then
+// runs up to a number of compactions picked by the policy. A compaction
+// replaces its inputs with non-overlapping outputs of the policy's target
+// rowset size. No data is read or written.
+
+struct CompactionSimulationOptions {
+  // Number of rounds to simulate.
+  int num_rounds = 100;
+
+  // Number of rowsets flushed at the start of each round.
+  int flushes_per_round = 1;
+
+  // Size of each flushed rowset.
+  uint64_t flush_size_bytes = 32 * 1024 * 1024;
+
+  // Maximum number of compactions run in each round.
+  int max_compactions_per_round = 1;
+};
+
+struct CompactionSimulationResult {
+  uint64_t bytes_flushed = 0;
+  uint64_t bytes_compacted = 0;
+  int num_compactions = 0;
+
+  // The average rowset height at the end of the simulation, and the mean and
+  // maximum of the average height sampled at the end of each round.
+  double final_average_height = 0.0;
+  double mean_average_height = 0.0;
+  double max_average_height = 0.0;
+
+  // Number of rowsets at the end of the simulation.
+  int final_num_rowsets = 0;
+
+  // Bytes written by flushes and compactions per byte flushed.
+  double write_amplification() const;
+
+  std::string ToString() const;
+};
+
+// Parse the rowset dump in 'data' into mock rowsets, appending them to
+// 'rowsets'.
+Status ParseRowSetDump(const std::string& data, RowSetVector* rowsets);
+
+// Write 'infos' to 'out' in the rowset dump format.
+void WriteRowSetDump(const std::vector<RowSetInfo>& infos, std::ostream* out);
+
+// Like the above, but dumps to a file named according to the rules of
+// --compaction_policy_dump_rowsets_pattern. Does nothing if the flag is unset.
+void WriteRowSetDumpToFile(const std::vector<RowSetInfo>& infos);
+
+// Simulate 'policy' starting from the layout 'initial'. The policy must not
+// be shared with a live tablet: it is informed of every simulated flush and
+// compaction through CompactionPolicy::RecordBytesWritten().
+Status SimulateCompactions(const RowSetVector& initial,
+                           const CompactionSimulationOptions& opts,
+                           CompactionPolicy* policy,
+                           CompactionSimulationResult* result);
+
+} // namespace tablet
+} // namespace kudu
+#endif
@@ -46,9 +46,15 @@
 #include <algorithm>
 #include <boost/smart_ptr/detail/yield_k.hpp>
 #include <boost/utility/binary.hpp>
+#include <cstring>
 #include <memory>
 #include <string>
 
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
@@ -115,6 +121,7 @@ template<class Traits> class NodeBase;
 template<class Traits> class InternalNode;
 template<class Traits> class LeafNode;
 template<class Traits> class PreparedMutation;
+template<class Traits> struct MutationHint;
 template<class Traits> class CBTree;
 template<class Traits> class CBTreeIterator;
 
@@ -304,42 +311,89 @@ class ValueSlice {
   const uint8_t* ptr_;
 } PACKED;
 
+// Returns the order-preserving prefix of 'key' stored alongside each key in
+// the tree's nodes: the first 8 bytes of the key (zero-padded) read as a
+// big-endian integer, with the sign bit flipped so that signed comparison of
+// two prefixes agrees with memcmp() of the keys they came from. Keys with
+// different prefixes compare the same way as their prefixes; keys with equal
+// prefixes must be compared in full.
+inline int64_t KeyPrefix(const Slice &key) {
+  uint64_t v = 0;
+  memcpy(&v, key.data(), std::min<size_t>(key.size(), sizeof(v)));
+  return static_cast<int64_t>(BigEndian::ToHost64(v) ^ (1ULL << 63));
+}
+
+// Counts the entries of the sorted array 'prefixes' which are less than
+// 'prefix' (into 'num_lt') and less than or equal to it (into 'num_le').
+inline void CountKeyPrefixes(const int64_t *prefixes, size_t num_entries,
+                             int64_t prefix, size_t *num_lt, size_t *num_le) {
+  size_t lt = 0;
+  size_t le = 0;
+  size_t i = 0;
+#ifdef __SSE4_2__
+  const __m128i search = _mm_set1_epi64x(prefix);
+  for (; i + 2 <= num_entries; i += 2) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prefixes + i));
+    int lt_mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(search, v)));
+    int eq_mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(search, v)));
+    lt += __builtin_popcount(lt_mask);
+    le += __builtin_popcount(lt_mask | eq_mask);
+  }
+#endif
+  for (; i < num_entries; i++) {
+    lt += prefixes[i] < prefix;
+    le += prefixes[i] <= prefix;
+  }
+  *num_lt = lt;
+  *num_le = le;
+}
+
 // Return the index of the first entry in the array which is
-// >= the given value
+// >= the given value.
+//
+// 'prefixes' holds the KeyPrefix() of each entry of 'array'. The prefixes,
+// which are stored contiguously, narrow the search down to the entries that
+// share the key's prefix; only those are compared in full.
 template<size_t N>
-size_t FindInSliceArray(const InlineSlice<N, true> *array, ssize_t num_entries,
-                        const Slice &key, bool *exact) {
+size_t FindInSliceArray(const InlineSlice<N, true> *array, const int64_t *prefixes,
+                        ssize_t num_entries, const Slice &key, bool *exact) {
   DCHECK_GE(num_entries, 0);
 
+  *exact = false;
   if (PREDICT_FALSE(num_entries == 0)) {
-    *exact = false;
     return 0;
   }
 
-  size_t left = 0;
-  size_t right = num_entries - 1;
+  size_t left;
+  size_t right;
+  CountKeyPrefixes(prefixes, num_entries, KeyPrefix(key), &left, &right);
 
+  // Binary search for the first entry >= key amongst [left, right).
   while (left < right) {
-    int mid = (left + right + 1) / 2;
-    // TODO: inline slices with more than 8 bytes will store a prefix of the
-    // slice inline, which we could use to short circuit some of these comparisons.
+    size_t mid = (left + right) / 2;
     int compare = array[mid].as_slice().compare(key);
     if (compare < 0) { // mid < key
-      left = mid;
-    } else if (compare > 0) { // mid > search
-      right = mid - 1;
-    } else { // mid == search
+      left = mid + 1;
+    } else if (compare > 0) { // mid > key
+      right = mid;
+    } else { // mid == key
       *exact = true;
       return mid;
     }
   }
+  return left;
+}
 
-  int compare = array[left].as_slice().compare(key);
-  *exact = compare == 0;
-  if (compare < 0) { // key > left
-    left++;
+// Makes room for a new key prefix at index 'idx' of 'prefixes' (which holds
+// 'num_entries' entries, including the new one) and stores the prefix of
+// 'key' there.
+inline void InsertInKeyPrefixArray(int64_t *prefixes, size_t num_entries,
+                                   const Slice &key, size_t idx) {
+  DCHECK_LT(idx, num_entries);
+  for (size_t i = num_entries - 1; i > idx; i--) {
+    prefixes[i] = prefixes[i - 1];
   }
-  return left;
+  prefixes[idx] = KeyPrefix(key);
 }
 
 
@@ -528,6 +582,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
     VersionField::SetLockedInsertingNoBarrier(&this->version_);
 
     keys_[0].set(split_key, arena);
+    key_prefixes_[0] = KeyPrefix(split_key);
     DCHECK_GT(split_key.size(), 0);
     child_pointers_[0] = lchild;
     child_pointers_[1] = rchild;
@@ -563,6 +618,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
     // Insert the key and child pointer in the right spot in the list
     int new_num_children = num_children_ + 1;
     InsertInSliceArray(keys_, new_num_children, key, idx, arena);
+    InsertInKeyPrefixArray(key_prefixes_, new_num_children, key, idx);
     for (int i = new_num_children - 1; i > idx + 1; i--) {
       child_pointers_[i] = child_pointers_[i - 1];
     }
@@ -580,7 +636,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
   // For example, if the key is less than the first discriminating
   // node, returns 0. If it is between 0 and 1, returns 1, etc.
   size_t Find(const Slice &key, bool *exact) {
-    return FindInSliceArray(keys_, key_count(), key, exact);
+    return FindInSliceArray(keys_, key_prefixes_, key_count(), key, exact);
   }
 
   // Find the child whose subtree may contain the given key.
@@ -657,11 +713,13 @@ class PACKED InternalNode : public NodeBase<Traits> {
     constant_overhead = sizeof(NodeBase<Traits>) // base class
                       + sizeof(uint32_t), // num_children_
     keyptr_space = Traits::kInternalNodeSize - constant_overhead,
-    kFanout = keyptr_space / (sizeof(KeyInlineSlice) + sizeof(NodePtr<Traits>))
+    kFanout = keyptr_space / (sizeof(int64_t) + sizeof(KeyInlineSlice) + sizeof(NodePtr<Traits>))
   };
 
   // This ordering of members ensures KeyInlineSlices are properly aligned
-  // for atomic ops
+  // for atomic ops. The key prefixes come first, since every search starts
+  // by scanning them.
+  int64_t key_prefixes_[kFanout];
   KeyInlineSlice keys_[kFanout];
   NodePtr<Traits> child_pointers_[kFanout];
   uint32_t num_children_;
@@ -695,6 +753,24 @@ class LeafNode : public NodeBase<Traits> {
     ret->idx_ = Find(ret->key(), &ret->exists_);
   }
 
+  // Return true if 'key' is known to fall within the range of keys routed to
+  // this leaf node, i.e. it is no less than this node's first key and less
+  // than the first key of its right sibling, if any.
+  //
+  // This relies on the first key of any leaf other than the leftmost one being
+  // the separator it was split off at: later insertions into a leaf are never
+  // less than that separator, and splits only move trailing entries out.
+  //
+  // The caller must hold this node's lock, which prevents this node from
+  // splitting and its 'next_' pointer from changing.
+  bool CoversKey(const Slice &key) const {
+    DCHECK(this->IsLocked());
+    if (PREDICT_FALSE(num_entries_ == 0) || key.compare(GetKey(0)) < 0) {
+      return false;
+    }
+    return next_ == NULL || key.compare(next_->GetKey(0)) < 0;
+  }
+
   // Insert a new entry into this leaf node.
   InsertStatus Insert(PreparedMutation<Traits> *mut, const Slice &val) {
     DCHECK_EQ(this, mut->leaf());
@@ -724,6 +800,7 @@ class LeafNode : public NodeBase<Traits> {
     // verified that there is space available above.
     num_entries_++;
     InsertInSliceArray(keys_, num_entries_, key, idx, arena);
+    InsertInKeyPrefixArray(key_prefixes_, num_entries_, key, idx);
     DebugRacyPoint<Traits>();
     InsertInSliceArray(vals_, num_entries_, val, idx, arena);
 
@@ -739,7 +816,7 @@ class LeafNode : public NodeBase<Traits> {
   // Note that, if the lock is not held, this may return
   // bogus results, in which case OCC must be used to verify.
   size_t Find(const Slice &key, bool *exact) const {
-    return FindInSliceArray(keys_, num_entries_, key, exact);
+    return FindInSliceArray(keys_, key_prefixes_, num_entries_, key, exact);
   }
 
   // Get the slice corresponding to the nth key.
@@ -810,11 +887,12 @@ class LeafNode : public NodeBase<Traits> {
                         + sizeof(LeafNode<Traits>*) // next_
                         + sizeof(uint8_t), // num_entries_
     kv_space = Traits::kLeafNodeSize - constant_overhead,
-    kMaxEntries = kv_space / (sizeof(KeyInlineSlice) + sizeof(ValueSlice))
+    kMaxEntries = kv_space / (sizeof(int64_t) + sizeof(KeyInlineSlice) + sizeof(ValueSlice))
   };
 
   // This ordering of members keeps KeyInlineSlices so pointers are aligned
   LeafNode<Traits>* next_;
+  int64_t key_prefixes_[kMaxEntries];
   KeyInlineSlice keys_[kMaxEntries];
   ValueSlice vals_[kMaxEntries];
   uint8_t num_entries_;
@@ -864,6 +942,25 @@ class PreparedMutation {
     needs_unlock_ = true;
   }
 
+  // Like the above, but first tries the leaf node recorded in 'hint' by a
+  // previous mutation against the same tree, falling back to a traversal from
+  // the root if it doesn't cover this mutation's key. Records the prepared
+  // leaf node back into 'hint'.
+  //
+  // Preparing a sequence of mutations in increasing key order with the same
+  // hint usually avoids most of the traversals.
+  void Prepare(CBTree<Traits> *tree, MutationHint<Traits> *hint) {
+    debug::ScopedTSANIgnoreReadsAndWrites ignore_tsan;
+    CHECK(!prepared());
+    DCHECK(hint->tree == NULL || hint->tree == tree);
+    this->tree_ = tree;
+    this->arena_ = tree->arena_.get();
+    tree->PrepareMutation(this, hint->leaf);
+    needs_unlock_ = true;
+    hint->tree = tree;
+    hint->leaf = leaf_;
+  }
+
   bool Insert(const Slice &val) {
     CHECK(prepared());
     return tree_->Insert(this, val);
@@ -949,6 +1046,20 @@ class PreparedMutation {
 };
 
 
+// Remembers the leaf node that a PreparedMutation was prepared against, for
+// use as a starting point by the next mutation of a nearby key. See
+// PreparedMutation::Prepare().
+//
+// Leaf nodes are never freed before their tree is, so a hint remains safe to
+// use for as long as the tree it refers to.
+template<class Traits>
+struct MutationHint {
+  MutationHint() : tree(NULL), leaf(NULL) {}
+
+  CBTree<Traits> *tree;
+  LeafNode<Traits> *leaf;
+};
+
 template<class Traits = BTreeTraits>
 class CBTree {
  public:
@@ -1270,8 +1381,17 @@ class CBTree {
     }
   }
 
-  void PrepareMutation(PreparedMutation<Traits> *mutation) {
+  void PrepareMutation(PreparedMutation<Traits> *mutation,
+                       LeafNode<Traits> *hint_leaf = NULL) {
     DCHECK_EQ(mutation->tree(), this);
+    if (hint_leaf != NULL) {
+      hint_leaf->Lock();
+      if (hint_leaf->CoversKey(mutation->key())) {
+        hint_leaf->PrepareMutation(mutation);
+        return;
+      }
+      hint_leaf->Unlock();
+    }
     while (true) {
       AtomicVersion stable_version;
       LeafNode<Traits> *lnode = TraverseToLeaf(mutation->key(), &stable_version);
@@ -1442,6 +1562,8 @@ class CBTree {
     CHECK_GT(copy_start, 0) <<
       "Trying to split a node with 0 or 1 entries";
 
+    std::copy(node->key_prefixes_ + copy_start, node->key_prefixes_ + node->num_entries(),
+              new_leaf->key_prefixes_);
     std::copy(node->keys_ + copy_start, node->keys_ + node->num_entries(),
               new_leaf->keys_);
     std::copy(node->vals_ + copy_start, node->vals_ + node->num_entries(),
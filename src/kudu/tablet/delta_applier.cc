@@ -119,7 +119,10 @@ Status DeltaApplier::InitializeSelectionVector(SelectionVector *sel_vec) {
     sel_vec->SetAllFalse();
     RETURN_NOT_OK(delta_iter_->SelectUpdates(sel_vec));
   } else {
-    RETURN_NOT_OK(base_iter_->InitializeSelectionVector(sel_vec));
+    // Zone maps only describe the base data, so they can only be used to
+    // skip rows to which no deltas apply.
+    RETURN_NOT_OK(base_iter_->InitializeSelectionVector(
+        sel_vec, /*use_zone_maps=*/!delta_iter_->MayHaveDeltas()));
   }
   if (!opts_.include_deleted_rows) {
     RETURN_NOT_OK(delta_iter_->ApplyDeletes(sel_vec));
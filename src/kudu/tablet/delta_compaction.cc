@@ -267,7 +267,8 @@ Status MajorDeltaCompaction::OpenBaseDataWriter() {
 
   gscoped_ptr<MultiColumnWriter> w(new MultiColumnWriter(fs_manager_,
                                                          &partial_schema_,
-                                                         tablet_id_));
+                                                         tablet_id_,
+                                                         fs::IOClass::COMPACTION));
   RETURN_NOT_OK(w->Open());
   base_data_writer_.swap(w);
   return Status::OK();
@@ -275,7 +276,7 @@ Status MajorDeltaCompaction::OpenBaseDataWriter() {
 
 Status MajorDeltaCompaction::OpenRedoDeltaFileWriter() {
   unique_ptr<WritableBlock> block;
-  CreateBlockOptions opts({ tablet_id_ });
+  CreateBlockOptions opts({ tablet_id_, fs::IOClass::COMPACTION });
   RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(opts, &block),
                         "Unable to create REDO delta output block");
   new_redo_delta_block_ = block->id();
@@ -285,7 +286,7 @@ Status MajorDeltaCompaction::OpenRedoDeltaFileWriter() {
 
 Status MajorDeltaCompaction::OpenUndoDeltaFileWriter() {
   unique_ptr<WritableBlock> block;
-  CreateBlockOptions opts({ tablet_id_ });
+  CreateBlockOptions opts({ tablet_id_, fs::IOClass::COMPACTION });
   RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(opts, &block),
                         "Unable to create UNDO delta output block");
   new_undo_delta_block_ = block->id();
@@ -352,8 +353,11 @@ void MajorDeltaCompaction::CreateMetadataUpdate(
     new_delta_blocks.push_back(new_redo_delta_block_);
   }
 
-  update->ReplaceRedoDeltaBlocks(compacted_delta_blocks,
-                                 new_delta_blocks);
+  // The compaction may not have needed any of the REDO stores.
+  if (!compacted_delta_blocks.empty()) {
+    update->ReplaceRedoDeltaBlocks(compacted_delta_blocks,
+                                   new_delta_blocks);
+  }
 
   if (undo_delta_mutations_written_ > 0) {
     update->SetNewUndoBlock(new_undo_delta_block_);
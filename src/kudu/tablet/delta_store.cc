@@ -258,16 +258,43 @@ Status DeltaPreparer<Traits>::ApplyUpdates(size_t col_to_apply, ColumnBlock* dst
     return Status::OK();
   }
 
+  const UpdatesForColumn& updates = updates_by_col_[col_to_apply];
+  if (updates.empty()) {
+    return Status::OK();
+  }
+
   const ColumnSchema* col_schema = &opts_.projection->column(col_to_apply);
-  for (const ColumnUpdate& cu : updates_by_col_[col_to_apply]) {
+  if (col_schema->type_info()->physical_type() == BINARY) {
+    // Slices must be relocated into the destination arena.
+    for (const ColumnUpdate& cu : updates) {
+      int32_t idx_in_block = cu.row_id - prev_prepared_idx_;
+      DCHECK_GE(idx_in_block, 0);
+      if (!filter.IsRowSelected(idx_in_block)) {
+        continue;
+      }
+      SimpleConstCell src(col_schema, cu.new_val_ptr);
+      ColumnBlock::Cell dst_cell = dst->cell(idx_in_block);
+      RETURN_NOT_OK(CopyCell(src, &dst_cell, dst->arena()));
+    }
+    return Status::OK();
+  }
+
+  // Fixed-width values are copied straight into the column block, with the
+  // type and nullability dispatch hoisted out of the loop.
+  const bool nullable = col_schema->is_nullable();
+  for (const ColumnUpdate& cu : updates) {
     int32_t idx_in_block = cu.row_id - prev_prepared_idx_;
     DCHECK_GE(idx_in_block, 0);
     if (!filter.IsRowSelected(idx_in_block)) {
       continue;
     }
-    SimpleConstCell src(col_schema, cu.new_val_ptr);
-    ColumnBlock::Cell dst_cell = dst->cell(idx_in_block);
-    RETURN_NOT_OK(CopyCell(src, &dst_cell, dst->arena()));
+    if (nullable) {
+      dst->SetCellIsNull(idx_in_block, cu.new_val_ptr == nullptr);
+      if (cu.new_val_ptr == nullptr) {
+        continue;
+      }
+    }
+    dst->SetCellValue(idx_in_block, cu.new_val_ptr);
   }
 
   return Status::OK();
@@ -389,7 +389,8 @@ Status DeltaTracker::CompactStores(const IOContext* io_context, int start_idx, i
   // Open a writer for the new destination delta block
   FsManager* fs = rowset_metadata_->fs_manager();
   unique_ptr<WritableBlock> block;
-  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id() });
+  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id(),
+                            fs::IOClass::COMPACTION });
   RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &block),
                         "Could not allocate delta block");
   BlockId new_block_id(block->id());
@@ -419,11 +420,13 @@ Status DeltaTracker::EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancie
                                                                  int64_t* bytes) {
   DCHECK_NE(Timestamp::kInvalidTimestamp, ancient_history_mark);
   DCHECK(bytes);
-  SharedDeltaStoreVector undos_newest_first;
-  CollectStores(&undos_newest_first, UNDOS_ONLY);
 
+  // Walk the stores in place rather than copying them all out, since only
+  // the oldest ones are of interest.
   int64_t tmp_bytes = 0;
-  for (const auto& undo : boost::adaptors::reverse(undos_newest_first)) {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  for (auto it = undo_delta_stores_.rbegin(); it != undo_delta_stores_.rend(); ++it) {
+    const auto& undo = *it;
     // Short-circuit once we hit an initialized delta block with 'max_timestamp' > AHM.
     if (undo->Initted() &&
         undo->delta_stats().max_timestamp() >= ancient_history_mark) {
@@ -436,6 +439,26 @@ Status DeltaTracker::EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancie
   return Status::OK();
 }
 
+bool DeltaTracker::HasAncientUndoDeltas(Timestamp ancient_history_mark) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  if (undo_delta_stores_.empty()) {
+    return false;
+  }
+  const auto& oldest = undo_delta_stores_.back();
+  return oldest->Initted() && oldest->delta_stats().max_timestamp() < ancient_history_mark;
+}
+
+void DeltaTracker::CollectAncientUndoDeltas(Timestamp ancient_history_mark,
+                                            SharedDeltaStoreVector* undos_oldest_first) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  for (auto it = undo_delta_stores_.rbegin(); it != undo_delta_stores_.rend(); ++it) {
+    const auto& undo = *it;
+    if (!undo->Initted()) break; // Never initialize the deltas in this code path (it's slow).
+    if (undo->delta_stats().max_timestamp() >= ancient_history_mark) break;
+    undos_oldest_first->push_back(undo);
+  }
+}
+
 Status DeltaTracker::InitUndoDeltas(Timestamp ancient_history_mark,
                                     MonoTime deadline,
                                     const IOContext* io_context,
@@ -482,37 +505,23 @@ Status DeltaTracker::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
   std::lock_guard<Mutex> l(compact_flush_lock_);
   RETURN_NOT_OK(CheckWritableUnlocked());
 
-  // Get the list of undo deltas.
-  SharedDeltaStoreVector undos_newest_first;
-  CollectStores(&undos_newest_first, UNDOS_ONLY);
-
-  if (undos_newest_first.empty()) {
-    *blocks_deleted = 0;
-    *bytes_deleted = 0;
-    return Status::OK();
-  }
-
+  // Get the ancient undo deltas, oldest first.
   SharedDeltaStoreVector undos_to_remove;
-  vector<BlockId> block_ids_to_remove;
+  CollectAncientUndoDeltas(ancient_history_mark, &undos_to_remove);
 
+  vector<BlockId> block_ids_to_remove;
   int64_t tmp_blocks_deleted = 0;
   int64_t tmp_bytes_deleted = 0;
-
-  // Traverse oldest-first.
-  for (auto& undo : boost::adaptors::reverse(undos_newest_first)) {
-    if (!undo->Initted()) break; // Never initialize the deltas in this code path (it's slow).
-    if (undo->delta_stats().max_timestamp() >= ancient_history_mark) break;
+  for (const auto& undo : undos_to_remove) {
     tmp_blocks_deleted++;
     tmp_bytes_deleted += undo->EstimateSize();
     // This is always a safe downcast because UNDO deltas are always on disk.
     block_ids_to_remove.push_back(down_cast<DeltaFileReader*>(undo.get())->block_id());
-    undos_to_remove.push_back(std::move(undo));
   }
-  undos_newest_first.clear(); // We did a std::move() on some elements from this vector above.
 
   // Only flush the rowset metadata if we are going to modify it.
   if (!undos_to_remove.empty()) {
-    // We iterated in reverse order and CommitDeltaStoreMetadataUpdate() requires storage order.
+    // We collected them oldest first and CommitDeltaStoreMetadataUpdate() requires storage order.
     std::reverse(undos_to_remove.begin(), undos_to_remove.end());
     RowSetMetadataUpdate update;
     update.RemoveUndoDeltaBlocks(block_ids_to_remove);
@@ -601,6 +610,62 @@ Status DeltaTracker::NewDeltaFileIterator(
   return DeltaIteratorMerger::Create(*included_stores, opts, out);
 }
 
+namespace {
+
+// Returns whether major compacting the columns 'col_ids' may need the deltas
+// of 'store'. Stores which haven't been initialized are assumed to.
+bool StoreAffectsColumns(DeltaStore* store, const vector<ColumnId>& col_ids) {
+  if (!store->Initted()) {
+    return true;
+  }
+  const DeltaStats& stats = store->delta_stats();
+  if (stats.delete_count() > 0 || stats.reinsert_count() > 0) {
+    return true;
+  }
+  for (ColumnId col_id : col_ids) {
+    if (stats.update_count_for_col_id(col_id) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+Status DeltaTracker::NewMajorCompactionDeltaIterator(
+    const RowIteratorOptions& opts,
+    const vector<ColumnId>& col_ids,
+    vector<shared_ptr<DeltaStore>>* included_stores,
+    unique_ptr<DeltaIterator>* out) const {
+  vector<shared_ptr<DeltaStore>> stores;
+  {
+    std::lock_guard<rw_spinlock> lock(component_lock_);
+    stores = redo_delta_stores_;
+  }
+
+  // Only the ends of the list are trimmed, since the compacted stores are
+  // replaced by a single one in their place.
+  auto first = stores.begin();
+  while (first != stores.end() && !StoreAffectsColumns(first->get(), col_ids)) {
+    ++first;
+  }
+  auto last = stores.end();
+  while (last != first && !StoreAffectsColumns((last - 1)->get(), col_ids)) {
+    --last;
+  }
+  size_t num_skipped = stores.size() - (last - first);
+  if (num_skipped > 0) {
+    VLOG_WITH_PREFIX(1) << "Leaving " << num_skipped << " of " << stores.size()
+                        << " REDO delta stores out of major delta compaction";
+  }
+  included_stores->assign(first, last);
+
+  for (const shared_ptr<DeltaStore>& store : *included_stores) {
+    ignore_result(down_cast<DeltaFileReader*>(store.get()));
+  }
+  return DeltaIteratorMerger::Create(*included_stores, opts, out);
+}
+
 Status DeltaTracker::WrapIterator(const shared_ptr<CFileSet::Iterator> &base,
                                   const RowIteratorOptions& opts,
                                   gscoped_ptr<ColumnwiseIterator>* out) const {
@@ -661,7 +726,8 @@ Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
   // Open file for write.
   FsManager* fs = rowset_metadata_->fs_manager();
   unique_ptr<WritableBlock> writable_block;
-  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id() });
+  CreateBlockOptions opts({ rowset_metadata_->tablet_metadata()->tablet_id(),
+                            fs::IOClass::FLUSH });
   RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &writable_block),
                         "Unable to allocate new delta data writable_block");
   BlockId block_id(writable_block->id());
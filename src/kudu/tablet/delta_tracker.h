@@ -126,6 +126,18 @@ class DeltaTracker {
       std::vector<std::shared_ptr<DeltaStore>>* included_stores,
       std::unique_ptr<DeltaIterator>* out) const;
 
+  // Like NewDeltaFileIterator() over the REDO stores, but for a major delta
+  // compaction of the columns 'col_ids': the stores at either end of the list
+  // which can't affect those columns, because their stats show no updates to
+  // them and no deletes or reinserts, are left out, so that the compaction
+  // neither decodes nor rewrites their deltas. The included stores are always
+  // a contiguous range of the REDO stores, and may be empty.
+  Status NewMajorCompactionDeltaIterator(
+      const RowIteratorOptions& opts,
+      const std::vector<ColumnId>& col_ids,
+      std::vector<std::shared_ptr<DeltaStore>>* included_stores,
+      std::unique_ptr<DeltaIterator>* out) const;
+
   // Flushes the current DeltaMemStore and replaces it with a new one.
   // Caller selects whether to also have the RowSetMetadata (and consequently
   // the TabletMetadata) flushed.
@@ -177,6 +189,9 @@ class DeltaTracker {
   Status EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark,
                                                      int64_t* bytes);
 
+  // See RowSet::HasAncientUndoDeltas().
+  bool HasAncientUndoDeltas(Timestamp ancient_history_mark) const;
+
   // See RowSet::InitUndoDeltas().
   Status InitUndoDeltas(Timestamp ancient_history_mark,
                         MonoTime deadline,
@@ -280,6 +295,13 @@ class DeltaTracker {
   void CollectStores(std::vector<std::shared_ptr<DeltaStore>>* stores,
                      WhichStores which) const;
 
+  // Collects the initialized undo delta stores with a max timestamp earlier
+  // than 'ancient_history_mark', oldest first. Since the undo delta stores are
+  // kept in decreasing timestamp order, these are at the end of
+  // 'undo_delta_stores_', and only they are visited.
+  void CollectAncientUndoDeltas(Timestamp ancient_history_mark,
+                                SharedDeltaStoreVector* undos_oldest_first) const;
+
   // Performs the actual compaction. Results of compaction are written to "block",
   // while delta stores that underwent compaction are appended to "compacted_stores", while
   // their corresponding block ids are appended to "compacted_blocks".
@@ -405,6 +405,47 @@ TEST_F(TestDeltaFile, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Tests that an apply-only scan of a projection untouched by the file's
+// deltas, as reported by the delta stats, doesn't read any delta blocks.
+TEST_F(TestDeltaFile, TestSkipsDecodingForUnupdatedProjection) {
+  WriteTestFile();
+
+  unique_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(test_block_, &block));
+  size_t bytes_read = 0;
+  unique_ptr<ReadableBlock> count_block(
+      new CountingReadableBlock(std::move(block), &bytes_read));
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(DeltaFileReader::Open(
+      std::move(count_block), REDO, ReaderOptions(), &reader));
+
+  // Project a column other than the one that was updated.
+  Schema projection({ ColumnSchema("other", UINT32) },
+                    { ColumnId(schema_.column_id(0) + 1) }, 0);
+  RowIteratorOptions opts;
+  opts.snap_to_include = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+  opts.projection = &projection;
+  DeltaIterator* raw_iter;
+  ASSERT_OK(reader->NewDeltaIterator(opts, &raw_iter));
+  gscoped_ptr<DeltaIterator> it(raw_iter);
+  ASSERT_OK(it->Init(nullptr));
+  ASSERT_OK(it->SeekToOrdinal(0));
+  size_t bytes_read_after_seek = bytes_read;
+
+  RowBlock rb(projection, 100, &arena_);
+  for (int start_row = 0; start_row < FLAGS_last_row_to_update; start_row += rb.nrows()) {
+    ASSERT_OK(it->PrepareBatch(rb.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+    ASSERT_FALSE(it->MayHaveDeltas());
+    SelectionVector sv(rb.nrows());
+    sv.SetAllTrue();
+    ASSERT_OK(it->ApplyDeletes(&sv));
+    ASSERT_EQ(rb.nrows(), sv.CountSelected());
+    ColumnBlock dst_col = rb.column_block(0);
+    ASSERT_OK(it->ApplyUpdates(0, &dst_col, sv));
+  }
+  ASSERT_EQ(bytes_read_after_seek, bytes_read);
+}
+
 // Check that, if a delta file is opened but no deltas are written,
 // Finish() will return Status::Aborted().
 TEST_F(TestDeltaFile, TestEmptyFileIsAborted) {
@@ -45,6 +45,7 @@
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/delta_relevancy.h"
+#include "kudu/tablet/delta_stats.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/tablet.pb.h"
@@ -418,6 +419,7 @@ DeltaFileIterator<Type>::DeltaFileIterator(shared_ptr<DeltaFileReader> dfr,
       prepared_(false),
       exhausted_(false),
       initted_(false),
+      projection_may_have_deltas_(true),
       cache_blocks_(CFileReader::CACHE_BLOCK) {}
 
 template<DeltaType Type>
@@ -450,6 +452,7 @@ Status DeltaFileIterator<Type>::SeekToOrdinal(rowid_t idx) {
     delta_blocks_.clear();
     return Status::OK();
   }
+  projection_may_have_deltas_ = ProjectionMayHaveDeltas();
 
   if (!index_iter_) {
     index_iter_.reset(IndexTreeIterator::Create(
@@ -550,6 +553,17 @@ Status DeltaFileIterator<Type>::PrepareBatch(size_t nrows, int prepare_flags) {
 
   CHECK_GT(nrows, 0);
 
+  // If the stats say that nothing in this file touches the projection, there's
+  // no need to read or decode any delta blocks for an apply-only batch. Any
+  // blocks already queued are dropped lazily by a later non-apply batch.
+  if (prepare_flags == DeltaIterator::PREPARE_FOR_APPLY &&
+      !projection_may_have_deltas_) {
+    prepared_ = true;
+    preparer_.Start(nrows, prepare_flags);
+    preparer_.Finish(nrows);
+    return Status::OK();
+  }
+
   rowid_t start_row = preparer_.cur_prepared_idx();
   rowid_t stop_row = start_row + nrows - 1;
 
@@ -672,6 +686,24 @@ Status DeltaFileIterator<Type>::AddDeltas(rowid_t start_row, rowid_t stop_row) {
   return Status::OK();
 }
 
+template<DeltaType Type>
+bool DeltaFileIterator<Type>::ProjectionMayHaveDeltas() const {
+  const DeltaStats& stats = dfr_->delta_stats();
+  if (stats.delete_count() > 0 || stats.reinsert_count() > 0) {
+    return true;
+  }
+  const Schema* projection = preparer_.opts().projection;
+  if (!projection->has_column_ids()) {
+    return true;
+  }
+  for (int i = 0; i < projection->num_columns(); i++) {
+    if (stats.update_count_for_col_id(projection->column_id(i)) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 template<DeltaType Type>
 Status DeltaFileIterator<Type>::ApplyUpdates(size_t col_to_apply, ColumnBlock* dst,
                                              const SelectionVector& filter) {
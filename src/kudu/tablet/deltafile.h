@@ -310,6 +310,12 @@ class DeltaFileIterator : public DeltaIterator {
 
   Status AddDeltas(rowid_t start_row, rowid_t stop_row);
 
+  // Returns whether, according to the delta file's stats, any delta in the
+  // file could affect a PREPARE_FOR_APPLY batch of the iterator's projection:
+  // that is, whether the file contains any deletes, reinserts, or updates to
+  // a projected column.
+  bool ProjectionMayHaveDeltas() const;
+
   // Log a FATAL error message about a bad delta.
   void FatalUnexpectedDelta(const DeltaKey &key, const Slice &deltas,
                             const std::string &msg);
@@ -324,6 +330,10 @@ class DeltaFileIterator : public DeltaIterator {
   bool exhausted_;
   bool initted_;
 
+  // Result of ProjectionMayHaveDeltas(), computed in SeekToOrdinal(). When
+  // false, apply-only batches skip reading and decoding delta blocks entirely.
+  bool projection_may_have_deltas_;
+
   // After PrepareBatch(), the set of delta blocks in the delta file
   // which correspond to prepared_block_.
   std::deque<std::unique_ptr<PreparedDeltaBlock>> delta_blocks_;
@@ -73,12 +73,16 @@ DeltaMemStore::DeltaMemStore(int64_t id,
   : id_(id),
     rs_id_(rs_id),
     allocator_(new MemoryTrackingBufferAllocator(
-        HeapBufferAllocator::Get(), std::move(parent_tracker))),
+        ArenaChunkPool::GetOrHeapAllocator(), std::move(parent_tracker))),
     arena_(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, allocator_)),
     tree_(arena_),
     anchorer_(log_anchor_registry,
               Substitute("Rowset-$0/DeltaMemStore-$1", rs_id_, id_)),
     disambiguator_sequence_number_(0) {
+  if (ArenaChunkPool::enabled()) {
+    // Once past the first few small buffers, grow by whole pooled chunks.
+    arena_->SetMaxBufferSize(ArenaChunkPool::kChunkSize);
+  }
 }
 
 Status DeltaMemStore::Init(const IOContext* /*io_context*/) {
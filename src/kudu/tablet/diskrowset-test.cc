@@ -640,11 +640,19 @@ TEST_F(TestRowSet, TestGCAncientStores) {
   ASSERT_EQ(0, dt->CountUndoDeltaStores());
   ASSERT_EQ(1, dt->CountRedoDeltaStores());
 
+  ASSERT_FALSE(rs->HasAncientUndoDeltas(clock_->Now()));
+
   // Convert the REDO delta to an UNDO delta.
   ASSERT_OK(rs->MajorCompactDeltaStores(nullptr, HistoryGcOpts::Disabled()));
   ASSERT_EQ(1, dt->CountUndoDeltaStores()); // From doing the major delta compaction.
   ASSERT_EQ(0, dt->CountRedoDeltaStores());
 
+  // The UNDO delta is only ancient as of a later time than its updates.
+  ASSERT_TRUE(rs->HasAncientUndoDeltas(clock_->Now()));
+  ASSERT_FALSE(rs->HasAncientUndoDeltas(Timestamp(1)));
+  ASSERT_OK(dt->DeleteAncientUndoDeltas(Timestamp(1), nullptr, nullptr, nullptr));
+  ASSERT_EQ(1, dt->CountUndoDeltaStores());
+
   // Delete all the UNDO deltas. There shouldn't be any delta stores left.
   int64_t blocks_deleted;
   int64_t bytes_deleted;
@@ -653,6 +661,7 @@ TEST_F(TestRowSet, TestGCAncientStores) {
   ASSERT_GT(bytes_deleted, 0);
   ASSERT_EQ(0, dt->CountUndoDeltaStores());
   ASSERT_EQ(0, dt->CountRedoDeltaStores());
+  ASSERT_FALSE(rs->HasAncientUndoDeltas(clock_->Now()));
 }
 
 TEST_F(TestRowSet, TestDiskSizeEstimation) {
@@ -107,10 +107,12 @@ const char *DiskRowSet::kMaxKeyMetaEntryName = "max_key";
 
 DiskRowSetWriter::DiskRowSetWriter(RowSetMetadata* rowset_metadata,
                                    const Schema* schema,
-                                   BloomFilterSizing bloom_sizing)
+                                   BloomFilterSizing bloom_sizing,
+                                   fs::IOClass io_class)
     : rowset_metadata_(rowset_metadata),
       schema_(schema),
       bloom_sizing_(bloom_sizing),
+      io_class_(io_class),
       finished_(false),
       written_count_(0) {
   CHECK(schema->has_column_ids());
@@ -121,7 +123,7 @@ Status DiskRowSetWriter::Open() {
 
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  col_writer_.reset(new MultiColumnWriter(fs, schema_, tablet_id));
+  col_writer_.reset(new MultiColumnWriter(fs, schema_, tablet_id, io_class_));
   RETURN_NOT_OK(col_writer_->Open());
 
   // Open bloom filter.
@@ -140,7 +142,7 @@ Status DiskRowSetWriter::InitBloomFileWriter() {
   unique_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id }),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id, io_class_ }),
                                            &block),
                         "Couldn't allocate a block for bloom filter");
   rowset_metadata_->set_bloom_block(block->id());
@@ -155,7 +157,7 @@ Status DiskRowSetWriter::InitAdHocIndexWriter() {
   unique_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
   const string& tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id }),
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(CreateBlockOptions({ tablet_id, io_class_ }),
                                            &block),
                         "Couldn't allocate a block for compoound index");
 
@@ -320,12 +322,14 @@ DiskRowSetWriter::~DiskRowSetWriter() {
 
 RollingDiskRowSetWriter::RollingDiskRowSetWriter(
     TabletMetadata* tablet_metadata, const Schema& schema,
-    BloomFilterSizing bloom_sizing, size_t target_rowset_size)
+    BloomFilterSizing bloom_sizing, size_t target_rowset_size,
+    fs::IOClass io_class)
     : state_(kInitialized),
       tablet_metadata_(DCHECK_NOTNULL(tablet_metadata)),
       schema_(schema),
       bloom_sizing_(bloom_sizing),
       target_rowset_size_(target_rowset_size),
+      io_class_(io_class),
       row_idx_in_cur_drs_(0),
       can_roll_(false),
       written_count_(0),
@@ -351,16 +355,16 @@ Status RollingDiskRowSetWriter::RollWriter() {
 
   RETURN_NOT_OK(tablet_metadata_->CreateRowSet(&cur_drs_metadata_));
 
-  cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_));
+  cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_,
+                                         io_class_));
   RETURN_NOT_OK(cur_writer_->Open());
 
   FsManager* fs = tablet_metadata_->fs_manager();
   unique_ptr<WritableBlock> undo_data_block;
   unique_ptr<WritableBlock> redo_data_block;
-  RETURN_NOT_OK(fs->CreateNewBlock(CreateBlockOptions({ tablet_metadata_->tablet_id() }),
-                                   &undo_data_block));
-  RETURN_NOT_OK(fs->CreateNewBlock(CreateBlockOptions({ tablet_metadata_->tablet_id() }),
-                                   &redo_data_block));
+  const CreateBlockOptions block_opts({ tablet_metadata_->tablet_id(), io_class_ });
+  RETURN_NOT_OK(fs->CreateNewBlock(block_opts, &undo_data_block));
+  RETURN_NOT_OK(fs->CreateNewBlock(block_opts, &redo_data_block));
   cur_undo_ds_block_id_ = undo_data_block->id();
   cur_redo_ds_block_id_ = redo_data_block->id();
   cur_undo_writer_.reset(new DeltaFileWriter(std::move(undo_data_block)));
@@ -529,7 +533,8 @@ DiskRowSet::DiskRowSet(shared_ptr<RowSetMetadata> rowset_metadata,
       log_anchor_registry_(log_anchor_registry),
       mem_trackers_(std::move(mem_trackers)),
       num_rows_(-1),
-      has_been_compacted_(false) {}
+      has_been_compacted_(false),
+      read_count_(0) {}
 
 Status DiskRowSet::Open(const IOContext* io_context) {
   TRACE_EVENT0("tablet", "DiskRowSet::Open");
@@ -641,8 +646,8 @@ Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
   opts.io_context = io_context;
   vector<shared_ptr<DeltaStore>> included_stores;
   unique_ptr<DeltaIterator> delta_iter;
-  RETURN_NOT_OK(delta_tracker_->NewDeltaFileIterator(
-      opts, REDO, &included_stores, &delta_iter));
+  RETURN_NOT_OK(delta_tracker_->NewMajorCompactionDeltaIterator(
+      opts, col_ids, &included_stores, &delta_iter));
 
   out->reset(new MajorDeltaCompaction(rowset_metadata_->fs_manager(),
                                       *schema,
@@ -658,6 +663,7 @@ Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
 Status DiskRowSet::NewRowIterator(const RowIteratorOptions& opts,
                                   gscoped_ptr<RowwiseIterator>* out) const {
   DCHECK(open_);
+  read_count_.fetch_add(1, std::memory_order_relaxed);
   shared_lock<rw_spinlock> l(component_lock_);
 
   shared_ptr<CFileSet::Iterator> base_iter(base_data_->NewIterator(opts.projection,
@@ -689,6 +695,7 @@ Status DiskRowSet::MutateRow(Timestamp timestamp,
   rowid_t num_rows;
   RETURN_NOT_OK(CountRows(io_context, &num_rows));
 #endif
+  read_count_.fetch_add(1, std::memory_order_relaxed);
   shared_lock<rw_spinlock> l(component_lock_);
 
   boost::optional<rowid_t> row_idx;
@@ -741,6 +748,29 @@ Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DiskRowSet::CheckRowsPresent(ArrayView<const RowSetKeyProbe* const> probes,
+                                    const IOContext* io_context,
+                                    bool* present,
+                                    ArrayView<ProbeStats* const> stats) const {
+  DCHECK(open_);
+  DCHECK_EQ(probes.size(), stats.size());
+  read_count_.fetch_add(probes.size(), std::memory_order_relaxed);
+  shared_lock<rw_spinlock> l(component_lock_);
+
+  vector<rowid_t> row_idxs(probes.size());
+  RETURN_NOT_OK(base_data_->CheckRowsPresent(probes, io_context, present,
+                                             row_idxs.data(), stats));
+
+  // Rows in the base data might since have been deleted.
+  for (size_t i = 0; i < probes.size(); i++) {
+    if (!present[i]) continue;
+    bool deleted = false;
+    RETURN_NOT_OK(delta_tracker_->CheckRowDeleted(row_idxs[i], io_context, &deleted, stats[i]));
+    present[i] = !deleted;
+  }
+  return Status::OK();
+}
+
 Status DiskRowSet::CountRows(const IOContext* io_context, rowid_t *count) const {
   DCHECK(open_);
   rowid_t num_rows = num_rows_.load();
@@ -866,6 +896,10 @@ Status DiskRowSet::EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient
   return delta_tracker_->EstimateBytesInPotentiallyAncientUndoDeltas(ancient_history_mark, bytes);
 }
 
+bool DiskRowSet::HasAncientUndoDeltas(Timestamp ancient_history_mark) const {
+  return delta_tracker_->HasAncientUndoDeltas(ancient_history_mark);
+}
+
 Status DiskRowSet::InitUndoDeltas(Timestamp ancient_history_mark,
                                   MonoTime deadline,
                                   const IOContext* io_context,
@@ -35,6 +35,7 @@
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -90,8 +91,10 @@ class OperationResultPB;
 class DiskRowSetWriter {
  public:
   // TODO: document ownership of rowset_metadata
+  // The writes to the rowset's blocks are scheduled as 'io_class'.
   DiskRowSetWriter(RowSetMetadata* rowset_metadata, const Schema* schema,
-                   BloomFilterSizing bloom_sizing);
+                   BloomFilterSizing bloom_sizing,
+                   fs::IOClass io_class = fs::IOClass::FOREGROUND);
 
   ~DiskRowSetWriter();
 
@@ -144,6 +147,8 @@ class DiskRowSetWriter {
 
   BloomFilterSizing bloom_sizing_;
 
+  const fs::IOClass io_class_;
+
   bool finished_;
   rowid_t written_count_;
   gscoped_ptr<MultiColumnWriter> col_writer_;
@@ -167,7 +172,8 @@ class RollingDiskRowSetWriter {
   // that this RollingDiskRowSetWriter creates.
   RollingDiskRowSetWriter(TabletMetadata* tablet_metadata, const Schema& schema,
                           BloomFilterSizing bloom_sizing,
-                          size_t target_rowset_size);
+                          size_t target_rowset_size,
+                          fs::IOClass io_class = fs::IOClass::FOREGROUND);
   ~RollingDiskRowSetWriter();
 
   Status Open();
@@ -245,6 +251,7 @@ class RollingDiskRowSetWriter {
   std::shared_ptr<RowSetMetadata> cur_drs_metadata_;
   const BloomFilterSizing bloom_sizing_;
   const size_t target_rowset_size_;
+  const fs::IOClass io_class_;
 
   gscoped_ptr<DiskRowSetWriter> cur_writer_;
 
@@ -352,6 +359,11 @@ class DiskRowSet : public RowSet {
   Status CheckRowPresent(const RowSetKeyProbe &probe, const fs::IOContext* io_context,
                          bool *present, ProbeStats* stats) const override;
 
+  Status CheckRowsPresent(ArrayView<const RowSetKeyProbe* const> probes,
+                          const fs::IOContext* io_context,
+                          bool* present,
+                          ArrayView<ProbeStats* const> stats) const override;
+
   ////////////////////
   // Read functions.
   ////////////////////
@@ -394,6 +406,8 @@ class DiskRowSet : public RowSet {
   Status EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark,
                                                      int64_t* bytes) override;
 
+  bool HasAncientUndoDeltas(Timestamp ancient_history_mark) const override;
+
   Status InitUndoDeltas(Timestamp ancient_history_mark,
                         MonoTime deadline,
                         const fs::IOContext* io_context,
@@ -418,6 +432,10 @@ class DiskRowSet : public RowSet {
     has_been_compacted_.store(true);
   }
 
+  uint64_t ReadCount() const override {
+    return read_count_.load(std::memory_order_relaxed);
+  }
+
   DeltaTracker *delta_tracker() {
     return DCHECK_NOTNULL(delta_tracker_.get());
   }
@@ -490,6 +508,9 @@ class DiskRowSet : public RowSet {
   // and thus should not be scheduled for further compactions.
   std::atomic<bool> has_been_compacted_;
 
+  // Number of scans and row key probes served by this rowset.
+  mutable std::atomic<uint64_t> read_count_;
+
   DISALLOW_COPY_AND_ASSIGN(DiskRowSet);
 };
 
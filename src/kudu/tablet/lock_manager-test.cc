@@ -117,6 +117,29 @@ TEST_F(LockManagerTest, TestMoveLock) {
   ASSERT_FALSE(row_lock.acquired()); // NOLINT(bugprone-use-after-move)
 }
 
+// Test locking a batch of rows, including a row which appears twice.
+TEST_F(LockManagerTest, TestLockRowsBatch) {
+  vector<Slice> keys = { Slice("c"), Slice("a"), Slice("b"), Slice("a") };
+  for (int i = 0; i < 3; ++i) {
+    vector<ScopedRowLock> locks;
+    ScopedRowLock::LockRows(&lock_manager_, kFakeTransaction, keys,
+                            LockManager::LOCK_EXCLUSIVE, &locks);
+    ASSERT_EQ(keys.size(), locks.size());
+    for (const auto& l : locks) {
+      ASSERT_TRUE(l.acquired());
+    }
+    for (const auto& key : keys) {
+      VerifyAlreadyLocked(key);
+    }
+  }
+
+  // All of the locks were released, so the rows can be locked again.
+  for (const auto& key : keys) {
+    ScopedRowLock l(&lock_manager_, kFakeTransaction, key, LockManager::LOCK_EXCLUSIVE);
+    ASSERT_TRUE(l.acquired());
+  }
+}
+
 class LmTestResource {
  public:
   explicit LmTestResource(const Slice* id)
@@ -17,10 +17,13 @@
 
 #include "kudu/tablet/lock_manager.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <mutex>
+#include <numeric>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -38,6 +41,7 @@
 #include "kudu/util/trace.h"
 
 using base::subtle::NoBarrier_Load;
+using std::vector;
 
 namespace kudu {
 namespace tablet {
@@ -52,12 +56,14 @@ class TransactionState;
 // Callers should generally use ScopedRowLock (see below).
 class LockEntry {
  public:
-  explicit LockEntry(const Slice& key)
+  LockEntry(const Slice& key, uint64_t hash)
   : sem(1),
     recursion_(0) {
-    key_hash_ = util_hash::CityHash64(reinterpret_cast<const char *>(key.data()), key.size());
-    key_ = key;
-    refs_ = 1;
+    Reset(key, hash);
+  }
+
+  static uint64_t HashKey(const Slice& key) {
+    return util_hash::CityHash64(reinterpret_cast<const char *>(key.data()), key.size());
   }
 
   bool Equals(const Slice& key, uint64_t hash) const {
@@ -76,12 +82,22 @@ class LockEntry {
   friend class LockTable;
   friend class LockManager;
 
+  // Prepares an unused entry (fresh or recycled) to lock 'key'. A recycled
+  // entry's semaphore is already released and its recursion count is zero.
+  void Reset(const Slice& key, uint64_t hash) {
+    DCHECK_EQ(0, recursion_);
+    key_hash_ = hash;
+    key_ = key;
+    refs_ = 1;
+  }
+
   void CopyKey() {
     key_buf_.assign_copy(key_.data(), key_.size());
     key_ = Slice(key_buf_);
   }
 
-  // Pointer to the next entry in the same hash table bucket
+  // Pointer to the next entry in the same hash table bucket, or in the
+  // table's free list.
   LockEntry *ht_next_;
 
   // Hash of the key, used to lookup the hash table bucket
@@ -110,7 +126,12 @@ class LockTable {
   };
 
  public:
-  LockTable() : mask_(0), size_(0), item_count_(0) {
+  LockTable()
+      : mask_(0),
+        size_(0),
+        item_count_(0),
+        free_list_(nullptr),
+        free_count_(0) {
     Resize();
   }
 
@@ -122,9 +143,16 @@ class LockTable {
         DCHECK(p == nullptr) << "The entry " << p->ToString() << " was not released";
       }
     }
+    while (free_list_ != nullptr) {
+      LockEntry* next = free_list_->ht_next_;
+      delete free_list_;
+      free_list_ = next;
+    }
   }
 
-  LockEntry *GetLockEntry(const Slice &key);
+  // Returns the entry for 'key', whose hash is 'hash', creating it if it
+  // doesn't exist. A new entry is only allocated if the free list is empty.
+  LockEntry *GetLockEntry(const Slice &key, uint64_t hash);
   void ReleaseLockEntry(LockEntry *entry);
 
  private:
@@ -157,6 +185,15 @@ class LockTable {
 
   void Resize();
 
+  // Returns an unused entry for 'key', recycled from the free list if possible.
+  LockEntry* NewLockEntry(const Slice& key, uint64_t hash);
+
+  // Returns 'entry' to the free list, or frees it if the list is full.
+  void RecycleLockEntry(LockEntry* entry);
+
+  // Maximum number of unused entries kept for reuse by each table.
+  static const int kMaxFreeEntries = 1024;
+
  private:
   // table rwlock used as write on resize
   percpu_rwlock lock_;
@@ -168,34 +205,66 @@ class LockTable {
   gscoped_array<Bucket> buckets_;
   // number of items in the table
   base::subtle::Atomic64 item_count_;
+
+  // Protects 'free_list_' and 'free_count_'.
+  simple_spinlock free_lock_;
+  // Released entries kept for reuse, chained through 'ht_next_'.
+  LockEntry* free_list_;
+  int free_count_;
+
+  // Keeps the fields of adjacent tables in a LockManager's array of shards
+  // off each other's cache lines.
+  char padding_[CACHELINE_SIZE];
 };
 
-LockEntry *LockTable::GetLockEntry(const Slice& key) {
-  auto new_entry = new LockEntry(key);
-  LockEntry *old_entry;
+LockEntry* LockTable::NewLockEntry(const Slice& key, uint64_t hash) {
+  {
+    std::lock_guard<simple_spinlock> l(free_lock_);
+    if (free_list_ != nullptr) {
+      LockEntry* entry = free_list_;
+      free_list_ = entry->ht_next_;
+      free_count_--;
+      entry->Reset(key, hash);
+      return entry;
+    }
+  }
+  return new LockEntry(key, hash);
+}
+
+void LockTable::RecycleLockEntry(LockEntry* entry) {
+  {
+    std::lock_guard<simple_spinlock> l(free_lock_);
+    if (free_count_ < kMaxFreeEntries) {
+      entry->ht_next_ = free_list_;
+      free_list_ = entry;
+      free_count_++;
+      return;
+    }
+  }
+  delete entry;
+}
+
+LockEntry *LockTable::GetLockEntry(const Slice& key, uint64_t hash) {
+  LockEntry *new_entry = nullptr;
 
   {
     shared_lock<rw_spinlock> l(lock_.get_lock());
-    Bucket *bucket = FindBucket(new_entry->key_hash_);
+    Bucket *bucket = FindBucket(hash);
     {
       std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
-      LockEntry **node = FindSlot(bucket, new_entry->key_, new_entry->key_hash_);
-      old_entry = *node;
-      if (old_entry != nullptr) {
-        old_entry->refs_++;
-      } else {
-        new_entry->ht_next_ = nullptr;
-        new_entry->CopyKey();
-        *node = new_entry;
+      LockEntry **node = FindSlot(bucket, key, hash);
+      if (*node != nullptr) {
+        // The row is already locked (or being waited on); share its entry.
+        (*node)->refs_++;
+        return *node;
       }
+      new_entry = NewLockEntry(key, hash);
+      new_entry->ht_next_ = nullptr;
+      new_entry->CopyKey();
+      *node = new_entry;
     }
   }
 
-  if (old_entry != nullptr) {
-    delete new_entry;
-    return old_entry;
-  }
-
   if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, 1) > size_) {
     std::unique_lock<percpu_rwlock> table_wrlock(lock_, std::try_to_lock);
     // if we can't take the lock, means that someone else is resizing.
@@ -230,7 +299,7 @@ void LockTable::ReleaseLockEntry(LockEntry *entry) {
 
   DCHECK(removed) << "Unable to find LockEntry on release";
   base::subtle::NoBarrier_AtomicIncrement(&item_count_, -1);
-  delete entry;
+  RecycleLockEntry(entry);
 }
 
 void LockTable::Resize() {
@@ -289,6 +358,27 @@ ScopedRowLock::ScopedRowLock(LockManager *manager,
   }
 }
 
+ScopedRowLock::ScopedRowLock(LockManager* manager, LockEntry* entry)
+  : manager_(DCHECK_NOTNULL(manager)),
+    acquired_(true),
+    entry_(DCHECK_NOTNULL(entry)),
+    ls_(LockManager::LOCK_ACQUIRED) {
+}
+
+void ScopedRowLock::LockRows(LockManager* manager,
+                             const TransactionState* tx,
+                             const vector<Slice>& keys,
+                             LockManager::LockMode mode,
+                             vector<ScopedRowLock>* locks) {
+  vector<LockEntry*> entries;
+  manager->LockBatch(keys, tx, mode, &entries);
+  locks->clear();
+  locks->reserve(entries.size());
+  for (LockEntry* entry : entries) {
+    locks->emplace_back(ScopedRowLock(manager, entry));
+  }
+}
+
 ScopedRowLock::ScopedRowLock(ScopedRowLock&& other) noexcept {
   TakeState(&other);
 }
@@ -325,23 +415,60 @@ void ScopedRowLock::Release() {
 // ============================================================================
 
 LockManager::LockManager()
-  : locks_(new LockTable()) {
+  : locks_(new LockTable[kNumShards]) {
 }
 
 LockManager::~LockManager() {
-  delete locks_;
+  delete [] locks_;
+}
+
+LockTable* LockManager::ShardFor(uint64_t hash) const {
+  // The table itself picks buckets using the low bits of the hash, so shard
+  // by the high bits.
+  static_assert((kNumShards & (kNumShards - 1)) == 0, "kNumShards must be a power of two");
+  return &locks_[(hash >> 32) & (kNumShards - 1)];
 }
 
 LockManager::LockStatus LockManager::Lock(const Slice& key,
                                           const TransactionState* tx,
                                           LockManager::LockMode mode,
                                           LockEntry** entry) {
-  *entry = locks_->GetLockEntry(key);
+  uint64_t hash = LockEntry::HashKey(key);
+  *entry = ShardFor(hash)->GetLockEntry(key, hash);
+  AcquireEntry(*entry, key, tx);
+  return LOCK_ACQUIRED;
+}
 
+void LockManager::LockBatch(const vector<Slice>& keys,
+                            const TransactionState* tx,
+                            LockManager::LockMode mode,
+                            vector<LockEntry*>* entries) {
+  // Take the locks in key order. Every batch locking in the same order means
+  // that two batches with overlapping keys can't deadlock one another.
+  vector<int> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return keys[a].compare(keys[b]) < 0;
+  });
+
+  entries->resize(keys.size());
+  for (int i : order) {
+    const Slice& key = keys[i];
+    uint64_t hash = LockEntry::HashKey(key);
+    LockEntry* entry = ShardFor(hash)->GetLockEntry(key, hash);
+    AcquireEntry(entry, key, tx);
+    (*entries)[i] = entry;
+  }
+  TRACE_COUNTER_INCREMENT("row_locks_batched", keys.size());
+}
+
+void LockManager::AcquireEntry(LockEntry* entry,
+                               const Slice& key,
+                               const TransactionState* tx) {
   // We expect low contention, so just try to try_lock first. This is faster
   // than a timed_lock, since we don't have to do a syscall to get the current
   // time.
-  if (!(*entry)->sem.TryAcquire()) {
+  if (!entry->sem.TryAcquire()) {
     // If the current holder of this lock is the same transaction just return
     // a LOCK_ALREADY_ACQUIRED status without actually acquiring the mutex.
     //
@@ -351,9 +478,9 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // obtained and released at the same time). If at any time in the future
     // we opt to perform more fine grained locking, possibly letting transactions
     // release a portion of the locks they no longer need, this no longer is OK.
-    if (ANNOTATE_UNPROTECTED_READ((*entry)->holder_) == tx) {
-      (*entry)->recursion_++;
-      return LOCK_ACQUIRED;
+    if (ANNOTATE_UNPROTECTED_READ(entry->holder_) == tx) {
+      entry->recursion_++;
+      return;
     }
 
     // If we couldn't immediately acquire the lock, do a timed lock so we can
@@ -363,8 +490,8 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     TRACE_COUNTER_INCREMENT("row_lock_wait_count", 1);
     MicrosecondsInt64 start_wait_us = GetMonoTimeMicros();
     int waited_seconds = 0;
-    while (!(*entry)->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
-      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ((*entry)->holder_);
+    while (!entry->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
+      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ(entry->holder_);
       LOG(WARNING) << "Waited " << (++waited_seconds) << " seconds to obtain row lock on key "
                    << KUDU_REDACT(key.ToDebugString()) << " cur holder: " << cur_holder;
       // TODO(unknown): would be nice to also include some info about the blocking transaction,
@@ -378,18 +505,19 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     }
   }
 
-  (*entry)->holder_ = tx;
-  return LOCK_ACQUIRED;
+  entry->holder_ = tx;
 }
 
 LockManager::LockStatus LockManager::TryLock(const Slice& key,
                                              const TransactionState* tx,
                                              LockManager::LockMode mode,
                                              LockEntry **entry) {
-  *entry = locks_->GetLockEntry(key);
+  uint64_t hash = LockEntry::HashKey(key);
+  LockTable* table = ShardFor(hash);
+  *entry = table->GetLockEntry(key, hash);
   bool locked = (*entry)->sem.TryAcquire();
   if (!locked) {
-    locks_->ReleaseLockEntry(*entry);
+    table->ReleaseLockEntry(*entry);
     return LOCK_BUSY;
   }
   (*entry)->holder_ = tx;
@@ -405,7 +533,7 @@ void LockManager::Release(LockEntry *lock, LockStatus ls) {
       lock->sem.Release();
     }
   }
-  locks_->ReleaseLockEntry(lock);
+  ShardFor(lock->key_hash_)->ReleaseLockEntry(lock);
 }
 
 } // namespace tablet
@@ -18,6 +18,8 @@
 #define KUDU_TABLET_LOCK_MANAGER_H
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/util/slice.h"
@@ -59,6 +61,22 @@ class LockManager {
                      LockMode mode, LockEntry **entry);
   void Release(LockEntry *lock, LockStatus ls);
 
+  // Acquires the locks for all of 'keys' on behalf of 'tx', blocking as
+  // necessary. The locks are taken in key order so that concurrent batches
+  // can't deadlock. On return, (*entries)[i] holds the lock for keys[i].
+  void LockBatch(const std::vector<Slice>& keys, const TransactionState* tx,
+                 LockMode mode, std::vector<LockEntry*>* entries);
+
+  // Blocks until 'entry', the lock entry for 'key', is held by 'tx'.
+  void AcquireEntry(LockEntry* entry, const Slice& key, const TransactionState* tx);
+
+  // Returns the shard of 'locks_' responsible for keys with the given hash.
+  LockTable* ShardFor(uint64_t hash) const;
+
+  // The lock table is split into independent shards so that lookups of
+  // unrelated rows don't contend on the same table lock or cache lines.
+  static const int kNumShards = 16;
+
   LockTable *locks_;
 
   DISALLOW_COPY_AND_ASSIGN(LockManager);
@@ -103,6 +121,14 @@ class ScopedRowLock {
   ScopedRowLock(LockManager *manager, const TransactionState* ctx,
                 const Slice &key, LockManager::LockMode mode);
 
+  // Lock all of 'keys' in the given LockManager, replacing the contents of
+  // 'locks' with one holder per key, in the same order as 'keys'. This is
+  // cheaper than locking each row individually, and the keys must remain
+  // valid for the lifetime of the returned locks in the same way.
+  static void LockRows(LockManager* manager, const TransactionState* ctx,
+                       const std::vector<Slice>& keys, LockManager::LockMode mode,
+                       std::vector<ScopedRowLock>* locks);
+
   // Move constructor and assignment.
   ScopedRowLock(ScopedRowLock&& other) noexcept;
   ScopedRowLock& operator=(ScopedRowLock&& other) noexcept;
@@ -116,6 +142,9 @@ class ScopedRowLock {
   ~ScopedRowLock();
 
  private:
+  // Takes ownership of 'entry', which is already held.
+  ScopedRowLock(LockManager* manager, LockEntry* entry);
+
   void TakeState(ScopedRowLock* other);
 
   LockManager *manager_;
@@ -376,6 +376,44 @@ TEST_F(TestMemRowSet, TestInsertDuplicate) {
   ASSERT_TRUE(s.IsAlreadyPresent()) << "bad status: " << s.ToString();
 }
 
+// Test inserting rows through a shared insert hint, in key order and not.
+TEST_F(TestMemRowSet, TestInsertWithHint) {
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              MemTracker::GetRootTracker(), &mrs));
+
+  const int kNumRows = 1000;
+  const auto& InsertWithHint = [&](int i, MemRowSet::InsertHint* hint) {
+    const string key = StringPrintf("hello %06d", i);
+    RowBuilder rb(schema_);
+    rb.AddString(key);
+    rb.AddUint32(i);
+    faststring enc_key;
+    schema_.EncodeComparableKey(rb.row(), &enc_key);
+    return mrs->Insert(Timestamp(i), rb.row(), Slice(enc_key), op_id_, hint);
+  };
+
+  // Insert the even rows in order, then the odd ones in reverse order.
+  MemRowSet::InsertHint hint;
+  for (int i = 0; i < kNumRows; i += 2) {
+    ASSERT_OK(InsertWithHint(i, &hint));
+  }
+  for (int i = kNumRows - 1; i > 0; i -= 2) {
+    ASSERT_OK(InsertWithHint(i, &hint));
+  }
+  int count = mrs->entry_count();
+  ASSERT_EQ(kNumRows, count);
+
+  MemRowSet::InsertHint dup_hint;
+  for (int i = 0; i < kNumRows; i++) {
+    bool present = false;
+    ASSERT_OK(CheckRowPresent(*mrs, StringPrintf("hello %06d", i), &present));
+    ASSERT_TRUE(present) << "row " << i;
+    Status s = InsertWithHint(i, &dup_hint);
+    ASSERT_TRUE(s.IsAlreadyPresent()) << "row " << i << ": " << s.ToString();
+  }
+}
+
 // Test for updating rows in memrowset
 TEST_F(TestMemRowSet, TestUpdate) {
   shared_ptr<MemRowSet> mrs;
@@ -773,5 +811,23 @@ TEST_F(TestMemRowSet, TestScanVirtualColumnIsDeleted) {
   }
 }
 
+// Test that updates are applied to the right columns when the projection
+// only covers some of the MemRowSet's columns.
+TEST_F(TestMemRowSet, TestScanProjectionAppliesUpdates) {
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              MemTracker::GetRootTracker(), &mrs));
+  ASSERT_OK(GenerateTestData(mrs.get()));
+
+  Schema projection({ schema_.column(1) }, { schema_.column_id(1) }, 0);
+  RowIteratorOptions opts;
+  opts.projection = &projection;
+  opts.snap_to_include = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+  vector<string> rows;
+  ASSERT_OK(DumpRowSet(*mrs, opts, &rows));
+  ASSERT_EQ((vector<string>{ "(uint32 val=0)", "(uint32 val=1)",
+                             "(uint32 val=2)", "(uint32 val=3)" }), rows);
+}
+
 } // namespace tablet
 } // namespace kudu
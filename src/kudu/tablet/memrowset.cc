@@ -28,6 +28,8 @@
 
 #include "kudu/codegen/compilation_manager.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/scan_kernel.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/row.h"
@@ -51,6 +53,13 @@ DEFINE_bool(mrs_use_codegen, true, "whether the memrowset should use code "
             "generation for iteration");
 TAG_FLAG(mrs_use_codegen, hidden);
 
+DEFINE_bool(mrs_use_codegen_scan_kernels, false, "whether the memrowset should "
+            "use code-generated kernels which evaluate a scan's predicates over "
+            "rows with no mutations before projecting them. Only takes effect "
+            "if --mrs_use_codegen is set.");
+TAG_FLAG(mrs_use_codegen_scan_kernels, experimental);
+TAG_FLAG(mrs_use_codegen_scan_kernels, runtime);
+
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -115,7 +124,7 @@ MemRowSet::MemRowSet(int64_t id,
   : id_(id),
     schema_(schema),
     allocator_(new MemoryTrackingBufferAllocator(
-        HeapBufferAllocator::Get(),
+        ArenaChunkPool::GetOrHeapAllocator(),
         CreateMemTrackerForMemRowSet(id, std::move(parent_tracker)))),
     arena_(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, allocator_)),
     tree_(arena_),
@@ -124,6 +133,10 @@ MemRowSet::MemRowSet(int64_t id,
     anchorer_(log_anchor_registry, Substitute("MemRowSet-$0", id_)),
     has_been_compacted_(false) {
   CHECK(schema.has_column_ids());
+  if (ArenaChunkPool::enabled()) {
+    // Once past the first few small buffers, grow by whole pooled chunks.
+    arena_->SetMaxBufferSize(ArenaChunkPool::kChunkSize);
+  }
   ANNOTATE_BENIGN_RACE(&debug_insert_count_, "insert count isnt accurate");
   ANNOTATE_BENIGN_RACE(&debug_update_count_, "update count isnt accurate");
 }
@@ -151,16 +164,23 @@ Status MemRowSet::DebugDump(vector<string> *lines) {
 Status MemRowSet::Insert(Timestamp timestamp,
                          const ConstContiguousRow& row,
                          const OpId& op_id) {
+  faststring enc_key_buf;
+  schema_.EncodeComparableKey(row, &enc_key_buf);
+  InsertHint hint;
+  return Insert(timestamp, row, Slice(enc_key_buf), op_id, &hint);
+}
+
+Status MemRowSet::Insert(Timestamp timestamp,
+                         const ConstContiguousRow& row,
+                         const Slice& enc_key,
+                         const OpId& op_id,
+                         InsertHint* hint) {
   CHECK(row.schema()->has_column_ids());
   DCHECK_SCHEMA_EQ(schema_, *row.schema());
 
   {
-    faststring enc_key_buf;
-    schema_.EncodeComparableKey(row, &enc_key_buf);
-    Slice enc_key(enc_key_buf);
-
     btree::PreparedMutation<MSBTreeTraits> mutation(enc_key);
-    mutation.Prepare(&tree_);
+    mutation.Prepare(&tree_, hint);
 
     // TODO: for now, the key ends up stored doubly --
     // once encoded in the btree key, and again in the value
@@ -411,6 +431,29 @@ Status MemRowSet::Iterator::Init(ScanSpec *spec) {
   RETURN_NOT_OK(projector_->Init());
   RETURN_NOT_OK(delta_projector_.Init());
 
+  base_col_to_projection_idx_.assign(memrowset_->schema_nonvirtual().num_columns(), -1);
+  for (const auto& mapping : projector_->base_cols_mapping()) {
+    base_col_to_projection_idx_[mapping.second] = mapping.first;
+  }
+
+  // The predicates stay in the spec: the kernel only filters out rows which
+  // can't match, and the rows it projects are evaluated again above us.
+  if (FLAGS_mrs_use_codegen && FLAGS_mrs_use_codegen_scan_kernels &&
+      spec && !spec->predicates().empty()) {
+    vector<ColumnPredicate> preds;
+    preds.reserve(spec->predicates().size());
+    for (const auto& entry : spec->predicates()) {
+      preds.push_back(entry.second);
+    }
+    vector<codegen::KernelPredicate> kernel_preds;
+    codegen::ScanKernelFunctions::ExtractPredicates(memrowset_->schema_nonvirtual(),
+                                                    preds, &kernel_preds);
+    if (!kernel_preds.empty()) {
+      codegen::CompilationManager::GetSingleton()->RequestScanKernel(
+          &memrowset_->schema_nonvirtual(), opts_.projection, kernel_preds, &scan_kernel_);
+    }
+  }
+
   if (spec && spec->lower_bound_key()) {
     bool exact;
     const Slice &lower_bound = spec->lower_bound_key()->encoded_key();
@@ -523,15 +566,25 @@ Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
     bool unset_in_sel_vector;
     ApplyStatus apply_status;
     if (insert_excluded || opts_.snap_to_include.IsCommitted(row.insertion_timestamp())) {
-      RETURN_NOT_OK(projector_->ProjectRowForRead(row, &dst_row, dst->arena()));
-
-      // Roll-forward MVCC for committed updates.
       Mutation* redo_head = reinterpret_cast<Mutation*>(
           base::subtle::Acquire_Load(reinterpret_cast<AtomicWord*>(&row.header_->redo_head)));
-      RETURN_NOT_OK(ApplyMutationsToProjectedRow(
-          redo_head, &dst_row, dst->arena(), &apply_status));
-      unset_in_sel_vector = (apply_status == APPLIED_AND_DELETED && !opts_.include_deleted_rows) ||
-                            (apply_status == NONE_APPLIED && insert_excluded);
+      if (scan_kernel_ && redo_head == nullptr) {
+        // With no mutations, the inserted row is the row as of the snapshot,
+        // so the scan kernel can filter it before it's projected.
+        bool matched;
+        RETURN_NOT_OK(scan_kernel_->ProjectRowIfMatch(row, &dst_row, dst->arena(), &matched));
+        apply_status = NONE_APPLIED;
+        unset_in_sel_vector = !matched || insert_excluded;
+      } else {
+        RETURN_NOT_OK(projector_->ProjectRowForRead(row, &dst_row, dst->arena()));
+
+        // Roll-forward MVCC for committed updates.
+        RETURN_NOT_OK(ApplyMutationsToProjectedRow(
+            redo_head, &dst_row, dst->arena(), &apply_status));
+        unset_in_sel_vector =
+            (apply_status == APPLIED_AND_DELETED && !opts_.include_deleted_rows) ||
+            (apply_status == NONE_APPLIED && insert_excluded);
+      }
     } else {
       // The insertion is too new; the entire row should be omitted.
       unset_in_sel_vector = true;
@@ -602,15 +655,26 @@ Status MemRowSet::Iterator::ApplyMutationsToProjectedRow(
         decoder.TwiddleDeleteStatus(&is_deleted);
       }
 
-      // TODO(todd): this is slow, since it makes multiple passes through the rowchangelist.
-      // Instead, we should keep the backwards mapping of columns.
-      for (const RowProjector::ProjectionIdxMapping& mapping : projector_->base_cols_mapping()) {
-        RowChangeListDecoder decoder(mut->changelist());
-        RETURN_NOT_OK(decoder.Init());
-        ColumnBlock dst_col = dst_row->column_block(mapping.first);
-        RETURN_NOT_OK(decoder.ApplyToOneColumn(dst_row->row_index(), &dst_col,
-                                               memrowset_->schema_nonvirtual(),
-                                               mapping.second, dst_arena));
+      // Decode the changelist once, routing each updated column to its
+      // projected column through the backwards mapping.
+      const Schema& base_schema = memrowset_->schema_nonvirtual();
+      while (decoder.HasNext()) {
+        RowChangeListDecoder::DecodedUpdate dec;
+        RETURN_NOT_OK(decoder.DecodeNext(&dec));
+        int base_idx = base_schema.find_column_by_id(dec.col_id);
+        if (base_idx == Schema::kColumnNotFound ||
+            base_col_to_projection_idx_[base_idx] == -1) {
+          continue;
+        }
+        int validated_idx;
+        const void* new_val;
+        RETURN_NOT_OK(dec.Validate(base_schema, &validated_idx, &new_val));
+        DCHECK_EQ(base_idx, validated_idx);
+
+        SimpleConstCell src(&base_schema.column(base_idx), new_val);
+        ColumnBlock dst_col = dst_row->column_block(base_col_to_projection_idx_[base_idx]);
+        ColumnBlock::Cell dst_cell = dst_col.cell(dst_row->row_index());
+        RETURN_NOT_OK(CopyCell(src, &dst_cell, dst_arena));
       }
     }
   }
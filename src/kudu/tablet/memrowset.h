@@ -56,6 +56,10 @@ class RowChangeList;
 class ScanSpec;
 struct IteratorStats;
 
+namespace codegen {
+class ScanKernel;
+}  // namespace codegen
+
 namespace fs {
 struct IOContext;
 }  // namespace fs
@@ -234,6 +238,23 @@ class MemRowSet : public RowSet,
                 const ConstContiguousRow& row,
                 const consensus::OpId& op_id);
 
+  // Remembers where in the tree the previous insert through it landed. See
+  // the Insert() overload below.
+  typedef btree::MutationHint<MSBTreeTraits> InsertHint;
+
+  // Like the above, but for a row whose key has already been encoded into
+  // 'enc_key', and starting the search for its position in the tree from
+  // where the previous insert with the same 'hint' landed.
+  //
+  // Inserting a batch of rows in increasing key order with a single hint
+  // avoids most of the tree traversals. 'hint' must only be used with this
+  // MemRowSet.
+  Status Insert(Timestamp timestamp,
+                const ConstContiguousRow& row,
+                const Slice& enc_key,
+                const consensus::OpId& op_id,
+                InsertHint* hint);
+
 
   // Update or delete an existing row in the memrowset.
   //
@@ -393,6 +414,10 @@ class MemRowSet : public RowSet,
     return Status::OK();
   }
 
+  bool HasAncientUndoDeltas(Timestamp /*ancient_history_mark*/) const override {
+    return false;
+  }
+
   Status InitUndoDeltas(Timestamp /*ancient_history_mark*/,
                         MonoTime /*deadline*/,
                         const fs::IOContext* /*io_context*/,
@@ -593,10 +618,20 @@ class MemRowSet::Iterator : public RowwiseIterator {
   const gscoped_ptr<MRSRowProjector> projector_;
   DeltaProjector delta_projector_;
 
+  // Evaluates the scan's supported predicates over rows with no mutations
+  // before projecting them. NULL if code generation is disabled or the
+  // kernel isn't compiled yet.
+  gscoped_ptr<codegen::ScanKernel> scan_kernel_;
+
   // The index of the first IS_DELETED virtual column in the projection schema,
   // or kColumnNotFound if one doesn't exist.
   const int projection_vc_is_deleted_idx_;
 
+  // For each column of the MemRowSet's schema, the index of the projection
+  // column it is read into, or -1 if it isn't projected. Lets a mutation's
+  // changelist be applied to the projected row in a single decoding pass.
+  std::vector<int> base_col_to_projection_idx_;
+
   // Temporary buffer used for RowChangeList projection.
   faststring delta_buf_;
 
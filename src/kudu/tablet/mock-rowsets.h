@@ -150,6 +150,11 @@ class MockRowSet : public RowSet {
     return Status::OK();
   }
 
+  virtual bool HasAncientUndoDeltas(Timestamp /*ancient_history_mark*/) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return false;
+  }
+
   virtual Status InitUndoDeltas(Timestamp /*ancient_history_mark*/,
                                 MonoTime /*deadline*/,
                                 const fs::IOContext* /*io_context*/,
@@ -211,11 +216,20 @@ class MockDiskRowSet : public MockRowSet {
                                Slice(last_key_).ToDebugString());
   }
 
+  virtual uint64_t ReadCount() const OVERRIDE {
+    return read_count_;
+  }
+
+  void set_read_count(uint64_t read_count) {
+    read_count_ = read_count;
+  }
+
  private:
   const std::string first_key_;
   const std::string last_key_;
   const uint64_t size_;
   const uint64_t column_size_;
+  uint64_t read_count_ = 0;
 };
 
 // Mock which acts like a MemRowSet and has no known bounds.
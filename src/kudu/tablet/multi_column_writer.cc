@@ -17,11 +17,14 @@
 
 #include "kudu/tablet/multi_column_writer.h"
 
+#include <algorithm>
 #include <memory>
 #include <ostream>
 #include <string>
 #include <utility>
 
+#include <gflags/gflags.h>
+
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/columnblock.h"
@@ -32,6 +35,24 @@
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(flush_column_encoding_threads, 4,
+             "Maximum number of threads used to encode and compress the columns "
+             "of a rowset being flushed or compacted. Threads are drawn from a "
+             "process-wide pool shared by all flushes. If 0, each rowset's "
+             "columns are encoded sequentially by the flushing thread.");
+TAG_FLAG(flush_column_encoding_threads, advanced);
+TAG_FLAG(flush_column_encoding_threads, experimental);
+
+DEFINE_bool(cfile_write_zone_maps, false,
+            "Whether the column files of new rowsets record the minimum and "
+            "maximum value and the number of NULLs of each data block, so that "
+            "scans may skip blocks which can't match their predicates. Zone maps "
+            "aren't written for floating point columns.");
+TAG_FLAG(cfile_write_zone_maps, experimental);
+TAG_FLAG(cfile_write_zone_maps, runtime);
 
 namespace kudu {
 namespace tablet {
@@ -41,17 +62,43 @@ using fs::BlockCreationTransaction;
 using fs::CreateBlockOptions;
 using fs::WritableBlock;
 using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Returns the process-wide pool on which columns are encoded, creating it on
+// first use. Intentionally leaked, like other process-wide singletons.
+ThreadPool* GetColumnEncodingPool() {
+  static ThreadPool* pool = []() {
+    gscoped_ptr<ThreadPool> p;
+    CHECK_OK(ThreadPoolBuilder("flush-encode")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_flush_column_encoding_threads)
+             .Build(&p));
+    return p.release();
+  }();
+  return pool;
+}
+
+} // anonymous namespace
 
 MultiColumnWriter::MultiColumnWriter(FsManager* fs,
                                      const Schema* schema,
-                                     std::string tablet_id)
+                                     std::string tablet_id,
+                                     fs::IOClass io_class)
   : fs_(fs),
     schema_(schema),
     finished_(false),
-    tablet_id_(std::move(tablet_id)) {
+    tablet_id_(std::move(tablet_id)),
+    io_class_(io_class),
+    num_column_groups_(1) {
 }
 
 MultiColumnWriter::~MultiColumnWriter() {
+  // No encoding task may outlive the writers it operates on.
+  if (encode_token_) {
+    encode_token_->Wait();
+  }
   STLDeleteElements(&cfile_writers_);
 }
 
@@ -59,7 +106,7 @@ Status MultiColumnWriter::Open() {
   CHECK(cfile_writers_.empty());
 
   // Open columns.
-  const CreateBlockOptions block_opts({ tablet_id_ });
+  const CreateBlockOptions block_opts({ tablet_id_, io_class_ });
   for (int i = 0; i < schema_->num_columns(); i++) {
     const ColumnSchema &col = schema_->column(i);
 
@@ -72,6 +119,8 @@ Status MultiColumnWriter::Open() {
     /// Set the column storage attributes.
     opts.storage_attributes = col.attributes();
 
+    opts.write_zone_map = FLAGS_cfile_write_zone_maps;
+
     // If the schema has a single PK and this is the PK col
     if (i == 0 && schema_->num_key_columns() == 1) {
       opts.write_validx = true;
@@ -97,19 +146,65 @@ Status MultiColumnWriter::Open() {
   }
   LOG(INFO) << "Opened CFile writers for " << cfile_writers_.size() << " column(s)";
 
+  // One column group is always encoded by the calling thread; the rest are
+  // handed to the flush pool.
+  if (FLAGS_flush_column_encoding_threads > 0 && schema_->num_columns() > 1) {
+    num_column_groups_ = std::min<int>(schema_->num_columns(),
+                                       FLAGS_flush_column_encoding_threads + 1);
+    encode_token_ = GetColumnEncodingPool()->NewToken(
+        ThreadPool::ExecutionMode::CONCURRENT);
+  }
+
+  return Status::OK();
+}
+
+Status MultiColumnWriter::AppendColumn(const RowBlock& block, int col_idx) {
+  ColumnBlock column = block.column_block(col_idx);
+  if (column.is_nullable()) {
+    return cfile_writers_[col_idx]->AppendNullableEntries(column.null_bitmap(),
+        column.data(), column.nrows());
+  }
+  return cfile_writers_[col_idx]->AppendEntries(column.data(), column.nrows());
+}
+
+Status MultiColumnWriter::AppendColumnGroup(const RowBlock& block,
+                                            int first_col_idx,
+                                            int stride) {
+  for (int i = first_col_idx; i < schema_->num_columns(); i += stride) {
+    RETURN_NOT_OK(AppendColumn(block, i));
+  }
   return Status::OK();
 }
 
 Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
-  for (int i = 0; i < schema_->num_columns(); i++) {
-    ColumnBlock column = block.column_block(i);
-    if (column.is_nullable()) {
-      RETURN_NOT_OK(cfile_writers_[i]->AppendNullableEntries(column.null_bitmap(),
-          column.data(), column.nrows()));
+  if (!encode_token_) {
+    return AppendColumnGroup(block, 0, 1);
+  }
+
+  // Hand all but the first column group to the flush pool, then encode the
+  // first group here while the others proceed. Each group's CFileWriters are
+  // only ever touched by the task driving that group.
+  vector<Status> statuses(num_column_groups_);
+  int num_submitted = 0;
+  for (int g = 1; g < num_column_groups_; g++) {
+    Status* s = &statuses[g];
+    Status submit_status = encode_token_->SubmitFunc([this, &block, g, s]() {
+      *s = AppendColumnGroup(block, g, num_column_groups_);
+    });
+    if (!submit_status.ok()) {
+      // The pool is unavailable; encode the group on this thread instead.
+      *s = AppendColumnGroup(block, g, num_column_groups_);
     } else {
-      RETURN_NOT_OK(cfile_writers_[i]->AppendEntries(column.data(), column.nrows()));
+      num_submitted++;
     }
   }
+  statuses[0] = AppendColumnGroup(block, 0, num_column_groups_);
+  if (num_submitted > 0) {
+    encode_token_->Wait();
+  }
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
   return Status::OK();
 }
 
@@ -19,12 +19,14 @@
 
 #include <cstddef>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <glog/logging.h>
 
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
 
@@ -33,6 +35,7 @@ namespace kudu {
 class FsManager;
 class RowBlock;
 class Schema;
+class ThreadPoolToken;
 struct ColumnId;
 
 namespace cfile {
@@ -46,12 +49,19 @@ class BlockCreationTransaction;
 namespace tablet {
 
 // Wrapper which writes several columns in parallel corresponding to some
-// Schema. Written blocks will fall in the tablet_id's data dir group.
+// Schema. Written blocks will fall in the tablet_id's data dir group, and
+// the writes to them are scheduled as 'io_class'.
+//
+// If --flush_column_encoding_threads is positive, the columns of each
+// appended block are encoded and compressed concurrently on a process-wide
+// flush thread pool, each CFileWriter being driven by at most one thread at a
+// time.
 class MultiColumnWriter {
  public:
   MultiColumnWriter(FsManager* fs,
                     const Schema* schema,
-                    std::string tablet_id);
+                    std::string tablet_id,
+                    fs::IOClass io_class);
 
   virtual ~MultiColumnWriter();
 
@@ -60,7 +70,8 @@ class MultiColumnWriter {
 
   // Append the given block to the output columns.
   //
-  // Note that the selection vector here is ignored.
+  // Note that the selection vector here is ignored. The block's data need only
+  // remain valid for the duration of the call.
   Status AppendBlock(const RowBlock& block);
 
   // Close the in-progress CFiles, finalizing the underlying writable
@@ -81,6 +92,13 @@ class MultiColumnWriter {
   void GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
 
  private:
+  // Appends the data of column 'col_idx' in 'block' to its CFileWriter.
+  Status AppendColumn(const RowBlock& block, int col_idx);
+
+  // Appends every 'stride'-th column of 'block' to the column writers,
+  // starting at 'first_col_idx'. Returns the first error encountered.
+  Status AppendColumnGroup(const RowBlock& block, int first_col_idx, int stride);
+
   FsManager* const fs_;
   const Schema* const schema_;
 
@@ -88,9 +106,19 @@ class MultiColumnWriter {
 
   const std::string tablet_id_;
 
+  // The class of the writes to the columns' blocks.
+  const fs::IOClass io_class_;
+
   std::vector<cfile::CFileWriter *> cfile_writers_;
   std::vector<BlockId> block_ids_;
 
+  // Token on the flush thread pool used to encode columns concurrently, or
+  // nullptr if columns are encoded on the calling thread.
+  std::unique_ptr<ThreadPoolToken> encode_token_;
+
+  // Number of column groups that are encoded concurrently.
+  int num_column_groups_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiColumnWriter);
 };
 
@@ -30,14 +30,18 @@
 #include "kudu/common/timestamp.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
 using std::thread;
+using std::vector;
+using strings::Substitute;
 
 namespace kudu {
 namespace tablet {
@@ -294,6 +298,121 @@ TEST_F(MvccTest, TestScopedTransaction) {
   }
 }
 
+// Snapshots share their committed set, so commits after a snapshot was taken
+// must not leak into it.
+TEST_F(MvccTest, TestSnapshotIsolatedFromLaterCommits) {
+  MvccManager mgr;
+  vector<Timestamp> txns;
+  for (int i = 0; i < 5; i++) {
+    txns.push_back(clock_->Now());
+    mgr.StartTransaction(txns.back());
+  }
+  mgr.AdjustSafeTime(clock_->Now());
+  for (int i : { 1, 3 }) {
+    mgr.StartApplyingTransaction(txns[i]);
+    mgr.CommitTransaction(txns[i]);
+  }
+
+  MvccSnapshot snap1;
+  mgr.TakeSnapshot(&snap1);
+  MvccSnapshot snap1_copy(snap1);
+
+  mgr.StartApplyingTransaction(txns[2]);
+  mgr.CommitTransaction(txns[2]);
+  MvccSnapshot snap2;
+  mgr.TakeSnapshot(&snap2);
+
+  for (const MvccSnapshot* snap : { &snap1, &snap1_copy }) {
+    ASSERT_FALSE(snap->IsCommitted(txns[0]));
+    ASSERT_TRUE(snap->IsCommitted(txns[1]));
+    ASSERT_FALSE(snap->IsCommitted(txns[2]));
+    ASSERT_TRUE(snap->IsCommitted(txns[3]));
+    ASSERT_FALSE(snap->IsCommitted(txns[4]));
+  }
+  ASSERT_TRUE(snap1.Equals(snap1_copy));
+  ASSERT_TRUE(snap2.IsCommitted(txns[2]));
+  ASSERT_FALSE(snap1.Equals(snap2));
+
+  for (int i : { 0, 4 }) {
+    mgr.StartApplyingTransaction(txns[i]);
+    mgr.CommitTransaction(txns[i]);
+  }
+}
+
+// Test the committed set both while the bitmap covers it and once the
+// timestamps spread too far apart for the bitmap.
+TEST_F(MvccTest, TestCommittedSet) {
+  scoped_refptr<MvccCommittedSet> set(new MvccCommittedSet());
+  ASSERT_TRUE(set->empty());
+  for (Timestamp::val_type ts : { 15, 11, 13, 13 }) {
+    set->Insert(ts);
+  }
+  ASSERT_EQ(3, set->size());
+  ASSERT_EQ((vector<Timestamp::val_type>{ 11, 13, 15 }), set->timestamps());
+  for (Timestamp::val_type ts = 0; ts < 20; ts++) {
+    ASSERT_EQ(ts == 11 || ts == 13 || ts == 15, set->Contains(ts)) << ts;
+  }
+
+  // Spread the timestamps far apart.
+  set->Insert(1000000);
+  set->Insert(5);
+  ASSERT_TRUE(set->Contains(5));
+  ASSERT_TRUE(set->Contains(1000000));
+  ASSERT_FALSE(set->Contains(999999));
+  ASSERT_FALSE(set->Contains(14));
+
+  // Removing the low timestamps brings them back within range of the bitmap.
+  set->RemoveBelow(999000);
+  ASSERT_EQ((vector<Timestamp::val_type>{ 1000000 }), set->timestamps());
+  ASSERT_TRUE(set->Contains(1000000));
+  ASSERT_FALSE(set->Contains(13));
+
+  scoped_refptr<MvccCommittedSet> copy = set->Clone();
+  copy->Insert(1000001);
+  ASSERT_TRUE(copy->Contains(1000001));
+  ASSERT_FALSE(set->Contains(1000001));
+}
+
+// Benchmark taking snapshots and checking commits while many transactions
+// are in flight, leaving a large committed set above the clean watermark.
+TEST_F(MvccTest, TestSnapshotPerformance) {
+  const int kNumTxns = 1000;
+  const int kNumIterations = AllowSlowTests() ? 1000000 : 100000;
+  MvccManager mgr;
+  vector<Timestamp> txns;
+  for (int i = 0; i < kNumTxns; i++) {
+    txns.push_back(clock_->Now());
+    mgr.StartTransaction(txns.back());
+  }
+  mgr.AdjustSafeTime(clock_->Now());
+  // Commit every other transaction, so the earliest stays in flight.
+  for (int i = 1; i < kNumTxns; i += 2) {
+    mgr.StartApplyingTransaction(txns[i]);
+    mgr.CommitTransaction(txns[i]);
+  }
+
+  vector<MvccSnapshot> snaps(64);
+  LOG_TIMING(INFO, Substitute("taking $0 snapshots", kNumIterations)) {
+    for (int i = 0; i < kNumIterations; i++) {
+      mgr.TakeSnapshot(&snaps[i % snaps.size()]);
+    }
+  }
+
+  const MvccSnapshot& snap = snaps[0];
+  int num_committed = 0;
+  LOG_TIMING(INFO, Substitute("checking $0 timestamps", kNumIterations)) {
+    for (int i = 0; i < kNumIterations; i++) {
+      if (snap.IsCommitted(txns[i % kNumTxns])) num_committed++;
+    }
+  }
+  ASSERT_EQ(kNumIterations / 2, num_committed);
+
+  for (int i = 0; i < kNumTxns; i += 2) {
+    mgr.StartApplyingTransaction(txns[i]);
+    mgr.CommitTransaction(txns[i]);
+  }
+}
+
 TEST_F(MvccTest, TestPointInTimeSnapshot) {
   MvccSnapshot snap(Timestamp(10));
 
@@ -306,8 +425,8 @@ TEST_F(MvccTest, TestPointInTimeSnapshot) {
 TEST_F(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter) {
   MvccSnapshot snap;
   snap.all_committed_before_ = Timestamp(10);
-  snap.committed_timestamps_.push_back(11);
-  snap.committed_timestamps_.push_back(13);
+  snap.AddCommittedTimestamp(Timestamp(11));
+  snap.AddCommittedTimestamp(Timestamp(13));
   snap.none_committed_at_or_after_ = Timestamp(14);
 
   ASSERT_TRUE(snap.MayHaveCommittedTransactionsAtOrAfter(Timestamp(9)));
@@ -342,8 +461,8 @@ TEST_F(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter) {
 TEST_F(MvccTest, TestMayHaveUncommittedTransactionsBefore) {
   MvccSnapshot snap;
   snap.all_committed_before_ = Timestamp(10);
-  snap.committed_timestamps_.push_back(11);
-  snap.committed_timestamps_.push_back(13);
+  snap.AddCommittedTimestamp(Timestamp(11));
+  snap.AddCommittedTimestamp(Timestamp(13));
   snap.none_committed_at_or_after_ = Timestamp(14);
 
   ASSERT_FALSE(snap.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(9)));
@@ -382,7 +501,7 @@ TEST_F(MvccTest, TestMayHaveUncommittedTransactionsBefore) {
   // still report that there can't be any uncommitted transactions before.
   MvccSnapshot snap2;
   snap2.all_committed_before_ = Timestamp(10);
-  snap2.committed_timestamps_.push_back(10);
+  snap2.AddCommittedTimestamp(Timestamp(10));
 
   ASSERT_FALSE(snap2.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(10)));
 }
@@ -755,7 +874,7 @@ TEST_F(MvccTest, TestCorrectInitWithNoTxns) {
   mgr.TakeSnapshot(&snap);
   EXPECT_EQ(snap.all_committed_before_, Timestamp::kInitialTimestamp);
   EXPECT_EQ(snap.none_committed_at_or_after_, Timestamp::kInitialTimestamp);
-  EXPECT_EQ(snap.committed_timestamps_.size(), 0);
+  EXPECT_TRUE(snap.is_clean());
 
   // Read the clock a few times to advance the timestamp
   for (int i = 0; i < 10; i++) clock_->Now();
@@ -779,7 +898,7 @@ TEST_F(MvccTest, TestCorrectInitWithNoTxns) {
 
   EXPECT_EQ(snap2.all_committed_before_, new_safe_time);
   EXPECT_EQ(snap2.none_committed_at_or_after_, new_safe_time);
-  EXPECT_EQ(snap2.committed_timestamps_.size(), 0);
+  EXPECT_TRUE(snap2.is_clean());
 }
 
 } // namespace tablet
@@ -209,18 +209,6 @@ void MvccManager::AdjustSafeTime(Timestamp safe_time) {
   AdjustCleanTime();
 }
 
-// Remove any elements from 'v' which are < the given watermark.
-static void FilterTimestamps(std::vector<Timestamp::val_type>* v,
-                             Timestamp::val_type watermark) {
-  int j = 0;
-  for (const auto& ts : *v) {
-    if (ts >= watermark) {
-      (*v)[j++] = ts;
-    }
-  }
-  v->resize(j);
-}
-
 void MvccManager::Close() {
   open_.store(false);
   std::lock_guard<LockType> l(lock_);
@@ -255,12 +243,12 @@ void MvccManager::AdjustCleanTime() {
   DVLOG(4) << "Adjusted clean time to: " << cur_snap_.all_committed_before_;
 
   // Filter out any committed timestamps that now fall below the watermark
-  FilterTimestamps(&cur_snap_.committed_timestamps_, cur_snap_.all_committed_before_.value());
+  cur_snap_.RemoveCommittedTimestampsBelow(cur_snap_.all_committed_before_);
 
   // If the current snapshot doesn't have any committed timestamps, then make sure we still
   // advance the 'none_committed_at_or_after_' watermark so that it never falls below
   // 'all_committed_before_'.
-  if (cur_snap_.committed_timestamps_.empty()) {
+  if (cur_snap_.is_clean()) {
     cur_snap_.none_committed_at_or_after_ = cur_snap_.all_committed_before_;
   }
 
@@ -452,11 +440,7 @@ MvccSnapshot MvccSnapshot::CreateSnapshotIncludingNoTransactions() {
 }
 
 bool MvccSnapshot::IsCommittedFallback(const Timestamp& timestamp) const {
-  for (const Timestamp::val_type& v : committed_timestamps_) {
-    if (v == timestamp.value()) return true;
-  }
-
-  return false;
+  return committed_ && committed_->Contains(timestamp.value());
 }
 
 bool MvccSnapshot::MayHaveCommittedTransactionsAtOrAfter(const Timestamp& timestamp) const {
@@ -475,7 +459,7 @@ bool MvccSnapshot::MayHaveUncommittedTransactionsAtOrBefore(const Timestamp& tim
 std::string MvccSnapshot::ToString() const {
   std::string ret("MvccSnapshot[committed={T|");
 
-  if (committed_timestamps_.size() == 0) {
+  if (is_clean()) {
     StrAppend(&ret, "T < ", all_committed_before_.ToString(),"}]");
     return ret;
   }
@@ -483,7 +467,7 @@ std::string MvccSnapshot::ToString() const {
             " or (T in {");
 
   bool first = true;
-  for (Timestamp::val_type t : committed_timestamps_) {
+  for (Timestamp::val_type t : committed_->timestamps()) {
     if (!first) {
       ret.push_back(',');
     }
@@ -503,7 +487,7 @@ void MvccSnapshot::AddCommittedTimestamps(const std::vector<Timestamp>& timestam
 void MvccSnapshot::AddCommittedTimestamp(Timestamp timestamp) {
   if (IsCommitted(timestamp)) return;
 
-  committed_timestamps_.push_back(timestamp.value());
+  mutable_committed()->Insert(timestamp.value());
 
   // If this is a new upper bound commit mark, update it.
   if (none_committed_at_or_after_ <= timestamp) {
@@ -518,7 +502,85 @@ bool MvccSnapshot::Equals(const MvccSnapshot& other) const {
   if (none_committed_at_or_after_ != other.none_committed_at_or_after_) {
     return false;
   }
-  return committed_timestamps_ == other.committed_timestamps_;
+  if (is_clean() || other.is_clean()) {
+    return is_clean() == other.is_clean();
+  }
+  return committed_->timestamps() == other.committed_->timestamps();
+}
+
+void MvccSnapshot::RemoveCommittedTimestampsBelow(Timestamp watermark) {
+  if (is_clean()) return;
+  if (committed_->timestamps().front() >= watermark.value()) return;
+  mutable_committed()->RemoveBelow(watermark.value());
+}
+
+MvccCommittedSet* MvccSnapshot::mutable_committed() {
+  if (!committed_) {
+    committed_ = new MvccCommittedSet();
+  } else if (!committed_->HasOneRef()) {
+    // Some other snapshot still refers to this set: copy it before writing.
+    committed_ = committed_->Clone();
+  }
+  return committed_.get();
+}
+
+////////////////////////////////////////////////////////////
+// MvccCommittedSet
+////////////////////////////////////////////////////////////
+
+MvccCommittedSet::MvccCommittedSet()
+  : bitmap_base_(0) {
+}
+
+scoped_refptr<MvccCommittedSet> MvccCommittedSet::Clone() const {
+  scoped_refptr<MvccCommittedSet> copy(new MvccCommittedSet());
+  copy->timestamps_ = timestamps_;
+  copy->bitmap_base_ = bitmap_base_;
+  copy->bitmap_ = bitmap_;
+  return copy;
+}
+
+bool MvccCommittedSet::Contains(Timestamp::val_type ts) const {
+  if (!bitmap_.empty()) {
+    if (ts < bitmap_base_ || ts - bitmap_base_ >= kBitmapBits) return false;
+    Timestamp::val_type bit = ts - bitmap_base_;
+    return bitmap_[bit / 64] & (1ULL << (bit % 64));
+  }
+  return std::binary_search(timestamps_.begin(), timestamps_.end(), ts);
+}
+
+void MvccCommittedSet::Insert(Timestamp::val_type ts) {
+  auto it = std::lower_bound(timestamps_.begin(), timestamps_.end(), ts);
+  if (it != timestamps_.end() && *it == ts) return;
+  timestamps_.insert(it, ts);
+
+  // Commits mostly arrive in increasing order just above the existing ones,
+  // so the bitmap can usually just be updated in place.
+  if (!bitmap_.empty() && ts >= bitmap_base_ && ts - bitmap_base_ < kBitmapBits) {
+    Timestamp::val_type bit = ts - bitmap_base_;
+    bitmap_[bit / 64] |= 1ULL << (bit % 64);
+    return;
+  }
+  RebuildBitmap();
+}
+
+void MvccCommittedSet::RemoveBelow(Timestamp::val_type watermark) {
+  timestamps_.erase(timestamps_.begin(),
+                    std::lower_bound(timestamps_.begin(), timestamps_.end(), watermark));
+  RebuildBitmap();
+}
+
+void MvccCommittedSet::RebuildBitmap() {
+  if (timestamps_.empty() || timestamps_.back() - timestamps_.front() >= kBitmapBits) {
+    bitmap_.clear();
+    return;
+  }
+  bitmap_base_ = timestamps_.front();
+  bitmap_.assign(kBitmapWords, 0);
+  for (Timestamp::val_type ts : timestamps_) {
+    Timestamp::val_type bit = ts - bitmap_base_;
+    bitmap_[bit / 64] |= 1ULL << (bit % 64);
+  }
 }
 
 ////////////////////////////////////////////////////////////
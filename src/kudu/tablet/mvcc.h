@@ -18,6 +18,8 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -28,6 +30,7 @@
 #include "kudu/common/timestamp.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/ref_counted.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
@@ -38,6 +41,58 @@ class MonoTime;
 namespace tablet {
 class MvccManager;
 
+// The set of transactions committed above a snapshot's clean watermark.
+//
+// Snapshots are taken much more often than this set changes, so copies of a
+// snapshot share one refcounted set, and the snapshot being modified copies it
+// first if anyone else still holds it (copy-on-write).
+//
+// The timestamps are kept sorted. While they span a small range they are also
+// encoded as a bitmap over that range, making a membership test a single bit
+// probe; otherwise it falls back to a binary search.
+class MvccCommittedSet : public RefCountedThreadSafe<MvccCommittedSet> {
+ public:
+  MvccCommittedSet();
+
+  // Return a new, unshared copy of this set.
+  scoped_refptr<MvccCommittedSet> Clone() const;
+
+  bool Contains(Timestamp::val_type ts) const;
+
+  // Add 'ts' to the set, if not already present.
+  void Insert(Timestamp::val_type ts);
+
+  // Remove all timestamps lower than 'watermark'.
+  void RemoveBelow(Timestamp::val_type watermark);
+
+  bool empty() const { return timestamps_.empty(); }
+  size_t size() const { return timestamps_.size(); }
+
+  // The timestamps in the set, in increasing order.
+  const std::vector<Timestamp::val_type>& timestamps() const { return timestamps_; }
+
+ private:
+  friend class RefCountedThreadSafe<MvccCommittedSet>;
+  ~MvccCommittedSet() {}
+
+  // Re-encode the bitmap to start at the lowest timestamp, or drop it if
+  // the timestamps span more than kBitmapBits.
+  void RebuildBitmap();
+
+  // The number of consecutive timestamps the bitmap can cover.
+  static const int kBitmapWords = 64;
+  static const uint64_t kBitmapBits = kBitmapWords * 64;
+
+  std::vector<Timestamp::val_type> timestamps_;
+
+  // If non-empty, bit i of 'bitmap_' is set iff (bitmap_base_ + i) is in the
+  // set, for every timestamp in the set.
+  Timestamp::val_type bitmap_base_;
+  std::vector<uint64_t> bitmap_;
+
+  DISALLOW_COPY_AND_ASSIGN(MvccCommittedSet);
+};
+
 // A snapshot of the current MVCC state, which can determine whether
 // a transaction ID should be considered visible.
 class MvccSnapshot {
@@ -101,7 +156,7 @@ class MvccSnapshot {
   // transactions with timestamps less than some timestamp to be committed,
   // and all other transactions to be uncommitted.
   bool is_clean() const {
-    return committed_timestamps_.empty();
+    return !committed_ || committed_->empty();
   }
 
   // Consider the given list of timestamps to be committed in this snapshot,
@@ -126,16 +181,23 @@ class MvccSnapshot {
 
   void AddCommittedTimestamp(Timestamp timestamp);
 
+  // Remove committed timestamps which fall below the clean watermark.
+  void RemoveCommittedTimestampsBelow(Timestamp watermark);
+
+  // Return the committed set, first making sure this snapshot is its only
+  // holder so that it can be modified.
+  MvccCommittedSet* mutable_committed();
+
   // Summary rule:
   //   A transaction T is committed if and only if:
   //      T < all_committed_before_ or
-  //   or committed_timestamps_.contains(T)
+  //   or committed_->Contains(T)
   //
   // In ASCII form, where 'C' represents a committed transaction,
   // and 'U' represents an uncommitted one:
   //
   //   CCCCCCCCCCCCCCCCCUUUUUCUUUCU
-  //                    |    \___\___ committed_timestamps_
+  //                    |    \___\___ committed_
   //                    |
   //                    \- all_committed_before_
 
@@ -146,18 +208,16 @@ class MvccSnapshot {
 
   // A transaction ID at or beyond which no transactions have been committed.
   // For any timestamp X, if X >= none_committed_after_, then X is uncommitted.
-  // This is equivalent to max(committed_timestamps_) + 1, but since
-  // that vector is unsorted, we cache it.
+  // This is equivalent to max(committed_) + 1, cached so that the common
+  // case in IsCommitted() doesn't have to consult the set.
   Timestamp none_committed_at_or_after_;
 
   // The set of transactions higher than all_committed_before_timestamp_ which
-  // are committed in this snapshot.
-  // It might seem like using an unordered_set<> or a set<> would be faster here,
-  // but in practice, this list tends to be stay pretty small, and is only
-  // rarely consulted (most data will be culled by 'all_committed_before_'
-  // or none_committed_at_or_after_. So, using the compact vector structure fits
-  // the whole thing on one or two cache lines, and it ends up going faster.
-  std::vector<Timestamp::val_type> committed_timestamps_;
+  // are committed in this snapshot, or null if there are none. This is rarely
+  // consulted (most lookups are culled by 'all_committed_before_' or
+  // 'none_committed_at_or_after_'), but shared between copies of the snapshot
+  // so that taking a snapshot doesn't copy it.
+  scoped_refptr<MvccCommittedSet> committed_;
 
 };
 
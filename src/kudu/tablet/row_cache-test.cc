@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/row_cache.h"
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/row.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/test_util.h"
+
+using std::shared_ptr;
+using std::string;
+using strings::Substitute;
+
+namespace kudu {
+namespace tablet {
+
+class RowCacheTest : public KuduTest {
+ public:
+  RowCacheTest()
+      : schema_({ ColumnSchema("key", INT32),
+                  ColumnSchema("val", STRING) }, 1),
+        builder_(schema_) {
+  }
+
+ protected:
+  // Builds the row { key, val } in 'builder_'.
+  ConstContiguousRow BuildRow(int32_t key, const string& val) {
+    builder_.Reset();
+    builder_.AddInt32(key);
+    builder_.AddString(val);
+    return builder_.row();
+  }
+
+  // Returns the value of the cached row with 'key', or "" if it isn't cached.
+  string LookupVal(RowCache* cache, const string& key) {
+    shared_ptr<const RowCache::Entry> entry = cache->Lookup(key);
+    if (!entry) {
+      return "";
+    }
+    return schema_.ExtractColumnFromRow<STRING>(entry->row(), 1)->ToString();
+  }
+
+  const Schema schema_;
+  RowBuilder builder_;
+};
+
+TEST_F(RowCacheTest, TestInsertAndLookup) {
+  RowCache cache(schema_, 1024 * 1024);
+  ASSERT_EQ("", LookupVal(&cache, "a"));
+
+  uint64_t token = cache.PrepareInsert("a");
+  ASSERT_TRUE(cache.Insert("a", token, BuildRow(1, "first")));
+  ASSERT_EQ(1, cache.num_entries());
+
+  // The cached row is a copy, which outlives the row it was inserted from.
+  BuildRow(2, "other");
+  ASSERT_EQ("first", LookupVal(&cache, "a"));
+
+  // Inserting the row again replaces it.
+  token = cache.PrepareInsert("a");
+  ASSERT_TRUE(cache.Insert("a", token, BuildRow(1, "second")));
+  ASSERT_EQ(1, cache.num_entries());
+  ASSERT_EQ("second", LookupVal(&cache, "a"));
+}
+
+// Test that rows aren't inserted if they may be older than a write of them.
+TEST_F(RowCacheTest, TestMutationsPreventInserts) {
+  RowCache cache(schema_, 1024 * 1024);
+
+  // A write which starts after the token is taken prevents the insert.
+  uint64_t token = cache.PrepareInsert("a");
+  cache.BeginMutation("a");
+  ASSERT_FALSE(cache.Insert("a", token, BuildRow(1, "stale")));
+
+  // So does a write which is still in flight, even with a fresh token.
+  token = cache.PrepareInsert("a");
+  ASSERT_FALSE(cache.Insert("a", token, BuildRow(1, "stale")));
+
+  // And one which ends after the token is taken.
+  cache.EndMutation("a");
+  ASSERT_FALSE(cache.Insert("a", token, BuildRow(1, "stale")));
+  ASSERT_EQ(0, cache.num_entries());
+
+  token = cache.PrepareInsert("a");
+  ASSERT_TRUE(cache.Insert("a", token, BuildRow(1, "fresh")));
+
+  // Writes evict the rows they mutate, both when they start and when they end.
+  cache.BeginMutation("a");
+  ASSERT_EQ("", LookupVal(&cache, "a"));
+  cache.EndMutation("a");
+  ASSERT_EQ(0, cache.num_entries());
+
+  // A lookup which started before the write still holds the row.
+  token = cache.PrepareInsert("a");
+  ASSERT_TRUE(cache.Insert("a", token, BuildRow(1, "fresh")));
+  shared_ptr<const RowCache::Entry> entry = cache.Lookup("a");
+  cache.BeginMutation("a");
+  cache.EndMutation("a");
+  ASSERT_EQ("fresh", schema_.ExtractColumnFromRow<STRING>(entry->row(), 1)->ToString());
+}
+
+TEST_F(RowCacheTest, TestEviction) {
+  const int kNumRows = 10000;
+  RowCache cache(schema_, 64 * 1024);
+  for (int i = 0; i < kNumRows; i++) {
+    string key = Substitute("key-$0", i);
+    uint64_t token = cache.PrepareInsert(key);
+    ASSERT_TRUE(cache.Insert(key, token, BuildRow(i, string(100, 'x'))));
+  }
+  ASSERT_GT(cache.num_entries(), 0);
+  ASSERT_LT(cache.num_entries(), kNumRows);
+
+  // The most recently inserted rows are the ones that are still cached.
+  ASSERT_NE("", LookupVal(&cache, Substitute("key-$0", kNumRows - 1)));
+  ASSERT_EQ("", LookupVal(&cache, "key-0"));
+}
+
+} // namespace tablet
+} // namespace kudu
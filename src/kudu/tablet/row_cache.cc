@@ -0,0 +1,143 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/row_cache.h"
+
+#include <mutex>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/map-util.h"
+
+using std::shared_ptr;
+using std::string;
+
+namespace kudu {
+namespace tablet {
+
+RowCache::Entry::Entry(const Schema* schema, string key)
+    : schema_(schema),
+      key_(std::move(key)),
+      arena_(schema->byte_size() + 64),
+      row_data_(nullptr) {
+}
+
+RowCache::RowCache(const Schema& schema, int64_t capacity_bytes)
+    : schema_(schema),
+      shard_capacity_bytes_(capacity_bytes / kNumShards) {
+}
+
+RowCache::~RowCache() {
+}
+
+RowCache::Shard* RowCache::ShardFor(const Slice& key) {
+  uint64_t hash = util_hash::CityHash64(reinterpret_cast<const char*>(key.data()), key.size());
+  return &shards_[hash % kNumShards];
+}
+
+shared_ptr<const RowCache::Entry> RowCache::Lookup(const Slice& key) {
+  Shard* shard = ShardFor(key);
+  string key_str = key.ToString();
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  LruList::iterator* it = FindOrNull(shard->entries, key_str);
+  if (!it) {
+    return nullptr;
+  }
+  shard->lru.splice(shard->lru.begin(), shard->lru, *it);
+  return **it;
+}
+
+uint64_t RowCache::PrepareInsert(const Slice& key) {
+  Shard* shard = ShardFor(key);
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  return shard->version;
+}
+
+bool RowCache::Insert(const Slice& key, uint64_t token, const ConstContiguousRow& row) {
+  DCHECK_SCHEMA_EQ(schema_, *row.schema());
+  Shard* shard = ShardFor(key);
+
+  // Copy the row before taking the lock, even though it may not be inserted.
+  shared_ptr<Entry> entry(new Entry(&schema_, key.ToString()));
+  uint8_t* row_data = static_cast<uint8_t*>(entry->arena_.AllocateBytes(schema_.byte_size()));
+  if (PREDICT_FALSE(!row_data)) {
+    return false;
+  }
+  ContiguousRow dst(&schema_, row_data);
+  if (PREDICT_FALSE(!CopyRow(row, &dst, &entry->arena_).ok())) {
+    return false;
+  }
+  entry->row_data_ = row_data;
+  int64_t charge = entry->charge();
+
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  if (shard->version != token || shard->mutations_in_flight > 0) {
+    return false;
+  }
+  EvictUnlocked(shard, entry->key_);
+  shard->lru.push_front(entry);
+  InsertOrDie(&shard->entries, entry->key_, shard->lru.begin());
+  shard->usage += charge;
+  while (shard->usage > shard_capacity_bytes_ && !shard->lru.empty()) {
+    EvictUnlocked(shard, shard->lru.back()->key_);
+  }
+  return true;
+}
+
+void RowCache::BeginMutation(const Slice& key) {
+  Shard* shard = ShardFor(key);
+  string key_str = key.ToString();
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  shard->version++;
+  shard->mutations_in_flight++;
+  EvictUnlocked(shard, key_str);
+}
+
+void RowCache::EndMutation(const Slice& key) {
+  Shard* shard = ShardFor(key);
+  string key_str = key.ToString();
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  DCHECK_GT(shard->mutations_in_flight, 0);
+  shard->version++;
+  shard->mutations_in_flight--;
+  EvictUnlocked(shard, key_str);
+}
+
+size_t RowCache::num_entries() const {
+  size_t num_entries = 0;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    num_entries += shard.entries.size();
+  }
+  return num_entries;
+}
+
+void RowCache::EvictUnlocked(Shard* shard, const string& key) {
+  auto it = shard->entries.find(key);
+  if (it == shard->entries.end()) {
+    return;
+  }
+  const shared_ptr<Entry>& entry = *it->second;
+  shard->usage -= entry->charge();
+  shard->lru.erase(it->second);
+  shard->entries.erase(it);
+}
+
+} // namespace tablet
+} // namespace kudu
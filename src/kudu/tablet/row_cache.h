@@ -0,0 +1,157 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_ROW_CACHE_H
+#define KUDU_TABLET_ROW_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/common/row.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+namespace tablet {
+
+// A cache of the latest versions of the rows of a tablet, keyed by their
+// encoded primary keys, which serves READ_LATEST point lookups of hot keys
+// without building iterators over the tablet's rowsets.
+//
+// To keep the cache consistent with writes, each write of a row calls
+// BeginMutation() on its key once it holds the row's lock, before it applies
+// the mutation, and EndMutation() once it's committed or aborted in MVCC,
+// before it releases the lock. Both evict the row. A lookup which missed
+// inserts the row it read only if no write to a key of the same shard
+// started or ended since it called PrepareInsert(), which it must do before
+// taking its MVCC snapshot, and none is in flight. So the cache never holds a
+// version of a row older than a committed write of it, nor one which an
+// in-flight write is about to replace.
+//
+// Rows are evicted in LRU order once a shard holds more than its share of the
+// capacity.
+//
+// This class is thread-safe.
+class RowCache {
+ public:
+  // A cached row. It remains valid for as long as it's referenced, even once
+  // evicted.
+  class Entry {
+   public:
+    ConstContiguousRow row() const {
+      return ConstContiguousRow(schema_, row_data_);
+    }
+
+   private:
+    friend class RowCache;
+
+    Entry(const Schema* schema, std::string key);
+
+    // The memory this entry takes.
+    int64_t charge() const {
+      return sizeof(*this) + key_.size() + arena_.memory_footprint();
+    }
+
+    const Schema* schema_;
+    const std::string key_;
+    Arena arena_;
+    const uint8_t* row_data_;
+
+    DISALLOW_COPY_AND_ASSIGN(Entry);
+  };
+
+  // Creates a cache of rows of 'schema' which holds about 'capacity_bytes' of
+  // them.
+  RowCache(const Schema& schema, int64_t capacity_bytes);
+  ~RowCache();
+
+  // The schema of the cached rows.
+  const Schema& schema() const { return schema_; }
+
+  // Returns the row with encoded key 'key', or null if it isn't cached.
+  std::shared_ptr<const Entry> Lookup(const Slice& key);
+
+  // Returns a token to insert the row with encoded key 'key' with. It must be
+  // taken before the MVCC snapshot the row is read at.
+  uint64_t PrepareInsert(const Slice& key);
+
+  // Inserts 'row', which has schema() and the encoded key 'key', unless a
+  // write to a key of the same shard started or ended since PrepareInsert()
+  // returned 'token', or is in flight. Returns whether it was inserted.
+  bool Insert(const Slice& key, uint64_t token, const ConstContiguousRow& row);
+
+  // Evicts the row with encoded key 'key', and prevents it from being inserted
+  // until a matching EndMutation(). Must be called by writes of the row before
+  // they apply their mutation.
+  void BeginMutation(const Slice& key);
+
+  // Evicts the row with encoded key 'key' again, once a write of it has been
+  // committed or aborted.
+  void EndMutation(const Slice& key);
+
+  // Returns the number of cached rows.
+  size_t num_entries() const;
+
+ private:
+  typedef std::list<std::shared_ptr<Entry>> LruList;
+
+  struct Shard {
+    Shard() : usage(0), version(0), mutations_in_flight(0) {}
+
+    mutable simple_spinlock lock;
+
+    // The cached rows, most recently used first, and an index of them by key.
+    LruList lru;
+    std::unordered_map<std::string, LruList::iterator> entries;
+
+    // The memory footprint of the cached rows.
+    int64_t usage;
+
+    // Incremented by every mutation started or ended. The tokens returned by
+    // PrepareInsert() are versions.
+    uint64_t version;
+
+    // The number of mutations started and not ended yet.
+    int64_t mutations_in_flight;
+  };
+
+  enum {
+    kNumShards = 16
+  };
+
+  Shard* ShardFor(const Slice& key);
+
+  // Evicts the row with encoded key 'key' from 'shard', if it's cached.
+  void EvictUnlocked(Shard* shard, const std::string& key);
+
+  const Schema schema_;
+  const int64_t shard_capacity_bytes_;
+  Shard shards_[kNumShards];
+
+  DISALLOW_COPY_AND_ASSIGN(RowCache);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif /* KUDU_TABLET_ROW_CACHE_H */
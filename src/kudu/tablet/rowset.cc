@@ -181,6 +181,17 @@ Status DuplicatingRowSet::MutateRow(Timestamp timestamp,
   return Status::OK();
 }
 
+Status RowSet::CheckRowsPresent(ArrayView<const RowSetKeyProbe* const> probes,
+                                const IOContext* io_context,
+                                bool* present,
+                                ArrayView<ProbeStats* const> stats) const {
+  DCHECK_EQ(probes.size(), stats.size());
+  for (size_t i = 0; i < probes.size(); i++) {
+    RETURN_NOT_OK(CheckRowPresent(*probes[i], io_context, &present[i], stats[i]));
+  }
+  return Status::OK();
+}
+
 Status DuplicatingRowSet::CheckRowPresent(const RowSetKeyProbe &probe, const IOContext* io_context,
                                           bool *present, ProbeStats* stats) const {
   *present = false;
@@ -37,6 +37,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/util/array_view.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/status.h"
 // IWYU pragma: no_include "kudu/util/monotime.h"
@@ -121,6 +122,17 @@ class RowSet {
   virtual Status CheckRowPresent(const RowSetKeyProbe &probe, const fs::IOContext* io_context,
                                  bool *present, ProbeStats* stats) const = 0;
 
+  // Batched version of CheckRowPresent(): sets present[i] for probes[i],
+  // accounting the work against stats[i]. The probes should be sorted by
+  // encoded key.
+  //
+  // The default implementation checks each probe in turn; rowsets for which
+  // batching saves work override it.
+  virtual Status CheckRowsPresent(ArrayView<const RowSetKeyProbe* const> probes,
+                                  const fs::IOContext* io_context,
+                                  bool* present,
+                                  ArrayView<ProbeStats* const> stats) const;
+
   // Update/delete a row in this rowset.
   // The 'update_schema' is the client schema used to encode the 'update' RowChangeList.
   //
@@ -218,6 +230,12 @@ class RowSet {
   virtual Status EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark,
                                                              int64_t* bytes) = 0;
 
+  // Return true if DeleteAncientUndoDeltas() would delete any blocks, i.e. if
+  // the oldest undo delta block is initialized and has a max timestamp earlier
+  // than 'ancient_history_mark'. This is cheap: it only looks at the oldest
+  // block.
+  virtual bool HasAncientUndoDeltas(Timestamp ancient_history_mark) const = 0;
+
   // Initialize undo delta blocks until the given 'deadline' is passed, or
   // until all undo delta blocks with a max timestamp older than
   // 'ancient_history_mark' have been initialized.
@@ -283,6 +301,13 @@ class RowSet {
     return try_lock.owns_lock() && !has_been_compacted();
   }
 
+  // Return the number of reads (scans and row key probes) this rowset has
+  // served since it was opened. Compaction policies use this as a measure of
+  // how "hot" the rowset is. Rowsets that don't track reads return 0.
+  virtual uint64_t ReadCount() const {
+    return 0;
+  }
+
   // Checked while validating that a rowset is available for compaction.
   virtual bool has_been_compacted() const = 0;
 
@@ -465,6 +490,10 @@ class DuplicatingRowSet : public RowSet {
     return Status::OK();
   }
 
+  bool HasAncientUndoDeltas(Timestamp /*ancient_history_mark*/) const OVERRIDE {
+    return false;
+  }
+
   Status InitUndoDeltas(Timestamp /*ancient_history_mark*/,
                         MonoTime /*deadline*/,
                         const fs::IOContext* /*io_context*/,
@@ -91,8 +91,8 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[3].get(), out[0]); // MemRowSet
   ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
-
-  // interval [3,4) overlaps 0-5, 3-5 and the MemRowSet
+
+  // interval [3,4) overlaps 0-5, 3-5 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(Slice("3"), Slice("4"), &out);
   ASSERT_EQ(3, out.size());
@@ -105,9 +105,9 @@ TEST_F(TestRowSetTree, TestTree) {
   tree.FindRowSetsIntersectingInterval(Slice("0"), Slice("2"), &out);
   ASSERT_EQ(2, out.size());
   ASSERT_EQ(vec[3].get(), out[0]);
-  ASSERT_EQ(vec[0].get(), out[1]);
-
-  // interval [5,7) overlaps 0-5, 3-5, 5-9 and the MemRowSet
+  ASSERT_EQ(vec[0].get(), out[1]);
+
+  // interval [5,7) overlaps 0-5, 3-5, 5-9 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(Slice("5"), Slice("7"), &out);
   ASSERT_EQ(4, out.size());
@@ -116,32 +116,32 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[1].get(), out[2]);
   ASSERT_EQ(vec[2].get(), out[3]);
 
-  // "3" overlaps 0-5, 3-5, and the MemRowSet.
-  out.clear();
-  tree.FindRowSetsWithKeyInRange("3", &out);
-  ASSERT_EQ(3, out.size());
-  ASSERT_EQ(vec[3].get(), out[0]); // MemRowSet
-  ASSERT_EQ(vec[0].get(), out[1]);
+  // "3" overlaps 0-5, 3-5, and the MemRowSet.
+  out.clear();
+  tree.FindRowSetsWithKeyInRange("3", &out);
+  ASSERT_EQ(3, out.size());
+  ASSERT_EQ(vec[3].get(), out[0]); // MemRowSet
+  ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
 
-  // "5" overlaps 0-5, 3-5, 5-9, and the MemRowSet
-  out.clear();
-  tree.FindRowSetsWithKeyInRange("5", &out);
-  ASSERT_EQ(4, out.size());
-  ASSERT_EQ(vec[3].get(), out[0]); // MemRowSet
-  ASSERT_EQ(vec[0].get(), out[1]);
-  ASSERT_EQ(vec[1].get(), out[2]);
-  ASSERT_EQ(vec[2].get(), out[3]);
-
-  // interval [0,5) overlaps 0-5, 3-5, and the MemRowSet
-  out.clear();
-  tree.FindRowSetsIntersectingInterval(Slice("0"), Slice("5"), &out);
-  ASSERT_EQ(3, out.size());
-  ASSERT_EQ(vec[3].get(), out[0]);
-  ASSERT_EQ(vec[0].get(), out[1]);
+  // "5" overlaps 0-5, 3-5, 5-9, and the MemRowSet
+  out.clear();
+  tree.FindRowSetsWithKeyInRange("5", &out);
+  ASSERT_EQ(4, out.size());
+  ASSERT_EQ(vec[3].get(), out[0]); // MemRowSet
+  ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
-
-  // interval [3,5) overlaps 0-5, 3-5 and the MemRowSet
+  ASSERT_EQ(vec[2].get(), out[3]);
+
+  // interval [0,5) overlaps 0-5, 3-5, and the MemRowSet
+  out.clear();
+  tree.FindRowSetsIntersectingInterval(Slice("0"), Slice("5"), &out);
+  ASSERT_EQ(3, out.size());
+  ASSERT_EQ(vec[3].get(), out[0]);
+  ASSERT_EQ(vec[0].get(), out[1]);
+  ASSERT_EQ(vec[1].get(), out[2]);
+
+  // interval [3,5) overlaps 0-5, 3-5 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(Slice("3"), Slice("5"), &out);
   ASSERT_EQ(3, out.size());
@@ -149,14 +149,14 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
 
-  // interval [-OO,3) overlaps 0-5 and the MemRowSet
+  // interval [-OO,3) overlaps 0-5 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(boost::none, Slice("3"), &out);
   ASSERT_EQ(2, out.size());
   ASSERT_EQ(vec[3].get(), out[0]);
   ASSERT_EQ(vec[0].get(), out[1]);
 
-  // interval [-OO,5) overlaps 0-5, 3-5 and the MemRowSet
+  // interval [-OO,5) overlaps 0-5, 3-5 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(boost::none, Slice("5"), &out);
   ASSERT_EQ(3, out.size());
@@ -164,7 +164,7 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
 
-  // interval [-OO,99) overlaps 0-5, 3-5, 5-9 and the MemRowSet
+  // interval [-OO,99) overlaps 0-5, 3-5, 5-9 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(boost::none, Slice("99"), &out);
   ASSERT_EQ(4, out.size());
@@ -172,15 +172,15 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
   ASSERT_EQ(vec[2].get(), out[3]);
-
-  // interval [6,+OO) overlaps 5-9 and the MemRowSet
+
+  // interval [6,+OO) overlaps 5-9 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(Slice("6"), boost::none, &out);
   ASSERT_EQ(2, out.size());
   ASSERT_EQ(vec[3].get(), out[0]);
   ASSERT_EQ(vec[2].get(), out[1]);
-
-  // interval [5,+OO) overlaps 0-5, 3-5, 5-9 and the MemRowSet
+
+  // interval [5,+OO) overlaps 0-5, 3-5, 5-9 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(Slice("5"), boost::none, &out);
   ASSERT_EQ(4, out.size());
@@ -188,8 +188,8 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
   ASSERT_EQ(vec[2].get(), out[3]);
-
-  // interval [4,+OO) overlaps 0-5, 3-5, 5-9 and the MemRowSet
+
+  // interval [4,+OO) overlaps 0-5, 3-5, 5-9 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(Slice("4"), boost::none, &out);
   ASSERT_EQ(4, out.size());
@@ -198,7 +198,7 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[1].get(), out[2]);
   ASSERT_EQ(vec[2].get(), out[3]);
 
-  // interval [-OO,+OO) overlaps 0-5, 3-5, 5-9 and the MemRowSet
+  // interval [-OO,+OO) overlaps 0-5, 3-5, 5-9 and the MemRowSet
   out.clear();
   tree.FindRowSetsIntersectingInterval(boost::none, boost::none, &out);
   ASSERT_EQ(4, out.size());
@@ -208,6 +208,41 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[2].get(), out[3]);
 }
 
+// Check point queries against a brute-force scan of the bounds, both with
+// mostly-disjoint rowsets and with enough overlap at a point that the lookup
+// has to fall back to the interval tree.
+TEST_F(TestRowSetTree, TestFindRowSetsWithKeyInRangeMatchesBruteForce) {
+  SeedRandom();
+  for (int num_rowsets : { 10, 100, 500 }) {
+    RowSetVector vec = GenerateRandomRowSets(num_rowsets);
+    // Add a few rowsets spanning the whole key space.
+    for (int i = 0; i < 3; i++) {
+      vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("0000", "9999")));
+    }
+    RowSetTree tree;
+    ASSERT_OK(tree.Reset(vec));
+
+    for (int i = 0; i < 1000; i++) {
+      string key = StringPrintf("%04d", rand() % 10000);
+      vector<RowSet*> out;
+      tree.FindRowSetsWithKeyInRange(key, &out);
+
+      unordered_set<RowSet*> expected;
+      for (const auto& rs : vec) {
+        string min_key, max_key;
+        ASSERT_OK(rs->GetBounds(&min_key, &max_key));
+        if (min_key <= key && key <= max_key) {
+          expected.insert(rs.get());
+        }
+      }
+      ASSERT_EQ(expected.size(), out.size()) << key;
+      for (RowSet* rs : out) {
+        ASSERT_TRUE(ContainsKey(expected, rs)) << key;
+      }
+    }
+  }
+}
+
 TEST_F(TestRowSetTree, TestTreeRandomized) {
   enum BoundOperator {
     BOUND_LESS_THAN,
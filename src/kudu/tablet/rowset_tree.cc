@@ -27,6 +27,7 @@
 
 #include <glog/logging.h>
 
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
@@ -62,6 +63,11 @@ struct QueryStruct {
   int idx;
 };
 
+// If more than this many rowsets start before a point query's key and
+// aren't excluded by the prefix maximum, the query falls back to the interval
+// tree rather than scanning them all.
+const int kMaxFlatScanLength = 64;
+
 } // anonymous namespace
 
 // Entry for use in the interval tree.
@@ -176,6 +182,7 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   unbounded_rowsets_.swap(unbounded);
   tree_.reset(new IntervalTree<RowSetIntervalTraits>(entries_));
   key_endpoints_.swap(endpoints);
+  BuildFlatBounds();
   all_rowsets_.assign(rowsets.begin(), rowsets.end());
 
   // Build the mapping from DRS ID to DRS.
@@ -191,6 +198,51 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   return Status::OK();
 }
 
+void RowSetTree::BuildFlatBounds() {
+  vector<const RowSetWithBounds*> sorted(entries_.begin(), entries_.end());
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const RowSetWithBounds* a, const RowSetWithBounds* b) {
+                     return a->min_key < b->min_key;
+                   });
+
+  // Copy all the keys into one buffer first, and only then take slices of
+  // it, so that growing the buffer can't invalidate them.
+  size_t total_size = 0;
+  for (const auto* e : sorted) {
+    total_size += e->min_key.size() + e->max_key.size();
+  }
+  flat_key_data_.clear();
+  flat_key_data_.reserve(total_size);
+  for (const auto* e : sorted) {
+    flat_key_data_.append(e->min_key);
+    flat_key_data_.append(e->max_key);
+  }
+
+  flat_min_keys_.clear();
+  flat_max_keys_.clear();
+  flat_prefix_max_keys_.clear();
+  flat_rowsets_.clear();
+  flat_min_keys_.reserve(sorted.size());
+  flat_max_keys_.reserve(sorted.size());
+  flat_prefix_max_keys_.reserve(sorted.size());
+  flat_rowsets_.reserve(sorted.size());
+  const char* p = flat_key_data_.data();
+  for (const auto* e : sorted) {
+    Slice min_key(p, e->min_key.size());
+    p += min_key.size();
+    Slice max_key(p, e->max_key.size());
+    p += max_key.size();
+    flat_min_keys_.push_back(min_key);
+    flat_max_keys_.push_back(max_key);
+    if (flat_prefix_max_keys_.empty() || flat_prefix_max_keys_.back().compare(max_key) < 0) {
+      flat_prefix_max_keys_.push_back(max_key);
+    } else {
+      flat_prefix_max_keys_.push_back(flat_prefix_max_keys_.back());
+    }
+    flat_rowsets_.push_back(e->rowset);
+  }
+}
+
 void RowSetTree::FindRowSetsIntersectingInterval(const boost::optional<Slice>& lower_bound,
                                                  const boost::optional<Slice>& upper_bound,
                                                  vector<RowSet*>* rowsets) const {
@@ -219,8 +271,26 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
     rowsets->push_back(rs.get());
   }
 
-  // Query the interval tree to efficiently find rowsets with known bounds
-  // whose ranges overlap the probe key.
+  // Only rowsets starting at or before the key can contain it, and of those,
+  // the ones before 'begin' all end before it.
+  Slice::Comparator less;
+  auto end = std::upper_bound(flat_min_keys_.begin(), flat_min_keys_.end(),
+                              encoded_key, less) - flat_min_keys_.begin();
+  auto begin = std::lower_bound(flat_prefix_max_keys_.begin(),
+                                flat_prefix_max_keys_.begin() + end,
+                                encoded_key, less) - flat_prefix_max_keys_.begin();
+  if (PREDICT_TRUE(end - begin <= kMaxFlatScanLength)) {
+    for (auto i = begin; i < end; i++) {
+      if (flat_max_keys_[i].compare(encoded_key) >= 0) {
+        rowsets->push_back(flat_rowsets_[i]);
+      }
+    }
+    return;
+  }
+
+  // Too many candidates overlap the key's neighborhood: query the interval
+  // tree to efficiently find rowsets with known bounds whose ranges overlap
+  // the probe key.
   vector<RowSetWithBounds *> from_tree;
   from_tree.reserve(all_rowsets_.size());
   tree_->FindContainingPoint(encoded_key, &from_tree);
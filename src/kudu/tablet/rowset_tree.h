@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <functional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -71,6 +72,7 @@ class RowSetTree {
   ~RowSetTree();
 
   // Return all RowSets whose range may contain the given encoded key.
+  // The disk rowsets are returned in order of increasing minimum key.
   //
   // The returned pointers are guaranteed to be valid at least until this
   // RowSetTree object is Reset().
@@ -110,6 +112,9 @@ class RowSetTree {
   const std::vector<RSEndpoint>& key_endpoints() const { return key_endpoints_; }
 
  private:
+  // Populate the flat_* members from 'entries_'.
+  void BuildFlatBounds();
+
   // Interval tree of the rowsets. Used to efficiently find rowsets which might contain
   // a probe row.
   gscoped_ptr<IntervalTree<RowSetIntervalTraits> > tree_;
@@ -124,6 +129,18 @@ class RowSetTree {
   // all the entry structs and free them in the destructor.
   std::vector<RowSetWithBounds *> entries_;
 
+  // Flattened copy of the bounds in 'entries_', sorted by min key, which
+  // FindRowSetsWithKeyInRange() binary searches instead of walking the
+  // pointer-based interval tree. All of the keys point into 'flat_key_data_',
+  // so a search touches a few contiguous arrays.
+  std::vector<Slice> flat_min_keys_;
+  std::vector<Slice> flat_max_keys_;
+  // flat_prefix_max_keys_[i] is the greatest of flat_max_keys_[0..i]: the
+  // rowsets before the first entry >= a key all end before that key.
+  std::vector<Slice> flat_prefix_max_keys_;
+  std::vector<RowSet*> flat_rowsets_;
+  std::string flat_key_data_;
+
   // All of the rowsets which were put in this RowSetTree.
   RowSetVector all_rowsets_;
 
@@ -51,6 +51,8 @@
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/opid.pb.h"
+#include "kudu/fs/data_dirs.h"
+#include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/fs/io_context.h"
 #include "kudu/gutil/bind.h"
@@ -65,6 +67,7 @@
 #include "kudu/tablet/delta_tracker.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/memrowset.h"
+#include "kudu/tablet/row_cache.h"
 #include "kudu/tablet/row_op.h"
 #include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_metadata.h"
@@ -90,6 +93,7 @@
 #include "kudu/util/process_memory.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status_callback.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/throttler.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/url-coding.h"
@@ -98,6 +102,30 @@ DEFINE_int32(tablet_compaction_budget_mb, 128,
              "Budget for a single compaction");
 TAG_FLAG(tablet_compaction_budget_mb, experimental);
 
+DEFINE_string(tablet_compaction_policy, "budgeted",
+              "The policy used to select rowsets for compaction. 'budgeted' "
+              "minimizes the average rowset height within a fixed I/O budget "
+              "per compaction; 'hybrid' additionally bounds write amplification "
+              "by switching to tiered, small-rowset compactions once "
+              "-compaction_write_amp_budget is exceeded.");
+TAG_FLAG(tablet_compaction_policy, experimental);
+
+static bool ValidateCompactionPolicy(const char* flagname, const std::string& value) {
+  if (value == "budgeted" || value == "hybrid") {
+    return true;
+  }
+  LOG(ERROR) << strings::Substitute("$0: unknown compaction policy '$1'", flagname, value);
+  return false;
+}
+DEFINE_validator(tablet_compaction_policy, &ValidateCompactionPolicy);
+
+DEFINE_int32(tablet_compaction_num_partitions, 1,
+             "Maximum number of key ranges into which a compaction's input is "
+             "split. Each range is merged and written to its own output rowsets "
+             "by a separate thread. Flushes of a MemRowSet are never split.");
+TAG_FLAG(tablet_compaction_num_partitions, advanced);
+TAG_FLAG(tablet_compaction_num_partitions, experimental);
+
 DEFINE_int32(tablet_bloom_block_size, 4096,
              "Block size of the bloom filters used for tablet keys.");
 TAG_FLAG(tablet_bloom_block_size, advanced);
@@ -109,6 +137,14 @@ DEFINE_double(tablet_bloom_target_fp_rate, 0.0001f,
               "required for bloom filters.");
 TAG_FLAG(tablet_bloom_target_fp_rate, advanced);
 
+DEFINE_bool(tablet_bloom_split_block, false,
+            "Whether newly written tablet key bloom filters use the split-block "
+            "layout, which confines the bits of each key to a single cache line "
+            "so that a probe costs one cache miss instead of one per hash. Files "
+            "written with this layout can't be read by older versions of Kudu.");
+TAG_FLAG(tablet_bloom_split_block, experimental);
+TAG_FLAG(tablet_bloom_split_block, runtime);
+
 
 DEFINE_double(fault_crash_before_flush_tablet_meta_after_compaction, 0.0,
               "Fraction of the time, during compaction, to crash before flushing metadata");
@@ -134,6 +170,13 @@ DEFINE_double(tablet_throttler_burst_factor, 1.0f,
              "base rate.");
 TAG_FLAG(tablet_throttler_burst_factor, experimental);
 
+DEFINE_int64(tablet_row_cache_capacity_mb, 0,
+             "Capacity of the cache of each tablet's rows which serves point "
+             "lookups of a single primary key at the latest snapshot, in MiB. "
+             "Rows are cached when such lookups project all the columns, and "
+             "evicted when they're written. 0 disables the cache.");
+TAG_FLAG(tablet_row_cache_capacity_mb, experimental);
+
 DEFINE_int32(tablet_history_max_age_sec, 15 * 60,
              "Number of seconds to retain tablet history. Reads initiated at a "
              "snapshot that is older than this age will be rejected. "
@@ -177,6 +220,7 @@ using std::ostream;
 using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
 using strings::Substitute;
@@ -189,6 +233,9 @@ struct IteratorStats;
 namespace tablet {
 
 static CompactionPolicy *CreateCompactionPolicy() {
+  if (FLAGS_tablet_compaction_policy == "hybrid") {
+    return new HybridCompactionPolicy(FLAGS_tablet_compaction_budget_mb);
+  }
   return new BudgetedCompactionPolicy(FLAGS_tablet_compaction_budget_mb);
 }
 
@@ -245,6 +292,11 @@ Tablet::Tablet(scoped_refptr<TabletMetadata> metadata,
                                    FLAGS_tablet_throttler_bytes_per_sec,
                                    FLAGS_tablet_throttler_burst_factor));
   }
+
+  if (FLAGS_tablet_row_cache_capacity_mb > 0) {
+    row_cache_ = std::make_shared<RowCache>(*schema(),
+                                            FLAGS_tablet_row_cache_capacity_mb * 1024 * 1024);
+  }
 }
 
 Tablet::~Tablet() {
@@ -263,7 +315,7 @@ Status Tablet::Open() {
   TRACE_EVENT0("tablet", "Tablet::Open");
   RETURN_IF_STOPPED_OR_CHECK_STATE(kInitialized);
 
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
   CHECK(schema()->has_column_ids());
 
   next_mrs_id_ = metadata_->last_durable_mrs_id() + 1;
@@ -350,7 +402,7 @@ void Tablet::Shutdown() {
   Stop();
   UnregisterMaintenanceOps();
 
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
   components_ = nullptr;
   {
     std::lock_guard<simple_spinlock> l(state_lock_);
@@ -375,7 +427,10 @@ Status Tablet::GetMappedReadProjection(const Schema& projection,
 
 BloomFilterSizing Tablet::DefaultBloomSizing() {
   return BloomFilterSizing::BySizeAndFPRate(FLAGS_tablet_bloom_block_size,
-                                            FLAGS_tablet_bloom_target_fp_rate);
+                                            FLAGS_tablet_bloom_target_fp_rate,
+                                            FLAGS_tablet_bloom_split_block ?
+                                            BloomFilterLayout::SPLIT_BLOCK :
+                                            BloomFilterLayout::CLASSIC);
 }
 
 void Tablet::SplitKeyRange(const EncodedKey* start_key,
@@ -385,7 +440,7 @@ void Tablet::SplitKeyRange(const EncodedKey* start_key,
                            std::vector<KeyRange>* key_range_info) {
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
 
@@ -406,7 +461,9 @@ Status Tablet::NewRowIterator(const Schema& projection,
   // Yield current rows.
   opts.snap_to_include = MvccSnapshot(mvcc_);
   opts.projection = &projection;
-  return NewRowIterator(std::move(opts), iter);
+  RETURN_NOT_OK(NewRowIterator(std::move(opts), iter));
+  down_cast<Iterator*>(iter->get())->use_row_cache_ = true;
+  return Status::OK();
 }
 
 Status Tablet::NewRowIterator(RowIteratorOptions opts,
@@ -458,8 +515,31 @@ Status Tablet::AcquireRowLocks(WriteTransactionState* tx_state) {
   TRACE_EVENT1("tablet", "Tablet::AcquireRowLocks",
                "num_locks", tx_state->row_ops().size());
   TRACE("PREPARE: Acquiring locks for $0 operations", tx_state->row_ops().size());
-  for (RowOp* op : tx_state->row_ops()) {
-    RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+  const auto& row_ops = tx_state->row_ops();
+  vector<Slice> keys;
+  keys.reserve(row_ops.size());
+  for (RowOp* op : row_ops) {
+    ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
+    op->key_probe.reset(new tablet::RowSetKeyProbe(row_key));
+    RETURN_NOT_OK(CheckRowInTablet(row_key));
+    keys.push_back(op->key_probe->encoded_key_slice());
+  }
+
+  // Lock the whole batch in one pass rather than row by row.
+  vector<ScopedRowLock> locks;
+  ScopedRowLock::LockRows(&lock_manager_, tx_state, keys, LockManager::LOCK_EXCLUSIVE, &locks);
+  for (int i = 0; i < row_ops.size(); i++) {
+    row_ops[i]->row_lock = std::move(locks[i]);
+  }
+
+  // Keep the rows out of the row cache until the transaction is committed.
+  // The transaction ends the mutations when it releases the locks.
+  shared_ptr<RowCache> row_cache = this->row_cache();
+  if (row_cache) {
+    for (const Slice& key : keys) {
+      row_cache->BeginMutation(key);
+    }
+    tx_state->set_row_cache(std::move(row_cache));
   }
   TRACE("PREPARE: locks acquired");
   return Status::OK();
@@ -612,7 +692,8 @@ Status Tablet::ValidateMutateUnlocked(const RowOp& op) const {
 Status Tablet::InsertOrUpsertUnlocked(const IOContext* io_context,
                                       WriteTransactionState *tx_state,
                                       RowOp* op,
-                                      ProbeStats* stats) {
+                                      ProbeStats* stats,
+                                      MemRowSet::InsertHint* mrs_hint) {
   DCHECK(op->checked_present);
   DCHECK(op->validated);
 
@@ -634,12 +715,12 @@ Status Tablet::InsertOrUpsertUnlocked(const IOContext* io_context,
   Timestamp ts = tx_state->timestamp();
   ConstContiguousRow row(schema(), op->decoded_op.row_data);
 
-  // TODO: the Insert() call below will re-encode the key, which is a
-  // waste. Should pass through the KeyProbe structure perhaps.
-
   // Now try to op into memrowset. The memrowset itself will return
   // AlreadyPresent if it has already been oped there.
-  Status s = comps->memrowset->Insert(ts, row, tx_state->op_id());
+  MemRowSet::InsertHint local_hint;
+  Status s = comps->memrowset->Insert(ts, row, op->key_probe->encoded_key_slice(),
+                                      tx_state->op_id(),
+                                      mrs_hint ? mrs_hint : &local_hint);
   if (s.ok()) {
     op->SetInsertSucceeded(comps->memrowset->mrs_id());
   } else {
@@ -783,7 +864,7 @@ Status Tablet::MutateRowUnlocked(const IOContext* io_context,
 }
 
 void Tablet::StartApplying(WriteTransactionState* tx_state) {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   tx_state->StartApplying();
   tx_state->set_tablet_components(components_);
 }
@@ -853,6 +934,11 @@ Status Tablet::BulkCheckPresence(const IOContext* io_context, WriteTransactionSt
   // 'pending_group' and then calls 'ProcessPendingGroup' when the next group
   // begins.
   vector<pair<RowSet*, int>> pending_group;
+  // Scratch space for the batch of probes sent to each rowset.
+  vector<int> batch_op_idxs;
+  vector<const RowSetKeyProbe*> batch_probes;
+  vector<ProbeStats*> batch_stats;
+  unique_ptr<bool[]> batch_present(new bool[keys.size()]);
   Status s;
   const auto& ProcessPendingGroup = [&]() {
     if (pending_group.empty() || !s.ok()) return;
@@ -866,27 +952,37 @@ Status Tablet::BulkCheckPresence(const IOContext* io_context, WriteTransactionSt
                             return s_a.compare(s_b) < 0;
                           }));
     RowSet* rs = pending_group[0].first;
-    for (auto it = pending_group.begin();
-         it != pending_group.end();
-         ++it) {
-      DCHECK_EQ(it->first, rs) << "All results within a group should be for the same RowSet";
-      int op_idx = keys_and_indexes[it->second].second;
+    batch_op_idxs.clear();
+    batch_probes.clear();
+    batch_stats.clear();
+    for (const auto& p : pending_group) {
+      DCHECK_EQ(p.first, rs) << "All results within a group should be for the same RowSet";
+      int op_idx = keys_and_indexes[p.second].second;
       RowOp* op = row_ops_base[op_idx];
       if (op->present_in_rowset) {
         // Already found this op present somewhere.
         continue;
       }
+      batch_op_idxs.push_back(op_idx);
+      batch_probes.push_back(op->key_probe.get());
+      batch_stats.push_back(tx_state->mutable_op_stats(op_idx));
+    }
+    if (batch_probes.empty()) {
+      pending_group.clear();
+      return;
+    }
 
-      bool present = false;
-      s = rs->CheckRowPresent(*op->key_probe, io_context,
-                              &present, tx_state->mutable_op_stats(op_idx));
-      if (PREDICT_FALSE(!s.ok())) {
-        LOG(WARNING) << Substitute("Tablet $0 failed to check row presence for op $1: $2",
-            tablet_id(), op->ToString(key_schema_), s.ToString());
-        return;
-      }
-      if (present) {
-        op->present_in_rowset = rs;
+    // Check the whole group against the rowset at once, so that it can batch
+    // its bloom filter probes and key index seeks.
+    s = rs->CheckRowsPresent(batch_probes, io_context, batch_present.get(), batch_stats);
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(WARNING) << Substitute("Tablet $0 failed to check row presence for $1 ops: $2",
+          tablet_id(), batch_probes.size(), s.ToString());
+      return;
+    }
+    for (int i = 0; i < batch_op_idxs.size(); i++) {
+      if (batch_present[i]) {
+        row_ops_base[batch_op_idxs[i]]->present_in_rowset = rs;
       }
     }
     pending_group.clear();
@@ -940,13 +1036,32 @@ Status Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
   IOContext io_context({ tablet_id() });
   RETURN_NOT_OK(BulkCheckPresence(&io_context, tx_state));
 
-  // Actually apply the ops.
+  // Apply the ops in key order, so that inserts into the MemRowSet can each
+  // pick up where the previous one left off in the tree, and so that the
+  // mutations of each DiskRowSet are applied together. The sort is stable so
+  // that ops on the same row are applied in the order the client sent them.
+  RowOp* const * row_ops_base = tx_state->row_ops().data();
+  vector<int> op_idxs;
+  op_idxs.reserve(num_ops);
   for (int op_idx = 0; op_idx < num_ops; op_idx++) {
-    RowOp* row_op = tx_state->row_ops()[op_idx];
-    if (row_op->has_result()) continue;
+    if (!row_ops_base[op_idx]->has_result()) {
+      op_idxs.push_back(op_idx);
+    }
+  }
+  const auto& KeyLess = [&](int a, int b) {
+    return row_ops_base[a]->key_probe->encoded_key_slice().compare(
+        row_ops_base[b]->key_probe->encoded_key_slice()) < 0;
+  };
+  if (!std::is_sorted(op_idxs.begin(), op_idxs.end(), KeyLess)) {
+    std::stable_sort(op_idxs.begin(), op_idxs.end(), KeyLess);
+  }
 
+  // Actually apply the ops.
+  MemRowSet::InsertHint mrs_hint;
+  for (int op_idx : op_idxs) {
+    RowOp* row_op = row_ops_base[op_idx];
     RETURN_NOT_OK(ApplyRowOperation(&io_context, tx_state, row_op,
-                                    tx_state->mutable_op_stats(op_idx)));
+                                    tx_state->mutable_op_stats(op_idx), &mrs_hint));
     DCHECK(row_op->has_result());
   }
 
@@ -959,7 +1074,8 @@ Status Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
 Status Tablet::ApplyRowOperation(const IOContext* io_context,
                                  WriteTransactionState* tx_state,
                                  RowOp* row_op,
-                                 ProbeStats* stats) {
+                                 ProbeStats* stats,
+                                 MemRowSet::InsertHint* mrs_hint) {
   {
     std::lock_guard<simple_spinlock> l(state_lock_);
     RETURN_NOT_OK_PREPEND(CheckHasNotBeenStoppedUnlocked(),
@@ -996,7 +1112,7 @@ Status Tablet::ApplyRowOperation(const IOContext* io_context,
   switch (row_op->decoded_op.type) {
     case RowOperationsPB::INSERT:
     case RowOperationsPB::UPSERT:
-      s = InsertOrUpsertUnlocked(io_context, tx_state, row_op, stats);
+      s = InsertOrUpsertUnlocked(io_context, tx_state, row_op, stats, mrs_hint);
       if (s.IsAlreadyPresent()) {
         return Status::OK();
       }
@@ -1054,7 +1170,7 @@ void Tablet::ModifyRowSetTree(const RowSetTree& old_tree,
 
 void Tablet::AtomicSwapRowSets(const RowSetVector &old_rowsets,
                                const RowSetVector &new_rowsets) {
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
   AtomicSwapRowSetsUnlocked(old_rowsets, new_rowsets);
 }
 
@@ -1133,7 +1249,7 @@ Status Tablet::FlushUnlocked() {
   shared_ptr<MemRowSet> old_mrs;
   {
     // Create a new MRS with the latest schema.
-    std::lock_guard<rw_spinlock> lock(component_lock_);
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
     RETURN_NOT_OK(ReplaceMemRowSetUnlocked(&input, &old_mrs));
   }
 
@@ -1278,6 +1394,13 @@ Status Tablet::AlterSchema(AlterSchemaTransactionState *tx_state) {
     return metadata_->Flush();
   }
 
+  // The cached rows have the old schema. No writes are in flight while the
+  // schema lock is held, so none has begun mutations in the old cache.
+  {
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
+    ResetRowCacheUnlocked();
+  }
+
   return FlushUnlocked();
 }
 
@@ -1293,7 +1416,7 @@ Status Tablet::RewindSchemaForBootstrap(const Schema& new_schema,
 
   metadata_->SetSchema(new_schema, schema_version);
   {
-    std::lock_guard<rw_spinlock> lock(component_lock_);
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
 
     shared_ptr<MemRowSet> old_mrs = components_->memrowset;
     shared_ptr<RowSetTree> old_rowsets = components_->rowsets;
@@ -1304,10 +1427,23 @@ Status Tablet::RewindSchemaForBootstrap(const Schema& new_schema,
                                     mem_trackers_.tablet_tracker,
                                     &new_mrs));
     components_ = new TabletComponents(new_mrs, old_rowsets);
+    ResetRowCacheUnlocked();
   }
   return Status::OK();
 }
 
+void Tablet::ResetRowCacheUnlocked() {
+  if (row_cache_) {
+    row_cache_ = std::make_shared<RowCache>(*schema(),
+                                            FLAGS_tablet_row_cache_capacity_mb * 1024 * 1024);
+  }
+}
+
+shared_ptr<RowCache> Tablet::row_cache() const {
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return row_cache_;
+}
+
 void Tablet::SetCompactionHooksForTests(
   const shared_ptr<Tablet::CompactionFaultHooks> &hooks) {
   compaction_hooks_ = hooks;
@@ -1324,7 +1460,7 @@ void Tablet::SetFlushCompactCommonHooksForTests(
 }
 
 int32_t Tablet::CurrentMrsIdForTests() const {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   return components_->memrowset->mrs_id();
 }
 
@@ -1343,7 +1479,7 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
   // in tablet.h for details on why that would be bad.
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
 
@@ -1369,7 +1505,7 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
     VLOG_WITH_PREFIX(2) << "Compaction quality: " << quality;
   }
 
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   for (const shared_ptr<RowSet>& rs : components_->rowsets->all_rowsets()) {
     if (picked_set.erase(rs.get()) == 0) {
       // Not picked.
@@ -1428,7 +1564,7 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
 void Tablet::GetRowSetsForTests(RowSetVector* out) {
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
   for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
@@ -1450,20 +1586,25 @@ void Tablet::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
     DCHECK(maintenance_ops_.empty());
   }
 
+  const vector<string> data_dirs = GetDataDirUuids();
   vector<MaintenanceOp*> maintenance_ops;
   gscoped_ptr<MaintenanceOp> rs_compact_op(new CompactRowSetsOp(this));
+  rs_compact_op->set_data_dirs(data_dirs);
   maint_mgr->RegisterOp(rs_compact_op.get());
   maintenance_ops.push_back(rs_compact_op.release());
 
   gscoped_ptr<MaintenanceOp> minor_delta_compact_op(new MinorDeltaCompactionOp(this));
+  minor_delta_compact_op->set_data_dirs(data_dirs);
   maint_mgr->RegisterOp(minor_delta_compact_op.get());
   maintenance_ops.push_back(minor_delta_compact_op.release());
 
   gscoped_ptr<MaintenanceOp> major_delta_compact_op(new MajorDeltaCompactionOp(this));
+  major_delta_compact_op->set_data_dirs(data_dirs);
   maint_mgr->RegisterOp(major_delta_compact_op.get());
   maintenance_ops.push_back(major_delta_compact_op.release());
 
   gscoped_ptr<MaintenanceOp> undo_delta_block_gc_op(new UndoDeltaBlockGCOp(this));
+  undo_delta_block_gc_op->set_data_dirs(data_dirs);
   maint_mgr->RegisterOp(undo_delta_block_gc_op.get());
   maintenance_ops.push_back(undo_delta_block_gc_op.release());
 
@@ -1471,6 +1612,14 @@ void Tablet::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
   maintenance_ops_.swap(maintenance_ops);
 }
 
+vector<string> Tablet::GetDataDirUuids() const {
+  DataDirGroupPB group_pb;
+  if (!metadata_->fs_manager()->dd_manager()->GetDataDirGroupPB(tablet_id(), &group_pb).ok()) {
+    return {};
+  }
+  return vector<string>(group_pb.uuids().begin(), group_pb.uuids().end());
+}
+
 void Tablet::UnregisterMaintenanceOps() {
   // This method must be externally synchronized to not coincide with other
   // calls to it or to RegisterMaintenanceOps.
@@ -1522,7 +1671,9 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                "tablet_id", tablet_id(),
                "op", op_name);
 
-  const IOContext io_context({ tablet_id() });
+  const IOContext io_context({ tablet_id(),
+                               mrs_being_flushed == TabletMetadata::kNoMrsFlushed ?
+                                   fs::IOClass::COMPACTION : fs::IOClass::FLUSH });
 
   MvccSnapshot flush_snap(mvcc_);
   LOG_WITH_PREFIX(INFO) << op_name << ": entering phase 1 (flushing snapshot). Phase 1 snapshot: "
@@ -1533,17 +1684,25 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                           "PostTakeMvccSnapshot hook failed");
   }
 
-  shared_ptr<CompactionInput> merge;
-  RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &io_context, &merge));
-
-  RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), DefaultBloomSizing(),
-                               compaction_policy_->target_rowset_size());
-  RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
-
   HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
-  RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, history_gc_opts, &drsw),
-                        "Flush to disk failed");
-  RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
+  vector<unique_ptr<RollingDiskRowSetWriter>> writers;
+  RETURN_NOT_OK(WriteCompactionOrFlushOutput(input, flush_snap, history_gc_opts,
+                                             &io_context, &writers));
+
+  // Tally the output of all of the key ranges. The written rowsets are
+  // collected in key order, which ReupdateMissedDeltas() relies upon.
+  int64_t rows_written = 0;
+  int drs_written = 0;
+  size_t bytes_written = 0;
+  RowSetMetadataVector new_drs_metas;
+  for (const auto& w : writers) {
+    rows_written += w->rows_written_count();
+    drs_written += w->drs_written_count();
+    bytes_written += w->written_size();
+    RowSetMetadataVector metas;
+    w->GetWrittenRowSetMetadata(&metas);
+    new_drs_metas.insert(new_drs_metas.end(), metas.begin(), metas.end());
+  }
 
   if (common_hooks_) {
     RETURN_NOT_OK_PREPEND(common_hooks_->PostWriteSnapshot(),
@@ -1553,7 +1712,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // Though unlikely, it's possible that no rows were written because all of
   // the input rows were GCed in this compaction. In that case, we don't
   // actually want to reopen.
-  if (drsw.rows_written_count() == 0) {
+  if (rows_written == 0) {
     LOG_WITH_PREFIX(INFO) << op_name << " resulted in no output rows (all input rows "
                           << "were GCed!)  Removing all input rowsets.";
     return HandleEmptyCompactionOrFlush(input.rowsets(), mrs_being_flushed);
@@ -1562,10 +1721,8 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // The RollingDiskRowSet writer wrote out one or more RowSets as the
   // output. Open these into 'new_rowsets'.
   vector<shared_ptr<RowSet> > new_disk_rowsets;
-  RowSetMetadataVector new_drs_metas;
-  drsw.GetWrittenRowSetMetadata(&new_drs_metas);
 
-  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(bytes_written);
   CHECK(!new_drs_metas.empty());
   {
     TRACE_EVENT0("tablet", "Opening compaction results");
@@ -1625,7 +1782,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
     TRACE_EVENT0("tablet", "Swapping DuplicatingRowSet");
     // Taking component_lock_ in write mode ensures that no new transactions
     // can StartApplying() (or snapshot components_) during this block.
-    std::lock_guard<rw_spinlock> lock(component_lock_);
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
     AtomicSwapRowSetsUnlocked(input.rowsets(), { inprogress_rowset });
 
     // NOTE: transactions may *commit* in between these two lines.
@@ -1669,6 +1826,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   LOG_WITH_PREFIX(INFO) << op_name
                         << " Phase 2: carrying over any updates which arrived during Phase 1";
   LOG_WITH_PREFIX(INFO) << "Phase 2 snapshot: " << non_duplicated_txns_snap.ToString();
+  shared_ptr<CompactionInput> merge;
   RETURN_NOT_OK_PREPEND(
       input.CreateCompactionInput(non_duplicated_txns_snap, schema(), &io_context, &merge),
           Substitute("Failed to create $0 inputs", op_name).c_str());
@@ -1715,12 +1873,14 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // Replace the compacted rowsets with the new on-disk rowsets, making them visible now that
   // their metadata was written to disk.
   AtomicSwapRowSets({ inprogress_rowset }, new_disk_rowsets);
+  compaction_policy_->RecordBytesWritten(
+      bytes_written, mrs_being_flushed != TabletMetadata::kNoMrsFlushed);
 
   LOG_WITH_PREFIX(INFO) << Substitute("$0 successful on $1 rows ($2 rowsets, $3 bytes)",
                                       op_name,
-                                      drsw.rows_written_count(),
-                                      drsw.drs_written_count(),
-                                      drsw.written_size());
+                                      rows_written,
+                                      drs_written,
+                                      bytes_written);
 
   if (common_hooks_) {
     RETURN_NOT_OK_PREPEND(common_hooks_->PostSwapNewRowSet(),
@@ -1730,6 +1890,71 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   return Status::OK();
 }
 
+Status Tablet::WriteCompactionOrFlushOutput(
+    const RowSetsInCompaction& input,
+    const MvccSnapshot& snap,
+    const HistoryGcOpts& history_gc_opts,
+    const IOContext* io_context,
+    vector<unique_ptr<RollingDiskRowSetWriter>>* writers) {
+  vector<string> split_keys;
+  input.GetPartitionSplitKeys(FLAGS_tablet_compaction_num_partitions, &split_keys);
+  const int num_partitions = split_keys.size() + 1;
+
+  // Set up an input and a writer for each key range. Every range's input
+  // merges all of the rowsets, but yields only the rows within the range.
+  vector<shared_ptr<CompactionInput>> inputs;
+  for (int i = 0; i < num_partitions; i++) {
+    shared_ptr<CompactionInput> merge;
+    RETURN_NOT_OK(input.CreateCompactionInput(snap, schema(), io_context, &merge));
+    if (num_partitions > 1) {
+      string lower_bound = i == 0 ? "" : split_keys[i - 1];
+      string upper_bound = i == num_partitions - 1 ? "" : split_keys[i];
+      shared_ptr<CompactionInput> range(CompactionInput::KeyRange(
+          std::move(merge), std::move(lower_bound), std::move(upper_bound)));
+      merge = std::move(range);
+    }
+    unique_ptr<RollingDiskRowSetWriter> drsw(
+        new RollingDiskRowSetWriter(metadata_.get(), merge->schema(), DefaultBloomSizing(),
+                                    compaction_policy_->target_rowset_size(),
+                                    io_context->io_class));
+    RETURN_NOT_OK_PREPEND(drsw->Open(), "Failed to open DiskRowSet for flush");
+    inputs.emplace_back(std::move(merge));
+    writers->emplace_back(std::move(drsw));
+  }
+
+  auto write_partition = [&](int i) {
+    RETURN_NOT_OK_PREPEND(FlushCompactionInput(inputs[i].get(), snap, history_gc_opts,
+                                               (*writers)[i].get()),
+                          "Flush to disk failed");
+    RETURN_NOT_OK_PREPEND((*writers)[i]->Finish(), "Failed to finish DRS writer");
+    return Status::OK();
+  };
+  if (num_partitions == 1) {
+    return write_partition(0);
+  }
+
+  LOG_WITH_PREFIX(INFO) << Substitute("Writing compaction output in $0 key ranges",
+                                      num_partitions);
+  gscoped_ptr<ThreadPool> pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("compaction-partition")
+                .set_min_threads(0)
+                .set_max_threads(num_partitions)
+                .Build(&pool));
+  vector<Status> statuses(num_partitions);
+  for (int i = 0; i < num_partitions; i++) {
+    Status s = pool->SubmitFunc([&, i]() { statuses[i] = write_partition(i); });
+    if (!s.ok()) {
+      statuses[i] = s;
+    }
+  }
+  pool->Wait();
+  pool->Shutdown();
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
 Status Tablet::HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
                                             int mrs_being_flushed) {
   // Write out the new Tablet Metadata and remove old rowsets.
@@ -1778,7 +2003,7 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
 
@@ -1796,7 +2021,7 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 
 
 Status Tablet::DebugDump(vector<string> *lines) {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
 
   LOG_STRING(INFO, lines) << "Dumping tablet:";
   LOG_STRING(INFO, lines) << "---------------------------";
@@ -1817,7 +2042,7 @@ Status Tablet::CaptureConsistentIterators(
     const ScanSpec* spec,
     vector<shared_ptr<RowwiseIterator>>* iters) const {
 
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   RETURN_IF_STOPPED_OR_CHECK_STATE(kOpen);
 
   // Construct all the iterators locally first, so that if we fail
@@ -2202,6 +2427,8 @@ Status Tablet::InitAncientUndoDeltas(MonoDelta time_budget, int64_t* bytes_in_an
   // Initialize the rowsets largest-first.
   int64_t tablet_bytes_in_ancient_undos = 0;
   for (const auto& rs_est_size : rowset_ancient_undos_est_sizes) {
+    // The remaining rowsets have no undos which may be ancient.
+    if (rs_est_size.second == 0) break;
     size_t index = rs_est_size.first;
     const auto& rowset = rowsets[index];
     int64_t rowset_blocks_initialized;
@@ -2235,6 +2462,8 @@ Status Tablet::DeleteAncientUndoDeltas(int64_t* blocks_deleted, int64_t* bytes_d
   GetComponents(&comps);
 
   // We need to hold the compact_flush_lock for each rowset we GC undos from.
+  // Only the rowsets which have ancient undos to delete are locked, so that
+  // the others remain available for compaction meanwhile.
   RowSetVector rowsets_to_gc_undos;
   vector<std::unique_lock<std::mutex>> rowset_locks;
   {
@@ -2242,7 +2471,8 @@ Status Tablet::DeleteAncientUndoDeltas(int64_t* blocks_deleted, int64_t* bytes_d
     // same rowsets for compaction while we delete old undos.
     std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
     for (const auto& rowset : comps->rowsets->all_rowsets()) {
-      if (!rowset->IsAvailableForCompaction()) {
+      if (!rowset->HasAncientUndoDeltas(ancient_history_mark) ||
+          !rowset->IsAvailableForCompaction()) {
         continue;
       }
       std::unique_lock<std::mutex> lock(*rowset->compact_flush_lock(), std::try_to_lock);
@@ -2306,7 +2536,7 @@ int64_t Tablet::CountRedoDeltasForTests() const {
 }
 
 size_t Tablet::num_rowsets() const {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   return components_ ? components_->rowsets->all_rowsets().size() : 0;
 }
 
@@ -2316,7 +2546,7 @@ void Tablet::PrintRSLayout(ostream* o) {
 
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
   std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
@@ -2430,7 +2660,12 @@ Tablet::Iterator::Iterator(const Tablet* tablet,
     : tablet_(tablet),
       io_context_({ tablet->tablet_id() }),
       projection_(*CHECK_NOTNULL(opts.projection)),
-      opts_(std::move(opts)) {
+      opts_(std::move(opts)),
+      use_row_cache_(false),
+      served_from_row_cache_(false),
+      fill_row_cache_(false),
+      row_cache_token_(0),
+      fill_row_(nullptr) {
   opts_.io_context = &io_context_;
   opts_.projection = &projection_;
 }
@@ -2443,6 +2678,13 @@ Status Tablet::Iterator::Init(ScanSpec *spec) {
 
   RETURN_NOT_OK(tablet_->GetMappedReadProjection(projection_, &projection_));
 
+  if (use_row_cache_) {
+    RETURN_NOT_OK(InitRowCacheLookup(spec));
+    if (served_from_row_cache_) {
+      return Status::OK();
+    }
+  }
+
   vector<shared_ptr<RowwiseIterator>> iters;
   RETURN_NOT_OK(tablet_->CaptureConsistentIterators(opts_, spec, &iters));
   TRACE_COUNTER_INCREMENT("rowset_iterators", iters.size());
@@ -2461,20 +2703,118 @@ Status Tablet::Iterator::Init(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status Tablet::Iterator::InitRowCacheLookup(const ScanSpec* spec) {
+  // Only lookups of a whole primary key, with no other predicates, can use
+  // the cache. The scan spec was optimized, so the key is the lower bound,
+  // and the upper bound is the key that follows it.
+  if (spec == nullptr || !spec->predicates().empty() ||
+      spec->lower_bound_key() == nullptr || spec->exclusive_upper_bound_key() == nullptr) {
+    return Status::OK();
+  }
+  const EncodedKey* key = spec->lower_bound_key();
+  const Schema& key_schema = tablet_->key_schema();
+  if (key->raw_keys().size() != key_schema.num_key_columns()) {
+    return Status::OK();
+  }
+  row_cache_ = tablet_->row_cache();
+  if (!row_cache_) {
+    return Status::OK();
+  }
+  Arena arena(256);
+  gscoped_ptr<EncodedKey> next_key;
+  RETURN_NOT_OK(EncodedKey::DecodeEncodedString(key_schema, &arena, key->encoded_key(),
+                                                &next_key));
+  Status s = EncodedKey::IncrementEncodedKey(key_schema, &next_key, &arena);
+  if (!s.ok() ||
+      next_key->encoded_key() != spec->exclusive_upper_bound_key()->encoded_key()) {
+    // The key may have no successor, if it's the greatest one.
+    row_cache_.reset();
+    return Status::OK();
+  }
+  row_cache_key_ = key->encoded_key().ToString();
+
+  // Prepare to insert the row before taking the snapshot it's read at. See
+  // RowCache.
+  row_cache_token_ = row_cache_->PrepareInsert(row_cache_key_);
+  opts_.snap_to_include = MvccSnapshot(tablet_->mvcc_);
+
+  cached_row_ = row_cache_->Lookup(row_cache_key_);
+  if (cached_row_) {
+    row_cache_projector_.reset(new RowProjector(&row_cache_->schema(), &projection_));
+    if (row_cache_projector_->Init().ok()) {
+      TRACE_COUNTER_INCREMENT("row_cache_hits", 1);
+      served_from_row_cache_ = true;
+      return Status::OK();
+    }
+    cached_row_.reset();
+    row_cache_projector_.reset();
+  }
+  TRACE_COUNTER_INCREMENT("row_cache_misses", 1);
+  fill_row_cache_ = projection_.Equals(row_cache_->schema());
+  return Status::OK();
+}
+
+void Tablet::Iterator::MaybeFillRowCache(const RowBlock& block) {
+  size_t num_selected = block.selection_vector()->CountSelected();
+  if (num_selected > 1 || (num_selected == 1 && fill_row_)) {
+    fill_row_cache_ = false;
+    return;
+  }
+  if (num_selected == 1) {
+    size_t idx = 0;
+    while (!block.selection_vector()->IsRowSelected(idx)) {
+      idx++;
+    }
+    fill_arena_.reset(new Arena(projection_.byte_size() + 64));
+    uint8_t* row_data = static_cast<uint8_t*>(
+        fill_arena_->AllocateBytes(projection_.byte_size()));
+    ContiguousRow row(&projection_, row_data);
+    if (!row_data || !CopyRow(block.row(idx), &row, fill_arena_.get()).ok()) {
+      fill_row_cache_ = false;
+      return;
+    }
+    fill_row_ = row_data;
+  }
+  if (!iter_->HasNext() && fill_row_) {
+    fill_row_cache_ = false;
+    row_cache_->Insert(row_cache_key_, row_cache_token_,
+                       ConstContiguousRow(&projection_, fill_row_));
+  }
+}
+
 bool Tablet::Iterator::HasNext() const {
+  if (served_from_row_cache_) {
+    return cached_row_ != nullptr;
+  }
   DCHECK(iter_.get() != nullptr) << "Not initialized!";
   return iter_->HasNext();
 }
 
 Status Tablet::Iterator::NextBlock(RowBlock *dst) {
+  if (served_from_row_cache_) {
+    DCHECK(cached_row_);
+    dst->Resize(1);
+    dst->selection_vector()->SetAllTrue();
+    RowBlockRow row = dst->row(0);
+    RETURN_NOT_OK(row_cache_projector_->ProjectRowForRead(cached_row_->row(), &row,
+                                                          dst->arena()));
+    cached_row_.reset();
+    return Status::OK();
+  }
   DCHECK(iter_.get() != nullptr) << "Not initialized!";
-  return iter_->NextBlock(dst);
+  RETURN_NOT_OK(iter_->NextBlock(dst));
+  if (fill_row_cache_) {
+    MaybeFillRowCache(*dst);
+  }
+  return Status::OK();
 }
 
 string Tablet::Iterator::ToString() const {
   string s;
   s.append("tablet iterator: ");
-  if (iter_.get() == nullptr) {
+  if (served_from_row_cache_) {
+    s.append("row cache");
+  } else if (iter_.get() == nullptr) {
     s.append("NULL");
   } else {
     s.append(iter_->ToString());
@@ -2487,6 +2827,10 @@ const Schema& Tablet::Iterator::schema() const {
 }
 
 void Tablet::Iterator::GetIteratorStats(vector<IteratorStats>* stats) const {
+  if (served_from_row_cache_) {
+    stats->assign(projection_.num_columns(), IteratorStats());
+    return;
+  }
   iter_->GetIteratorStats(stats);
 }
 
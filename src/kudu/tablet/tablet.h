@@ -42,6 +42,7 @@
 #include "kudu/gutil/threading/thread_collision_warner.h"
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/tablet/row_cache.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/tablet_mem_trackers.h"
 #include "kudu/tablet/tablet_metadata.h"
@@ -74,13 +75,19 @@ class LogAnchorRegistry;
 
 namespace tablet {
 
+namespace btree {
+template<class Traits> struct MutationHint;
+}
+
 class AlterSchemaTransactionState;
 class CompactionPolicy;
 class HistoryGcOpts;
 class MemRowSet;
+class RollingDiskRowSetWriter;
 class RowSetTree;
 class RowSetsInCompaction;
 class WriteTransactionState;
+struct MSBTreeTraits;
 struct RowOp;
 struct TabletComponents;
 struct TabletMetrics;
@@ -184,14 +191,25 @@ class Tablet {
 
   // Apply a single row operation, which must already be prepared.
   // The result is set back into row_op->result.
+  //
+  // If 'mrs_hint' is non-NULL, an insert into the MemRowSet starts its search
+  // from where the previous one through the same hint landed. See
+  // MemRowSet::Insert().
   Status ApplyRowOperation(const fs::IOContext* io_context,
                            WriteTransactionState* tx_state,
                            RowOp* row_op,
-                           ProbeStats* stats) WARN_UNUSED_RESULT;
+                           ProbeStats* stats,
+                           btree::MutationHint<MSBTreeTraits>* mrs_hint = nullptr)
+      WARN_UNUSED_RESULT;
 
   // Create a new row iterator which yields the rows as of the current MVCC
   // state of this tablet.
   // The returned iterator is not initialized.
+  //
+  // If the tablet has a row cache, a point lookup of a single primary key
+  // through the iterator is served from the cache if the row is there, and
+  // otherwise inserts the row it reads into the cache, if it projects all the
+  // columns.
   Status NewRowIterator(const Schema& projection,
                         gscoped_ptr<RowwiseIterator>* iter) const;
 
@@ -366,6 +384,11 @@ class Tablet {
   // Return the Lock Manager for this tablet
   LockManager* lock_manager() { return &lock_manager_; }
 
+  // Returns the row cache of this tablet, or null if it has none. See
+  // --tablet_row_cache_capacity_mb.
+  // This method takes a read lock on component_lock_ and is thread-safe.
+  std::shared_ptr<RowCache> row_cache() const;
+
   const TabletMetadata *metadata() const { return metadata_.get(); }
   TabletMetadata *metadata() { return metadata_.get(); }
   scoped_refptr<TabletMetadata> shared_metadata() const { return metadata_; }
@@ -403,6 +426,10 @@ class Tablet {
   // Register the maintenance ops associated with this tablet
   void RegisterMaintenanceOps(MaintenanceManager* maint_mgr);
 
+  // Returns the UUIDs of the data dirs the blocks of this tablet go to, or
+  // an empty vector if the tablet has no data dir group.
+  std::vector<std::string> GetDataDirUuids() const;
+
   // Unregister the maintenance ops associated with this tablet. This will wait
   // for all ops to finish before returning.
   //
@@ -520,6 +547,10 @@ class Tablet {
 
   Status FlushUnlocked();
 
+  // Replaces the row cache, if there is one, with an empty one for the current
+  // schema. Must be called with component_lock_ held exclusively.
+  void ResetRowCacheUnlocked();
+
   // Validate the contents of 'op' and return a bad Status if it is invalid.
   Status ValidateOp(const RowOp& op) const;
 
@@ -544,7 +575,8 @@ class Tablet {
   Status InsertOrUpsertUnlocked(const fs::IOContext* io_context,
                                 WriteTransactionState *tx_state,
                                 RowOp* op,
-                                ProbeStats* stats);
+                                ProbeStats* stats,
+                                btree::MutationHint<MSBTreeTraits>* mrs_hint);
 
   // Same as above, but for UPDATE.
   Status MutateRowUnlocked(const fs::IOContext* io_context,
@@ -591,6 +623,20 @@ class Tablet {
   Status DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                                   int64_t mrs_being_flushed);
 
+  // Performs phase 1 of a merge compaction or flush: writes the rows of
+  // 'input' visible in 'snap' to new rowsets, appending one finished writer
+  // per key range to 'writers'. The ranges are disjoint and ordered by key,
+  // so the concatenation of the writers' output is sorted.
+  //
+  // When --tablet_compaction_num_partitions is greater than 1 and the input
+  // can be partitioned, each key range is merged and written concurrently.
+  Status WriteCompactionOrFlushOutput(
+      const RowSetsInCompaction& input,
+      const MvccSnapshot& snap,
+      const HistoryGcOpts& history_gc_opts,
+      const fs::IOContext* io_context,
+      std::vector<std::unique_ptr<RollingDiskRowSetWriter>>* writers);
+
   // Handle the case in which a compaction or flush yielded no output rows.
   // In this case, we just need to remove the rowsets in 'rowsets' from the
   // metadata and flush it.
@@ -617,7 +663,7 @@ class Tablet {
                                  const RowSetVector &to_add);
 
   void GetComponents(scoped_refptr<TabletComponents>* comps) const {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     *comps = components_;
   }
 
@@ -687,7 +733,11 @@ class Tablet {
   // NOTE: callers should avoid taking this lock for a long time, even in shared mode.
   // This is because the lock has some concept of fairness -- if, while a long reader
   // is active, a writer comes along, then all future short readers will be blocked.
-  mutable rw_spinlock component_lock_;
+  //
+  // Every write batch and scan takes this lock in shared mode, while only flushes
+  // and compactions take it exclusively, so it is a per-CPU lock: readers on
+  // different cores never bounce the same cache line.
+  mutable percpu_rwlock component_lock_;
 
   // The current components of the tablet. These should always be read
   // or swapped under the component_lock.
@@ -702,6 +752,10 @@ class Tablet {
 
   std::unique_ptr<Throttler> throttler_;
 
+  // The cache of rows for point lookups, if enabled. It's replaced by an empty
+  // one when the schema changes. Protected by component_lock_.
+  std::shared_ptr<RowCache> row_cache_;
+
   int64_t next_mrs_id_;
 
   // A pointer to the server's clock.
@@ -804,11 +858,42 @@ class Tablet::Iterator : public RowwiseIterator {
   Iterator(const Tablet* tablet,
            RowIteratorOptions opts);
 
+  // Sets up the iterator to serve the point lookup of 'spec' from the row
+  // cache, if it is one and the row is cached, or to insert the row into the
+  // cache otherwise. Does nothing if the lookup can't use the cache.
+  Status InitRowCacheLookup(const ScanSpec* spec);
+
+  // Inserts the single row selected in 'block' into the row cache, once the
+  // lookup is done, if it's the only row the lookup returns.
+  void MaybeFillRowCache(const RowBlock& block);
+
   const Tablet* tablet_;
   fs::IOContext io_context_;
   Schema projection_;
   RowIteratorOptions opts_;
   gscoped_ptr<RowwiseIterator> iter_;
+
+  // Whether point lookups through this iterator may use the tablet's row
+  // cache. Only set for iterators over the current MVCC state.
+  bool use_row_cache_;
+
+  // The row cache used by the lookup, and its encoded primary key.
+  std::shared_ptr<RowCache> row_cache_;
+  std::string row_cache_key_;
+
+  // On a hit, the cached row, until it's returned, and the projector from the
+  // cache's schema to 'projection_'. 'served_from_row_cache_' is set if 'iter_'
+  // isn't used at all.
+  std::shared_ptr<const RowCache::Entry> cached_row_;
+  std::unique_ptr<RowProjector> row_cache_projector_;
+  bool served_from_row_cache_;
+
+  // On a miss, whether the row read may still be inserted into the cache, the
+  // token to insert it with, and a copy of the row once it's been read.
+  bool fill_row_cache_;
+  uint64_t row_cache_token_;
+  std::unique_ptr<Arena> fill_arena_;
+  const uint8_t* fill_row_;
 };
 
 // Structure which represents the components of the tablet's storage.
@@ -27,6 +27,7 @@
 #include <vector>
 
 #include <boost/optional/optional.hpp>
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -78,6 +79,9 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_int32(tablet_bootstrap_max_deferred_ops);
+DECLARE_int32(tablet_bootstrap_prefetch_entries);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -267,6 +271,69 @@ TEST_F(BootstrapTest, TestBootstrapHighOpIdIndex) {
   ASSERT_OPID_EQ(last_opid, boot_info.last_committed_id);
 }
 
+// Test that bootstrap replays every entry, in order, when the log is read on a
+// separate prefetch thread.
+TEST_F(BootstrapTest, TestBootstrapWithPrefetch) {
+  FLAGS_tablet_bootstrap_prefetch_entries = 3;
+  const int kNumSegments = 4;
+  const int kNumEntriesPerSegment = 10;
+  ASSERT_OK(BuildLog());
+  for (int i = 0; i < kNumSegments; i++) {
+    ASSERT_OK(AppendReplicateBatchAndCommitEntryPairsToLog(kNumEntriesPerSegment));
+    ASSERT_OK(RollLog());
+  }
+
+  shared_ptr<Tablet> tablet;
+  ConsensusBootstrapInfo boot_info;
+  ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+  OpId last_opid = MakeOpId(1, current_index_ - 1);
+  ASSERT_OPID_EQ(last_opid, boot_info.last_id);
+  ASSERT_OPID_EQ(last_opid, boot_info.last_committed_id);
+
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(kNumSegments * kNumEntriesPerSegment, results.size());
+}
+
+// Test that the last committed operations, whose stores are all active, are
+// passed to consensus rather than replayed when deferral is enabled.
+TEST_F(BootstrapTest, TestBootstrapWithDeferredOps) {
+  FLAGS_tablet_bootstrap_max_deferred_ops = 3;
+  const int kNumEntries = 10;
+  ASSERT_OK(BuildLog());
+  const int64_t first_index = current_index_;
+  for (int i = 0; i < kNumEntries; i++) {
+    // Both of the batch's operations mutated the MRS, which wasn't flushed.
+    OpId opid = MakeOpId(1, current_index_++);
+    ASSERT_OK(AppendReplicateBatch(opid));
+    gscoped_ptr<consensus::CommitMsg> commit(new consensus::CommitMsg);
+    commit->set_op_type(consensus::WRITE_OP);
+    *commit->mutable_commited_op_id() = opid;
+    for (int j = 0; j < 2; j++) {
+      commit->mutable_result()->add_ops()->add_mutated_stores()->set_mrs_id(1);
+    }
+    ASSERT_OK(AppendCommit(std::move(commit)));
+  }
+
+  shared_ptr<Tablet> tablet;
+  ConsensusBootstrapInfo boot_info;
+  ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+  OpId last_opid = MakeOpId(1, current_index_ - 1);
+  ASSERT_OPID_EQ(last_opid, boot_info.last_id);
+  ASSERT_OPID_EQ(last_opid, boot_info.last_committed_id);
+
+  // The deferred operations are the last ones, in order.
+  ASSERT_EQ(3, boot_info.orphaned_replicates.size());
+  for (int i = 0; i < 3; i++) {
+    ASSERT_OPID_EQ(MakeOpId(1, first_index + kNumEntries - 3 + i),
+                   boot_info.orphaned_replicates[i]->id());
+  }
+
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(kNumEntries - 3, results.size());
+}
+
 // Tests attempting a local bootstrap of a tablet that was in the middle of a
 // tablet copy before "crashing".
 TEST_F(BootstrapTest, TestIncompleteTabletCopy) {
@@ -18,6 +18,7 @@
 #include "kudu/tablet/tablet_bootstrap.h"
 
 #include <cstdint>
+#include <deque>
 #include <iterator>
 #include <map>
 #include <memory>
@@ -54,6 +55,7 @@
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/fs/io_context.h"
+#include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -78,6 +80,7 @@
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/tserver/tserver_admin.pb.h"
+#include "kudu/util/blocking_queue.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
@@ -90,6 +93,7 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
 
 DECLARE_int32(group_commit_queue_size_bytes);
 
@@ -99,6 +103,24 @@ DEFINE_double(fault_crash_during_log_replay, 0.0,
               "(For testing only!)");
 TAG_FLAG(fault_crash_during_log_replay, unsafe);
 
+DEFINE_int32(tablet_bootstrap_prefetch_entries, 0,
+             "If greater than 0, log segments are read, decompressed and parsed on "
+             "a separate thread during tablet bootstrap, up to this many entries "
+             "ahead of the entry being replayed. If 0, entries are read and "
+             "replayed on the same thread.");
+TAG_FLAG(tablet_bootstrap_prefetch_entries, experimental);
+
+DEFINE_int32(tablet_bootstrap_max_deferred_ops, 0,
+             "If greater than 0, up to this many of the last committed operations "
+             "in the log, whose mutations are all in memory stores which weren't "
+             "flushed, are not replayed during tablet bootstrap, but are passed "
+             "to consensus to be applied in the background, in order, as it "
+             "starts. This lets a replica vote and accept new operations sooner "
+             "after a restart, at the cost of holding the deferred operations "
+             "in memory. If 0, all committed operations are replayed before the "
+             "replica starts.");
+TAG_FLAG(tablet_bootstrap_max_deferred_ops, experimental);
+
 DECLARE_int32(max_clock_sync_error_usec);
 
 using kudu::clock::Clock;
@@ -176,6 +198,104 @@ class FlushedStoresSnapshot {
   DISALLOW_COPY_AND_ASSIGN(FlushedStoresSnapshot);
 };
 
+// Reads the entries of a sequence of log segments on a separate thread, ahead
+// of their replay. Entries are returned in order, segment by segment, with the
+// same interface as a LogEntryReader: once a segment's entries are exhausted,
+// ReadNextEntry() returns EndOfFile and the following call returns the first
+// entry of the next segment.
+class LogEntryPrefetcher {
+ public:
+  LogEntryPrefetcher(log::SegmentSequence segments, int max_buffered_entries)
+      : segments_(std::move(segments)),
+        queue_(max_buffered_entries),
+        offset_(0),
+        read_up_to_offset_(0) {
+  }
+
+  ~LogEntryPrefetcher() {
+    queue_.Shutdown();
+    if (thread_) {
+      thread_->Join();
+    }
+    Item* item;
+    while (queue_.BlockingGet(&item)) {
+      delete item;
+    }
+  }
+
+  Status Start() {
+    return Thread::Create("tablet-bootstrap", "log-prefetch",
+                          &LogEntryPrefetcher::Run, this, &thread_);
+  }
+
+  // Returns the next entry, or the status that reading the current segment
+  // ended with, as LogEntryReader::ReadNextEntry() would have.
+  Status ReadNextEntry(unique_ptr<LogEntryPB>* entry) {
+    Item* item = nullptr;
+    CHECK(queue_.BlockingGet(&item));
+    unique_ptr<Item> owned_item(item);
+    offset_ = item->offset;
+    read_up_to_offset_ = item->read_up_to_offset;
+    if (!item->entry) {
+      return item->status;
+    }
+    *entry = std::move(item->entry);
+    return Status::OK();
+  }
+
+  // The offset and the read-up-to offset of the current segment's reader, as
+  // of the last entry returned.
+  int64_t offset() const { return offset_; }
+  int64_t read_up_to_offset() const { return read_up_to_offset_; }
+
+ private:
+  // An entry read by the prefetch thread, or, if 'entry' is null, the status
+  // which reading its segment ended with.
+  struct Item {
+    unique_ptr<LogEntryPB> entry;
+    Status status;
+    int64_t offset;
+    int64_t read_up_to_offset;
+  };
+
+  void Run() {
+    for (const scoped_refptr<ReadableLogSegment>& segment : segments_) {
+      log::LogEntryReader reader(segment.get());
+      while (true) {
+        unique_ptr<Item> item(new Item);
+        Status s = reader.ReadNextEntry(&item->entry);
+        if (!s.ok()) {
+          item->entry.reset();
+          item->status = s;
+        }
+        item->offset = reader.offset();
+        item->read_up_to_offset = reader.read_up_to_offset();
+        if (!queue_.BlockingPut(item.get())) {
+          // Shut down by the destructor.
+          return;
+        }
+        ignore_result(item.release());
+        if (!s.ok()) {
+          if (!s.IsEndOfFile()) {
+            // The replay stops at the first error.
+            return;
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  const log::SegmentSequence segments_;
+  BlockingQueue<Item*> queue_;
+  scoped_refptr<Thread> thread_;
+
+  int64_t offset_;
+  int64_t read_up_to_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogEntryPrefetcher);
+};
+
 // Bootstraps an existing tablet by opening the metadata from disk, and rebuilding soft
 // state by playing log segments. A bootstrapped tablet can then be added to an existing
 // consensus configuration as a LEARNER, which will bring its state up to date with the
@@ -338,6 +458,16 @@ class TabletBootstrap {
   // by the operation, returning one of the enum values above.
   ActiveStores AnalyzeActiveStores(const CommitMsg& commit);
 
+  // Returns true if the committed operation of 'commit' may be deferred to
+  // consensus rather than replayed, i.e. if it can be applied from scratch:
+  // either it's a write whose mutated stores are all active, or it's a no-op.
+  bool CanDeferOperation(const CommitMsg& commit);
+
+  // Replays the deferred operations of 'state', oldest first, until at most
+  // 'max_deferred' remain.
+  Status ApplyDeferredOperations(const IOContext* io_context, ReplayState* state,
+                                 int max_deferred);
+
   void DumpReplayStateToLog(const ReplayState& state);
 
   Status HandleEntry(const IOContext* io_context,
@@ -390,6 +520,7 @@ class TabletBootstrap {
         ops_overwritten(0),
         ops_ignored(0),
         ops_committed(0),
+        ops_deferred(0),
         inserts_seen(0),
         inserts_ignored(0),
         mutations_seen(0),
@@ -398,14 +529,14 @@ class TabletBootstrap {
     }
 
     string ToString() const {
-      return Substitute("ops{read=$0 overwritten=$1 applied=$2 ignored=$3} "
+      return Substitute("ops{read=$0 overwritten=$1 applied=$2 ignored=$3 deferred=$9} "
                         "inserts{seen=$4 ignored=$5} "
                         "mutations{seen=$6 ignored=$7} "
                         "orphaned_commits=$8",
                         ops_read, ops_overwritten, ops_committed, ops_ignored,
                         inserts_seen, inserts_ignored,
                         mutations_seen, mutations_ignored,
-                        orphaned_commits);
+                        orphaned_commits, ops_deferred);
     }
 
     // Number of REPLICATE messages read from the log
@@ -418,6 +549,9 @@ class TabletBootstrap {
     int ops_ignored;
     // Number of REPLICATE messages for which a matching COMMIT was found.
     int ops_committed;
+    // Number of committed REPLICATE messages which were deferred to consensus
+    // rather than replayed (see --tablet_bootstrap_max_deferred_ops).
+    int ops_deferred;
 
     // Number inserts/mutations seen and ignored.
     int inserts_seen, inserts_ignored;
@@ -654,6 +788,12 @@ Status TabletBootstrap::PrepareRecoveryDir(bool* needs_recovery) {
   // Throw away any logs from the previous recovery attempt and restart the log
   // replay process from the beginning using the same recovery dir as last time.
   string recovery_path = fs_manager->GetTabletWalRecoveryDir(tablet_id);
+  // With --log_archive_dir, closed segments may live in an archive directory
+  // of each of the log and recovery directories, which is renamed along with
+  // them.
+  Env* env = fs_manager->env();
+  const string archive_log_dir = log::GetArchiveDirForWalDir(log_dir);
+  const string archive_recovery_path = log::GetArchiveDirForWalDir(recovery_path);
   if (fs_manager->Exists(recovery_path)) {
     LOG_WITH_PREFIX(INFO) << "Previous recovery directory found at " << recovery_path << ": "
                           << "Replaying log files from this location instead of " << log_dir;
@@ -671,6 +811,19 @@ Status TabletBootstrap::PrepareRecoveryDir(bool* needs_recovery) {
     RETURN_NOT_OK_PREPEND(env_util::CreateDirIfMissing(fs_manager->env(), log_dir),
                           "Failed to create log directory " + log_dir);
 
+    if (!archive_log_dir.empty() && env->FileExists(archive_log_dir)) {
+      if (!env->FileExists(archive_recovery_path)) {
+        // We crashed between renaming the log directory and its archive.
+        RETURN_NOT_OK_PREPEND(env->RenameFile(archive_log_dir, archive_recovery_path),
+                              Substitute("Could not move log archive directory $0 to $1",
+                                         archive_log_dir, archive_recovery_path));
+      } else {
+        RETURN_NOT_OK_PREPEND(env->DeleteRecursively(archive_log_dir),
+                              "Could not recursively delete old log archive dir " +
+                              archive_log_dir);
+      }
+    }
+
     *needs_recovery = true;
     return Status::OK();
   }
@@ -701,9 +854,26 @@ Status TabletBootstrap::PrepareRecoveryDir(bool* needs_recovery) {
     // and then re-create the log directory.
     VLOG_WITH_PREFIX(1) << "Moving log directory " << log_dir << " to recovery directory "
                         << recovery_path << " in preparation for log replay";
+    if (!archive_log_dir.empty()) {
+      // Any archive left from an earlier recovery is stale. Making sure the
+      // log directory has an archive directory lets a crash right after the
+      // rename below be told apart from a finished one.
+      if (env->FileExists(archive_recovery_path)) {
+        RETURN_NOT_OK_PREPEND(env->DeleteRecursively(archive_recovery_path),
+                              "Could not recursively delete stale log archive dir " +
+                              archive_recovery_path);
+      }
+      RETURN_NOT_OK_PREPEND(env_util::CreateDirsRecursively(env, archive_log_dir),
+                            "Failed to create log archive directory " + archive_log_dir);
+    }
     RETURN_NOT_OK_PREPEND(fs_manager->env()->RenameFile(log_dir, recovery_path),
                           Substitute("Could not move log directory $0 to recovery dir $1",
                                      log_dir, recovery_path));
+    if (!archive_log_dir.empty()) {
+      RETURN_NOT_OK_PREPEND(env->RenameFile(archive_log_dir, archive_recovery_path),
+                            Substitute("Could not move log archive directory $0 to $1",
+                                       archive_log_dir, archive_recovery_path));
+    }
     RETURN_NOT_OK_PREPEND(fs_manager->env()->CreateDir(log_dir),
                           "Failed to recreate log directory " + log_dir);
   }
@@ -802,8 +972,9 @@ struct ReplayState {
 
   void DumpReplayStateToStrings(vector<string>* strings)  const {
     strings->push_back(Substitute("ReplayState: Previous OpId: $0, Committed OpId: $1, "
-        "Pending Replicates: $2, Pending Commits: $3", OpIdToString(prev_op_id),
-        OpIdToString(committed_op_id), pending_replicates.size(), pending_commits.size()));
+        "Pending Replicates: $2, Pending Commits: $3, Deferred Operations: $4",
+        OpIdToString(prev_op_id), OpIdToString(committed_op_id),
+        pending_replicates.size(), pending_commits.size(), deferred_ops.size()));
     if (!pending_replicates.empty()) {
       strings->push_back("Dumping REPLICATES: ");
       AddEntriesToStrings(pending_replicates, strings);
@@ -827,6 +998,12 @@ struct ReplayState {
 
   // COMMIT log entries which couldn't be applied immediately.
   OpIndexToEntryMap pending_commits;
+
+  // Committed operations which haven't been replayed, as pairs of REPLICATE
+  // and COMMIT log entries, in the order they were committed. They're either
+  // replayed later, before any following operation is, or passed to consensus
+  // along with the pending replicates.
+  std::deque<std::pair<unique_ptr<LogEntryPB>, unique_ptr<LogEntryPB>>> deferred_ops;
 };
 
 // Handle the given log entry.
@@ -1044,7 +1221,18 @@ Status TabletBootstrap::ApplyCommitMessage(const IOContext* io_context,
       LOG_WITH_PREFIX(DFATAL) << error_msg;
       return Status::Corruption(error_msg);
     }
-    RETURN_NOT_OK(HandleEntryPair(io_context, pending_replicate_entry.get(), entry));
+    if (FLAGS_tablet_bootstrap_max_deferred_ops > 0 && CanDeferOperation(entry->commit())) {
+      state->deferred_ops.emplace_back(std::move(pending_replicate_entry),
+                                       unique_ptr<LogEntryPB>(new LogEntryPB(*entry)));
+      stats_.ops_deferred++;
+      RETURN_NOT_OK(ApplyDeferredOperations(io_context, state,
+                                            FLAGS_tablet_bootstrap_max_deferred_ops));
+    } else {
+      // Operations must be replayed in order, so any deferred operation goes
+      // first.
+      RETURN_NOT_OK(ApplyDeferredOperations(io_context, state, 0));
+      RETURN_NOT_OK(HandleEntryPair(io_context, pending_replicate_entry.get(), entry));
+    }
     stats_.ops_committed++;
   } else {
     stats_.orphaned_commits++;
@@ -1054,6 +1242,42 @@ Status TabletBootstrap::ApplyCommitMessage(const IOContext* io_context,
   return Status::OK();
 }
 
+bool TabletBootstrap::CanDeferOperation(const CommitMsg& commit) {
+  switch (commit.op_type()) {
+    case NO_OP:
+      return true;
+    case WRITE_OP: {
+      // Re-applying a write from scratch would duplicate any of its mutations
+      // which were flushed, so every mutated store must be active.
+      if (AnalyzeActiveStores(commit) != SOME_STORES_ACTIVE) {
+        return false;
+      }
+      for (const OperationResultPB& op_result : commit.result().ops()) {
+        for (const MemStoreTargetPB& mutated_store : op_result.mutated_stores()) {
+          if (!flushed_stores_.IsMemStoreActive(mutated_store)) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+Status TabletBootstrap::ApplyDeferredOperations(const IOContext* io_context,
+                                                ReplayState* state,
+                                                int max_deferred) {
+  while (state->deferred_ops.size() > static_cast<size_t>(max_deferred)) {
+    auto& op = state->deferred_ops.front();
+    RETURN_NOT_OK(HandleEntryPair(io_context, op.first.get(), op.second.get()));
+    state->deferred_ops.pop_front();
+    stats_.ops_deferred--;
+  }
+  return Status::OK();
+}
+
 // Never deletes 'replicate_entry' or 'commit_entry'.
 Status TabletBootstrap::HandleEntryPair(const IOContext* io_context, LogEntryPB* replicate_entry,
                                         LogEntryPB* commit_entry) {
@@ -1166,6 +1390,10 @@ Status TabletBootstrap::PlaySegments(const IOContext* io_context,
   if (!segments.empty()) {
     const scoped_refptr<ReadableLogSegment>& segment = segments[0];
     // Set the point-in-time schema for the tablet based on the log header.
+    if (!segment->header().has_schema()) {
+      return Status::Corruption(Substitute("log segment $0 has no schema in its header",
+                                           segment->path()));
+    }
     Schema pit_schema;
     RETURN_NOT_OK_PREPEND(SchemaFromPB(segment->header().schema(), &pit_schema),
                           "Couldn't decode log segment schema");
@@ -1183,14 +1411,23 @@ Status TabletBootstrap::PlaySegments(const IOContext* io_context,
   const auto kStatusUpdateInterval = MonoDelta::FromSeconds(5);
   int segment_count = 0;
 
+  unique_ptr<LogEntryPrefetcher> prefetcher;
+  if (FLAGS_tablet_bootstrap_prefetch_entries > 0) {
+    prefetcher.reset(new LogEntryPrefetcher(segments, FLAGS_tablet_bootstrap_prefetch_entries));
+    RETURN_NOT_OK_PREPEND(prefetcher->Start(), "Failed to start log prefetch thread");
+  }
+
   for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
-    log::LogEntryReader reader(segment.get());
+    unique_ptr<log::LogEntryReader> reader;
+    if (!prefetcher) {
+      reader.reset(new log::LogEntryReader(segment.get()));
+    }
 
     int entry_count = 0;
     while (true) {
       {
         unique_ptr<LogEntryPB> entry;
-        Status s = reader.ReadNextEntry(&entry);
+        Status s = prefetcher ? prefetcher->ReadNextEntry(&entry) : reader->ReadNextEntry(&entry);
         if (PREDICT_FALSE(!s.ok())) {
           if (s.IsEndOfFile()) {
             break;
@@ -1222,8 +1459,11 @@ Status TabletBootstrap::PlaySegments(const IOContext* io_context,
         SetStatusMessage(Substitute("Bootstrap replaying log segment $0/$1 "
                                     "($2/$3 this segment, stats: $4)",
                                     segment_count + 1, log_reader_->num_segments(),
-                                    HumanReadableNumBytes::ToString(reader.offset()),
-                                    HumanReadableNumBytes::ToString(reader.read_up_to_offset()),
+                                    HumanReadableNumBytes::ToString(
+                                        prefetcher ? prefetcher->offset() : reader->offset()),
+                                    HumanReadableNumBytes::ToString(
+                                        prefetcher ? prefetcher->read_up_to_offset() :
+                                                     reader->read_up_to_offset()),
                                     stats_.ToString()));
         last_status_update = now;
       }
@@ -1301,7 +1541,16 @@ Status TabletBootstrap::PlaySegments(const IOContext* io_context,
     DumpReplayStateToLog(state);
   }
 
-  // Set up the ConsensusBootstrapInfo structure for the caller.
+  // Set up the ConsensusBootstrapInfo structure for the caller. The deferred
+  // operations precede the pending replicates, and being committed, they're
+  // applied in order by consensus as soon as it starts.
+  if (!state.deferred_ops.empty()) {
+    LOG_WITH_PREFIX(INFO) << Substitute("Deferring $0 committed operations to consensus",
+                                        state.deferred_ops.size());
+  }
+  for (auto& op : state.deferred_ops) {
+    consensus_info->orphaned_replicates.push_back(op.first->release_replicate());
+  }
   for (OpIndexToEntryMap::value_type& e : state.pending_replicates) {
     consensus_info->orphaned_replicates.push_back(e.second->release_replicate());
   }
@@ -37,12 +37,14 @@
 #include "kudu/common/partial_row.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/timestamp.h"
+#include "kudu/fs/block_id.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/tablet/compaction.h"
+#include "kudu/tablet/delta_tracker.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/rowset.h"
@@ -57,6 +59,7 @@
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(cfile_lazy_open);
 DECLARE_bool(enable_maintenance_manager);
 DECLARE_int32(tablet_history_max_age_sec);
 DECLARE_string(time_source);
@@ -246,6 +249,56 @@ TEST_F(TabletHistoryGcTest, TestMajorDeltaCompactionOnSubsetOfColumns) {
   ASSERT_EQ(TotalNumRows(), rows.size());
 }
 
+// Test that major delta compaction of a column leaves the REDO delta files
+// which don't update it alone, rather than decoding and rewriting them.
+TEST_F(TabletHistoryGcTest, TestMajorDeltaCompactionSkipsUnrelatedDeltaFiles) {
+  // Open the delta files eagerly, so that their stats are known.
+  FLAGS_cfile_lazy_open = false;
+  FLAGS_tablet_history_max_age_sec = 100;
+
+  num_rowsets_ = 3;
+  rows_per_rowset_ = 20;
+
+  NO_FATALS(InsertOriginalRows(num_rowsets_, rows_per_rowset_));
+
+  // Write a delta file updating column 1 into each rowset, then another
+  // updating column 2.
+  LocalTabletWriter writer(tablet().get(), &client_schema_);
+  for (int col_idx = 1; col_idx <= 2; col_idx++) {
+    for (int32_t row_key = 0; row_key < TotalNumRows(); row_key++) {
+      KuduPartialRow row(&client_schema_);
+      setup_.BuildRowKey(&row, row_key);
+      ASSERT_OK_FAST(row.SetInt32(col_idx, col_idx));
+      ASSERT_OK_FAST(writer.Update(row));
+    }
+    for (int i = 0; i < num_rowsets_; i++) {
+      ASSERT_OK(tablet()->FlushBiggestDMS());
+    }
+  }
+
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(200)));
+
+  vector<std::shared_ptr<RowSet>> rowsets;
+  tablet()->GetRowSetsForTests(&rowsets);
+  for (int i = 0; i < num_rowsets_; i++) {
+    DiskRowSet* drs = down_cast<DiskRowSet*>(rowsets[i].get());
+    vector<BlockId> redo_blocks = drs->metadata()->redo_delta_blocks();
+    ASSERT_EQ(2, redo_blocks.size());
+
+    vector<ColumnId> col_ids_to_compact = { schema_.column_id(2) };
+    ASSERT_OK(drs->MajorCompactDeltaStoresWithColumnIds(col_ids_to_compact, nullptr,
+                                                        tablet()->GetHistoryGcOpts()));
+
+    // Only the delta file updating column 2 was compacted.
+    ASSERT_EQ(1, drs->delta_tracker()->CountRedoDeltaStores());
+    ASSERT_EQ(vector<BlockId>{ redo_blocks[0] }, drs->metadata()->redo_delta_blocks());
+  }
+
+  NO_FATALS(VerifyDebugDumpRowsMatch(
+      R"(int32 val=2\); Undo Mutations: \[@[[:digit:]]+\(DELETE\)\]; )"
+      R"(Redo Mutations: \[@[[:digit:]]+\(SET key_idx=1\)\];$)"));
+}
+
 // Tests the following two MRS flush scenarios:
 // 1. Verify that no UNDO is generated after inserting a row into the MRS,
 //    waiting for the AHM to pass, then flushing the MRS.
@@ -81,6 +81,8 @@ namespace tablet {
 TabletOpBase::TabletOpBase(string name, IOUsage io_usage, Tablet* tablet)
     : MaintenanceOp(std::move(name), io_usage),
       tablet_(tablet) {
+  // The flushes and compactions of a tablet change the stats of each other.
+  set_stats_group(tablet);
 }
 
 string TabletOpBase::LogPrefix() const {
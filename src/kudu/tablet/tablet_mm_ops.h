@@ -59,6 +59,9 @@ class CompactRowSetsOp : public TabletOpBase {
 
   virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
 
+  // The stats only change with the flushes and compactions of the tablet.
+  virtual bool has_event_driven_stats() const OVERRIDE { return true; }
+
   virtual bool Prepare() OVERRIDE;
 
   virtual void Perform() OVERRIDE;
@@ -85,6 +88,9 @@ class MinorDeltaCompactionOp : public TabletOpBase {
 
   virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
 
+  // The stats only change with the flushes and compactions of the tablet.
+  virtual bool has_event_driven_stats() const OVERRIDE { return true; }
+
   virtual bool Prepare() OVERRIDE;
 
   virtual void Perform() OVERRIDE;
@@ -111,6 +117,9 @@ class MajorDeltaCompactionOp : public TabletOpBase {
 
   virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
 
+  // The stats only change with the flushes and compactions of the tablet.
+  virtual bool has_event_driven_stats() const OVERRIDE { return true; }
+
   virtual bool Prepare() OVERRIDE;
 
   virtual void Perform() OVERRIDE;
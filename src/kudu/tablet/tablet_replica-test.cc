@@ -20,6 +20,7 @@
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 #include <gflags/gflags.h>
@@ -76,6 +77,7 @@
 METRIC_DECLARE_entity(tablet);
 
 DECLARE_int32(flush_threshold_mb);
+DECLARE_int32(max_transactions_per_prepare_batch);
 
 namespace kudu {
 namespace tablet {
@@ -96,6 +98,7 @@ using rpc::Messenger;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
 
@@ -561,6 +564,46 @@ TEST_F(TabletReplicaTest, TestActiveTransactionPreventsLogGC) {
   ASSERT_EQ(2, segments.size());
 }
 
+// Test that writes submitted together are prepared and replicated in batches,
+// and that each one still gets its own response.
+TEST_F(TabletReplicaTest, TestBatchedPrepare) {
+  FLAGS_max_transactions_per_prepare_batch = 4;
+  ConsensusBootstrapInfo info;
+  ASSERT_OK(StartReplicaAndWaitUntilLeader(info));
+
+  // The last write inserts a row inserted by the first, and so fails.
+  const int kNumWrites = 10;
+  vector<unique_ptr<WriteRequestPB>> reqs;
+  vector<unique_ptr<WriteResponsePB>> resps;
+  CountDownLatch rpc_latch(kNumWrites + 1);
+  for (int i = 0; i <= kNumWrites; i++) {
+    reqs.emplace_back(new WriteRequestPB());
+    if (i == kNumWrites) {
+      insert_counter_ = 0;
+    }
+    ASSERT_OK(GenerateSequentialInsertRequest(reqs.back().get()));
+    resps.emplace_back(new WriteResponsePB());
+    unique_ptr<WriteTransactionState> tx_state(
+        new WriteTransactionState(tablet_replica_.get(), reqs.back().get(),
+                                  nullptr, // No RequestIdPB
+                                  resps.back().get()));
+    tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
+        new LatchTransactionCompletionCallback<WriteResponsePB>(&rpc_latch,
+                                                                resps.back().get())));
+    ASSERT_OK(tablet_replica_->SubmitWrite(std::move(tx_state)));
+  }
+  rpc_latch.Wait();
+
+  for (int i = 0; i < kNumWrites; i++) {
+    ASSERT_FALSE(resps[i]->has_error()) << SecureDebugString(*resps[i]);
+    ASSERT_EQ(0, resps[i]->per_row_errors_size()) << SecureDebugString(*resps[i]);
+  }
+  ASSERT_EQ(1, resps[kNumWrites]->per_row_errors_size());
+  uint64_t num_rows;
+  ASSERT_OK(tablet()->CountRows(&num_rows));
+  ASSERT_EQ(kNumWrites, num_rows);
+}
+
 TEST_F(TabletReplicaTest, TestGCEmptyLog) {
   ConsensusBootstrapInfo info;
   ASSERT_OK(StartReplica(info));
@@ -26,6 +26,7 @@
 #include <type_traits>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 
 #include "kudu/clock/clock.h"
@@ -59,6 +60,8 @@
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
+DECLARE_int32(flush_threshold_mb);
+
 METRIC_DEFINE_histogram(tablet, op_prepare_queue_length, "Operation Prepare Queue Length",
                         kudu::MetricUnit::kTasks,
                         "Number of operations waiting to be prepared within this tablet. "
@@ -87,6 +90,10 @@ METRIC_DEFINE_gauge_size(tablet, on_disk_size, "Tablet Size On Disk",
 METRIC_DEFINE_gauge_string(tablet, state, "Tablet State",
                            kudu::MetricUnit::kState,
                            "State of this tablet.");
+METRIC_DEFINE_gauge_int32(tablet, numa_node, "NUMA Node",
+                          kudu::MetricUnit::kUnits,
+                          "The NUMA node whose CPUs run the tasks of this tablet, "
+                          "or -1 if it isn't assigned to any.");
 
 namespace kudu {
 namespace tablet {
@@ -127,6 +134,7 @@ TabletReplica::TabletReplica(
       local_peer_pb_(std::move(local_peer_pb)),
       log_anchor_registry_(new LogAnchorRegistry()),
       apply_pool_(apply_pool),
+      numa_node_(-1),
       mark_dirty_clbk_(std::move(mark_dirty_clbk)),
       state_(NOT_INITIALIZED),
       last_status_("Tablet initializing...") {
@@ -139,12 +147,14 @@ TabletReplica::~TabletReplica() {
       << TabletStatePB_Name(state_);
 }
 
-Status TabletReplica::Init(ThreadPool* raft_pool) {
+Status TabletReplica::Init(ThreadPool* raft_pool, int numa_node) {
   CHECK_EQ(NOT_INITIALIZED, state_);
   TRACE("Creating consensus instance");
   SetStatusMessage("Initializing consensus...");
+  numa_node_ = numa_node;
   ConsensusOptions options;
   options.tablet_id = meta_->tablet_id();
+  options.raft_pool_shard = numa_node;
   shared_ptr<RaftConsensus> consensus;
   RETURN_NOT_OK(RaftConsensus::Create(std::move(options),
                                       local_peer_pb_,
@@ -163,7 +173,8 @@ Status TabletReplica::Start(const ConsensusBootstrapInfo& bootstrap_info,
                             shared_ptr<Messenger> messenger,
                             scoped_refptr<ResultTracker> result_tracker,
                             scoped_refptr<Log> log,
-                            ThreadPool* prepare_pool) {
+                            ThreadPool* prepare_pool,
+                            shared_ptr<consensus::MultiRaftManager> multi_raft_manager) {
   DCHECK(tablet) << "A TabletReplica must be provided with a Tablet";
   DCHECK(log) << "A TabletReplica must be provided with a Log";
 
@@ -184,13 +195,15 @@ Status TabletReplica::Start(const ConsensusBootstrapInfo& bootstrap_info,
       log_ = DCHECK_NOTNULL(log); // Not moved because it's passed to RaftConsensus::Start() below.
 
       metric_entity = tablet_->GetMetricEntity();
-      prepare_pool_token_ = prepare_pool->NewTokenWithMetrics(
+      prepare_pool_token_ = prepare_pool->NewTokenForShard(
+          numa_node_,
           ThreadPool::ExecutionMode::SERIAL,
           {
               METRIC_op_prepare_queue_length.Instantiate(metric_entity),
               METRIC_op_prepare_queue_time.Instantiate(metric_entity),
               METRIC_op_prepare_run_time.Instantiate(metric_entity)
           });
+      prepare_queue_.reset(new TransactionPrepareQueue(prepare_pool_token_.get()));
 
       if (tablet_->metrics() != nullptr) {
         TRACE("Starting instrumentation");
@@ -202,6 +215,7 @@ Status TabletReplica::Start(const ConsensusBootstrapInfo& bootstrap_info,
         METRIC_state.InstantiateFunctionGauge(
             tablet_->GetMetricEntity(), Bind(&TabletReplica::StateName, Unretained(this)))
             ->AutoDetach(&metric_detacher_);
+        METRIC_numa_node.Instantiate(tablet_->GetMetricEntity(), numa_node_);
       }
       txn_tracker_.StartMemoryTracking(tablet_->mem_tracker());
 
@@ -209,7 +223,8 @@ Status TabletReplica::Start(const ConsensusBootstrapInfo& bootstrap_info,
       VLOG(2) << "T " << tablet_id() << " P " << consensus_->peer_uuid() << ": Peer starting";
       VLOG(2) << "RaftConfig before starting: " << SecureDebugString(consensus_->CommittedConfig());
 
-      peer_proxy_factory.reset(new RpcPeerProxyFactory(messenger_));
+      peer_proxy_factory.reset(new RpcPeerProxyFactory(messenger_,
+                                                       std::move(multi_raft_manager)));
       time_manager.reset(new TimeManager(clock_, tablet_->mvcc_manager()->GetCleanTimestamp()));
     }
 
@@ -637,6 +652,15 @@ Status TabletReplica::StartFollowerTransaction(const scoped_refptr<ConsensusRoun
   return Status::OK();
 }
 
+double TabletReplica::GetFlushBacklog() {
+  shared_ptr<Tablet> tablet = shared_tablet();
+  if (!tablet || FLAGS_flush_threshold_mb <= 0) {
+    return 0;
+  }
+  return static_cast<double>(tablet->MemRowSetSize() + tablet->DeltaMemStoresSize()) /
+         (FLAGS_flush_threshold_mb * 1024L * 1024L);
+}
+
 void TabletReplica::FinishConsensusOnlyRound(ConsensusRound* round) {
   consensus::ReplicateMsg* replicate_msg = round->replicate_msg();
   consensus::OperationType op_type = replicate_msg->op_type();
@@ -682,7 +706,8 @@ Status TabletReplica::NewLeaderTransactionDriver(gscoped_ptr<Transaction> transa
     log_.get(),
     prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    prepare_queue_.get());
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::LEADER));
   driver->swap(tx_driver);
 
@@ -697,7 +722,8 @@ Status TabletReplica::NewReplicaTransactionDriver(gscoped_ptr<Transaction> trans
     log_.get(),
     prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    prepare_queue_.get());
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::REPLICA));
   driver->swap(tx_driver);
 
@@ -716,12 +742,17 @@ void TabletReplica::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
   }
 
   vector<MaintenanceOp*> maintenance_ops;
+  const vector<string> data_dirs = tablet()->GetDataDirUuids();
 
   gscoped_ptr<MaintenanceOp> mrs_flush_op(new FlushMRSOp(this));
+  mrs_flush_op->set_data_dirs(data_dirs);
+  mrs_flush_op->set_stats_group(tablet());
   maint_mgr->RegisterOp(mrs_flush_op.get());
   maintenance_ops.push_back(mrs_flush_op.release());
 
   gscoped_ptr<MaintenanceOp> dms_flush_op(new FlushDeltaMemStoresOp(this));
+  dms_flush_op->set_data_dirs(data_dirs);
+  dms_flush_op->set_stats_group(tablet());
   maint_mgr->RegisterOp(dms_flush_op.get());
   maintenance_ops.push_back(dms_flush_op.release());
 
@@ -57,6 +57,7 @@ class Callback;
 
 namespace consensus {
 class ConsensusMetadataManager;
+class MultiRaftManager;
 class TransactionStatusPB;
 }
 
@@ -77,6 +78,7 @@ namespace tablet {
 class AlterSchemaTransactionState;
 class TabletStatusPB;
 class TransactionDriver;
+class TransactionPrepareQueue;
 class WriteTransactionState;
 
 // A replica in a tablet consensus configuration, which coordinates writes to tablets.
@@ -97,18 +99,26 @@ class TabletReplica : public RefCountedThreadSafe<TabletReplica>,
   // This must be called before publishing the instance to other threads.
   // If this fails, the TabletReplica instance remains in a NOT_INITIALIZED
   // state.
-  Status Init(ThreadPool* raft_pool);
+  //
+  // If 'numa_node' isn't negative, the thread pool tokens of the replica are
+  // placed in that shard of the raft and prepare pools, which run the tasks of
+  // each shard on the CPUs of one NUMA node.
+  Status Init(ThreadPool* raft_pool, int numa_node = -1);
 
   // Starts the TabletReplica, making it available for Write()s. If this
   // TabletReplica is part of a consensus configuration this will connect it to other replicas
   // in the consensus configuration.
+  //
+  // If 'multi_raft_manager' is set, the replica's requests to other servers
+  // may be batched with those of the other replicas sharing it.
   Status Start(const consensus::ConsensusBootstrapInfo& bootstrap_info,
                std::shared_ptr<tablet::Tablet> tablet,
                scoped_refptr<clock::Clock> clock,
                std::shared_ptr<rpc::Messenger> messenger,
                scoped_refptr<rpc::ResultTracker> result_tracker,
                scoped_refptr<log::Log> log,
-               ThreadPool* prepare_pool);
+               ThreadPool* prepare_pool,
+               std::shared_ptr<consensus::MultiRaftManager> multi_raft_manager = nullptr);
 
   // Synchronously transition this replica to STOPPED state from any other
   // state. This also stops RaftConsensus. If a Stop() operation is already in
@@ -159,6 +169,10 @@ class TabletReplica : public RefCountedThreadSafe<TabletReplica>,
   // has finished, advancing MVCC safe time as appropriate.
   virtual void FinishConsensusOnlyRound(consensus::ConsensusRound* round) override;
 
+  // Used by consensus to apply backpressure to writes as the memory waiting to
+  // be flushed grows past --flush_threshold_mb.
+  virtual double GetFlushBacklog() override;
+
   consensus::RaftConsensus* consensus() {
     std::lock_guard<simple_spinlock> lock(lock_);
     return consensus_.get();
@@ -331,6 +345,9 @@ class TabletReplica : public RefCountedThreadSafe<TabletReplica>,
   // the Tablet server.
   ThreadPool* const apply_pool_;
 
+  // The NUMA node the replica is assigned to, or -1. Set by Init().
+  int numa_node_;
+
   // Function to mark this TabletReplica's tablet as dirty in the TSTabletManager.
   //
   // Must be called whenever cluster membership or leadership changes, or when
@@ -366,6 +383,9 @@ class TabletReplica : public RefCountedThreadSafe<TabletReplica>,
   // Token for serial task submission to the server-wide transaction prepare pool.
   std::unique_ptr<ThreadPoolToken> prepare_pool_token_;
 
+  // Batches the prepare phase of the transactions on 'prepare_pool_token_'.
+  std::unique_ptr<TransactionPrepareQueue> prepare_queue_;
+
   scoped_refptr<clock::Clock> clock_;
 
   // List of maintenance operations for the tablet that need information that only the peer
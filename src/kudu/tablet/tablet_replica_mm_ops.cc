@@ -145,6 +145,8 @@ void FlushMRSOp::UpdateStats(MaintenanceOpStats* stats) {
   }
 
   stats->set_ram_anchored(tablet_replica_->tablet()->MemRowSetSize());
+  // Flushing writes about as much as the MRS holds in memory.
+  stats->set_io_bytes(stats->ram_anchored());
   stats->set_logs_retained_bytes(
       tablet_replica_->tablet()->MemRowSetLogReplaySize(replay_size_map));
 
@@ -215,6 +217,7 @@ void FlushDeltaMemStoresOp::UpdateStats(MaintenanceOpStats* stats) {
                                                    &dms_size, &retention_size);
 
   stats->set_ram_anchored(dms_size);
+  stats->set_io_bytes(dms_size);
   stats->set_runnable(true);
   stats->set_logs_retained_bytes(retention_size);
 
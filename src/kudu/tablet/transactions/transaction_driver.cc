@@ -17,13 +17,16 @@
 
 #include "kudu/tablet/transactions/transaction_driver.h"
 
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/message.h>
@@ -47,16 +50,26 @@
 #include "kudu/tablet/transaction_order_verifier.h"
 #include "kudu/tablet/transactions/transaction_tracker.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status_callback.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
+DEFINE_int32(max_transactions_per_prepare_batch, 0,
+             "If greater than 0, the transactions of a tablet which are queued "
+             "to be prepared are prepared together, up to this many at a time, "
+             "and the leader transactions among them are replicated together. "
+             "If 0, each transaction is prepared and replicated on its own.");
+TAG_FLAG(max_transactions_per_prepare_batch, experimental);
+TAG_FLAG(max_transactions_per_prepare_batch, runtime);
+
 namespace kudu {
 namespace tablet {
 
 using consensus::CommitMsg;
+using consensus::ConsensusRound;
 using consensus::DriverType;
 using consensus::RaftConsensus;
 using consensus::ReplicateMsg;
@@ -65,6 +78,7 @@ using pb_util::SecureShortDebugString;
 using rpc::RequestIdPB;
 using rpc::ResultTracker;
 using std::string;
+using std::vector;
 using strings::Substitute;
 
 static const char* kTimestampFieldName = "timestamp";
@@ -99,6 +113,95 @@ class FollowerTransactionCompletionCallback : public TransactionCompletionCallba
   scoped_refptr<ResultTracker> result_tracker_;
 };
 
+////////////////////////////////////////////////////////////
+// TransactionPrepareQueue
+////////////////////////////////////////////////////////////
+
+TransactionPrepareQueue::TransactionPrepareQueue(ThreadPoolToken* prepare_pool_token)
+    : prepare_pool_token_(prepare_pool_token),
+      batch_scheduled_(false) {
+}
+
+TransactionPrepareQueue::~TransactionPrepareQueue() {
+}
+
+Status TransactionPrepareQueue::Submit(scoped_refptr<TransactionDriver> driver) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  queue_.emplace_back(std::move(driver));
+  if (batch_scheduled_) {
+    return Status::OK();
+  }
+  // The queue is only non-empty while a batch is scheduled, so 'driver' is
+  // the only transaction queued.
+  Status s = prepare_pool_token_->SubmitFunc([this]() { RunBatch(); });
+  if (PREDICT_FALSE(!s.ok())) {
+    queue_.clear();
+    return s;
+  }
+  batch_scheduled_ = true;
+  return Status::OK();
+}
+
+void TransactionPrepareQueue::RunBatch() {
+  vector<scoped_refptr<TransactionDriver>> batch;
+  vector<scoped_refptr<TransactionDriver>> failed;
+  Status submit_status;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    size_t max_batch_size = std::max(1, FLAGS_max_transactions_per_prepare_batch);
+    while (!queue_.empty() && batch.size() < max_batch_size) {
+      batch.emplace_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+    // Any transaction queued from now on goes in the next batch, which runs
+    // after this one on the serial token.
+    if (!queue_.empty()) {
+      submit_status = prepare_pool_token_->SubmitFunc([this]() { RunBatch(); });
+    }
+    if (PREDICT_FALSE(!submit_status.ok())) {
+      failed.assign(queue_.begin(), queue_.end());
+      queue_.clear();
+    }
+    batch_scheduled_ = !queue_.empty();
+  }
+  for (const auto& driver : failed) {
+    driver->HandleFailure(submit_status);
+  }
+
+  vector<TransactionDriver*> to_replicate;
+  vector<scoped_refptr<ConsensusRound>> rounds;
+  for (const auto& driver : batch) {
+    TRACE_EVENT_FLOW_END0("txn", "PrepareTask", driver.get());
+    ADOPT_TRACE(driver->trace());
+    bool replicate = false;
+    Status s = driver->PrepareAndStart(&replicate);
+    if (PREDICT_FALSE(!s.ok())) {
+      driver->HandleFailure(s);
+    } else if (replicate) {
+      to_replicate.push_back(driver.get());
+      rounds.push_back(driver->mutable_state()->consensus_round());
+    }
+  }
+  if (to_replicate.empty()) {
+    return;
+  }
+
+  Status s = to_replicate.front()->consensus_->ReplicateBatch(rounds);
+  if (PREDICT_TRUE(s.ok())) {
+    return;
+  }
+  // Replicate the transactions one by one, so that each one fails for its
+  // own reasons, if any.
+  for (size_t i = 0; i < to_replicate.size(); i++) {
+    TransactionDriver* driver = to_replicate[i];
+    ADOPT_TRACE(driver->trace());
+    s = driver->consensus_->Replicate(rounds[i]);
+    if (PREDICT_FALSE(!s.ok())) {
+      driver->HandleFailure(driver->ReplicationFailedToStart(s));
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////
 // TransactionDriver
 ////////////////////////////////////////////////////////////
@@ -108,13 +211,15 @@ TransactionDriver::TransactionDriver(TransactionTracker *txn_tracker,
                                      Log* log,
                                      ThreadPoolToken* prepare_pool_token,
                                      ThreadPool* apply_pool,
-                                     TransactionOrderVerifier* order_verifier)
+                                     TransactionOrderVerifier* order_verifier,
+                                     TransactionPrepareQueue* prepare_queue)
     : txn_tracker_(txn_tracker),
       consensus_(consensus),
       log_(log),
       prepare_pool_token_(prepare_pool_token),
       apply_pool_(apply_pool),
       order_verifier_(order_verifier),
+      prepare_queue_(prepare_queue),
       trace_(new Trace()),
       start_time_(MonoTime::Now()),
       replication_state_(NOT_REPLICATING),
@@ -226,8 +331,12 @@ Status TransactionDriver::ExecuteAsync() {
   }
 
   if (s.ok()) {
-    s = prepare_pool_token_->SubmitClosure(
-      Bind(&TransactionDriver::PrepareTask, Unretained(this)));
+    if (prepare_queue_ && FLAGS_max_transactions_per_prepare_batch > 0) {
+      s = prepare_queue_->Submit(this);
+    } else {
+      s = prepare_pool_token_->SubmitClosure(
+        Bind(&TransactionDriver::PrepareTask, Unretained(this)));
+    }
   }
 
   if (!s.ok()) {
@@ -275,8 +384,29 @@ void TransactionDriver::RegisterFollowerTransactionOnResultTracker() {
 }
 
 Status TransactionDriver::Prepare() {
+  bool replicate = false;
+  RETURN_NOT_OK(PrepareAndStart(&replicate));
+  if (replicate) {
+    Status s = consensus_->Replicate(mutable_state()->consensus_round());
+    if (PREDICT_FALSE(!s.ok())) {
+      return ReplicationFailedToStart(s);
+    }
+  }
+  return Status::OK();
+}
+
+Status TransactionDriver::ReplicationFailedToStart(const Status& s) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  CHECK_EQ(replication_state_, REPLICATING);
+  transaction_status_ = s;
+  replication_state_ = REPLICATION_FAILED;
+  return s;
+}
+
+Status TransactionDriver::PrepareAndStart(bool* replicate) {
   TRACE_EVENT1("txn", "Prepare", "txn", this);
   VLOG_WITH_PREFIX(4) << "Prepare()";
+  *replicate = false;
 
   // Actually prepare and start the transaction.
   prepare_physical_timestamp_ = GetMonoTimeMicros();
@@ -328,15 +458,7 @@ Status TransactionDriver::Prepare() {
         replication_state_ = REPLICATING;
         replication_start_time_ = MonoTime::Now();
       }
-
-      Status s = consensus_->Replicate(mutable_state()->consensus_round());
-      if (PREDICT_FALSE(!s.ok())) {
-        std::lock_guard<simple_spinlock> lock(lock_);
-        CHECK_EQ(replication_state_, REPLICATING);
-        transaction_status_ = s;
-        replication_state_ = REPLICATION_FAILED;
-        return s;
-      }
+      *replicate = true;
       break;
     }
     case REPLICATING:
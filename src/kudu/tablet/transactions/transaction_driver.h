@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <deque>
 #include <string>
 
 #include <gtest/gtest_prod.h>
@@ -47,9 +48,50 @@ class RaftConsensus;
 }
 
 namespace tablet {
+class TransactionDriver;
 class TransactionOrderVerifier;
 class TransactionTracker;
 
+// Batches the prepare phase of a tablet's transactions: the transactions
+// submitted while a batch is queued or running on the tablet's serial
+// prepare pool token are prepared together by the next batch, one after the
+// other, and the leader transactions among them are then replicated with a
+// single RaftConsensus::ReplicateBatch() call. This saves a thread pool task
+// and a round of consensus locking and peer signaling per transaction.
+//
+// Transactions are prepared and replicated in the order they're submitted.
+// Each transaction still fails on its own: if the batch can't be replicated
+// as a whole, its transactions are replicated one by one.
+//
+// This class is thread safe.
+class TransactionPrepareQueue {
+ public:
+  // 'prepare_pool_token' must be a SERIAL token, and must outlive this object.
+  explicit TransactionPrepareQueue(ThreadPoolToken* prepare_pool_token);
+  ~TransactionPrepareQueue();
+
+  // Queues 'driver' to be prepared by the next batch.
+  Status Submit(scoped_refptr<TransactionDriver> driver);
+
+ private:
+  // Prepares and replicates the queued transactions, up to
+  // --max_transactions_per_prepare_batch of them.
+  void RunBatch();
+
+  ThreadPoolToken* const prepare_pool_token_;
+
+  simple_spinlock lock_;
+
+  // The transactions to prepare, in order of submission.
+  std::deque<scoped_refptr<TransactionDriver>> queue_;
+
+  // Whether a RunBatch() task is queued or running, and so will take care of
+  // 'queue_'.
+  bool batch_scheduled_;
+
+  DISALLOW_COPY_AND_ASSIGN(TransactionPrepareQueue);
+};
+
 // Base class for transaction drivers.
 //
 // TransactionDriver classes encapsulate the logic of coordinating the execution of
@@ -225,12 +267,18 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
  public:
   // Construct TransactionDriver. TransactionDriver does not take ownership
   // of any of the objects pointed to in the constructor's arguments.
+  //
+  // If 'prepare_queue' isn't null, and --max_transactions_per_prepare_batch
+  // is positive, the transaction is prepared through 'prepare_queue', in a
+  // batch with the tablet's other transactions. Otherwise it's prepared by a
+  // task of its own on 'prepare_pool_token'.
   TransactionDriver(TransactionTracker* txn_tracker,
                     consensus::RaftConsensus* consensus,
                     log::Log* log,
                     ThreadPoolToken* prepare_pool_token,
                     ThreadPool* apply_pool,
-                    TransactionOrderVerifier* order_verifier);
+                    TransactionOrderVerifier* order_verifier,
+                    TransactionPrepareQueue* prepare_queue = nullptr);
 
   // Perform any non-constructor initialization. Sets the transaction
   // that will be executed.
@@ -280,6 +328,7 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
  private:
   FRIEND_TEST(TabletReplicaTest, TestShuttingDownMVCC);
   friend class RefCountedThreadSafe<TransactionDriver>;
+  friend class TransactionPrepareQueue;
   enum ReplicationState {
     // The operation has not yet been sent to consensus for replication
     NOT_REPLICATING,
@@ -311,6 +360,16 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   // Actually prepare.
   Status Prepare();
 
+  // Prepares and starts the transaction. If it's a leader transaction which
+  // must now be replicated, sets 'replicate' to true: the caller must then
+  // replicate its consensus round, and call ReplicationFailedToStart() if
+  // that fails.
+  Status PrepareAndStart(bool* replicate);
+
+  // Records that the replication of the prepared leader transaction couldn't
+  // start because of 's', and returns 's'.
+  Status ReplicationFailedToStart(const Status& s);
+
   // Submits ApplyTask to the apply pool.
   Status ApplyAsync();
 
@@ -356,6 +415,7 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   ThreadPoolToken* const prepare_pool_token_;
   ThreadPool* const apply_pool_;
   TransactionOrderVerifier* const order_verifier_;
+  TransactionPrepareQueue* const prepare_queue_;
 
   Status transaction_status_;
 
@@ -52,6 +52,7 @@ METRIC_DECLARE_gauge_uint64(all_transactions_inflight);
 METRIC_DECLARE_gauge_uint64(write_transactions_inflight);
 METRIC_DECLARE_gauge_uint64(alter_schema_transactions_inflight);
 METRIC_DECLARE_counter(transaction_memory_pressure_rejections);
+METRIC_DECLARE_histogram(write_transaction_pending_duration);
 
 using std::shared_ptr;
 using std::vector;
@@ -216,6 +217,8 @@ TEST_F(TransactionTrackerTest, TestMetrics) {
   drivers[1]->Abort(Status::Aborted(""));
   drivers[2]->Abort(Status::Aborted(""));
   NO_FATALS(CheckMetrics(entity_, 0, 0, 0));
+  ASSERT_EQ(3, down_cast<Histogram*>(
+      entity_->FindOrNull(METRIC_write_transaction_pending_duration).get())->TotalCount());
 }
 
 // Check that the tracker's consumption is very close (but not quite equal to)
@@ -18,6 +18,7 @@
 #include "kudu/tablet/transactions/transaction_tracker.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <limits>
 #include <mutex>
 #include <ostream>
@@ -68,6 +69,19 @@ METRIC_DEFINE_counter(tablet, transaction_memory_pressure_rejections,
                       "Number of transactions rejected because the tablet's "
                       "transaction memory limit was reached.");
 
+METRIC_DEFINE_histogram(tablet, write_transaction_pending_duration,
+                        "Write Transaction Pending Duration",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Duration for which write transactions were in flight, from "
+                        "their submission to their release.",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(tablet, alter_schema_transaction_pending_duration,
+                        "Alter Schema Transaction Pending Duration",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Duration for which alter schema transactions were in flight, "
+                        "from their submission to their release.",
+                        60000000LU, 2);
+
 using std::shared_ptr;
 using std::string;
 using std::vector;
@@ -83,7 +97,9 @@ TransactionTracker::Metrics::Metrics(const scoped_refptr<MetricEntity>& entity)
     : GINIT(all_transactions_inflight),
       GINIT(write_transactions_inflight),
       GINIT(alter_schema_transactions_inflight),
-      MINIT(transaction_memory_pressure_rejections) {
+      MINIT(transaction_memory_pressure_rejections),
+      MINIT(write_transaction_pending_duration),
+      MINIT(alter_schema_transaction_pending_duration) {
 }
 #undef GINIT
 #undef MINIT
@@ -92,17 +108,99 @@ TransactionTracker::State::State()
   : memory_footprint(0) {
 }
 
-TransactionTracker::TransactionTracker() {
+TransactionTracker::TransactionTracker()
+    : reservation_chunk_bytes_(0) {
 }
 
 TransactionTracker::~TransactionTracker() {
-  std::lock_guard<simple_spinlock> l(lock_);
-  CHECK_EQ(pending_txns_.size(), 0);
+  for (Shard& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    CHECK_EQ(shard.pending_txns.size(), 0);
+    if (mem_tracker_) {
+      mem_tracker_->Release(shard.memory_reserved);
+    }
+  }
+}
+
+TransactionTracker::Shard* TransactionTracker::GetShard(const TransactionDriver* driver) {
+  // Drivers are heap-allocated, so the low bits of their addresses carry
+  // little entropy.
+  uintptr_t h = reinterpret_cast<uintptr_t>(driver);
+  h ^= h >> 17;
+  h *= 0x9e3779b97f4a7c15ULL;
+  return &shards_[(h >> 32) % kNumShards];
+}
+
+bool TransactionTracker::TryConsumeUnlocked(Shard* shard, int64_t bytes) {
+  DCHECK(shard->lock.is_locked());
+  if (!mem_tracker_) {
+    return true;
+  }
+  int64_t needed = shard->memory_used + bytes - shard->memory_reserved;
+  if (needed > 0) {
+    int64_t reserve = std::max(needed, reservation_chunk_bytes_);
+    if (!mem_tracker_->TryConsume(reserve)) {
+      // Near the limit, reserve no more than is needed.
+      if (reserve == needed || !mem_tracker_->TryConsume(needed)) {
+        return false;
+      }
+      reserve = needed;
+    }
+    shard->memory_reserved += reserve;
+  }
+  shard->memory_used += bytes;
+  return true;
+}
+
+void TransactionTracker::ReleaseUnlocked(Shard* shard, int64_t bytes) {
+  DCHECK(shard->lock.is_locked());
+  if (!mem_tracker_) {
+    return;
+  }
+  shard->memory_used -= bytes;
+  DCHECK_GE(shard->memory_used, 0);
+  // Keep up to a chunk in reserve for the shard's next transactions.
+  int64_t excess = shard->memory_reserved - shard->memory_used - reservation_chunk_bytes_;
+  if (excess > 0) {
+    mem_tracker_->Release(excess);
+    shard->memory_reserved -= excess;
+  }
+}
+
+void TransactionTracker::ReturnReservations() {
+  for (Shard& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    int64_t unused = shard.memory_reserved - shard.memory_used;
+    if (unused > 0) {
+      mem_tracker_->Release(unused);
+      shard.memory_reserved -= unused;
+    }
+  }
 }
 
 Status TransactionTracker::Add(TransactionDriver* driver) {
   int64_t driver_mem_footprint = driver->state()->request()->SpaceUsed();
-  if (mem_tracker_ && !mem_tracker_->TryConsume(driver_mem_footprint)) {
+
+  // Cache the transaction memory footprint so we needn't refer to the request
+  // again, as it may disappear between now and then.
+  State st;
+  st.memory_footprint = driver_mem_footprint;
+  Shard* shard = GetShard(driver);
+  auto try_add = [&]() {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    if (!TryConsumeUnlocked(shard, driver_mem_footprint)) {
+      return false;
+    }
+    InsertOrDie(&shard->pending_txns, driver, st);
+    return true;
+  };
+  bool added = try_add();
+  if (!added && mem_tracker_) {
+    // The memory may be reserved by other shards: reclaim it, and try again.
+    ReturnReservations();
+    added = try_add();
+  }
+  if (!added) {
     if (metrics_) {
       metrics_->transaction_memory_pressure_rejections->Increment();
     }
@@ -124,13 +222,6 @@ Status TransactionTracker::Add(TransactionDriver* driver) {
   }
 
   IncrementCounters(*driver);
-
-  // Cache the transaction memory footprint so we needn't refer to the request
-  // again, as it may disappear between now and then.
-  State st;
-  st.memory_footprint = driver_mem_footprint;
-  std::lock_guard<simple_spinlock> l(lock_);
-  InsertOrDie(&pending_txns_, driver, st);
   return Status::OK();
 }
 
@@ -157,14 +248,17 @@ void TransactionTracker::DecrementCounters(const TransactionDriver& driver) cons
 
   DCHECK_GT(metrics_->all_transactions_inflight->value(), 0);
   metrics_->all_transactions_inflight->Decrement();
+  int64_t pending_us = (MonoTime::Now() - driver.start_time()).ToMicroseconds();
   switch (driver.tx_type()) {
     case Transaction::WRITE_TXN:
       DCHECK_GT(metrics_->write_transactions_inflight->value(), 0);
       metrics_->write_transactions_inflight->Decrement();
+      metrics_->write_transaction_pending_duration->Increment(pending_us);
       break;
     case Transaction::ALTER_SCHEMA_TXN:
       DCHECK_GT(metrics_->alter_schema_transactions_inflight->value(), 0);
       metrics_->alter_schema_transactions_inflight->Decrement();
+      metrics_->alter_schema_transaction_pending_duration->Increment(pending_us);
       break;
   }
 }
@@ -173,12 +267,11 @@ void TransactionTracker::Release(TransactionDriver* driver) {
   DecrementCounters(*driver);
 
   // Remove the transaction from the map updating memory consumption if needed.
-  std::lock_guard<simple_spinlock> l(lock_);
-  State st = FindOrDie(pending_txns_, driver);
-  if (mem_tracker_) {
-    mem_tracker_->Release(st.memory_footprint);
-  }
-  if (PREDICT_FALSE(pending_txns_.erase(driver) != 1)) {
+  Shard* shard = GetShard(driver);
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  State st = FindOrDie(shard->pending_txns, driver);
+  ReleaseUnlocked(shard, st.memory_footprint);
+  if (PREDICT_FALSE(shard->pending_txns.erase(driver) != 1)) {
     LOG(FATAL) << "Could not remove pending transaction from map: "
         << driver->ToStringUnlocked();
   }
@@ -187,16 +280,22 @@ void TransactionTracker::Release(TransactionDriver* driver) {
 void TransactionTracker::GetPendingTransactions(
     vector<scoped_refptr<TransactionDriver> >* pending_out) const {
   DCHECK(pending_out->empty());
-  std::lock_guard<simple_spinlock> l(lock_);
-  for (const TxnMap::value_type& e : pending_txns_) {
-    // Increments refcount of each transaction.
-    pending_out->push_back(e.first);
+  for (const Shard& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    for (const TxnMap::value_type& e : shard.pending_txns) {
+      // Increments refcount of each transaction.
+      pending_out->push_back(e.first);
+    }
   }
 }
 
 int TransactionTracker::GetNumPendingForTests() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return pending_txns_.size();
+  int num_pending = 0;
+  for (const Shard& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard.lock);
+    num_pending += shard.pending_txns.size();
+  }
+  return num_pending;
 }
 
 void TransactionTracker::WaitForAllToFinish() const {
@@ -251,10 +350,11 @@ void TransactionTracker::StartInstrumentation(
 void TransactionTracker::StartMemoryTracking(
     const shared_ptr<MemTracker>& parent_mem_tracker) {
   if (FLAGS_tablet_transaction_memory_limit_mb != -1) {
-    mem_tracker_ = MemTracker::CreateTracker(
-        FLAGS_tablet_transaction_memory_limit_mb * 1024 * 1024,
-        "txn_tracker",
-        parent_mem_tracker);
+    int64_t limit = FLAGS_tablet_transaction_memory_limit_mb * 1024 * 1024;
+    mem_tracker_ = MemTracker::CreateTracker(limit, "txn_tracker", parent_mem_tracker);
+    // Each shard reserves a small fraction of the limit at a time, so that
+    // the reservations don't take much of the limit.
+    reservation_chunk_bytes_ = std::min<int64_t>(1024 * 1024, limit / (kNumShards * 16));
   }
 }
 
@@ -25,6 +25,7 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
@@ -42,6 +43,14 @@ class TransactionDriver;
 // Each TabletReplica has a TransactionTracker which keeps track of pending transactions.
 // Each "LeaderTransaction" will register itself by calling Add().
 // It will remove itself by calling Release().
+//
+// The pending transactions are sharded by driver, so that concurrent writes
+// to the same tablet rarely contend on a lock. Each shard also reserves
+// transaction memory from the tracker's MemTracker in chunks, and accounts
+// for its transactions against its reservation, so that most transactions
+// don't touch the MemTracker hierarchy at all. The memory limit is thus
+// approximate: a transaction may be rejected while the other shards hold
+// unused reservations, of at most a chunk each.
 class TransactionTracker {
  public:
   TransactionTracker();
@@ -78,6 +87,10 @@ class TransactionTracker {
     scoped_refptr<AtomicGauge<uint64_t> > alter_schema_transactions_inflight;
 
     scoped_refptr<Counter> transaction_memory_pressure_rejections;
+
+    // How long transactions were pending, by type.
+    scoped_refptr<Histogram> write_transaction_pending_duration;
+    scoped_refptr<Histogram> alter_schema_transaction_pending_duration;
   };
 
   // Increments relevant metric counters.
@@ -86,8 +99,6 @@ class TransactionTracker {
   // Decrements relevant metric counters.
   void DecrementCounters(const TransactionDriver& driver) const;
 
-  mutable simple_spinlock lock_;
-
   // Per-transaction state that is tracked along with the transaction itself.
   struct State {
     State();
@@ -96,12 +107,43 @@ class TransactionTracker {
     int64_t memory_footprint;
   };
 
-  // Protected by 'lock_'.
   typedef std::unordered_map<scoped_refptr<TransactionDriver>,
       State,
       ScopedRefPtrHashFunctor<TransactionDriver>,
       ScopedRefPtrEqualToFunctor<TransactionDriver> > TxnMap;
-  TxnMap pending_txns_;
+
+  struct CACHELINE_ALIGNED Shard {
+    mutable simple_spinlock lock;
+
+    // Protected by 'lock'.
+    TxnMap pending_txns;
+
+    // The memory consumed from 'mem_tracker_' on behalf of the shard, and the
+    // part of it used by the shard's transactions. Protected by 'lock'.
+    int64_t memory_reserved = 0;
+    int64_t memory_used = 0;
+  };
+
+  static const int kNumShards = 16;
+
+  Shard* GetShard(const TransactionDriver* driver);
+
+  // Accounts for 'bytes' of transaction memory in 'shard', reserving more
+  // from 'mem_tracker_' if needed. Returns false if the memory limit is
+  // reached. 'shard->lock' must be held.
+  bool TryConsumeUnlocked(Shard* shard, int64_t bytes);
+
+  // Releases 'bytes' of transaction memory in 'shard', returning the
+  // shard's excess reservation to 'mem_tracker_'. 'shard->lock' must be held.
+  void ReleaseUnlocked(Shard* shard, int64_t bytes);
+
+  // Returns the unused reservations of all the shards to 'mem_tracker_'.
+  void ReturnReservations();
+
+  Shard shards_[kNumShards];
+
+  // The size of the chunks in which shards reserve memory.
+  int64_t reservation_chunk_bytes_;
 
   gscoped_ptr<Metrics> metrics_;
 
@@ -44,6 +44,7 @@
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/tablet/row_cache.h"
 #include "kudu/tablet/row_op.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet.pb.h"
@@ -89,7 +90,7 @@ WriteTransaction::WriteTransaction(unique_ptr<WriteTransactionState> state, Driv
 void WriteTransaction::NewReplicateMsg(gscoped_ptr<ReplicateMsg>* replicate_msg) {
   replicate_msg->reset(new ReplicateMsg);
   (*replicate_msg)->set_op_type(WRITE_OP);
-  (*replicate_msg)->mutable_write_request()->CopyFrom(*state()->request());
+  state()->MoveRequestTo((*replicate_msg)->mutable_write_request());
   if (state()->are_results_tracked()) {
     (*replicate_msg)->mutable_request_id()->CopyFrom(state()->request_id());
   }
@@ -251,6 +252,18 @@ WriteTransactionState::WriteTransactionState(TabletReplica* tablet_replica,
   }
 }
 
+void WriteTransactionState::MoveRequestTo(tserver::WriteRequestPB* dst) {
+  if (!movable_request_) {
+    dst->CopyFrom(*request_);
+    return;
+  }
+  // Swapping only exchanges the pointers to the nested messages and strings,
+  // so the row data isn't copied.
+  dst->Swap(movable_request_);
+  movable_request_ = nullptr;
+  request_ = dst;
+}
+
 void WriteTransactionState::SetMvccTx(gscoped_ptr<ScopedTransaction> mvcc_tx) {
   DCHECK(!mvcc_tx_) << "Mvcc transaction already started/set.";
   mvcc_tx_ = std::move(mvcc_tx);
@@ -366,6 +379,14 @@ void WriteTransactionState::UpdateMetricsForOp(const RowOp& op) {
 }
 
 void WriteTransactionState::ReleaseRowLocks() {
+  // The transaction is committed or aborted by now, so the rows may be cached
+  // again.
+  if (row_cache_) {
+    for (RowOp* op : row_ops_) {
+      row_cache_->EndMutation(op->key_probe->encoded_key_slice());
+    }
+    row_cache_.reset();
+  }
   // free the row locks
   for (RowOp* op : row_ops_) {
     op->row_lock.Release();
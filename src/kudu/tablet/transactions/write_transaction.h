@@ -22,6 +22,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -50,6 +51,7 @@ class RequestIdPB;
 
 namespace tablet {
 
+class RowCache;
 class ScopedTransaction;
 class TabletReplica;
 class TxResultPB;
@@ -100,6 +102,21 @@ class WriteTransactionState : public TransactionState {
     return request_;
   }
 
+  // Allows the request to be moved into the REPLICATE message of this
+  // transaction rather than copied, for requests which their owner no longer
+  // needs once the transaction is submitted. 'request' must be the request
+  // this state was constructed with.
+  void set_request_movable(tserver::WriteRequestPB* request) {
+    DCHECK_EQ(request, request_);
+    movable_request_ = request;
+  }
+
+  // Fills 'dst' with the request, moving it there if it's movable, and
+  // points request() at 'dst' in that case. 'dst' must then outlive this
+  // state, which it does when it's part of the REPLICATE message of this
+  // transaction's consensus round.
+  void MoveRequestTo(tserver::WriteRequestPB* dst);
+
   // Returns the prepared response to the client that will be sent when this
   // transaction is completed, if this transaction was started by a client.
   tserver::WriteResponsePB *response() const OVERRIDE {
@@ -172,6 +189,12 @@ class WriteTransactionState : public TransactionState {
     return &stats_array_[i];
   }
 
+  // Sets the row cache which the mutations of this transaction's rows were
+  // begun in. They're ended when the row locks are released.
+  void set_row_cache(std::shared_ptr<RowCache> row_cache) {
+    row_cache_ = std::move(row_cache);
+  }
+
   // Set the 'row_ops' member based on the given decoded operations.
   void SetRowOps(std::vector<DecodedRowOperation> decoded_ops);
 
@@ -202,10 +225,17 @@ class WriteTransactionState : public TransactionState {
   const tserver::WriteRequestPB* request_;
   tserver::WriteResponsePB* response_;
 
+  // 'request_', if it may be moved by MoveRequestTo(), or NULL.
+  tserver::WriteRequestPB* movable_request_ = nullptr;
+
   // The row operations which are decoded from the request during PREPARE
   // Protected by superclass's txn_state_lock_.
   std::vector<RowOp*> row_ops_;
 
+  // The row cache which the mutations of the rows of 'row_ops_' were begun
+  // in, if any.
+  std::shared_ptr<RowCache> row_cache_;
+
   // Array of ProbeStats for each of the operations in 'row_ops_'.
   // Allocated from this transaction's arena during SetRowOps().
   ProbeStats* stats_array_ = nullptr;
@@ -541,6 +541,7 @@ TEST_F(ToolTest, TestModeHelp) {
   {
     const vector<string> kClusterModeRegexes = {
         "ksck.*Check the health of a Kudu cluster",
+        "rebalance_leaders.*Move tablet leaderships between tablet servers",
     };
     NO_FATALS(RunTestHelp("cluster", kClusterModeRegexes));
   }
@@ -568,7 +569,9 @@ TEST_F(ToolTest, TestModeHelp) {
   }
   {
     const vector<string> kPerfRegexes = {
+        "compaction_sim.*Simulate compaction policies over a dumped rowset layout",
         "loadgen.*Run load generation with optional scan afterwards",
+        "raft_loadgen.*Measure the throughput and latency of Raft replication",
     };
     NO_FATALS(RunTestHelp("perf", kPerfRegexes));
   }
@@ -628,6 +631,7 @@ TEST_F(ToolTest, TestModeHelp) {
   {
     const vector<string> kWalModeRegexes = {
         "dump.*Dump a WAL",
+        "stats.*Summarize the entries of a tablet's WAL",
     };
     NO_FATALS(RunTestHelp("wal", kWalModeRegexes));
   }
@@ -1131,6 +1135,17 @@ TEST_F(ToolTest, TestWalDump) {
       ASSERT_STR_NOT_MATCHES(stdout, "Footer:");
     }
   }
+
+  {
+    NO_FATALS(RunActionStdoutString(Substitute(
+        "wal stats $0 --histograms", fs.GetTabletWalDir(kTestTablet)), &stdout));
+    SCOPED_TRACE(stdout);
+    ASSERT_STR_MATCHES(stdout, "Segments:");
+    ASSERT_STR_MATCHES(stdout, "WRITE_OP *\\| *1 ");
+    ASSERT_STR_MATCHES(stdout, "Terms:");
+    ASSERT_STR_MATCHES(stdout, "Histograms:");
+    ASSERT_STR_NOT_MATCHES(stdout, "this is a test insert");
+  }
 }
 
 TEST_F(ToolTest, TestLocalReplicaDumpMeta) {
@@ -1642,6 +1657,42 @@ TEST_F(ToolTest, TestLoadgenAutoGenTablePartitioning) {
   ASSERT_OK(WaitForNumTabletsOnTS(ts, expected_tablets, kTimeout));
 }
 
+// Run the Raft load generator over a small sweep, and check that it reports
+// each combination as a line of CSV, and that it cleans up its tablets.
+TEST_F(ToolTest, TestRaftLoadgen) {
+  {
+    ExternalMiniClusterOptions opts;
+    opts.num_tablet_servers = 3;
+    NO_FATALS(StartExternalMiniCluster(std::move(opts)));
+  }
+  const string master_addrs =
+      HostPort::ToCommaSeparatedString(cluster_->master_rpc_addrs());
+  string out;
+  NO_FATALS(RunActionStdoutString(Substitute(
+      "perf raft_loadgen $0 --raft_op_sizes_bytes=16,4096 --raft_concurrency=1,4 "
+      "--raft_replication_factors=1,3 --raft_run_seconds=1", master_addrs), &out));
+  vector<string> lines = strings::Split(out, "\n", strings::SkipEmpty());
+  ASSERT_EQ(9, lines.size()) << out;
+  ASSERT_STR_CONTAINS(lines[0], "op_size_bytes,concurrency,replication_factor,ops_per_sec");
+  for (int i = 1; i < lines.size(); i++) {
+    vector<string> fields = strings::Split(lines[i], ",");
+    ASSERT_EQ(10, fields.size()) << lines[i];
+    double ops_per_sec;
+    ASSERT_TRUE(safe_strtod(fields[3], &ops_per_sec)) << lines[i];
+    ASSERT_GT(ops_per_sec, 0) << lines[i];
+  }
+  for (const auto& e : ts_map_) {
+    ASSERT_OK(WaitForNumTabletsOnTS(e.second, 0, MonoDelta::FromSeconds(10)));
+  }
+
+  // The replication factor is bounded by the number of tablet servers.
+  string stderr;
+  Status s = RunActionStderrString(Substitute(
+      "perf raft_loadgen $0 --raft_replication_factors=4", master_addrs), &stderr);
+  ASSERT_TRUE(s.IsRuntimeError()) << s.ToString();
+  ASSERT_STR_CONTAINS(stderr, "greater than the number of tablet servers");
+}
+
 // Test that a non-random workload results in the behavior we would expect when
 // running against an auto-generated range partitioned table.
 TEST_F(ToolTest, TestNonRandomWorkloadLoadgen) {
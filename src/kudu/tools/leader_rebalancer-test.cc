@@ -0,0 +1,200 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tools/leader_rebalancer.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace kudu {
+namespace tools {
+
+namespace {
+
+// The leader load of each server after the transfers in 'transfers'.
+unordered_map<string, double> LoadAfter(const vector<string>& server_uuids,
+                                        const vector<TabletLeaderLoad>& tablets,
+                                        const vector<LeaderTransfer>& transfers) {
+  unordered_map<string, string> leader_by_tablet;
+  for (const auto& tablet : tablets) {
+    leader_by_tablet[tablet.tablet_id] = tablet.leader_uuid;
+  }
+  for (const auto& transfer : transfers) {
+    EXPECT_EQ(transfer.from, leader_by_tablet[transfer.tablet_id]);
+    leader_by_tablet[transfer.tablet_id] = transfer.to;
+  }
+  unordered_map<string, double> load;
+  for (const auto& uuid : server_uuids) {
+    load[uuid] = 0;
+  }
+  for (const auto& tablet : tablets) {
+    load[leader_by_tablet[tablet.tablet_id]] += tablet.load;
+  }
+  return load;
+}
+
+} // anonymous namespace
+
+TEST(LeaderBalancingAlgoTest, TestNoServers) {
+  LeaderBalancingAlgo algo(0.1);
+  vector<LeaderTransfer> transfers;
+  ASSERT_OK(algo.GetNextTransfers({}, {}, 0, &transfers));
+  ASSERT_TRUE(transfers.empty());
+}
+
+TEST(LeaderBalancingAlgoTest, TestBalanced) {
+  const vector<string> servers = { "ts0", "ts1", "ts2" };
+  const vector<TabletLeaderLoad> tablets = {
+    { "t0", "ts0", { "ts1", "ts2" }, 100 },
+    { "t1", "ts1", { "ts0", "ts2" }, 105 },
+    { "t2", "ts2", { "ts0", "ts1" }, 95 },
+  };
+  LeaderBalancingAlgo algo(0.1);
+  vector<LeaderTransfer> transfers;
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 0, &transfers));
+  ASSERT_TRUE(transfers.empty());
+}
+
+// All the leaders are on one server; they spread over all three.
+TEST(LeaderBalancingAlgoTest, TestSkewedLeaders) {
+  const vector<string> servers = { "ts0", "ts1", "ts2" };
+  vector<TabletLeaderLoad> tablets;
+  for (int i = 0; i < 9; i++) {
+    tablets.push_back({ "t" + std::to_string(i), "ts0", { "ts1", "ts2" }, 10 });
+  }
+  LeaderBalancingAlgo algo(0);
+  vector<LeaderTransfer> transfers;
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 0, &transfers));
+  ASSERT_EQ(6, transfers.size());
+  const auto load = LoadAfter(servers, tablets, transfers);
+  for (const auto& uuid : servers) {
+    EXPECT_EQ(30, FindOrDie(load, uuid)) << uuid;
+  }
+
+  // Once the transfers are done, none are needed any more.
+  for (const auto& transfer : transfers) {
+    for (auto& tablet : tablets) {
+      if (tablet.tablet_id == transfer.tablet_id) {
+        tablet.leader_uuid = transfer.to;
+        tablet.follower_uuids = { "ts0", transfer.to == "ts1" ? "ts2" : "ts1" };
+      }
+    }
+  }
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 0, &transfers));
+  ASSERT_TRUE(transfers.empty());
+}
+
+// The leader load, rather than the number of leaders, is balanced: a server
+// may lead a single hot tablet while another leads many cold ones.
+TEST(LeaderBalancingAlgoTest, TestHotTablet) {
+  const vector<string> servers = { "ts0", "ts1" };
+  const vector<TabletLeaderLoad> tablets = {
+    { "hot", "ts0", { "ts1" }, 100 },
+    { "cold0", "ts0", { "ts1" }, 25 },
+    { "cold1", "ts0", { "ts1" }, 25 },
+    { "cold2", "ts0", { "ts1" }, 25 },
+    { "cold3", "ts0", { "ts1" }, 25 },
+  };
+  LeaderBalancingAlgo algo(0);
+  vector<LeaderTransfer> transfers;
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 0, &transfers));
+  const auto load = LoadAfter(servers, tablets, transfers);
+  EXPECT_EQ(100, FindOrDie(load, "ts0"));
+  EXPECT_EQ(100, FindOrDie(load, "ts1"));
+}
+
+// Leaderships only move to the servers hosting followers of the tablet, and
+// a tablet which can't usefully move stays put.
+TEST(LeaderBalancingAlgoTest, TestFollowersOnly) {
+  const vector<string> servers = { "ts0", "ts1", "ts2" };
+  const vector<TabletLeaderLoad> tablets = {
+    { "t0", "ts0", { "ts1" }, 10 },
+    { "t1", "ts0", { "ts1" }, 10 },
+    { "t2", "ts0", {}, 10 },
+  };
+  LeaderBalancingAlgo algo(0);
+  vector<LeaderTransfer> transfers;
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 0, &transfers));
+  ASSERT_EQ(1, transfers.size());
+  EXPECT_EQ("ts1", transfers[0].to);
+  const auto load = LoadAfter(servers, tablets, transfers);
+  EXPECT_EQ(20, FindOrDie(load, "ts0"));
+  EXPECT_EQ(10, FindOrDie(load, "ts1"));
+  EXPECT_EQ(0, FindOrDie(load, "ts2"));
+}
+
+TEST(LeaderBalancingAlgoTest, TestMaxTransfers) {
+  const vector<string> servers = { "ts0", "ts1" };
+  vector<TabletLeaderLoad> tablets;
+  for (int i = 0; i < 10; i++) {
+    tablets.push_back({ "t" + std::to_string(i), "ts0", { "ts1" }, 1 });
+  }
+  LeaderBalancingAlgo algo(0);
+  vector<LeaderTransfer> transfers;
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 2, &transfers));
+  ASSERT_EQ(2, transfers.size());
+  ASSERT_OK(algo.GetNextTransfers(servers, tablets, 0, &transfers));
+  ASSERT_EQ(5, transfers.size());
+}
+
+TEST(LeaderRebalancerTest, TestParseRowsWritten) {
+  const string json = R"([
+    {
+      "type": "server",
+      "id": "kudu.tabletserver",
+      "metrics": [ { "name": "rows_inserted", "value": 1000 } ]
+    },
+    {
+      "type": "tablet",
+      "id": "tablet-a",
+      "metrics": [
+        { "name": "rows_inserted", "value": 10 },
+        { "name": "rows_upserted", "value": 20 },
+        { "name": "rows_updated", "value": 30 },
+        { "name": "rows_deleted", "value": 40 },
+        { "name": "scans_started", "value": 1000 }
+      ]
+    },
+    {
+      "type": "tablet",
+      "id": "tablet-b",
+      "metrics": []
+    }
+  ])";
+  unordered_map<string, int64_t> rows_written;
+  ASSERT_OK(LeaderRebalancer::ParseRowsWritten(json, &rows_written));
+  ASSERT_EQ(2, rows_written.size());
+  EXPECT_EQ(100, FindOrDie(rows_written, "tablet-a"));
+  EXPECT_EQ(0, FindOrDie(rows_written, "tablet-b"));
+
+  ASSERT_FALSE(LeaderRebalancer::ParseRowsWritten("not json", &rows_written).ok());
+}
+
+} // namespace tools
+} // namespace kudu
@@ -0,0 +1,247 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tools/leader_rebalancer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <utility>
+
+#include <boost/optional/optional.hpp>
+#include <glog/logging.h>
+#include <rapidjson/document.h>
+
+#include "kudu/common/wire_protocol.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/master.pb.h"
+#include "kudu/master/master.proxy.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/tools/ksck.h"
+#include "kudu/tools/ksck_remote.h"
+#include "kudu/tools/ksck_results.h"
+#include "kudu/tools/tool_action_common.h"
+#include "kudu/tools/tool_replica_util.h"
+#include "kudu/util/curl_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/jsonreader.h"
+#include "kudu/util/net/net_util.h"
+
+using kudu::consensus::LeaderStepDownMode;
+using kudu::master::ListTabletServersRequestPB;
+using kudu::master::ListTabletServersResponsePB;
+using kudu::master::MasterServiceProxy;
+using rapidjson::Value;
+using std::endl;
+using std::ostream;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tools {
+
+namespace {
+
+// The tablet metrics whose sum is the count of rows written to a tablet.
+const char* const kRowsWrittenMetrics[] = {
+  "rows_inserted",
+  "rows_upserted",
+  "rows_updated",
+  "rows_deleted",
+};
+
+} // anonymous namespace
+
+LeaderRebalancer::LeaderRebalancer(Config config)
+    : config_(std::move(config)) {
+}
+
+Status LeaderRebalancer::ParseRowsWritten(const string& metrics_json,
+                                          unordered_map<string, int64_t>* rows_written) {
+  DCHECK(rows_written);
+  rows_written->clear();
+  JsonReader r(metrics_json);
+  RETURN_NOT_OK(r.Init());
+  vector<const Value*> entities;
+  RETURN_NOT_OK(r.ExtractObjectArray(r.root(), nullptr, &entities));
+  for (const Value* entity : entities) {
+    string type;
+    RETURN_NOT_OK(r.ExtractString(entity, "type", &type));
+    if (type != "tablet") {
+      continue;
+    }
+    string id;
+    RETURN_NOT_OK(r.ExtractString(entity, "id", &id));
+    vector<const Value*> metrics;
+    RETURN_NOT_OK(r.ExtractObjectArray(entity, "metrics", &metrics));
+    int64_t rows = 0;
+    for (const Value* metric : metrics) {
+      string name;
+      RETURN_NOT_OK(r.ExtractString(metric, "name", &name));
+      for (const char* rows_metric : kRowsWrittenMetrics) {
+        if (name == rows_metric) {
+          int64_t value;
+          RETURN_NOT_OK(r.ExtractInt64(metric, "value", &value));
+          rows += value;
+          break;
+        }
+      }
+    }
+    (*rows_written)[id] = rows;
+  }
+  return Status::OK();
+}
+
+Status LeaderRebalancer::FetchRowsWritten(const HostPort& http_hp,
+                                          unordered_map<string, int64_t>* rows_written) {
+  string url = Substitute("http://$0/metrics?metrics=$1", http_hp.ToString(),
+                          JoinStrings(vector<string>(std::begin(kRowsWrittenMetrics),
+                                                     std::end(kRowsWrittenMetrics)), ","));
+  EasyCurl curl;
+  faststring dst;
+  RETURN_NOT_OK_PREPEND(curl.FetchURL(url, &dst), "unable to fetch " + url);
+  return ParseRowsWritten(dst.ToString(), rows_written);
+}
+
+Status LeaderRebalancer::Run(bool report_only, ostream& out, vector<LeaderTransfer>* transfers) {
+  DCHECK(transfers);
+  transfers->clear();
+
+  // Find the HTTP endpoints of the tablet servers.
+  LeaderMasterProxy proxy;
+  RETURN_NOT_OK(proxy.Init(config_.master_addresses, config_.timeout));
+  ListTabletServersRequestPB list_req;
+  ListTabletServersResponsePB list_resp;
+  RETURN_NOT_OK((proxy.SyncRpc<ListTabletServersRequestPB, ListTabletServersResponsePB>(
+      list_req, &list_resp, "ListTabletServers", &MasterServiceProxy::ListTabletServersAsync)));
+  if (list_resp.has_error()) {
+    return StatusFromPB(list_resp.error().status());
+  }
+  unordered_map<string, HostPort> http_hp_by_uuid;
+  for (const auto& server : list_resp.servers()) {
+    if (server.registration().http_addresses_size() == 0) {
+      continue;
+    }
+    HostPort hp;
+    RETURN_NOT_OK(HostPortFromPB(server.registration().http_addresses(0), &hp));
+    http_hp_by_uuid.emplace(server.instance_id().permanent_uuid(), std::move(hp));
+  }
+
+  // Find the leaders and their healthy followers.
+  shared_ptr<KsckCluster> cluster;
+  RETURN_NOT_OK_PREPEND(RemoteKsckCluster::Build(config_.master_addresses, &cluster),
+                        "unable to build KsckCluster");
+  Ksck ksck(cluster);
+  ksck.set_table_filters(config_.table_filters);
+  // Ignoring the result: leaders of healthy tablets may move even if some
+  // other tablets are unhealthy.
+  ignore_result(ksck.Run());
+  const KsckResults& results = ksck.results();
+
+  vector<string> server_uuids;
+  unordered_map<string, HostPort> rpc_hp_by_uuid;
+  for (const auto& summary : results.tserver_summaries) {
+    if (summary.health != KsckServerHealth::HEALTHY ||
+        !ContainsKey(http_hp_by_uuid, summary.uuid)) {
+      continue;
+    }
+    HostPort hp;
+    RETURN_NOT_OK(hp.ParseString(summary.address, 0));
+    server_uuids.push_back(summary.uuid);
+    rpc_hp_by_uuid.emplace(summary.uuid, std::move(hp));
+  }
+
+  vector<TabletLeaderLoad> tablets;
+  for (const auto& summary : results.tablet_summaries) {
+    TabletLeaderLoad tablet;
+    tablet.tablet_id = summary.id;
+    for (const auto& replica : summary.replicas) {
+      if (replica.is_leader) {
+        tablet.leader_uuid = replica.ts_uuid;
+      } else if (replica.is_voter && replica.ts_healthy &&
+                 replica.state == tablet::RUNNING) {
+        tablet.follower_uuids.push_back(replica.ts_uuid);
+      }
+    }
+    if (!tablet.leader_uuid.empty()) {
+      tablets.emplace_back(std::move(tablet));
+    }
+  }
+
+  // Sample the rows written to each tablet at its leader, and take the rate
+  // as the leader's load.
+  unordered_map<string, unordered_map<string, int64_t>> before_by_server;
+  for (const auto& uuid : server_uuids) {
+    RETURN_NOT_OK(FetchRowsWritten(FindOrDie(http_hp_by_uuid, uuid), &before_by_server[uuid]));
+  }
+  const MonoTime start = MonoTime::Now();
+  SleepFor(config_.sample_interval);
+  unordered_map<string, unordered_map<string, int64_t>> after_by_server;
+  for (const auto& uuid : server_uuids) {
+    RETURN_NOT_OK(FetchRowsWritten(FindOrDie(http_hp_by_uuid, uuid), &after_by_server[uuid]));
+  }
+  const double interval_sec = (MonoTime::Now() - start).ToSeconds();
+  for (auto& tablet : tablets) {
+    const auto* before = FindOrNull(before_by_server, tablet.leader_uuid);
+    const auto* after = FindOrNull(after_by_server, tablet.leader_uuid);
+    const int64_t* rows_before = before ? FindOrNull(*before, tablet.tablet_id) : nullptr;
+    const int64_t* rows_after = after ? FindOrNull(*after, tablet.tablet_id) : nullptr;
+    // A count going backwards means the replica was restarted meanwhile;
+    // count no load for it then.
+    if (rows_before && rows_after && *rows_after > *rows_before) {
+      tablet.load = (*rows_after - *rows_before) / interval_sec;
+    }
+  }
+
+  vector<LeaderTransfer> planned;
+  LeaderBalancingAlgo algo(config_.load_tolerance);
+  RETURN_NOT_OK(algo.GetNextTransfers(server_uuids, tablets, config_.max_transfers, &planned));
+  if (planned.empty()) {
+    out << "leader load is balanced" << endl;
+    return Status::OK();
+  }
+  for (const auto& transfer : planned) {
+    out << Substitute("transfer leadership of tablet $0 from $1 to $2",
+                      transfer.tablet_id, transfer.from, transfer.to) << endl;
+    if (report_only) {
+      continue;
+    }
+    Status s = DoLeaderStepDown(transfer.tablet_id, transfer.from,
+                                FindOrDie(rpc_hp_by_uuid, transfer.from),
+                                LeaderStepDownMode::GRACEFUL, transfer.to, config_.timeout);
+    if (!s.ok()) {
+      // The leader may have changed since it was sampled; the next run will
+      // reconsider the tablet.
+      LOG(WARNING) << Substitute("unable to transfer leadership of tablet $0 to $1: $2",
+                                 transfer.tablet_id, transfer.to, s.ToString());
+      continue;
+    }
+    transfers->push_back(transfer);
+  }
+  return Status::OK();
+}
+
+} // namespace tools
+} // namespace kudu
@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/tools/rebalance_algo.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class HostPort;
+
+namespace tools {
+
+// Transfers tablet leaderships between the tablet servers of a cluster to
+// spread the leader load evenly. The load of a leader is the rate of rows
+// written to its tablet, sampled from the tablet servers' metrics.
+class LeaderRebalancer {
+ public:
+  struct Config {
+    // Kudu masters' RPC endpoints.
+    std::vector<std::string> master_addresses;
+
+    // Names of tables whose leaders to move. If empty, the leaders of every
+    // table are moved.
+    std::vector<std::string> table_filters;
+
+    // How long to sample the write rates of the tablets for.
+    MonoDelta sample_interval = MonoDelta::FromSeconds(10);
+
+    // The most leadership transfers to do in one run, to bound the churn.
+    int max_transfers = 10;
+
+    // See LeaderBalancingAlgo.
+    double load_tolerance = 0.1;
+
+    // The timeout of the RPCs to the cluster.
+    MonoDelta timeout = MonoDelta::FromSeconds(30);
+  };
+
+  explicit LeaderRebalancer(Config config);
+
+  // Sample the leader loads, and request the leadership transfers which
+  // balance them. 'transfers' is set to the transfers which were requested
+  // successfully; the leadership transfers themselves are asynchronous.
+  // If 'report_only', only print the planned transfers to 'out'.
+  Status Run(bool report_only, std::ostream& out, std::vector<LeaderTransfer>* transfers);
+
+  // Parse the per-tablet counts of rows written from the JSON output of a
+  // tablet server's /metrics page into 'rows_written', keyed by tablet id.
+  static Status ParseRowsWritten(const std::string& metrics_json,
+                                 std::unordered_map<std::string, int64_t>* rows_written);
+
+ private:
+  // Fetch the per-tablet counts of rows written from the metrics of the
+  // tablet server at 'http_hp'.
+  static Status FetchRowsWritten(const HostPort& http_hp,
+                                 std::unordered_map<std::string, int64_t>* rows_written);
+
+  const Config config_;
+};
+
+} // namespace tools
+} // namespace kudu
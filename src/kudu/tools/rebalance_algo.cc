@@ -616,5 +616,99 @@ Status LocationBalancingAlgo::FindBestMove(
   return Status::OK();
 }
 
+
+LeaderBalancingAlgo::LeaderBalancingAlgo(double load_tolerance)
+    : load_tolerance_(load_tolerance) {
+  DCHECK_GE(load_tolerance_, 0);
+}
+
+Status LeaderBalancingAlgo::GetNextTransfers(const vector<string>& server_uuids,
+                                             const vector<TabletLeaderLoad>& tablets,
+                                             int max_transfers,
+                                             vector<LeaderTransfer>* transfers) const {
+  DCHECK_GE(max_transfers, 0);
+  DCHECK(transfers);
+  transfers->clear();
+  if (server_uuids.empty()) {
+    return Status::OK();
+  }
+
+  unordered_map<string, double> load_by_server;
+  for (const auto& uuid : server_uuids) {
+    load_by_server.emplace(uuid, 0);
+  }
+  // Indexes into 'tablets' of the leaders which may still move, by server.
+  unordered_map<string, vector<int>> movable_by_server;
+  double total_load = 0;
+  for (int i = 0; i < tablets.size(); i++) {
+    const auto& tablet = tablets[i];
+    if (tablet.load < 0) {
+      return Status::InvalidArgument(
+          Substitute("tablet $0: negative leader load $1", tablet.tablet_id, tablet.load));
+    }
+    double* load = FindOrNull(load_by_server, tablet.leader_uuid);
+    if (!load) {
+      // The leader's server isn't to be balanced, so leave the tablet be.
+      continue;
+    }
+    *load += tablet.load;
+    total_load += tablet.load;
+    movable_by_server[tablet.leader_uuid].push_back(i);
+  }
+  const double max_balanced_load =
+      total_load / server_uuids.size() * (1 + load_tolerance_);
+
+  while (max_transfers == 0 || static_cast<int>(transfers->size()) < max_transfers) {
+    // Find the most loaded server.
+    auto most_loaded = load_by_server.begin();
+    for (auto it = load_by_server.begin(); it != load_by_server.end(); ++it) {
+      if (it->second > most_loaded->second) {
+        most_loaded = it;
+      }
+    }
+    if (most_loaded->second <= max_balanced_load) {
+      break;
+    }
+
+    // Of the leaderships it may give away, find the transfer which leaves
+    // the more loaded of the two servers the least loaded, and of those the
+    // one leaving the new leader's server the least loaded.
+    vector<int>& movable = movable_by_server[most_loaded->first];
+    int best_idx = -1;
+    const string* best_to = nullptr;
+    double best_max_load = most_loaded->second;
+    double best_to_load = 0;
+    for (int idx : movable) {
+      const auto& tablet = tablets[idx];
+      for (const auto& follower_uuid : tablet.follower_uuids) {
+        const double* follower_load = FindOrNull(load_by_server, follower_uuid);
+        if (!follower_load) {
+          continue;
+        }
+        const double to_load = *follower_load + tablet.load;
+        const double max_load = std::max(most_loaded->second - tablet.load, to_load);
+        if (max_load < best_max_load ||
+            (best_idx != -1 && max_load == best_max_load && to_load < best_to_load)) {
+          best_idx = idx;
+          best_to = &follower_uuid;
+          best_max_load = max_load;
+          best_to_load = to_load;
+        }
+      }
+    }
+    if (best_idx == -1) {
+      // No transfer lowers the load of the most loaded server.
+      break;
+    }
+
+    const auto& tablet = tablets[best_idx];
+    most_loaded->second -= tablet.load;
+    FindOrDie(load_by_server, *best_to) += tablet.load;
+    movable.erase(std::find(movable.begin(), movable.end(), best_idx));
+    transfers->push_back({ tablet.tablet_id, most_loaded->first, *best_to });
+  }
+  return Status::OK();
+}
+
 } // namespace tools
 } // namespace kudu
@@ -282,5 +282,58 @@ class LocationBalancingAlgo : public RebalancingAlgo {
       boost::optional<TableReplicaMove>* move);
 };
 
+// The load of a tablet's leader replica, and the servers which may take over
+// the leadership.
+struct TabletLeaderLoad {
+  std::string tablet_id;
+
+  // Unique identifier of the tablet server hosting the leader.
+  std::string leader_uuid;
+
+  // Unique identifiers of the tablet servers hosting healthy voter replicas
+  // other than the leader.
+  std::vector<std::string> follower_uuids;
+
+  // The load the leadership puts on its server, e.g. rows written per second.
+  double load = 0;
+};
+
+// A directive to transfer the leadership of a tablet between two servers.
+struct LeaderTransfer {
+  std::string tablet_id;
+  std::string from;     // Unique identifier of the current leader's server.
+  std::string to;       // Unique identifier of the new leader's server.
+};
+
+// A greedy algorithm spreading the leader load evenly over the tablet
+// servers. Each transfer moves a leadership off the most loaded server to
+// the follower's server which ends up the least loaded of the two, as long
+// as that lowers the load of the most loaded server. The servers are
+// considered balanced once none of them carries more than 'load_tolerance'
+// above the mean load, e.g. 0.1 for 10%.
+class LeaderBalancingAlgo {
+ public:
+  explicit LeaderBalancingAlgo(double load_tolerance);
+
+  // Using the leader loads of the tablets in 'tablets', populate 'transfers'
+  // with no more than 'max_transfers' leadership transfers that spread the
+  // load over the servers in 'server_uuids', moving the leadership of any
+  // tablet at most once. 'max_transfers' of 0 means no limit. Servers in
+  // 'server_uuids' which lead no tablet count as carrying no load; servers
+  // not in it get no leaderships.
+  //
+  // Once this method returns Status::OK() and leaves 'transfers' empty, the
+  // leader load is considered balanced.
+  //
+  // 'transfers' must be non-NULL.
+  Status GetNextTransfers(const std::vector<std::string>& server_uuids,
+                          const std::vector<TabletLeaderLoad>& tablets,
+                          int max_transfers,
+                          std::vector<LeaderTransfer>* transfers) const;
+
+ private:
+  const double load_tolerance_;
+};
+
 } // namespace tools
 } // namespace kudu
@@ -39,10 +39,12 @@
 #include "kudu/tools/ksck.h"
 #include "kudu/tools/ksck_remote.h"
 #include "kudu/tools/ksck_results.h"
+#include "kudu/tools/leader_rebalancer.h"
 #include "kudu/tools/rebalancer.h"
 #include "kudu/tools/tool_action.h"
 #include "kudu/tools/tool_action_common.h"
 #include "kudu/tools/tool_replica_util.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 #include "kudu/util/version_util.h"
 
@@ -63,6 +65,7 @@ using strings::Substitute;
   } \
 } while (0);
 
+DECLARE_int64(timeout_ms);
 DECLARE_string(tables);
 DEFINE_string(tablets, "",
               "Tablets to check (comma-separated list of IDs) "
@@ -120,6 +123,18 @@ DEFINE_bool(disable_intra_location_rebalancing, false,
             "replica distribution within each location. "
             "This setting is applicable to multi-location clusters only.");
 
+DEFINE_uint32(leader_load_sample_interval_sec, 10,
+              "How long to sample the rates of rows written to the tablets "
+              "for, to estimate the load of their leaders.");
+
+DEFINE_uint32(max_leader_transfers, 10,
+              "Maximum number of leadership transfers to request in one run, "
+              "to bound the churn of leaderships. 0 means no limit.");
+
+DEFINE_double(leader_load_tolerance, 0.1,
+              "The leader load is considered balanced once no tablet server "
+              "carries more than this fraction above the mean leader load.");
+
 static bool ValidateMoveSingleReplicas(const char* flag_name,
                                        const string& flag_value) {
   const vector<string> allowed_values = { "auto", "enabled", "disabled" };
@@ -320,6 +335,29 @@ Status RunRebalance(const RunnerContext& context) {
   return Status::OK();
 }
 
+// Move tablet leaderships to spread the leader load, which is taken to be
+// proportional to the rate of rows written to the tablets.
+Status RunRebalanceLeaders(const RunnerContext& context) {
+  LeaderRebalancer::Config config;
+  config.master_addresses = Split(FindOrDie(context.required_args, kMasterAddressesArg), ",");
+  config.table_filters = Split(FLAGS_tables, ",", strings::SkipEmpty());
+  config.sample_interval = MonoDelta::FromSeconds(FLAGS_leader_load_sample_interval_sec);
+  config.max_transfers = FLAGS_max_leader_transfers;
+  config.load_tolerance = FLAGS_leader_load_tolerance;
+  config.timeout = MonoDelta::FromMilliseconds(FLAGS_timeout_ms);
+  if (config.load_tolerance < 0) {
+    return Status::InvalidArgument("--leader_load_tolerance must not be negative");
+  }
+
+  LeaderRebalancer rebalancer(std::move(config));
+  vector<LeaderTransfer> transfers;
+  RETURN_NOT_OK(rebalancer.Run(FLAGS_report_only, cout, &transfers));
+  if (!FLAGS_report_only) {
+    cout << Substitute("requested $0 leadership transfers", transfers.size()) << endl;
+  }
+  return Status::OK();
+}
+
 } // anonymous namespace
 
 unique_ptr<Mode> BuildClusterMode() {
@@ -382,6 +420,33 @@ unique_ptr<Mode> BuildClusterMode() {
     builder.AddAction(std::move(rebalance));
   }
 
+  {
+    constexpr auto desc = "Move tablet leaderships between tablet servers to "
+        "balance the leader load.";
+    constexpr auto extra_desc = "The load of a leader is estimated by the rate "
+        "of rows written to its tablet, sampled from the tablet servers' "
+        "metrics for --leader_load_sample_interval_sec. Leaderships of the "
+        "most loaded tablet servers are gracefully transferred to followers, "
+        "in the same manner as the 'kudu tablet leader_step_down' command "
+        "with --new_leader_uuid, until no tablet server carries more than "
+        "--leader_load_tolerance above the mean, or --max_leader_transfers "
+        "transfers are requested. Run it periodically to follow changes in "
+        "the load.";
+    unique_ptr<Action> rebalance_leaders =
+        ActionBuilder("rebalance_leaders", &RunRebalanceLeaders)
+        .Description(desc)
+        .ExtraDescription(extra_desc)
+        .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+        .AddOptionalParameter("leader_load_sample_interval_sec")
+        .AddOptionalParameter("leader_load_tolerance")
+        .AddOptionalParameter("max_leader_transfers")
+        .AddOptionalParameter("report_only")
+        .AddOptionalParameter("tables")
+        .AddOptionalParameter("timeout_ms")
+        .Build();
+    builder.AddAction(std::move(rebalance_leaders));
+  }
+
   return builder.Build();
 }
 
@@ -353,7 +353,9 @@ Status PrintSegment(const scoped_refptr<ReadableLogSegment>& segment) {
   }
   if (print_type != DONT_PRINT) {
     Schema tablet_schema;
-    RETURN_NOT_OK(SchemaFromPB(segment->header().schema(), &tablet_schema));
+    if (segment->header().has_schema()) {
+      RETURN_NOT_OK(SchemaFromPB(segment->header().schema(), &tablet_schema));
+    }
 
     LogEntryReader reader(segment.get());
     while (true) {
@@ -162,10 +162,27 @@
 //      |  | thread2 +---------+
 //      |  |         | tabletC |
 //      v  +---------+         v
+//
+//
+// The 'raft_loadgen' action measures the consensus layer alone: it creates
+// dedicated tablet replicas on the cluster's tablet servers and replicates
+// NO_OP operations to them through the consensus service, playing the part
+// of the replicas' leader itself. It sweeps the size of the ops, the number
+// of ops in flight and the number of replicas, printing a line of CSV with
+// the throughput and the commit latency percentiles for each combination:
+//
+//   kudu perf raft_loadgen 127.0.0.1 \
+//     --raft_op_sizes_bytes=128,4096 \
+//     --raft_concurrency=1,8,64 \
+//     --raft_replication_factors=1,3
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -187,20 +204,43 @@
 #include "kudu/client/schema.h"
 #include "kudu/client/shared_ptr.h"
 #include "kudu/client/write_op.h"
+#include "kudu/clock/hybrid_clock.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/consensus.proxy.h"
+#include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/opid.pb.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tablet/compaction_policy.h"
+#include "kudu/tablet/compaction_policy_simulator.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/rowset.h"
 #include "kudu/tools/tool_action.h"
 #include "kudu/tools/tool_action_common.h"
+#include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/tserver/tserver_admin.pb.h"
+#include "kudu/tserver/tserver_admin.proxy.h"
 #include "kudu/util/decimal_util.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_validators.h"
+#include "kudu/util/hdr_histogram.h"
 #include "kudu/util/int128.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/net/net_util.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/random.h"
 #include "kudu/util/status.h"
@@ -222,10 +262,28 @@ using kudu::client::KuduSchemaBuilder;
 using kudu::client::KuduSession;
 using kudu::client::KuduTable;
 using kudu::client::KuduTableCreator;
+using kudu::client::KuduTabletServer;
+using kudu::consensus::ConsensusRequestPB;
+using kudu::consensus::ConsensusResponsePB;
+using kudu::consensus::ConsensusServiceProxy;
+using kudu::consensus::OpId;
+using kudu::consensus::RaftConfigPB;
+using kudu::consensus::RaftPeerPB;
+using kudu::consensus::ReplicateMsg;
+using kudu::rpc::RpcController;
+using kudu::tserver::CreateTabletRequestPB;
+using kudu::tserver::CreateTabletResponsePB;
+using kudu::tserver::DeleteTabletRequestPB;
+using kudu::tserver::DeleteTabletResponsePB;
+using kudu::tserver::TabletServerAdminServiceProxy;
+using kudu::tserver::TabletServerErrorPB;
 using kudu::client::sp::shared_ptr;
 using std::accumulate;
+using std::atomic;
 using std::cerr;
+using std::condition_variable;
 using std::cout;
+using std::deque;
 using std::endl;
 using std::lock_guard;
 using std::mutex;
@@ -233,6 +291,7 @@ using std::numeric_limits;
 using std::ostringstream;
 using std::string;
 using std::thread;
+using std::unique_lock;
 using std::unique_ptr;
 using std::vector;
 using strings::Substitute;
@@ -315,6 +374,33 @@ DEFINE_int32(table_num_range_partitions, 1,
 DEFINE_int32(table_num_replicas, 1,
              "The number of replicas for the auto-created table; "
              "0 means 'use server-side default'.");
+DEFINE_int32(sim_rounds, 100,
+             "Number of flush-and-compact rounds run by the compaction policy "
+             "simulator.");
+DEFINE_int32(sim_flushes_per_round, 1,
+             "Number of rowsets flushed in each round of the compaction policy "
+             "simulator.");
+DEFINE_int32(sim_flush_size_mb, 32,
+             "Size in MiB of each rowset flushed by the compaction policy "
+             "simulator.");
+DEFINE_int32(sim_compactions_per_round, 1,
+             "Maximum number of compactions run in each round of the "
+             "compaction policy simulator.");
+DECLARE_int32(tablet_compaction_budget_mb);
+DEFINE_string(raft_op_sizes_bytes, "1024",
+              "Comma-separated list of the payload sizes, in bytes, of the ops "
+              "replicated by the Raft load generator.");
+DEFINE_string(raft_concurrency, "1,16",
+              "Comma-separated list of the numbers of ops the Raft load "
+              "generator keeps in flight at once.");
+DEFINE_string(raft_replication_factors, "3",
+              "Comma-separated list of the numbers of replicas the Raft load "
+              "generator replicates ops to. Each must be at most the number "
+              "of tablet servers in the cluster.");
+DEFINE_int32(raft_run_seconds, 5,
+             "Number of seconds the Raft load generator replicates ops for "
+             "each combination of op size, concurrency and replication factor.");
+DECLARE_int64(timeout_ms);
 DEFINE_bool(use_random, false,
             "Whether to use random numbers instead of sequential ones. "
             "In case of using random numbers collisions are possible over "
@@ -744,6 +830,453 @@ Status TestLoadGenerator(const RunnerContext& context) {
   return Status::OK();
 }
 
+Status SimulateCompactionPolicies(const RunnerContext& context) {
+  const string& path = FindOrDie(context.required_args, "rowsets_dump");
+  faststring data;
+  RETURN_NOT_OK_PREPEND(ReadFileToString(Env::Default(), path, &data),
+                        Substitute("unable to read rowset dump $0", path));
+  tablet::RowSetVector rowsets;
+  RETURN_NOT_OK(tablet::ParseRowSetDump(data.ToString(), &rowsets));
+
+  tablet::CompactionSimulationOptions opts;
+  opts.num_rounds = FLAGS_sim_rounds;
+  opts.flushes_per_round = FLAGS_sim_flushes_per_round;
+  opts.flush_size_bytes = static_cast<uint64_t>(FLAGS_sim_flush_size_mb) * 1024 * 1024;
+  opts.max_compactions_per_round = FLAGS_sim_compactions_per_round;
+
+  cout << "Simulating " << opts.num_rounds << " rounds over "
+       << rowsets.size() << " rowsets from " << path << endl;
+  {
+    tablet::BudgetedCompactionPolicy policy(FLAGS_tablet_compaction_budget_mb);
+    tablet::CompactionSimulationResult result;
+    RETURN_NOT_OK(tablet::SimulateCompactions(rowsets, opts, &policy, &result));
+    cout << "  budgeted: " << result.ToString() << endl;
+  }
+  {
+    tablet::HybridCompactionPolicy policy(FLAGS_tablet_compaction_budget_mb);
+    tablet::CompactionSimulationResult result;
+    RETURN_NOT_OK(tablet::SimulateCompactions(rowsets, opts, &policy, &result));
+    cout << "  hybrid  : " << result.ToString() << endl;
+  }
+  return Status::OK();
+}
+
+// Parses 'str', a comma-separated list of positive integers, into 'values'.
+Status ParsePositiveIntList(const string& flag_name, const string& str,
+                            vector<int>* values) {
+  for (const auto& elem : strings::Split(str, ",", strings::SkipEmpty())) {
+    int value;
+    if (!safe_strto32(elem.ToString(), &value) || value <= 0) {
+      return Status::InvalidArgument(
+          Substitute("--$0: '$1' is not a positive integer", flag_name, elem.ToString()));
+    }
+    values->push_back(value);
+  }
+  if (values->empty()) {
+    return Status::InvalidArgument(Substitute("--$0 must not be empty", flag_name));
+  }
+  return Status::OK();
+}
+
+// The term of the Raft load generator's leadership. Its replicas start in
+// term 0.
+const int64_t kRaftLoadTerm = 1;
+
+// Approximate maximum size of the ops sent to a replica in one request.
+const int64_t kRaftLoadMaxBatchBytes = 1024 * 1024;
+
+// How often an idle replica is sent a heartbeat.
+const int kRaftLoadHeartbeatIntervalMs = 500;
+
+// A tablet server hosting a replica of the Raft load generator's tablet.
+struct RaftLoadReplica {
+  string uuid;
+  string address;
+  unique_ptr<ConsensusServiceProxy> consensus_proxy;
+  unique_ptr<TabletServerAdminServiceProxy> admin_proxy;
+};
+
+// Replicates NO_OP operations of a fixed size to a set of tablet replicas,
+// acting as their leader: the replicas are non-voters in a Raft config whose
+// only voter is the generator, so they never start elections and just append
+// and acknowledge whatever they receive. An op is committed once a majority
+// of the replicas have durably appended it, so its latency covers the same
+// network round trips and WAL syncs as an op replicated by a real leader,
+// but none of the costs of a tablet.
+//
+// One thread per replica sends batches of ops, as the leader's peers do, and
+// each of 'concurrency' client threads has one op in flight at a time.
+class RaftLoadGenerator {
+ public:
+  RaftLoadGenerator(string tablet_id, string leader_uuid,
+                    vector<RaftLoadReplica*> replicas,
+                    int op_size_bytes, int concurrency)
+      : tablet_id_(std::move(tablet_id)),
+        leader_uuid_(std::move(leader_uuid)),
+        replicas_(std::move(replicas)),
+        op_size_bytes_(op_size_bytes),
+        concurrency_(concurrency),
+        stop_(false),
+        first_index_(1),
+        last_index_(0),
+        committed_index_(0),
+        last_timestamp_(0),
+        sent_index_(replicas_.size(), 0),
+        received_index_(replicas_.size(), 0),
+        num_ops_(0) {
+  }
+
+  // Replicates ops for 'duration', recording the commit latency of each, in
+  // microseconds, in 'latency_hist'. Sets 'ops_per_sec' to the throughput.
+  Status Run(const MonoDelta& duration, HdrHistogram* latency_hist, double* ops_per_sec) {
+    vector<thread> peer_threads;
+    for (size_t i = 0; i < replicas_.size(); i++) {
+      peer_threads.emplace_back([this, i]() { this->PeerThread(i); });
+    }
+
+    // The ops are timed from the first commit, since the replicas may still
+    // be bootstrapping when the peer threads start.
+    Status s = WaitForFirstCommit();
+    Stopwatch sw;
+    if (s.ok()) {
+      const MonoTime deadline = MonoTime::Now() + duration;
+      vector<thread> client_threads;
+      sw.start();
+      for (int i = 0; i < concurrency_; i++) {
+        client_threads.emplace_back([this, deadline, latency_hist]() {
+          this->ClientThread(deadline, latency_hist);
+        });
+      }
+      for (auto& t : client_threads) {
+        t.join();
+      }
+      sw.stop();
+    }
+    {
+      lock_guard<mutex> l(lock_);
+      stop_ = true;
+      cond_.notify_all();
+    }
+    for (auto& t : peer_threads) {
+      t.join();
+    }
+    RETURN_NOT_OK(s);
+    {
+      lock_guard<mutex> l(lock_);
+      RETURN_NOT_OK(error_);
+    }
+    *ops_per_sec = num_ops_ / sw.elapsed().wall_seconds();
+    return Status::OK();
+  }
+
+ private:
+  // Appends a single op and waits for it to be committed.
+  Status WaitForFirstCommit() {
+    unique_lock<mutex> l(lock_);
+    int64_t index = AppendOpUnlocked();
+    const auto timeout = std::chrono::milliseconds(FLAGS_timeout_ms);
+    if (!cond_.wait_for(l, timeout, [&]() { return stop_ || committed_index_ >= index; })) {
+      return Status::TimedOut(
+          Substitute("timed out waiting for the replicas of tablet $0 to start", tablet_id_));
+    }
+    return error_;
+  }
+
+  // Appends a new op to the log and returns its index.
+  int64_t AppendOpUnlocked() {
+    ReplicateMsg msg;
+    int64_t index = ++last_index_;
+    msg.mutable_id()->set_term(kRaftLoadTerm);
+    msg.mutable_id()->set_index(index);
+    // The replicas update their clocks with the ops' timestamps, which must
+    // increase.
+    uint64_t timestamp = std::max(
+        last_timestamp_ + 1,
+        clock::HybridClock::TimestampFromMicroseconds(GetCurrentTimeMicros()).ToUint64());
+    last_timestamp_ = timestamp;
+    msg.set_timestamp(timestamp);
+    msg.set_op_type(consensus::NO_OP);
+    msg.mutable_noop_request()->mutable_payload_for_tests()->resize(op_size_bytes_);
+    log_.emplace_back(std::move(msg));
+    cond_.notify_all();
+    return index;
+  }
+
+  void ClientThread(const MonoTime& deadline, HdrHistogram* latency_hist) {
+    while (MonoTime::Now() < deadline) {
+      unique_lock<mutex> l(lock_);
+      MonoTime start = MonoTime::Now();
+      int64_t index = AppendOpUnlocked();
+      cond_.wait(l, [&]() { return stop_ || committed_index_ >= index; });
+      if (committed_index_ < index) {
+        return;
+      }
+      l.unlock();
+      latency_hist->Increment((MonoTime::Now() - start).ToMicroseconds());
+      num_ops_++;
+    }
+  }
+
+  void PeerThread(size_t idx) {
+    RaftLoadReplica* replica = replicas_[idx];
+    OpId preceding_id = consensus::MinimumOpId();
+    unique_lock<mutex> l(lock_);
+    while (!stop_) {
+      cond_.wait_for(l, std::chrono::milliseconds(kRaftLoadHeartbeatIntervalMs), [&]() {
+        return stop_ || sent_index_[idx] < last_index_;
+      });
+      if (stop_) {
+        break;
+      }
+
+      ConsensusRequestPB req;
+      req.set_dest_uuid(replica->uuid);
+      req.set_tablet_id(tablet_id_);
+      req.set_caller_uuid(leader_uuid_);
+      req.set_caller_term(kRaftLoadTerm);
+      *req.mutable_preceding_id() = preceding_id;
+      req.set_committed_index(committed_index_);
+      int64_t batch_bytes = 0;
+      for (int64_t i = sent_index_[idx] + 1;
+           i <= last_index_ && batch_bytes < kRaftLoadMaxBatchBytes; i++) {
+        const ReplicateMsg& msg = log_[i - first_index_];
+        *req.add_ops() = msg;
+        batch_bytes += msg.ByteSizeLong();
+      }
+      l.unlock();
+
+      ConsensusResponsePB resp;
+      RpcController rpc;
+      rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_timeout_ms));
+      Status s = replica->consensus_proxy->UpdateConsensus(req, &resp, &rpc);
+      if (s.ok() && resp.has_error()) {
+        // The replica may not have finished bootstrapping yet.
+        if (resp.error().code() == TabletServerErrorPB::TABLET_NOT_RUNNING) {
+          SleepFor(MonoDelta::FromMilliseconds(10));
+          l.lock();
+          continue;
+        }
+        s = StatusFromPB(resp.error().status());
+      }
+      if (s.ok() && resp.status().has_error()) {
+        s = StatusFromPB(resp.status().error().status());
+      }
+
+      l.lock();
+      if (!s.ok()) {
+        if (error_.ok()) {
+          error_ = s.CloneAndPrepend(Substitute("replica $0 of tablet $1 failed to replicate",
+                                                replica->address, tablet_id_));
+        }
+        stop_ = true;
+        cond_.notify_all();
+        break;
+      }
+      if (req.ops_size() > 0) {
+        preceding_id = req.ops(req.ops_size() - 1).id();
+        sent_index_[idx] = preceding_id.index();
+      }
+      received_index_[idx] = resp.status().last_received().index();
+      AdvanceCommittedIndexUnlocked();
+    }
+  }
+
+  // Commits the ops received by a majority of the replicas, and discards the
+  // ops which have been sent to all of them.
+  void AdvanceCommittedIndexUnlocked() {
+    vector<int64_t> received = received_index_;
+    std::sort(received.begin(), received.end(), std::greater<int64_t>());
+    int64_t majority_index = received[received.size() / 2];
+    if (majority_index > committed_index_) {
+      committed_index_ = majority_index;
+      cond_.notify_all();
+    }
+    int64_t min_sent_index = *std::min_element(sent_index_.begin(), sent_index_.end());
+    while (first_index_ <= min_sent_index && first_index_ <= committed_index_) {
+      log_.pop_front();
+      first_index_++;
+    }
+  }
+
+  const string tablet_id_;
+  const string leader_uuid_;
+  const vector<RaftLoadReplica*> replicas_;
+  const int op_size_bytes_;
+  const int concurrency_;
+
+  mutex lock_;
+
+  // Signaled when ops are appended or committed, or when the run stops.
+  condition_variable cond_;
+
+  bool stop_;
+  Status error_;
+
+  // The ops which haven't yet been both committed and sent to every replica,
+  // starting with the op at 'first_index_'.
+  deque<ReplicateMsg> log_;
+  int64_t first_index_;
+  int64_t last_index_;
+  int64_t committed_index_;
+  uint64_t last_timestamp_;
+
+  // Per replica, the index of the last op sent to it and the index of the
+  // last op it acknowledged.
+  vector<int64_t> sent_index_;
+  vector<int64_t> received_index_;
+
+  atomic<int64_t> num_ops_;
+};
+
+// Creates a replica of the tablet 'tablet_id' on each of 'replicas', as
+// non-voters in a config led by the Raft load generator 'leader_uuid'.
+Status CreateRaftLoadTablet(const string& tablet_id, const string& leader_uuid,
+                            const vector<RaftLoadReplica*>& replicas) {
+  RaftConfigPB config;
+  config.set_opid_index(consensus::kInvalidOpIdIndex);
+  RaftPeerPB* leader = config.add_peers();
+  leader->set_permanent_uuid(leader_uuid);
+  leader->set_member_type(RaftPeerPB::VOTER);
+  for (const auto* replica : replicas) {
+    RaftPeerPB* peer = config.add_peers();
+    peer->set_permanent_uuid(replica->uuid);
+    peer->set_member_type(RaftPeerPB::NON_VOTER);
+    HostPort hp;
+    RETURN_NOT_OK(hp.ParseString(replica->address, tserver::TabletServer::kDefaultPort));
+    RETURN_NOT_OK(HostPortToPB(hp, peer->mutable_last_known_addr()));
+  }
+
+  SchemaBuilder b;
+  RETURN_NOT_OK(b.AddKeyColumn("key", INT64));
+  const Schema schema = b.Build();
+  for (const auto* replica : replicas) {
+    CreateTabletRequestPB req;
+    CreateTabletResponsePB resp;
+    RpcController rpc;
+    rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_timeout_ms));
+    req.set_dest_uuid(replica->uuid);
+    req.set_table_id(tablet_id);
+    req.set_tablet_id(tablet_id);
+    req.set_table_name(Substitute("raft_loadgen_$0", tablet_id));
+    RETURN_NOT_OK(SchemaToPB(schema, req.mutable_schema()));
+    *req.mutable_config() = config;
+    RETURN_NOT_OK_PREPEND(replica->admin_proxy->CreateTablet(req, &resp, &rpc),
+                          Substitute("CreateTablet() to $0 failed", replica->address));
+    if (resp.has_error()) {
+      return StatusFromPB(resp.error().status()).CloneAndPrepend(
+          Substitute("unable to create a replica on $0", replica->address));
+    }
+  }
+  return Status::OK();
+}
+
+// Deletes the replicas of the tablet 'tablet_id' from 'replicas'.
+Status DeleteRaftLoadTablet(const string& tablet_id,
+                            const vector<RaftLoadReplica*>& replicas) {
+  Status first_error;
+  for (const auto* replica : replicas) {
+    DeleteTabletRequestPB req;
+    DeleteTabletResponsePB resp;
+    RpcController rpc;
+    rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_timeout_ms));
+    req.set_dest_uuid(replica->uuid);
+    req.set_tablet_id(tablet_id);
+    req.set_reason("raft_loadgen finished");
+    req.set_delete_type(tablet::TABLET_DATA_DELETED);
+    Status s = replica->admin_proxy->DeleteTablet(req, &resp, &rpc);
+    if (s.ok() && resp.has_error()) {
+      s = StatusFromPB(resp.error().status());
+    }
+    if (!s.ok() && first_error.ok()) {
+      first_error = s.CloneAndPrepend(
+          Substitute("unable to delete the replica on $0", replica->address));
+    }
+  }
+  return first_error;
+}
+
+Status RunRaftLoadGenerator(const RunnerContext& context) {
+  vector<int> op_sizes;
+  vector<int> concurrencies;
+  vector<int> replication_factors;
+  RETURN_NOT_OK(ParsePositiveIntList("raft_op_sizes_bytes", FLAGS_raft_op_sizes_bytes,
+                                     &op_sizes));
+  RETURN_NOT_OK(ParsePositiveIntList("raft_concurrency", FLAGS_raft_concurrency,
+                                     &concurrencies));
+  RETURN_NOT_OK(ParsePositiveIntList("raft_replication_factors",
+                                     FLAGS_raft_replication_factors,
+                                     &replication_factors));
+
+  const string& master_addresses_str =
+      FindOrDie(context.required_args, kMasterAddressesArg);
+  shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(KuduClientBuilder()
+                .master_server_addrs(strings::Split(master_addresses_str, ","))
+                .Build(&client));
+  vector<KuduTabletServer*> tservers;
+  ElementDeleter deleter(&tservers);
+  RETURN_NOT_OK(client->ListTabletServers(&tservers));
+  const int max_replication_factor =
+      *std::max_element(replication_factors.begin(), replication_factors.end());
+  if (max_replication_factor > static_cast<int>(tservers.size())) {
+    return Status::InvalidArgument(
+        Substitute("replication factor $0 is greater than the number of tablet servers ($1)",
+                   max_replication_factor, tservers.size()));
+  }
+
+  vector<unique_ptr<RaftLoadReplica>> replicas;
+  for (const auto* ts : tservers) {
+    unique_ptr<RaftLoadReplica> replica(new RaftLoadReplica);
+    replica->uuid = ts->uuid();
+    replica->address = Substitute("$0:$1", ts->hostname(), ts->port());
+    RETURN_NOT_OK(BuildProxy(replica->address, tserver::TabletServer::kDefaultPort,
+                             &replica->consensus_proxy));
+    RETURN_NOT_OK(BuildProxy(replica->address, tserver::TabletServer::kDefaultPort,
+                             &replica->admin_proxy));
+    replicas.emplace_back(std::move(replica));
+  }
+
+  ObjectIdGenerator oid_generator;
+  const string leader_uuid = oid_generator.Next();
+  cout << "op_size_bytes,concurrency,replication_factor,ops_per_sec,"
+       << "mean_latency_us,p50_latency_us,p95_latency_us,p99_latency_us,"
+       << "p999_latency_us,max_latency_us" << endl;
+  for (int replication_factor : replication_factors) {
+    vector<RaftLoadReplica*> point_replicas;
+    for (int i = 0; i < replication_factor; i++) {
+      point_replicas.push_back(replicas[i].get());
+    }
+    for (int op_size : op_sizes) {
+      for (int concurrency : concurrencies) {
+        // Each combination gets a fresh tablet, so the ops of one don't
+        // weigh on the WALs of the next.
+        const string tablet_id = oid_generator.Next();
+        Status s = CreateRaftLoadTablet(tablet_id, leader_uuid, point_replicas);
+        // Latencies up to 60 seconds, in microseconds.
+        HdrHistogram latency_hist(60 * 1000 * 1000, 2);
+        double ops_per_sec = 0;
+        if (s.ok()) {
+          RaftLoadGenerator gen(tablet_id, leader_uuid, point_replicas,
+                                op_size, concurrency);
+          s = gen.Run(MonoDelta::FromSeconds(FLAGS_raft_run_seconds),
+                      &latency_hist, &ops_per_sec);
+        }
+        Status delete_status = DeleteRaftLoadTablet(tablet_id, point_replicas);
+        RETURN_NOT_OK(s);
+        RETURN_NOT_OK(delete_status);
+        cout << op_size << "," << concurrency << "," << replication_factor << ","
+             << ops_per_sec << "," << latency_hist.MeanValue() << ","
+             << latency_hist.ValueAtPercentile(50) << ","
+             << latency_hist.ValueAtPercentile(95) << ","
+             << latency_hist.ValueAtPercentile(99) << ","
+             << latency_hist.ValueAtPercentile(99.9) << ","
+             << latency_hist.MaxValue() << endl;
+      }
+    }
+  }
+  return Status::OK();
+}
+
 } // anonymous namespace
 
 unique_ptr<Mode> BuildPerfMode() {
@@ -792,9 +1325,54 @@ unique_ptr<Mode> BuildPerfMode() {
       .AddOptionalParameter("use_random")
       .Build();
 
+  unique_ptr<Action> compaction_sim =
+      ActionBuilder("compaction_sim", &SimulateCompactionPolicies)
+      .Description("Simulate compaction policies over a dumped rowset layout")
+      .ExtraDescription(
+          "Replay flushes and compactions over a tablet's rowset layout, as "
+          "dumped according to --compaction_policy_dump_rowsets_pattern, and "
+          "report the write amplification and average rowset height reached "
+          "by the budgeted and hybrid compaction policies. Flushed rowsets "
+          "span the layout's whole key range. No data is read or written.")
+      .AddRequiredParameter({ "rowsets_dump",
+          "Path to a rowset dump: one line per rowset holding the tab-separated "
+          "size in MiB, C-escaped min key, and C-escaped max key" })
+      .AddOptionalParameter("compaction_hot_rowset_read_fraction")
+      .AddOptionalParameter("compaction_tiered_max_size_ratio")
+      .AddOptionalParameter("compaction_write_amp_budget")
+      .AddOptionalParameter("sim_compactions_per_round")
+      .AddOptionalParameter("sim_flush_size_mb")
+      .AddOptionalParameter("sim_flushes_per_round")
+      .AddOptionalParameter("sim_rounds")
+      .AddOptionalParameter("tablet_compaction_budget_mb")
+      .Build();
+
+  unique_ptr<Action> raft_loadgen =
+      ActionBuilder("raft_loadgen", &RunRaftLoadGenerator)
+      .Description("Measure the throughput and latency of Raft replication")
+      .ExtraDescription(
+          "Replicate no-op operations to dedicated tablet replicas on the "
+          "cluster's tablet servers as fast as possible, bypassing the client "
+          "and tablet layers: the tool itself acts as the replicas' leader, "
+          "and an operation is committed once a majority of the replicas have "
+          "durably appended it to their WALs. Each combination of operation "
+          "size, concurrency and replication factor is run against a new "
+          "tablet, which is deleted afterwards, and reported as a line of CSV "
+          "with the throughput in operations per second and the commit "
+          "latency percentiles in microseconds.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddOptionalParameter("raft_concurrency")
+      .AddOptionalParameter("raft_op_sizes_bytes")
+      .AddOptionalParameter("raft_replication_factors")
+      .AddOptionalParameter("raft_run_seconds")
+      .AddOptionalParameter("timeout_ms")
+      .Build();
+
   return ModeBuilder("perf")
       .Description("Measure the performance of a Kudu cluster")
+      .AddAction(std::move(compaction_sim))
       .AddAction(std::move(insert))
+      .AddAction(std::move(raft_loadgen))
       .Build();
 }
 
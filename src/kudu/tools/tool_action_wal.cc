@@ -17,28 +17,71 @@
 
 #include "kudu/tools/tool_action.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include <gflags/gflags.h>
+#include <gflags/gflags_declare.h>
+
+#include "kudu/clock/hybrid_clock.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/log.pb.h"
+#include "kudu/consensus/log_index.h"
+#include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log_util.h"
+#include "kudu/consensus/opid.pb.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/tools/tool_action_common.h"
+#include "kudu/util/compression/compression.pb.h"
 #include "kudu/util/env.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
 
+DEFINE_bool(histograms, false,
+            "Whether to print the percentiles of the sizes of the entries and "
+            "of the gaps between the timestamps of consecutive operations");
+
+DECLARE_int32(log_read_decode_threads);
+
 namespace kudu {
 namespace tools {
 
+using clock::HybridClock;
+using consensus::OperationType_Name;
+using consensus::ReplicateMsg;
+using log::LogEntryPB;
+using log::LogEntryReader;
+using log::LogEntryTypePB_Name;
+using log::LogIndex;
+using log::LogReader;
 using log::ReadableLogSegment;
+using log::SegmentSequence;
+using std::cout;
+using std::map;
+using std::shared_ptr;
 using std::string;
+using std::to_string;
 using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
 
 namespace {
 
 const char* const kPathArg = "path";
+const char* const kWalDirArg = "wal_dir";
 
 Status Dump(const RunnerContext& context) {
   const string& segment_path = FindOrDie(context.required_args, kPathArg);
@@ -49,6 +92,158 @@ Status Dump(const RunnerContext& context) {
   return Status::OK();
 }
 
+// The count and total size of the entries of one type.
+struct EntryTypeStats {
+  int64_t count = 0;
+  int64_t bytes = 0;
+  int64_t max_bytes = 0;
+};
+
+// The operations replicated in one term.
+struct TermStats {
+  int64_t term;
+  int64_t first_index;
+  int64_t last_index;
+  int64_t count;
+};
+
+string FormatRatio(int64_t numerator, int64_t denominator) {
+  if (denominator == 0) {
+    return "-";
+  }
+  return Substitute("$0", static_cast<double>(numerator) / denominator);
+}
+
+Status Stats(const RunnerContext& context) {
+  const string& wal_dir = FindOrDie(context.required_args, kWalDirArg);
+
+  // Parsing the entries, rather than printing them, is what takes the time,
+  // so unless asked otherwise, decode the batches read ahead on every core.
+  if (FLAGS_log_read_decode_threads == 0) {
+    FLAGS_log_read_decode_threads = base::NumCPUs();
+  }
+
+  shared_ptr<LogReader> reader;
+  RETURN_NOT_OK(LogReader::Open(Env::Default(),
+                                wal_dir,
+                                scoped_refptr<LogIndex>(),
+                                BaseName(wal_dir),
+                                scoped_refptr<MetricEntity>(),
+                                &reader));
+  SegmentSequence segments;
+  RETURN_NOT_OK(reader->GetSegmentsSnapshot(&segments));
+
+  // Sizes up to 1GiB and gaps up to a day, with two significant digits.
+  const int64_t kMaxEntryBytes = 1LL << 30;
+  const int64_t kMaxGapMicros = 24LL * 60 * 60 * 1000 * 1000;
+  HdrHistogram entry_bytes_hist(kMaxEntryBytes, 2);
+  HdrHistogram gap_micros_hist(kMaxGapMicros, 2);
+
+  map<string, EntryTypeStats> stats_by_type;
+  vector<TermStats> terms;
+  int64_t prev_physical_micros = -1;
+
+  DataTable segments_table({ "segment", "compression", "file bytes", "entry bytes",
+                             "compression ratio", "first index", "last index" });
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    int64_t segment_entry_bytes = 0;
+    int64_t first_index = -1;
+    int64_t last_index = -1;
+
+    LogEntryReader entry_reader(segment.get());
+    while (true) {
+      unique_ptr<LogEntryPB> entry;
+      Status s = entry_reader.ReadNextEntry(&entry);
+      if (s.IsEndOfFile()) {
+        break;
+      }
+      RETURN_NOT_OK_PREPEND(s, Substitute("could not read $0", segment->path()));
+
+      int64_t bytes = entry->ByteSize();
+      segment_entry_bytes += bytes;
+      entry_bytes_hist.Increment(std::min(bytes, kMaxEntryBytes));
+
+      string type;
+      if (entry->has_replicate()) {
+        const ReplicateMsg& replicate = entry->replicate();
+        type = OperationType_Name(replicate.op_type());
+
+        int64_t term = replicate.id().term();
+        int64_t index = replicate.id().index();
+        if (first_index == -1) {
+          first_index = index;
+        }
+        last_index = index;
+        if (terms.empty() || terms.back().term != term) {
+          terms.push_back({ term, index, index, 0 });
+        }
+        terms.back().last_index = index;
+        terms.back().count++;
+
+        // Ops replicated again after a leader change may go back in time.
+        int64_t physical_micros = HybridClock::GetPhysicalValueMicros(
+            Timestamp(replicate.timestamp()));
+        if (prev_physical_micros >= 0 && physical_micros >= prev_physical_micros) {
+          gap_micros_hist.Increment(std::min(physical_micros - prev_physical_micros,
+                                             kMaxGapMicros));
+        }
+        prev_physical_micros = physical_micros;
+      } else {
+        type = LogEntryTypePB_Name(entry->type());
+      }
+      EntryTypeStats& type_stats = stats_by_type[type];
+      type_stats.count++;
+      type_stats.bytes += bytes;
+      type_stats.max_bytes = std::max(type_stats.max_bytes, bytes);
+    }
+
+    segments_table.AddRow({ to_string(segment->header().sequence_number()),
+                            CompressionType_Name(segment->header().compression_codec()),
+                            to_string(segment->file_size()),
+                            to_string(segment_entry_bytes),
+                            FormatRatio(segment_entry_bytes, segment->file_size()),
+                            to_string(first_index),
+                            to_string(last_index) });
+  }
+
+  DataTable types_table({ "type", "count", "bytes", "mean bytes", "max bytes" });
+  for (const auto& e : stats_by_type) {
+    const EntryTypeStats& type_stats = e.second;
+    types_table.AddRow({ e.first,
+                         to_string(type_stats.count),
+                         to_string(type_stats.bytes),
+                         to_string(type_stats.bytes / type_stats.count),
+                         to_string(type_stats.max_bytes) });
+  }
+
+  DataTable terms_table({ "term", "first index", "last index", "ops" });
+  for (const TermStats& term : terms) {
+    terms_table.AddRow({ to_string(term.term),
+                         to_string(term.first_index),
+                         to_string(term.last_index),
+                         to_string(term.count) });
+  }
+
+  cout << "Segments:" << std::endl;
+  RETURN_NOT_OK(segments_table.PrintTo(cout));
+  cout << std::endl << "Entries:" << std::endl;
+  RETURN_NOT_OK(types_table.PrintTo(cout));
+  cout << std::endl << "Terms:" << std::endl;
+  RETURN_NOT_OK(terms_table.PrintTo(cout));
+
+  if (FLAGS_histograms) {
+    DataTable hist_table({ "percentile", "entry bytes", "timestamp gap (us)" });
+    for (double percentile : { 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 100.0 }) {
+      hist_table.AddRow({ Substitute("$0", percentile),
+                          to_string(entry_bytes_hist.ValueAtPercentile(percentile)),
+                          to_string(gap_micros_hist.ValueAtPercentile(percentile)) });
+    }
+    cout << std::endl << "Histograms:" << std::endl;
+    RETURN_NOT_OK(hist_table.PrintTo(cout));
+  }
+  return Status::OK();
+}
+
 } // anonymous namespace
 
 unique_ptr<Mode> BuildWalMode() {
@@ -61,9 +256,24 @@ unique_ptr<Mode> BuildWalMode() {
       .AddOptionalParameter("truncate_data")
       .Build();
 
+  unique_ptr<Action> stats =
+      ActionBuilder("stats", &Stats)
+      .Description("Summarize the entries of a tablet's WAL (write-ahead log)")
+      .ExtraDescription("Reads every segment in the given WAL directory, without "
+                        "printing the entries, and prints the number and size of "
+                        "the entries of each type, the compression ratio of each "
+                        "segment, and the range of operations replicated in each "
+                        "term. Batches are decoded in parallel, on as many threads "
+                        "as there are cores unless --log_read_decode_threads is set.")
+      .AddRequiredParameter({ kWalDirArg, "path to a tablet's WAL directory" })
+      .AddOptionalParameter("format")
+      .AddOptionalParameter("histograms")
+      .Build();
+
   return ModeBuilder("wal")
       .Description("Operate on WAL (write-ahead log) files")
       .AddAction(std::move(dump))
+      .AddAction(std::move(stats))
       .Build();
 }
 
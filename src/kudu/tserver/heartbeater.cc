@@ -17,6 +17,7 @@
 
 #include "kudu/tserver/heartbeater.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <memory>
@@ -34,7 +35,9 @@
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/replica_management.pb.h"
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
@@ -55,6 +58,7 @@
 #include "kudu/tserver/tablet_server_options.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
@@ -100,13 +104,26 @@ DEFINE_uint32(heartbeat_inject_required_feature_flag, 0,
 TAG_FLAG(heartbeat_inject_required_feature_flag, runtime);
 TAG_FLAG(heartbeat_inject_required_feature_flag, unsafe);
 
+DEFINE_bool(heartbeat_send_consensus_state_digests, true,
+            "Whether to report the consensus state of a replica as a compact "
+            "digest when its term, leader and committed config are unchanged "
+            "since the master last acknowledged them, if the master accepts "
+            "such digests. This greatly reduces the size of full tablet "
+            "reports, and the work of the master to process them.");
+TAG_FLAG(heartbeat_send_consensus_state_digests, advanced);
+TAG_FLAG(heartbeat_send_consensus_state_digests, runtime);
+
 DECLARE_bool(raft_prepare_replacement_before_eviction);
 
+using kudu::consensus::ConsensusStatePB;
 using kudu::consensus::ReplicaManagementInfoPB;
+using kudu::master::ConsensusStateDigestPB;
 using kudu::master::MasterErrorPB;
 using kudu::master::MasterFeatures;
 using kudu::master::MasterServiceProxy;
+using kudu::master::ReportedTabletPB;
 using kudu::master::TabletReportPB;
+using kudu::master::TabletReportUpdatesPB;
 using kudu::pb_util::SecureDebugString;
 using kudu::rpc::ErrorStatusPB;
 using kudu::rpc::RpcController;
@@ -140,6 +157,25 @@ Status MasterServiceProxyForHostPort(const HostPort& hostport,
   return Status::OK();
 }
 
+ConsensusStateDigestPB DigestConsensusState(const ConsensusStatePB& cstate) {
+  ConsensusStateDigestPB digest;
+  digest.set_current_term(cstate.current_term());
+  if (!cstate.leader_uuid().empty()) {
+    digest.set_leader_uuid(cstate.leader_uuid());
+  }
+  if (cstate.committed_config().has_opid_index()) {
+    digest.set_committed_config_opid_index(cstate.committed_config().opid_index());
+  }
+  return digest;
+}
+
+bool DigestsEqual(const ConsensusStateDigestPB& a, const ConsensusStateDigestPB& b) {
+  return a.current_term() == b.current_term() &&
+      a.leader_uuid() == b.leader_uuid() &&
+      a.has_committed_config_opid_index() == b.has_committed_config_opid_index() &&
+      a.committed_config_opid_index() == b.committed_config_opid_index();
+}
+
 } // anonymous namespace
 
 // Most of the actual logic of the heartbeater is inside this inner class,
@@ -162,6 +198,14 @@ class Heartbeater::Thread {
   // tablets which have not changed since the acknowledged report.
   void MarkTabletReportAcknowledged(const TabletReportPB& report);
 
+  // Re-reports the tablets for which the master asked for the full
+  // consensus state in 'updates'.
+  void HandleTabletReportUpdates(const master::TabletReportUpdatesPB& updates);
+
+  void set_master_accepts_digests(bool accepts) {
+    master_accepts_digests_ = accepts;
+  }
+
  private:
   void RunThread();
   Status ConnectToMaster();
@@ -170,8 +214,13 @@ class Heartbeater::Thread {
   Status DoHeartbeat(MasterErrorPB* error, ErrorStatusPB* error_status);
   Status SetupRegistration(ServerRegistrationPB* reg);
   void SetupCommonField(master::TSToMasterCommonPB* common);
+  void SetupLoadStats(master::TSLoadStatsPB* stats);
   bool IsCurrentThread() const;
 
+  // Replaces the consensus states in 'report' which are unchanged since they
+  // were last acknowledged with their digests, if the master accepts them.
+  void DigestUnchangedConsensusStates(TabletReportPB* report);
+
   // The host and port of the master that this thread will heartbeat to.
   //
   // We keep the HostPort around rather than a Sockaddr because the
@@ -195,6 +244,11 @@ class Heartbeater::Thread {
   // This is tracked so as to back-off heartbeating.
   int consecutive_failed_heartbeats_;
 
+  // The number of bytes appended to the WALs as of the last heartbeat, and
+  // when that was, from which the WAL append rate is computed.
+  int64_t last_wal_bytes_logged_;
+  MonoTime last_load_stats_time_;
+
   // Each tablet report is assigned a sequence number, so that subsequent
   // tablet reports only need to re-report those tablets which have
   // changed since the last report. Each tablet tracks the sequence
@@ -209,11 +263,18 @@ class Heartbeater::Thread {
   // reported to the master, an entry is added to this map.
   DirtyMap dirty_tablets_;
 
-  // Lock protecting 'dirty_tablets_'.
+  // Digests of the consensus states of tablets, as of the latest
+  // acknowledged report which included them.
+  std::unordered_map<std::string, ConsensusStateDigestPB> acked_digests_;
+
+  // Lock protecting 'dirty_tablets_' and 'acked_digests_'.
   //
   // Should not be held at the same time as mutex_.
   mutable simple_spinlock dirty_tablets_lock_;
 
+  // Whether the master heartbeated to last accepted consensus state digests.
+  std::atomic<bool> master_accepts_digests_;
+
   // Next tablet report seqno.
   std::atomic_int next_report_seq_;
 
@@ -317,6 +378,21 @@ void Heartbeater::MarkTabletReportsAcknowledgedForTests(
   }
 }
 
+void Heartbeater::HandleTabletReportUpdatesForTests(
+    const vector<TabletReportUpdatesPB>& updates) {
+  CHECK_EQ(updates.size(), threads_.size());
+
+  for (int i = 0; i < updates.size(); i++) {
+    threads_[i]->HandleTabletReportUpdates(updates[i]);
+  }
+}
+
+void Heartbeater::SetMasterAcceptsConsensusStateDigestsForTests(bool accepts) {
+  for (const auto& thread : threads_) {
+    thread->set_master_accepts_digests(accepts);
+  }
+}
+
 ////////////////////////////////////////////////////////////
 // Heartbeater::Thread
 ////////////////////////////////////////////////////////////
@@ -325,7 +401,9 @@ Heartbeater::Thread::Thread(HostPort master_address, TabletServer* server)
   : master_address_(std::move(master_address)),
     server_(server),
     consecutive_failed_heartbeats_(0),
+    last_wal_bytes_logged_(0),
     next_report_seq_(0),
+    master_accepts_digests_(false),
     cond_(&mutex_),
     should_run_(false),
     heartbeat_asap_(true),
@@ -352,6 +430,35 @@ void Heartbeater::Thread::SetupCommonField(master::TSToMasterCommonPB* common) {
   common->mutable_ts_instance()->CopyFrom(server_->instance_pb());
 }
 
+void Heartbeater::Thread::SetupLoadStats(master::TSLoadStatsPB* stats) {
+  MonoTime now = MonoTime::Now();
+  int64_t wal_bytes = server_->tablet_manager()->GetWalBytesLogged();
+  if (last_load_stats_time_.Initialized()) {
+    // Tablets which were deleted since the last heartbeat take their bytes
+    // with them, so the total may go down.
+    double elapsed_secs = (now - last_load_stats_time_).ToSeconds();
+    if (elapsed_secs > 0) {
+      stats->set_wal_bytes_per_sec(
+          std::max<int64_t>(0, wal_bytes - last_wal_bytes_logged_) / elapsed_secs);
+    }
+  }
+  last_wal_bytes_logged_ = wal_bytes;
+  last_load_stats_time_ = now;
+
+  FsManager* fs_manager = server_->fs_manager();
+  for (const auto& dir : fs_manager->GetDataRootDirs()) {
+    SpaceInfo space_info;
+    Status s = fs_manager->env()->GetSpaceInfo(dir, &space_info);
+    if (!s.ok() || space_info.capacity_bytes <= 0) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << Substitute(
+          "Unable to get the space used in data directory $0: $1", dir, s.ToString());
+      continue;
+    }
+    stats->add_data_dir_utilization(
+        1.0 - static_cast<double>(space_info.free_bytes) / space_info.capacity_bytes);
+  }
+}
+
 Status Heartbeater::Thread::SetupRegistration(ServerRegistrationPB* reg) {
   reg->Clear();
 
@@ -482,6 +589,7 @@ Status Heartbeater::Thread::DoHeartbeat(MasterErrorPB* error,
     GenerateIncrementalTabletReport(req.mutable_tablet_report());
   }
   req.set_num_live_tablets(server_->tablet_manager()->GetNumLiveTablets());
+  SetupLoadStats(req.mutable_load_stats());
 
   VLOG(2) << "Sending heartbeat:\n" << SecureDebugString(req);
   master::TSHeartbeatResponsePB resp;
@@ -509,6 +617,7 @@ Status Heartbeater::Thread::DoHeartbeat(MasterErrorPB* error,
   }
 
   last_hb_response_.Swap(&resp);
+  master_accepts_digests_ = last_hb_response_.accepts_consensus_state_digests();
 
   for (const auto& ca_cert_der : last_hb_response_.ca_cert_der()) {
     security::Cert ca_cert;
@@ -541,6 +650,7 @@ Status Heartbeater::Thread::DoHeartbeat(MasterErrorPB* error,
   }
 
   MarkTabletReportAcknowledged(req.tablet_report());
+  HandleTabletReportUpdates(last_hb_response_.tablet_report());
   return Status::OK();
 }
 
@@ -637,6 +747,69 @@ void Heartbeater::Thread::MarkTabletReportAcknowledged(const TabletReportPB& rep
       ++it;
     }
   }
+
+  // Record the consensus states the master now knows of. A full report
+  // includes every tablet, so anything it doesn't include is gone.
+  if (!report.is_incremental()) {
+    acked_digests_.clear();
+  }
+  for (const auto& id : report.removed_tablet_ids()) {
+    acked_digests_.erase(id);
+  }
+  for (const ReportedTabletPB& reported : report.updated_tablets()) {
+    if (reported.has_consensus_state()) {
+      acked_digests_[reported.tablet_id()] = DigestConsensusState(reported.consensus_state());
+    } else if (reported.has_consensus_state_digest()) {
+      acked_digests_[reported.tablet_id()] = reported.consensus_state_digest();
+    } else {
+      acked_digests_.erase(reported.tablet_id());
+    }
+  }
+}
+
+void Heartbeater::Thread::HandleTabletReportUpdates(const TabletReportUpdatesPB& updates) {
+  bool any_needed = false;
+  for (const auto& update : updates.tablets()) {
+    if (!update.needs_consensus_state()) {
+      continue;
+    }
+    {
+      std::lock_guard<simple_spinlock> l(dirty_tablets_lock_);
+      acked_digests_.erase(update.tablet_id());
+    }
+    MarkTabletDirty(update.tablet_id(), "master needs the full consensus state");
+    any_needed = true;
+  }
+  if (any_needed) {
+    TriggerASAP();
+  }
+}
+
+void Heartbeater::Thread::DigestUnchangedConsensusStates(TabletReportPB* report) {
+  if (!FLAGS_heartbeat_send_consensus_state_digests || !master_accepts_digests_) {
+    return;
+  }
+  const string& local_uuid = server_->instance_pb().permanent_uuid();
+  std::lock_guard<simple_spinlock> l(dirty_tablets_lock_);
+  for (ReportedTabletPB& reported : *report->mutable_updated_tablets()) {
+    if (!reported.has_consensus_state()) {
+      continue;
+    }
+    const ConsensusStatePB& cstate = reported.consensus_state();
+    // The master needs a pending config, and, if it's going to add or evict
+    // replicas according to their health, the health reports of the leader.
+    if (cstate.has_pending_config() ||
+        (FLAGS_raft_prepare_replacement_before_eviction &&
+         cstate.leader_uuid() == local_uuid)) {
+      continue;
+    }
+    const ConsensusStateDigestPB* acked = FindOrNull(acked_digests_, reported.tablet_id());
+    ConsensusStateDigestPB digest = DigestConsensusState(cstate);
+    if (acked && DigestsEqual(*acked, digest)) {
+      reported.clear_consensus_state();
+      *reported.mutable_consensus_state_digest() = std::move(digest);
+    }
+  }
 }
 
 Status Heartbeater::Thread::Start() {
@@ -704,6 +877,7 @@ void Heartbeater::Thread::GenerateIncrementalTabletReport(TabletReportPB* report
   }
   server_->tablet_manager()->PopulateIncrementalTabletReport(
       report, dirty_tablet_ids);
+  DigestUnchangedConsensusStates(report);
 }
 
 void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report) {
@@ -711,6 +885,7 @@ void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report) {
   report->set_sequence_number(next_report_seq_.fetch_add(1));
   report->set_is_incremental(false);
   server_->tablet_manager()->PopulateFullTabletReport(report);
+  DigestUnchangedConsensusStates(report);
 }
 
 } // namespace tserver
@@ -28,6 +28,7 @@ namespace kudu {
 
 namespace master {
 class TabletReportPB;
+class TabletReportUpdatesPB;
 }
 
 namespace tserver {
@@ -66,6 +67,12 @@ class Heartbeater {
   std::vector<master::TabletReportPB> GenerateFullTabletReportsForTests();
   void MarkTabletReportsAcknowledgedForTests(
       const std::vector<master::TabletReportPB>& reports);
+  void HandleTabletReportUpdatesForTests(
+      const std::vector<master::TabletReportUpdatesPB>& updates);
+
+  // Makes the reports use consensus state digests as though the masters
+  // accepted them.
+  void SetMasterAcceptsConsensusStateDigestsForTests(bool accepts);
 
  private:
   class Thread;
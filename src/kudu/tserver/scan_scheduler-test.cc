@@ -0,0 +1,126 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/tserver/scan_scheduler.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tserver {
+
+class ScanSchedulerTest : public KuduTest {
+ protected:
+  // Runs 'kNumTasks' tasks of each tenant of 'tenants' on a single thread,
+  // each of which uses the same amount of CPU time, and returns the tenants
+  // in the order their tasks ran.
+  void RunTasks(const vector<string>& tenants, const string& weights,
+                vector<string>* order) {
+    const int kNumTasks = 8;
+    ScanScheduler scheduler;
+    ASSERT_OK(scheduler.Start(1, weights));
+
+    // Hold the thread until all of the tasks are queued, so that they're
+    // ordered by the scheduler rather than by their submission.
+    CountDownLatch latch(1);
+    ASSERT_OK(scheduler.Submit("blocker", [&]() { latch.Wait(); }));
+
+    simple_spinlock lock;
+    for (int i = 0; i < kNumTasks; i++) {
+      for (const auto& tenant : tenants) {
+        ASSERT_OK(scheduler.Submit(tenant, [&, tenant]() {
+            BurnCpu();
+            std::lock_guard<simple_spinlock> l(lock);
+            order->push_back(tenant);
+          }));
+      }
+    }
+    latch.CountDown();
+    scheduler.Shutdown();
+    ASSERT_EQ(kNumTasks * tenants.size(), order->size());
+    for (const auto& tenant : tenants) {
+      ASSERT_GT(scheduler.TenantCpuTime(tenant).ToMilliseconds(), 0);
+    }
+  }
+
+  static void BurnCpu() {
+    Stopwatch sw(Stopwatch::THIS_THREAD);
+    sw.start();
+    while (sw.elapsed().user + sw.elapsed().system < 10 * 1000 * 1000) {
+    }
+  }
+};
+
+// Tenants of equal weight share the thread equally, whichever submitted
+// its tasks first.
+TEST_F(ScanSchedulerTest, TestEqualShares) {
+  vector<string> order;
+  NO_FATALS(RunTasks({ "a", "b" }, "", &order));
+  int num_a = std::count(order.begin(), order.begin() + 6, "a");
+  ASSERT_GE(num_a, 2);
+  ASSERT_LE(num_a, 4);
+}
+
+// Tenants share the thread in proportion to their weights.
+TEST_F(ScanSchedulerTest, TestWeightedShares) {
+  vector<string> order;
+  NO_FATALS(RunTasks({ "a", "b" }, "a:3", &order));
+  int num_a = std::count(order.begin(), order.begin() + 8, "a");
+  ASSERT_GE(num_a, 5);
+  ASSERT_LE(num_a, 7);
+}
+
+TEST_F(ScanSchedulerTest, TestInvalidWeights) {
+  for (const char* weights : { "a", "a:", ":1", "a:0", "a:-1", "a:x" }) {
+    ScanScheduler scheduler;
+    Status s = scheduler.Start(1, weights);
+    ASSERT_TRUE(s.IsInvalidArgument()) << weights << ": " << s.ToString();
+  }
+}
+
+TEST_F(ScanSchedulerTest, TestShutdown) {
+  ScanScheduler scheduler;
+  ASSERT_TRUE(scheduler.Submit("a", []() {}).IsServiceUnavailable());
+  ASSERT_OK(scheduler.Start(2, ""));
+  ASSERT_TRUE(scheduler.running());
+
+  // Queued tasks run before the scheduler shuts down.
+  CountDownLatch latch(10);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(scheduler.Submit("a", [&]() { latch.CountDown(); }));
+  }
+  scheduler.Shutdown();
+  ASSERT_EQ(0, latch.count());
+  ASSERT_FALSE(scheduler.running());
+  ASSERT_TRUE(scheduler.Submit("a", []() {}).IsServiceUnavailable());
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,171 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+ScanScheduler::ScanScheduler()
+    : cond_(&lock_),
+      running_(false),
+      virtual_time_(0) {
+}
+
+ScanScheduler::~ScanScheduler() {
+  Shutdown();
+}
+
+Status ScanScheduler::Start(int num_threads, const string& tenant_weights) {
+  CHECK_GT(num_threads, 0);
+  for (const auto& entry : strings::Split(tenant_weights, ",", strings::SkipEmpty())) {
+    vector<string> parts = strings::Split(entry, ":");
+    double weight;
+    if (parts.size() != 2 || parts[0].empty() ||
+        !safe_strtod(parts[1], &weight) || weight <= 0) {
+      return Status::InvalidArgument(
+          Substitute("invalid tenant weight '$0': expected <tenant>:<positive weight>",
+                     entry.ToString()));
+    }
+    weights_[parts[0]] = weight;
+  }
+
+  {
+    MutexLock l(lock_);
+    CHECK(!running_);
+    running_ = true;
+  }
+  for (int i = 0; i < num_threads; i++) {
+    scoped_refptr<Thread> thread;
+    Status s = Thread::Create("scan", Substitute("scan-worker-$0", i),
+                              &ScanScheduler::RunThread, this, &thread);
+    if (!s.ok()) {
+      Shutdown();
+      return s;
+    }
+    threads_.emplace_back(std::move(thread));
+  }
+  return Status::OK();
+}
+
+void ScanScheduler::Shutdown() {
+  {
+    MutexLock l(lock_);
+    running_ = false;
+    cond_.Broadcast();
+  }
+  for (const auto& thread : threads_) {
+    thread->Join();
+  }
+  threads_.clear();
+}
+
+bool ScanScheduler::running() const {
+  MutexLock l(lock_);
+  return running_;
+}
+
+Status ScanScheduler::Submit(const string& tenant, Task task) {
+  MutexLock l(lock_);
+  if (PREDICT_FALSE(!running_)) {
+    return Status::ServiceUnavailable("scan scheduler is not running");
+  }
+  auto* t = &LookupOrInsert(&tenants_, tenant, Tenant());
+  if (t->tasks.empty()) {
+    // A tenant which was idle resumes with the busy tenants, and doesn't get
+    // to catch up on the time it was idle.
+    const double* weight = FindOrNull(weights_, tenant);
+    t->weight = weight ? *weight : 1;
+    t->virtual_time = std::max(t->virtual_time, virtual_time_);
+  }
+  t->tasks.push_back(std::move(task));
+  cond_.Signal();
+  return Status::OK();
+}
+
+MonoDelta ScanScheduler::TenantCpuTime(const string& tenant) const {
+  MutexLock l(lock_);
+  const Tenant* t = FindOrNull(tenants_, tenant);
+  return MonoDelta::FromNanoseconds(t ? t->cpu_time_ns : 0);
+}
+
+ScanScheduler::Tenant* ScanScheduler::PickTenantUnlocked() {
+  lock_.AssertAcquired();
+  Tenant* next = nullptr;
+  for (auto& e : tenants_) {
+    Tenant* t = &e.second;
+    if (!t->tasks.empty() && (!next || t->virtual_time < next->virtual_time)) {
+      next = t;
+    }
+  }
+  return next;
+}
+
+void ScanScheduler::RunThread() {
+  MutexLock l(lock_);
+  while (true) {
+    Tenant* tenant = PickTenantUnlocked();
+    if (!tenant) {
+      if (!running_) {
+        return;
+      }
+      cond_.Wait();
+      continue;
+    }
+    Task task = std::move(tenant->tasks.front());
+    tenant->tasks.pop_front();
+    virtual_time_ = std::max(virtual_time_, tenant->virtual_time);
+    const double weight = tenant->weight;
+    const int64_t estimated_us = tenant->last_cpu_time_us;
+    tenant->virtual_time += estimated_us / weight;
+
+    Stopwatch sw(Stopwatch::THIS_THREAD);
+    l.Unlock();
+    sw.start();
+    task();
+    sw.stop();
+    // Destroy the task, and whatever it holds, outside of the lock.
+    task = nullptr;
+    l.Lock();
+
+    // Tenants are never removed, so 'tenant' is still valid.
+    CpuTimes elapsed = sw.elapsed();
+    int64_t cpu_time_ns = elapsed.user + elapsed.system;
+    tenant->cpu_time_ns += cpu_time_ns;
+    tenant->last_cpu_time_us = cpu_time_ns / 1000;
+    tenant->virtual_time += (tenant->last_cpu_time_us - estimated_us) / weight;
+  }
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Thread;
+
+namespace tserver {
+
+// Runs scan tasks on a dedicated set of threads, which are shared between
+// tenants (users or tables) with weighted fair queuing: each backlogged
+// tenant gets a share of the threads' CPU time proportional to its weight,
+// however many scans it runs and whatever they cost.
+//
+// Each tenant has a virtual time, which advances by the CPU time used by
+// each of its tasks divided by its weight, and the next task to run is the
+// oldest task of the tenant with the lowest virtual time. A tenant which has
+// been idle starts again at the lowest virtual time of the busy tenants, so
+// idle time isn't banked as credit.
+//
+// Tasks should be short; a scan continuation is bounded by its batch size
+// and time budget, and so is a natural time slice.
+class ScanScheduler {
+ public:
+  typedef std::function<void()> Task;
+
+  ScanScheduler();
+  ~ScanScheduler();
+
+  // Starts 'num_threads' threads. The weights of tenants are parsed from
+  // 'tenant_weights', a comma-separated list of <tenant>:<weight> pairs.
+  // Tenants which aren't listed have a weight of 1.
+  Status Start(int num_threads, const std::string& tenant_weights);
+
+  // Runs the queued tasks, and then stops the threads. Any task submitted
+  // afterwards is rejected.
+  void Shutdown();
+
+  // Returns true if the threads are running and accept tasks.
+  bool running() const;
+
+  // Queues 'task' to run on behalf of 'tenant'.
+  // Returns ServiceUnavailable if the scheduler isn't running.
+  Status Submit(const std::string& tenant, Task task);
+
+  // Returns the total CPU time used by the tasks of 'tenant'.
+  MonoDelta TenantCpuTime(const std::string& tenant) const;
+
+ private:
+  struct Tenant {
+    double weight = 1;
+    double virtual_time = 0;
+
+    // The CPU time of the tenant's last task, which is charged in advance
+    // for the next task, so that while a task runs, the tenant's other
+    // tasks are scheduled as though it had already finished.
+    int64_t last_cpu_time_us = 0;
+
+    // The total CPU time used by the tenant's tasks.
+    int64_t cpu_time_ns = 0;
+
+    std::deque<Task> tasks;
+  };
+
+  void RunThread();
+
+  // Returns the tenant with queued tasks and the lowest virtual time, or
+  // NULL if no tasks are queued.
+  Tenant* PickTenantUnlocked();
+
+  mutable Mutex lock_;
+
+  // Signaled when a task is queued or the scheduler shuts down.
+  ConditionVariable cond_;
+
+  bool running_;
+
+  // The weights of tenants, from the 'tenant_weights' passed to Start().
+  std::unordered_map<std::string, double> weights_;
+
+  // The tenants which have submitted tasks.
+  std::unordered_map<std::string, Tenant> tenants_;
+
+  // The virtual time of the last task to start, which is the lowest busy
+  // virtual time.
+  double virtual_time_;
+
+  std::vector<scoped_refptr<Thread>> threads_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanScheduler);
+};
+
+} // namespace tserver
+} // namespace kudu
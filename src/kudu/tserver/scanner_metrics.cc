@@ -30,6 +30,12 @@ METRIC_DEFINE_histogram(server, scanner_duration,
                         "Histogram of the duration of active scanners on this server",
                         60000000LU, 2);
 
+METRIC_DEFINE_counter(server, scanner_cpu_time_us,
+                      "Scanner CPU Time",
+                      kudu::MetricUnit::kMicroseconds,
+                      "Total user and system CPU time spent by scanners on this server "
+                      "iterating over tablets");
+
 namespace kudu {
 
 namespace tserver {
@@ -37,7 +43,8 @@ namespace tserver {
 ScannerMetrics::ScannerMetrics(const scoped_refptr<MetricEntity>& metric_entity)
     : scanners_expired(
           METRIC_scanners_expired.Instantiate(metric_entity)),
-      scanner_duration(METRIC_scanner_duration.Instantiate(metric_entity)) {
+      scanner_duration(METRIC_scanner_duration.Instantiate(metric_entity)),
+      scanner_cpu_time_us(METRIC_scanner_cpu_time_us.Instantiate(metric_entity)) {
 }
 
 void ScannerMetrics::SubmitScannerDuration(const MonoTime& time_started) {
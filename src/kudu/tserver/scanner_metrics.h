@@ -41,6 +41,9 @@ struct ScannerMetrics {
 
   // Keeps track of the duration of scanners.
   scoped_refptr<Histogram> scanner_duration;
+
+  // Keeps track of the CPU time spent scanning.
+  scoped_refptr<Counter> scanner_cpu_time_us;
 };
 
 } // namespace tserver
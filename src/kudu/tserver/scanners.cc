@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <ostream>
 
@@ -44,6 +45,7 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(scanner_ttl_ms, 60000,
              "Number of milliseconds of inactivity allowed for a scanner"
@@ -58,6 +60,17 @@ DEFINE_int32(scan_history_count, 20,
              "scans will be shown on the tablet server's scans dashboard.");
 TAG_FLAG(scan_history_count, experimental);
 
+DEFINE_int32(scanner_prefetch_num_threads, 4,
+             "Number of threads which prefetch the next batches of scanners. "
+             "Only used if --scanner_prefetch_batches is set.");
+TAG_FLAG(scanner_prefetch_num_threads, experimental);
+
+DEFINE_int64(scanner_prefetch_memory_limit_bytes, 256 * 1024 * 1024,
+             "Maximum amount of memory held by prefetched scan batches. Batches "
+             "aren't prefetched while the limit is reached. Only used if "
+             "--scanner_prefetch_batches is set.");
+TAG_FLAG(scanner_prefetch_memory_limit_bytes, experimental);
+
 METRIC_DEFINE_gauge_size(server, active_scanners,
                          "Active Scanners",
                          kudu::MetricUnit::kScanners,
@@ -95,6 +108,7 @@ ScannerManager::ScannerManager(const scoped_refptr<MetricEntity>& metric_entity)
 }
 
 ScannerManager::~ScannerManager() {
+  Shutdown();
   {
     MutexLock l(shutdown_lock_);
     shutdown_ = true;
@@ -113,6 +127,20 @@ Status ScannerManager::StartRemovalThread() {
   return Status::OK();
 }
 
+Status ScannerManager::StartPrefetchPool(const std::shared_ptr<MemTracker>& parent_mem_tracker) {
+  prefetch_mem_tracker_ = MemTracker::CreateTracker(FLAGS_scanner_prefetch_memory_limit_bytes,
+                                                    "scanner-prefetch", parent_mem_tracker);
+  return ThreadPoolBuilder("scan-prefetch")
+      .set_max_threads(FLAGS_scanner_prefetch_num_threads)
+      .Build(&prefetch_pool_);
+}
+
+void ScannerManager::Shutdown() {
+  if (prefetch_pool_) {
+    prefetch_pool_->Shutdown();
+  }
+}
+
 void ScannerManager::RunRemovalThread() {
   while (true) {
     // Loop until we are shutdown.
@@ -314,7 +342,10 @@ Scanner::Scanner(string id, const scoped_refptr<TabletReplica>& tablet_replica,
       metrics_(metrics),
       arena_(256),
       row_format_flags_(row_format_flags),
-      num_rows_returned_(0) {
+      num_rows_returned_(0),
+      cpu_time_(MonoDelta::FromNanoseconds(0)),
+      prefetch_cond_(&prefetch_lock_),
+      prefetching_(false) {
   if (tablet_replica_) {
     auto tablet = tablet_replica->shared_tablet();
     if (tablet && tablet->metrics()) {
@@ -336,6 +367,41 @@ Scanner::~Scanner() {
   }
 }
 
+bool Scanner::StartPrefetch() {
+  MutexLock l(prefetch_lock_);
+  if (prefetching_ || prefetched_batch_) {
+    return false;
+  }
+  prefetching_ = true;
+  return true;
+}
+
+void Scanner::FinishPrefetch(std::unique_ptr<SerializedScanBatch> batch) {
+  MutexLock l(prefetch_lock_);
+  DCHECK(prefetching_);
+  prefetched_batch_ = std::move(batch);
+  prefetching_ = false;
+  prefetch_cond_.Broadcast();
+}
+
+std::unique_ptr<SerializedScanBatch> Scanner::TakePrefetchedBatch() {
+  MutexLock l(prefetch_lock_);
+  while (prefetching_) {
+    prefetch_cond_.Wait();
+  }
+  return std::move(prefetched_batch_);
+}
+
+void Scanner::add_cpu_time(const MonoDelta& cpu_time) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    cpu_time_ = MonoDelta::FromNanoseconds(cpu_time_.ToNanoseconds() + cpu_time.ToNanoseconds());
+  }
+  if (metrics_) {
+    metrics_->scanner_cpu_time_us->IncrementBy(cpu_time.ToMicroseconds());
+  }
+}
+
 void Scanner::UpdateAccessTime() {
   std::lock_guard<simple_spinlock> l(lock_);
   last_access_time_ = MonoTime::Now();
@@ -404,6 +470,7 @@ ScanDescriptor Scanner::descriptor() const {
     std::lock_guard<simple_spinlock> l(lock_);
     descriptor.last_call_seq_id = call_seq_id_;
     descriptor.last_access_time = last_access_time_;
+    descriptor.cpu_time = cpu_time_;
   }
 
   return descriptor;
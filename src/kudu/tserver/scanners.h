@@ -30,6 +30,8 @@
 
 #include "kudu/common/iterator_stats.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -38,20 +40,23 @@
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/auto_release_pool.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/rw_mutex.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
 class RowwiseIterator;
 class Schema;
-class Status;
 class Thread;
+class ThreadPool;
 
 namespace tserver {
 
@@ -79,6 +84,22 @@ class ScannerManager {
   // Starts the expired scanner removal thread.
   Status StartRemovalThread();
 
+  // Starts the pool which prefetches scan batches, tracking the memory of
+  // the prefetched batches under 'parent_mem_tracker'.
+  Status StartPrefetchPool(const std::shared_ptr<MemTracker>& parent_mem_tracker);
+
+  // Waits for the running prefetches to finish and shuts down their pool.
+  void Shutdown();
+
+  // Returns the pool on which scan batches are prefetched, or NULL if it
+  // hasn't been started.
+  ThreadPool* prefetch_pool() { return prefetch_pool_.get(); }
+
+  // Returns the tracker of the memory held by prefetched batches.
+  const std::shared_ptr<MemTracker>& prefetch_mem_tracker() const {
+    return prefetch_mem_tracker_;
+  }
+
   // Create a new scanner with a unique ID, inserting it into the map. Further
   // lookups for the scanner must provide the username associated with
   // 'remote_user'.
@@ -162,6 +183,11 @@ class ScannerManager {
   // Thread to remove expired scanners.
   scoped_refptr<kudu::Thread> removal_thread_;
 
+  // Pool on which the next batches of scanners are prefetched.
+  gscoped_ptr<ThreadPool> prefetch_pool_;
+
+  std::shared_ptr<MemTracker> prefetch_mem_tracker_;
+
   FunctionGaugeDetacher metric_detacher_;
 
   DISALLOW_COPY_AND_ASSIGN(ScannerManager);
@@ -190,6 +216,45 @@ class ScopedUnregisterScanner {
   bool cancelled_;
 };
 
+// A batch of serialized scan results, as returned by a continuation of the
+// scan. The rows are in either the row-wise or the columnar layout, depending
+// on the scanner's row format flags.
+struct SerializedScanBatch {
+  // Preallocates 'capacity' bytes for each of the row-wise buffers.
+  explicit SerializedScanBatch(size_t capacity)
+      : rows_data(new faststring(capacity)),
+        indirect_data(new faststring(capacity)) {
+  }
+
+  // Returns the number of bytes allocated by the buffers of the batch.
+  size_t memory_footprint() const {
+    return rows_data->capacity() + indirect_data->capacity() + columnar_batch.size();
+  }
+
+  RowwiseRowBlockPB rowblock_pb;
+  std::unique_ptr<faststring> rows_data;
+  std::unique_ptr<faststring> indirect_data;
+  ColumnarSerializedBatch columnar_batch;
+
+  // The primary key of the last row in the batch, if any.
+  faststring last_primary_key;
+
+  // The number of rows in the batch.
+  int64_t num_rows_returned = 0;
+
+  // The following are only set if the batch was prefetched.
+
+  // The status of scanning the batch.
+  Status status;
+
+  // The number of rows scanned to produce the batch.
+  int64_t rows_scanned = 0;
+
+  // The memory of the batch tracked by the scanner manager's prefetch
+  // tracker, released when the batch is destroyed.
+  std::unique_ptr<ScopedTrackedConsumption> consumption;
+};
+
 // An open scanner on the server side.
 class Scanner {
  public:
@@ -314,6 +379,15 @@ class Scanner {
     return num_rows_returned_;
   }
 
+  // Adds CPU time spent scanning to this scanner's total.
+  void add_cpu_time(const MonoDelta& cpu_time);
+
+  // Returns the total CPU time spent scanning.
+  MonoDelta cpu_time() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return cpu_time_;
+  }
+
   bool has_fulfilled_limit() const {
     std::lock_guard<simple_spinlock> l(lock_);
     return spec_ && spec_->has_limit() && num_rows_returned_ >= spec_->limit();
@@ -321,6 +395,22 @@ class Scanner {
 
   ScanDescriptor descriptor() const;
 
+  // While a client consumes a batch, the next one may be prefetched in the
+  // background (see --scanner_prefetch_batches), so that the next
+  // continuation of the scan returns it without waiting for the tablet.
+  //
+  // Marks a prefetch of the next batch as in progress. Returns false if
+  // a prefetch is already in progress or its batch hasn't been taken yet.
+  bool StartPrefetch();
+
+  // Publishes the batch of the prefetch started by StartPrefetch().
+  void FinishPrefetch(std::unique_ptr<SerializedScanBatch> batch);
+
+  // Waits for the prefetch in progress, if any, and takes its batch.
+  // Returns NULL if nothing was prefetched. Once this returns, the
+  // iterator isn't used by a prefetch until the next StartPrefetch().
+  std::unique_ptr<SerializedScanBatch> TakePrefetchedBatch();
+
  private:
   friend class ScannerManager;
 
@@ -342,8 +432,8 @@ class Scanner {
   // The current call sequence ID.
   uint32_t call_seq_id_;
 
-  // Protects last_access_time_ call_seq_id_, iter_, spec_, and
-  // num_rows_returned_.
+  // Protects last_access_time_ call_seq_id_, iter_, spec_,
+  // num_rows_returned_, and cpu_time_.
   mutable simple_spinlock lock_;
 
   // The time the scanner was started.
@@ -380,6 +470,21 @@ class Scanner {
   // this scanner.
   int64_t num_rows_returned_;
 
+  // The user and system CPU time spent scanning.
+  MonoDelta cpu_time_;
+
+  // Protects 'prefetching_'' and 'prefetched_batch_', and is signaled by
+  // 'prefetch_cond_' when a prefetch finishes.
+  Mutex prefetch_lock_;
+  ConditionVariable prefetch_cond_;
+
+  // Whether a prefetch is running, in which case it has exclusive use of
+  // 'iter_'.
+  bool prefetching_;
+
+  // The batch of the last prefetch, if it hasn't been taken yet.
+  std::unique_ptr<SerializedScanBatch> prefetched_batch_;
+
   DISALLOW_COPY_AND_ASSIGN(Scanner);
 };
 
@@ -420,6 +525,9 @@ struct ScanDescriptor {
   MonoTime start_time;
   MonoTime last_access_time;
   uint32_t last_call_seq_id;
+
+  // The CPU time spent scanning.
+  MonoDelta cpu_time;
 };
 
 } // namespace tserver
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/tablet_copy_bandwidth_manager.h"
+
+#include <memory>
+
+#include <gflags/gflags_declare.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(tablet_copy_max_bytes_per_sec);
+
+using std::unique_ptr;
+
+namespace kudu {
+namespace tserver {
+
+class TabletCopyBandwidthManagerTest : public KuduTest {
+ protected:
+  TabletCopyBandwidthManager manager_;
+};
+
+// Test that the budget is shared between the source servers first, and then
+// between the copies from each source server.
+TEST_F(TabletCopyBandwidthManagerTest, TestFairShares) {
+  unique_ptr<TabletCopyBandwidthManager::Share> a1 = manager_.Register("a");
+  ASSERT_EQ(0, manager_.RateForSource("a"));
+
+  FLAGS_tablet_copy_max_bytes_per_sec = 1200;
+  ASSERT_EQ(1200, manager_.RateForSource("a"));
+
+  unique_ptr<TabletCopyBandwidthManager::Share> a2 = manager_.Register("a");
+  unique_ptr<TabletCopyBandwidthManager::Share> b1 = manager_.Register("b");
+  ASSERT_EQ(300, manager_.RateForSource("a"));
+  ASSERT_EQ(600, manager_.RateForSource("b"));
+
+  // As copies finish, the others take over their shares.
+  a1.reset();
+  ASSERT_EQ(600, manager_.RateForSource("a"));
+  ASSERT_EQ(600, manager_.RateForSource("b"));
+  a2.reset();
+  ASSERT_EQ(1200, manager_.RateForSource("b"));
+}
+
+TEST_F(TabletCopyBandwidthManagerTest, TestConsume) {
+  FLAGS_tablet_copy_max_bytes_per_sec = 200 * 1024;
+  unique_ptr<TabletCopyBandwidthManager::Share> a = manager_.Register("a");
+  unique_ptr<TabletCopyBandwidthManager::Share> b = manager_.Register("b");
+
+  // The bucket starts with a second's worth of the copy's share.
+  MonoTime start = MonoTime::Now();
+  a->Consume(100 * 1024);
+  ASSERT_LT((MonoTime::Now() - start).ToMilliseconds(), 100);
+
+  // Then fetching waits for the bucket to refill at the copy's share of the
+  // rate, regardless of the other copy.
+  start = MonoTime::Now();
+  a->Consume(50 * 1024);
+  ASSERT_GE((MonoTime::Now() - start).ToMilliseconds(), 400);
+  start = MonoTime::Now();
+  b->Consume(100 * 1024);
+  ASSERT_LT((MonoTime::Now() - start).ToMilliseconds(), 100);
+}
+
+} // namespace tserver
+} // namespace kudu
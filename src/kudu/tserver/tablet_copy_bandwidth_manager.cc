@@ -0,0 +1,120 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/tablet_copy_bandwidth_manager.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_int64(tablet_copy_max_bytes_per_sec, 0,
+             "The maximum rate at which a tablet server fetches data for all "
+             "the tablet copies it runs, in bytes per second. The rate is "
+             "shared evenly between the source servers being copied from, "
+             "and between the copies from each source server. 0 means "
+             "unlimited.");
+TAG_FLAG(tablet_copy_max_bytes_per_sec, advanced);
+TAG_FLAG(tablet_copy_max_bytes_per_sec, runtime);
+
+using std::string;
+using std::unique_ptr;
+
+namespace kudu {
+namespace tserver {
+
+unique_ptr<TabletCopyBandwidthManager::Share> TabletCopyBandwidthManager::Register(
+    const string& source) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    copies_by_source_[source]++;
+  }
+  return unique_ptr<Share>(new Share(this, source));
+}
+
+int64_t TabletCopyBandwidthManager::RateForSource(const string& source) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return RateForSourceUnlocked(source);
+}
+
+int64_t TabletCopyBandwidthManager::RateForSourceUnlocked(const string& source) const {
+  int64_t budget = FLAGS_tablet_copy_max_bytes_per_sec;
+  if (budget <= 0) {
+    return 0;
+  }
+  int copies = FindWithDefault(copies_by_source_, source, 0);
+  DCHECK_GT(copies, 0) << "no copies registered from " << source;
+  // At least a byte per second, since 0 would mean unlimited.
+  return std::max<int64_t>(
+      1, budget / static_cast<int64_t>(copies_by_source_.size()) / std::max(copies, 1));
+}
+
+MonoDelta TabletCopyBandwidthManager::TakeTokens(Share* share, int64_t bytes) {
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  int64_t rate = RateForSourceUnlocked(share->source_);
+  if (rate == 0) {
+    share->last_refill_ = MonoTime();
+    return MonoDelta::FromNanoseconds(0);
+  }
+
+  // The bucket holds up to a second's worth of tokens. Since the rate
+  // changes as copies come and go, it's capped by the current rate.
+  if (PREDICT_FALSE(!share->last_refill_.Initialized())) {
+    share->tokens_ = rate;
+  } else {
+    share->tokens_ = std::min<double>(
+        rate, share->tokens_ + rate * (now - share->last_refill_).ToSeconds());
+  }
+  share->last_refill_ = now;
+  share->tokens_ -= bytes;
+  if (share->tokens_ >= 0) {
+    return MonoDelta::FromNanoseconds(0);
+  }
+  return MonoDelta::FromSeconds(-share->tokens_ / rate);
+}
+
+TabletCopyBandwidthManager::Share::Share(TabletCopyBandwidthManager* manager, string source)
+    : manager_(manager),
+      source_(std::move(source)),
+      tokens_(0) {
+}
+
+TabletCopyBandwidthManager::Share::~Share() {
+  std::lock_guard<simple_spinlock> l(manager_->lock_);
+  int* copies = FindOrNull(manager_->copies_by_source_, source_);
+  DCHECK(copies);
+  if (--*copies == 0) {
+    manager_->copies_by_source_.erase(source_);
+  }
+}
+
+void TabletCopyBandwidthManager::Share::Consume(int64_t bytes) {
+  MonoDelta wait = manager_->TakeTokens(this, bytes);
+  if (wait.ToNanoseconds() > 0) {
+    SleepFor(wait);
+  }
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace tserver {
+
+// Shares the bandwidth budget for tablet copies, --tablet_copy_max_bytes_per_sec,
+// between the tablet copies a tablet server is running at the same time.
+//
+// The budget is divided evenly between the source servers being copied
+// from, and the share of each source server evenly between the copies from
+// it, so that recovering a node spreads its load over the source servers
+// rather than overloading whichever holds the most replicas. The shares are
+// recomputed as copies start and finish, so that the copies in progress use
+// the whole budget, but no more.
+//
+// Each copy takes its share through a token bucket holding up to a second's
+// worth of its share, which may go into debt by a single chunk, in the way
+// of fs::IOScheduler.
+//
+// This class is thread-safe.
+class TabletCopyBandwidthManager {
+ public:
+  class Share;
+
+  TabletCopyBandwidthManager() = default;
+
+  // Registers a copy from the source server identified by 'source', for as
+  // long as the returned share is alive.
+  std::unique_ptr<Share> Register(const std::string& source);
+
+  // The rate, in bytes per second, currently allotted to each copy from
+  // 'source'. Returns 0 if bandwidth isn't limited.
+  int64_t RateForSource(const std::string& source) const;
+
+  class Share {
+   public:
+    ~Share();
+
+    // Waits until 'bytes' more may be fetched by the copy.
+    void Consume(int64_t bytes);
+
+   private:
+    friend class TabletCopyBandwidthManager;
+
+    Share(TabletCopyBandwidthManager* manager, std::string source);
+
+    TabletCopyBandwidthManager* const manager_;
+    const std::string source_;
+
+    // The bytes which may be fetched without waiting, and when they were last
+    // refilled. Protected by the manager's lock.
+    double tokens_;
+    MonoTime last_refill_;
+
+    DISALLOW_COPY_AND_ASSIGN(Share);
+  };
+
+ private:
+  // Takes 'bytes' tokens from 'share', and returns how long to wait before
+  // fetching them.
+  MonoDelta TakeTokens(Share* share, int64_t bytes);
+
+  // REQUIRES: 'lock_' is held.
+  int64_t RateForSourceUnlocked(const std::string& source) const;
+
+  mutable simple_spinlock lock_;
+
+  // The number of copies in progress from each source server.
+  std::unordered_map<std::string, int> copies_by_source_;
+
+  DISALLOW_COPY_AND_ASSIGN(TabletCopyBandwidthManager);
+};
+
+} // namespace tserver
+} // namespace kudu
@@ -73,6 +73,7 @@ using std::thread;
 using std::vector;
 
 DECLARE_double(env_inject_eio);
+DECLARE_int32(tablet_copy_download_threads_per_session);
 DECLARE_string(block_manager);
 DECLARE_string(env_inject_eio_globs);
 
@@ -371,6 +372,38 @@ TEST_F(TabletCopyClientTest, TestDownloadAllBlocks) {
   }
 }
 
+// Test that the blocks are downloaded in parallel, and that the blocks
+// downloaded before restarting the session are not downloaded again.
+TEST_F(TabletCopyClientTest, TestDownloadBlocksResumes) {
+  FLAGS_tablet_copy_download_threads_per_session = 4;
+  ASSERT_OK(StartCopy());
+  ASSERT_OK(client_->DownloadBlocks());
+  vector<BlockId> remote_blocks = ListBlocks(*client_->remote_superblock_);
+  vector<BlockId> new_blocks = ListBlocks(*client_->superblock_);
+  ASSERT_EQ(remote_blocks.size(), new_blocks.size());
+  ASSERT_EQ(remote_blocks.size(), client_->downloaded_blocks_.size());
+  ASSERT_EQ(0, client_->superblock_->orphaned_blocks_size());
+
+  // Begin a new session. Until the blocks are downloaded, the ones already
+  // downloaded are orphaned, and the new superblock refers to no blocks.
+  ASSERT_OK(client_->RestartRemoteSession());
+  ASSERT_TRUE(ListBlocks(*client_->superblock_).empty());
+  ASSERT_EQ(new_blocks.size(), client_->superblock_->orphaned_blocks_size());
+
+  // No blocks are downloaded again, and the same blocks are referred to.
+  ASSERT_OK(client_->DownloadBlocks());
+  ASSERT_EQ(remote_blocks.size(), client_->downloaded_blocks_.size());
+  ASSERT_EQ(new_blocks, ListBlocks(*client_->superblock_));
+  ASSERT_EQ(0, client_->superblock_->orphaned_blocks_size());
+
+  ASSERT_OK(client_->DownloadWALs());
+  ASSERT_OK(client_->Finish());
+  for (const BlockId& block_id : new_blocks) {
+    unique_ptr<fs::ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  }
+}
+
 // Test that failing a disk outside fo the tablet copy client will eventually
 // stop the copy client and cause it to fail.
 TEST_F(TabletCopyClientTest, TestFailedDiskStopsClient) {
@@ -17,11 +17,15 @@
 
 #include "kudu/tserver/tablet_copy_client.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <ostream>
+#include <unordered_set>
 #include <utility>
 
+#include <boost/bind.hpp>
 #include <boost/optional/optional.hpp>
 #include <gflags/gflags.h>
 #include <gflags/gflags_declare.h>
@@ -40,6 +44,8 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
@@ -65,13 +71,29 @@
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(tablet_copy_begin_session_timeout_ms, 30000,
              "Tablet server RPC client timeout for BeginTabletCopySession calls. "
              "Also used for EndTabletCopySession calls.");
 TAG_FLAG(tablet_copy_begin_session_timeout_ms, advanced);
 
+DEFINE_int32(tablet_copy_download_threads_per_session, 1,
+             "Number of threads each tablet copy session downloads the data "
+             "blocks of the tablet with, in parallel.");
+TAG_FLAG(tablet_copy_download_threads_per_session, advanced);
+TAG_FLAG(tablet_copy_download_threads_per_session, experimental);
+
+DEFINE_int32(tablet_copy_max_session_restarts, 0,
+             "Number of times a tablet copy begins a new session with the copy "
+             "source after losing the previous one, e.g. to a network error or "
+             "to the source expiring it, rather than failing the copy. The data "
+             "blocks downloaded in the earlier sessions are not downloaded again.");
+TAG_FLAG(tablet_copy_max_session_restarts, experimental);
+TAG_FLAG(tablet_copy_max_session_restarts, runtime);
+
 DEFINE_bool(tablet_copy_save_downloaded_metadata, false,
             "Save copies of the downloaded tablet copy files for debugging purposes. "
             "Note: This is only intended for debugging and should not be normally used!");
@@ -128,6 +150,7 @@ using rpc::Messenger;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 using tablet::ColumnDataPB;
@@ -148,7 +171,8 @@ TabletCopyClient::TabletCopyClient(std::string tablet_id,
     FsManager* fs_manager,
     scoped_refptr<ConsensusMetadataManager> cmeta_manager,
     shared_ptr<Messenger> messenger,
-    TabletCopyClientMetrics* tablet_copy_metrics)
+    TabletCopyClientMetrics* tablet_copy_metrics,
+    TabletCopyBandwidthManager* bandwidth_manager)
     : tablet_id_(std::move(tablet_id)),
       fs_manager_(fs_manager),
       cmeta_manager_(std::move(cmeta_manager)),
@@ -158,8 +182,10 @@ TabletCopyClient::TabletCopyClient(std::string tablet_id,
       tablet_replica_(nullptr),
       session_idle_timeout_millis_(FLAGS_tablet_copy_begin_session_timeout_ms),
       start_time_micros_(0),
+      block_count_(0),
       rng_(GetRandomSeed32()),
-      tablet_copy_metrics_(tablet_copy_metrics) {
+      tablet_copy_metrics_(tablet_copy_metrics),
+      bandwidth_manager_(bandwidth_manager) {
   BlockManager* bm = fs_manager->block_manager();
   transaction_ = bm->NewCreationTransaction();
   if (tablet_copy_metrics_) {
@@ -241,56 +267,13 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
 
   // Set up an RPC proxy for the TabletCopyService.
   proxy_.reset(new TabletCopyServiceProxy(messenger_, addr, copy_source_addr.host()));
-
-  BeginTabletCopySessionRequestPB req;
-  req.set_requestor_uuid(fs_manager_->uuid());
-  req.set_tablet_id(tablet_id_);
-
-  rpc::RpcController controller;
-
-  // Begin the tablet copy session with the remote peer.
-  BeginTabletCopySessionResponsePB resp;
-  RETURN_NOT_OK_PREPEND(SendRpcWithRetry(&controller, [&] {
-    return proxy_->BeginTabletCopySession(req, &resp, &controller);
-  }), "unable to begin tablet copy session");
-
-  string copy_peer_uuid = resp.has_responder_uuid()
-      ? resp.responder_uuid() : "(unknown uuid)";
-  if (resp.superblock().tablet_data_state() != tablet::TABLET_DATA_READY) {
-    Status s = Status::IllegalState("Remote peer (" + copy_peer_uuid + ")" +
-                                    " is currently copying itself!",
-                                    pb_util::SecureShortDebugString(resp.superblock()));
-    LOG_WITH_PREFIX(WARNING) << s.ToString();
-    return s;
+  if (bandwidth_manager_ && !bandwidth_share_) {
+    bandwidth_share_ = bandwidth_manager_->Register(copy_source_addr.ToString());
   }
 
-  session_id_ = resp.session_id();
-  // Update our default RPC timeout to reflect the server's session timeout.
-  session_idle_timeout_millis_ = resp.session_idle_timeout_millis();
-
-  // Store a copy of the remote (old) superblock.
-  remote_superblock_.reset(resp.release_superblock());
-
-  // Make a copy of the remote superblock. We first clear out the remote blocks
-  // from this structure and then add them back in as they are downloaded.
-  superblock_.reset(new TabletSuperBlockPB(*remote_superblock_));
-
-  // The block ids (in active rowsets as well as from orphaned blocks) on the
-  // remote have no meaning to us and could cause data loss if accidentally
-  // deleted locally. We must clear them all.
-  superblock_->clear_rowsets();
-  superblock_->clear_orphaned_blocks();
-
-  // The UUIDs within the DataDirGroupPB on the remote are also unique to the
-  // remote and have no meaning to us.
-  superblock_->clear_data_dir_group();
-
-  // Set the data state to COPYING to indicate that, on crash, this replica
-  // should be discarded.
-  superblock_->set_tablet_data_state(tablet::TABLET_DATA_COPYING);
-
-  wal_seqnos_.assign(resp.wal_segment_seqnos().begin(), resp.wal_segment_seqnos().end());
-  remote_cstate_.reset(resp.release_initial_cstate());
+  string copy_peer_uuid;
+  RETURN_NOT_OK(BeginRemoteSession(&copy_peer_uuid));
+  ResetSuperBlockFromRemote();
 
   Schema schema;
   RETURN_NOT_OK_PREPEND(SchemaFromPB(superblock_->schema(), &schema),
@@ -380,11 +363,26 @@ Status TabletCopyClient::FetchAll(const scoped_refptr<TabletReplica>& tablet_rep
 
   tablet_replica_ = tablet_replica;
 
-  // Download all the files (serially, for now, but in parallel in the future).
-  RETURN_NOT_OK(DownloadBlocks());
-  RETURN_NOT_OK(DownloadWALs());
-
-  return Status::OK();
+  for (int restarts = 0;; restarts++) {
+    Status s = DownloadBlocks();
+    if (s.ok()) {
+      s = DownloadWALs();
+    }
+    if (s.ok()) {
+      return Status::OK();
+    }
+    // Errors talking to the source, or in the data it sent, may be overcome
+    // by a new session. Local errors, e.g. of a failed disk, may not.
+    bool restartable = s.IsRemoteError() || s.IsNetworkError() || s.IsTimedOut() ||
+                       s.IsServiceUnavailable() || s.IsCorruption();
+    if (!restartable || restarts >= FLAGS_tablet_copy_max_session_restarts) {
+      return s;
+    }
+    LOG_WITH_PREFIX(WARNING) << "Restarting tablet copy session after error: " << s.ToString()
+                             << Substitute(" ($0 data blocks downloaded so far)",
+                                           downloaded_blocks_.size());
+    RETURN_NOT_OK_PREPEND(RestartRemoteSession(), "unable to restart tablet copy session");
+  }
 }
 
 Status TabletCopyClient::Finish() {
@@ -494,6 +492,97 @@ void TabletCopyClient::SetStatusMessage(const string& message) {
   }
 }
 
+Status TabletCopyClient::BeginRemoteSession(string* copy_peer_uuid) {
+  BeginTabletCopySessionRequestPB req;
+  req.set_requestor_uuid(fs_manager_->uuid());
+  req.set_tablet_id(tablet_id_);
+
+  rpc::RpcController controller;
+
+  // Begin the tablet copy session with the remote peer.
+  BeginTabletCopySessionResponsePB resp;
+  RETURN_NOT_OK_PREPEND(SendRpcWithRetry(&controller, [&] {
+    return proxy_->BeginTabletCopySession(req, &resp, &controller);
+  }), "unable to begin tablet copy session");
+
+  *copy_peer_uuid = resp.has_responder_uuid()
+      ? resp.responder_uuid() : "(unknown uuid)";
+  if (resp.superblock().tablet_data_state() != tablet::TABLET_DATA_READY) {
+    Status s = Status::IllegalState("Remote peer (" + *copy_peer_uuid + ")" +
+                                    " is currently copying itself!",
+                                    pb_util::SecureShortDebugString(resp.superblock()));
+    LOG_WITH_PREFIX(WARNING) << s.ToString();
+    return s;
+  }
+
+  session_id_ = resp.session_id();
+  // Update our default RPC timeout to reflect the server's session timeout.
+  session_idle_timeout_millis_ = resp.session_idle_timeout_millis();
+
+  // Store a copy of the remote (old) superblock.
+  remote_superblock_.reset(resp.release_superblock());
+
+  wal_seqnos_.assign(resp.wal_segment_seqnos().begin(), resp.wal_segment_seqnos().end());
+  remote_cstate_.reset(resp.release_initial_cstate());
+  return Status::OK();
+}
+
+void TabletCopyClient::ResetSuperBlockFromRemote() {
+  // Make a copy of the remote superblock. We first clear out the remote blocks
+  // from this structure and then add them back in as they are downloaded.
+  superblock_.reset(new TabletSuperBlockPB(*remote_superblock_));
+
+  // The block ids (in active rowsets as well as from orphaned blocks) on the
+  // remote have no meaning to us and could cause data loss if accidentally
+  // deleted locally. We must clear them all.
+  superblock_->clear_rowsets();
+  superblock_->clear_orphaned_blocks();
+
+  // The UUIDs within the DataDirGroupPB on the remote are also unique to the
+  // remote and have no meaning to us.
+  superblock_->clear_data_dir_group();
+
+  // Set the data state to COPYING to indicate that, on crash, this replica
+  // should be discarded.
+  superblock_->set_tablet_data_state(tablet::TABLET_DATA_COPYING);
+}
+
+Status TabletCopyClient::RestartRemoteSession() {
+  CHECK_EQ(kStarted, state_);
+
+  // The old session may well be gone already; it expires on the source.
+  WARN_NOT_OK(EndRemoteSession(), Substitute("$0Unable to close tablet copy session",
+                                             LogPrefix()));
+  const int64_t old_term = remote_cstate_->current_term();
+  string copy_peer_uuid;
+  RETURN_NOT_OK(BeginRemoteSession(&copy_peer_uuid));
+  if (remote_cstate_->current_term() < old_term) {
+    return Status::IllegalState(
+        Substitute("source peer $0 went back to term $1 from term $2",
+                   copy_peer_uuid, remote_cstate_->current_term(), old_term));
+  }
+
+  // The local parts of the old superblock carry over.
+  unique_ptr<TabletSuperBlockPB> old_superblock(std::move(superblock_));
+  ResetSuperBlockFromRemote();
+  if (old_superblock->has_tombstone_last_logged_opid()) {
+    *superblock_->mutable_tombstone_last_logged_opid() =
+        old_superblock->tombstone_last_logged_opid();
+  }
+  *superblock_->mutable_data_dir_group() = old_superblock->data_dir_group();
+
+  // So may the blocks downloaded so far: blocks are immutable, so a block
+  // with the same ID on the source still has the same contents. Until
+  // DownloadBlocks() finds which of them the source still refers to, they are
+  // orphaned, to be deleted should the copy be aborted.
+  for (const auto& e : downloaded_blocks_) {
+    e.second.CopyToPB(superblock_->add_orphaned_blocks());
+  }
+
+  // The source's config and term may have moved on since the last session.
+  return WriteConsensusMetadata();
+}
+
 Status TabletCopyClient::EndRemoteSession() {
   if (state_ == kInitialized) {
     return Status::OK();
@@ -557,71 +646,129 @@ int TabletCopyClient::CountRemoteBlocks() const {
 Status TabletCopyClient::DownloadBlocks() {
   CHECK_EQ(kStarted, state_);
 
-  // Count up the total number of blocks to download.
-  int num_remote_blocks = CountRemoteBlocks();
-
-  // Download each block, writing the new block IDs into the new superblock
-  // as each block downloads.
-  int block_count = 0;
-  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_remote_blocks << " data blocks...";
+  // Collect the blocks which remain to be downloaded, e.g. after a restart
+  // of the session.
+  vector<BlockId> to_download;
+  unordered_set<BlockId, BlockIdHash, BlockIdEqual> seen;
+  const auto add_block = [&](const BlockIdPB& block_pb) {
+    BlockId block_id(BlockId::FromPB(block_pb));
+    if (!ContainsKey(downloaded_blocks_, block_id) && InsertIfNotPresent(&seen, block_id)) {
+      to_download.emplace_back(block_id);
+    }
+  };
   for (const RowSetDataPB& src_rowset : remote_superblock_->rowsets()) {
-    // Create rowset.
-    RowSetDataPB* dst_rowset = superblock_->add_rowsets();
-    *dst_rowset = src_rowset;
-    // Clear the data in the rowset so that we don't end up deleting the wrong
-    // blocks (using the ids of the remote blocks) if we fail.
-    // TODO(mpercy): This is pretty fragile. Consider building a class
-    // structure on top of SuperBlockPB to abstract copying details.
-    dst_rowset->clear_columns();
-    dst_rowset->clear_redo_deltas();
-    dst_rowset->clear_undo_deltas();
-    dst_rowset->clear_bloom_block();
-    dst_rowset->clear_adhoc_index_block();
-
-    // We can't leave superblock_ unserializable with unset required field
-    // values in child elements, so we must download and rewrite each block
-    // before referencing it in the rowset.
     for (const ColumnDataPB& src_col : src_rowset.columns()) {
-      BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_col.block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      ColumnDataPB* dst_col = dst_rowset->add_columns();
-      *dst_col = src_col;
-      *dst_col->mutable_block() = new_block_id;
+      add_block(src_col.block());
     }
     for (const DeltaDataPB& src_redo : src_rowset.redo_deltas()) {
-      BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_redo.block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      DeltaDataPB* dst_redo = dst_rowset->add_redo_deltas();
-      *dst_redo = src_redo;
-      *dst_redo->mutable_block() = new_block_id;
+      add_block(src_redo.block());
     }
     for (const DeltaDataPB& src_undo : src_rowset.undo_deltas()) {
-      BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_undo.block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      DeltaDataPB* dst_undo = dst_rowset->add_undo_deltas();
-      *dst_undo = src_undo;
-      *dst_undo->mutable_block() = new_block_id;
+      add_block(src_undo.block());
     }
     if (src_rowset.has_bloom_block()) {
-      BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_rowset.bloom_block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      *dst_rowset->mutable_bloom_block() = new_block_id;
+      add_block(src_rowset.bloom_block());
     }
     if (src_rowset.has_adhoc_index_block()) {
-      BlockIdPB new_block_id;
-      RETURN_NOT_OK(DownloadAndRewriteBlock(src_rowset.adhoc_index_block(), num_remote_blocks,
-                                            &block_count, &new_block_id));
-      *dst_rowset->mutable_adhoc_index_block() = new_block_id;
+      add_block(src_rowset.adhoc_index_block());
+    }
+  }
+
+  int num_remote_blocks = CountRemoteBlocks();
+  LOG_WITH_PREFIX(INFO) << "Starting download of " << to_download.size() << " data blocks"
+                        << Substitute(" ($0 of $1 already downloaded)...",
+                                      num_remote_blocks - to_download.size(),
+                                      num_remote_blocks);
+  {
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("tablet-copy-download")
+                  .set_min_threads(0)
+                  .set_max_threads(std::max(1, FLAGS_tablet_copy_download_threads_per_session))
+                  .Build(&pool));
+    download_status_ = Status::OK();
+    block_count_ = 0;
+    for (const BlockId& block_id : to_download) {
+      Status s = pool->SubmitFunc(boost::bind(&TabletCopyClient::DownloadBlockTask,
+                                              this, block_id,
+                                              static_cast<int>(to_download.size())));
+      if (!s.ok()) {
+        std::lock_guard<simple_spinlock> l(lock_);
+        if (download_status_.ok()) {
+          download_status_ = s;
+        }
+        break;
+      }
+    }
+    pool->Wait();
+    pool->Shutdown();
+  }
+  RETURN_NOT_OK(download_status_);
+
+  // Rewrite the rowsets of the new superblock with the new block IDs. Every
+  // block downloaded but no longer referred to by the source, e.g. a block of
+  // a rowset since compacted away, stays orphaned.
+  unordered_set<BlockId, BlockIdHash, BlockIdEqual> referenced;
+  const auto rewrite_block = [&](BlockIdPB* block_pb) {
+    const BlockId& new_block_id = FindOrDie(downloaded_blocks_, BlockId::FromPB(*block_pb));
+    new_block_id.CopyToPB(block_pb);
+    referenced.insert(new_block_id);
+  };
+  superblock_->clear_rowsets();
+  for (const RowSetDataPB& src_rowset : remote_superblock_->rowsets()) {
+    RowSetDataPB* dst_rowset = superblock_->add_rowsets();
+    *dst_rowset = src_rowset;
+    for (ColumnDataPB& dst_col : *dst_rowset->mutable_columns()) {
+      rewrite_block(dst_col.mutable_block());
+    }
+    for (DeltaDataPB& dst_redo : *dst_rowset->mutable_redo_deltas()) {
+      rewrite_block(dst_redo.mutable_block());
+    }
+    for (DeltaDataPB& dst_undo : *dst_rowset->mutable_undo_deltas()) {
+      rewrite_block(dst_undo.mutable_block());
+    }
+    if (dst_rowset->has_bloom_block()) {
+      rewrite_block(dst_rowset->mutable_bloom_block());
+    }
+    if (dst_rowset->has_adhoc_index_block()) {
+      rewrite_block(dst_rowset->mutable_adhoc_index_block());
+    }
+  }
+  superblock_->clear_orphaned_blocks();
+  for (const auto& e : downloaded_blocks_) {
+    if (!ContainsKey(referenced, e.second)) {
+      e.second.CopyToPB(superblock_->add_orphaned_blocks());
     }
   }
 
   return Status::OK();
 }
 
+void TabletCopyClient::DownloadBlockTask(const BlockId& src_block_id, int num_blocks) {
+  int block_count;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!download_status_.ok()) {
+      return;
+    }
+    block_count = ++block_count_;
+  }
+  SetStatusMessage(Substitute("Downloading block $0 ($1/$2)",
+                              src_block_id.ToString(), block_count, num_blocks));
+  BlockId new_block_id;
+  Status s = DownloadBlock(src_block_id, &new_block_id).CloneAndPrepend(
+      "Unable to download block with id " + src_block_id.ToString());
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (s.ok()) {
+    // Until the rowsets refer to it, the new block is orphaned, so that
+    // aborting the copy deletes it.
+    InsertOrDie(&downloaded_blocks_, src_block_id, new_block_id);
+    new_block_id.CopyToPB(superblock_->add_orphaned_blocks());
+  } else if (download_status_.ok()) {
+    download_status_ = s;
+  }
+}
+
 Status TabletCopyClient::DownloadWAL(uint64_t wal_segment_seqno) {
   VLOG_WITH_PREFIX(1) << "Downloading WAL segment with seqno " << wal_segment_seqno;
   RETURN_NOT_OK_PREPEND(CheckHealthyDirGroup(), "Not downloading WAL for replica");
@@ -649,7 +796,9 @@ Status TabletCopyClient::WriteConsensusMetadata() {
   if (!cmeta_) {
     return cmeta_manager_->Create(tablet_id_,
                                   remote_cstate_->committed_config(),
-                                  remote_cstate_->current_term());
+                                  remote_cstate_->current_term(),
+                                  consensus::ConsensusMetadataCreateMode::FLUSH_ON_CREATE,
+                                  &cmeta_);
   }
 
   // Otherwise, update the consensus metadata to reflect the config and term
@@ -668,30 +817,14 @@ Status TabletCopyClient::WriteConsensusMetadata() {
   return Status::OK();
 }
 
-Status TabletCopyClient::DownloadAndRewriteBlock(const BlockIdPB& src_block_id,
-                                                 int num_blocks,
-                                                 int* block_count,
-                                                 BlockIdPB* dest_block_id) {
-  BlockId old_block_id(BlockId::FromPB(src_block_id));
-  SetStatusMessage(Substitute("Downloading block $0 ($1/$2)",
-                              old_block_id.ToString(),
-                              *block_count + 1, num_blocks));
-  BlockId new_block_id;
-  RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
-      "Unable to download block with id " + old_block_id.ToString());
-
-  new_block_id.CopyToPB(dest_block_id);
-  (*block_count)++;
-  return Status::OK();
-}
-
 Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
                                        BlockId* new_block_id) {
   VLOG_WITH_PREFIX(1) << "Downloading block with block_id " << old_block_id.ToString();
   RETURN_NOT_OK_PREPEND(CheckHealthyDirGroup(), "Not downloading block for replica");
 
   unique_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(CreateBlockOptions({ tablet_id_ }), &block),
+  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(
+      CreateBlockOptions({ tablet_id_, fs::IOClass::TABLET_COPY }), &block),
                         "Unable to create new block");
 
   DataIdPB data_id;
@@ -703,6 +836,7 @@ Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
 
   *new_block_id = block->id();
   RETURN_NOT_OK_PREPEND(block->Finalize(), "Unable to finalize block");
+  std::lock_guard<simple_spinlock> l(lock_);
   transaction_->AddCreatedBlock(std::move(block));
   return Status::OK();
 }
@@ -717,6 +851,7 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
   req.set_session_id(session_id_);
   req.mutable_data_id()->CopyFrom(data_id);
   req.set_max_length(FLAGS_tablet_copy_transfer_chunk_size_bytes);
+  req.set_data_in_sidecar(true);
 
   bool done = false;
   while (!done) {
@@ -728,13 +863,27 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
           return proxy_->FetchData(req, &resp, &controller);
     }), "unable to fetch data from remote");
 
+    // Servers which don't support sidecars for the data still send it in
+    // the response.
+    Slice data = resp.chunk().data();
+    if (resp.chunk().has_data_sidecar_idx()) {
+      RETURN_NOT_OK_PREPEND(controller.GetInboundSidecar(resp.chunk().data_sidecar_idx(), &data),
+                            "unable to get data sidecar");
+    }
+
     // Sanity-check for corruption.
-    RETURN_NOT_OK_PREPEND(VerifyData(offset, resp.chunk()),
+    RETURN_NOT_OK_PREPEND(VerifyData(offset, resp.chunk(), data),
                           Substitute("Error validating data item $0",
                                      pb_util::SecureShortDebugString(data_id)));
 
     // Write the data.
-    RETURN_NOT_OK(appendable->Append(resp.chunk().data()));
+    RETURN_NOT_OK(appendable->Append(data));
+
+    // Hold off fetching the next chunk until the copy's share of the
+    // bandwidth allows for this one.
+    if (bandwidth_share_) {
+      bandwidth_share_->Consume(data.size());
+    }
 
     if (PREDICT_FALSE(FLAGS_tablet_copy_download_file_inject_latency_ms > 0)) {
       LOG_WITH_PREFIX(INFO) << "Injecting latency into file download: " <<
@@ -742,7 +891,7 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_tablet_copy_download_file_inject_latency_ms));
     }
 
-    auto chunk_size = resp.chunk().data().size();
+    auto chunk_size = data.size();
     done = offset + chunk_size == resp.chunk().total_data_length();
     offset += chunk_size;
     if (tablet_copy_metrics_) {
@@ -754,6 +903,11 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
 }
 
 Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
+  return VerifyData(offset, chunk, chunk.data());
+}
+
+Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk,
+                                    const Slice& data) {
   // Verify the offset is what we expected.
   if (offset != chunk.offset()) {
     return Status::InvalidArgument("Offset did not match what was asked for",
@@ -761,17 +915,17 @@ Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
   }
 
   // Verify that the chunk does not overflow the total data length.
-  if (offset + chunk.data().length() > chunk.total_data_length()) {
+  if (offset + data.size() > chunk.total_data_length()) {
     return Status::InvalidArgument("Chunk exceeds total block data length",
-        Substitute("$0 vs $1", offset + chunk.data().length(), chunk.total_data_length()));
+        Substitute("$0 vs $1", offset + data.size(), chunk.total_data_length()));
   }
 
   // Verify the checksum.
-  uint32_t crc32 = crc::Crc32c(chunk.data().data(), chunk.data().length());
+  uint32_t crc32 = crc::Crc32c(data.data(), data.size());
   if (PREDICT_FALSE(crc32 != chunk.crc32())) {
     return Status::Corruption(
         Substitute("CRC32 does not match at offset $0 size $1: $2 vs $3",
-          offset, chunk.data().size(), crc32, chunk.crc32()));
+          offset, data.size(), crc32, chunk.crc32()));
   }
   return Status::OK();
 }
@@ -19,20 +19,23 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
 
+#include "kudu/fs/block_id.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/tserver/tablet_copy_bandwidth_manager.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/random.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
-class BlockId;
-class BlockIdPB;
 class FsManager;
 class HostPort;
 
@@ -73,18 +76,26 @@ struct TabletCopyClientMetrics {
 // Client class for using tablet copy to copy a tablet from another host.
 // This class is not thread-safe.
 //
+// The blocks are downloaded by --tablet_copy_download_threads_per_session
+// threads in parallel. The blocks downloaded so far are kept track of, so
+// that if the copy session with the source is lost, a new one may be begun
+// without downloading them again; see --tablet_copy_max_session_restarts.
+//
 // TODO:
-// * Parallelize download of blocks and WAL segments.
+// * Parallelize download of WAL segments.
 //
 class TabletCopyClient {
  public:
 
   // Construct the tablet copy client.
   // 'fs_manager' and 'messenger' must remain valid until this object is destroyed.
+  // If 'bandwidth_manager' isn't null, it must also remain valid, and the
+  // data is fetched at the rate it allots to the copy.
   TabletCopyClient(std::string tablet_id, FsManager* fs_manager,
                    scoped_refptr<consensus::ConsensusMetadataManager> cmeta_manager,
                    std::shared_ptr<rpc::Messenger> messenger,
-                   TabletCopyClientMetrics* tablet_copy_metrics);
+                   TabletCopyClientMetrics* tablet_copy_metrics,
+                   TabletCopyBandwidthManager* bandwidth_manager = nullptr);
 
   // Attempt to clean up resources on the remote end by sending an
   // EndTabletCopySession() RPC
@@ -135,6 +146,7 @@ class TabletCopyClient {
   FRIEND_TEST(TabletCopyClientTest, TestVerifyData);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadWalSegment);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadAllBlocks);
+  FRIEND_TEST(TabletCopyClientTest, TestDownloadBlocksResumes);
   FRIEND_TEST(TabletCopyClientAbortTest, TestAbort);
 
   // State machine that guides the progression of a single tablet copy.
@@ -173,9 +185,22 @@ class TabletCopyClient {
   // The string "TabletCopy: " will be prepended to each message.
   void SetStatusMessage(const std::string& message);
 
+  // Begin a tablet copy session with the source, setting 'session_id_',
+  // 'remote_superblock_', 'wal_seqnos_' and 'remote_cstate_' from the
+  // source's response. 'copy_peer_uuid' is set to the source's UUID.
+  Status BeginRemoteSession(std::string* copy_peer_uuid);
+
   // End the tablet copy session.
   Status EndRemoteSession();
 
+  // After losing the session with the source, begin a new one, keeping the
+  // blocks downloaded so far that the source's new superblock still refers to.
+  Status RestartRemoteSession();
+
+  // Reset 'superblock_' to a copy of 'remote_superblock_' which refers to
+  // no blocks and is in the COPYING state.
+  void ResetSuperBlockFromRemote();
+
   // Download all WAL files sequentially.
   Status DownloadWALs();
 
@@ -191,29 +216,24 @@ class TabletCopyClient {
   // Count the number of blocks on the remote (from 'remote_superblock_').
   int CountRemoteBlocks() const;
 
-  // Download all blocks belonging to a tablet sequentially. Add all
-  // downloaded blocks to the tablet copy's transaction.
+  // Download all blocks belonging to a tablet which have not been downloaded
+  // yet, in parallel. Add all downloaded blocks to the tablet copy's
+  // transaction.
   //
   // Blocks are given new IDs upon creation. On success, 'superblock_'
   // is populated to reflect the new block IDs.
   Status DownloadBlocks();
 
-  // Download the remote block specified by 'src_block_id'. 'num_blocks' should
-  // be given as the total number of blocks there are to download (for logging
-  // purposes). Add the block to the tablet copy's transaction, to close blocks
-  // belonging to the transaction together when the copying is complete.
-  //
-  // On success:
-  // - 'dest_block_id' is set to the new ID of the downloaded block.
-  // - 'block_count' is incremented by 1.
-  Status DownloadAndRewriteBlock(const BlockIdPB& src_block_id,
-                                 int num_blocks,
-                                 int* block_count,
-                                 BlockIdPB* dest_block_id);
+  // Download the remote block 'src_block_id' on behalf of DownloadBlocks(),
+  // unless another download has failed already. 'num_blocks' should be given
+  // as the total number of blocks there are to download (for logging
+  // purposes). Records the new ID of the block in 'downloaded_blocks_', or
+  // the error in 'download_status_'.
+  void DownloadBlockTask(const BlockId& src_block_id, int num_blocks);
 
   // Download a single block.
   // Data block is opened with new ID. After downloading, the block is finalized
-  // and added to the tablet copy's transaction.
+  // and added to the tablet copy's transaction. Thread-safe.
   //
   // On success, 'new_block_id' is set to the new ID of the downloaded block.
   Status DownloadBlock(const BlockId& old_block_id,
@@ -231,6 +251,10 @@ class TabletCopyClient {
 
   Status VerifyData(uint64_t offset, const DataChunkPB& resp);
 
+  // Same as above, for the bytes 'data' of the chunk, which may have been sent
+  // in a sidecar rather than in 'resp' itself.
+  Status VerifyData(uint64_t offset, const DataChunkPB& resp, const Slice& data);
+
   // Runs the provided functor, which must send an RPC and return the result
   // status, until it succeeds, times out, or fails with a non-retriable error.
   template<typename F>
@@ -269,10 +293,31 @@ class TabletCopyClient {
   std::vector<uint64_t> wal_seqnos_;
   int64_t start_time_micros_;
 
-  Random rng_;
+  // Protects the members below while blocks are downloaded in parallel.
+  simple_spinlock lock_;
+
+  // The blocks downloaded so far, by their remote block IDs. They are also
+  // recorded as orphaned blocks in 'superblock_' until the rowsets refer to
+  // them, so that an aborted copy deletes them.
+  std::unordered_map<BlockId, BlockId, BlockIdHash, BlockIdEqual> downloaded_blocks_;
+
+  // The first error of the parallel block downloads.
+  Status download_status_;
+
+  // The number of blocks downloaded in the current DownloadBlocks() call,
+  // for the status messages.
+  int block_count_;
+
+  ThreadSafeRandom rng_;
 
   TabletCopyClientMetrics* tablet_copy_metrics_;
 
+  TabletCopyBandwidthManager* const bandwidth_manager_;
+
+  // This copy's share of the tablet copy bandwidth, registered with
+  // 'bandwidth_manager_' by Start().
+  std::unique_ptr<TabletCopyBandwidthManager::Share> bandwidth_share_;
+
   // Block transaction for the tablet copy.
   std::unique_ptr<fs::BlockCreationTransaction> transaction_;
 
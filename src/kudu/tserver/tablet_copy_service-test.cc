@@ -419,6 +419,38 @@ TEST_F(TabletCopyServiceTest, TestFetchBlockAtOnce) {
   AssertDataEqual(local_data.data(), local_data.size(), resp.chunk());
 }
 
+// Test that the data of a block is sent in a sidecar for the clients which
+// ask for it.
+TEST_F(TabletCopyServiceTest, TestFetchBlockInSidecar) {
+  string session_id;
+  tablet::TabletSuperBlockPB superblock;
+  ASSERT_OK(DoBeginValidTabletCopySession(&session_id, &superblock));
+
+  BlockId block_id = FirstColumnBlockId(superblock);
+  Slice local_data;
+  faststring scratch;
+  ASSERT_OK(ReadLocalBlockFile(mini_server_->server()->fs_manager(), block_id,
+                               &scratch, &local_data));
+
+  FetchDataRequestPB req;
+  req.set_session_id(session_id);
+  req.mutable_data_id()->CopyFrom(AsDataTypeId(block_id));
+  req.set_data_in_sidecar(true);
+  FetchDataResponsePB resp;
+  RpcController controller;
+  controller.set_timeout(MonoDelta::FromSeconds(1.0));
+  ASSERT_OK(UnwindRemoteError(tablet_copy_proxy_->FetchData(req, &resp, &controller),
+                              &controller));
+
+  ASSERT_TRUE(resp.chunk().has_data_sidecar_idx());
+  ASSERT_TRUE(resp.chunk().data().empty());
+  Slice data;
+  ASSERT_OK(controller.GetInboundSidecar(resp.chunk().data_sidecar_idx(), &data));
+  ASSERT_EQ(local_data.size(), data.size());
+  ASSERT_TRUE(local_data == data);
+  ASSERT_EQ(crc::Crc32c(data.data(), data.size()), resp.chunk().crc32());
+}
+
 // Test that we are able to incrementally fetch blocks.
 TEST_F(TabletCopyServiceTest, TestFetchBlockIncrementally) {
   string session_id;
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -44,6 +45,7 @@
 namespace kudu {
 
 class FsManager;
+class faststring;
 
 namespace tablet {
 class TabletReplica;
@@ -72,6 +74,10 @@ struct ImmutableRandomAccessFileInfo {
   Status Read(uint64_t offset, Slice data) const {
     return readable->Read(offset, data);
   }
+
+  Status Prefetch(uint64_t offset, size_t length) const {
+    return readable->Prefetch(offset, length);
+  }
 };
 
 // Caches block size and holds an exclusive reference to a ReadableBlock.
@@ -89,6 +95,10 @@ struct ImmutableReadableBlockInfo {
   Status Read(uint64_t offset, Slice data) const {
     return readable->Read(offset, data);
   }
+
+  Status Prefetch(uint64_t offset, size_t length) const {
+    return readable->Prefetch(offset, length);
+  }
 };
 
 // A potential Learner must establish a TabletCopySourceSession with the leader in order
@@ -125,15 +135,15 @@ class TabletCopySourceSession : public RefCountedThreadSafe<TabletCopySourceSess
 
   // Open block for reading, if it's not already open, and read some of it.
   // If maxlen is 0, we use a system-selected length for the data piece.
-  // *data is set to a std::string containing the data. Ownership of this object
-  // is passed to the caller. A string is used because the RPC interface is
-  // sending data serialized as protobuf and we want to minimize copying.
+  // *data is set to the data. It's read straight into the buffer, which the
+  // RPC layer may then send as a sidecar without copying it again. The piece
+  // which follows is prefetched, since clients fetch the pieces in order.
   // On error, Status is set to a non-OK value and error_code is filled in.
   //
   // This method is thread-safe.
   Status GetBlockPiece(const BlockId& block_id,
                        uint64_t offset, int64_t client_maxlen,
-                       std::string* data, int64_t* block_file_size,
+                       faststring* data, int64_t* block_file_size,
                        TabletCopyErrorPB::Code* error_code);
 
   // Get a piece of a log segment.
@@ -141,7 +151,7 @@ class TabletCopySourceSession : public RefCountedThreadSafe<TabletCopySourceSess
   // is only for sending WAL segment files.
   Status GetLogSegmentPiece(uint64_t segment_seqno,
                             uint64_t offset, int64_t client_maxlen,
-                            std::string* data, int64_t* log_file_size,
+                            faststring* data, int64_t* log_file_size,
                             TabletCopyErrorPB::Code* error_code);
 
   const tablet::TabletSuperBlockPB& tablet_superblock() const {
@@ -50,9 +50,12 @@
 #include "kudu/common/wire_protocol-test-util.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/consensus.proxy.h"
 #include "kudu/consensus/log-test-base.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/raft_consensus.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/fs-test-util.h"
@@ -75,6 +78,7 @@
 #include "kudu/server/server_base.pb.h"
 #include "kudu/server/server_base.proxy.h"
 #include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_replica.h"
@@ -97,6 +101,7 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/logging_test_util.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
@@ -148,6 +153,7 @@ DECLARE_bool(crash_on_eio);
 DECLARE_bool(enable_maintenance_manager);
 DECLARE_bool(fail_dns_resolution);
 DECLARE_bool(rowset_metadata_store_keys);
+DECLARE_bool(scanner_prefetch_batches);
 DECLARE_double(cfile_inject_corruption);
 DECLARE_double(env_inject_eio);
 DECLARE_int32(flush_threshold_mb);
@@ -1838,6 +1844,48 @@ TEST_F(TabletServerTest, TestSnapshotScan_WithoutSnapshotTimestamp) {
   ASSERT_GT(resp.propagated_timestamp(), resp.snap_timestamp());
 }
 
+// Tests that a snapshot scan with a maximum staleness is served at the MVCC
+// clean timestamp, which is in the past, and reports that timestamp back.
+TEST_F(TabletServerTest, TestSnapshotScan_WithMaxStaleness) {
+  vector<uint64_t> write_timestamps_collector;
+  // perform a write
+  InsertTestRowsRemote(0, 1, 1, nullptr, kTabletId, &write_timestamps_collector);
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  // Set up a new request with no predicates, all columns.
+  const Schema& projection = schema_;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(projection, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(0); // so it won't return data right away
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  scan->set_max_staleness_us(60 * 1000 * 1000);
+
+  const Timestamp pre_scan_ts = mini_server_->server()->clock()->Now();
+
+  // Send the call
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+  }
+
+  // The snapshot timestamp must be within the staleness bound, and at or
+  // before the clean timestamp, so the scan didn't have to wait.
+  ASSERT_TRUE(resp.has_snap_timestamp());
+  ASSERT_LT(resp.snap_timestamp(), mini_server_->server()->clock()->Now().ToUint64());
+  ASSERT_GE(resp.snap_timestamp(),
+            HybridClock::AddPhysicalTimeToTimestamp(
+                pre_scan_ts, MonoDelta::FromSeconds(-60)).ToUint64());
+  ASSERT_LE(resp.snap_timestamp(),
+            tablet_replica_->tablet()->mvcc_manager()->GetCleanTimestamp().ToUint64());
+}
+
 // Tests that a snapshot in the future (beyond the current time plus maximum
 // synchronization error) fails as an invalid snapshot.
 TEST_F(TabletServerTest, TestSnapshotScan_SnapshotInTheFutureFails) {
@@ -2244,6 +2292,44 @@ TEST_F(TabletServerTest, TestRandomizedScanLimits) {
   }
 }
 
+// Test that scans return the same rows whether or not their batches are
+// prefetched, and that the prefetched batches are released.
+TEST_F(TabletServerTest, TestScanWithPrefetchedBatches) {
+  // Use small row blocks, such that the scans have several batches.
+  FLAGS_scanner_batch_size_rows = 10;
+  const int64_t kNumRows = 1000;
+  InsertTestRowsDirect(0, kNumRows);
+
+  for (int64_t limit : { kNumRows, kNumRows / 3 }) {
+    vector<string> results[2];
+    for (bool prefetch : { false, true }) {
+      FLAGS_scanner_prefetch_batches = prefetch;
+      ScanRequestPB req;
+      ScanResponsePB resp;
+      RpcController rpc;
+      NewScanRequestPB* scan = req.mutable_new_scan_request();
+      scan->set_tablet_id(kTabletId);
+      scan->set_limit(limit);
+      req.set_batch_size_bytes(0); // so it won't return data right away
+      ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+      {
+        SCOPED_TRACE(SecureDebugString(req));
+        ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+        SCOPED_TRACE(SecureDebugString(resp));
+        ASSERT_FALSE(resp.has_error());
+      }
+      NO_FATALS(DrainScannerToStrings(resp.scanner_id(), schema_, &results[prefetch]));
+    }
+    ASSERT_EQ(limit, static_cast<int64_t>(results[1].size()));
+    ASSERT_EQ(results[0], results[1]);
+  }
+
+  const auto& mem_tracker = mini_server_->server()->scanner_manager()->prefetch_mem_tracker();
+  ASSERT_EVENTUALLY([&] {
+    ASSERT_EQ(0, mem_tracker->consumption());
+  });
+}
+
 TEST_F(TabletServerTest, TestScanWithPredicates) {
   int num_rows = AllowSlowTests() ? 10000 : 1000;
   InsertTestRowsDirect(0, num_rows);
@@ -3010,6 +3096,56 @@ TEST_F(TabletServerTest, TestRpcServerCreateDestroy) {
   }
 }
 
+// Tests that each request of a MultiRaftUpdateConsensus batch fails, or
+// succeeds, on its own, with its response in the same position.
+TEST_F(TabletServerTest, TestMultiRaftUpdateConsensusErrors) {
+  consensus::MultiRaftConsensusRequestPB req;
+  consensus::ConsensusRequestPB* missing_tablet = req.add_requests();
+  missing_tablet->set_tablet_id("does-not-exist");
+  missing_tablet->set_dest_uuid(mini_server_->uuid());
+  missing_tablet->set_caller_uuid("leader");
+  missing_tablet->set_caller_term(1);
+  consensus::ConsensusRequestPB* wrong_uuid = req.add_requests();
+  wrong_uuid->set_tablet_id(kTabletId);
+  wrong_uuid->set_dest_uuid("wrong-uuid");
+  wrong_uuid->set_caller_uuid("leader");
+  wrong_uuid->set_caller_term(1);
+
+  consensus::MultiRaftConsensusResponsePB resp;
+  rpc::RpcController controller;
+  controller.RequireServerFeature(consensus::MULTI_RAFT_UPDATE);
+  ASSERT_OK(consensus_proxy_->MultiRaftUpdateConsensus(req, &resp, &controller));
+  ASSERT_EQ(2, resp.responses_size());
+  ASSERT_TRUE(resp.responses(0).has_error());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(0).error().code());
+  ASSERT_TRUE(resp.responses(1).has_error());
+  ASSERT_EQ(TabletServerErrorPB::WRONG_SERVER_UUID, resp.responses(1).error().code());
+}
+
+TEST_F(TabletServerTest, TestMultiRaftRequestConsensusVoteErrors) {
+  consensus::MultiRaftVoteRequestPB req;
+  consensus::VoteRequestPB* missing_tablet = req.add_requests();
+  missing_tablet->set_tablet_id("does-not-exist");
+  missing_tablet->set_dest_uuid(mini_server_->uuid());
+  missing_tablet->set_candidate_uuid("candidate");
+  missing_tablet->set_candidate_term(1);
+  missing_tablet->mutable_candidate_status()->mutable_last_received()->CopyFrom(consensus::MinimumOpId());
+  consensus::VoteRequestPB* wrong_uuid = req.add_requests();
+  wrong_uuid->CopyFrom(*missing_tablet);
+  wrong_uuid->set_tablet_id(kTabletId);
+  wrong_uuid->set_dest_uuid("wrong-uuid");
+
+  consensus::MultiRaftVoteResponsePB resp;
+  rpc::RpcController controller;
+  controller.RequireServerFeature(consensus::MULTI_RAFT_VOTE);
+  ASSERT_OK(consensus_proxy_->MultiRaftRequestConsensusVote(req, &resp, &controller));
+  ASSERT_EQ(2, resp.responses_size());
+  ASSERT_TRUE(resp.responses(0).has_error());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(0).error().code());
+  ASSERT_TRUE(resp.responses(1).has_error());
+  ASSERT_EQ(TabletServerErrorPB::WRONG_SERVER_UUID, resp.responses(1).error().code());
+}
+
 TEST_F(TabletServerTest, TestWriteOutOfBounds) {
   const char *tabletId = "TestWriteOutOfBoundsTablet";
   Schema schema = SchemaBuilder(schema_).Build();
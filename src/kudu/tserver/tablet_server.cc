@@ -22,6 +22,7 @@
 #include <type_traits>
 #include <utility>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/cfile/block_cache.h"
@@ -32,15 +33,38 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/tserver/heartbeater.h"
+#include "kudu/tserver/scan_scheduler.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_copy_service.h"
 #include "kudu/tserver/tablet_service.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver_path_handlers.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/status.h"
 
+DEFINE_int32(scan_pool_num_threads, 0,
+             "Number of threads on which scans run, separately from the RPC "
+             "service threads, so that scans don't hold up other requests. "
+             "The threads are shared between tenants with weighted fair "
+             "queuing; see --scan_pool_tenant. If 0, scans run on the RPC "
+             "service threads.");
+TAG_FLAG(scan_pool_num_threads, experimental);
+
+DEFINE_string(scan_pool_tenant_weights, "",
+              "Comma-separated list of <tenant>:<weight> pairs, which set the "
+              "shares of the scan pool's CPU time of the tenants they name "
+              "relative to other tenants, whose weight is 1.");
+TAG_FLAG(scan_pool_tenant_weights, experimental);
+
+DEFINE_int32(consensus_service_num_threads, 0,
+             "Number of RPC service threads of the consensus service. With "
+             "--consensus_service_async_updates, updates don't hold a thread "
+             "while their ops are made durable, so a few threads are enough. "
+             "If 0, --rpc_num_service_threads.");
+TAG_FLAG(consensus_service_num_threads, experimental);
+
 using std::string;
 using kudu::fs::ErrorHandlerType;
 using kudu::rpc::ServiceIf;
@@ -55,6 +79,7 @@ TabletServer::TabletServer(const TabletServerOptions& opts)
     opts_(opts),
     tablet_manager_(new TSTabletManager(this)),
     scanner_manager_(new ScannerManager(metric_entity())),
+    scan_scheduler_(new ScanScheduler()),
     path_handlers_(new TabletServerPathHandlers(this)) {
 }
 
@@ -89,6 +114,11 @@ Status TabletServer::Init() {
   RETURN_NOT_OK(ValidateMasterAddressResolution());
 
   RETURN_NOT_OK(KuduServer::Init());
+
+  // The tablets may read blocks from the cache as soon as they bootstrap.
+  RETURN_NOT_OK_PREPEND(cfile::BlockCache::GetSingleton()->ValidateRestoredBlocks(
+                            fs_manager_->block_manager()),
+                        "Could not validate the restored block cache entries");
   if (web_server_) {
     RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
   }
@@ -103,6 +133,14 @@ Status TabletServer::Init() {
 
   RETURN_NOT_OK_PREPEND(scanner_manager_->StartRemovalThread(),
                         "Could not start expired Scanner removal thread");
+  RETURN_NOT_OK_PREPEND(scanner_manager_->StartPrefetchPool(mem_tracker()),
+                        "Could not start Scanner prefetch pool");
+
+  if (FLAGS_scan_pool_num_threads > 0) {
+    RETURN_NOT_OK_PREPEND(scan_scheduler_->Start(FLAGS_scan_pool_num_threads,
+                                                 FLAGS_scan_pool_tenant_weights),
+                          "Could not start scan pool");
+  }
 
   initted_ = true;
   return Status::OK();
@@ -128,7 +166,8 @@ Status TabletServer::Start() {
 
   RETURN_NOT_OK(RegisterService(std::move(ts_service)));
   RETURN_NOT_OK(RegisterService(std::move(admin_service)));
-  RETURN_NOT_OK(RegisterService(std::move(consensus_service)));
+  RETURN_NOT_OK(RegisterService(std::move(consensus_service),
+                                FLAGS_consensus_service_num_threads));
   RETURN_NOT_OK(RegisterService(std::move(tablet_copy_service)));
   RETURN_NOT_OK(KuduServer::Start());
 
@@ -145,7 +184,9 @@ void TabletServer::Shutdown() {
     string name = ToString();
     LOG(INFO) << name << " shutting down...";
 
-    // 1. Stop accepting new RPCs.
+    // 1. Stop accepting new RPCs. The queued scans are run first, since they
+    // refer to the tablet service.
+    scan_scheduler_->Shutdown();
     UnregisterAllServices();
 
     // 2. Shut down the tserver's subsystems.
@@ -153,7 +194,10 @@ void TabletServer::Shutdown() {
     WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
     fs_manager_->UnsetErrorNotificationCb(ErrorHandlerType::DISK_ERROR);
     fs_manager_->UnsetErrorNotificationCb(ErrorHandlerType::CFILE_CORRUPTION);
+    scanner_manager_->Shutdown();
     tablet_manager_->Shutdown();
+    WARN_NOT_OK(cfile::BlockCache::GetSingleton()->Persist(),
+                "Failed to persist the block cache");
 
     // 3. Shut down generic subsystems.
     KuduServer::Shutdown();
@@ -35,6 +35,7 @@ class MaintenanceManager;
 namespace tserver {
 
 class Heartbeater;
+class ScanScheduler;
 class ScannerManager;
 class TabletServerPathHandlers;
 class TSTabletManager;
@@ -68,6 +69,8 @@ class TabletServer : public kserver::KuduServer {
 
   ScannerManager* scanner_manager() { return scanner_manager_.get(); }
 
+  ScanScheduler* scan_scheduler() { return scan_scheduler_.get(); }
+
   Heartbeater* heartbeater() { return heartbeater_.get(); }
 
   void set_fail_heartbeats_for_tests(bool fail_heartbeats_for_tests) {
@@ -103,6 +106,10 @@ class TabletServer : public kserver::KuduServer {
   // dependencies.
   gscoped_ptr<ScannerManager> scanner_manager_;
 
+  // Scheduler of scans on their own threads. If --scan_pool_num_threads is
+  // 0, it isn't started and scans run on the RPC service threads.
+  gscoped_ptr<ScanScheduler> scan_scheduler_;
+
   // Thread responsible for heartbeating to the master.
   gscoped_ptr<Heartbeater> heartbeater_;
 
@@ -35,6 +35,7 @@
 #include <glog/logging.h>
 
 #include "kudu/clock/clock.h"
+#include "kudu/clock/hybrid_clock.h"
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/common.pb.h"
@@ -52,6 +53,7 @@
 #include "kudu/common/wire_protocol.pb.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/opid.pb.h"
+#include "kudu/consensus/ops_sidecar.h"
 #include "kudu/consensus/raft_consensus.h"
 #include "kudu/consensus/replica_management.pb.h"
 #include "kudu/consensus/time_manager.h"
@@ -77,6 +79,7 @@
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/tserver/scan_scheduler.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_replica_lookup.h"
 #include "kudu/tserver/tablet_server.h"
@@ -90,14 +93,18 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/process_memory.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/util/status_callback.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/trace_metrics.h"
 
@@ -117,6 +124,32 @@ DEFINE_int32(scanner_batch_size_rows, 100,
 TAG_FLAG(scanner_batch_size_rows, advanced);
 TAG_FLAG(scanner_batch_size_rows, runtime);
 
+DEFINE_bool(scanner_prefetch_batches, false,
+            "Whether to scan the next batch of a scanner in the background "
+            "after returning a batch, so that the next continuation of the "
+            "scan returns without waiting for the tablet. The memory and "
+            "threads used are bounded by --scanner_prefetch_memory_limit_bytes "
+            "and --scanner_prefetch_num_threads.");
+TAG_FLAG(scanner_prefetch_batches, experimental);
+TAG_FLAG(scanner_prefetch_batches, runtime);
+
+DEFINE_string(scan_pool_tenant, "user",
+              "The tenants between which the scan pool's threads are shared "
+              "fairly, if --scan_pool_num_threads is positive: 'user' to share "
+              "them between the users who run scans, or 'table' to share "
+              "them between the tables scanned.");
+TAG_FLAG(scan_pool_tenant, experimental);
+TAG_FLAG(scan_pool_tenant, runtime);
+static bool ValidateScanPoolTenant(const char* flagname, const string& value) {
+  if (value == "user" || value == "table") {
+    return true;
+  }
+  LOG(ERROR) << Substitute("invalid value for --$0: '$1': must be 'user' or 'table'",
+                           flagname, value);
+  return false;
+}
+DEFINE_validator(scan_pool_tenant, &ValidateScanPoolTenant);
+
 DEFINE_bool(scanner_allow_snapshot_scans_with_logical_timestamps, false,
             "If set, the server will support snapshot scans with logical timestamps.");
 TAG_FLAG(scanner_allow_snapshot_scans_with_logical_timestamps, unsafe);
@@ -139,6 +172,15 @@ DEFINE_bool(scanner_inject_service_unavailable_on_continue_scan, false,
            "any Scan continuation RPC call. Used for tests.");
 TAG_FLAG(scanner_inject_service_unavailable_on_continue_scan, unsafe);
 
+DEFINE_bool(consensus_service_async_updates, false,
+            "Whether UpdateConsensus requests release their service thread once "
+            "their ops are appended to the WAL, and are responded to by the WAL "
+            "once the ops are durable, rather than blocking the service thread "
+            "until then. Fewer service threads are then needed to keep up with "
+            "the leaders, see --consensus_service_num_threads.");
+TAG_FLAG(consensus_service_async_updates, experimental);
+TAG_FLAG(consensus_service_async_updates, runtime);
+
 DECLARE_bool(raft_prepare_replacement_before_eviction);
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 DECLARE_int32(tablet_history_max_age_sec);
@@ -155,6 +197,10 @@ using kudu::consensus::GetNodeInstanceResponsePB;
 using kudu::consensus::LeaderStepDownMode;
 using kudu::consensus::LeaderStepDownRequestPB;
 using kudu::consensus::LeaderStepDownResponsePB;
+using kudu::consensus::MultiRaftConsensusRequestPB;
+using kudu::consensus::MultiRaftConsensusResponsePB;
+using kudu::consensus::MultiRaftVoteRequestPB;
+using kudu::consensus::MultiRaftVoteResponsePB;
 using kudu::consensus::OpId;
 using kudu::consensus::RaftConsensus;
 using kudu::consensus::RunLeaderElectionRequestPB;
@@ -217,24 +263,34 @@ bool LookupTabletReplicaOrRespond(TabletReplicaLookupIf* tablet_manager,
   return true;
 }
 
-template<class RespClass>
-void RespondTabletNotRunning(const scoped_refptr<TabletReplica>& replica,
+// Return the error for 'replica' not being RUNNING but in 'tablet_state',
+// setting 'error_code' to the code to respond with.
+Status TabletNotRunningError(const scoped_refptr<TabletReplica>& replica,
                              tablet::TabletStatePB tablet_state,
-                             RespClass* resp,
-                             rpc::RpcContext* context) {
+                             TabletServerErrorPB::Code* error_code) {
   Status s = Status::IllegalState("Tablet not RUNNING",
                                   tablet::TabletStatePB_Name(tablet_state));
-  auto error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+  *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
   if (replica->tablet_metadata()->tablet_data_state() == TABLET_DATA_TOMBSTONED ||
       replica->tablet_metadata()->tablet_data_state() == TABLET_DATA_DELETED) {
     // Treat tombstoned tablets as if they don't exist for most purposes.
     // This takes precedence over failed, since we don't reset the failed
     // status of a TabletReplica when deleting it. Only tablet copy does that.
-    error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
   } else if (tablet_state == tablet::FAILED) {
     s = s.CloneAndAppend(replica->error().ToString());
-    error_code = TabletServerErrorPB::TABLET_FAILED;
+    *error_code = TabletServerErrorPB::TABLET_FAILED;
   }
+  return s;
+}
+
+template<class RespClass>
+void RespondTabletNotRunning(const scoped_refptr<TabletReplica>& replica,
+                             tablet::TabletStatePB tablet_state,
+                             RespClass* resp,
+                             rpc::RpcContext* context) {
+  TabletServerErrorPB::Code error_code;
+  Status s = TabletNotRunningError(replica, tablet_state, &error_code);
   SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
 }
 
@@ -451,6 +507,15 @@ class ScanResultCollector {
   //
   // Does nothing by default.
   virtual void set_row_format_flags(uint64_t /* row_format_flags */) {}
+
+  // Whether the batches of this collector may be prefetched by the scanner,
+  // in which case UsePrefetchedBatch() replaces the results collected so
+  // far with a prefetched batch. False by default.
+  virtual bool supports_prefetch() const { return false; }
+
+  virtual void UsePrefetchedBatch(SerializedScanBatch* /* batch */) {
+    LOG(FATAL) << "Prefetched batches not supported";
+  }
 };
 
 namespace {
@@ -484,14 +549,10 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
 // server-side scan and thus never need to return the actual data.)
 class ScanResultCopier : public ScanResultCollector {
  public:
-  ScanResultCopier(RowwiseRowBlockPB* rowblock_pb,
-                   faststring* rows_data,
-                   faststring* indirect_data)
-      : rowblock_pb_(DCHECK_NOTNULL(rowblock_pb)),
-        rows_data_(DCHECK_NOTNULL(rows_data)),
-        indirect_data_(DCHECK_NOTNULL(indirect_data)),
-        num_rows_returned_(0),
-        pad_unixtime_micros_to_16_bytes_(false) {}
+  explicit ScanResultCopier(SerializedScanBatch* batch)
+      : batch_(DCHECK_NOTNULL(batch)),
+        pad_unixtime_micros_to_16_bytes_(false),
+        columnar_(false) {}
 
   void HandleRowBlock(Scanner* scanner, const RowBlock& row_block) override {
     int64_t num_selected = row_block.selection_vector()->CountSelected();
@@ -499,39 +560,68 @@ class ScanResultCopier : public ScanResultCollector {
     // all rows in the block were deleted)
     if (num_selected == 0) return;
 
-    num_rows_returned_ += num_selected;
+    batch_->num_rows_returned += num_selected;
     scanner->add_num_rows_returned(num_selected);
-    SerializeRowBlock(row_block, rowblock_pb_, scanner->client_projection_schema(),
-                      rows_data_, indirect_data_, pad_unixtime_micros_to_16_bytes_);
-    SetLastRow(row_block, &last_primary_key_);
+    if (columnar_) {
+      SerializeRowBlockColumnar(row_block, scanner->client_projection_schema(),
+                                &batch_->columnar_batch);
+    } else {
+      SerializeRowBlock(row_block, &batch_->rowblock_pb, scanner->client_projection_schema(),
+                        batch_->rows_data.get(), batch_->indirect_data.get(),
+                        pad_unixtime_micros_to_16_bytes_);
+    }
+    SetLastRow(row_block, &batch_->last_primary_key);
   }
 
   // Returns number of bytes buffered to return.
   int64_t ResponseSize() const override {
-    return rows_data_->size() + indirect_data_->size();
+    if (columnar_) {
+      return batch_->columnar_batch.size();
+    }
+    return batch_->rows_data->size() + batch_->indirect_data->size();
   }
 
   const faststring& last_primary_key() const override {
-    return last_primary_key_;
+    return batch_->last_primary_key;
   }
 
   int64_t NumRowsReturned() const override {
-    return num_rows_returned_;
+    return batch_->num_rows_returned;
+  }
+
+  bool supports_prefetch() const override { return true; }
+
+  void UsePrefetchedBatch(SerializedScanBatch* batch) override {
+    DCHECK_EQ(0, batch_->num_rows_returned);
+    batch_->rowblock_pb.Swap(&batch->rowblock_pb);
+    batch_->rows_data.swap(batch->rows_data);
+    batch_->indirect_data.swap(batch->indirect_data);
+    batch_->columnar_batch = std::move(batch->columnar_batch);
+    batch_->last_primary_key.assign_copy(batch->last_primary_key.data(),
+                                         batch->last_primary_key.size());
+    batch_->num_rows_returned = batch->num_rows_returned;
+    batch_->consumption = std::move(batch->consumption);
   }
 
   void set_row_format_flags(uint64_t row_format_flags) override {
     if (row_format_flags & RowFormatFlags::PAD_UNIX_TIME_MICROS_TO_16_BYTES) {
       pad_unixtime_micros_to_16_bytes_ = true;
     }
+    if (row_format_flags & RowFormatFlags::COLUMNAR_LAYOUT) {
+      columnar_ = true;
+    }
   }
 
+  // Whether the rows are collected in the columnar layout, in which case
+  // they're in columnar_batch() rather than the row block PB and buffers.
+  bool columnar() const { return columnar_; }
+
+  ColumnarSerializedBatch* columnar_batch() { return &batch_->columnar_batch; }
+
  private:
-  RowwiseRowBlockPB* const rowblock_pb_;
-  faststring* const rows_data_;
-  faststring* const indirect_data_;
-  int64_t num_rows_returned_;
-  faststring last_primary_key_;
+  SerializedScanBatch* const batch_;
   bool pad_unixtime_micros_to_16_bytes_;
+  bool columnar_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanResultCopier);
 };
@@ -631,6 +721,124 @@ static size_t GetMaxBatchSizeBytesHint(const ScanRequestPB* req) {
                   implicit_cast<uint32_t>(FLAGS_scanner_max_batch_size_bytes));
 }
 
+namespace {
+
+// Scans the next batch of 'scanner' into 'collector', until the collected
+// results reach 'batch_size_bytes', the scan is complete, or the time budget
+// of a batch is spent. Sets 'rows_scanned' to the number of rows scanned,
+// regardless of predicates or deletions.
+Status CollectScanBatch(Scanner* scanner,
+                        size_t batch_size_bytes,
+                        ScanResultCollector* collector,
+                        int64_t* rows_scanned) {
+  RowwiseIterator* iter = scanner->iter();
+
+  Stopwatch sw(Stopwatch::THIS_THREAD);
+  sw.start();
+  SCOPED_CLEANUP({
+    sw.stop();
+    CpuTimes elapsed = sw.elapsed();
+    scanner->add_cpu_time(MonoDelta::FromNanoseconds(elapsed.user + elapsed.system));
+  });
+
+  // TODO(todd): could size the RowBlock based on the user's requested batch size?
+  // If people had really large indirect objects, we would currently overshoot
+  // their requested batch size by a lot.
+  Arena arena(32 * 1024);
+  RowBlock block(iter->schema(), FLAGS_scanner_batch_size_rows, &arena);
+
+  // TODO(todd): in the future, use the client timeout to set a budget. For now,
+  // just use a half second, which should be plenty to amortize call overhead.
+  int budget_ms = 500;
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(budget_ms);
+
+  *rows_scanned = 0;
+  while (iter->HasNext() && !scanner->has_fulfilled_limit()) {
+    if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
+      SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
+    }
+
+    RETURN_NOT_OK(iter->NextBlock(&block));
+
+    if (PREDICT_TRUE(block.nrows() > 0)) {
+      // Count the number of rows scanned, regardless of predicates or deletions.
+      // The collector will separately count the number of rows actually returned to
+      // the client.
+      *rows_scanned += block.nrows();
+      if (scanner->spec().has_limit()) {
+        int64_t rows_left = scanner->spec().limit() - scanner->num_rows_returned();
+        DCHECK_GT(rows_left, 0);  // Guaranteed by has_fulfilled_limit()
+        block.selection_vector()->ClearToSelectAtMost(static_cast<size_t>(rows_left));
+      }
+      collector->HandleRowBlock(scanner, block);
+    }
+
+    int64_t response_size = collector->ResponseSize();
+
+    if (VLOG_IS_ON(2)) {
+      // This may be fairly expensive if row block size is small
+      TRACE("Copied block (nrows=$0), new size=$1", block.nrows(), response_size);
+    }
+
+    // TODO: should check if RPC got cancelled, once we implement RPC cancellation.
+    if (PREDICT_FALSE(MonoTime::Now() >= deadline)) {
+      TRACE("Deadline expired - responding early");
+      break;
+    }
+
+    if (response_size >= batch_size_bytes) {
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+// Scans the next batch of 'scanner', and publishes it to be returned by the
+// next continuation of the scan.
+void PrefetchNextBatch(const SharedScanner& scanner,
+                       size_t batch_size_bytes,
+                       const shared_ptr<MemTracker>& mem_tracker) {
+  unique_ptr<SerializedScanBatch> batch(new SerializedScanBatch(batch_size_bytes * 11 / 10));
+  batch->consumption.reset(new ScopedTrackedConsumption(mem_tracker,
+                                                        batch->memory_footprint()));
+  ScanResultCopier collector(batch.get());
+  collector.set_row_format_flags(scanner->row_format_flags());
+  batch->status = CollectScanBatch(scanner.get(), batch_size_bytes, &collector,
+                                   &batch->rows_scanned);
+  batch->consumption->Reset(batch->memory_footprint());
+  scanner->FinishPrefetch(std::move(batch));
+}
+
+// Schedules the prefetch of the next batch of 'scanner' on the prefetch pool
+// of 'manager', unless the prefetched batches already hold as much memory as
+// they may.
+void SchedulePrefetch(ScannerManager* manager,
+                      const SharedScanner& scanner,
+                      size_t batch_size_bytes) {
+  ThreadPool* pool = manager->prefetch_pool();
+  if (!pool) {
+    return;
+  }
+  shared_ptr<MemTracker> mem_tracker = manager->prefetch_mem_tracker();
+  // The row-wise buffers of the batch are preallocated.
+  if (mem_tracker->SpareCapacity() < 2 * (batch_size_bytes * 11 / 10)) {
+    TRACE("Not prefetching the next batch: memory limit reached");
+    return;
+  }
+  if (!scanner->StartPrefetch()) {
+    return;
+  }
+  Status s = pool->SubmitFunc([scanner, batch_size_bytes, mem_tracker]() {
+      PrefetchNextBatch(scanner, batch_size_bytes, mem_tracker);
+    });
+  if (PREDICT_FALSE(!s.ok())) {
+    WARN_NOT_OK(s, Substitute("Could not prefetch the next batch of scanner $0", scanner->id()));
+    scanner->FinishPrefetch(nullptr);
+  }
+}
+
+} // anonymous namespace
+
 TabletServiceImpl::TabletServiceImpl(TabletServer* server)
   : TabletServerServiceIf(server->metric_entity(), server->result_tracker()),
     server_(server) {
@@ -897,6 +1105,10 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
       req,
       context->AreResultsTracked() ? context->request_id() : nullptr,
       resp));
+  // The request is owned by the RPC context and isn't read again once the
+  // write is submitted, so its row data can be moved into the REPLICATE
+  // message rather than copied.
+  tx_state->set_request_movable(const_cast<WriteRequestPB*>(req));
 
   // If the client sent us a timestamp, decode it and update the clock so that all future
   // timestamps are greater than the passed timestamp.
@@ -915,6 +1127,16 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
       new RpcTransactionCompletionCallback<WriteResponsePB>(context,
                                                             resp)));
 
+  // Let the client know whether the leader is applying backpressure to writes,
+  // before the response may be sent.
+  shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+  if (consensus) {
+    int64_t admission_delay_us = consensus->admission_delay_us();
+    if (admission_delay_us > 0) {
+      resp->set_admission_delay_us(admission_delay_us);
+    }
+  }
+
   // Submit the write. The RPC will be responded to asynchronously.
   s = replica->SubmitWrite(std::move(tx_state));
 
@@ -942,6 +1164,18 @@ bool ConsensusServiceImpl::AuthorizeServiceUser(const google::protobuf::Message*
   return server_->Authorize(rpc, ServerBase::SUPER_USER | ServerBase::SERVICE_USER);
 }
 
+bool ConsensusServiceImpl::SupportsFeature(uint32_t feature) const {
+  switch (feature) {
+    case consensus::OPS_SIDECAR:
+    case consensus::COMPRESSED_OPS_SIDECAR:
+    case consensus::MULTI_RAFT_UPDATE:
+    case consensus::MULTI_RAFT_VOTE:
+      return true;
+    default:
+      return false;
+  }
+}
+
 void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
                                            ConsensusResponsePB* resp,
                                            rpc::RpcContext* context) {
@@ -949,30 +1183,124 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   if (!CheckUuidMatchOrRespond(tablet_manager_, "UpdateConsensus", req, resp, context)) {
     return;
   }
-  scoped_refptr<TabletReplica> replica;
-  if (!LookupRunningTabletReplicaOrRespond(tablet_manager_, req->tablet_id(), resp, context,
-                                           &replica)) {
-    return;
+  StdStatusCallback done;
+  if (FLAGS_consensus_service_async_updates) {
+    done = [resp, context](const Status& s) {
+      if (PREDICT_FALSE(!s.ok())) {
+        resp->Clear();
+        SetupErrorAndRespond(resp->mutable_error(), s,
+                             TabletServerErrorPB::UNKNOWN_ERROR, context);
+        return;
+      }
+      context->RespondSuccess();
+    };
   }
-
-  // Submit the update directly to the TabletReplica's RaftConsensus instance.
-  shared_ptr<RaftConsensus> consensus;
-  if (!GetConsensusOrRespond(replica, resp, context, &consensus)) return;
-  Status s = consensus->Update(req, resp);
+  TabletServerErrorPB::Code error_code;
+  Status s = DoUpdateConsensus(req, resp, context, &error_code, done);
   if (PREDICT_FALSE(!s.ok())) {
     // Clear the response first, since a partially-filled response could
     // result in confusing a caller, or in having missing required fields
     // in embedded optional messages.
     resp->Clear();
 
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
     return;
   }
+  // Otherwise 'done' responds.
+  if (!done) {
+    context->RespondSuccess();
+  }
+}
+
+void ConsensusServiceImpl::MultiRaftUpdateConsensus(const MultiRaftConsensusRequestPB* req,
+                                                    MultiRaftConsensusResponsePB* resp,
+                                                    rpc::RpcContext* context) {
+  DVLOG(3) << "Received MultiRaftUpdateConsensus RPC with " << req->requests_size()
+           << " requests";
+  const string& local_uuid = tablet_manager_->NodeInstance().permanent_uuid();
+  // The requests are run one after another; each fails or succeeds on its
+  // own, and the batch RPC itself always succeeds.
+  for (const ConsensusRequestPB& tablet_req : req->requests()) {
+    ConsensusResponsePB* tablet_resp = resp->add_responses();
+    TabletServerErrorPB::Code error_code;
+    Status s;
+    if (PREDICT_FALSE(tablet_req.dest_uuid() != local_uuid)) {
+      s = Status::InvalidArgument(Substitute("MultiRaftUpdateConsensus: Wrong destination UUID "
+                                             "requested. Local UUID: $0. Requested UUID: $1",
+                                             local_uuid, tablet_req.dest_uuid()));
+      error_code = TabletServerErrorPB::WRONG_SERVER_UUID;
+    } else {
+      s = DoUpdateConsensus(&tablet_req, tablet_resp, context, &error_code);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      tablet_resp->Clear();
+      StatusToPB(s, tablet_resp->mutable_error()->mutable_status());
+      tablet_resp->mutable_error()->set_code(error_code);
+    }
+  }
   context->RespondSuccess();
 }
 
+Status ConsensusServiceImpl::DoUpdateConsensus(const ConsensusRequestPB* req,
+                                               ConsensusResponsePB* resp,
+                                               rpc::RpcContext* context,
+                                               TabletServerErrorPB::Code* error_code) {
+  scoped_refptr<TabletReplica> replica;
+  Status s = tablet_manager_->GetTabletReplica(req->tablet_id(), &replica);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    return s;
+  }
+  tablet::TabletStatePB state = replica->state();
+  if (PREDICT_FALSE(state != tablet::RUNNING)) {
+    return TabletNotRunningError(replica, state, error_code);
+  }
+
+  // Submit the update directly to the TabletReplica's RaftConsensus instance.
+  shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+  if (PREDICT_FALSE(!consensus)) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return Status::ServiceUnavailable("Raft Consensus unavailable",
+                                      "Tablet replica not initialized");
+  }
+
+  // If the leader shipped the ops in a sidecar, decode them into a copy of the
+  // request. The copy is cheap since the request itself carries no ops.
+  ConsensusRequestPB decoded_req;
+  if (req->has_ops_sidecar_idx()) {
+    Slice ops_sidecar;
+    s = context->GetInboundSidecar(req->ops_sidecar_idx(), &ops_sidecar);
+    if (s.ok()) {
+      decoded_req = *req;
+      decoded_req.clear_ops_sidecar_idx();
+      decoded_req.clear_ops_sidecar_compression();
+      s = consensus::DecodeOpsFromSidecar(ops_sidecar, req->ops_sidecar_compression(),
+                                          &decoded_req);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+      return s.CloneAndPrepend("Invalid ops sidecar");
+    }
+    req = &decoded_req;
+  } else if (req->GetArena() != nullptr && req->ops_size() > 0) {
+    // The replica takes ownership of the ops, which must then outlive the
+    // arena the request was parsed on.
+    decoded_req = *req;
+    req = &decoded_req;
+  }
+
+  if (done) {
+    consensus->UpdateAsync(req, resp, std::move(done));
+    return Status::OK();
+  }
+  s = consensus->Update(req, resp);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    return s;
+  }
+  return Status::OK();
+}
+
 void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
                                                 VoteResponsePB* resp,
                                                 rpc::RpcContext* context) {
@@ -980,7 +1308,47 @@ void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
   if (!CheckUuidMatchOrRespond(tablet_manager_, "RequestConsensusVote", req, resp, context)) {
     return;
   }
+  TabletServerErrorPB::Code error_code;
+  Status s = DoRequestConsensusVote(req, resp, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+  context->RespondSuccess();
+}
+
+void ConsensusServiceImpl::MultiRaftRequestConsensusVote(const MultiRaftVoteRequestPB* req,
+                                                         MultiRaftVoteResponsePB* resp,
+                                                         rpc::RpcContext* context) {
+  DVLOG(3) << "Received MultiRaftRequestConsensusVote RPC with " << req->requests_size()
+           << " requests";
+  const string& local_uuid = tablet_manager_->NodeInstance().permanent_uuid();
+  // As in MultiRaftUpdateConsensus(), each request fails or succeeds on its
+  // own, and the batch RPC itself always succeeds.
+  for (const VoteRequestPB& tablet_req : req->requests()) {
+    VoteResponsePB* tablet_resp = resp->add_responses();
+    TabletServerErrorPB::Code error_code;
+    Status s;
+    if (PREDICT_FALSE(tablet_req.dest_uuid() != local_uuid)) {
+      s = Status::InvalidArgument(Substitute("MultiRaftRequestConsensusVote: Wrong destination "
+                                             "UUID requested. Local UUID: $0. Requested UUID: $1",
+                                             local_uuid, tablet_req.dest_uuid()));
+      error_code = TabletServerErrorPB::WRONG_SERVER_UUID;
+    } else {
+      s = DoRequestConsensusVote(&tablet_req, tablet_resp, &error_code);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      tablet_resp->Clear();
+      StatusToPB(s, tablet_resp->mutable_error()->mutable_status());
+      tablet_resp->mutable_error()->set_code(error_code);
+    }
+  }
+  context->RespondSuccess();
+}
 
+Status ConsensusServiceImpl::DoRequestConsensusVote(const VoteRequestPB* req,
+                                                    VoteResponsePB* resp,
+                                                    TabletServerErrorPB::Code* error_code) {
   // Because the last-logged opid is stored in the TabletMetadata we go through
   // the following dance:
   // 1. Get a reference to the currently-registered TabletReplica.
@@ -999,8 +1367,10 @@ void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
   // to easily "tombstoned vote" while the tablet is bootstrapping.
 
   scoped_refptr<TabletReplica> replica;
-  if (!LookupTabletReplicaOrRespond(tablet_manager_, req->tablet_id(), resp, context, &replica)) {
-    return;
+  Status s = tablet_manager_->GetTabletReplica(req->tablet_id(), &replica);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    return s;
   }
 
   boost::optional<OpId> last_logged_opid;
@@ -1011,8 +1381,7 @@ void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
   // We cannot vote while DELETED. This check is not racy because DELETED is a
   // terminal state; it is not possible to transition out of DELETED.
   if (data_state == TABLET_DATA_DELETED) {
-    RespondTabletNotRunning(replica, replica->state(), resp, context);
-    return;
+    return TabletNotRunningError(replica, replica->state(), error_code);
   }
 
   // Attempt to vote while copying or tombstoned.
@@ -1021,20 +1390,22 @@ void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
   }
 
   // Submit the vote request directly to the consensus instance.
-  shared_ptr<RaftConsensus> consensus;
-  if (!GetConsensusOrRespond(replica, resp, context, &consensus)) return;
+  shared_ptr<RaftConsensus> consensus = replica->shared_consensus();
+  if (PREDICT_FALSE(!consensus)) {
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return Status::ServiceUnavailable("Raft Consensus unavailable",
+                                      "Tablet replica not initialized");
+  }
 
-  Status s = consensus->RequestVote(req,
-                                    consensus::TabletVotingState(std::move(last_logged_opid),
-                                                                 data_state),
-                                    resp);
+  s = consensus->RequestVote(req,
+                             consensus::TabletVotingState(std::move(last_logged_opid),
+                                                          data_state),
+                             resp);
   if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
+    *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    return s;
   }
-  context->RespondSuccess();
+  return Status::OK();
 }
 
 void ConsensusServiceImpl::ChangeConfig(const ChangeConfigRequestPB* req,
@@ -1230,6 +1601,60 @@ void ConsensusServiceImpl::GetLastOpId(const consensus::GetLastOpIdRequestPB *re
   context->RespondSuccess();
 }
 
+void ConsensusServiceImpl::ReadIndex(const consensus::ReadIndexRequestPB* req,
+                                     consensus::ReadIndexResponsePB* resp,
+                                     rpc::RpcContext* context) {
+  DVLOG(3) << "Received ReadIndex RPC: " << SecureDebugString(*req);
+  if (!CheckUuidMatchOrRespond(tablet_manager_, "ReadIndex", req, resp, context)) {
+    return;
+  }
+  scoped_refptr<TabletReplica> replica;
+  if (!LookupRunningTabletReplicaOrRespond(tablet_manager_, req->tablet_id(), resp, context,
+                                           &replica)) {
+    return;
+  }
+  shared_ptr<RaftConsensus> consensus;
+  if (!GetConsensusOrRespond(replica, resp, context, &consensus)) return;
+
+  // This may wait for a round of heartbeats to the followers.
+  int64_t read_index;
+  Status s = consensus->LeaderReadIndex(context->GetClientDeadline(), &read_index);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         TabletServerErrorPB::UNKNOWN_ERROR,
+                         context);
+    return;
+  }
+  resp->set_read_index(read_index);
+  context->RespondSuccess();
+}
+
+void ConsensusServiceImpl::InstallSnapshot(const consensus::InstallSnapshotRequestPB* req,
+                                           consensus::InstallSnapshotResponsePB* resp,
+                                           rpc::RpcContext* context) {
+  DVLOG(3) << "Received InstallSnapshot RPC for tablet " << req->tablet_id()
+           << " at offset " << req->offset();
+  if (!CheckUuidMatchOrRespond(tablet_manager_, "InstallSnapshot", req, resp, context)) {
+    return;
+  }
+  scoped_refptr<TabletReplica> replica;
+  if (!LookupRunningTabletReplicaOrRespond(tablet_manager_, req->tablet_id(), resp, context,
+                                           &replica)) {
+    return;
+  }
+  shared_ptr<RaftConsensus> consensus;
+  if (!GetConsensusOrRespond(replica, resp, context, &consensus)) return;
+
+  Status s = consensus->InstallSnapshot(req, resp);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         TabletServerErrorPB::UNKNOWN_ERROR,
+                         context);
+    return;
+  }
+  context->RespondSuccess();
+}
+
 void ConsensusServiceImpl::GetConsensusState(const consensus::GetConsensusStateRequestPB* req,
                                              consensus::GetConsensusStateResponsePB* resp,
                                              rpc::RpcContext* context) {
@@ -1319,6 +1744,30 @@ void TabletServiceImpl::ScannerKeepAlive(const ScannerKeepAliveRequestPB *req,
 }
 
 namespace {
+// Attaches the buffers of 'batch' to the response as sidecars, and records
+// their indexes in 'pb'.
+void SetColumnarData(ColumnarSerializedBatch* batch, ColumnarRowBlockPB* pb,
+                     rpc::RpcContext* context) {
+  pb->set_num_rows(batch->num_rows);
+  for (auto& col : batch->columns) {
+    ColumnarRowBlockPB::Column* col_pb = pb->add_columns();
+    int idx;
+    CHECK_OK(context->AddOutboundSidecar(
+        RpcSidecar::FromFaststring(std::move(col.data)), &idx));
+    col_pb->set_data_sidecar(idx);
+    if (col.varlen_data && col.varlen_data->size() > 0) {
+      CHECK_OK(context->AddOutboundSidecar(
+          RpcSidecar::FromFaststring(std::move(col.varlen_data)), &idx));
+      col_pb->set_varlen_data_sidecar(idx);
+    }
+    if (col.non_null_bitmap) {
+      CHECK_OK(context->AddOutboundSidecar(
+          RpcSidecar::FromFaststring(std::move(col.non_null_bitmap)), &idx));
+      col_pb->set_non_null_bitmap_sidecar(idx);
+    }
+  }
+}
+
 void SetResourceMetrics(ResourceMetricsPB* metrics, rpc::RpcContext* context) {
   metrics->set_cfile_cache_miss_bytes(
     context->trace()->metrics()->GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME));
@@ -1340,11 +1789,51 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
     return;
   }
 
+  ScanScheduler* scheduler = server_->scan_scheduler();
+  if (scheduler->running()) {
+    Status s = scheduler->Submit(ScanTenant(req, context), [this, req, resp, context]() {
+        ADOPT_TRACE(context->trace());
+        DoScan(req, resp, context);
+      });
+    if (PREDICT_FALSE(!s.ok())) {
+      context->RespondFailure(s);
+    }
+    return;
+  }
+  DoScan(req, resp, context);
+}
+
+string TabletServiceImpl::ScanTenant(const ScanRequestPB* req,
+                                     const rpc::RpcContext* context) {
+  if (FLAGS_scan_pool_tenant == "user") {
+    return context->remote_user().username();
+  }
+  scoped_refptr<TabletReplica> replica;
+  if (req->has_new_scan_request()) {
+    if (!server_->tablet_manager()->LookupTablet(req->new_scan_request().tablet_id(),
+                                                 &replica)) {
+      return "";
+    }
+  } else {
+    SharedScanner scanner;
+    TabletServerErrorPB::Code error_code;
+    if (!server_->scanner_manager()->LookupScanner(req->scanner_id(),
+                                                   context->remote_user().username(),
+                                                   &error_code, &scanner).ok()) {
+      // The scan's continuation will fail anyway, whatever its tenant.
+      return "";
+    }
+    replica = scanner->tablet_replica();
+  }
+  return replica->tablet_metadata()->table_name();
+}
+
+void TabletServiceImpl::DoScan(const ScanRequestPB* req,
+                               ScanResponsePB* resp,
+                               rpc::RpcContext* context) {
   size_t batch_size_bytes = GetMaxBatchSizeBytesHint(req);
-  unique_ptr<faststring> rows_data(new faststring(batch_size_bytes * 11 / 10));
-  unique_ptr<faststring> indirect_data(new faststring(batch_size_bytes * 11 / 10));
-  RowwiseRowBlockPB data;
-  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
+  SerializedScanBatch batch(batch_size_bytes * 11 / 10);
+  ScanResultCopier collector(&batch);
 
   bool has_more_results = false;
   TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
@@ -1385,20 +1874,24 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   }
   resp->set_has_more_results(has_more_results);
 
-  resp->mutable_data()->CopyFrom(data);
-
-  // Add sidecar data to context and record the returned indices.
-  int rows_idx;
-  CHECK_OK(context->AddOutboundSidecar(
-      RpcSidecar::FromFaststring((std::move(rows_data))), &rows_idx));
-  resp->mutable_data()->set_rows_sidecar(rows_idx);
+  if (collector.columnar()) {
+    SetColumnarData(collector.columnar_batch(), resp->mutable_columnar_data(), context);
+  } else {
+    resp->mutable_data()->CopyFrom(batch.rowblock_pb);
 
-  // Add indirect data as a sidecar, if applicable.
-  if (indirect_data->size() > 0) {
-    int indirect_idx;
+    // Add sidecar data to context and record the returned indices.
+    int rows_idx;
     CHECK_OK(context->AddOutboundSidecar(
-        RpcSidecar::FromFaststring(std::move(indirect_data)), &indirect_idx));
-    resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+        RpcSidecar::FromFaststring((std::move(batch.rows_data))), &rows_idx));
+    resp->mutable_data()->set_rows_sidecar(rows_idx);
+
+    // Add indirect data as a sidecar, if applicable.
+    if (batch.indirect_data->size() > 0) {
+      int indirect_idx;
+      CHECK_OK(context->AddOutboundSidecar(
+          RpcSidecar::FromFaststring(std::move(batch.indirect_data)), &indirect_idx));
+      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+    }
   }
 
   // Set the last row found by the collector.
@@ -1611,6 +2104,7 @@ bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
   switch (feature) {
     case TabletServerFeatures::COLUMN_PREDICATES:
     case TabletServerFeatures::PAD_UNIXTIME_MICROS_TO_16_BYTES:
+    case TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE:
       return true;
     default:
       return false;
@@ -2087,6 +2581,10 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   // If we early-exit out of this function, automatically unregister the scanner.
   ScopedUnregisterScanner unreg_scanner(server_->scanner_manager(), scanner->id());
 
+  // Wait for any prefetch of this batch, which has exclusive use of the
+  // iterator until it's done.
+  unique_ptr<SerializedScanBatch> prefetched = scanner->TakePrefetchedBatch();
+
   VLOG(2) << "Found existing scanner " << scanner->id() << " for request: "
           << SecureShortDebugString(*req);
   TRACE("Found scanner $0 for tablet $1", scanner->id(), scanner->tablet_id());
@@ -2105,61 +2603,27 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
 
   RowwiseIterator* iter = scanner->iter();
 
-  // TODO(todd): could size the RowBlock based on the user's requested batch size?
-  // If people had really large indirect objects, we would currently overshoot
-  // their requested batch size by a lot.
-  Arena arena(32 * 1024);
-  RowBlock block(scanner->iter()->schema(),
-                 FLAGS_scanner_batch_size_rows, &arena);
-
-  // TODO(todd): in the future, use the client timeout to set a budget. For now,
-  // just use a half second, which should be plenty to amortize call overhead.
-  int budget_ms = 500;
-  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(budget_ms);
-
   int64_t rows_scanned = 0;
-  while (iter->HasNext() && !scanner->has_fulfilled_limit()) {
-    if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
-      SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
+  if (prefetched) {
+    DCHECK(result_collector->supports_prefetch());
+    if (PREDICT_FALSE(!prefetched->status.ok())) {
+      LOG(WARNING) << "Copying rows from internal iterator for request "
+                   << SecureShortDebugString(*req);
+      *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+      return prefetched->status;
     }
-
-    Status s = iter->NextBlock(&block);
+    TRACE("Returning prefetched batch");
+    rows_scanned = prefetched->rows_scanned;
+    result_collector->UsePrefetchedBatch(prefetched.get());
+  } else {
+    Status s = CollectScanBatch(scanner.get(), batch_size_bytes, result_collector,
+                                &rows_scanned);
     if (PREDICT_FALSE(!s.ok())) {
       LOG(WARNING) << "Copying rows from internal iterator for request "
                    << SecureShortDebugString(*req);
       *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
       return s;
     }
-
-    if (PREDICT_TRUE(block.nrows() > 0)) {
-      // Count the number of rows scanned, regardless of predicates or deletions.
-      // The collector will separately count the number of rows actually returned to
-      // the client.
-      rows_scanned += block.nrows();
-      if (scanner->spec().has_limit()) {
-        int64_t rows_left = scanner->spec().limit() - scanner->num_rows_returned();
-        DCHECK_GT(rows_left, 0);  // Guaranteed by has_fulfilled_limit()
-        block.selection_vector()->ClearToSelectAtMost(static_cast<size_t>(rows_left));
-      }
-      result_collector->HandleRowBlock(scanner.get(), block);
-    }
-
-    int64_t response_size = result_collector->ResponseSize();
-
-    if (VLOG_IS_ON(2)) {
-      // This may be fairly expensive if row block size is small
-      TRACE("Copied block (nrows=$0), new size=$1", block.nrows(), response_size);
-    }
-
-    // TODO: should check if RPC got cancelled, once we implement RPC cancellation.
-    if (PREDICT_FALSE(MonoTime::Now() >= deadline)) {
-      TRACE("Deadline expired - responding early");
-      break;
-    }
-
-    if (response_size >= batch_size_bytes) {
-      break;
-    }
   }
 
   scoped_refptr<TabletReplica> replica = scanner->tablet_replica();
@@ -2210,6 +2674,9 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       !scanner->has_fulfilled_limit();
   if (*has_more_results) {
     unreg_scanner.Cancel();
+    if (FLAGS_scanner_prefetch_batches && result_collector->supports_prefetch()) {
+      SchedulePrefetch(server_->scanner_manager(), scanner, batch_size_bytes);
+    }
   } else {
     VLOG(2) << "Scanner " << scanner->id() << " complete: removing...";
   }
@@ -2265,12 +2732,20 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   // that came before it are, at least, started. This, together with waiting for the mvcc
   // snapshot to be clean below, allows us to always return the same data when scanning at
   // the same timestamp (repeatable reads).
-  TRACE("Waiting safe time to advance");
+  //
+  // There is no need to wait for a timestamp at or before the MVCC clean
+  // timestamp: no new operations may start before it, and those which
+  // started are all committed. Skipping the wait lets followers serve such
+  // scans even when they aren't hearing from a leader.
   MonoTime before = MonoTime::Now();
-  Status s = time_manager->WaitUntilSafe(tmp_snap_timestamp, final_deadline);
-
   tablet::MvccSnapshot snap;
   tablet::MvccManager* mvcc_manager = tablet->mvcc_manager();
+  Status s;
+  if (tmp_snap_timestamp > mvcc_manager->GetCleanTimestamp()) {
+    TRACE("Waiting safe time to advance");
+    s = time_manager->WaitUntilSafe(tmp_snap_timestamp, final_deadline);
+  }
+
   if (s.ok()) {
     // Wait for the in-flights in the snapshot to be finished.
     TRACE("Waiting for operations to commit");
@@ -2350,8 +2825,24 @@ Status TabletServiceImpl::PickAndVerifyTimestamp(const NewScanRequestPB& scan_pb
     //      clock time as the snapshot timestamp.
     //   2) else we use the client provided one, but make sure it is not too
     //      far in the future as to be invalid.
+    //   3) if the client provided a maximum staleness instead, we take the
+    //      MVCC clean timestamp if it's recent enough, since scanning at it
+    //      doesn't need to wait. Otherwise we take the oldest timestamp the
+    //      client allows, and wait for the replica to catch up to it.
     if (!scan_pb.has_snap_timestamp()) {
       tmp_snap_timestamp = server_->clock()->Now();
+      if (scan_pb.has_max_staleness_us()) {
+        if (!server_->clock()->HasPhysicalComponent()) {
+          return Status::NotSupported(
+              "Bounded staleness scans are not supported on this server");
+        }
+        Timestamp oldest_allowed = clock::HybridClock::AddPhysicalTimeToTimestamp(
+            tmp_snap_timestamp,
+            MonoDelta::FromMicroseconds(-static_cast<int64_t>(scan_pb.max_staleness_us())));
+        tmp_snap_timestamp = std::min(tmp_snap_timestamp,
+                                      std::max(mvcc_manager->GetCleanTimestamp(),
+                                               oldest_allowed));
+      }
     } else {
       tmp_snap_timestamp.FromUint64(scan_pb.snap_timestamp());
       RETURN_NOT_OK(ValidateTimestamp(tmp_snap_timestamp));
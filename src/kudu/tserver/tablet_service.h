@@ -26,6 +26,7 @@
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/tserver/tserver_admin.service.h"
 #include "kudu/tserver/tserver_service.service.h"
+#include "kudu/util/status_callback.h"
 
 namespace google {
 namespace protobuf {
@@ -56,8 +57,16 @@ class GetLastOpIdRequestPB;
 class GetLastOpIdResponsePB;
 class GetNodeInstanceRequestPB;
 class GetNodeInstanceResponsePB;
+class InstallSnapshotRequestPB;
+class InstallSnapshotResponsePB;
 class LeaderStepDownRequestPB;
 class LeaderStepDownResponsePB;
+class MultiRaftConsensusRequestPB;
+class MultiRaftConsensusResponsePB;
+class MultiRaftVoteRequestPB;
+class MultiRaftVoteResponsePB;
+class ReadIndexRequestPB;
+class ReadIndexResponsePB;
 class RunLeaderElectionRequestPB;
 class RunLeaderElectionResponsePB;
 class StartTabletCopyRequestPB;
@@ -136,6 +145,15 @@ class TabletServiceImpl : public TabletServerServiceIf {
   virtual void Shutdown() OVERRIDE;
 
  private:
+  // Runs the Scan request 'req' and responds to it.
+  void DoScan(const ScanRequestPB* req,
+              ScanResponsePB* resp,
+              rpc::RpcContext* context);
+
+  // Returns the tenant on behalf of whom the scan pool runs 'req' (see
+  // --scan_pool_tenant).
+  std::string ScanTenant(const ScanRequestPB* req, const rpc::RpcContext* context);
+
   Status HandleNewScanRequest(tablet::TabletReplica* tablet_replica,
                               const ScanRequestPB* req,
                               const rpc::RpcContext* rpc_context,
@@ -145,6 +163,12 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               bool* has_more_results,
                               TabletServerErrorPB::Code* error_code);
 
+  // Run the RequestConsensusVote request 'req'. Like DoUpdateConsensus(),
+  // doesn't respond to the RPC.
+  Status DoRequestConsensusVote(const consensus::VoteRequestPB* req,
+                                consensus::VoteResponsePB* resp,
+                                TabletServerErrorPB::Code* error_code);
+
   Status HandleContinueScanRequest(const ScanRequestPB* req,
                                    const rpc::RpcContext* rpc_context,
                                    ScanResultCollector* result_collector,
@@ -208,14 +232,24 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
                             google::protobuf::Message* resp,
                             rpc::RpcContext* context) override;
 
+  bool SupportsFeature(uint32_t feature) const override;
+
   virtual void UpdateConsensus(const consensus::ConsensusRequestPB* req,
                                consensus::ConsensusResponsePB* resp,
                                rpc::RpcContext* context) OVERRIDE;
 
+  void MultiRaftUpdateConsensus(const consensus::MultiRaftConsensusRequestPB* req,
+                                consensus::MultiRaftConsensusResponsePB* resp,
+                                rpc::RpcContext* context) override;
+
   virtual void RequestConsensusVote(const consensus::VoteRequestPB* req,
                                     consensus::VoteResponsePB* resp,
                                     rpc::RpcContext* context) OVERRIDE;
 
+  void MultiRaftRequestConsensusVote(const consensus::MultiRaftVoteRequestPB* req,
+                                     consensus::MultiRaftVoteResponsePB* resp,
+                                     rpc::RpcContext* context) override;
+
   virtual void ChangeConfig(const consensus::ChangeConfigRequestPB* req,
                             consensus::ChangeConfigResponsePB* resp,
                             rpc::RpcContext* context) OVERRIDE;
@@ -244,6 +278,14 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
                            consensus::GetLastOpIdResponsePB* resp,
                            rpc::RpcContext* context) OVERRIDE;
 
+  virtual void ReadIndex(const consensus::ReadIndexRequestPB* req,
+                         consensus::ReadIndexResponsePB* resp,
+                         rpc::RpcContext* context) OVERRIDE;
+
+  virtual void InstallSnapshot(const consensus::InstallSnapshotRequestPB* req,
+                               consensus::InstallSnapshotResponsePB* resp,
+                               rpc::RpcContext* context) OVERRIDE;
+
   virtual void GetConsensusState(const consensus::GetConsensusStateRequestPB* req,
                                  consensus::GetConsensusStateResponsePB* resp,
                                  rpc::RpcContext* context) OVERRIDE;
@@ -253,6 +295,19 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
                                rpc::RpcContext* context) OVERRIDE;
 
  private:
+  // Run the UpdateConsensus request 'req', whose ops sidecar, if any, is
+  // attached to the RPC of 'context'. Doesn't respond to the RPC: on failure,
+  // returns the error and sets 'error_code' to the code to respond with.
+  //
+  // If 'done' is set, the update doesn't block until its ops are durable:
+  // once the request is handed to consensus, OK is returned and 'done' is
+  // called with the result of the update, possibly from another thread.
+  Status DoUpdateConsensus(const consensus::ConsensusRequestPB* req,
+                           consensus::ConsensusResponsePB* resp,
+                           rpc::RpcContext* context,
+                           TabletServerErrorPB::Code* error_code,
+                           StdStatusCallback done = nullptr);
+
   server::ServerBase* server_;
   TabletReplicaLookupIf* tablet_manager_;
 };
@@ -23,6 +23,7 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -55,6 +56,8 @@
 #define ASSERT_MONOTONIC_REPORT_SEQNO(report_seqno, tablet_report) \
   ASSERT_NO_FATAL_FAILURE(AssertMonotonicReportSeqno(report_seqno, tablet_report))
 
+DECLARE_bool(raft_prepare_replacement_before_eviction);
+
 using std::string;
 using std::vector;
 
@@ -64,10 +67,13 @@ class FsManager;
 
 namespace tserver {
 
+using consensus::ConsensusStatePB;
 using consensus::kInvalidOpIdIndex;
 using consensus::RaftConfigPB;
+using master::ConsensusStateDigestPB;
 using master::ReportedTabletPB;
 using master::TabletReportPB;
+using master::TabletReportUpdatesPB;
 using pb_util::SecureShortDebugString;
 using tablet::TabletReplica;
 
@@ -287,5 +293,73 @@ TEST_F(TsTabletManagerTest, TestTabletReports) {
   ASSERT_MONOTONIC_REPORT_SEQNO(&seqno, report);
 }
 
+// Once the master has acknowledged the consensus state of a tablet, the state
+// is reported as a digest until it changes or the master asks for it.
+TEST_F(TsTabletManagerTest, TestTabletReportDigests) {
+  // Otherwise, the reports of the tablet's leader carry the health of its
+  // replicas, and are always reported in full.
+  FLAGS_raft_prepare_replacement_before_eviction = false;
+  heartbeater_->SetMasterAcceptsConsensusStateDigestsForTests(true);
+  ASSERT_OK(CreateNewTablet("tablet-1", schema_, nullptr));
+
+  TabletReportPB report;
+  GenerateFullTabletReport(&report);
+  ASSERT_REPORT_HAS_UPDATED_TABLET(report, "tablet-1");
+  const ConsensusStatePB cstate = report.updated_tablets(0).consensus_state();
+  MarkTabletReportAcknowledged(report);
+
+  GenerateFullTabletReport(&report);
+  ASSERT_EQ(1, report.updated_tablets_size());
+  const ReportedTabletPB& reported = report.updated_tablets(0);
+  ASSERT_FALSE(reported.has_consensus_state()) << SecureShortDebugString(reported);
+  ASSERT_TRUE(reported.has_consensus_state_digest()) << SecureShortDebugString(reported);
+  const ConsensusStateDigestPB& digest = reported.consensus_state_digest();
+  ASSERT_EQ(cstate.current_term(), digest.current_term());
+  ASSERT_EQ(cstate.leader_uuid(), digest.leader_uuid());
+  MarkTabletReportAcknowledged(report);
+
+  // The master asks for the full state.
+  TabletReportUpdatesPB updates;
+  auto* update = updates.add_tablets();
+  update->set_tablet_id("tablet-1");
+  update->set_needs_consensus_state(true);
+  heartbeater_->HandleTabletReportUpdatesForTests({ updates });
+  GenerateIncrementalTabletReport(&report);
+  ASSERT_EQ(1, report.updated_tablets_size());
+  ASSERT_REPORT_HAS_UPDATED_TABLET(report, "tablet-1");
+  MarkTabletReportAcknowledged(report);
+
+  // A master which doesn't accept digests always gets the full state.
+  heartbeater_->SetMasterAcceptsConsensusStateDigestsForTests(false);
+  GenerateFullTabletReport(&report);
+  ASSERT_REPORT_HAS_UPDATED_TABLET(report, "tablet-1");
+}
+
+TEST_F(TsTabletManagerTest, TestOrderTabletsToOpen) {
+  auto make_tablet = [](const string& data_dir, bool was_leader, int64_t wal_bytes) {
+    TSTabletManager::TabletToOpen tablet;
+    tablet.data_dir = data_dir;
+    tablet.was_leader = was_leader;
+    tablet.wal_bytes = wal_bytes;
+    return tablet;
+  };
+  vector<TSTabletManager::TabletToOpen> tablets = {
+    make_tablet("a", false, 10),
+    make_tablet("a", false, 1),
+    make_tablet("a", true, 100),
+    make_tablet("b", false, 5),
+    make_tablet("b", false, 50),
+  };
+  TSTabletManager::OrderTabletsToOpen(&tablets);
+
+  // The leader goes first, and then the tablets with the least WAL, taking
+  // one tablet per data dir at a time.
+  vector<int64_t> wal_bytes;
+  for (const auto& tablet : tablets) {
+    wal_bytes.push_back(tablet.wal_bytes);
+  }
+  ASSERT_EQ(vector<int64_t>({ 100, 5, 1, 50, 10 }), wal_bytes);
+}
+
 } // namespace tserver
 } // namespace kudu
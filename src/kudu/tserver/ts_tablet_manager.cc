@@ -17,12 +17,14 @@
 
 #include "kudu/tserver/ts_tablet_manager.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -41,17 +43,20 @@
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/multi_raft_batcher.h"
 #include "kudu/consensus/opid.pb.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/consensus/raft_consensus.h"
 #include "kudu/fs/data_dirs.h"
+#include "kudu/fs/fs.pb.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/rpc/result_tracker.h"
 #include "kudu/tablet/metadata.pb.h"
@@ -62,12 +67,14 @@
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/threadpool.h"
@@ -85,6 +92,22 @@ DEFINE_int32(num_tablets_to_open_simultaneously, 0,
              "may make sense to manually tune this.");
 TAG_FLAG(num_tablets_to_open_simultaneously, advanced);
 
+DEFINE_int32(num_tablets_to_open_per_data_dir, 1,
+             "Number of tablets to open simultaneously per data directory during "
+             "startup, if --num_tablets_to_open_simultaneously is 0. Since each "
+             "tablet's log replay is mostly CPU-bound, it may make sense to raise "
+             "this on hosts with many cores per disk, particularly with "
+             "--tablet_bootstrap_prefetch_entries set.");
+TAG_FLAG(num_tablets_to_open_per_data_dir, advanced);
+
+DEFINE_bool(prioritize_tablets_to_open, true,
+            "Whether to order the tablets opened during startup, opening first "
+            "the tablets which were leaders and those with the least WAL to "
+            "replay, and spreading consecutive tablets across the data "
+            "directories. If false, tablets are opened in the order they're "
+            "listed on disk.");
+TAG_FLAG(prioritize_tablets_to_open, advanced);
+
 DEFINE_int32(num_tablets_to_delete_simultaneously, 0,
              "Number of threads available to delete tablets. If this is set to 0 (the "
              "default), then the number of delete threads will be set based on the number "
@@ -216,7 +239,10 @@ TSTabletManager::TSTabletManager(TabletServer* server)
     server_(server),
     metric_registry_(server->metric_registry()),
     tablet_copy_metrics_(server->metric_entity()),
-    state_(MANAGER_INITIALIZING) {
+    state_(MANAGER_INITIALIZING),
+    startup_tablets_opened_(0),
+    startup_wal_bytes_replayed_(0),
+    next_numa_node_(0) {
   METRIC_tablets_num_not_initialized.InstantiateFunctionGauge(
           server->metric_entity(),
           Bind(&TSTabletManager::RefreshTabletStateCacheAndReturnCount,
@@ -313,8 +339,9 @@ Status TSTabletManager::Init() {
   // FsManager isn't initialized until this point.
   int max_open_threads = FLAGS_num_tablets_to_open_simultaneously;
   if (max_open_threads == 0) {
-    // Default to the number of disks.
-    max_open_threads = fs_manager_->GetDataRootDirs().size();
+    // Default to a fixed number per disk.
+    max_open_threads = fs_manager_->GetDataRootDirs().size() *
+        std::max(1, FLAGS_num_tablets_to_open_per_data_dir);
   }
   RETURN_NOT_OK(ThreadPoolBuilder("tablet-open")
                 .set_max_threads(max_open_threads)
@@ -328,6 +355,8 @@ Status TSTabletManager::Init() {
                 .set_max_threads(max_delete_threads)
                 .Build(&delete_tablet_pool_));
 
+  multi_raft_manager_ = std::make_shared<consensus::MultiRaftManager>(server_->messenger());
+
   // Search for tablets in the metadata dir.
   vector<string> tablet_ids;
   RETURN_NOT_OK(fs_manager_->ListTabletIds(&tablet_ids));
@@ -355,8 +384,21 @@ Status TSTabletManager::Init() {
   }
   LOG(INFO) << Substitute("Loaded tablet metadata ($0 live tablets)", metas.size());
 
-  // Now submit the "Open" task for each.
-  for (const scoped_refptr<TabletMetadata>& meta : metas) {
+  vector<TabletToOpen> tablets;
+  tablets.reserve(metas.size());
+  for (auto& meta : metas) {
+    tablets.emplace_back(GetTabletToOpen(std::move(meta)));
+    startup_wal_bytes_ += tablets.back().wal_bytes;
+  }
+  if (FLAGS_prioritize_tablets_to_open) {
+    OrderTabletsToOpen(&tablets);
+  }
+  startup_num_tablets_ = tablets.size();
+  startup_open_start_ = MonoTime::Now();
+
+  // Now submit the "Open" task for each. The pool runs them in order.
+  for (const TabletToOpen& tablet : tablets) {
+    const scoped_refptr<TabletMetadata>& meta = tablet.meta;
     scoped_refptr<TransitionInProgressDeleter> deleter;
     {
       std::lock_guard<RWMutex> lock(lock_);
@@ -365,8 +407,11 @@ Status TSTabletManager::Init() {
 
     scoped_refptr<TabletReplica> replica;
     RETURN_NOT_OK(CreateAndRegisterTabletReplica(meta, NEW_REPLICA, &replica));
-    RETURN_NOT_OK(open_tablet_pool_->SubmitFunc(boost::bind(&TSTabletManager::OpenTablet,
-                                                            this, replica, deleter)));
+    int64_t wal_bytes = tablet.wal_bytes;
+    RETURN_NOT_OK(open_tablet_pool_->SubmitFunc([this, replica, deleter, wal_bytes]() {
+          OpenTablet(replica, deleter);
+          TabletOpenedAtStartup(wal_bytes);
+        }));
   }
 
   {
@@ -377,6 +422,100 @@ Status TSTabletManager::Init() {
   return Status::OK();
 }
 
+TSTabletManager::TabletToOpen TSTabletManager::GetTabletToOpen(
+    scoped_refptr<TabletMetadata> meta) {
+  TabletToOpen tablet;
+  const string& tablet_id = meta->tablet_id();
+
+  DataDirGroupPB group;
+  if (fs_manager_->dd_manager()->GetDataDirGroupPB(tablet_id, &group).ok() &&
+      group.uuids_size() > 0) {
+    tablet.data_dir = group.uuids(0);
+  }
+
+  // Whether the replica was the leader isn't persisted, but a replica which
+  // voted for itself in its last term most likely won or is about to again.
+  scoped_refptr<ConsensusMetadata> cmeta;
+  if (cmeta_manager_->Load(tablet_id, &cmeta).ok()) {
+    tablet.was_leader = cmeta->has_voted_for() &&
+        cmeta->voted_for() == fs_manager_->uuid();
+  }
+
+  Env* env = fs_manager_->env();
+  const string wal_dir = fs_manager_->GetTabletWalDir(tablet_id);
+  vector<string> children;
+  if (env->GetChildren(wal_dir, &children).ok()) {
+    for (const string& child : children) {
+      uint64_t size;
+      if (HasPrefixString(child, FsManager::kWalFileNamePrefix) &&
+          env->GetFileSize(JoinPathSegments(wal_dir, child), &size).ok()) {
+        tablet.wal_bytes += size;
+      }
+    }
+  }
+
+  tablet.meta = std::move(meta);
+  return tablet;
+}
+
+void TSTabletManager::OrderTabletsToOpen(vector<TabletToOpen>* tablets) {
+  auto higher_priority = [](const TabletToOpen& a, const TabletToOpen& b) {
+    if (a.was_leader != b.was_leader) {
+      return a.was_leader;
+    }
+    return a.wal_bytes < b.wal_bytes;
+  };
+  std::stable_sort(tablets->begin(), tablets->end(), higher_priority);
+
+  // Queue the tablets of each data dir in order of priority, and then take
+  // them in rounds of one tablet per data dir, each round in order of
+  // priority.
+  std::unordered_map<string, int> dir_idx;
+  vector<vector<TabletToOpen>> by_dir;
+  for (auto& tablet : *tablets) {
+    int idx = LookupOrInsert(&dir_idx, tablet.data_dir, by_dir.size());
+    if (idx == static_cast<int>(by_dir.size())) {
+      by_dir.emplace_back();
+    }
+    by_dir[idx].emplace_back(std::move(tablet));
+  }
+  vector<TabletToOpen> ordered;
+  ordered.reserve(tablets->size());
+  for (size_t round = 0; ordered.size() < tablets->size(); round++) {
+    size_t round_start = ordered.size();
+    for (auto& dir_tablets : by_dir) {
+      if (round < dir_tablets.size()) {
+        ordered.emplace_back(std::move(dir_tablets[round]));
+      }
+    }
+    std::stable_sort(ordered.begin() + round_start, ordered.end(), higher_priority);
+  }
+  tablets->swap(ordered);
+}
+
+void TSTabletManager::TabletOpenedAtStartup(int64_t wal_bytes) {
+  int opened = ++startup_tablets_opened_;
+  int64_t replayed = (startup_wal_bytes_replayed_ += wal_bytes);
+  MonoDelta elapsed = MonoTime::Now() - startup_open_start_;
+  if (opened == startup_num_tablets_) {
+    LOG(INFO) << Substitute("Opened all $0 tablets in $1",
+                            startup_num_tablets_, elapsed.ToString());
+    return;
+  }
+  // Bootstrap time is dominated by the WAL replay, so estimate the remaining
+  // time from the WAL bytes replayed so far, or from the number of tablets
+  // opened if the tablets have no WAL to speak of.
+  double done = startup_wal_bytes_ > 0 ?
+      static_cast<double>(replayed) / startup_wal_bytes_ :
+      static_cast<double>(opened) / startup_num_tablets_;
+  string eta = done > 0 ?
+      MonoDelta::FromSeconds(elapsed.ToSeconds() * (1 - done) / done).ToString() :
+      "unknown";
+  KLOG_EVERY_N_SECS(INFO, 10) << Substitute(
+      "Opened $0/$1 tablets ($2/$3 WAL bytes), estimated time remaining: $4",
+      opened, startup_num_tablets_, replayed, startup_wal_bytes_, eta);
+}
+
 Status TSTabletManager::WaitForAllBootstrapsToFinish() {
   CHECK_EQ(state(), MANAGER_RUNNING);
 
@@ -703,7 +842,8 @@ void TSTabletManager::RunTabletCopy(
   //
   // TODO(aserbin): make this robust and more optimal than it is now.
   TabletCopyClient tc_client(tablet_id, fs_manager_, cmeta_manager_,
-                             server_->messenger(), &tablet_copy_metrics_);
+                             server_->messenger(), &tablet_copy_metrics_,
+                             &tablet_copy_bandwidth_);
 
   // Download and persist the remote superblock in TABLET_DATA_COPYING state.
   if (replacing_tablet) {
@@ -770,7 +910,12 @@ Status TSTabletManager::CreateAndRegisterTabletReplica(
                         Bind(&TSTabletManager::MarkTabletDirty,
                              Unretained(this),
                              tablet_id)));
-  Status s = replica->Init(server_->raft_pool());
+  int numa_node = -1;
+  if (server_->num_numa_nodes() > 0) {
+    numa_node = next_numa_node_.fetch_add(1, std::memory_order_relaxed) %
+                server_->num_numa_nodes();
+  }
+  Status s = replica->Init(server_->raft_pool(), numa_node);
   if (PREDICT_FALSE(!s.ok())) {
     replica->SetError(s);
     replica->Shutdown();
@@ -1078,7 +1223,8 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletReplica>& replica,
                        server_->messenger(),
                        server_->result_tracker(),
                        log,
-                       server_->tablet_prepare_pool());
+                       server_->tablet_prepare_pool(),
+                       multi_raft_manager_);
     if (!s.ok()) {
       LOG(ERROR) << LogPrefix(tablet_id) << "Tablet failed to start: "
                  << s.ToString();
@@ -1228,6 +1374,18 @@ int TSTabletManager::GetNumLiveTablets() const {
   return count;
 }
 
+int64_t TSTabletManager::GetWalBytesLogged() const {
+  int64_t bytes = 0;
+  shared_lock<RWMutex> l(lock_);
+  for (const auto& entry : tablet_map_) {
+    const Log* wal = entry.second->log();
+    if (wal) {
+      bytes += wal->bytes_logged();
+    }
+  }
+  return bytes;
+}
+
 void TSTabletManager::InitLocalRaftPeerPB() {
   DCHECK_EQ(state(), MANAGER_INITIALIZING);
   local_peer_pb_.set_permanent_uuid(fs_manager_->uuid());
@@ -17,9 +17,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -32,6 +34,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tablet/metadata.pb.h"
+#include "kudu/tserver/tablet_copy_bandwidth_manager.h"
 #include "kudu/tserver/tablet_copy_client.h"
 #include "kudu/tserver/tablet_replica_lookup.h"
 #include "kudu/tserver/tserver.pb.h"
@@ -58,6 +61,7 @@ class ThreadPool;
 
 namespace consensus {
 class ConsensusMetadataManager;
+class MultiRaftManager;
 class OpId;
 class StartTabletCopyRequestPB;
 } // namespace consensus
@@ -192,6 +196,10 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
   // Return the number of tablets in RUNNING or BOOTSTRAPPING state.
   int GetNumLiveTablets() const;
 
+  // Return the total number of bytes appended to the WALs of the tablets
+  // currently hosted on this server.
+  int64_t GetWalBytesLogged() const;
+
   Status RunAllLogGC();
 
   // Delete the tablet using the specified delete_type as the final metadata
@@ -225,6 +233,7 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
 
  private:
   FRIEND_TEST(TsTabletManagerTest, TestPersistBlocks);
+  FRIEND_TEST(TsTabletManagerTest, TestOrderTabletsToOpen);
 
   // Flag specified when registering a TabletReplica.
   enum RegisterTabletReplicaMode {
@@ -262,6 +271,38 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
                                      scoped_refptr<TransitionInProgressDeleter>* deleter,
                                      TabletServerErrorPB::Code* error_code);
 
+  // A tablet to open at startup, with what's known about it before its
+  // bootstrap.
+  struct TabletToOpen {
+    scoped_refptr<tablet::TabletMetadata> meta;
+
+    // The UUID of the first data dir in the tablet's data dir group, or
+    // empty if it has none.
+    std::string data_dir;
+
+    // Whether this server voted for itself in the last term it knows of,
+    // i.e. whether it was, or ran to be, the tablet's leader.
+    bool was_leader = false;
+
+    // The size of the tablet's WAL segments, an estimate of how much of the
+    // WAL its bootstrap replays.
+    int64_t wal_bytes = 0;
+  };
+
+  // Loads what's known about the tablet of 'meta' before its bootstrap.
+  TabletToOpen GetTabletToOpen(scoped_refptr<tablet::TabletMetadata> meta);
+
+  // Orders 'tablets' to be opened at startup: the tablets which were leaders
+  // and then those with the least WAL to replay go first, so that as many
+  // tablets as possible serve soon, and consecutive tablets are spread
+  // across the data dirs, so that the bootstrap threads don't queue on one
+  // disk.
+  static void OrderTabletsToOpen(std::vector<TabletToOpen>* tablets);
+
+  // Records that a tablet opened at startup has finished opening, and logs
+  // the startup's progress and its estimated time to completion.
+  void TabletOpenedAtStartup(int64_t wal_bytes);
+
   // Open a tablet meta from the local file system by loading its superblock.
   Status OpenTabletMeta(const std::string& tablet_id,
                         scoped_refptr<tablet::TabletMetadata>* metadata);
@@ -359,6 +400,10 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
 
   TabletCopyClientMetrics tablet_copy_metrics_;
 
+  // Shares --tablet_copy_max_bytes_per_sec between the tablet copies in
+  // progress.
+  TabletCopyBandwidthManager tablet_copy_bandwidth_;
+
   // Timestamp indicating the last time tablet_map_ was walked to count
   // tablet states.
   MonoTime last_walked_ = MonoTime::Min();
@@ -374,9 +419,23 @@ class TSTabletManager : public tserver::TabletReplicaLookupIf {
   // Thread pool used to open the tablets async, whether bootstrap is required or not.
   gscoped_ptr<ThreadPool> open_tablet_pool_;
 
+  // The progress of opening the tablets found at startup.
+  MonoTime startup_open_start_;
+  int startup_num_tablets_ = 0;
+  int64_t startup_wal_bytes_ = 0;
+  std::atomic<int> startup_tablets_opened_;
+  std::atomic<int64_t> startup_wal_bytes_replayed_;
+
   // Thread pool used to delete tablets asynchronously.
   gscoped_ptr<ThreadPool> delete_tablet_pool_;
 
+  // Used to assign the replicas to NUMA nodes round-robin, when the server
+  // has any. See --tablet_numa_affinity.
+  std::atomic<uint32_t> next_numa_node_;
+
+  // Batches the consensus requests of the tablets to other servers.
+  std::shared_ptr<consensus::MultiRaftManager> multi_raft_manager_;
+
   FunctionGaugeDetacher metric_detacher_;
 
   DISALLOW_COPY_AND_ASSIGN(TSTabletManager);
@@ -506,10 +506,12 @@ void IteratorStatsToJson(const ScanDescriptor& scan, EasyJson* json) {
     row["bytes_read"] = HumanReadableNumBytes::ToString(stats.bytes_read);
     row["cells_read"] = HumanReadableInt::ToString(stats.cells_read);
     row["blocks_read"] = HumanReadableInt::ToString(stats.blocks_read);
+    row["blocks_skipped"] = HumanReadableInt::ToString(stats.blocks_skipped);
 
     row["bytes_read_title"] = stats.bytes_read;
     row["cells_read_title"] = stats.cells_read;
     row["blocks_read_title"] = stats.blocks_read;
+    row["blocks_skipped_title"] = stats.blocks_skipped;
   };
 
   IteratorStats total_stats;
@@ -543,8 +545,11 @@ void ScanToJson(const ScanDescriptor& scan, EasyJson* json) {
   json->Set("time_since_start",
             HumanReadableElapsedTime::ToShortString(time_since_start.ToSeconds()));
 
+  json->Set("cpu_time", HumanReadableElapsedTime::ToShortString(scan.cpu_time.ToSeconds()));
+
   json->Set("duration_title", duration.ToSeconds());
   json->Set("time_since_start_title", time_since_start.ToSeconds());
+  json->Set("cpu_time_title", scan.cpu_time.ToSeconds());
 
   EasyJson stats_json = json->Set("stats", EasyJson::kArray);
   IteratorStatsToJson(scan, &stats_json);
@@ -627,6 +632,15 @@ void TabletServerPathHandlers::HandleMaintenanceManagerPage(const Webserver::Web
     registered_op["logs_retained"] = HumanReadableNumBytes::ToString(op_pb.logs_retained_bytes());
     registered_op["perf"] = op_pb.perf_improvement();
   }
+
+  EasyJson data_dirs = output->Set("data_dirs", EasyJson::kArray);
+  for (const auto& dir_pb : pb.data_dirs()) {
+    EasyJson data_dir = data_dirs.PushBack(EasyJson::kObject);
+    data_dir["uuid"] = dir_pb.uuid();
+    data_dir["running_ops"] = dir_pb.running_ops();
+    data_dir["scheduled_io"] = HumanReadableNumBytes::ToString(dir_pb.scheduled_io_bytes());
+    data_dir["utilization"] = StringPrintf("%.1f%%", dir_pb.utilization() * 100);
+  }
 }
 
 } // namespace tserver
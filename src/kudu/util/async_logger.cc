@@ -17,11 +17,25 @@
 
 #include "kudu/util/async_logger.h"
 
+#include <ctime>
 #include <string>
 #include <thread>
 
+#include <gflags/gflags.h>
+
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
 
+DEFINE_bool(log_async_drop_when_full, false,
+            "Whether to drop log messages rather than block the logging thread "
+            "when the asynchronous logging buffers are full, e.g. because the "
+            "log disk is slow. Dropped messages are counted, and their number "
+            "is noted in the log. Only relevant when --log_async is enabled.");
+TAG_FLAG(log_async_drop_when_full, advanced);
+TAG_FLAG(log_async_drop_when_full, runtime);
+
 using std::string;
 
 namespace kudu {
@@ -62,10 +76,17 @@ void AsyncLogger::Write(bool force_flush,
                         time_t timestamp,
                         const char* message,
                         int message_len) {
+  // Unfortunately, the underlying log level isn't passed through to this interface, so we
+  // have to use this hack: messages from FATAL errors start with the character 'F'.
+  const bool fatal = message_len > 0 && message[0] == 'F';
   {
     MutexLock l(lock_);
     DCHECK_EQ(state_, RUNNING);
     while (BufferFull(*active_buf_)) {
+      if (FLAGS_log_async_drop_when_full && !fatal) {
+        dropped_messages_count_++;
+        return;
+      }
       app_threads_blocked_count_for_tests_++;
       free_buffer_cond_.Wait();
     }
@@ -83,10 +104,7 @@ void AsyncLogger::Write(bool force_flush,
   // NOTE: even if the application doesn't wrap the FATAL-level logger, log messages at
   // FATAL are also written to all other log files with lower levels. So, a FATAL message
   // will force a synchronous flush of all lower-level logs before exiting.
-  //
-  // Unfortunately, the underlying log level isn't passed through to this interface, so we
-  // have to use this hack: messages from FATAL errors start with the character 'F'.
-  if (message_len > 0 && message[0] == 'F') {
+  if (fatal) {
     Flush();
   }
 }
@@ -127,11 +145,18 @@ void AsyncLogger::RunThread() {
     if (BufferFull(*flushing_buf_)) {
       free_buffer_cond_.Broadcast();
     }
+    uint64_t num_dropped = dropped_messages_count_ - dropped_messages_reported_;
+    dropped_messages_reported_ = dropped_messages_count_;
     l.Unlock();
 
     for (const auto& msg : flushing_buf_->messages) {
       wrapped_->Write(false, msg.ts, msg.message.data(), msg.message.size());
     }
+    if (PREDICT_FALSE(num_dropped > 0)) {
+      string note = strings::Substitute(
+          "Dropped $0 log messages because the log buffers were full\n", num_dropped);
+      wrapped_->Write(false, time(nullptr), note.data(), note.size());
+    }
     if (flushing_buf_->flush) {
       wrapped_->Flush();
     }
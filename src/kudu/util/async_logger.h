@@ -57,7 +57,13 @@ namespace kudu {
 //
 // NOTE: the logger limits the total amount of buffer space, so if the underlying
 // log blocks for too long, eventually the threads generating the log messages
-// will block as well. This prevents runaway memory usage.
+// will block as well. This prevents runaway memory usage. Since glog holds a
+// process-wide lock while writing a message, a single blocked thread then
+// stalls every thread which logs, including those logging while holding
+// locks on hot paths such as consensus. With --log_async_drop_when_full, the
+// messages which don't fit are dropped and counted instead, and the number
+// of dropped messages is noted in the log once the logger catches up. FATAL
+// messages are never dropped.
 class AsyncLogger : public google::base::Logger {
  public:
   AsyncLogger(google::base::Logger* wrapped,
@@ -96,6 +102,12 @@ class AsyncLogger : public google::base::Logger {
   // logged data may not have been flushed to disk yet.
   uint32_t LogSize() override;
 
+  // Return the number of messages dropped because the buffers were full.
+  uint64_t dropped_messages_count() const {
+    MutexLock l(lock_);
+    return dropped_messages_count_;
+  }
+
   // Return a count of how many times an application thread was
   // blocked due to the buffers being full and the writer thread
   // not keeping up.
@@ -166,6 +178,11 @@ class AsyncLogger : public google::base::Logger {
   // a full buffer.
   int app_threads_blocked_count_for_tests_ = 0;
 
+  // Count of messages dropped due to a full buffer, and the value of the
+  // count when the writer thread last noted the dropped messages in the log.
+  uint64_t dropped_messages_count_ = 0;
+  uint64_t dropped_messages_reported_ = 0;
+
   // Count of how many times the writer thread has flushed the buffers.
   // 64 bits should be enough to never worry about overflow.
   uint64_t flush_count_ = 0;
@@ -100,6 +100,17 @@ class BitReader {
   template<typename T>
   bool GetValue(int num_bits, T* v);
 
+  // Gets up to 'batch_size' values of 'num_bits' bits each from the buffer
+  // into 'v', as if by that many calls to GetValue(). Returns the number of
+  // values read, which is less than 'batch_size' only if there are not enough
+  // bytes left.
+  //
+  // Much faster than GetValue() for widths up to 32 bits: each value is
+  // extracted from an unaligned 64-bit load independently of the others, so
+  // the loop has no dependency between iterations.
+  template<typename T>
+  int GetBatch(int num_bits, T* v, int batch_size);
+
   // Reads a 'num_bytes'-sized value from the buffer and stores it in 'v'. T needs to be a
   // little-endian native type and big enough to store 'num_bytes'. The value is assumed
   // to be byte-aligned so the stream will be advanced to the start of the next byte
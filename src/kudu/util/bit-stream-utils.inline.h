@@ -18,6 +18,8 @@
 #define IMPALA_UTIL_BIT_STREAM_UTILS_INLINE_H
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
 #include "glog/logging.h"
 #include "kudu/util/bit-stream-utils.h"
@@ -131,6 +133,39 @@ inline bool BitReader::GetValue(int num_bits, T* v) {
   return true;
 }
 
+template<typename T>
+inline int BitReader::GetBatch(int num_bits, T* v, int batch_size) {
+  DCHECK_LE(num_bits, 64);
+  DCHECK_LE(num_bits, sizeof(T) * 8);
+  DCHECK_GE(batch_size, 0);
+
+  const int64_t start = position();
+  const int64_t bits_left = static_cast<int64_t>(max_bytes_) * 8 - start;
+  const int num_values = static_cast<int>(std::min<int64_t>(batch_size, bits_left / num_bits));
+
+  int i = 0;
+  if (num_bits <= 32) {
+    // The values whose 64-bit load stays within the buffer. Since the values
+    // start at most 7 bits into their load, it holds all of their bits.
+    const int64_t last_load_bit = (static_cast<int64_t>(max_bytes_) - 8) * 8 + 7;
+    const int num_fast = last_load_bit < start ? 0 : static_cast<int>(
+        std::min<int64_t>(num_values, (last_load_bit - start) / num_bits + 1));
+    const uint64_t mask = (1ULL << num_bits) - 1;
+    for (; i < num_fast; i++) {
+      const int64_t bit = start + static_cast<int64_t>(i) * num_bits;
+      uint64_t word;
+      memcpy(&word, buffer_ + (bit >> 3), sizeof(word));
+      v[i] = static_cast<T>((word >> (bit & 7)) & mask);
+    }
+    SeekToBit(start + static_cast<int64_t>(i) * num_bits);
+  }
+  for (; i < num_values; i++) {
+    bool result = GetValue(num_bits, &v[i]);
+    DCHECK(result);
+  }
+  return num_values;
+}
+
 inline void BitReader::Rewind(int num_bits) {
   bit_offset_ -= num_bits;
   if (bit_offset_ >= 0) {
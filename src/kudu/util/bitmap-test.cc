@@ -17,8 +17,11 @@
 
 #include "kudu/util/bitmap.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -272,4 +275,58 @@ TEST(TestBitMap, TestEquals) {
   ASSERT_TRUE(BitmapEquals(bm3, bm3 + 3, num_bits - 24)); // off by three bytes
 }
 
+// Test the bulk merge, count and run iteration kernels against bit by bit
+// equivalents, on lengths which exercise both the vectorized and the tail
+// loops, and on both sparse and dense bitmaps.
+TEST(TestBitMap, TestBulkOperations) {
+  srand(1);
+  for (size_t num_bits : { 1, 7, 8, 63, 64, 65, 255, 256, 257, 1000, 4096 }) {
+    for (int density : { 1, 50, 99 }) {
+      SCOPED_TRACE(num_bits);
+      SCOPED_TRACE(density);
+      std::vector<uint8_t> a(BitmapSize(num_bits));
+      std::vector<uint8_t> b(BitmapSize(num_bits));
+      size_t num_set = 0;
+      for (size_t i = 0; i < num_bits; i++) {
+        bool set = rand() % 100 < density;
+        BitmapChange(a.data(), i, set);
+        num_set += set;
+        BitmapChange(b.data(), i, rand() % 100 < density);
+      }
+      ASSERT_EQ(num_set, BitmapCount(a.data(), num_bits));
+
+      std::vector<std::pair<size_t, size_t>> runs;
+      size_t start;
+      size_t len;
+      SetBitRunIterator iter(a.data(), num_bits);
+      while (iter.Next(&start, &len)) {
+        runs.emplace_back(start, len);
+      }
+      std::vector<std::pair<size_t, size_t>> expected_runs;
+      bool value;
+      size_t offset = 0;
+      BitmapIterator bitmap_iter(a.data(), num_bits);
+      while ((len = bitmap_iter.Next(&value))) {
+        if (value) expected_runs.emplace_back(offset, len);
+        offset += len;
+      }
+      ASSERT_EQ(expected_runs, runs);
+
+      std::vector<uint8_t> merged_or = a;
+      std::vector<uint8_t> merged_and = a;
+      std::vector<uint8_t> merged_and_not = a;
+      BitmapMergeOr(merged_or.data(), b.data(), num_bits);
+      BitmapMergeAnd(merged_and.data(), b.data(), num_bits);
+      BitmapMergeAndNot(merged_and_not.data(), b.data(), num_bits);
+      for (size_t i = 0; i < num_bits; i++) {
+        bool in_a = BitmapTest(a.data(), i);
+        bool in_b = BitmapTest(b.data(), i);
+        ASSERT_EQ(in_a || in_b, BitmapTest(merged_or.data(), i));
+        ASSERT_EQ(in_a && in_b, BitmapTest(merged_and.data(), i));
+        ASSERT_EQ(in_a && !in_b, BitmapTest(merged_and_not.data(), i));
+      }
+    }
+  }
+}
+
 } // namespace kudu
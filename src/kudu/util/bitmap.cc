@@ -20,12 +20,185 @@
 #include <cstring>
 #include <string>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include <glog/logging.h>
 
+#include "kudu/gutil/cpu.h"
 #include "kudu/gutil/stringprintf.h"
 
+using base::CPU;
+
 namespace kudu {
 
+namespace {
+
+enum class MergeOp {
+  OR,
+  AND,
+  AND_NOT
+};
+
+template<MergeOp op>
+inline uint64_t Merge(uint64_t dst, uint64_t src) {
+  switch (op) {
+    case MergeOp::OR: return dst | src;
+    case MergeOp::AND: return dst & src;
+    case MergeOp::AND_NOT: return dst & ~src;
+  }
+  return dst;
+}
+
+// The scalar kernels work a word at a time. Bitmaps needn't be aligned, so
+// the words are loaded with memcpy().
+template<MergeOp op>
+void MergeScalar(uint8_t* dst, const uint8_t* src, size_t n_bytes) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= n_bytes; i += sizeof(uint64_t)) {
+    uint64_t d;
+    uint64_t s;
+    memcpy(&d, dst + i, sizeof(d));
+    memcpy(&s, src + i, sizeof(s));
+    d = Merge<op>(d, s);
+    memcpy(dst + i, &d, sizeof(d));
+  }
+  for (; i < n_bytes; i++) {
+    dst[i] = Merge<op>(dst[i], src[i]);
+  }
+}
+
+size_t CountScalar(const uint8_t* bitmap, size_t n_bytes) {
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= n_bytes; i += sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, bitmap + i, sizeof(w));
+    count += __builtin_popcountll(w);
+  }
+  for (; i < n_bytes; i++) {
+    count += __builtin_popcount(bitmap[i]);
+  }
+  return count;
+}
+
+// Returns the number of leading bytes of 'bitmap' which are equal to 'byte'.
+size_t SkipBytesScalar(const uint8_t* bitmap, size_t n_bytes, uint8_t byte) {
+  const uint64_t pattern = 0x0101010101010101ULL * byte;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= n_bytes; i += sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, bitmap + i, sizeof(w));
+    if (w != pattern) break;
+  }
+  while (i < n_bytes && bitmap[i] == byte) {
+    i++;
+  }
+  return i;
+}
+
+#if defined(__x86_64__)
+// The AVX2 kernels work 32 bytes at a time, and leave the rest to the scalar
+// kernels.
+template<MergeOp op>
+__attribute__((target("avx2")))
+void MergeAvx2(uint8_t* dst, const uint8_t* src, size_t n_bytes) {
+  size_t i = 0;
+  for (; i + sizeof(__m256i) <= n_bytes; i += sizeof(__m256i)) {
+    __m256i* d = reinterpret_cast<__m256i*>(dst + i);
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i v = _mm256_loadu_si256(d);
+    switch (op) {
+      case MergeOp::OR: v = _mm256_or_si256(v, s); break;
+      case MergeOp::AND: v = _mm256_and_si256(v, s); break;
+      case MergeOp::AND_NOT: v = _mm256_andnot_si256(s, v); break;
+    }
+    _mm256_storeu_si256(d, v);
+  }
+  MergeScalar<op>(dst + i, src + i, n_bytes - i);
+}
+
+// Counts the bits of each nibble with a lookup table held in a register,
+// then sums the byte counts into 64-bit lanes.
+__attribute__((target("avx2")))
+size_t CountAvx2(const uint8_t* bitmap, size_t n_bytes) {
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i sums = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + sizeof(__m256i) <= n_bytes; i += sizeof(__m256i)) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bitmap + i));
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                     _mm256_shuffle_epi8(lookup, hi));
+    sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+  }
+  size_t count = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+                 _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+  return count + CountScalar(bitmap + i, n_bytes - i);
+}
+
+__attribute__((target("avx2")))
+size_t SkipBytesAvx2(const uint8_t* bitmap, size_t n_bytes, uint8_t byte) {
+  const __m256i pattern = _mm256_set1_epi8(static_cast<char>(byte));
+  size_t i = 0;
+  for (; i + sizeof(__m256i) <= n_bytes; i += sizeof(__m256i)) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bitmap + i));
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern)) != -1) break;
+  }
+  return i + SkipBytesScalar(bitmap + i, n_bytes - i, byte);
+}
+#endif
+
+// The kernels for the runtime architecture, selected once when the
+// translation unit is initialized to keep 'cpuid' off the hot path.
+void (*g_merge_or)(uint8_t*, const uint8_t*, size_t) = MergeScalar<MergeOp::OR>;
+void (*g_merge_and)(uint8_t*, const uint8_t*, size_t) = MergeScalar<MergeOp::AND>;
+void (*g_merge_and_not)(uint8_t*, const uint8_t*, size_t) = MergeScalar<MergeOp::AND_NOT>;
+size_t (*g_count)(const uint8_t*, size_t) = CountScalar;
+size_t (*g_skip_bytes)(const uint8_t*, size_t, uint8_t) = SkipBytesScalar;
+
+__attribute__((constructor))
+void SelectBitmapFunctions() {
+#if defined(__x86_64__)
+  if (CPU().has_avx2()) {
+    g_merge_or = MergeAvx2<MergeOp::OR>;
+    g_merge_and = MergeAvx2<MergeOp::AND>;
+    g_merge_and_not = MergeAvx2<MergeOp::AND_NOT>;
+    g_count = CountAvx2;
+    g_skip_bytes = SkipBytesAvx2;
+  }
+#endif
+}
+
+} // anonymous namespace
+
+void BitmapMergeOr(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  g_merge_or(dst, src, BitmapSize(n_bits));
+}
+
+void BitmapMergeAnd(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  g_merge_and(dst, src, BitmapSize(n_bits));
+}
+
+void BitmapMergeAndNot(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  g_merge_and_not(dst, src, BitmapSize(n_bits));
+}
+
+size_t BitmapCount(const uint8_t *bitmap, size_t num_bits) {
+  size_t n_full_bytes = num_bits >> 3;
+  size_t count = g_count(bitmap, n_full_bytes);
+  size_t n_remaining_bits = num_bits & 7;
+  if (n_remaining_bits > 0) {
+    count += __builtin_popcount(bitmap[n_full_bytes] & ((1 << n_remaining_bits) - 1));
+  }
+  return count;
+}
+
 void BitmapChangeBits(uint8_t *bitmap, size_t offset, size_t num_bits, bool value) {
   DCHECK_GT(num_bits, 0);
 
@@ -66,7 +239,6 @@ void BitmapChangeBits(uint8_t *bitmap, size_t offset, size_t num_bits, bool valu
 
 bool BitmapFindFirst(const uint8_t *bitmap, size_t offset, size_t bitmap_size,
                      bool value, size_t *idx) {
-  const uint64_t pattern64[2] = { 0xffffffffffffffff, 0x0000000000000000 };
   const uint8_t pattern8[2] = { 0xff, 0x00 };
   size_t bit;
 
@@ -90,19 +262,10 @@ bool BitmapFindFirst(const uint8_t *bitmap, size_t offset, size_t bitmap_size,
     p++;
   }
 
-  // check 64bit at the time for a 'value' bit
-  const uint64_t *u64 = (const uint64_t *)p;
-  while (num_bits >= 64 && *u64 == pattern64[value]) {
-    num_bits -= 64;
-    u64++;
-  }
-
-  // check 8bit at the time for a 'value' bit
-  p = (const uint8_t *)u64;
-  while (num_bits >= 8 && *p == pattern8[value]) {
-    num_bits -= 8;
-    p++;
-  }
+  // Skip the whole bytes without a 'value' bit, many at a time.
+  size_t n_skipped = g_skip_bytes(p, num_bits >> 3, pattern8[value]);
+  p += n_skipped;
+  num_bits -= n_skipped << 3;
 
   // Find a 'value' bit at the beginning of the last byte
   for (bit = 0; num_bits > 0; ++bit) {
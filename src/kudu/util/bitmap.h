@@ -59,12 +59,19 @@ inline bool BitmapTest(const uint8_t *bitmap, size_t idx) {
 
 // Merge the two bitmaps using bitwise or. Both bitmaps should have at least
 // n_bits valid bits.
-inline void BitmapMergeOr(uint8_t *dst, const uint8_t *src, size_t n_bits) {
-  size_t n_bytes = BitmapSize(n_bits);
-  for (size_t i = 0; i < n_bytes; i++) {
-    *dst++ |= *src++;
-  }
-}
+//
+// The merges below work on whole bytes, so the bits which follow the n_bits
+// valid bits in the last byte are merged too. They use AVX2 when available.
+void BitmapMergeOr(uint8_t *dst, const uint8_t *src, size_t n_bits);
+
+// Merge the two bitmaps using bitwise and.
+void BitmapMergeAnd(uint8_t *dst, const uint8_t *src, size_t n_bits);
+
+// Clear the bits of 'dst' which are set in 'src', i.e. dst &= ~src.
+void BitmapMergeAndNot(uint8_t *dst, const uint8_t *src, size_t n_bits);
+
+// Return the number of set bits among the first 'num_bits' bits.
+size_t BitmapCount(const uint8_t *bitmap, size_t num_bits);
 
 // Set bits from offset to (offset + num_bits) to the specified value
 void BitmapChangeBits(uint8_t *bitmap, size_t offset, size_t num_bits, bool value);
@@ -168,6 +175,44 @@ class BitmapIterator {
   const uint8_t *map_;
 };
 
+// Iterator which yields the runs of consecutive set bits in a bitmap,
+// skipping over the unset bits many at a time, so that walking a sparse
+// bitmap costs little more than the number of runs.
+// Example usage:
+//   size_t start;
+//   size_t len;
+//   SetBitRunIterator iter(bitmap, n_bits);
+//   while (iter.Next(&start, &len)) {
+//      printf("bits [%lu, %lu) are set\n", start, start + len);
+//   }
+class SetBitRunIterator {
+ public:
+  SetBitRunIterator(const uint8_t *map, size_t num_bits)
+    : offset_(0), num_bits_(num_bits), map_(map)
+  {}
+
+  // Sets 'start' and 'len' to the next run of set bits and returns true, or
+  // returns false if there are no more.
+  bool Next(size_t *start, size_t *len) {
+    if (!BitmapFindFirstSet(map_, offset_, num_bits_, start)) {
+      offset_ = num_bits_;
+      return false;
+    }
+    size_t end;
+    if (!BitmapFindFirstZero(map_, *start, num_bits_, &end)) {
+      end = num_bits_;
+    }
+    *len = end - *start;
+    offset_ = end;
+    return true;
+  }
+
+ private:
+  size_t offset_;
+  size_t num_bits_;
+  const uint8_t *map_;
+};
+
 // Iterator which yields the set bits in a bitmap.
 // Example usage:
 //   for (TrueBitIterator iter(bitmap, n_bits);
@@ -118,7 +118,7 @@ class BlockingQueue {
     MutexLock l(lock_);
     while (true) {
       if (!list_.empty()) {
-        out->reserve(list_.size());
+        out->reserve(out->size() + list_.size());
         for (const T& elt : list_) {
           out->push_back(elt);
           decrement_size_unlocked(elt);
@@ -89,4 +89,41 @@ TEST(TestBloomFilter, TestInsertAndProbe) {
   ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
 }
 
+TEST(TestBloomFilter, TestSplitBlockInsertAndProbe) {
+  int n_keys = 2000;
+  BloomFilterBuilder bfb(
+    BloomFilterSizing::ByCountAndFPRate(n_keys, 0.01, BloomFilterLayout::SPLIT_BLOCK));
+  ASSERT_EQ(BloomFilterLayout::SPLIT_BLOCK, bfb.layout());
+  ASSERT_EQ(8, bfb.n_hashes());
+  ASSERT_EQ(0, bfb.n_bits() % (BloomFilter::kSplitBlockBytes * 8));
+
+  // Confining each key to one block needs more bits per key than the
+  // classic layout for the same false positive rate.
+  double expected_fp_rate = bfb.false_positive_rate();
+  ASSERT_NEAR(expected_fp_rate, 0.01, 0.002);
+  ASSERT_EQ(10, bfb.n_bits() / n_keys);
+
+  AddRandomKeys(kRandomSeed, n_keys, &bfb);
+
+  BloomFilter bf(bfb.slice(), bfb.n_hashes(), bfb.layout());
+  CheckRandomKeys(kRandomSeed, n_keys, bf);
+
+  uint32_t num_queries = 100000;
+  uint32_t num_positives = 0;
+  for (int i = 0; i < num_queries; i++) {
+    uint64_t key = random();
+    Slice key_slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key));
+    BloomKeyProbe probe(key_slice);
+    bf.PrefetchKey(probe);
+    if (bf.MayContainKey(probe)) {
+      num_positives++;
+    }
+  }
+
+  double fp_rate = static_cast<double>(num_positives) / static_cast<double>(num_queries);
+  LOG(INFO) << "FP rate: " << fp_rate << " (" << num_positives << "/" << num_queries << ")";
+  LOG(INFO) << "Expected FP rate: " << expected_fp_rate;
+  ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
+}
+
 } // namespace kudu
@@ -33,33 +33,89 @@ static int ComputeOptimalHashCount(size_t n_bits, size_t elems) {
   return n_hashes;
 }
 
+// The false positive rate of a split-block filter with 'bits_per_key' bits
+// for each inserted key. The number of keys per block is roughly
+// Poisson-distributed, and a block with j keys acts as eight one-hash filters
+// of 32 bits with j keys each.
+static double SplitBlockFalsePositiveRate(double bits_per_key) {
+  const double lambda = BloomFilter::kSplitBlockBytes * 8 / bits_per_key;
+  double fp_rate = 0;
+  double p_j = exp(-lambda);
+  for (int j = 0; j < lambda * 4 + 64; j++) {
+    fp_rate += p_j * pow(1 - pow(1 - 1.0 / 32, j), BloomFilter::kSplitBlockWords);
+    p_j *= lambda / (j + 1);
+  }
+  return fp_rate;
+}
+
+// The number of bits per key a split-block filter needs to achieve 'fp_rate'.
+// Confining each key to one block makes this somewhat more than the classic
+// layout needs.
+static double SplitBlockBitsPerKey(double fp_rate) {
+  double lo = 1;
+  double hi = 64;
+  for (int i = 0; i < 50; i++) {
+    double mid = (lo + hi) / 2;
+    if (SplitBlockFalsePositiveRate(mid) > fp_rate) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return hi;
+}
+
+// The split-block layout must be made of whole blocks.
+static size_t RoundUpForLayout(size_t n_bytes, BloomFilterLayout layout) {
+  if (layout != BloomFilterLayout::SPLIT_BLOCK) {
+    return n_bytes;
+  }
+  const size_t block = BloomFilter::kSplitBlockBytes;
+  return (n_bytes + block - 1) / block * block;
+}
+
 BloomFilterSizing BloomFilterSizing::ByCountAndFPRate(
-  size_t expected_count, double fp_rate) {
+  size_t expected_count, double fp_rate, BloomFilterLayout layout) {
   CHECK_GT(fp_rate, 0);
   CHECK_LT(fp_rate, 1);
 
-  double n_bits = -static_cast<double>(expected_count) * log(fp_rate)
-    / kNaturalLog2 / kNaturalLog2;
+  double n_bits;
+  if (layout == BloomFilterLayout::SPLIT_BLOCK) {
+    n_bits = expected_count * SplitBlockBitsPerKey(fp_rate);
+  } else {
+    n_bits = -static_cast<double>(expected_count) * log(fp_rate)
+      / kNaturalLog2 / kNaturalLog2;
+  }
   int n_bytes = static_cast<int>(ceil(n_bits / 8));
   CHECK_GT(n_bytes, 0)
     << "expected_count: " << expected_count
     << " fp_rate: " << fp_rate;
-  return BloomFilterSizing(n_bytes, expected_count);
+  return BloomFilterSizing(RoundUpForLayout(n_bytes, layout), expected_count, layout);
 }
 
-BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_rate) {
+BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_rate,
+                                                     BloomFilterLayout layout) {
+  n_bytes = RoundUpForLayout(n_bytes, layout);
   size_t n_bits = n_bytes * 8;
-  double expected_elems = -static_cast<double>(n_bits) * kNaturalLog2 * kNaturalLog2 /
-    log(fp_rate);
+  double expected_elems;
+  if (layout == BloomFilterLayout::SPLIT_BLOCK) {
+    expected_elems = n_bits / SplitBlockBitsPerKey(fp_rate);
+  } else {
+    expected_elems = -static_cast<double>(n_bits) * kNaturalLog2 * kNaturalLog2 /
+      log(fp_rate);
+  }
   DCHECK_GT(expected_elems, 1);
-  return BloomFilterSizing(n_bytes, (size_t)ceil(expected_elems));
+  return BloomFilterSizing(n_bytes, (size_t)ceil(expected_elems), layout);
 }
 
 
 BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing)
   : n_bits_(sizing.n_bytes() * 8),
     bitmap_(new uint8_t[sizing.n_bytes()]),
-    n_hashes_(ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
+    layout_(sizing.layout()),
+    n_hashes_(layout_ == BloomFilterLayout::SPLIT_BLOCK ?
+              BloomFilter::kSplitBlockWords :
+              ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
     expected_count_(sizing.expected_count()),
     n_inserted_(0) {
   Clear();
@@ -75,14 +131,23 @@ double BloomFilterBuilder::false_positive_rate() const {
     << "expected_count_ not initialized: can't call this function on "
     << "a BloomFilter initialized from external data";
 
+  if (layout_ == BloomFilterLayout::SPLIT_BLOCK) {
+    return SplitBlockFalsePositiveRate(static_cast<double>(n_bits_) / expected_count_);
+  }
+
   return pow(1 - exp(-static_cast<double>(n_hashes_) * expected_count_ / n_bits_), n_hashes_);
 }
 
-BloomFilter::BloomFilter(const Slice &data, size_t n_hashes)
+BloomFilter::BloomFilter(const Slice &data, size_t n_hashes, BloomFilterLayout layout)
   : n_bits_(data.size() * 8),
     bitmap_(reinterpret_cast<const uint8_t *>(data.data())),
-    n_hashes_(n_hashes)
-{}
+    n_hashes_(n_hashes),
+    layout_(layout) {
+  DCHECK(layout_ != BloomFilterLayout::SPLIT_BLOCK || data.size() % kSplitBlockBytes == 0);
+}
+
+const size_t BloomFilter::kSplitBlockBytes;
+const size_t BloomFilter::kSplitBlockWords;
 
 
 
@@ -83,6 +83,11 @@ class BloomKeyProbe {
     return h_1_;
   }
 
+  // The second, independent half of the key's hash.
+  uint32_t secondary_hash() const {
+    return h_2_;
+  }
+
   // Mix the given hash function with the second calculated hash
   // value. A sequence of independent hashes can be calculated
   // by repeatedly calling MixHash() on its previous result.
@@ -99,6 +104,23 @@ class BloomKeyProbe {
   uint32_t h_2_;
 };
 
+// How the bits set for a key are spread over a bloom filter.
+enum class BloomFilterLayout {
+  // Each of the key's hashes may pick any bit of the filter, so probing
+  // for a key incurs up to one cache miss per hash.
+  CLASSIC,
+
+  // The filter is split into blocks of 32 bytes, each made of eight 32-bit
+  // words. A key picks one block and sets one bit in each of its words, so
+  // probing for a key touches a single cache line, and the eight word tests
+  // are independent of each other. For the same size and number of keys the
+  // false positive rate is somewhat higher than with the classic layout.
+  //
+  // See "Cache-, Hash- and Space-Efficient Bloom Filters", Putze, Sanders
+  // and Singler, WEA 2007.
+  SPLIT_BLOCK,
+};
+
 // Sizing parameters for the constructor to BloomFilterBuilder.
 // This is simply to provide a nicer API than a bunch of overloaded
 // constructors.
@@ -107,24 +129,29 @@ class BloomFilterSizing {
   // Size the bloom filter by a fixed size and false positive rate.
   //
   // Picks the number of entries to achieve the above.
-  static BloomFilterSizing BySizeAndFPRate(size_t n_bytes, double fp_rate);
+  static BloomFilterSizing BySizeAndFPRate(size_t n_bytes, double fp_rate,
+                                           BloomFilterLayout layout = BloomFilterLayout::CLASSIC);
 
   // Size the bloom filer by an expected count and false positive rate.
   //
   // Picks the number of bytes to achieve the above.
-  static BloomFilterSizing ByCountAndFPRate(size_t expected_count, double fp_rate);
+  static BloomFilterSizing ByCountAndFPRate(size_t expected_count, double fp_rate,
+                                            BloomFilterLayout layout = BloomFilterLayout::CLASSIC);
 
   size_t n_bytes() const { return n_bytes_; }
   size_t expected_count() const { return expected_count_; }
+  BloomFilterLayout layout() const { return layout_; }
 
  private:
-  BloomFilterSizing(size_t n_bytes, size_t expected_count) :
+  BloomFilterSizing(size_t n_bytes, size_t expected_count, BloomFilterLayout layout) :
     n_bytes_(n_bytes),
-    expected_count_(expected_count)
+    expected_count_(expected_count),
+    layout_(layout)
   {}
 
   size_t n_bytes_;
   size_t expected_count_;
+  BloomFilterLayout layout_;
 };
 
 
@@ -162,6 +189,8 @@ class BloomFilterBuilder {
   // in the bloom filter.
   size_t n_hashes() const { return n_hashes_; }
 
+  BloomFilterLayout layout() const { return layout_; }
+
   size_t expected_count() const { return expected_count_; }
 
   // Return the number of keys inserted.
@@ -173,6 +202,8 @@ class BloomFilterBuilder {
   size_t n_bits_;
   gscoped_array<uint8_t> bitmap_;
 
+  BloomFilterLayout layout_;
+
   // The number of hash functions to compute.
   size_t n_hashes_;
 
@@ -187,20 +218,46 @@ class BloomFilterBuilder {
 // Wrapper around a byte array for reading it as a bloom filter.
 class BloomFilter {
  public:
-  BloomFilter() : bitmap_(nullptr) {}
-  BloomFilter(const Slice &data, size_t n_hashes);
+  BloomFilter() : bitmap_(nullptr), layout_(BloomFilterLayout::CLASSIC) {}
+  BloomFilter(const Slice &data, size_t n_hashes,
+              BloomFilterLayout layout = BloomFilterLayout::CLASSIC);
 
   // Return true if the filter may contain the given key.
   bool MayContainKey(const BloomKeyProbe &probe) const;
 
+  // Prefetch the first bitmap byte MayContainKey(probe) will test. Issuing
+  // this a few probes ahead lets a batch of lookups overlap their cache misses.
+  void PrefetchKey(const BloomKeyProbe &probe) const {
+    const uint8_t* addr;
+    if (layout_ == BloomFilterLayout::SPLIT_BLOCK) {
+      addr = &bitmap_[PickBlock(probe, n_bits_) * kSplitBlockBytes];
+    } else {
+      addr = &bitmap_[PickBit(probe.initial_hash(), n_bits_) >> 3];
+    }
+    prefetch(reinterpret_cast<const char *>(addr), PREFETCH_HINT_T0);
+  }
+
+  // Size and number of 32-bit words of each block of the split-block layout.
+  static const size_t kSplitBlockBytes = 32;
+  static const size_t kSplitBlockWords = 8;
+
  private:
   friend class BloomFilterBuilder;
   static uint32_t PickBit(uint32_t hash, size_t n_bits);
 
+  // Split-block layout: the index of the block for 'probe', and the bit to
+  // test within word 'i' of that block.
+  static size_t PickBlock(const BloomKeyProbe &probe, size_t n_bits);
+  static uint32_t PickBitInWord(const BloomKeyProbe &probe, size_t i);
+
+  bool SplitBlockMayContainKey(const BloomKeyProbe &probe) const;
+
   size_t n_bits_;
   const uint8_t *bitmap_;
 
   size_t n_hashes_;
+
+  BloomFilterLayout layout_;
 };
 
 
@@ -220,7 +277,35 @@ inline uint32_t BloomFilter::PickBit(uint32_t hash, size_t n_bits) {
   }
 }
 
+inline size_t BloomFilter::PickBlock(const BloomKeyProbe &probe, size_t n_bits) {
+  // Maps the hash uniformly onto the blocks without a division.
+  const uint64_t n_blocks = n_bits / (kSplitBlockBytes * 8);
+  return (static_cast<uint64_t>(probe.secondary_hash()) * n_blocks) >> 32;
+}
+
+ATTRIBUTE_NO_SANITIZE_INTEGER
+inline uint32_t BloomFilter::PickBitInWord(const BloomKeyProbe &probe, size_t i) {
+  // Odd constants from which each word derives an independent bit position.
+  static const uint32_t kSalts[kSplitBlockWords] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+  };
+  return (probe.initial_hash() * kSalts[i]) >> 27;
+}
+
 inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
+  if (layout_ == BloomFilterLayout::SPLIT_BLOCK) {
+    uint8_t* block = &bitmap_[BloomFilter::PickBlock(probe, n_bits_) *
+                              BloomFilter::kSplitBlockBytes];
+    for (size_t i = 0; i < BloomFilter::kSplitBlockWords; i++) {
+      uint8_t* word = block + i * sizeof(uint32_t);
+      UnalignedStore<uint32_t>(
+          word, UnalignedLoad<uint32_t>(word) | (1U << BloomFilter::PickBitInWord(probe, i)));
+    }
+    n_inserted_++;
+    return;
+  }
+
   uint32_t h = probe.initial_hash();
   for (size_t i = 0; i < n_hashes_; i++) {
     uint32_t bitpos = BloomFilter::PickBit(h, n_bits_);
@@ -230,7 +315,22 @@ inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
   n_inserted_++;
 }
 
+inline bool BloomFilter::SplitBlockMayContainKey(const BloomKeyProbe &probe) const {
+  const uint8_t* block = &bitmap_[PickBlock(probe, n_bits_) * kSplitBlockBytes];
+  // The words are tested without branching, so that the compiler may turn
+  // the loop into a few SIMD instructions.
+  uint32_t all_set = 1;
+  for (size_t i = 0; i < kSplitBlockWords; i++) {
+    all_set &= UnalignedLoad<uint32_t>(block + i * sizeof(uint32_t)) >> PickBitInWord(probe, i);
+  }
+  return all_set & 1;
+}
+
 inline bool BloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  if (layout_ == BloomFilterLayout::SPLIT_BLOCK) {
+    return SplitBlockMayContainKey(probe);
+  }
+
   uint32_t h = probe.initial_hash();
 
   // Basic unrolling by 2s gives a small benefit here since the two bit positions
@@ -65,7 +65,11 @@ struct BenchSetup {
     // vast majority of lookups.
     ZIPFIAN,
     // Every item is equally likely to be looked up.
-    UNIFORM
+    UNIFORM,
+    // Zipfian lookups, interleaved with an equal number of lookups of keys
+    // which are never looked up again, as done by a large scan. The scan
+    // lookups are accounted for neither in the hit rate nor in the lookups/sec.
+    SCAN_MIX
   };
   Pattern pattern;
 
@@ -75,11 +79,18 @@ struct BenchSetup {
   // in the cache.
   double dataset_cache_ratio;
 
+  CacheEvictionPolicy policy;
+
   string ToString() const {
     string ret;
     switch (pattern) {
       case Pattern::ZIPFIAN: ret += "ZIPFIAN"; break;
       case Pattern::UNIFORM: ret += "UNIFORM"; break;
+      case Pattern::SCAN_MIX: ret += "SCAN_MIX"; break;
+    }
+    switch (policy) {
+      case CacheEvictionPolicy::LRU: ret += " LRU"; break;
+      case CacheEvictionPolicy::TINY_LFU: ret += " TINY_LFU"; break;
     }
     ret += StringPrintf(" ratio=%.2fx n_unique=%d", dataset_cache_ratio, max_key());
     return ret;
@@ -97,7 +108,7 @@ class CacheBench : public KuduTest,
   void SetUp() override {
     KuduTest::SetUp();
 
-    cache_.reset(NewLRUCache(DRAM_CACHE, kCacheCapacity, "test-cache"));
+    cache_.reset(NewCache(DRAM_CACHE, GetParam().policy, kCacheCapacity, "test-cache"));
   }
 
   // Run queries against the cache until '*done' becomes true.
@@ -107,9 +118,16 @@ class CacheBench : public KuduTest,
     Random r(GetRandomSeed32());
     int64_t lookups = 0;
     int64_t hits = 0;
+    bool scan = false;
     while (!*done) {
       uint32_t int_key;
-      if (setup.pattern == BenchSetup::Pattern::ZIPFIAN) {
+      if (setup.pattern == BenchSetup::Pattern::SCAN_MIX) {
+        scan = !scan;
+      }
+      if (scan) {
+        // The scanned keys are out of the range of the other lookups.
+        int_key = setup.max_key() + (next_scan_key_++ & 0x3fffffff);
+      } else if (setup.pattern != BenchSetup::Pattern::UNIFORM) {
         int_key = r.Skewed(Bits::Log2Floor(setup.max_key()));
       } else {
         int_key = r.Uniform(setup.max_key());
@@ -119,7 +137,7 @@ class CacheBench : public KuduTest,
       Slice key_slice(key_buf, arraysize(key_buf));
       Cache::Handle* h = cache_->Lookup(key_slice, Cache::EXPECT_IN_CACHE);
       if (h) {
-        hits++;
+        hits += scan ? 0 : 1;
       } else {
         Cache::PendingHandle* ph = cache_->Allocate(
             key_slice, /* val_len=*/kEntrySize, /* charge=*/kEntrySize);
@@ -127,7 +145,7 @@ class CacheBench : public KuduTest,
       }
 
       cache_->Release(h);
-      lookups++;
+      lookups += scan ? 0 : 1;
     }
     return {hits, lookups};
   }
@@ -156,15 +174,26 @@ class CacheBench : public KuduTest,
 
  protected:
   unique_ptr<Cache> cache_;
+
+  // The next key to look up for the scans of the SCAN_MIX pattern.
+  atomic<uint32_t> next_scan_key_{0};
 };
 
-// Test both distributions, and for each, test both the case where the data
-// fits in the cache and where it is a bit larger.
+// Test all the patterns with both eviction policies, and for each, test both
+// the case where the data fits in the cache and where it is a bit larger.
 INSTANTIATE_TEST_CASE_P(Patterns, CacheBench, testing::ValuesIn(std::vector<BenchSetup>{
-      {BenchSetup::Pattern::ZIPFIAN, 1.0},
-      {BenchSetup::Pattern::ZIPFIAN, 3.0},
-      {BenchSetup::Pattern::UNIFORM, 1.0},
-      {BenchSetup::Pattern::UNIFORM, 3.0}
+      {BenchSetup::Pattern::ZIPFIAN, 1.0, CacheEvictionPolicy::LRU},
+      {BenchSetup::Pattern::ZIPFIAN, 3.0, CacheEvictionPolicy::LRU},
+      {BenchSetup::Pattern::UNIFORM, 1.0, CacheEvictionPolicy::LRU},
+      {BenchSetup::Pattern::UNIFORM, 3.0, CacheEvictionPolicy::LRU},
+      {BenchSetup::Pattern::SCAN_MIX, 1.0, CacheEvictionPolicy::LRU},
+      {BenchSetup::Pattern::SCAN_MIX, 3.0, CacheEvictionPolicy::LRU},
+      {BenchSetup::Pattern::ZIPFIAN, 1.0, CacheEvictionPolicy::TINY_LFU},
+      {BenchSetup::Pattern::ZIPFIAN, 3.0, CacheEvictionPolicy::TINY_LFU},
+      {BenchSetup::Pattern::UNIFORM, 1.0, CacheEvictionPolicy::TINY_LFU},
+      {BenchSetup::Pattern::UNIFORM, 3.0, CacheEvictionPolicy::TINY_LFU},
+      {BenchSetup::Pattern::SCAN_MIX, 1.0, CacheEvictionPolicy::TINY_LFU},
+      {BenchSetup::Pattern::SCAN_MIX, 3.0, CacheEvictionPolicy::TINY_LFU}
     }));
 
 TEST_P(CacheBench, RunBench) {
@@ -27,9 +27,11 @@
 #include "kudu/util/test_util.h"
 
 #if defined(__linux__)
+DECLARE_bool(nvm_cache_persistent);
 DECLARE_string(nvm_cache_path);
 #endif // defined(__linux__)
 
+DECLARE_bool(cache_force_single_shard);
 DECLARE_double(cache_memtracker_approximation_ratio);
 
 namespace kudu {
@@ -243,4 +245,118 @@ TEST_P(CacheTest, HeavyEntries) {
   ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
 }
 
+#if defined(__linux__)
+// Test that a persistent NVM cache starts with the entries saved by the
+// previous one, and erases those of them which turn out to be stale.
+TEST_P(CacheTest, Persistence) {
+  if (GetParam() != NVM_CACHE) return;
+  FLAGS_nvm_cache_persistent = true;
+  Insert(100, 101);
+  Insert(200, 201);
+  Insert(300, 301);
+  ASSERT_OK(cache_->Persist());
+  ASSERT_FALSE(cache_->HasUnvalidatedEntries());
+
+  cache_.reset(NewLRUCache(NVM_CACHE, kCacheSize, "cache_test"));
+  ASSERT_TRUE(cache_->HasUnvalidatedEntries());
+  ASSERT_EQ(201, Lookup(200));
+
+  cache_->ValidateRestoredEntries([](const Slice& key) {
+    return DecodeInt(key) != 200;
+  });
+  ASSERT_FALSE(cache_->HasUnvalidatedEntries());
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+  ASSERT_EQ(301, Lookup(300));
+}
+#endif // defined(__linux__)
+
+// Tests of the admission of entries by the TinyLFU policy. The cache has a
+// single shard, of 4096 entries.
+class TinyLFUCacheTest : public KuduTest,
+                         public Cache::EvictionCallback {
+ public:
+  void EvictedEntry(Slice key, Slice /*val*/) override {
+    evicted_keys_.push_back(DecodeInt(key));
+  }
+
+  void SetUp() override {
+    KuduTest::SetUp();
+    FLAGS_cache_force_single_shard = true;
+    cache_.reset(NewCache(DRAM_CACHE, CacheEvictionPolicy::TINY_LFU,
+                          kNumEntries * kEntrySize, "tinylfu_cache_test"));
+  }
+
+ protected:
+  static const int kNumEntries = 4096;
+  static const int kEntrySize = 4096;
+
+  // Looks up 'key', inserting it on a miss like the block cache does.
+  // Returns whether the lookup hit.
+  bool LookupOrInsert(int key) {
+    std::string key_str = EncodeInt(key);
+    Cache::UniqueHandle h(cache_->Lookup(key_str, Cache::EXPECT_IN_CACHE),
+                          Cache::HandleDeleter(cache_.get()));
+    if (h) {
+      return true;
+    }
+    h.reset(Insert(key));
+    return false;
+  }
+
+  Cache::Handle* Insert(int key) {
+    std::string key_str = EncodeInt(key);
+    Cache::PendingHandle* ph = CHECK_NOTNULL(
+        cache_->Allocate(key_str, key_str.size(), kEntrySize));
+    memcpy(cache_->MutableValue(ph), key_str.data(), key_str.size());
+    return cache_->Insert(ph, this);
+  }
+
+  std::vector<int> evicted_keys_;
+  gscoped_ptr<Cache> cache_;
+};
+
+// Test that a scan of many keys accessed once doesn't flush the entries which
+// are accessed over and over.
+TEST_F(TinyLFUCacheTest, ScanResistance) {
+  const int kNumHotKeys = 1000;
+  for (int i = 0; i < 4; i++) {
+    for (int key = 0; key < kNumHotKeys; key++) {
+      LookupOrInsert(key);
+    }
+  }
+
+  // With LRU eviction, this would evict the whole hot set.
+  for (int key = kNumHotKeys; key < kNumHotKeys + 10 * kNumEntries; key++) {
+    ASSERT_FALSE(LookupOrInsert(key));
+  }
+  for (int key = 0; key < kNumHotKeys; key++) {
+    ASSERT_TRUE(LookupOrInsert(key)) << key;
+  }
+}
+
+// Test that an entry which isn't admitted into the full cache is still usable
+// by its inserter, and is freed once released.
+TEST_F(TinyLFUCacheTest, RejectedEntry) {
+  for (int key = 0; key < kNumEntries; key++) {
+    LookupOrInsert(key);
+    LookupOrInsert(key);
+  }
+  ASSERT_TRUE(evicted_keys_.empty());
+
+  const int kNewKey = kNumEntries;
+  Cache::Handle* h = Insert(kNewKey);
+  ASSERT_EQ(kNewKey, DecodeInt(cache_->Value(h)));
+  ASSERT_EQ(nullptr, cache_->Lookup(EncodeInt(kNewKey), Cache::EXPECT_IN_CACHE));
+  ASSERT_TRUE(evicted_keys_.empty());
+  cache_->Release(h);
+  ASSERT_EQ(std::vector<int>({ kNewKey }), evicted_keys_);
+
+  // Looking the key up often enough gets it admitted.
+  for (int i = 0; i < 10; i++) {
+    LookupOrInsert(kNewKey);
+  }
+  ASSERT_TRUE(LookupOrInsert(kNewKey));
+}
+
 }  // namespace kudu
@@ -4,6 +4,7 @@
 
 #include "kudu/util/cache.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstring>
@@ -77,6 +78,7 @@ struct LRUHandle {
   uint32_t val_length;
   std::atomic<int32_t> refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  std::atomic<bool> referenced;  // Whether hit since the last CLOCK pass (TinyLFU only)
 
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
@@ -186,13 +188,12 @@ class HandleTable {
   }
 };
 
-// A single shard of sharded cache.
-class LRUCache {
+// The state and accounting common to the shards of all the eviction policies.
+class CacheShard {
  public:
-  explicit LRUCache(MemTracker* tracker);
-  ~LRUCache();
+  explicit CacheShard(MemTracker* tracker);
 
-  // Separate from constructor so caller can easily make an array of LRUCache
+  // Separate from constructor so caller can easily make an array of shards
   void SetCapacity(size_t capacity) {
     capacity_ = capacity;
     max_deferred_consumption_ = capacity * FLAGS_cache_memtracker_approximation_ratio;
@@ -200,21 +201,24 @@ class LRUCache {
 
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
 
-  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
-  // Like Cache::Lookup, but with an extra "hash" parameter.
-  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
   void Release(Cache::Handle* handle);
-  void Erase(const Slice& key, uint32_t hash);
 
- private:
-  void LRU_Remove(LRUHandle* e);
-  void LRU_Append(LRUHandle* e);
+ protected:
+  ~CacheShard();
+
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(LRUHandle* e);
   // Call the user's eviction callback, if it exists, and free the entry.
   void FreeEntry(LRUHandle* e);
 
+  // Sets the members of 'e' which were not already set during Allocate(), and
+  // accounts for its insertion.
+  void PrepareInsert(LRUHandle* e, Cache::EvictionCallback* eviction_callback);
+
+  // Updates the lookup metrics. Should be called without the lock held.
+  void RecordLookup(bool was_hit, bool caching);
+
   // Update the memtracker's consumption by the given amount.
   //
   // This "buffers" the updates locally in 'deferred_consumption_' until the amount
@@ -235,18 +239,17 @@ class LRUCache {
   // Positive delta indicates an increased memory consumption.
   void UpdateMemTracker(int64_t delta);
 
-  // Initialized before use.
-  size_t capacity_;
-
-  // mutex_ protects the following state.
-  MutexType mutex_;
-  size_t usage_;
+  // Unlinks 'e' from the list it's in.
+  static void List_Remove(LRUHandle* e);
+  // Links 'e' at the end of the list whose dummy head is 'head'.
+  static void List_Append(LRUHandle* head, LRUHandle* e);
 
-  // Dummy head of LRU list.
-  // lru.prev is newest entry, lru.next is oldest entry.
-  LRUHandle lru_;
+  // Unrefs and frees the entries of the list whose dummy head is 'head', on
+  // destruction of the shard.
+  void FreeList(LRUHandle* head);
 
-  HandleTable table_;
+  // Initialized before use.
+  size_t capacity_;
 
   MemTracker* mem_tracker_;
   atomic<int64_t> deferred_consumption_ { 0 };
@@ -258,34 +261,21 @@ class LRUCache {
   CacheMetrics* metrics_;
 };
 
-LRUCache::LRUCache(MemTracker* tracker)
- : usage_(0),
-   mem_tracker_(tracker),
+CacheShard::CacheShard(MemTracker* tracker)
+ : mem_tracker_(tracker),
    metrics_(nullptr) {
-  // Make empty circular linked list
-  lru_.next = &lru_;
-  lru_.prev = &lru_;
 }
 
-LRUCache::~LRUCache() {
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    DCHECK_EQ(e->refs.load(std::memory_order_relaxed), 1)
-        << "caller has an unreleased handle";
-    if (Unref(e)) {
-      FreeEntry(e);
-    }
-    e = next;
-  }
+CacheShard::~CacheShard() {
   mem_tracker_->Consume(deferred_consumption_);
 }
 
-bool LRUCache::Unref(LRUHandle* e) {
+bool CacheShard::Unref(LRUHandle* e) {
   DCHECK_GT(e->refs.load(std::memory_order_relaxed), 0);
   return e->refs.fetch_sub(1) == 1;
 }
 
-void LRUCache::FreeEntry(LRUHandle* e) {
+void CacheShard::FreeEntry(LRUHandle* e) {
   DCHECK_EQ(e->refs.load(std::memory_order_relaxed), 0);
   if (e->eviction_callback) {
     e->eviction_callback->EvictedEntry(e->key(), e->value());
@@ -298,7 +288,38 @@ void LRUCache::FreeEntry(LRUHandle* e) {
   delete [] e;
 }
 
-void LRUCache::UpdateMemTracker(int64_t delta) {
+void CacheShard::PrepareInsert(LRUHandle* e, Cache::EvictionCallback* eviction_callback) {
+  e->eviction_callback = eviction_callback;
+  e->refs.store(2, std::memory_order_relaxed);  // One from the shard, one for the returned handle
+  e->referenced.store(false, std::memory_order_relaxed);
+  UpdateMemTracker(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->IncrementBy(e->charge);
+    metrics_->inserts->Increment();
+  }
+}
+
+void CacheShard::RecordLookup(bool was_hit, bool caching) {
+  if (!metrics_) {
+    return;
+  }
+  metrics_->lookups->Increment();
+  if (was_hit) {
+    if (caching) {
+      metrics_->cache_hits_caching->Increment();
+    } else {
+      metrics_->cache_hits->Increment();
+    }
+  } else {
+    if (caching) {
+      metrics_->cache_misses_caching->Increment();
+    } else {
+      metrics_->cache_misses->Increment();
+    }
+  }
+}
+
+void CacheShard::UpdateMemTracker(int64_t delta) {
   int64_t old_deferred = deferred_consumption_.fetch_add(delta);
   int64_t new_deferred = old_deferred + delta;
 
@@ -309,18 +330,86 @@ void LRUCache::UpdateMemTracker(int64_t delta) {
   }
 }
 
-void LRUCache::LRU_Remove(LRUHandle* e) {
+void CacheShard::Release(Cache::Handle* handle) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+  bool last_reference = Unref(e);
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+void CacheShard::List_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
-  usage_ -= e->charge;
 }
 
-void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
+void CacheShard::List_Append(LRUHandle* head, LRUHandle* e) {
+  // Make "e" newest entry by inserting just before the head
+  e->next = head;
+  e->prev = head->prev;
   e->prev->next = e;
   e->next->prev = e;
+}
+
+void CacheShard::FreeList(LRUHandle* head) {
+  for (LRUHandle* e = head->next; e != head; ) {
+    LRUHandle* next = e->next;
+    DCHECK_EQ(e->refs.load(std::memory_order_relaxed), 1)
+        << "caller has an unreleased handle";
+    if (Unref(e)) {
+      FreeEntry(e);
+    }
+    e = next;
+  }
+}
+
+// A single shard of sharded cache, evicting the least recently used entries.
+class LRUCache : public CacheShard {
+ public:
+  static constexpr const char* const kName = "lru";
+
+  explicit LRUCache(MemTracker* tracker);
+  ~LRUCache();
+
+  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
+  // Like Cache::Lookup, but with an extra "hash" parameter.
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  void LRU_Remove(LRUHandle* e);
+  void LRU_Append(LRUHandle* e);
+
+  // mutex_ protects the following state.
+  MutexType mutex_;
+  size_t usage_;
+
+  // Dummy head of LRU list.
+  // lru.prev is newest entry, lru.next is oldest entry.
+  LRUHandle lru_;
+
+  HandleTable table_;
+};
+
+LRUCache::LRUCache(MemTracker* tracker)
+ : CacheShard(tracker),
+   usage_(0) {
+  // Make empty circular linked list
+  lru_.next = &lru_;
+  lru_.prev = &lru_;
+}
+
+LRUCache::~LRUCache() {
+  FreeList(&lru_);
+}
+
+void LRUCache::LRU_Remove(LRUHandle* e) {
+  List_Remove(e);
+  usage_ -= e->charge;
+}
+
+void LRUCache::LRU_Append(LRUHandle* e) {
+  List_Append(&lru_, e);
   usage_ += e->charge;
 }
 
@@ -337,46 +426,13 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
   }
 
   // Do the metrics outside of the lock.
-  if (metrics_) {
-    metrics_->lookups->Increment();
-    bool was_hit = (e != nullptr);
-    if (was_hit) {
-      if (caching) {
-        metrics_->cache_hits_caching->Increment();
-      } else {
-        metrics_->cache_hits->Increment();
-      }
-    } else {
-      if (caching) {
-        metrics_->cache_misses_caching->Increment();
-      } else {
-        metrics_->cache_misses->Increment();
-      }
-    }
-  }
+  RecordLookup(e != nullptr, caching);
 
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
-void LRUCache::Release(Cache::Handle* handle) {
-  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
-  bool last_reference = Unref(e);
-  if (last_reference) {
-    FreeEntry(e);
-  }
-}
-
 Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
-
-  // Set the remaining LRUHandle members which were not already allocated during
-  // Allocate().
-  e->eviction_callback = eviction_callback;
-  e->refs.store(2, std::memory_order_relaxed);  // One from LRUCache, one for the returned handle
-  UpdateMemTracker(e->charge);
-  if (PREDICT_TRUE(metrics_)) {
-    metrics_->cache_usage->IncrementBy(e->charge);
-    metrics_->inserts->Increment();
-  }
+  PrepareInsert(e, eviction_callback);
 
   LRUHandle* to_remove_head = nullptr;
   {
@@ -433,20 +489,300 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+// Estimates how often keys were accessed lately from their hash, with a
+// count-min sketch: kDepth rows of small saturating counters, each row indexed
+// by a different hash of the key. The estimate of a key is the lowest of its
+// counters.
+//
+// All the counters are halved once the number of recorded accesses reaches
+// ten times the width of the sketch, so that the estimates reflect recent
+// accesses rather than the whole history.
+class FrequencySketch {
+ public:
+  // 'width' is rounded up to a power of 2.
+  explicit FrequencySketch(size_t width);
+
+  // Records an access to the key with hash 'hash'. Thread-safe and lock-free.
+  void Increment(uint32_t hash);
+
+  // Returns the estimated number of recent accesses to the key with hash
+  // 'hash', up to kMaxCount.
+  int Estimate(uint32_t hash) const;
+
+  // Whether enough accesses were recorded for the counters to be halved.
+  bool NeedsAging() const {
+    return additions_.load(std::memory_order_relaxed) >= sample_size_;
+  }
+
+  // Halves all the counters. Concurrent calls to Increment() are safe but may
+  // be lost; concurrent calls to Age() are not safe.
+  void Age();
+
+ private:
+  static constexpr int kDepth = 4;
+  static constexpr uint8_t kMaxCount = 15;
+
+  size_t Index(uint32_t hash, int row) const {
+    static constexpr uint32_t kSeeds[kDepth] = {
+      0x97cb3127, 0xb8f5c1e3, 0x4c9a1f5b, 0xe2d4ab71
+    };
+    uint32_t h = (hash ^ kSeeds[row]) * 0x9e3779b1;
+    h ^= h >> 16;
+    return row * (width_mask_ + 1) + (h & width_mask_);
+  }
+
+  size_t width_mask_;
+  int64_t sample_size_;
+  std::unique_ptr<atomic<uint8_t>[]> counters_;
+  atomic<int64_t> additions_ { 0 };
+};
+
+FrequencySketch::FrequencySketch(size_t width) {
+  size_t rounded_width = 1UL << Bits::Log2Ceiling64(std::max<size_t>(width, 1));
+  width_mask_ = rounded_width - 1;
+  sample_size_ = 10 * rounded_width;
+  counters_.reset(new atomic<uint8_t>[kDepth * rounded_width]);
+  for (size_t i = 0; i < kDepth * rounded_width; i++) {
+    counters_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void FrequencySketch::Increment(uint32_t hash) {
+  for (int row = 0; row < kDepth; row++) {
+    atomic<uint8_t>* counter = &counters_[Index(hash, row)];
+    uint8_t count = counter->load(std::memory_order_relaxed);
+    while (count < kMaxCount &&
+           !counter->compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+    }
+  }
+  additions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+int FrequencySketch::Estimate(uint32_t hash) const {
+  int estimate = kMaxCount;
+  for (int row = 0; row < kDepth; row++) {
+    estimate = std::min<int>(estimate,
+                             counters_[Index(hash, row)].load(std::memory_order_relaxed));
+  }
+  return estimate;
+}
+
+void FrequencySketch::Age() {
+  for (size_t i = 0; i < kDepth * (width_mask_ + 1); i++) {
+    counters_[i].store(counters_[i].load(std::memory_order_relaxed) / 2,
+                       std::memory_order_relaxed);
+  }
+  additions_.store(0, std::memory_order_relaxed);
+}
+
+// A single shard of sharded cache, with a TinyLFU admission policy and CLOCK
+// eviction.
+//
+// Every lookup, hit or miss, is recorded in a frequency sketch. When the shard
+// is full, a new entry is only admitted if its key was accessed more often
+// lately than the entry it would evict, so that a scan of keys accessed once
+// doesn't flush out the entries accessed over and over. A rejected entry is
+// still returned to the inserter, but isn't visible to lookups and is freed
+// once released.
+//
+// The eviction candidates are picked in CLOCK order ("second chance"): the
+// entries are kept in insertion order and a hit only sets the 'referenced' bit
+// of the entry, which saves the entry from the next eviction pass. Unlike with
+// LRUCache, a hit doesn't reorder any list, so lookups only take the shard
+// lock in shared mode and don't serialize with one another.
+class TinyLFUCache : public CacheShard {
+ public:
+  static constexpr const char* const kName = "tinylfu";
+
+  // Size of the entries the frequency sketch is sized for: it has one counter
+  // per row for every kSketchBytesPerCounter bytes of capacity.
+  static constexpr size_t kSketchBytesPerCounter = 4096;
+
+  explicit TinyLFUCache(MemTracker* tracker);
+  ~TinyLFUCache();
+
+  void SetCapacity(size_t capacity) {
+    CacheShard::SetCapacity(capacity);
+    sketch_.reset(new FrequencySketch(capacity / kSketchBytesPerCounter));
+  }
+
+  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
+  // Like Cache::Lookup, but with an extra "hash" parameter.
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  // Returns the next entry to evict, giving a second chance to the entries
+  // referenced since the previous pass.
+  //
+  // REQUIRES: the lock is held exclusively and the clock isn't empty.
+  LRUHandle* NextVictim();
+
+  // Unlinks 'e' from the clock and the table.
+  //
+  // REQUIRES: the lock is held exclusively.
+  void Remove(LRUHandle* e);
+
+  // Protects the following state. Taken in shared mode by lookups, whose
+  // updates to the entries and the sketch are atomic.
+  rw_spinlock mutex_;
+  size_t usage_;
+
+  // Dummy head of the list of entries in CLOCK order: clock_.next is the
+  // next eviction candidate, clock_.prev the latest entry inserted or given
+  // a second chance.
+  LRUHandle clock_;
+
+  HandleTable table_;
+
+  std::unique_ptr<FrequencySketch> sketch_;
+};
+
+TinyLFUCache::TinyLFUCache(MemTracker* tracker)
+ : CacheShard(tracker),
+   usage_(0),
+   sketch_(new FrequencySketch(0)) {
+  clock_.next = &clock_;
+  clock_.prev = &clock_;
+}
+
+TinyLFUCache::~TinyLFUCache() {
+  FreeList(&clock_);
+}
+
+LRUHandle* TinyLFUCache::NextVictim() {
+  // Every entry skipped loses its bit, so this ends within a full turn.
+  while (true) {
+    LRUHandle* e = clock_.next;
+    DCHECK_NE(e, &clock_);
+    if (!e->referenced.exchange(false, std::memory_order_relaxed)) {
+      return e;
+    }
+    List_Remove(e);
+    List_Append(&clock_, e);
+  }
+}
+
+void TinyLFUCache::Remove(LRUHandle* e) {
+  List_Remove(e);
+  table_.Remove(e->key(), e->hash);
+  usage_ -= e->charge;
+}
+
+Cache::Handle* TinyLFUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
+  LRUHandle* e;
+  {
+    shared_lock<rw_spinlock> l(mutex_);
+    e = table_.Lookup(key, hash);
+    if (e != nullptr) {
+      e->refs.fetch_add(1, std::memory_order_relaxed);
+      if (!e->referenced.load(std::memory_order_relaxed)) {
+        e->referenced.store(true, std::memory_order_relaxed);
+      }
+    }
+  }
+  sketch_->Increment(hash);
+
+  // Do the metrics outside of the lock.
+  RecordLookup(e != nullptr, caching);
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+Cache::Handle* TinyLFUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
+  PrepareInsert(e, eviction_callback);
+
+  LRUHandle* to_remove_head = nullptr;
+  {
+    std::lock_guard<rw_spinlock> l(mutex_);
+    if (sketch_->NeedsAging()) {
+      sketch_->Age();
+    }
+
+    // An entry replacing another one with the same key is always admitted.
+    LRUHandle* old = table_.Lookup(e->key(), e->hash);
+    const bool replacing = old != nullptr;
+    if (replacing) {
+      Remove(old);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+
+    bool admit = true;
+    if (usage_ + e->charge > capacity_) {
+      int frequency = sketch_->Estimate(e->hash);
+      while (usage_ + e->charge > capacity_ && clock_.next != &clock_) {
+        LRUHandle* victim = NextVictim();
+        if (!replacing && sketch_->Estimate(victim->hash) >= frequency) {
+          admit = false;
+          break;
+        }
+        Remove(victim);
+        if (Unref(victim)) {
+          victim->next = to_remove_head;
+          to_remove_head = victim;
+        }
+      }
+    }
+
+    if (admit) {
+      List_Append(&clock_, e);
+      table_.Insert(e);
+      usage_ += e->charge;
+    } else {
+      // Only the returned handle refers to the entry.
+      e->refs.store(1, std::memory_order_relaxed);
+    }
+  }
+
+  // we free the entries here outside of mutex for
+  // performance reasons
+  while (to_remove_head != nullptr) {
+    LRUHandle* next = to_remove_head->next;
+    FreeEntry(to_remove_head);
+    to_remove_head = next;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void TinyLFUCache::Erase(const Slice& key, uint32_t hash) {
+  LRUHandle* e;
+  bool last_reference = false;
+  {
+    std::lock_guard<rw_spinlock> l(mutex_);
+    e = table_.Lookup(key, hash);
+    if (e != nullptr) {
+      Remove(e);
+      last_reference = Unref(e);
+    }
+  }
+  // mutex not held here
+  // last_reference will only be true if e != NULL
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
 // Determine the number of bits of the hash that should be used to determine
 // the cache shard. This, in turn, determines the number of shards.
 int DetermineShardBits() {
   int bits = PREDICT_FALSE(FLAGS_cache_force_single_shard) ?
       0 : Bits::Log2Ceiling(base::NumCPUs());
-  VLOG(1) << "Will use " << (1 << bits) << " shards for LRU cache.";
+  VLOG(1) << "Will use " << (1 << bits) << " shards for cache.";
   return bits;
 }
 
-class ShardedLRUCache : public Cache {
+// A cache whose entries are spread over shards of type 'ShardType' by hash,
+// each with its own lock, to reduce the contention.
+template <class ShardType>
+class ShardedCache : public Cache {
  private:
   shared_ptr<MemTracker> mem_tracker_;
   gscoped_ptr<CacheMetrics> metrics_;
-  vector<LRUCache*> shards_;
+  vector<ShardType*> shards_;
 
   // Number of bits of hash used to determine the shard.
   const int shard_bits_;
@@ -467,24 +803,24 @@ class ShardedLRUCache : public Cache {
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
+  explicit ShardedCache(size_t capacity, const string& id)
       : shard_bits_(DetermineShardBits()) {
     // A cache is often a singleton, so:
     // 1. We reuse its MemTracker if one already exists, and
     // 2. It is directly parented to the root MemTracker.
     mem_tracker_ = MemTracker::FindOrCreateGlobalTracker(
-        -1, strings::Substitute("$0-sharded_lru_cache", id));
+        -1, strings::Substitute("$0-sharded_$1_cache", id, ShardType::kName));
 
     int num_shards = 1 << shard_bits_;
     const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
     for (int s = 0; s < num_shards; s++) {
-      gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
+      gscoped_ptr<ShardType> shard(new ShardType(mem_tracker_.get()));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
   }
 
-  virtual ~ShardedLRUCache() {
+  virtual ~ShardedCache() {
     STLDeleteElements(&shards_);
   }
 
@@ -519,7 +855,7 @@ class ShardedLRUCache : public Cache {
       return;
     }
     metrics_.reset(new CacheMetrics(entity));
-    for (LRUCache* cache : shards_) {
+    for (ShardType* cache : shards_) {
       cache->SetMetrics(metrics_.get());
     }
   }
@@ -557,16 +893,30 @@ class ShardedLRUCache : public Cache {
 }  // end anonymous namespace
 
 Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
+  return NewCache(type, CacheEvictionPolicy::LRU, capacity, id);
+}
+
+Cache* NewCache(CacheType type, CacheEvictionPolicy policy, size_t capacity,
+                const string& id) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      switch (policy) {
+        case CacheEvictionPolicy::LRU:
+          return new ShardedCache<LRUCache>(capacity, id);
+        case CacheEvictionPolicy::TINY_LFU:
+          return new ShardedCache<TinyLFUCache>(capacity, id);
+      }
+      break;
 #if defined(HAVE_LIB_VMEM)
     case NVM_CACHE:
+      CHECK(policy == CacheEvictionPolicy::LRU) << "NVM caches only support LRU eviction";
       return NewLRUNvmCache(capacity, id);
 #endif
     default:
-      LOG(FATAL) << "Unsupported LRU cache type: " << type;
+      break;
   }
+  LOG(FATAL) << "Unsupported cache type: " << type;
+  __builtin_unreachable();
 }
 
 }  // namespace kudu
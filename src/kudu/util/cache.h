@@ -20,12 +20,14 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
@@ -37,10 +39,26 @@ enum CacheType {
   NVM_CACHE
 };
 
+// The policy deciding which entries a cache keeps once it is full.
+enum class CacheEvictionPolicy {
+  // Evict the least-recently-used entries.
+  LRU,
+
+  // Only admit new entries whose key was looked up more often lately than the
+  // entries they would evict (TinyLFU), picking the latter in CLOCK order.
+  // Resists scans of data accessed once, and lookups hitting the cache don't
+  // serialize on the shard locks. Only supported by DRAM_CACHE.
+  TINY_LFU,
+};
+
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used eviction policy.
 Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
 
+// Create a new cache with a fixed size capacity and the given eviction policy.
+Cache* NewCache(CacheType type, CacheEvictionPolicy policy, size_t capacity,
+                const std::string& id);
+
 class Cache {
  public:
   // Callback interface which is called when an entry is evicted from the
@@ -207,6 +225,29 @@ class Cache {
   // Free 'ptr', which must have been previously allocated using 'Allocate'.
   virtual void Free(PendingHandle* ptr) = 0;
 
+  // ------------------------------------------------------------
+  // Persistence
+  // ------------------------------------------------------------
+  //
+  // A persistent cache starts with the entries saved by the previous process
+  // which created a cache with the same id. Entries restored this way have no
+  // eviction callback.
+
+  // Saves the entries of a persistent cache. The previously saved entries
+  // are replaced atomically, so that a crash while saving leaves them intact.
+  // Caches which aren't persistent have nothing to save.
+  virtual Status Persist() { return Status::OK(); }
+
+  // Returns whether some entries restored from a previous process haven't
+  // been validated by ValidateRestoredEntries() yet.
+  virtual bool HasUnvalidatedEntries() const { return false; }
+
+  // Erases the entries restored from a previous process whose key 'is_valid'
+  // returns false for, e.g. because the data they cache no longer exists.
+  // Only the first call has entries to validate.
+  virtual void ValidateRestoredEntries(
+      const std::function<bool(const Slice& key)>& /*is_valid*/) {}
+
  private:
   DISALLOW_COPY_AND_ASSIGN(Cache);
 };
@@ -87,4 +87,8 @@ TEST_F(TestCompression, TestZlibCompressionCodec) {
   TestCompressionCodec(ZLIB);
 }
 
+TEST_F(TestCompression, TestZstdCompressionCodec) {
+  TestCompressionCodec(ZSTD);
+}
+
 } // namespace kudu
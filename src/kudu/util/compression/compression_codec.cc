@@ -22,18 +22,29 @@
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <lz4.h>
 #include <snappy-sinksource.h>
 #include <snappy.h>
 #include <zlib.h>
+#include <zstd.h>
 
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/string_case.h"
+#include "kudu/util/threadlocal.h"
+
+DEFINE_int32(zstd_compression_level, 3,
+             "Compression level used by the ZSTD codec. Higher levels compress "
+             "better but more slowly; decompression speed is about the same at "
+             "every level. Negative levels trade compression ratio for speed.");
+TAG_FLAG(zstd_compression_level, experimental);
+TAG_FLAG(zstd_compression_level, runtime);
 
 namespace kudu {
 
@@ -244,6 +255,96 @@ class ZlibCodec : public CompressionCodec {
   }
 };
 
+// Reusing a context across calls avoids allocating and initializing zstd's
+// internal state for every block.
+class ZstdCompressionContext {
+ public:
+  ZstdCompressionContext() : ctx_(ZSTD_createCCtx()) {
+    CHECK(ctx_) << "unable to create ZSTD compression context";
+  }
+  ~ZstdCompressionContext() {
+    ZSTD_freeCCtx(ctx_);
+  }
+  ZSTD_CCtx* get() const { return ctx_; }
+
+ private:
+  ZSTD_CCtx* const ctx_;
+  DISALLOW_COPY_AND_ASSIGN(ZstdCompressionContext);
+};
+
+class ZstdDecompressionContext {
+ public:
+  ZstdDecompressionContext() : ctx_(ZSTD_createDCtx()) {
+    CHECK(ctx_) << "unable to create ZSTD decompression context";
+  }
+  ~ZstdDecompressionContext() {
+    ZSTD_freeDCtx(ctx_);
+  }
+  ZSTD_DCtx* get() const { return ctx_; }
+
+ private:
+  ZSTD_DCtx* const ctx_;
+  DISALLOW_COPY_AND_ASSIGN(ZstdDecompressionContext);
+};
+
+class ZstdCodec : public CompressionCodec {
+ public:
+  static ZstdCodec *GetSingleton() {
+    return Singleton<ZstdCodec>::get();
+  }
+
+  Status Compress(const Slice& input,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    BLOCK_STATIC_THREAD_LOCAL(ZstdCompressionContext, cctx);
+    size_t n = ZSTD_compressCCtx(cctx->get(),
+                                 compressed, MaxCompressedLength(input.size()),
+                                 input.data(), input.size(),
+                                 FLAGS_zstd_compression_level);
+    if (ZSTD_isError(n)) {
+      return Status::IOError("unable to compress the buffer", ZSTD_getErrorName(n));
+    }
+    *compressed_length = n;
+    return Status::OK();
+  }
+
+  Status Compress(const vector<Slice>& input_slices,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    if (input_slices.size() == 1) {
+      return Compress(input_slices[0], compressed, compressed_length);
+    }
+
+    SlicesSource source(input_slices);
+    faststring buffer;
+    source.Dump(&buffer);
+    return Compress(Slice(buffer.data(), buffer.size()), compressed, compressed_length);
+  }
+
+  Status Uncompress(const Slice& compressed,
+                    uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
+    BLOCK_STATIC_THREAD_LOCAL(ZstdDecompressionContext, dctx);
+    size_t n = ZSTD_decompressDCtx(dctx->get(),
+                                   uncompressed, uncompressed_length,
+                                   compressed.data(), compressed.size());
+    if (ZSTD_isError(n)) {
+      return Status::Corruption("unable to uncompress the buffer", ZSTD_getErrorName(n));
+    }
+    if (n != uncompressed_length) {
+      return Status::Corruption(
+          StringPrintf("unable to uncompress the buffer: expected %zu bytes, got %zu",
+                       uncompressed_length, n));
+    }
+    return Status::OK();
+  }
+
+  size_t MaxCompressedLength(size_t source_bytes) const OVERRIDE {
+    return ZSTD_compressBound(source_bytes);
+  }
+
+  CompressionType type() const override {
+    return ZSTD;
+  }
+};
+
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec) {
   switch (compression) {
@@ -259,6 +360,9 @@ Status GetCompressionCodec(CompressionType compression,
     case ZLIB:
       *codec = ZlibCodec::GetSingleton();
       break;
+    case ZSTD:
+      *codec = ZstdCodec::GetSingleton();
+      break;
     default:
       return Status::NotFound("bad compression type");
   }
@@ -275,6 +379,8 @@ CompressionType GetCompressionCodecType(const std::string& name) {
     return LZ4;
   if (uname == "ZLIB")
     return ZLIB;
+  if (uname == "ZSTD")
+    return ZSTD;
   if (uname == "NONE")
     return NO_COMPRESSION;
 
@@ -16,10 +16,18 @@
 // under the License.
 #include "kudu/util/crc.h"
 
+#if defined(__SSE4_2__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include <algorithm>
+
 #include <crcutil/interface.h>
 
 #include "kudu/gutil/once.h"
+#include "kudu/gutil/port.h"
 #include "kudu/util/debug/leakcheck_disabler.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 namespace crc {
@@ -52,5 +60,50 @@ uint32_t Crc32c(const void* data, size_t length, uint32_t prev_crc32) {
   return static_cast<uint32_t>(crc_tmp); // Only uses lower 32 bits.
 }
 
+#if defined(__SSE4_2__) && defined(__x86_64__)
+namespace {
+
+// Calculates the CRC32C of the three buffers 'a', 'b' and 'c' into 'crcs'.
+//
+// The words of the buffers are fed to the CRC32 instruction in turn, which
+// has a latency of three cycles but a throughput of one per cycle, up to the
+// end of the shortest buffer. The rest of the longer ones are left to crcutil.
+void Crc32cInterleaved3(const Slice& a, const Slice& b, const Slice& c, uint32_t* crcs) {
+  const uint8_t* pa = a.data();
+  const uint8_t* pb = b.data();
+  const uint8_t* pc = c.data();
+  const size_t words = std::min({ a.size(), b.size(), c.size() }) / sizeof(uint64_t);
+  uint64_t ca = 0xffffffff;
+  uint64_t cb = 0xffffffff;
+  uint64_t cc = 0xffffffff;
+  for (size_t i = 0; i < words; i++) {
+    ca = _mm_crc32_u64(ca, UNALIGNED_LOAD64(pa));
+    cb = _mm_crc32_u64(cb, UNALIGNED_LOAD64(pb));
+    cc = _mm_crc32_u64(cc, UNALIGNED_LOAD64(pc));
+    pa += sizeof(uint64_t);
+    pb += sizeof(uint64_t);
+    pc += sizeof(uint64_t);
+  }
+  const size_t done = words * sizeof(uint64_t);
+  crcs[0] = Crc32c(pa, a.size() - done, static_cast<uint32_t>(~ca));
+  crcs[1] = Crc32c(pb, b.size() - done, static_cast<uint32_t>(~cb));
+  crcs[2] = Crc32c(pc, c.size() - done, static_cast<uint32_t>(~cc));
+}
+
+} // anonymous namespace
+#endif
+
+void Crc32cMulti(ArrayView<const Slice> data, uint32_t* crcs) {
+  size_t i = 0;
+#if defined(__SSE4_2__) && defined(__x86_64__)
+  for (; i + 3 <= data.size(); i += 3) {
+    Crc32cInterleaved3(data[i], data[i + 1], data[i + 2], &crcs[i]);
+  }
+#endif
+  for (; i < data.size(); i++) {
+    crcs[i] = Crc32c(data[i].data(), data[i].size());
+  }
+}
+
 } // namespace crc
 } // namespace kudu
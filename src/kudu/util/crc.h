@@ -22,7 +22,12 @@
 
 #include <crcutil/interface.h>
 
+#include "kudu/util/array_view.h"
+
 namespace kudu {
+
+class Slice;
+
 namespace crc {
 
 typedef crcutil_interface::CRC Crc;
@@ -37,6 +42,15 @@ uint32_t Crc32c(const void* data, size_t length);
 // extends it to new chunk and returns the result.
 uint32_t Crc32c(const void* data, size_t length, uint32_t prev_crc32);
 
+// Calculates the CRC32C of each of the buffers in 'data' into the matching
+// element of 'crcs', which must have room for data.size() values.
+//
+// Faster than calculating them one at a time when the buffers are small: the
+// CRC32 instructions computing different buffers are interleaved, so that
+// they don't wait on each other's latency, which otherwise dominates for
+// buffers too short for the interleaving done within a single buffer.
+void Crc32cMulti(ArrayView<const Slice> data, uint32_t* crcs);
+
 } // namespace crc
 } // namespace kudu
 
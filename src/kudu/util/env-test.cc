@@ -654,6 +654,89 @@ TEST_F(TestEnv, TestReopen) {
   ASSERT_EQ(first + second, s.ToString());
 }
 
+TEST_F(TestEnv, TestDirectIOWritableFile) {
+  string test_path = GetTestPath("test_env_direct_wf");
+  WritableFileOptions opts;
+  opts.direct_io = true;
+  opts.dsync = true;
+  shared_ptr<WritableFile> writer;
+  Status s = env_util::OpenFileForWrite(opts, env_, test_path, &writer);
+  if (s.IsNotSupported() || s.posix_code() == EINVAL) {
+    LOG(INFO) << "direct I/O not supported, skipping test: " << s.ToString();
+    return;
+  }
+  ASSERT_OK(s);
+
+  // Append pieces of assorted, unaligned sizes, including ones spanning
+  // several blocks, so that the partial last block is rewritten.
+  string expected;
+  Random rng(SeedRandom());
+  for (int i = 0; i < 50; i++) {
+    string a = RandomString(rng.Uniform(100), &rng);
+    string b = RandomString(rng.Uniform(10000), &rng);
+    vector<Slice> data = { Slice(a), Slice(b) };
+    ASSERT_OK(writer->AppendV(data));
+    expected += a + b;
+    ASSERT_EQ(expected.size(), writer->Size());
+  }
+  ASSERT_OK(writer->Sync());
+  ASSERT_OK(writer->Close());
+
+  // The padding of the last block is truncated away on close.
+  shared_ptr<RandomAccessFile> reader;
+  ASSERT_OK(env_util::OpenFileForRandom(env_, test_path, &reader));
+  uint64_t size;
+  ASSERT_OK(reader->Size(&size));
+  ASSERT_EQ(expected.size(), size);
+  unique_ptr<uint8_t[]> scratch(new uint8_t[size]);
+  Slice result(scratch.get(), size);
+  ASSERT_OK(reader->Read(0, result));
+  ASSERT_EQ(expected, result.ToString());
+}
+
+// Test that appends continue from where a writable file was truncated, with
+// and without direct I/O.
+TEST_F(TestEnv, TestWritableFileTruncate) {
+  for (bool direct_io : { false, true }) {
+    SCOPED_TRACE(direct_io);
+    string test_path = GetTestPath(Substitute("test_env_truncate_wf_$0", direct_io));
+    WritableFileOptions opts;
+    opts.direct_io = direct_io;
+    shared_ptr<WritableFile> writer;
+    Status s = env_util::OpenFileForWrite(opts, env_, test_path, &writer);
+    if (direct_io && (s.IsNotSupported() || s.posix_code() == EINVAL)) {
+      LOG(INFO) << "direct I/O not supported, skipping: " << s.ToString();
+      continue;
+    }
+    ASSERT_OK(s);
+    if (fallocate_supported_) {
+      ASSERT_OK(writer->PreAllocate(kOneMb));
+    }
+
+    Random rng(SeedRandom());
+    string expected = RandomString(10000, &rng);
+    ASSERT_OK(writer->Append(expected));
+    ASSERT_OK(writer->Truncate(5000));
+    ASSERT_EQ(5000, writer->Size());
+    expected.resize(5000);
+    string more = RandomString(100, &rng);
+    ASSERT_OK(writer->Append(more));
+    expected += more;
+    ASSERT_EQ(expected.size(), writer->Size());
+    ASSERT_OK(writer->Close());
+
+    shared_ptr<RandomAccessFile> reader;
+    ASSERT_OK(env_util::OpenFileForRandom(env_, test_path, &reader));
+    uint64_t size;
+    ASSERT_OK(reader->Size(&size));
+    ASSERT_EQ(expected.size(), size);
+    unique_ptr<uint8_t[]> scratch(new uint8_t[size]);
+    Slice result(scratch.get(), size);
+    ASSERT_OK(reader->Read(0, result));
+    ASSERT_EQ(expected, result.ToString());
+  }
+}
+
 TEST_F(TestEnv, TestIsDirectory) {
   string dir = GetTestPath("a_directory");
   ASSERT_OK(env_->CreateDir(dir));
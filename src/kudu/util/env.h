@@ -173,6 +173,14 @@ class Env {
   // Synchronize the entry for a specific directory.
   virtual Status SyncDir(const std::string& dirname) = 0;
 
+  // Synchronize all the data and metadata written to the filesystem which
+  // holds 'path', as syncfs(2) does. Returns NotSupported on platforms
+  // without syncfs(2).
+  //
+  // NOTE: Linux only reports the errors of writing back the data of the
+  // filesystem's files from 5.8 on.
+  virtual Status SyncFileSystem(const std::string& path) = 0;
+
   // Recursively delete the specified directory.
   // This should operate safely, not following any symlinks, etc.
   virtual Status DeleteRecursively(const std::string &dirname) = 0;
@@ -435,6 +443,14 @@ class RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const = 0;
 
+  // Hints that 'length' bytes starting at 'offset' will soon be read, so
+  // that they can be fetched from disk asynchronously in the meantime. Only
+  // a hint: returns without waiting for the data, which may or may not be
+  // in memory by the time it's read.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status Prefetch(uint64_t offset, size_t length) const = 0;
+
   // Returns the size of the file
   virtual Status Size(uint64_t *size) const = 0;
 
@@ -454,9 +470,20 @@ struct WritableFileOptions {
   // See CreateMode for details.
   Env::CreateMode mode;
 
+  // Open the file with O_DIRECT, bypassing the page cache. Appends are staged
+  // through an aligned buffer and padded with zeros to the file system block
+  // size; the padding is truncated away on Close(). Only supported on Linux.
+  bool direct_io;
+
+  // Open the file with O_DSYNC, so that every append is durable once it
+  // returns and Sync() has nothing left to do. Only supported on Linux.
+  bool dsync;
+
   WritableFileOptions()
     : sync_on_close(false),
-      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE) { }
+      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE),
+      direct_io(false),
+      dsync(false) { }
 };
 
 // Options specified when a file is opened for random access.
@@ -498,6 +525,11 @@ class WritableFile {
   // In no case is the file truncated by this operation.
   virtual Status PreAllocate(uint64_t size) = 0;
 
+  // Truncates the file to 'size' bytes, which must not exceed Size(), and
+  // continues appending from there. Space pre-allocated past the end of the
+  // file is kept, reading as zeros.
+  virtual Status Truncate(uint64_t size) = 0;
+
   virtual Status Close() = 0;
 
   // Flush all dirty data (not metadata) to disk.
@@ -506,6 +538,12 @@ class WritableFile {
   // return a meaningful status.
   virtual Status Flush(FlushMode mode) = 0;
 
+  // Flush all dirty data and metadata to disk.
+  //
+  // May be called concurrently with AppendV() from a different thread. In
+  // that case, all data appended before Sync() was called is durable once it
+  // returns; data appended concurrently may or may not be, and will be
+  // covered by the next call to Sync().
   virtual Status Sync() = 0;
 
   virtual uint64_t Size() const = 0;
@@ -527,9 +565,16 @@ struct RWFileOptions {
   // See CreateMode for details.
   Env::CreateMode mode;
 
+  // Open the file with O_DIRECT, bypassing the page cache. Unlike with
+  // WritableFile, no staging is done: the offset, length and memory address
+  // of every read and write must be aligned to the file system block size.
+  // Only supported on Linux.
+  bool direct_io;
+
   RWFileOptions()
     : sync_on_close(false),
-      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE) { }
+      mode(Env::CREATE_IF_NON_EXISTING_TRUNCATE),
+      direct_io(false) { }
 };
 
 // A file abstraction for both reading and writing. No notion of a built-in
@@ -581,6 +626,14 @@ class RWFile {
   // Safe for concurrent use by multiple threads.
   virtual Status ReadV(uint64_t offset, ArrayView<Slice> results) const = 0;
 
+  // Hints that 'length' bytes starting at 'offset' will soon be read, so
+  // that they can be fetched from disk asynchronously in the meantime. Only
+  // a hint: returns without waiting for the data, which may or may not be
+  // in memory by the time it's read.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status Prefetch(uint64_t offset, size_t length) const = 0;
+
   // Writes 'data' to the file position given by 'offset'.
   virtual Status Write(uint64_t offset, const Slice& data) = 0;
 
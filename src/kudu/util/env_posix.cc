@@ -17,6 +17,7 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
@@ -47,6 +48,7 @@
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/util/alignment.h"
 #include "kudu/util/array_view.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
@@ -365,6 +367,19 @@ Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
   return Status::OK();
 }
 
+Status DoPrefetch(int fd, const string& filename, uint64_t offset, size_t length) {
+  MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
+  ThreadRestrictions::AssertIOAllowed();
+#if defined(__linux__)
+  // posix_fadvise() returns the error rather than setting errno.
+  int err = posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+  if (err != 0) {
+    return IOError(filename, err);
+  }
+#endif
+  return Status::OK();
+}
+
 Status DoReadV(int fd, const string& filename, uint64_t offset,
                ArrayView<Slice> results) {
   MAYBE_RETURN_EIO(filename, IOError(Env::kInjectedFailureStatusMsg, EIO));
@@ -615,6 +630,10 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return DoReadV(fd_, filename_, offset, results);
   }
 
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE {
+    return DoPrefetch(fd_, filename_, offset, length);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     MAYBE_RETURN_EIO(filename_, IOError(Env::kInjectedFailureStatusMsg, EIO));
     TRACE_EVENT1("io", "PosixRandomAccessFile::Size", "path", filename_);
@@ -641,12 +660,16 @@ class PosixRandomAccessFile: public RandomAccessFile {
 class PosixWritableFile : public WritableFile {
  public:
   PosixWritableFile(string fname, int fd, uint64_t file_size,
-                    bool sync_on_close)
+                    bool sync_on_close, bool dsync = false,
+                    size_t direct_io_block_size = 0)
       : filename_(std::move(fname)),
         fd_(fd),
         sync_on_close_(sync_on_close),
+        dsync_(dsync),
+        direct_io_block_size_(direct_io_block_size),
         filesize_(file_size),
         pre_allocated_size_(0),
+        direct_io_buf_size_(0),
         pending_sync_(false),
         closed_(false) {}
 
@@ -660,14 +683,20 @@ class PosixWritableFile : public WritableFile {
 
   virtual Status AppendV(ArrayView<const Slice> data) OVERRIDE {
     ThreadRestrictions::AssertIOAllowed();
-    RETURN_NOT_OK(DoWriteV(fd_, filename_, filesize_, data));
-    // Calculate the amount of data written
-    size_t bytes_written = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
-                                      [&](int sum, const Slice& curr) {
-                                        return sum + curr.size();
-                                      });
-    filesize_ += bytes_written;
-    pending_sync_ = true;
+    if (direct_io_block_size_ > 0) {
+      RETURN_NOT_OK(DirectAppendV(data));
+    } else {
+      RETURN_NOT_OK(DoWriteV(fd_, filename_, filesize_, data));
+      // Calculate the amount of data written
+      size_t bytes_written = accumulate(data.begin(), data.end(), static_cast<size_t>(0),
+                                        [&](int sum, const Slice& curr) {
+                                          return sum + curr.size();
+                                        });
+      filesize_ += bytes_written;
+    }
+    if (!dsync_) {
+      pending_sync_.store(true, std::memory_order_release);
+    }
     return Status::OK();
   }
 
@@ -692,6 +721,47 @@ class PosixWritableFile : public WritableFile {
     return Status::OK();
   }
 
+  virtual Status Truncate(uint64_t size) OVERRIDE {
+    MAYBE_RETURN_EIO(filename_, IOError(Env::kInjectedFailureStatusMsg, EIO));
+
+    TRACE_EVENT1("io", "PosixWritableFile::Truncate", "path", filename_);
+    ThreadRestrictions::AssertIOAllowed();
+    DCHECK_LE(size, filesize_);
+    // Direct I/O appends rewrite the partial last block, which must be
+    // reloaded from the file.
+    const size_t block_size = direct_io_block_size_;
+    if (block_size > 0 && size % block_size != 0) {
+      if (direct_io_buf_size_ < block_size) {
+        direct_io_buf_.reset(static_cast<uint8_t*>(aligned_malloc(block_size, block_size)));
+        if (!direct_io_buf_) {
+          return Status::RuntimeError("unable to allocate direct I/O buffer for " + filename_);
+        }
+        direct_io_buf_size_ = block_size;
+      }
+      ssize_t r;
+      RETRY_ON_EINTR(r, pread(fd_, direct_io_buf_.get(), block_size,
+                              KUDU_ALIGN_DOWN(size, block_size)));
+      if (r < static_cast<ssize_t>(size % block_size)) {
+        return r < 0 ? IOError(filename_, errno) :
+            Status::IOError("short read of the last block of " + filename_);
+      }
+    }
+    int ret;
+    RETRY_ON_EINTR(ret, ftruncate(fd_, size));
+    if (ret != 0) {
+      return IOError(filename_, errno);
+    }
+    filesize_ = size;
+    pending_sync_.store(true, std::memory_order_release);
+    if (pre_allocated_size_ > size) {
+      RETRY_ON_EINTR(ret, fallocate(fd_, 0, size, pre_allocated_size_ - size));
+      if (ret != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+        return IOError(filename_, errno);
+      }
+    }
+    return Status::OK();
+  }
+
   virtual Status Close() OVERRIDE {
     if (closed_) {
       return Status::OK();
@@ -701,14 +771,15 @@ class PosixWritableFile : public WritableFile {
     MAYBE_RETURN_EIO(filename_, IOError(Env::kInjectedFailureStatusMsg, EIO));
     Status s;
 
-    // If we've allocated more space than we used, truncate to the
-    // actual size of the file and perform Sync().
-    if (filesize_ < pre_allocated_size_) {
+    // If we've allocated more space than we used, or padded the last block
+    // for direct I/O, truncate to the actual size of the file and perform Sync().
+    if (filesize_ < pre_allocated_size_ ||
+        (direct_io_block_size_ > 0 && filesize_ % direct_io_block_size_ != 0)) {
       int ret;
       RETRY_ON_EINTR(ret, ftruncate(fd_, filesize_));
       if (ret != 0) {
         s = IOError(filename_, errno);
-        pending_sync_ = true;
+        pending_sync_.store(true, std::memory_order_release);
       }
     }
 
@@ -759,8 +830,7 @@ class PosixWritableFile : public WritableFile {
     TRACE_EVENT1("io", "PosixWritableFile::Sync", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
     LOG_SLOW_EXECUTION(WARNING, 1000, Substitute("sync call for $0", filename_)) {
-      if (pending_sync_) {
-        pending_sync_ = false;
+      if (pending_sync_.exchange(false, std::memory_order_acq_rel)) {
         RETURN_NOT_OK(DoSync(fd_, filename_));
       }
     }
@@ -774,13 +844,73 @@ class PosixWritableFile : public WritableFile {
   virtual const string& filename() const OVERRIDE { return filename_; }
 
  private:
+  // Appends 'data' to a file opened with O_DIRECT. The data is copied after
+  // the partial last block of the file, kept at the start of 'direct_io_buf_',
+  // and the result is written out padded with zeros to a whole number of
+  // blocks. This rewrites the partial last block on every append, but keeps
+  // the file contents identical to a buffered write.
+  Status DirectAppendV(ArrayView<const Slice> data) {
+    const size_t block_size = direct_io_block_size_;
+    size_t tail_len = filesize_ % block_size;
+    size_t bytes_req = tail_len;
+    for (const Slice& s : data) {
+      bytes_req += s.size();
+    }
+    size_t write_len = KUDU_ALIGN_UP(bytes_req, block_size);
+    if (write_len > direct_io_buf_size_) {
+      gscoped_ptr<uint8_t, FreeDeleter> new_buf(
+          static_cast<uint8_t*>(aligned_malloc(write_len, block_size)));
+      if (!new_buf) {
+        return Status::RuntimeError("unable to allocate direct I/O buffer for " + filename_);
+      }
+      if (tail_len > 0) {
+        memcpy(new_buf.get(), direct_io_buf_.get(), tail_len);
+      }
+      direct_io_buf_.swap(new_buf);
+      direct_io_buf_size_ = write_len;
+    }
+    uint8_t* dst = direct_io_buf_.get() + tail_len;
+    for (const Slice& s : data) {
+      memcpy(dst, s.data(), s.size());
+      dst += s.size();
+    }
+    memset(dst, 0, write_len - bytes_req);
+
+    Slice block_data(direct_io_buf_.get(), write_len);
+    RETURN_NOT_OK(DoWriteV(fd_, filename_, filesize_ - tail_len,
+                           ArrayView<const Slice>(&block_data, 1)));
+    filesize_ += bytes_req - tail_len;
+
+    // Keep the new partial last block, if any, for the next append.
+    size_t new_tail_len = filesize_ % block_size;
+    if (new_tail_len > 0 && write_len > block_size) {
+      memmove(direct_io_buf_.get(), direct_io_buf_.get() + write_len - block_size, new_tail_len);
+    }
+    return Status::OK();
+  }
+
   const string filename_;
   const int fd_;
   const bool sync_on_close_;
 
+  // Whether the file was opened with O_DSYNC.
+  const bool dsync_;
+
+  // If non-zero, the file was opened with O_DIRECT and all writes must be
+  // aligned to, and a multiple of, this many bytes.
+  const size_t direct_io_block_size_;
+
   uint64_t filesize_;
   uint64_t pre_allocated_size_;
-  bool pending_sync_;
+
+  // Aligned buffer reused across direct I/O appends. Starts with the partial
+  // last block of the file.
+  gscoped_ptr<uint8_t, FreeDeleter> direct_io_buf_;
+  size_t direct_io_buf_size_;
+
+  // Whether there is appended data which has not yet been synced. Atomic
+  // since Sync() may be called concurrently with AppendV().
+  std::atomic<bool> pending_sync_;
   bool closed_;
 };
 
@@ -805,6 +935,10 @@ class PosixRWFile : public RWFile {
     return DoReadV(fd_, filename_, offset, results);
   }
 
+  virtual Status Prefetch(uint64_t offset, size_t length) const OVERRIDE {
+    return DoPrefetch(fd_, filename_, offset, length);
+  }
+
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
     return WriteV(offset, ArrayView<const Slice>(&data, 1));
   }
@@ -1145,6 +1279,14 @@ class PosixEnv : public Env {
     TRACE_EVENT1("io", "PosixEnv::NewRWFile", "path", fname);
     int fd;
     RETURN_NOT_OK(DoOpen(fname, opts.mode, &fd));
+    if (opts.direct_io) {
+      Status s = EnableDirectIO(fname, fd);
+      if (!s.ok()) {
+        int err;
+        RETRY_ON_EINTR(err, close(fd));
+        return s;
+      }
+    }
     result->reset(new PosixRWFile(fname, fd, opts.sync_on_close));
     return Status::OK();
   }
@@ -1256,6 +1398,27 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  virtual Status SyncFileSystem(const string& path) OVERRIDE {
+    TRACE_EVENT1("io", "SyncFileSystem", "path", path);
+    MAYBE_RETURN_EIO(path, IOError(Env::kInjectedFailureStatusMsg, EIO));
+    ThreadRestrictions::AssertIOAllowed();
+#if defined(__linux__)
+    if (FLAGS_never_fsync) return Status::OK();
+    int fd;
+    RETRY_ON_EINTR(fd, open(path.c_str(), O_RDONLY));
+    if (fd < 0) {
+      return IOError(path, errno);
+    }
+    ScopedFdCloser fd_closer(fd);
+    if (syncfs(fd) != 0) {
+      return IOError(path, errno);
+    }
+    return Status::OK();
+#else
+    return Status::NotSupported("syncfs is not supported on this platform");
+#endif
+  }
+
   virtual Status DeleteRecursively(const string &name) OVERRIDE {
     return Walk(name, POST_ORDER, Bind(&PosixEnv::DeleteRecursivelyCb,
                                        Unretained(this)));
@@ -1790,8 +1953,72 @@ class PosixEnv : public Env {
     if (opts.mode == OPEN_EXISTING) {
       RETURN_NOT_OK(GetFileSize(fname, &file_size));
     }
-    result->reset(new PosixWritableFile(fname, fd, file_size, opts.sync_on_close));
+    size_t direct_io_block_size = 0;
+    if (opts.direct_io || opts.dsync) {
+      RETURN_NOT_OK(ReopenForDirectIO(fname, opts, &fd, &direct_io_block_size));
+    }
+    result->reset(new PosixWritableFile(fname, fd, file_size, opts.sync_on_close,
+                                        opts.dsync, direct_io_block_size));
+    return Status::OK();
+  }
+
+  // Replaces 'fd' with a new descriptor for 'fname' opened with O_DIRECT
+  // and/or O_DSYNC as requested by 'opts'. If O_DIRECT is requested, sets
+  // 'block_size' to the alignment required of writes.
+  Status ReopenForDirectIO(const string& fname, const WritableFileOptions& opts,
+                           int* fd, size_t* block_size) {
+    ThreadRestrictions::AssertIOAllowed();
+    int err;
+    RETRY_ON_EINTR(err, close(*fd));
+    if (err < 0) {
+      return IOError(fname, errno);
+    }
+#if defined(__linux__)
+    int flags = O_RDWR;
+    if (opts.direct_io) {
+      flags |= O_DIRECT;
+    }
+    if (opts.dsync) {
+      flags |= O_DSYNC;
+    }
+    RETRY_ON_EINTR(*fd, open(fname.c_str(), flags));
+    if (*fd < 0) {
+      return IOError(fname, errno);
+    }
+    *block_size = 0;
+    if (opts.direct_io) {
+      struct stat st;
+      Status s;
+      if (fstat(*fd, &st) < 0) {
+        s = IOError(fname, errno);
+      } else if (st.st_size % st.st_blksize != 0) {
+        s = Status::NotSupported(Substitute(
+            "cannot append with direct I/O to $0: size $1 is not a multiple of "
+            "the block size $2", fname, st.st_size, st.st_blksize));
+      }
+      if (!s.ok()) {
+        RETRY_ON_EINTR(err, close(*fd));
+        return s;
+      }
+      *block_size = st.st_blksize;
+    }
     return Status::OK();
+#else
+    return Status::NotSupported("direct I/O and O_DSYNC are only supported on Linux");
+#endif
+  }
+
+  // Sets O_DIRECT on the already open descriptor 'fd' for 'fname'.
+  static Status EnableDirectIO(const string& fname, int fd) {
+#if defined(__linux__)
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_DIRECT) < 0) {
+      return IOError(fname, errno);
+    }
+    return Status::OK();
+#else
+    return Status::NotSupported("direct I/O is only supported on Linux");
+#endif
   }
 
   Status DeleteRecursivelyCb(FileType type, const string& dirname, const string& basename) {
@@ -17,6 +17,7 @@
 
 #include "kudu/util/file_cache.h"
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
@@ -56,6 +57,10 @@
 DEFINE_int32(test_num_producer_threads, 1, "Number of producer threads");
 DEFINE_int32(test_num_consumer_threads, 4, "Number of consumer threads");
 DEFINE_int32(test_duration_secs, 2, "Number of seconds to run the test");
+DEFINE_int32(test_num_lookup_threads, 8,
+             "Number of threads looking up descriptors in TestLookupThroughput");
+DEFINE_int32(test_num_hot_files, 32,
+             "Number of files looked up repeatedly in TestLookupThroughput");
 
 DECLARE_bool(cache_force_single_shard);
 
@@ -369,6 +374,7 @@ TYPED_TEST(FileCacheStressTest, TestStress) {
   }
 
   // Let the test run.
+  MonoTime start = MonoTime::Now();
   SleepFor(MonoDelta::FromSeconds(FLAGS_test_duration_secs));
 
   // Stop the threads.
@@ -380,6 +386,7 @@ TYPED_TEST(FileCacheStressTest, TestStress) {
   for (auto& c : consumers) {
     c.join();
   }
+  double elapsed_secs = (MonoTime::Now() - start).ToSeconds();
 
   // Log the metrics.
   unordered_map<string, int> action_counts;
@@ -397,6 +404,64 @@ TYPED_TEST(FileCacheStressTest, TestStress) {
                             action_count_pair.first,
                             action_count_pair.second);
   }
+
+  // Every open, read, and write looks up a descriptor or a cached fd.
+  int num_lookups = action_counts["open"] + action_counts["read"] +
+      action_counts["write"];
+  LOG(INFO) << Substitute("lookups/sec: $0", num_lookups / elapsed_secs);
+}
+
+// Measures the throughput of descriptor lookups when many threads repeatedly
+// open a small set of already-open ("hot") files, as happens when scanning
+// many small blocks.
+TYPED_TEST(FileCacheStressTest, TestLookupThroughput) {
+  OverrideFlagForSlowTests("test_duration_secs", "30");
+
+  // Create the hot files and hold a descriptor to each so that every lookup
+  // takes the hit path.
+  vector<string> file_names;
+  vector<shared_ptr<TypeParam>> held_files;
+  for (int i = 0; i < FLAGS_test_num_hot_files; i++) {
+    string file_name = this->GetTestPath(Substitute("hot-$0", i));
+    unique_ptr<WritableFile> f;
+    ASSERT_OK(this->env_->NewWritableFile(file_name, &f));
+    ASSERT_OK(f->Append("data"));
+    ASSERT_OK(f->Close());
+    shared_ptr<TypeParam> opened;
+    ASSERT_OK(this->cache_->OpenExistingFile(file_name, &opened));
+    file_names.emplace_back(std::move(file_name));
+    held_files.emplace_back(std::move(opened));
+  }
+
+  std::atomic<int64_t> total_lookups(0);
+  CountDownLatch stop(1);
+  vector<thread> threads;
+  for (int i = 0; i < FLAGS_test_num_lookup_threads; i++) {
+    threads.emplace_back([&, i]() {
+      Random rand(i);
+      int64_t lookups = 0;
+      while (stop.count() > 0) {
+        shared_ptr<TypeParam> f;
+        CHECK_OK(this->cache_->OpenExistingFile(
+            file_names[rand.Uniform(file_names.size())], &f));
+        lookups++;
+      }
+      total_lookups += lookups;
+    });
+  }
+
+  MonoTime start = MonoTime::Now();
+  SleepFor(MonoDelta::FromSeconds(FLAGS_test_duration_secs));
+  stop.CountDown();
+  for (auto& t : threads) {
+    t.join();
+  }
+  double elapsed_secs = (MonoTime::Now() - start).ToSeconds();
+  LOG(INFO) << Substitute("$0 threads, $1 hot files: $2 lookups/sec",
+                          FLAGS_test_num_lookup_threads,
+                          FLAGS_test_num_hot_files,
+                          total_lookups.load() / elapsed_secs);
+  ASSERT_GT(total_lookups.load(), 0);
 }
 
 } // namespace kudu
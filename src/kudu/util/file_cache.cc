@@ -20,6 +20,7 @@
 #include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <ostream>
@@ -31,7 +32,6 @@
 #include <glog/logging.h>
 
 #include "kudu/gutil/macros.h"
-#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/array_view.h"
@@ -100,9 +100,9 @@ class BaseDescriptor {
   ~BaseDescriptor() {
     VLOG(2) << "Out of scope descriptor with file name: " << filename();
 
-    // The (now expired) weak_ptr remains in 'descriptors_', to be removed by
-    // the next call to RunDescriptorExpiry(). Removing it here would risk a
-    // deadlock on recursive acquisition of 'lock_'.
+    // The (now expired) weak_ptr remains in 'shards_', to be removed by the
+    // next call to RunDescriptorExpiry(). Removing it here would risk a
+    // deadlock on recursive acquisition of the shard's lock.
 
     if (deleted()) {
       cache()->Erase(filename());
@@ -245,6 +245,12 @@ class Descriptor<RWFile> : public RWFile {
     return opened.file()->ReadV(offset, results);
   }
 
+  Status Prefetch(uint64_t offset, size_t length) const override {
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->Prefetch(offset, length);
+  }
+
   Status Write(uint64_t offset, const Slice& data) override {
     ScopedOpenedDescriptor<RWFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -372,6 +378,12 @@ class Descriptor<RandomAccessFile> : public RandomAccessFile {
     return opened.file()->ReadV(offset, results);
   }
 
+  Status Prefetch(uint64_t offset, size_t length) const override {
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->Prefetch(offset, length);
+  }
+
   Status Size(uint64_t *size) const override {
     ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -485,16 +497,27 @@ Status FileCache<FileType>::Init() {
 template <class FileType>
 Status FileCache<FileType>::OpenExistingFile(const string& file_name,
                                              shared_ptr<FileType>* file) {
+  DescriptorShard* shard = ShardFor(file_name);
   shared_ptr<internal::Descriptor<FileType>> desc;
   {
-    // Find an existing descriptor, or create one if none exists.
-    std::lock_guard<simple_spinlock> l(lock_);
-    RETURN_NOT_OK(FindDescriptorUnlocked(file_name, &desc));
+    // Fast path: find an existing descriptor under the shared lock.
+    shared_lock<rw_spinlock> l(shard->lock);
+    RETURN_NOT_OK(FindDescriptorUnlocked(*shard, file_name, &desc));
+  }
+  if (desc) {
+    VLOG(2) << "Found existing descriptor: " << desc->filename();
+  } else {
+    // Slow path: create a descriptor, unless another thread beat us to it.
+    std::lock_guard<rw_spinlock> l(shard->lock);
+    RETURN_NOT_OK(FindDescriptorUnlocked(*shard, file_name, &desc));
     if (desc) {
       VLOG(2) << "Found existing descriptor: " << desc->filename();
     } else {
       desc = std::make_shared<internal::Descriptor<FileType>>(this, file_name);
-      InsertOrDie(&descriptors_, file_name, desc);
+
+      // This may replace an expired descriptor not yet removed by
+      // RunDescriptorExpiry().
+      shard->descriptors[file_name] = desc;
       VLOG(2) << "Created new descriptor: " << desc->filename();
     }
   }
@@ -509,9 +532,10 @@ Status FileCache<FileType>::OpenExistingFile(const string& file_name,
 template <class FileType>
 Status FileCache<FileType>::DeleteFile(const string& file_name) {
   {
-    std::lock_guard<simple_spinlock> l(lock_);
+    DescriptorShard* shard = ShardFor(file_name);
+    std::lock_guard<rw_spinlock> l(shard->lock);
     shared_ptr<internal::Descriptor<FileType>> desc;
-    RETURN_NOT_OK(FindDescriptorUnlocked(file_name, &desc));
+    RETURN_NOT_OK(FindDescriptorUnlocked(*shard, file_name, &desc));
 
     if (desc) {
       VLOG(2) << "Marking file for deletion: " << file_name;
@@ -534,17 +558,18 @@ void FileCache<FileType>::Invalidate(const string& file_name) {
   //
   // This ensures that any concurrent OpenExistingFile() during this method wil
   // see the invalidation and issue a CHECK failure.
+  DescriptorShard* shard = ShardFor(file_name);
   shared_ptr<internal::Descriptor<FileType>> desc;
   {
     // Find an existing descriptor, or create one if none exists.
-    std::lock_guard<simple_spinlock> l(lock_);
-    auto it = descriptors_.find(file_name);
-    if (it != descriptors_.end()) {
+    std::lock_guard<rw_spinlock> l(shard->lock);
+    auto it = shard->descriptors.find(file_name);
+    if (it != shard->descriptors.end()) {
       desc = it->second.lock();
     }
     if (!desc) {
       desc = std::make_shared<internal::Descriptor<FileType>>(this, file_name);
-      descriptors_.emplace(file_name, desc);
+      shard->descriptors[file_name] = desc;
     }
 
     desc->base_.MarkInvalidated();
@@ -559,55 +584,71 @@ void FileCache<FileType>::Invalidate(const string& file_name) {
   // the duration of this method, and no other methods erase strong
   // references from the map.
   {
-    std::lock_guard<simple_spinlock> l(lock_);
-    CHECK_EQ(1, descriptors_.erase(file_name));
+    std::lock_guard<rw_spinlock> l(shard->lock);
+    CHECK_EQ(1, shard->descriptors.erase(file_name));
   }
 }
 
 template <class FileType>
 int FileCache<FileType>::NumDescriptorsForTests() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return descriptors_.size();
+  int num_descriptors = 0;
+  for (const auto& shard : shards_) {
+    shared_lock<rw_spinlock> l(shard.lock);
+    num_descriptors += shard.descriptors.size();
+  }
+  return num_descriptors;
 }
 
 template <class FileType>
 string FileCache<FileType>::ToDebugString() const {
-  std::lock_guard<simple_spinlock> l(lock_);
   string ret;
-  for (const auto& e : descriptors_) {
-    bool strong = false;
-    bool deleted = false;
-    bool opened = false;
-    shared_ptr<internal::Descriptor<FileType>> desc = e.second.lock();
-    if (desc) {
-      strong = true;
-      if (desc->base_.deleted()) {
-        deleted = true;
+  for (const auto& shard : shards_) {
+    shared_lock<rw_spinlock> l(shard.lock);
+    for (const auto& e : shard.descriptors) {
+      bool strong = false;
+      bool deleted = false;
+      bool opened = false;
+      shared_ptr<internal::Descriptor<FileType>> desc = e.second.lock();
+      if (desc) {
+        strong = true;
+        if (desc->base_.deleted()) {
+          deleted = true;
+        }
+        internal::ScopedOpenedDescriptor<FileType> o(
+            desc->base_.LookupFromCache());
+        if (o.opened()) {
+          opened = true;
+        }
       }
-      internal::ScopedOpenedDescriptor<FileType> o(
-          desc->base_.LookupFromCache());
-      if (o.opened()) {
-        opened = true;
+      if (strong) {
+        ret += Substitute("$0 (S$1$2)\n", e.first,
+                          deleted ? "D" : "", opened ? "O" : "");
+      } else {
+        ret += Substitute("$0\n", e.first);
       }
     }
-    if (strong) {
-      ret += Substitute("$0 (S$1$2)\n", e.first,
-                        deleted ? "D" : "", opened ? "O" : "");
-    } else {
-      ret += Substitute("$0\n", e.first);
-    }
   }
   return ret;
 }
 
+template <class FileType>
+typename FileCache<FileType>::DescriptorShard* FileCache<FileType>::ShardFor(
+    const string& file_name) {
+  static_assert((kNumDescriptorShards & (kNumDescriptorShards - 1)) == 0,
+                "kNumDescriptorShards must be a power of two");
+  size_t h = std::hash<string>()(file_name);
+  return &shards_[h & (kNumDescriptorShards - 1)];
+}
+
 template <class FileType>
 Status FileCache<FileType>::FindDescriptorUnlocked(
+    const DescriptorShard& shard,
     const string& file_name,
     shared_ptr<internal::Descriptor<FileType>>* file) {
-  DCHECK(lock_.is_locked());
+  DCHECK(shard.lock.is_locked());
 
-  auto it = descriptors_.find(file_name);
-  if (it != descriptors_.end()) {
+  auto it = shard.descriptors.find(file_name);
+  if (it != shard.descriptors.end()) {
     // Found the descriptor. Has it expired?
     shared_ptr<internal::Descriptor<FileType>> desc = it->second.lock();
     if (desc) {
@@ -622,8 +663,8 @@ Status FileCache<FileType>::FindDescriptorUnlocked(
       }
       return Status::OK();
     }
-    // Descriptor has expired; erase it and pretend we found nothing.
-    descriptors_.erase(it);
+    // Descriptor has expired; pretend we found nothing. It'll be erased by
+    // RunDescriptorExpiry(), keeping lookups free of exclusive locking.
   }
   return Status::OK();
 }
@@ -632,12 +673,29 @@ template <class FileType>
 void FileCache<FileType>::RunDescriptorExpiry() {
   while (!running_.WaitFor(MonoDelta::FromMilliseconds(
       FLAGS_file_cache_expiry_period_ms))) {
-    std::lock_guard<simple_spinlock> l(lock_);
-    for (auto it = descriptors_.begin(); it != descriptors_.end();) {
-      if (it->second.expired()) {
-        it = descriptors_.erase(it);
-      } else {
-        it++;
+    for (auto& shard : shards_) {
+      // Most shards have nothing to expire; check that under the shared lock
+      // so that concurrent lookups aren't blocked needlessly.
+      {
+        shared_lock<rw_spinlock> l(shard.lock);
+        bool any_expired = false;
+        for (const auto& e : shard.descriptors) {
+          if (e.second.expired()) {
+            any_expired = true;
+            break;
+          }
+        }
+        if (!any_expired) {
+          continue;
+        }
+      }
+      std::lock_guard<rw_spinlock> l(shard.lock);
+      for (auto it = shard.descriptors.begin(); it != shard.descriptors.end();) {
+        if (it->second.expired()) {
+          it = shard.descriptors.erase(it);
+        } else {
+          it++;
+        }
       }
     }
   }
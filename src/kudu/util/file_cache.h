@@ -167,14 +167,35 @@ class FileCache {
   template<class FileType2>
   FRIEND_TEST(FileCacheTest, TestBasicOperations);
 
-  // Looks up a descriptor by file name.
+  typedef std::unordered_map<
+      std::string, std::weak_ptr<internal::Descriptor<FileType>>> DescriptorMap;
+
+  // A slice of the descriptor map, selected by the hash of the file name.
+  //
+  // Lookups of existing descriptors (the common case) take 'lock' in shared
+  // mode and so do not contend with one another. Only creating or removing a
+  // descriptor takes it exclusively.
+  struct DescriptorShard {
+    mutable rw_spinlock lock;
+    DescriptorMap descriptors;
+  };
+
+  // Number of shards in 'shards_'. Must be a power of two.
+  static constexpr int kNumDescriptorShards = 16;
+
+  // Returns the shard responsible for 'file_name'.
+  DescriptorShard* ShardFor(const std::string& file_name);
+
+  // Looks up a descriptor by file name in 'shard'. Expired descriptors are
+  // treated as absent; they are removed by RunDescriptorExpiry().
   //
-  // Must be called with 'lock_' held.
-  Status FindDescriptorUnlocked(
+  // Must be called with 'shard.lock' held in either mode.
+  static Status FindDescriptorUnlocked(
+      const DescriptorShard& shard,
       const std::string& file_name,
       std::shared_ptr<internal::Descriptor<FileType>>* file);
 
-  // Periodically removes expired descriptors from 'descriptors_'.
+  // Periodically removes expired descriptors from 'shards_'.
   void RunDescriptorExpiry();
 
   // Interface to the underlying filesystem.
@@ -190,12 +211,8 @@ class FileCache {
   // Underlying cache instance. Caches opened files.
   std::unique_ptr<Cache> cache_;
 
-  // Protects the descriptor map.
-  mutable simple_spinlock lock_;
-
-  // Maps filenames to descriptors.
-  std::unordered_map<std::string,
-                     std::weak_ptr<internal::Descriptor<FileType>>> descriptors_;
+  // Maps filenames to descriptors, sharded by the hash of the filename.
+  DescriptorShard shards_[kNumDescriptorShards];
 
   // Calls RunDescriptorExpiry() in a loop until 'running_' isn't set.
   scoped_refptr<Thread> descriptor_expiry_thread_;
@@ -95,6 +95,11 @@ class HdrHistogram {
   void IncrementWithExpectedInterval(int64_t value,
                                      int64_t expected_interval_between_samples);
 
+  // Adds the data recorded in 'other', which must have the same highest
+  // trackable value and number of significant digits. Like the copy
+  // constructor, this isn't a consistent snapshot of 'other'.
+  void MergeFrom(const HdrHistogram& other);
+
   // Fetch configuration params.
   uint64_t highest_trackable_value() const { return highest_trackable_value_; }
   int num_significant_digits() const { return num_significant_digits_; }
@@ -177,6 +182,10 @@ class HdrHistogram {
   void Init();
   int CountsArrayIndex(int bucket_index, int sub_bucket_index) const;
 
+  // Lower the min, or raise the max, to 'value' if needed.
+  void UpdateMinValue(base::subtle::Atomic64 value);
+  void UpdateMaxValue(base::subtle::Atomic64 value);
+
   uint64_t highest_trackable_value_;
   int num_significant_digits_;
   int counts_array_length_;
@@ -39,25 +39,30 @@ using google::protobuf::FieldDescriptor;
 using google::protobuf::Message;
 using google::protobuf::Reflection;
 
+using std::ostream;
 using std::ostringstream;
 using std::string;
 using std::vector;
 
 namespace kudu {
 
-// Adapter to allow RapidJSON to write directly to a stringstream.
-// Since Squeasel exposes a stringstream as its interface, this is needed to avoid overcopying.
+// Adapter to allow RapidJSON to write directly to a stream.
+// Since Squeasel exposes a stream as its interface, this is needed to avoid overcopying.
 class UTF8StringStreamBuffer {
  public:
-  explicit UTF8StringStreamBuffer(std::ostringstream* out);
+  explicit UTF8StringStreamBuffer(std::ostream* out);
   ~UTF8StringStreamBuffer();
   void Put(rapidjson::UTF8<>::Ch c);
 
   void Flush();
 
  private:
+  // The buffered output is flushed to 'out_' once it reaches this size, so
+  // that a large document may be streamed rather than buffered in full.
+  static constexpr size_t kFlushThreshold = 64 * 1024;
+
   faststring buf_;
-  std::ostringstream* out_;
+  std::ostream* out_;
 };
 
 // rapidjson doesn't provide any common interface between the PrettyWriter and
@@ -90,7 +95,7 @@ class JsonWriterIf {
 template<class T>
 class JsonWriterImpl : public JsonWriterIf {
  public:
-  explicit JsonWriterImpl(ostringstream* out);
+  explicit JsonWriterImpl(ostream* out);
 
   virtual void Null() OVERRIDE;
   virtual void Bool(bool b) OVERRIDE;
@@ -121,7 +126,7 @@ class JsonWriterImpl : public JsonWriterIf {
 typedef rapidjson::PrettyWriter<UTF8StringStreamBuffer> PrettyWriterClass;
 typedef rapidjson::Writer<UTF8StringStreamBuffer> CompactWriterClass;
 
-JsonWriter::JsonWriter(ostringstream* out, Mode m) {
+JsonWriter::JsonWriter(ostream* out, Mode m) {
   switch (m) {
     case PRETTY:
       impl_.reset(new JsonWriterImpl<PrettyWriterClass>(DCHECK_NOTNULL(out)));
@@ -289,7 +294,7 @@ string JsonWriter::ToJson(const Message& pb, Mode mode) {
 // UTF8StringStreamBuffer
 //
 
-UTF8StringStreamBuffer::UTF8StringStreamBuffer(std::ostringstream* out)
+UTF8StringStreamBuffer::UTF8StringStreamBuffer(std::ostream* out)
   : out_(DCHECK_NOTNULL(out)) {
 }
 UTF8StringStreamBuffer::~UTF8StringStreamBuffer() {
@@ -298,6 +303,9 @@ UTF8StringStreamBuffer::~UTF8StringStreamBuffer() {
 
 void UTF8StringStreamBuffer::Put(rapidjson::UTF8<>::Ch c) {
   buf_.push_back(c);
+  if (PREDICT_FALSE(buf_.size() >= kFlushThreshold)) {
+    Flush();
+  }
 }
 
 void UTF8StringStreamBuffer::Flush() {
@@ -310,7 +318,7 @@ void UTF8StringStreamBuffer::Flush() {
 //
 
 template<class T>
-JsonWriterImpl<T>::JsonWriterImpl(ostringstream* out)
+JsonWriterImpl<T>::JsonWriterImpl(ostream* out)
   : stream_(DCHECK_NOTNULL(out)),
     writer_(stream_) {
 }
@@ -43,8 +43,9 @@ class JsonWriterIf;
 // This class implements all the methods of rapidjson::JsonWriter, plus an
 // additional convenience method for String(std::string).
 //
-// We take an instance of std::stringstream in the constructor because Mongoose / Squeasel
-// uses std::stringstream for output buffering.
+// We take an instance of std::ostream in the constructor because Mongoose / Squeasel
+// uses std::stringstream for output buffering, and streaming web pages write to a
+// stream which sends its data to the client as it's written.
 class JsonWriter {
  public:
   enum Mode {
@@ -54,7 +55,7 @@ class JsonWriter {
     COMPACT
   };
 
-  JsonWriter(std::ostringstream* out, Mode mode);
+  JsonWriter(std::ostream* out, Mode mode);
   ~JsonWriter();
 
   void Null();
@@ -28,6 +28,8 @@
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/bind_helpers.h"
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -37,6 +39,7 @@
 #include "kudu/util/faststring.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
@@ -51,6 +54,20 @@ DEFINE_int32(inject_latency_on_kernel_stack_lookup_ms, 0,
              "kernel stack");
 TAG_FLAG(inject_latency_on_kernel_stack_lookup_ms, hidden);
 
+DEFINE_int32(hung_task_stall_history_size, 100,
+             "Number of the most recent stalls of watched threads to keep for "
+             "the /stalls page of the web UI");
+TAG_FLAG(hung_task_stall_history_size, advanced);
+TAG_FLAG(hung_task_stall_history_size, runtime);
+
+METRIC_DEFINE_gauge_uint64(server, stack_watchdog_stalls,
+    "Stack Watchdog Stalls", kudu::MetricUnit::kUnits,
+    "Number of times since the server started that a thread stayed in a section "
+    "watched by the kernel stack watchdog for longer than its threshold, for "
+    "example on a slow WAL sync. The stalls are broken down by section on the "
+    "/stalls page of the web UI.",
+    kudu::EXPOSE_AS_COUNTER);
+
 using std::lock_guard;
 using std::string;
 using std::unique_ptr;
@@ -61,8 +78,18 @@ namespace kudu {
 
 __thread KernelStackWatchdog::TLS* KernelStackWatchdog::tls_;
 
+static uint64_t GetNumStalls() {
+  return KernelStackWatchdog::GetInstance()->num_stalls();
+}
+
+void RegisterKernelStackWatchdogMetrics(const scoped_refptr<MetricEntity>& entity) {
+  entity->NeverRetire(
+      METRIC_stack_watchdog_stalls.InstantiateFunctionGauge(entity, Bind(&GetNumStalls)));
+}
+
 KernelStackWatchdog::KernelStackWatchdog()
   : log_collector_(nullptr),
+    num_stalls_(0),
     finish_(1) {
 
   // During creation of the stack watchdog thread, we need to disable using
@@ -95,6 +122,61 @@ std::vector<string> KernelStackWatchdog::LoggedMessagesForTests() const {
   return *log_collector_;
 }
 
+vector<KernelStackWatchdog::Stall> KernelStackWatchdog::RecentStalls() const {
+  vector<Stall> stalls;
+  lock_guard<simple_spinlock> l(stalls_lock_);
+  stalls.reserve(stalls_.size());
+  for (const RecordedStall& recorded : stalls_) {
+    stalls.push_back(recorded.stall);
+  }
+  return stalls;
+}
+
+int64_t KernelStackWatchdog::num_stalls() const {
+  lock_guard<simple_spinlock> l(stalls_lock_);
+  return num_stalls_;
+}
+
+std::unordered_map<string, int64_t> KernelStackWatchdog::StallCountsByLabel() const {
+  lock_guard<simple_spinlock> l(stalls_lock_);
+  return stall_counts_;
+}
+
+void KernelStackWatchdog::RecordStall(int64_t tid, const TLS::Frame& frame, int64_t duration_ms,
+                                      string kernel_stack, string user_stack) {
+  lock_guard<simple_spinlock> l(stalls_lock_);
+  // A stall lasting several checks is likely to be among the last few recorded.
+  for (auto it = stalls_.rbegin(); it != stalls_.rend(); ++it) {
+    if (it->start_time == frame.start_time_ && it->stall.tid == tid &&
+        it->stall.label == frame.status_) {
+      it->stall.duration_ms = duration_ms;
+      it->stall.kernel_stack = std::move(kernel_stack);
+      it->stall.user_stack = std::move(user_stack);
+      return;
+    }
+  }
+
+  num_stalls_++;
+  stall_counts_[frame.status_]++;
+  int history_size = FLAGS_hung_task_stall_history_size;
+  if (history_size <= 0) {
+    stalls_.clear();
+    return;
+  }
+  RecordedStall recorded;
+  recorded.start_time = frame.start_time_;
+  recorded.stall.label = frame.status_;
+  recorded.stall.tid = tid;
+  recorded.stall.start_unix_micros = GetCurrentTimeMicros() - duration_ms * 1000;
+  recorded.stall.duration_ms = duration_ms;
+  recorded.stall.kernel_stack = std::move(kernel_stack);
+  recorded.stall.user_stack = std::move(user_stack);
+  stalls_.emplace_back(std::move(recorded));
+  while (stalls_.size() > static_cast<size_t>(history_size)) {
+    stalls_.pop_front();
+  }
+}
+
 void KernelStackWatchdog::Register(TLS* tls) {
   int64_t tid = Thread::CurrentThreadId();
   lock_guard<simple_spinlock> l(tls_lock_);
@@ -194,12 +276,15 @@ void KernelStackWatchdog::RunThread() {
             break;
           }
 
-          lock_guard<simple_spinlock> l(log_lock_);
-          LOG_STRING(WARNING, log_collector_.get())
-              << "Thread " << p << " stuck at " << frame->status_
-              << " for " << paused_ms << "ms" << ":\n"
-              << "Kernel stack:\n" << kernel_stack << "\n"
-              << "User stack:\n" << user_stack;
+          {
+            lock_guard<simple_spinlock> l(log_lock_);
+            LOG_STRING(WARNING, log_collector_.get())
+                << "Thread " << p << " stuck at " << frame->status_
+                << " for " << paused_ms << "ms" << ":\n"
+                << "Kernel stack:\n" << kernel_stack << "\n"
+                << "User stack:\n" << user_stack;
+          }
+          RecordStall(p, *frame, paused_ms, std::move(kernel_stack), std::move(user_stack));
         }
       }
     }
@@ -50,10 +50,17 @@
 //
 // Scopes with SCOPED_WATCH_STACK may be nested, but only up to a hard-coded limited depth
 // (currently 8).
+//
+// Besides logging them, the watchdog keeps the most recent stalls it observed,
+// and counts them by the label of the stalled scope, so that they can be
+// inspected on the /stalls page of the web UI and tracked through the
+// 'stack_watchdog_stalls' metric.
 #ifndef KUDU_UTIL_KERNEL_STACK_WATCHDOG_H
 #define KUDU_UTIL_KERNEL_STACK_WATCHDOG_H
 
+#include <cstdint>
 #include <ctime>
+#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -78,15 +85,47 @@
 
 namespace kudu {
 
+class MetricEntity;
 class Thread;
 
+// Register the metrics of the watchdog in the given server entity.
+void RegisterKernelStackWatchdogMetrics(const scoped_refptr<MetricEntity>& entity);
+
 // Singleton thread which implements the watchdog.
 class KernelStackWatchdog {
  public:
+  // A stall of a watched scope, as observed by the watchdog.
+  struct Stall {
+    // The label of the scope (typically a file:line string).
+    std::string label;
+    // The ID of the stalled thread.
+    int64_t tid;
+    // The wall time at which the thread entered the scope, in microseconds
+    // since the Unix epoch.
+    int64_t start_unix_micros;
+    // How long the thread had been in the scope when the watchdog last saw it
+    // there.
+    int64_t duration_ms;
+    // The kernel and user stacks of the thread at that time.
+    std::string kernel_stack;
+    std::string user_stack;
+  };
+
   static KernelStackWatchdog* GetInstance() {
     return Singleton<KernelStackWatchdog>::get();
   }
 
+  // Returns the most recent stalls, oldest first. A scope which is still
+  // stalled the next time the watchdog checks on it is reported once, with
+  // its latest duration and stacks.
+  std::vector<Stall> RecentStalls() const;
+
+  // Returns the number of stalls since the process started.
+  int64_t num_stalls() const;
+
+  // Returns the number of stalls since the process started of each label.
+  std::unordered_map<std::string, int64_t> StallCountsByLabel() const;
+
   // Instead of logging through glog, log warning messages into a vector.
   //
   // If 'save_logs' is true, will start saving to the vector, and forget any
@@ -191,6 +230,11 @@ class KernelStackWatchdog {
   // The actual watchdog loop that the watchdog thread runs.
   void RunThread();
 
+  // Records that thread 'tid' has been stalled in the scope of 'frame' for
+  // 'duration_ms', with the given stacks.
+  void RecordStall(int64_t tid, const TLS::Frame& frame, int64_t duration_ms,
+                   std::string kernel_stack, std::string user_stack);
+
   DECLARE_STATIC_THREAD_LOCAL(TLS, tls_);
 
   typedef std::unordered_map<pid_t, TLS*> TLSMap;
@@ -208,6 +252,24 @@ class KernelStackWatchdog {
   // Lock protecting log_collector_.
   mutable simple_spinlock log_lock_;
 
+  // A stall along with the monotonic time at which the thread entered the
+  // scope, which tells successive observations of the same stall apart from
+  // new ones.
+  struct RecordedStall {
+    MicrosecondsInt64 start_time;
+    Stall stall;
+  };
+
+  // The most recent stalls, up to --hung_task_stall_history_size of them.
+  std::deque<RecordedStall> stalls_;
+
+  // The number of stalls of each label, and in total.
+  std::unordered_map<std::string, int64_t> stall_counts_;
+  int64_t num_stalls_;
+
+  // Lock protecting stalls_, stall_counts_ and num_stalls_.
+  mutable simple_spinlock stalls_lock_;
+
   // Lock protecting tls_by_tid_ and pending_delete_.
   mutable simple_spinlock tls_lock_;
 
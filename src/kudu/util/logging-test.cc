@@ -24,6 +24,7 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
@@ -38,6 +39,8 @@
 #include "kudu/util/test_macros.h"  // IWYU pragma: keep
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(log_async_drop_when_full);
+
 using std::string;
 using std::vector;
 
@@ -168,6 +171,29 @@ TEST(LoggingTest, TestAsyncLogger) {
   ASSERT_GT(async.app_threads_blocked_count_for_tests(), 0);
 }
 
+// Test that, with --log_async_drop_when_full, application threads drop the
+// messages that don't fit in the buffers rather than block on a slow log.
+TEST(LoggingTest, TestAsyncLoggerDropWhenFull) {
+  google::FlagSaver saver;
+  FLAGS_log_async_drop_when_full = true;
+  const int kNumMessages = 10000;
+  const int kBuffer = 1000;
+  CountingLogger base;
+  AsyncLogger async(&base, kBuffer);
+  async.Start();
+  for (int m = 0; m < kNumMessages; m++) {
+    async.Write(true, m, "x", 1);
+  }
+  async.Flush();
+  async.Stop();
+  ASSERT_EQ(0, async.app_threads_blocked_count_for_tests());
+  ASSERT_GT(async.dropped_messages_count(), 0);
+  // Each batch of dropped messages is noted in the log with one more message.
+  const int num_written = kNumMessages - static_cast<int>(async.dropped_messages_count());
+  ASSERT_GT(base.message_count_.load(), num_written);
+  ASSERT_LE(base.message_count_.load(), kNumMessages);
+}
+
 TEST(LoggingTest, TestAsyncLoggerAutoFlush) {
   const int kBuffer = 10000;
   CountingLogger base;
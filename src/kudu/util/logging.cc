@@ -25,6 +25,7 @@
 #include <fstream>
 #include <mutex>
 #include <utility>
+#include <vector>
 
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -135,6 +136,11 @@ SimpleSink* registered_sink = nullptr;
 // Protected by 'logging_mutex'.
 int initial_stderr_severity;
 
+// The asynchronous loggers, if enabled. They're never destroyed.
+//
+// Protected by 'logging_mutex'.
+vector<AsyncLogger*> async_loggers;
+
 void EnableAsyncLogging() {
   debug::ScopedLeakCheckDisabler leaky;
 
@@ -145,7 +151,17 @@ void EnableAsyncLogging() {
     auto* async = new AsyncLogger(orig, FLAGS_log_async_buffer_bytes_per_level);
     async->Start();
     google::base::SetLogger(level, async);
+    async_loggers.push_back(async);
+  }
+}
+
+uint64_t GetAsyncLoggingDroppedMessages() {
+  SpinLockHolder l(&logging_mutex);
+  uint64_t dropped = 0;
+  for (const auto* async : async_loggers) {
+    dropped += async->dropped_messages_count();
   }
+  return dropped;
 }
 
 void UnregisterLoggingCallbackUnlocked() {
@@ -17,6 +17,7 @@
 #ifndef KUDU_UTIL_LOGGING_H
 #define KUDU_UTIL_LOGGING_H
 
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 
@@ -292,6 +293,10 @@ void UnregisterLoggingCallback();
 // file corresponding to this severity
 void GetFullLogFilename(google::LogSeverity severity, std::string* filename);
 
+// Returns the number of log messages dropped by the asynchronous loggers
+// because their buffers were full. See --log_async_drop_when_full.
+uint64_t GetAsyncLoggingDroppedMessages();
+
 // Format a timestamp in the same format as used by GLog.
 std::string FormatTimestampForLog(MicrosecondsInt64 micros_since_epoch);
 
@@ -56,6 +56,8 @@ METRIC_DEFINE_histogram(test, maintenance_op_duration,
                         "Maintenance Operation Duration",
                         kudu::MetricUnit::kSeconds, "", 60000000LU, 2);
 
+DECLARE_bool(maintenance_manager_incremental_stats);
+DECLARE_int32(maintenance_manager_max_ops_per_data_dir);
 DECLARE_int64(log_target_replay_size_mb);
 
 namespace kudu {
@@ -100,12 +102,15 @@ class TestMaintenanceOp : public MaintenanceOp {
       ram_anchored_(500),
       logs_retained_bytes_(0),
       perf_improvement_(0),
+      io_bytes_(0),
       metric_entity_(METRIC_ENTITY_test.Instantiate(&metric_registry_, "test")),
       maintenance_op_duration_(METRIC_maintenance_op_duration.Instantiate(metric_entity_)),
       maintenance_ops_running_(METRIC_maintenance_ops_running.Instantiate(metric_entity_, 0)),
       remaining_runs_(1),
       prepared_runs_(0),
-      sleep_time_(MonoDelta::FromSeconds(0)) {
+      sleep_time_(MonoDelta::FromSeconds(0)),
+      event_driven_stats_(false),
+      update_stats_count_(0) {
   }
 
   virtual ~TestMaintenanceOp() {}
@@ -137,10 +142,12 @@ class TestMaintenanceOp : public MaintenanceOp {
 
   virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE {
     std::lock_guard<Mutex> guard(lock_);
+    update_stats_count_++;
     stats->set_runnable(remaining_runs_ > 0);
     stats->set_ram_anchored(ram_anchored_);
     stats->set_logs_retained_bytes(logs_retained_bytes_);
     stats->set_perf_improvement(perf_improvement_);
+    stats->set_io_bytes(io_bytes_);
   }
 
   void set_remaining_runs(int runs) {
@@ -168,6 +175,24 @@ class TestMaintenanceOp : public MaintenanceOp {
     perf_improvement_ = perf_improvement;
   }
 
+  void set_io_bytes(int64_t io_bytes) {
+    std::lock_guard<Mutex> guard(lock_);
+    io_bytes_ = io_bytes;
+  }
+
+  void set_event_driven_stats(bool event_driven_stats) {
+    event_driven_stats_ = event_driven_stats;
+  }
+
+  virtual bool has_event_driven_stats() const OVERRIDE {
+    return event_driven_stats_;
+  }
+
+  int update_stats_count() {
+    std::lock_guard<Mutex> guard(lock_);
+    return update_stats_count_;
+  }
+
   virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE {
     return maintenance_op_duration_;
   }
@@ -182,6 +207,7 @@ class TestMaintenanceOp : public MaintenanceOp {
   uint64_t ram_anchored_;
   uint64_t logs_retained_bytes_;
   uint64_t perf_improvement_;
+  int64_t io_bytes_;
   MetricRegistry metric_registry_;
   scoped_refptr<MetricEntity> metric_entity_;
   scoped_refptr<Histogram> maintenance_op_duration_;
@@ -195,6 +221,10 @@ class TestMaintenanceOp : public MaintenanceOp {
 
   // The amount of time each op invocation will sleep.
   MonoDelta sleep_time_;
+
+  bool event_driven_stats_;
+  // The number of calls to UpdateStats().
+  int update_stats_count_;
 };
 
 // Create an op and wait for it to start running.  Unregister it while it is
@@ -313,6 +343,123 @@ TEST_F(MaintenanceManagerTest, TestLogRetentionPrioritization) {
   manager_->UnregisterOp(&op2);
 }
 
+// Test that no more than the configured number of ops run on a data dir at
+// once, while the ops of other data dirs run in parallel.
+TEST_F(MaintenanceManagerTest, TestDataDirConcurrency) {
+  FLAGS_maintenance_manager_max_ops_per_data_dir = 1;
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE);
+  op1.set_data_dirs({ "dir1" });
+  op1.set_perf_improvement(10);
+  op1.set_remaining_runs(2);
+  op1.set_sleep_time(MonoDelta::FromSeconds(1));
+
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE);
+  op2.set_data_dirs({ "dir2" });
+  op2.set_perf_improvement(5);
+  op2.set_remaining_runs(1);
+  op2.set_sleep_time(MonoDelta::FromSeconds(1));
+
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+
+  // Despite its lower improvement, op2 runs on the second thread, since op1
+  // is already running on its data dir.
+  ASSERT_EVENTUALLY([&]() {
+      ASSERT_EQ(1, op1.RunningGauge()->value());
+      ASSERT_EQ(1, op2.RunningGauge()->value());
+    });
+  MaintenanceManagerStatusPB status_pb;
+  manager_->GetMaintenanceManagerStatusDump(&status_pb);
+  ASSERT_EQ(2, status_pb.data_dirs_size());
+  for (const auto& dir_pb : status_pb.data_dirs()) {
+    ASSERT_EQ(1, dir_pb.running_ops());
+    ASSERT_GT(dir_pb.utilization(), 0);
+  }
+
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+}
+
+// Test that, when scheduling per data dir, ops improving performance are
+// ranked by their improvement per amount of I/O.
+TEST_F(MaintenanceManagerTest, TestIOCostPrioritization) {
+  const int64_t kMB = 1024 * 1024;
+
+  manager_->Shutdown();
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE);
+  op1.set_perf_improvement(10);
+  op1.set_io_bytes(100 * kMB);
+
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE);
+  op2.set_perf_improvement(2);
+  op2.set_io_bytes(kMB);
+
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+
+  ASSERT_EQ(&op1, manager_->FindBestOp().first);
+
+  FLAGS_maintenance_manager_max_ops_per_data_dir = 1;
+  ASSERT_EQ(&op2, manager_->FindBestOp().first);
+
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+}
+
+// Test that, in the incremental mode, the stats of event-driven ops are only
+// updated once the op or an op of its group notified a change.
+TEST_F(MaintenanceManagerTest, TestIncrementalStats) {
+  manager_->Shutdown();
+  FLAGS_maintenance_manager_incremental_stats = true;
+
+  const int kGroup = 0;
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE);
+  op1.set_perf_improvement(10);
+  op1.set_event_driven_stats(true);
+  op1.set_stats_group(&kGroup);
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE);
+  op2.set_perf_improvement(5);
+  op2.set_event_driven_stats(true);
+  op2.set_stats_group(&kGroup);
+  TestMaintenanceOp op3("op3", MaintenanceOp::HIGH_IO_USAGE);
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+  manager_->RegisterOp(&op3);
+
+  ASSERT_EQ(&op1, manager_->FindBestOp().first);
+  ASSERT_EQ(1, op1.update_stats_count());
+  ASSERT_EQ(1, op2.update_stats_count());
+  ASSERT_EQ(1, op3.update_stats_count());
+
+  // Without a notification, the cached stats are used.
+  op2.set_perf_improvement(20);
+  ASSERT_EQ(&op1, manager_->FindBestOp().first);
+  ASSERT_EQ(1, op1.update_stats_count());
+  ASSERT_EQ(1, op2.update_stats_count());
+  // Ops which aren't event-driven are always updated.
+  ASSERT_EQ(2, op3.update_stats_count());
+
+  op2.NotifyStatsChanged();
+  ASSERT_EQ(&op2, manager_->FindBestOp().first);
+  ASSERT_EQ(1, op1.update_stats_count());
+  ASSERT_EQ(2, op2.update_stats_count());
+
+  // Once an op of the group completes, the whole group is updated.
+  {
+    std::lock_guard<Mutex> guard(manager_->lock_);
+    manager_->NotifyStatsGroupUnlocked(&op1);
+  }
+  manager_->FindBestOp();
+  ASSERT_EQ(2, op1.update_stats_count());
+  ASSERT_EQ(3, op2.update_stats_count());
+
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+  manager_->UnregisterOp(&op3);
+}
+
 // Test retrieving a list of an op's running instances
 TEST_F(MaintenanceManagerTest, TestRunningInstances) {
   TestMaintenanceOp op("op", MaintenanceOp::HIGH_IO_USAGE);
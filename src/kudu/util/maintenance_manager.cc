@@ -17,6 +17,7 @@
 
 #include "kudu/util/maintenance_manager.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstddef>
 #include <cstdint>
@@ -90,6 +91,35 @@ DEFINE_double(data_gc_prioritization_prob, 0.5,
              "such as delta compaction.");
 TAG_FLAG(data_gc_prioritization_prob, experimental);
 
+DEFINE_int32(maintenance_manager_max_ops_per_data_dir, 0,
+             "If positive, the maximum number of high-IO maintenance operations "
+             "running at once on any data directory, so that the operations are "
+             "spread over the disks rather than piled up on some of them. In this "
+             "mode, the performance improvement of the operations is also weighed "
+             "against the estimated amount of I/O they do. If 0, the data "
+             "directories of the operations aren't taken into account.");
+TAG_FLAG(maintenance_manager_max_ops_per_data_dir, experimental);
+
+DEFINE_int64(maintenance_manager_data_dir_io_budget_mb, 0,
+             "If positive, the number of megabytes of estimated I/O per second "
+             "that the maintenance operations may schedule on any data "
+             "directory, in bursts of up to a second worth of budget. Ignored "
+             "unless --maintenance_manager_max_ops_per_data_dir is positive.");
+TAG_FLAG(maintenance_manager_data_dir_io_budget_mb, experimental);
+
+DEFINE_bool(maintenance_manager_incremental_stats, false,
+            "If true, the maintenance manager only updates the stats of the "
+            "operations whose stats are event-driven, e.g. compactions, once "
+            "they changed, rather than on every scheduling pass. This cuts the "
+            "scheduling cost on servers with many tablets.");
+TAG_FLAG(maintenance_manager_incremental_stats, experimental);
+
+DEFINE_int32(maintenance_manager_max_stats_age_ms, 10000,
+             "With --maintenance_manager_incremental_stats, the maximum age of "
+             "the stats of an operation, after which they are updated even "
+             "though the operation didn't signal a change.");
+TAG_FLAG(maintenance_manager_max_stats_age_ms, experimental);
+
 namespace kudu {
 
 MaintenanceOpStats::MaintenanceOpStats() {
@@ -103,6 +133,7 @@ void MaintenanceOpStats::Clear() {
   logs_retained_bytes_ = 0;
   data_retained_bytes_ = 0;
   perf_improvement_ = 0;
+  io_bytes_ = 0;
   last_modified_ = MonoTime();
 }
 
@@ -110,7 +141,9 @@ MaintenanceOp::MaintenanceOp(std::string name, IOUsage io_usage)
     : name_(std::move(name)),
       running_(0),
       cancel_(false),
-      io_usage_(io_usage) {
+      io_usage_(io_usage),
+      stats_dirty_(true),
+      stats_group_(nullptr) {
 }
 
 MaintenanceOp::~MaintenanceOp() {
@@ -135,6 +168,13 @@ MaintenanceManagerStatusPB_OpInstancePB OpInstance::DumpToPB() const {
   return pb;
 }
 
+MaintenanceManager::DataDirState::DataDirState()
+    : running_ops(0),
+      io_debt_bytes(0),
+      scheduled_io_bytes(0),
+      busy_seconds(0) {
+}
+
 const MaintenanceManager::Options MaintenanceManager::kDefaultOptions = {
   .num_threads = 0,
   .polling_interval_ms = 0,
@@ -154,6 +194,7 @@ MaintenanceManager::MaintenanceManager(const Options& options,
     running_ops_(0),
     completed_ops_count_(0),
     rand_(GetRandomSeed32()),
+    start_time_(MonoTime::Now()),
     memory_pressure_func_(&process_memory::UnderMemoryPressure) {
   CHECK_OK(ThreadPoolBuilder("MaintenanceMgr").set_min_threads(num_threads_)
                .set_max_threads(num_threads_).Build(&thread_pool_));
@@ -208,6 +249,9 @@ void MaintenanceManager::RegisterOp(MaintenanceOp* op) {
       << ", but it already exists in ops_.";
   op->manager_ = shared_from_this();
   op->cond_.reset(new ConditionVariable(&lock_));
+  if (op->stats_group_) {
+    stats_groups_[op->stats_group_].push_back(op);
+  }
   VLOG_AND_TRACE("maintenance", 1) << LogPrefix() << "Registered " << op->name();
 }
 
@@ -233,6 +277,15 @@ void MaintenanceManager::UnregisterOp(MaintenanceOp* op) {
           << "waiting for it to complete";
     }
     ops_.erase(iter);
+    if (op->stats_group_) {
+      auto group_iter = stats_groups_.find(op->stats_group_);
+      DCHECK(group_iter != stats_groups_.end());
+      auto& group = group_iter->second;
+      group.erase(std::find(group.begin(), group.end(), op));
+      if (group.empty()) {
+        stats_groups_.erase(group_iter);
+      }
+    }
   }
   LOG_WITH_PREFIX(INFO) << "Unregistered op " << op->name();
   op->cond_.reset();
@@ -297,12 +350,16 @@ void MaintenanceManager::RunSchedulerThread() {
                             << ".  Re-running scheduler.";
       op->running_--;
       running_ops_--;
+      op->NotifyStatsChanged();
       op->cond_->Signal();
       continue;
     }
 
     LOG_AND_TRACE("maintenance", INFO) << LogPrefix() << "Scheduling "
                                        << op->name() << ": " << note;
+    AddDataDirOpUnlocked(op, FindOrDie(ops_, op).io_bytes());
+    // Running the op may make it unrunnable until it completes.
+    op->NotifyStatsChanged();
     // Run the maintenance operation.
     Status s = thread_pool_->SubmitFunc(boost::bind(
         &MaintenanceManager::LaunchOp, this, op));
@@ -330,6 +387,10 @@ void MaintenanceManager::RunSchedulerThread() {
 // sliding priority between log retention and RAM usage. For example, is an Op that frees
 // 128MB of log retention and 12MB of RAM always better than an op that frees 12MB of log retention
 // and 128MB of RAM? Maybe a more holistic approach would be better.
+//
+// If --maintenance_manager_max_ops_per_data_dir is set, the high-IO Ops whose data dirs are
+// already busy are only considered to free memory, and the performance improvement Ops are ranked
+// by their improvement per MB of estimated I/O, so that the cheaper ones go first.
 pair<MaintenanceOp*, string> MaintenanceManager::FindBestOp() {
   TRACE_EVENT0("maintenance", "MaintenanceManager::FindBestOp");
 
@@ -337,6 +398,8 @@ pair<MaintenanceOp*, string> MaintenanceManager::FindBestOp() {
   if (free_threads == 0) {
     return {nullptr, "no free threads"};
   }
+  const bool per_data_dir = FLAGS_maintenance_manager_max_ops_per_data_dir > 0;
+  const MonoTime now = MonoTime::Now();
 
   int64_t low_io_most_logs_retained_bytes = 0;
   MaintenanceOp* low_io_most_logs_retained_bytes_op = nullptr;
@@ -358,11 +421,24 @@ pair<MaintenanceOp*, string> MaintenanceManager::FindBestOp() {
     MaintenanceOpStats& stats(val.second);
     VLOG_WITH_PREFIX(3) << "Considering MM op " << op->name();
     // Update op stats.
-    stats.Clear();
-    op->UpdateStats(&stats);
+    if (StatsNeedUpdate(op, stats, now)) {
+      stats.Clear();
+      op->UpdateStats(&stats);
+    }
     if (op->cancelled() || !stats.valid() || !stats.runnable()) {
       continue;
     }
+
+    // Freeing memory is urgent enough to pile up on busy disks.
+    if (stats.ram_anchored() > most_mem_anchored) {
+      most_mem_anchored_op = op;
+      most_mem_anchored = stats.ram_anchored();
+    }
+    if (!DataDirsAvailableUnlocked(op, now)) {
+      VLOG_WITH_PREFIX(3) << "Data dirs of MM op " << op->name() << " are busy";
+      continue;
+    }
+
     if (stats.logs_retained_bytes() > low_io_most_logs_retained_bytes &&
         op->io_usage() == MaintenanceOp::LOW_IO_USAGE) {
       low_io_most_logs_retained_bytes_op = op;
@@ -371,10 +447,6 @@ pair<MaintenanceOp*, string> MaintenanceManager::FindBestOp() {
                                        << stats.logs_retained_bytes() << " bytes of logs";
     }
 
-    if (stats.ram_anchored() > most_mem_anchored) {
-      most_mem_anchored_op = op;
-      most_mem_anchored = stats.ram_anchored();
-    }
     // We prioritize ops that can free more logs, but when it's the same we pick the one that
     // also frees up the most memory.
     if (stats.logs_retained_bytes() > 0 &&
@@ -393,10 +465,14 @@ pair<MaintenanceOp*, string> MaintenanceManager::FindBestOp() {
                                        << stats.data_retained_bytes() << " bytes of data";
     }
 
+    double perf_improvement = stats.perf_improvement();
+    if (per_data_dir && stats.io_bytes() > 0) {
+      perf_improvement /= std::max(1.0, stats.io_bytes() / (1024.0 * 1024.0));
+    }
     if ((!best_perf_improvement_op) ||
-        (stats.perf_improvement() > best_perf_improvement)) {
+        (perf_improvement > best_perf_improvement)) {
       best_perf_improvement_op = op;
-      best_perf_improvement = stats.perf_improvement();
+      best_perf_improvement = perf_improvement;
     }
   }
 
@@ -449,6 +525,98 @@ pair<MaintenanceOp*, string> MaintenanceManager::FindBestOp() {
   return {nullptr, "no ops with positive improvement"};
 }
 
+bool MaintenanceManager::StatsNeedUpdate(MaintenanceOp* op, const MaintenanceOpStats& stats,
+                                         const MonoTime& now) {
+  if (!FLAGS_maintenance_manager_incremental_stats || !op->has_event_driven_stats()) {
+    return true;
+  }
+  // Clear the flag before the update, so that a change racing with it is
+  // caught by the next pass.
+  if (op->stats_dirty_.Exchange(false) || !stats.valid()) {
+    return true;
+  }
+  return now - stats.last_modified() >
+      MonoDelta::FromMilliseconds(FLAGS_maintenance_manager_max_stats_age_ms);
+}
+
+void MaintenanceManager::NotifyStatsGroupUnlocked(MaintenanceOp* op) {
+  op->NotifyStatsChanged();
+  if (!op->stats_group_) {
+    return;
+  }
+  for (MaintenanceOp* group_op : FindOrDie(stats_groups_, op->stats_group_)) {
+    group_op->NotifyStatsChanged();
+  }
+}
+
+void MaintenanceManager::DataDirState::ReplenishBudget(const MonoTime& now,
+                                                       double budget_bytes_per_sec) {
+  if (budget_bytes_per_sec <= 0) {
+    io_debt_bytes = 0;
+  } else if (last_budget_update.Initialized()) {
+    io_debt_bytes = std::max(
+        0.0, io_debt_bytes - (now - last_budget_update).ToSeconds() * budget_bytes_per_sec);
+  }
+  last_budget_update = now;
+}
+
+bool MaintenanceManager::DataDirsAvailableUnlocked(const MaintenanceOp* op,
+                                                   const MonoTime& now) {
+  const int max_ops = FLAGS_maintenance_manager_max_ops_per_data_dir;
+  if (max_ops <= 0 || op->io_usage() != MaintenanceOp::HIGH_IO_USAGE) {
+    return true;
+  }
+  const double budget_bytes_per_sec =
+      FLAGS_maintenance_manager_data_dir_io_budget_mb * 1024.0 * 1024.0;
+  for (const auto& uuid : op->data_dirs()) {
+    DataDirState* dir = FindOrNull(data_dirs_, uuid);
+    if (!dir) {
+      // Nothing was ever scheduled on the directory.
+      continue;
+    }
+    if (dir->running_ops >= max_ops) {
+      return false;
+    }
+    dir->ReplenishBudget(now, budget_bytes_per_sec);
+    if (budget_bytes_per_sec > 0 && dir->io_debt_bytes >= budget_bytes_per_sec) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MaintenanceManager::AddDataDirOpUnlocked(const MaintenanceOp* op, int64_t io_bytes) {
+  if (op->io_usage() != MaintenanceOp::HIGH_IO_USAGE) {
+    return;
+  }
+  const MonoTime now = MonoTime::Now();
+  const double budget_bytes_per_sec =
+      FLAGS_maintenance_manager_data_dir_io_budget_mb * 1024.0 * 1024.0;
+  for (const auto& uuid : op->data_dirs()) {
+    DataDirState* dir = &data_dirs_[uuid];
+    if (dir->running_ops++ == 0) {
+      dir->busy_since = now;
+    }
+    dir->ReplenishBudget(now, budget_bytes_per_sec);
+    dir->io_debt_bytes += io_bytes;
+    dir->scheduled_io_bytes += io_bytes;
+  }
+}
+
+void MaintenanceManager::RemoveDataDirOpUnlocked(const MaintenanceOp* op) {
+  if (op->io_usage() != MaintenanceOp::HIGH_IO_USAGE) {
+    return;
+  }
+  const MonoTime now = MonoTime::Now();
+  for (const auto& uuid : op->data_dirs()) {
+    DataDirState* dir = &FindOrDie(data_dirs_, uuid);
+    DCHECK_GT(dir->running_ops, 0);
+    if (--dir->running_ops == 0) {
+      dir->busy_seconds += (now - dir->busy_since).ToSeconds();
+    }
+  }
+}
+
 void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
   int64_t thread_id = Thread::CurrentThreadId();
   OpInstance op_instance;
@@ -475,6 +643,8 @@ void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
 
     op->DurationHistogram()->Increment(op_instance.duration.ToMilliseconds());
 
+    RemoveDataDirOpUnlocked(op);
+    NotifyStatsGroupUnlocked(op);
     running_ops_--;
     op->running_--;
     op->cond_->Signal();
@@ -532,6 +702,22 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
     }
   }
 
+  const MonoTime now = MonoTime::Now();
+  const double uptime_seconds = (now - start_time_).ToSeconds();
+  for (const auto& e : data_dirs_) {
+    const DataDirState& dir = e.second;
+    MaintenanceManagerStatusPB_DataDirPB* dir_pb = out_pb->add_data_dirs();
+    dir_pb->set_uuid(e.first);
+    dir_pb->set_running_ops(dir.running_ops);
+    dir_pb->set_scheduled_io_bytes(dir.scheduled_io_bytes);
+    double busy_seconds = dir.busy_seconds;
+    if (dir.running_ops > 0) {
+      busy_seconds += (now - dir.busy_since).ToSeconds();
+    }
+    dir_pb->set_utilization(uptime_seconds > 0 ?
+                            std::min(1.0, busy_seconds / uptime_seconds) : 0);
+  }
+
   for (int n = 1; n <= completed_ops_.size(); n++) {
     int i = completed_ops_count_ - n;
     if (i < 0) break;
@@ -108,6 +108,16 @@ class MaintenanceOpStats {
     perf_improvement_ = perf_improvement;
   }
 
+  int64_t io_bytes() const {
+    DCHECK(valid_);
+    return io_bytes_;
+  }
+
+  void set_io_bytes(int64_t io_bytes) {
+    UpdateLastModified();
+    io_bytes_ = io_bytes;
+  }
+
   const MonoTime& last_modified() const {
     DCHECK(valid_);
     return last_modified_;
@@ -148,6 +158,10 @@ class MaintenanceOpStats {
   // absolute scale (yet TBD).
   double perf_improvement_;
 
+  // Approximate amount of data that this operation would read and write on
+  // its data directories. May be 0 if unknown.
+  int64_t io_bytes_;
+
   // The last time that the stats were modified.
   MonoTime last_modified_;
 };
@@ -215,6 +229,40 @@ class MaintenanceOp {
 
   IOUsage io_usage() const { return io_usage_; }
 
+  // The UUIDs of the data directories this op does its I/O on. Empty if
+  // unknown, in which case the op isn't subject to the per-directory limits
+  // of the manager.
+  const std::vector<std::string>& data_dirs() const { return data_dirs_; }
+
+  // Sets the data directories of the op. Must be called before the op is
+  // registered.
+  void set_data_dirs(std::vector<std::string> data_dirs) {
+    DCHECK(!manager_);
+    data_dirs_ = std::move(data_dirs);
+  }
+
+  // Whether the stats of this op only change when it's notified with
+  // NotifyStatsChanged(), or when an op of its stats group completes. If so,
+  // and in the incremental mode of the manager (see
+  // --maintenance_manager_incremental_stats), UpdateStats() is only called
+  // then, or once the stats are older than
+  // --maintenance_manager_max_stats_age_ms, rather than on every scheduling
+  // pass.
+  virtual bool has_event_driven_stats() const { return false; }
+
+  // Marks the stats of this op to be updated on the next scheduling pass.
+  void NotifyStatsChanged() {
+    stats_dirty_.Store(true);
+  }
+
+  // Sets the group of ops whose work changes the stats of each other, e.g.
+  // the ops of the same tablet. May be null. Must be called before the op is
+  // registered.
+  void set_stats_group(const void* stats_group) {
+    DCHECK(!manager_);
+    stats_group_ = stats_group;
+  }
+
   // Return true if the operation has been cancelled due to Unregister() pending.
   bool cancelled() const {
     return cancel_.Load();
@@ -253,6 +301,13 @@ class MaintenanceOp {
   std::shared_ptr<MaintenanceManager> manager_;
 
   IOUsage io_usage_;
+
+  std::vector<std::string> data_dirs_;
+
+  // Set when the stats of the op must be updated on the next scheduling pass.
+  AtomicBool stats_dirty_;
+
+  const void* stats_group_;
 };
 
 struct MaintenanceOpComparator {
@@ -300,10 +355,37 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   static const Options kDefaultOptions;
 
  private:
+  FRIEND_TEST(MaintenanceManagerTest, TestIOCostPrioritization);
+  FRIEND_TEST(MaintenanceManagerTest, TestIncrementalStats);
   FRIEND_TEST(MaintenanceManagerTest, TestLogRetentionPrioritization);
   typedef std::map<MaintenanceOp*, MaintenanceOpStats,
           MaintenanceOpComparator> OpMapTy;
 
+  // The high-IO ops scheduled on a data directory.
+  struct DataDirState {
+    DataDirState();
+
+    // The number of ops running on the directory.
+    int running_ops;
+
+    // The estimated I/O of the ops scheduled on the directory which the I/O
+    // budget hasn't replenished yet, as of 'last_budget_update'.
+    double io_debt_bytes;
+    MonoTime last_budget_update;
+
+    // The estimated I/O of all the ops scheduled on the directory.
+    int64_t scheduled_io_bytes;
+
+    // The number of seconds during which ops were running on the directory,
+    // excluding the current stretch which started at 'busy_since' if ops are
+    // running.
+    double busy_seconds;
+    MonoTime busy_since;
+
+    // Pays the I/O debt back at the rate of the budget since the last update.
+    void ReplenishBudget(const MonoTime& now, double budget_bytes_per_sec);
+  };
+
   // Return true if tests have currently disabled the maintenance
   // manager by way of changing the gflags at runtime.
   bool disabled_for_tests() const;
@@ -316,6 +398,25 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   // suitable for logging.
   std::pair<MaintenanceOp*, std::string> FindBestOp();
 
+  // Returns whether the data directories of 'op' have the concurrency and
+  // I/O budget left to schedule it, as configured by the
+  // --maintenance_manager_max_ops_per_data_dir and
+  // --maintenance_manager_data_dir_io_budget_mb flags.
+  bool DataDirsAvailableUnlocked(const MaintenanceOp* op, const MonoTime& now);
+
+  // Returns whether the stats of 'op' must be updated by this scheduling pass.
+  static bool StatsNeedUpdate(MaintenanceOp* op, const MaintenanceOpStats& stats,
+                              const MonoTime& now);
+
+  // Marks the stats of the ops of the stats group of 'op' to be updated,
+  // including those of 'op' itself.
+  void NotifyStatsGroupUnlocked(MaintenanceOp* op);
+
+  // Accounts for 'op' on its data directories when it is scheduled with the
+  // given estimated I/O, and when it finishes.
+  void AddDataDirOpUnlocked(const MaintenanceOp* op, int64_t io_bytes);
+  void RemoveDataDirOpUnlocked(const MaintenanceOp* op);
+
   void LaunchOp(MaintenanceOp* op);
 
   std::string LogPrefix() const;
@@ -336,6 +437,13 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   int64_t completed_ops_count_;
   Random rand_;
 
+  // The state of the data directories the high-IO ops ran on, by UUID.
+  std::unordered_map<std::string, DataDirState> data_dirs_;
+  const MonoTime start_time_;
+
+  // The registered ops of each stats group.
+  std::unordered_map<const void*, std::vector<MaintenanceOp*>> stats_groups_;
+
   // Function which should return true if the server is under global memory pressure.
   // This is indirected for testing purposes.
   std::function<bool(double*)> memory_pressure_func_;
@@ -27,6 +27,7 @@
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -35,8 +36,11 @@
 #include "kudu/util/mem_tracker.pb.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/scoped_cleanup.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int64(mem_tracker_batch_bytes);
+
 namespace kudu {
 
 using std::equal_to;
@@ -62,6 +66,38 @@ TEST(MemTrackerTest, SingleTrackerNoLimit) {
   EXPECT_EQ(t->consumption(), 0);
 }
 
+TEST(MemTrackerTest, BatchedConsumption) {
+  gflags::FlagSaver saver;
+  FLAGS_mem_tracker_batch_bytes = 1000;
+  shared_ptr<MemTracker> p = MemTracker::CreateTracker(-1, "p");
+  shared_ptr<MemTracker> c = MemTracker::CreateTracker(-1, "c", p);
+
+  // Small changes are batched...
+  c->Consume(600);
+  EXPECT_EQ(0, c->consumption());
+  EXPECT_EQ(0, p->consumption());
+
+  // ...until the batch of the thread is large enough.
+  c->Consume(600);
+  EXPECT_EQ(1200, c->consumption());
+  EXPECT_EQ(1200, p->consumption());
+
+  c->Release(1100);
+  EXPECT_EQ(100, c->consumption());
+  EXPECT_EQ(100, p->consumption());
+
+  // TryConsume() isn't batched.
+  EXPECT_TRUE(c->TryConsume(10));
+  EXPECT_EQ(110, c->consumption());
+
+  // Destroying a tracker applies its batches.
+  c->Consume(500);
+  c->Release(610);
+  EXPECT_EQ(110, p->consumption());
+  c.reset();
+  EXPECT_EQ(0, p->consumption());
+}
+
 TEST(MemTrackerTest, SingleTrackerWithLimit) {
   shared_ptr<MemTracker> t = MemTracker::CreateTracker(11, "t");
   EXPECT_TRUE(t->has_limit());
@@ -379,6 +415,40 @@ TEST(MemTrackerTest, CollisionDetection) {
 #endif
 }
 
+// Microbenchmark of concurrent Consume()/Release() calls on trackers sharing
+// their ancestors, with and without per-thread batching.
+TEST(MemTrackerTest, ConsumeReleasePerf) {
+  const int kNumThreads = 8;
+  const int kNumIterations = AllowSlowTests() ? 10000000 : 100000;
+  gflags::FlagSaver saver;
+  for (int64_t batch_bytes : { 0, 64 * 1024 }) {
+    FLAGS_mem_tracker_batch_bytes = batch_bytes;
+    shared_ptr<MemTracker> p = MemTracker::CreateTracker(-1, "p");
+    vector<shared_ptr<MemTracker>> children;
+    for (int i = 0; i < kNumThreads; i++) {
+      children.emplace_back(MemTracker::CreateTracker(-1, Substitute("c$0", i), p));
+    }
+    LOG_TIMING(INFO, Substitute("$0 consume/release pairs with $1 byte batches",
+                                kNumThreads * kNumIterations, batch_bytes)) {
+      vector<std::thread> threads;
+      for (int i = 0; i < kNumThreads; i++) {
+        MemTracker* c = children[i].get();
+        threads.emplace_back([c, kNumIterations]() {
+          for (int j = 0; j < kNumIterations; j++) {
+            c->Consume(128);
+            c->Release(128);
+          }
+        });
+      }
+      for (auto& t : threads) {
+        t.join();
+      }
+    }
+    children.clear();
+    ASSERT_EQ(0, p->consumption());
+  }
+}
+
 TEST(MemTrackerTest, TestMultiThreadedRegisterAndDestroy) {
   std::atomic<bool> done(false);
   vector<std::thread> threads;
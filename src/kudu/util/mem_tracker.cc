@@ -17,22 +17,40 @@
 
 #include "kudu/util/mem_tracker.h"
 
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdlib>
 #include <deque>
 #include <limits>
 #include <list>
 #include <memory>
+#include <new>
 #include <ostream>
 #include <stack>
 #include <type_traits>
 
+#include <gflags/gflags.h>
+
 #include "kudu/gutil/once.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/mem_tracker.pb.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/process_memory.h"
+#include "kudu/util/striped64.h"
+
+DEFINE_int64(mem_tracker_batch_bytes, 0,
+             "If positive, memory consumption changes are batched per thread "
+             "and only applied to the memory trackers once a thread's batch "
+             "reaches this many bytes. This avoids contention on the shared "
+             "trackers, at the cost of a tracked consumption which may lag "
+             "behind the actual one by about this many bytes per CPU and per "
+             "tracker. Only applies to the trackers created after it's set.");
+TAG_FLAG(mem_tracker_batch_bytes, experimental);
 
 namespace kudu {
 
@@ -48,6 +66,36 @@ using std::vector;
 using std::weak_ptr;
 
 using strings::Substitute;
+using striped64::internal::Cell;
+
+namespace {
+
+// The number of per-thread batches of a tracker: the nearest power of two
+// greater than or equal to the number of CPUs.
+int NumBatches() {
+  static const int kNumBatches = []() {
+    const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = 1;
+    while (num_cpus > n) {
+      n <<= 1;
+    }
+    return n;
+  }();
+  return kNumBatches;
+}
+
+// Returns the index of the batch of the calling thread. The threads are
+// assigned batches in turn, so that concurrent threads don't share one.
+int ThreadBatchIndex() {
+  static std::atomic<uint32_t> next_index(0);
+  static __thread int tls_index = -1;
+  if (PREDICT_FALSE(tls_index < 0)) {
+    tls_index = next_index.fetch_add(1, std::memory_order_relaxed) & (NumBatches() - 1);
+  }
+  return tls_index;
+}
+
+} // anonymous namespace
 
 // The ancestor for all trackers. Every tracker is visible from the root down.
 static shared_ptr<MemTracker> root_tracker;
@@ -79,12 +127,25 @@ MemTracker::MemTracker(int64_t byte_limit, const string& id, shared_ptr<MemTrack
       id_(id),
       descr_(Substitute("memory consumption for $0", id)),
       parent_(std::move(parent)),
-      consumption_(0) {
+      consumption_(0),
+      batch_bytes_(FLAGS_mem_tracker_batch_bytes),
+      batches_(nullptr) {
   VLOG(1) << "Creating tracker " << ToString();
+  if (batch_bytes_ > 0) {
+    void* buf = nullptr;
+    int err = posix_memalign(&buf, CACHELINE_SIZE, sizeof(Cell) * NumBatches());
+    CHECK_EQ(0, err) << "error calling posix_memalign";
+    batches_ = new (buf) Cell[NumBatches()];
+  }
 }
 
 MemTracker::~MemTracker() {
   VLOG(1) << "Destroying tracker " << ToString();
+  if (batches_) {
+    FlushBatches();
+    // Cell is a POD, so no need to destruct each one.
+    free(batches_);
+  }
   if (parent_) {
     DCHECK(consumption() == 0) << "Memory tracker " << ToString()
         << " has unreleased consumption " << consumption();
@@ -230,9 +291,11 @@ void MemTracker::Consume(int64_t bytes) {
   if (bytes == 0) {
     return;
   }
-  for (auto& tracker : all_trackers_) {
-    tracker->consumption_.IncrementBy(bytes);
+  if (batches_) {
+    ConsumeBatched(bytes);
+    return;
   }
+  ConsumeAll(bytes);
 }
 
 bool MemTracker::TryConsume(int64_t bytes) {
@@ -279,12 +342,37 @@ void MemTracker::Release(int64_t bytes) {
     return;
   }
 
-  for (auto& tracker : all_trackers_) {
-    tracker->consumption_.IncrementBy(-bytes);
+  if (batches_) {
+    ConsumeBatched(-bytes);
+  } else {
+    ConsumeAll(-bytes);
   }
   process_memory::MaybeGCAfterRelease(bytes);
 }
 
+void MemTracker::ConsumeBatched(int64_t bytes) {
+  // Only the calling thread usually updates its batch, so the cache line of
+  // the batch stays local to its CPU.
+  std::atomic<int64_t>* batch = &batches_[ThreadBatchIndex()].value_;
+  int64_t batched = batch->fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  if (PREDICT_TRUE(std::abs(batched) < batch_bytes_)) {
+    return;
+  }
+  ConsumeAll(batch->exchange(0, std::memory_order_relaxed));
+}
+
+void MemTracker::ConsumeAll(int64_t bytes) {
+  for (auto& tracker : all_trackers_) {
+    tracker->consumption_.IncrementBy(bytes);
+  }
+}
+
+void MemTracker::FlushBatches() {
+  for (int i = 0; i < NumBatches(); i++) {
+    ConsumeAll(batches_[i].value_.exchange(0, std::memory_order_relaxed));
+  }
+}
+
 bool MemTracker::AnyLimitExceeded() {
   for (const auto& tracker : limit_trackers_) {
     if (tracker->LimitExceeded()) {
@@ -33,6 +33,12 @@ namespace kudu {
 
 class MemTrackerPB;
 
+namespace striped64 {
+namespace internal {
+class Cell;
+} // namespace internal
+} // namespace striped64
+
 // A MemTracker tracks memory consumption; it contains an optional limit and is
 // arranged into a tree structure such that the consumption tracked by a
 // MemTracker is also tracked by its ancestors.
@@ -56,6 +62,15 @@ class MemTrackerPB;
 // Memory consumption is tracked via calls to Consume()/Release(), either to
 // the tracker itself or to one of its descendants.
 //
+// With --mem_tracker_batch_bytes, the consumption changes made through
+// Consume()/Release() are batched per thread, and only applied to the tracker
+// and its ancestors once a thread's batch reaches that many bytes. This keeps
+// the hot paths from contending on the counters of the shared ancestors, e.g.
+// the root tracker, at the cost of a tracked consumption which lags behind the
+// actual one by at most the number of batches (about one per CPU) times
+// --mem_tracker_batch_bytes, for the tracker and for each of its descendants.
+// TryConsume() is never batched.
+//
 // This class is thread-safe.
 class MemTracker : public std::enable_shared_from_this<MemTracker> {
  public:
@@ -140,7 +155,8 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   bool has_limit() const { return limit_ >= 0; }
   const std::string& id() const { return id_; }
 
-  // Returns the memory consumed in bytes.
+  // Returns the memory consumed in bytes, not including the consumption still
+  // batched per thread, see above.
   int64_t consumption() const {
     return consumption_.current_value();
   }
@@ -174,6 +190,16 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // Creates the root tracker.
   static void CreateRootTracker();
 
+  // Adds 'bytes' to the batch of the calling thread, applying the batch to
+  // the tracker and its ancestors once it's large enough.
+  void ConsumeBatched(int64_t bytes);
+
+  // Applies 'bytes' to the consumption of the tracker and its ancestors.
+  void ConsumeAll(int64_t bytes);
+
+  // Applies the batches of every thread.
+  void FlushBatches();
+
   int64_t limit_;
   const std::string id_;
   const std::string descr_;
@@ -181,6 +207,12 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
 
   HighWaterMark consumption_;
 
+  // The threshold of --mem_tracker_batch_bytes when the tracker was created,
+  // and the per-thread batches of consumption not yet applied. The batches
+  // are null if the tracker doesn't batch its consumption.
+  const int64_t batch_bytes_;
+  striped64::internal::Cell* batches_;
+
   // this tracker plus all of its ancestors
   std::vector<MemTracker*> all_trackers_;
   // all_trackers_ with valid limits
@@ -35,6 +35,8 @@ DEFINE_int32(num_threads, 16, "Number of threads to test");
 DEFINE_int32(allocs_per_thread, 10000, "Number of allocations each thread should do");
 DEFINE_int32(alloc_size, 4, "number of bytes in each allocation");
 
+DECLARE_int64(arena_chunk_pool_capacity_mb);
+
 namespace kudu {
 
 using std::shared_ptr;
@@ -189,6 +191,44 @@ TEST(TestArena, TestMemoryTrackingEnforced) {
   ASSERT_EQ(256, mem_tracker->consumption());
 }
 
+TEST(TestArena, TestChunkPool) {
+  FLAGS_arena_chunk_pool_capacity_mb = 4;
+  ASSERT_TRUE(ArenaChunkPool::enabled());
+  ArenaChunkPool* pool = ArenaChunkPool::Get();
+  const size_t kChunkSize = ArenaChunkPool::kChunkSize;
+
+  shared_ptr<MemTracker> mem_tracker = MemTracker::CreateTracker(-1, "arena-test-tracker");
+  shared_ptr<MemoryTrackingBufferAllocator> allocator(
+      new MemoryTrackingBufferAllocator(pool, mem_tracker));
+  {
+    MemoryTrackingArena arena(256, allocator);
+    arena.SetMaxBufferSize(kChunkSize);
+    for (int i = 0; i < 10 * 1024; i++) {
+      ASSERT_TRUE(arena.AllocateBytes(1024));
+    }
+    ASSERT_EQ(0, pool->idle_bytes());
+  }
+  ASSERT_EQ(0, mem_tracker->consumption());
+
+  // The pool only keeps as many idle chunks as its capacity allows.
+  ASSERT_EQ(2 * kChunkSize, pool->idle_bytes());
+
+  // A new arena draws its chunks from the pool.
+  {
+    MemoryTrackingArena arena(kChunkSize, allocator);
+    ASSERT_EQ(kChunkSize, pool->idle_bytes());
+    ASSERT_EQ(kChunkSize, mem_tracker->consumption());
+  }
+  ASSERT_EQ(2 * kChunkSize, pool->idle_bytes());
+
+  // Buffers of other sizes come from the heap.
+  {
+    MemoryTrackingArena arena(1024, allocator);
+    ASSERT_EQ(2 * kChunkSize, pool->idle_bytes());
+  }
+  ASSERT_EQ(2 * kChunkSize, pool->idle_bytes());
+}
+
 TEST(TestArena, TestSTLAllocator) {
   Arena a(256);
   typedef vector<int, ArenaAllocator<int, false> > ArenaVector;
@@ -99,7 +99,9 @@ class ArenaBase {
   explicit ArenaBase(size_t initial_buffer_size);
 
   // Set the maximum buffer size allocated for this arena.
-  // The maximum buffer size allowed is slightly less than ~1MB (8192 * 127 bytes).
+  // The maximum buffer size allowed is slightly less than ~1MB (8192 * 127 bytes),
+  // or ArenaChunkPool::kChunkSize for arenas whose buffers come from the
+  // ArenaChunkPool, which doesn't go through tcmalloc.
   //
   // Consider the following pros/cons of large buffer sizes:
   //
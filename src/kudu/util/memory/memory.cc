@@ -21,13 +21,17 @@
 #include "kudu/util/memory/memory.h"
 
 #include <mm_malloc.h>
+#include <sys/mman.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 
 #include <gflags/gflags.h>
 
+#include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/overwrite.h"
@@ -44,6 +48,13 @@ DEFINE_bool(allocator_aligned_mode, false,
             "unless explicitly specified otherwise - to boost SIMD");
 TAG_FLAG(allocator_aligned_mode, hidden);
 
+DEFINE_int64(arena_chunk_pool_capacity_mb, 0,
+             "If positive, the arenas of the MemRowSets and DeltaMemStores "
+             "grow by chunks of 2MB backed by huge pages, drawn from and "
+             "returned to a process-wide pool holding up to this many MB of "
+             "idle chunks.");
+TAG_FLAG(arena_chunk_pool_capacity_mb, experimental);
+
 namespace kudu {
 
 namespace {
@@ -336,4 +347,91 @@ void MemoryTrackingBufferAllocator::FreeInternal(Buffer* buffer) {
   mem_tracker_->Release(buffer->size());
 }
 
+bool ArenaChunkPool::enabled() {
+  return FLAGS_arena_chunk_pool_capacity_mb > 0;
+}
+
+ArenaChunkPool::ArenaChunkPool()
+    : mem_tracker_(MemTracker::CreateTracker(
+          std::max<int64_t>(FLAGS_arena_chunk_pool_capacity_mb, 0) * 1024 * 1024,
+          "arena-chunk-pool")) {
+}
+
+int64_t ArenaChunkPool::idle_bytes() const {
+  return mem_tracker_->consumption();
+}
+
+void* ArenaChunkPool::MapChunk() {
+  // Map twice the size to carve out a chunk aligned on a huge page.
+  const size_t map_size = 2 * kChunkSize;
+  void* mapping = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+  uintptr_t chunk = KUDU_ALIGN_UP(start, kChunkSize);
+  if (chunk > start) {
+    munmap(mapping, chunk - start);
+  }
+  if (chunk + kChunkSize < start + map_size) {
+    munmap(reinterpret_cast<void*>(chunk + kChunkSize), start + map_size - chunk - kChunkSize);
+  }
+#ifdef MADV_HUGEPAGE
+  // Best effort: without transparent huge pages, the chunk is still pooled.
+  madvise(reinterpret_cast<void*>(chunk), kChunkSize, MADV_HUGEPAGE);
+#endif
+  return reinterpret_cast<void*>(chunk);
+}
+
+Buffer* ArenaChunkPool::AllocateInternal(size_t requested,
+                                         size_t minimal,
+                                         BufferAllocator* originator) {
+  if (minimal > kChunkSize || requested < kChunkSize) {
+    // Buffers of any other size are never chunks, which is how FreeInternal()
+    // tells them apart.
+    return DelegateAllocate(HeapBufferAllocator::Get(), requested, minimal, originator);
+  }
+  void* data = nullptr;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!idle_chunks_.empty()) {
+      data = idle_chunks_.back();
+      idle_chunks_.pop_back();
+    }
+  }
+  if (data) {
+    mem_tracker_->Release(kChunkSize);
+  } else {
+    data = MapChunk();
+    if (!data) {
+      return nullptr;
+    }
+  }
+  return CreateBuffer(data, kChunkSize, originator);
+}
+
+bool ArenaChunkPool::ReallocateInternal(size_t requested,
+                                        size_t minimal,
+                                        Buffer* buffer,
+                                        BufferAllocator* originator) {
+  LOG(FATAL) << "Not implemented";
+  return false;
+}
+
+void ArenaChunkPool::FreeInternal(Buffer* buffer) {
+  if (buffer->size() != kChunkSize) {
+    DelegateFree(HeapBufferAllocator::Get(), buffer);
+    return;
+  }
+  // The arena may have poisoned the chunk, which must not outlive it.
+  ASAN_UNPOISON_MEMORY_REGION(buffer->data(), kChunkSize);
+  if (mem_tracker_->TryConsume(kChunkSize)) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    idle_chunks_.push_back(buffer->data());
+    return;
+  }
+  munmap(buffer->data(), kChunkSize);
+}
+
 }  // namespace kudu
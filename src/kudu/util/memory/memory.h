@@ -43,6 +43,7 @@
 #include <glog/logging.h>
 
 #include "kudu/util/boost_mutex_utils.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/mutex.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -703,6 +704,71 @@ class MemoryTrackingBufferAllocator : public BufferAllocator {
   bool enforce_limit_;
 };
 
+// Allocates buffers of exactly kChunkSize bytes out of a process-wide pool of
+// chunks mapped outside of the heap and backed by transparent huge pages, and
+// smaller or larger buffers on the heap.
+//
+// Freed chunks go back to the pool rather than to the OS, so that arenas which
+// are repeatedly filled and destroyed, e.g. those of the MemRowSets and
+// DeltaMemStores, neither fragment the heap nor map new pages. The memory held
+// by the idle chunks is accounted to a MemTracker whose limit,
+// --arena_chunk_pool_capacity_mb, bounds the pool: a chunk freed into a full
+// pool is unmapped.
+//
+// This class is thread-safe.
+class ArenaChunkPool : public BufferAllocator {
+ public:
+  // The size of a huge page on x86-64.
+  static constexpr size_t kChunkSize = 2 * 1024 * 1024;
+
+  // Whether the pool is enabled, i.e. --arena_chunk_pool_capacity_mb is set.
+  static bool enabled();
+
+  // Returns a singleton instance of the pool.
+  static ArenaChunkPool* Get() {
+    return Singleton<ArenaChunkPool>::get();
+  }
+
+  // Returns the pool if it's enabled, or the heap allocator otherwise.
+  static BufferAllocator* GetOrHeapAllocator() {
+    if (enabled()) {
+      return Get();
+    }
+    return HeapBufferAllocator::Get();
+  }
+
+  // Returns the number of bytes held by the idle chunks of the pool.
+  int64_t idle_bytes() const;
+
+ private:
+  friend class Singleton<ArenaChunkPool>;
+
+  ArenaChunkPool();
+
+  // Returns a chunk if 'minimal' <= kChunkSize <= 'requested', or a
+  // 'requested'-sized buffer on the heap otherwise.
+  virtual Buffer* AllocateInternal(size_t requested,
+                                   size_t minimal,
+                                   BufferAllocator* originator) OVERRIDE;
+
+  virtual bool ReallocateInternal(size_t requested,
+                                  size_t minimal,
+                                  Buffer* buffer,
+                                  BufferAllocator* originator) OVERRIDE;
+
+  virtual void FreeInternal(Buffer* buffer) OVERRIDE;
+
+  // Maps a new chunk, or returns null on failure.
+  static void* MapChunk();
+
+  std::shared_ptr<MemTracker> mem_tracker_;
+
+  mutable simple_spinlock lock_;
+  std::vector<void*> idle_chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArenaChunkPool);
+};
+
 // Synchronizes access to AllocateInternal and FreeInternal, and exposes the
 // mutex for use by subclasses. Allocation requests performed through this
 // allocator are atomic end-to-end. Template parameter DelegateAllocatorType
@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -32,6 +33,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/hdr_histogram.h"
+#include "kudu/util/histogram.pb.h"
 #include "kudu/util/jsonreader.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/metrics.h"
@@ -41,6 +43,7 @@
 #include "kudu/util/test_util.h"
 
 using std::string;
+using std::thread;
 using std::unordered_set;
 using std::vector;
 
@@ -176,6 +179,41 @@ TEST_F(MetricsTest, SimpleHistogramTest) {
   // TODO: Test coverage needs to be improved a lot.
 }
 
+METRIC_DEFINE_histogram(test_entity, test_sharded_hist, "Test Sharded Histogram",
+                        MetricUnit::kMilliseconds, "foo", 1000000, 3,
+                        kudu::SHARDED);
+
+// Test that the values recorded into the per-CPU shards of a sharded histogram,
+// from many threads at once, are all merged together when it's read.
+TEST_F(MetricsTest, ShardedHistogramTest) {
+  scoped_refptr<Histogram> hist = METRIC_test_sharded_hist.Instantiate(entity_);
+  const int kNumThreads = 8;
+  const int kNumValuesPerThread = 1000;
+  vector<thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&hist, i]() {
+      for (int j = 1; j <= kNumValuesPerThread; j++) {
+        hist->Increment(i * kNumValuesPerThread + j);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  const int kNumValues = kNumThreads * kNumValuesPerThread;
+  ASSERT_EQ(kNumValues, hist->TotalCount());
+  ASSERT_EQ(1, hist->MinValueForTests());
+  ASSERT_EQ(kNumValues, hist->MaxValueForTests());
+  ASSERT_EQ((kNumValues + 1) / 2.0, hist->MeanValueForTests());
+
+  HistogramSnapshotPB snapshot_pb;
+  MetricJsonOptions opts;
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot_pb, opts));
+  ASSERT_EQ(kNumValues, snapshot_pb.total_count());
+  ASSERT_EQ(static_cast<int64_t>(kNumValues) * (kNumValues + 1) / 2, snapshot_pb.total_sum());
+}
+
 TEST_F(MetricsTest, JsonPrintTest) {
   scoped_refptr<Counter> test_counter = METRIC_test_counter.Instantiate(entity_);
   test_counter->Increment();
@@ -222,6 +260,92 @@ TEST_F(MetricsTest, JsonPrintTest) {
   ASSERT_STR_CONTAINS(METRIC_test_counter.name(), out.str());
 }
 
+TEST_F(MetricsTest, PrometheusPrintTest) {
+  scoped_refptr<Counter> test_counter = METRIC_test_counter.Instantiate(entity_);
+  test_counter->IncrementBy(3);
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  hist->Increment(2);
+  hist->Increment(4);
+  entity_->SetAttribute("test_attr", "attr \"val\"");
+
+  std::ostringstream out;
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, MetricJsonOptions()));
+  const string labels = "entity_type=\"test_entity\",id=\"my-test\","
+                        "test_attr=\"attr \\\"val\\\"\"";
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_test_counter counter\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_counter{" + labels + "} 3\n");
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_test_hist summary\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist{" + labels + ",quantile=\"1\"} 4\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist_sum{" + labels + "} 6\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist_count{" + labels + "} 2\n");
+
+  // The entity attributes may be left out.
+  out.str("");
+  MetricJsonOptions opts;
+  opts.include_entity_attributes = false;
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "test_counter" }, opts));
+  ASSERT_STR_CONTAINS(out.str(),
+                      "kudu_test_counter{entity_type=\"test_entity\",id=\"my-test\"} 3\n");
+  ASSERT_STR_NOT_CONTAINS(out.str(), "test_hist");
+}
+
+// Test that entities may be filtered by type and id.
+TEST_F(MetricsTest, EntityFilterTest) {
+  scoped_refptr<MetricEntity> other =
+      METRIC_ENTITY_test_entity.Instantiate(&registry_, "my-other-test");
+  scoped_refptr<Counter> test_counter = METRIC_test_counter.Instantiate(entity_);
+  scoped_refptr<Counter> other_counter = METRIC_test_counter.Instantiate(other);
+
+  const auto get_json = [&](const MetricJsonOptions& opts) {
+    std::ostringstream out;
+    JsonWriter writer(&out, JsonWriter::COMPACT);
+    CHECK_OK(registry_.WriteAsJson(&writer, { "*" }, opts));
+    return out.str();
+  };
+
+  MetricJsonOptions opts;
+  opts.entity_ids = { "my-other-test" };
+  string json = get_json(opts);
+  ASSERT_STR_CONTAINS(json, "\"my-other-test\"");
+  ASSERT_STR_NOT_CONTAINS(json, "\"my-test\"");
+
+  // Unlike metric names, ids must match exactly.
+  opts.entity_ids = { "my-" };
+  ASSERT_EQ("[]", get_json(opts));
+
+  opts.entity_ids.clear();
+  opts.entity_types = { "server" };
+  ASSERT_EQ("[]", get_json(opts));
+  opts.entity_types = { "test_entity" };
+  json = get_json(opts);
+  ASSERT_STR_CONTAINS(json, "\"my-test\"");
+  ASSERT_STR_CONTAINS(json, "\"my-other-test\"");
+}
+
+// Test that histogram snapshots are reused only while no values are recorded.
+TEST_F(MetricsTest, HistogramSnapshotCacheTest) {
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  hist->Increment(10);
+
+  MetricJsonOptions opts;
+  HistogramSnapshotPB snapshot_pb;
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot_pb, opts));
+  ASSERT_EQ(1, snapshot_pb.total_count());
+  ASSERT_EQ(10, snapshot_pb.max());
+
+  snapshot_pb.Clear();
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot_pb, opts));
+  ASSERT_EQ("test_hist", snapshot_pb.name());
+  ASSERT_EQ(1, snapshot_pb.total_count());
+  ASSERT_EQ(10, snapshot_pb.max());
+
+  hist->Increment(20);
+  snapshot_pb.Clear();
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot_pb, opts));
+  ASSERT_EQ(2, snapshot_pb.total_count());
+  ASSERT_EQ(20, snapshot_pb.max());
+}
+
 // Test that metrics are retired when they are no longer referenced.
 TEST_F(MetricsTest, RetirementTest) {
   FLAGS_metrics_retirement_age_ms = 100;
@@ -16,8 +16,11 @@
 // under the License.
 #include "kudu/util/metrics.h"
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <utility>
 
 #include <gflags/gflags.h>
@@ -26,9 +29,11 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hdr_histogram.h"
 #include "kudu/util/histogram.pb.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/string_case.h"
 
@@ -44,6 +49,7 @@ METRIC_DEFINE_entity(server);
 
 namespace kudu {
 
+using std::ostream;
 using std::string;
 using std::vector;
 using strings::Substitute;
@@ -203,8 +209,70 @@ bool MatchMetricInList(const string& metric_name,
   return false;
 }
 
+// Returns 'name' with the characters which aren't allowed in Prometheus
+// metric and label names replaced by underscores.
+string PrometheusName(const string& name) {
+  string ret = name;
+  for (size_t i = 0; i < ret.size(); i++) {
+    char c = ret[i];
+    if (!(isalpha(c) || c == '_' || (i > 0 && isdigit(c)))) {
+      ret[i] = '_';
+    }
+  }
+  return ret;
+}
+
+// Escapes 'value' for use as a Prometheus label value or, if 'is_help' is
+// true, as the text of a HELP line.
+string PrometheusEscape(const string& value, bool is_help) {
+  string ret;
+  ret.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        ret += "\\\\";
+        break;
+      case '\n':
+        ret += "\\n";
+        break;
+      case '"':
+        ret += is_help ? "\"" : "\\\"";
+        break;
+      default:
+        ret += c;
+    }
+  }
+  return ret;
+}
+
+// Returns the Prometheus metric type of metrics of type 'type'.
+const char* PrometheusType(MetricType::Type type) {
+  switch (type) {
+    case MetricType::kCounter:
+      return "counter";
+    case MetricType::kHistogram:
+      return "summary";
+    default:
+      return "gauge";
+  }
+}
+
 } // anonymous namespace
 
+bool MetricEntity::MatchesEntityFilters(const MetricJsonOptions& opts) const {
+  if (!opts.entity_types.empty() &&
+      std::find(opts.entity_types.begin(), opts.entity_types.end(), prototype_->name()) ==
+      opts.entity_types.end()) {
+    return false;
+  }
+  if (!opts.entity_ids.empty() &&
+      std::find(opts.entity_ids.begin(), opts.entity_ids.end(), id_) ==
+      opts.entity_ids.end()) {
+    return false;
+  }
+  return true;
+}
+
 
 Status MetricEntity::WriteAsJson(JsonWriter* writer,
                                  const vector<string>& requested_metrics,
@@ -218,7 +286,9 @@ Status MetricEntity::WriteAsJson(JsonWriter* writer,
   {
     // Snapshot the metrics in this registry (not guaranteed to be a consistent snapshot)
     std::lock_guard<simple_spinlock> l(lock_);
-    attrs = attributes_;
+    if (opts.include_entity_attributes) {
+      attrs = attributes_;
+    }
     for (const MetricMap::value_type& val : metric_map_) {
       const MetricPrototype* prototype = val.first;
       const scoped_refptr<Metric>& metric = val.second;
@@ -272,6 +342,51 @@ Status MetricEntity::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void MetricEntity::CollectForPrometheus(const vector<string>& requested_metrics,
+                                        const MetricJsonOptions& opts,
+                                        PrometheusFamilyMap* families) const {
+  bool select_all = MatchMetricInList(id(), requested_metrics);
+
+  vector<scoped_refptr<Metric>> metrics;
+  AttributeMap attrs;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (opts.include_entity_attributes) {
+      attrs = attributes_;
+    }
+    for (const MetricMap::value_type& val : metric_map_) {
+      if (select_all || MatchMetricInList(val.first->name(), requested_metrics)) {
+        metrics.push_back(val.second);
+      }
+    }
+  }
+  if (metrics.empty()) {
+    return;
+  }
+
+  // Sort the attributes so that each entity's labels are consistently ordered.
+  std::map<string, string> sorted_attrs(attrs.begin(), attrs.end());
+  string labels = Substitute("entity_type=\"$0\",id=\"$1\"",
+                             prototype_->name(), PrometheusEscape(id_, false));
+  for (const auto& attr : sorted_attrs) {
+    // Don't let an attribute override the labels identifying the entity.
+    string name = PrometheusName(attr.first);
+    if (name == "entity_type" || name == "id") {
+      continue;
+    }
+    labels += Substitute(",$0=\"$1\"", name, PrometheusEscape(attr.second, false));
+  }
+
+  for (auto& m : metrics) {
+    if (!m->ModifiedInOrAfterEpoch(opts.only_modified_in_or_after_epoch) ||
+        (!opts.include_untouched_metrics && m->IsUntouched()) ||
+        !m->HasNumericValue()) {
+      continue;
+    }
+    (*families)[m->prototype()->name()].emplace_back(labels, std::move(m));
+  }
+}
+
 void MetricEntity::RetireOldMetrics() {
   MonoTime now(MonoTime::Now());
 
@@ -353,6 +468,9 @@ Status MetricRegistry::WriteAsJson(JsonWriter* writer,
 
   writer->StartArray();
   for (const auto& e : entities) {
+    if (!e.second->MatchesEntityFilters(opts)) {
+      continue;
+    }
     WARN_NOT_OK(e.second->WriteAsJson(writer, requested_metrics, opts),
                 Substitute("Failed to write entity $0 as JSON", e.second->id()));
   }
@@ -368,6 +486,45 @@ Status MetricRegistry::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status MetricRegistry::WriteAsPrometheus(ostream* out,
+                                         const vector<string>& requested_metrics,
+                                         const MetricJsonOptions& opts) const {
+  EntityMap entities;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    entities = entities_;
+  }
+
+  // The format requires all of the samples of a metric to be grouped under
+  // its TYPE line, so gather the instances of each metric from all of the
+  // entities first.
+  MetricEntity::PrometheusFamilyMap families;
+  for (const auto& e : entities) {
+    if (e.second->MatchesEntityFilters(opts)) {
+      e.second->CollectForPrometheus(requested_metrics, opts, &families);
+    }
+  }
+
+  const std::streamsize old_precision = out->precision(std::numeric_limits<double>::digits10);
+  for (const auto& family : families) {
+    const MetricPrototype* prototype = family.second.front().second->prototype();
+    const string name = "kudu_" + PrometheusName(family.first);
+    *out << "# HELP " << name << " " << PrometheusEscape(prototype->description(), true) << "\n";
+    *out << "# TYPE " << name << " " << PrometheusType(prototype->type()) << "\n";
+    for (const auto& instance : family.second) {
+      WARN_NOT_OK(instance.second->WriteAsPrometheus(out, name, instance.first),
+                  Substitute("Failed to write $0 in Prometheus format", family.first));
+    }
+  }
+  out->precision(old_precision);
+
+  // See WriteAsJson().
+  families.clear();
+  entities.clear();
+  const_cast<MetricRegistry*>(this)->RetireOldMetrics();
+  return Status::OK();
+}
+
 void MetricRegistry::RetireOldMetrics() {
   std::lock_guard<simple_spinlock> l(lock_);
   for (auto it = entities_.begin(); it != entities_.end();) {
@@ -547,6 +704,18 @@ Status Gauge::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status Gauge::WriteAsPrometheus(ostream* out,
+                                const string& name,
+                                const string& labels) const {
+  if (!HasNumericValue()) {
+    return Status::NotSupported("gauge value is not numeric");
+  }
+  *out << name << "{" << labels << "} ";
+  WriteValue(out);
+  *out << "\n";
+  return Status::OK();
+}
+
 //
 // StringGauge
 //
@@ -608,6 +777,13 @@ Status Counter::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status Counter::WriteAsPrometheus(ostream* out,
+                                  const string& name,
+                                  const string& labels) const {
+  *out << name << "{" << labels << "} " << value() << "\n";
+  return Status::OK();
+}
+
 /////////////////////////////////////////////////
 // HistogramPrototype
 /////////////////////////////////////////////////
@@ -637,19 +813,74 @@ scoped_refptr<Histogram> HistogramPrototype::Instantiate(
 
 Histogram::Histogram(const HistogramPrototype* proto)
   : Metric(proto),
-    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())) {
+    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())),
+    num_shards_(proto->sharded() ? base::NumCPUs() : 0),
+    cached_snapshot_count_(0) {
+  if (num_shards_ > 0) {
+    shards_.reset(new std::atomic<HdrHistogram*>[num_shards_]);
+    for (int i = 0; i < num_shards_; i++) {
+      shards_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
+
+Histogram::~Histogram() {
+  for (int i = 0; i < num_shards_; i++) {
+    delete shards_[i].load(std::memory_order_relaxed);
+  }
+}
+
+HdrHistogram* Histogram::CurrentShard() {
+  int cpu = GetCurrentCpu();
+  std::atomic<HdrHistogram*>* shard = &shards_[(cpu < 0 ? 0 : cpu) % num_shards_];
+  HdrHistogram* h = shard->load(std::memory_order_acquire);
+  if (PREDICT_TRUE(h != nullptr)) {
+    return h;
+  }
+  // Only the CPUs which record values get a shard.
+  gscoped_ptr<HdrHistogram> new_h(new HdrHistogram(histogram_->highest_trackable_value(),
+                                                   histogram_->num_significant_digits()));
+  if (shard->compare_exchange_strong(h, new_h.get(), std::memory_order_acq_rel)) {
+    return new_h.release();
+  }
+  // Another thread on the same CPU won the race.
+  return h;
 }
 
 void Histogram::Increment(int64_t value) {
   UpdateModificationEpoch();
+  if (shards_) {
+    CurrentShard()->Increment(value);
+    return;
+  }
   histogram_->Increment(value);
 }
 
 void Histogram::IncrementBy(int64_t value, int64_t amount) {
   UpdateModificationEpoch();
+  if (shards_) {
+    CurrentShard()->IncrementBy(value, amount);
+    return;
+  }
   histogram_->IncrementBy(value, amount);
 }
 
+const HdrHistogram* Histogram::histogram() const {
+  DCHECK(!shards_) << "sharded histogram " << prototype_->name();
+  return histogram_.get();
+}
+
+std::unique_ptr<HdrHistogram> Histogram::Snapshot() const {
+  std::unique_ptr<HdrHistogram> snapshot(new HdrHistogram(*histogram_));
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* shard = shards_[i].load(std::memory_order_acquire);
+    if (shard) {
+      snapshot->MergeFrom(*shard);
+    }
+  }
+  return snapshot;
+}
+
 Status Histogram::WriteAsJson(JsonWriter* writer,
                               const MetricJsonOptions& opts) const {
 
@@ -659,6 +890,28 @@ Status Histogram::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status Histogram::WriteAsPrometheus(ostream* out,
+                                    const string& name,
+                                    const string& labels) const {
+  HistogramSnapshotPB snapshot;
+  RETURN_NOT_OK(GetHistogramSnapshotPB(&snapshot, MetricJsonOptions()));
+  const std::pair<const char*, int64_t> quantiles[] = {
+    { "0", snapshot.min() },
+    { "0.75", snapshot.percentile_75() },
+    { "0.95", snapshot.percentile_95() },
+    { "0.99", snapshot.percentile_99() },
+    { "0.999", snapshot.percentile_99_9() },
+    { "0.9999", snapshot.percentile_99_99() },
+    { "1", snapshot.max() },
+  };
+  for (const auto& q : quantiles) {
+    *out << name << "{" << labels << ",quantile=\"" << q.first << "\"} " << q.second << "\n";
+  }
+  *out << name << "_sum{" << labels << "} " << snapshot.total_sum() << "\n";
+  *out << name << "_count{" << labels << "} " << snapshot.total_count() << "\n";
+  return Status::OK();
+}
+
 Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
                                          const MetricJsonOptions& opts) const {
   snapshot_pb->set_name(prototype_->name());
@@ -673,7 +926,8 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
   // Fast-path for a reasonably common case of an empty histogram. This occurs
   // when a histogram is tracking some information about a feature not in
   // use, for example.
-  if (histogram_->TotalCount() == 0) {
+  const uint64_t total_count = TotalCount();
+  if (total_count == 0) {
     snapshot_pb->set_total_count(0);
     snapshot_pb->set_total_sum(0);
     snapshot_pb->set_min(0);
@@ -685,17 +939,30 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
     snapshot_pb->set_percentile_99_99(0);
     snapshot_pb->set_max(0);
   } else {
-    HdrHistogram snapshot(*histogram_);
-    snapshot_pb->set_total_count(snapshot.TotalCount());
-    snapshot_pb->set_total_sum(snapshot.TotalSum());
-    snapshot_pb->set_min(snapshot.MinValue());
-    snapshot_pb->set_mean(snapshot.MeanValue());
-    snapshot_pb->set_percentile_75(snapshot.ValueAtPercentile(75));
-    snapshot_pb->set_percentile_95(snapshot.ValueAtPercentile(95));
-    snapshot_pb->set_percentile_99(snapshot.ValueAtPercentile(99));
-    snapshot_pb->set_percentile_99_9(snapshot.ValueAtPercentile(99.9));
-    snapshot_pb->set_percentile_99_99(snapshot.ValueAtPercentile(99.99));
-    snapshot_pb->set_max(snapshot.MaxValue());
+    // Reuse the statistics of the last snapshot if no values were recorded
+    // since. The raw values aren't cached, so they always need a snapshot.
+    if (!opts.include_raw_histograms) {
+      std::lock_guard<simple_spinlock> l(snapshot_lock_);
+      if (cached_snapshot_ && cached_snapshot_count_ == total_count) {
+        snapshot_pb->MergeFrom(*cached_snapshot_);
+        return Status::OK();
+      }
+    }
+
+    std::unique_ptr<HdrHistogram> snapshot_ptr = Snapshot();
+    const HdrHistogram& snapshot = *snapshot_ptr;
+    std::unique_ptr<HistogramSnapshotPB> stats(new HistogramSnapshotPB());
+    stats->set_total_count(snapshot.TotalCount());
+    stats->set_total_sum(snapshot.TotalSum());
+    stats->set_min(snapshot.MinValue());
+    stats->set_mean(snapshot.MeanValue());
+    stats->set_percentile_75(snapshot.ValueAtPercentile(75));
+    stats->set_percentile_95(snapshot.ValueAtPercentile(95));
+    stats->set_percentile_99(snapshot.ValueAtPercentile(99));
+    stats->set_percentile_99_9(snapshot.ValueAtPercentile(99.9));
+    stats->set_percentile_99_99(snapshot.ValueAtPercentile(99.99));
+    stats->set_max(snapshot.MaxValue());
+    snapshot_pb->MergeFrom(*stats);
 
     if (opts.include_raw_histograms) {
       RecordedValuesIterator iter(&snapshot);
@@ -706,27 +973,40 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
         snapshot_pb->add_counts(value.count_at_value_iterated_to);
       }
     }
+
+    // The snapshot may include values recorded after 'total_count' was
+    // read, in which case it won't be reused: the count will have moved on.
+    std::lock_guard<simple_spinlock> l(snapshot_lock_);
+    cached_snapshot_count_ = total_count;
+    cached_snapshot_ = std::move(stats);
   }
   return Status::OK();
 }
 
 uint64_t Histogram::CountInBucketForValueForTests(uint64_t value) const {
-  return histogram_->CountInBucketForValue(value);
+  return Snapshot()->CountInBucketForValue(value);
 }
 
 uint64_t Histogram::TotalCount() const {
-  return histogram_->TotalCount();
+  uint64_t total_count = histogram_->TotalCount();
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* shard = shards_[i].load(std::memory_order_acquire);
+    if (shard) {
+      total_count += shard->TotalCount();
+    }
+  }
+  return total_count;
 }
 
 uint64_t Histogram::MinValueForTests() const {
-  return histogram_->MinValue();
+  return Snapshot()->MinValue();
 }
 
 uint64_t Histogram::MaxValueForTests() const {
-  return histogram_->MaxValue();
+  return Snapshot()->MaxValue();
 }
 double Histogram::MeanValueForTests() const {
-  return histogram_->MeanValue();
+  return Snapshot()->MeanValue();
 }
 
 ScopedLatencyMetric::ScopedLatencyMetric(Histogram* latency_hist)
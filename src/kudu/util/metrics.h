@@ -104,6 +104,18 @@
 //                            "Total number of threads started on this server",
 //                            kudu::EXPOSE_AS_COUNTER);
 //
+// Similarly, histograms recorded on hot paths by many threads at once, e.g.
+// RPC queue times, may be defined with the 'SHARDED' flag. The values are then
+// recorded into per-CPU shards of the histogram, merged when it's read, which
+// avoids contending on its buckets at the cost of the memory of the shards:
+//
+// METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
+//                         "RPC Queue Time",
+//                         kudu::MetricUnit::kMicroseconds,
+//                         "Number of microseconds incoming RPC requests spend in the worker queue",
+//                         60000000LU, 3,
+//                         kudu::SHARDED);
+//
 //
 // Metrics ownership
 // ------------------------------------------------------------
@@ -221,15 +233,38 @@
 //      ...
 // ]
 //
+// =================
+// Prometheus output
+// =================
+//
+// Metrics may also be written in the Prometheus text exposition format, which
+// is cheaper to produce and to parse. Each metric is named after its metric
+// prototype with a "kudu_" prefix, and each of its instances is labeled with
+// the type, id and attributes of its entity. Histograms are written as
+// summaries with their percentiles as quantiles, and string gauges are left
+// out, since Prometheus only has numeric values.
+//
+// Example Prometheus output:
+//
+// # HELP kudu_log_reader_bytes_read Number of bytes read since tablet start
+// # TYPE kudu_log_reader_bytes_read counter
+// kudu_log_reader_bytes_read{entity_type="tablet",id="e95e57ba8d4d48458e7c7d35020d4a46",...} 0
+//
 /////////////////////////////////////////////////////
 
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <iosfwd>
 #include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
@@ -285,9 +320,9 @@
   ::kudu::GaugePrototype<double> METRIC_##name(                      \
       ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__))
 
-#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits) \
+#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits, ...) \
   ::kudu::HistogramPrototype METRIC_##name(                                       \
-      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc), \
+      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__), \
     max_val, num_sig_digits)
 
 // The following macros act as forward declarations for entity types and metric prototypes.
@@ -438,6 +473,16 @@ struct MetricJsonOptions {
 
   // Whether to include the attributes of each entity.
   bool include_entity_attributes = true;
+
+  // If not empty, only include the entities of these types (e.g. "tablet").
+  // The entities of other types are skipped without snapshotting their
+  // metrics.
+  std::vector<std::string> entity_types;
+
+  // If not empty, only include the entities with these ids. Unlike the
+  // 'requested_metrics' of MetricRegistry::WriteAsJson(), the ids must match
+  // exactly.
+  std::vector<std::string> entity_ids;
 };
 
 class MetricEntityPrototype {
@@ -494,6 +539,9 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Return true if this entity is selected by the entity filters of 'opts'.
+  bool MatchesEntityFilters(const MetricJsonOptions& opts) const;
+
   const MetricMap& UnsafeMetricsMapForTests() const { return metric_map_; }
 
   // Mark that the given metric should never be retired until the metric
@@ -536,10 +584,23 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
   friend class MetricRegistry;
   friend class RefCountedThreadSafe<MetricEntity>;
 
+  // The metrics of a registry to write in the Prometheus text format, keyed
+  // by metric name. Each instance of a metric is paired with the labels
+  // identifying its entity.
+  typedef std::map<std::string,
+                   std::vector<std::pair<std::string, scoped_refptr<Metric>>>>
+      PrometheusFamilyMap;
+
   MetricEntity(const MetricEntityPrototype* prototype, std::string id,
                AttributeMap attributes);
   ~MetricEntity();
 
+  // Adds the metrics of this entity selected by 'requested_metrics' and
+  // 'opts' to 'families'. See MetricRegistry::WriteAsPrometheus().
+  void CollectForPrometheus(const std::vector<std::string>& requested_metrics,
+                            const MetricJsonOptions& opts,
+                            PrometheusFamilyMap* families) const;
+
   // Ensure that the given metric prototype is allowed to be instantiated
   // within this entity. This entity's type must match the expected entity
   // type defined within the metric prototype.
@@ -571,6 +632,17 @@ class Metric : public RefCountedThreadSafe<Metric> {
   virtual Status WriteAsJson(JsonWriter* writer,
                              const MetricJsonOptions& opts) const = 0;
 
+  // Writes the samples of this metric in the Prometheus text format, as the
+  // metric 'name' with the labels 'labels' (a comma-separated list of
+  // name="value" pairs, without braces).
+  virtual Status WriteAsPrometheus(std::ostream* out,
+                                   const std::string& name,
+                                   const std::string& labels) const = 0;
+
+  // Return true if the value of this metric is numeric, so that it may be
+  // written in the Prometheus text format.
+  virtual bool HasNumericValue() const { return true; }
+
   const MetricPrototype* prototype() const { return prototype_; }
 
   // Return true if this metric has never been touched.
@@ -659,6 +731,13 @@ class MetricRegistry {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Same as WriteAsJson(), but writes the metrics to 'out' in the Prometheus
+  // text exposition format. Only the options filtering the metrics and
+  // 'include_entity_attributes' apply to this format.
+  Status WriteAsPrometheus(std::ostream* out,
+                           const std::vector<std::string>& requested_metrics,
+                           const MetricJsonOptions& opts) const;
+
   // For each registered entity, retires orphaned metrics. If an entity has no more
   // metrics and there are no external references, entities are removed as well.
   //
@@ -723,7 +802,11 @@ class MetricPrototypeRegistry {
 enum PrototypeFlags {
   // Flag which causes a Gauge prototype to expose itself as if it
   // were a counter.
-  EXPOSE_AS_COUNTER = 1 << 0
+  EXPOSE_AS_COUNTER = 1 << 0,
+
+  // Flag which causes a Histogram prototype to record values into per-CPU
+  // shards, merged on read.
+  SHARDED = 1 << 1
 };
 
 class MetricPrototype {
@@ -818,9 +901,16 @@ class Gauge : public Metric {
   virtual ~Gauge() {}
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual Status WriteAsPrometheus(std::ostream* out,
+                                   const std::string& name,
+                                   const std::string& labels) const OVERRIDE;
 
  protected:
   virtual void WriteValue(JsonWriter* writer) const = 0;
+
+  // Writes the value as a Prometheus sample value.
+  // Only called if HasNumericValue().
+  virtual void WriteValue(std::ostream* out) const = 0;
  private:
   DISALLOW_COPY_AND_ASSIGN(Gauge);
 };
@@ -835,9 +925,14 @@ class StringGauge : public Gauge {
   virtual bool IsUntouched() const override {
     return false;
   }
+  virtual bool HasNumericValue() const override {
+    return false;
+  }
 
  protected:
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE;
+  virtual void WriteValue(std::ostream* /* out */) const OVERRIDE {
+  }
  private:
   std::string value_;
   mutable simple_spinlock lock_;  // Guards value_
@@ -879,6 +974,9 @@ class AtomicGauge : public Gauge {
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE {
     writer->Value(value());
   }
+  virtual void WriteValue(std::ostream* out) const OVERRIDE {
+    *out << value();
+  }
   AtomicInt<int64_t> value_;
  private:
   DISALLOW_COPY_AND_ASSIGN(AtomicGauge);
@@ -954,6 +1052,10 @@ class FunctionGauge : public Gauge {
     writer->Value(value());
   }
 
+  virtual void WriteValue(std::ostream* out) const OVERRIDE {
+    *out << value();
+  }
+
   // Reset this FunctionGauge to return a specific value.
   // This should be used during destruction. If you want a settable
   // Gauge, use a normal Gauge instead of a FunctionGauge.
@@ -994,6 +1096,10 @@ class FunctionGauge : public Gauge {
     return false;
   }
 
+  virtual bool HasNumericValue() const override {
+    return std::is_arithmetic<T>::value;
+  }
+
  private:
   friend class MetricEntity;
 
@@ -1040,6 +1146,9 @@ class Counter : public Metric {
   void IncrementBy(int64_t amount);
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual Status WriteAsPrometheus(std::ostream* out,
+                                   const std::string& name,
+                                   const std::string& labels) const OVERRIDE;
 
   virtual bool IsUntouched() const override {
     return value() == 0;
@@ -1064,6 +1173,7 @@ class HistogramPrototype : public MetricPrototype {
 
   uint64_t max_trackable_value() const { return max_trackable_value_; }
   int num_sig_digits() const { return num_sig_digits_; }
+  bool sharded() const { return args_.flags_ & SHARDED; }
   virtual MetricType::Type type() const OVERRIDE { return MetricType::kHistogram; }
 
  private:
@@ -1089,13 +1199,25 @@ class Histogram : public Metric {
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
 
+  // Writes the histogram as a Prometheus summary, with its percentiles as
+  // the quantiles.
+  virtual Status WriteAsPrometheus(std::ostream* out,
+                                   const std::string& name,
+                                   const std::string& labels) const OVERRIDE;
+
   // Returns a snapshot of this histogram including the bucketed values and counts.
   Status GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
                                 const MetricJsonOptions& opts) const;
 
   // Returns a pointer to the underlying histogram. The implementation of HdrHistogram
   // is thread safe.
-  const HdrHistogram* histogram() const { return histogram_.get(); }
+  //
+  // REQUIRES: the histogram isn't sharded. Use Snapshot() otherwise.
+  const HdrHistogram* histogram() const;
+
+  // Returns a (non-consistent) snapshot of the histogram, with the values of
+  // all of its shards.
+  std::unique_ptr<HdrHistogram> Snapshot() const;
 
   uint64_t CountInBucketForValueForTests(uint64_t value) const;
   uint64_t MinValueForTests() const;
@@ -1110,8 +1232,26 @@ class Histogram : public Metric {
   FRIEND_TEST(MetricsTest, SimpleHistogramTest);
   friend class MetricEntity;
   explicit Histogram(const HistogramPrototype* proto);
+  ~Histogram();
+
+  // Returns the shard of the calling CPU, allocating it if needed.
+  HdrHistogram* CurrentShard();
 
   const gscoped_ptr<HdrHistogram> histogram_;
+
+  // For sharded histograms, the shards indexed by CPU, allocated on first
+  // use, and their number. The values are only recorded into the shards.
+  const int num_shards_;
+  std::unique_ptr<std::atomic<HdrHistogram*>[]> shards_;
+
+  // The statistics of the last snapshot of the histogram, and its total count
+  // at the time. They're reused until more values are recorded, since
+  // computing them means copying and scanning all of the buckets. Protected
+  // by 'snapshot_lock_'.
+  mutable simple_spinlock snapshot_lock_;
+  mutable uint64_t cached_snapshot_count_;
+  mutable std::unique_ptr<HistogramSnapshotPB> cached_snapshot_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
@@ -0,0 +1,155 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/mpsc_blocking_queue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+#include "kudu/util/test_macros.h"
+
+using std::thread;
+using std::vector;
+
+namespace kudu {
+
+TEST(MpscBlockingQueueTest, TestDrainInOrder) {
+  MpscBlockingQueue<int32_t> queue(5);
+  ASSERT_TRUE(queue.empty());
+  ASSERT_TRUE(queue.BlockingPut(1));
+  ASSERT_TRUE(queue.BlockingPut(2));
+  ASSERT_TRUE(queue.BlockingPut(3));
+  ASSERT_FALSE(queue.empty());
+
+  vector<int32_t> out = { 0 };
+  ASSERT_OK(queue.BlockingDrainTo(&out, MonoTime::Now()));
+  ASSERT_EQ(vector<int32_t>({ 0, 1, 2, 3 }), out);
+  ASSERT_TRUE(queue.empty());
+
+  Status s = queue.BlockingDrainTo(&out, MonoTime::Now() + MonoDelta::FromMilliseconds(10));
+  ASSERT_TRUE(s.IsTimedOut()) << s.ToString();
+}
+
+TEST(MpscBlockingQueueTest, TestShutdown) {
+  MpscBlockingQueue<int32_t> queue(5);
+  ASSERT_TRUE(queue.BlockingPut(1));
+  queue.Shutdown();
+  ASSERT_FALSE(queue.BlockingPut(2));
+
+  // Elements put before the shutdown still drain out.
+  vector<int32_t> out;
+  ASSERT_OK(queue.BlockingDrainTo(&out));
+  ASSERT_EQ(vector<int32_t>({ 1 }), out);
+  ASSERT_TRUE(queue.BlockingDrainTo(&out).IsAborted());
+}
+
+// Test that a consumer parked on an empty queue is woken up by a producer
+// and by a shutdown.
+TEST(MpscBlockingQueueTest, TestWakeParkedConsumer) {
+  MpscBlockingQueue<int32_t> queue(5);
+  vector<int32_t> out;
+  Status drain_status;
+  thread consumer([&]() {
+    drain_status = queue.BlockingDrainTo(&out);
+  });
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  ASSERT_TRUE(queue.BlockingPut(1));
+  consumer.join();
+  ASSERT_OK(drain_status);
+  ASSERT_EQ(vector<int32_t>({ 1 }), out);
+
+  consumer = thread([&]() {
+    drain_status = queue.BlockingDrainTo(&out);
+  });
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  queue.Shutdown();
+  consumer.join();
+  ASSERT_TRUE(drain_status.IsAborted()) << drain_status.ToString();
+}
+
+struct LengthLogicalSize {
+  static size_t logical_size(const vector<int>& v) {
+    return v.size();
+  }
+};
+
+// Test that producers block while the queue is at its maximum size, which
+// counts the logical size of the elements.
+TEST(MpscBlockingQueueTest, TestBlockWhenFull) {
+  MpscBlockingQueue<vector<int>, LengthLogicalSize> queue(4);
+  ASSERT_TRUE(queue.BlockingPut(vector<int>(4, 0)));
+
+  CountDownLatch put_latch(1);
+  thread producer([&]() {
+    CHECK(queue.BlockingPut(vector<int>(1, 1)));
+    put_latch.CountDown();
+  });
+  ASSERT_FALSE(put_latch.WaitFor(MonoDelta::FromMilliseconds(50)));
+
+  vector<vector<int>> out;
+  ASSERT_OK(queue.BlockingDrainTo(&out));
+  put_latch.Wait();
+  producer.join();
+  ASSERT_OK(queue.BlockingDrainTo(&out));
+  ASSERT_EQ(2, out.size());
+  ASSERT_EQ(vector<int>(1, 1), out[1]);
+}
+
+// Test that each producer's elements come out in the order they were put
+// when many producers race with the consumer.
+TEST(MpscBlockingQueueTest, TestMultipleProducers) {
+  const int kNumProducers = 8;
+  const int kNumPerProducer = 10000;
+  MpscBlockingQueue<int64_t> queue(16);
+
+  vector<thread> producers;
+  for (int p = 0; p < kNumProducers; p++) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < kNumPerProducer; i++) {
+        CHECK(queue.BlockingPut(static_cast<int64_t>(p) << 32 | i));
+      }
+    });
+  }
+
+  vector<int64_t> last(kNumProducers, -1);
+  int64_t num_drained = 0;
+  while (num_drained < kNumProducers * kNumPerProducer) {
+    vector<int64_t> out;
+    ASSERT_OK(queue.BlockingDrainTo(&out));
+    for (int64_t v : out) {
+      int p = v >> 32;
+      int64_t i = v & 0xffffffff;
+      ASSERT_EQ(last[p] + 1, i);
+      last[p] = i;
+    }
+    num_drained += out.size();
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  ASSERT_TRUE(queue.empty());
+}
+
+} // namespace kudu
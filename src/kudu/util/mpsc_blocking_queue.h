@@ -0,0 +1,246 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/blocking_queue.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// A multi-producer, single-consumer variant of BlockingQueue.
+//
+// Producers push onto a lock-free stack, which the consumer takes whole and
+// reverses, so that neither takes a lock while the queue is neither empty
+// nor full. A mutex and condition variable are only used to park the
+// consumer when the queue is empty, and producers when it's full, and only
+// touched by the other side if somebody is actually parked.
+//
+// As with BlockingQueue, the size of the queue is the sum of the logical
+// sizes of its elements. Producers which find the queue below 'max_size'
+// go ahead without coordinating with each other, so the queue may exceed
+// 'max_size' by up to one element per concurrent producer.
+//
+// Any number of threads may put elements concurrently, but at most one
+// thread may get elements at any given time.
+template <typename T, class LOGICAL_SIZE = DefaultLogicalSize>
+class MpscBlockingQueue {
+ public:
+  explicit MpscBlockingQueue(size_t max_size)
+      : max_size_(max_size),
+        head_(0),
+        size_(0),
+        consumer_parked_(false),
+        producers_parked_(0),
+        not_empty_(&park_lock_),
+        not_full_(&park_lock_) {
+  }
+
+  // If the queue holds a bare pointer, it must be empty on destruction, since
+  // it may have ownership of the pointer.
+  ~MpscBlockingQueue() {
+    Node* node = reinterpret_cast<Node*>(head_.load() & ~kShutdownBit);
+    DCHECK(node == nullptr || !std::is_pointer<T>::value)
+        << "MpscBlockingQueue holds bare pointers at destruction time";
+    while (node) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  // Puts the given value in the queue. If the queue is full, blocks until
+  // space becomes available. Returns false if the queue was shut down prior
+  // to enqueueing the element.
+  bool BlockingPut(const T& val) {
+    if (PREDICT_FALSE(size_.load() >= max_size_) && !WaitForSpace()) {
+      return false;
+    }
+
+    size_t size = LOGICAL_SIZE::logical_size(val);
+    Node* node = new Node{ val, nullptr };
+    size_.fetch_add(size);
+    uintptr_t old_head = head_.load();
+    do {
+      if (PREDICT_FALSE(old_head & kShutdownBit)) {
+        size_.fetch_sub(size);
+        delete node;
+        return false;
+      }
+      node->next = reinterpret_cast<Node*>(old_head);
+    } while (!head_.compare_exchange_weak(old_head, reinterpret_cast<uintptr_t>(node)));
+
+    // Pairs with the consumer publishing 'consumer_parked_' before checking
+    // whether the queue is empty: either the consumer sees the new element or
+    // we see that it's parked.
+    if (consumer_parked_.load()) {
+      MutexLock l(park_lock_);
+      not_empty_.Signal();
+    }
+    return true;
+  }
+
+  // Gets all elements from the queue, in the order they were put, and
+  // appends them to 'out'.
+  //
+  // If 'deadline' passes and no elements have been returned from the
+  // queue, returns Status::TimedOut(). If 'deadline' is uninitialized,
+  // no deadline is used.
+  //
+  // If the queue has been shut down, but there are still elements waiting,
+  // then it returns those elements as if the queue were not yet shut down.
+  //
+  // Returns:
+  // - OK if successful
+  // - TimedOut if the deadline passed
+  // - Aborted if the queue shut down
+  Status BlockingDrainTo(std::vector<T>* out, MonoTime deadline = MonoTime()) {
+    while (true) {
+      // Take the whole stack, leaving the shutdown bit in place. Only the
+      // consumer removes elements, so the stack can't become empty meanwhile.
+      uintptr_t old_head = head_.load();
+      if (old_head & ~kShutdownBit) {
+        while (!head_.compare_exchange_weak(old_head, old_head & kShutdownBit)) {}
+      }
+      Node* node = reinterpret_cast<Node*>(old_head & ~kShutdownBit);
+      if (node) {
+        // The stack is newest first.
+        size_t old_size = out->size();
+        size_t size = 0;
+        while (node) {
+          out->push_back(node->val);
+          size += LOGICAL_SIZE::logical_size(node->val);
+          Node* next = node->next;
+          delete node;
+          node = next;
+        }
+        std::reverse(out->begin() + old_size, out->end());
+        size_.fetch_sub(size);
+
+        // Pairs with the producers publishing 'producers_parked_' before
+        // checking whether the queue is full.
+        if (producers_parked_.load() > 0) {
+          MutexLock l(park_lock_);
+          not_full_.Broadcast();
+        }
+        return Status::OK();
+      }
+      if (PREDICT_FALSE(old_head & kShutdownBit)) {
+        return Status::Aborted("");
+      }
+
+      MutexLock l(park_lock_);
+      consumer_parked_.store(true);
+      bool timed_out = false;
+      if (head_.load() == 0) {
+        if (!deadline.Initialized()) {
+          not_empty_.Wait();
+        } else {
+          timed_out = !not_empty_.WaitUntil(deadline);
+        }
+      }
+      consumer_parked_.store(false);
+      if (PREDICT_FALSE(timed_out) && head_.load() == 0) {
+        return Status::TimedOut("");
+      }
+    }
+  }
+
+  // Shut down the queue.
+  // When a queue is shut down, no more elements can be added to it, and
+  // BlockingPut() will return false.
+  // Existing elements will drain out of it, and then BlockingDrainTo() will
+  // start returning Status::Aborted().
+  void Shutdown() {
+    head_.fetch_or(kShutdownBit);
+    MutexLock l(park_lock_);
+    not_empty_.Broadcast();
+    not_full_.Broadcast();
+  }
+
+  bool empty() const {
+    return (head_.load() & ~kShutdownBit) == 0;
+  }
+
+  size_t max_size() const {
+    return max_size_;
+  }
+
+  // The logical size of the elements in the queue, which may be stale by the
+  // time it's returned.
+  size_t size() const {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Node {
+    T val;
+    Node* next;
+  };
+
+  // Set in 'head_' once the queue is shut down. Nodes are at least word
+  // aligned, so the lowest bit of their address is always free.
+  static constexpr uintptr_t kShutdownBit = 1;
+
+  // Waits until the queue is below its maximum size. Returns false if the
+  // queue was shut down first.
+  bool WaitForSpace() {
+    MutexLock l(park_lock_);
+    producers_parked_.fetch_add(1);
+    while (size_.load() >= max_size_ && !(head_.load() & kShutdownBit)) {
+      not_full_.Wait();
+    }
+    producers_parked_.fetch_sub(1);
+    return !(head_.load() & kShutdownBit);
+  }
+
+  const size_t max_size_;
+
+  // The most recently put element, the head of a linked stack of the
+  // elements in the queue, with kShutdownBit set once shut down.
+  std::atomic<uintptr_t> head_;
+
+  // The sum of the logical sizes of the elements in the queue.
+  std::atomic<size_t> size_;
+
+  // Whether the consumer is, or is about to be, waiting on 'not_empty_'.
+  std::atomic<bool> consumer_parked_;
+
+  // The number of producers waiting, or about to wait, on 'not_full_'.
+  std::atomic<int> producers_parked_;
+
+  Mutex park_lock_;
+  ConditionVariable not_empty_;
+  ConditionVariable not_full_;
+
+  DISALLOW_COPY_AND_ASSIGN(MpscBlockingQueue);
+};
+
+} // namespace kudu
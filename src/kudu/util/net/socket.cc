@@ -18,6 +18,9 @@
 #include "kudu/util/net/socket.h"
 
 #include <fcntl.h>
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#endif
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
@@ -178,6 +181,37 @@ Status Socket::SetTcpCork(bool enabled) {
   return Status::OK();
 }
 
+Status Socket::SetBusyPoll(int usec) {
+  DCHECK_GE(usec, 0);
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+  RETURN_NOT_OK_PREPEND(SetSockOpt(SOL_SOCKET, SO_BUSY_POLL, usec),
+                        "failed to set SO_BUSY_POLL");
+  return Status::OK();
+#else
+  return Status::NotSupported("SO_BUSY_POLL is not supported on this platform");
+#endif
+}
+
+Status Socket::SetZeroCopy(bool enabled) {
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  int flag = enabled ? 1 : 0;
+  RETURN_NOT_OK_PREPEND(SetSockOpt(SOL_SOCKET, SO_ZEROCOPY, flag),
+                        "failed to set SO_ZEROCOPY");
+  return Status::OK();
+#else
+  return Status::NotSupported("SO_ZEROCOPY is not supported on this platform");
+#endif
+}
+
+Status Socket::SetLinger(bool enabled, int timeout_secs) {
+  struct linger l;
+  l.l_onoff = enabled ? 1 : 0;
+  l.l_linger = timeout_secs;
+  RETURN_NOT_OK_PREPEND(SetSockOpt(SOL_SOCKET, SO_LINGER, l),
+                        "failed to set SO_LINGER");
+  return Status::OK();
+}
+
 Status Socket::SetNonBlocking(bool enabled) {
   int curflags = ::fcntl(fd_, F_GETFL, 0);
   if (curflags == -1) {
@@ -394,6 +428,25 @@ Status Socket::Connect(const Sockaddr &remote) {
   return Status::OK();
 }
 
+Status Socket::GetIncomingCpu(int* cpu) const {
+#if defined(__linux__) && defined(SO_INCOMING_CPU)
+  int val = -1;
+  socklen_t val_len = sizeof(val);
+  DCHECK_GE(fd_, 0);
+  if (::getsockopt(fd_, SOL_SOCKET, SO_INCOMING_CPU, &val, &val_len) != 0) {
+    int err = errno;
+    return Status::NetworkError("getsockopt(SO_INCOMING_CPU) failed", ErrnoToString(err), err);
+  }
+  if (val < 0) {
+    return Status::NotFound("incoming CPU not known");
+  }
+  *cpu = val;
+  return Status::OK();
+#else
+  return Status::NotSupported("SO_INCOMING_CPU is not supported on this platform");
+#endif
+}
+
 Status Socket::GetSockError() const {
   int val = 0, ret;
   socklen_t val_len = sizeof(val);
@@ -451,6 +504,77 @@ Status Socket::Writev(const struct ::iovec *iov, int iov_len,
   return Status::OK();
 }
 
+Status Socket::WritevZeroCopy(const struct ::iovec *iov, int iov_len,
+                              int64_t *nwritten) {
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  if (PREDICT_FALSE(iov_len <= 0)) {
+    return Status::NetworkError(
+                StringPrintf("writev: invalid io vector length of %d",
+                             iov_len),
+                Slice(), EINVAL);
+  }
+  DCHECK_GE(fd_, 0);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(struct msghdr));
+  msg.msg_iov = const_cast<iovec *>(iov);
+  msg.msg_iovlen = iov_len;
+  ssize_t res;
+  RETRY_ON_EINTR(res, ::sendmsg(fd_, &msg, MSG_NOSIGNAL | MSG_ZEROCOPY));
+  if (PREDICT_FALSE(res < 0)) {
+    int err = errno;
+    return Status::NetworkError("sendmsg error", ErrnoToString(err), err);
+  }
+
+  *nwritten = res;
+  return Status::OK();
+#else
+  return Status::NotSupported("MSG_ZEROCOPY is not supported on this platform");
+#endif
+}
+
+Status Socket::ReadZeroCopyCompletions(
+    const std::function<void(uint32_t first, uint32_t last, bool copied)>& callback) {
+#if defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+  DCHECK_GE(fd_, 0);
+  while (true) {
+    // Enough room for a few notifications, which read one per call anyway.
+    uint8_t control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t res;
+    RETRY_ON_EINTR(res, ::recvmsg(fd_, &msg, MSG_ERRQUEUE));
+    if (res < 0) {
+      int err = errno;
+      if (err == EAGAIN || err == EWOULDBLOCK) {
+        // The error queue is drained.
+        return Status::OK();
+      }
+      return Status::NetworkError("recvmsg error", ErrnoToString(err), err);
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      const auto* serr = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      if (PREDICT_FALSE(serr->ee_errno != 0)) {
+        return Status::NetworkError("zero-copy send error",
+                                    ErrnoToString(serr->ee_errno), serr->ee_errno);
+      }
+      callback(serr->ee_info, serr->ee_data, serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+    }
+  }
+#else
+  return Status::NotSupported("MSG_ZEROCOPY is not supported on this platform");
+#endif
+}
+
 // Mostly follows writen() from Stevens (2004) or Kerrisk (2010).
 Status Socket::BlockingWrite(const uint8_t *buf, size_t buflen, size_t *nwritten,
     const MonoTime& deadline) {
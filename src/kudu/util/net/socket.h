@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/util/status.h"
@@ -72,6 +73,20 @@ class Socket {
   // Set or clear TCP_CORK
   Status SetTcpCork(bool enabled);
 
+  // Set SO_BUSY_POLL, the number of microseconds the kernel busy-polls the
+  // device queue for this socket on blocking reads and polls when there is no
+  // data. 0 disables busy polling. Not supported on every platform.
+  Status SetBusyPoll(int usec);
+
+  // Set or clear SO_ZEROCOPY, which WritevZeroCopy() requires. Returns
+  // Status::NotSupported() on platforms and kernels which lack it, and for
+  // sockets which can't send the memory of the caller as is, e.g. TLS sockets.
+  virtual Status SetZeroCopy(bool enabled);
+
+  // Set SO_LINGER. With 'enabled' and a 'timeout_secs' of 0, closing the
+  // socket resets the connection and discards the data not sent yet.
+  Status SetLinger(bool enabled, int timeout_secs);
+
   // Set or clear O_NONBLOCK
   Status SetNonBlocking(bool enabled);
   Status IsNonBlocking(bool* is_nonblock) const;
@@ -125,6 +140,12 @@ class Socket {
   // get the error status using getsockopt(2)
   Status GetSockError() const;
 
+  // Set 'cpu' to the CPU which processed the last packets received on this
+  // socket, using the SO_INCOMING_CPU socket option. Returns
+  // Status::NotSupported() on platforms which lack the option, and
+  // Status::NotFound() if the CPU is not known yet.
+  Status GetIncomingCpu(int* cpu) const;
+
   // Write up to 'amt' bytes from 'buf' to the socket. The number of bytes
   // actually written will be stored in 'nwritten'. If an error is returned,
   // the value of 'nwritten' is undefined.
@@ -136,6 +157,20 @@ class Socket {
   // bytes must be retried. See writev(2) for more information.
   virtual Status Writev(const struct ::iovec *iov, int iov_len, int64_t *nwritten);
 
+  // Like Writev(), but with MSG_ZEROCOPY: the kernel sends the data right from
+  // the memory of 'iov', which must then remain unchanged until the send is
+  // reported complete by ReadZeroCopyCompletions(). The kernel numbers the
+  // calls which send some data in order, starting at 0. Requires a successful
+  // SetZeroCopy(true).
+  Status WritevZeroCopy(const struct ::iovec *iov, int iov_len, int64_t *nwritten);
+
+  // Reads the notifications of the zero-copy sends completed by the kernel,
+  // calling 'callback' with the numbers of the first and last sends of each
+  // range of completed sends, and whether the kernel ended up copying their
+  // data, e.g. because the device doesn't support sending from user memory.
+  Status ReadZeroCopyCompletions(
+      const std::function<void(uint32_t first, uint32_t last, bool copied)>& callback);
+
   // Blocking Write call, returns IOError unless full buffer is sent.
   // Underlying Socket expected to be in blocking mode. Fails if any Write() sends 0 bytes.
   // Returns OK if buflen bytes were sent, otherwise IOError.
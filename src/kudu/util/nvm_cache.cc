@@ -11,8 +11,15 @@
 // malloc/free, but allocates from persistent memory instead of DRAM.
 //
 // We use this API to implement a cache which treats persistent memory or
-// non-volatile memory as if it were a larger cheaper bank of volatile memory. We
-// currently make no use of its persistence properties.
+// non-volatile memory as if it were a larger cheaper bank of volatile memory.
+//
+// libvmem pools don't survive the process, so to make the cache warm after a
+// restart, a persistent cache (see --nvm_cache_persistent) saves its entries
+// to a file next to the pool when asked to, and loads them back on creation.
+// The file is replaced atomically and every entry in it is checksummed, so a
+// crash leaves the previously saved entries usable. It's up to the user of the
+// cache to erase the restored entries which went stale while the cache was
+// down, see Cache::ValidateRestoredEntries().
 //
 // Currently, we only store key/value in NVM. All other data structures such as the
 // ShardedLRUCache instances, hash table, etc are in DRAM. The assumption is that
@@ -20,9 +27,12 @@
 
 #include "kudu/util/nvm_cache.h"
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -43,10 +53,17 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/cache_metrics.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/crc.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/status.h"
 
 DEFINE_string(nvm_cache_path, "/vmem",
               "The path at which the NVM cache will try to allocate its memory. "
@@ -65,6 +82,11 @@ DEFINE_bool(nvm_cache_simulate_allocation_failure, false,
             "for testing.");
 TAG_FLAG(nvm_cache_simulate_allocation_failure, unsafe);
 
+DEFINE_bool(nvm_cache_persistent, false,
+            "If true, the entries of the NVM cache are saved to a file under "
+            "--nvm_cache_path on shutdown, and loaded back into the cache on "
+            "startup, so that the cache is warm after a restart.");
+TAG_FLAG(nvm_cache_persistent, experimental);
 
 namespace kudu {
 
@@ -72,6 +94,7 @@ namespace {
 
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::vector;
 
 typedef simple_spinlock MutexType;
@@ -90,6 +113,7 @@ struct LRUHandle {
   uint32_t val_length;
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  bool restored;      // Restored from a previous process, and not validated yet
   uint8_t* kv_data;
 
   Slice key() const {
@@ -210,6 +234,14 @@ class NvmLRUCache {
   void Erase(const Slice& key, uint32_t hash);
   void* AllocateAndRetry(size_t size);
 
+  // Appends the entries of the shard to 'entries', from the least recently
+  // used one. Each entry is referenced, and must be released.
+  void GetEntries(vector<LRUHandle*>* entries);
+
+  // Erases the restored entries whose key 'is_valid' returns false for, and
+  // marks the other ones as validated. Returns the number of erased entries.
+  int ValidateRestoredEntries(const std::function<bool(const Slice&)>& is_valid);
+
  private:
   void NvmLRU_Remove(LRUHandle* e);
   void NvmLRU_Append(LRUHandle* e);
@@ -456,15 +488,95 @@ void NvmLRUCache::Erase(const Slice& key, uint32_t hash) {
     FreeEntry(e);
   }
 }
+
+void NvmLRUCache::GetEntries(vector<LRUHandle*>* entries) {
+  std::lock_guard<MutexType> l(mutex_);
+  for (LRUHandle* e = lru_.next; e != &lru_; e = e->next) {
+    base::RefCountInc(&e->refs);
+    entries->push_back(e);
+  }
+}
+
+int NvmLRUCache::ValidateRestoredEntries(
+    const std::function<bool(const Slice&)>& is_valid) {
+  LRUHandle* to_remove_head = NULL;
+  int num_erased = 0;
+  {
+    std::lock_guard<MutexType> l(mutex_);
+    for (LRUHandle* e = lru_.next; e != &lru_; ) {
+      LRUHandle* next = e->next;
+      if (e->restored) {
+        e->restored = false;
+        if (!is_valid(e->key())) {
+          NvmLRU_Remove(e);
+          table_.Remove(e->key(), e->hash);
+          if (Unref(e)) {
+            e->next = to_remove_head;
+            to_remove_head = e;
+          }
+          num_erased++;
+        }
+      }
+      e = next;
+    }
+  }
+  FreeLRUEntries(to_remove_head);
+  return num_erased;
+}
+
 static const int kNumShardBits = 4;
 static const int kNumShards = 1 << kNumShardBits;
 
+// The file a persistent cache saves its entries to is made of a header,
+// followed by a record per entry, from the least recently used one of each
+// shard:
+//
+//   header: kPersistedMagic, kPersistedVersion (fixed32)
+//   record: key length (fixed32), value length (fixed32), charge (fixed32),
+//           key, value, CRC32C of all that (fixed32)
+//
+// As the shard of an entry only depends on its key, restoring the records in
+// order restores the LRU order of each shard.
+static const char kPersistedMagic[] = "kudunvmc";
+static const size_t kPersistedMagicLength = sizeof(kPersistedMagic) - 1;
+static const uint32_t kPersistedVersion = 1;
+static const size_t kRecordHeaderSize = 3 * sizeof(uint32_t);
+
+// Keys are short: this only protects against allocating a huge buffer for
+// the key of a corrupt record.
+static const uint32_t kMaxPersistedKeyLength = 64 * 1024;
+
+// Reads exactly 'len' bytes of 'file' into 'buf'.
+Status ReadFully(SequentialFile* file, uint8_t* buf, size_t len) {
+  Slice s(buf, len);
+  RETURN_NOT_OK(file->Read(&s));
+  if (PREDICT_FALSE(s.size() != len)) {
+    return Status::Corruption("truncated file", file->filename());
+  }
+  if (s.data() != buf) {
+    memmove(buf, s.data(), len);
+  }
+  return Status::OK();
+}
+
+uint32_t RecordChecksum(const uint8_t* header, const Slice& key, const Slice& value) {
+  uint32_t crc = crc::Crc32c(header, kRecordHeaderSize);
+  crc = crc::Crc32c(key.data(), key.size(), crc);
+  return crc::Crc32c(value.data(), value.size(), crc);
+}
+
 class ShardedLRUCache : public Cache {
  private:
   gscoped_ptr<CacheMetrics> metrics_;
   vector<NvmLRUCache*> shards_;
   VMEM* vmp_;
 
+  // The id of the cache, naming the file its entries are saved to.
+  const string id_;
+
+  // Whether some restored entries haven't been validated yet.
+  std::atomic<bool> has_unvalidated_entries_;
+
   static inline uint32_t HashSlice(const Slice& s) {
     return util_hash::CityHash64(
       reinterpret_cast<const char *>(s.data()), s.size());
@@ -474,9 +586,16 @@ class ShardedLRUCache : public Cache {
     return hash >> (32 - kNumShardBits);
   }
 
+  // The file the entries of the cache are saved to.
+  string PersistedPath() const {
+    return JoinPathSegments(FLAGS_nvm_cache_path, id_ + ".cache");
+  }
+
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& /*id*/, VMEM* vmp)
-        : vmp_(vmp) {
+  explicit ShardedLRUCache(size_t capacity, const string& id, VMEM* vmp)
+        : vmp_(vmp),
+          id_(id),
+          has_unvalidated_entries_(false) {
 
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
@@ -544,6 +663,7 @@ class ShardedLRUCache : public Cache {
         handle->charge = (charge == kAutomaticCharge) ?
             vmem_malloc_usable_size(vmp_, buf) : charge;
         handle->hash = HashSlice(key);
+        handle->restored = false;
         memcpy(handle->kv_data, key.data(), key.size());
         return reinterpret_cast<PendingHandle*>(handle);
       }
@@ -555,8 +675,155 @@ class ShardedLRUCache : public Cache {
   virtual void Free(PendingHandle* ph) OVERRIDE {
     vmem_free(vmp_, ph);
   }
+
+  virtual Status Persist() OVERRIDE;
+
+  virtual bool HasUnvalidatedEntries() const OVERRIDE {
+    return has_unvalidated_entries_;
+  }
+
+  virtual void ValidateRestoredEntries(
+      const std::function<bool(const Slice& key)>& is_valid) OVERRIDE;
+
+  // Loads the entries saved by a previous process, if any, up to the first
+  // corrupt one or the first one which doesn't fit in the pool.
+  Status Restore();
 };
 
+Status ShardedLRUCache::Persist() {
+  if (!FLAGS_nvm_cache_persistent) {
+    return Status::OK();
+  }
+
+  // The entries are written out of the shard locks, so that the cache keeps
+  // serving lookups meanwhile.
+  vector<LRUHandle*> entries;
+  for (NvmLRUCache* shard : shards_) {
+    shard->GetEntries(&entries);
+  }
+  SCOPED_CLEANUP({
+    for (LRUHandle* e : entries) {
+      Release(reinterpret_cast<Handle*>(e));
+    }
+  });
+
+  Env* env = Env::Default();
+  const string path = PersistedPath();
+  const string tmp_template = path + kTmpInfix + ".XXXXXX";
+  string tmp_path;
+  unique_ptr<WritableFile> file;
+  RETURN_NOT_OK(env->NewTempWritableFile(WritableFileOptions(), tmp_template, &tmp_path, &file));
+  auto tmp_deleter = MakeScopedCleanup([&]() {
+    WARN_NOT_OK(env->DeleteFile(tmp_path), "Could not delete file " + tmp_path);
+  });
+
+  faststring header;
+  header.append(kPersistedMagic, kPersistedMagicLength);
+  PutFixed32(&header, kPersistedVersion);
+  RETURN_NOT_OK(file->Append(Slice(header)));
+  for (LRUHandle* e : entries) {
+    uint8_t record_header[kRecordHeaderSize];
+    EncodeFixed32(record_header, e->key_length);
+    EncodeFixed32(record_header + 4, e->val_length);
+    EncodeFixed32(record_header + 8, e->charge);
+    uint8_t crc[sizeof(uint32_t)];
+    EncodeFixed32(crc, RecordChecksum(record_header, e->key(), e->value()));
+    Slice record[] = { Slice(record_header, kRecordHeaderSize), e->key(), e->value(),
+                       Slice(crc, sizeof(crc)) };
+    RETURN_NOT_OK(file->AppendV(record));
+  }
+  RETURN_NOT_OK(file->Sync());
+  RETURN_NOT_OK(file->Close());
+
+  RETURN_NOT_OK_PREPEND(env->RenameFile(tmp_path, path), "Failed to rename tmp file to " + path);
+  tmp_deleter.cancel();
+  RETURN_NOT_OK_PREPEND(env->SyncDir(DirName(path)), "Failed to SyncDir() parent of " + path);
+  LOG(INFO) << "Saved " << entries.size() << " NVM cache entries to " << path;
+  return Status::OK();
+}
+
+void ShardedLRUCache::ValidateRestoredEntries(
+    const std::function<bool(const Slice& key)>& is_valid) {
+  if (!has_unvalidated_entries_.exchange(false)) {
+    return;
+  }
+  int num_erased = 0;
+  for (NvmLRUCache* shard : shards_) {
+    num_erased += shard->ValidateRestoredEntries(is_valid);
+  }
+  LOG(INFO) << "Erased " << num_erased << " stale NVM cache entries";
+}
+
+Status ShardedLRUCache::Restore() {
+  Env* env = Env::Default();
+  const string path = PersistedPath();
+  if (!env->FileExists(path)) {
+    return Status::OK();
+  }
+  unique_ptr<SequentialFile> file;
+  RETURN_NOT_OK(env->NewSequentialFile(path, &file));
+
+  uint8_t header[kPersistedMagicLength + sizeof(uint32_t)];
+  RETURN_NOT_OK(ReadFully(file.get(), header, sizeof(header)));
+  if (memcmp(header, kPersistedMagic, kPersistedMagicLength) != 0 ||
+      DecodeFixed32(header + kPersistedMagicLength) != kPersistedVersion) {
+    return Status::Corruption("not a saved NVM cache", path);
+  }
+
+  int64_t num_restored = 0;
+  SCOPED_CLEANUP({
+    if (num_restored > 0) {
+      has_unvalidated_entries_ = true;
+    }
+    LOG(INFO) << "Restored " << num_restored << " NVM cache entries from " << path;
+  });
+  faststring key;
+  while (true) {
+    uint8_t record_header[kRecordHeaderSize];
+    Slice s(record_header, kRecordHeaderSize);
+    RETURN_NOT_OK(file->Read(&s));
+    if (s.empty()) {
+      return Status::OK();
+    }
+    if (s.data() != record_header) {
+      memmove(record_header, s.data(), s.size());
+    }
+    if (PREDICT_FALSE(s.size() != kRecordHeaderSize)) {
+      return Status::Corruption("truncated file", path);
+    }
+    const uint32_t key_len = DecodeFixed32(record_header);
+    const uint32_t val_len = DecodeFixed32(record_header + 4);
+    const uint32_t charge = DecodeFixed32(record_header + 8);
+    if (PREDICT_FALSE(key_len > kMaxPersistedKeyLength ||
+                      val_len > std::numeric_limits<int>::max() ||
+                      charge > std::numeric_limits<int>::max())) {
+      return Status::Corruption("invalid record", path);
+    }
+    key.resize(key_len);
+    RETURN_NOT_OK(ReadFully(file.get(), key.data(), key_len));
+
+    PendingHandle* ph = Allocate(Slice(key), val_len, charge);
+    if (ph == nullptr) {
+      // The pool is smaller than the one of the previous process: the
+      // entries left are the most recently used ones of some shards, but
+      // there is no room for them anymore.
+      return Status::OK();
+    }
+    auto ph_deleter = MakeScopedCleanup([&]() { Free(ph); });
+    RETURN_NOT_OK(ReadFully(file.get(), MutableValue(ph), val_len));
+    uint8_t crc[sizeof(uint32_t)];
+    RETURN_NOT_OK(ReadFully(file.get(), crc, sizeof(crc)));
+    if (PREDICT_FALSE(DecodeFixed32(crc) !=
+                      RecordChecksum(record_header, Slice(key), Slice(MutableValue(ph), val_len)))) {
+      return Status::Corruption("checksum mismatch", path);
+    }
+    ph_deleter.cancel();
+    reinterpret_cast<LRUHandle*>(ph)->restored = true;
+    Release(Insert(ph, nullptr));
+    num_restored++;
+  }
+}
+
 } // end anonymous namespace
 
 Cache* NewLRUNvmCache(size_t capacity, const std::string& id) {
@@ -571,7 +838,13 @@ Cache* NewLRUNvmCache(size_t capacity, const std::string& id) {
   PLOG_IF(FATAL, vmp == NULL) << "Could not initialize NVM cache library in path "
                               << FLAGS_nvm_cache_path.c_str();
 
-  return new ShardedLRUCache(capacity, id, vmp);
+  ShardedLRUCache* cache = new ShardedLRUCache(capacity, id, vmp);
+  if (FLAGS_nvm_cache_persistent) {
+    // The entries restored before an error are intact, so the cache is
+    // usable either way.
+    WARN_NOT_OK(cache->Restore(), "Could not restore the NVM cache entries");
+  }
+  return cache;
 }
 
 }  // namespace kudu
@@ -20,6 +20,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -27,6 +28,7 @@
 #include "kudu/util/test_macros.h"
 
 using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -59,4 +61,43 @@ TEST(OsUtilTest, TestSelfNameWithParens) {
   RunTest("a(b(c((d))e)", 111, 222, 333);
 }
 
+TEST(OsUtilTest, TestParseCpuList) {
+  vector<int> cpus;
+  ASSERT_OK(ParseCpuList("0-3,8,10-11\n", &cpus));
+  ASSERT_EQ(vector<int>({ 0, 1, 2, 3, 8, 10, 11 }), cpus);
+  ASSERT_OK(ParseCpuList("5,1-2,2", &cpus));
+  ASSERT_EQ(vector<int>({ 1, 2, 5 }), cpus);
+  ASSERT_OK(ParseCpuList("", &cpus));
+  ASSERT_TRUE(cpus.empty());
+
+  ASSERT_TRUE(ParseCpuList("3-1", &cpus).IsInvalidArgument());
+  ASSERT_TRUE(ParseCpuList("a", &cpus).IsInvalidArgument());
+  ASSERT_TRUE(ParseCpuList("-2", &cpus).IsInvalidArgument());
+}
+
+#if defined(__linux__)
+TEST(OsUtilTest, TestCpuAffinity) {
+  int cpu = GetCurrentCpu();
+  ASSERT_GE(cpu, 0);
+  vector<int> node_cpus;
+  ASSERT_OK(GetNumaNodeCpus(cpu, &node_cpus));
+  ASSERT_FALSE(node_cpus.empty());
+  ASSERT_OK(SetCurrentThreadCpuAffinity({ cpu }));
+  ASSERT_EQ(cpu, GetCurrentCpu());
+}
+
+TEST(OsUtilTest, TestNumaNodes) {
+  vector<vector<int>> nodes;
+  ASSERT_OK(GetNumaNodes(&nodes));
+  ASSERT_FALSE(nodes.empty());
+  // Every node's CPUs are exactly those GetNumaNodeCpus() reports for them.
+  for (const auto& node_cpus : nodes) {
+    ASSERT_FALSE(node_cpus.empty());
+    vector<int> cpus;
+    ASSERT_OK(GetNumaNodeCpus(node_cpus[0], &cpus));
+    ASSERT_EQ(node_cpus, cpus);
+  }
+}
+#endif
+
 } // namespace kudu
@@ -25,9 +25,12 @@
 #include "kudu/util/os-util.h"
 
 #include <fcntl.h>
+#include <sched.h>
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <ostream>
 #include <string>
@@ -37,12 +40,14 @@
 #include <glog/logging.h>
 
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/util/env.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/status.h"
@@ -173,4 +178,118 @@ bool IsBeingDebugged() {
 #endif // __linux__
 }
 
+Status ParseCpuList(const string& cpulist, vector<int>* cpus) {
+  vector<int> parsed;
+  for (StringPiece range : Split(cpulist, ",", strings::SkipWhitespace())) {
+    std::pair<StringPiece, StringPiece> bounds = Split(range, "-");
+    int32_t first;
+    int32_t last;
+    if (!safe_strto32(bounds.first.data(), bounds.first.size(), &first) || first < 0) {
+      return Status::InvalidArgument("invalid CPU list", cpulist);
+    }
+    last = first;
+    if (!bounds.second.empty() &&
+        !safe_strto32(bounds.second.data(), bounds.second.size(), &last)) {
+      return Status::InvalidArgument("invalid CPU list", cpulist);
+    }
+    if (last < first) {
+      return Status::InvalidArgument("invalid CPU range in CPU list", cpulist);
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      parsed.push_back(cpu);
+    }
+  }
+  std::sort(parsed.begin(), parsed.end());
+  parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+  *cpus = std::move(parsed);
+  return Status::OK();
+}
+
+Status SetCurrentThreadCpuAffinity(const vector<int>& cpus) {
+#ifndef __linux__
+  return Status::NotSupported("thread CPU affinity is not supported on this platform");
+#else
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return Status::InvalidArgument(Substitute("invalid CPU $0", cpu));
+    }
+    CPU_SET(cpu, &set);
+  }
+  // With a tid of 0, sched_setaffinity() applies to the calling thread only.
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    int err = errno;
+    return Status::RuntimeError(Substitute("could not set the CPU affinity to $0",
+                                           JoinInts(cpus, ",")),
+                                ErrnoToString(err), err);
+  }
+  return Status::OK();
+#endif // __linux__
+}
+
+Status GetNumaNodeCpus(int cpu, vector<int>* node_cpus) {
+  Env* env = Env::Default();
+  // The CPU directory in sysfs holds a 'nodeN' entry for its NUMA node.
+  string cpu_dir = Substitute("/sys/devices/system/cpu/cpu$0", cpu);
+  if (!env->FileExists(cpu_dir)) {
+    return Status::NotFound(Substitute("CPU $0 not found", cpu));
+  }
+  vector<string> children;
+  RETURN_NOT_OK(env->GetChildren(cpu_dir, &children));
+  for (const string& child : children) {
+    int32_t node;
+    if (!HasPrefixString(child, "node") ||
+        !safe_strto32(child.substr(4), &node)) {
+      continue;
+    }
+    faststring buf;
+    RETURN_NOT_OK(ReadFileToString(
+        env, Substitute("/sys/devices/system/node/node$0/cpulist", node), &buf));
+    return ParseCpuList(buf.ToString(), node_cpus);
+  }
+  // No NUMA topology: a single node spanning every CPU.
+  faststring buf;
+  RETURN_NOT_OK(ReadFileToString(env, "/sys/devices/system/cpu/online", &buf));
+  return ParseCpuList(buf.ToString(), node_cpus);
+}
+
+Status GetNumaNodes(vector<vector<int>>* nodes) {
+  Env* env = Env::Default();
+  faststring buf;
+  vector<vector<int>> result;
+  if (env->FileExists("/sys/devices/system/node/online")) {
+    RETURN_NOT_OK(ReadFileToString(env, "/sys/devices/system/node/online", &buf));
+    vector<int> node_ids;
+    RETURN_NOT_OK(ParseCpuList(buf.ToString(), &node_ids));
+    for (int node : node_ids) {
+      RETURN_NOT_OK(ReadFileToString(
+          env, Substitute("/sys/devices/system/node/node$0/cpulist", node), &buf));
+      vector<int> cpus;
+      RETURN_NOT_OK(ParseCpuList(buf.ToString(), &cpus));
+      // Nodes with memory only have no CPUs to run threads on.
+      if (!cpus.empty()) {
+        result.emplace_back(std::move(cpus));
+      }
+    }
+  }
+  if (result.empty()) {
+    // No NUMA topology: a single node spanning every CPU.
+    RETURN_NOT_OK(ReadFileToString(env, "/sys/devices/system/cpu/online", &buf));
+    vector<int> cpus;
+    RETURN_NOT_OK(ParseCpuList(buf.ToString(), &cpus));
+    result.emplace_back(std::move(cpus));
+  }
+  *nodes = std::move(result);
+  return Status::OK();
+}
+
+int GetCurrentCpu() {
+#ifndef __linux__
+  return -1;
+#else
+  return sched_getcpu();
+#endif // __linux__
+}
+
 } // namespace kudu
@@ -26,6 +26,7 @@
 #include <cstdint>
 #include <string>
 #include <type_traits> // IWYU pragma: keep
+#include <vector>
 
 #include "kudu/util/status.h"
 
@@ -67,6 +68,29 @@ void DisableCoreDumps();
 // This may return false on unsupported (non-Linux) platforms.
 bool IsBeingDebugged();
 
+// Parses a list of CPUs in the kernel's "cpulist" format, i.e. comma-separated
+// CPU numbers and inclusive ranges such as "0-3,8,10-11", into 'cpus', in
+// ascending order and without duplicates.
+Status ParseCpuList(const std::string& cpulist, std::vector<int>* cpus);
+
+// Restricts the calling thread to run on the CPUs in 'cpus'.
+//
+// Returns Status::NotSupported() on platforms without thread affinity.
+Status SetCurrentThreadCpuAffinity(const std::vector<int>& cpus);
+
+// Sets 'node_cpus' to the CPUs of the NUMA node 'cpu' belongs to. On systems
+// which don't expose their NUMA topology, the node is assumed to span all
+// the CPUs.
+Status GetNumaNodeCpus(int cpu, std::vector<int>* node_cpus);
+
+// Sets 'nodes' to the CPUs of each online NUMA node which has any, in order of
+// node number. On systems which don't expose their NUMA topology, there is a
+// single node spanning all the CPUs.
+Status GetNumaNodes(std::vector<std::vector<int>>* nodes);
+
+// Returns the CPU the calling thread is running on, or -1 if unknown.
+int GetCurrentCpu();
+
 } // namespace kudu
 
 #endif /* KUDU_UTIL_OS_UTIL_H */
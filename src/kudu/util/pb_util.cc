@@ -526,7 +526,7 @@ Status WritePBToPath(Env* env, const std::string& path,
     return Status::IOError("Unable to serialize PB to file");
   }
 
-  if (sync == pb_util::SYNC) {
+  if (sync != pb_util::NO_SYNC) {
     RETURN_NOT_OK_PREPEND(file->Sync(), "Failed to Sync() " + tmp_path);
   }
   RETURN_NOT_OK_PREPEND(file->Close(), "Failed to Close() " + tmp_path);
@@ -742,6 +742,19 @@ Status WritablePBContainerFile::Append(const Message& msg) {
   return Status::OK();
 }
 
+Status WritablePBContainerFile::AppendBatch(const vector<const Message*>& msgs) {
+  DCHECK_EQ(FileState::OPEN, state_);
+
+  faststring buf;
+  for (const auto* msg : msgs) {
+    RETURN_NOT_OK_PREPEND(AppendMsgToBuffer(*msg, &buf),
+                          "Failed to prepare buffer for writing");
+  }
+  RETURN_NOT_OK_PREPEND(AppendBytes(buf), "Failed to append data to file");
+
+  return Status::OK();
+}
+
 Status WritablePBContainerFile::Flush() {
   DCHECK_EQ(FileState::OPEN, state_);
 
@@ -1019,6 +1032,16 @@ uint64_t ReadablePBContainerFile::offset() const {
   return offset_;
 }
 
+Status ReadablePBContainerFile::SeekToOffset(uint64_t offset) {
+  DCHECK_EQ(FileState::OPEN, state_);
+  if (offset < offset_) {
+    return Status::InvalidArgument(Substitute(
+        "cannot seek back from offset $0 to $1", offset_, offset));
+  }
+  offset_ = offset;
+  return Status::OK();
+}
+
 Status ReadPBContainerFromPath(Env* env, const std::string& path, Message* msg) {
   unique_ptr<RandomAccessFile> file;
   RETURN_NOT_OK(env->NewRandomAccessFile(path, &file));
@@ -1053,7 +1076,7 @@ Status WritePBContainerToPath(Env* env, const std::string& path,
   WritablePBContainerFile pb_file(std::move(file));
   RETURN_NOT_OK(pb_file.CreateNew(msg));
   RETURN_NOT_OK(pb_file.Append(msg));
-  if (sync == pb_util::SYNC) {
+  if (sync != pb_util::NO_SYNC) {
     RETURN_NOT_OK(pb_file.Sync());
   }
   RETURN_NOT_OK(pb_file.Close());
@@ -25,6 +25,7 @@
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/optional/optional.hpp>
 #include <google/protobuf/message.h>
@@ -58,7 +59,10 @@ namespace pb_util {
 
 enum SyncMode {
   SYNC,
-  NO_SYNC
+  NO_SYNC,
+  // Sync the file, but not the directory holding it. The caller must sync
+  // the directory itself before relying on the new file being durable.
+  SYNC_FILE_ONLY
 };
 
 enum CreateMode {
@@ -302,6 +306,9 @@ class WritablePBContainerFile {
   // must be called prior to calling Append(), i.e. the file must be open.
   Status Append(const google::protobuf::Message& msg);
 
+  // Like Append(), but writes all of 'msgs' to the container at once.
+  Status AppendBatch(const std::vector<const google::protobuf::Message*>& msgs);
+
   // Asynchronously flushes all dirty container data to the filesystem.
   // The file must be open.
   Status Flush();
@@ -434,6 +441,13 @@ class ReadablePBContainerFile {
   // File must be open.
   uint64_t offset() const;
 
+  // Skips ahead to 'offset', which must be the offset of a record, e.g. a
+  // value previously returned by offset(). File must be open.
+  //
+  // Returns Status::InvalidArgument() if 'offset' is behind the current
+  // read offset.
+  Status SeekToOffset(uint64_t offset);
+
  private:
   FileState state_;
   int version_;
@@ -470,6 +484,7 @@ Status ReadPBContainerFromPath(Env* env, const std::string& path,
 //
 // If create == NO_OVERWRITE and 'path' already exists, the function will fail.
 // If sync == SYNC, the newly created file will be fsynced before returning.
+// If sync == SYNC_FILE_ONLY, so is the file, but not its directory.
 Status WritePBContainerToPath(Env* env, const std::string& path,
                               const google::protobuf::Message& msg,
                               CreateMode create,
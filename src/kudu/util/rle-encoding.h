@@ -17,6 +17,9 @@
 #ifndef IMPALA_RLE_ENCODING_H
 #define IMPALA_RLE_ENCODING_H
 
+#include <algorithm>
+#include <cstddef>
+
 #include <glog/logging.h>
 
 #include "kudu/gutil/port.h"
@@ -111,6 +114,12 @@ class RleDecoder {
   // GetNextRun will return more from the same run.
   size_t GetNextRun(T* val, size_t max_run);
 
+  // Gets up to the next 'batch_size' values into 'values', filling repeated
+  // runs and unpacking literal runs in bulk. Returns the number of values
+  // read, which is less than 'batch_size' only if there is no more data to be
+  // decoded.
+  size_t GetBatch(T* values, size_t batch_size);
+
  private:
   bool ReadHeader();
 
@@ -341,6 +350,29 @@ inline size_t RleDecoder<T>::GetNextRun(T* val, size_t max_run) {
   return ret;
  }
 
+template<typename T>
+inline size_t RleDecoder<T>::GetBatch(T* values, size_t batch_size) {
+  DCHECK(bit_reader_.is_initialized());
+  size_t ret = 0;
+  while (ret < batch_size && ReadHeader()) {
+    if (PREDICT_TRUE(repeat_count_ > 0)) {
+      size_t n = std::min<size_t>(repeat_count_, batch_size - ret);
+      std::fill(values + ret, values + ret + n, static_cast<T>(current_value_));
+      repeat_count_ -= n;
+      ret += n;
+    } else {
+      DCHECK(literal_count_ > 0);
+      size_t n = std::min<size_t>(literal_count_, batch_size - ret);
+      int num_read = bit_reader_.GetBatch(bit_width_, values + ret, n);
+      DCHECK_EQ(n, static_cast<size_t>(num_read));
+      literal_count_ -= n;
+      ret += n;
+    }
+  }
+  rewind_state_ = CANT_REWIND;
+  return ret;
+}
+
 template<typename T>
 inline size_t RleDecoder<T>::Skip(size_t to_skip) {
   DCHECK(bit_reader_.is_initialized());
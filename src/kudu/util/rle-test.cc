@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -141,6 +142,46 @@ TEST(BitArray, TestValues) {
   }
 }
 
+// Test that GetBatch() reads the same values as GetValue(), from any bit
+// position and up to the end of the buffer.
+TEST(BitArray, TestGetBatch) {
+  const int kNumValues = 1000;
+  srand(0);
+  for (int width = 1; width <= kMaxWidth; ++width) {
+    const uint64_t mask = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    vector<uint64_t> values;
+    faststring buffer;
+    BitWriter writer(&buffer);
+    for (int i = 0; i < kNumValues; ++i) {
+      values.push_back(((static_cast<uint64_t>(rand()) << 32) | rand()) & mask); // NOLINT(*)
+      writer.PutValue(values.back(), width);
+    }
+    writer.Flush();
+
+    BitReader reader(buffer.data(), writer.bytes_written());
+    int i = 0;
+    while (i < kNumValues) {
+      // Alternate between batches of various sizes and single values.
+      uint64_t batch[37];
+      int n = reader.GetBatch(width, batch, std::min(1 + i % 37, kNumValues - i));
+      ASSERT_GT(n, 0);
+      for (int j = 0; j < n; ++j) {
+        ASSERT_EQ(values[i + j], batch[j]) << "width " << width << " value " << i + j;
+      }
+      i += n;
+      if (i < kNumValues) {
+        uint64_t val;
+        ASSERT_TRUE(reader.GetValue(width, &val));
+        ASSERT_EQ(values[i++], val);
+      }
+    }
+    // Only the padding of the last byte is left.
+    uint64_t batch[8];
+    ASSERT_EQ((writer.bytes_written() * 8 - kNumValues * width) / width,
+              reader.GetBatch(width, batch, 8));
+  }
+}
+
 // Test some mixed values
 TEST(BitArray, TestMixed) {
   const int kTestLenBits = 1024;
@@ -209,6 +250,18 @@ void ValidateRle(const vector<T>& values, int bit_width,
     EXPECT_TRUE(result);
     EXPECT_EQ(value, val);
   }
+
+  // Verify batched read, in batches of various sizes.
+  RleDecoder<T> batch_decoder(buffer.data(), encoded_len, bit_width);
+  std::unique_ptr<T[]> batch(new T[values.size()]);
+  size_t batch_size = 1;
+  for (size_t i = 0; i < values.size(); i += batch_size, batch_size = batch_size * 3 + 1) {
+    batch_size = std::min(batch_size, values.size() - i);
+    EXPECT_EQ(batch_size, batch_decoder.GetBatch(batch.get(), batch_size));
+    for (size_t j = 0; j < batch_size; ++j) {
+      EXPECT_EQ(values[i + j], batch[j]);
+    }
+  }
 }
 
 TEST(Rle, SpecificSequences) {
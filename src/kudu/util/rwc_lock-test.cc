@@ -27,10 +27,12 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/rwc_lock.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
 
+using base::subtle::NoBarrier_AtomicIncrement;
 using base::subtle::NoBarrier_Load;
 using base::subtle::Release_Store;
 using std::string;
@@ -144,4 +146,85 @@ TEST_F(RWCLockTest, TestCorrectBehavior) {
   }
 }
 
+// Readers which arrive while a commit is in progress wait for it to finish,
+// and the committer waits for readers which already hold the lock.
+TEST_F(RWCLockTest, TestReadersWaitForCommit) {
+  RWCLock lock;
+  Atomic32 committed = 0;
+
+  lock.ReadLock();
+  thread committer([&]() {
+    lock.WriteLock();
+    lock.UpgradeToCommitLock();
+    CHECK(!lock.HasReaders());
+    SleepFor(MonoDelta::FromMilliseconds(100));
+    Release_Store(&committed, 1);
+    lock.CommitUnlock();
+  });
+
+  // The commit can't proceed until the existing reader is done.
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  ASSERT_EQ(0, NoBarrier_Load(&committed));
+  lock.ReadUnlock();
+
+  // Give the committer time to take the commit lock. A new reader must not
+  // get in until the commit is done.
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  lock.ReadLock();
+  ASSERT_EQ(1, NoBarrier_Load(&committed));
+  lock.ReadUnlock();
+  committer.join();
+  ASSERT_FALSE(lock.HasReaders());
+}
+
+// Readers which arrive while the committer waits for an existing reader
+// sleep until the commit is done, rather than spinning on the mutex.
+TEST_F(RWCLockTest, TestReadersSleepWhileCommitPending) {
+  const int kNumReaders = 4;
+  RWCLock lock;
+  Atomic32 committed = 0;
+  Atomic32 num_reads = 0;
+
+  lock.ReadLock();
+  thread committer([&]() {
+    lock.WriteLock();
+    lock.UpgradeToCommitLock();
+    Release_Store(&committed, 1);
+    lock.CommitUnlock();
+  });
+
+  // Give the committer time to start waiting for the reader.
+  SleepFor(MonoDelta::FromMilliseconds(100));
+
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  vector<thread> readers;
+  for (int i = 0; i < kNumReaders; i++) {
+    readers.emplace_back([&]() {
+      lock.ReadLock();
+      CHECK_EQ(1, NoBarrier_Load(&committed));
+      NoBarrier_AtomicIncrement(&num_reads, 1);
+      lock.ReadUnlock();
+    });
+  }
+  SleepFor(MonoDelta::FromMilliseconds(500));
+  sw.stop();
+
+  // None of the new readers may get in while the commit is pending, and
+  // spinning ones would have used about a core each for the whole time.
+  ASSERT_EQ(0, NoBarrier_Load(&num_reads));
+  CpuTimes times = sw.elapsed();
+  ASSERT_LT(times.user + times.system, MonoDelta::FromMilliseconds(250).ToNanoseconds())
+      << times.ToString();
+
+  lock.ReadUnlock();
+  for (thread& t : readers) {
+    t.join();
+  }
+  committer.join();
+  ASSERT_EQ(1, NoBarrier_Load(&committed));
+  ASSERT_EQ(kNumReaders, NoBarrier_Load(&num_reads));
+  ASSERT_FALSE(lock.HasReaders());
+}
+
 } // namespace kudu
@@ -19,6 +19,8 @@
 
 #include <glog/logging.h>
 
+#include "kudu/gutil/port.h"
+
 #ifndef NDEBUG
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/debug-util.h"
@@ -30,7 +32,7 @@ namespace kudu {
 RWCLock::RWCLock()
   : no_mutators_(&lock_),
     no_readers_(&lock_),
-    reader_count_(0),
+    readers_(0),
 #ifdef NDEBUG
     write_locked_(false) {
 #else
@@ -47,27 +49,45 @@ RWCLock::~RWCLock() {
 }
 
 void RWCLock::ReadLock() {
-  MutexLock l(lock_);
-  reader_count_++;
+  int64_t readers = readers_.load(std::memory_order_relaxed);
+  while (true) {
+    if (PREDICT_TRUE(!(readers & kCommitPending))) {
+      if (readers_.compare_exchange_weak(readers, readers + 1,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+        return;
+      }
+      continue;
+    }
+    // A commit is pending. The committer releases lock_ while it waits for
+    // the existing readers, so sleep until CommitUnlock() clears the bit
+    // and broadcasts no_mutators_, rather than spinning on lock_. Readers
+    // only wait here while the committer holds the write lock, so they
+    // never take the signal WriteUnlock() meant for a writer.
+    {
+      MutexLock l(lock_);
+      while (readers_.load(std::memory_order_relaxed) & kCommitPending) {
+        no_mutators_.Wait();
+      }
+    }
+    readers = readers_.load(std::memory_order_relaxed);
+  }
 }
 
 void RWCLock::ReadUnlock() {
-  MutexLock l(lock_);
-  DCHECK(HasReadersUnlocked());
-  reader_count_--;
-  if (reader_count_ == 0) {
+  int64_t prev = readers_.fetch_sub(1, std::memory_order_release);
+  DCHECK_GT(prev & ~kCommitPending, 0);
+  if (PREDICT_FALSE(prev == (kCommitPending | 1))) {
+    // The last reader out wakes the committer. Taking lock_ ensures that
+    // the committer is already waiting, or that it hasn't yet checked for
+    // readers and will see there are none.
+    MutexLock l(lock_);
     no_readers_.Signal();
   }
 }
 
 bool RWCLock::HasReaders() const {
-  MutexLock l(lock_);
-  return HasReadersUnlocked();
-}
-
-bool RWCLock::HasReadersUnlocked() const {
-  lock_.AssertAcquired();
-  return reader_count_ > 0;
+  return (readers_.load(std::memory_order_acquire) & ~kCommitPending) > 0;
 }
 
 bool RWCLock::HasWriteLock() const {
@@ -112,7 +132,10 @@ void RWCLock::WriteUnlock() {
 void RWCLock::UpgradeToCommitLock() {
   lock_.lock();
   DCHECK(HasWriteLockUnlocked());
-  while (reader_count_ > 0) {
+  // New readers back off as soon as they see the commit is pending, so only
+  // those which already hold the lock need to finish.
+  readers_.fetch_or(kCommitPending, std::memory_order_acquire);
+  while (HasReaders()) {
     no_readers_.Wait();
   }
   DCHECK(HasWriteLockUnlocked());
@@ -122,13 +145,14 @@ void RWCLock::UpgradeToCommitLock() {
 }
 
 void RWCLock::CommitUnlock() {
-  DCHECK(!HasReadersUnlocked());
+  DCHECK(!HasReaders());
   DCHECK(HasWriteLockUnlocked());
   write_locked_ = false;
 #ifndef NDEBUG
   writer_tid_ = 0;
   last_writer_backtrace_[0] = '\0';
 #endif // NDEBUG
+  readers_.fetch_and(~kCommitPending, std::memory_order_release);
   no_mutators_.Broadcast();
   lock_.unlock();
 }
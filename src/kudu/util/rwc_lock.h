@@ -17,6 +17,7 @@
 #ifndef KUDU_UTIL_RWC_LOCK_H
 #define KUDU_UTIL_RWC_LOCK_H
 
+#include <atomic>
 #include <cstdint>
 
 #include "kudu/gutil/macros.h"
@@ -66,6 +67,12 @@ namespace kudu {
 // For the common pattern described above, the 'CowObject<>' template class defined
 // in cow_object.h is more convenient than manual locking.
 //
+// Taking and releasing the read lock doesn't touch the mutex: readers only
+// update an atomic count. Readers which arrive while a commit is pending
+// sleep until it's done, and then retry. This
+// keeps frequently-read objects (e.g. the master's table and tablet metadata)
+// from serializing their readers on the mutex.
+//
 // NOTE: this implementation currently does not implement any starvation protection
 // or fairness. If the read lock is being constantly acquired (i.e reader count
 // never drops to 0) then UpgradeToCommitLock() may block arbitrarily long.
@@ -115,17 +122,23 @@ class RWCLock {
   void CommitUnlock();
 
  private:
-  // Variants of the functions above that must be called with lock_ held.
-  bool HasReadersUnlocked() const;
+  // Variant of HasWriteLock() that must be called with lock_ held.
   bool HasWriteLockUnlocked() const;
 
-  // Lock which protects reader_count_ and write_locked_.
+  // Set in 'readers_' while a thread holds or is waiting for the commit lock.
+  static const int64_t kCommitPending = 1LL << 62;
+
+  // Lock which protects write_locked_.
+  // Readers wait on no_mutators_ while a commit is pending.
   // Additionally, while the commit lock is held, the
   // locking thread holds this mutex, which prevents any new
   // threads from obtaining the lock in any mode.
   mutable Mutex lock_;
   ConditionVariable no_mutators_, no_readers_;
-  int reader_count_;
+
+  // The number of readers holding the lock, or'ed with kCommitPending.
+  // Readers never take lock_ unless a commit is pending.
+  std::atomic<int64_t> readers_;
   bool write_locked_;
 
 #ifndef NDEBUG
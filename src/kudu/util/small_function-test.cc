@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/small_function.h"
+
+#include <memory>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+using std::unique_ptr;
+
+namespace kudu {
+
+TEST(SmallFunctionTest, TestInline) {
+  auto counter = std::make_shared<int>(0);
+  SmallFunction f([counter]() { (*counter)++; });
+  ASSERT_TRUE(static_cast<bool>(f));
+  ASSERT_TRUE(f.is_inline());
+  f();
+  f();
+  ASSERT_EQ(2, *counter);
+
+  // Moving the function moves the callable along with its captures.
+  SmallFunction g(std::move(f));
+  ASSERT_FALSE(static_cast<bool>(f));
+  ASSERT_EQ(2, counter.use_count());
+  g();
+  ASSERT_EQ(3, *counter);
+
+  g.reset();
+  ASSERT_FALSE(static_cast<bool>(g));
+  ASSERT_EQ(1, counter.use_count());
+}
+
+TEST(SmallFunctionTest, TestHeap) {
+  auto counter = std::make_shared<int>(0);
+  char padding[SmallFunction::kInlineSize] = { 0 };
+  SmallFunction f([counter, padding]() { (*counter) += 1 + padding[0]; });
+  ASSERT_FALSE(f.is_inline());
+  f();
+  ASSERT_EQ(1, *counter);
+
+  SmallFunction g;
+  ASSERT_FALSE(static_cast<bool>(g));
+  g = std::move(f);
+  ASSERT_FALSE(static_cast<bool>(f));
+  g();
+  ASSERT_EQ(2, *counter);
+  g = SmallFunction();
+  ASSERT_EQ(1, counter.use_count());
+}
+
+TEST(SmallFunctionTest, TestMoveOnly) {
+  int result = 0;
+  unique_ptr<int> value(new int(42));
+  struct Task {
+    void operator()() { *result = *value; }
+    int* result;
+    unique_ptr<int> value;
+  };
+  SmallFunction f(Task{ &result, std::move(value) });
+  ASSERT_TRUE(f.is_inline());
+  SmallFunction g(std::move(f));
+  g();
+  ASSERT_EQ(42, result);
+}
+
+} // namespace kudu
@@ -0,0 +1,179 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+// A move-only wrapper of a callable taking no argument and returning nothing.
+//
+// Unlike std::function or boost::function, callables of up to kInlineSize
+// bytes, e.g. lambdas capturing a few pointers or a shared_ptr, are stored
+// in the wrapper itself rather than on the heap, and the callable doesn't
+// need to be copyable. Larger callables, or those which may throw when
+// moved, are heap-allocated.
+//
+// Example:
+//   SmallFunction f([w_this]() { ... });
+//   f();
+class SmallFunction {
+ public:
+  static constexpr size_t kInlineSize = 6 * sizeof(void*);
+
+  SmallFunction() : ops_(nullptr) {}
+
+  // Wraps 'f', which must be callable as f().
+  template <class F,
+            class = typename std::enable_if<
+                !std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+  SmallFunction(F&& f) // NOLINT(runtime/explicit)
+      : ops_(nullptr) {
+    typedef typename std::decay<F>::type Fn;
+    Init<Fn>(std::forward<F>(f), std::integral_constant<bool, FitsInline<Fn>()>());
+  }
+
+  SmallFunction(SmallFunction&& other) noexcept
+      : ops_(nullptr) {
+    MoveFrom(&other);
+  }
+
+  SmallFunction& operator=(SmallFunction&& other) noexcept {
+    if (this != &other) {
+      reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  ~SmallFunction() {
+    reset();
+  }
+
+  // Invokes the wrapped callable.
+  //
+  // REQUIRES: a callable is wrapped.
+  void operator()() {
+    DCHECK(ops_);
+    ops_->invoke(&storage_);
+  }
+
+  // Whether a callable is wrapped.
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // Whether the wrapped callable is stored inline, without a heap allocation.
+  bool is_inline() const { return ops_ && ops_->is_inline; }
+
+  // Destroys the wrapped callable, if any.
+  void reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  typedef typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type Storage;
+
+  // How to run, move and destroy the callable held in 'storage_'.
+  struct Ops {
+    void (*invoke)(void* storage);
+    void (*move)(void* from, void* to);
+    void (*destroy)(void* storage);
+    bool is_inline;
+  };
+
+  template <class F>
+  static constexpr bool FitsInline() {
+    return sizeof(F) <= kInlineSize &&
+           alignof(F) <= alignof(Storage) &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+  // The callable is constructed in 'storage_'.
+  template <class F>
+  struct InlineOps {
+    static void Invoke(void* storage) {
+      (*static_cast<F*>(storage))();
+    }
+    static void Move(void* from, void* to) {
+      F* f = static_cast<F*>(from);
+      new (to) F(std::move(*f));
+      f->~F();
+    }
+    static void Destroy(void* storage) {
+      static_cast<F*>(storage)->~F();
+    }
+    static const Ops* Get() {
+      static const Ops kOps = { &Invoke, &Move, &Destroy, true };
+      return &kOps;
+    }
+  };
+
+  // 'storage_' holds a pointer to the heap-allocated callable.
+  template <class F>
+  struct HeapOps {
+    static void Invoke(void* storage) {
+      (**static_cast<F**>(storage))();
+    }
+    static void Move(void* from, void* to) {
+      *static_cast<F**>(to) = *static_cast<F**>(from);
+    }
+    static void Destroy(void* storage) {
+      delete *static_cast<F**>(storage);
+    }
+    static const Ops* Get() {
+      static const Ops kOps = { &Invoke, &Move, &Destroy, false };
+      return &kOps;
+    }
+  };
+
+  template <class Fn, class F>
+  void Init(F&& f, std::true_type /* inline */) {
+    new (&storage_) Fn(std::forward<F>(f));
+    ops_ = InlineOps<Fn>::Get();
+  }
+
+  template <class Fn, class F>
+  void Init(F&& f, std::false_type /* inline */) {
+    *reinterpret_cast<Fn**>(&storage_) = new Fn(std::forward<F>(f));
+    ops_ = HeapOps<Fn>::Get();
+  }
+
+  void MoveFrom(SmallFunction* other) {
+    if (other->ops_) {
+      other->ops_->move(&other->storage_, &storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  Storage storage_;
+  const Ops* ops_;
+
+  DISALLOW_COPY_AND_ASSIGN(SmallFunction);
+};
+
+} // namespace kudu
@@ -25,6 +25,7 @@
 #include "kudu/gutil/integral_types.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/spinlock.h"
+#include "kudu/util/debug-util.h"
 #include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -76,6 +77,21 @@ TEST_F(SpinLockProfilingTest, TestStackCollection) {
   std::string s = str.str();
   ASSERT_STR_CONTAINS(s, "12345 1 @ ");
   ASSERT_EQ(0, dropped);
+
+  // The samples may also be collected without formatting them.
+  StartSynchronizationProfiling();
+  gutil::SubmitSpinLockProfileData(&lock, 678);
+  StopSynchronizationProfiling();
+  int64_t total_count = 0;
+  int64_t total_cycles = 0;
+  FlushSynchronizationProfile([&](const StackTrace& stack, int64_t count, int64_t cycles) {
+      ASSERT_TRUE(stack.HasCollected());
+      total_count += count;
+      total_cycles += cycles;
+    }, &dropped);
+  ASSERT_EQ(1, total_count);
+  ASSERT_EQ(678, total_cycles);
+  ASSERT_EQ(0, dropped);
 }
 
 } // namespace kudu
@@ -89,7 +89,7 @@ class ContentionStacks {
   //
   // On return, guarantees that any stack traces that were present at the beginning of
   // the call have been flushed. However, new stacks can be added concurrently with this call.
-  void Flush(std::ostringstream* out, int64_t* dropped);
+  void Flush(const SynchronizationProfileVisitor& visitor, int64_t* dropped);
 
  private:
 
@@ -176,16 +176,13 @@ void ContentionStacks::AddStack(const StackTrace& s, int64_t cycles) {
   dropped_samples_.Increment();
 }
 
-void ContentionStacks::Flush(std::ostringstream* out, int64_t* dropped) {
+void ContentionStacks::Flush(const SynchronizationProfileVisitor& visitor, int64_t* dropped) {
   uint64_t iterator = 0;
   StackTrace t;
   int64_t cycles;
   int64_t count;
-  while (g_contention_stacks->CollectSample(&iterator, &t, &count, &cycles)) {
-    *out << cycles << " " << count
-         << " @ " << t.ToHexString(StackTrace::NO_FIX_CALLER_ADDRESSES |
-                                   StackTrace::HEX_0X_PREFIX)
-         << std::endl;
+  while (CollectSample(&iterator, &t, &count, &cycles)) {
+    visitor(t, count, cycles);
   }
 
   *dropped += dropped_samples_.Exchange(0);
@@ -289,7 +286,19 @@ void StartSynchronizationProfiling() {
 
 void FlushSynchronizationProfile(std::ostringstream* out,
                                  int64_t* drop_count) {
-  CHECK_NOTNULL(g_contention_stacks)->Flush(out, drop_count);
+  FlushSynchronizationProfile(
+      [out](const StackTrace& t, int64_t count, int64_t cycles) {
+        *out << cycles << " " << count
+             << " @ " << t.ToHexString(StackTrace::NO_FIX_CALLER_ADDRESSES |
+                                       StackTrace::HEX_0X_PREFIX)
+             << std::endl;
+      },
+      drop_count);
+}
+
+void FlushSynchronizationProfile(const SynchronizationProfileVisitor& visitor,
+                                 int64_t* drop_count) {
+  CHECK_NOTNULL(g_contention_stacks)->Flush(visitor, drop_count);
 }
 
 void StopSynchronizationProfiling() {
@@ -18,6 +18,7 @@
 #define KUDU_UTIL_SPINLOCK_PROFILING_H
 
 #include <cstdint>
+#include <functional>
 #include <iosfwd>
 
 #include "kudu/gutil/ref_counted.h"
@@ -25,6 +26,7 @@
 namespace kudu {
 
 class MetricEntity;
+class StackTrace;
 
 // Enable instrumentation of spinlock contention.
 //
@@ -65,6 +67,14 @@ void StartSynchronizationProfiling();
 // returned samples.
 void FlushSynchronizationProfile(std::ostringstream* out, int64_t* drop_count);
 
+// Same as above, but passes each stack trace to 'visitor' along with its trip
+// count and the number of cycles spent waiting at it, rather than formatting
+// them.
+typedef std::function<void(const StackTrace& stack, int64_t trip_count, int64_t cycles)>
+    SynchronizationProfileVisitor;
+void FlushSynchronizationProfile(const SynchronizationProfileVisitor& visitor,
+                                 int64_t* drop_count);
+
 // Stop collecting contention profiles.
 void StopSynchronizationProfiling();
 
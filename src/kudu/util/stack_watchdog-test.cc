@@ -17,6 +17,7 @@
 
 #include "kudu/util/kernel_stack_watchdog.h"
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <thread>
@@ -27,6 +28,7 @@
 #include <gtest/gtest.h>
 
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -77,6 +79,33 @@ TEST_F(StackWatchdogTest, TestWatchdog) {
   ASSERT_STR_CONTAINS(s, "TestWatchdog_Test::TestBody()");
   ASSERT_STR_CONTAINS(s, "nanosleep");
 }
+
+// Test that stalls are recorded and counted once each, however many times the
+// watchdog sees them.
+TEST_F(StackWatchdogTest, TestRecordsStalls) {
+  KernelStackWatchdog* watchdog = KernelStackWatchdog::GetInstance();
+  int64_t stalls_before = watchdog->num_stalls();
+  int line;
+  {
+    SCOPED_WATCH_STACK(20); line = __LINE__;
+    for (int i = 0; i < 50; i++) {
+      SleepFor(MonoDelta::FromMilliseconds(100));
+      if (watchdog->LoggedMessagesForTests().size() > 3) {
+        break;
+      }
+    }
+  }
+  string label = Substitute("stack_watchdog-test.cc:$0", line);
+  ASSERT_EQ(stalls_before + 1, watchdog->num_stalls());
+  ASSERT_EQ(1, FindWithDefault(watchdog->StallCountsByLabel(), label, 0));
+
+  vector<KernelStackWatchdog::Stall> stalls = watchdog->RecentStalls();
+  ASSERT_FALSE(stalls.empty());
+  const KernelStackWatchdog::Stall& stall = stalls.back();
+  ASSERT_STR_CONTAINS(stall.label, label);
+  ASSERT_GT(stall.duration_ms, 20);
+  ASSERT_STR_CONTAINS(stall.user_stack, "TestRecordsStalls_Test::TestBody()");
+}
 #endif
 
 // Test that SCOPED_WATCH_STACK scopes can be nested.
@@ -184,6 +184,9 @@ class ThreadMgr {
   // Metric callback for number of threads running. Also used for error messages.
   uint64_t ReadThreadsRunning() const;
 
+  // See GetThreadNames() in thread.h.
+  void GetThreadNames(unordered_map<int64_t, string>* names) const;
+
  private:
   // Container class for any details we want to capture about a thread
   // TODO: Add start-time.
@@ -314,6 +317,16 @@ uint64_t ThreadMgr::ReadThreadsRunning() const {
   return threads_running_metric_;
 }
 
+void ThreadMgr::GetThreadNames(unordered_map<int64_t, string>* names) const {
+  names->clear();
+  shared_lock<decltype(lock_)> l(lock_);
+  for (const auto& category : thread_categories_) {
+    for (const auto& elem : category.second) {
+      (*names)[elem.second.thread_id()] = elem.second.name();
+    }
+  }
+}
+
 void ThreadMgr::AddThread(const pthread_t& pthread_id, const string& name,
     const string& category, int64_t tid) {
   // These annotations cause TSAN to ignore the synchronization on lock_
@@ -459,6 +472,11 @@ Status StartThreadInstrumentation(const scoped_refptr<MetricEntity>& server_metr
   return thread_manager->StartInstrumentation(server_metrics, web);
 }
 
+void GetThreadNames(unordered_map<int64_t, string>* names) {
+  GoogleOnceInit(&once, &InitThreading);
+  thread_manager->GetThreadNames(names);
+}
+
 ThreadJoiner::ThreadJoiner(Thread* thr)
   : thread_(CHECK_NOTNULL(thr)),
     warn_after_ms_(kDefaultWarnAfterMs),
@@ -30,6 +30,7 @@
 
 #include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/bind.hpp>     // IWYU pragma: keep
@@ -368,6 +369,12 @@ class Thread : public RefCountedThreadSafe<Thread> {
 // the given entity. If 'web' is NULL, does not register the path handler.
 Status StartThreadInstrumentation(const scoped_refptr<MetricEntity>& server_metrics,
                                   WebCallbackRegistry* web);
+
+// Fills 'names' with the names of all running kudu::Threads, keyed by their
+// system thread ids. The names are suffixed by the thread ids, e.g.
+// "rpc reactor-1234". Threads which weren't started as kudu::Threads are
+// left out.
+void GetThreadNames(std::unordered_map<int64_t, std::string>* names);
 } // namespace kudu
 
 #endif /* KUDU_UTIL_THREAD_H */
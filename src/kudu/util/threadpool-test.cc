@@ -17,6 +17,7 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <iterator>
@@ -48,6 +49,7 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/promise.h"
 #include "kudu/util/random.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -206,7 +208,7 @@ TEST_F(ThreadPoolTest, TestThreadPoolWithNoMinimum) {
   // Finish all work
   latch.CountDown();
   pool_->Wait();
-  ASSERT_EQ(0, pool_->active_threads_);
+  ASSERT_EQ(0, pool_->num_active_threads());
   pool_->Shutdown();
   ASSERT_EQ(0, pool_->num_threads());
 }
@@ -297,7 +299,7 @@ TEST_F(ThreadPoolTest, TestVariableSizeThreadPool) {
   // Finish all work
   latch.CountDown();
   pool_->Wait();
-  ASSERT_EQ(0, pool_->active_threads_);
+  ASSERT_EQ(0, pool_->num_active_threads());
   pool_->Shutdown();
   ASSERT_EQ(0, pool_->num_threads());
 }
@@ -556,6 +558,42 @@ TEST_F(ThreadPoolTest, TestTokenSubmitsProcessedSerially) {
   ASSERT_EQ("abcde", result);
 }
 
+// Test that a coalesced task isn't queued again while a duplicate is queued,
+// but is once its duplicate started running.
+TEST_F(ThreadPoolTest, TestTokenSubmitCoalesced) {
+  ASSERT_OK(RebuildPoolWithMinMax(1, 1));
+  unique_ptr<ThreadPoolToken> t = pool_->NewToken(ThreadPool::ExecutionMode::SERIAL);
+
+  // Block the only thread of the pool.
+  CountDownLatch latch(1);
+  SCOPED_CLEANUP({
+    latch.CountDown();
+  });
+  ASSERT_OK(pool_->Submit(SlowTask::NewSlowTask(&latch)));
+
+  int key;
+  atomic<int> num_runs(0);
+  CountDownLatch running(1);
+  CountDownLatch blocked(1);
+  for (int i = 0; i < 5; i++) {
+    ASSERT_OK(t->SubmitCoalesced(&key, [&]() {
+      if (num_runs++ == 0) {
+        running.CountDown();
+        blocked.Wait();
+      }
+    }));
+  }
+  latch.CountDown();
+  running.Wait();
+  ASSERT_EQ(1, num_runs);
+
+  // The first task is running, so this one is queued.
+  ASSERT_OK(t->SubmitCoalesced(&key, [&]() { num_runs++; }));
+  blocked.CountDown();
+  t->Wait();
+  ASSERT_EQ(2, num_runs);
+}
+
 TEST_P(ThreadPoolTestTokenTypes, TestTokenSubmitsProcessedConcurrently) {
   const int kNumTokens = 5;
   ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
@@ -901,6 +939,131 @@ TEST_F(ThreadPoolTest, TestTokenConcurrency) {
                           kSubmitThreads, total_num_tokens_submitted.load());
 }
 
+// For test cases that should run with both a single and several shards.
+class ThreadPoolTestShards : public ThreadPoolTest,
+                             public testing::WithParamInterface<int> {};
+
+INSTANTIATE_TEST_CASE_P(Shards, ThreadPoolTestShards, ::testing::Values(1, 4));
+
+// Submits tasks to many tokens from several threads at once, checking that
+// the SERIAL tokens still run their tasks in order, and reports the time taken.
+TEST_P(ThreadPoolTestShards, TestManyTokens) {
+  const int kNumShards = GetParam();
+  const int kNumTokens = AllowSlowTests() ? 10000 : 1000;
+  const int kNumTasksPerToken = 10;
+  const int kNumSubmitThreads = 4;
+  ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                   .set_max_threads(std::max(kNumShards, base::NumCPUs()))
+                                   .set_num_shards(kNumShards)));
+
+  // Half of the tokens are SERIAL, the other half CONCURRENT. Each counts the
+  // tasks it ran.
+  vector<unique_ptr<ThreadPoolToken>> tokens;
+  vector<atomic<int>> num_tasks_run(kNumTokens);
+  for (int i = 0; i < kNumTokens; i++) {
+    tokens.emplace_back(pool_->NewToken(i % 2 == 0 ?
+                                        ThreadPool::ExecutionMode::SERIAL :
+                                        ThreadPool::ExecutionMode::CONCURRENT));
+    num_tasks_run[i] = 0;
+  }
+
+  // Each token is submitted to by a single thread, so that its tasks are
+  // queued in a known order.
+  atomic<int> num_out_of_order(0);
+  MonoTime start = MonoTime::Now();
+  vector<thread> threads;
+  for (int t = 0; t < kNumSubmitThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int task = 0; task < kNumTasksPerToken; task++) {
+        for (int i = t; i < kNumTokens; i += kNumSubmitThreads) {
+          CHECK_OK(tokens[i]->SubmitFunc([&, i, task]() {
+            int prev = num_tasks_run[i]++;
+            if (i % 2 == 0 && prev != task) {
+              num_out_of_order++;
+            }
+          }));
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  pool_->Wait();
+  MonoDelta elapsed = MonoTime::Now() - start;
+
+  ASSERT_EQ(0, num_out_of_order);
+  for (int i = 0; i < kNumTokens; i++) {
+    ASSERT_EQ(kNumTasksPerToken, num_tasks_run[i]);
+  }
+  LOG(INFO) << Substitute("Ran $0 tasks of $1 tokens in $2 shards: $3",
+                          kNumTokens * kNumTasksPerToken, kNumTokens,
+                          kNumShards, elapsed.ToString());
+}
+
+// Test that a task queued in a shard whose threads are all busy is run by a
+// thread of another shard.
+TEST_F(ThreadPoolTest, TestShardWorkStealing) {
+  ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                   .set_min_threads(2)
+                                   .set_max_threads(2)
+                                   .set_num_shards(2)));
+  // Let the threads go idle.
+  SleepFor(MonoDelta::FromMilliseconds(100));
+
+  // The tokens are spread round-robin over the shards: 't1' and 't3' share
+  // the first shard.
+  unique_ptr<ThreadPoolToken> t1 = pool_->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  unique_ptr<ThreadPoolToken> t2 = pool_->NewToken(ThreadPool::ExecutionMode::SERIAL);
+  unique_ptr<ThreadPoolToken> t3 = pool_->NewToken(ThreadPool::ExecutionMode::SERIAL);
+
+  CountDownLatch latch(1);
+  SCOPED_CLEANUP({
+    latch.CountDown();
+  });
+  ASSERT_OK(t1->Submit(SlowTask::NewSlowTask(&latch)));
+  CountDownLatch stolen(1);
+  ASSERT_OK(t3->SubmitFunc([&stolen]() { stolen.CountDown(); }));
+  ASSERT_TRUE(stolen.WaitFor(MonoDelta::FromSeconds(10)));
+  ASSERT_EQ(2, pool_->num_threads());
+  latch.CountDown();
+  pool_->Wait();
+}
+
+#if defined(__linux__)
+// Test that the threads of shards built with CPUs run on those CPUs, and that
+// tokens may be placed in a given shard.
+TEST_F(ThreadPoolTest, TestShardCpus) {
+  int cpu = GetCurrentCpu();
+  ASSERT_GE(cpu, 0);
+  ASSERT_OK(RebuildPoolWithBuilder(ThreadPoolBuilder(kDefaultPoolName)
+                                   .set_max_threads(2)
+                                   .set_num_shards(2)
+                                   .set_shard_cpus({ { cpu } })));
+  ASSERT_EQ(2, pool_->num_shards());
+
+  atomic<int> wrong_cpu(0);
+  auto check_cpu = [&]() {
+    if (GetCurrentCpu() != cpu) {
+      wrong_cpu++;
+    }
+  };
+  for (int shard = 0; shard < 4; shard++) {
+    unique_ptr<ThreadPoolToken> t = pool_->NewTokenForShard(
+        shard, ThreadPool::ExecutionMode::SERIAL);
+    for (int i = 0; i < 10; i++) {
+      ASSERT_OK(t->SubmitFunc(check_cpu));
+    }
+    t->Wait();
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(pool_->SubmitFunc(check_cpu));
+  }
+  pool_->Wait();
+  ASSERT_EQ(0, wrong_cpu);
+}
+#endif
+
 TEST_F(ThreadPoolTest, TestLIFOThreadWakeUps) {
   const int kNumThreads = 10;
 
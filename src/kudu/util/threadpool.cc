@@ -17,6 +17,7 @@
 
 #include "kudu/util/threadpool.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <deque>
 #include <limits>
@@ -24,8 +25,8 @@
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
-#include <boost/function.hpp> // IWYU pragma: keep
 #include <glog/logging.h>
 
 #include "kudu/gutil/callback.h"
@@ -35,6 +36,7 @@
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
@@ -46,38 +48,32 @@ using std::deque;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////
-// FunctionRunnable
+// RunnableTask
 ////////////////////////////////////////////////////////
 
-class FunctionRunnable : public Runnable {
- public:
-  explicit FunctionRunnable(boost::function<void()> func) : func_(std::move(func)) {}
-
-  void Run() OVERRIDE {
-    func_();
+// Adapts a Runnable into a callable, so that it can be queued inline.
+struct RunnableTask {
+  void operator()() {
+    r->Run();
   }
 
- private:
-  boost::function<void()> func_;
+  shared_ptr<Runnable> r;
 };
 
 ////////////////////////////////////////////////////////
-// ClosureRunnable
+// ClosureTask
 ////////////////////////////////////////////////////////
 
-class ClosureRunnable : public Runnable {
- public:
-  explicit ClosureRunnable(Closure cl) : cl_(std::move(cl)) {}
-
-  void Run() OVERRIDE {
-    cl_.Run();
+struct ClosureTask {
+  void operator()() {
+    cl.Run();
   }
 
- private:
-  Closure cl_;
+  Closure cl;
 };
 
 ////////////////////////////////////////////////////////
@@ -89,7 +85,8 @@ ThreadPoolBuilder::ThreadPoolBuilder(string name)
       min_threads_(0),
       max_threads_(base::NumCPUs()),
       max_queue_size_(std::numeric_limits<int>::max()),
-      idle_timeout_(MonoDelta::FromMilliseconds(500)) {}
+      idle_timeout_(MonoDelta::FromMilliseconds(500)),
+      num_shards_(1) {}
 
 ThreadPoolBuilder& ThreadPoolBuilder::set_trace_metric_prefix(const string& prefix) {
   trace_metric_prefix_ = prefix;
@@ -123,6 +120,17 @@ ThreadPoolBuilder& ThreadPoolBuilder::set_metrics(ThreadPoolMetrics metrics) {
   return *this;
 }
 
+ThreadPoolBuilder& ThreadPoolBuilder::set_num_shards(int num_shards) {
+  CHECK_GT(num_shards, 0);
+  num_shards_ = num_shards;
+  return *this;
+}
+
+ThreadPoolBuilder& ThreadPoolBuilder::set_shard_cpus(vector<vector<int>> shard_cpus) {
+  shard_cpus_ = std::move(shard_cpus);
+  return *this;
+}
+
 Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
   pool->reset(new ThreadPool(*this));
   RETURN_NOT_OK((*pool)->Init());
@@ -134,13 +142,15 @@ Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
 ////////////////////////////////////////////////////////
 
 ThreadPoolToken::ThreadPoolToken(ThreadPool* pool,
+                                 ThreadPool::Shard* shard,
                                  ThreadPool::ExecutionMode mode,
                                  ThreadPoolMetrics metrics)
     : mode_(mode),
       metrics_(std::move(metrics)),
       pool_(pool),
+      shard_(shard),
       state_(State::IDLE),
-      not_running_cond_(&pool->lock_),
+      not_running_cond_(&shard->lock),
       active_threads_(0) {
 }
 
@@ -150,19 +160,15 @@ ThreadPoolToken::~ThreadPoolToken() {
 }
 
 Status ThreadPoolToken::SubmitClosure(Closure c) {
-  return Submit(std::make_shared<ClosureRunnable>(std::move(c)));
-}
-
-Status ThreadPoolToken::SubmitFunc(boost::function<void()> f) {
-  return Submit(std::make_shared<FunctionRunnable>(std::move(f)));
+  return pool_->DoSubmit(SmallFunction(ClosureTask{ std::move(c) }), this);
 }
 
 Status ThreadPoolToken::Submit(shared_ptr<Runnable> r) {
-  return pool_->DoSubmit(std::move(r), this);
+  return pool_->DoSubmit(SmallFunction(RunnableTask{ std::move(r) }), this);
 }
 
 void ThreadPoolToken::Shutdown() {
-  MutexLock unique_lock(pool_->lock_);
+  MutexLock unique_lock(shard_->lock);
   pool_->CheckNotPoolThreadUnlocked();
 
   // Clear the queue under the lock, but defer the releasing of the tasks
@@ -170,7 +176,7 @@ void ThreadPoolToken::Shutdown() {
   // the ThreadPool. The task's destructors may acquire locks, etc, so this
   // also prevents lock inversions.
   std::deque<ThreadPool::Task> to_release = std::move(entries_);
-  pool_->total_queued_tasks_ -= to_release.size();
+  shard_->total_queued_tasks -= to_release.size();
 
   switch (state()) {
     case State::IDLE:
@@ -187,9 +193,9 @@ void ThreadPoolToken::Shutdown() {
       // Plus doing it this way (rather than switching to QUIESCING and waiting
       // for a worker thread to process the queue entry) helps retain state
       // transition symmetry with ThreadPool::Shutdown.
-      for (auto it = pool_->queue_.begin(); it != pool_->queue_.end();) {
+      for (auto it = shard_->queue.begin(); it != shard_->queue.end();) {
         if (*it == this) {
-          it = pool_->queue_.erase(it);
+          it = shard_->queue.erase(it);
         } else {
           it++;
         }
@@ -219,10 +225,11 @@ void ThreadPoolToken::Shutdown() {
       t.trace->Release();
     }
   }
+  pool_->TasksDone(to_release.size());
 }
 
 void ThreadPoolToken::Wait() {
-  MutexLock unique_lock(pool_->lock_);
+  MutexLock unique_lock(shard_->lock);
   pool_->CheckNotPoolThreadUnlocked();
   while (IsActive()) {
     not_running_cond_.Wait();
@@ -230,7 +237,7 @@ void ThreadPoolToken::Wait() {
 }
 
 bool ThreadPoolToken::WaitUntil(const MonoTime& until) {
-  MutexLock unique_lock(pool_->lock_);
+  MutexLock unique_lock(shard_->lock);
   pool_->CheckNotPoolThreadUnlocked();
   while (IsActive()) {
     if (!not_running_cond_.WaitUntil(until)) {
@@ -303,25 +310,66 @@ const char* ThreadPoolToken::StateToString(State s) {
   return "<cannot reach here>";
 }
 
+
 ////////////////////////////////////////////////////////
 // ThreadPool
 ////////////////////////////////////////////////////////
 
+__thread ThreadPool::Shard* ThreadPool::tls_shard_ = nullptr;
+
+ThreadPool::Shard::Shard(ThreadPool* pool, int index, int min_threads,
+                         int max_threads, int max_queue_size, vector<int> cpus)
+    : pool(pool),
+      index(index),
+      min_threads(min_threads),
+      max_threads(max_threads),
+      max_queue_size(max_queue_size),
+      cpus(std::move(cpus)),
+      status(Status::Uninitialized("The pool was not initialized.")),
+      no_threads_cond(&lock),
+      num_threads(0),
+      num_threads_pending_start(0),
+      active_threads(0),
+      total_queued_tasks(0) {
+}
+
 ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
   : name_(builder.name_),
-    min_threads_(builder.min_threads_),
-    max_threads_(builder.max_threads_),
-    max_queue_size_(builder.max_queue_size_),
     idle_timeout_(builder.idle_timeout_),
-    pool_status_(Status::Uninitialized("The pool was not initialized.")),
-    idle_cond_(&lock_),
-    no_threads_cond_(&lock_),
-    num_threads_(0),
-    num_threads_pending_start_(0),
-    active_threads_(0),
-    total_queued_tasks_(0),
-    tokenless_(NewToken(ExecutionMode::CONCURRENT)),
+    next_shard_(0),
+    unfinished_tasks_(0),
+    idle_cond_(&idle_lock_),
     metrics_(builder.metrics_) {
+  // Every shard needs a thread of its own to run its tasks.
+  const int num_shards = std::min(builder.num_shards_, builder.max_threads_);
+  for (int i = 0; i < num_shards; i++) {
+    // Split the limits evenly, the first shards taking the remainders.
+    auto share = [&](int total) {
+      return total / num_shards + (i < total % num_shards ? 1 : 0);
+    };
+    vector<int> cpus;
+    if (!builder.shard_cpus_.empty()) {
+      cpus = builder.shard_cpus_[i % builder.shard_cpus_.size()];
+      for (int cpu : cpus) {
+        if (cpu >= static_cast<int>(shard_by_cpu_.size())) {
+          shard_by_cpu_.resize(cpu + 1, -1);
+        }
+        // A CPU shared by several shards maps to the first of them.
+        if (shard_by_cpu_[cpu] < 0) {
+          shard_by_cpu_[cpu] = i;
+        }
+      }
+    }
+    shards_.emplace_back(new Shard(this, i,
+                                   share(builder.min_threads_),
+                                   share(builder.max_threads_),
+                                   share(builder.max_queue_size_),
+                                   std::move(cpus)));
+  }
+  for (auto& shard : shards_) {
+    shard->tokenless = NewTokenInShard(shard.get(), ExecutionMode::CONCURRENT, {});
+  }
+
   string prefix = !builder.trace_metric_prefix_.empty() ?
       builder.trace_metric_prefix_ : builder.name_;
 
@@ -334,95 +382,119 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
 }
 
 ThreadPool::~ThreadPool() {
-  // There should only be one live token: the one used in tokenless submission.
-  CHECK_EQ(1, tokens_.size()) << Substitute(
+  // There should only be one live token per shard: the one used in tokenless
+  // submission.
+  size_t num_tokens = 0;
+  for (const auto& shard : shards_) {
+    MutexLock l(shard->lock);
+    num_tokens += shard->tokens.size();
+  }
+  CHECK_EQ(shards_.size(), num_tokens) << Substitute(
       "Threadpool $0 destroyed with $1 allocated tokens",
-      name_, tokens_.size());
+      name_, num_tokens);
   Shutdown();
 }
 
 Status ThreadPool::Init() {
-  if (!pool_status_.IsUninitialized()) {
+  if (!shards_[0]->status.IsUninitialized()) {
     return Status::NotSupported("The thread pool is already initialized");
   }
-  pool_status_ = Status::OK();
-  num_threads_pending_start_ = min_threads_;
-  for (int i = 0; i < min_threads_; i++) {
-    Status status = CreateThread();
-    if (!status.ok()) {
-      Shutdown();
-      return status;
+  for (auto& shard : shards_) {
+    shard->status = Status::OK();
+    shard->num_threads_pending_start = shard->min_threads;
+  }
+  for (auto& shard : shards_) {
+    for (int i = 0; i < shard->min_threads; i++) {
+      Status status = CreateThread(shard.get());
+      if (!status.ok()) {
+        Shutdown();
+        return status;
+      }
     }
   }
   return Status::OK();
 }
 
 void ThreadPool::Shutdown() {
-  MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
 
-  // Note: this is the same error seen at submission if the pool is at
-  // capacity, so clients can't tell them apart. This isn't really a practical
-  // concern though because shutting down a pool typically requires clients to
-  // be quiesced first, so there's no danger of a client getting confused.
-  pool_status_ = Status::ServiceUnavailable("The pool has been shut down.");
-
-  // Clear the various queues under the lock, but defer the releasing
-  // of the tasks outside the lock, in case there are concurrent threads
+  // Clear the various queues under the locks, but defer the releasing
+  // of the tasks outside the locks, in case there are concurrent threads
   // wanting to access the ThreadPool. The task's destructors may acquire
   // locks, etc, so this also prevents lock inversions.
-  queue_.clear();
   std::deque<std::deque<Task>> to_release;
-  for (auto* t : tokens_) {
-    if (!t->entries_.empty()) {
-      to_release.emplace_back(std::move(t->entries_));
+  for (auto& shard : shards_) {
+    MutexLock l(shard->lock);
+
+    // Note: this is the same error seen at submission if the pool is at
+    // capacity, so clients can't tell them apart. This isn't really a practical
+    // concern though because shutting down a pool typically requires clients to
+    // be quiesced first, so there's no danger of a client getting confused.
+    shard->status = Status::ServiceUnavailable("The pool has been shut down.");
+
+    shard->queue.clear();
+    for (auto* t : shard->tokens) {
+      if (!t->entries_.empty()) {
+        to_release.emplace_back(std::move(t->entries_));
+      }
+      switch (t->state()) {
+        case ThreadPoolToken::State::IDLE:
+          // The token is idle; we can quiesce it immediately.
+          t->Transition(ThreadPoolToken::State::QUIESCED);
+          break;
+        case ThreadPoolToken::State::RUNNING:
+          // The token has tasks associated with it. If they're merely queued
+          // (i.e. there are no active threads), the tasks will have been removed
+          // above and we can quiesce immediately. Otherwise, we need to wait for
+          // the threads to finish.
+          t->Transition(t->active_threads_ > 0 ?
+              ThreadPoolToken::State::QUIESCING :
+              ThreadPoolToken::State::QUIESCED);
+          break;
+        default:
+          break;
+      }
     }
-    switch (t->state()) {
-      case ThreadPoolToken::State::IDLE:
-        // The token is idle; we can quiesce it immediately.
-        t->Transition(ThreadPoolToken::State::QUIESCED);
-        break;
-      case ThreadPoolToken::State::RUNNING:
-        // The token has tasks associated with it. If they're merely queued
-        // (i.e. there are no active threads), the tasks will have been removed
-        // above and we can quiesce immediately. Otherwise, we need to wait for
-        // the threads to finish.
-        t->Transition(t->active_threads_ > 0 ?
-            ThreadPoolToken::State::QUIESCING :
-            ThreadPoolToken::State::QUIESCED);
-        break;
-      default:
-        break;
+
+    // The queues are empty. Wake any sleeping worker threads. Some worker
+    // threads will exit immediately upon waking, while others will exit after
+    // they finish executing an outstanding task.
+    shard->total_queued_tasks = 0;
+    while (!shard->idle_threads.empty()) {
+      shard->idle_threads.front().not_empty.Signal();
+      shard->idle_threads.pop_front();
     }
   }
 
-  // The queues are empty. Wake any sleeping worker threads and wait for all
-  // of them to exit. Some worker threads will exit immediately upon waking,
-  // while others will exit after they finish executing an outstanding task.
-  total_queued_tasks_ = 0;
-  while (!idle_threads_.empty()) {
-    idle_threads_.front().not_empty.Signal();
-    idle_threads_.pop_front();
-  }
-  while (num_threads_ + num_threads_pending_start_ > 0) {
-    no_threads_cond_.Wait();
+  // Wait for all the worker threads to exit. This only starts once every shard
+  // is shut down, as a thread may be finishing a task stolen from another shard.
+  for (auto& shard : shards_) {
+    MutexLock l(shard->lock);
+    while (shard->num_threads + shard->num_threads_pending_start > 0) {
+      shard->no_threads_cond.Wait();
+    }
   }
 
   // All the threads have exited. Check the state of each token.
-  for (auto* t : tokens_) {
-    DCHECK(t->state() == ThreadPoolToken::State::IDLE ||
-           t->state() == ThreadPoolToken::State::QUIESCED);
+  for (auto& shard : shards_) {
+    MutexLock l(shard->lock);
+    for (auto* t : shard->tokens) {
+      DCHECK(t->state() == ThreadPoolToken::State::IDLE ||
+             t->state() == ThreadPoolToken::State::QUIESCED);
+    }
   }
 
-  // Finally release the queued tasks, outside the lock.
-  unique_lock.Unlock();
+  // Finally release the queued tasks, outside the locks.
+  int64_t num_released = 0;
   for (auto& token : to_release) {
+    num_released += token.size();
     for (auto& t : token) {
       if (t.trace) {
         t.trace->Release();
       }
     }
   }
+  TasksDone(num_released);
 }
 
 unique_ptr<ThreadPoolToken> ThreadPool::NewToken(ExecutionMode mode) {
@@ -431,54 +503,101 @@ unique_ptr<ThreadPoolToken> ThreadPool::NewToken(ExecutionMode mode) {
 
 unique_ptr<ThreadPoolToken> ThreadPool::NewTokenWithMetrics(
     ExecutionMode mode, ThreadPoolMetrics metrics) {
-  MutexLock guard(lock_);
+  return NewTokenInShard(NextShard(), mode, std::move(metrics));
+}
+
+unique_ptr<ThreadPoolToken> ThreadPool::NewTokenForShard(
+    int shard, ExecutionMode mode, ThreadPoolMetrics metrics) {
+  return NewTokenInShard(shard < 0 ? NextShard() : shards_[shard % shards_.size()].get(),
+                         mode, std::move(metrics));
+}
+
+unique_ptr<ThreadPoolToken> ThreadPool::NewTokenInShard(
+    Shard* shard, ExecutionMode mode, ThreadPoolMetrics metrics) {
+  MutexLock guard(shard->lock);
   unique_ptr<ThreadPoolToken> t(new ThreadPoolToken(this,
+                                                    shard,
                                                     mode,
                                                     std::move(metrics)));
-  InsertOrDie(&tokens_, t.get());
+  InsertOrDie(&shard->tokens, t.get());
   return t;
 }
 
 void ThreadPool::ReleaseToken(ThreadPoolToken* t) {
-  MutexLock guard(lock_);
+  MutexLock guard(t->shard_->lock);
   CHECK(!t->IsActive()) << Substitute("Token with state $0 may not be released",
                                       ThreadPoolToken::StateToString(t->state()));
-  CHECK_EQ(1, tokens_.erase(t));
+  CHECK_EQ(1, t->shard_->tokens.erase(t));
 }
 
-Status ThreadPool::SubmitClosure(Closure c) {
-  return Submit(std::make_shared<ClosureRunnable>(std::move(c)));
+ThreadPool::Shard* ThreadPool::NextShard() {
+  if (shards_.size() == 1) {
+    return shards_[0].get();
+  }
+  return shards_[next_shard_.fetch_add(1, std::memory_order_relaxed) %
+                 shards_.size()].get();
 }
 
-Status ThreadPool::SubmitFunc(boost::function<void()> f) {
-  return Submit(std::make_shared<FunctionRunnable>(std::move(f)));
+ThreadPool::Shard* ThreadPool::LocalShard() {
+  if (!shard_by_cpu_.empty()) {
+    int cpu = GetCurrentCpu();
+    if (cpu >= 0 && cpu < static_cast<int>(shard_by_cpu_.size()) && shard_by_cpu_[cpu] >= 0) {
+      return shards_[shard_by_cpu_[cpu]].get();
+    }
+  }
+  return NextShard();
+}
+
+Status ThreadPool::SubmitClosure(Closure c) {
+  return SubmitTask(SmallFunction(ClosureTask{ std::move(c) }));
 }
 
 Status ThreadPool::Submit(shared_ptr<Runnable> r) {
-  return DoSubmit(std::move(r), tokenless_.get());
+  return SubmitTask(SmallFunction(RunnableTask{ std::move(r) }));
 }
 
-Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
+Status ThreadPool::SubmitTask(SmallFunction f) {
+  // Tasks submitted by a worker of the pool stay in the worker's shard.
+  Shard* shard = tls_shard_ && tls_shard_->pool == this ? tls_shard_ : LocalShard();
+  return DoSubmit(std::move(f), shard->tokenless.get());
+}
+
+Status ThreadPool::DoSubmit(SmallFunction f, ThreadPoolToken* token,
+                            const void* coalesce_key) {
   DCHECK(token);
   MonoTime submit_time = MonoTime::Now();
+  Shard* shard = token->shard_;
 
-  MutexLock guard(lock_);
-  if (PREDICT_FALSE(!pool_status_.ok())) {
-    return pool_status_;
+  MutexLock guard(shard->lock);
+  if (PREDICT_FALSE(!shard->status.ok())) {
+    return shard->status;
   }
 
   if (PREDICT_FALSE(!token->MaySubmitNewTasks())) {
     return Status::ServiceUnavailable("Thread pool token was shut down");
   }
 
+  // The queued duplicate will do the work of this task. 'f' is destroyed
+  // once the lock is released.
+  if (coalesce_key) {
+    for (const auto& t : token->entries_) {
+      if (t.coalesce_key == coalesce_key) {
+        return Status::OK();
+      }
+    }
+  }
+
   // Size limit check.
-  int64_t capacity_remaining = static_cast<int64_t>(max_threads_) - active_threads_ +
-                               static_cast<int64_t>(max_queue_size_) - total_queued_tasks_;
+  int64_t capacity_remaining = static_cast<int64_t>(shard->max_threads) -
+                               shard->active_threads +
+                               static_cast<int64_t>(shard->max_queue_size) -
+                               shard->total_queued_tasks;
   if (capacity_remaining < 1) {
     return Status::ServiceUnavailable(
         Substitute("Thread pool is at capacity ($0/$1 tasks running, $2/$3 tasks queued)",
-                   num_threads_ + num_threads_pending_start_, max_threads_,
-                   total_queued_tasks_, max_queue_size_));
+                   shard->num_threads + shard->num_threads_pending_start,
+                   shard->max_threads, shard->total_queued_tasks,
+                   shard->max_queue_size));
   }
 
   // Should we create another thread?
@@ -496,21 +615,23 @@ Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
   // created a thread we didn't really need. However, this race is unavoidable
   // and harmless.
   //
-  // Of course, we never create more than max_threads_ threads no matter what.
+  // Of course, we never create more than max_threads threads no matter what.
   int threads_from_this_submit =
       token->IsActive() && token->mode() == ExecutionMode::SERIAL ? 0 : 1;
-  int inactive_threads = num_threads_ + num_threads_pending_start_ - active_threads_;
-  int additional_threads = static_cast<int>(queue_.size())
+  int inactive_threads = shard->num_threads + shard->num_threads_pending_start -
+                         shard->active_threads;
+  int additional_threads = static_cast<int>(shard->queue.size())
                          + threads_from_this_submit
                          - inactive_threads;
   bool need_a_thread = false;
-  if (additional_threads > 0 && num_threads_ + num_threads_pending_start_ < max_threads_) {
+  if (additional_threads > 0 &&
+      shard->num_threads + shard->num_threads_pending_start < shard->max_threads) {
     need_a_thread = true;
-    num_threads_pending_start_++;
+    shard->num_threads_pending_start++;
   }
 
   Task task;
-  task.runnable = std::move(r);
+  task.func = std::move(f);
   task.trace = Trace::CurrentTrace();
   // Need to AddRef, since the thread which submitted the task may go away,
   // and we don't want the trace to be destructed while waiting in the queue.
@@ -518,20 +639,24 @@ Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
     task.trace->AddRef();
   }
   task.submit_time = submit_time;
+  task.coalesce_key = coalesce_key;
 
   // Add the task to the token's queue.
   ThreadPoolToken::State state = token->state();
   DCHECK(state == ThreadPoolToken::State::IDLE ||
          state == ThreadPoolToken::State::RUNNING);
   token->entries_.emplace_back(std::move(task));
+  bool queued_token = false;
   if (state == ThreadPoolToken::State::IDLE ||
       token->mode() == ExecutionMode::CONCURRENT) {
-    queue_.emplace_back(token);
+    shard->queue.emplace_back(token);
+    queued_token = true;
     if (state == ThreadPoolToken::State::IDLE) {
       token->Transition(ThreadPoolToken::State::RUNNING);
     }
   }
-  int length_at_submit = total_queued_tasks_++;
+  int length_at_submit = shard->total_queued_tasks++;
+  unfinished_tasks_++;
 
   // Wake up an idle thread for this task. Choosing the thread at the front of
   // the list ensures LIFO semantics as idling threads are also added to the front.
@@ -539,9 +664,11 @@ Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
   // If there are no idle threads, the new task remains on the queue and is
   // processed by an active thread (or a thread we're about to create) at some
   // point in the future.
-  if (!idle_threads_.empty()) {
-    idle_threads_.front().not_empty.Signal();
-    idle_threads_.pop_front();
+  bool woke_a_thread = false;
+  if (!shard->idle_threads.empty()) {
+    shard->idle_threads.front().not_empty.Signal();
+    shard->idle_threads.pop_front();
+    woke_a_thread = true;
   }
   guard.Unlock();
 
@@ -552,12 +679,18 @@ Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
     token->metrics_.queue_length_histogram->Increment(length_at_submit);
   }
 
+  // All the threads of the shard are busy: let an idle thread of another
+  // shard pick the task up rather than leaving it queued.
+  if (queued_token && !woke_a_thread && !need_a_thread && shards_.size() > 1) {
+    WakeUpThief(shard);
+  }
+
   if (need_a_thread) {
-    Status status = CreateThread();
+    Status status = CreateThread(shard);
     if (!status.ok()) {
       guard.Lock();
-      num_threads_pending_start_--;
-      if (num_threads_ + num_threads_pending_start_ == 0) {
+      shard->num_threads_pending_start--;
+      if (shard->num_threads + shard->num_threads_pending_start == 0) {
         // If we have no threads, we can't do any work.
         return status;
       }
@@ -573,17 +706,17 @@ Status ThreadPool::DoSubmit(shared_ptr<Runnable> r, ThreadPoolToken* token) {
 }
 
 void ThreadPool::Wait() {
-  MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
-  while (total_queued_tasks_ > 0 || active_threads_ > 0) {
+  MutexLock unique_lock(idle_lock_);
+  while (unfinished_tasks_ > 0) {
     idle_cond_.Wait();
   }
 }
 
 bool ThreadPool::WaitUntil(const MonoTime& until) {
-  MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
-  while (total_queued_tasks_ > 0 || active_threads_ > 0) {
+  MutexLock unique_lock(idle_lock_);
+  while (unfinished_tasks_ > 0) {
     if (!idle_cond_.WaitUntil(until)) {
       return false;
     }
@@ -595,37 +728,79 @@ bool ThreadPool::WaitFor(const MonoDelta& delta) {
   return WaitUntil(MonoTime::Now() + delta);
 }
 
-void ThreadPool::DispatchThread() {
-  MutexLock unique_lock(lock_);
-  InsertOrDie(&threads_, Thread::current_thread());
-  DCHECK_GT(num_threads_pending_start_, 0);
-  num_threads_++;
-  num_threads_pending_start_--;
-  // If we are one of the first 'min_threads_' to start, we must be
+void ThreadPool::TasksDone(int64_t count) {
+  // The waiters check 'unfinished_tasks_' under 'idle_lock_', so taking it
+  // before signaling is enough for them to never miss the wake up.
+  if (count > 0 && unfinished_tasks_.fetch_sub(count) == count) {
+    MutexLock l(idle_lock_);
+    idle_cond_.Broadcast();
+  }
+}
+
+int ThreadPool::num_threads() const {
+  int num_threads = 0;
+  for (const auto& shard : shards_) {
+    MutexLock l(shard->lock);
+    num_threads += shard->num_threads + shard->num_threads_pending_start;
+  }
+  return num_threads;
+}
+
+int ThreadPool::num_active_threads() const {
+  int active_threads = 0;
+  for (const auto& shard : shards_) {
+    MutexLock l(shard->lock);
+    active_threads += shard->active_threads;
+  }
+  return active_threads;
+}
+
+void ThreadPool::DispatchThread(Shard* shard) {
+  tls_shard_ = shard;
+  if (!shard->cpus.empty()) {
+    WARN_NOT_OK(SetCurrentThreadCpuAffinity(shard->cpus),
+                Substitute("$0: could not restrict worker thread to its shard's CPUs", name_));
+  }
+  MutexLock unique_lock(shard->lock);
+  DCHECK_GT(shard->num_threads_pending_start, 0);
+  shard->num_threads++;
+  shard->num_threads_pending_start--;
+  // If we are one of the first 'min_threads' to start, we must be
   // a "permanent" thread.
-  bool permanent = num_threads_ <= min_threads_;
+  bool permanent = shard->num_threads <= shard->min_threads;
 
-  // Owned by this worker thread and added/removed from idle_threads_ as needed.
-  IdleThread me(&lock_);
+  // Owned by this worker thread and added/removed from idle_threads as needed.
+  IdleThread me(&shard->lock);
 
   while (true) {
     // Note: Status::Aborted() is used to indicate normal shutdown.
-    if (!pool_status_.ok()) {
-      VLOG(2) << "DispatchThread exiting: " << pool_status_.ToString();
+    if (!shard->status.ok()) {
+      VLOG(2) << "DispatchThread exiting: " << shard->status.ToString();
       break;
     }
 
-    if (queue_.empty()) {
+    if (shard->queue.empty() && shards_.size() > 1) {
+      // Look for work in the other shards before going idle. Anything may
+      // have happened to this shard in the meantime, so start over after.
+      unique_lock.Unlock();
+      bool stolen = StealAndRunTask(shard);
+      unique_lock.Lock();
+      if (stolen || !shard->queue.empty() || !shard->status.ok()) {
+        continue;
+      }
+    }
+
+    if (shard->queue.empty()) {
       // There's no work to do, let's go idle.
       //
       // Note: if FIFO behavior is desired, it's as simple as changing this to push_back().
-      idle_threads_.push_front(me);
+      shard->idle_threads.push_front(me);
       SCOPED_CLEANUP({
         // For some wake ups (i.e. Shutdown or DoSubmit) this thread is
         // guaranteed to be unlinked after being awakened. In others (i.e.
         // spurious wake-up or Wait timeout), it'll still be linked.
         if (me.is_linked()) {
-          idle_threads_.erase(idle_threads_.iterator_to(me));
+          shard->idle_threads.erase(shard->idle_threads.iterator_to(me));
         }
       });
       if (permanent) {
@@ -638,7 +813,7 @@ void ThreadPool::DispatchThread() {
           // brief period during which another thread may actually grab the internal mutex
           // protecting the state, signal, and release again before we get the mutex. So,
           // we'll recheck the empty queue case regardless.
-          if (queue_.empty()) {
+          if (shard->queue.empty()) {
             VLOG(3) << "Releasing worker thread from pool " << name_ << " after "
                     << idle_timeout_.ToMilliseconds() << "ms of idle time.";
             break;
@@ -649,113 +824,157 @@ void ThreadPool::DispatchThread() {
     }
 
     // Get the next token and task to execute.
-    ThreadPoolToken* token = queue_.front();
-    queue_.pop_front();
-    DCHECK_EQ(ThreadPoolToken::State::RUNNING, token->state());
-    DCHECK(!token->entries_.empty());
-    Task task = std::move(token->entries_.front());
-    token->entries_.pop_front();
-    token->active_threads_++;
-    --total_queued_tasks_;
-    ++active_threads_;
-
+    ThreadPoolToken* token;
+    Task task = TakeTask(shard, &token);
     unique_lock.Unlock();
+    RunTask(&task, token);
+    unique_lock.Lock();
+    FinishTask(shard, token);
+  }
 
-    // Release the reference which was held by the queued item.
-    ADOPT_TRACE(task.trace);
-    if (task.trace) {
-      task.trace->Release();
-    }
+  // It's important that we hold the lock between exiting the loop and dropping
+  // num_threads. Otherwise it's possible someone else could come along here
+  // and add a new task just as the last running thread is about to exit.
+  CHECK(unique_lock.OwnsLock());
 
-    // Update metrics
-    MonoTime now(MonoTime::Now());
-    int64_t queue_time_us = (now - task.submit_time).ToMicroseconds();
-    TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
-    if (metrics_.queue_time_us_histogram) {
-      metrics_.queue_time_us_histogram->Increment(queue_time_us);
-    }
-    if (token->metrics_.queue_time_us_histogram) {
-      token->metrics_.queue_time_us_histogram->Increment(queue_time_us);
-    }
+  shard->num_threads--;
+  if (shard->num_threads + shard->num_threads_pending_start == 0) {
+    shard->no_threads_cond.Broadcast();
 
-    // Execute the task
-    {
-      MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
-      MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
+    // Sanity check: if we're the last thread exiting, the queue ought to be
+    // empty. Otherwise it will never get processed.
+    CHECK(shard->queue.empty());
+    DCHECK_EQ(0, shard->total_queued_tasks);
+  }
+}
 
-      task.runnable->Run();
+ThreadPool::Task ThreadPool::TakeTask(Shard* shard, ThreadPoolToken** token) {
+  ThreadPoolToken* t = shard->queue.front();
+  shard->queue.pop_front();
+  DCHECK_EQ(ThreadPoolToken::State::RUNNING, t->state());
+  DCHECK(!t->entries_.empty());
+  Task task = std::move(t->entries_.front());
+  t->entries_.pop_front();
+  t->active_threads_++;
+  --shard->total_queued_tasks;
+  ++shard->active_threads;
+  *token = t;
+  return task;
+}
+
+void ThreadPool::RunTask(Task* task, ThreadPoolToken* token) {
+  // Release the reference which was held by the queued item.
+  ADOPT_TRACE(task->trace);
+  if (task->trace) {
+    task->trace->Release();
+  }
 
-      int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
-      int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
+  // Update metrics
+  MonoTime now(MonoTime::Now());
+  int64_t queue_time_us = (now - task->submit_time).ToMicroseconds();
+  TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
+  if (metrics_.queue_time_us_histogram) {
+    metrics_.queue_time_us_histogram->Increment(queue_time_us);
+  }
+  if (token->metrics_.queue_time_us_histogram) {
+    token->metrics_.queue_time_us_histogram->Increment(queue_time_us);
+  }
 
-      if (metrics_.run_time_us_histogram) {
-        metrics_.run_time_us_histogram->Increment(wall_us);
-      }
-      if (token->metrics_.run_time_us_histogram) {
-        token->metrics_.run_time_us_histogram->Increment(wall_us);
-      }
-      TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
-      TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
-    }
-    // Destruct the task while we do not hold the lock.
-    //
-    // The task's destructor may be expensive if it has a lot of bound
-    // objects, and we don't want to block submission of the threadpool.
-    // In the worst case, the destructor might even try to do something
-    // with this threadpool, and produce a deadlock.
-    task.runnable.reset();
-    unique_lock.Lock();
+  // Execute the task
+  {
+    MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
+    MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
 
-    // Possible states:
-    // 1. The token was shut down while we ran its task. Transition to QUIESCED.
-    // 2. The token has no more queued tasks. Transition back to IDLE.
-    // 3. The token has more tasks. Requeue it and transition back to RUNNABLE.
-    ThreadPoolToken::State state = token->state();
-    DCHECK(state == ThreadPoolToken::State::RUNNING ||
-           state == ThreadPoolToken::State::QUIESCING);
-    if (--token->active_threads_ == 0) {
-      if (state == ThreadPoolToken::State::QUIESCING) {
-        DCHECK(token->entries_.empty());
-        token->Transition(ThreadPoolToken::State::QUIESCED);
-      } else if (token->entries_.empty()) {
-        token->Transition(ThreadPoolToken::State::IDLE);
-      } else if (token->mode() == ExecutionMode::SERIAL) {
-        queue_.emplace_back(token);
-      }
+    task->func();
+
+    int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
+    int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
+
+    if (metrics_.run_time_us_histogram) {
+      metrics_.run_time_us_histogram->Increment(wall_us);
     }
-    if (--active_threads_ == 0) {
-      idle_cond_.Broadcast();
+    if (token->metrics_.run_time_us_histogram) {
+      token->metrics_.run_time_us_histogram->Increment(wall_us);
     }
+    TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
+    TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
   }
+  // Destruct the task while we do not hold the lock.
+  //
+  // The task's destructor may be expensive if it has a lot of bound
+  // objects, and we don't want to block submission of the threadpool.
+  // In the worst case, the destructor might even try to do something
+  // with this threadpool, and produce a deadlock.
+  task->func.reset();
+}
+
+void ThreadPool::FinishTask(Shard* shard, ThreadPoolToken* token) {
+  // Possible states:
+  // 1. The token was shut down while we ran its task. Transition to QUIESCED.
+  // 2. The token has no more queued tasks. Transition back to IDLE.
+  // 3. The token has more tasks. Requeue it and transition back to RUNNABLE.
+  ThreadPoolToken::State state = token->state();
+  DCHECK(state == ThreadPoolToken::State::RUNNING ||
+         state == ThreadPoolToken::State::QUIESCING);
+  if (--token->active_threads_ == 0) {
+    if (state == ThreadPoolToken::State::QUIESCING) {
+      DCHECK(token->entries_.empty());
+      token->Transition(ThreadPoolToken::State::QUIESCED);
+    } else if (token->entries_.empty()) {
+      token->Transition(ThreadPoolToken::State::IDLE);
+    } else if (token->mode() == ExecutionMode::SERIAL) {
+      shard->queue.emplace_back(token);
+    }
+  }
+  --shard->active_threads;
+  TasksDone(1);
+}
 
-  // It's important that we hold the lock between exiting the loop and dropping
-  // num_threads_. Otherwise it's possible someone else could come along here
-  // and add a new task just as the last running thread is about to exit.
-  CHECK(unique_lock.OwnsLock());
-
-  CHECK_EQ(threads_.erase(Thread::current_thread()), 1);
-  num_threads_--;
-  if (num_threads_ + num_threads_pending_start_ == 0) {
-    no_threads_cond_.Broadcast();
+bool ThreadPool::StealAndRunTask(Shard* home) {
+  // A SERIAL token is only ever queued once in its shard, so a stolen task
+  // still runs strictly after the previous tasks of its token.
+  for (size_t i = 1; i < shards_.size(); i++) {
+    Shard* victim = shards_[(home->index + i) % shards_.size()].get();
+    if (!victim->lock.TryAcquire()) {
+      continue;
+    }
+    MutexLock l(victim->lock, MutexLock::AlreadyAcquired());
+    if (!victim->status.ok() || victim->queue.empty()) {
+      continue;
+    }
+    ThreadPoolToken* token;
+    Task task = TakeTask(victim, &token);
+    l.Unlock();
+    RunTask(&task, token);
+    l.Lock();
+    FinishTask(victim, token);
+    return true;
+  }
+  return false;
+}
 
-    // Sanity check: if we're the last thread exiting, the queue ought to be
-    // empty. Otherwise it will never get processed.
-    CHECK(queue_.empty());
-    DCHECK_EQ(0, total_queued_tasks_);
+void ThreadPool::WakeUpThief(Shard* home) {
+  for (size_t i = 1; i < shards_.size(); i++) {
+    Shard* shard = shards_[(home->index + i) % shards_.size()].get();
+    MutexLock l(shard->lock);
+    if (!shard->idle_threads.empty()) {
+      shard->idle_threads.front().not_empty.Signal();
+      shard->idle_threads.pop_front();
+      return;
+    }
   }
 }
 
-Status ThreadPool::CreateThread() {
+Status ThreadPool::CreateThread(Shard* shard) {
   return kudu::Thread::Create("thread pool", strings::Substitute("$0 [worker]", name_),
-                              &ThreadPool::DispatchThread, this, nullptr);
+                              &ThreadPool::DispatchThread, this, shard, nullptr);
 }
 
 void ThreadPool::CheckNotPoolThreadUnlocked() {
-  Thread* current = Thread::current_thread();
-  if (ContainsKey(threads_, current)) {
+  if (tls_shard_ && tls_shard_->pool == this) {
     LOG(FATAL) << Substitute("Thread belonging to thread pool '$0' with "
         "name '$1' called pool function that would result in deadlock",
-        name_, current->name());
+        name_, Thread::current_thread()->name());
   }
 }
 
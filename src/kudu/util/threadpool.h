@@ -17,14 +17,19 @@
 #ifndef KUDU_UTIL_THREAD_POOL_H
 #define KUDU_UTIL_THREAD_POOL_H
 
+#include <atomic>
+#include <cstdint>
 #include <deque>
 #include <iosfwd>
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/list_hook.hpp>
+#include <glog/logging.h>
 #include <gtest/gtest_prod.h>
 
 #include "kudu/gutil/callback.h"
@@ -36,6 +41,7 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
+#include "kudu/util/small_function.h"
 #include "kudu/util/status.h"
 
 namespace boost {
@@ -114,6 +120,21 @@ struct ThreadPoolMetrics {
 // metrics: Histograms, counters, etc. to update on various threadpool events.
 //    Default: not set.
 //
+// num_shards: Number of scheduling shards to split the pool into. Each shard
+//    has its own lock, queue and worker threads, with max_threads,
+//    min_threads and max_queue_size split among the shards, and the tokens
+//    are spread over the shards. Workers with nothing to run in their shard
+//    steal the tasks queued in the other shards. This spares pools shared by
+//    many tokens from contending on a single lock, at the cost of the FIFO
+//    order between tasks queued in different shards. Capped at max_threads.
+//    Default: 1.
+//
+// shard_cpus: The CPUs the worker threads of each shard are restricted to,
+//    e.g. those of a NUMA node, with shard i taking the i-th set, wrapping
+//    around. Tasks submitted without a token then go to the shard of the CPU
+//    the submitter runs on, if any, so that they run on its node.
+//    Default: not set, threads run on any CPU.
+//
 class ThreadPoolBuilder {
  public:
   explicit ThreadPoolBuilder(std::string name);
@@ -126,6 +147,8 @@ class ThreadPoolBuilder {
   ThreadPoolBuilder& set_max_queue_size(int max_queue_size);
   ThreadPoolBuilder& set_idle_timeout(const MonoDelta& idle_timeout);
   ThreadPoolBuilder& set_metrics(ThreadPoolMetrics metrics);
+  ThreadPoolBuilder& set_num_shards(int num_shards);
+  ThreadPoolBuilder& set_shard_cpus(std::vector<std::vector<int>> shard_cpus);
 
   // Instantiate a new ThreadPool with the existing builder arguments.
   Status Build(gscoped_ptr<ThreadPool>* pool) const;
@@ -139,6 +162,8 @@ class ThreadPoolBuilder {
   int max_queue_size_;
   MonoDelta idle_timeout_;
   ThreadPoolMetrics metrics_;
+  int num_shards_;
+  std::vector<std::vector<int>> shard_cpus_;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadPoolBuilder);
 };
@@ -164,6 +189,11 @@ class ThreadPoolBuilder {
 // from starving one another. However, tokenless (and CONCURRENT token-based)
 // tasks can starve SERIAL token-based tasks.
 //
+// A pool built with several shards (see ThreadPoolBuilder) applies the above
+// within each shard, and a token's tasks are always queued in its shard. An
+// idle worker may run the tasks queued in another shard, but the tasks of a
+// SERIAL token still run one at a time and in order.
+//
 // Usage Example:
 //    static void Func(int n) { ... }
 //    class Task : public Runnable { ... }
@@ -193,8 +223,11 @@ class ThreadPool {
   // Submits a function using the kudu Closure system.
   Status SubmitClosure(Closure c) WARN_UNUSED_RESULT;
 
-  // Submits a function bound using boost::bind(&FuncName, args...).
-  Status SubmitFunc(boost::function<void()> f) WARN_UNUSED_RESULT;
+  // Submits a callable taking no argument, e.g. a lambda or a function bound
+  // using boost::bind(&FuncName, args...). Small callables are queued without
+  // any heap allocation (see SmallFunction).
+  template <class F>
+  Status SubmitFunc(F f) WARN_UNUSED_RESULT;
 
   // Submits a Runnable class.
   Status Submit(std::shared_ptr<Runnable> r) WARN_UNUSED_RESULT;
@@ -229,12 +262,22 @@ class ThreadPool {
   std::unique_ptr<ThreadPoolToken> NewTokenWithMetrics(ExecutionMode mode,
                                                        ThreadPoolMetrics metrics);
 
+  // Like NewTokenWithMetrics(), but queues the tasks of the token in shard
+  // 'shard' modulo the number of shards, e.g. so that the tokens of a tablet
+  // in several pools built with the same 'shard_cpus' run on the same NUMA
+  // node. A negative 'shard' picks one like NewToken() does.
+  std::unique_ptr<ThreadPoolToken> NewTokenForShard(int shard,
+                                                    ExecutionMode mode,
+                                                    ThreadPoolMetrics metrics = {});
+
+  // Returns the number of scheduling shards of the pool.
+  int num_shards() const {
+    return shards_.size();
+  }
+
   // Return the number of threads currently running (or in the process of starting up)
   // for this thread pool.
-  int num_threads() const {
-    MutexLock l(lock_);
-    return num_threads_ + num_threads_pending_start_;
-  }
+  int num_threads() const;
 
  private:
   FRIEND_TEST(ThreadPoolTest, TestThreadPoolWithNoMinimum);
@@ -245,11 +288,93 @@ class ThreadPool {
 
   // Client-provided task to be executed by this pool.
   struct Task {
-    std::shared_ptr<Runnable> runnable;
+    SmallFunction func;
     Trace* trace;
 
     // Time at which the entry was submitted to the pool.
     MonoTime submit_time;
+
+    // Key of the task for ThreadPoolToken::SubmitCoalesced(), or null.
+    const void* coalesce_key;
+  };
+
+  // List of all threads currently waiting for work.
+  //
+  // A thread is added to the front of the list when it goes idle and is
+  // removed from the front and signaled when new work arrives. This produces a
+  // LIFO usage pattern that is more efficient than idling on a single
+  // ConditionVariable (which yields FIFO semantics).
+  struct IdleThread : public boost::intrusive::list_base_hook<> {
+    explicit IdleThread(Mutex* m)
+        : not_empty(m) {}
+
+    // Condition variable for "queue is not empty". Waiters wake up when a new
+    // task is queued.
+    ConditionVariable not_empty;
+
+    DISALLOW_COPY_AND_ASSIGN(IdleThread);
+  };
+
+  // A scheduling shard of the pool: a share of its threads along with the
+  // queue of the tokens they run tasks from. A pool built with a single shard
+  // behaves exactly like an unsharded pool.
+  //
+  // All the mutable members are protected by 'lock'.
+  struct Shard {
+    Shard(ThreadPool* pool, int index, int min_threads, int max_threads,
+          int max_queue_size, std::vector<int> cpus);
+
+    ThreadPool* const pool;
+    const int index;
+    const int min_threads;
+    const int max_threads;
+    const int max_queue_size;
+
+    // The CPUs the threads of the shard run on, or empty for any.
+    const std::vector<int> cpus;
+
+    // Overall status of the shard. Set to an error when the pool is shut down.
+    Status status;
+
+    // Synchronizes the members of the shard, the state of its tokens and all
+    // of its condition variables.
+    mutable Mutex lock;
+
+    // Condition variable for "shard has no threads". Waiters wake up when
+    // num_threads and num_threads_pending_start are both 0.
+    ConditionVariable no_threads_cond;
+
+    // Number of threads currently running.
+    int num_threads;
+
+    // Number of threads which are in the process of starting.
+    // When these threads start, they will decrement this counter and
+    // accordingly increment 'num_threads'.
+    int num_threads_pending_start;
+
+    // Number of threads currently executing client tasks queued in this
+    // shard, including threads of other shards which stole them.
+    int active_threads;
+
+    // Total number of client tasks queued, either directly (queue) or
+    // indirectly (tokens).
+    int total_queued_tasks;
+
+    // All allocated tokens of the shard.
+    std::unordered_set<ThreadPoolToken*> tokens;
+
+    // FIFO of tokens from which tasks should be executed. Does not own the
+    // tokens; they are owned by clients and are removed from the FIFO on shutdown.
+    std::deque<ThreadPoolToken*> queue;
+
+    // Threads of the shard currently waiting for work.
+    boost::intrusive::list<IdleThread> idle_threads; // NOLINT(build/include_what_you_use)
+
+    // ExecutionMode::CONCURRENT token used by the pool for tokenless
+    // submission to this shard.
+    std::unique_ptr<ThreadPoolToken> tokenless;
+
+    DISALLOW_COPY_AND_ASSIGN(Shard);
   };
 
   // Creates a new thread pool using a builder.
@@ -258,109 +383,100 @@ class ThreadPool {
   // Initializes the thread pool by starting the minimum number of threads.
   Status Init();
 
-  // Dispatcher responsible for dequeueing and executing the tasks
-  void DispatchThread();
+  // Dispatcher responsible for dequeueing and executing the tasks of 'shard',
+  // and those of the other shards while 'shard' has nothing queued.
+  void DispatchThread(Shard* shard);
 
-  // Create new thread.
+  // Create new thread in 'shard'.
   //
-  // REQUIRES: caller has incremented 'num_threads_pending_start_' ahead of this call.
-  // NOTE: For performance reasons, lock_ should not be held.
-  Status CreateThread();
+  // REQUIRES: caller has incremented 'num_threads_pending_start' of the
+  // shard ahead of this call.
+  // NOTE: For performance reasons, the shard's lock should not be held.
+  Status CreateThread(Shard* shard);
 
   // Aborts if the current thread is a member of this thread pool.
   void CheckNotPoolThreadUnlocked();
 
-  // Submits a task to be run via token.
-  Status DoSubmit(std::shared_ptr<Runnable> r, ThreadPoolToken* token);
+  // Submits a task to be run without a token.
+  Status SubmitTask(SmallFunction f);
+
+  // Submits a task to be run via token. If 'coalesce_key' isn't null and a
+  // task with the same key is still queued to the token, 'f' is dropped.
+  Status DoSubmit(SmallFunction f, ThreadPoolToken* token,
+                  const void* coalesce_key = nullptr);
+
+  // Allocates a new token in 'shard'.
+  std::unique_ptr<ThreadPoolToken> NewTokenInShard(Shard* shard,
+                                                   ExecutionMode mode,
+                                                   ThreadPoolMetrics metrics);
 
   // Releases token 't' and invalidates it.
   void ReleaseToken(ThreadPoolToken* t);
 
-  const std::string name_;
-  const int min_threads_;
-  const int max_threads_;
-  const int max_queue_size_;
-  const MonoDelta idle_timeout_;
+  // Returns the shard the next token or tokenless task should go to.
+  Shard* NextShard();
 
-  // Overall status of the pool. Set to an error when the pool is shut down.
+  // Returns the shard whose threads run on the CPU of the calling thread, or
+  // NextShard() if there is none.
+  Shard* LocalShard();
+
+  // Takes the next task queued in 'shard', accounting for it as running.
   //
-  // Protected by 'lock_'.
-  Status pool_status_;
+  // REQUIRES: the shard's lock is held and its queue is not empty.
+  Task TakeTask(Shard* shard, ThreadPoolToken** token);
 
-  // Synchronizes many of the members of the pool and all of its
-  // condition variables.
-  mutable Mutex lock_;
+  // Runs 'task' of 'token'. Must be called without any lock held.
+  void RunTask(Task* task, ThreadPoolToken* token);
 
-  // Condition variable for "pool is idling". Waiters wake up when
-  // active_threads_ reaches zero.
-  ConditionVariable idle_cond_;
+  // Accounts for the end of a task of 'token' taken from 'shard' by
+  // TakeTask().
+  //
+  // REQUIRES: the shard's lock is held.
+  void FinishTask(Shard* shard, ThreadPoolToken* token);
 
-  // Condition variable for "pool has no threads". Waiters wake up when
-  // num_threads_ and num_pending_threads_ are both 0.
-  ConditionVariable no_threads_cond_;
+  // Runs a task queued in a shard other than 'home', if one can be found
+  // without contending on the other shards' locks. Returns true if a task
+  // was run. Must be called without any lock held.
+  bool StealAndRunTask(Shard* home);
 
-  // Number of threads currently running.
-  //
-  // Protected by lock_.
-  int num_threads_;
+  // Wakes up an idle thread of a shard other than 'home', so that it steals
+  // the task just queued in 'home'. Must be called without any lock held.
+  void WakeUpThief(Shard* home);
 
-  // Number of threads which are in the process of starting.
-  // When these threads start, they will decrement this counter and
-  // accordingly increment 'num_threads_'.
-  //
-  // Protected by lock_.
-  int num_threads_pending_start_;
+  // Accounts for 'count' submitted tasks which have either run or been
+  // dropped, waking up the waiters of Wait() once none is left.
+  void TasksDone(int64_t count);
 
-  // Number of threads currently running and executing client tasks.
-  //
-  // Protected by lock_.
-  int active_threads_;
+  // Returns the number of threads executing client tasks, across shards.
+  int num_active_threads() const;
 
-  // Total number of client tasks queued, either directly (queue_) or
-  // indirectly (tokens_).
-  //
-  // Protected by lock_.
-  int total_queued_tasks_;
+  const std::string name_;
+  const MonoDelta idle_timeout_;
 
-  // All allocated tokens.
-  //
-  // Protected by lock_.
-  std::unordered_set<ThreadPoolToken*> tokens_;
+  // The scheduling shards of the pool.
+  std::vector<std::unique_ptr<Shard>> shards_;
 
-  // FIFO of tokens from which tasks should be executed. Does not own the
-  // tokens; they are owned by clients and are removed from the FIFO on shutdown.
-  //
-  // Protected by lock_.
-  std::deque<ThreadPoolToken*> queue_;
+  // Used to spread the tokens and the tokenless tasks over the shards.
+  std::atomic<uint32_t> next_shard_;
 
-  // Pointers to all running threads. Raw pointers are safe because a Thread
-  // may only go out of scope after being removed from threads_.
-  //
-  // Protected by lock_.
-  std::unordered_set<Thread*> threads_;
+  // The shard whose threads run on each CPU, indexed by CPU, or -1 for CPUs
+  // no shard is restricted to. Empty unless the pool was built with
+  // 'shard_cpus'.
+  std::vector<int> shard_by_cpu_;
 
-  // List of all threads currently waiting for work.
-  //
-  // A thread is added to the front of the list when it goes idle and is
-  // removed from the front and signaled when new work arrives. This produces a
-  // LIFO usage pattern that is more efficient than idling on a single
-  // ConditionVariable (which yields FIFO semantics).
-  //
-  // Protected by lock_.
-  struct IdleThread : public boost::intrusive::list_base_hook<> {
-    explicit IdleThread(Mutex* m)
-        : not_empty(m) {}
+  // Number of tasks submitted to the pool which have neither run nor been
+  // dropped yet.
+  std::atomic<int64_t> unfinished_tasks_;
 
-    // Condition variable for "queue is not empty". Waiters wake up when a new
-    // task is queued.
-    ConditionVariable not_empty;
+  // Protects nothing but the wait on 'idle_cond_'.
+  Mutex idle_lock_;
 
-    DISALLOW_COPY_AND_ASSIGN(IdleThread);
-  };
-  boost::intrusive::list<IdleThread> idle_threads_; // NOLINT(build/include_what_you_use)
+  // Condition variable for "pool is idling". Waiters wake up when
+  // unfinished_tasks_ reaches zero.
+  ConditionVariable idle_cond_;
 
-  // ExecutionMode::CONCURRENT token used by the pool for tokenless submission.
-  std::unique_ptr<ThreadPoolToken> tokenless_;
+  // The shard the current thread is a worker of, if any.
+  static __thread Shard* tls_shard_;
 
   // Metrics for the entire thread pool.
   const ThreadPoolMetrics metrics_;
@@ -375,8 +491,8 @@ class ThreadPool {
 // Entry point for token-based task submission and blocking for a particular
 // thread pool. Tokens can only be created via ThreadPool::NewToken().
 //
-// All functions are thread-safe. Mutable members are protected via the
-// ThreadPool's lock.
+// All functions are thread-safe. Mutable members are protected via the lock
+// of the ThreadPool's shard the token belongs to.
 class ThreadPoolToken {
  public:
   // Destroys the token.
@@ -388,8 +504,23 @@ class ThreadPoolToken {
   // Submits a function using the kudu Closure system.
   Status SubmitClosure(Closure c) WARN_UNUSED_RESULT;
 
-  // Submits a function bound using boost::bind(&FuncName, args...).
-  Status SubmitFunc(boost::function<void()> f) WARN_UNUSED_RESULT;
+  // Submits a callable taking no argument, e.g. a lambda or a function bound
+  // using boost::bind(&FuncName, args...). Small callables are queued without
+  // any heap allocation (see SmallFunction).
+  template <class F>
+  Status SubmitFunc(F f) WARN_UNUSED_RESULT;
+
+  // Like SubmitFunc(), but drops 'f' if a task submitted with the same 'key'
+  // is still queued to the token, i.e. isn't running yet. This is meant for
+  // idempotent tasks like "send the next request": the queued task covers for
+  // the dropped one as it hasn't run yet. 'key' must not be null, and is
+  // typically the address of the object the task works on: it must not be
+  // reused for other tasks while such a task may still be queued.
+  //
+  // Finding a queued duplicate is linear in the number of queued tasks of
+  // the token.
+  template <class F>
+  Status SubmitCoalesced(const void* key, F f) WARN_UNUSED_RESULT;
 
   // Submits a Runnable class.
   Status Submit(std::shared_ptr<Runnable> r) WARN_UNUSED_RESULT;
@@ -451,8 +582,10 @@ class ThreadPoolToken {
 
   // Constructs a new token.
   //
-  // The token may not outlive its thread pool ('pool').
+  // The token may not outlive its thread pool ('pool'), and its tasks are
+  // queued in 'shard' of the pool.
   ThreadPoolToken(ThreadPool* pool,
+                  ThreadPool::Shard* shard,
                   ThreadPool::ExecutionMode mode,
                   ThreadPoolMetrics metrics);
 
@@ -484,6 +617,10 @@ class ThreadPoolToken {
   // Pointer to the token's thread pool.
   ThreadPool* pool_;
 
+  // The shard of the pool the token's tasks are queued in. Its lock protects
+  // the mutable members of the token.
+  ThreadPool::Shard* shard_;
+
   // Token state machine.
   State state_;
 
@@ -501,5 +638,21 @@ class ThreadPoolToken {
   DISALLOW_COPY_AND_ASSIGN(ThreadPoolToken);
 };
 
+template <class F>
+Status ThreadPool::SubmitFunc(F f) {
+  return SubmitTask(SmallFunction(std::move(f)));
+}
+
+template <class F>
+Status ThreadPoolToken::SubmitFunc(F f) {
+  return pool_->DoSubmit(SmallFunction(std::move(f)), this);
+}
+
+template <class F>
+Status ThreadPoolToken::SubmitCoalesced(const void* key, F f) {
+  DCHECK(key);
+  return pool_->DoSubmit(SmallFunction(std::move(f)), this, key);
+}
+
 } // namespace kudu
 #endif
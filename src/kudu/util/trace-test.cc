@@ -32,6 +32,7 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/countdown_latch.h"
@@ -88,6 +89,34 @@ TEST_F(TraceTest, TestBasic) {
             result);
 }
 
+// Messages with a constant format are formatted only when dumped. Check that
+// they come out just as strings::Substitute() would have formatted them, even
+// if the arguments are gone by then.
+TEST_F(TraceTest, TestDeferredFormatting) {
+  scoped_refptr<Trace> t(new Trace);
+  const void* ptr = reinterpret_cast<const void*>(0xdeadbeef);
+  {
+    string temp = "temporary";
+    char buf[] = "buffer";
+    TRACE_TO(t, "$0 $1 $2 $3 $4 $5 $6 $7 $8 $9",
+             temp, buf, static_cast<const char*>(nullptr), 'c', -12345,
+             static_cast<uint64_t>(54321), 1.5, 2.5f, true, ptr);
+    temp = "overwritten";
+    strcpy(buf, "clobber"); // NOLINT(runtime/printf)
+  }
+  // A format which isn't a constant is formatted right away.
+  TRACE_TO(t, string("$$$0"), 42);
+  TRACE_TO(t, "no args $$");
+
+  string expected = strings::Substitute("$0 $1 $2 $3 $4 $5 $6 $7 $8 $9",
+                                        "temporary", "buffer", "", 'c', -12345,
+                                        static_cast<uint64_t>(54321), 1.5, 2.5f, true, ptr);
+  string result = t->DumpToString(Trace::NO_FLAGS);
+  ASSERT_STR_CONTAINS(result, "] " + expected + "\n");
+  ASSERT_STR_CONTAINS(result, "] $42\n");
+  ASSERT_STR_CONTAINS(result, "] no args $\n");
+}
+
 TEST_F(TraceTest, TestAttach) {
   scoped_refptr<Trace> traceA(new Trace);
   scoped_refptr<Trace> traceB(new Trace);
@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <deque>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -65,6 +66,11 @@ struct TraceEntry {
   const char* file_path;
   int line_number;
 
+  // The format of a message recorded by Trace::Record(). If set, the message
+  // which follows the entry header is the binary encoding of its arguments
+  // (see TraceArg::EncodeTo()) instead of the formatted message.
+  const char* format;
+
   uint32_t message_len;
   TraceEntry* next;
 
@@ -74,6 +80,85 @@ struct TraceEntry {
   }
 };
 
+size_t TraceArg::EncodedSize() const {
+  size_t size = sizeof(type_);
+  switch (type_) {
+    case STRING: return size + sizeof(uint32_t) + str_len_;
+    case CHAR: return size + sizeof(v_.c);
+    case INT64: return size + sizeof(v_.i);
+    case UINT64: return size + sizeof(v_.u);
+    case INT128: return size + sizeof(v_.i128);
+    case UINT128: return size + sizeof(v_.u128);
+    case FLOAT: return size + sizeof(v_.f);
+    case DOUBLE: return size + sizeof(v_.d);
+    case BOOL: return size + sizeof(v_.b);
+    case POINTER: return size + sizeof(v_.p);
+  }
+  LOG(FATAL) << "unknown trace argument type: " << type_;
+}
+
+uint8_t* TraceArg::EncodeTo(uint8_t* dst) const {
+  *dst++ = type_;
+  if (type_ == STRING) {
+    uint32_t len = str_len_;
+    memcpy(dst, &len, sizeof(len));
+    dst += sizeof(len);
+    // 'str_data_' may be null for an empty string.
+    if (len > 0) {
+      memcpy(dst, str_data_, len);
+    }
+    return dst + len;
+  }
+  size_t size = EncodedSize() - sizeof(type_);
+  memcpy(dst, &v_, size);
+  return dst + size;
+}
+
+string TraceArg::Format(const char* format, const uint8_t* encoded_args, size_t len) {
+  // Decode the arguments. A deque is used since a SubstituteArg may point into
+  // itself, and so must not be moved once constructed.
+  std::deque<SubstituteArg> args;
+  const uint8_t* src = encoded_args;
+  const uint8_t* end = encoded_args + len;
+  auto read = [&](void* value, size_t size) {
+    memcpy(value, src, size);
+    src += size;
+  };
+  while (src < end) {
+    Type type = static_cast<Type>(*src++);
+    switch (type) {
+      case STRING: {
+        uint32_t str_len;
+        read(&str_len, sizeof(str_len));
+        args.emplace_back(StringPiece(reinterpret_cast<const char*>(src), str_len));
+        src += str_len;
+        break;
+      }
+      case CHAR: { char v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case INT64: { int64_t v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case UINT64: { uint64_t v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case INT128: { __int128 v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case UINT128: { unsigned __int128 v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case FLOAT: { float v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case DOUBLE: { double v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case BOOL: { bool v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+      case POINTER: { const void* v; read(&v, sizeof(v)); args.emplace_back(v); break; }
+    }
+  }
+  DCHECK(src == end);
+
+  const SubstituteArg* args_array[11];
+  for (size_t i = 0; i < 10; i++) {
+    args_array[i] = i < args.size() ? &args[i] : &SubstituteArg::kNoArg;
+  }
+  args_array[10] = nullptr;
+
+  string msg;
+  msg.resize(strings::internal::SubstitutedSize(format, args_array));
+  strings::internal::SubstituteToBuffer(format, args_array, &msg[0]);
+  return msg;
+}
+
 // Get the part of filepath after the last path separator.
 // (Doesn't modify filepath, contrary to basename() in libgen.h.)
 // Borrowed from glog.
@@ -105,6 +190,23 @@ void Trace::SubstituteAndTrace(const char* file_path,
   AddEntry(entry);
 }
 
+void Trace::RecordDeferred(const char* file_path,
+                           int line_number,
+                           const char* format,
+                           std::initializer_list<TraceArg> args) {
+  size_t len = 0;
+  for (const auto& arg : args) {
+    len += arg.EncodedSize();
+  }
+  TraceEntry* entry = NewEntry(len, file_path, line_number);
+  entry->format = format;
+  uint8_t* dst = reinterpret_cast<uint8_t*>(entry->message());
+  for (const auto& arg : args) {
+    dst = arg.EncodeTo(dst);
+  }
+  AddEntry(entry);
+}
+
 TraceEntry* Trace::NewEntry(int msg_len, const char* file_path, int line_number) {
   int size = sizeof(TraceEntry) + msg_len;
   uint8_t* dst = reinterpret_cast<uint8_t*>(arena_->AllocateBytes(size));
@@ -113,6 +215,7 @@ TraceEntry* Trace::NewEntry(int msg_len, const char* file_path, int line_number)
   entry->message_len = msg_len;
   entry->file_path = file_path;
   entry->line_number = line_number;
+  entry->format = nullptr;
   return entry;
 }
 
@@ -168,8 +271,12 @@ void Trace::Dump(std::ostream* out, int flags) const {
     }
     *out << const_basename(e->file_path) << ':' << e->line_number
          << "] ";
-    out->write(reinterpret_cast<char*>(e) + sizeof(TraceEntry),
-               e->message_len);
+    if (e->format) {
+      *out << TraceArg::Format(
+          e->format, reinterpret_cast<const uint8_t*>(e->message()), e->message_len);
+    } else {
+      out->write(e->message(), e->message_len);
+    }
     *out << std::endl;
   }
 
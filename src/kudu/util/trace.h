@@ -17,6 +17,10 @@
 #ifndef KUDU_UTIL_TRACE_H
 #define KUDU_UTIL_TRACE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
 #include <iosfwd>
 #include <string>
 #include <utility>
@@ -43,21 +47,24 @@ class Trace;
 #define ADOPT_TRACE(t) kudu::ScopedAdoptTrace _adopt_trace(t);
 
 // Issue a trace message, if tracing is enabled in the current thread.
-// See Trace::SubstituteAndTrace for arguments.
+// See Trace::Record for arguments.
 // Example:
 //  TRACE("Acquired timestamp $0", timestamp);
+//
+// When the format is a string constant, the arguments are recorded in binary
+// form and the message is only formatted if the trace is dumped.
 #define TRACE(format, substitutions...) \
   do { \
     kudu::Trace* _trace = Trace::CurrentTrace(); \
     if (_trace) { \
-      _trace->SubstituteAndTrace(__FILE__, __LINE__, (format),  \
+      _trace->Record(__FILE__, __LINE__, (format),  \
         ##substitutions); \
     } \
   } while (0);
 
 // Like the above, but takes the trace pointer as an explicit argument.
 #define TRACE_TO(trace, format, substitutions...) \
-  (trace)->SubstituteAndTrace(__FILE__, __LINE__, (format), ##substitutions)
+  (trace)->Record(__FILE__, __LINE__, (format), ##substitutions)
 
 // Increment a counter associated with the current trace.
 //
@@ -118,6 +125,95 @@ class JsonWriter;
 class ThreadSafeArena;
 struct TraceEntry;
 
+// An argument to a trace message whose formatting is deferred until the trace
+// is dumped. This accepts the same types as strings::internal::SubstituteArg,
+// and the message is formatted exactly as strings::Substitute() would have.
+//
+// A TraceArg only refers to the value it was constructed from, so it must not
+// outlive it. Strings are copied into the trace when the message is recorded.
+class TraceArg {
+ public:
+  TraceArg(const char* value)  // NOLINT(runtime/explicit)
+      : type_(STRING), str_data_(value), str_len_(value == nullptr ? 0 : strlen(value)) {}
+  TraceArg(const std::string& value)  // NOLINT(runtime/explicit)
+      : type_(STRING), str_data_(value.data()), str_len_(value.size()) {}
+  TraceArg(const StringPiece& value)  // NOLINT(runtime/explicit)
+      : type_(STRING), str_data_(value.data()), str_len_(value.size()) {}
+
+  TraceArg(char value)  // NOLINT(runtime/explicit)
+      : type_(CHAR) { v_.c = value; }
+  TraceArg(short value)  // NOLINT(runtime/explicit)
+      : type_(INT64) { v_.i = value; }
+  TraceArg(unsigned short value)  // NOLINT(runtime/explicit)
+      : type_(UINT64) { v_.u = value; }
+  TraceArg(int value)  // NOLINT(runtime/explicit)
+      : type_(INT64) { v_.i = value; }
+  TraceArg(unsigned int value)  // NOLINT(runtime/explicit)
+      : type_(UINT64) { v_.u = value; }
+  TraceArg(long value)  // NOLINT(runtime/explicit)
+      : type_(INT64) { v_.i = value; }
+  TraceArg(unsigned long value)  // NOLINT(runtime/explicit)
+      : type_(UINT64) { v_.u = value; }
+  TraceArg(long long value)  // NOLINT(runtime/explicit)
+      : type_(INT64) { v_.i = value; }
+  TraceArg(unsigned long long value)  // NOLINT(runtime/explicit)
+      : type_(UINT64) { v_.u = value; }
+  TraceArg(__int128 value)  // NOLINT(runtime/explicit)
+      : type_(INT128) { v_.i128 = value; }
+  TraceArg(unsigned __int128 value)  // NOLINT(runtime/explicit)
+      : type_(UINT128) { v_.u128 = value; }
+  TraceArg(float value)  // NOLINT(runtime/explicit)
+      : type_(FLOAT) { v_.f = value; }
+  TraceArg(double value)  // NOLINT(runtime/explicit)
+      : type_(DOUBLE) { v_.d = value; }
+  TraceArg(bool value)  // NOLINT(runtime/explicit)
+      : type_(BOOL) { v_.b = value; }
+  TraceArg(const void* value)  // NOLINT(runtime/explicit)
+      : type_(POINTER) { v_.p = value; }
+
+ private:
+  friend class Trace;
+
+  enum Type : uint8_t {
+    STRING,
+    CHAR,
+    INT64,
+    UINT64,
+    INT128,
+    UINT128,
+    FLOAT,
+    DOUBLE,
+    BOOL,
+    POINTER
+  };
+
+  // Returns the number of bytes EncodeTo() writes.
+  size_t EncodedSize() const;
+
+  // Writes the type and value of the argument to 'dst', returning a pointer
+  // to the byte following it.
+  uint8_t* EncodeTo(uint8_t* dst) const;
+
+  // Formats a message with the given 'format' and the 'len' bytes of arguments
+  // encoded at 'encoded_args'.
+  static std::string Format(const char* format, const uint8_t* encoded_args, size_t len);
+
+  Type type_;
+  const char* str_data_ = nullptr;
+  size_t str_len_ = 0;
+  union {
+    char c;
+    int64_t i;
+    uint64_t u;
+    __int128 i128;
+    unsigned __int128 u128;
+    float f;
+    double d;
+    bool b;
+    const void* p;
+  } v_;
+};
+
 // A trace for a request or other process. This supports collecting trace entries
 // from a number of threads, and later dumping the results to a stream.
 //
@@ -159,6 +255,27 @@ class Trace : public RefCountedThreadSafe<Trace> {
                           const strings::internal::SubstituteArg& arg9 =
                             strings::internal::SubstituteArg::kNoArg);
 
+  // Logs a message into the trace buffer, deferring its formatting until the
+  // trace is dumped. Only the arguments are copied, in binary form, so this is
+  // considerably cheaper than SubstituteAndTrace().
+  //
+  // N.B.: as with the file path, the format is not copied, so must be a static
+  // constant (eg a string literal).
+  template<typename... Args>
+  void Record(const char* filepath, int line_number, const char* format,
+              const Args&... args) {
+    static_assert(sizeof...(args) <= 10, "too many trace message arguments");
+    RecordDeferred(filepath, line_number, format, { TraceArg(args)... });
+  }
+
+  // As above, but for a format which isn't a static constant: the message is
+  // formatted immediately, by SubstituteAndTrace().
+  template<typename... Args>
+  void Record(const char* filepath, int line_number, StringPiece format,
+              const Args&... args) {
+    SubstituteAndTrace(filepath, line_number, format, args...);
+  }
+
   // Dump the trace buffer to the given output stream.
   //
   enum {
@@ -215,6 +332,10 @@ class Trace : public RefCountedThreadSafe<Trace> {
   // object.
   static __thread Trace* threadlocal_trace_;
 
+  // Implementation of Record() for static formats.
+  void RecordDeferred(const char* file_path, int line_number, const char* format,
+                      std::initializer_list<TraceArg> args);
+
   // Allocate a new entry from the arena, with enough space to hold a
   // message of length 'len'.
   TraceEntry* NewEntry(int len, const char* file_path, int line_number);
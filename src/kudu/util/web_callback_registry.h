@@ -89,6 +89,20 @@ class WebCallbackRegistry {
     std::ostringstream* output;
   };
 
+  // A response to an HTTP request whose body is sent as it's written.
+  struct StreamingWebResponse {
+    // Determines the status code of the HTTP response.
+    HttpStatusCode status_code;
+
+    // Additional headers added to the HTTP response.
+    HttpResponseHeaders response_headers;
+
+    // The response body. The status code and headers are sent along with the
+    // first part of the body which is flushed, so they may not be changed
+    // once the callback has written enough to fill the output buffer.
+    std::ostream* output;
+  };
+
   // A function that handles an HTTP request where the response body will be rendered
   // with a mustache template from the JSON object held by 'resp'.
   typedef boost::function<void (const WebRequest& args, WebResponse* resp)>
@@ -99,6 +113,11 @@ class WebCallbackRegistry {
   typedef boost::function<void (const WebRequest& args, PrerenderedWebResponse* resp)>
       PrerenderedPathHandlerCallback;
 
+  // A function that handles an HTTP request, where the response body is
+  // streamed to the client as it's written to the 'output' member of 'resp'.
+  typedef boost::function<void (const WebRequest& args, StreamingWebResponse* resp)>
+      StreamingPathHandlerCallback;
+
   virtual ~WebCallbackRegistry() {}
 
   // Register a callback for a URL path. Path should not include the
@@ -122,6 +141,14 @@ class WebCallbackRegistry {
                                               const PrerenderedPathHandlerCallback& callback,
                                               bool is_styled,
                                               bool is_on_nav_bar) = 0;
+
+  // Same as RegisterPrerenderedPathHandler(), except that the response body
+  // is sent in chunks as the callback produces it, rather than buffered in
+  // full. This suits large machine-readable responses, so the page is never
+  // styled.
+  virtual void RegisterStreamingPathHandler(const std::string& path, const std::string& alias,
+                                            const StreamingPathHandlerCallback& callback,
+                                            bool is_on_nav_bar) = 0;
 };
 
 } // namespace kudu